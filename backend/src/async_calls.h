@@ -0,0 +1,432 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <grpc++/grpc++.h>
+#include <grpc++/impl/codegen/proto_utils.h>
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include "async_rpc_pool.h"
+#include "backend_metrics.h"
+#include "log.h"
+
+namespace dronecore {
+namespace backend {
+
+// All streams of one server streaming RPC, e.g. of a telemetry topic. The
+// topic of a system is subscribed to once, when the first client for the
+// system comes, and every response is published to all streams of the system
+// from there. A new stream first gets the latest response, so that values
+// which rarely change are not missing.
+//
+// Publishing never waits for a client. Every stream has at most one write in
+// flight, and up to max_queued responses waiting for it. Once these are
+// full, the oldest one is dropped, so a slow client only misses responses,
+// instead of holding up the others or the thread publishing them. With
+// max_queued 1, the default for topics of a state, the latest one wins. Topics
+// of events should queue more, so that bursts make it through.
+//
+// A response is serialized once when it is published, and that same buffer
+// is written to all streams, so the cost grows with the number of topics and
+// not with the number of clients. The RPC therefore has to be a raw method of
+// the service, e.g. with WithRawMethod_SubscribePosition, which takes the
+// buffer as it is. Its request is not parsed, the streams don't look at it.
+template <typename Request, typename Response>
+class AsyncStreamTopic
+{
+public:
+    typedef std::function<void(grpc::ServerContext *, grpc::ByteBuffer *,
+                               grpc::ServerAsyncWriter<grpc::ByteBuffer> *,
+                               grpc::ServerCompletionQueue *, void *)> request_function_t;
+    // Returns the system the stream is for, or the status to fail it with.
+    typedef std::function<grpc::Status(const grpc::ServerContext &, uint64_t &uuid)>
+    resolve_function_t;
+    typedef std::function<void(uint64_t uuid)> subscribe_function_t;
+
+    AsyncStreamTopic(AsyncRpcPool &pool, RpcMetrics &metrics,
+                     request_function_t request_function,
+                     resolve_function_t resolve_function,
+                     subscribe_function_t subscribe_function,
+                     unsigned max_queued = 1)
+        : _pool(pool),
+          _metrics(metrics),
+          _request_function(request_function),
+          _resolve_function(resolve_function),
+          _subscribe_function(subscribe_function),
+          _max_queued(max_queued > 0 ? max_queued : 1) {}
+
+    ~AsyncStreamTopic()
+    {
+        shutdown();
+    }
+
+    // Waits for a client on the completion queue, and for the next one after it.
+    void start(grpc::ServerCompletionQueue *completion_queue)
+    {
+        auto stream = new Stream(*this, completion_queue);
+        if (stream->is_orphan()) {
+            delete stream;
+        }
+    }
+
+    void publish(uint64_t uuid, const Response &response)
+    {
+        // Outside of the lock, streams of other systems need not wait for it.
+        grpc::ByteBuffer buffer;
+        bool own_buffer;
+        if (!grpc::SerializationTraits<Response>::Serialize(response, &buffer, &own_buffer).ok()) {
+            LogErr() << "Could not serialize a response for system " << uuid;
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto &system = _systems[uuid];
+        // Copies of a buffer share its slices, nothing is copied but references.
+        system.latest_response = buffer;
+        system.has_latest_response = true;
+        for (auto stream : system.streams) {
+            stream->write(buffer);
+        }
+    }
+
+    // To be called once the pool is shut down, deletes the streams which
+    // were waiting for a response.
+    void shutdown()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto &system : _systems) {
+            for (auto stream : system.second.streams) {
+                delete stream;
+            }
+            system.second.streams.clear();
+        }
+    }
+
+    // Non-copyable
+    AsyncStreamTopic(const AsyncStreamTopic &) = delete;
+    const AsyncStreamTopic &operator=(const AsyncStreamTopic &) = delete;
+
+private:
+    class Stream final : public AsyncCall
+    {
+    public:
+        Stream(AsyncStreamTopic &topic, grpc::ServerCompletionQueue *completion_queue)
+            : _topic(topic),
+              _completion_queue(completion_queue),
+              _writer(&_context),
+              _queue(topic._max_queued)
+        {
+            if (!_topic._pool.start_operation([this]() {
+            _topic._request_function(&_context, &_request, &_writer, _completion_queue,
+                                     &_requested_tag);
+            })) {
+                // Nobody is going to proceed with it.
+                _is_orphan = true;
+            }
+        }
+
+        ~Stream()
+        {
+            if (_is_active) {
+                _topic._metrics.active_streams.fetch_sub(1, std::memory_order_relaxed);
+                _topic._metrics.queued_messages.fetch_sub(_queue_len, std::memory_order_relaxed);
+            }
+            if (_num_dropped > 0) {
+                LogInfo() << "Dropped " << _num_dropped << " of " << _num_published
+                          << " responses for a slow client of system " << _uuid;
+            }
+        }
+
+        bool is_orphan() const { return _is_orphan; }
+        uint64_t uuid() const { return _uuid; }
+
+        void proceed(int event, bool ok) override
+        {
+            switch (event) {
+                case REQUESTED:
+                    if (!ok) {
+                        // The server is shutting down.
+                        delete this;
+                        return;
+                    }
+                    _topic.start(_completion_queue);
+                    _topic._metrics.calls.fetch_add(1, std::memory_order_relaxed);
+                    {
+                        const auto status = _topic._resolve_function(_context, _uuid);
+                        if (!status.ok()) {
+                            finish(status);
+                            return;
+                        }
+                    }
+                    _is_active = true;
+                    _topic._metrics.active_streams.fetch_add(1, std::memory_order_relaxed);
+                    _topic.add(this);
+                    return;
+                case WRITTEN:
+                    written(ok);
+                    return;
+                case FINISHED:
+                    delete this;
+                    return;
+            }
+        }
+
+        // Called with the topic locked.
+        void write(const grpc::ByteBuffer &response)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            if (_is_finishing) {
+                return;
+            }
+            ++_num_published;
+            if (_is_writing) {
+                queue(response);
+                return;
+            }
+            start_write(response);
+        }
+
+    private:
+        enum Event {
+            REQUESTED,
+            WRITTEN,
+            FINISHED
+        };
+
+        // We assume that we already acquired the mutex in this function.
+        void queue(const grpc::ByteBuffer &response)
+        {
+            if (_queue_len == _queue.size()) {
+                // Overwrites the oldest one.
+                _queue_begin = (_queue_begin + 1) % _queue.size();
+                --_queue_len;
+                ++_num_dropped;
+                _topic._metrics.messages_dropped.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                _topic._metrics.queued_messages.fetch_add(1, std::memory_order_relaxed);
+            }
+            _queue[(_queue_begin + _queue_len) % _queue.size()] = response;
+            ++_queue_len;
+        }
+
+        // We assume that we already acquired the mutex in this function.
+        void start_write(const grpc::ByteBuffer &response)
+        {
+            _is_writing = _topic._pool.start_operation([this, &response]() {
+                _writer.Write(response, &_written_tag);
+            });
+            if (_is_writing) {
+                _topic._metrics.messages_written.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        void written(bool ok)
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _is_writing = false;
+
+                if (ok) {
+                    if (_queue_len > 0) {
+                        // The write takes its own reference right away, so the slot can be
+                        // reused.
+                        const unsigned next = _queue_begin;
+                        _queue_begin = (_queue_begin + 1) % _queue.size();
+                        --_queue_len;
+                        _topic._metrics.queued_messages.fetch_sub(1, std::memory_order_relaxed);
+                        start_write(_queue[next]);
+                    }
+                    return;
+                }
+                // The client is gone.
+                _is_finishing = true;
+            }
+
+            // Without the stream locked, as publish() locks the topic first.
+            _topic.remove(this);
+            finish(grpc::Status::CANCELLED);
+        }
+
+        void finish(const grpc::Status &status)
+        {
+            if (!_topic._pool.start_operation([this, &status]() {
+            _writer.Finish(status, &_finished_tag);
+            })) {
+                delete this;
+            }
+        }
+
+        AsyncStreamTopic &_topic;
+        grpc::ServerCompletionQueue *_completion_queue;
+        grpc::ServerContext _context {};
+        grpc::ByteBuffer _request {};
+        grpc::ServerAsyncWriter<grpc::ByteBuffer> _writer;
+        bool _is_orphan = false;
+        // Counted as an active stream.
+        bool _is_active = false;
+        uint64_t _uuid = 0;
+
+        Tag _requested_tag {this, REQUESTED};
+        Tag _written_tag {this, WRITTEN};
+        Tag _finished_tag {this, FINISHED};
+
+        std::mutex _mutex {};
+        bool _is_writing = false;
+        bool _is_finishing = false;
+        // Ring of the responses waiting for the write in flight.
+        std::vector<grpc::ByteBuffer> _queue;
+        unsigned _queue_begin = 0;
+        unsigned _queue_len = 0;
+        uint64_t _num_published = 0;
+        uint64_t _num_dropped = 0;
+    };
+
+    struct SystemStreams {
+        std::set<Stream *> streams {};
+        bool is_subscribed = false;
+        bool has_latest_response = false;
+        grpc::ByteBuffer latest_response {};
+    };
+
+    void add(Stream *stream)
+    {
+        bool should_subscribe = false;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto &system = _systems[stream->uuid()];
+            system.streams.insert(stream);
+            if (system.has_latest_response) {
+                stream->write(system.latest_response);
+            }
+            should_subscribe = !system.is_subscribed;
+            system.is_subscribed = true;
+        }
+
+        // Not with the topic locked, in case the first response is published
+        // right away.
+        if (should_subscribe) {
+            _subscribe_function(stream->uuid());
+        }
+    }
+
+    void remove(Stream *stream)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _systems[stream->uuid()].streams.erase(stream);
+    }
+
+    AsyncRpcPool &_pool;
+    RpcMetrics &_metrics;
+    const request_function_t _request_function;
+    const resolve_function_t _resolve_function;
+    const subscribe_function_t _subscribe_function;
+    const unsigned _max_queued;
+
+    std::mutex _mutex {};
+    std::map<uint64_t, SystemStreams> _systems {};
+};
+
+// One unary RPC call. The handler gets the request once it came in and has
+// to call the reply function exactly once, from any thread, e.g. from the
+// callback of an async DroneCore call. No thread waits in between. The
+// response is only sent if the status is OK.
+template <typename Request, typename Response>
+class AsyncUnaryCall final : public AsyncCall
+{
+public:
+    typedef std::function<void(grpc::ServerContext *, Request *,
+                               grpc::ServerAsyncResponseWriter<Response> *,
+                               grpc::ServerCompletionQueue *, void *)> request_function_t;
+    typedef std::function<void(const grpc::Status &, const Response &)> reply_function_t;
+    typedef std::function<void(const grpc::ServerContext &, const Request &, reply_function_t)>
+    handle_function_t;
+
+    // Waits for a call on the completion queue, and for the next one after it.
+    static void start(AsyncRpcPool &pool, RpcMetrics &metrics, request_function_t request_function,
+                      handle_function_t handle_function,
+                      grpc::ServerCompletionQueue *completion_queue)
+    {
+        auto call = new AsyncUnaryCall(pool, metrics, request_function, handle_function,
+                                       completion_queue);
+        if (!pool.start_operation([call]() {
+        call->_request_function(&call->_context, &call->_request, &call->_responder,
+                                call->_completion_queue, &call->_requested_tag);
+        })) {
+            delete call;
+        }
+    }
+
+    void proceed(int event, bool ok) override
+    {
+        switch (event) {
+            case REQUESTED:
+                if (!ok) {
+                    // The server is shutting down.
+                    delete this;
+                    return;
+                }
+                start(_pool, _metrics, _request_function, _handle_function, _completion_queue);
+                _metrics.calls.fetch_add(1, std::memory_order_relaxed);
+                _requested_time = std::chrono::steady_clock::now();
+                _handle_function(_context, _request, [this](const grpc::Status & status,
+                const Response & response) {
+                    const std::chrono::duration<double> latency =
+                        std::chrono::steady_clock::now() - _requested_time;
+                    _metrics.add_latency(latency.count());
+                    if (!_pool.start_operation([this, &status, &response]() {
+                    if (status.ok()) {
+                        _responder.Finish(response, status, &_finished_tag);
+                    } else {
+                        _responder.FinishWithError(status, &_finished_tag);
+                    }
+                    })) {
+                        delete this;
+                    }
+                });
+                return;
+            case FINISHED:
+                delete this;
+                return;
+        }
+    }
+
+    // Non-copyable
+    AsyncUnaryCall(const AsyncUnaryCall &) = delete;
+    const AsyncUnaryCall &operator=(const AsyncUnaryCall &) = delete;
+
+private:
+    enum Event {
+        REQUESTED,
+        FINISHED
+    };
+
+    AsyncUnaryCall(AsyncRpcPool &pool, RpcMetrics &metrics, request_function_t request_function,
+                   handle_function_t handle_function,
+                   grpc::ServerCompletionQueue *completion_queue)
+        : _pool(pool),
+          _metrics(metrics),
+          _request_function(request_function),
+          _handle_function(handle_function),
+          _completion_queue(completion_queue),
+          _responder(&_context) {}
+
+    AsyncRpcPool &_pool;
+    RpcMetrics &_metrics;
+    const request_function_t _request_function;
+    const handle_function_t _handle_function;
+    grpc::ServerCompletionQueue *_completion_queue;
+    grpc::ServerContext _context {};
+    Request _request {};
+    grpc::ServerAsyncResponseWriter<Response> _responder;
+    std::chrono::steady_clock::time_point _requested_time {};
+
+    Tag _requested_tag {this, REQUESTED};
+    Tag _finished_tag {this, FINISHED};
+};
+
+} // namespace backend
+} // namespace dronecore
@@ -0,0 +1,69 @@
+#include "async_rpc_pool.h"
+
+#include <chrono>
+
+namespace dronecore {
+namespace backend {
+
+AsyncRpcPool::AsyncRpcPool(unsigned num_threads)
+    : _num_threads(num_threads > 0 ? num_threads : 1) {}
+
+AsyncRpcPool::~AsyncRpcPool()
+{
+    for (auto &thread : _threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+void AsyncRpcPool::add_completion_queues(grpc::ServerBuilder &builder)
+{
+    for (unsigned i = 0; i < _num_threads; ++i) {
+        _completion_queues.push_back(builder.AddCompletionQueue());
+    }
+}
+
+void AsyncRpcPool::run()
+{
+    for (auto &completion_queue : _completion_queues) {
+        _threads.push_back(std::thread(handle_events, completion_queue.get()));
+    }
+}
+
+void AsyncRpcPool::shutdown(grpc::Server &server)
+{
+    {
+        // Once this is set, no operation can start anymore, so the queues
+        // can be shut down safely after the server.
+        std::lock_guard<std::mutex> lock(_mutex);
+        _is_shutting_down = true;
+    }
+
+    // Streams never finish on their own, so they are cancelled right away.
+    server.Shutdown(std::chrono::system_clock::now());
+
+    for (auto &completion_queue : _completion_queues) {
+        completion_queue->Shutdown();
+    }
+
+    for (auto &thread : _threads) {
+        thread.join();
+    }
+    _threads.clear();
+}
+
+void AsyncRpcPool::handle_events(grpc::ServerCompletionQueue *completion_queue)
+{
+    void *tag = nullptr;
+    bool ok = false;
+
+    // This only returns false once the queue is shut down and drained.
+    while (completion_queue->Next(&tag, &ok)) {
+        auto call_tag = static_cast<AsyncCall::Tag *>(tag);
+        call_tag->call->proceed(call_tag->event, ok);
+    }
+}
+
+} // namespace backend
+} // namespace dronecore
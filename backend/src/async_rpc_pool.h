@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <grpc++/server.h>
+#include <grpc++/server_builder.h>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dronecore {
+namespace backend {
+
+// Something waiting for completion queue events. The tag of every operation
+// is a pointer to one of its Tags, which tells the call which of its
+// operations completed.
+class AsyncCall
+{
+public:
+    virtual ~AsyncCall() {}
+
+    struct Tag {
+        AsyncCall *call;
+        int event;
+    };
+
+    virtual void proceed(int event, bool ok) = 0;
+};
+
+// A fixed number of threads, each with a completion queue of its own, which
+// serve all async calls between them. No thread is ever parked on a single
+// call, so the number of streams does not depend on the number of threads.
+class AsyncRpcPool
+{
+public:
+    explicit AsyncRpcPool(unsigned num_threads);
+    ~AsyncRpcPool();
+
+    // To be called before the server is built.
+    void add_completion_queues(grpc::ServerBuilder &builder);
+    const std::vector<std::unique_ptr<grpc::ServerCompletionQueue>> &completion_queues() const
+    {
+        return _completion_queues;
+    }
+
+    // To be called once the calls are waiting on the completion queues.
+    void run();
+
+    // Shuts down the server, then waits for all threads to finish.
+    void shutdown(grpc::Server &server);
+
+    bool is_shutting_down() const { return _is_shutting_down; }
+
+    // Runs an operation which starts on a completion queue, unless these are
+    // being shut down already, which is not allowed. Returns false then, and
+    // the tag will not come back.
+    template <typename Operation>
+    bool start_operation(Operation operation)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_is_shutting_down) {
+            return false;
+        }
+        operation();
+        return true;
+    }
+
+    // Non-copyable
+    AsyncRpcPool(const AsyncRpcPool &) = delete;
+    const AsyncRpcPool &operator=(const AsyncRpcPool &) = delete;
+
+private:
+    static void handle_events(grpc::ServerCompletionQueue *completion_queue);
+
+    const unsigned _num_threads;
+    std::vector<std::unique_ptr<grpc::ServerCompletionQueue>> _completion_queues {};
+    std::vector<std::thread> _threads {};
+
+    std::mutex _mutex {};
+    std::atomic<bool> _is_shutting_down {false};
+};
+
+} // namespace backend
+} // namespace dronecore
@@ -5,6 +5,7 @@
 #include "connection_initiator.h"
 #include "dronecore.h"
 #include "grpc_server.h"
+#include "metrics_http_server.h"
 
 namespace dronecore {
 namespace backend {
@@ -15,18 +16,30 @@ public:
     Impl() {}
     ~Impl() {}
 
+    // Does not wait for a system, calls fail as UNAVAILABLE until one is discovered.
     void connect(const int mavlink_listen_port)
     {
-        _connection_initiator.start(_dc, 14540);
-        _connection_initiator.wait();
+        _connection_initiator.start(_dc, mavlink_listen_port);
     }
 
-    void startGRPCServer()
+    void startGRPCServer(const std::string &listen_address)
     {
-        _server = std::unique_ptr<GRPCServer>(new GRPCServer(_dc));
+        _server = std::unique_ptr<GRPCServer>(new GRPCServer(_dc, listen_address));
         _server->run();
     }
 
+    std::shared_ptr<grpc::Channel> createInProcessChannel()
+    {
+        return _server->in_process_channel();
+    }
+
+    bool startMetricsServer(const int port)
+    {
+        _metrics_server = std::unique_ptr<MetricsHttpServer>(new MetricsHttpServer(
+                                                                 _server->metrics()));
+        return _metrics_server->start(port);
+    }
+
     void wait()
     {
         _server->wait();
@@ -36,14 +49,37 @@ private:
     DroneCore _dc;
     ConnectionInitiator<dronecore::DroneCore> _connection_initiator;
     std::unique_ptr<GRPCServer> _server;
+    // Declared after the server, so that it stops before the metrics go.
+    std::unique_ptr<MetricsHttpServer> _metrics_server;
 };
 
 DroneCoreBackend::DroneCoreBackend() : _impl(new Impl()) {}
 DroneCoreBackend::~DroneCoreBackend() = default;
 
-void DroneCoreBackend::startGRPCServer() { _impl->startGRPCServer(); }
-void DroneCoreBackend::connect(const int mavlink_listen_port) { return _impl->connect(mavlink_listen_port); }
-void DroneCoreBackend::wait() { _impl->wait(); }
+void DroneCoreBackend::startGRPCServer(const std::string &listen_address)
+{
+    _impl->startGRPCServer(listen_address);
+}
+
+void DroneCoreBackend::connect(const int mavlink_listen_port)
+{
+    return _impl->connect(mavlink_listen_port);
+}
+
+void DroneCoreBackend::wait()
+{
+    _impl->wait();
+}
+
+std::shared_ptr<grpc::Channel> DroneCoreBackend::createInProcessChannel()
+{
+    return _impl->createInProcessChannel();
+}
+
+bool DroneCoreBackend::startMetricsServer(const int port)
+{
+    return _impl->startMetricsServer(port);
+}
 
 } // namespace backend
 } // namespace dronecore
@@ -1,6 +1,11 @@
 #pragma once
 
 #include <memory>
+#include <string>
+
+namespace grpc {
+class Channel;
+}
 
 namespace dronecore {
 namespace backend {
@@ -13,10 +18,17 @@ public:
     DroneCoreBackend(DroneCoreBackend &&) = delete;
     DroneCoreBackend &operator=(DroneCoreBackend &&) = delete;
 
-    void startGRPCServer();
+    // See GRPCServer for the formats of the address.
+    void startGRPCServer(const std::string &listen_address = "0.0.0.0:50051");
     void connect(const int mavlink_listen_port = 14540);
     void wait();
 
+    // For clients in the same process, without going through a socket.
+    std::shared_ptr<grpc::Channel> createInProcessChannel();
+
+    // Serves the metrics of the server over HTTP, for Prometheus to scrape.
+    bool startMetricsServer(const int port);
+
 private:
     class Impl;
     std::unique_ptr<Impl> _impl;
@@ -3,10 +3,25 @@
 #include "backend.h"
 
 void runBackend(const int mavlink_listen_port, void (*onServerStarted)(void *), void *context)
+{
+    runBackendOnAddress(mavlink_listen_port, "0.0.0.0:50051", onServerStarted, context);
+}
+
+void runBackendOnAddress(const int mavlink_listen_port, const char *listen_address,
+                         void (*onServerStarted)(void *), void *context)
+{
+    runBackendWithMetrics(mavlink_listen_port, listen_address, 0, onServerStarted, context);
+}
+
+void runBackendWithMetrics(const int mavlink_listen_port, const char *listen_address,
+                           const int metrics_port, void (*onServerStarted)(void *), void *context)
 {
     dronecore::backend::DroneCoreBackend backend;
     backend.connect(mavlink_listen_port);
-    backend.startGRPCServer();
+    backend.startGRPCServer(listen_address != nullptr ? listen_address : "");
+    if (metrics_port > 0) {
+        backend.startMetricsServer(metrics_port);
+    }
 
     if (onServerStarted != nullptr) {
         onServerStarted(context);
@@ -7,6 +7,21 @@ extern "C" {
 __attribute__((visibility("default"))) void runBackend(int mavlink_listen_port,
                                                        void (*onServerStarted)(void *), void *context);
 
+// Like runBackend(), but listening on listen_address, which is "host:port" or
+// "unix:path" for a Unix domain socket, e.g. "unix:/tmp/dronecore.sock".
+__attribute__((visibility("default"))) void runBackendOnAddress(int mavlink_listen_port,
+                                                                const char *listen_address,
+                                                                void (*onServerStarted)(void *),
+                                                                void *context);
+
+// Like runBackendOnAddress(), but also serving the metrics of the backend over
+// HTTP on metrics_port, for Prometheus to scrape.
+__attribute__((visibility("default"))) void runBackendWithMetrics(int mavlink_listen_port,
+                                                                  const char *listen_address,
+                                                                  int metrics_port,
+                                                                  void (*onServerStarted)(void *),
+                                                                  void *context);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,108 @@
+#include "backend_metrics.h"
+
+#include <sstream>
+
+namespace dronecore {
+namespace backend {
+
+constexpr unsigned RpcMetrics::NUM_LATENCY_BUCKETS;
+
+const double RpcMetrics::LATENCY_BUCKET_BOUNDS_S[NUM_LATENCY_BUCKETS] = {
+    0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 10.0
+};
+
+void RpcMetrics::add_latency(double latency_s)
+{
+    unsigned bucket = 0;
+    while (bucket < NUM_LATENCY_BUCKETS && latency_s > LATENCY_BUCKET_BOUNDS_S[bucket]) {
+        ++bucket;
+    }
+    // Relaxed, as nobody relies on the counters to be consistent with each other.
+    latency_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    latency_sum_us.fetch_add(uint64_t(latency_s * 1e6), std::memory_order_relaxed);
+}
+
+BackendMetrics::BackendMetrics() {}
+
+BackendMetrics::~BackendMetrics() {}
+
+RpcMetrics &BackendMetrics::rpc(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (auto &rpc : _rpcs) {
+        if (rpc.first == name) {
+            return *rpc.second;
+        }
+    }
+    _rpcs.push_back(std::make_pair(name, std::unique_ptr<RpcMetrics>(new RpcMetrics())));
+    return *_rpcs.back().second;
+}
+
+std::string BackendMetrics::prometheus_text() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::ostringstream text;
+
+    text << "# HELP dronecore_backend_rpc_calls_total Calls handled or streams started.\n"
+         << "# TYPE dronecore_backend_rpc_calls_total counter\n";
+    for (const auto &rpc : _rpcs) {
+        text << "dronecore_backend_rpc_calls_total{rpc=\"" << rpc.first << "\"} "
+             << rpc.second->calls.load() << "\n";
+    }
+
+    text << "# HELP dronecore_backend_rpc_latency_seconds Time from request to reply of calls.\n"
+         << "# TYPE dronecore_backend_rpc_latency_seconds histogram\n";
+    for (const auto &rpc : _rpcs) {
+        uint64_t count = 0;
+        for (unsigned i = 0; i < RpcMetrics::NUM_LATENCY_BUCKETS + 1; ++i) {
+            count += rpc.second->latency_buckets[i].load();
+            text << "dronecore_backend_rpc_latency_seconds_bucket{rpc=\"" << rpc.first
+                 << "\",le=\"";
+            if (i < RpcMetrics::NUM_LATENCY_BUCKETS) {
+                text << RpcMetrics::LATENCY_BUCKET_BOUNDS_S[i];
+            } else {
+                text << "+Inf";
+            }
+            text << "\"} " << count << "\n";
+        }
+        text << "dronecore_backend_rpc_latency_seconds_sum{rpc=\"" << rpc.first << "\"} "
+             << double(rpc.second->latency_sum_us.load()) / 1e6 << "\n"
+             << "dronecore_backend_rpc_latency_seconds_count{rpc=\"" << rpc.first << "\"} "
+             << count << "\n";
+    }
+
+    text << "# HELP dronecore_backend_active_streams Streams currently open.\n"
+         << "# TYPE dronecore_backend_active_streams gauge\n";
+    for (const auto &rpc : _rpcs) {
+        text << "dronecore_backend_active_streams{rpc=\"" << rpc.first << "\"} "
+             << rpc.second->active_streams.load() << "\n";
+    }
+
+    text << "# HELP dronecore_backend_stream_messages_written_total Messages written to streams.\n"
+         << "# TYPE dronecore_backend_stream_messages_written_total counter\n";
+    for (const auto &rpc : _rpcs) {
+        text << "dronecore_backend_stream_messages_written_total{rpc=\"" << rpc.first << "\"} "
+             << rpc.second->messages_written.load() << "\n";
+    }
+
+    text << "# HELP dronecore_backend_stream_messages_dropped_total Messages dropped for slow "
+         "clients.\n"
+         << "# TYPE dronecore_backend_stream_messages_dropped_total counter\n";
+    for (const auto &rpc : _rpcs) {
+        text << "dronecore_backend_stream_messages_dropped_total{rpc=\"" << rpc.first << "\"} "
+             << rpc.second->messages_dropped.load() << "\n";
+    }
+
+    text << "# HELP dronecore_backend_stream_queued_messages Messages waiting to be written.\n"
+         << "# TYPE dronecore_backend_stream_queued_messages gauge\n";
+    for (const auto &rpc : _rpcs) {
+        text << "dronecore_backend_stream_queued_messages{rpc=\"" << rpc.first << "\"} "
+             << rpc.second->queued_messages.load() << "\n";
+    }
+
+    return text.str();
+}
+
+} // namespace backend
+} // namespace dronecore
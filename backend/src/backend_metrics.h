@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dronecore {
+namespace backend {
+
+// What is counted of one RPC. These are only atomics, so that the calls can
+// count from any thread without taking a lock.
+struct RpcMetrics {
+    static constexpr unsigned NUM_LATENCY_BUCKETS = 12;
+    // Upper bounds, there is one more bucket for the rest.
+    static const double LATENCY_BUCKET_BOUNDS_S[NUM_LATENCY_BUCKETS];
+
+    // Calls handled, or streams started.
+    std::atomic<uint64_t> calls {0};
+    // Of unary calls, from the request to the reply.
+    std::atomic<uint64_t> latency_buckets[NUM_LATENCY_BUCKETS + 1] {};
+    std::atomic<uint64_t> latency_sum_us {0};
+
+    std::atomic<int64_t> active_streams {0};
+    std::atomic<uint64_t> messages_written {0};
+    std::atomic<uint64_t> messages_dropped {0};
+    // Messages waiting for a write in flight, of all streams.
+    std::atomic<int64_t> queued_messages {0};
+
+    void add_latency(double latency_s);
+};
+
+// The metrics of all RPCs of the backend, in the text format of Prometheus.
+class BackendMetrics
+{
+public:
+    BackendMetrics();
+    ~BackendMetrics();
+
+    // To be called while setting up the services, the metrics returned stay
+    // valid as long as this.
+    RpcMetrics &rpc(const std::string &name);
+
+    std::string prometheus_text() const;
+
+    // Non-copyable
+    BackendMetrics(const BackendMetrics &) = delete;
+    const BackendMetrics &operator=(const BackendMetrics &) = delete;
+
+private:
+    mutable std::mutex _mutex {};
+    std::vector<std::pair<std::string, std::unique_ptr<RpcMetrics>>> _rpcs {};
+};
+
+} // namespace backend
+} // namespace dronecore
@@ -5,25 +5,41 @@ if(NOT EXISTS ${PROTOC_BINARY} OR NOT EXISTS ${GRPC_CPP_PLUGIN_BINARY})
     message(FATAL_ERROR "Could not find 'protoc' or 'grpc_cpp_plugin' in the 'default' build folder. Please build for your host first (`make BUILD_DRONECORESERVER=YES default`).")
 endif()
 
+# The proto is taken from PROTO_DIR, or from the directory given as third
+# argument, which can import the protos of PROTO_DIR.
 function(compile_proto_pb COMPONENT_NAME PB_COMPILED_SOURCE)
+    if(ARGC GREATER 2)
+        set(COMPONENT_PROTO_DIR ${ARGV2})
+    else()
+        set(COMPONENT_PROTO_DIR ${PROTO_DIR})
+    endif()
+
     add_custom_command(OUTPUT ${COMPONENT_NAME}/${COMPONENT_NAME}.pb.cc
         COMMAND ${PROTOC_BINARY}
+            -I ${COMPONENT_PROTO_DIR}
             -I ${PROTO_DIR}
             --cpp_out=.
-            ${PROTO_DIR}/${COMPONENT_NAME}/${COMPONENT_NAME}.proto
+            ${COMPONENT_PROTO_DIR}/${COMPONENT_NAME}/${COMPONENT_NAME}.proto
     )
 
     set(PB_COMPILED_SOURCE ${COMPONENT_NAME}/${COMPONENT_NAME}.pb.cc PARENT_SCOPE)
 endfunction()
 
 function(compile_proto_grpc COMPONENT_NAME GRPC_COMPILED_SOURCES)
+    if(ARGC GREATER 2)
+        set(COMPONENT_PROTO_DIR ${ARGV2})
+    else()
+        set(COMPONENT_PROTO_DIR ${PROTO_DIR})
+    endif()
+
     add_custom_command(OUTPUT ${COMPONENT_NAME}/${COMPONENT_NAME}.grpc.pb.cc
         COMMAND ${PROTOC_BINARY}
+            -I ${COMPONENT_PROTO_DIR}
             -I ${PROTO_DIR}
             --grpc_out=.
             --plugin=protoc-gen-grpc=${GRPC_CPP_PLUGIN_BINARY}
             --cpp_out=.
-            ${PROTO_DIR}/${COMPONENT_NAME}/${COMPONENT_NAME}.proto
+            ${COMPONENT_PROTO_DIR}/${COMPONENT_NAME}/${COMPONENT_NAME}.proto
     )
 
     set(GRPC_COMPILED_SOURCE ${COMPONENT_NAME}/${COMPONENT_NAME}.grpc.pb.cc PARENT_SCOPE)
@@ -1,6 +1,16 @@
+#include <cstdlib>
+
 #include "backend_api.h"
 
 int main(int argc, char **argv)
 {
-    runBackend(14540, nullptr, nullptr);
+    // E.g. "unix:/tmp/dronecore.sock" to not go through TCP.
+    if (argc > 2) {
+        // E.g. "9091" to have the metrics on http://localhost:9091/metrics.
+        runBackendWithMetrics(14540, argv[1], std::atoi(argv[2]), nullptr, nullptr);
+    } else if (argc > 1) {
+        runBackendOnAddress(14540, argv[1], nullptr, nullptr);
+    } else {
+        runBackend(14540, nullptr, nullptr);
+    }
 }
@@ -8,17 +8,44 @@
 namespace dronecore {
 namespace backend {
 
+constexpr unsigned GRPCServer::NUM_THREADS;
+constexpr const char *GRPCServer::DEFAULT_LISTEN_ADDRESS;
+
+GRPCServer::~GRPCServer()
+{
+    if (_server != nullptr) {
+        _pool.shutdown(*_server);
+        _telemetry_service.shutdown();
+        _telemetry_stream_service.shutdown();
+        _passthrough_stream_service.shutdown();
+    }
+}
+
 void GRPCServer::run()
 {
     grpc::ServerBuilder builder;
     setup_port(builder);
 
     builder.RegisterService(&_core);
-    builder.RegisterService(&_action_service);
-    builder.RegisterService(&_mission_service);
-    builder.RegisterService(&_telemetry_service);
+    builder.RegisterService(_action_service.service());
+    builder.RegisterService(_mission_service.service());
+    builder.RegisterService(_mission_stream_service.service());
+    builder.RegisterService(_telemetry_service.service());
+    builder.RegisterService(_telemetry_stream_service.service());
+    builder.RegisterService(_passthrough_stream_service.service());
+    _pool.add_completion_queues(builder);
 
     _server = builder.BuildAndStart();
+
+    for (auto &completion_queue : _pool.completion_queues()) {
+        _action_service.start(completion_queue.get());
+        _mission_service.start(completion_queue.get());
+        _mission_stream_service.start(completion_queue.get());
+        _telemetry_service.start(completion_queue.get());
+        _telemetry_stream_service.start(completion_queue.get());
+        _passthrough_stream_service.start(completion_queue.get());
+    }
+    _pool.run();
     LogInfo() << "Server started";
 }
 
@@ -31,11 +58,27 @@ void GRPCServer::wait()
     }
 }
 
+std::shared_ptr<grpc::Channel> GRPCServer::in_process_channel()
+{
+    if (_server == nullptr) {
+        LogWarn() << "Calling 'in_process_channel()' on a non-existing server. "
+                  << "Did you call 'run()' before?";
+        return nullptr;
+    }
+
+    grpc::ChannelArguments channel_args;
+    return _server->InProcessChannel(channel_args);
+}
+
 void GRPCServer::setup_port(grpc::ServerBuilder &builder)
 {
-    std::string server_address("0.0.0.0:50051");
-    builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
-    LogInfo() << "Server set to listen on " << server_address;
+    if (_listen_address.empty()) {
+        LogInfo() << "Server set to only serve in-process channels";
+        return;
+    }
+
+    builder.AddListeningPort(_listen_address, grpc::InsecureServerCredentials());
+    LogInfo() << "Server set to listen on " << _listen_address;
 }
 
 } // namespace backend
@@ -2,14 +2,22 @@
 
 #include <grpc++/server.h>
 #include <memory>
+#include <string>
 
 #include "action/action.h"
-#include "action/action_service_impl.h"
+#include "action/action_async_service.h"
+#include "async_rpc_pool.h"
+#include "backend_metrics.h"
 #include "core/core_service_impl.h"
 #include "dronecore.h"
+#include "mavlink_passthrough/mavlink_passthrough.h"
+#include "mavlink_passthrough/mavlink_passthrough_stream_service.h"
 #include "mission/mission.h"
-#include "mission/mission_service_impl.h"
-#include "telemetry/telemetry_service_impl.h"
+#include "mission/mission_async_service.h"
+#include "mission/mission_stream_service.h"
+#include "system_plugins.h"
+#include "telemetry/telemetry_async_service.h"
+#include "telemetry/telemetry_stream_service.h"
 
 namespace dronecore {
 namespace backend {
@@ -17,34 +25,60 @@ namespace backend {
 class GRPCServer
 {
 public:
-    GRPCServer(DroneCore &dc)
+    // The address can be "host:port", or "unix:path" for a Unix domain socket.
+    // If it is empty, the server is only reachable by in_process_channel().
+    GRPCServer(DroneCore &dc, const std::string &listen_address = DEFAULT_LISTEN_ADDRESS)
         : _dc(dc),
+          _listen_address(listen_address),
           _core(_dc),
-          _action(_dc.system()),
-          _action_service(_action),
-          _mission(_dc.system()),
-          _mission_service(_mission),
-          _telemetry(_dc.system()),
-          _telemetry_service(_telemetry)
-    {
-        assert(_dc.system_uuids().size() >= 1);
-    }
+          _pool(NUM_THREADS),
+          _actions(_dc),
+          _action_service(_actions, _pool, _metrics),
+          _missions(_dc),
+          _mission_service(_missions, _pool, _metrics),
+          _mission_stream_service(_missions, _pool, _metrics),
+          _telemetries(_dc),
+          _telemetry_service(_telemetries, _pool, _metrics),
+          _telemetry_stream_service(_telemetries, _pool, _metrics),
+          _passthroughs(_dc),
+          _passthrough_stream_service(_passthroughs, _pool, _metrics) {}
+
+    ~GRPCServer();
 
     void run();
     void wait();
 
+    // A channel to the server which does not go through a socket, for
+    // clients in the same process. Only valid after run().
+    std::shared_ptr<grpc::Channel> in_process_channel();
+
+    const BackendMetrics &metrics() const { return _metrics; }
+
+    static constexpr auto DEFAULT_LISTEN_ADDRESS = "0.0.0.0:50051";
+
 private:
     void setup_port(grpc::ServerBuilder &builder);
 
+    // Serving all streams and calls but the ones of core.
+    static constexpr unsigned NUM_THREADS = 4;
+
     DroneCore &_dc;
+    const std::string _listen_address;
 
     CoreServiceImpl<> _core;
-    Action _action;
-    ActionServiceImpl<> _action_service;
-    Mission _mission;
-    MissionServiceImpl<> _mission_service;
-    Telemetry _telemetry;
-    TelemetryServiceImpl<> _telemetry_service;
+    BackendMetrics _metrics;
+    AsyncRpcPool _pool;
+    // Of every system, created for the first call to it.
+    SystemPlugins<Action> _actions;
+    ActionAsyncService<> _action_service;
+    SystemPlugins<Mission> _missions;
+    MissionAsyncService<> _mission_service;
+    MissionStreamService<> _mission_stream_service;
+    SystemPlugins<Telemetry> _telemetries;
+    TelemetryAsyncService<> _telemetry_service;
+    TelemetryStreamService<> _telemetry_stream_service;
+    SystemPlugins<MAVLinkPassthrough> _passthroughs;
+    MAVLinkPassthroughStreamService<> _passthrough_stream_service;
 
     std::unique_ptr<grpc::Server> _server;
 };
@@ -0,0 +1,138 @@
+#include "metrics_http_server.h"
+
+#include <arpa/inet.h>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "log.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace dronecore {
+namespace backend {
+
+constexpr int MetricsHttpServer::POLL_TIMEOUT_MS;
+constexpr int MetricsHttpServer::REQUEST_TIMEOUT_MS;
+
+MetricsHttpServer::MetricsHttpServer(const BackendMetrics &metrics) :
+    _metrics(metrics)
+{}
+
+MetricsHttpServer::~MetricsHttpServer()
+{
+    stop();
+}
+
+bool MetricsHttpServer::start(int port)
+{
+    _listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (_listen_fd < 0) {
+        LogErr() << "Metrics socket error: " << strerror(errno);
+        return false;
+    }
+
+    int reuse = 1;
+    setsockopt(_listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(uint16_t(port));
+
+    if (bind(_listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+        listen(_listen_fd, 4) != 0) {
+        LogErr() << "Metrics bind error: " << strerror(errno);
+        close(_listen_fd);
+        _listen_fd = -1;
+        return false;
+    }
+
+    _should_exit = false;
+    _thread = new std::thread(serve, this);
+    LogInfo() << "Metrics served on port " << port;
+    return true;
+}
+
+void MetricsHttpServer::stop()
+{
+    _should_exit = true;
+
+    if (_thread != nullptr) {
+        _thread->join();
+        delete _thread;
+        _thread = nullptr;
+    }
+
+    if (_listen_fd >= 0) {
+        close(_listen_fd);
+        _listen_fd = -1;
+    }
+}
+
+void MetricsHttpServer::serve(MetricsHttpServer *self)
+{
+    while (!self->_should_exit) {
+        struct pollfd listen_poll = {self->_listen_fd, POLLIN, 0};
+        if (poll(&listen_poll, 1, POLL_TIMEOUT_MS) <= 0) {
+            continue;
+        }
+
+        const int fd = accept(self->_listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        self->answer(fd);
+        close(fd);
+    }
+}
+
+void MetricsHttpServer::answer(int fd)
+{
+    // Only the request line matters, the rest of the request is not read.
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n") == std::string::npos && request.size() < sizeof(buffer)) {
+        struct pollfd client_poll = {fd, POLLIN, 0};
+        if (poll(&client_poll, 1, REQUEST_TIMEOUT_MS) <= 0) {
+            return;
+        }
+        const ssize_t recv_len = recv(fd, buffer, sizeof(buffer), 0);
+        if (recv_len <= 0) {
+            return;
+        }
+        request.append(buffer, size_t(recv_len));
+    }
+
+    std::string response;
+    if (request.compare(0, 4, "GET ") == 0) {
+        const std::string body = _metrics.prometheus_text();
+        response = "HTTP/1.0 200 OK\r\n"
+                   "Content-Type: text/plain; version=0.0.4\r\n"
+                   "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                   "\r\n" + body;
+    } else {
+        response = "HTTP/1.0 405 Method Not Allowed\r\n"
+                   "Content-Length: 0\r\n"
+                   "\r\n";
+    }
+
+    size_t sent_len = 0;
+    while (sent_len < response.size()) {
+        const ssize_t send_len = send(fd, response.data() + sent_len, response.size() - sent_len,
+                                      MSG_NOSIGNAL);
+        if (send_len <= 0) {
+            return;
+        }
+        sent_len += size_t(send_len);
+    }
+}
+
+} // namespace backend
+} // namespace dronecore
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+#include "backend_metrics.h"
+
+namespace dronecore {
+namespace backend {
+
+// Answers every GET with the metrics in the text format of Prometheus, e.g.
+// to http://host:port/metrics. One request at a time is plenty for scraping.
+class MetricsHttpServer
+{
+public:
+    explicit MetricsHttpServer(const BackendMetrics &metrics);
+    ~MetricsHttpServer();
+
+    bool start(int port);
+    void stop();
+
+    // Non-copyable
+    MetricsHttpServer(const MetricsHttpServer &) = delete;
+    const MetricsHttpServer &operator=(const MetricsHttpServer &) = delete;
+
+private:
+    static void serve(MetricsHttpServer *self);
+    void answer(int fd);
+
+    // How long stop() may take, and how long a client may take to send its request.
+    static constexpr int POLL_TIMEOUT_MS = 100;
+    static constexpr int REQUEST_TIMEOUT_MS = 1000;
+
+    const BackendMetrics &_metrics;
+    int _listen_fd = -1;
+    std::thread *_thread = nullptr;
+    std::atomic_bool _should_exit {false};
+};
+
+} // namespace backend
+} // namespace dronecore
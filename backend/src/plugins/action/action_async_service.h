@@ -0,0 +1,110 @@
+#pragma once
+
+#include "async_calls.h"
+#include "async_rpc_pool.h"
+#include "backend_metrics.h"
+#include "action/action.h"
+#include "action/action.grpc.pb.h"
+#include "system_plugins.h"
+
+namespace dronecore {
+namespace backend {
+
+// Same RPCs as ActionServiceImpl, but served by the threads of an
+// AsyncRpcPool, for all systems. A call is answered from the callback of the
+// action, no thread waits for the vehicle meanwhile.
+template <typename Action = Action>
+class ActionAsyncService final
+{
+public:
+    ActionAsyncService(SystemPlugins<Action> &actions, AsyncRpcPool &pool,
+                       BackendMetrics &metrics)
+        : _actions(actions),
+          _pool(pool),
+          _arm_metrics(metrics.rpc("action.Arm")),
+          _takeoff_metrics(metrics.rpc("action.Takeoff")),
+          _land_metrics(metrics.rpc("action.Land")) {}
+
+    grpc::Service *service() { return &_service; }
+
+    void start(grpc::ServerCompletionQueue *completion_queue)
+    {
+        startCall<rpc::action::ArmRequest, rpc::action::ArmResponse>(
+        _arm_metrics, [this](grpc::ServerContext * context, rpc::action::ArmRequest * request,
+               grpc::ServerAsyncResponseWriter<rpc::action::ArmResponse> *responder,
+        grpc::ServerCompletionQueue * cq, void *tag) {
+            _service.RequestArm(context, request, responder, cq, cq, tag);
+        }, [](Action & action, typename Action::result_callback_t callback) {
+            action.arm_async(callback);
+        }, completion_queue);
+
+        startCall<rpc::action::TakeoffRequest, rpc::action::TakeoffResponse>(
+        _takeoff_metrics, [this](grpc::ServerContext * context,
+                                 rpc::action::TakeoffRequest * request,
+               grpc::ServerAsyncResponseWriter<rpc::action::TakeoffResponse> *responder,
+        grpc::ServerCompletionQueue * cq, void *tag) {
+            _service.RequestTakeoff(context, request, responder, cq, cq, tag);
+        }, [](Action & action, typename Action::result_callback_t callback) {
+            action.takeoff_async(callback);
+        }, completion_queue);
+
+        startCall<rpc::action::LandRequest, rpc::action::LandResponse>(
+        _land_metrics, [this](grpc::ServerContext * context, rpc::action::LandRequest * request,
+               grpc::ServerAsyncResponseWriter<rpc::action::LandResponse> *responder,
+        grpc::ServerCompletionQueue * cq, void *tag) {
+            _service.RequestLand(context, request, responder, cq, cq, tag);
+        }, [](Action & action, typename Action::result_callback_t callback) {
+            action.land_async(callback);
+        }, completion_queue);
+    }
+
+private:
+    // All action calls are alike: run the action on the system the call is
+    // for and reply with its result.
+    template <typename Request, typename Response>
+    void startCall(RpcMetrics &metrics,
+                   typename AsyncUnaryCall<Request, Response>::request_function_t request_function,
+                   std::function<void(Action &, typename Action::result_callback_t)> run_action,
+                   grpc::ServerCompletionQueue *completion_queue)
+    {
+        AsyncUnaryCall<Request, Response>::start(
+            _pool, metrics, request_function, [this, run_action](
+                const grpc::ServerContext & context,
+                const Request & /* request */,
+        typename AsyncUnaryCall<Request, Response>::reply_function_t reply) {
+            uint64_t uuid = 0;
+            const auto status = _actions.resolve(context, uuid);
+            if (!status.ok()) {
+                reply(status, Response());
+                return;
+            }
+
+            run_action(*_actions.get(uuid), [reply](ActionResult action_result) {
+                Response response;
+                response.set_allocated_action_result(generateRPCActionResult(action_result));
+                reply(grpc::Status::OK, response);
+            });
+        }, completion_queue);
+    }
+
+    static rpc::action::ActionResult *generateRPCActionResult(const ActionResult action_result)
+    {
+        auto rpc_result = static_cast<dronecore::rpc::action::ActionResult::Result>(action_result);
+
+        auto *rpc_action_result = new dronecore::rpc::action::ActionResult();
+        rpc_action_result->set_result(rpc_result);
+        rpc_action_result->set_result_str(dronecore::action_result_str(action_result));
+
+        return rpc_action_result;
+    }
+
+    SystemPlugins<Action> &_actions;
+    AsyncRpcPool &_pool;
+    RpcMetrics &_arm_metrics;
+    RpcMetrics &_takeoff_metrics;
+    RpcMetrics &_land_metrics;
+    dronecore::rpc::action::ActionService::AsyncService _service {};
+};
+
+} // namespace backend
+} // namespace dronecore
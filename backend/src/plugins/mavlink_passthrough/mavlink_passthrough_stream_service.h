@@ -0,0 +1,303 @@
+#pragma once
+
+#include <bitset>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "async_calls.h"
+#include "async_rpc_pool.h"
+#include "backend_metrics.h"
+#include "mavlink_passthrough/mavlink_passthrough.h"
+#include "mavlink_passthrough/mavlink_passthrough.grpc.pb.h"
+#include "system_plugins.h"
+
+namespace dronecore {
+namespace backend {
+
+// Serves SubscribeMAVLinkFrames. Every stream subscribes to the frames it
+// asked for on its own, and the frames are appended to a buffer as they are
+// received, on the receive thread. Whenever no write is in flight, the buffer
+// is written as one batch, so batches grow with the rate of the frames and
+// with how slow the client is. Once MAX_PENDING_BYTES are waiting, further
+// frames are dropped and counted in the next batch.
+template <typename MAVLinkPassthrough = MAVLinkPassthrough>
+class MAVLinkPassthroughStreamService final
+{
+public:
+    MAVLinkPassthroughStreamService(SystemPlugins<MAVLinkPassthrough> &passthroughs,
+                                    AsyncRpcPool &pool, BackendMetrics &metrics)
+        : _passthroughs(passthroughs),
+          _pool(pool),
+          _metrics(metrics.rpc("mavlink_passthrough.SubscribeMAVLinkFrames")) {}
+
+    ~MAVLinkPassthroughStreamService()
+    {
+        shutdown();
+    }
+
+    grpc::Service *service() { return &_service; }
+
+    // Waits for a client on the completion queue, and for the next one after it.
+    void start(grpc::ServerCompletionQueue *completion_queue)
+    {
+        auto stream = new Stream(*this, completion_queue);
+        if (stream->is_orphan()) {
+            delete stream;
+        }
+    }
+
+    // To be called once the pool is shut down, deletes the streams which
+    // were left.
+    void shutdown()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto stream : _streams) {
+            delete stream;
+        }
+        _streams.clear();
+    }
+
+    // Non-copyable
+    MAVLinkPassthroughStreamService(const MAVLinkPassthroughStreamService &) = delete;
+    const MAVLinkPassthroughStreamService &operator=(const MAVLinkPassthroughStreamService &) =
+        delete;
+
+private:
+    static constexpr size_t MAX_PENDING_BYTES = 64 * 1024;
+
+    class Stream final : public AsyncCall
+    {
+    public:
+        Stream(MAVLinkPassthroughStreamService &service,
+               grpc::ServerCompletionQueue *completion_queue)
+            : _service(service),
+              _completion_queue(completion_queue),
+              _writer(&_context)
+        {
+            if (!_service._pool.start_operation([this]() {
+            _service._service.RequestSubscribeMAVLinkFrames(&_context, &_request, &_writer,
+                                                            _completion_queue,
+                                                            _completion_queue,
+                                                            &_requested_tag);
+            })) {
+                // Nobody is going to proceed with it.
+                _is_orphan = true;
+            }
+        }
+
+        ~Stream()
+        {
+            unsubscribe();
+            if (_is_active) {
+                _service._metrics.active_streams.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+
+        bool is_orphan() const { return _is_orphan; }
+
+        void proceed(int event, bool ok) override
+        {
+            switch (event) {
+                case REQUESTED:
+                    if (!ok) {
+                        // The server is shutting down.
+                        delete this;
+                        return;
+                    }
+                    _service.start(_completion_queue);
+                    _service._metrics.calls.fetch_add(1, std::memory_order_relaxed);
+                    {
+                        const auto status = subscribe();
+                        if (!status.ok()) {
+                            finish(status);
+                            return;
+                        }
+                    }
+                    _is_active = true;
+                    _service._metrics.active_streams.fetch_add(1, std::memory_order_relaxed);
+                    _service.add(this);
+                    return;
+                case WRITTEN:
+                    written(ok);
+                    return;
+                case FINISHED:
+                    delete this;
+                    return;
+            }
+        }
+
+    private:
+        enum Event {
+            REQUESTED,
+            WRITTEN,
+            FINISHED
+        };
+
+        grpc::Status subscribe()
+        {
+            uint64_t uuid = 0;
+            const auto status = _service._passthroughs.resolve(_context, uuid);
+            if (!status.ok()) {
+                return status;
+            }
+            if (_request.message_ids_size() == 0) {
+                return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "No message ids");
+            }
+
+            if (_request.component_ids_size() == 0) {
+                _components.set();
+            }
+            for (auto component_id : _request.component_ids()) {
+                if (component_id < _components.size()) {
+                    _components.set(component_id);
+                }
+            }
+
+            const std::vector<uint32_t> message_ids(_request.message_ids().begin(),
+                                                    _request.message_ids().end());
+            _passthrough = _service._passthroughs.get(uuid);
+            _subscription = _passthrough->subscribe_frames(
+            message_ids, [this](const typename MAVLinkPassthrough::FrameView & frame) {
+                add_frame(frame);
+            });
+            return grpc::Status::OK;
+        }
+
+        // Once this returns, add_frame() is not called anymore. Not to be
+        // called with the stream locked, as that might be waited for.
+        void unsubscribe()
+        {
+            if (_passthrough != nullptr) {
+                _passthrough->unsubscribe(_subscription);
+                _passthrough = nullptr;
+            }
+        }
+
+        // Called on the receive thread.
+        void add_frame(const typename MAVLinkPassthrough::FrameView &frame)
+        {
+            if (!_components.test(frame.component_id)) {
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_is_finishing) {
+                return;
+            }
+            if (_pending.size() + frame.frame_len > MAX_PENDING_BYTES) {
+                ++_num_dropped;
+                _service._metrics.messages_dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            _pending.append(reinterpret_cast<const char *>(frame.frame), frame.frame_len);
+            ++_num_pending;
+
+            if (!_is_writing) {
+                write_pending();
+            }
+        }
+
+        // We assume that we already acquired _mutex in this function.
+        void write_pending()
+        {
+            // Swapping keeps both buffers allocated, to be reused.
+            _batch.mutable_frames()->swap(_pending);
+            _pending.clear();
+            _batch.set_num_frames(_num_pending);
+            _batch.set_num_dropped(_num_dropped);
+            _num_pending = 0;
+            _num_dropped = 0;
+
+            _is_writing = _service._pool.start_operation([this]() {
+                _writer.Write(_batch, &_written_tag);
+            });
+            if (_is_writing) {
+                _service._metrics.messages_written.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        void written(bool ok)
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _is_writing = false;
+
+                if (ok) {
+                    if (!_pending.empty()) {
+                        write_pending();
+                    }
+                    return;
+                }
+                // The client is gone.
+                _is_finishing = true;
+            }
+
+            unsubscribe();
+            _service.remove(this);
+            finish(grpc::Status::CANCELLED);
+        }
+
+        void finish(const grpc::Status &status)
+        {
+            if (!_service._pool.start_operation([this, &status]() {
+            _writer.Finish(status, &_finished_tag);
+            })) {
+                delete this;
+            }
+        }
+
+        MAVLinkPassthroughStreamService &_service;
+        grpc::ServerCompletionQueue *_completion_queue;
+        grpc::ServerContext _context {};
+        rpc::mavlink_passthrough::SubscribeMAVLinkFramesRequest _request {};
+        grpc::ServerAsyncWriter<rpc::mavlink_passthrough::MAVLinkFrameBatch> _writer;
+        bool _is_orphan = false;
+        // Counted as an active stream.
+        bool _is_active = false;
+
+        MAVLinkPassthrough *_passthrough = nullptr;
+        typename MAVLinkPassthrough::subscription_handle_t _subscription = 0;
+        // Written before subscribing, only read afterwards.
+        std::bitset<256> _components {};
+
+        Tag _requested_tag {this, REQUESTED};
+        Tag _written_tag {this, WRITTEN};
+        Tag _finished_tag {this, FINISHED};
+
+        std::mutex _mutex {};
+        bool _is_writing = false;
+        bool _is_finishing = false;
+        std::string _pending {};
+        uint32_t _num_pending = 0;
+        uint64_t _num_dropped = 0;
+        rpc::mavlink_passthrough::MAVLinkFrameBatch _batch {};
+    };
+
+    void add(Stream *stream)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _streams.insert(stream);
+    }
+
+    void remove(Stream *stream)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _streams.erase(stream);
+    }
+
+    SystemPlugins<MAVLinkPassthrough> &_passthroughs;
+    AsyncRpcPool &_pool;
+    RpcMetrics &_metrics;
+    rpc::mavlink_passthrough::MAVLinkPassthroughService::AsyncService _service {};
+
+    std::mutex _mutex {};
+    std::set<Stream *> _streams {};
+};
+
+template <typename MAVLinkPassthrough>
+constexpr size_t MAVLinkPassthroughStreamService<MAVLinkPassthrough>::MAX_PENDING_BYTES;
+
+} // namespace backend
+} // namespace dronecore
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "async_calls.h"
+#include "async_rpc_pool.h"
+#include "backend_metrics.h"
+#include "mission/mission.h"
+#include "mission/mission.grpc.pb.h"
+#include "mission/mission_item.h"
+#include "system_plugins.h"
+
+namespace dronecore {
+namespace backend {
+
+// Same RPCs as MissionServiceImpl, but served by the threads of an
+// AsyncRpcPool, for all systems. A call is answered from the callback of the
+// mission, no thread waits for the vehicle meanwhile.
+template <typename Mission = Mission>
+class MissionAsyncService final
+{
+public:
+    typedef std::function<void(const grpc::Status &, const rpc::mission::UploadMissionResponse &)>
+    upload_mission_reply_t;
+    typedef std::function<void(const grpc::Status &, const rpc::mission::StartMissionResponse &)>
+    start_mission_reply_t;
+
+    MissionAsyncService(SystemPlugins<Mission> &missions, AsyncRpcPool &pool,
+                        BackendMetrics &metrics)
+        : _missions(missions),
+          _pool(pool),
+          _upload_mission_metrics(metrics.rpc("mission.UploadMission")),
+          _start_mission_metrics(metrics.rpc("mission.StartMission")) {}
+
+    grpc::Service *service() { return &_service; }
+
+    void start(grpc::ServerCompletionQueue *completion_queue)
+    {
+        AsyncUnaryCall<rpc::mission::UploadMissionRequest,
+                       rpc::mission::UploadMissionResponse>::start(
+        _pool, _upload_mission_metrics, [this](grpc::ServerContext * context,
+                                               rpc::mission::UploadMissionRequest * request,
+        grpc::ServerAsyncResponseWriter<rpc::mission::UploadMissionResponse> *responder,
+        grpc::ServerCompletionQueue * cq, void *tag) {
+            _service.RequestUploadMission(context, request, responder, cq, cq, tag);
+        }, [this](const grpc::ServerContext & context,
+                  const rpc::mission::UploadMissionRequest & request,
+        upload_mission_reply_t reply) {
+            uploadMission(context, request, reply);
+        }, completion_queue);
+
+        AsyncUnaryCall<rpc::mission::StartMissionRequest,
+                       rpc::mission::StartMissionResponse>::start(
+        _pool, _start_mission_metrics, [this](grpc::ServerContext * context,
+                                              rpc::mission::StartMissionRequest * request,
+        grpc::ServerAsyncResponseWriter<rpc::mission::StartMissionResponse> *responder,
+        grpc::ServerCompletionQueue * cq, void *tag) {
+            _service.RequestStartMission(context, request, responder, cq, cq, tag);
+        }, [this](const grpc::ServerContext & context,
+                  const rpc::mission::StartMissionRequest & /* request */,
+        start_mission_reply_t reply) {
+            startMission(context, reply);
+        }, completion_queue);
+    }
+
+private:
+    void uploadMission(const grpc::ServerContext &context,
+                       const rpc::mission::UploadMissionRequest &request,
+                       upload_mission_reply_t reply)
+    {
+        grpc::Status status;
+        auto mission = getMission(context, status);
+        if (mission == nullptr) {
+            reply(status, rpc::mission::UploadMissionResponse());
+            return;
+        }
+
+        std::vector<std::shared_ptr<MissionItem>> mission_items;
+        for (auto rpc_mission_item : request.mission().mission_item()) {
+            mission_items.push_back(translateRPCMissionItem(rpc_mission_item));
+        }
+
+        mission->upload_mission_async(mission_items, [this,
+              reply](const dronecore::Mission::Result result) {
+            rpc::mission::UploadMissionResponse response;
+            response.set_allocated_mission_result(generateRPCMissionResult(result));
+            reply(grpc::Status::OK, response);
+        });
+    }
+
+    void startMission(const grpc::ServerContext &context, start_mission_reply_t reply)
+    {
+        grpc::Status status;
+        auto mission = getMission(context, status);
+        if (mission == nullptr) {
+            reply(status, rpc::mission::StartMissionResponse());
+            return;
+        }
+
+        mission->start_mission_async([this, reply](const dronecore::Mission::Result result) {
+            rpc::mission::StartMissionResponse response;
+            response.set_allocated_mission_result(generateRPCMissionResult(result));
+            reply(grpc::Status::OK, response);
+        });
+    }
+
+    // Returns nullptr with the status to fail the call with if there is no
+    // such system.
+    Mission *getMission(const grpc::ServerContext &context, grpc::Status &status)
+    {
+        uint64_t uuid = 0;
+        status = _missions.resolve(context, uuid);
+        if (!status.ok()) {
+            return nullptr;
+        }
+        return _missions.get(uuid);
+    }
+
+    std::shared_ptr<MissionItem>
+    translateRPCMissionItem(const rpc::mission::MissionItem &rpc_mission_item) const
+    {
+        auto mission_item = std::make_shared<MissionItem>();
+        mission_item->set_position(rpc_mission_item.latitude_deg(),
+                                   rpc_mission_item.longitude_deg());
+        mission_item->set_relative_altitude(rpc_mission_item.relative_altitude_m());
+        mission_item->set_speed(rpc_mission_item.speed_m_s());
+        mission_item->set_fly_through(rpc_mission_item.is_fly_through());
+        mission_item->set_gimbal_pitch_and_yaw(rpc_mission_item.gimbal_pitch_deg(),
+                                               rpc_mission_item.gimbal_yaw_deg());
+        mission_item->set_camera_action(static_cast<MissionItem::CameraAction>
+                                        (rpc_mission_item.camera_action()));
+
+        return mission_item;
+    }
+
+    rpc::mission::MissionResult *
+    generateRPCMissionResult(const dronecore::Mission::Result result) const
+    {
+        auto rpc_result = static_cast<rpc::mission::MissionResult::Result>(result);
+
+        auto rpc_mission_result = new rpc::mission::MissionResult();
+        rpc_mission_result->set_result(rpc_result);
+        rpc_mission_result->set_result_str(dronecore::Mission::result_str(result));
+
+        return rpc_mission_result;
+    }
+
+    SystemPlugins<Mission> &_missions;
+    AsyncRpcPool &_pool;
+    RpcMetrics &_upload_mission_metrics;
+    RpcMetrics &_start_mission_metrics;
+    dronecore::rpc::mission::MissionService::AsyncService _service {};
+};
+
+} // namespace backend
+} // namespace dronecore
@@ -0,0 +1,396 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "async_calls.h"
+#include "async_rpc_pool.h"
+#include "backend_metrics.h"
+#include "mission/mission.h"
+#include "mission/mission_item.h"
+#include "mission_stream/mission_stream.grpc.pb.h"
+#include "system_plugins.h"
+
+namespace dronecore {
+namespace backend {
+
+// Serves missions in chunks of items. An upload converts every chunk into
+// compact mission item data as it is read, so neither the whole request nor
+// a MissionItem per item is kept, and the data is handed over to the mission
+// without another copy. The count has to go to the vehicle first, therefore
+// the upload to it starts once the client is done writing.
+//
+// A download sends the items one chunk after the other, each once the one
+// before is written, so only one chunk is converted at a time.
+template <typename Mission = Mission>
+class MissionStreamService final
+{
+public:
+    MissionStreamService(SystemPlugins<Mission> &missions, AsyncRpcPool &pool,
+                         BackendMetrics &metrics)
+        : _missions(missions),
+          _pool(pool),
+          _upload_metrics(metrics.rpc("mission_stream.UploadMissionStream")),
+          _download_metrics(metrics.rpc("mission_stream.DownloadMissionStream")) {}
+
+    grpc::Service *service() { return &_service; }
+
+    // Waits for clients on the completion queue, and for the next ones after them.
+    void start(grpc::ServerCompletionQueue *completion_queue)
+    {
+        startUpload(completion_queue);
+        startDownload(completion_queue);
+    }
+
+    // Non-copyable
+    MissionStreamService(const MissionStreamService &) = delete;
+    const MissionStreamService &operator=(const MissionStreamService &) = delete;
+
+    static constexpr unsigned DEFAULT_ITEMS_PER_CHUNK = 100;
+
+private:
+    class Upload final : public AsyncCall
+    {
+    public:
+        Upload(MissionStreamService &service, grpc::ServerCompletionQueue *completion_queue)
+            : _service(service),
+              _completion_queue(completion_queue),
+              _reader(&_context)
+        {
+            if (!_service._pool.start_operation([this]() {
+            _service._service.RequestUploadMissionStream(&_context, &_reader,
+                                                         _completion_queue, _completion_queue,
+                                                         &_requested_tag);
+            })) {
+                // Nobody is going to proceed with it.
+                _is_orphan = true;
+            }
+        }
+
+        bool is_orphan() const { return _is_orphan; }
+
+        void proceed(int event, bool ok) override
+        {
+            switch (event) {
+                case REQUESTED:
+                    if (!ok) {
+                        // The server is shutting down.
+                        delete this;
+                        return;
+                    }
+                    _service.startUpload(_completion_queue);
+                    _service._upload_metrics.calls.fetch_add(1, std::memory_order_relaxed);
+                    _requested_time = std::chrono::steady_clock::now();
+                    {
+                        grpc::Status status;
+                        _mission = _service.getMission(_context, status);
+                        if (_mission == nullptr) {
+                            finish(status, rpc::mission::UploadMissionResponse());
+                            return;
+                        }
+                    }
+                    read();
+                    return;
+                case READ:
+                    if (ok) {
+                        for (const auto &rpc_mission_item : _chunk.mission_items()) {
+                            _mission_data.push_back(translateRPCMissionItem(rpc_mission_item));
+                        }
+                        read();
+                    } else {
+                        // The client is done writing.
+                        upload();
+                    }
+                    return;
+                case FINISHED:
+                    delete this;
+                    return;
+            }
+        }
+
+    private:
+        enum Event {
+            REQUESTED,
+            READ,
+            FINISHED
+        };
+
+        void read()
+        {
+            if (!_service._pool.start_operation([this]() {
+            _reader.Read(&_chunk, &_read_tag);
+            })) {
+                delete this;
+            }
+        }
+
+        void upload()
+        {
+            _mission->upload_mission_async(std::move(_mission_data),
+            [this](const dronecore::Mission::Result result) {
+                rpc::mission::UploadMissionResponse response;
+                response.set_allocated_mission_result(generateRPCMissionResult(result));
+                finish(grpc::Status::OK, response);
+            });
+        }
+
+        void finish(const grpc::Status &status, const rpc::mission::UploadMissionResponse &response)
+        {
+            const std::chrono::duration<double> latency =
+                std::chrono::steady_clock::now() - _requested_time;
+            _service._upload_metrics.add_latency(latency.count());
+
+            if (!_service._pool.start_operation([this, &status, &response]() {
+            if (status.ok()) {
+                    _reader.Finish(response, status, &_finished_tag);
+                } else {
+                    _reader.FinishWithError(status, &_finished_tag);
+                }
+            })) {
+                delete this;
+            }
+        }
+
+        MissionStreamService &_service;
+        grpc::ServerCompletionQueue *_completion_queue;
+        grpc::ServerContext _context {};
+        grpc::ServerAsyncReader<rpc::mission::UploadMissionResponse,
+             rpc::mission_stream::MissionChunk> _reader;
+        bool _is_orphan = false;
+        std::chrono::steady_clock::time_point _requested_time {};
+
+        Mission *_mission = nullptr;
+        // Read into again and again, which keeps the items allocated.
+        rpc::mission_stream::MissionChunk _chunk {};
+        dronecore::Mission::mission_data_t _mission_data {};
+
+        Tag _requested_tag {this, REQUESTED};
+        Tag _read_tag {this, READ};
+        Tag _finished_tag {this, FINISHED};
+    };
+
+    class Download final : public AsyncCall
+    {
+    public:
+        Download(MissionStreamService &service, grpc::ServerCompletionQueue *completion_queue)
+            : _service(service),
+              _completion_queue(completion_queue),
+              _writer(&_context)
+        {
+            if (!_service._pool.start_operation([this]() {
+            _service._service.RequestDownloadMissionStream(&_context, &_request, &_writer,
+                                                           _completion_queue, _completion_queue,
+                                                           &_requested_tag);
+            })) {
+                // Nobody is going to proceed with it.
+                _is_orphan = true;
+            }
+        }
+
+        ~Download()
+        {
+            if (_is_active) {
+                _service._download_metrics.active_streams.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+
+        bool is_orphan() const { return _is_orphan; }
+
+        void proceed(int event, bool ok) override
+        {
+            switch (event) {
+                case REQUESTED:
+                    if (!ok) {
+                        // The server is shutting down.
+                        delete this;
+                        return;
+                    }
+                    _service.startDownload(_completion_queue);
+                    _service._download_metrics.calls.fetch_add(1, std::memory_order_relaxed);
+                    _is_active = true;
+                    _service._download_metrics.active_streams.fetch_add(1,
+                                                                        std::memory_order_relaxed);
+                    download();
+                    return;
+                case WRITTEN:
+                    if (!ok) {
+                        // The client is gone.
+                        finish(grpc::Status::CANCELLED);
+                    } else if (_chunk.has_mission_result()) {
+                        finish(grpc::Status::OK);
+                    } else {
+                        writeNext();
+                    }
+                    return;
+                case FINISHED:
+                    delete this;
+                    return;
+            }
+        }
+
+    private:
+        enum Event {
+            REQUESTED,
+            WRITTEN,
+            FINISHED
+        };
+
+        void download()
+        {
+            grpc::Status status;
+            auto mission = _service.getMission(_context, status);
+            if (mission == nullptr) {
+                finish(status);
+                return;
+            }
+
+            _items_per_chunk = (_request.max_items_per_chunk() > 0) ?
+                               _request.max_items_per_chunk() : DEFAULT_ITEMS_PER_CHUNK;
+
+            mission->download_mission_async(
+                [this](const dronecore::Mission::Result result,
+            std::vector<std::shared_ptr<MissionItem>> mission_items) {
+                _result = result;
+                _mission_items = std::move(mission_items);
+                writeNext();
+            });
+        }
+
+        // Only called when no write is in flight.
+        void writeNext()
+        {
+            // Clearing keeps the items allocated, to be reused.
+            _chunk.mutable_mission_items()->Clear();
+            _chunk.set_total_items(unsigned(_mission_items.size()));
+
+            const size_t end = std::min(_mission_items.size(), _next_item + _items_per_chunk);
+            for (; _next_item < end; ++_next_item) {
+                translateMissionItem(*_mission_items[_next_item], *_chunk.add_mission_items());
+            }
+            if (_next_item == _mission_items.size()) {
+                _chunk.set_allocated_mission_result(generateRPCMissionResult(_result));
+            }
+
+            if (_service._pool.start_operation([this]() {
+            _writer.Write(_chunk, &_written_tag);
+            })) {
+                _service._download_metrics.messages_written.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                delete this;
+            }
+        }
+
+        void finish(const grpc::Status &status)
+        {
+            if (!_service._pool.start_operation([this, &status]() {
+            _writer.Finish(status, &_finished_tag);
+            })) {
+                delete this;
+            }
+        }
+
+        MissionStreamService &_service;
+        grpc::ServerCompletionQueue *_completion_queue;
+        grpc::ServerContext _context {};
+        rpc::mission_stream::DownloadMissionStreamRequest _request {};
+        grpc::ServerAsyncWriter<rpc::mission_stream::DownloadMissionChunk> _writer;
+        bool _is_orphan = false;
+        // Counted as an active stream.
+        bool _is_active = false;
+
+        size_t _items_per_chunk = DEFAULT_ITEMS_PER_CHUNK;
+        dronecore::Mission::Result _result = dronecore::Mission::Result::UNKNOWN;
+        std::vector<std::shared_ptr<MissionItem>> _mission_items {};
+        size_t _next_item = 0;
+        rpc::mission_stream::DownloadMissionChunk _chunk {};
+
+        Tag _requested_tag {this, REQUESTED};
+        Tag _written_tag {this, WRITTEN};
+        Tag _finished_tag {this, FINISHED};
+    };
+
+    void startUpload(grpc::ServerCompletionQueue *completion_queue)
+    {
+        auto upload = new Upload(*this, completion_queue);
+        if (upload->is_orphan()) {
+            delete upload;
+        }
+    }
+
+    void startDownload(grpc::ServerCompletionQueue *completion_queue)
+    {
+        auto download = new Download(*this, completion_queue);
+        if (download->is_orphan()) {
+            delete download;
+        }
+    }
+
+    // Returns nullptr with the status to fail the call with if there is no
+    // such system.
+    Mission *getMission(const grpc::ServerContext &context, grpc::Status &status)
+    {
+        uint64_t uuid = 0;
+        status = _missions.resolve(context, uuid);
+        if (!status.ok()) {
+            return nullptr;
+        }
+        return _missions.get(uuid);
+    }
+
+    static MissionItemData
+    translateRPCMissionItem(const rpc::mission::MissionItem &rpc_mission_item)
+    {
+        MissionItemData data {};
+        data.latitude_deg = rpc_mission_item.latitude_deg();
+        data.longitude_deg = rpc_mission_item.longitude_deg();
+        data.relative_altitude_m = rpc_mission_item.relative_altitude_m();
+        data.speed_m_s = rpc_mission_item.speed_m_s();
+        data.fly_through = rpc_mission_item.is_fly_through();
+        data.gimbal_pitch_deg = rpc_mission_item.gimbal_pitch_deg();
+        data.gimbal_yaw_deg = rpc_mission_item.gimbal_yaw_deg();
+        data.camera_action =
+            static_cast<MissionItem::CameraAction>(rpc_mission_item.camera_action());
+        return data;
+    }
+
+    static void translateMissionItem(const MissionItem &mission_item,
+                                     rpc::mission::MissionItem &rpc_mission_item)
+    {
+        rpc_mission_item.set_latitude_deg(mission_item.get_latitude_deg());
+        rpc_mission_item.set_longitude_deg(mission_item.get_longitude_deg());
+        rpc_mission_item.set_relative_altitude_m(mission_item.get_relative_altitude_m());
+        rpc_mission_item.set_speed_m_s(mission_item.get_speed_m_s());
+        rpc_mission_item.set_is_fly_through(mission_item.get_fly_through());
+        rpc_mission_item.set_gimbal_pitch_deg(mission_item.get_gimbal_pitch_deg());
+        rpc_mission_item.set_gimbal_yaw_deg(mission_item.get_gimbal_yaw_deg());
+        rpc_mission_item.set_camera_action(static_cast<rpc::mission::MissionItem::CameraAction>
+                                           (mission_item.get_camera_action()));
+    }
+
+    static rpc::mission::MissionResult *
+    generateRPCMissionResult(const dronecore::Mission::Result result)
+    {
+        auto rpc_result = static_cast<rpc::mission::MissionResult::Result>(result);
+
+        auto rpc_mission_result = new rpc::mission::MissionResult();
+        rpc_mission_result->set_result(rpc_result);
+        rpc_mission_result->set_result_str(dronecore::Mission::result_str(result));
+
+        return rpc_mission_result;
+    }
+
+    SystemPlugins<Mission> &_missions;
+    AsyncRpcPool &_pool;
+    RpcMetrics &_upload_metrics;
+    RpcMetrics &_download_metrics;
+    rpc::mission_stream::MissionStreamService::AsyncService _service {};
+};
+
+template <typename Mission>
+constexpr unsigned MissionStreamService<Mission>::DEFAULT_ITEMS_PER_CHUNK;
+
+} // namespace backend
+} // namespace dronecore
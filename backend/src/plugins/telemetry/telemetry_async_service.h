@@ -0,0 +1,254 @@
+#pragma once
+
+#include "async_calls.h"
+#include "async_rpc_pool.h"
+#include "backend_metrics.h"
+#include "system_plugins.h"
+#include "telemetry/telemetry.h"
+#include "telemetry/telemetry.grpc.pb.h"
+#include "telemetry/telemetry_translation.h"
+
+namespace dronecore {
+namespace backend {
+
+// Same RPCs as TelemetryServiceImpl, but served by the threads of an
+// AsyncRpcPool, for all systems. Every topic of a system is subscribed to
+// once, all streams of it are fed from that subscription, see
+// AsyncStreamTopic.
+//
+// Every subscription fills in the same response for every sample, and the
+// topic serializes it once for all streams, so that no messages are
+// allocated while streaming, and more clients cost no more serializing.
+template <typename Telemetry = Telemetry>
+class TelemetryAsyncService final
+{
+public:
+    TelemetryAsyncService(SystemPlugins<Telemetry> &telemetries, AsyncRpcPool &pool,
+                          BackendMetrics &metrics)
+        : _telemetries(telemetries),
+          _position(pool, metrics.rpc("telemetry.SubscribePosition"),
+                    [this](grpc::ServerContext * context,
+                                 grpc::ByteBuffer * request,
+                                 grpc::ServerAsyncWriter<grpc::ByteBuffer> *writer,
+                                 grpc::ServerCompletionQueue * completion_queue, void *tag) {
+        _service.RequestSubscribePosition(context, request, writer, completion_queue,
+                                          completion_queue, tag);
+    }, resolveFunction(), [this](uint64_t uuid) { subscribePosition(uuid); }),
+    _health(pool, metrics.rpc("telemetry.SubscribeHealth"), [this](grpc::ServerContext * context,
+                         grpc::ByteBuffer * request,
+                         grpc::ServerAsyncWriter<grpc::ByteBuffer> *writer,
+                         grpc::ServerCompletionQueue * completion_queue, void *tag) {
+        _service.RequestSubscribeHealth(context, request, writer, completion_queue,
+                                        completion_queue, tag);
+    }, resolveFunction(), [this](uint64_t uuid) { subscribeHealth(uuid); }),
+    _home(pool, metrics.rpc("telemetry.SubscribeHome"), [this](grpc::ServerContext * context,
+                       grpc::ByteBuffer * request,
+                       grpc::ServerAsyncWriter<grpc::ByteBuffer> *writer,
+                       grpc::ServerCompletionQueue * completion_queue, void *tag) {
+        _service.RequestSubscribeHome(context, request, writer, completion_queue,
+                                      completion_queue, tag);
+    }, resolveFunction(), [this](uint64_t uuid) { subscribeHome(uuid); }),
+    _in_air(pool, metrics.rpc("telemetry.SubscribeInAir"), [this](grpc::ServerContext * context,
+                         grpc::ByteBuffer * request,
+                         grpc::ServerAsyncWriter<grpc::ByteBuffer> *writer,
+                         grpc::ServerCompletionQueue * completion_queue, void *tag) {
+        _service.RequestSubscribeInAir(context, request, writer, completion_queue,
+                                       completion_queue, tag);
+    }, resolveFunction(), [this](uint64_t uuid) { subscribeInAir(uuid); }, MAX_QUEUED_EVENTS),
+    _armed(pool, metrics.rpc("telemetry.SubscribeArmed"), [this](grpc::ServerContext * context,
+                        grpc::ByteBuffer * request,
+                        grpc::ServerAsyncWriter<grpc::ByteBuffer> *writer,
+                        grpc::ServerCompletionQueue * completion_queue, void *tag) {
+        _service.RequestSubscribeArmed(context, request, writer, completion_queue,
+                                       completion_queue, tag);
+    }, resolveFunction(), [this](uint64_t uuid) { subscribeArmed(uuid); }, MAX_QUEUED_EVENTS),
+    _gps_info(pool, metrics.rpc("telemetry.SubscribeGPSInfo"), [this](grpc::ServerContext * context,
+                           grpc::ByteBuffer * request,
+                           grpc::ServerAsyncWriter<grpc::ByteBuffer> *writer,
+                           grpc::ServerCompletionQueue * completion_queue, void *tag) {
+        _service.RequestSubscribeGPSInfo(context, request, writer, completion_queue,
+                                         completion_queue, tag);
+    }, resolveFunction(), [this](uint64_t uuid) { subscribeGPSInfo(uuid); }),
+    _battery(pool, metrics.rpc("telemetry.SubscribeBattery"), [this](grpc::ServerContext * context,
+                          grpc::ByteBuffer * request,
+                          grpc::ServerAsyncWriter<grpc::ByteBuffer> *writer,
+                          grpc::ServerCompletionQueue * completion_queue, void *tag) {
+        _service.RequestSubscribeBattery(context, request, writer, completion_queue,
+                                         completion_queue, tag);
+    }, resolveFunction(), [this](uint64_t uuid) { subscribeBattery(uuid); }) {}
+
+    grpc::Service *service() { return &_service; }
+
+    void start(grpc::ServerCompletionQueue *completion_queue)
+    {
+        _position.start(completion_queue);
+        _health.start(completion_queue);
+        _home.start(completion_queue);
+        _in_air.start(completion_queue);
+        _armed.start(completion_queue);
+        _gps_info.start(completion_queue);
+        _battery.start(completion_queue);
+    }
+
+    // To be called once the pool is shut down.
+    void shutdown()
+    {
+        _position.shutdown();
+        _health.shutdown();
+        _home.shutdown();
+        _in_air.shutdown();
+        _armed.shutdown();
+        _gps_info.shutdown();
+        _battery.shutdown();
+    }
+
+private:
+    // In air and armed are states as well, but a client should not miss it
+    // when they flip back and forth. A slow client of the others only gets
+    // the latest value.
+    static constexpr unsigned MAX_QUEUED_EVENTS = 16;
+
+    std::function<grpc::Status(const grpc::ServerContext &, uint64_t &)> resolveFunction()
+    {
+        return [this](const grpc::ServerContext & context, uint64_t &uuid) {
+            return _telemetries.resolve(context, uuid);
+        };
+    }
+
+    void subscribePosition(uint64_t uuid)
+    {
+        auto telemetry = _telemetries.get(uuid);
+        if (telemetry == nullptr) {
+            return;
+        }
+
+        dronecore::rpc::telemetry::PositionResponse rpc_position_response;
+        telemetry->position_async([this, uuid,
+              rpc_position_response](dronecore::Telemetry::Position position) mutable {
+            translatePosition(position, rpc_position_response.mutable_position());
+            _position.publish(uuid, rpc_position_response);
+        });
+    }
+
+    void subscribeHealth(uint64_t uuid)
+    {
+        auto telemetry = _telemetries.get(uuid);
+        if (telemetry == nullptr) {
+            return;
+        }
+
+        dronecore::rpc::telemetry::HealthResponse rpc_health_response;
+        telemetry->health_async([this, uuid,
+              rpc_health_response](dronecore::Telemetry::Health health) mutable {
+            translateHealth(health, rpc_health_response.mutable_health());
+            _health.publish(uuid, rpc_health_response);
+        });
+    }
+
+    void subscribeHome(uint64_t uuid)
+    {
+        auto telemetry = _telemetries.get(uuid);
+        if (telemetry == nullptr) {
+            return;
+        }
+
+        dronecore::rpc::telemetry::HomeResponse rpc_home_response;
+        telemetry->home_position_async([this, uuid,
+              rpc_home_response](dronecore::Telemetry::Position position) mutable {
+            translatePosition(position, rpc_home_response.mutable_home());
+            _home.publish(uuid, rpc_home_response);
+        });
+    }
+
+    void subscribeInAir(uint64_t uuid)
+    {
+        auto telemetry = _telemetries.get(uuid);
+        if (telemetry == nullptr) {
+            return;
+        }
+
+        telemetry->in_air_async([this, uuid](bool is_in_air) {
+            dronecore::rpc::telemetry::InAirResponse rpc_in_air_response;
+            rpc_in_air_response.set_is_in_air(is_in_air);
+            _in_air.publish(uuid, rpc_in_air_response);
+        });
+    }
+
+    void subscribeArmed(uint64_t uuid)
+    {
+        auto telemetry = _telemetries.get(uuid);
+        if (telemetry == nullptr) {
+            return;
+        }
+
+        telemetry->armed_async([this, uuid](bool is_armed) {
+            dronecore::rpc::telemetry::ArmedResponse rpc_armed_response;
+            rpc_armed_response.set_is_armed(is_armed);
+            _armed.publish(uuid, rpc_armed_response);
+        });
+    }
+
+    void subscribeGPSInfo(uint64_t uuid)
+    {
+        auto telemetry = _telemetries.get(uuid);
+        if (telemetry == nullptr) {
+            return;
+        }
+
+        dronecore::rpc::telemetry::GPSInfoResponse rpc_gps_info_response;
+        telemetry->gps_info_async([this, uuid,
+              rpc_gps_info_response](dronecore::Telemetry::GPSInfo gps_info) mutable {
+            translateGPSInfo(gps_info, rpc_gps_info_response.mutable_gps_info());
+            _gps_info.publish(uuid, rpc_gps_info_response);
+        });
+    }
+
+    void subscribeBattery(uint64_t uuid)
+    {
+        auto telemetry = _telemetries.get(uuid);
+        if (telemetry == nullptr) {
+            return;
+        }
+
+        dronecore::rpc::telemetry::BatteryResponse rpc_battery_response;
+        telemetry->battery_async([this, uuid,
+              rpc_battery_response](dronecore::Telemetry::Battery battery) mutable {
+            translateBattery(battery, rpc_battery_response.mutable_battery());
+            _battery.publish(uuid, rpc_battery_response);
+        });
+    }
+
+    // Raw methods, so that the topics write the responses they serialized once.
+    typedef rpc::telemetry::TelemetryService TelemetryService;
+    typedef TelemetryService::WithRawMethod_SubscribePosition<
+        TelemetryService::WithRawMethod_SubscribeHealth<
+        TelemetryService::WithRawMethod_SubscribeHome<
+        TelemetryService::WithRawMethod_SubscribeInAir<
+        TelemetryService::WithRawMethod_SubscribeArmed<
+        TelemetryService::WithRawMethod_SubscribeGPSInfo<
+        TelemetryService::WithRawMethod_SubscribeBattery<
+        TelemetryService::AsyncService>>>>>>> RawService;
+
+    SystemPlugins<Telemetry> &_telemetries;
+    RawService _service {};
+
+    AsyncStreamTopic<rpc::telemetry::SubscribePositionRequest, rpc::telemetry::PositionResponse>
+    _position;
+    AsyncStreamTopic<rpc::telemetry::SubscribeHealthRequest, rpc::telemetry::HealthResponse>
+    _health;
+    AsyncStreamTopic<rpc::telemetry::SubscribeHomeRequest, rpc::telemetry::HomeResponse> _home;
+    AsyncStreamTopic<rpc::telemetry::SubscribeInAirRequest, rpc::telemetry::InAirResponse>
+    _in_air;
+    AsyncStreamTopic<rpc::telemetry::SubscribeArmedRequest, rpc::telemetry::ArmedResponse>
+    _armed;
+    AsyncStreamTopic<rpc::telemetry::SubscribeGPSInfoRequest, rpc::telemetry::GPSInfoResponse>
+    _gps_info;
+    AsyncStreamTopic<rpc::telemetry::SubscribeBatteryRequest, rpc::telemetry::BatteryResponse>
+    _battery;
+};
+
+template <typename Telemetry>
+constexpr unsigned TelemetryAsyncService<Telemetry>::MAX_QUEUED_EVENTS;
+
+} // namespace backend
+} // namespace dronecore
@@ -6,6 +6,8 @@
 namespace dronecore {
 namespace backend {
 
+// Every stream fills in the same response for every sample, so that no
+// messages are allocated while streaming.
 template <typename Telemetry = Telemetry>
 class TelemetryServiceImpl final : public dronecore::rpc::telemetry::TelemetryService::Service
 {
@@ -19,15 +21,14 @@ public:
                                    const dronecore::rpc::telemetry::SubscribePositionRequest * /* request */,
                                    grpc::ServerWriter<rpc::telemetry::PositionResponse> *writer) override
     {
-        _telemetry.position_async([&writer](dronecore::Telemetry::Position position) {
-            auto rpc_position = new dronecore::rpc::telemetry::Position();
+        dronecore::rpc::telemetry::PositionResponse rpc_position_response;
+        _telemetry.position_async([&writer,
+              &rpc_position_response](dronecore::Telemetry::Position position) {
+            auto rpc_position = rpc_position_response.mutable_position();
             rpc_position->set_latitude_deg(position.latitude_deg);
             rpc_position->set_longitude_deg(position.longitude_deg);
             rpc_position->set_relative_altitude_m(position.relative_altitude_m);
             rpc_position->set_absolute_altitude_m(position.absolute_altitude_m);
-
-            dronecore::rpc::telemetry::PositionResponse rpc_position_response;
-            rpc_position_response.set_allocated_position(rpc_position);
             writer->Write(rpc_position_response);
         });
 
@@ -39,8 +40,10 @@ public:
                                  const dronecore::rpc::telemetry::SubscribeHealthRequest * /* request */,
                                  grpc::ServerWriter<rpc::telemetry::HealthResponse> *writer) override
     {
-        _telemetry.health_async([&writer](dronecore::Telemetry::Health health) {
-            auto rpc_health = new dronecore::rpc::telemetry::Health();
+        dronecore::rpc::telemetry::HealthResponse rpc_health_response;
+        _telemetry.health_async([&writer,
+              &rpc_health_response](dronecore::Telemetry::Health health) {
+            auto rpc_health = rpc_health_response.mutable_health();
             rpc_health->set_is_gyrometer_calibration_ok(health.gyrometer_calibration_ok);
             rpc_health->set_is_accelerometer_calibration_ok(health.accelerometer_calibration_ok);
             rpc_health->set_is_magnetometer_calibration_ok(health.magnetometer_calibration_ok);
@@ -48,9 +51,6 @@ public:
             rpc_health->set_is_local_position_ok(health.local_position_ok);
             rpc_health->set_is_global_position_ok(health.global_position_ok);
             rpc_health->set_is_home_position_ok(health.home_position_ok);
-
-            dronecore::rpc::telemetry::HealthResponse rpc_health_response;
-            rpc_health_response.set_allocated_health(rpc_health);
             writer->Write(rpc_health_response);
         });
 
@@ -62,15 +62,14 @@ public:
                                const dronecore::rpc::telemetry::SubscribeHomeRequest * /* request */,
                                grpc::ServerWriter<rpc::telemetry::HomeResponse> *writer) override
     {
-        _telemetry.home_position_async([&writer](dronecore::Telemetry::Position position) {
-            auto rpc_position = new dronecore::rpc::telemetry::Position();
+        dronecore::rpc::telemetry::HomeResponse rpc_home_response;
+        _telemetry.home_position_async([&writer,
+              &rpc_home_response](dronecore::Telemetry::Position position) {
+            auto rpc_position = rpc_home_response.mutable_home();
             rpc_position->set_latitude_deg(position.latitude_deg);
             rpc_position->set_longitude_deg(position.longitude_deg);
             rpc_position->set_relative_altitude_m(position.relative_altitude_m);
             rpc_position->set_absolute_altitude_m(position.absolute_altitude_m);
-
-            dronecore::rpc::telemetry::HomeResponse rpc_home_response;
-            rpc_home_response.set_allocated_home(rpc_position);
             writer->Write(rpc_home_response);
         });
 
@@ -110,13 +109,12 @@ public:
                                   const dronecore::rpc::telemetry::SubscribeGPSInfoRequest * /* request */,
                                   grpc::ServerWriter<rpc::telemetry::GPSInfoResponse> *writer) override
     {
-        _telemetry.gps_info_async([this, &writer](dronecore::Telemetry::GPSInfo gps_info) {
-            auto rpc_gps_info = new dronecore::rpc::telemetry::GPSInfo();
+        dronecore::rpc::telemetry::GPSInfoResponse rpc_gps_info_response;
+        _telemetry.gps_info_async([this, &writer,
+              &rpc_gps_info_response](dronecore::Telemetry::GPSInfo gps_info) {
+            auto rpc_gps_info = rpc_gps_info_response.mutable_gps_info();
             rpc_gps_info->set_num_satellites(gps_info.num_satellites);
             rpc_gps_info->set_fix_type(translateGPSFixType(gps_info.fix_type));
-
-            dronecore::rpc::telemetry::GPSInfoResponse rpc_gps_info_response;
-            rpc_gps_info_response.set_allocated_gps_info(rpc_gps_info);
             writer->Write(rpc_gps_info_response);
         });
 
@@ -149,13 +147,12 @@ public:
                                   const dronecore::rpc::telemetry::SubscribeBatteryRequest * /* request */,
                                   grpc::ServerWriter<rpc::telemetry::BatteryResponse> *writer) override
     {
-        _telemetry.battery_async([this, &writer](dronecore::Telemetry::Battery battery) {
-            auto rpc_battery = new dronecore::rpc::telemetry::Battery();
+        dronecore::rpc::telemetry::BatteryResponse rpc_battery_response;
+        _telemetry.battery_async([this, &writer,
+              &rpc_battery_response](dronecore::Telemetry::Battery battery) {
+            auto rpc_battery = rpc_battery_response.mutable_battery();
             rpc_battery->set_voltage_v(battery.voltage_v);
             rpc_battery->set_remaining_percent(battery.remaining_percent);
-
-            dronecore::rpc::telemetry::BatteryResponse rpc_battery_response;
-            rpc_battery_response.set_allocated_battery(rpc_battery);
             writer->Write(rpc_battery_response);
         });
 
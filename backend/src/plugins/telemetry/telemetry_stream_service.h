@@ -0,0 +1,382 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "async_calls.h"
+#include "async_rpc_pool.h"
+#include "backend_metrics.h"
+#include "system_plugins.h"
+#include "telemetry/telemetry.h"
+#include "telemetry/telemetry_translation.h"
+#include "telemetry_stream/telemetry_stream.grpc.pb.h"
+
+namespace dronecore {
+namespace backend {
+
+// Serves SubscribeTelemetry, which has every topic a client asks for on a
+// single stream. The topics of a system are subscribed to once, for all
+// clients, and only the latest value of each is kept. Every TICK_MS, each
+// stream which is done writing gets one batch with the topics which changed
+// since it got them last, as far as the rates it asked for allow. A slow
+// client therefore only gets fewer batches.
+template <typename Telemetry = Telemetry>
+class TelemetryStreamService final
+{
+public:
+    TelemetryStreamService(SystemPlugins<Telemetry> &telemetries, AsyncRpcPool &pool,
+                           BackendMetrics &metrics)
+        : _telemetries(telemetries),
+          _pool(pool),
+          _metrics(metrics.rpc("telemetry_stream.SubscribeTelemetry"))
+    {
+        _tick_thread = std::thread(&TelemetryStreamService::tickLoop, this);
+    }
+
+    ~TelemetryStreamService()
+    {
+        shutdown();
+    }
+
+    grpc::Service *service() { return &_service; }
+
+    // Waits for a client on the completion queue, and for the next one after it.
+    void start(grpc::ServerCompletionQueue *completion_queue)
+    {
+        auto stream = new Stream(*this, completion_queue);
+        if (stream->is_orphan()) {
+            delete stream;
+        }
+    }
+
+    // To be called once the pool is shut down, deletes the streams which
+    // were left.
+    void shutdown()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _should_exit = true;
+        }
+        _tick_cv.notify_all();
+        if (_tick_thread.joinable()) {
+            _tick_thread.join();
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto stream : _streams) {
+            delete stream;
+        }
+        _streams.clear();
+    }
+
+    // Non-copyable
+    TelemetryStreamService(const TelemetryStreamService &) = delete;
+    const TelemetryStreamService &operator=(const TelemetryStreamService &) = delete;
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    static constexpr int TICK_MS = 50;
+    static constexpr unsigned NUM_TOPICS = 7;
+
+    struct SystemState {
+        bool is_subscribed = false;
+        rpc::telemetry_stream::TelemetryUpdate latest[NUM_TOPICS] {};
+        // Counts the updates of every topic, to tell which changed.
+        uint64_t sequence[NUM_TOPICS] {};
+    };
+
+    class Stream final : public AsyncCall
+    {
+    public:
+        Stream(TelemetryStreamService &service, grpc::ServerCompletionQueue *completion_queue)
+            : _service(service),
+              _completion_queue(completion_queue),
+              _writer(&_context)
+        {
+            if (!_service._pool.start_operation([this]() {
+            _service._service.RequestSubscribeTelemetry(&_context, &_request, &_writer,
+                                                        _completion_queue, _completion_queue,
+                                                        &_requested_tag);
+            })) {
+                // Nobody is going to proceed with it.
+                _is_orphan = true;
+            }
+        }
+
+        ~Stream()
+        {
+            if (_is_active) {
+                _service._metrics.active_streams.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+
+        bool is_orphan() const { return _is_orphan; }
+        uint64_t uuid() const { return _uuid; }
+
+        void proceed(int event, bool ok) override
+        {
+            switch (event) {
+                case REQUESTED:
+                    if (!ok) {
+                        // The server is shutting down.
+                        delete this;
+                        return;
+                    }
+                    _service.start(_completion_queue);
+                    _service._metrics.calls.fetch_add(1, std::memory_order_relaxed);
+                    {
+                        const auto status = _service._telemetries.resolve(_context, _uuid);
+                        if (!status.ok()) {
+                            finish(status);
+                            return;
+                        }
+                    }
+                    addTopics();
+                    _is_active = true;
+                    _service._metrics.active_streams.fetch_add(1, std::memory_order_relaxed);
+                    _service.add(this);
+                    return;
+                case WRITTEN:
+                    written(ok);
+                    return;
+                case FINISHED:
+                    delete this;
+                    return;
+            }
+        }
+
+        // Called with the service locked.
+        void tick(clock::time_point now, const SystemState &state)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            if (_is_writing || _is_finishing) {
+                return;
+            }
+
+            // Clearing keeps the updates allocated, to be reused.
+            _batch.mutable_updates()->Clear();
+            for (auto &topic : _topics) {
+                if (state.sequence[topic.topic] == topic.sent_sequence || now < topic.next_time) {
+                    continue;
+                }
+                *_batch.add_updates() = state.latest[topic.topic];
+                topic.sent_sequence = state.sequence[topic.topic];
+                topic.next_time = now + topic.min_interval;
+            }
+
+            if (_batch.updates_size() > 0) {
+                _is_writing = _service._pool.start_operation([this]() {
+                    _writer.Write(_batch, &_written_tag);
+                });
+                if (_is_writing) {
+                    _service._metrics.messages_written.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        }
+
+    private:
+        enum Event {
+            REQUESTED,
+            WRITTEN,
+            FINISHED
+        };
+
+        struct TopicState {
+            unsigned topic;
+            clock::duration min_interval;
+            uint64_t sent_sequence;
+            clock::time_point next_time;
+        };
+
+        void addTopics()
+        {
+            bool is_added[NUM_TOPICS] {};
+
+            for (const auto &subscription : _request.topic_subscriptions()) {
+                const auto topic = subscription.topic();
+                if (!rpc::telemetry_stream::Topic_IsValid(topic) ||
+                    unsigned(topic) >= NUM_TOPICS || is_added[topic]) {
+                    continue;
+                }
+                is_added[topic] = true;
+
+                const double max_rate_hz = subscription.max_rate_hz();
+                clock::duration min_interval = clock::duration::zero();
+                if (max_rate_hz > 0.0) {
+                    min_interval = std::chrono::duration_cast<clock::duration>(
+                                       std::chrono::duration<double>(1.0 / max_rate_hz));
+                }
+                _topics.push_back(TopicState {
+                    unsigned(topic), min_interval, 0, clock::time_point()
+                });
+            }
+        }
+
+        void written(bool ok)
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _is_writing = false;
+
+                if (ok) {
+                    return;
+                }
+                // The client is gone.
+                _is_finishing = true;
+            }
+
+            // Without the stream locked, as the tick locks the service first.
+            _service.remove(this);
+            finish(grpc::Status::CANCELLED);
+        }
+
+        void finish(const grpc::Status &status)
+        {
+            if (!_service._pool.start_operation([this, &status]() {
+            _writer.Finish(status, &_finished_tag);
+            })) {
+                delete this;
+            }
+        }
+
+        TelemetryStreamService &_service;
+        grpc::ServerCompletionQueue *_completion_queue;
+        grpc::ServerContext _context {};
+        rpc::telemetry_stream::SubscribeTelemetryRequest _request {};
+        grpc::ServerAsyncWriter<rpc::telemetry_stream::TelemetryBatch> _writer;
+        bool _is_orphan = false;
+        // Counted as an active stream.
+        bool _is_active = false;
+        uint64_t _uuid = 0;
+        std::vector<TopicState> _topics {};
+
+        Tag _requested_tag {this, REQUESTED};
+        Tag _written_tag {this, WRITTEN};
+        Tag _finished_tag {this, FINISHED};
+
+        std::mutex _mutex {};
+        bool _is_writing = false;
+        bool _is_finishing = false;
+        rpc::telemetry_stream::TelemetryBatch _batch {};
+    };
+
+    void add(Stream *stream)
+    {
+        bool should_subscribe = false;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _streams.insert(stream);
+            auto &state = _systems[stream->uuid()];
+            should_subscribe = !state.is_subscribed;
+            state.is_subscribed = true;
+        }
+
+        // Not with the service locked, in case the first update comes right away.
+        if (should_subscribe) {
+            subscribe(stream->uuid());
+        }
+    }
+
+    void remove(Stream *stream)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _streams.erase(stream);
+    }
+
+    void subscribe(uint64_t uuid)
+    {
+        auto telemetry = _telemetries.get(uuid);
+        if (telemetry == nullptr) {
+            return;
+        }
+
+        telemetry->position_async([this, uuid](dronecore::Telemetry::Position position) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            translatePosition(position,
+                              update(uuid, rpc::telemetry_stream::POSITION).mutable_position());
+        });
+        telemetry->health_async([this, uuid](dronecore::Telemetry::Health health) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            translateHealth(health, update(uuid, rpc::telemetry_stream::HEALTH).mutable_health());
+        });
+        telemetry->home_position_async([this, uuid](dronecore::Telemetry::Position position) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            translatePosition(position, update(uuid, rpc::telemetry_stream::HOME).mutable_home());
+        });
+        telemetry->in_air_async([this, uuid](bool is_in_air) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            update(uuid, rpc::telemetry_stream::IN_AIR).set_is_in_air(is_in_air);
+        });
+        telemetry->armed_async([this, uuid](bool is_armed) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            update(uuid, rpc::telemetry_stream::ARMED).set_is_armed(is_armed);
+        });
+        telemetry->gps_info_async([this, uuid](dronecore::Telemetry::GPSInfo gps_info) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            translateGPSInfo(gps_info,
+                             update(uuid, rpc::telemetry_stream::GPS_INFO).mutable_gps_info());
+        });
+        telemetry->battery_async([this, uuid](dronecore::Telemetry::Battery battery) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            translateBattery(battery,
+                             update(uuid, rpc::telemetry_stream::BATTERY).mutable_battery());
+        });
+    }
+
+    // Returns the latest update of the topic, to be filled in again.
+    // We assume that we already acquired the mutex in this function.
+    rpc::telemetry_stream::TelemetryUpdate &update(uint64_t uuid, unsigned topic)
+    {
+        auto &state = _systems[uuid];
+        ++state.sequence[topic];
+        return state.latest[topic];
+    }
+
+    void tickLoop()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        auto next_tick = clock::now();
+
+        while (!_should_exit) {
+            next_tick += std::chrono::milliseconds(TICK_MS);
+            _tick_cv.wait_until(lock, next_tick, [this]() { return _should_exit; });
+            if (_should_exit) {
+                break;
+            }
+
+            const auto now = clock::now();
+            for (auto stream : _streams) {
+                stream->tick(now, _systems[stream->uuid()]);
+            }
+        }
+    }
+
+    SystemPlugins<Telemetry> &_telemetries;
+    AsyncRpcPool &_pool;
+    RpcMetrics &_metrics;
+    rpc::telemetry_stream::TelemetryStreamService::AsyncService _service {};
+
+    std::mutex _mutex {};
+    std::set<Stream *> _streams {};
+    std::map<uint64_t, SystemState> _systems {};
+
+    bool _should_exit = false;
+    std::condition_variable _tick_cv {};
+    std::thread _tick_thread {};
+};
+
+template <typename Telemetry>
+constexpr int TelemetryStreamService<Telemetry>::TICK_MS;
+
+template <typename Telemetry>
+constexpr unsigned TelemetryStreamService<Telemetry>::NUM_TOPICS;
+
+} // namespace backend
+} // namespace dronecore
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "telemetry/telemetry.h"
+#include "telemetry/telemetry.pb.h"
+
+namespace dronecore {
+namespace backend {
+
+// Fill in messages which the caller keeps, so that they can be reused.
+
+inline void translatePosition(const dronecore::Telemetry::Position &position,
+                              dronecore::rpc::telemetry::Position *rpc_position)
+{
+    rpc_position->set_latitude_deg(position.latitude_deg);
+    rpc_position->set_longitude_deg(position.longitude_deg);
+    rpc_position->set_relative_altitude_m(position.relative_altitude_m);
+    rpc_position->set_absolute_altitude_m(position.absolute_altitude_m);
+}
+
+inline void translateHealth(const dronecore::Telemetry::Health &health,
+                            dronecore::rpc::telemetry::Health *rpc_health)
+{
+    rpc_health->set_is_gyrometer_calibration_ok(health.gyrometer_calibration_ok);
+    rpc_health->set_is_accelerometer_calibration_ok(health.accelerometer_calibration_ok);
+    rpc_health->set_is_magnetometer_calibration_ok(health.magnetometer_calibration_ok);
+    rpc_health->set_is_level_calibration_ok(health.level_calibration_ok);
+    rpc_health->set_is_local_position_ok(health.local_position_ok);
+    rpc_health->set_is_global_position_ok(health.global_position_ok);
+    rpc_health->set_is_home_position_ok(health.home_position_ok);
+}
+
+inline dronecore::rpc::telemetry::FixType translateGPSFixType(const int fix_type)
+{
+    switch (fix_type) {
+        default:
+        case 0:
+            return dronecore::rpc::telemetry::FixType::NO_GPS;
+        case 1:
+            return dronecore::rpc::telemetry::FixType::NO_FIX;
+        case 2:
+            return dronecore::rpc::telemetry::FixType::FIX_2D;
+        case 3:
+            return dronecore::rpc::telemetry::FixType::FIX_3D;
+        case 4:
+            return dronecore::rpc::telemetry::FixType::FIX_DGPS;
+        case 5:
+            return dronecore::rpc::telemetry::FixType::RTK_FLOAT;
+        case 6:
+            return dronecore::rpc::telemetry::FixType::RTK_FIXED;
+    }
+}
+
+inline void translateGPSInfo(const dronecore::Telemetry::GPSInfo &gps_info,
+                             dronecore::rpc::telemetry::GPSInfo *rpc_gps_info)
+{
+    rpc_gps_info->set_num_satellites(gps_info.num_satellites);
+    rpc_gps_info->set_fix_type(translateGPSFixType(gps_info.fix_type));
+}
+
+inline void translateBattery(const dronecore::Telemetry::Battery &battery,
+                             dronecore::rpc::telemetry::Battery *rpc_battery)
+{
+    rpc_battery->set_voltage_v(battery.voltage_v);
+    rpc_battery->set_remaining_percent(battery.remaining_percent);
+}
+
+} // namespace backend
+} // namespace dronecore
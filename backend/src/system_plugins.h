@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdlib>
+#include <functional>
+#include <grpc++/server_context.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "dronecore.h"
+
+namespace dronecore {
+namespace backend {
+
+// One plugin per system, created when the first call for the system comes.
+// Clients say which system a call is for with the "system-uuid" metadata,
+// as a decimal. Calls without it are for the first system discovered, so
+// that clients of a single vehicle do not need to care. Until a system is
+// discovered, calls fail as UNAVAILABLE, so that clients can retry.
+template <typename Plugin>
+class SystemPlugins
+{
+public:
+    typedef std::function<std::unique_ptr<Plugin>(uint64_t uuid)> create_function_t;
+    typedef std::function<bool(uint64_t &uuid)> default_uuid_function_t;
+
+    static constexpr auto UUID_METADATA_KEY = "system-uuid";
+
+    // Creates the plugins on the systems of dc.
+    explicit SystemPlugins(DroneCore &dc)
+        : _create_function([&dc](uint64_t uuid) {
+        std::unique_ptr<Plugin> plugin {};
+        if (has_uuid(dc, uuid)) {
+            plugin.reset(new Plugin(dc.system(uuid)));
+        }
+        return plugin;
+    }),
+    _default_uuid_function([&dc](uint64_t &uuid) {
+        const auto uuids = dc.system_uuids();
+        if (uuids.empty()) {
+            return false;
+        }
+        uuid = uuids.front();
+        return true;
+    }) {}
+
+    // The create function returns nullptr if there is no such system.
+    SystemPlugins(create_function_t create_function, default_uuid_function_t default_uuid_function)
+        : _create_function(create_function),
+          _default_uuid_function(default_uuid_function) {}
+
+    // Returns the system the call is for, or the status to fail the call with.
+    grpc::Status resolve(const grpc::ServerContext &context, uint64_t &uuid)
+    {
+        const auto metadata = context.client_metadata().find(UUID_METADATA_KEY);
+        if (metadata == context.client_metadata().end()) {
+            if (!_default_uuid_function(uuid)) {
+                return grpc::Status(grpc::StatusCode::UNAVAILABLE, "No system discovered yet");
+            }
+        } else {
+            const std::string value(metadata->second.data(), metadata->second.size());
+            char *end = nullptr;
+            uuid = std::strtoull(value.c_str(), &end, 10);
+            if (value.empty() || *end != '\0') {
+                return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Invalid system UUID");
+            }
+        }
+
+        if (get(uuid) == nullptr) {
+            return grpc::Status(grpc::StatusCode::NOT_FOUND, "No such system");
+        }
+        return grpc::Status::OK;
+    }
+
+    // Returns nullptr if there is no such system.
+    Plugin *get(uint64_t uuid)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto it = _plugins.find(uuid);
+        if (it != _plugins.end()) {
+            return it->second.get();
+        }
+
+        auto plugin = _create_function(uuid);
+        if (plugin == nullptr) {
+            return nullptr;
+        }
+        auto raw_plugin = plugin.get();
+        _plugins[uuid] = std::move(plugin);
+        return raw_plugin;
+    }
+
+    // Non-copyable
+    SystemPlugins(const SystemPlugins &) = delete;
+    const SystemPlugins &operator=(const SystemPlugins &) = delete;
+
+private:
+    static bool has_uuid(DroneCore &dc, uint64_t uuid)
+    {
+        for (auto system_uuid : dc.system_uuids()) {
+            if (system_uuid == uuid) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const create_function_t _create_function;
+    const default_uuid_function_t _default_uuid_function;
+
+    std::mutex _mutex {};
+    std::map<uint64_t, std::unique_ptr<Plugin>> _plugins {};
+};
+
+template <typename Plugin>
+constexpr const char *SystemPlugins<Plugin>::UUID_METADATA_KEY;
+
+} // namespace backend
+} // namespace dronecore
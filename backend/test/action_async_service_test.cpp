@@ -0,0 +1,129 @@
+#include <chrono>
+#include <future>
+#include <gmock/gmock.h>
+#include <grpc++/grpc++.h>
+#include <grpc++/server.h>
+#include <grpc++/server_builder.h>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "action/action_async_service.h"
+#include "action/mocks/action_mock.h"
+#include "async_rpc_pool.h"
+#include "backend_metrics.h"
+#include "system_plugins.h"
+
+namespace {
+
+using testing::_;
+using testing::NiceMock;
+
+using MockAction = NiceMock<dronecore::testing::MockAction>;
+using ActionAsyncService = dronecore::backend::ActionAsyncService<MockAction>;
+using ActionService = dronecore::rpc::action::ActionService;
+using AsyncRpcPool = dronecore::backend::AsyncRpcPool;
+using SystemActions = dronecore::backend::SystemPlugins<MockAction>;
+
+using ArmResponse = dronecore::rpc::action::ArmResponse;
+using result_callback_t = MockAction::result_callback_t;
+
+class ActionAsyncServiceTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        _action = new MockAction();
+        _actions = std::unique_ptr<SystemActions>(new SystemActions(
+        [this](uint64_t uuid) {
+            std::unique_ptr<MockAction> action {};
+            if (uuid == ARBITRARY_UUID) {
+                action.reset(_action);
+            }
+            return action;
+        }, [](uint64_t &uuid) {
+            uuid = ARBITRARY_UUID;
+            return true;
+        }));
+        _pool = std::unique_ptr<AsyncRpcPool>(new AsyncRpcPool(NUM_THREADS));
+        _action_service = std::unique_ptr<ActionAsyncService>(new ActionAsyncService(
+                                                                  *_actions, *_pool, _metrics));
+
+        grpc::ServerBuilder builder;
+        builder.RegisterService(_action_service->service());
+        _pool->add_completion_queues(builder);
+        _server = builder.BuildAndStart();
+
+        for (auto &completion_queue : _pool->completion_queues()) {
+            _action_service->start(completion_queue.get());
+        }
+        _pool->run();
+
+        grpc::ChannelArguments channel_args;
+        auto channel = _server->InProcessChannel(channel_args);
+        _stub = ActionService::NewStub(channel);
+    }
+
+    virtual void TearDown()
+    {
+        _pool->shutdown(*_server);
+    }
+
+    static constexpr uint64_t ARBITRARY_UUID = 1122334455667788;
+    static constexpr unsigned NUM_THREADS = 2;
+
+    // Owned by _actions once it was asked for.
+    MockAction *_action = nullptr;
+    std::unique_ptr<SystemActions> _actions {};
+    dronecore::backend::BackendMetrics _metrics {};
+    std::unique_ptr<AsyncRpcPool> _pool {};
+    std::unique_ptr<ActionAsyncService> _action_service {};
+    std::unique_ptr<grpc::Server> _server {};
+    std::unique_ptr<ActionService::Stub> _stub {};
+};
+
+TEST_F(ActionAsyncServiceTest, holdsNoThreadWhileWaitingForAcks)
+{
+    // More outstanding commands than threads of the pool.
+    const unsigned num_arms = 4 * NUM_THREADS;
+
+    std::mutex callbacks_mutex;
+    std::vector<result_callback_t> callbacks;
+    std::promise<void> all_called_promise;
+    auto all_called_future = all_called_promise.get_future();
+    EXPECT_CALL(*_action, arm_async(_))
+    .Times(num_arms)
+    .WillRepeatedly(testing::Invoke([&](result_callback_t callback) {
+        std::lock_guard<std::mutex> lock(callbacks_mutex);
+        callbacks.push_back(callback);
+        if (callbacks.size() == num_arms) {
+            all_called_promise.set_value();
+        }
+    }));
+
+    std::vector<std::future<std::pair<grpc::Status, ArmResponse>>> responses;
+    for (unsigned i = 0; i < num_arms; ++i) {
+        responses.push_back(std::async(std::launch::async, [this]() {
+            grpc::ClientContext context;
+            dronecore::rpc::action::ArmRequest request;
+            ArmResponse response;
+            const auto status = _stub->Arm(&context, request, &response);
+            return std::make_pair(status, response);
+        }));
+    }
+
+    ASSERT_EQ(std::future_status::ready, all_called_future.wait_for(std::chrono::seconds(5)));
+    for (auto &callback : callbacks) {
+        callback(dronecore::ActionResult::SUCCESS);
+    }
+
+    for (auto &response : responses) {
+        const auto status_and_response = response.get();
+        EXPECT_TRUE(status_and_response.first.ok());
+        EXPECT_EQ(dronecore::rpc::action::ActionResult::SUCCESS,
+                  status_and_response.second.action_result().result());
+    }
+}
+
+} // namespace
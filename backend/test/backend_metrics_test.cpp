@@ -0,0 +1,58 @@
+#include <gmock/gmock.h>
+#include <string>
+
+#include "backend_metrics.h"
+
+namespace {
+
+using testing::HasSubstr;
+
+using dronecore::backend::BackendMetrics;
+
+TEST(BackendMetrics, returnsSameMetricsForSameRpc)
+{
+    BackendMetrics metrics;
+
+    auto &first = metrics.rpc("action.Arm");
+    auto &second = metrics.rpc("action.Arm");
+    auto &other = metrics.rpc("action.Land");
+
+    EXPECT_EQ(&first, &second);
+    EXPECT_NE(&first, &other);
+}
+
+TEST(BackendMetrics, countsCallsPerRpc)
+{
+    BackendMetrics metrics;
+    metrics.rpc("action.Arm").calls += 2;
+    metrics.rpc("action.Land").calls += 1;
+
+    const auto text = metrics.prometheus_text();
+
+    EXPECT_THAT(text, HasSubstr("dronecore_backend_rpc_calls_total{rpc=\"action.Arm\"} 2\n"));
+    EXPECT_THAT(text, HasSubstr("dronecore_backend_rpc_calls_total{rpc=\"action.Land\"} 1\n"));
+}
+
+TEST(BackendMetrics, accumulatesLatencyBuckets)
+{
+    BackendMetrics metrics;
+    auto &rpc = metrics.rpc("mission.UploadMission");
+    rpc.add_latency(0.0005);
+    rpc.add_latency(0.002);
+    rpc.add_latency(60.0);
+
+    const auto text = metrics.prometheus_text();
+
+    EXPECT_THAT(text, HasSubstr("dronecore_backend_rpc_latency_seconds_bucket{"
+                                "rpc=\"mission.UploadMission\",le=\"0.001\"} 1\n"));
+    EXPECT_THAT(text, HasSubstr("dronecore_backend_rpc_latency_seconds_bucket{"
+                                "rpc=\"mission.UploadMission\",le=\"0.0025\"} 2\n"));
+    EXPECT_THAT(text, HasSubstr("dronecore_backend_rpc_latency_seconds_bucket{"
+                                "rpc=\"mission.UploadMission\",le=\"10\"} 2\n"));
+    EXPECT_THAT(text, HasSubstr("dronecore_backend_rpc_latency_seconds_bucket{"
+                                "rpc=\"mission.UploadMission\",le=\"+Inf\"} 3\n"));
+    EXPECT_THAT(text, HasSubstr("dronecore_backend_rpc_latency_seconds_count{"
+                                "rpc=\"mission.UploadMission\"} 3\n"));
+}
+
+} // namespace
@@ -0,0 +1,178 @@
+#include <future>
+#include <gmock/gmock.h>
+#include <grpc++/grpc++.h>
+#include <grpc++/server.h>
+#include <grpc++/server_builder.h>
+#include <memory>
+
+#include "async_rpc_pool.h"
+#include "backend_metrics.h"
+#include "system_plugins.h"
+#include "telemetry/mocks/telemetry_mock.h"
+#include "telemetry/telemetry_async_service.h"
+
+namespace {
+
+using testing::_;
+using testing::NiceMock;
+
+using MockTelemetry = NiceMock<dronecore::testing::MockTelemetry>;
+using TelemetryAsyncService = dronecore::backend::TelemetryAsyncService<MockTelemetry>;
+using TelemetryService = dronecore::rpc::telemetry::TelemetryService;
+using AsyncRpcPool = dronecore::backend::AsyncRpcPool;
+using SystemTelemetries = dronecore::backend::SystemPlugins<MockTelemetry>;
+
+using PositionResponse = dronecore::rpc::telemetry::PositionResponse;
+using Position = dronecore::Telemetry::Position;
+using position_callback_t = dronecore::Telemetry::position_callback_t;
+
+ACTION_P2(SaveCallback, callback, callback_promise)
+{
+    *callback = arg0;
+    callback_promise->set_value();
+}
+
+class TelemetryAsyncServiceTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        _telemetry = new MockTelemetry();
+        _telemetries = std::unique_ptr<SystemTelemetries>(new SystemTelemetries(
+        [this](uint64_t uuid) {
+            std::unique_ptr<MockTelemetry> telemetry {};
+            if (uuid == ARBITRARY_UUID) {
+                telemetry.reset(_telemetry);
+            }
+            return telemetry;
+        }, [](uint64_t &uuid) {
+            uuid = ARBITRARY_UUID;
+            return true;
+        }));
+        _pool = std::unique_ptr<AsyncRpcPool>(new AsyncRpcPool(2));
+        _telemetry_service = std::unique_ptr<TelemetryAsyncService>(new TelemetryAsyncService(
+                                                                        *_telemetries, *_pool,
+                                                                        _metrics));
+
+        grpc::ServerBuilder builder;
+        builder.RegisterService(_telemetry_service->service());
+        _pool->add_completion_queues(builder);
+        _server = builder.BuildAndStart();
+
+        for (auto &completion_queue : _pool->completion_queues()) {
+            _telemetry_service->start(completion_queue.get());
+        }
+        _pool->run();
+
+        grpc::ChannelArguments channel_args;
+        auto channel = _server->InProcessChannel(channel_args);
+        _stub = TelemetryService::NewStub(channel);
+    }
+
+    virtual void TearDown()
+    {
+        _pool->shutdown(*_server);
+        _telemetry_service->shutdown();
+    }
+
+    Position createPosition(const double lat, const double lng) const
+    {
+        Position position;
+        position.latitude_deg = lat;
+        position.longitude_deg = lng;
+        position.absolute_altitude_m = 500.0f;
+        position.relative_altitude_m = 10.0f;
+        return position;
+    }
+
+    static constexpr uint64_t ARBITRARY_UUID = 1122334455667788;
+
+    // Owned by _telemetries once it was asked for.
+    MockTelemetry *_telemetry = nullptr;
+    std::unique_ptr<SystemTelemetries> _telemetries {};
+    dronecore::backend::BackendMetrics _metrics {};
+    std::unique_ptr<AsyncRpcPool> _pool {};
+    std::unique_ptr<TelemetryAsyncService> _telemetry_service {};
+    std::unique_ptr<grpc::Server> _server {};
+    std::unique_ptr<TelemetryService::Stub> _stub {};
+};
+
+TEST_F(TelemetryAsyncServiceTest, subscribesOnceForAllStreams)
+{
+    position_callback_t callback;
+    std::promise<void> subscription_promise;
+    auto subscription_future = subscription_promise.get_future();
+    EXPECT_CALL(*_telemetry, position_async(_))
+    .Times(1)
+    .WillOnce(SaveCallback(&callback, &subscription_promise));
+
+    dronecore::rpc::telemetry::SubscribePositionRequest request;
+    grpc::ClientContext first_context;
+    auto first_reader = _stub->SubscribePosition(&first_context, request);
+    grpc::ClientContext second_context;
+    auto second_reader = _stub->SubscribePosition(&second_context, request);
+
+    subscription_future.wait();
+    callback(createPosition(41.848695, 75.132751));
+
+    PositionResponse response;
+    ASSERT_TRUE(first_reader->Read(&response));
+    EXPECT_DOUBLE_EQ(41.848695, response.position().latitude_deg());
+
+    // The second stream may have come in after the publication, it gets the
+    // latest position either way.
+    ASSERT_TRUE(second_reader->Read(&response));
+    EXPECT_DOUBLE_EQ(41.848695, response.position().latitude_deg());
+
+    first_context.TryCancel();
+    second_context.TryCancel();
+}
+
+TEST_F(TelemetryAsyncServiceTest, sendsLatestPositionToNewStream)
+{
+    position_callback_t callback;
+    std::promise<void> subscription_promise;
+    auto subscription_future = subscription_promise.get_future();
+    EXPECT_CALL(*_telemetry, position_async(_))
+    .WillOnce(SaveCallback(&callback, &subscription_promise));
+
+    dronecore::rpc::telemetry::SubscribePositionRequest request;
+    grpc::ClientContext first_context;
+    auto first_reader = _stub->SubscribePosition(&first_context, request);
+
+    subscription_future.wait();
+    callback(createPosition(41.848695, 75.132751));
+    callback(createPosition(46.522626, 6.635356));
+
+    PositionResponse response;
+    ASSERT_TRUE(first_reader->Read(&response));
+
+    grpc::ClientContext second_context;
+    auto second_reader = _stub->SubscribePosition(&second_context, request);
+    ASSERT_TRUE(second_reader->Read(&response));
+    EXPECT_DOUBLE_EQ(46.522626, response.position().latitude_deg());
+
+    first_context.TryCancel();
+    second_context.TryCancel();
+}
+
+TEST_F(TelemetryAsyncServiceTest, failsForUnknownSystem)
+{
+    EXPECT_CALL(*_telemetry, position_async(_)).Times(0);
+
+    dronecore::rpc::telemetry::SubscribePositionRequest request;
+    grpc::ClientContext context;
+    context.AddMetadata(SystemTelemetries::UUID_METADATA_KEY, "42");
+    auto reader = _stub->SubscribePosition(&context, request);
+
+    PositionResponse response;
+    EXPECT_FALSE(reader->Read(&response));
+    EXPECT_EQ(grpc::StatusCode::NOT_FOUND, reader->Finish().error_code());
+    EXPECT_EQ(1u, _metrics.rpc("telemetry.SubscribePosition").calls.load());
+    EXPECT_EQ(0, _metrics.rpc("telemetry.SubscribePosition").active_streams.load());
+
+    // Never handed over.
+    delete _telemetry;
+}
+
+} // namespace
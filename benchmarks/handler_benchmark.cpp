@@ -0,0 +1,99 @@
+#include "call_every_handler.h"
+#include "timeout_handler.h"
+#include <benchmark/benchmark.h>
+#include <vector>
+
+using namespace dronecore;
+
+// Every command and parameter in flight has a timeout, which is refreshed
+// whenever something arrives for it.
+static void BM_TimeoutHandlerRefresh(benchmark::State &state)
+{
+    Time time;
+    TimeoutHandler handler(time);
+    std::vector<void *> cookies(size_t(state.range(0)), nullptr);
+    for (auto &cookie : cookies) {
+        handler.add([]() {}, 10.0, &cookie);
+    }
+
+    size_t i = 0;
+    for (auto _ : state) {
+        handler.refresh(cookies[i]);
+        i = (i + 1) % cookies.size();
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(BM_TimeoutHandlerRefresh)->Arg(16)->Arg(256)->Arg(4096);
+
+// Adding and removing, as for a command which is acked right away.
+static void BM_TimeoutHandlerAddRemove(benchmark::State &state)
+{
+    Time time;
+    TimeoutHandler handler(time);
+    std::vector<void *> cookies(size_t(state.range(0)), nullptr);
+    for (auto &cookie : cookies) {
+        handler.add([]() {}, 10.0, &cookie);
+    }
+
+    for (auto _ : state) {
+        void *cookie = nullptr;
+        handler.add([]() {}, 1.0, &cookie);
+        handler.remove(cookie);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(BM_TimeoutHandlerAddRemove)->Arg(16)->Arg(256)->Arg(4096);
+
+// Checking for due timeouts when none is, which is what happens most often.
+static void BM_TimeoutHandlerRunOnce(benchmark::State &state)
+{
+    Time time;
+    TimeoutHandler handler(time);
+    std::vector<void *> cookies(size_t(state.range(0)), nullptr);
+    for (auto &cookie : cookies) {
+        handler.add([]() {}, 10.0, &cookie);
+    }
+
+    for (auto _ : state) {
+        handler.run_once();
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(BM_TimeoutHandlerRunOnce)->Arg(16)->Arg(256)->Arg(4096);
+
+static void BM_CallEveryHandlerRunOnce(benchmark::State &state)
+{
+    Time time;
+    CallEveryHandler handler(time);
+    std::vector<void *> cookies(size_t(state.range(0)), nullptr);
+    for (auto &cookie : cookies) {
+        handler.add([]() {}, 10.0f, &cookie);
+    }
+
+    for (auto _ : state) {
+        handler.run_once();
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(BM_CallEveryHandlerRunOnce)->Arg(16)->Arg(256)->Arg(4096);
+
+static void BM_CallEveryHandlerChange(benchmark::State &state)
+{
+    Time time;
+    CallEveryHandler handler(time);
+    std::vector<void *> cookies(size_t(state.range(0)), nullptr);
+    for (auto &cookie : cookies) {
+        handler.add([]() {}, 10.0f, &cookie);
+    }
+
+    size_t i = 0;
+    float interval_s = 10.0f;
+    for (auto _ : state) {
+        // Alternating, so that the entry moves in the heap.
+        interval_s = (interval_s == 10.0f) ? 20.0f : 10.0f;
+        handler.change(interval_s, cookies[i]);
+        i = (i + 1) % cookies.size();
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(BM_CallEveryHandlerChange)->Arg(16)->Arg(256)->Arg(4096);
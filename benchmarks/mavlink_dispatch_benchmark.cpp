@@ -0,0 +1,84 @@
+#include "mavlink_handler_table.h"
+#include "mavlink_message_traits.h"
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+using namespace dronecore;
+
+// What MAVLinkSystem::process_mavlink_message() does for every message: load
+// the current table, find the handlers of the id and call them.
+static void dispatch(const std::shared_ptr<const MAVLinkHandlerTable> &shared_table,
+                     const MAVLinkMessageView &view)
+{
+    const std::shared_ptr<const MAVLinkHandlerTable> table = std::atomic_load(&shared_table);
+    const MAVLinkHandlerTable::entries_t *entries = table->find(view.msgid());
+    if (entries != nullptr) {
+        MAVLinkHandlerTable::dispatch(*entries, view);
+    }
+}
+
+// Handlers for other ids as well, so that finding the right ones counts.
+static std::shared_ptr<const MAVLinkHandlerTable> table_with_handlers(
+    unsigned num_handlers, MAVLinkHandlerTable::Entry entry, std::vector<int> &cookies)
+{
+    std::shared_ptr<MAVLinkHandlerTable> table = std::make_shared<MAVLinkHandlerTable>();
+    cookies.resize(num_handlers);
+    for (unsigned i = 0; i < num_handlers; ++i) {
+        entry.cookie = &cookies[i];
+        table->add(MAVLINK_MSG_ID_ATTITUDE, entry);
+        table->add(MAVLINK_MSG_ID_HEARTBEAT, entry);
+        table->add(MAVLINK_MSG_ID_CAMERA_INFORMATION, entry);
+    }
+    return table;
+}
+
+static mavlink_message_t attitude()
+{
+    mavlink_message_t message;
+    mavlink_msg_attitude_pack(1, 1, &message, 0, 0.1f, 0.2f, 0.3f, 0.01f, 0.02f, 0.03f);
+    return message;
+}
+
+// Handlers which decode the message themselves.
+static void BM_DispatchMessageHandlers(benchmark::State &state)
+{
+    float roll = 0.0f;
+    MAVLinkHandlerTable::Entry entry = {[&roll](const mavlink_message_t &message) {
+            roll = mavlink_msg_attitude_get_roll(&message);
+        }, nullptr, nullptr, nullptr, nullptr, nullptr
+    };
+    std::vector<int> cookies;
+    auto table = table_with_handlers(unsigned(state.range(0)), entry, cookies);
+    const auto message = attitude();
+
+    for (auto _ : state) {
+        dispatch(table, MAVLinkMessageView(message));
+        benchmark::DoNotOptimize(roll);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(BM_DispatchMessageHandlers)->Arg(1)->Arg(4)->Arg(16);
+
+// Typed handlers, which share one decode.
+static void BM_DispatchDecodedHandlers(benchmark::State &state)
+{
+    float roll = 0.0f;
+    MAVLinkHandlerTable::Entry entry = {nullptr, nullptr, nullptr,
+                                        MAVLinkMessageTraits<mavlink_attitude_t>::decode,
+                                        [&roll](const void *decoded) {
+            roll = static_cast<const mavlink_attitude_t *>(decoded)->roll;
+        }, nullptr
+    };
+    std::vector<int> cookies;
+    auto table = table_with_handlers(unsigned(state.range(0)), entry, cookies);
+    const auto message = attitude();
+
+    for (auto _ : state) {
+        dispatch(table, MAVLinkMessageView(message));
+        benchmark::DoNotOptimize(roll);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(BM_DispatchDecodedHandlers)->Arg(1)->Arg(4)->Arg(16);
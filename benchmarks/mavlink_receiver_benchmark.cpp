@@ -0,0 +1,62 @@
+#include "mavlink_receiver.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <vector>
+
+using namespace dronecore;
+
+// Attitude messages, as a flight controller streams them at a high rate.
+static std::vector<char> attitudes(unsigned num)
+{
+    std::vector<char> bytes;
+    for (unsigned i = 0; i < num; ++i) {
+        mavlink_message_t message;
+        mavlink_msg_attitude_pack(1, 1, &message, i, 0.1f, 0.2f, 0.3f, 0.01f, 0.02f, 0.03f);
+        uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+        uint16_t len = mavlink_msg_to_send_buffer(buffer, &message);
+        bytes.insert(bytes.end(), buffer, buffer + len);
+    }
+    return bytes;
+}
+
+// Whole frames in one datagram, as from UDP.
+static void BM_MAVLinkReceiverParseMessage(benchmark::State &state)
+{
+    auto bytes = attitudes(unsigned(state.range(0)));
+    MAVLinkReceiver receiver;
+
+    int64_t num_parsed = 0;
+    for (auto _ : state) {
+        receiver.set_new_datagram(bytes.data(), unsigned(bytes.size()));
+        while (receiver.parse_message()) {
+            benchmark::DoNotOptimize(receiver.get_last_message_view().msgid());
+            ++num_parsed;
+        }
+    }
+    state.SetItemsProcessed(num_parsed);
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(bytes.size()));
+}
+BENCHMARK(BM_MAVLinkReceiverParseMessage)->Arg(1)->Arg(16)->Arg(64);
+
+// Frames cut into reads of a few bytes, as from a serial port.
+static void BM_MAVLinkReceiverParseSplitFrames(benchmark::State &state)
+{
+    auto bytes = attitudes(64);
+    const unsigned read_len = unsigned(state.range(0));
+    MAVLinkReceiver receiver;
+
+    int64_t num_parsed = 0;
+    for (auto _ : state) {
+        for (unsigned offset = 0; offset < bytes.size(); offset += read_len) {
+            const unsigned len = std::min(read_len, unsigned(bytes.size()) - offset);
+            receiver.set_new_datagram(bytes.data() + offset, len);
+            while (receiver.parse_message()) {
+                benchmark::DoNotOptimize(receiver.get_last_message_view().msgid());
+                ++num_parsed;
+            }
+        }
+    }
+    state.SetItemsProcessed(num_parsed);
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(bytes.size()));
+}
+BENCHMARK(BM_MAVLinkReceiverParseSplitFrames)->Arg(8)->Arg(64);
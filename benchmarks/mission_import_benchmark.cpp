@@ -0,0 +1,103 @@
+#include "mission/mission.h"
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+using namespace dronecore;
+
+namespace {
+
+// Writes the items of the QGC sample plan `scale` times into one plan in a
+// temporary directory and returns its path, or an empty string.
+std::string write_scaled_plan(const std::string &dir, unsigned scale)
+{
+    std::string self_file_path = __FILE__;
+    std::string self_dir_path = self_file_path.substr(0, self_file_path.rfind('/'));
+    std::ifstream sample_file(self_dir_path + "/../plugins/mission/qgroundcontrol_sample.plan");
+    if (!sample_file.good()) {
+        return "";
+    }
+    std::stringstream sample_stream;
+    sample_stream << sample_file.rdbuf();
+    const std::string sample = sample_stream.str();
+
+    // Find the content of the items array by its matching bracket.
+    const size_t items_key = sample.find("\"items\"");
+    if (items_key == std::string::npos) {
+        return "";
+    }
+    const size_t items_begin = sample.find('[', items_key) + 1;
+    size_t items_end = items_begin;
+    for (int depth = 1; depth > 0; ++items_end) {
+        if (items_end >= sample.size()) {
+            return "";
+        }
+        if (sample[items_end] == '[') {
+            ++depth;
+        } else if (sample[items_end] == ']') {
+            --depth;
+        }
+    }
+    --items_end;
+    const std::string items = sample.substr(items_begin, items_end - items_begin);
+
+    const std::string path = dir + "/scaled.plan";
+    std::ofstream scaled_file(path);
+    scaled_file << sample.substr(0, items_begin) << items;
+    for (unsigned i = 1; i < scale; ++i) {
+        scaled_file << "," << items;
+    }
+    scaled_file << sample.substr(items_end);
+    return path;
+}
+
+template<typename T>
+void import_scaled_plan(benchmark::State &state)
+{
+    char dir_template[] = "/tmp/dronecore_benchmark_XXXXXX";
+    const char *dir = mkdtemp(dir_template);
+    if (dir == nullptr) {
+        state.SkipWithError("Could not create a temporary directory");
+        return;
+    }
+    const std::string path = write_scaled_plan(dir, unsigned(state.range(0)));
+    if (path.empty()) {
+        rmdir(dir);
+        state.SkipWithError("Could not write the scaled plan");
+        return;
+    }
+
+    size_t num_items = 0;
+    for (auto _ : state) {
+        T mission;
+        if (Mission::import_qgroundcontrol_mission(mission, path) != Mission::Result::SUCCESS) {
+            state.SkipWithError("Import failed");
+            break;
+        }
+        num_items = mission.size();
+        benchmark::DoNotOptimize(mission.data());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(num_items));
+
+    std::remove(path.c_str());
+    rmdir(dir);
+}
+
+} // namespace
+
+// A plan of about 5 MB, as for a large survey.
+static void BM_MissionImportQGCData(benchmark::State &state)
+{
+    import_scaled_plan<Mission::mission_data_t>(state);
+}
+BENCHMARK(BM_MissionImportQGCData)->Arg(1000)->Unit(benchmark::kMillisecond);
+
+static void BM_MissionImportQGCItems(benchmark::State &state)
+{
+    import_scaled_plan<Mission::mission_items_t>(state);
+}
+BENCHMARK(BM_MissionImportQGCItems)->Arg(1000)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,50 @@
+#include "mavlink_parameters.h"
+#include <benchmark/benchmark.h>
+#include <vector>
+
+using namespace dronecore;
+
+// Parameter values are copied into every request, reply and callback.
+static void BM_ParamValueCopy(benchmark::State &state)
+{
+    MAVLinkParameters::ParamValue value;
+    value.set_float(0.5f);
+
+    for (auto _ : state) {
+        MAVLinkParameters::ParamValue copy = value;
+        benchmark::DoNotOptimize(copy);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(BM_ParamValueCopy);
+
+// As when all parameters are fetched and kept.
+static void BM_ParamValueCopyIntoVector(benchmark::State &state)
+{
+    MAVLinkParameters::ParamValue value;
+    value.set_int32(42);
+    std::vector<MAVLinkParameters::ParamValue> values;
+    values.reserve(size_t(state.range(0)));
+
+    for (auto _ : state) {
+        values.clear();
+        for (int64_t i = 0; i < state.range(0); ++i) {
+            values.push_back(value);
+        }
+        benchmark::DoNotOptimize(values.data());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_ParamValueCopyIntoVector)->Arg(1000);
+
+static void BM_ParamValueGetFloat(benchmark::State &state)
+{
+    MAVLinkParameters::ParamValue value;
+    value.set_float(0.5f);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(value.get_float());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(BM_ParamValueGetFloat);
@@ -0,0 +1,58 @@
+#include "mpsc_queue.h"
+#include "safe_queue.h"
+#include "spsc_queue.h"
+#include <benchmark/benchmark.h>
+#include <vector>
+
+using namespace dronecore;
+
+// Every benchmark thread pushes and pops again, so all of them contend for
+// the one queue.
+static void BM_SafeQueueContention(benchmark::State &state)
+{
+    static SafeQueue<int> queue;
+
+    for (auto _ : state) {
+        queue.enqueue(1);
+        benchmark::DoNotOptimize(queue.dequeue());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(BM_SafeQueueContention)->ThreadRange(1, 8)->UseRealTime();
+
+// The first thread consumes, all others produce.
+static void BM_MpscQueueContention(benchmark::State &state)
+{
+    static MpscQueue<int> queue;
+
+    int item = 0;
+    for (auto _ : state) {
+        if (state.thread_index() == 0) {
+            benchmark::DoNotOptimize(queue.try_pop(item));
+        } else {
+            queue.push(1);
+        }
+    }
+
+    if (state.thread_index() == 0) {
+        // Nothing is pushed anymore once all threads are done.
+        while (queue.try_pop(item)) {}
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(BM_MpscQueueContention)->ThreadRange(2, 8)->UseRealTime();
+
+static void BM_SpscQueuePushPop(benchmark::State &state)
+{
+    SpscQueue<int> queue(size_t(state.range(0)));
+    std::vector<int> items;
+    items.reserve(queue.capacity());
+
+    for (auto _ : state) {
+        while (queue.push(1)) {}
+        items.clear();
+        benchmark::DoNotOptimize(queue.pop_batch(items));
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(queue.capacity()));
+}
+BENCHMARK(BM_SpscQueuePushPop)->Arg(64)->Arg(1024);
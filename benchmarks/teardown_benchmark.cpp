@@ -0,0 +1,31 @@
+#include "dronecore_impl.h"
+#include <benchmark/benchmark.h>
+#include <memory>
+
+using namespace dronecore;
+
+// Tearing down an instance with a UDP connection and a vehicle each. All
+// receive threads are woken at once, so this should hardly grow with the
+// number of connections.
+static void BM_DroneCoreTeardown(benchmark::State &state)
+{
+    const int num_vehicles = int(state.range(0));
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::unique_ptr<DroneCoreImpl> impl(new DroneCoreImpl());
+        for (int i = 0; i < num_vehicles; ++i) {
+            impl->add_udp_connection(24540 + i);
+
+            mavlink_message_t heartbeat;
+            mavlink_msg_heartbeat_pack(uint8_t(i + 1), MAV_COMP_ID_AUTOPILOT1, &heartbeat,
+                                       MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_PX4, 0, 0, 0);
+            impl->receive_message(heartbeat, nullptr);
+        }
+        state.ResumeTiming();
+
+        impl.reset();
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * num_vehicles);
+}
+BENCHMARK(BM_DroneCoreTeardown)->Arg(1)->Arg(10)->Arg(50)->UseRealTime();
@@ -0,0 +1,46 @@
+#include "seqlock.h"
+#include "telemetry/telemetry.h"
+#include <benchmark/benchmark.h>
+#include <mutex>
+
+using namespace dronecore;
+
+// The telemetry getters load a SeqLock the receive thread stores to. The
+// first benchmark thread writes as the receive thread does, all others read
+// as app threads polling get_position() do.
+static void BM_TelemetryGetterContention(benchmark::State &state)
+{
+    static SeqLock<Telemetry::Position> position;
+
+    Telemetry::Position value {47.397742, 8.545594, 488.0f, 10.0f};
+    for (auto _ : state) {
+        if (state.thread_index() == 0) {
+            value.relative_altitude_m += 0.1f;
+            position.store(value);
+        } else {
+            benchmark::DoNotOptimize(position.load());
+        }
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(BM_TelemetryGetterContention)->ThreadRange(2, 8)->UseRealTime();
+
+// The same with a mutex, as the getters used to work, for comparison.
+static void BM_TelemetryGetterContentionMutex(benchmark::State &state)
+{
+    static std::mutex mutex;
+    static Telemetry::Position position {};
+
+    Telemetry::Position value {47.397742, 8.545594, 488.0f, 10.0f};
+    for (auto _ : state) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (state.thread_index() == 0) {
+            value.relative_altitude_m += 0.1f;
+            position = value;
+        } else {
+            benchmark::DoNotOptimize(position);
+        }
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(BM_TelemetryGetterContentionMutex)->ThreadRange(2, 8)->UseRealTime();
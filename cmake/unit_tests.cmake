@@ -16,6 +16,12 @@ target_link_libraries(unit_tests_runner
     dronecore
     dronecore_mission
     dronecore_camera
+    dronecore_follow_me
+    dronecore_geofence
+    dronecore_ftp
+    dronecore_logging
+    dronecore_offboard
+    dronecore_telemetry
     gtest
     gtest_main
     gmock
@@ -0,0 +1,79 @@
+#include "allocation_counter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace dronecore {
+
+namespace {
+
+std::atomic<uint64_t> num_counted {0};
+thread_local bool is_counted = false;
+
+void *allocate(size_t size)
+{
+    if (is_counted) {
+        num_counted.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // malloc(0) may return nullptr, new has to return something unique.
+    if (size == 0) {
+        size = 1;
+    }
+    while (true) {
+        void *memory = malloc(size);
+        if (memory != nullptr) {
+            return memory;
+        }
+        // Without exceptions, there is nothing else to do than to give up.
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) {
+            abort();
+        }
+        handler();
+    }
+}
+
+} // namespace
+
+void AllocationCounter::count_this_thread()
+{
+    is_counted = true;
+}
+
+void AllocationCounter::stop_counting_this_thread()
+{
+    is_counted = false;
+}
+
+uint64_t AllocationCounter::num_allocations()
+{
+    return num_counted.load(std::memory_order_relaxed);
+}
+
+void AllocationCounter::reset()
+{
+    num_counted.store(0, std::memory_order_relaxed);
+}
+
+} // namespace dronecore
+
+void *operator new(size_t size)
+{
+    return dronecore::allocate(size);
+}
+
+void *operator new[](size_t size)
+{
+    return dronecore::allocate(size);
+}
+
+void operator delete(void *memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+    free(memory);
+}
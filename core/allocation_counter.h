@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+namespace dronecore {
+
+// Counts calls to the global operator new, which the unit tests replace with
+// one that counts. Only the threads which asked for it are counted, so that
+// other threads warming up don't make the count flaky. Only for tests.
+class AllocationCounter
+{
+public:
+    // Counts the allocations of the calling thread from now on.
+    static void count_this_thread();
+    static void stop_counting_this_thread();
+
+    // Of all counted threads since the last reset().
+    static uint64_t num_allocations();
+    static void reset();
+};
+
+} // namespace dronecore
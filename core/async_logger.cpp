@@ -0,0 +1,321 @@
+#include "async_logger.h"
+#include "log.h"
+#include "thread_roles.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#if ANDROID
+#include <android/log.h>
+#else
+#include <iostream>
+#endif
+
+namespace dronecore {
+
+constexpr unsigned AsyncLogger::MAX_TEXT_LEN;
+constexpr unsigned AsyncLogger::QUEUE_LEN;
+constexpr int AsyncLogger::DRAIN_INTERVAL_MS;
+
+std::atomic<int> AsyncLogger::_min_level {static_cast<int>(LogLevel::Debug)};
+
+namespace {
+
+// Writes what is left once the process exits. Objects destroyed after it
+// still log, right away then.
+struct StopAtExit {
+    ~StopAtExit() { AsyncLogger::instance().stop(); }
+} stop_at_exit;
+
+// Set once the queue handle of the thread is destroyed. Trivially destructible,
+// so that it can still be read by the thread_local destructors which run later.
+thread_local bool thread_queue_is_gone = false;
+
+} // namespace
+
+AsyncLogger &AsyncLogger::instance()
+{
+    // Never deleted, so that it can be used from other static objects in any order.
+    static AsyncLogger *logger = new AsyncLogger();
+    return *logger;
+}
+
+AsyncLogger::AsyncLogger()
+{
+    _drained.reserve(QUEUE_LEN);
+    _thread = std::thread(&AsyncLogger::run, this);
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    stop();
+}
+
+AsyncLogger::ThreadQueueHandle::~ThreadQueueHandle()
+{
+    if (queue != nullptr) {
+        queue->is_finished.store(true, std::memory_order_release);
+        // drain() frees it from now on.
+        queue = nullptr;
+    }
+    thread_queue_is_gone = true;
+}
+
+AsyncLogger::ThreadQueue *AsyncLogger::thread_queue()
+{
+    if (thread_queue_is_gone) {
+        return nullptr;
+    }
+
+    thread_local ThreadQueueHandle handle;
+
+    if (handle.queue == nullptr) {
+        // Only the first message of a thread takes the lock.
+        std::unique_ptr<ThreadQueue> queue(new ThreadQueue());
+        handle.queue = queue.get();
+        std::lock_guard<std::mutex> lock(_queues_mutex);
+        _queues.push_back(std::move(queue));
+    }
+    return handle.queue;
+}
+
+void AsyncLogger::log(LogLevel level, const char *filename, int line, const std::string &text)
+{
+    Message message;
+    message.level = level;
+    message.time = time(nullptr);
+    message.filename = filename;
+    message.line = line;
+    const size_t text_len = std::min(text.size(), size_t(MAX_TEXT_LEN - 1));
+    memcpy(message.text, text.data(), text_len);
+    message.text[text_len] = '\0';
+
+    // Also from thread_local destructors run after the queue of the thread went.
+    ThreadQueue *queue = _is_stopped.load(std::memory_order_acquire) ? nullptr :
+                         thread_queue();
+    if (queue == nullptr) {
+        std::lock_guard<std::mutex> lock(_drain_mutex);
+        // After what the thread queued before.
+        drain();
+        write(message);
+        return;
+    }
+
+    if (!queue->messages.push(message)) {
+        queue->num_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Pairs with the ones in run() and stop(), so that either the thread sees
+    // the message or we see that it sleeps, and the same for the last drain.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_is_stopped.load(std::memory_order_relaxed)) {
+        // Stopped after the check above, its last drain might have missed it.
+        std::lock_guard<std::mutex> lock(_drain_mutex);
+        drain();
+        return;
+    }
+    if (_is_sleeping.load(std::memory_order_relaxed)) {
+        wake_up();
+    }
+}
+
+void AsyncLogger::wake_up()
+{
+    {
+        std::lock_guard<std::mutex> lock(_wake_mutex);
+        _is_sleeping.store(false, std::memory_order_relaxed);
+    }
+    _wake_cv.notify_one();
+}
+
+void AsyncLogger::set_sink(sink_t sink)
+{
+    std::lock_guard<std::mutex> lock(_drain_mutex);
+    drain();
+    _sink = sink;
+}
+
+void AsyncLogger::flush()
+{
+    std::lock_guard<std::mutex> lock(_drain_mutex);
+    drain();
+}
+
+void AsyncLogger::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_wake_mutex);
+        if (_should_exit) {
+            return;
+        }
+        _should_exit = true;
+    }
+    _wake_cv.notify_all();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(_drain_mutex);
+    _is_stopped.store(true, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    drain();
+}
+
+void AsyncLogger::run()
+{
+    ThreadRoles::apply_to_this_thread(DroneCore::ThreadRole::LOGGING, "logger");
+
+    std::unique_lock<std::mutex> wake_lock(_wake_mutex);
+
+    while (!_should_exit) {
+        _wake_cv.wait_for(wake_lock, std::chrono::milliseconds(DRAIN_INTERVAL_MS));
+
+        wake_lock.unlock();
+        bool drained_any;
+        {
+            std::lock_guard<std::mutex> lock(_drain_mutex);
+            drained_any = drain();
+        }
+
+        if (!drained_any) {
+            // Nothing is logged, so we sleep until the next message. Whatever
+            // came in before the flag was seen is drained first.
+            _is_sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            {
+                std::lock_guard<std::mutex> lock(_drain_mutex);
+                drained_any = drain();
+            }
+            wake_lock.lock();
+            if (!drained_any) {
+                _wake_cv.wait(wake_lock, [this]() {
+                    return !_is_sleeping.load(std::memory_order_relaxed) || _should_exit;
+                });
+            }
+            _is_sleeping.store(false, std::memory_order_relaxed);
+        } else {
+            wake_lock.lock();
+        }
+    }
+}
+
+bool AsyncLogger::drain()
+{
+    // We assume that we already acquired _drain_mutex in this function.
+
+    uint64_t num_dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(_queues_mutex);
+
+        for (auto it = _queues.begin(); it != _queues.end();) {
+            // Checked first, as everything the thread pushed is visible then.
+            const bool is_finished = (*it)->is_finished.load(std::memory_order_acquire);
+            (*it)->messages.pop_batch(_drained);
+            num_dropped += (*it)->num_dropped.exchange(0, std::memory_order_relaxed);
+
+            if (is_finished) {
+                it = _queues.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    const bool drained_any = !_drained.empty() || num_dropped > 0;
+    for (const auto &message : _drained) {
+        write(message);
+    }
+    _drained.clear();
+
+    if (num_dropped > 0) {
+        Message message;
+        message.level = LogLevel::Warn;
+        message.time = time(nullptr);
+        message.filename = __FILENAME__;
+        message.line = __LINE__;
+        snprintf(message.text, sizeof(message.text), "Dropped %llu log messages",
+                 static_cast<unsigned long long>(num_dropped));
+        write(message);
+    }
+
+    return drained_any;
+}
+
+void AsyncLogger::write(const Message &message)
+{
+    // We assume that we already acquired _drain_mutex in this function.
+
+    if (_sink) {
+        _sink(message);
+    } else {
+        write_to_console(message);
+    }
+}
+
+void AsyncLogger::write_to_console(const Message &message)
+{
+#if ANDROID
+    switch (message.level) {
+        case LogLevel::Debug:
+            __android_log_print(ANDROID_LOG_DEBUG, "DroneCore", "%s", message.text);
+            break;
+        case LogLevel::Info:
+            __android_log_print(ANDROID_LOG_INFO, "DroneCore", "%s", message.text);
+            break;
+        case LogLevel::Warn:
+            __android_log_print(ANDROID_LOG_WARN, "DroneCore", "%s", message.text);
+            break;
+        case LogLevel::Err:
+            __android_log_print(ANDROID_LOG_ERROR, "DroneCore", "%s", message.text);
+            break;
+    }
+#else
+
+    switch (message.level) {
+        case LogLevel::Debug:
+            std::cout << ANSI_COLOR_GREEN;
+            break;
+        case LogLevel::Info:
+            std::cout << ANSI_COLOR_BLUE;
+            break;
+        case LogLevel::Warn:
+            std::cout << ANSI_COLOR_YELLOW;
+            break;
+        case LogLevel::Err:
+            std::cout << ANSI_COLOR_RED;
+            break;
+    }
+
+    // Time output taken from:
+    // https://stackoverflow.com/questions/16357999#answer-16358264
+    struct tm *timeinfo = localtime(&message.time);
+    char time_buffer[10] {}; // We need 8 characters + \0
+    strftime(time_buffer, sizeof(time_buffer), "%I:%M:%S", timeinfo);
+    std::cout << "[" << time_buffer;
+
+    switch (message.level) {
+        case LogLevel::Debug:
+            std::cout << "|Debug] ";
+            break;
+        case LogLevel::Info:
+            std::cout << "|Info ] ";
+            break;
+        case LogLevel::Warn:
+            std::cout << "|Warn ] ";
+            break;
+        case LogLevel::Err:
+            std::cout << "|Error] ";
+            break;
+    }
+
+    std::cout << ANSI_COLOR_RESET;
+
+    std::cout << message.text;
+    std::cout << " (" << message.filename << ":" << message.line << ")";
+
+    std::cout << std::endl;
+#endif
+}
+
+} // namespace dronecore
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "spsc_queue.h"
+
+namespace dronecore {
+
+// The values are what DRONECORE_MIN_LOG_LEVEL compares to.
+enum class LogLevel {
+    Debug = 0,
+    Info = 1,
+    Warn = 2,
+    Err = 3
+};
+
+// Writes the log messages of all threads on a thread of its own, so that
+// logging never waits for the console. Every thread which logs gets a ring of
+// its own, which it pushes to without locking. If it is full, messages are
+// dropped and counted rather than waited for. Messages of one thread are
+// written in order, those of different threads may be interleaved a bit.
+//
+// Messages go to the console unless a sink is set. Once the process exits,
+// the messages left are written and any later ones are written right away.
+class AsyncLogger
+{
+public:
+    static constexpr unsigned MAX_TEXT_LEN = 256;
+    static constexpr unsigned QUEUE_LEN = 256;
+
+    struct Message {
+        LogLevel level;
+        time_t time;
+        // As from __FILENAME__, not copied.
+        const char *filename;
+        int line;
+        char text[MAX_TEXT_LEN];
+    };
+
+    // Only ever called by one thread at a time.
+    typedef std::function<void(const Message &)> sink_t;
+
+    static AsyncLogger &instance();
+
+    // Can be called from any thread, never waits for the sink. Text longer
+    // than MAX_TEXT_LEN - 1 is cut off.
+    void log(LogLevel level, const char *filename, int line, const std::string &text);
+
+    // nullptr switches back to the console.
+    void set_sink(sink_t sink);
+
+    // Messages below the level are dropped before they are formatted. Levels
+    // compiled out with DRONECORE_MIN_LOG_LEVEL stay out.
+    static void set_min_level(LogLevel level)
+    {
+        _min_level.store(static_cast<int>(level), std::memory_order_relaxed);
+    }
+
+    static bool is_enabled(LogLevel level)
+    {
+        return static_cast<int>(level) >= _min_level.load(std::memory_order_relaxed);
+    }
+
+    // Returns once everything logged before is written.
+    void flush();
+
+    // Writes everything left and stops the thread, later messages are
+    // written right away.
+    void stop();
+
+    static void write_to_console(const Message &message);
+
+    // Non-copyable
+    AsyncLogger(const AsyncLogger &) = delete;
+    const AsyncLogger &operator=(const AsyncLogger &) = delete;
+
+private:
+    AsyncLogger();
+    ~AsyncLogger();
+
+    struct ThreadQueue {
+        ThreadQueue() : messages(QUEUE_LEN) {}
+
+        SpscQueue<Message> messages;
+        std::atomic<uint64_t> num_dropped {0};
+        // Set once its thread has exited.
+        std::atomic<bool> is_finished {false};
+    };
+
+    // Marks the queue of a thread as finished when the thread exits.
+    struct ThreadQueueHandle {
+        ThreadQueue *queue = nullptr;
+        ~ThreadQueueHandle();
+    };
+
+    // nullptr once the thread is exiting and its queue went.
+    ThreadQueue *thread_queue();
+    void run();
+    // Returns whether there was anything to write.
+    bool drain();
+    void wake_up();
+    void write(const Message &message);
+
+    static constexpr int DRAIN_INTERVAL_MS = 10;
+
+    static std::atomic<int> _min_level;
+
+    // Held while taking messages out of the queues and writing them, as the
+    // queues have one consumer only.
+    std::mutex _drain_mutex {};
+    sink_t _sink {};
+    std::vector<Message> _drained {};
+
+    std::mutex _queues_mutex {};
+    std::vector<std::unique_ptr<ThreadQueue>> _queues {};
+
+    std::atomic<bool> _is_stopped {false};
+    std::mutex _wake_mutex {};
+    std::condition_variable _wake_cv {};
+    bool _should_exit = false;
+    // Set while the thread waits for the next message instead of draining
+    // periodically, so that an idle process does not wake up for nothing.
+    std::atomic<bool> _is_sleeping {false};
+    std::thread _thread {};
+};
+
+} // namespace dronecore
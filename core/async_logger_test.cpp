@@ -0,0 +1,171 @@
+#include "async_logger.h"
+#include "log.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dronecore;
+
+namespace {
+
+class AsyncLoggerTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        AsyncLogger::instance().set_sink([this](const AsyncLogger::Message & message) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _messages.push_back(message);
+        });
+    }
+
+    void TearDown() override
+    {
+        AsyncLogger::instance().set_sink(nullptr);
+    }
+
+    std::vector<AsyncLogger::Message> messages()
+    {
+        AsyncLogger::instance().flush();
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _messages;
+    }
+
+    std::mutex _mutex {};
+    std::vector<AsyncLogger::Message> _messages {};
+};
+
+} // namespace
+
+TEST_F(AsyncLoggerTest, WritesToSink)
+{
+    LogWarn() << "Answer: " << 42;
+
+    const auto written = messages();
+    ASSERT_EQ(written.size(), 1u);
+    EXPECT_EQ(written[0].level, LogLevel::Warn);
+    EXPECT_STREQ(written[0].text, "Answer: 42");
+    EXPECT_STREQ(written[0].filename, "async_logger_test.cpp");
+}
+
+TEST_F(AsyncLoggerTest, CutsOffLongText)
+{
+    LogInfo() << std::string(2 * AsyncLogger::MAX_TEXT_LEN, 'x');
+
+    const auto written = messages();
+    ASSERT_EQ(written.size(), 1u);
+    EXPECT_EQ(std::string(written[0].text), std::string(AsyncLogger::MAX_TEXT_LEN - 1, 'x'));
+}
+
+TEST_F(AsyncLoggerTest, WritesMessagesOfExitedThread)
+{
+    std::thread thread([]() {
+        for (int i = 0; i < 3; ++i) {
+            LogErr() << "Thread " << i;
+        }
+    });
+    thread.join();
+
+    const auto written = messages();
+    ASSERT_EQ(written.size(), 3u);
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(std::string(written[i].text), "Thread " + std::to_string(i));
+    }
+}
+
+TEST_F(AsyncLoggerTest, WritesFromLateThreadLocalDestructors)
+{
+    struct LogsWhenDestroyed {
+        ~LogsWhenDestroyed() { LogErr() << "Late"; }
+    };
+
+    std::thread thread([]() {
+        // Made before the queue of the thread, so destroyed after it.
+        thread_local LogsWhenDestroyed logs_when_destroyed;
+        LogErr() << "Early";
+    });
+    thread.join();
+
+    const auto written = messages();
+    ASSERT_EQ(written.size(), 2u);
+    EXPECT_STREQ(written[0].text, "Early");
+    EXPECT_STREQ(written[1].text, "Late");
+}
+
+TEST_F(AsyncLoggerTest, DropsWhenQueueIsFull)
+{
+    std::promise<void> entered;
+    std::promise<void> release;
+    auto release_future = release.get_future().share();
+    bool is_first = true;
+
+    AsyncLogger::instance().set_sink([&](const AsyncLogger::Message & message) {
+        if (is_first) {
+            // Holds up writing, so that the queue fills up.
+            is_first = false;
+            entered.set_value();
+            release_future.wait();
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        _messages.push_back(message);
+    });
+
+    LogInfo() << "First";
+    ASSERT_EQ(entered.get_future().wait_for(std::chrono::seconds(1)), std::future_status::ready);
+
+    const unsigned num_too_many = 10;
+    for (unsigned i = 0; i < AsyncLogger::QUEUE_LEN + num_too_many; ++i) {
+        LogInfo() << "Message " << i;
+    }
+    release.set_value();
+
+    const auto written = messages();
+    ASSERT_EQ(written.size(), 1u + AsyncLogger::QUEUE_LEN + 1u);
+    EXPECT_STREQ(written.back().text, "Dropped 10 log messages");
+    EXPECT_EQ(written.back().level, LogLevel::Warn);
+}
+
+TEST_F(AsyncLoggerTest, SkipsDisabledLevels)
+{
+    int num_evaluated = 0;
+    auto evaluate = [&num_evaluated]() {
+        return ++num_evaluated;
+    };
+
+    AsyncLogger::set_min_level(LogLevel::Warn);
+    LogInfo() << "Not written " << evaluate();
+    LogWarn() << "Written " << evaluate();
+    AsyncLogger::set_min_level(LogLevel::Debug);
+
+    const auto written = messages();
+    ASSERT_EQ(written.size(), 1u);
+    EXPECT_STREQ(written[0].text, "Written 1");
+    EXPECT_EQ(num_evaluated, 1);
+}
+
+TEST_F(AsyncLoggerTest, WakesUpWhenIdle)
+{
+    // Long enough for the thread to find nothing and go to sleep.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    LogInfo() << "After idle";
+
+    // Written by the thread, without a flush.
+    for (unsigned i = 0; i < 100; ++i) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_messages.empty()) {
+                break;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    ASSERT_EQ(_messages.size(), 1u);
+    EXPECT_STREQ(_messages[0].text, "After idle");
+}
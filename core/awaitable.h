@@ -0,0 +1,344 @@
+#pragma once
+
+// Opt-in C++20 coroutine support, the library itself is C++11 and does not
+// include this. The plugins have their awaitables next to them, e.g.
+// "action/action_awaitable.h".
+
+#if __cplusplus < 202002L
+#error "awaitable.h needs C++20 (-std=c++20)"
+#endif
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace dronecore {
+
+/**
+ * @brief Runs work, and with it resumes coroutines, like DroneCore::callback_executor_t.
+ *
+ * It must not run the work inline but queue it, e.g. RunLoop::executor().
+ */
+typedef std::function<void(std::function<void()> work)> executor_t;
+
+/**
+ * @brief Runs all work posted to it on the thread which calls run().
+ *
+ * Use its executor() for the awaitables, so that one thread drives the coroutines of
+ * many vehicles, without a thread or a blocking call each. It can also be set with
+ * DroneCore::set_callback_executor() to get the user callbacks on the same thread.
+ */
+class RunLoop
+{
+public:
+    RunLoop() {}
+
+    /**
+     * @brief Executor which posts to this loop.
+     */
+    executor_t executor()
+    {
+        return [this](std::function<void()> work) { post(std::move(work)); };
+    }
+
+    /**
+     * @brief Queues work to be run by run(), from any thread.
+     */
+    void post(std::function<void()> work)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _work.push_back(std::move(work));
+        _cv.notify_one();
+    }
+
+    /**
+     * @brief Runs the work posted until stop() is called.
+     */
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true) {
+            _cv.wait(lock, [this]() { return !_work.empty() || _should_stop; });
+            if (_should_stop) {
+                _should_stop = false;
+                return;
+            }
+            auto work = std::move(_work.front());
+            _work.pop_front();
+            lock.unlock();
+            work();
+            lock.lock();
+        }
+    }
+
+    /**
+     * @brief Makes run() return after the work running now, e.g. from a coroutine.
+     */
+    void stop()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _should_stop = true;
+        _cv.notify_one();
+    }
+
+    // Non-copyable
+    RunLoop(const RunLoop &) = delete;
+    const RunLoop &operator=(const RunLoop &) = delete;
+
+private:
+    std::mutex _mutex {};
+    std::condition_variable _cv {};
+    std::deque<std::function<void()>> _work {};
+    bool _should_stop = false;
+};
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+template <typename T>
+struct TaskPromiseBase {
+    std::coroutine_handle<> continuation {};
+    bool is_detached = false;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    // Goes on with whoever awaited the task, or frees a detached one.
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            auto &promise = handle.promise();
+            if (promise.is_detached) {
+                handle.destroy();
+                return std::noop_coroutine();
+            }
+            if (promise.continuation) {
+                return promise.continuation;
+            }
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() noexcept { std::terminate(); }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase<T> {
+    std::optional<T> value {};
+
+    Task<T> get_return_object() noexcept;
+
+    template <typename U>
+    void return_value(U &&result) { value.emplace(std::forward<U>(result)); }
+
+    T take_result() { return std::move(*value); }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase<void> {
+    Task<void> get_return_object() noexcept;
+
+    void return_void() noexcept {}
+
+    void take_result() noexcept {}
+};
+
+} // namespace detail
+
+/**
+ * @brief Coroutine which returns a T, for sequences like arm, takeoff and upload.
+ *
+ * It starts when it is awaited, or with start() when nobody awaits it.
+ */
+template <typename T>
+class Task
+{
+public:
+    typedef detail::TaskPromise<T> promise_type;
+
+    Task(Task &&other) noexcept : _handle(std::exchange(other._handle, nullptr)) {}
+
+    ~Task()
+    {
+        if (_handle) {
+            _handle.destroy();
+        }
+    }
+
+    /**
+     * @brief Starts the task on this thread without awaiting it, it frees itself when done.
+     *
+     * Its result is dropped.
+     */
+    void start() &&
+    {
+        auto handle = std::exchange(_handle, nullptr);
+        handle.promise().is_detached = true;
+        handle.resume();
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept
+    {
+        _handle.promise().continuation = continuation;
+        return _handle;
+    }
+
+    T await_resume() { return _handle.promise().take_result(); }
+
+    // Non-copyable
+    Task(const Task &) = delete;
+    const Task &operator=(const Task &) = delete;
+
+private:
+    friend promise_type;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+
+    std::coroutine_handle<promise_type> _handle;
+};
+
+namespace detail {
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() noexcept
+{
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() noexcept
+{
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+} // namespace detail
+
+/**
+ * @brief Awaits the callback of an `*_async` call and resumes on the executor.
+ *
+ * It is the result for one result, and a std::tuple of them for several.
+ */
+template <typename... Results>
+class CallbackAwaitable
+{
+public:
+    typedef std::function<void(Results...)> callback_t;
+    typedef std::function<void(callback_t)> start_t;
+
+    CallbackAwaitable(executor_t executor, start_t start) :
+        _executor(std::move(executor)),
+        _start(std::move(start)) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        // Nothing is touched after posting, the awaitable may be gone then.
+        _start([this, handle](Results... results) {
+            _results.emplace(results...);
+            _executor([handle]() { handle.resume(); });
+        });
+    }
+
+    auto await_resume()
+    {
+        if constexpr (sizeof...(Results) == 1) {
+            return std::get<0>(std::move(*_results));
+        } else {
+            return std::move(*_results);
+        }
+    }
+
+private:
+    executor_t _executor;
+    start_t _start;
+    std::optional<std::tuple<std::decay_t<Results>...>> _results {};
+};
+
+/**
+ * @brief Awaits the first update of a subscription which the predicate accepts.
+ *
+ * The subscription is removed again when resuming.
+ */
+template <typename T>
+class SubscriptionAwaitable
+{
+public:
+    typedef std::function<void(T)> callback_t;
+    typedef std::function<uint64_t(callback_t)> subscribe_t;
+    typedef std::function<void(uint64_t)> unsubscribe_t;
+    typedef std::function<bool(const T &)> predicate_t;
+
+    SubscriptionAwaitable(executor_t executor, subscribe_t subscribe, unsubscribe_t unsubscribe,
+                          predicate_t predicate = nullptr) :
+        _executor(std::move(executor)),
+        _subscribe(std::move(subscribe)),
+        _unsubscribe(std::move(unsubscribe)),
+        _state(std::make_shared<State>())
+    {
+        _state->predicate = std::move(predicate);
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        // Updates can still come after unsubscribing, so the callback keeps
+        // its own state alive. It is locked until the handle is known.
+        std::lock_guard<std::mutex> lock(_state->mutex);
+        auto state = _state;
+        auto executor = _executor;
+        _state->subscription = _subscribe([state, executor, handle](T value) {
+            if (state->predicate && !state->predicate(value)) {
+                return;
+            }
+            if (state->is_done.exchange(true)) {
+                return;
+            }
+            state->value.emplace(std::move(value));
+            executor([handle]() { handle.resume(); });
+        });
+    }
+
+    T await_resume()
+    {
+        std::lock_guard<std::mutex> lock(_state->mutex);
+        _unsubscribe(_state->subscription);
+        return std::move(*_state->value);
+    }
+
+private:
+    struct State {
+        std::mutex mutex {};
+        std::atomic<bool> is_done {false};
+        uint64_t subscription = 0;
+        predicate_t predicate {};
+        std::optional<T> value {};
+    };
+
+    executor_t _executor;
+    subscribe_t _subscribe;
+    unsubscribe_t _unsubscribe;
+    std::shared_ptr<State> _state;
+};
+
+} // namespace dronecore
@@ -1,7 +1,16 @@
 #include "call_every_handler.h"
+#include <chrono>
 
 namespace dronecore {
 
+// Unlike Time::shift_steady_time_by() this doesn't round to milliseconds,
+// otherwise e.g. a 30 Hz interval would drift by 1/3 ms on every call.
+static dl_time_t::duration to_duration(float interval_s)
+{
+    return std::chrono::duration_cast<dl_time_t::duration>(
+               std::chrono::duration<double>(double(interval_s)));
+}
+
 CallEveryHandler::CallEveryHandler(Time &time) :
     _time(time)
 {
@@ -11,18 +20,18 @@ CallEveryHandler::~CallEveryHandler()
 {
 }
 
-void CallEveryHandler::add(std::function<void()> callback, float interval_s, void **cookie)
+void CallEveryHandler::add(Callback<void()> callback, float interval_s, void **cookie)
 {
-    auto new_entry = std::make_shared<Entry>();
-    new_entry->callback = callback;
-    new_entry->last_time = _time.steady_time();
-    new_entry->interval_s = interval_s;
-
-    void *new_cookie = static_cast<void *>(new_entry.get());
-
+    void *new_cookie;
     {
         std::lock_guard<std::mutex> lock(_entries_mutex);
-        _entries.insert(std::pair<void *, std::shared_ptr<Entry>>(new_cookie, new_entry));
+
+        const size_t slot = _entries.add(Entry {std::move(callback),
+                                                _time.steady_time() + to_duration(interval_s),
+                                                interval_s,
+                                                Jitter {0, 0, 0.0, 0.0},
+                                                Usage {nullptr, 0.0f, 0, 0.0, 0.0}});
+        new_cookie = _entries.cookie_of(slot);
     }
 
     if (cookie != nullptr) {
@@ -34,9 +43,13 @@ void CallEveryHandler::change(float interval_s, const void *cookie)
 {
     std::lock_guard<std::mutex> lock(_entries_mutex);
 
-    auto it = _entries.find(const_cast<void *>(cookie));
-    if (it != _entries.end()) {
-        it->second->interval_s = interval_s;
+    size_t slot;
+    if (_entries.find(cookie, slot)) {
+        Entry &entry = _entries[slot];
+        // The next deadline is based on the last one with the new interval.
+        entry.deadline += to_duration(interval_s) - to_duration(entry.interval_s);
+        entry.interval_s = interval_s;
+        _entries.update(slot);
     }
 }
 
@@ -44,9 +57,11 @@ void CallEveryHandler::reset(const void *cookie)
 {
     std::lock_guard<std::mutex> lock(_entries_mutex);
 
-    auto it = _entries.find(const_cast<void *>(cookie));
-    if (it != _entries.end()) {
-        it->second->last_time = _time.steady_time();
+    size_t slot;
+    if (_entries.find(cookie, slot)) {
+        Entry &entry = _entries[slot];
+        entry.deadline = _time.cached_steady_time() + to_duration(entry.interval_s);
+        _entries.update(slot);
     }
 }
 
@@ -54,10 +69,9 @@ void CallEveryHandler::remove(const void *cookie)
 {
     std::lock_guard<std::mutex> lock(_entries_mutex);
 
-    auto it = _entries.find(const_cast<void *>(cookie));
-    if (it != _entries.end()) {
-        _entries.erase(const_cast<void *>(cookie));
-        _iterator_invalidated = true;
+    size_t slot;
+    if (_entries.find(cookie, slot)) {
+        _entries.remove(slot);
     }
 }
 
@@ -65,32 +79,124 @@ void CallEveryHandler::run_once()
 {
     _entries_mutex.lock();
 
-    for (auto it = _entries.begin(); it != _entries.end(); ++it) {
+    const dl_time_t now = _time.cached_steady_time();
 
-        if (_time.elapsed_since_s(it->second->last_time) > double(it->second->interval_s)) {
+    // Taken out of the member so that a run on another thread, or from within
+    // a callback, gets a buffer of its own.
+    std::vector<void *> due_cookies;
+    due_cookies.swap(_due_cookies);
+    due_cookies.clear();
 
-            _time.shift_steady_time_by(it->second->last_time, double(it->second->interval_s));
+    // Every entry is called at most once per run, even if the callback takes
+    // longer than its interval.
+    while (!_entries.empty() && _entries[_entries.front()].deadline <= now) {
 
-            if (it->second->callback) {
+        const size_t slot = _entries.front();
+        Entry &entry = _entries[slot];
 
-                // Get a copy for the callback because we unlock.
-                std::function<void()> callback = it->second->callback;
+        const double late_s =
+            std::chrono::duration<double>(now - entry.deadline).count();
 
-                // Unlock while we callback because it might in turn want to add timeouts.
-                _entries_mutex.unlock();
-                callback();
-                _entries_mutex.lock();
-            }
+        Jitter &jitter = entry.jitter;
+        ++jitter.num_calls;
+        jitter.mean_s += (late_s - jitter.mean_s) / jitter.num_calls;
+        if (late_s > jitter.max_s) {
+            jitter.max_s = late_s;
         }
 
-        // We leave the loop.
-        // FIXME: there should be a nicer way to do this.
-        if (_iterator_invalidated) {
-            _iterator_invalidated = false;
-            break;
+        // Move on to the next deadline. If we are more than one interval late,
+        // the missed calls are dropped instead of being done in a burst.
+        const dl_time_t::duration interval = to_duration(entry.interval_s);
+        entry.deadline += interval;
+        while (entry.deadline <= now && interval.count() > 0) {
+            entry.deadline += interval;
+            ++jitter.num_skipped;
+        }
+        if (entry.deadline <= now) {
+            // With an interval that is 0 or rounds down to 0, we would spin.
+            entry.deadline = now + std::chrono::milliseconds(1);
         }
+        _entries.update(slot);
+
+        due_cookies.push_back(_entries.cookie_of(slot));
+    }
+
+    for (const void *due_cookie : due_cookies) {
+        size_t slot;
+        // The entry might have been removed by an earlier callback meanwhile.
+        if (!_entries.find(due_cookie, slot) || !_entries[slot].callback) {
+            continue;
+        }
+
+        // Get a copy for the callback because we unlock.
+        Callback<void()> callback = _entries[slot].callback;
+
+        // Unlock while we callback because it might in turn want to add timeouts.
+        _entries_mutex.unlock();
+        const auto start = std::chrono::steady_clock::now();
+        callback();
+        const double busy_s = std::chrono::duration<double>(
+                                  std::chrono::steady_clock::now() - start).count();
+        _entries_mutex.lock();
+
+        if (_entries.find(due_cookie, slot)) {
+            Usage &usage = _entries[slot].usage;
+            ++usage.num_calls;
+            usage.total_s += busy_s;
+            if (busy_s > usage.max_s) {
+                usage.max_s = busy_s;
+            }
+        }
+    }
+
+    // Kept for the next run, unless one meanwhile kept its own.
+    if (_due_cookies.capacity() < due_cookies.capacity()) {
+        _due_cookies.swap(due_cookies);
     }
     _entries_mutex.unlock();
 }
 
+bool CallEveryHandler::next_deadline(dl_time_t &deadline)
+{
+    std::lock_guard<std::mutex> lock(_entries_mutex);
+
+    if (_entries.empty()) {
+        return false;
+    }
+    deadline = _entries[_entries.front()].deadline;
+    return true;
+}
+
+size_t CallEveryHandler::size()
+{
+    std::lock_guard<std::mutex> lock(_entries_mutex);
+    return _entries.size();
+}
+
+bool CallEveryHandler::get_jitter(const void *cookie, Jitter &jitter)
+{
+    std::lock_guard<std::mutex> lock(_entries_mutex);
+
+    size_t slot;
+    if (!_entries.find(cookie, slot)) {
+        return false;
+    }
+    jitter = _entries[slot].jitter;
+    return true;
+}
+
+std::vector<CallEveryHandler::Usage> CallEveryHandler::get_usages()
+{
+    std::lock_guard<std::mutex> lock(_entries_mutex);
+
+    std::vector<Usage> usages;
+    _entries.for_each([this, &usages](size_t slot, const Entry & entry) {
+        Usage usage = entry.usage;
+        usage.cookie = _entries.cookie_of(slot);
+        usage.interval_s = entry.interval_s;
+        usages.push_back(usage);
+    });
+    return usages;
+}
+
 } // namespace dronecore
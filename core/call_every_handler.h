@@ -1,10 +1,12 @@
 #pragma once
 
 #include <mutex>
-#include <memory>
+#include <cstdint>
 #include <functional>
-#include <map>
+#include <vector>
+#include "deadline_heap.h"
 #include "global_include.h"
+#include "inplace_function.h"
 
 namespace dronecore {
 
@@ -20,23 +22,58 @@ public:
     CallEveryHandler &operator=(CallEveryHandler const &) = delete; // Copy assign
     CallEveryHandler &operator=(CallEveryHandler &&) = delete;      // Move assign
 
-    void add(std::function<void()> callback, float interval_s, void **cookie);
+    // Calls happen on absolute deadlines, each one interval after the previous
+    // deadline, so that they don't drift no matter how late run_once() is.
+    // The cookie is an opaque handle which is never reused.
+    void add(Callback<void()> callback, float interval_s, void **cookie);
     void change(float interval_s, const void *cookie);
     void reset(const void *cookie);
     void remove(const void *cookie);
 
     void run_once();
 
+    // Returns false if there are no entries.
+    bool next_deadline(dl_time_t &deadline);
+
+    size_t size();
+
+    // How late the calls were compared to their deadlines.
+    struct Jitter {
+        unsigned num_calls;
+        unsigned num_skipped;
+        double mean_s;
+        double max_s;
+    };
+
+    bool get_jitter(const void *cookie, Jitter &jitter);
+
+    // Time spent in the callback of an entry, on the clock rather than the
+    // time given, as it is about the thread calling it.
+    struct Usage {
+        const void *cookie;
+        float interval_s;
+        unsigned num_calls;
+        double total_s;
+        double max_s;
+    };
+
+    // Of all entries, in no particular order.
+    std::vector<Usage> get_usages();
+
 private:
     struct Entry {
-        std::function<void()> callback;
-        dl_time_t last_time;
+        Callback<void()> callback;
+        dl_time_t deadline;
         float interval_s;
+        Jitter jitter;
+        Usage usage;
     };
 
-    std::map<void *, std::shared_ptr<Entry>> _entries {};
+    DeadlineHeap<Entry> _entries {};
     std::mutex _entries_mutex {};
-    bool _iterator_invalidated {false};
+    // Cookies of the entries due in run_once(), kept so that it doesn't
+    // allocate on every run.
+    std::vector<void *> _due_cookies {};
 
     Time &_time;
 };
@@ -1,6 +1,8 @@
 #include "call_every_handler.h"
 #include <gtest/gtest.h>
 #include <atomic>
+#include <chrono>
+#include <thread>
 #include "log.h"
 
 #ifdef FAKE_TIME
@@ -130,3 +132,108 @@ TEST(CallEveryHandler, Reset)
     }
     EXPECT_EQ(num_called, 1);
 }
+
+TEST(CallEveryHandler, DoesNotDrift)
+{
+    Time time {};
+    CallEveryHandler ceh(time);
+
+    int num_called = 0;
+
+    void *cookie = nullptr;
+    ceh.add([&num_called]() { ++num_called; }, 0.05f, &cookie);
+
+    // Checking late every time must not accumulate into missed calls.
+    for (int i = 0; i < 100; ++i) {
+        time.sleep_for(std::chrono::milliseconds(5));
+        ceh.run_once();
+    }
+    EXPECT_EQ(num_called, 10);
+
+    CallEveryHandler::Jitter jitter;
+    ASSERT_TRUE(ceh.get_jitter(cookie, jitter));
+    EXPECT_EQ(jitter.num_calls, 10u);
+    EXPECT_EQ(jitter.num_skipped, 0u);
+    // We only look every 5 ms, so that is how late it can be.
+    EXPECT_LE(jitter.max_s, 0.006);
+}
+
+TEST(CallEveryHandler, SkipsMissedCalls)
+{
+    Time time {};
+    CallEveryHandler ceh(time);
+
+    int num_called = 0;
+
+    void *cookie = nullptr;
+    ceh.add([&num_called]() { ++num_called; }, 0.1f, &cookie);
+
+    // We're very late, this should give one call instead of a burst.
+    time.sleep_for(std::chrono::milliseconds(550));
+    ceh.run_once();
+    EXPECT_EQ(num_called, 1);
+
+    CallEveryHandler::Jitter jitter;
+    ASSERT_TRUE(ceh.get_jitter(cookie, jitter));
+    EXPECT_EQ(jitter.num_skipped, 4u);
+
+    // And we're back on the original schedule.
+    time.sleep_for(std::chrono::milliseconds(30));
+    ceh.run_once();
+    EXPECT_EQ(num_called, 1);
+    time.sleep_for(std::chrono::milliseconds(30));
+    ceh.run_once();
+    EXPECT_EQ(num_called, 2);
+}
+
+TEST(CallEveryHandler, RemoveOtherDuringCallback)
+{
+    Time time {};
+    CallEveryHandler ceh(time);
+
+    int num_called = 0;
+
+    void *cookie1 = nullptr;
+    void *cookie2 = nullptr;
+    ceh.add([&]() {
+        ++num_called;
+        ceh.remove(cookie2);
+    }, 0.1f, &cookie1);
+    ceh.add([&num_called]() { ++num_called; }, 0.1f, &cookie2);
+
+    time.sleep_for(std::chrono::milliseconds(110));
+    ceh.run_once();
+    EXPECT_EQ(num_called, 1);
+
+    CallEveryHandler::Jitter jitter;
+    EXPECT_FALSE(ceh.get_jitter(cookie2, jitter));
+}
+
+TEST(CallEveryHandler, CountsTimeInCallback)
+{
+    Time time {};
+    CallEveryHandler ceh(time);
+
+    void *cookie = nullptr;
+    ceh.add([]() {
+        // On the real clock, which is what the usage is counted on.
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }, 0.1f, &cookie);
+
+    for (int i = 0; i < 3; ++i) {
+        time.sleep_for(std::chrono::milliseconds(100));
+        ceh.run_once();
+    }
+
+    const auto usages = ceh.get_usages();
+    ASSERT_EQ(usages.size(), 1u);
+    EXPECT_EQ(usages[0].cookie, cookie);
+    EXPECT_FLOAT_EQ(usages[0].interval_s, 0.1f);
+    EXPECT_EQ(usages[0].num_calls, 3u);
+    EXPECT_GE(usages[0].total_s, 0.006);
+    EXPECT_GE(usages[0].max_s, 0.002);
+    EXPECT_LE(usages[0].max_s, usages[0].total_s);
+
+    ceh.remove(cookie);
+    EXPECT_TRUE(ceh.get_usages().empty());
+}
@@ -0,0 +1,229 @@
+#include "callback_executor.h"
+#include "message_tracer.h"
+#include "thread_roles.h"
+#include "trace_recorder.h"
+#include <algorithm>
+
+namespace dronecore {
+
+constexpr size_t CallbackExecutor::DROP_OLDEST_QUEUE_LEN;
+constexpr size_t CallbackExecutor::BLOCK_QUEUE_LEN;
+constexpr size_t CallbackExecutor::TASK_LEN;
+
+// The strand whose work the current thread is running, if any.
+static thread_local const void *running_strand = nullptr;
+
+CallbackExecutor::CallbackExecutor() {}
+
+CallbackExecutor::~CallbackExecutor()
+{
+    std::vector<std::shared_ptr<Strand>> strands;
+    {
+        std::lock_guard<std::mutex> lock(_strands_mutex);
+        for (auto &key_and_strand : _strands) {
+            strands.push_back(key_and_strand.second);
+        }
+        _strands.clear();
+    }
+    for (auto &strand : strands) {
+        cancel_strand(*strand);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_ready_mutex);
+        _should_exit = true;
+    }
+    _ready_cv.notify_all();
+
+    std::lock_guard<std::mutex> lock(_thread_mutex);
+    for (auto thread : _threads) {
+        thread->join();
+        delete thread;
+    }
+    _threads.clear();
+}
+
+void CallbackExecutor::set_executor(executor_t executor)
+{
+    std::lock_guard<std::mutex> lock(_strands_mutex);
+    _executor = executor;
+}
+
+void CallbackExecutor::set_num_threads(unsigned num_threads)
+{
+    std::lock_guard<std::mutex> lock(_thread_mutex);
+    _num_threads = std::max(num_threads, _num_threads);
+}
+
+void CallbackExecutor::post(const void *owner, const void *topic, task_t task,
+                            Overflow overflow)
+{
+    std::shared_ptr<Strand> strand;
+    executor_t executor;
+    {
+        std::lock_guard<std::mutex> lock(_strands_mutex);
+        std::shared_ptr<Strand> &entry = _strands[std::make_pair(owner, topic)];
+        if (!entry) {
+            entry = std::make_shared<Strand>();
+        }
+        strand = entry;
+        executor = _executor;
+    }
+
+    const size_t max_len = (overflow == Overflow::DROP_OLDEST) ?
+                           DROP_OLDEST_QUEUE_LEN : BLOCK_QUEUE_LEN;
+
+    std::unique_lock<std::mutex> lock(strand->mutex);
+    if (strand->queue.size() >= max_len) {
+        if (overflow == Overflow::DROP_OLDEST) {
+            strand->queue.pop_front();
+            ++_num_dropped;
+        } else if (running_strand == nullptr) {
+            // A callback posting more work can't wait, it might hold up the
+            // very thread which would make room. The queue gets longer instead.
+            strand->cv.wait(lock, [&strand, max_len]() {
+                return strand->queue.size() < max_len || strand->cancelled;
+            });
+        }
+    }
+    if (strand->cancelled) {
+        return;
+    }
+
+    strand->queue.push_back(MessageTracer::wrap_callback(std::move(task)));
+
+    if (!strand->scheduled) {
+        strand->scheduled = true;
+        strand->executor = executor;
+        lock.unlock();
+        if (executor) {
+            executor([strand]() { run_strand_on_executor(strand); });
+        } else {
+            submit_to_work_queue(std::move(strand));
+        }
+    }
+}
+
+void CallbackExecutor::cancel(const void *owner)
+{
+    std::vector<std::shared_ptr<Strand>> strands;
+    {
+        std::lock_guard<std::mutex> lock(_strands_mutex);
+        auto it = _strands.lower_bound(std::make_pair(owner, static_cast<const void *>(nullptr)));
+        while (it != _strands.end() && it->first.first == owner) {
+            strands.push_back(it->second);
+            it = _strands.erase(it);
+        }
+    }
+    for (auto &strand : strands) {
+        cancel_strand(*strand);
+    }
+}
+
+uint64_t CallbackExecutor::num_dropped() const
+{
+    return _num_dropped;
+}
+
+bool CallbackExecutor::run_strand(Strand &strand)
+{
+    // Work of other strands gets a turn after this many, even if there is more.
+    constexpr unsigned max_work_per_run = 16;
+
+    std::unique_lock<std::mutex> lock(strand.mutex);
+    for (unsigned i = 0; i < max_work_per_run && !strand.queue.empty() && !strand.cancelled;
+         ++i) {
+        task_t task = strand.queue.pop_front();
+        strand.running = true;
+        lock.unlock();
+        // Wake up any poster waiting for room.
+        strand.cv.notify_all();
+
+        const void *previous_strand = running_strand;
+        running_strand = &strand;
+        {
+            TraceScope scope("callback", "callback");
+            task();
+        }
+        running_strand = previous_strand;
+
+        lock.lock();
+        strand.running = false;
+        strand.cv.notify_all();
+    }
+
+    if (strand.queue.empty() || strand.cancelled) {
+        strand.scheduled = false;
+        return false;
+    }
+    return true;
+}
+
+void CallbackExecutor::run_strand_on_executor(std::shared_ptr<Strand> strand)
+{
+    if (!run_strand(*strand)) {
+        return;
+    }
+
+    executor_t executor;
+    {
+        std::lock_guard<std::mutex> lock(strand->mutex);
+        executor = strand->executor;
+    }
+    executor([strand]() { run_strand_on_executor(strand); });
+}
+
+void CallbackExecutor::cancel_strand(Strand &strand)
+{
+    std::unique_lock<std::mutex> lock(strand.mutex);
+    strand.cancelled = true;
+    strand.queue.clear();
+    strand.cv.notify_all();
+
+    // A callback cancelling its own owner can't wait for itself.
+    if (running_strand != &strand) {
+        strand.cv.wait(lock, [&strand]() { return !strand.running; });
+    }
+}
+
+void CallbackExecutor::submit_to_work_queue(std::shared_ptr<Strand> strand)
+{
+    {
+        // The threads are only started once somebody uses them.
+        std::lock_guard<std::mutex> lock(_thread_mutex);
+        while (_threads.size() < _num_threads) {
+            _threads.push_back(new std::thread(&CallbackExecutor::run_work_queue, this));
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(_ready_mutex);
+        _ready.push_back(std::move(strand));
+    }
+    _ready_cv.notify_one();
+}
+
+void CallbackExecutor::run_work_queue()
+{
+    ThreadRoles::apply_to_this_thread(DroneCore::ThreadRole::CALLBACK, "callbacks");
+
+    std::unique_lock<std::mutex> lock(_ready_mutex);
+    // Once stopped, what is still scheduled is done first.
+    while (true) {
+        _ready_cv.wait(lock, [this]() { return !_ready.empty() || _should_exit; });
+        if (_ready.empty()) {
+            return;
+        }
+        std::shared_ptr<Strand> strand = _ready.pop_front();
+        lock.unlock();
+
+        const bool has_more = run_strand(*strand);
+
+        lock.lock();
+        if (has_more) {
+            // To the back, so that the other strands get their turn.
+            _ready.push_back(std::move(strand));
+        }
+    }
+}
+
+} // namespace dronecore
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "inplace_function.h"
+#include "ring_queue.h"
+
+namespace dronecore {
+
+// Runs user callbacks away from the receive thread, so that a slow callback
+// does not hold up parsing.
+//
+// Work is posted for an owner (usually a plugin of one system) and a topic.
+// Work of the same owner and topic runs in the order it was posted and never
+// concurrently, other work may run in parallel. The work itself is run by the
+// threads of the built-in work queue, or by an executor set by the user.
+//
+// With the built-in work queue, posting and running callbacks whose captures
+// fit into a task_t doesn't allocate once the queues have grown.
+class CallbackExecutor
+{
+public:
+    typedef std::function<void()> work_t;
+    typedef std::function<void(work_t)> executor_t;
+
+    // Big enough for a telemetry sample and the list it goes to.
+    static constexpr size_t TASK_LEN = 64;
+    typedef InplaceFunction<void(), TASK_LEN> task_t;
+
+    // What to do if work is posted to a full queue.
+    enum class Overflow {
+        DROP_OLDEST, // For telemetry, where only the latest value matters.
+        BLOCK // For events, waits until the callbacks have caught up.
+    };
+
+    static constexpr size_t DROP_OLDEST_QUEUE_LEN = 16;
+    static constexpr size_t BLOCK_QUEUE_LEN = 256;
+
+    CallbackExecutor();
+    ~CallbackExecutor();
+
+    // Uses executor instead of the built-in work queue. It can run the work on
+    // any thread but has to run all of it eventually. nullptr switches back.
+    void set_executor(executor_t executor);
+
+    // Threads of the built-in work queue, one by default. They are shared by
+    // all systems, so that many of them don't need a thread each. The number
+    // can only be raised, threads already started keep running.
+    void set_num_threads(unsigned num_threads);
+
+    void post(const void *owner, const void *topic, task_t task,
+              Overflow overflow = Overflow::DROP_OLDEST);
+
+    // Drops the work of owner which has not started yet and waits for the
+    // one running. Once this returns, nothing posted before is run anymore.
+    void cancel(const void *owner);
+
+    uint64_t num_dropped() const;
+
+    // Non-copyable
+    CallbackExecutor(const CallbackExecutor &) = delete;
+    const CallbackExecutor &operator=(const CallbackExecutor &) = delete;
+
+private:
+    // Queue of one owner and topic. It is scheduled on the executor at most
+    // once at a time, which keeps its work in order.
+    struct Strand {
+        std::mutex mutex {};
+        std::condition_variable cv {};
+        RingQueue<task_t> queue {};
+        bool scheduled = false;
+        bool running = false;
+        bool cancelled = false;
+        // Empty for the built-in work queue.
+        executor_t executor {};
+    };
+
+    // Returns true if the strand has more work and has to be scheduled again.
+    static bool run_strand(Strand &strand);
+    static void run_strand_on_executor(std::shared_ptr<Strand> strand);
+    static void cancel_strand(Strand &strand);
+
+    void submit_to_work_queue(std::shared_ptr<Strand> strand);
+    void run_work_queue();
+
+    std::mutex _strands_mutex {};
+    std::map<std::pair<const void *, const void *>, std::shared_ptr<Strand>> _strands {};
+    executor_t _executor {};
+
+    std::mutex _thread_mutex {};
+    std::vector<std::thread *> _threads {};
+    unsigned _num_threads = 1;
+
+    // The strands scheduled on the built-in work queue, each one is in there
+    // at most once.
+    std::mutex _ready_mutex {};
+    std::condition_variable _ready_cv {};
+    RingQueue<std::shared_ptr<Strand>> _ready {};
+    bool _should_exit = false;
+
+    std::atomic<uint64_t> _num_dropped {0};
+};
+
+} // namespace dronecore
@@ -0,0 +1,194 @@
+#include "callback_executor.h"
+#include "allocation_counter.h"
+#include <gtest/gtest.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+using namespace dronecore;
+
+TEST(CallbackExecutor, KeepsOrderOfTopic)
+{
+    CallbackExecutor executor;
+    int owner;
+    int topic;
+
+    std::vector<int> values;
+    std::promise<void> done;
+    for (int i = 0; i < 10; ++i) {
+        executor.post(&owner, &topic, [&values, &done, i]() {
+            values.push_back(i);
+            if (i == 9) {
+                done.set_value();
+            }
+        }, CallbackExecutor::Overflow::BLOCK);
+    }
+
+    ASSERT_EQ(done.get_future().wait_for(std::chrono::seconds(1)), std::future_status::ready);
+    ASSERT_EQ(values.size(), 10u);
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_EQ(values[i], i);
+    }
+    EXPECT_EQ(executor.num_dropped(), 0u);
+}
+
+TEST(CallbackExecutor, DropsOldestWhenFull)
+{
+    CallbackExecutor executor;
+    int owner;
+    int blocked_topic;
+    int topic;
+
+    // Stall the worker thread, so that nothing gets run meanwhile.
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    executor.post(&owner, &blocked_topic, [released]() { released.wait(); });
+
+    std::vector<size_t> values;
+    const size_t num_posted = CallbackExecutor::DROP_OLDEST_QUEUE_LEN + 5;
+    for (size_t i = 0; i < num_posted; ++i) {
+        executor.post(&owner, &topic, [&values, i]() { values.push_back(i); });
+    }
+    EXPECT_EQ(executor.num_dropped(), 5u);
+
+    // One more tells when the others have run, it pushes out another one.
+    std::promise<void> done;
+    executor.post(&owner, &topic, [&done]() { done.set_value(); });
+    EXPECT_EQ(executor.num_dropped(), 6u);
+
+    release.set_value();
+    ASSERT_EQ(done.get_future().wait_for(std::chrono::seconds(1)), std::future_status::ready);
+
+    ASSERT_EQ(values.size(), CallbackExecutor::DROP_OLDEST_QUEUE_LEN - 1);
+    EXPECT_EQ(values.front(), 6u);
+    EXPECT_EQ(values.back(), num_posted - 1);
+}
+
+TEST(CallbackExecutor, CancelDropsQueuedWork)
+{
+    CallbackExecutor executor;
+    int owner;
+    int other_owner;
+    int topic;
+
+    std::promise<void> started;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    executor.post(&other_owner, &topic, [&started, released]() {
+        started.set_value();
+        released.wait();
+    });
+    started.get_future().wait();
+
+    std::atomic<int> num_called {0};
+    executor.post(&owner, &topic, [&num_called]() { ++num_called; });
+    executor.cancel(&owner);
+
+    release.set_value();
+    executor.cancel(&other_owner);
+
+    EXPECT_EQ(num_called, 0);
+}
+
+TEST(CallbackExecutor, UsesUserExecutor)
+{
+    CallbackExecutor executor;
+    int owner;
+    int topic;
+
+    std::vector<CallbackExecutor::work_t> submitted;
+    executor.set_executor([&submitted](CallbackExecutor::work_t work) {
+        submitted.push_back(work);
+    });
+
+    int num_called = 0;
+    executor.post(&owner, &topic, [&num_called]() { ++num_called; });
+    executor.post(&owner, &topic, [&num_called]() { ++num_called; });
+
+    // Both are run by the one submitted strand run.
+    ASSERT_EQ(submitted.size(), 1u);
+    EXPECT_EQ(num_called, 0);
+    submitted[0]();
+    EXPECT_EQ(num_called, 2);
+}
+
+TEST(CallbackExecutor, RunsOwnersInParallelWithMoreThreads)
+{
+    CallbackExecutor executor;
+    executor.set_num_threads(2);
+    int stalled_owner;
+    int owner;
+    int topic;
+
+    // One thread is held up by the first owner, the other one keeps going.
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    executor.post(&stalled_owner, &topic, [released]() { released.wait(); });
+
+    std::vector<int> values;
+    std::promise<void> done;
+    for (int i = 0; i < 10; ++i) {
+        executor.post(&owner, &topic, [&values, &done, i]() {
+            values.push_back(i);
+            if (i == 9) {
+                done.set_value();
+            }
+        }, CallbackExecutor::Overflow::BLOCK);
+    }
+
+    EXPECT_EQ(done.get_future().wait_for(std::chrono::seconds(1)), std::future_status::ready);
+    release.set_value();
+
+    ASSERT_EQ(values.size(), 10u);
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_EQ(values[i], i);
+    }
+}
+
+TEST(CallbackExecutor, DoesNotAllocateOnceWarmedUp)
+{
+    CallbackExecutor executor;
+    int owner;
+    int topic;
+
+    // About what a telemetry update captures.
+    const std::array<double, 6> value {{1.0, 2.0, 3.0, 4.0, 5.0, 6.0}};
+    std::atomic<unsigned> num_called {0};
+    auto post = [&]() {
+        executor.post(&owner, &topic, [&num_called, value]() {
+            AllocationCounter::count_this_thread();
+            num_called += (value[5] > 0.0) ? 1 : 0;
+        }, CallbackExecutor::Overflow::BLOCK);
+    };
+
+    // Fills the queue up once while the first one is stuck, so that it has
+    // grown as long as it ever gets.
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    executor.post(&owner, &topic, [released]() { released.wait(); },
+                  CallbackExecutor::Overflow::BLOCK);
+    for (size_t i = 0; i < CallbackExecutor::BLOCK_QUEUE_LEN; ++i) {
+        post();
+    }
+    release.set_value();
+
+    const unsigned num_warm_up = CallbackExecutor::BLOCK_QUEUE_LEN;
+    while (num_called < num_warm_up) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    AllocationCounter::reset();
+    AllocationCounter::count_this_thread();
+    for (unsigned i = 0; i < 1000; ++i) {
+        post();
+    }
+    AllocationCounter::stop_counting_this_thread();
+
+    while (num_called < num_warm_up + 1000) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(AllocationCounter::num_allocations(), 0u);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace dronecore {
+
+typedef uint64_t callback_handle_t;
+
+// Handles are unique across all lists, so that a handle can be given back
+// without saying which list it came from.
+inline callback_handle_t next_callback_handle()
+{
+    static std::atomic<callback_handle_t> next_handle {1};
+    return next_handle++;
+}
+
+// List of callbacks which all get the same value. The list is copy-on-write,
+// so calling is lock-free and a callback can add or remove callbacks, including
+// itself, while it is being called.
+template<typename... Args>
+class CallbackList
+{
+public:
+    typedef std::function<void(Args...)> callback_t;
+
+    CallbackList() = default;
+    ~CallbackList() = default;
+
+    callback_handle_t add(callback_t callback)
+    {
+        const callback_handle_t handle = next_callback_handle();
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto entries = std::make_shared<Entries>(*std::atomic_load(&_entries));
+        entries->push_back(Entry {handle, callback});
+        std::atomic_store(&_entries, std::shared_ptr<const Entries>(entries));
+
+        return handle;
+    }
+
+    bool remove(callback_handle_t handle)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto entries = std::make_shared<Entries>(*std::atomic_load(&_entries));
+        for (auto it = entries->begin(); it != entries->end(); ++it) {
+            if (it->handle == handle) {
+                entries->erase(it);
+                std::atomic_store(&_entries, std::shared_ptr<const Entries>(entries));
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::atomic_store(&_entries, std::make_shared<const Entries>());
+    }
+
+    // Cheap enough to check before computing the value to call with.
+    bool empty() const
+    {
+        return std::atomic_load(&_entries)->empty();
+    }
+
+    void operator()(Args... args) const
+    {
+        const std::shared_ptr<const Entries> entries = std::atomic_load(&_entries);
+        for (const auto &entry : *entries) {
+            entry.callback(args...);
+        }
+    }
+
+    // Non-copyable
+    CallbackList(const CallbackList &) = delete;
+    const CallbackList &operator=(const CallbackList &) = delete;
+
+private:
+    struct Entry {
+        callback_handle_t handle;
+        callback_t callback;
+    };
+    typedef std::vector<Entry> Entries;
+
+    std::mutex _mutex {};
+    std::shared_ptr<const Entries> _entries {std::make_shared<const Entries>()};
+};
+
+} // namespace dronecore
@@ -0,0 +1,68 @@
+#include "callback_list.h"
+#include <gtest/gtest.h>
+
+using namespace dronecore;
+
+TEST(CallbackList, CallsAll)
+{
+    CallbackList<int> callbacks;
+    EXPECT_TRUE(callbacks.empty());
+
+    int sum_first = 0;
+    int sum_second = 0;
+    callbacks.add([&sum_first](int value) { sum_first += value; });
+    callbacks.add([&sum_second](int value) { sum_second += value; });
+    EXPECT_FALSE(callbacks.empty());
+
+    callbacks(3);
+    EXPECT_EQ(sum_first, 3);
+    EXPECT_EQ(sum_second, 3);
+}
+
+TEST(CallbackList, Remove)
+{
+    CallbackList<int> callbacks;
+
+    int num_first = 0;
+    int num_second = 0;
+    callback_handle_t first = callbacks.add([&num_first](int) { ++num_first; });
+    callbacks.add([&num_second](int) { ++num_second; });
+
+    EXPECT_TRUE(callbacks.remove(first));
+    EXPECT_FALSE(callbacks.remove(first));
+
+    callbacks(0);
+    EXPECT_EQ(num_first, 0);
+    EXPECT_EQ(num_second, 1);
+
+    callbacks.clear();
+    EXPECT_TRUE(callbacks.empty());
+}
+
+TEST(CallbackList, HandlesAreUniqueAcrossLists)
+{
+    CallbackList<int> ints;
+    CallbackList<bool> bools;
+
+    callback_handle_t int_handle = ints.add([](int) {});
+    callback_handle_t bool_handle = bools.add([](bool) {});
+
+    EXPECT_NE(int_handle, bool_handle);
+    EXPECT_FALSE(ints.remove(bool_handle));
+}
+
+TEST(CallbackList, RemoveItselfDuringCall)
+{
+    CallbackList<int> callbacks;
+
+    int num_calls = 0;
+    callback_handle_t handle = 0;
+    handle = callbacks.add([&](int) {
+        ++num_calls;
+        callbacks.remove(handle);
+    });
+
+    callbacks(0);
+    callbacks(0);
+    EXPECT_EQ(num_calls, 1);
+}
@@ -0,0 +1,219 @@
+#include "column_file.h"
+#include "global_include.h"
+#include "log.h"
+
+#ifndef WINDOWS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace dronecore {
+
+constexpr uint32_t ColumnFile::VERSION;
+constexpr uint32_t ColumnFile::ROWS_PER_BLOCK;
+constexpr size_t ColumnFile::HEADER_FIXED_LEN;
+constexpr size_t ColumnFile::COLUMN_DESCRIPTION_LEN;
+constexpr size_t ColumnFile::BLOCK_HEADER_LEN;
+constexpr size_t ColumnFile::BLOCKS_PER_GROWTH;
+
+namespace {
+
+size_t type_size(ColumnFile::Type type)
+{
+    return (type == ColumnFile::Type::DOUBLE) ? sizeof(double) : sizeof(float);
+}
+
+template<typename T>
+void write_at(uint8_t *destination, const T &value)
+{
+    memcpy(destination, &value, sizeof(value));
+}
+
+} // namespace
+
+ColumnFile::ColumnFile() {}
+
+ColumnFile::~ColumnFile()
+{
+    close();
+}
+
+bool ColumnFile::open(const std::string &path, const std::vector<Column> &columns)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    close_locked();
+
+#ifdef WINDOWS
+    UNUSED(path);
+    UNUSED(columns);
+    LogErr() << "Memory-mapped recording is not supported on Windows";
+    return false;
+#else
+    _fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (_fd < 0) {
+        LogErr() << "Could not create " << path << ": " << strerror(errno);
+        return false;
+    }
+
+    _columns = columns;
+    _column_offsets.clear();
+    size_t offset = BLOCK_HEADER_LEN + sizeof(uint64_t) * ROWS_PER_BLOCK;
+    for (const auto &column : _columns) {
+        _column_offsets.push_back(offset);
+        offset += type_size(column.type) * ROWS_PER_BLOCK;
+    }
+
+    if (!map(header_len() + BLOCKS_PER_GROWTH * block_len())) {
+        ::close(_fd);
+        _fd = -1;
+        return false;
+    }
+
+    memcpy(_mapping, "DCCF", 4);
+    write_at(_mapping + 4, VERSION);
+    write_at(_mapping + 8, uint32_t(_columns.size()));
+    write_at(_mapping + 12, ROWS_PER_BLOCK);
+
+    uint8_t *description = _mapping + HEADER_FIXED_LEN;
+    for (const auto &column : _columns) {
+        // The mapping of a new file is zeroed, so the name is always terminated.
+        memcpy(description, column.name.c_str(),
+               std::min(column.name.size(), COLUMN_DESCRIPTION_LEN - 2));
+        description[COLUMN_DESCRIPTION_LEN - 1] = uint8_t(column.type);
+        description += COLUMN_DESCRIPTION_LEN;
+    }
+
+    _num_rows = 0;
+    _open = true;
+    return true;
+#endif
+}
+
+void ColumnFile::close()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    close_locked();
+}
+
+void ColumnFile::append(uint64_t time_us, const double *values)
+{
+    // No need to lock if nothing is recorded.
+    if (!_open) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_open) {
+        return;
+    }
+
+    const size_t block = size_t(_num_rows / ROWS_PER_BLOCK);
+    const uint32_t row = uint32_t(_num_rows % ROWS_PER_BLOCK);
+    const size_t block_offset = header_len() + block * block_len();
+
+    if (block_offset + block_len() > _mapping_len) {
+        const size_t new_len = _mapping_len + BLOCKS_PER_GROWTH * block_len();
+        unmap();
+        if (!map(new_len)) {
+            close_locked();
+            return;
+        }
+    }
+
+    uint8_t *data = _mapping + block_offset;
+    if (row == 0) {
+        memcpy(data, "DCBK", 4);
+        write_at(data + 8, time_us);
+    }
+    write_at(data + 16, time_us);
+    write_at(data + BLOCK_HEADER_LEN + row * sizeof(uint64_t), time_us);
+
+    for (size_t i = 0; i < _columns.size(); ++i) {
+        if (_columns[i].type == Type::DOUBLE) {
+            write_at(data + _column_offsets[i] + row * sizeof(double), values[i]);
+        } else {
+            write_at(data + _column_offsets[i] + row * sizeof(float), float(values[i]));
+        }
+    }
+
+    // Only count the row once it is complete.
+    write_at(data + 4, uint32_t(row + 1));
+    ++_num_rows;
+}
+
+bool ColumnFile::map(size_t len)
+{
+    // We assume that we already acquired _mutex in this function.
+#ifdef WINDOWS
+    UNUSED(len);
+    return false;
+#else
+    if (ftruncate(_fd, off_t(len)) != 0) {
+        LogErr() << "Could not grow recording: " << strerror(errno);
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (mapping == MAP_FAILED) {
+        LogErr() << "Could not map recording: " << strerror(errno);
+        return false;
+    }
+
+    _mapping = static_cast<uint8_t *>(mapping);
+    _mapping_len = len;
+    return true;
+#endif
+}
+
+void ColumnFile::unmap()
+{
+    // We assume that we already acquired _mutex in this function.
+#ifndef WINDOWS
+    if (_mapping != nullptr) {
+        munmap(_mapping, _mapping_len);
+    }
+#endif
+    _mapping = nullptr;
+    _mapping_len = 0;
+}
+
+void ColumnFile::close_locked()
+{
+    // We assume that we already acquired _mutex in this function.
+    _open = false;
+    unmap();
+
+    if (_fd < 0) {
+        return;
+    }
+
+#ifndef WINDOWS
+    const size_t num_blocks = size_t((_num_rows + ROWS_PER_BLOCK - 1) / ROWS_PER_BLOCK);
+    if (ftruncate(_fd, off_t(header_len() + num_blocks * block_len())) != 0) {
+        LogWarn() << "Could not cut recording to size: " << strerror(errno);
+    }
+    ::close(_fd);
+#endif
+    _fd = -1;
+}
+
+size_t ColumnFile::block_len() const
+{
+    size_t len = BLOCK_HEADER_LEN + sizeof(uint64_t) * ROWS_PER_BLOCK;
+    for (const auto &column : _columns) {
+        len += type_size(column.type) * ROWS_PER_BLOCK;
+    }
+    return len;
+}
+
+size_t ColumnFile::header_len() const
+{
+    return HEADER_FIXED_LEN + COLUMN_DESCRIPTION_LEN * _columns.size();
+}
+
+} // namespace dronecore
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace dronecore {
+
+// Appends fixed-width records to a memory-mapped file, laid out column by
+// column in blocks of ROWS_PER_BLOCK records. Appending is a copy into the
+// mapping; the file is only grown, and the mapping renewed, every few blocks.
+//
+// File layout, in host byte order (little endian on all supported platforms):
+//   Header:  magic "DCCF", version (u32), number of columns (u32),
+//            rows per block (u32), then per column: name (char[31]) and
+//            type (u8, 'f' for float, 'd' for double).
+//   Blocks:  magic "DCBK", number of rows (u32), first time (u64),
+//            last time (u64), then the time column (u64 per row) and all
+//            other columns, each with space for ROWS_PER_BLOCK rows.
+//
+// All blocks have the same size, so a reader can jump to any block and search
+// the block headers by time without reading the columns. The row count of the
+// last block is updated on every append, so a recording is readable up to the
+// last record even if it was never closed.
+//
+// It is safe to append from one thread while another one opens or closes.
+class ColumnFile
+{
+public:
+    enum class Type : uint8_t {
+        FLOAT = 'f',
+        DOUBLE = 'd'
+    };
+
+    struct Column {
+        std::string name;
+        Type type;
+    };
+
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t ROWS_PER_BLOCK = 1024;
+    static constexpr size_t HEADER_FIXED_LEN = 16;
+    static constexpr size_t COLUMN_DESCRIPTION_LEN = 32;
+    static constexpr size_t BLOCK_HEADER_LEN = 24;
+
+    ColumnFile();
+    ~ColumnFile();
+
+    // Creates or truncates the file at path. Returns false if the file could not
+    // be created or memory-mapped files are not supported on this platform.
+    bool open(const std::string &path, const std::vector<Column> &columns);
+    // Cuts the file to what was written and unmaps it.
+    void close();
+    bool is_open() const { return _open; }
+
+    // Takes one value per column in the order given by open(). Values of
+    // float columns are narrowed. Does nothing if the file is not open.
+    void append(uint64_t time_us, const double *values);
+
+    // Non-copyable
+    ColumnFile(const ColumnFile &) = delete;
+    const ColumnFile &operator=(const ColumnFile &) = delete;
+
+private:
+    static constexpr size_t BLOCKS_PER_GROWTH = 16;
+
+    bool map(size_t len);
+    void unmap();
+    void close_locked();
+    size_t block_len() const;
+    size_t header_len() const;
+
+    std::mutex _mutex {};
+    std::atomic<bool> _open {false};
+    int _fd = -1;
+    uint8_t *_mapping = nullptr;
+    size_t _mapping_len = 0;
+
+    std::vector<Column> _columns {};
+    // Byte offset of each column after the time column inside a block.
+    std::vector<size_t> _column_offsets {};
+    uint64_t _num_rows = 0;
+};
+
+} // namespace dronecore
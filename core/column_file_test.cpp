@@ -0,0 +1,81 @@
+#include "column_file.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+using namespace dronecore;
+
+namespace {
+
+std::vector<uint8_t> read_file(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file),
+                                std::istreambuf_iterator<char>());
+}
+
+template<typename T>
+T read_at(const std::vector<uint8_t> &data, size_t offset)
+{
+    T value;
+    memcpy(&value, &data[offset], sizeof(value));
+    return value;
+}
+
+} // namespace
+
+TEST(ColumnFile, WritesBlocks)
+{
+    const std::string path = "column_file_test.dccf";
+    const unsigned num_rows = ColumnFile::ROWS_PER_BLOCK + 10;
+
+    ColumnFile file;
+    ASSERT_TRUE(file.open(path, {
+        {"lat", ColumnFile::Type::DOUBLE},
+        {"alt", ColumnFile::Type::FLOAT}
+    }));
+    EXPECT_TRUE(file.is_open());
+
+    for (unsigned i = 0; i < num_rows; ++i) {
+        const double values[] = {47.0 + i * 1e-7, 500.0 + i};
+        file.append(1000 + i, values);
+    }
+    file.close();
+    EXPECT_FALSE(file.is_open());
+
+    const std::vector<uint8_t> data = read_file(path);
+    const size_t header_len =
+        ColumnFile::HEADER_FIXED_LEN + 2 * ColumnFile::COLUMN_DESCRIPTION_LEN;
+    const size_t row_len = sizeof(uint64_t) + sizeof(double) + sizeof(float);
+    const size_t block_len = ColumnFile::BLOCK_HEADER_LEN + ColumnFile::ROWS_PER_BLOCK * row_len;
+    ASSERT_EQ(data.size(), header_len + 2 * block_len);
+
+    EXPECT_EQ(memcmp(&data[0], "DCCF", 4), 0);
+    EXPECT_EQ(read_at<uint32_t>(data, 8), 2u);
+    EXPECT_EQ(read_at<uint32_t>(data, 12), ColumnFile::ROWS_PER_BLOCK);
+    EXPECT_STREQ(reinterpret_cast<const char *>(&data[ColumnFile::HEADER_FIXED_LEN]), "lat");
+    EXPECT_EQ(data[ColumnFile::HEADER_FIXED_LEN + ColumnFile::COLUMN_DESCRIPTION_LEN - 1], 'd');
+
+    // The second block holds the last 10 rows.
+    const size_t second = header_len + block_len;
+    EXPECT_EQ(memcmp(&data[second], "DCBK", 4), 0);
+    EXPECT_EQ(read_at<uint32_t>(data, second + 4), 10u);
+    EXPECT_EQ(read_at<uint64_t>(data, second + 8), 1000u + ColumnFile::ROWS_PER_BLOCK);
+    EXPECT_EQ(read_at<uint64_t>(data, second + 16), 1000u + num_rows - 1);
+
+    const size_t alt_offset = second + ColumnFile::BLOCK_HEADER_LEN
+                              + ColumnFile::ROWS_PER_BLOCK * (sizeof(uint64_t) + sizeof(double));
+    EXPECT_EQ(read_at<float>(data, alt_offset + 9 * sizeof(float)), 500.0f + num_rows - 1);
+
+    std::remove(path.c_str());
+}
+
+TEST(ColumnFile, AppendWhenClosedIsIgnored)
+{
+    ColumnFile file;
+    const double values[] = {1.0};
+    file.append(0, values);
+    EXPECT_FALSE(file.is_open());
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+
+namespace dronecore {
+
+// The one result of an async call which a sync wrapper waits for. It lives on
+// the stack of the waiting thread and the callback only takes a reference to
+// it, which std::function keeps in place, so unlike a std::promise nothing is
+// allocated.
+//
+// The callback has to come in any case, also after a wait timed out, as the
+// destructor waits for it so that it never finds the completion gone. All our
+// async calls have timeouts of their own and call back when they expire.
+template <typename T>
+class Completion
+{
+public:
+    Completion() {}
+
+    ~Completion()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [this]() { return _is_done; });
+    }
+
+    // Only the first one counts.
+    void complete(T value)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_is_done) {
+            return;
+        }
+        _value = std::move(value);
+        _is_done = true;
+        // Notified with the lock held, the waiter may be gone right after.
+        _cv.notify_all();
+    }
+
+    T wait()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [this]() { return _is_done; });
+        return _value;
+    }
+
+    // Returns false if there was no result within the timeout.
+    bool wait_for(double timeout_s, T &value)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (!_cv.wait_for(lock, std::chrono::duration<double>(timeout_s),
+        [this]() { return _is_done; })) {
+            return false;
+        }
+        value = _value;
+        return true;
+    }
+
+    // Non-copyable
+    Completion(const Completion &) = delete;
+    const Completion &operator=(const Completion &) = delete;
+
+private:
+    std::mutex _mutex {};
+    std::condition_variable _cv {};
+    bool _is_done = false;
+    T _value {};
+};
+
+} // namespace dronecore
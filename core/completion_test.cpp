@@ -0,0 +1,65 @@
+#include "completion.h"
+#include "allocation_counter.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+using namespace dronecore;
+
+TEST(Completion, WaitsForResultOfOtherThread)
+{
+    Completion<int> completion;
+    std::thread thread([&completion]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        completion.complete(42);
+    });
+
+    EXPECT_EQ(completion.wait(), 42);
+    thread.join();
+}
+
+TEST(Completion, KeepsFirstResult)
+{
+    Completion<int> completion;
+    completion.complete(1);
+    completion.complete(2);
+    EXPECT_EQ(completion.wait(), 1);
+}
+
+TEST(Completion, TimesOutAndTakesLateResult)
+{
+    std::thread thread;
+    {
+        Completion<int> completion;
+        int value = 0;
+        EXPECT_FALSE(completion.wait_for(0.01, value));
+
+        thread = std::thread([&completion]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            completion.complete(3);
+        });
+        // Leaving the scope waits for the result.
+    }
+    thread.join();
+}
+
+TEST(Completion, WaitsWithoutAllocating)
+{
+    // Like a sync wrapper: the callback only has a reference to the completion.
+    std::function<void(int)> callback;
+    AllocationCounter::reset();
+    AllocationCounter::count_this_thread();
+    {
+        Completion<int> completion;
+        callback = [&completion](int value) { completion.complete(value); };
+        callback(5);
+        int value = 0;
+        EXPECT_TRUE(completion.wait_for(1.0, value));
+        EXPECT_EQ(value, 5);
+        callback = nullptr;
+    }
+    AllocationCounter::stop_counting_this_thread();
+
+    EXPECT_EQ(AllocationCounter::num_allocations(), 0u);
+}
@@ -1,13 +1,24 @@
 #include "connection.h"
 #include "dronecore_impl.h"
-#include "mavlink_channels.h"
 #include "global_include.h"
+#include "mavlink_message_table.h"
+#include "simulated_clock.h"
+#include "trace_recorder.h"
+#include <algorithm>
+#include <chrono>
 
 namespace dronecore {
 
+constexpr double Connection::PEER_TIMEOUT_S;
+
 Connection::Connection(DroneCoreImpl &parent) :
     _parent(parent),
-    _mavlink_receiver() {}
+    _mavlink_receiver(),
+    _outgoing_scheduler([this](const uint8_t *frame, unsigned frame_len, uint8_t target_system) {
+    capture_frame(frame, frame_len);
+    return send_frame(frame, frame_len, target_system);
+})
+{}
 
 Connection::~Connection()
 {
@@ -15,31 +26,307 @@ Connection::~Connection()
     stop_mavlink_receiver();
 }
 
-bool Connection::start_mavlink_receiver()
+ConnectionResult Connection::start(IoReactor &reactor)
+{
+    UNUSED(reactor);
+    return start();
+}
+
+void Connection::start_mavlink_receiver()
+{
+    _mavlink_receiver.reset(new MAVLinkReceiver(&_receive_counters));
+}
+
+void Connection::stop_mavlink_receiver()
+{
+    _mavlink_receiver.reset();
+}
+
+int64_t Connection::steady_ns()
 {
-    uint8_t channel;
-    if (!MAVLinkChannels::Instance().checkout_free_channel(channel)) {
+    // Usually called within the batch of a received datagram.
+    const dl_time_t now = TimeBatch::is_active() ? TimeBatch::time() :
+                          SimulatedClock::is_enabled() ? SimulatedClock::now() :
+                          std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+}
+
+bool Connection::has_peer() const
+{
+    const int64_t last_ns = _last_received_ns.load(std::memory_order_relaxed);
+    if (last_ns == 0) {
         return false;
     }
+    // The timeout is in seconds, so the coarse clock is fine.
+    const int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               Time::coarse_steady_time().time_since_epoch()).count();
+    return double(now_ns - last_ns) * 1e-9 < PEER_TIMEOUT_S;
+}
+
+void Connection::receive_message(const MAVLinkMessageView &message)
+{
+    TraceScope scope("receive", "message", message.msgid());
+
+    // Only the receive thread of this connection writes it.
+    const int64_t now_ns = steady_ns();
+    const int64_t last_ns = _last_received_ns.load(std::memory_order_relaxed);
+    _last_received_ns.store(now_ns, std::memory_order_relaxed);
+    if (last_ns == 0 || double(now_ns - last_ns) * 1e-9 >= PEER_TIMEOUT_S) {
+        // Instead of letting the new peer wait for the next round.
+        _parent.send_heartbeat(*this);
+    }
+
+    if (_capture.is_open()) {
+        if (message.frame() != nullptr) {
+            _capture.add(message.frame(), message.frame_len(), now_ns);
+        } else {
+            uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+            const uint16_t buffer_len = mavlink_msg_to_send_buffer(buffer, &message.message());
+            _capture.add(buffer, buffer_len, now_ns);
+        }
+    }
+
+    if (message.msgid() == MAVLINK_MSG_ID_RADIO_STATUS) {
+        // Offsets in the wire order of the payload.
+        _health.add_radio_status(message.get<uint8_t>(4), message.get<uint8_t>(5),
+                                 message.get<uint8_t>(7), message.get<uint8_t>(8),
+                                 message.get<uint8_t>(6));
+    }
 
-    _mavlink_receiver.reset(new MAVLinkReceiver(channel));
-    return true;
+    MessageTracer &tracer = _parent.message_tracer();
+    if (!tracer.is_enabled() || !_mavlink_receiver) {
+        _parent.receive_message(message, this);
+        return;
+    }
+
+    MessageTracer::Trace trace(tracer, message.msgid(), _mavlink_receiver->get_datagram_time());
+    _parent.receive_message(message, this);
 }
 
-void Connection::stop_mavlink_receiver()
+bool Connection::send_message(const mavlink_message_t &message)
+{
+    const uint8_t target_system = target_system_of(message);
+
+    mavlink_message_t framed = message;
+    _num_bytes_saved += frame_message(framed, is_mavlink1_to(target_system));
+
+    uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+    uint16_t buffer_len = mavlink_msg_to_send_buffer(buffer, &framed);
+    _num_bytes_sent += buffer_len;
+
+    return _outgoing_scheduler.send(buffer, buffer_len, target_system,
+                                    OutgoingScheduler::priority_of(message.msgid));
+}
+
+bool Connection::send_messages(const mavlink_message_t *messages, size_t num_messages)
 {
-    if (_mavlink_receiver) {
+    if (!_outgoing_scheduler.sends_right_away()) {
+        bool success = true;
+        for (size_t i = 0; i < num_messages; ++i) {
+            success = send_message(messages[i]) && success;
+        }
+        return success;
+    }
+
+    // Shared by the connections sent on from this thread, grown only once.
+    thread_local std::vector<uint8_t> buffer;
+    thread_local std::vector<Frame> frames;
+    if (buffer.size() < num_messages * MAVLINK_MAX_PACKET_LEN) {
+        buffer.resize(num_messages * MAVLINK_MAX_PACKET_LEN);
+    }
+    frames.clear();
 
-        uint8_t used_channel = _mavlink_receiver->get_channel();
-        // Destroy receiver before giving the channel back.
-        _mavlink_receiver.reset();
-        MAVLinkChannels::Instance().checkin_used_channel(used_channel);
+    for (size_t i = 0; i < num_messages; ++i) {
+        const uint8_t target_system = target_system_of(messages[i]);
+
+        mavlink_message_t framed = messages[i];
+        _num_bytes_saved += frame_message(framed, is_mavlink1_to(target_system));
+
+        uint8_t *data = &buffer[i * MAVLINK_MAX_PACKET_LEN];
+        const uint16_t len = mavlink_msg_to_send_buffer(data, &framed);
+        _num_bytes_sent += len;
+        frames.push_back(Frame {data, len, target_system});
+        capture_frame(data, len);
+    }
+
+    return send_frames(frames.data(), frames.size());
+}
+
+bool Connection::send_frames(const Frame *frames, size_t num_frames)
+{
+    bool success = true;
+    for (size_t i = 0; i < num_frames; ++i) {
+        success = send_frame(frames[i].data, frames[i].len, frames[i].target_system) && success;
+    }
+    return success;
+}
+
+bool Connection::set_capture(const std::string &path)
+{
+    if (path.empty()) {
+        _capture.close();
+        return true;
     }
+    return _capture.open(path);
 }
 
-void Connection::receive_message(const mavlink_message_t &message)
+void Connection::set_send_queue(size_t max_queued, DroneCore::SendOverflow overflow)
 {
-    _parent.receive_message(message);
+    _outgoing_scheduler.set_queue(max_queued,
+                                  (overflow == DroneCore::SendOverflow::DROP_OLDEST) ?
+                                  OutgoingScheduler::Overflow::DROP_OLDEST :
+                                  OutgoingScheduler::Overflow::DROP_NEWEST);
+}
+
+bool Connection::is_mavlink1_to(uint8_t target_system) const
+{
+    switch (_framing.load()) {
+        case DroneCore::MavlinkFraming::MAVLINK1:
+            return true;
+        case DroneCore::MavlinkFraming::MAVLINK2:
+            return false;
+        case DroneCore::MavlinkFraming::AUTO:
+        default:
+            if (target_system == 0) {
+                return _has_mavlink1_peer;
+            }
+            return _parent.mavlink_version_of(target_system) == 1;
+    }
+}
+
+unsigned Connection::frame_message(mavlink_message_t &message, bool mavlink1)
+{
+    const mavlink_msg_entry_t *entry = MAVLinkMessageTable::entry(message.msgid);
+    if (entry == nullptr) {
+        return 0;
+    }
+
+    if (message.msgid > 255) {
+        // Doesn't fit into a MAVLink 1 header.
+        mavlink1 = false;
+    }
+
+    const bool is_mavlink1 = (message.magic == MAVLINK_STX_MAVLINK1);
+    const uint8_t *payload = reinterpret_cast<const uint8_t *>(_MAV_PAYLOAD(&message));
+    const bool is_trimmed = (message.len <= 1 || payload[message.len - 1] != 0);
+
+    if (mavlink1 != is_mavlink1 || (!mavlink1 && !is_trimmed)) {
+        // The payload buffer still holds the full message, trimming only
+        // shortened len, so it can be finalized again from the full length.
+        mavlink_status_t status {};
+        status.flags = mavlink1 ? MAVLINK_STATUS_FLAG_OUT_MAVLINK1 : 0;
+        // Keeps the sequence number.
+        status.current_tx_seq = message.seq;
+        mavlink_finalize_message_buffer(&message, message.sysid, message.compid, &status,
+                                        entry->min_msg_len, entry->max_msg_len,
+                                        entry->crc_extra);
+    }
+
+    return mavlink1 ? 0 : unsigned(entry->max_msg_len - message.len);
+}
+
+bool Connection::forward_frame(const uint8_t *frame, unsigned frame_len, uint8_t target_system,
+                               uint32_t message_id)
+{
+    return _outgoing_scheduler.send(frame, frame_len, target_system,
+                                    OutgoingScheduler::priority_of(message_id));
+}
+
+void Connection::set_forwarding(const DroneCore::ForwardingConfig &forwarding)
+{
+    _forwarding_enabled = forwarding.enabled;
+    _forwarded_message_ids = forwarding.message_ids;
+    std::sort(_forwarded_message_ids.begin(), _forwarded_message_ids.end());
+}
+
+bool Connection::forwards_message(uint32_t message_id) const
+{
+    return _forwarded_message_ids.empty() ||
+           std::binary_search(_forwarded_message_ids.begin(), _forwarded_message_ids.end(),
+                              message_id);
+}
+
+void Connection::count_duplicate(double delay_s)
+{
+    ++_num_duplicates;
+    _sum_delay_us += uint64_t(delay_s * 1e6);
+}
+
+DroneCore::LinkStats Connection::link_stats() const
+{
+    const uint64_t num_duplicates = _num_duplicates;
+    const OutgoingScheduler::Stats outgoing = _outgoing_scheduler.stats();
+    const MAVLinkReceiveCounters &received = _receive_counters;
+
+    std::vector<DroneCore::SystemLinkStats> systems;
+    for (unsigned sysid = 0; sysid < received.num_messages_by_sysid.size(); ++sysid) {
+        const uint64_t num_messages =
+            received.num_messages_by_sysid[sysid].load(std::memory_order_relaxed);
+        if (num_messages > 0) {
+            systems.push_back(DroneCore::SystemLinkStats {
+                uint8_t(sysid),
+                num_messages,
+                received.num_lost_by_sysid[sysid].load(std::memory_order_relaxed)
+            });
+        }
+    }
+
+    return DroneCore::LinkStats {
+        _num_received_first,
+        num_duplicates,
+        num_duplicates > 0 ? double(_sum_delay_us) * 1e-6 / double(num_duplicates) : 0.0,
+        outgoing.num_queued,
+        outgoing.num_dropped,
+        outgoing.depth,
+        outgoing.max_depth,
+        _num_bytes_sent,
+        _num_bytes_saved,
+        received.num_bytes.load(std::memory_order_relaxed),
+        received.num_messages.load(std::memory_order_relaxed),
+        received.num_crc_errors.load(std::memory_order_relaxed),
+        received.num_lost.load(std::memory_order_relaxed),
+        received.num_resyncs.load(std::memory_order_relaxed),
+        received.num_bytes_discarded.load(std::memory_order_relaxed),
+        _health.score(),
+        systems
+    };
+}
+
+void Connection::update_health()
+{
+    const int64_t last_ns = _last_received_ns.load(std::memory_order_relaxed);
+    const double since_received_s = (last_ns == 0) ? LinkHealth::STALE_S :
+                                    double(steady_ns() - last_ns) * 1e-9;
+    _health.update(LinkHealth::Counters {
+        _receive_counters.num_messages.load(std::memory_order_relaxed),
+        _receive_counters.num_lost.load(std::memory_order_relaxed),
+        double(_sum_delay_us) * 1e-6,
+        since_received_s
+    });
+}
+
+uint64_t Connection::num_received_from(uint8_t system_id) const
+{
+    return _receive_counters.num_messages_by_sysid[system_id].load(std::memory_order_relaxed);
+}
+
+uint8_t Connection::target_system_of(const mavlink_message_t &message)
+{
+    return target_system_of(message.msgid,
+                            reinterpret_cast<const uint8_t *>(_MAV_PAYLOAD(&message)),
+                            message.len);
+}
+
+uint8_t Connection::target_system_of(uint32_t message_id, const uint8_t *payload,
+                                     unsigned payload_len)
+{
+    const mavlink_msg_entry_t *entry = MAVLinkMessageTable::entry(message_id);
+    if (entry == nullptr || (entry->flags & MAV_MSG_ENTRY_FLAG_HAVE_TARGET_SYSTEM) == 0 ||
+        entry->target_system_ofs >= payload_len) {
+        // Without a target it is for everyone, and a trimmed zero is 0 too.
+        return 0;
+    }
+    return payload[entry->target_system_ofs];
 }
 
 } // namespace dronecore
@@ -1,12 +1,18 @@
 #pragma once
 
 #include "dronecore.h"
+#include "link_health.h"
 #include "mavlink_receiver.h"
+#include "outgoing_scheduler.h"
+#include "traffic_capture.h"
+#include <atomic>
 #include <memory>
+#include <vector>
 
 namespace dronecore {
 
 class DroneCoreImpl;
+class IoReactor;
 
 class Connection
 {
@@ -15,22 +21,127 @@ public:
     virtual ~Connection();
 
     virtual ConnectionResult start() = 0;
+    // Start with receiving done by a shared reactor instead of an own thread.
+    // Connections which don't support it just use start().
+    virtual ConnectionResult start(IoReactor &reactor);
     virtual ConnectionResult stop() = 0;
+    // Wakes up the threads of the connection to exit, without waiting for them,
+    // so that stopping many connections takes as long as the slowest one, not
+    // all of them one after the other. stop() is still needed afterwards.
+    virtual void request_stop() {}
     virtual bool is_ok() const = 0;
 
-    virtual bool send_message(const mavlink_message_t &message) = 0;
+    // Both go through the outgoing scheduler, so they may be queued.
+    bool send_message(const mavlink_message_t &message);
+    // Encodes the messages one after the other into a buffer which is reused and
+    // hands them to send_frames() at once. With a budget set they are sent one by
+    // one, as the outgoing scheduler may need to queue them.
+    bool send_messages(const mavlink_message_t *messages, size_t num_messages);
+    bool forward_frame(const uint8_t *frame, unsigned frame_len, uint8_t target_system,
+                       uint32_t message_id);
+    // Sends an encoded frame as it is, target_system is where it is for.
+    virtual bool send_frame(const uint8_t *frame, unsigned frame_len,
+                            uint8_t target_system) = 0;
+
+    struct Frame {
+        const uint8_t *data;
+        unsigned len;
+        uint8_t target_system;
+    };
+    // Connections which can send several frames with one call override this, by
+    // default they are sent one by one with send_frame().
+    virtual bool send_frames(const Frame *frames, size_t num_frames);
+
+    // Needs to be set before start().
+    void set_forwarding(const DroneCore::ForwardingConfig &forwarding);
+    bool forwards() const { return _forwarding_enabled; }
+    bool forwards_message(uint32_t message_id) const;
+
+    // Whether anything has been received within PEER_TIMEOUT_S, our heartbeats
+    // are only sent to links with someone on the other end.
+    bool has_peer() const;
+    static constexpr double PEER_TIMEOUT_S = 3.0;
+
+    void count_received_first() { ++_num_received_first; }
+    void count_duplicate(double delay_s);
+    DroneCore::LinkStats link_stats() const;
+
+    // Called once per heartbeat interval, see LinkHealth.
+    void update_health();
+    float health_score() const { return _health.score(); }
+    // Messages received from this system so far, including duplicates.
+    uint64_t num_received_from(uint8_t system_id) const;
+
+    // In bytes per second, 0 to send everything right away.
+    void set_budget(double bytes_per_s) { _outgoing_scheduler.set_budget(bytes_per_s); }
+    void set_send_queue(size_t max_queued, DroneCore::SendOverflow overflow);
+
+    void set_framing(DroneCore::MavlinkFraming framing) { _framing = framing; }
+
+    // Records all frames received and sent as tlog segments named after the
+    // path, see TrafficCapture. An empty path stops it.
+    bool set_capture(const std::string &path);
+    // In AUTO, broadcasts are then sent as MAVLink 1.
+    void set_has_mavlink1_peer() { _has_mavlink1_peer = true; }
+
+    // Packs the message again if it is not in the given version, or if its
+    // MAVLink 2 payload still has trailing zeros. Returns the bytes which the
+    // truncation saves, compared to the full payload.
+    static unsigned frame_message(mavlink_message_t &message, bool mavlink1);
+
+    // The system a message is for, 0 if it is for all of them.
+    static uint8_t target_system_of(const mavlink_message_t &message);
+    static uint8_t target_system_of(uint32_t message_id, const uint8_t *payload,
+                                    unsigned payload_len);
 
     // Non-copyable
     Connection(const Connection &) = delete;
     const Connection &operator=(const Connection &) = delete;
 
 protected:
-    bool start_mavlink_receiver();
+    void start_mavlink_receiver();
     void stop_mavlink_receiver();
-    void receive_message(const mavlink_message_t &message);
+    // Needs to be called in stop(), as the queued frames are sent with send_frame().
+    void stop_outgoing_scheduler() { _outgoing_scheduler.stop(); }
+    void receive_message(const MAVLinkMessageView &message);
     DroneCoreImpl &_parent;
     std::unique_ptr<MAVLinkReceiver> _mavlink_receiver;
 
+private:
+    bool _forwarding_enabled = false;
+    // Sorted, all are forwarded if empty.
+    std::vector<uint32_t> _forwarded_message_ids {};
+
+    // On the steady clock, 0 until something is received.
+    std::atomic<int64_t> _last_received_ns {0};
+    static int64_t steady_ns();
+
+    std::atomic<uint64_t> _num_received_first {0};
+    std::atomic<uint64_t> _num_duplicates {0};
+    std::atomic<uint64_t> _sum_delay_us {0};
+
+    OutgoingScheduler _outgoing_scheduler;
+
+    bool is_mavlink1_to(uint8_t target_system) const;
+
+    std::atomic<DroneCore::MavlinkFraming> _framing {DroneCore::MavlinkFraming::AUTO};
+    std::atomic<bool> _has_mavlink1_peer {false};
+    std::atomic<uint64_t> _num_bytes_sent {0};
+    std::atomic<uint64_t> _num_bytes_saved {0};
+
+    // Outlive the receivers, which are replaced on every start.
+    MAVLinkReceiveCounters _receive_counters {};
+
+    LinkHealth _health {};
+
+    TrafficCapture _capture {};
+    void capture_frame(const uint8_t *frame, unsigned frame_len)
+    {
+        if (_capture.is_open()) {
+            _capture.add(frame, frame_len, steady_ns());
+        }
+    }
+
     //void received_mavlink_message(mavlink_message_t &);
 };
 
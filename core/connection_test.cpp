@@ -0,0 +1,39 @@
+#include "connection.h"
+#include <gtest/gtest.h>
+
+using namespace dronecore;
+
+TEST(Connection, TruncatesMavlink2Payload)
+{
+    mavlink_message_t message;
+    mavlink_msg_command_long_pack(245, 190, &message, 1, 1, MAV_CMD_COMPONENT_ARM_DISARM, 0,
+                                  1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+    const uint8_t seq = message.seq;
+
+    // Packing already trims, so nothing needs to change.
+    const unsigned saved = Connection::frame_message(message, false);
+    EXPECT_EQ(message.magic, MAVLINK_STX);
+    EXPECT_EQ(saved, unsigned(MAVLINK_MSG_ID_COMMAND_LONG_LEN - message.len));
+    EXPECT_GT(saved, 0u);
+    EXPECT_EQ(message.seq, seq);
+}
+
+TEST(Connection, FramesAsMavlink1)
+{
+    mavlink_message_t message;
+    mavlink_msg_command_long_pack(245, 190, &message, 1, 1, MAV_CMD_COMPONENT_ARM_DISARM, 0,
+                                  1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+    const mavlink_message_t mavlink2 = message;
+
+    EXPECT_EQ(Connection::frame_message(message, true), 0u);
+    EXPECT_EQ(message.magic, MAVLINK_STX_MAVLINK1);
+    // MAVLink 1 payloads are never truncated.
+    EXPECT_EQ(message.len, MAVLINK_MSG_ID_COMMAND_LONG_MIN_LEN);
+    EXPECT_EQ(message.seq, mavlink2.seq);
+
+    // And back, with the same payload as packed.
+    Connection::frame_message(message, false);
+    EXPECT_EQ(message.magic, MAVLINK_STX);
+    EXPECT_EQ(message.len, mavlink2.len);
+    EXPECT_EQ(message.checksum, mavlink2.checksum);
+}
@@ -1,21 +1,156 @@
 #include "global_include.h"
 #include "log.h"
 #include "curl_wrapper.h"
+#include "completion.h"
+#include "thread_roles.h"
 #include <sstream>
 #include <iostream>
 #include <stdio.h>
 #include <fstream>
+#include <map>
 #include <string>
 
 namespace dronecore {
 
 
+constexpr long CurlWrapper::MAX_HOST_CONNECTIONS;
+constexpr int CurlWrapper::MULTI_WAIT_MS;
+
 CurlWrapper::CurlWrapper()
 {
+    _multi = curl_multi_init();
+    if (_multi != nullptr) {
+        curl_multi_setopt(_multi, CURLMOPT_MAX_HOST_CONNECTIONS, MAX_HOST_CONNECTIONS);
+        curl_multi_setopt(_multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    }
 }
 
 CurlWrapper::~CurlWrapper()
 {
+    {
+        std::lock_guard<std::mutex> lock(_multi_mutex);
+        _should_exit = true;
+        _multi_cv.notify_all();
+    }
+
+    if (_multi_thread != nullptr) {
+        _multi_thread->join();
+        delete _multi_thread;
+        _multi_thread = nullptr;
+    }
+
+    if (_multi != nullptr) {
+        curl_multi_cleanup(_multi);
+    }
+}
+
+void CurlWrapper::perform_async(const std::shared_ptr<CURL> &curl,
+                                const transfer_callback_t &callback)
+{
+    {
+        std::lock_guard<std::mutex> lock(_multi_mutex);
+        if (_multi != nullptr && !_should_exit) {
+            if (_multi_thread == nullptr) {
+                _multi_thread = new std::thread(multi_thread, this);
+            }
+            // The handle is kept until the transfer is done.
+            _new_transfers.push_back(std::make_pair(curl.get(), [curl, callback](CURLcode result) {
+                callback(result);
+            }));
+            _multi_cv.notify_one();
+            return;
+        }
+    }
+
+    LogErr() << "Error: cannot start transfer because of curl initialization error.";
+    callback(CURLcode::CURLE_FAILED_INIT);
+}
+
+bool CurlWrapper::in_multi_thread()
+{
+    std::lock_guard<std::mutex> lock(_multi_mutex);
+    if (_multi_thread != nullptr && _multi_thread->get_id() == std::this_thread::get_id()) {
+        LogErr() << "Error: cannot wait for a transfer in a transfer callback.";
+        return true;
+    }
+    return false;
+}
+
+CURLcode CurlWrapper::perform(const std::shared_ptr<CURL> &curl)
+{
+    if (in_multi_thread()) {
+        return CURLcode::CURLE_FAILED_INIT;
+    }
+
+    Completion<CURLcode> completion;
+
+    perform_async(curl, [&completion](CURLcode result) {
+        completion.complete(result);
+    });
+
+    return completion.wait();
+}
+
+void CurlWrapper::multi_thread(CurlWrapper *self)
+{
+    ThreadRoles::apply_to_this_thread(DroneCore::ThreadRole::HTTP, "curl");
+
+    std::map<CURL *, transfer_callback_t> running;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(self->_multi_mutex);
+            if (running.empty()) {
+                self->_multi_cv.wait(lock, [self]() {
+                    return self->_should_exit || !self->_new_transfers.empty();
+                });
+            }
+            if (self->_should_exit) {
+                for (auto &transfer : self->_new_transfers) {
+                    running.insert(transfer);
+                }
+                self->_new_transfers.clear();
+                break;
+            }
+            for (auto &transfer : self->_new_transfers) {
+                curl_multi_add_handle(self->_multi, transfer.first);
+                running.insert(transfer);
+            }
+            self->_new_transfers.clear();
+        }
+
+        int num_running = 0;
+        curl_multi_perform(self->_multi, &num_running);
+
+        CURLMsg *message;
+        int num_messages = 0;
+        while ((message = curl_multi_info_read(self->_multi, &num_messages)) != nullptr) {
+            if (message->msg != CURLMSG_DONE) {
+                continue;
+            }
+            CURL *curl = message->easy_handle;
+            const CURLcode result = message->data.result;
+            curl_multi_remove_handle(self->_multi, curl);
+
+            auto it = running.find(curl);
+            if (it != running.end()) {
+                transfer_callback_t callback = it->second;
+                running.erase(it);
+                // Without the lock, so that the callback can start the next transfer.
+                callback(result);
+            }
+        }
+
+        if (!running.empty()) {
+            curl_multi_wait(self->_multi, nullptr, 0, MULTI_WAIT_MS, nullptr);
+        }
+    }
+
+    // Whatever has not finished is given up, so that no one waits for it.
+    for (auto &transfer : running) {
+        curl_multi_remove_handle(self->_multi, transfer.first);
+        transfer.second(CURLcode::CURLE_ABORTED_BY_CALLBACK);
+    }
 }
 
 // converts curl output to string
@@ -38,7 +173,9 @@ bool CurlWrapper::download_text(const std::string &url, std::string &content)
         curl_easy_setopt(curl.get(), CURLOPT_URL, url.c_str());
         curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, write_callback);
         curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &readBuffer);
-        res = curl_easy_perform(curl.get());
+        // Offers gzip and deflate, curl decodes them before they get to us.
+        curl_easy_setopt(curl.get(), CURLOPT_ACCEPT_ENCODING, "");
+        res = perform(curl);
         content = readBuffer;
 
         if (res == CURLcode::CURLE_OK) {
@@ -137,7 +274,7 @@ bool CurlWrapper::upload_file(const std::string &url, const std::string &path,
         curl_easy_setopt(curl.get(), CURLOPT_HTTPPOST, post);
         curl_easy_setopt(curl.get(), CURLOPT_NOPROGRESS, 0L);
 
-        res = curl_easy_perform(curl.get());
+        res = perform(curl);
 
         curl_slist_free_all(chunk);
         curl_formfree(post);
@@ -188,43 +325,162 @@ static int download_progress_update(void *p, double dltotal, double dlnow, doubl
 
 bool CurlWrapper::download_file_to_path(const std::string &url, const std::string &path, const
                                         progress_callback_t &progress_callback)
+{
+    if (in_multi_thread()) {
+        return false;
+    }
+
+    Completion<bool> completion;
+
+    download_file_async(url, path, progress_callback, false, [&completion](bool success) {
+        completion.complete(success);
+    });
+
+    return completion.wait();
+}
+
+void CurlWrapper::resume_download_file_to_path_async(const std::string &url,
+                                                     const std::string &path,
+                                                     const progress_callback_t &progress_callback,
+                                                     const result_callback_t &result_callback)
+{
+    download_file_async(url, path, progress_callback, true, result_callback);
+}
+
+void CurlWrapper::download_file_async(const std::string &url, const std::string &path,
+                                      const progress_callback_t &progress_callback, bool resume,
+                                      const result_callback_t &result_callback)
 {
     auto curl = std::shared_ptr<CURL>(curl_easy_init(), curl_easy_cleanup);
     FILE *fp;
 
     if (nullptr != curl) {
-        CURLcode res;
-        struct dl_up_progress prog;
-        prog.progress_callback = progress_callback;
+        auto prog = std::make_shared<dl_up_progress>();
+        prog->progress_callback = progress_callback;
+
+        const curl_off_t offset = resume ? curl_off_t(get_file_size(path)) : 0;
+
+        fp = fopen(path.c_str(), (offset > 0) ? "ab" : "wb");
+        if (fp == nullptr) {
+            LogErr() << "Error: cannot open " << path << " for downloading";
+            if (result_callback) {
+                result_callback(false);
+            }
+            return;
+        }
 
-        fp = fopen(path.c_str(), "wb");
         curl_easy_setopt(curl.get(), CURLOPT_CONNECTTIMEOUT, 5L);
         curl_easy_setopt(curl.get(), CURLOPT_PROGRESSFUNCTION, download_progress_update);
-        curl_easy_setopt(curl.get(), CURLOPT_PROGRESSDATA, &prog);
+        curl_easy_setopt(curl.get(), CURLOPT_PROGRESSDATA, prog.get());
         curl_easy_setopt(curl.get(), CURLOPT_URL, url.c_str());
         curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, NULL);
         curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, fp);
         curl_easy_setopt(curl.get(), CURLOPT_NOPROGRESS, 0L);
-        res = curl_easy_perform(curl.get());
-        fclose(fp);
+        if (resume) {
+            // An error page must not end up in the middle of the file.
+            curl_easy_setopt(curl.get(), CURLOPT_FAILONERROR, 1L);
+            curl_easy_setopt(curl.get(), CURLOPT_RESUME_FROM_LARGE, offset);
+        }
 
-        if (res == CURLcode::CURLE_OK) {
-            if (nullptr != progress_callback) {
-                progress_callback(100, Status::Finished, res);
+        perform_async(curl, [this, curl, prog, fp, offset, url, path, progress_callback, resume,
+        result_callback](CURLcode res) {
+            fclose(fp);
+
+            long response_code = 0;
+            curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE, &response_code);
+
+            // Nothing is left to continue once the range starts at the end.
+            if (offset > 0 && res == CURLcode::CURLE_HTTP_RETURNED_ERROR && response_code == 416) {
+                res = CURLcode::CURLE_OK;
             }
-            return true;
-        } else {
-            if (nullptr != progress_callback) {
-                progress_callback(0, Status::Error, res);
+
+            if (offset > 0 && res == CURLcode::CURLE_RANGE_ERROR) {
+                LogWarn() << "Server can't continue " << url << ", downloading it all again";
+                download_file_async(url, path, progress_callback, false, result_callback);
+                return;
             }
-            remove(path.c_str());
-            LogErr() << "Error while downloading file, curl error code: " << curl_easy_strerror(res);
-            return false;
-        }
+
+            if (res == CURLcode::CURLE_OK) {
+                if (nullptr != progress_callback) {
+                    progress_callback(100, Status::Finished, res);
+                }
+            } else {
+                if (nullptr != progress_callback) {
+                    progress_callback(0, Status::Error, res);
+                }
+                if (!resume) {
+                    remove(path.c_str());
+                }
+                LogErr() << "Error while downloading file, curl error code: "
+                         << curl_easy_strerror(res);
+            }
+
+            if (result_callback) {
+                result_callback(res == CURLcode::CURLE_OK);
+            }
+        });
     } else {
         LogErr() << "Error: cannot start downloading file because of curl initialization error. ";
-        return false;
+        if (result_callback) {
+            result_callback(false);
+        }
     }
 }
 
+static size_t stream_write_callback(void *contents, size_t size, size_t nmemb, void *userp)
+{
+    auto &chunk_callback = *reinterpret_cast<chunk_callback_t *>(userp);
+    // Anything short of all of it makes curl stop.
+    if (!chunk_callback(reinterpret_cast<const char *>(contents), size * nmemb)) {
+        return 0;
+    }
+    return size * nmemb;
+}
+
+void CurlWrapper::download_stream_async(const std::string &url, uint64_t offset,
+                                        const chunk_callback_t &chunk_callback,
+                                        const result_callback_t &result_callback)
+{
+    auto curl = std::shared_ptr<CURL>(curl_easy_init(), curl_easy_cleanup);
+
+    if (nullptr == curl || nullptr == chunk_callback) {
+        LogErr() << "Error: cannot start streaming because of curl initialization error.";
+        if (result_callback) {
+            result_callback(false);
+        }
+        return;
+    }
+
+    // Needs to stay where it is for the write callback.
+    auto callback = std::make_shared<chunk_callback_t>(chunk_callback);
+
+    curl_easy_setopt(curl.get(), CURLOPT_CONNECTTIMEOUT, 5L);
+    curl_easy_setopt(curl.get(), CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, stream_write_callback);
+    curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, callback.get());
+    // An error page is not content.
+    curl_easy_setopt(curl.get(), CURLOPT_FAILONERROR, 1L);
+    if (offset > 0) {
+        curl_easy_setopt(curl.get(), CURLOPT_RESUME_FROM_LARGE, curl_off_t(offset));
+    }
+
+    perform_async(curl, [curl, callback, offset, result_callback](CURLcode res) {
+        long response_code = 0;
+        curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE, &response_code);
+
+        // Nothing is left once the range starts at the end.
+        if (offset > 0 && res == CURLcode::CURLE_HTTP_RETURNED_ERROR && response_code == 416) {
+            res = CURLcode::CURLE_OK;
+        }
+
+        if (res != CURLcode::CURLE_OK) {
+            LogErr() << "Error while streaming, curl error code: " << curl_easy_strerror(res);
+        }
+
+        if (result_callback) {
+            result_callback(res == CURLcode::CURLE_OK);
+        }
+    });
+}
+
 } // namespace dronecore
@@ -1,7 +1,14 @@
 #pragma once
 
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
 #include "curl_include.h"
 #include "curl_wrapper_types.h"
 
@@ -21,6 +28,19 @@ public:
     virtual bool upload_file(const std::string &url, const std::string &path, const
                              progress_callback_t &progress_callback) = 0;
 
+    // Continues the file at path where it stopped, or downloads it all if there
+    // is none. A failed download is kept, so that it can be continued.
+    virtual void resume_download_file_to_path_async(const std::string &url,
+                                                    const std::string &path,
+                                                    const progress_callback_t &progress_callback,
+                                                    const result_callback_t &result_callback) = 0;
+
+    // Hands the content from offset on to the chunk callback, without keeping
+    // it. Starting at the end of the content counts as success.
+    virtual void download_stream_async(const std::string &url, uint64_t offset,
+                                       const chunk_callback_t &chunk_callback,
+                                       const result_callback_t &result_callback) = 0;
+
     virtual ~ICurlWrapper() {}
 };
 
@@ -36,6 +56,47 @@ public:
                                const progress_callback_t &progress_callback) override;
     bool upload_file(const std::string &url, const std::string &path,
                      const progress_callback_t &progress_callback) override;
+    void resume_download_file_to_path_async(const std::string &url, const std::string &path,
+                                            const progress_callback_t &progress_callback,
+                                            const result_callback_t &result_callback) override;
+    void download_stream_async(const std::string &url, uint64_t offset,
+                               const chunk_callback_t &chunk_callback,
+                               const result_callback_t &result_callback) override;
+
+    // Non-copyable
+    CurlWrapper(const CurlWrapper &) = delete;
+    const CurlWrapper &operator=(const CurlWrapper &) = delete;
+
+private:
+    void download_file_async(const std::string &url, const std::string &path,
+                             const progress_callback_t &progress_callback, bool resume,
+                             const result_callback_t &result_callback);
+
+    typedef std::function<void(CURLcode result)> transfer_callback_t;
+
+    // All transfers of the wrapper run on one multi handle, on a thread which
+    // is started with the first one. Its connections are kept alive and used
+    // again by the next transfers to the same host, so a short transfer does
+    // not wait for a long one, nor for a new connection. The callbacks are
+    // called on that thread, so they must not call perform().
+    void perform_async(const std::shared_ptr<CURL> &curl, const transfer_callback_t &callback);
+    CURLcode perform(const std::shared_ptr<CURL> &curl);
+    // Logs an error if so, waiting there would never end.
+    bool in_multi_thread();
+    static void multi_thread(CurlWrapper *self);
+
+    CURLM *_multi = nullptr;
+
+    std::mutex _multi_mutex {};
+    std::condition_variable _multi_cv {};
+    // Picked up by the thread with the next round.
+    std::vector<std::pair<CURL *, transfer_callback_t>> _new_transfers {};
+    std::thread *_multi_thread = nullptr;
+    bool _should_exit = false;
+
+    static constexpr long MAX_HOST_CONNECTIONS = 6;
+    // How long new transfers wait at most while others are running.
+    static constexpr int MULTI_WAIT_MS = 50;
 };
 
 #ifdef TESTING
@@ -47,6 +108,14 @@ public:
                                              const progress_callback_t &progress_callback));
     MOCK_METHOD3(upload_file, bool(const std::string &url, const std::string &path, const
                                    progress_callback_t &progress_callback));
+    MOCK_METHOD4(resume_download_file_to_path_async,
+                 void(const std::string &url, const std::string &path,
+                      const progress_callback_t &progress_callback,
+                      const result_callback_t &result_callback));
+    MOCK_METHOD4(download_stream_async,
+                 void(const std::string &url, uint64_t offset,
+                      const chunk_callback_t &chunk_callback,
+                      const result_callback_t &result_callback));
 };
 #endif // TESTING
 
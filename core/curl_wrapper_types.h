@@ -1,5 +1,6 @@
 #pragma once
 #include "curl_include.h"
+#include <cstddef>
 #include <functional>
 
 namespace dronecore {
@@ -14,6 +15,11 @@ enum class Status {
 
 typedef std::function<int(int progress, Status status, CURLcode curl_code)> progress_callback_t;
 
+typedef std::function<void(bool success)> result_callback_t;
+
+// Gets the data as it arrives, returns false to stop the transfer.
+typedef std::function<bool(const char *data, size_t size)> chunk_callback_t;
+
 struct dl_up_progress {
     int progress_in_percentage = 0;
     progress_callback_t progress_callback;
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace dronecore {
+
+// The items of TimeoutHandler and CallEveryHandler, ordered by deadline.
+// Items are kept in slots which are recycled using a free list, so that adding,
+// updating and removing don't allocate once the heap is warmed up. The heap
+// holds slot numbers ordered by the deadline of their items.
+//
+// Each item has a cookie, an opaque handle which is never nullptr and doesn't
+// match a later item in the same slot.
+//
+// Item can be any struct with a deadline member which is ordered by operator<.
+// It is not thread-safe, the handlers use it with their lock held.
+template<typename Item>
+class DeadlineHeap
+{
+public:
+    DeadlineHeap() {}
+
+    // Returns the slot of the new item.
+    size_t add(Item item)
+    {
+        size_t slot;
+        if (_free_slots.empty()) {
+            slot = _slots.size();
+            _slots.push_back(Slot {Item {}, NOT_IN_HEAP, 1});
+        } else {
+            slot = _free_slots.back();
+            _free_slots.pop_back();
+        }
+
+        _slots[slot].item = std::move(item);
+        _slots[slot].heap_index = _heap.size();
+        _heap.push_back(slot);
+        sift_up(_slots[slot].heap_index);
+        return slot;
+    }
+
+    // The item is reset, so that e.g. its callback is released.
+    void remove(size_t slot)
+    {
+        const size_t index = _slots[slot].heap_index;
+        const size_t last = _heap.size() - 1;
+        if (index != last) {
+            heap_swap(index, last);
+        }
+        _heap.pop_back();
+        if (index < _heap.size()) {
+            update(_heap[index]);
+        }
+
+        Slot &freed = _slots[slot];
+        freed.item = Item {};
+        freed.heap_index = NOT_IN_HEAP;
+        ++freed.generation;
+        _free_slots.push_back(slot);
+    }
+
+    // To be called after the deadline of the item changed.
+    void update(size_t slot)
+    {
+        sift_up(_slots[slot].heap_index);
+        sift_down(_slots[slot].heap_index);
+    }
+
+    // Returns false if the item of the cookie was removed.
+    bool find(const void *cookie, size_t &slot) const
+    {
+        const uintptr_t slot_plus_one =
+            reinterpret_cast<uintptr_t>(cookie) & ((uintptr_t(1) << SLOT_BITS) - 1);
+        if (slot_plus_one == 0 || slot_plus_one > _slots.size()) {
+            return false;
+        }
+        if (_slots[slot_plus_one - 1].heap_index == NOT_IN_HEAP ||
+            cookie_of(slot_plus_one - 1) != cookie) {
+            return false;
+        }
+        slot = slot_plus_one - 1;
+        return true;
+    }
+
+    void *cookie_of(size_t slot) const
+    {
+        // The slot is offset by one so that no cookie is ever nullptr.
+        return reinterpret_cast<void *>((_slots[slot].generation << SLOT_BITS) |
+                                        uintptr_t(slot + 1));
+    }
+
+    Item &operator[](size_t slot) { return _slots[slot].item; }
+
+    bool empty() const { return _heap.empty(); }
+    size_t size() const { return _heap.size(); }
+
+    // The slot of the item with the earliest deadline, if not empty.
+    size_t front() const { return _heap.front(); }
+
+    // Calls f(slot, item) for all items, in no particular order.
+    template<typename F>
+    void for_each(F f)
+    {
+        for (size_t slot = 0; slot < _slots.size(); ++slot) {
+            if (_slots[slot].heap_index != NOT_IN_HEAP) {
+                f(slot, _slots[slot].item);
+            }
+        }
+    }
+
+    // Non-copyable
+    DeadlineHeap(const DeadlineHeap &) = delete;
+    const DeadlineHeap &operator=(const DeadlineHeap &) = delete;
+
+private:
+    struct Slot {
+        Item item;
+        // Position in _heap, or NOT_IN_HEAP if the slot is free.
+        size_t heap_index;
+        // Incremented whenever the slot is freed, so that old cookies don't
+        // match the next item using the slot.
+        uintptr_t generation;
+    };
+
+    static constexpr size_t NOT_IN_HEAP = SIZE_MAX;
+    static constexpr unsigned SLOT_BITS = sizeof(uintptr_t) * 4;
+
+    bool is_earlier(size_t lhs, size_t rhs) const
+    {
+        return _slots[_heap[lhs]].item.deadline < _slots[_heap[rhs]].item.deadline;
+    }
+
+    void heap_swap(size_t lhs, size_t rhs)
+    {
+        std::swap(_heap[lhs], _heap[rhs]);
+        _slots[_heap[lhs]].heap_index = lhs;
+        _slots[_heap[rhs]].heap_index = rhs;
+    }
+
+    void sift_up(size_t index)
+    {
+        while (index > 0) {
+            const size_t parent = (index - 1) / 2;
+            if (!is_earlier(index, parent)) {
+                break;
+            }
+            heap_swap(index, parent);
+            index = parent;
+        }
+    }
+
+    void sift_down(size_t index)
+    {
+        while (true) {
+            const size_t left = 2 * index + 1;
+            const size_t right = left + 1;
+            size_t earliest = index;
+
+            if (left < _heap.size() && is_earlier(left, earliest)) {
+                earliest = left;
+            }
+            if (right < _heap.size() && is_earlier(right, earliest)) {
+                earliest = right;
+            }
+            if (earliest == index) {
+                break;
+            }
+            heap_swap(index, earliest);
+            index = earliest;
+        }
+    }
+
+    std::vector<Slot> _slots {};
+    std::vector<size_t> _free_slots {};
+    std::vector<size_t> _heap {};
+};
+
+template<typename Item>
+constexpr size_t DeadlineHeap<Item>::NOT_IN_HEAP;
+template<typename Item>
+constexpr unsigned DeadlineHeap<Item>::SLOT_BITS;
+
+} // namespace dronecore
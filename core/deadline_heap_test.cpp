@@ -0,0 +1,88 @@
+#include "deadline_heap.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace dronecore;
+
+namespace {
+
+struct Item {
+    int deadline;
+    int value;
+};
+
+} // namespace
+
+TEST(DeadlineHeap, KeepsEarliestInFront)
+{
+    DeadlineHeap<Item> heap;
+    EXPECT_TRUE(heap.empty());
+
+    for (int deadline : {5, 3, 8, 1, 9, 2}) {
+        heap.add(Item {deadline, deadline * 10});
+    }
+    EXPECT_EQ(heap.size(), 6u);
+
+    std::vector<int> deadlines;
+    while (!heap.empty()) {
+        const size_t slot = heap.front();
+        deadlines.push_back(heap[slot].deadline);
+        EXPECT_EQ(heap[slot].value, heap[slot].deadline * 10);
+        heap.remove(slot);
+    }
+    EXPECT_EQ(deadlines, (std::vector<int> {1, 2, 3, 5, 8, 9}));
+}
+
+TEST(DeadlineHeap, ReordersUpdatedItems)
+{
+    DeadlineHeap<Item> heap;
+    const size_t first = heap.add(Item {1, 0});
+    const size_t second = heap.add(Item {2, 0});
+    heap.add(Item {3, 0});
+
+    heap[first].deadline = 4;
+    heap.update(first);
+    EXPECT_EQ(heap.front(), second);
+
+    heap[first].deadline = 0;
+    heap.update(first);
+    EXPECT_EQ(heap.front(), first);
+}
+
+TEST(DeadlineHeap, DoesNotReuseCookies)
+{
+    DeadlineHeap<Item> heap;
+    const size_t slot = heap.add(Item {1, 0});
+    void *cookie = heap.cookie_of(slot);
+    EXPECT_NE(cookie, nullptr);
+
+    size_t found = 0;
+    EXPECT_TRUE(heap.find(cookie, found));
+    EXPECT_EQ(found, slot);
+
+    heap.remove(slot);
+    EXPECT_FALSE(heap.find(cookie, found));
+
+    // The slot is recycled, but the old cookie does not match.
+    const size_t next_slot = heap.add(Item {2, 0});
+    EXPECT_EQ(next_slot, slot);
+    EXPECT_FALSE(heap.find(cookie, found));
+    EXPECT_TRUE(heap.find(heap.cookie_of(next_slot), found));
+
+    EXPECT_FALSE(heap.find(nullptr, found));
+}
+
+TEST(DeadlineHeap, VisitsAllItems)
+{
+    DeadlineHeap<Item> heap;
+    heap.add(Item {1, 10});
+    const size_t removed = heap.add(Item {2, 20});
+    heap.add(Item {3, 30});
+    heap.remove(removed);
+
+    int sum = 0;
+    heap.for_each([&sum](size_t, const Item & item) {
+        sum += item.value;
+    });
+    EXPECT_EQ(sum, 40);
+}
@@ -2,6 +2,9 @@
 
 #include "dronecore_impl.h"
 #include "global_include.h"
+#include "simulated_clock.h"
+#include "thread_roles.h"
+#include "trace_recorder.h"
 
 namespace dronecore {
 
@@ -19,6 +22,12 @@ ConnectionResult DroneCore::add_any_connection(const std::string &connection_url
     return _impl->add_any_connection(connection_url);
 }
 
+ConnectionResult DroneCore::add_any_connection(const std::string &connection_url,
+                                               const ForwardingConfig &forwarding)
+{
+    return _impl->add_any_connection(connection_url, forwarding);
+}
+
 ConnectionResult DroneCore::add_link_connection(const std::string &protocol,
                                                 const std::string &ip,
                                                 const int port)
@@ -31,18 +40,35 @@ ConnectionResult DroneCore::add_udp_connection(const int local_port_number)
     return _impl->add_udp_connection(local_port_number);
 }
 
+ConnectionResult DroneCore::add_udp_connection(int local_port_number, const UdpConfig &udp_config)
+{
+    return _impl->add_udp_connection(local_port_number, ForwardingConfig(), udp_config);
+}
+
 ConnectionResult DroneCore::add_tcp_connection(const std::string &remote_ip,
                                                const int remote_port)
 {
     return _impl->add_tcp_connection(remote_ip, remote_port);
 }
 
+ConnectionResult DroneCore::add_tcp_connection(const std::string &remote_ip, int remote_port,
+                                               const TcpConfig &tcp_config)
+{
+    return _impl->add_tcp_connection(remote_ip, remote_port, ForwardingConfig(), tcp_config);
+}
+
 ConnectionResult DroneCore::add_serial_connection(const std::string &dev_path,
                                                   const int baudrate)
 {
     return _impl->add_serial_connection(dev_path, baudrate);
 }
 
+ConnectionResult DroneCore::add_serial_connection(const std::string &dev_path, int baudrate,
+                                                  const SerialConfig &serial_config)
+{
+    return _impl->add_serial_connection(dev_path, baudrate, ForwardingConfig(), serial_config);
+}
+
 std::vector<uint64_t> DroneCore::system_uuids() const
 {
     return _impl->get_system_uuids();
@@ -78,4 +104,194 @@ void DroneCore::register_on_timeout(const event_callback_t callback)
     _impl->register_on_timeout(callback);
 }
 
+void DroneCore::set_callback_executor(callback_executor_t executor)
+{
+    _impl->set_callback_executor(executor);
+}
+
+void DroneCore::set_executor(std::shared_ptr<Executor> executor)
+{
+    _impl->set_executor(executor);
+}
+
+void DroneCore::set_callback_thread_count(unsigned num_threads)
+{
+    _impl->set_callback_thread_count(num_threads);
+}
+
+bool DroneCore::set_receive_shard_count(unsigned num_shards)
+{
+    return _impl->set_receive_shard_count(num_shards);
+}
+
+DroneCore::DispatchStats DroneCore::dispatch_stats(DispatchClass dispatch_class) const
+{
+    return _impl->dispatch_stats(dispatch_class);
+}
+
+void DroneCore::enable_plugins_on_first_use(bool enable)
+{
+    _impl->enable_plugins_on_first_use(enable);
+}
+
+void DroneCore::set_idle_timeout(double timeout_s)
+{
+    _impl->set_idle_timeout(timeout_s);
+}
+
+void DroneCore::register_on_link_state(link_state_callback_t callback)
+{
+    _impl->register_on_link_state(callback);
+}
+
+void DroneCore::set_link_loss_timeouts(double degraded_timeout_s, double lost_timeout_s)
+{
+    _impl->set_link_loss_timeouts(degraded_timeout_s, lost_timeout_s);
+}
+
+bool DroneCore::set_link_capture(unsigned link_index, const std::string &path)
+{
+    return _impl->set_link_capture(link_index, path);
+}
+
+bool DroneCore::set_state_dir(const std::string &dir)
+{
+    return _impl->set_state_dir(dir);
+}
+
+void DroneCore::set_thread_config(ThreadRole role, const ThreadConfig &config)
+{
+    ThreadRoles::set_config(role, config);
+}
+
+MemoryResource *DroneCore::set_memory_resource(MemoryResource *resource)
+{
+    return set_default_resource(resource);
+}
+
+void DroneCore::enable_simulated_time(bool enable)
+{
+    SimulatedClock::set_enabled(enable);
+}
+
+void DroneCore::advance_simulated_time(double duration_s)
+{
+    SimulatedClock::advance(duration_s);
+}
+
+bool DroneCore::set_link_budget(unsigned link_index, double bytes_per_s)
+{
+    return _impl->set_link_budget(link_index, bytes_per_s);
+}
+
+bool DroneCore::set_link_send_queue(unsigned link_index, size_t max_queued,
+                                    SendOverflow overflow)
+{
+    return _impl->set_link_send_queue(link_index, max_queued, overflow);
+}
+
+bool DroneCore::set_link_framing(unsigned link_index, MavlinkFraming framing)
+{
+    return _impl->set_link_framing(link_index, framing);
+}
+
+bool DroneCore::remove_connection(unsigned link_index)
+{
+    return _impl->remove_connection(link_index);
+}
+
+std::vector<DroneCore::LinkStats> DroneCore::link_stats() const
+{
+    return _impl->link_stats();
+}
+
+void DroneCore::enable_message_tracing(bool enable)
+{
+    _impl->enable_message_tracing(enable);
+}
+
+std::vector<DroneCore::MessageLatencies> DroneCore::message_latencies() const
+{
+    return _impl->message_latencies();
+}
+
+void DroneCore::enable_trace_recording(bool enable)
+{
+    TraceRecorder::instance().set_enabled(enable);
+}
+
+bool DroneCore::write_trace(const std::string &path) const
+{
+    return TraceRecorder::instance().write_chrome_json(path);
+}
+
+DroneCore::CallbackUsage DroneCore::callback_usage(uint64_t uuid) const
+{
+    return _impl->callback_usage(uuid);
+}
+
+DroneCore::ResourceUsage DroneCore::resource_usage(uint64_t uuid) const
+{
+    return _impl->resource_usage(uuid);
+}
+
+DroneCore::ResourceUsage DroneCore::total_resource_usage() const
+{
+    return _impl->total_resource_usage();
+}
+
+std::vector<DroneCore::FleetCommandReport>
+DroneCore::send_fleet_command(FleetCommand command, const std::vector<uint64_t> &uuids)
+{
+    return _impl->send_fleet_command(command, uuids);
+}
+
+void DroneCore::send_fleet_command_async(FleetCommand command, const std::vector<uint64_t> &uuids,
+                                         fleet_command_callback_t callback)
+{
+    _impl->send_fleet_command_async(command, uuids, callback);
+}
+
+void DroneCore::get_fleet_telemetry(FleetTelemetry &fleet_telemetry) const
+{
+    _impl->get_fleet_telemetry(fleet_telemetry);
+}
+
+std::vector<uint64_t> DroneCore::get_fleet_within_radius(uint64_t uuid, double radius_m) const
+{
+    return _impl->get_fleet_within_radius(uuid, radius_m);
+}
+
+std::vector<uint64_t> DroneCore::get_fleet_nearest(uint64_t uuid, unsigned k) const
+{
+    return _impl->get_fleet_nearest(uuid, k);
+}
+
+std::vector<uint64_t>
+DroneCore::get_fleet_inside_polygon(const std::vector<FleetVertex> &polygon) const
+{
+    return _impl->get_fleet_inside_polygon(polygon);
+}
+
+const char *DroneCore::fleet_command_result_str(FleetCommandResult result)
+{
+    switch (result) {
+        case FleetCommandResult::SUCCESS:
+            return "Success";
+        case FleetCommandResult::NO_SYSTEM:
+            return "No system";
+        case FleetCommandResult::CONNECTION_ERROR:
+            return "Connection error";
+        case FleetCommandResult::BUSY:
+            return "Busy";
+        case FleetCommandResult::COMMAND_DENIED:
+            return "Command denied";
+        case FleetCommandResult::TIMEOUT:
+            return "Timeout";
+        case FleetCommandResult::UNKNOWN:
+        default:
+            return "Unknown";
+    }
+}
+
 } // namespace dronecore
@@ -6,10 +6,12 @@
 #include <functional>
 
 #include "connection_result.h"
+#include "memory_resource.h"
 
 namespace dronecore {
 
 class DroneCoreImpl;
+class Executor;
 class System;
 
 /**
@@ -45,22 +47,60 @@ public:
     /**
      * @brief Adds Connection via URL
      *
-     * Supports connection: Serial, TCP or UDP.
+     * Supports connection: Serial, TCP, UDP or shared memory.
      * Connection URL format should be:
      * - UDP - udp://[Bind_host][:Bind_port]
      * - TCP - tcp://[Server_host][:Server_port]
      * - Serial - serial://[Dev_Node][:Baudrate]
+     * - Shared memory - shm://Name, e.g. to a simulator on the same machine (Linux only)
+     * - Replay - replay://Path[:Speed], a .tlog or pcap recording, at the recorded speed times
+     *   Speed (defaults to 1), 0 for as fast as possible
+     * - Simulated - sim://[Number], that many simulated vehicles (defaults to 1), see
+     *   enable_simulated_time()
      *
      * Default URL : udp://:14540.
      * - Default Bind host IP is localhost(127.0.0.1)
      *
      * Warning: serial connections are not supported on Windows (they are supported on Linux and macOS).
      *
+     * A shared memory connection exchanges messages through the POSIX shared memory "/Name",
+     * which is created by whichever side is first. The layout for the other side is described
+     * by ShmSegment in core/shm_ring.h.
+     *
      * @param connection_url connection URL string.
      * @return The result of adding the connection.
      */
     ConnectionResult add_any_connection(const std::string &connection_url = DEFAULT_UDP_CONNECTION_URL);
 
+    /**
+     * @brief Forwarding of received messages for a connection.
+     *
+     * With it, DroneCore acts as a MAVLink router, e.g. for a ground station or
+     * a logger next to it. Messages received on a forwarding connection are
+     * forwarded to all other connections, and messages received on any other
+     * connection are forwarded to it. Frames are forwarded as they were
+     * received, without decoding and encoding them again.
+     *
+     * Messages for a specific system are only forwarded to the connection
+     * this system was last heard on, and to forwarding connections.
+     */
+    struct ForwardingConfig {
+        bool enabled = false; /**< @brief Whether the connection takes part in forwarding. */
+        /** @brief Message ids to forward to the connection, all if empty. */
+        std::vector<uint32_t> message_ids {};
+    };
+
+    /**
+     * @brief Adds Connection via URL and forwards messages to and from it.
+     *
+     * @param connection_url connection URL string, as for add_any_connection().
+     * @param forwarding Forwarding for the connection.
+     * @return The result of adding the connection.
+     * @sa ForwardingConfig
+     */
+    ConnectionResult add_any_connection(const std::string &connection_url,
+                                        const ForwardingConfig &forwarding);
+
     /**
      * @brief Adds a UDP connection to the specified port number.
      *
@@ -69,6 +109,44 @@ public:
      */
     ConnectionResult add_udp_connection(int local_port_number = DEFAULT_UDP_PORT);
 
+    /**
+     * @brief How the socket of a UDP connection is set up.
+     *
+     * The buffer sizes are capped by the system, e.g. by net.core.rmem_max on Linux, a warning
+     * is logged if less than asked for is given. Kernel timestamps and busy polling are only
+     * supported on Linux. With busy polling the connection reads in a thread of its own, as only
+     * blocking reads busy poll, and it might need CAP_NET_ADMIN.
+     */
+    struct UdpConfig {
+        /** @brief Size of the socket's receive buffer in bytes, 0 for the system default. */
+        int recv_buffer_bytes = 0;
+        /** @brief Size of the socket's send buffer in bytes, 0 for the system default. */
+        int send_buffer_bytes = 0;
+        /**
+         * @brief Whether messages are stamped with when the kernel received them (SO_TIMESTAMPNS)
+         * instead of when they were read from the socket.
+         */
+        bool kernel_timestamps = false;
+        /** @brief How long to busy poll for datagrams (SO_BUSY_POLL) in microseconds, 0 for not. */
+        unsigned busy_poll_us = 0;
+        /**
+         * @brief Maximum number of datagrams read with one call (recvmmsg), only used on Linux.
+         * More cost less per datagram at high rates, 0 is taken as 1.
+         */
+        unsigned recv_batch_size = 16;
+    };
+
+    /**
+     * @brief Adds a UDP connection to the specified port number, with the socket set up as
+     * configured.
+     *
+     * @param local_port_number The local UDP port to listen to.
+     * @param udp_config How the socket is set up.
+     * @return The result of adding the connection.
+     * @sa UdpConfig
+     */
+    ConnectionResult add_udp_connection(int local_port_number, const UdpConfig &udp_config);
+
     /**
      * @brief Adds a TCP connection with a specific IP address and port number.
      *
@@ -79,6 +157,41 @@ public:
     ConnectionResult add_tcp_connection(const std::string &remote_ip = DEFAULT_TCP_REMOTE_IP,
                                         int remote_port = DEFAULT_TCP_REMOTE_PORT);
 
+    /**
+     * @brief How a TCP connection sends and reconnects.
+     *
+     * Once the connection breaks, e.g. because SITL was restarted, it is connected again,
+     * waiting reconnect_min_s after the first attempt and twice as long after every failed one,
+     * up to reconnect_max_s. Messages sent in between are dropped.
+     */
+    struct TcpConfig {
+        /** @brief Whether to set TCP_NODELAY, i.e. not to wait to fill segments (Nagle). */
+        bool no_delay = true;
+        /**
+         * @brief How long messages may wait to be sent together with later ones, in seconds.
+         *
+         * 0 sends every message on its own, right away.
+         */
+        double write_coalesce_s = 0.001;
+        /** @brief Wait before the first attempt to reconnect, in seconds. */
+        double reconnect_min_s = 0.5;
+        /** @brief Longest wait between attempts to reconnect, in seconds. */
+        double reconnect_max_s = 30.0;
+    };
+
+    /**
+     * @brief Adds a TCP connection with a specific IP address and port number, sending and
+     * reconnecting as configured.
+     *
+     * @param remote_ip Remote IP address to connect to.
+     * @param remote_port The TCP port to connect to.
+     * @param tcp_config How the connection sends and reconnects.
+     * @return The result of adding the connection.
+     * @sa TcpConfig
+     */
+    ConnectionResult add_tcp_connection(const std::string &remote_ip, int remote_port,
+                                        const TcpConfig &tcp_config);
+
     /**
      * @brief Adds a serial connection with a specific port (COM or UART dev node) and baudrate as specified.
      *
@@ -92,6 +205,42 @@ public:
     ConnectionResult add_serial_connection(const std::string &dev_path = DEFAULT_SERIAL_DEV_PATH,
                                            int baudrate = DEFAULT_SERIAL_BAUDRATE);
 
+    /**
+     * @brief How a serial port is read and written.
+     *
+     * The port is served by a thread of its own, which also writes what was sent, so that
+     * sending never waits for the UART. Reads are batched like with VMIN and VTIME: bytes are
+     * passed on to the parser once read_min_bytes are there, or once no byte arrived for
+     * read_timeout_ds. The defaults pass on every byte right away.
+     */
+    struct SerialConfig {
+        /** @brief Bytes to collect before parsing them, as VMIN (1..255). */
+        unsigned read_min_bytes = 1;
+        /** @brief Time without a new byte after which fewer are parsed, in 0.1 s, as VTIME. */
+        unsigned read_timeout_ds = 0;
+        /** @brief Size of the read buffer in bytes. */
+        unsigned read_buffer_size = 16384;
+        /** @brief Bytes which may wait to be written, beyond that messages are dropped. */
+        unsigned write_queue_size = 65536;
+        /** @brief Whether to ask the driver for low latency (ASYNC_LOW_LATENCY, Linux only). */
+        bool low_latency = true;
+    };
+
+    /**
+     * @brief Adds a serial connection with a specific port and baudrate, read and written as
+     * configured.
+     *
+     * Warning: this method is not supported on Windows (it is supported on Linux and macOS).
+     *
+     * @param dev_path COM or UART dev node name/path.
+     * @param baudrate Baudrate of the serial port.
+     * @param serial_config How the port is read and written.
+     * @return The result of adding the connection.
+     * @sa SerialConfig
+     */
+    ConnectionResult add_serial_connection(const std::string &dev_path, int baudrate,
+                                           const SerialConfig &serial_config);
+
     /**
      * @brief Get vector of system UUIDs.
      *
@@ -181,6 +330,764 @@ public:
      */
     void register_on_timeout(event_callback_t callback);
 
+    /**
+     * @brief How recently anything was received from a system.
+     */
+    enum class LinkState {
+        OK, /**< @brief Messages are coming in. */
+        DEGRADED, /**< @brief Nothing received for the degraded timeout. */
+        LOST /**< @brief Nothing received for the lost timeout. */
+    };
+
+    /**
+     * @brief Callback type for link state changes.
+     *
+     * @param uuid UUID of the system.
+     * @param state The state the link to it has gone to.
+     */
+    typedef std::function<void(uint64_t uuid, LinkState state)> link_state_callback_t;
+
+    /**
+     * @brief Register callback for changes of the link state of systems.
+     *
+     * Unlike the timeout, which waits 3 seconds for heartbeats, this counts any message of
+     * the system, and the timeouts are checked at their deadline, to the millisecond, instead
+     * of by the periodic work of the system. Going back to OK is reported with the next
+     * message.
+     *
+     * The callback is called from the thread receiving the messages or from the timer thread
+     * of DroneCore, so it should return quickly.
+     *
+     * **Note** Only one callback can be registered at a time. If this function is called several
+     * times, previous callbacks will be overwritten.
+     *
+     * @param callback Callback to register.
+     */
+    void register_on_link_state(link_state_callback_t callback);
+
+    /**
+     * @brief Set after how long without any message a link is degraded or lost.
+     *
+     * This applies to all systems, also those already found.
+     *
+     * @param degraded_timeout_s Time until DEGRADED, 1 s by default.
+     * @param lost_timeout_s Time until LOST, 3 s by default, at least the degraded timeout.
+     */
+    void set_link_loss_timeouts(double degraded_timeout_s, double lost_timeout_s);
+
+    /**
+     * @brief Type of an executor for user callbacks.
+     *
+     * The executor gets a function which has to be called eventually, on any thread.
+     */
+    typedef std::function<void(std::function<void()> work)> callback_executor_t;
+
+    /**
+     * @brief Set what runs the callbacks of plugins, e.g. telemetry subscriptions.
+     *
+     * By default, callbacks are run on a thread of DroneCore, one after the other, so
+     * that slow callbacks don't hold up receiving. With an executor set, they are run
+     * by it instead, e.g. by an event loop or a thread pool of the application.
+     *
+     * Either way, callbacks of one topic of a system are called in order and never
+     * concurrently. If telemetry callbacks can't keep up, the oldest updates are
+     * dropped.
+     *
+     * @param executor Executor to use, or `nullptr` to go back to the default.
+     */
+    void set_callback_executor(callback_executor_t executor);
+
+    /**
+     * @brief Set the Executor which runs the callbacks of plugins, including the results of
+     * async calls.
+     *
+     * Like set_callback_executor(), e.g. with an InlineExecutor or a ThreadPoolExecutor from
+     * "executor.h". DroneCore keeps the executor until another one is set.
+     *
+     * @param executor Executor to use, or `nullptr` to go back to the default.
+     */
+    void set_executor(std::shared_ptr<Executor> executor);
+
+    /**
+     * @brief Set how many threads of DroneCore run the callbacks of plugins.
+     *
+     * These threads are shared by all systems, so many vehicles can be handled within a fixed
+     * number of threads. One is enough for a few vehicles, with hundreds it can take more to
+     * keep up. Callbacks of one topic of a system are still called in order and never
+     * concurrently. This has no effect while an executor is set with set_callback_executor().
+     *
+     * The number can only be raised, the default is 1.
+     *
+     * @param num_threads Number of threads for callbacks.
+     */
+    void set_callback_thread_count(unsigned num_threads);
+
+    /**
+     * @brief Dispatch received messages on a number of shared threads.
+     *
+     * By default, messages are parsed and handled on the thread which receives them, so all
+     * vehicles on one port share one core. With shards, the receive thread only frames the
+     * messages and hands them over to one of `num_shards` threads, chosen by system ID.
+     * Messages of one system are still handled in the order they arrived, while different
+     * systems are handled in parallel.
+     *
+     * Messages of DispatchClass::PRIORITY, such as command acks, are handled ahead of the bulk
+     * streams queued on the same shard, so the order is only kept within each class.
+     *
+     * This can only be set before the first connection is added.
+     *
+     * @param num_shards Number of threads, 0 (the default) to handle messages on the receive
+     *        thread.
+     * @return `false` if there are connections already.
+     */
+    bool set_receive_shard_count(unsigned num_shards);
+
+    /**
+     * @brief Classes of received messages, see set_receive_shard_count().
+     */
+    enum class DispatchClass {
+        /** @brief Control and transactions, e.g. heartbeats, command acks and the replies
+         * of mission and param transfers. */
+        PRIORITY,
+        BULK /**< @brief Streams, e.g. telemetry, log data and camera captures. */
+    };
+
+    /**
+     * @brief Dispatch statistics of one class of messages.
+     */
+    struct DispatchStats {
+        uint64_t num_dispatched; /**< @brief Messages handled on the shards. */
+        uint64_t queue_depth; /**< @brief Messages waiting to be handled right now. */
+        /** @brief Most messages that were ever waiting on one shard at once. */
+        uint64_t max_queue_depth;
+    };
+
+    /**
+     * @brief Get the dispatch statistics of one class of messages.
+     *
+     * Without shards messages are handled as they arrive and all counters stay zero.
+     *
+     * @param dispatch_class Class of the messages.
+     * @return Statistics summed over all shards.
+     */
+    DispatchStats dispatch_stats(DispatchClass dispatch_class) const;
+
+    /**
+     * @brief Only enable plugins once they are used.
+     *
+     * By default, a plugin sets up everything it might need as soon as its system is
+     * discovered, e.g. telemetry reads the calibration params for the health. Over a slow
+     * link this holds up what is actually needed. With this set, plugins which support it
+     * wait with that until a getter or subscription needing it is first called.
+     *
+     * This applies to plugins constructed afterwards.
+     *
+     * @param enable `true` to enable plugins on first use, `false` (the default) to enable
+     *        them on discovery.
+     */
+    void enable_plugins_on_first_use(bool enable);
+
+    /**
+     * @brief Stop sending heartbeats while nothing is received, to save power.
+     *
+     * Once nothing has been received on any connection for the timeout, DroneCore goes
+     * idle and stops sending heartbeats. Systems already stop their periodic work while they
+     * are disconnected, so an idle DroneCore does not wake up at all, which helps the battery
+     * of a handheld ground station. The next received message or a new connection wakes it
+     * up again, and a heartbeat is sent right away then.
+     *
+     * Only use this with vehicles which send without hearing from us first.
+     *
+     * @param timeout_s Time without any received message before going idle, 0 (the
+     *        default) to keep sending heartbeats.
+     */
+    void set_idle_timeout(double timeout_s);
+
+    /**
+     * @brief Keep what is found out about systems in a directory, for a quick restart.
+     *
+     * For each system, the UUID, components, autopilot version and the hashes of the
+     * missions it holds are kept in the directory. After a restart, a system found there
+     * is discovered with its first heartbeat already, instead of after asking for its
+     * autopilot version again, which is then only checked in the background. Uploading a
+     * mission the vehicle already holds is skipped, as it was before the restart.
+     *
+     * The cached params and camera definitions are kept in subdirectories of it too, instead
+     * of in $DRONECORE_PARAM_CACHE_DIR and $DRONECORE_CAMERA_DEFINITION_CACHE_DIR.
+     *
+     * Call this before adding connections; systems found before keep working without it.
+     * Not supported on Windows.
+     *
+     * @param dir Directory to use, made if needed, or an empty string to stop using one.
+     * @return true if the directory can be used.
+     */
+    bool set_state_dir(const std::string &dir);
+
+    /**
+     * @brief What a thread of DroneCore is used for, see set_thread_config().
+     */
+    enum class ThreadRole {
+        RECEIVE, /**< @brief Reading from connections and parsing messages. */
+        DISPATCH, /**< @brief Handling messages, see set_receive_shard_count(). */
+        CALLBACK, /**< @brief Calling back the application. */
+        WORK, /**< @brief Timeouts, retries and periodic work of all systems. */
+        SEND, /**< @brief Sending queued messages. */
+        OFFBOARD, /**< @brief Sending offboard setpoints. */
+        HTTP, /**< @brief Downloads. */
+        LOGGING /**< @brief Writing log files and log output. */
+    };
+
+    /**
+     * @brief Scheduling policies for set_thread_config().
+     */
+    enum class ThreadPolicy {
+        NORMAL, /**< @brief The default time-sharing scheduling. */
+        FIFO, /**< @brief Real-time, SCHED_FIFO. */
+        ROUND_ROBIN /**< @brief Real-time, SCHED_RR. */
+    };
+
+    /**
+     * @brief How to set up the threads of one role.
+     */
+    struct ThreadConfig {
+        /** @brief Name of the threads, e.g. in top or a debugger, empty for the default name.
+         * At most 15 characters are used. */
+        std::string name;
+        std::vector<unsigned> cpus; /**< @brief CPUs the threads can run on, empty for any. */
+        ThreadPolicy policy; /**< @brief Scheduling policy. */
+        int priority; /**< @brief Priority for the real-time policies, ignored for NORMAL. */
+    };
+
+    /**
+     * @brief Set the name, CPUs and scheduling of the threads of a role.
+     *
+     * Some threads, e.g. the one doing the work of all systems, are shared by all instances
+     * of DroneCore, so this applies to the whole process. Threads are set up when they are
+     * started, so this needs to be called before the connections are added. Without a
+     * config, threads get a default name and are left as they are otherwise.
+     *
+     * Affinity and scheduling are only supported on Linux. Real-time policies usually need
+     * privileges, if they can't be set a warning is logged and the thread runs anyway.
+     *
+     * @param role Role of the threads to set up.
+     * @param config How to set them up.
+     */
+    static void set_thread_config(ThreadRole role, const ThreadConfig &config);
+
+    /**
+     * @brief Set the memory resource internals like queues and handler tables allocate from.
+     *
+     * Internals take the resource when they are constructed, so this needs to be called
+     * before DroneCore is created and the connections are added. The resource needs to
+     * outlive them. This applies to the whole process.
+     *
+     * @param resource The resource to use, nullptr to use new and delete again.
+     * @return The resource used before.
+     */
+    static MemoryResource *set_memory_resource(MemoryResource *resource);
+
+    /**
+     * @brief Drive all scheduling of DroneCore by a simulated clock instead of the real one.
+     *
+     * The simulated time only moves on with advance_simulated_time(), which runs all
+     * timeouts, retries and periodic work due meanwhile, e.g. heartbeats, in the order of
+     * their deadlines. With simulated vehicles from a "sim://" connection, a scenario of an
+     * hour runs in seconds, and the same way every time.
+     *
+     * This needs to be called before DroneCore is created and applies to the whole process.
+     * Blocking calls wait for real time, so only the asynchronous API can be used meanwhile.
+     *
+     * @param enable `true` for the simulated clock, `false` (the default) for the real one.
+     */
+    static void enable_simulated_time(bool enable);
+
+    /**
+     * @brief Move the simulated clock on and run everything that is due meanwhile.
+     *
+     * The work runs on the calling thread, callbacks to the application still go through the
+     * callback executor.
+     *
+     * @param duration_s Simulated time to move on by.
+     */
+    static void advance_simulated_time(double duration_s);
+
+    /**
+     * @brief Receive statistics of one system on a connection, see LinkStats.
+     */
+    struct SystemLinkStats {
+        uint8_t system_id; /**< @brief MAVLink system ID. */
+        uint64_t num_messages; /**< @brief Messages received from it. */
+        /** @brief Messages missing in its sequence numbers, i.e. lost on the way. */
+        uint64_t num_lost;
+    };
+
+    /**
+     * @brief Statistics of a connection.
+     *
+     * If a system is connected over more than one link, e.g. a radio and LTE,
+     * every message is handled only once, as it arrives on the first link.
+     * Copies of it arriving on another link are dropped.
+     */
+    struct LinkStats {
+        /** @brief Messages which arrived on this connection before any other. */
+        uint64_t num_received_first;
+        /** @brief Messages which had already arrived on another connection. */
+        uint64_t num_duplicates;
+        /** @brief How much later the duplicates arrived than on the first connection. */
+        double mean_delay_s;
+        /** @brief Messages which had to wait for the budget or went into the send queue. */
+        uint64_t num_queued;
+        /** @brief Messages which were dropped as the budget was exhausted or the queue full. */
+        uint64_t num_dropped;
+        /** @brief Messages waiting to be sent right now. */
+        uint64_t send_queue_depth;
+        /** @brief Most messages that were ever waiting to be sent at once. */
+        uint64_t max_send_queue_depth;
+        /** @brief Bytes of the messages sent, without forwarded ones. */
+        uint64_t num_bytes_sent;
+        /** @brief Bytes saved by dropping trailing zeros from MAVLink 2 payloads. */
+        uint64_t num_bytes_saved;
+        /** @brief Bytes received, including ones which were not part of a message. */
+        uint64_t num_bytes_received;
+        /** @brief Messages received, including duplicates. */
+        uint64_t num_messages_received;
+        /** @brief Frames dropped because of a wrong checksum. */
+        uint64_t num_crc_errors;
+        /** @brief Messages missing in the sequence numbers of all senders. */
+        uint64_t num_lost;
+        /**
+         * @brief Times bytes had to be skipped to find the start of the next message, or a
+         * broken message was searched for the ones within it.
+         */
+        uint64_t num_resyncs;
+        /** @brief Bytes received which were not part of any message in the end. */
+        uint64_t num_bytes_discarded;
+        /**
+         * @brief How well the connection works, between 0 and 1, from losses, delays and
+         * RADIO_STATUS. Systems heard on several connections are reached on the best one.
+         */
+        float health;
+        /** @brief Statistics of each system heard on this connection. */
+        std::vector<SystemLinkStats> systems;
+    };
+
+    /**
+     * @brief Get the statistics of all connections.
+     *
+     * The counters are always kept and cheap to read, so this can be polled e.g. to alert
+     * on a degrading link.
+     *
+     * @return Statistics in the order the connections were added.
+     */
+    std::vector<LinkStats> link_stats() const;
+
+    /**
+     * @brief Latencies of one stage of handling a type of message.
+     */
+    struct LatencyHistogram {
+        uint64_t num_samples; /**< @brief Messages measured. */
+        double mean_us; /**< @brief Mean latency in microseconds. */
+        uint64_t max_us; /**< @brief Highest latency in microseconds. */
+        /**
+         * @brief Number of messages by latency.
+         *
+         * Element i counts latencies from 2^(i-1) up to below 2^i microseconds, element 0 the
+         * ones below 1 microsecond. The last element also counts everything above.
+         */
+        std::vector<uint64_t> buckets;
+    };
+
+    /**
+     * @brief Where the time goes between a message arriving and its callbacks having run.
+     *
+     * A message with several callbacks is counted once for each of them in callback and total.
+     */
+    struct MessageLatencies {
+        uint32_t message_id; /**< @brief MAVLink message ID. */
+        /** @brief MAVLink message name, empty if it is not known for the dialect in use. */
+        std::string message_name;
+        /** @brief From the datagram being received to the message being parsed. */
+        LatencyHistogram parse;
+        /** @brief From being parsed to its system being found. */
+        LatencyHistogram lookup;
+        /** @brief From its system being found to all plugins having handled it. */
+        LatencyHistogram dispatch;
+        /** @brief From a user callback being queued to it returning. */
+        LatencyHistogram callback;
+        /** @brief From the datagram being received to a user callback returning. */
+        LatencyHistogram total;
+    };
+
+    /**
+     * @brief Start or stop measuring the latencies of received messages, see message_latencies().
+     *
+     * This is off by default. While it is on, every message is timestamped a few times.
+     *
+     * @param enable true to start measuring.
+     */
+    void enable_message_tracing(bool enable);
+
+    /**
+     * @brief Get the latencies measured since tracing was first enabled.
+     *
+     * @return Latencies of each message ID received while tracing, by ascending ID.
+     */
+    std::vector<MessageLatencies> message_latencies() const;
+
+    /**
+     * @brief Start or stop recording a timeline of what DroneCore is doing, see write_trace().
+     *
+     * This covers the messages received on each thread, the work of each system, commands and
+     * params from being sent until they are answered, user callbacks and HTTP transfers. It is
+     * off by default. Starting it again discards what was recorded before.
+     *
+     * The recording is shared by all DroneCore instances of the process.
+     *
+     * @param enable true to start recording.
+     */
+    void enable_trace_recording(bool enable);
+
+    /**
+     * @brief Write the timeline recorded so far to a file.
+     *
+     * The file is in the Chrome trace event format, which can be opened with chrome://tracing
+     * or https://ui.perfetto.dev. Only the latest events are kept.
+     *
+     * @param path Path of the file to write, it is overwritten.
+     * @return true if the file was written.
+     */
+    bool write_trace(const std::string &path) const;
+
+    /**
+     * @brief Time spent in the handlers of one plugin for one message ID.
+     */
+    struct HandlerUsage {
+        /**
+         * @brief Plugin which registered the handlers, e.g. "TelemetryImpl", or part of the
+         * core.
+         */
+
+        std::string owner;
+        uint32_t message_id; /**< @brief MAVLink message ID. */
+        uint64_t num_calls; /**< @brief Messages handled. */
+        double total_s; /**< @brief Time spent in total. */
+        double max_s; /**< @brief Longest time spent on one message. */
+    };
+
+    /**
+     * @brief Time spent in one callback which a plugin has called periodically.
+     */
+    struct PeriodicUsage {
+        double interval_s; /**< @brief How often it is called. */
+        uint64_t num_calls; /**< @brief Times it was called. */
+        double total_s; /**< @brief Time spent in total. */
+        double max_s; /**< @brief Longest time spent in one call. */
+    };
+
+    /**
+     * @brief Where the threads of a system spend their time, see callback_usage().
+     */
+    struct CallbackUsage {
+        /** @brief Message handlers, which run on the thread receiving the message. */
+        std::vector<HandlerUsage> handlers;
+        /** @brief Periodic callbacks, which run on the thread doing the work of all systems. */
+        std::vector<PeriodicUsage> periodic;
+    };
+
+    /**
+     * @brief Get the time spent in the internal callbacks of a system.
+     *
+     * This is always measured, e.g. to find which plugin takes up the receive thread
+     * under load. The time is counted since the system was discovered and includes
+     * time the thread was preempted. User callbacks are not included, as they run
+     * on a thread of their own.
+     *
+     * @param uuid UUID of the system.
+     * @return Usage of the handlers of each plugin, nothing if there is no such system.
+     */
+    CallbackUsage callback_usage(uint64_t uuid) const;
+
+    /**
+     * @brief What a system holds on to, see resource_usage().
+     */
+    struct ResourceUsage {
+        /** @brief Threads running, e.g. of the offboard or camera plugins. */
+        unsigned num_threads;
+        /** @brief Message handlers registered. */
+        uint64_t num_handlers;
+        /** @brief Timeouts and periodic callbacks registered. */
+        uint64_t num_timers;
+        /** @brief Commands and parameter requests which are queued or waiting for an answer. */
+        uint64_t num_queued_work;
+        /** @brief Bytes reserved for the telemetry history. */
+        uint64_t history_bytes;
+        /** @brief Bytes of the mission as last uploaded or downloaded. */
+        uint64_t mission_bytes;
+        /** @brief Bytes of the parsed camera definitions. */
+        uint64_t camera_definition_bytes;
+    };
+
+    /**
+     * @brief Get the resources a system uses, e.g. to enforce a budget for each vehicle
+     * or to find leaks in a long-running ground station.
+     *
+     * The numbers are taken from the plugins when asked for, so this is not meant to be
+     * called at a high rate.
+     *
+     * @param uuid UUID of the system.
+     * @return Usage of the system including all its plugins, all zero if there is no such
+     * system.
+     */
+    ResourceUsage resource_usage(uint64_t uuid) const;
+
+    /**
+     * @brief Get the resources used by all systems together.
+     *
+     * @return Usage of all systems, with all threads DroneCore runs, also the ones of the
+     * connections.
+     */
+    ResourceUsage total_resource_usage() const;
+
+    /**
+     * @brief Limit how much is sent on a connection, e.g. to the capacity of a telemetry radio.
+     *
+     * Beyond the budget, messages are queued and sent in order of priority: heartbeats and
+     * setpoints first, then commands, then everything else such as missions and parameters.
+     * As queues fill up, old setpoints are replaced by new ones and other messages dropped.
+     *
+     * @param link_index Index of the connection in the order the connections were added.
+     * @param bytes_per_s Budget in bytes per second, 0 to send everything right away (default).
+     * @return true if there is such a connection.
+     */
+    bool set_link_budget(unsigned link_index, double bytes_per_s);
+
+    /**
+     * @brief What to drop when the send queue of a connection is full.
+     */
+    enum class SendOverflow {
+        DROP_NEWEST, /**< @brief Refuse the message being sent. */
+        DROP_OLDEST /**< @brief Drop the message which waited longest. */
+    };
+
+    /**
+     * @brief Send on a connection from a thread of its own.
+     *
+     * By default, messages are sent on the thread sending them, so a connection which
+     * blocks, e.g. a serial port which can't keep up, holds up every thread sending,
+     * including the heartbeats. With a send queue, sending only queues the message, and
+     * the connection's own thread sends it, in the order of priority as with a budget.
+     * Setpoints in the queue are replaced by newer ones regardless of the overflow.
+     *
+     * @param link_index Index of the connection in the order the connections were added.
+     * @param max_queued Most messages of each priority to keep, 0 to send right away
+     *        (default).
+     * @param overflow What to drop when the queue is full.
+     * @return true if there is such a connection.
+     */
+    bool set_link_send_queue(unsigned link_index, size_t max_queued, SendOverflow overflow);
+
+    /**
+     * @brief MAVLink version of the messages sent on a connection.
+     */
+    enum class MavlinkFraming {
+        /** @brief MAVLink 2, except to systems which turned out to only speak MAVLink 1. */
+        AUTO,
+        /** @brief Always MAVLink 1, e.g. for radios which can't handle MAVLink 2. */
+        MAVLINK1,
+        /** @brief Always MAVLink 2. */
+        MAVLINK2
+    };
+
+    /**
+     * @brief Set the MAVLink version of the messages sent on a connection.
+     *
+     * MAVLink 2 payloads are sent without trailing zeros, so e.g. a COMMAND_LONG with only a
+     * few params set is shorter. Messages which need MAVLink 2 are always sent with it.
+     * Forwarded messages are left as they arrived.
+     *
+     * @param link_index Index of the connection in the order the connections were added.
+     * @param framing Version to use, AUTO by default.
+     * @return true if there is such a connection.
+     */
+    bool set_link_framing(unsigned link_index, MavlinkFraming framing);
+
+    /**
+     * @brief Record all traffic of a connection as tlog, for looking into an incident later.
+     *
+     * Frames received and sent are recorded as they went through, with the time, in
+     * segments named path-0000.tlog, path-0001.tlog and so on, of up to 64 MiB each. Each
+     * segment can be played back with a replay:// connection or any tool which reads tlogs.
+     *
+     * Receiving and sending only copy the frame, the files are written by a thread of their
+     * own. If it falls behind, frames are left out of the recording, never held up.
+     * Not supported on Windows.
+     *
+     * @param link_index Index of the connection in the order the connections were added.
+     * @param path Path and start of the file names, or an empty string to stop recording.
+     * @return true if there is such a connection and, unless stopping, the first segment
+     *         could be made.
+     */
+    bool set_link_capture(unsigned link_index, const std::string &path);
+
+    /**
+     * @brief Remove a connection, e.g. a serial radio which was unplugged.
+     *
+     * Its thread is stopped and what is still queued for it dropped, while the other
+     * connections keep sending and receiving. Systems reached on it move to another
+     * connection they are heard on. The connections added after it move down one index.
+     *
+     * @param link_index Index of the connection in the order the connections were added.
+     * @return true if there is such a connection.
+     */
+    bool remove_connection(unsigned link_index);
+
+    /**
+     * @brief Commands which can be sent to many systems at once.
+     */
+    enum class FleetCommand {
+        ARM, /**< @brief Arm, without switching to hold mode first as Action::arm() does. */
+        DISARM, /**< @brief Disarm. */
+        KILL, /**< @brief Disarm right away, also in flight. */
+        LAND, /**< @brief Land at the current position. */
+        HOLD, /**< @brief Switch to hold mode. */
+        RETURN_TO_LAUNCH /**< @brief Switch to return to launch mode. */
+    };
+
+    /**
+     * @brief Possible results of a fleet command for one system.
+     */
+    enum class FleetCommandResult {
+        SUCCESS = 0, /**< @brief The command was accepted. */
+        NO_SYSTEM, /**< @brief No system with this UUID is connected. */
+        CONNECTION_ERROR, /**< @brief The command could not be sent. */
+        BUSY, /**< @brief The system is busy. */
+        COMMAND_DENIED, /**< @brief The command was denied. */
+        TIMEOUT, /**< @brief The system did not answer. */
+        UNKNOWN /**< @brief Unspecified error. */
+    };
+
+    /**
+     * @brief Returns a human-readable English string for a FleetCommandResult.
+     *
+     * @param result The enum value for which a human readable string is required.
+     * @return Human readable string for the FleetCommandResult.
+     */
+    static const char *fleet_command_result_str(FleetCommandResult result);
+
+    /**
+     * @brief Result of a fleet command for one system.
+     */
+    struct FleetCommandReport {
+        uint64_t uuid; /**< @brief UUID of the system. */
+        FleetCommandResult result; /**< @brief Result for the system. */
+        double latency_s; /**< @brief Time from sending until the answer. */
+    };
+
+    /**
+     * @brief Callback type for send_fleet_command_async().
+     */
+    typedef std::function<void(const std::vector<FleetCommandReport> &reports)>
+    fleet_command_callback_t;
+
+    /**
+     * @brief Send a command to many systems at once (synchronous).
+     *
+     * The command is sent to all systems before any answer is awaited, so that
+     * it takes about as long as for the slowest system rather than the sum of
+     * all of them. The answers, retries and timeouts are tracked for each
+     * system on its own.
+     *
+     * @param command The command to send.
+     * @param uuids UUIDs of the systems to send it to.
+     * @return Results in the order of `uuids`.
+     */
+    std::vector<FleetCommandReport> send_fleet_command(FleetCommand command,
+                                                       const std::vector<uint64_t> &uuids);
+
+    /**
+     * @brief Send a command to many systems at once (asynchronous).
+     *
+     * @param command The command to send.
+     * @param uuids UUIDs of the systems to send it to.
+     * @param callback Function to call with the results in the order of `uuids`,
+     *        once all systems have answered or timed out.
+     * @sa send_fleet_command()
+     */
+    void send_fleet_command_async(FleetCommand command, const std::vector<uint64_t> &uuids,
+                                  fleet_command_callback_t callback);
+
+    /**
+     * @brief Latest position, heading and battery of all systems, one vector per field.
+     *
+     * Index i of every vector belongs to the system `uuids[i]`. Values which have not been
+     * received yet are NaN.
+     */
+    struct FleetTelemetry {
+        std::vector<uint64_t> uuids; /**< @brief UUIDs of the systems. */
+        std::vector<double> latitude_deg; /**< @brief Latitude in degrees. */
+        std::vector<double> longitude_deg; /**< @brief Longitude in degrees. */
+        /** @brief Altitude AMSL (above mean sea level) in metres. */
+        std::vector<float> absolute_altitude_m;
+        /** @brief Altitude relative to takeoff altitude in metres. */
+        std::vector<float> relative_altitude_m;
+        /** @brief Heading in degrees from north, clockwise. */
+        std::vector<float> heading_deg;
+        std::vector<float> battery_voltage_v; /**< @brief Battery voltage in volts. */
+        /** @brief Battery remaining (range: 0.0 to 1.0). */
+        std::vector<float> battery_remaining_percent;
+    };
+
+    /**
+     * @brief Get a snapshot of the telemetry of all systems at once.
+     *
+     * This needs no Telemetry plugin, the values of all systems are kept by DroneCore.
+     * The snapshot is consistent, none of the values is updated while it is taken.
+     * Passing the same object every time, e.g. every frame of a map, keeps its vectors
+     * from being allocated again.
+     *
+     * @param fleet_telemetry Filled with the values of all systems.
+     */
+    void get_fleet_telemetry(FleetTelemetry &fleet_telemetry) const;
+
+    /**
+     * @brief Get the other systems within a horizontal distance of a system.
+     *
+     * Positions are kept in a grid as they arrive, so this doesn't compare all pairs of
+     * systems. Distances are measured in a local tangent plane around the first position
+     * received, which is accurate for a fleet spread over some tens of kilometres.
+     *
+     * @param uuid UUID of the system in the center.
+     * @param radius_m Distance in metres.
+     * @return UUIDs of the systems within the distance, in no particular order, empty if
+     *         the position of the system is not known.
+     */
+    std::vector<uint64_t> get_fleet_within_radius(uint64_t uuid, double radius_m) const;
+
+    /**
+     * @brief Get the other systems closest to a system, see get_fleet_within_radius().
+     *
+     * @param uuid UUID of the system in the center.
+     * @param k How many systems to get at most.
+     * @return UUIDs of the closest systems, closest first.
+     */
+    std::vector<uint64_t> get_fleet_nearest(uint64_t uuid, unsigned k) const;
+
+    /**
+     * @brief Vertex of a polygon for get_fleet_inside_polygon().
+     */
+    struct FleetVertex {
+        double latitude_deg; /**< @brief Latitude in degrees. */
+        double longitude_deg; /**< @brief Longitude in degrees. */
+    };
+
+    /**
+     * @brief Get the systems inside a polygon, see get_fleet_within_radius().
+     *
+     * @param polygon Vertices of the polygon in order, clockwise or counterclockwise.
+     * @return UUIDs of the systems inside, in no particular order.
+     */
+    std::vector<uint64_t> get_fleet_inside_polygon(const std::vector<FleetVertex> &polygon) const;
+
 private:
     /* @private. */
     std::unique_ptr<DroneCoreImpl> _impl;
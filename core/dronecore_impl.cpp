@@ -1,48 +1,155 @@
 #include "dronecore_impl.h"
 
+#include <memory>
 #include <mutex>
 
+#include "completion.h"
 #include "connection.h"
 #include "global_include.h"
+#include "log.h"
+#include "mavlink_message_table.h"
+#include "simulated_connection.h"
 #include "tcp_connection.h"
+#include "thread_roles.h"
 #include "udp_connection.h"
 #include "system.h"
 #include "mavlink_system.h"
 
 #ifndef WINDOWS
+#include "replay_connection.h"
 #include "serial_connection.h"
+#include "shm_connection.h"
 #endif
 
 namespace dronecore {
 
+constexpr double DroneCoreImpl::HEARTBEAT_INTERVAL_S;
+constexpr float DroneCoreImpl::ROUTE_HYSTERESIS;
+
 DroneCoreImpl::DroneCoreImpl() :
-    _connections_mutex(),
-    _connections(),
-    _systems_mutex(),
+    _connections_mutex("connections"),
+    _connections(std::make_shared<const connections_t>()),
+    _systems_mutex("systems"),
     _systems(),
     _on_discover_callback(nullptr),
     _on_timeout_callback(nullptr)
-{}
+{
+    for (auto &entry : _system_lookup) {
+        entry.system = nullptr;
+        for (auto &bits : entry.component_bits) {
+            bits = 0;
+        }
+    }
+    for (auto &route : _routes) {
+        route = nullptr;
+    }
+    for (auto &score : _route_scores) {
+        score = 0.0f;
+    }
+    for (auto &version : _mavlink_versions) {
+        version = 0;
+    }
+
+    std::lock_guard<std::mutex> lock(_heartbeat_mutex);
+    _last_activity_time = _time.steady_time();
+    schedule_heartbeats();
+}
 
 DroneCoreImpl::~DroneCoreImpl()
 {
+    _should_exit = true;
+
+    TimerScheduler::timer_id_t heartbeat_timer_id;
     {
-        std::lock_guard<std::recursive_mutex> lock(_systems_mutex);
-        _should_exit = true;
+        std::lock_guard<std::mutex> lock(_heartbeat_mutex);
+        heartbeat_timer_id = _heartbeat_timer_id;
+        _heartbeat_timer_id = 0;
+    }
+    // Without _heartbeat_mutex, which send_heartbeats() takes if it is running.
+    // It sees _should_exit then and doesn't schedule another one.
+    TimerScheduler::Instance().cancel(heartbeat_timer_id);
 
-        _systems.clear();
+    // The connections are stopped first, so that no receive thread can still be
+    // dispatching to a system when the systems are destroyed below. All threads
+    // are woken up before the first one is joined, so that they exit together.
+    {
+        std::lock_guard<instrumented_mutex_t> lock(_connections_mutex);
+        const std::shared_ptr<const connections_t> connections = this->connections();
+        std::atomic_store(&_connections, std::make_shared<const connections_t>());
+        _num_connections = 0;
+        for (auto &connection : *connections) {
+            connection->request_stop();
+        }
+        // Not left to whoever drops the last snapshot.
+        for (auto &connection : *connections) {
+            connection->stop();
+        }
+        for (auto &route : _routes) {
+            route = nullptr;
+        }
     }
 
+    // Only then, as the receive threads post to them.
+    _receive_shards.reset();
+
     {
-        std::lock_guard<std::mutex> lock(_connections_mutex);
-        _connections.clear();
+        std::lock_guard<instrumented_recursive_mutex_t> lock(_systems_mutex);
+
+        for (auto &entry : _system_lookup) {
+            entry.system = nullptr;
+        }
+        {
+            std::lock_guard<instrumented_mutex_t> uuid_lock(_systems_by_uuid_mutex);
+            _systems_by_uuid.clear();
+        }
+        _systems.clear();
     }
+
+#if DRONECORE_LOCK_STATS
+    LogInfo() << "Lock stats:\n" << LockStats::get_text();
+#endif
+}
+
+void DroneCoreImpl::receive_message(const mavlink_message_t &message, Connection *connection)
+{
+    receive_message(MAVLinkMessageView(message), connection);
 }
 
-void DroneCoreImpl::receive_message(const mavlink_message_t &message)
+void DroneCoreImpl::receive_message(const MAVLinkMessageView &message, Connection *connection)
 {
+    // Only written once per heartbeat interval, so that receive threads don't
+    // take the cache line from each other for every message.
+    if (!_received_since_heartbeat.load(std::memory_order_relaxed)) {
+        _received_since_heartbeat.store(true, std::memory_order_relaxed);
+    }
+    if (_is_idle.load(std::memory_order_relaxed)) {
+        wake_up_from_idle();
+    }
+
+    if (Topology::SINGLE_SYSTEM && receive_known_message(message, connection)) {
+        return;
+    }
+
+    if (connection != nullptr) {
+        if (_num_connections > 1) {
+            const DuplicateFilter::Result result =
+                _duplicate_filter.check(message.sysid(), message.compid(), message.seq(),
+                                        message.msgid(), connection, _time.elapsed_s());
+            if (result.is_duplicate) {
+                connection->count_duplicate(result.delay_s);
+                return;
+            }
+        }
+        connection->count_received_first();
+    }
+
+    // Also what is not for us, e.g. from a ground station to a vehicle.
+    if (connection != nullptr && _has_forwarding) {
+        forward_message(message, connection);
+    }
+
     // Don't ever create a system with sysid 0.
-    if (message.sysid == 0) {
+    if (message.sysid() == 0) {
         return;
     }
 
@@ -50,24 +157,61 @@ void DroneCoreImpl::receive_message(const mavlink_message_t &message)
     //        itself with sysid 255.
     //        A better way would probably be to parse the heartbeat message and
     //        look at type and check if it is MAV_TYPE_GCS.
-    if (message.sysid == 255) {
+    if (message.sysid() == 255) {
         return;
     }
 
-    std::lock_guard<std::recursive_mutex> lock(_systems_mutex);
+    if (_receive_shards) {
+        _receive_shards->post(message, connection);
+        return;
+    }
+    dispatch_message(message, connection);
+}
+
+void DroneCoreImpl::dispatch_message(const MAVLinkMessageView &message, Connection *connection)
+{
+    if (connection != nullptr &&
+        _routes[message.sysid()].load(std::memory_order_relaxed) != connection) {
+        // Without a route, or if the system went quiet on it, whichever
+        // connection hears it takes over.
+        const float route_score = _route_scores[message.sysid()].load(std::memory_order_relaxed);
+        if (route_score <= 0.0f ||
+            connection->health_score() > route_score + ROUTE_HYSTERESIS) {
+            reroute(message.sysid(), connection);
+        }
+    }
+
+    // Fast path for components we already know, without any locking.
+    if (!_null_system_exists) {
+        const SystemLookupEntry &entry = _system_lookup[message.sysid()];
+        System *system = entry.system;
+        const uint8_t compid = message.compid();
+        if (system != nullptr &&
+            (entry.component_bits[compid / 64] & (uint64_t(1) << (compid % 64)))) {
+            // Messages no plugin asked for are dropped before any decoding.
+            if (!_should_exit && system->accept_message(message.msgid())) {
+                MessageTracer::mark_looked_up();
+                system->process_mavlink_message(message);
+            }
+            return;
+        }
+    }
+
+    std::lock_guard<instrumented_recursive_mutex_t> lock(_systems_mutex);
 
     // Change system id of null system
     if (_systems.find(0) != _systems.end()) {
         auto null_system = _systems[0];
         _systems.erase(0);
-        null_system->set_system_id(message.sysid);
-        _systems.insert(system_entry_t(message.sysid, null_system));
+        null_system->set_system_id(message.sysid());
+        _systems.insert(system_entry_t(message.sysid(), null_system));
+        _null_system_exists = false;
     }
 
-    if (!does_system_exist(message.sysid)) {
-        make_system_with_component(message.sysid, message.compid);
+    if (!does_system_exist(message.sysid())) {
+        make_system_with_component(message.sysid(), message.compid());
     } else {
-        _systems.at(message.sysid)->add_new_component(message.compid);
+        _systems.at(message.sysid())->add_new_component(message.compid());
     }
 
     if (_should_exit) {
@@ -76,30 +220,280 @@ void DroneCoreImpl::receive_message(const mavlink_message_t &message)
         return;
     }
 
-    if (message.sysid != 1) {
-        LogDebug() << "sysid: " << int(message.sysid);
+    update_system_lookup(message.sysid(), message.compid());
+
+    if (_systems.find(message.sysid()) != _systems.end()) {
+        MessageTracer::mark_looked_up();
+        _systems.at(message.sysid())->process_mavlink_message(message);
+    }
+}
+
+bool DroneCoreImpl::receive_known_message(const MAVLinkMessageView &message,
+                                         Connection *connection)
+{
+    // With one connection there is nothing to filter or forward, and once the
+    // route is set it stays on it.
+    if (connection != nullptr &&
+        _routes[message.sysid()].load(std::memory_order_relaxed) != connection) {
+        return false;
+    }
+
+    const SystemLookupEntry &entry = _system_lookup[message.sysid()];
+    System *system = entry.system;
+    const uint8_t compid = message.compid();
+    if (system == nullptr ||
+        !(entry.component_bits[compid / 64] & (uint64_t(1) << (compid % 64)))) {
+        return false;
     }
 
-    if (_systems.find(message.sysid) != _systems.end()) {
-        _systems.at(message.sysid)->process_mavlink_message(message);
+    if (connection != nullptr) {
+        connection->count_received_first();
+    }
+    if (!_should_exit && system->accept_message(message.msgid())) {
+        MessageTracer::mark_looked_up();
+        system->process_mavlink_message(message);
+    }
+    return true;
+}
+
+Connection *DroneCoreImpl::find_route(const connections_t &connections, uint8_t system_id) const
+{
+    Connection *route = _routes[system_id].load(std::memory_order_relaxed);
+    if (route == nullptr) {
+        return nullptr;
+    }
+    // There are only a few connections.
+    for (auto &connection : connections) {
+        if (connection.get() == route) {
+            return route;
+        }
+    }
+    return nullptr;
+}
+
+void DroneCoreImpl::reroute(uint8_t system_id, Connection *connection)
+{
+    const Connection *previous = _routes[system_id].exchange(connection);
+    _route_scores[system_id].store(connection->health_score(), std::memory_order_relaxed);
+    if (previous == nullptr) {
+        return;
+    }
+
+    LogInfo() << "Switching system " << int(system_id) << " to another connection";
+    // What is waiting for an ack was probably lost on the old route, so it is
+    // sent again right away instead of after its timeout.
+    System *system = _system_lookup[system_id].system.load();
+    if (system != nullptr) {
+        system->mavlink_system()->retransmit_commands();
+    }
+}
+
+void DroneCoreImpl::update_route_scores(const connections_t &connections)
+{
+    for (auto &connection : connections) {
+        connection->update_health();
+    }
+
+    for (unsigned system_id = 1; system_id < _routes.size(); ++system_id) {
+        Connection *route = find_route(connections, uint8_t(system_id));
+        if (route == nullptr) {
+            _route_scores[system_id].store(0.0f, std::memory_order_relaxed);
+            continue;
+        }
+        RouteCheck &check = _route_checks[system_id];
+        const uint64_t num_received = route->num_received_from(uint8_t(system_id));
+        const bool is_heard = (check.connection != route || num_received != check.num_received);
+        check = RouteCheck {route, num_received};
+        _route_scores[system_id].store(is_heard ? route->health_score() : 0.0f,
+                                       std::memory_order_relaxed);
+    }
+}
+
+void DroneCoreImpl::forward_message(const MAVLinkMessageView &message, Connection *source)
+{
+    uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+    const uint8_t *frame = message.frame();
+    unsigned frame_len = message.frame_len();
+    if (frame == nullptr) {
+        // Only for frames which mavlink had to parse byte by byte, e.g. ones
+        // split across reads or signed ones.
+        frame_len = mavlink_msg_to_send_buffer(buffer, &message.message());
+        frame = buffer;
+    }
+
+    const uint8_t target_system = Connection::target_system_of(message.msgid(),
+                                                               message.payload(),
+                                                               message.payload_len());
+
+    const std::shared_ptr<const connections_t> connections = this->connections();
+
+    Connection *route = nullptr;
+    if (target_system != 0) {
+        route = find_route(*connections, target_system);
+    }
+
+    for (auto it = connections->begin(); it != connections->end(); ++it) {
+        Connection *connection = it->get();
+        if (connection == source) {
+            continue;
+        }
+        if (!connection->forwards()) {
+            if (!source->forwards()) {
+                continue;
+            }
+            // No need to bother other vehicles with it.
+            if (route != nullptr && route != connection) {
+                continue;
+            }
+        }
+        if (!connection->forwards_message(message.msgid())) {
+            continue;
+        }
+        connection->forward_frame(frame, frame_len, target_system, message.msgid());
     }
 }
 
 bool DroneCoreImpl::send_message(const mavlink_message_t &message)
 {
-    std::lock_guard<std::mutex> lock(_connections_mutex);
+    const uint8_t target_system = Connection::target_system_of(message);
+
+    const std::shared_ptr<const connections_t> connections = this->connections();
+
+    if (target_system != 0) {
+        Connection *connection = find_route(*connections, target_system);
+        if (connection != nullptr) {
+            return connection->send_message(message);
+        }
+    }
 
-    for (auto it = _connections.begin(); it != _connections.end(); ++it) {
-        if (!(**it).send_message(message)) {
+    if (connections->empty()) {
+        return true;
+    }
+
+    // One connection failing does not keep the message from the others.
+    bool success = false;
+    for (auto it = connections->begin(); it != connections->end(); ++it) {
+        if ((**it).send_message(message)) {
+            success = true;
+        } else {
             LogErr() << "send fail";
-            return false;
         }
     }
 
-    return true;
+    return success;
+}
+
+void DroneCoreImpl::send_heartbeat(Connection &connection)
+{
+    mavlink_message_t message;
+    // GCSClient is not autopilot!; hence MAV_AUTOPILOT_INVALID.
+    mavlink_msg_heartbeat_pack(GCSClient::system_id,
+                               GCSClient::component_id,
+                               &message,
+                               MAV_TYPE_GCS,
+                               MAV_AUTOPILOT_INVALID,
+                               0, 0, 0);
+    connection.send_message(message);
+}
+
+void DroneCoreImpl::send_heartbeats()
+{
+    std::lock_guard<std::mutex> lock(_heartbeat_mutex);
+
+    if (_should_exit) {
+        return;
+    }
+
+    {
+        const std::shared_ptr<const connections_t> connections = this->connections();
+        for (auto &connection : *connections) {
+            if (connection->has_peer()) {
+                send_heartbeat(*connection);
+            }
+        }
+        update_route_scores(*connections);
+    }
+
+    if (_received_since_heartbeat.exchange(false)) {
+        _last_activity_time = _time.steady_time();
+
+    } else if (_idle_timeout_s > 0.0 &&
+               _time.elapsed_since_s(_last_activity_time) >= _idle_timeout_s) {
+        _is_idle.store(true);
+        // A message which came in meanwhile might have missed the flag. If the
+        // receive thread still misses it, the next message wakes us up anyway.
+        if (!_received_since_heartbeat.load()) {
+            LogDebug() << "Nothing received for " << _idle_timeout_s << " s, going idle";
+            return;
+        }
+        _is_idle.store(false);
+    }
+
+    schedule_heartbeats();
+}
+
+void DroneCoreImpl::schedule_heartbeats()
+{
+    // We assume that we already acquired _heartbeat_mutex in this function.
+    _heartbeat_timer_id = TimerScheduler::Instance().add(
+                              std::bind(&DroneCoreImpl::send_heartbeats, this),
+                              _time.steady_time_in_future(HEARTBEAT_INTERVAL_S));
+}
+
+void DroneCoreImpl::wake_up_from_idle()
+{
+    std::lock_guard<std::mutex> lock(_heartbeat_mutex);
+
+    if (!_is_idle.exchange(false) || _should_exit) {
+        return;
+    }
+
+    LogDebug() << "Waking up from idle";
+    _last_activity_time = _time.steady_time();
+    // The vehicle hears from us right away, not only after the next interval.
+    _heartbeat_timer_id = TimerScheduler::Instance().add(
+                              std::bind(&DroneCoreImpl::send_heartbeats, this),
+                              _time.steady_time());
+}
+
+void DroneCoreImpl::set_idle_timeout(double timeout_s)
+{
+    {
+        std::lock_guard<std::mutex> lock(_heartbeat_mutex);
+        _idle_timeout_s = timeout_s;
+        _last_activity_time = _time.steady_time();
+    }
+
+    if (timeout_s <= 0.0 && _is_idle.load()) {
+        wake_up_from_idle();
+    }
+}
+
+bool DroneCoreImpl::send_messages(const mavlink_message_t *messages, size_t num_messages)
+{
+    {
+        const std::shared_ptr<const connections_t> connections = this->connections();
+
+        if (connections->empty()) {
+            return true;
+        }
+
+        // With one connection all of them go there, whether routed or not.
+        if (connections->size() == 1) {
+            return connections->front()->send_messages(messages, num_messages);
+        }
+    }
+
+    // Otherwise each message picks its own connections.
+    bool success = true;
+    for (size_t i = 0; i < num_messages; ++i) {
+        success = send_message(messages[i]) && success;
+    }
+    return success;
 }
 
-ConnectionResult DroneCoreImpl::add_any_connection(const std::string &connection_url)
+ConnectionResult DroneCoreImpl::add_any_connection(const std::string &connection_url,
+                                                   const DroneCore::ForwardingConfig &forwarding)
 {
     std::string delimiter = "://";
     std::string conn_url(connection_url);
@@ -121,6 +515,28 @@ ConnectionResult DroneCoreImpl::add_any_connection(const std::string &connection
         }
     }
     connection_str.push_back(conn_url);
+    if (connection_str.at(0) == "shm") {
+        if (connection_str.size() != 2 || connection_str.at(1) == "") {
+            return ConnectionResult::CONNECTION_URL_INVALID;
+        }
+        return add_shm_connection(connection_str.at(1), forwarding);
+    }
+    if (connection_str.at(0) == "replay") {
+        if (connection_str.size() < 2 || connection_str.at(1) == "") {
+            return ConnectionResult::CONNECTION_URL_INVALID;
+        }
+        const double speed = (connection_str.size() > 2 && connection_str.at(2) != "") ?
+                             std::stod(connection_str.at(2)) : 1.0;
+        return add_replay_connection(connection_str.at(1), speed, forwarding);
+    }
+    if (connection_str.at(0) == "sim") {
+        const int num_vehicles = (connection_str.size() > 1 && connection_str.at(1) != "") ?
+                                 std::stoi(connection_str.at(1)) : 1;
+        if (num_vehicles <= 0) {
+            return ConnectionResult::CONNECTION_URL_INVALID;
+        }
+        return add_simulated_connection(unsigned(num_vehicles), forwarding);
+    }
     /* check if the protocol is Network protocol or Serial */
     if (connection_str.at(0) != "serial") {
         int port = 0;
@@ -128,19 +544,21 @@ ConnectionResult DroneCoreImpl::add_any_connection(const std::string &connection
             port = std::stoi(connection_str.at(2));
         }
         return add_link_connection(connection_str.at(0), connection_str.at(1),
-                                   port);
+                                   port, forwarding);
     } else {
         if (connection_str.at(1) == "") {
             return add_serial_connection(DroneCore::DEFAULT_SERIAL_DEV_PATH,
-                                         DroneCore::DEFAULT_SERIAL_BAUDRATE);
+                                         DroneCore::DEFAULT_SERIAL_BAUDRATE, forwarding);
         } else {
-            return add_serial_connection(connection_str.at(1), std::stoi(connection_str.at(2)));
+            return add_serial_connection(connection_str.at(1), std::stoi(connection_str.at(2)),
+                                         forwarding);
         }
     }
 }
 
 ConnectionResult DroneCoreImpl::add_link_connection(const std::string &protocol,
-                                                    const std::string &ip, const int port)
+                                                    const std::string &ip, const int port,
+                                                    const DroneCore::ForwardingConfig &forwarding)
 {
     int local_port_number = 0;
     std::string local_ip = ip;
@@ -155,35 +573,107 @@ ConnectionResult DroneCoreImpl::add_link_connection(const std::string &protocol,
     }
 
     if (protocol == "udp") {
-        return add_udp_connection(local_port_number);
+        return add_udp_connection(local_port_number, forwarding);
     } else { //TCP connection
-        return add_tcp_connection(local_ip, local_port_number);
+        return add_tcp_connection(local_ip, local_port_number, forwarding);
     }
 }
 
-ConnectionResult DroneCoreImpl::add_udp_connection(int local_port_number)
+ConnectionResult DroneCoreImpl::add_udp_connection(int local_port_number,
+                                                   const DroneCore::ForwardingConfig &forwarding,
+                                                   const DroneCore::UdpConfig &udp_config)
 {
-    auto new_conn = std::make_shared<UdpConnection>(*this, local_port_number);
+    if (!may_add_connection()) {
+        return ConnectionResult::CONNECTIONS_EXHAUSTED;
+    }
 
-    ConnectionResult ret = new_conn->start();
+    auto new_conn = std::make_shared<UdpConnection>(*this, local_port_number, udp_config);
+    new_conn->set_forwarding(forwarding);
+
+    ConnectionResult ret = new_conn->start(_io_reactor);
     if (ret == ConnectionResult::SUCCESS) {
         add_connection(new_conn);
     }
     return ret;
 }
 
+bool DroneCoreImpl::may_add_connection() const
+{
+    if (Topology::MAX_CONNECTIONS > 0 && _num_connections >= Topology::MAX_CONNECTIONS) {
+        LogErr() << "This build takes only " << Topology::MAX_CONNECTIONS << " connection(s)";
+        return false;
+    }
+    return true;
+}
+
 void DroneCoreImpl::add_connection(std::shared_ptr<Connection> new_connection)
 {
-    std::lock_guard<std::mutex> lock(_connections_mutex);
-    _connections.push_back(new_connection);
+    {
+        std::lock_guard<instrumented_mutex_t> lock(_connections_mutex);
+        auto connections = std::make_shared<connections_t>(*this->connections());
+        connections->push_back(new_connection);
+        _num_connections = unsigned(connections->size());
+        std::atomic_store(&_connections, std::shared_ptr<const connections_t>(connections));
+        if (new_connection->forwards()) {
+            _has_forwarding = true;
+        }
+    }
+
+    // A new connection gets heartbeats even if the others are quiet.
+    if (_is_idle.load()) {
+        wake_up_from_idle();
+    }
+}
+
+bool DroneCoreImpl::remove_connection(unsigned link_index)
+{
+    std::shared_ptr<Connection> removed;
+    {
+        std::lock_guard<instrumented_mutex_t> lock(_connections_mutex);
+        auto connections = std::make_shared<connections_t>(*this->connections());
+        if (link_index >= connections->size()) {
+            LogErr() << "No connection " << link_index << " to remove";
+            return false;
+        }
+        removed = (*connections)[link_index];
+        connections->erase(connections->begin() + link_index);
+        _num_connections = unsigned(connections->size());
+        std::atomic_store(&_connections, std::shared_ptr<const connections_t>(connections));
+    }
+
+    // Outside of the lock, so that the other connections carry on while its
+    // thread is joined. What is still queued for it is dropped.
+    removed->stop();
+
+    // Messages it received might still wait in the shards, and dispatching
+    // them uses it.
+    if (_receive_shards) {
+        _receive_shards->wait_until_dispatched();
+    }
+
+    // Systems reached on it are routed again by whatever they are heard on next.
+    for (unsigned system_id = 0; system_id < _routes.size(); ++system_id) {
+        Connection *route = removed.get();
+        if (_routes[system_id].compare_exchange_strong(route, nullptr)) {
+            _route_scores[system_id].store(0.0f, std::memory_order_relaxed);
+        }
+    }
+    return true;
 }
 
 ConnectionResult DroneCoreImpl::add_tcp_connection(const std::string &remote_ip,
-                                                   int remote_port)
+                                                   int remote_port,
+                                                   const DroneCore::ForwardingConfig &forwarding,
+                                                   const DroneCore::TcpConfig &tcp_config)
 {
-    auto new_conn = std::make_shared<TcpConnection>(*this, remote_ip, remote_port);
+    if (!may_add_connection()) {
+        return ConnectionResult::CONNECTIONS_EXHAUSTED;
+    }
 
-    ConnectionResult ret = new_conn->start();
+    auto new_conn = std::make_shared<TcpConnection>(*this, remote_ip, remote_port, tcp_config);
+    new_conn->set_forwarding(forwarding);
+
+    ConnectionResult ret = new_conn->start(_io_reactor);
     if (ret == ConnectionResult::SUCCESS) {
         add_connection(new_conn);
     }
@@ -191,11 +681,19 @@ ConnectionResult DroneCoreImpl::add_tcp_connection(const std::string &remote_ip,
 }
 
 ConnectionResult DroneCoreImpl::add_serial_connection(const std::string &dev_path,
-                                                      int baudrate)
+                                                      int baudrate,
+                                                      const DroneCore::ForwardingConfig &forwarding,
+                                                      const DroneCore::SerialConfig &serial_config)
 {
 #if !defined(WINDOWS)
-    auto new_conn = std::make_shared<SerialConnection>(*this, dev_path, baudrate);
+    if (!may_add_connection()) {
+        return ConnectionResult::CONNECTIONS_EXHAUSTED;
+    }
 
+    auto new_conn = std::make_shared<SerialConnection>(*this, dev_path, baudrate, serial_config);
+    new_conn->set_forwarding(forwarding);
+
+    // The port has its own thread, which also writes, so it does not use the reactor.
     ConnectionResult ret = new_conn->start();
     if (ret == ConnectionResult::SUCCESS) {
         add_connection(new_conn);
@@ -204,10 +702,69 @@ ConnectionResult DroneCoreImpl::add_serial_connection(const std::string &dev_pat
 #else
     UNUSED(dev_path);
     UNUSED(baudrate);
+    UNUSED(forwarding);
+    UNUSED(serial_config);
+    return ConnectionResult::NOT_IMPLEMENTED;
+#endif
+}
+
+ConnectionResult DroneCoreImpl::add_shm_connection(const std::string &name,
+                                                   const DroneCore::ForwardingConfig &forwarding)
+{
+#if defined(SHM_CONNECTION_SUPPORTED)
+    if (!may_add_connection()) {
+        return ConnectionResult::CONNECTIONS_EXHAUSTED;
+    }
+
+    auto new_conn = std::make_shared<ShmConnection>(*this, name);
+    new_conn->set_forwarding(forwarding);
+
+    ConnectionResult ret = new_conn->start();
+    if (ret == ConnectionResult::SUCCESS) {
+        add_connection(new_conn);
+    }
+    return ret;
+#else
+    UNUSED(name);
+    UNUSED(forwarding);
     return ConnectionResult::NOT_IMPLEMENTED;
 #endif
 }
 
+ConnectionResult DroneCoreImpl::add_replay_connection(const std::string &path, double speed,
+                                                      const DroneCore::ForwardingConfig &forwarding)
+{
+    if (!may_add_connection()) {
+        return ConnectionResult::CONNECTIONS_EXHAUSTED;
+    }
+
+    auto new_conn = std::make_shared<ReplayConnection>(*this, path, speed);
+    new_conn->set_forwarding(forwarding);
+
+    ConnectionResult ret = new_conn->start();
+    if (ret == ConnectionResult::SUCCESS) {
+        add_connection(new_conn);
+    }
+    return ret;
+}
+
+ConnectionResult DroneCoreImpl::add_simulated_connection(
+    unsigned num_vehicles, const DroneCore::ForwardingConfig &forwarding)
+{
+    if (!may_add_connection()) {
+        return ConnectionResult::CONNECTIONS_EXHAUSTED;
+    }
+
+    auto new_conn = std::make_shared<SimulatedConnection>(*this, num_vehicles);
+    new_conn->set_forwarding(forwarding);
+
+    ConnectionResult ret = new_conn->start();
+    if (ret == ConnectionResult::SUCCESS) {
+        add_connection(new_conn);
+    }
+    return ret;
+}
+
 std::vector<uint64_t> DroneCoreImpl::get_system_uuids() const
 {
     std::vector<uint64_t> uuids = {};
@@ -226,7 +783,7 @@ std::vector<uint64_t> DroneCoreImpl::get_system_uuids() const
 System &DroneCoreImpl::get_system()
 {
     {
-        std::lock_guard<std::recursive_mutex> lock(_systems_mutex);
+        std::lock_guard<instrumented_recursive_mutex_t> lock(_systems_mutex);
         // In get_system withoiut uuid, we expect to have only
         // one system conneted.
         if (_systems.size() == 1) {
@@ -255,20 +812,17 @@ System &DroneCoreImpl::get_system()
 
 System &DroneCoreImpl::get_system(const uint64_t uuid)
 {
-    {
-        std::lock_guard<std::recursive_mutex> lock(_systems_mutex);
-        // TODO: make a cache map for this.
-        for (auto system : _systems) {
-            if (system.second->get_uuid() == uuid) {
-                return *system.second;
-            }
-        }
+    System *system = find_system(uuid);
+    if (system != nullptr) {
+        return *system;
     }
 
     // We have not found a system with this UUID.
     // TODO: this is an error condition that we ought to handle properly.
     LogErr() << "system with UUID: " << uuid << " not found";
 
+    std::lock_guard<instrumented_recursive_mutex_t> lock(_systems_mutex);
+
     // Create a dummy
     uint8_t system_id = 0, comp_id = 0;
     make_system_with_component(system_id, comp_id);
@@ -278,7 +832,7 @@ System &DroneCoreImpl::get_system(const uint64_t uuid)
 
 bool DroneCoreImpl::is_connected() const
 {
-    std::lock_guard<std::recursive_mutex> lock(_systems_mutex);
+    std::lock_guard<instrumented_recursive_mutex_t> lock(_systems_mutex);
 
     if (_systems.size() == 1) {
         return _systems.begin()->second->is_connected();
@@ -288,19 +842,31 @@ bool DroneCoreImpl::is_connected() const
 
 bool DroneCoreImpl::is_connected(const uint64_t uuid) const
 {
-    std::lock_guard<std::recursive_mutex> lock(_systems_mutex);
+    const System *system = find_system(uuid);
+    return system != nullptr && system->is_connected();
+}
 
-    for (auto it = _systems.begin(); it != _systems.end(); ++it) {
-        if (it->second->get_uuid() == uuid) {
-            return it->second->is_connected();
-        }
+System *DroneCoreImpl::find_system(uint64_t uuid) const
+{
+    std::lock_guard<instrumented_mutex_t> lock(_systems_by_uuid_mutex);
+    auto it = _systems_by_uuid.find(uuid);
+    return (it != _systems_by_uuid.end()) ? it->second : nullptr;
+}
+
+void DroneCoreImpl::index_system_uuid(uint8_t system_id, uint64_t uuid)
+{
+    // Set before the first message of the system is dispatched to it.
+    System *system = _system_lookup[system_id].system;
+    if (system == nullptr || uuid == 0) {
+        return;
     }
-    return false;
+    std::lock_guard<instrumented_mutex_t> lock(_systems_by_uuid_mutex);
+    _systems_by_uuid[uuid] = system;
 }
 
 void DroneCoreImpl::make_system_with_component(uint8_t system_id, uint8_t comp_id)
 {
-    std::lock_guard<std::recursive_mutex> lock(_systems_mutex);
+    std::lock_guard<instrumented_recursive_mutex_t> lock(_systems_mutex);
 
     if (_should_exit) {
         // When the system got destroyed in the destructor, we have to give up.
@@ -313,11 +879,29 @@ void DroneCoreImpl::make_system_with_component(uint8_t system_id, uint8_t comp_i
     auto new_system = std::make_shared<System>(*this, system_id, comp_id);
 
     _systems.insert(system_entry_t(system_id, new_system));
+
+    if (system_id == 0) {
+        _null_system_exists = true;
+    }
+}
+
+void DroneCoreImpl::update_system_lookup(uint8_t system_id, uint8_t component_id)
+{
+    // We assume that we already acquired _systems_mutex in this function.
+
+    auto it = _systems.find(system_id);
+    if (it == _systems.end()) {
+        return;
+    }
+
+    SystemLookupEntry &entry = _system_lookup[system_id];
+    entry.system = it->second.get();
+    entry.component_bits[component_id / 64] |= (uint64_t(1) << (component_id % 64));
 }
 
 bool DroneCoreImpl::does_system_exist(uint8_t system_id)
 {
-    std::lock_guard<std::recursive_mutex> lock(_systems_mutex);
+    std::lock_guard<instrumented_recursive_mutex_t> lock(_systems_mutex);
 
     if (!_should_exit) {
         return (_systems.find(system_id) != _systems.end());
@@ -341,9 +925,56 @@ void DroneCoreImpl::notify_on_timeout(const uint64_t uuid)
     }
 }
 
+void DroneCoreImpl::notify_on_link_state(uint64_t uuid, LinkWatchdog::State state)
+{
+    if (_on_link_state_callback == nullptr) {
+        return;
+    }
+
+    switch (state) {
+        case LinkWatchdog::State::OK:
+            _on_link_state_callback(uuid, DroneCore::LinkState::OK);
+            break;
+        case LinkWatchdog::State::DEGRADED:
+            _on_link_state_callback(uuid, DroneCore::LinkState::DEGRADED);
+            break;
+        case LinkWatchdog::State::LOST:
+            _on_link_state_callback(uuid, DroneCore::LinkState::LOST);
+            break;
+    }
+}
+
+void DroneCoreImpl::register_on_link_state(DroneCore::link_state_callback_t callback)
+{
+    _on_link_state_callback = callback;
+}
+
+void DroneCoreImpl::set_link_loss_timeouts(double degraded_timeout_s, double lost_timeout_s)
+{
+    {
+        std::lock_guard<std::mutex> lock(_link_loss_timeouts_mutex);
+        _degraded_timeout_s = degraded_timeout_s;
+        _lost_timeout_s = lost_timeout_s;
+    }
+
+    std::lock_guard<instrumented_recursive_mutex_t> lock(_systems_mutex);
+    for (auto &id_and_system : _systems) {
+        id_and_system.second->_mavlink_system->set_link_loss_timeouts(degraded_timeout_s,
+                                                                      lost_timeout_s);
+    }
+}
+
+void DroneCoreImpl::get_link_loss_timeouts(double &degraded_timeout_s,
+                                           double &lost_timeout_s) const
+{
+    std::lock_guard<std::mutex> lock(_link_loss_timeouts_mutex);
+    degraded_timeout_s = _degraded_timeout_s;
+    lost_timeout_s = _lost_timeout_s;
+}
+
 void DroneCoreImpl::register_on_discover(const DroneCore::event_callback_t callback)
 {
-    std::lock_guard<std::recursive_mutex> lock(_systems_mutex);
+    std::lock_guard<instrumented_recursive_mutex_t> lock(_systems_mutex);
 
     for (auto const &connected_system : _systems) {
         callback(connected_system.second->get_uuid());
@@ -357,4 +988,362 @@ void DroneCoreImpl::register_on_timeout(const DroneCore::event_callback_t callba
     _on_timeout_callback = callback;
 }
 
+void DroneCoreImpl::set_callback_executor(DroneCore::callback_executor_t executor)
+{
+    _callback_executor.set_executor(executor);
+}
+
+void DroneCoreImpl::set_executor(std::shared_ptr<Executor> executor)
+{
+    if (executor == nullptr) {
+        _callback_executor.set_executor(nullptr);
+        return;
+    }
+    _callback_executor.set_executor([executor](CallbackExecutor::work_t work) {
+        executor->post(std::move(work));
+    });
+}
+
+void DroneCoreImpl::set_callback_thread_count(unsigned num_threads)
+{
+    _callback_executor.set_num_threads(num_threads);
+}
+
+bool DroneCoreImpl::set_receive_shard_count(unsigned num_shards)
+{
+    std::lock_guard<instrumented_mutex_t> lock(_connections_mutex);
+    // Receive threads read it without a lock, so it can't change under them.
+    if (!connections()->empty()) {
+        return false;
+    }
+
+    if (num_shards == 0) {
+        _receive_shards.reset();
+    } else {
+        _receive_shards.reset(new ReceiveShards(num_shards,
+        [this](const MAVLinkMessageView & message, Connection * connection) {
+            dispatch_message(message, connection);
+        }));
+    }
+    return true;
+}
+
+DroneCore::DispatchStats
+DroneCoreImpl::dispatch_stats(DroneCore::DispatchClass dispatch_class) const
+{
+    std::lock_guard<instrumented_mutex_t> lock(_connections_mutex);
+    if (!_receive_shards) {
+        return DroneCore::DispatchStats {0, 0, 0};
+    }
+    return _receive_shards->stats(dispatch_class);
+}
+
+bool DroneCoreImpl::set_link_budget(unsigned link_index, double bytes_per_s)
+{
+    const std::shared_ptr<const connections_t> connections = this->connections();
+
+    if (link_index >= connections->size()) {
+        LogErr() << "No connection " << link_index << " to set a budget for";
+        return false;
+    }
+    (*connections)[link_index]->set_budget(bytes_per_s);
+    return true;
+}
+
+bool DroneCoreImpl::set_link_send_queue(unsigned link_index, size_t max_queued,
+                                        DroneCore::SendOverflow overflow)
+{
+    const std::shared_ptr<const connections_t> connections = this->connections();
+
+    if (link_index >= connections->size()) {
+        LogErr() << "No connection " << link_index << " to set a send queue for";
+        return false;
+    }
+    (*connections)[link_index]->set_send_queue(max_queued, overflow);
+    return true;
+}
+
+bool DroneCoreImpl::set_link_framing(unsigned link_index, DroneCore::MavlinkFraming framing)
+{
+    const std::shared_ptr<const connections_t> connections = this->connections();
+
+    if (link_index >= connections->size()) {
+        LogErr() << "No connection " << link_index << " to set the framing for";
+        return false;
+    }
+    (*connections)[link_index]->set_framing(framing);
+    return true;
+}
+
+bool DroneCoreImpl::set_link_capture(unsigned link_index, const std::string &path)
+{
+    const std::shared_ptr<const connections_t> connections = this->connections();
+
+    if (link_index >= connections->size()) {
+        LogErr() << "No connection " << link_index << " to capture";
+        return false;
+    }
+    return (*connections)[link_index]->set_capture(path);
+}
+
+void DroneCoreImpl::set_mavlink_version(uint8_t system_id, unsigned version)
+{
+    _mavlink_versions[system_id].store(version, std::memory_order_relaxed);
+    if (version != 1) {
+        return;
+    }
+
+    // Broadcasts on its connection need to be understood by it.
+    const std::shared_ptr<const connections_t> connections = this->connections();
+    Connection *connection = find_route(*connections, system_id);
+    if (connection != nullptr) {
+        connection->set_has_mavlink1_peer();
+    }
+}
+
+std::vector<DroneCore::LinkStats> DroneCoreImpl::link_stats() const
+{
+    const std::shared_ptr<const connections_t> connections = this->connections();
+
+    std::vector<DroneCore::LinkStats> stats;
+    for (auto it = connections->begin(); it != connections->end(); ++it) {
+        stats.push_back((**it).link_stats());
+    }
+    return stats;
+}
+
+std::vector<DroneCore::MessageLatencies> DroneCoreImpl::message_latencies() const
+{
+    std::vector<DroneCore::MessageLatencies> result;
+    for (const auto &latencies : _message_tracer.latencies()) {
+        DroneCore::MessageLatencies entry;
+        entry.message_id = latencies.msgid;
+        const char *name = MAVLinkMessageTable::name(latencies.msgid);
+        entry.message_name = (name != nullptr) ? name : "";
+        DroneCore::LatencyHistogram *histograms[MessageTracer::NUM_STAGES] = {
+            &entry.parse, &entry.lookup, &entry.dispatch, &entry.callback, &entry.total
+        };
+        for (unsigned i = 0; i < MessageTracer::NUM_STAGES; ++i) {
+            const MessageTracer::Histogram &histogram = latencies.stages[i];
+            histograms[i]->num_samples = histogram.count;
+            histograms[i]->mean_us = (histogram.count > 0) ?
+                                     double(histogram.sum_us) / double(histogram.count) : 0.0;
+            histograms[i]->max_us = histogram.max_us;
+            histograms[i]->buckets.assign(histogram.buckets.begin(), histogram.buckets.end());
+        }
+        result.push_back(entry);
+    }
+    return result;
+}
+
+DroneCore::CallbackUsage DroneCoreImpl::callback_usage(uint64_t uuid) const
+{
+    DroneCore::CallbackUsage result;
+
+    System *system = find_system(uuid);
+    if (system == nullptr) {
+        return result;
+    }
+    std::shared_ptr<MAVLinkSystem> mavlink_system = system->_mavlink_system;
+
+    for (const auto &usage : mavlink_system->get_handler_usages()) {
+        result.handlers.push_back(DroneCore::HandlerUsage {
+            mavlink_system->owner_name_of(usage.cookie), usage.msg_id, usage.num_calls,
+            double(usage.total_ns) * 1e-9, double(usage.max_ns) * 1e-9
+        });
+    }
+    for (const auto &usage : mavlink_system->get_call_every_usages()) {
+        result.periodic.push_back(DroneCore::PeriodicUsage {
+            double(usage.interval_s), usage.num_calls, usage.total_s, usage.max_s
+        });
+    }
+    return result;
+}
+
+DroneCore::ResourceUsage DroneCoreImpl::resource_usage(uint64_t uuid) const
+{
+    DroneCore::ResourceUsage usage {};
+
+    System *system = find_system(uuid);
+    if (system != nullptr) {
+        system->_mavlink_system->add_resource_usage(usage);
+    }
+    return usage;
+}
+
+DroneCore::ResourceUsage DroneCoreImpl::total_resource_usage() const
+{
+    DroneCore::ResourceUsage usage {};
+    {
+        std::lock_guard<instrumented_recursive_mutex_t> lock(_systems_mutex);
+        for (auto &id_and_system : _systems) {
+            id_and_system.second->_mavlink_system->add_resource_usage(usage);
+        }
+    }
+    // Those of the systems are among them.
+    usage.num_threads = ThreadRoles::num_running();
+    return usage;
+}
+
+std::vector<DroneCore::FleetCommandReport>
+DroneCoreImpl::send_fleet_command(DroneCore::FleetCommand command,
+                                  const std::vector<uint64_t> &uuids)
+{
+    Completion<std::vector<DroneCore::FleetCommandReport>> completion;
+
+    // Every system answers or times out on its own, so this does not need a
+    // timeout of its own.
+    send_fleet_command_async(command, uuids,
+    [&completion](const std::vector<DroneCore::FleetCommandReport> &reports) {
+        completion.complete(reports);
+    });
+
+    return completion.wait();
+}
+
+void DroneCoreImpl::send_fleet_command_async(DroneCore::FleetCommand command,
+                                             const std::vector<uint64_t> &uuids,
+                                             DroneCore::fleet_command_callback_t callback)
+{
+    struct State {
+        std::mutex mutex {};
+        std::vector<DroneCore::FleetCommandReport> reports {};
+        // One more than there are systems, until all commands are queued,
+        // because some answers come before that.
+        size_t num_pending = 0;
+        DroneCore::fleet_command_callback_t callback {};
+        Time time {};
+        dl_time_t start_time {};
+    };
+    auto state = std::make_shared<State>();
+    state->reports.resize(uuids.size());
+    state->num_pending = uuids.size() + 1;
+    state->callback = callback;
+    state->start_time = state->time.steady_time();
+
+    auto finish_one = [state]() {
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (--state->num_pending != 0) {
+                return;
+            }
+        }
+        if (state->callback) {
+            state->callback(state->reports);
+        }
+    };
+
+    for (size_t i = 0; i < uuids.size(); ++i) {
+        state->reports[i] = DroneCore::FleetCommandReport {
+            uuids[i], DroneCore::FleetCommandResult::NO_SYSTEM, 0.0
+        };
+
+        auto mavlink_system = find_connected_mavlink_system(uuids[i]);
+        if (!mavlink_system) {
+            finish_one();
+            continue;
+        }
+
+        send_fleet_command_to(*mavlink_system, command,
+        [state, finish_one, i](MAVLinkCommands::Result result, float) {
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->reports[i].result = fleet_command_result_from_command_result(result);
+                state->reports[i].latency_s = state->time.elapsed_since_s(state->start_time);
+            }
+            finish_one();
+        });
+    }
+
+    finish_one();
+}
+
+void DroneCoreImpl::get_fleet_telemetry(DroneCore::FleetTelemetry &fleet_telemetry) const
+{
+    _fleet_telemetry_store.get(fleet_telemetry);
+}
+
+std::vector<uint64_t> DroneCoreImpl::get_fleet_within_radius(uint64_t uuid,
+                                                             double radius_m) const
+{
+    return _fleet_telemetry_store.get_within_radius(uuid, radius_m);
+}
+
+std::vector<uint64_t> DroneCoreImpl::get_fleet_nearest(uint64_t uuid, unsigned k) const
+{
+    return _fleet_telemetry_store.get_nearest(uuid, k);
+}
+
+std::vector<uint64_t>
+DroneCoreImpl::get_fleet_inside_polygon(const std::vector<DroneCore::FleetVertex> &polygon) const
+{
+    return _fleet_telemetry_store.get_inside_polygon(polygon);
+}
+
+std::shared_ptr<MAVLinkSystem> DroneCoreImpl::find_connected_mavlink_system(uint64_t uuid) const
+{
+    System *system = find_system(uuid);
+    if (system == nullptr || !system->is_connected()) {
+        return nullptr;
+    }
+    return system->_mavlink_system;
+}
+
+void DroneCoreImpl::send_fleet_command_to(MAVLinkSystem &mavlink_system,
+                                          DroneCore::FleetCommand command,
+                                          MAVLinkSystem::command_result_callback_t callback)
+{
+    MAVLinkCommands::CommandLong command_long {};
+    command_long.target_component_id = mavlink_system.get_autopilot_id();
+
+    switch (command) {
+        case DroneCore::FleetCommand::ARM:
+            command_long.command = MAV_CMD_COMPONENT_ARM_DISARM;
+            command_long.params.param1 = 1.0f; // arm
+            break;
+        case DroneCore::FleetCommand::DISARM:
+            command_long.command = MAV_CMD_COMPONENT_ARM_DISARM;
+            command_long.params.param1 = 0.0f; // disarm
+            break;
+        case DroneCore::FleetCommand::KILL:
+            command_long.command = MAV_CMD_COMPONENT_ARM_DISARM;
+            command_long.params.param1 = 0.0f; // disarm
+            command_long.params.param2 = 21196.0f; // even in flight
+            break;
+        case DroneCore::FleetCommand::LAND:
+            command_long.command = MAV_CMD_NAV_LAND;
+            break;
+        case DroneCore::FleetCommand::HOLD:
+            mavlink_system.set_flight_mode_async(MAVLinkSystem::FlightMode::HOLD, callback);
+            return;
+        case DroneCore::FleetCommand::RETURN_TO_LAUNCH:
+            mavlink_system.set_flight_mode_async(MAVLinkSystem::FlightMode::RETURN_TO_LAUNCH,
+                                                 callback);
+            return;
+    }
+
+    mavlink_system.send_command_async(command_long, callback);
+}
+
+DroneCore::FleetCommandResult
+DroneCoreImpl::fleet_command_result_from_command_result(MAVLinkCommands::Result result)
+{
+    switch (result) {
+        case MAVLinkCommands::Result::SUCCESS:
+            return DroneCore::FleetCommandResult::SUCCESS;
+        case MAVLinkCommands::Result::NO_SYSTEM:
+            return DroneCore::FleetCommandResult::NO_SYSTEM;
+        case MAVLinkCommands::Result::CONNECTION_ERROR:
+            return DroneCore::FleetCommandResult::CONNECTION_ERROR;
+        case MAVLinkCommands::Result::BUSY:
+            return DroneCore::FleetCommandResult::BUSY;
+        case MAVLinkCommands::Result::COMMAND_DENIED:
+            return DroneCore::FleetCommandResult::COMMAND_DENIED;
+        case MAVLinkCommands::Result::TIMEOUT:
+            return DroneCore::FleetCommandResult::TIMEOUT;
+        default:
+            return DroneCore::FleetCommandResult::UNKNOWN;
+    }
+}
+
 } // namespace dronecore
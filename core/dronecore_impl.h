@@ -1,14 +1,32 @@
 #pragma once
 
+#include <array>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <unordered_map>
 #include <vector>
 #include <atomic>
 
+#include "callback_executor.h"
 #include "connection.h"
+#include "duplicate_filter.h"
+#include "executor.h"
+#include "fleet_telemetry_store.h"
+#include "global_include.h"
 #include "dronecore.h"
+#include "io_reactor.h"
+#include "link_watchdog.h"
+#include "lock_stats.h"
+#include "receive_shards.h"
+#include "system_state_store.h"
 #include "system.h"
+#include "mavlink_system.h"
 #include "mavlink_include.h"
+#include "mavlink_message_view.h"
+#include "message_tracer.h"
+#include "timer_scheduler.h"
+#include "topology.h"
 
 namespace dronecore {
 
@@ -18,19 +36,52 @@ public:
     DroneCoreImpl();
     ~DroneCoreImpl();
 
-    void receive_message(const mavlink_message_t &message);
+    // The connection is learnt as the route to the system which sent it.
+    void receive_message(const mavlink_message_t &message, Connection *connection = nullptr);
+    void receive_message(const MAVLinkMessageView &message, Connection *connection = nullptr);
+    // Only to where the target system was heard from last, messages for all
+    // systems or for one not heard from yet go out on every connection.
     bool send_message(const mavlink_message_t &message);
+    // Sends a burst in one go where possible.
+    bool send_messages(const mavlink_message_t *messages, size_t num_messages);
+    // Ours, as GCS, which is the same for all systems on the connection.
+    void send_heartbeat(Connection &connection);
 
-    ConnectionResult add_any_connection(const std::string &connection_url);
+    ConnectionResult add_any_connection(const std::string &connection_url,
+                                        const DroneCore::ForwardingConfig &forwarding =
+                                            DroneCore::ForwardingConfig());
     ConnectionResult add_link_connection(const std::string &protocol,
                                          const std::string &ip,
-                                         int port);
-    ConnectionResult add_udp_connection(int local_port_number);
+                                         int port,
+                                         const DroneCore::ForwardingConfig &forwarding =
+                                             DroneCore::ForwardingConfig());
+    ConnectionResult add_udp_connection(int local_port_number,
+                                        const DroneCore::ForwardingConfig &forwarding =
+                                            DroneCore::ForwardingConfig(),
+                                        const DroneCore::UdpConfig &udp_config =
+                                            DroneCore::UdpConfig());
     void add_connection(std::shared_ptr<Connection>);
     ConnectionResult add_tcp_connection(const std::string &remote_ip,
-                                        int remote_port);
+                                        int remote_port,
+                                        const DroneCore::ForwardingConfig &forwarding =
+                                            DroneCore::ForwardingConfig(),
+                                        const DroneCore::TcpConfig &tcp_config =
+                                            DroneCore::TcpConfig());
     ConnectionResult add_serial_connection(const std::string &dev_path,
-                                           int baudrate);
+                                           int baudrate,
+                                           const DroneCore::ForwardingConfig &forwarding =
+                                               DroneCore::ForwardingConfig(),
+                                           const DroneCore::SerialConfig &serial_config =
+                                               DroneCore::SerialConfig());
+    ConnectionResult add_shm_connection(const std::string &name,
+                                        const DroneCore::ForwardingConfig &forwarding =
+                                            DroneCore::ForwardingConfig());
+    ConnectionResult add_replay_connection(const std::string &path, double speed,
+                                           const DroneCore::ForwardingConfig &forwarding =
+                                               DroneCore::ForwardingConfig());
+    ConnectionResult add_simulated_connection(unsigned num_vehicles,
+                                              const DroneCore::ForwardingConfig &forwarding =
+                                                  DroneCore::ForwardingConfig());
 
     std::vector<uint64_t> get_system_uuids() const;
     System &get_system();
@@ -42,23 +93,196 @@ public:
     void register_on_discover(DroneCore::event_callback_t callback);
     void register_on_timeout(DroneCore::event_callback_t callback);
 
+    // Called by a system once its UUID is known, before it is announced.
+    void index_system_uuid(uint8_t system_id, uint64_t uuid);
     void notify_on_discover(uint64_t uuid);
     void notify_on_timeout(uint64_t uuid);
+    void register_on_link_state(DroneCore::link_state_callback_t callback);
+    void notify_on_link_state(uint64_t uuid, LinkWatchdog::State state);
+    void set_link_loss_timeouts(double degraded_timeout_s, double lost_timeout_s);
+    // For systems made later.
+    void get_link_loss_timeouts(double &degraded_timeout_s, double &lost_timeout_s) const;
+
+    void set_callback_executor(DroneCore::callback_executor_t executor);
+    void set_executor(std::shared_ptr<Executor> executor);
+    void set_callback_thread_count(unsigned num_threads);
+    bool set_receive_shard_count(unsigned num_shards);
+    DroneCore::DispatchStats dispatch_stats(DroneCore::DispatchClass dispatch_class) const;
+    void enable_plugins_on_first_use(bool enable) { _plugins_on_first_use = enable; }
+    bool plugins_on_first_use() const { return _plugins_on_first_use; }
+    CallbackExecutor &callback_executor() { return _callback_executor; }
+    MessageTracer &message_tracer() { return _message_tracer; }
+
+    void set_idle_timeout(double timeout_s);
+    bool set_state_dir(const std::string &dir) { return _system_state_store.open(dir); }
+
+    bool set_link_budget(unsigned link_index, double bytes_per_s);
+    bool set_link_send_queue(unsigned link_index, size_t max_queued,
+                             DroneCore::SendOverflow overflow);
+    bool set_link_framing(unsigned link_index, DroneCore::MavlinkFraming framing);
+    bool set_link_capture(unsigned link_index, const std::string &path);
+    bool remove_connection(unsigned link_index);
+
+    // As found out by the system, 0 if unknown.
+    void set_mavlink_version(uint8_t system_id, unsigned version);
+    unsigned mavlink_version_of(uint8_t system_id) const
+    {
+        return _mavlink_versions[system_id].load(std::memory_order_relaxed);
+    }
+    std::vector<DroneCore::LinkStats> link_stats() const;
+
+    void enable_message_tracing(bool enable) { _message_tracer.set_enabled(enable); }
+    std::vector<DroneCore::MessageLatencies> message_latencies() const;
+    DroneCore::CallbackUsage callback_usage(uint64_t uuid) const;
+    DroneCore::ResourceUsage resource_usage(uint64_t uuid) const;
+    DroneCore::ResourceUsage total_resource_usage() const;
+
+    std::vector<DroneCore::FleetCommandReport>
+    send_fleet_command(DroneCore::FleetCommand command, const std::vector<uint64_t> &uuids);
+    void send_fleet_command_async(DroneCore::FleetCommand command,
+                                  const std::vector<uint64_t> &uuids,
+                                  DroneCore::fleet_command_callback_t callback);
+
+    void get_fleet_telemetry(DroneCore::FleetTelemetry &fleet_telemetry) const;
+    std::vector<uint64_t> get_fleet_within_radius(uint64_t uuid, double radius_m) const;
+    std::vector<uint64_t> get_fleet_nearest(uint64_t uuid, unsigned k) const;
+    std::vector<uint64_t>
+    get_fleet_inside_polygon(const std::vector<DroneCore::FleetVertex> &polygon) const;
+    FleetTelemetryStore &fleet_telemetry_store() { return _fleet_telemetry_store; }
+    SystemStateStore &system_state_store() { return _system_state_store; }
 
 private:
     void make_system_with_component(uint8_t system_id, uint8_t component_id);
     bool does_system_exist(uint8_t system_id);
+    void update_system_lookup(uint8_t system_id, uint8_t component_id);
+    // nullptr if there is no system with this UUID (yet).
+    System *find_system(uint64_t uuid) const;
+    void forward_message(const MAVLinkMessageView &message, Connection *source);
+    // Everything after the checks done on the receive thread, possibly on a shard.
+    void dispatch_message(const MAVLinkMessageView &message, Connection *connection);
+    // receive_message() of single system builds. Returns false if the message
+    // is for a system or component not known yet, which dispatch_message() adds.
+    bool receive_known_message(const MAVLinkMessageView &message, Connection *connection);
+    // False, and logged, if the build doesn't take another connection.
+    bool may_add_connection() const;
+    // Called by the timer, on every connection with a peer.
+    void send_heartbeats();
+    void schedule_heartbeats();
+    void wake_up_from_idle();
+
+    // Unlike get_system(uuid), this does not make a placeholder if there is none.
+    std::shared_ptr<MAVLinkSystem> find_connected_mavlink_system(uint64_t uuid) const;
+    static void send_fleet_command_to(MAVLinkSystem &mavlink_system,
+                                      DroneCore::FleetCommand command,
+                                      MAVLinkSystem::command_result_callback_t callback);
+    static DroneCore::FleetCommandResult
+    fleet_command_result_from_command_result(MAVLinkCommands::Result result);
 
     using system_entry_t = std::pair<uint8_t, std::shared_ptr<System>>;
 
-    std::mutex _connections_mutex;
-    std::vector<std::shared_ptr<Connection>> _connections;
+    // Shared by all connections for receiving, needs to outlive them.
+    IoReactor _io_reactor {};
+
+    // Times the callbacks too, needs to outlive the executor.
+    MessageTracer _message_tracer {};
+
+    // Runs the callbacks of all systems, needs to outlive them.
+    CallbackExecutor _callback_executor {};
+
+    // Written by the handlers of all systems, needs to outlive them.
+    FleetTelemetryStore _fleet_telemetry_store {};
 
-    mutable std::recursive_mutex _systems_mutex;
+    // Read and written by all systems, needs to outlive them.
+    SystemStateStore _system_state_store {};
+
+    // Only taken to change the connections, and by set_receive_shard_count().
+    mutable instrumented_mutex_t _connections_mutex;
+    typedef std::vector<std::shared_ptr<Connection>> connections_t;
+    // Replaced as a whole when a connection is added or removed, so that
+    // senders take it using atomic_load without locking, and an unplugged
+    // radio stalls nothing. Whoever still holds the old one keeps its
+    // connections alive.
+    std::shared_ptr<const connections_t> _connections;
+    std::shared_ptr<const connections_t> connections() const
+    {
+        return std::atomic_load(&_connections);
+    }
+    // The connection each system id is reached on, written by the receive
+    // side without a lock. It might have been removed meanwhile, so it is
+    // only used through find_route().
+    std::array<std::atomic<Connection *>, 256> _routes;
+    // nullptr if the route is not one of the connections (any longer).
+    Connection *find_route(const connections_t &connections, uint8_t system_id) const;
+    // Health score of each route, 0 if the system has not been heard on it
+    // within the last heartbeat interval. Another connection the system is
+    // heard on takes over only once it scores ROUTE_HYSTERESIS more, so that
+    // two similar links don't take turns.
+    std::array<std::atomic<float>, 256> _route_scores;
+    static constexpr float ROUTE_HYSTERESIS = 0.2f;
+    void update_route_scores(const connections_t &connections);
+    void reroute(uint8_t system_id, Connection *connection);
+    struct RouteCheck {
+        Connection *connection;
+        uint64_t num_received;
+    };
+    // Only used by update_route_scores().
+    std::array<RouteCheck, 256> _route_checks {};
+    std::array<std::atomic<unsigned>, 256> _mavlink_versions;
+    // Set once a connection with forwarding is added.
+    std::atomic<bool> _has_forwarding {false};
+    std::atomic<bool> _plugins_on_first_use {false};
+
+    // Copies of a message from a second link are only dropped, there is no
+    // need to check with a single connection.
+    std::atomic<unsigned> _num_connections {0};
+    DuplicateFilter _duplicate_filter {};
+    Time _time {};
+
+    // Only set while there are no connections, nullptr to dispatch on the
+    // receive threads.
+    std::unique_ptr<ReceiveShards> _receive_shards {};
+
+    mutable instrumented_recursive_mutex_t _systems_mutex;
     std::map<uint8_t, std::shared_ptr<System>> _systems;
 
+    // Lets receive_message() find known systems without taking _systems_mutex.
+    // Entries are only written with _systems_mutex held, once a system or one of
+    // its components is discovered, and are valid as long as _systems is.
+    struct SystemLookupEntry {
+        std::atomic<System *> system;
+        // One bit for each component id that the system already knows about.
+        std::atomic<uint64_t> component_bits[4];
+    };
+    std::array<SystemLookupEntry, 256> _system_lookup;
+
+    // Finds systems by UUID without going through all of them. Systems are
+    // never removed, so the pointers stay valid as long as _systems is.
+    mutable instrumented_mutex_t _systems_by_uuid_mutex {"systems_by_uuid"};
+    std::unordered_map<uint64_t, System *> _systems_by_uuid {};
+
+    // While there is a placeholder system with sysid 0, it needs to be renamed
+    // by the next message, so the fast path can't be used.
+    std::atomic<bool> _null_system_exists {false};
+
+    static constexpr double HEARTBEAT_INTERVAL_S = 1.0;
+    std::mutex _heartbeat_mutex {};
+    // The last one scheduled, which might have fired already.
+    TimerScheduler::timer_id_t _heartbeat_timer_id = 0;
+
+    // Without anything received for the idle timeout, heartbeats stop until the
+    // next message comes in, see DroneCore::set_idle_timeout().
+    double _idle_timeout_s = 0.0;
+    dl_time_t _last_activity_time {};
+    std::atomic<bool> _received_since_heartbeat {false};
+    std::atomic<bool> _is_idle {false};
+
     DroneCore::event_callback_t _on_discover_callback;
     DroneCore::event_callback_t _on_timeout_callback;
+    DroneCore::link_state_callback_t _on_link_state_callback;
+
+    mutable std::mutex _link_loss_timeouts_mutex {};
+    double _degraded_timeout_s = LinkWatchdog::DEFAULT_DEGRADED_TIMEOUT_S;
+    double _lost_timeout_s = LinkWatchdog::DEFAULT_LOST_TIMEOUT_S;
 
     std::atomic<bool> _should_exit = {false};
 };
@@ -0,0 +1,60 @@
+#include "duplicate_filter.h"
+
+namespace dronecore {
+
+constexpr double DuplicateFilter::WINDOW_S;
+constexpr unsigned DuplicateFilter::MAX_COPIES;
+
+DuplicateFilter::DuplicateFilter() {}
+
+DuplicateFilter::~DuplicateFilter() {}
+
+DuplicateFilter::Result DuplicateFilter::check(uint8_t sysid, uint8_t compid, uint8_t seq,
+                                               uint32_t msgid, const void *link, double time_s)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const uint16_t key = uint16_t((uint16_t(sysid) << 8) | compid);
+    auto it = _windows.find(key);
+    if (it == _windows.end()) {
+        std::unique_ptr<window_t> window(new window_t());
+        for (auto &entry : *window) {
+            entry = Entry {nullptr, 0, 0.0, {}};
+        }
+        it = _windows.insert(std::make_pair(key, std::move(window))).first;
+    }
+
+    Entry &entry = (*it->second)[seq];
+    if (entry.link != nullptr && entry.link != link && entry.msgid == msgid &&
+        time_s - entry.time_s < WINDOW_S) {
+        // The entry stays, so that every further copy is dropped as well.
+        const void **free_slot = nullptr;
+        bool is_new_message = false;
+        for (auto &copy_link : entry.copy_links) {
+            if (copy_link == link) {
+                is_new_message = true;
+                break;
+            }
+            if (copy_link == nullptr && free_slot == nullptr) {
+                free_slot = &copy_link;
+            }
+        }
+        if (!is_new_message) {
+            if (free_slot != nullptr) {
+                *free_slot = link;
+            }
+            return Result {true, entry.link, time_s - entry.time_s};
+        }
+    }
+
+    entry = Entry {link, msgid, time_s, {}};
+    return Result {false, link, 0.0};
+}
+
+void DuplicateFilter::reset()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _windows.clear();
+}
+
+} // namespace dronecore
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace dronecore {
+
+// Recognises messages which arrive a second time on another link, e.g. when
+// a vehicle is connected over a radio and LTE at once. A message is taken as
+// the same if its sender, sequence number and message id match one which
+// came on another link less than WINDOW_S ago. A link on its own never has
+// anything dropped, however quickly its sequence numbers wrap around.
+class DuplicateFilter
+{
+public:
+    DuplicateFilter();
+    ~DuplicateFilter();
+
+    struct Result {
+        bool is_duplicate;
+        // For a duplicate, the link it came on first and how much later it
+        // came on this one.
+        const void *first_link;
+        double delay_s;
+    };
+
+    Result check(uint8_t sysid, uint8_t compid, uint8_t seq, uint32_t msgid,
+                 const void *link, double time_s);
+
+    void reset();
+
+    static constexpr double WINDOW_S = 0.5;
+
+    // Non-copyable
+    DuplicateFilter(const DuplicateFilter &) = delete;
+    const DuplicateFilter &operator=(const DuplicateFilter &) = delete;
+
+private:
+    // Links with a copy of a message recorded, besides the first one.
+    static constexpr unsigned MAX_COPIES = 3;
+
+    struct Entry {
+        const void *link;
+        uint32_t msgid;
+        double time_s;
+        // A link which comes up again has a new message of its own.
+        std::array<const void *, MAX_COPIES> copy_links;
+    };
+    // The last message with each sequence number.
+    typedef std::array<Entry, 256> window_t;
+
+    std::mutex _mutex {};
+    // By sysid and compid, made when a component is first heard from.
+    std::unordered_map<uint16_t, std::unique_ptr<window_t>> _windows {};
+};
+
+} // namespace dronecore
@@ -0,0 +1,72 @@
+#include "duplicate_filter.h"
+#include <gtest/gtest.h>
+
+using namespace dronecore;
+
+static const int radio = 0;
+static const int lte = 1;
+static const int satellite = 2;
+
+TEST(DuplicateFilter, DropsCopyFromOtherLink)
+{
+    DuplicateFilter filter;
+
+    auto result = filter.check(1, 1, 10, 0, &radio, 1.0);
+    EXPECT_FALSE(result.is_duplicate);
+
+    result = filter.check(1, 1, 10, 0, &lte, 1.2);
+    EXPECT_TRUE(result.is_duplicate);
+    EXPECT_EQ(result.first_link, &radio);
+    EXPECT_DOUBLE_EQ(result.delay_s, 0.2);
+
+    // The next message may well come on the other link first.
+    result = filter.check(1, 1, 11, 0, &lte, 1.3);
+    EXPECT_FALSE(result.is_duplicate);
+    result = filter.check(1, 1, 11, 0, &radio, 1.35);
+    EXPECT_TRUE(result.is_duplicate);
+    EXPECT_EQ(result.first_link, &lte);
+}
+
+TEST(DuplicateFilter, DropsCopiesFromTwoOtherLinks)
+{
+    DuplicateFilter filter;
+
+    EXPECT_FALSE(filter.check(1, 1, 10, 0, &radio, 1.0).is_duplicate);
+    EXPECT_TRUE(filter.check(1, 1, 10, 0, &lte, 1.1).is_duplicate);
+
+    auto result = filter.check(1, 1, 10, 0, &satellite, 1.3);
+    EXPECT_TRUE(result.is_duplicate);
+    EXPECT_EQ(result.first_link, &radio);
+    EXPECT_DOUBLE_EQ(result.delay_s, 0.3);
+
+    // After a quick wrap around, a link which had a copy has a new message.
+    EXPECT_FALSE(filter.check(1, 1, 10, 0, &lte, 1.4).is_duplicate);
+    EXPECT_TRUE(filter.check(1, 1, 10, 0, &radio, 1.45).is_duplicate);
+}
+
+TEST(DuplicateFilter, KeepsEverythingFromOneLink)
+{
+    DuplicateFilter filter;
+
+    // Sequence numbers wrap around quickly at high rates.
+    for (unsigned i = 0; i < 1000; ++i) {
+        auto result = filter.check(1, 1, uint8_t(i), 0, &radio, 1.0 + i * 0.001);
+        EXPECT_FALSE(result.is_duplicate);
+    }
+}
+
+TEST(DuplicateFilter, TellsMessagesApart)
+{
+    DuplicateFilter filter;
+
+    EXPECT_FALSE(filter.check(1, 1, 10, 0, &radio, 1.0).is_duplicate);
+    // Another component or another system.
+    EXPECT_FALSE(filter.check(1, 100, 10, 0, &lte, 1.0).is_duplicate);
+    EXPECT_FALSE(filter.check(2, 1, 10, 0, &lte, 1.0).is_duplicate);
+    // Another message id.
+    EXPECT_FALSE(filter.check(1, 1, 10, 30, &lte, 1.0).is_duplicate);
+
+    // Too late, it is a new message after a wrap around.
+    EXPECT_FALSE(filter.check(1, 1, 20, 0, &radio, 1.0).is_duplicate);
+    EXPECT_FALSE(filter.check(1, 1, 20, 0, &lte, 1.0 + DuplicateFilter::WINDOW_S).is_duplicate);
+}
@@ -0,0 +1,79 @@
+#include "executor.h"
+#include "dronecore.h"
+#include "thread_roles.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dronecore {
+
+void InlineExecutor::post(std::function<void()> work)
+{
+    work();
+}
+
+struct ThreadPoolExecutor::Pool {
+    std::mutex mutex {};
+    std::condition_variable cv {};
+    std::deque<std::function<void()>> work {};
+    bool should_exit = false;
+    std::vector<std::thread *> threads {};
+
+    void run()
+    {
+        ThreadRoles::apply_to_this_thread(DroneCore::ThreadRole::CALLBACK, "callbacks");
+
+        std::unique_lock<std::mutex> lock(mutex);
+        // Once stopped, what is still queued is done first.
+        while (true) {
+            cv.wait(lock, [this]() { return !work.empty() || should_exit; });
+            if (work.empty()) {
+                return;
+            }
+            std::function<void()> next = std::move(work.front());
+            work.pop_front();
+            lock.unlock();
+
+            next();
+
+            lock.lock();
+        }
+    }
+};
+
+ThreadPoolExecutor::ThreadPoolExecutor(unsigned num_threads) :
+    _pool(new Pool())
+{
+    for (unsigned i = 0; i < std::max(num_threads, 1u); ++i) {
+        _pool->threads.push_back(new std::thread(&Pool::run, _pool.get()));
+    }
+}
+
+ThreadPoolExecutor::~ThreadPoolExecutor()
+{
+    {
+        std::lock_guard<std::mutex> lock(_pool->mutex);
+        _pool->should_exit = true;
+    }
+    _pool->cv.notify_all();
+
+    for (auto thread : _pool->threads) {
+        thread->join();
+        delete thread;
+    }
+    _pool->threads.clear();
+}
+
+void ThreadPoolExecutor::post(std::function<void()> work)
+{
+    {
+        std::lock_guard<std::mutex> lock(_pool->mutex);
+        _pool->work.push_back(std::move(work));
+    }
+    _pool->cv.notify_one();
+}
+
+} // namespace dronecore
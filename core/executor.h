@@ -0,0 +1,91 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+
+namespace dronecore {
+
+/**
+ * @brief Runs the callbacks of plugins, see DroneCore::set_executor().
+ *
+ * Applications with an event loop of their own implement post() to queue the work on it,
+ * so that callbacks arrive on that loop without another hand-over.
+ */
+class Executor
+{
+public:
+    /**
+     * @brief Destructor.
+     */
+    virtual ~Executor() = default;
+
+    /**
+     * @brief Runs work, on any thread, but eventually and exactly once.
+     *
+     * This may be called from any thread, also from within work that is running.
+     *
+     * @param work Work to run.
+     */
+    virtual void post(std::function<void()> work) = 0;
+};
+
+/**
+ * @brief Runs the callbacks right away, on the DroneCore thread which has them.
+ *
+ * This saves handing them over to another thread, but the callbacks hold up receiving and
+ * must therefore be quick. They must not wait for DroneCore, e.g. with a synchronous call.
+ */
+class InlineExecutor : public Executor
+{
+public:
+    /**
+     * @brief Runs work right away.
+     *
+     * @param work Work to run.
+     */
+    void post(std::function<void()> work) override;
+};
+
+/**
+ * @brief Runs the callbacks on a fixed number of threads of its own.
+ *
+ * Callbacks of one topic of a system are still called in order and never concurrently.
+ */
+class ThreadPoolExecutor : public Executor
+{
+public:
+    /**
+     * @brief Constructor, starts the threads.
+     *
+     * @param num_threads Number of threads, at least one.
+     */
+    explicit ThreadPoolExecutor(unsigned num_threads);
+
+    /**
+     * @brief Destructor, runs the work which is left and stops the threads.
+     */
+    ~ThreadPoolExecutor();
+
+    /**
+     * @brief Queues work for one of the threads.
+     *
+     * @param work Work to run.
+     */
+    void post(std::function<void()> work) override;
+
+    // Non-copyable
+    /**
+     * @brief Copy constructor (object is not copyable).
+     */
+    ThreadPoolExecutor(const ThreadPoolExecutor &) = delete;
+    /**
+     * @brief Equality operator (object is not copyable).
+     */
+    const ThreadPoolExecutor &operator=(const ThreadPoolExecutor &) = delete;
+
+private:
+    struct Pool;
+    std::unique_ptr<Pool> _pool;
+};
+
+} // namespace dronecore
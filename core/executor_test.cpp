@@ -0,0 +1,61 @@
+#include "executor.h"
+#include "callback_executor.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+using namespace dronecore;
+
+TEST(Executor, InlineRunsRightAway)
+{
+    InlineExecutor executor;
+    bool has_run = false;
+    executor.post([&has_run]() { has_run = true; });
+    EXPECT_TRUE(has_run);
+}
+
+TEST(Executor, ThreadPoolRunsAllWorkBeforeDestruction)
+{
+    std::atomic<int> num_run {0};
+    {
+        ThreadPoolExecutor executor(3);
+        for (int i = 0; i < 100; ++i) {
+            executor.post([&num_run]() {
+                std::this_thread::yield();
+                ++num_run;
+            });
+        }
+        // Leaving the scope runs what is left.
+    }
+    EXPECT_EQ(num_run, 100);
+}
+
+TEST(Executor, ThreadPoolRunsOnOtherThread)
+{
+    std::thread::id id;
+    {
+        ThreadPoolExecutor executor(1);
+        executor.post([&id]() { id = std::this_thread::get_id(); });
+    }
+    EXPECT_NE(id, std::thread::id());
+    EXPECT_NE(id, std::this_thread::get_id());
+}
+
+TEST(Executor, RunsCallbacksInline)
+{
+    auto inline_executor = std::make_shared<InlineExecutor>();
+    CallbackExecutor executor;
+    executor.set_executor([inline_executor](CallbackExecutor::work_t work) {
+        inline_executor->post(std::move(work));
+    });
+    int owner;
+    int topic;
+
+    int num_run = 0;
+    for (int i = 0; i < 3; ++i) {
+        executor.post(&owner, &topic, [&num_run]() { ++num_run; },
+                      CallbackExecutor::Overflow::BLOCK);
+        EXPECT_EQ(num_run, i + 1);
+    }
+}
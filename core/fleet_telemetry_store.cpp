@@ -0,0 +1,218 @@
+#include "fleet_telemetry_store.h"
+#include "global_include.h"
+#include <cmath>
+#include <thread>
+
+namespace dronecore {
+
+constexpr unsigned FleetTelemetryStore::NUM_SLOTS;
+constexpr double FleetTelemetryStore::CELL_SIZE_M;
+
+FleetTelemetryStore::FleetTelemetryStore()
+{
+    // Nothing is known until it is received.
+    for (unsigned slot = 0; slot < NUM_SLOTS; ++slot) {
+        _uuid[slot].store(0, std::memory_order_relaxed);
+        _latitude_deg[slot].store(double(NAN), std::memory_order_relaxed);
+        _longitude_deg[slot].store(double(NAN), std::memory_order_relaxed);
+        _absolute_altitude_m[slot].store(NAN, std::memory_order_relaxed);
+        _relative_altitude_m[slot].store(NAN, std::memory_order_relaxed);
+        _heading_deg[slot].store(NAN, std::memory_order_relaxed);
+        _battery_voltage_v[slot].store(NAN, std::memory_order_relaxed);
+        _battery_remaining_percent[slot].store(NAN, std::memory_order_relaxed);
+    }
+}
+
+void FleetTelemetryStore::set_uuid(uint8_t system_id, uint64_t uuid)
+{
+    std::lock_guard<std::mutex> lock(_write_mutex);
+    begin_write();
+    _uuid[system_id].store(uuid, std::memory_order_relaxed);
+    end_write();
+}
+
+void FleetTelemetryStore::set_position(uint8_t system_id, double latitude_deg,
+                                       double longitude_deg, float absolute_altitude_m,
+                                       float relative_altitude_m, float heading_deg)
+{
+    std::lock_guard<std::mutex> lock(_write_mutex);
+    begin_write();
+    _latitude_deg[system_id].store(latitude_deg, std::memory_order_relaxed);
+    _longitude_deg[system_id].store(longitude_deg, std::memory_order_relaxed);
+    _absolute_altitude_m[system_id].store(absolute_altitude_m, std::memory_order_relaxed);
+    _relative_altitude_m[system_id].store(relative_altitude_m, std::memory_order_relaxed);
+    _heading_deg[system_id].store(heading_deg, std::memory_order_relaxed);
+    end_write();
+
+    if (!_has_reference) {
+        _projection = LocalProjection(latitude_deg, longitude_deg);
+        _has_reference = true;
+    }
+    _grid.set(system_id, to_local(latitude_deg, longitude_deg));
+}
+
+void FleetTelemetryStore::set_battery(uint8_t system_id, float voltage_v,
+                                      float remaining_percent)
+{
+    std::lock_guard<std::mutex> lock(_write_mutex);
+    begin_write();
+    _battery_voltage_v[system_id].store(voltage_v, std::memory_order_relaxed);
+    _battery_remaining_percent[system_id].store(remaining_percent, std::memory_order_relaxed);
+    end_write();
+}
+
+void FleetTelemetryStore::get(DroneCore::FleetTelemetry &snapshot) const
+{
+    uint32_t seq_before;
+    uint32_t seq_after;
+    do {
+        seq_before = _seq.load(std::memory_order_acquire);
+        while (seq_before & 1) {
+            // A write is going on, it only takes a few stores.
+            std::this_thread::yield();
+            seq_before = _seq.load(std::memory_order_acquire);
+        }
+
+        snapshot.uuids.clear();
+        snapshot.latitude_deg.clear();
+        snapshot.longitude_deg.clear();
+        snapshot.absolute_altitude_m.clear();
+        snapshot.relative_altitude_m.clear();
+        snapshot.heading_deg.clear();
+        snapshot.battery_voltage_v.clear();
+        snapshot.battery_remaining_percent.clear();
+
+        for (unsigned slot = 0; slot < NUM_SLOTS; ++slot) {
+            const uint64_t uuid = _uuid[slot].load(std::memory_order_relaxed);
+            if (uuid == 0) {
+                continue;
+            }
+            snapshot.uuids.push_back(uuid);
+            snapshot.latitude_deg.push_back(_latitude_deg[slot].load(std::memory_order_relaxed));
+            snapshot.longitude_deg.push_back(
+                _longitude_deg[slot].load(std::memory_order_relaxed));
+            snapshot.absolute_altitude_m.push_back(
+                _absolute_altitude_m[slot].load(std::memory_order_relaxed));
+            snapshot.relative_altitude_m.push_back(
+                _relative_altitude_m[slot].load(std::memory_order_relaxed));
+            snapshot.heading_deg.push_back(_heading_deg[slot].load(std::memory_order_relaxed));
+            snapshot.battery_voltage_v.push_back(
+                _battery_voltage_v[slot].load(std::memory_order_relaxed));
+            snapshot.battery_remaining_percent.push_back(
+                _battery_remaining_percent[slot].load(std::memory_order_relaxed));
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        seq_after = _seq.load(std::memory_order_relaxed);
+    } while (seq_before != seq_after);
+}
+
+std::vector<uint64_t> FleetTelemetryStore::get_within_radius(uint64_t uuid,
+                                                             double radius_m) const
+{
+    std::lock_guard<std::mutex> lock(_write_mutex);
+
+    unsigned system_id;
+    SpatialGrid::Point center;
+    if (!find_system_id(uuid, system_id) || !_grid.get(system_id, center)) {
+        return {};
+    }
+
+    std::vector<unsigned> system_ids;
+    _grid.get_within_radius(center, radius_m, system_ids);
+    return uuids_of(system_ids, system_id);
+}
+
+std::vector<uint64_t> FleetTelemetryStore::get_nearest(uint64_t uuid, unsigned k) const
+{
+    std::lock_guard<std::mutex> lock(_write_mutex);
+
+    unsigned system_id;
+    SpatialGrid::Point center;
+    if (!find_system_id(uuid, system_id) || !_grid.get(system_id, center)) {
+        return {};
+    }
+
+    // The closest one is always the system itself.
+    std::vector<unsigned> system_ids;
+    _grid.get_nearest(center, size_t(k) + 1, system_ids);
+    std::vector<uint64_t> uuids = uuids_of(system_ids, system_id);
+    if (uuids.size() > k) {
+        uuids.resize(k);
+    }
+    return uuids;
+}
+
+std::vector<uint64_t>
+FleetTelemetryStore::get_inside_polygon(const std::vector<DroneCore::FleetVertex> &polygon) const
+{
+    std::lock_guard<std::mutex> lock(_write_mutex);
+    if (!_has_reference) {
+        return {};
+    }
+
+    std::vector<SpatialGrid::Point> local_polygon;
+    local_polygon.reserve(polygon.size());
+    for (const auto &vertex : polygon) {
+        local_polygon.push_back(to_local(vertex.latitude_deg, vertex.longitude_deg));
+    }
+
+    std::vector<unsigned> system_ids;
+    _grid.get_inside_polygon(local_polygon, system_ids);
+    return uuids_of(system_ids, NUM_SLOTS);
+}
+
+SpatialGrid::Point FleetTelemetryStore::to_local(double latitude_deg, double longitude_deg) const
+{
+    // We assume that we already acquired _write_mutex in this function.
+    return SpatialGrid::Point {
+        _projection.north_m(latitude_deg),
+        _projection.east_m(longitude_deg)
+    };
+}
+
+std::vector<uint64_t> FleetTelemetryStore::uuids_of(const std::vector<unsigned> &system_ids,
+                                                    unsigned except_system_id) const
+{
+    // We assume that we already acquired _write_mutex in this function.
+    std::vector<uint64_t> uuids;
+    for (unsigned system_id : system_ids) {
+        const uint64_t uuid = _uuid[system_id].load(std::memory_order_relaxed);
+        if (system_id != except_system_id && uuid != 0) {
+            uuids.push_back(uuid);
+        }
+    }
+    return uuids;
+}
+
+bool FleetTelemetryStore::find_system_id(uint64_t uuid, unsigned &system_id) const
+{
+    // We assume that we already acquired _write_mutex in this function.
+    if (uuid == 0) {
+        return false;
+    }
+    for (unsigned slot = 0; slot < NUM_SLOTS; ++slot) {
+        if (_uuid[slot].load(std::memory_order_relaxed) == uuid) {
+            system_id = slot;
+            return true;
+        }
+    }
+    return false;
+}
+
+void FleetTelemetryStore::begin_write()
+{
+    // We assume that we already acquired _write_mutex in this function.
+    const uint32_t seq = _seq.load(std::memory_order_relaxed);
+    _seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void FleetTelemetryStore::end_write()
+{
+    // We assume that we already acquired _write_mutex in this function.
+    const uint32_t seq = _seq.load(std::memory_order_relaxed);
+    _seq.store(seq + 1, std::memory_order_release);
+}
+
+} // namespace dronecore
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "dronecore.h"
+#include "local_projection.h"
+#include "spatial_grid.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace dronecore {
+
+// The latest position, heading and battery of every system, kept column by
+// column so that a snapshot of the whole fleet is a few contiguous copies.
+// There is a slot for each system id.
+//
+// Like SeqLock, readers don't take a lock and retry if a write happened
+// meanwhile, writers are serialized among each other.
+//
+// Positions are also kept in a grid, so that proximity queries don't need to
+// compare all pairs. These queries are short and take the write lock.
+class FleetTelemetryStore
+{
+public:
+    static constexpr unsigned NUM_SLOTS = 256;
+
+    FleetTelemetryStore();
+    ~FleetTelemetryStore() = default;
+
+    // A slot is only part of the snapshot once the system has a UUID.
+    void set_uuid(uint8_t system_id, uint64_t uuid);
+
+    void set_position(uint8_t system_id, double latitude_deg, double longitude_deg,
+                      float absolute_altitude_m, float relative_altitude_m, float heading_deg);
+
+    void set_battery(uint8_t system_id, float voltage_v, float remaining_percent);
+
+    // Reuses the vectors of snapshot, so that it doesn't allocate once they
+    // are long enough.
+    void get(DroneCore::FleetTelemetry &snapshot) const;
+
+    // The others within radius_m of the system with uuid, closest first for
+    // the nearest ones. Only the horizontal distance counts.
+    std::vector<uint64_t> get_within_radius(uint64_t uuid, double radius_m) const;
+    std::vector<uint64_t> get_nearest(uint64_t uuid, unsigned k) const;
+
+    std::vector<uint64_t>
+    get_inside_polygon(const std::vector<DroneCore::FleetVertex> &polygon) const;
+
+    // Non-copyable
+    FleetTelemetryStore(const FleetTelemetryStore &) = delete;
+    const FleetTelemetryStore &operator=(const FleetTelemetryStore &) = delete;
+
+private:
+    // Plenty for separation distances, fine enough for the grid to stay sparse.
+    static constexpr double CELL_SIZE_M = 100.0;
+
+    void begin_write();
+    void end_write();
+
+    SpatialGrid::Point to_local(double latitude_deg, double longitude_deg) const;
+    std::vector<uint64_t> uuids_of(const std::vector<unsigned> &system_ids,
+                                   unsigned except_system_id) const;
+    bool find_system_id(uint64_t uuid, unsigned &system_id) const;
+
+    template<typename T>
+    using column_t = std::array<std::atomic<T>, NUM_SLOTS>;
+
+    // Odd while a write is going on.
+    std::atomic<uint32_t> _seq {0};
+    mutable std::mutex _write_mutex {};
+
+    // The local tangent plane of the grid is around the first position.
+    bool _has_reference = false;
+    LocalProjection _projection {};
+    SpatialGrid _grid {CELL_SIZE_M};
+
+    column_t<uint64_t> _uuid;
+    column_t<double> _latitude_deg;
+    column_t<double> _longitude_deg;
+    column_t<float> _absolute_altitude_m;
+    column_t<float> _relative_altitude_m;
+    column_t<float> _heading_deg;
+    column_t<float> _battery_voltage_v;
+    column_t<float> _battery_remaining_percent;
+};
+
+} // namespace dronecore
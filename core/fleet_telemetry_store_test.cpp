@@ -0,0 +1,97 @@
+#include "fleet_telemetry_store.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+using namespace dronecore;
+
+TEST(FleetTelemetryStore, OnlyHasSystemsWithUuid)
+{
+    FleetTelemetryStore store;
+    DroneCore::FleetTelemetry snapshot;
+
+    store.set_position(1, 47.1, 8.5, 500.0f, 10.0f, 90.0f);
+    store.get(snapshot);
+    EXPECT_TRUE(snapshot.uuids.empty());
+
+    store.set_uuid(1, 1001);
+    store.set_uuid(7, 1007);
+    store.set_battery(7, 12.1f, 0.5f);
+    store.get(snapshot);
+
+    ASSERT_EQ(snapshot.uuids.size(), 2u);
+    ASSERT_EQ(snapshot.latitude_deg.size(), 2u);
+    ASSERT_EQ(snapshot.battery_remaining_percent.size(), 2u);
+
+    EXPECT_EQ(snapshot.uuids[0], 1001u);
+    EXPECT_DOUBLE_EQ(snapshot.latitude_deg[0], 47.1);
+    EXPECT_DOUBLE_EQ(snapshot.longitude_deg[0], 8.5);
+    EXPECT_FLOAT_EQ(snapshot.heading_deg[0], 90.0f);
+    EXPECT_TRUE(std::isnan(snapshot.battery_voltage_v[0]));
+
+    EXPECT_EQ(snapshot.uuids[1], 1007u);
+    EXPECT_TRUE(std::isnan(snapshot.latitude_deg[1]));
+    EXPECT_FLOAT_EQ(snapshot.battery_voltage_v[1], 12.1f);
+    EXPECT_FLOAT_EQ(snapshot.battery_remaining_percent[1], 0.5f);
+}
+
+TEST(FleetTelemetryStore, SnapshotIsNotTorn)
+{
+    FleetTelemetryStore store;
+    for (unsigned system_id = 1; system_id <= 10; ++system_id) {
+        store.set_uuid(uint8_t(system_id), system_id);
+    }
+
+    // Every write sets all fields of all systems to the same value.
+    std::atomic<bool> should_exit {false};
+    std::thread writer([&store, &should_exit]() {
+        for (unsigned i = 0; !should_exit; ++i) {
+            for (unsigned system_id = 1; system_id <= 10; ++system_id) {
+                store.set_position(uint8_t(system_id), i, i, float(i), float(i), float(i));
+            }
+        }
+    });
+
+    DroneCore::FleetTelemetry snapshot;
+    for (unsigned i = 0; i < 1000; ++i) {
+        store.get(snapshot);
+        ASSERT_EQ(snapshot.uuids.size(), 10u);
+        for (size_t j = 0; j < snapshot.uuids.size(); ++j) {
+            if (std::isnan(snapshot.latitude_deg[j])) {
+                continue;
+            }
+            EXPECT_DOUBLE_EQ(snapshot.latitude_deg[j], snapshot.longitude_deg[j]);
+            EXPECT_FLOAT_EQ(float(snapshot.latitude_deg[j]), snapshot.heading_deg[j]);
+        }
+    }
+
+    should_exit = true;
+    writer.join();
+}
+
+TEST(FleetTelemetryStore, FindsOthersNearby)
+{
+    FleetTelemetryStore store;
+    store.set_uuid(1, 1001);
+    store.set_uuid(2, 1002);
+    store.set_uuid(3, 1003);
+
+    // About 111 m per 0.001 degrees of latitude.
+    store.set_position(1, 47.0, 8.0, 500.0f, 10.0f, 0.0f);
+    store.set_position(2, 47.001, 8.0, 500.0f, 10.0f, 0.0f);
+    store.set_position(3, 47.01, 8.0, 500.0f, 10.0f, 0.0f);
+
+    EXPECT_EQ(store.get_within_radius(1001, 200.0), (std::vector<uint64_t> {1002}));
+    EXPECT_EQ(store.get_nearest(1001, 5), (std::vector<uint64_t> {1002, 1003}));
+    EXPECT_EQ(store.get_nearest(1003, 1), (std::vector<uint64_t> {1002}));
+    EXPECT_TRUE(store.get_within_radius(1004, 200.0).empty());
+
+    const std::vector<DroneCore::FleetVertex> square {
+        {46.9995, 7.999}, {47.0015, 7.999}, {47.0015, 8.001}, {46.9995, 8.001}
+    };
+    std::vector<uint64_t> inside = store.get_inside_polygon(square);
+    std::sort(inside.begin(), inside.end());
+    EXPECT_EQ(inside, (std::vector<uint64_t> {1001, 1002}));
+}
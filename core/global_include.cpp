@@ -1,8 +1,12 @@
 #include "global_include.h"
+#include "simulated_clock.h"
 
 #include <cfloat>
 #include <cstdint>
 #include <limits>
+#if defined(LINUX)
+#include <time.h>
+#endif
 
 namespace dronecore {
 
@@ -13,6 +17,31 @@ Time::~Time() {}
 
 dl_time_t Time::steady_time()
 {
+    if (SimulatedClock::is_enabled()) {
+        return SimulatedClock::now();
+    }
+    return steady_clock::now();
+}
+
+dl_time_t Time::cached_steady_time()
+{
+    return TimeBatch::is_active() ? TimeBatch::time() : steady_time();
+}
+
+dl_time_t Time::coarse_steady_time()
+{
+    if (SimulatedClock::is_enabled()) {
+        return SimulatedClock::now();
+    }
+#if defined(LINUX)
+    // The steady clock is CLOCK_MONOTONIC, the coarse one counts from the same start.
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC_COARSE, &now) == 0) {
+        return dl_time_t(std::chrono::duration_cast<dl_time_t::duration>(
+                             std::chrono::seconds(now.tv_sec) +
+                             std::chrono::nanoseconds(now.tv_nsec)));
+    }
+#endif
     return steady_clock::now();
 }
 
@@ -74,6 +103,32 @@ void Time::sleep_for(std::chrono::nanoseconds ns)
 }
 
 
+thread_local int64_t TimeBatch::_time_ns = 0;
+
+TimeBatch::TimeBatch() :
+    _is_outermost(!is_active())
+{
+    if (_is_outermost) {
+        const dl_time_t now = SimulatedClock::is_enabled() ? SimulatedClock::now() :
+                              steady_clock::now();
+        _time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       now.time_since_epoch()).count();
+    }
+}
+
+TimeBatch::~TimeBatch()
+{
+    if (_is_outermost) {
+        _time_ns = 0;
+    }
+}
+
+dl_time_t TimeBatch::time()
+{
+    return dl_time_t(std::chrono::duration_cast<dl_time_t::duration>(
+                         std::chrono::nanoseconds(_time_ns)));
+}
+
 FakeTime::FakeTime() :
     Time()
 {
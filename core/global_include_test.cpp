@@ -53,6 +53,31 @@ TEST(GlobalInclude, ElapsedIncreasing)
     ASSERT_GT(now, before);
 }
 
+TEST(GlobalInclude, CachedTimeStaysWithinBatch)
+{
+    Time time {};
+    dl_time_t outer_time;
+    {
+        TimeBatch batch;
+        outer_time = time.cached_steady_time();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        {
+            TimeBatch nested_batch;
+            EXPECT_EQ(time.cached_steady_time(), outer_time);
+        }
+        EXPECT_EQ(time.cached_steady_time(), outer_time);
+    }
+    EXPECT_GT(time.cached_steady_time(), outer_time);
+}
+
+TEST(GlobalInclude, CoarseTimeAboutSteadyTime)
+{
+    Time time {};
+    const double difference_s =
+        std::chrono::duration<double>(Time::coarse_steady_time() - time.steady_time()).count();
+    EXPECT_LT(std::fabs(difference_s), 0.05);
+}
+
 TEST(GlobalInclude, RadDegDouble)
 {
     ASSERT_DOUBLE_EQ(0.0, to_rad_from_deg(0.0));
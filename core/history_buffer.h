@@ -0,0 +1,122 @@
+#pragma once
+
+#include "memory_resource.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace dronecore {
+
+// Keeps the last samples of a value with their time, in preallocated storage
+// from the default memory resource.
+// Adding a sample never allocates, and a query only holds the lock while it
+// copies out at most two contiguous spans.
+//
+// Sample can be any struct with a time_us member, and samples need to be added
+// in increasing order of it.
+template<typename Sample>
+class HistoryBuffer
+{
+public:
+    HistoryBuffer() = default;
+    ~HistoryBuffer() = default;
+
+    // Drops all samples. A capacity of 0 turns the history off.
+    void set_capacity(size_t capacity)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _samples.assign(capacity, Sample());
+        _samples.shrink_to_fit();
+        _begin = 0;
+        _size = 0;
+        _capacity = capacity;
+    }
+
+    size_t capacity() const
+    {
+        return _capacity;
+    }
+
+    // Of the storage, which is taken up front for the whole capacity.
+    size_t bytes() const
+    {
+        return _capacity * sizeof(Sample);
+    }
+
+    void add(const Sample &sample)
+    {
+        // No need to lock if nobody wants the history.
+        if (_capacity == 0) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_samples.empty()) {
+            return;
+        }
+
+        if (_size < _samples.size()) {
+            _samples[index_of(_size)] = sample;
+            ++_size;
+        } else {
+            // Full, the oldest one makes space.
+            _samples[_begin] = sample;
+            _begin = index_of(1);
+        }
+    }
+
+    // Appends all samples from since_us onwards to samples, oldest first.
+    void copy_since(uint64_t since_us, std::vector<Sample> &samples) const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        // The samples are sorted by time, so the first one to copy can be found
+        // with a binary search over their order.
+        size_t first = 0;
+        size_t last = _size;
+        while (first < last) {
+            const size_t middle = first + (last - first) / 2;
+            if (_samples[index_of(middle)].time_us < since_us) {
+                first = middle + 1;
+            } else {
+                last = middle;
+            }
+        }
+
+        if (first == _size) {
+            return;
+        }
+
+        const size_t start = index_of(first);
+        const size_t count = _size - first;
+        const size_t until_wrap = std::min(count, _samples.size() - start);
+
+        samples.reserve(samples.size() + count);
+        samples.insert(samples.end(), _samples.begin() + start,
+                       _samples.begin() + start + until_wrap);
+
+        samples.insert(samples.end(), _samples.begin(), _samples.begin() + (count - until_wrap));
+    }
+
+    // Non-copyable
+    HistoryBuffer(const HistoryBuffer &) = delete;
+    const HistoryBuffer &operator=(const HistoryBuffer &) = delete;
+
+private:
+    size_t index_of(size_t position) const
+    {
+        // We assume that we already acquired _mutex in this function.
+        return (_begin + position) % _samples.size();
+    }
+
+    mutable std::mutex _mutex {};
+    pmr_vector<Sample> _samples {};
+    size_t _begin = 0;
+    size_t _size = 0;
+    std::atomic<size_t> _capacity {0};
+};
+
+} // namespace dronecore
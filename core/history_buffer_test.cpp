@@ -0,0 +1,81 @@
+#include "history_buffer.h"
+#include <gtest/gtest.h>
+
+using namespace dronecore;
+
+namespace {
+
+struct Sample {
+    uint64_t time_us;
+    int value;
+};
+
+} // namespace
+
+TEST(HistoryBuffer, OffByDefault)
+{
+    HistoryBuffer<Sample> history;
+    history.add(Sample {1, 1});
+
+    std::vector<Sample> samples;
+    history.copy_since(0, samples);
+    EXPECT_TRUE(samples.empty());
+}
+
+TEST(HistoryBuffer, CopiesSince)
+{
+    HistoryBuffer<Sample> history;
+    history.set_capacity(10);
+
+    for (int i = 0; i < 5; ++i) {
+        history.add(Sample {uint64_t(i * 100), i});
+    }
+
+    std::vector<Sample> samples;
+    history.copy_since(150, samples);
+    ASSERT_EQ(samples.size(), 3u);
+    EXPECT_EQ(samples[0].value, 2);
+    EXPECT_EQ(samples[2].value, 4);
+
+    samples.clear();
+    history.copy_since(1000, samples);
+    EXPECT_TRUE(samples.empty());
+}
+
+TEST(HistoryBuffer, KeepsLatestWhenFull)
+{
+    HistoryBuffer<Sample> history;
+    history.set_capacity(4);
+
+    for (int i = 0; i < 10; ++i) {
+        history.add(Sample {uint64_t(i), i});
+    }
+
+    std::vector<Sample> samples;
+    history.copy_since(0, samples);
+    ASSERT_EQ(samples.size(), 4u);
+    for (unsigned i = 0; i < samples.size(); ++i) {
+        EXPECT_EQ(samples[i].value, int(6 + i));
+    }
+
+    // The span to copy wraps around the end of the storage.
+    samples.clear();
+    history.copy_since(7, samples);
+    ASSERT_EQ(samples.size(), 3u);
+    EXPECT_EQ(samples[0].value, 7);
+    EXPECT_EQ(samples[2].value, 9);
+}
+
+TEST(HistoryBuffer, SetCapacityDrops)
+{
+    HistoryBuffer<Sample> history;
+    history.set_capacity(4);
+    history.add(Sample {1, 1});
+
+    history.set_capacity(8);
+    EXPECT_EQ(history.capacity(), 8u);
+
+    std::vector<Sample> samples;
+    history.copy_since(0, samples);
+    EXPECT_TRUE(samples.empty());
+}
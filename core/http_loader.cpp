@@ -1,8 +1,16 @@
 #include "http_loader.h"
 #include "curl_wrapper.h"
+#include "completion.h"
+#include "global_include.h"
+#include "log.h"
+#include "thread_roles.h"
+#include "trace_recorder.h"
+#include <algorithm>
+#include <cstring>
 
 namespace dronecore {
 
+constexpr int HttpLoader::MAX_BATCH_RETRIES;
 
 #ifdef TESTING
 HttpLoader::HttpLoader(const std::shared_ptr<ICurlWrapper> &curl_wrapper)
@@ -38,6 +46,9 @@ void HttpLoader::stop()
         delete _work_thread;
         _work_thread = nullptr;
     }
+
+    // The transfers which are running are finished, the rest is left out.
+    wait_for_batches();
 }
 
 bool HttpLoader::download_sync(const std::string &url, const std::string &local_path)
@@ -51,7 +62,175 @@ void HttpLoader::download_async(const std::string &url, const std::string &local
                                 const progress_callback_t &progress_callback)
 {
     auto work_item = std::make_shared<DownloadItem>(url, local_path, progress_callback);
-    _work_queue.enqueue(work_item);
+    _work_queue.enqueue(std::move(work_item));
+}
+
+void HttpLoader::download_stream_async(const std::string &url,
+                                       const chunk_callback_t &chunk_callback,
+                                       const result_callback_t &result_callback,
+                                       uint64_t offset)
+{
+    _curl_wrapper->download_stream_async(url, offset, chunk_callback, result_callback);
+}
+
+bool HttpLoader::download_stream_sync(const std::string &url,
+                                      const chunk_callback_t &chunk_callback,
+                                      uint64_t offset)
+{
+    Completion<bool> completion;
+
+    _curl_wrapper->download_stream_async(url, offset, chunk_callback, [&completion](bool success) {
+        completion.complete(success);
+    });
+
+    return completion.wait();
+}
+
+bool HttpLoader::download_to_buffer_sync(const std::string &url, char *buffer,
+                                         size_t buffer_size, size_t &received,
+                                         uint64_t offset)
+{
+    received = 0;
+    bool fits = true;
+
+    bool success = download_stream_sync(url, [buffer, buffer_size, &received, &fits]
+    (const char *data, size_t size) {
+        if (size > buffer_size - received) {
+            fits = false;
+            return false;
+        }
+        memcpy(buffer + received, data, size);
+        received += size;
+        return true;
+    }, offset);
+
+    if (!fits) {
+        LogErr() << "Content of " << url << " does not fit into " << buffer_size << " bytes";
+    }
+    return success && fits;
+}
+
+void HttpLoader::download_batch_async(const std::vector<BatchFile> &files,
+                                      unsigned max_parallel,
+                                      const batch_progress_callback_t &callback)
+{
+    auto batch = std::make_shared<Batch>();
+    batch->files = files;
+    batch->callback = callback;
+    batch->percentages.assign(files.size(), 0);
+    batch->progress.num_files = files.size();
+
+    if (files.empty() || _curl_wrapper == nullptr) {
+        std::lock_guard<std::mutex> lock(batch->mutex);
+        batch->progress.num_failed = files.size();
+        batch->progress.finished = true;
+        report_batch_progress(*batch);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_batches_mutex);
+        ++_num_batches;
+    }
+
+    std::vector<size_t> first_files;
+    {
+        // Transfers can't finish the batch before all of them are started.
+        std::lock_guard<std::mutex> lock(batch->mutex);
+        const size_t num_parallel = std::min<size_t>(std::max(max_parallel, 1u), files.size());
+        for (size_t i = 0; i < num_parallel; ++i) {
+            first_files.push_back(batch->next_file++);
+        }
+        batch->num_running = unsigned(num_parallel);
+    }
+
+    for (size_t index : first_files) {
+        download_batch_file(batch, index, 0);
+    }
+}
+
+void HttpLoader::download_batch_file(const std::shared_ptr<Batch> &batch, size_t index,
+                                     int attempt)
+{
+    auto progress_callback = [batch, index](int progress, Status status, CURLcode curl_code) {
+        UNUSED(status);
+        UNUSED(curl_code);
+        std::lock_guard<std::mutex> lock(batch->mutex);
+        // A retry starts counting again, only more is reported.
+        if (progress > batch->percentages[index] && progress < 100) {
+            batch->percentage_sum += progress - batch->percentages[index];
+            batch->percentages[index] = progress;
+            report_batch_progress(*batch);
+        }
+        return 0;
+    };
+
+    const BatchFile &file = batch->files[index];
+    _curl_wrapper->resume_download_file_to_path_async(
+        file.url, file.local_path, progress_callback,
+    [this, batch, index, attempt](bool success) {
+        if (!success && attempt < MAX_BATCH_RETRIES && !_should_exit) {
+            download_batch_file(batch, index, attempt + 1);
+            return;
+        }
+        finish_batch_file(batch, index, success);
+    });
+}
+
+void HttpLoader::finish_batch_file(const std::shared_ptr<Batch> &batch, size_t index,
+                                   bool success)
+{
+    bool has_next = false;
+    size_t next_index = 0;
+    {
+        std::lock_guard<std::mutex> lock(batch->mutex);
+        // Failed files are done as well.
+        batch->percentage_sum += 100 - batch->percentages[index];
+        batch->percentages[index] = 100;
+        if (success) {
+            ++batch->progress.num_succeeded;
+        } else {
+            ++batch->progress.num_failed;
+        }
+        report_batch_progress(*batch);
+
+        if (batch->next_file < batch->files.size() && !_should_exit) {
+            has_next = true;
+            next_index = batch->next_file++;
+
+        } else if (--batch->num_running == 0) {
+            batch->progress.finished = true;
+            report_batch_progress(*batch);
+        } else {
+            return;
+        }
+    }
+
+    if (has_next) {
+        download_batch_file(batch, next_index, 0);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_batches_mutex);
+    --_num_batches;
+    _batches_cv.notify_all();
+}
+
+void HttpLoader::report_batch_progress(Batch &batch)
+{
+    // We assume that we already acquired the mutex of the batch in this function.
+
+    batch.progress.percentage = batch.files.empty() ?
+                                100 : batch.percentage_sum / int(batch.files.size());
+    if (batch.callback) {
+        batch.callback(batch.progress);
+    }
+}
+
+void HttpLoader::wait_for_batches()
+{
+    std::unique_lock<std::mutex> lock(_batches_mutex);
+    _batches_cv.wait(lock, [this]() { return _num_batches == 0; });
 }
 
 bool HttpLoader::upload_sync(const std::string &target_url, const std::string &local_path)
@@ -65,11 +244,13 @@ void HttpLoader::upload_async(const std::string &target_url, const std::string &
                               const progress_callback_t &progress_callback)
 {
     auto work_item = std::make_shared<UploadItem>(target_url, local_path, progress_callback);
-    _work_queue.enqueue(work_item);
+    _work_queue.enqueue(std::move(work_item));
 }
 
 void HttpLoader::work_thread(HttpLoader *self)
 {
+    ThreadRoles::apply_to_this_thread(DroneCore::ThreadRole::HTTP, "http_loader");
+
     while (!self->_should_exit) {
         auto item = self->_work_queue.dequeue();
         auto curl_wrapper = self->_curl_wrapper;
@@ -85,12 +266,14 @@ void HttpLoader::do_item(const std::shared_ptr<WorkItem> &item,
 {
     auto download_item = std::dynamic_pointer_cast<DownloadItem>(item);
     if (nullptr != download_item) {
+        TraceScope scope("http", "download");
         do_download(download_item, curl_wrapper);
         return;
     }
 
     auto upload_item = std::dynamic_pointer_cast<UploadItem>(item);
     if (nullptr != upload_item) {
+        TraceScope scope("http", "upload");
         do_upload(upload_item, curl_wrapper);
         return;
     }
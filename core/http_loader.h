@@ -2,8 +2,12 @@
 
 #include <thread>
 #include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 #include "safe_queue.h"
 #include "curl_wrapper.h"
 
@@ -29,6 +33,43 @@ public:
     void download_async(const std::string &url, const std::string &local_path,
                         const progress_callback_t &progress_callback = nullptr);
 
+    // The content from offset on is handed to the chunk callback as it arrives,
+    // on the thread of the transfers, so the callback should not block. A
+    // transfer which stopped can be continued with the offset it got to.
+    void download_stream_async(const std::string &url, const chunk_callback_t &chunk_callback,
+                               const result_callback_t &result_callback,
+                               uint64_t offset = 0);
+    bool download_stream_sync(const std::string &url, const chunk_callback_t &chunk_callback,
+                              uint64_t offset = 0);
+    // Fails if the content does not fit into the buffer, received tells how much
+    // of it is there.
+    bool download_to_buffer_sync(const std::string &url, char *buffer, size_t buffer_size,
+                                 size_t &received, uint64_t offset = 0);
+
+    struct BatchFile {
+        std::string url;
+        std::string local_path;
+    };
+
+    struct BatchProgress {
+        size_t num_files;
+        size_t num_succeeded;
+        size_t num_failed;
+        // Of the whole batch, every file counts the same.
+        int percentage;
+        bool finished;
+    };
+
+    typedef std::function<void(const BatchProgress &progress)> batch_progress_callback_t;
+
+    // Downloads the files with up to max_parallel transfers at a time, next to
+    // the work queue so that it is not held up. Transfers continue files which
+    // are partly there, and continue again where they stopped if they fail, up
+    // to MAX_BATCH_RETRIES times. The callback is called with the lock of the
+    // batch held, as the batch goes on and a last time with finished set.
+    void download_batch_async(const std::vector<BatchFile> &files, unsigned max_parallel,
+                              const batch_progress_callback_t &callback);
+
     bool upload_sync(const std::string &target_url, const std::string &local_path);
     void upload_async(const std::string &target_url, const std::string &local_path,
                       const progress_callback_t &progress_callback = nullptr);
@@ -142,12 +183,36 @@ private:
     static bool do_upload(const std::shared_ptr<UploadItem> &item,
                           const std::shared_ptr<ICurlWrapper> &curl_wrapper);
 
+    struct Batch {
+        std::vector<BatchFile> files {};
+        batch_progress_callback_t callback {};
+
+        std::mutex mutex {};
+        size_t next_file = 0;
+        std::vector<int> percentages {};
+        int percentage_sum = 0;
+        BatchProgress progress {};
+        unsigned num_running = 0;
+    };
+
+    void download_batch_file(const std::shared_ptr<Batch> &batch, size_t index, int attempt);
+    void finish_batch_file(const std::shared_ptr<Batch> &batch, size_t index, bool success);
+    // We assume that we already acquired the mutex of the batch in this function.
+    static void report_batch_progress(Batch &batch);
+    void wait_for_batches();
+
+    static constexpr int MAX_BATCH_RETRIES = 3;
+
     std::shared_ptr<ICurlWrapper> _curl_wrapper;
 
     SafeQueue <std::shared_ptr<WorkItem>> _work_queue {};
     std::thread *_work_thread = nullptr;
 
     std::atomic<bool> _should_exit {false};
+
+    std::mutex _batches_mutex {};
+    std::condition_variable _batches_cv {};
+    unsigned _num_batches = 0;
 };
 
 } // namespace dronecore
@@ -0,0 +1,59 @@
+#include "inflater.h"
+#include "log.h"
+#include <zlib.h>
+
+namespace dronecore {
+
+Inflater::Inflater() :
+    _stream(new z_stream_s())
+{
+    // With 32 added to the window bits, zlib tells gzip and zlib apart itself.
+    // This is what the inflateInit2() macro does, without its old-style cast.
+    _is_initialized = (inflateInit2_(_stream.get(), 15 + 32, ZLIB_VERSION,
+                                     int(sizeof(z_stream))) == Z_OK);
+    if (!_is_initialized) {
+        LogErr() << "Could not initialize zlib";
+    }
+}
+
+Inflater::~Inflater()
+{
+    if (_is_initialized) {
+        inflateEnd(_stream.get());
+    }
+}
+
+bool Inflater::feed(const char *data, size_t size, std::string &output)
+{
+    if (!_is_initialized || _has_failed) {
+        return false;
+    }
+
+    _stream->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    _stream->avail_in = uInt(size);
+
+    char buffer[4096];
+    // Until all input is taken and the output did not fill the buffer.
+    do {
+        _stream->next_out = reinterpret_cast<Bytef *>(buffer);
+        _stream->avail_out = sizeof(buffer);
+
+        const int result = inflate(_stream.get(), Z_NO_FLUSH);
+        // Not being able to go on means that input is needed.
+        if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+            LogErr() << "Could not decompress: " << (_stream->msg ? _stream->msg : "invalid data");
+            _has_failed = true;
+            return false;
+        }
+        output.append(buffer, sizeof(buffer) - _stream->avail_out);
+        _is_finished = (result == Z_STREAM_END);
+    } while (!_is_finished && (_stream->avail_in > 0 || _stream->avail_out == 0));
+    return true;
+}
+
+bool Inflater::is_gzip(const char *data, size_t size)
+{
+    return size >= 2 && uint8_t(data[0]) == 0x1f && uint8_t(data[1]) == 0x8b;
+}
+
+} // namespace dronecore
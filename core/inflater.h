@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+struct z_stream_s;
+
+namespace dronecore {
+
+// Decompresses gzip or zlib data as it arrives, like the chunks of a download,
+// so that the compressed data never needs to be kept as a whole.
+class Inflater
+{
+public:
+    Inflater();
+    ~Inflater();
+
+    // Appends what the data decompresses to. Fails once the data turns out not
+    // to be valid, the rest is ignored then.
+    bool feed(const char *data, size_t size, std::string &output);
+
+    // Whether the end of the compressed data has been reached.
+    bool is_finished() const { return _is_finished; }
+
+    // By the magic bytes of gzip at the start.
+    static bool is_gzip(const char *data, size_t size);
+
+    // Non-copyable
+    Inflater(const Inflater &) = delete;
+    const Inflater &operator=(const Inflater &) = delete;
+
+private:
+    std::unique_ptr<z_stream_s> _stream;
+    bool _is_initialized = false;
+    bool _is_finished = false;
+    bool _has_failed = false;
+};
+
+} // namespace dronecore
@@ -0,0 +1,80 @@
+#include "inflater.h"
+#include <gtest/gtest.h>
+#include <zlib.h>
+#include <algorithm>
+#include <string>
+
+using namespace dronecore;
+
+static std::string gzip(const std::string &content)
+{
+    z_stream stream {};
+    // 16 added to the window bits makes it gzip instead of zlib. Like the
+    // deflateInit2() macro, without its old-style cast.
+    deflateInit2_(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY,
+                  ZLIB_VERSION, int(sizeof(z_stream)));
+
+    std::string compressed(deflateBound(&stream, uLong(content.size())), '\0');
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(content.data()));
+    stream.avail_in = uInt(content.size());
+    stream.next_out = reinterpret_cast<Bytef *>(&compressed[0]);
+    stream.avail_out = uInt(compressed.size());
+    deflate(&stream, Z_FINISH);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    return compressed;
+}
+
+static std::string make_definition()
+{
+    std::string content = "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n<mavlinkcamera>\n";
+    for (int i = 0; i < 1000; ++i) {
+        content += "  <option name=\"Option " + std::to_string(i) + "\" value=\"" +
+                   std::to_string(i) + "\" />\n";
+    }
+    return content + "</mavlinkcamera>\n";
+}
+
+TEST(Inflater, DecompressesChunkByChunk)
+{
+    const std::string content = make_definition();
+    const std::string compressed = gzip(content);
+    ASSERT_TRUE(Inflater::is_gzip(compressed.data(), compressed.size()));
+    EXPECT_LT(compressed.size(), content.size() / 4);
+
+    Inflater inflater;
+    std::string output;
+    // Like a slow download.
+    for (size_t i = 0; i < compressed.size(); i += 7) {
+        const size_t size = std::min(size_t(7), compressed.size() - i);
+        ASSERT_TRUE(inflater.feed(&compressed[i], size, output));
+    }
+
+    EXPECT_TRUE(inflater.is_finished());
+    EXPECT_EQ(output, content);
+}
+
+TEST(Inflater, DecompressesAllAtOnce)
+{
+    const std::string content = make_definition();
+    const std::string compressed = gzip(content);
+
+    Inflater inflater;
+    std::string output;
+    EXPECT_TRUE(inflater.feed(compressed.data(), compressed.size(), output));
+    EXPECT_TRUE(inflater.is_finished());
+    EXPECT_EQ(output, content);
+}
+
+TEST(Inflater, FailsOnInvalidData)
+{
+    const std::string content = make_definition();
+    EXPECT_FALSE(Inflater::is_gzip(content.data(), content.size()));
+
+    Inflater inflater;
+    std::string output;
+    EXPECT_FALSE(inflater.feed(content.data(), content.size(), output));
+    EXPECT_FALSE(inflater.is_finished());
+    // Once failed, it stays that way.
+    EXPECT_FALSE(inflater.feed(content.data(), content.size(), output));
+}
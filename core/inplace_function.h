@@ -0,0 +1,230 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace dronecore {
+
+template <typename Signature, size_t Capacity, bool Copyable = false>
+class InplaceFunction;
+
+// Like a move-only std::function, but keeps callables of up to Capacity bytes
+// in place instead of allocating them. Larger ones still work but are put on
+// the heap. If Copyable, it can be copied like a std::function, which then
+// only needs the callables to be copyable.
+template <size_t Capacity, bool Copyable, typename R, typename... Args>
+class InplaceFunction<R(Args...), Capacity, Copyable>
+{
+private:
+    // Takes the place of the copy constructor and assignment if not Copyable.
+    struct NotCopyable {};
+    typedef typename std::conditional<Copyable, InplaceFunction, NotCopyable>::type copy_t;
+
+public:
+    InplaceFunction() {}
+    InplaceFunction(std::nullptr_t) {}
+
+    template <typename F, typename = typename std::enable_if<
+                  !std::is_same<typename std::decay<F>::type, InplaceFunction>::value>::type>
+    InplaceFunction(F &&functor)
+    {
+        typedef typename std::decay<F>::type functor_t;
+        typedef typename std::conditional<fits_in_place<functor_t>(),
+                InPlace<functor_t>, OnHeap<functor_t>>::type holder_t;
+        static_assert(!Copyable || std::is_copy_constructible<functor_t>::value,
+                      "functor needs to be copyable");
+
+        // So that an empty std::function or function pointer stays empty.
+        if (is_empty(functor)) {
+            return;
+        }
+        holder_t::construct(&_storage, std::forward<F>(functor));
+        _invoke = &holder_t::invoke;
+        _manage = &holder_t::manage;
+    }
+
+    InplaceFunction(InplaceFunction &&other)
+    {
+        move_from(other);
+    }
+
+    InplaceFunction(const copy_t &other)
+    {
+        copy_from(other);
+    }
+
+    InplaceFunction &operator=(InplaceFunction &&other)
+    {
+        if (this != &other) {
+            reset();
+            move_from(other);
+        }
+        return *this;
+    }
+
+    InplaceFunction &operator=(const copy_t &other)
+    {
+        if (this != &other) {
+            reset();
+            copy_from(other);
+        }
+        return *this;
+    }
+
+    ~InplaceFunction()
+    {
+        reset();
+    }
+
+    explicit operator bool() const { return _invoke != nullptr; }
+    bool operator==(std::nullptr_t) const { return _invoke == nullptr; }
+    bool operator!=(std::nullptr_t) const { return _invoke != nullptr; }
+
+    R operator()(Args... args) const
+    {
+        return _invoke(const_cast<void *>(static_cast<const void *>(&_storage)),
+                       std::forward<Args>(args)...);
+    }
+
+    template <typename F>
+    static constexpr bool fits_in_place()
+    {
+        return sizeof(F) <= Capacity && alignof(F) <= alignof(storage_t);
+    }
+
+private:
+    enum class Operation {
+        MOVE,
+        COPY,
+        DESTROY
+    };
+
+    typedef typename std::aligned_storage<Capacity, alignof(std::max_align_t)>::type storage_t;
+    typedef R (*invoke_t)(void *storage, Args &&... args);
+    // Moves from src to dest for MOVE, src is destroyed unless it is a COPY.
+    typedef void (*manage_t)(Operation operation, void *dest, void *src);
+
+    template <typename F>
+    static bool is_empty(const F &) { return false; }
+    template <typename S>
+    static bool is_empty(const std::function<S> &functor) { return !functor; }
+    template <typename T>
+    static bool is_empty(T *functor) { return functor == nullptr; }
+
+    // Only instantiated with copies if Copyable.
+    template <typename F>
+    static void copy_construct(void *dest, const F &functor, std::true_type)
+    {
+        new (dest) F(functor);
+    }
+    template <typename F>
+    static void copy_construct(void *, const F &, std::false_type) {}
+    template <typename F>
+    static void copy_onto_heap(void *dest, const F &functor, std::true_type)
+    {
+        new (dest) F *(new F(functor));
+    }
+    template <typename F>
+    static void copy_onto_heap(void *, const F &, std::false_type) {}
+
+    template <typename F>
+    struct InPlace {
+        template <typename G>
+        static void construct(void *storage, G &&functor)
+        {
+            new (storage) F(std::forward<G>(functor));
+        }
+
+        static R invoke(void *storage, Args &&... args)
+        {
+            return (*static_cast<F *>(storage))(std::forward<Args>(args)...);
+        }
+
+        static void manage(Operation operation, void *dest, void *src)
+        {
+            F *functor = static_cast<F *>(src);
+            if (operation == Operation::COPY) {
+                copy_construct(dest, *functor, std::integral_constant<bool, Copyable>());
+                return;
+            }
+            if (operation == Operation::MOVE) {
+                new (dest) F(std::move(*functor));
+            }
+            functor->~F();
+        }
+    };
+
+    template <typename F>
+    struct OnHeap {
+        static F *&pointer(void *storage) { return *static_cast<F **>(storage); }
+
+        template <typename G>
+        static void construct(void *storage, G &&functor)
+        {
+            new (storage) F *(new F(std::forward<G>(functor)));
+        }
+
+        static R invoke(void *storage, Args &&... args)
+        {
+            return (*pointer(storage))(std::forward<Args>(args)...);
+        }
+
+        static void manage(Operation operation, void *dest, void *src)
+        {
+            if (operation == Operation::COPY) {
+                copy_onto_heap(dest, *pointer(src), std::integral_constant<bool, Copyable>());
+            } else if (operation == Operation::MOVE) {
+                new (dest) F *(pointer(src));
+            } else {
+                delete pointer(src);
+            }
+        }
+    };
+
+    void move_from(InplaceFunction &other)
+    {
+        if (other._manage != nullptr) {
+            other._manage(Operation::MOVE, &_storage, &other._storage);
+        }
+        _invoke = other._invoke;
+        _manage = other._manage;
+        other._invoke = nullptr;
+        other._manage = nullptr;
+    }
+
+    void copy_from(const InplaceFunction &other)
+    {
+        if (other._manage != nullptr) {
+            other._manage(Operation::COPY, &_storage,
+                          const_cast<void *>(static_cast<const void *>(&other._storage)));
+        }
+        _invoke = other._invoke;
+        _manage = other._manage;
+    }
+
+    void reset()
+    {
+        if (_manage != nullptr) {
+            _manage(Operation::DESTROY, nullptr, &_storage);
+        }
+        _invoke = nullptr;
+        _manage = nullptr;
+    }
+
+    storage_t _storage;
+    invoke_t _invoke = nullptr;
+    manage_t _manage = nullptr;
+};
+
+// For the callbacks kept by the core, e.g. message handlers, timeouts and the
+// work of commands and params. A std::bind of a member function with `this` and
+// a few arguments fits, and so does a lambda holding a std::function.
+static constexpr size_t CALLBACK_LEN = 48;
+
+template <typename Signature>
+using Callback = InplaceFunction<Signature, CALLBACK_LEN, true>;
+
+} // namespace dronecore
@@ -0,0 +1,111 @@
+#include "inplace_function.h"
+#include "allocation_counter.h"
+#include <gtest/gtest.h>
+#include <array>
+#include <functional>
+#include <memory>
+#include <utility>
+
+using namespace dronecore;
+
+TEST(InplaceFunction, CallsSmallFunctorWithoutAllocating)
+{
+    int sum = 0;
+    const int offset = 3;
+
+    AllocationCounter::reset();
+    AllocationCounter::count_this_thread();
+    {
+        InplaceFunction<void(int), 32> function([&sum, offset](int value) {
+            sum += value + offset;
+        });
+
+        InplaceFunction<void(int), 32> moved(std::move(function));
+        EXPECT_FALSE(function);
+        ASSERT_TRUE(moved);
+        moved(1);
+        moved(2);
+    }
+    AllocationCounter::stop_counting_this_thread();
+
+    EXPECT_EQ(sum, 9);
+    EXPECT_EQ(AllocationCounter::num_allocations(), 0u);
+}
+
+TEST(InplaceFunction, PutsLargeFunctorOnHeap)
+{
+    std::array<int, 32> values {};
+    values[31] = 42;
+
+    typedef InplaceFunction<int(), 16> function_t;
+    auto large = [values]() { return values[31]; };
+    EXPECT_FALSE(function_t::fits_in_place<decltype(large)>());
+
+    function_t function(large);
+    function_t other;
+    other = std::move(function);
+    EXPECT_EQ(other(), 42);
+}
+
+TEST(InplaceFunction, DestroysFunctor)
+{
+    auto counted = std::make_shared<int>(0);
+    {
+        InplaceFunction<void(), 32> function([counted]() {});
+        EXPECT_EQ(counted.use_count(), 2);
+
+        InplaceFunction<void(), 32> other([]() {});
+        other = std::move(function);
+        EXPECT_EQ(counted.use_count(), 2);
+    }
+    EXPECT_EQ(counted.use_count(), 1);
+}
+
+TEST(InplaceFunction, TakesMoveOnlyArguments)
+{
+    InplaceFunction<int(std::unique_ptr<int>), 16> function([](std::unique_ptr<int> value) {
+        return *value;
+    });
+    EXPECT_EQ(function(std::unique_ptr<int>(new int(7))), 7);
+}
+
+TEST(InplaceFunction, CopiesCallbackWithoutAllocating)
+{
+    struct Receiver {
+        void receive(bool success, int value) { sum += success ? value : 0; }
+        int sum = 0;
+    } receiver;
+
+    using namespace std::placeholders;
+    auto bound = std::bind(&Receiver::receive, &receiver, _1, _2);
+    EXPECT_TRUE(Callback<void(bool, int)>::fits_in_place<decltype(bound)>());
+
+    AllocationCounter::reset();
+    AllocationCounter::count_this_thread();
+    {
+        Callback<void(bool, int)> callback(bound);
+        Callback<void(bool, int)> copy(callback);
+        Callback<void(bool, int)> other;
+        other = copy;
+        callback(true, 1);
+        copy(true, 2);
+        other(false, 4);
+    }
+    AllocationCounter::stop_counting_this_thread();
+
+    EXPECT_EQ(receiver.sum, 3);
+    EXPECT_EQ(AllocationCounter::num_allocations(), 0u);
+}
+
+TEST(InplaceFunction, KeepsEmptyStdFunctionEmpty)
+{
+    std::function<void()> empty;
+    Callback<void()> callback(empty);
+    EXPECT_FALSE(callback);
+    EXPECT_TRUE(callback == nullptr);
+
+    callback = []() {};
+    EXPECT_TRUE(callback != nullptr);
+    callback = nullptr;
+    EXPECT_FALSE(callback);
+}
@@ -14,7 +14,8 @@ protected:
 #ifndef WINDOWS
         const int ret = system("./start_px4_sitl.sh");
         if (ret != 0) {
-            dronecore::LogErr() << "./start_px4_sitl.sh failed, giving up.";
+            LogErr() << "./start_px4_sitl.sh failed, giving up.";
+            dronecore::AsyncLogger::instance().flush();
             abort();
         }
         // We need to wait a bit until it's up and running.
@@ -28,7 +29,8 @@ protected:
         std::this_thread::sleep_for(std::chrono::seconds(1));
         const int ret = system("./stop_px4_sitl.sh");
         if (ret != 0) {
-            dronecore::LogErr() << "./stop_px4_sitl.sh failed, giving up.";
+            LogErr() << "./stop_px4_sitl.sh failed, giving up.";
+            dronecore::AsyncLogger::instance().flush();
             abort();
         }
 #endif
@@ -0,0 +1,512 @@
+#include "io_reactor.h"
+#include "global_include.h"
+#include "io_uring.h"
+#include "log.h"
+#include "thread_roles.h"
+#include <cstdlib>
+#include <cstring>
+
+#if defined(LINUX)
+#include <sys/epoll.h>
+#elif defined(APPLE)
+#include <sys/types.h>
+#include <sys/event.h>
+#include <sys/time.h>
+#endif
+
+#if defined(DRONECORE_IO_URING)
+#include <poll.h>
+#endif
+
+#if defined(LINUX) || defined(APPLE)
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#endif
+
+namespace dronecore {
+
+#if defined(LINUX) || defined(APPLE)
+#define GET_ERROR(_x) strerror(_x)
+#define REACTOR_SUPPORTED
+#endif
+
+#if defined(DRONECORE_IO_URING)
+namespace {
+
+// Enough for bursts of a fleet, datagrams beyond that wait in the socket.
+constexpr unsigned IO_URING_ENTRIES = 256;
+constexpr unsigned IO_URING_NUM_BUFFERS = 256;
+// As UdpConnection, enough for MTU 1500 bytes, and the address before it.
+constexpr unsigned IO_URING_BUFFER_LEN = 2048 + 256;
+
+// Of the wake-ups and cancels, whose completions are not for any fd.
+constexpr uint64_t NO_FD_USER_DATA = 0;
+
+uint64_t user_data_of(int fd, uint32_t generation)
+{
+    return (uint64_t(generation) << 32) | uint32_t(fd);
+}
+
+bool io_uring_requested()
+{
+    const char *backend = std::getenv("DRONECORE_IO_BACKEND");
+    return backend == nullptr || strcmp(backend, "epoll") != 0;
+}
+
+} // namespace
+#endif
+
+IoReactor::IoReactor()
+{
+#if defined(DRONECORE_IO_URING)
+    if (io_uring_requested()) {
+        _uring.reset(new IoUring());
+        if (_uring->init(IO_URING_ENTRIES, IO_URING_NUM_BUFFERS, IO_URING_BUFFER_LEN)) {
+            _thread = new std::thread(&IoReactor::run, this);
+            return;
+        }
+        LogInfo() << "Falling back to epoll";
+        _uring.reset();
+    }
+#endif
+
+#if defined(REACTOR_SUPPORTED)
+#if defined(LINUX)
+    _poll_fd = epoll_create1(EPOLL_CLOEXEC);
+#else
+    _poll_fd = kqueue();
+#endif
+    if (_poll_fd < 0) {
+        LogErr() << "Could not create reactor: " << GET_ERROR(errno);
+        return;
+    }
+
+    // A pipe is used to wake up the reactor thread on stop.
+    if (pipe(_wake_up_fds) != 0) {
+        LogErr() << "Could not create reactor pipe: " << GET_ERROR(errno);
+        close(_poll_fd);
+        _poll_fd = -1;
+        return;
+    }
+    fcntl(_wake_up_fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(_wake_up_fds[1], F_SETFL, O_NONBLOCK);
+
+#if defined(LINUX)
+    struct epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.fd = _wake_up_fds[0];
+    epoll_ctl(_poll_fd, EPOLL_CTL_ADD, _wake_up_fds[0], &event);
+#else
+    struct kevent event;
+    EV_SET(&event, _wake_up_fds[0], EVFILT_READ, EV_ADD, 0, 0, nullptr);
+    kevent(_poll_fd, &event, 1, nullptr, 0, nullptr);
+#endif
+
+    _thread = new std::thread(&IoReactor::run, this);
+#endif
+}
+
+IoReactor::~IoReactor()
+{
+    _should_exit = true;
+
+    if (_thread) {
+        wake_up();
+        _thread->join();
+        delete _thread;
+        _thread = nullptr;
+    }
+
+#if defined(DRONECORE_IO_URING)
+    _uring.reset();
+#endif
+
+#if defined(REACTOR_SUPPORTED)
+    if (_wake_up_fds[0] >= 0) {
+        close(_wake_up_fds[0]);
+        close(_wake_up_fds[1]);
+    }
+    if (_poll_fd >= 0) {
+        close(_poll_fd);
+    }
+#endif
+}
+
+bool IoReactor::is_supported()
+{
+#if defined(REACTOR_SUPPORTED)
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool IoReactor::uses_io_uring() const
+{
+#if defined(DRONECORE_IO_URING)
+    return _uring != nullptr;
+#else
+    return false;
+#endif
+}
+
+bool IoReactor::add_fd(int fd, readable_callback_t callback)
+{
+#if defined(DRONECORE_IO_URING)
+    if (_uring) {
+        return add_to_io_uring(fd, callback, nullptr);
+    }
+#endif
+
+#if defined(REACTOR_SUPPORTED)
+    if (_poll_fd < 0 || fd < 0) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_callbacks_mutex);
+        _callbacks[fd] = std::make_shared<Entry>(Entry {callback, nullptr, 0});
+    }
+
+#if defined(LINUX)
+    struct epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    const bool success = (epoll_ctl(_poll_fd, EPOLL_CTL_ADD, fd, &event) == 0);
+#else
+    struct kevent event;
+    EV_SET(&event, fd, EVFILT_READ, EV_ADD, 0, 0, nullptr);
+    const bool success = (kevent(_poll_fd, &event, 1, nullptr, 0, nullptr) == 0);
+#endif
+
+    if (!success) {
+        LogErr() << "Could not add fd to reactor: " << GET_ERROR(errno);
+        std::lock_guard<std::mutex> lock(_callbacks_mutex);
+        _callbacks.erase(fd);
+        return false;
+    }
+    return true;
+#else
+    UNUSED(fd);
+    UNUSED(callback);
+    return false;
+#endif
+}
+
+bool IoReactor::add_datagram_fd(int fd, datagram_callback_t callback)
+{
+#if defined(DRONECORE_IO_URING)
+    if (_uring) {
+        return add_to_io_uring(fd, nullptr, callback);
+    }
+#endif
+    UNUSED(fd);
+    UNUSED(callback);
+    return false;
+}
+
+void IoReactor::remove_fd(int fd)
+{
+#if defined(REACTOR_SUPPORTED)
+    std::shared_ptr<Entry> removed;
+#if defined(DRONECORE_IO_URING)
+    // Held from the erase to the cancel. Otherwise the reactor thread could
+    // arm the fd again in between, and the cancel would miss that request.
+    std::unique_lock<std::mutex> submit_lock(_submit_mutex, std::defer_lock);
+    if (_uring) {
+        submit_lock.lock();
+    }
+#endif
+    {
+        std::lock_guard<std::mutex> lock(_callbacks_mutex);
+        auto it = _callbacks.find(fd);
+        if (it != _callbacks.end()) {
+            removed = it->second;
+            _callbacks.erase(it);
+        }
+    }
+
+#if defined(DRONECORE_IO_URING)
+    if (removed && _uring) {
+        // Completions which are still on their way are dropped as the entry
+        // is gone.
+        io_uring_sqe *sqe = _uring->get_sqe();
+        if (!sqe) {
+            _uring->submit();
+            sqe = _uring->get_sqe();
+        }
+        if (sqe) {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = user_data_of(fd, removed->generation);
+            sqe->user_data = NO_FD_USER_DATA;
+            _uring->submit();
+        } else {
+            LogErr() << "Could not cancel io_uring request of fd " << fd;
+        }
+        removed.reset();
+    }
+    // The reactor thread holds _dispatch_mutex while it waits for this one.
+    if (submit_lock.owns_lock()) {
+        submit_lock.unlock();
+    }
+#endif
+
+    if (removed) {
+#if defined(LINUX)
+        epoll_ctl(_poll_fd, EPOLL_CTL_DEL, fd, nullptr);
+#else
+        struct kevent event;
+        EV_SET(&event, fd, EVFILT_READ, EV_DELETE, 0, 0, nullptr);
+        kevent(_poll_fd, &event, 1, nullptr, 0, nullptr);
+#endif
+    }
+
+    // Wait for a callback which might currently be running, unless we are
+    // being called from within it.
+    if (!_thread || std::this_thread::get_id() != _thread->get_id()) {
+        std::lock_guard<std::mutex> lock(_dispatch_mutex);
+    }
+#else
+    UNUSED(fd);
+#endif
+}
+
+void IoReactor::wake_up()
+{
+#if defined(DRONECORE_IO_URING)
+    if (_uring) {
+        std::lock_guard<std::mutex> lock(_submit_mutex);
+        io_uring_sqe *sqe = _uring->get_sqe();
+        if (sqe) {
+            sqe->opcode = IORING_OP_NOP;
+            sqe->user_data = NO_FD_USER_DATA;
+        }
+        _uring->submit();
+        return;
+    }
+#endif
+
+#if defined(REACTOR_SUPPORTED)
+    const char dummy = 0;
+    if (write(_wake_up_fds[1], &dummy, 1) != 1) {
+        LogWarn() << "Could not wake up reactor";
+    }
+#endif
+}
+
+void IoReactor::drain_wake_up()
+{
+#if defined(REACTOR_SUPPORTED)
+    char dummy[16];
+    while (read(_wake_up_fds[0], dummy, sizeof(dummy)) > 0) {}
+#endif
+}
+
+void IoReactor::run()
+{
+    ThreadRoles::apply_to_this_thread(DroneCore::ThreadRole::RECEIVE, "io_reactor");
+
+#if defined(DRONECORE_IO_URING)
+    if (_uring) {
+        run_io_uring();
+        return;
+    }
+#endif
+
+#if defined(REACTOR_SUPPORTED)
+    static constexpr int MAX_EVENTS = 32;
+    int ready_fds[MAX_EVENTS];
+
+    while (!_should_exit) {
+
+#if defined(LINUX)
+        struct epoll_event events[MAX_EVENTS];
+        const int num_events = epoll_wait(_poll_fd, events, MAX_EVENTS, -1);
+        for (int i = 0; i < num_events; ++i) {
+            ready_fds[i] = events[i].data.fd;
+        }
+#else
+        struct kevent events[MAX_EVENTS];
+        const int num_events = kevent(_poll_fd, nullptr, 0, events, MAX_EVENTS, nullptr);
+        for (int i = 0; i < num_events; ++i) {
+            ready_fds[i] = static_cast<int>(events[i].ident);
+        }
+#endif
+
+        if (num_events < 0) {
+            if (errno != EINTR) {
+                LogErr() << "Reactor wait failed: " << GET_ERROR(errno);
+            }
+            continue;
+        }
+
+        for (int i = 0; i < num_events; ++i) {
+            if (ready_fds[i] == _wake_up_fds[0]) {
+                drain_wake_up();
+                continue;
+            }
+
+            std::lock_guard<std::mutex> dispatch_lock(_dispatch_mutex);
+
+            std::shared_ptr<Entry> entry;
+            {
+                std::lock_guard<std::mutex> lock(_callbacks_mutex);
+                auto it = _callbacks.find(ready_fds[i]);
+                if (it != _callbacks.end()) {
+                    entry = it->second;
+                }
+            }
+
+            // The fd might have been removed in the meantime.
+            if (entry) {
+                entry->readable();
+            }
+        }
+    }
+#endif
+}
+
+#if defined(DRONECORE_IO_URING)
+bool IoReactor::add_to_io_uring(int fd, readable_callback_t readable,
+                                datagram_callback_t datagram)
+{
+    if (fd < 0) {
+        return false;
+    }
+
+    std::shared_ptr<Entry> entry;
+    {
+        std::lock_guard<std::mutex> lock(_callbacks_mutex);
+        entry = std::make_shared<Entry>(Entry {readable, datagram, _next_generation++});
+        _callbacks[fd] = entry;
+    }
+
+    if (!arm(fd, *entry)) {
+        LogErr() << "Could not add fd to io_uring";
+        std::lock_guard<std::mutex> lock(_callbacks_mutex);
+        _callbacks.erase(fd);
+        return false;
+    }
+    return true;
+}
+
+bool IoReactor::arm(int fd, const Entry &entry)
+{
+    std::lock_guard<std::mutex> lock(_submit_mutex);
+    return arm_locked(fd, entry);
+}
+
+bool IoReactor::arm_locked(int fd, const Entry &entry)
+{
+    io_uring_sqe *sqe = _uring->get_sqe();
+    if (!sqe) {
+        // Full of what the reactor thread has not submitted yet.
+        _uring->submit();
+        sqe = _uring->get_sqe();
+        if (!sqe) {
+            return false;
+        }
+    }
+
+    if (entry.datagram) {
+        _uring->prep_recvmsg_multishot(*sqe, fd);
+    } else {
+        // One poll at a time, so that whatever is left after the callback is
+        // seen by the next one.
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = fd;
+        sqe->poll32_events = POLLIN;
+    }
+    sqe->user_data = user_data_of(fd, entry.generation);
+
+    if (_thread && std::this_thread::get_id() == _thread->get_id()) {
+        _uring->publish();
+        return true;
+    }
+    return _uring->submit();
+}
+
+void IoReactor::run_io_uring()
+{
+    while (!_should_exit) {
+        if (!_uring->wait()) {
+            return;
+        }
+
+        io_uring_cqe cqe;
+        while (!_should_exit && _uring->pop_cqe(cqe)) {
+            handle_completion(cqe);
+        }
+    }
+}
+
+void IoReactor::handle_completion(const io_uring_cqe &cqe)
+{
+    if (cqe.user_data == NO_FD_USER_DATA) {
+        return;
+    }
+
+    const int fd = int(uint32_t(cqe.user_data));
+    const uint32_t generation = uint32_t(cqe.user_data >> 32);
+
+    std::lock_guard<std::mutex> dispatch_lock(_dispatch_mutex);
+
+    std::shared_ptr<Entry> entry;
+    {
+        std::lock_guard<std::mutex> lock(_callbacks_mutex);
+        auto it = _callbacks.find(fd);
+        if (it != _callbacks.end() && it->second->generation == generation) {
+            entry = it->second;
+        }
+    }
+
+    if (entry && entry->datagram) {
+        Datagram datagram {};
+        if (_uring->get_datagram(cqe, datagram.src_addr, datagram.src_addr_len,
+                                 datagram.control, datagram.control_len,
+                                 datagram.data, datagram.len)) {
+            entry->datagram(datagram);
+        }
+    }
+    // Also if the fd has been removed in the meantime.
+    _uring->recycle_buffer(cqe);
+
+    if (!entry) {
+        return;
+    }
+
+    if (entry->datagram) {
+        // The receive ends e.g. once the buffers run out, then a new one is
+        // needed.
+        if (cqe.flags & IORING_CQE_F_MORE) {
+            return;
+        }
+        if (cqe.res < 0 && cqe.res != -ENOBUFS) {
+            LogErr() << "io_uring receive failed: " << GET_ERROR(-cqe.res);
+            return;
+        }
+    } else {
+        if (cqe.res < 0) {
+            LogErr() << "io_uring poll failed: " << GET_ERROR(-cqe.res);
+            return;
+        }
+        entry->readable();
+    }
+
+    // Unless the callback has removed it. Checked and armed under
+    // _submit_mutex, which remove_fd() holds until its cancel is queued.
+    std::lock_guard<std::mutex> submit_lock(_submit_mutex);
+    {
+        std::lock_guard<std::mutex> lock(_callbacks_mutex);
+        auto it = _callbacks.find(fd);
+        if (it == _callbacks.end() || it->second != entry) {
+            return;
+        }
+    }
+    arm_locked(fd, *entry);
+}
+#endif
+
+} // namespace dronecore
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#if defined(DRONECORE_IO_URING)
+struct io_uring_cqe;
+#endif
+
+namespace dronecore {
+
+class IoUring;
+
+// The IoReactor waits on the file descriptors of all connections which opt
+// into it using one thread (epoll on Linux, kqueue on macOS) instead of each
+// connection blocking in its own receive thread.
+//
+// If built with ENABLE_IO_URING, io_uring is used instead where the kernel
+// has it, unless the environment variable DRONECORE_IO_BACKEND is set to
+// "epoll". It also receives the datagrams itself, into buffers shared with
+// the kernel, so that one system call brings in many of them.
+class IoReactor
+{
+public:
+    IoReactor();
+    ~IoReactor();
+
+    typedef std::function<void()> readable_callback_t;
+    // A received datagram, only valid during the callback. The address is a
+    // sockaddr of src_addr_len bytes, the control data are the cmsgs of recvmsg().
+    struct Datagram {
+        const void *src_addr;
+        unsigned src_addr_len;
+        const void *control;
+        unsigned control_len;
+        char *data;
+        unsigned len;
+    };
+    typedef std::function<void(const Datagram &)> datagram_callback_t;
+
+    // Returns false if there is no reactor backend on this platform, in
+    // which case connections have to fall back to their own threads.
+    static bool is_supported();
+
+    // The callback is called from the reactor thread whenever fd is readable.
+    bool add_fd(int fd, readable_callback_t callback);
+
+    // The callback is called from the reactor thread with every datagram which
+    // arrives on fd. Only io_uring receives them itself, otherwise this returns
+    // false and add_fd() is to be used instead.
+    bool add_datagram_fd(int fd, datagram_callback_t callback);
+
+    bool uses_io_uring() const;
+
+    // Once this returns, the callback for fd is not running and will not be
+    // called again. It is also safe to call this from within the callback.
+    void remove_fd(int fd);
+
+    // Non-copyable
+    IoReactor(const IoReactor &) = delete;
+    const IoReactor &operator=(const IoReactor &) = delete;
+
+private:
+    struct Entry {
+        readable_callback_t readable;
+        datagram_callback_t datagram;
+        // Tells completions for an fd which was removed and added again apart.
+        uint32_t generation;
+    };
+
+    void run();
+    void wake_up();
+    void drain_wake_up();
+
+    int _poll_fd = -1;
+    int _wake_up_fds[2] = {-1, -1};
+
+    std::mutex _callbacks_mutex {};
+    // Shared with the reactor thread while it runs the callback.
+    std::map<int, std::shared_ptr<Entry>> _callbacks {};
+
+#if defined(DRONECORE_IO_URING)
+    bool add_to_io_uring(int fd, readable_callback_t readable, datagram_callback_t datagram);
+    // Another receive or poll for the entry, submitted right away unless it
+    // is the reactor thread, which submits when it waits next.
+    bool arm(int fd, const Entry &entry);
+    // We assume that _submit_mutex is held.
+    bool arm_locked(int fd, const Entry &entry);
+    void run_io_uring();
+    void handle_completion(const io_uring_cqe &cqe);
+
+    std::unique_ptr<IoUring> _uring {};
+    // Serializes the submissions, of the reactor thread and of add and remove.
+    // Taken before _callbacks_mutex when both are needed.
+    std::mutex _submit_mutex {};
+    uint32_t _next_generation = 1;
+#endif
+
+    // Held while a callback is run so that remove_fd() can wait for it.
+    std::mutex _dispatch_mutex {};
+
+    std::thread *_thread = nullptr;
+    std::atomic_bool _should_exit {false};
+};
+
+} // namespace dronecore
@@ -0,0 +1,200 @@
+#include "io_reactor.h"
+#include "global_include.h"
+#include <gtest/gtest.h>
+#include <atomic>
+
+#ifndef WINDOWS
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+#endif
+
+using namespace dronecore;
+
+#ifndef WINDOWS
+TEST(IoReactor, CallsBackWhenReadable)
+{
+    if (!IoReactor::is_supported()) {
+        return;
+    }
+
+    IoReactor reactor;
+
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+
+    std::atomic<int> num_called {0};
+    EXPECT_TRUE(reactor.add_fd(fds[0], [&num_called, &fds]() {
+        char buffer[8];
+        if (read(fds[0], buffer, sizeof(buffer)) > 0) {
+            ++num_called;
+        }
+    }));
+
+    const char dummy = 42;
+    EXPECT_EQ(write(fds[1], &dummy, 1), 1);
+
+    for (int i = 0; i < 100 && num_called == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(num_called, 1);
+
+    reactor.remove_fd(fds[0]);
+
+    // After removing, we should not get called anymore.
+    EXPECT_EQ(write(fds[1], &dummy, 1), 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(num_called, 1);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(IoReactor, RemoveUnknownFd)
+{
+    IoReactor reactor;
+    // Should not block or crash.
+    reactor.remove_fd(1234);
+}
+TEST(IoReactor, ReceivesDatagrams)
+{
+    IoReactor reactor;
+
+    const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(fd, 0);
+    struct sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)), 0);
+    socklen_t addr_len = sizeof(addr);
+    ASSERT_EQ(getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &addr_len), 0);
+
+    std::mutex mutex;
+    std::vector<std::string> received;
+    std::vector<uint16_t> src_ports;
+    auto callback = [&](const IoReactor::Datagram &datagram) {
+        struct sockaddr_in src {};
+        ASSERT_GE(datagram.src_addr_len, sizeof(src));
+        memcpy(&src, datagram.src_addr, sizeof(src));
+        std::lock_guard<std::mutex> lock(mutex);
+        received.push_back(std::string(datagram.data, datagram.len));
+        src_ports.push_back(ntohs(src.sin_port));
+    };
+    const bool added = reactor.add_datagram_fd(fd, callback);
+
+    // Only io_uring receives datagrams itself.
+    EXPECT_EQ(added, reactor.uses_io_uring());
+    if (!added) {
+        close(fd);
+        return;
+    }
+
+    const int sender = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(sender, 0);
+    struct sockaddr_in sender_addr {};
+
+    // More than there are buffers, in rounds which fit into the socket.
+    const unsigned num_datagrams = 1000;
+    const unsigned num_per_round = 100;
+    for (unsigned round = 0; round < num_datagrams / num_per_round; ++round) {
+        for (unsigned i = round * num_per_round; i < (round + 1) * num_per_round; ++i) {
+            const std::string text = "datagram " + std::to_string(i);
+            EXPECT_EQ(sendto(sender, text.data(), text.size(), 0,
+                             reinterpret_cast<sockaddr *>(&addr), sizeof(addr)),
+                      ssize_t(text.size()));
+        }
+
+        for (int i = 0; i < 100; ++i) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (received.size() == (round + 1) * num_per_round) {
+                    break;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+    socklen_t sender_addr_len = sizeof(sender_addr);
+    getsockname(sender, reinterpret_cast<sockaddr *>(&sender_addr), &sender_addr_len);
+
+    reactor.remove_fd(fd);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ASSERT_EQ(received.size(), num_datagrams);
+        EXPECT_EQ(received.front(), "datagram 0");
+        EXPECT_EQ(received.back(), "datagram " + std::to_string(num_datagrams - 1));
+        EXPECT_EQ(src_ports.front(), ntohs(sender_addr.sin_port));
+    }
+
+    close(sender);
+    close(fd);
+}
+
+#if defined(LINUX)
+TEST(IoReactor, PassesKernelTimestamps)
+{
+    IoReactor reactor;
+    if (!reactor.uses_io_uring()) {
+        return;
+    }
+
+    const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(fd, 0);
+    const int enable = 1;
+    ASSERT_EQ(setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)), 0);
+    struct sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)), 0);
+    socklen_t addr_len = sizeof(addr);
+    ASSERT_EQ(getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &addr_len), 0);
+
+    std::atomic<int64_t> stamp_ns {0};
+    ASSERT_TRUE(reactor.add_datagram_fd(fd, [&stamp_ns](const IoReactor::Datagram & datagram) {
+        struct msghdr header {};
+        header.msg_control = const_cast<void *>(datagram.control);
+        header.msg_controllen = datagram.control_len;
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&header); cmsg;
+             cmsg = CMSG_NXTHDR(&header, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+                struct timespec stamp;
+                memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+                stamp_ns = int64_t(stamp.tv_sec) * 1000000000 + stamp.tv_nsec;
+            }
+        }
+    }));
+
+    const int sender = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(sender, 0);
+    const int64_t sent_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::system_clock::now().time_since_epoch()).count();
+    EXPECT_EQ(sendto(sender, "stamped", 7, 0, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)),
+              7);
+    for (int i = 0; i < 100 && stamp_ns == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    reactor.remove_fd(fd);
+
+    // Stamped on the way in, well before it is looked at.
+    EXPECT_GE(stamp_ns, sent_ns);
+    EXPECT_LT(stamp_ns, sent_ns + 1000000000);
+
+    close(sender);
+    close(fd);
+}
+#endif
+
+TEST(IoReactor, FallsBackToEpollIfAskedTo)
+{
+    setenv("DRONECORE_IO_BACKEND", "epoll", 1);
+    IoReactor reactor;
+    unsetenv("DRONECORE_IO_BACKEND");
+    EXPECT_FALSE(reactor.uses_io_uring());
+}
+#endif
@@ -0,0 +1,334 @@
+#include "io_uring.h"
+
+#if defined(DRONECORE_IO_URING)
+
+#include "log.h"
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace dronecore {
+
+constexpr uint16_t IoUring::BUFFER_GROUP;
+constexpr unsigned IoUring::CONTROL_LEN;
+
+namespace {
+
+int io_uring_setup(unsigned num_entries, io_uring_params &params)
+{
+    return int(syscall(__NR_io_uring_setup, num_entries, &params));
+}
+
+int io_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return int(syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags,
+                       nullptr, 0));
+}
+
+int io_uring_register(int ring_fd, unsigned opcode, void *arg, unsigned num_args)
+{
+    return int(syscall(__NR_io_uring_register, ring_fd, opcode, arg, num_args));
+}
+
+// The kernel reads and writes the rings at the same time as we do.
+unsigned load_acquire(const unsigned *p)
+{
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+void store_release(unsigned *p, unsigned value)
+{
+    __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+template<typename T>
+T *at_offset(void *base, unsigned offset)
+{
+    return reinterpret_cast<T *>(static_cast<char *>(base) + offset);
+}
+
+} // namespace
+
+IoUring::IoUring() {}
+
+IoUring::~IoUring()
+{
+    close_ring();
+}
+
+bool IoUring::has_multishot()
+{
+    // Multishot receives came with Linux 6.0, as did this flag, which is
+    // easier to test for.
+    io_uring_params params {};
+    params.flags = IORING_SETUP_SINGLE_ISSUER;
+    const int fd = io_uring_setup(1, params);
+    if (fd < 0) {
+        return false;
+    }
+    close(fd);
+    return true;
+}
+
+bool IoUring::init(unsigned num_entries, unsigned num_buffers, unsigned buffer_len)
+{
+    if (!has_multishot()) {
+        LogInfo() << "io_uring not available or older than Linux 6.0";
+        return false;
+    }
+
+    io_uring_params params {};
+    _ring_fd = io_uring_setup(num_entries, params);
+    if (_ring_fd < 0) {
+        LogWarn() << "Could not set up io_uring: " << strerror(errno);
+        return false;
+    }
+
+    // Both rings are in one mapping since Linux 5.4, which is long before 6.0.
+    const size_t sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    const size_t cq_len = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    _ring_len = (sq_len > cq_len) ? sq_len : cq_len;
+    _ring = mmap(nullptr, _ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                 _ring_fd, IORING_OFF_SQ_RING);
+    if (_ring == MAP_FAILED) {
+        LogWarn() << "Could not map io_uring: " << strerror(errno);
+        _ring = nullptr;
+        close_ring();
+        return false;
+    }
+
+    _sqes_len = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = mmap(nullptr, _sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      _ring_fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        LogWarn() << "Could not map io_uring entries: " << strerror(errno);
+        close_ring();
+        return false;
+    }
+    _sqes = static_cast<io_uring_sqe *>(sqes);
+
+    _sq_head = at_offset<unsigned>(_ring, params.sq_off.head);
+    _sq_tail = at_offset<unsigned>(_ring, params.sq_off.tail);
+    _sq_mask = *at_offset<unsigned>(_ring, params.sq_off.ring_mask);
+    _sq_entries = params.sq_entries;
+    _sqe_tail = *_sq_tail;
+    // Entries and slots always match, so this is only done once.
+    unsigned *sq_array = at_offset<unsigned>(_ring, params.sq_off.array);
+    for (unsigned i = 0; i < _sq_entries; ++i) {
+        sq_array[i] = i;
+    }
+
+    _cq_head = at_offset<unsigned>(_ring, params.cq_off.head);
+    _cq_tail = at_offset<unsigned>(_ring, params.cq_off.tail);
+    _cq_mask = *at_offset<unsigned>(_ring, params.cq_off.ring_mask);
+    _cqes = at_offset<io_uring_cqe>(_ring, params.cq_off.cqes);
+
+    if (!setup_buffers(num_buffers, buffer_len)) {
+        close_ring();
+        return false;
+    }
+
+    _recvmsg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+    _recvmsg_hdr.msg_controllen = CONTROL_LEN;
+    return true;
+}
+
+bool IoUring::setup_buffers(unsigned num_buffers, unsigned buffer_len)
+{
+    // Needs to be a power of two.
+    _num_buffers = 1;
+    while (_num_buffers < num_buffers) {
+        _num_buffers *= 2;
+    }
+    _buffer_len = buffer_len;
+    _buffers.resize(size_t(_num_buffers) * _buffer_len);
+
+    _buf_ring_len = _num_buffers * sizeof(io_uring_buf);
+    void *buf_ring = mmap(nullptr, _buf_ring_len, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf_ring == MAP_FAILED) {
+        LogWarn() << "Could not map io_uring buffer ring: " << strerror(errno);
+        return false;
+    }
+    _buf_ring = static_cast<io_uring_buf_ring *>(buf_ring);
+
+    io_uring_buf_reg reg {};
+    reg.ring_addr = reinterpret_cast<uint64_t>(_buf_ring);
+    reg.ring_entries = _num_buffers;
+    reg.bgid = BUFFER_GROUP;
+    if (io_uring_register(_ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+        LogWarn() << "Could not register io_uring buffers: " << strerror(errno);
+        munmap(_buf_ring, _buf_ring_len);
+        _buf_ring = nullptr;
+        return false;
+    }
+
+    for (unsigned i = 0; i < _num_buffers; ++i) {
+        io_uring_buf &buf = buf_slot(i);
+        buf.addr = reinterpret_cast<uint64_t>(&_buffers[size_t(i) * _buffer_len]);
+        buf.len = _buffer_len;
+        buf.bid = uint16_t(i);
+    }
+    __atomic_store_n(&_buf_ring->tail, uint16_t(_num_buffers), __ATOMIC_RELEASE);
+    return true;
+}
+
+io_uring_buf &IoUring::buf_slot(unsigned index)
+{
+    // Not with bufs[], the flexible array ends up after an empty struct which
+    // takes room in C++, unlike in C.
+    return reinterpret_cast<io_uring_buf *>(_buf_ring)[index];
+}
+
+void IoUring::close_ring()
+{
+    if (_buf_ring) {
+        io_uring_buf_reg reg {};
+        reg.bgid = BUFFER_GROUP;
+        io_uring_register(_ring_fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    }
+    // Closing the ring cancels whatever is still in flight.
+    if (_ring_fd >= 0) {
+        close(_ring_fd);
+        _ring_fd = -1;
+    }
+    if (_buf_ring) {
+        munmap(_buf_ring, _buf_ring_len);
+        _buf_ring = nullptr;
+    }
+    if (_sqes) {
+        munmap(_sqes, _sqes_len);
+        _sqes = nullptr;
+    }
+    if (_ring) {
+        munmap(_ring, _ring_len);
+        _ring = nullptr;
+    }
+}
+
+io_uring_sqe *IoUring::get_sqe()
+{
+    if (_sqe_tail - load_acquire(_sq_head) >= _sq_entries) {
+        return nullptr;
+    }
+    io_uring_sqe *sqe = &_sqes[_sqe_tail & _sq_mask];
+    ++_sqe_tail;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+void IoUring::publish()
+{
+    store_release(_sq_tail, _sqe_tail);
+}
+
+bool IoUring::enter(unsigned min_complete, unsigned flags)
+{
+    // The kernel takes what has been published, however many that is, so
+    // there is no need to count what is still to be submitted.
+    while (true) {
+        const int ret = io_uring_enter(_ring_fd, _sq_entries, min_complete, flags);
+        if (ret >= 0) {
+            return true;
+        }
+        if (errno == EINTR) {
+            // A signal while waiting, the caller looks for completions anyway.
+            return min_complete > 0;
+        }
+        if (errno != EAGAIN && errno != EBUSY) {
+            LogErr() << "io_uring_enter failed: " << strerror(errno);
+            return false;
+        }
+    }
+}
+
+bool IoUring::submit()
+{
+    publish();
+    return enter(0, 0);
+}
+
+bool IoUring::wait()
+{
+    return enter(1, IORING_ENTER_GETEVENTS);
+}
+
+bool IoUring::pop_cqe(io_uring_cqe &cqe)
+{
+    // Only the thread taking the completions writes the head.
+    const unsigned head = *_cq_head;
+    if (head == load_acquire(_cq_tail)) {
+        return false;
+    }
+    cqe = _cqes[head & _cq_mask];
+    store_release(_cq_head, head + 1);
+    return true;
+}
+
+void IoUring::prep_recvmsg_multishot(io_uring_sqe &sqe, int fd)
+{
+    sqe.opcode = IORING_OP_RECVMSG;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uint64_t>(&_recvmsg_hdr);
+    sqe.len = 1;
+    sqe.ioprio = IORING_RECV_MULTISHOT;
+    sqe.flags = IOSQE_BUFFER_SELECT;
+    sqe.buf_group = BUFFER_GROUP;
+}
+
+bool IoUring::get_datagram(const io_uring_cqe &cqe, const void *&src_addr,
+                           unsigned &src_addr_len, const void *&control, unsigned &control_len,
+                           char *&data, unsigned &len)
+{
+    if (cqe.res <= 0 || !(cqe.flags & IORING_CQE_F_BUFFER)) {
+        return false;
+    }
+
+    // The buffer starts with what recvmsg() returns in the message header,
+    // then the address, the control data and then the payload.
+    char *buffer = &_buffers[size_t(cqe.flags >> IORING_CQE_BUFFER_SHIFT) * _buffer_len];
+    io_uring_recvmsg_out out;
+    memcpy(&out, buffer, sizeof(out));
+
+    const size_t header_len = sizeof(out) + _recvmsg_hdr.msg_namelen + _recvmsg_hdr.msg_controllen;
+    if (size_t(cqe.res) < header_len) {
+        return false;
+    }
+    // Cut to the buffer, the parser must not take the rest for a whole one.
+    if (out.flags & MSG_TRUNC) {
+        LogWarn() << "Dropping datagram longer than the io_uring buffer";
+        return false;
+    }
+
+    src_addr = buffer + sizeof(out);
+    src_addr_len = (out.namelen < _recvmsg_hdr.msg_namelen) ? out.namelen :
+                   unsigned(_recvmsg_hdr.msg_namelen);
+    control = buffer + sizeof(out) + _recvmsg_hdr.msg_namelen;
+    control_len = (out.controllen < _recvmsg_hdr.msg_controllen) ? out.controllen :
+                  unsigned(_recvmsg_hdr.msg_controllen);
+    data = buffer + header_len;
+    len = unsigned(size_t(cqe.res) - header_len);
+    return true;
+}
+
+void IoUring::recycle_buffer(const io_uring_cqe &cqe)
+{
+    if (!(cqe.flags & IORING_CQE_F_BUFFER)) {
+        return;
+    }
+
+    const uint16_t bid = uint16_t(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+    // Only the thread taking the completions writes the tail.
+    const uint16_t tail = _buf_ring->tail;
+    io_uring_buf &buf = buf_slot(tail & (_num_buffers - 1));
+    buf.addr = reinterpret_cast<uint64_t>(&_buffers[size_t(bid) * _buffer_len]);
+    buf.len = _buffer_len;
+    buf.bid = bid;
+    __atomic_store_n(&_buf_ring->tail, uint16_t(tail + 1), __ATOMIC_RELEASE);
+}
+
+} // namespace dronecore
+
+#endif
@@ -0,0 +1,97 @@
+#pragma once
+
+#if defined(DRONECORE_IO_URING)
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+#include <time.h>
+
+namespace dronecore {
+
+// A submission and completion ring of io_uring, set up with the raw system
+// calls so that no library is needed, and a ring of buffers which the kernel
+// picks from for received datagrams.
+//
+// Submissions may come from any thread as long as the caller serializes them,
+// completions are only to be taken by one thread.
+class IoUring
+{
+public:
+    IoUring();
+    ~IoUring();
+
+    // Returns false if io_uring is not there or too old (before Linux 6.0, as
+    // multishot receives are needed), or if it is forbidden e.g. by seccomp.
+    bool init(unsigned num_entries, unsigned num_buffers, unsigned buffer_len);
+
+    // nullptr if the ring is full. The entry is zeroed, and only seen by the
+    // kernel once it is published.
+    io_uring_sqe *get_sqe();
+    void publish();
+    // Publishes and submits right away.
+    bool submit();
+    // Submits what has been published and waits until there is at least one
+    // completion. This needs no serializing with the submissions.
+    bool wait();
+    // Takes the next completion if there is one.
+    bool pop_cqe(io_uring_cqe &cqe);
+
+    // Fills in a receive which keeps posting a completion for each datagram,
+    // into one of the buffers, until it is cancelled or runs out of buffers.
+    void prep_recvmsg_multishot(io_uring_sqe &sqe, int fd);
+    // The datagram of a completion of the receive above, false if it has none.
+    bool get_datagram(const io_uring_cqe &cqe, const void *&src_addr, unsigned &src_addr_len,
+                      const void *&control, unsigned &control_len, char *&data, unsigned &len);
+    // Gives the buffer of the completion back, once the datagram is handled.
+    void recycle_buffer(const io_uring_cqe &cqe);
+
+    static constexpr uint16_t BUFFER_GROUP = 0;
+    // Room for the control data of a receive, enough for a kernel timestamp.
+    static constexpr unsigned CONTROL_LEN = CMSG_SPACE(sizeof(struct timespec));
+
+    // Non-copyable
+    IoUring(const IoUring &) = delete;
+    const IoUring &operator=(const IoUring &) = delete;
+
+private:
+    static bool has_multishot();
+    bool setup_buffers(unsigned num_buffers, unsigned buffer_len);
+    io_uring_buf &buf_slot(unsigned index);
+    bool enter(unsigned min_complete, unsigned flags);
+    void close_ring();
+
+    int _ring_fd = -1;
+
+    void *_ring = nullptr;
+    size_t _ring_len = 0;
+    io_uring_sqe *_sqes = nullptr;
+    size_t _sqes_len = 0;
+
+    unsigned *_sq_head = nullptr;
+    unsigned *_sq_tail = nullptr;
+    unsigned _sq_mask = 0;
+    unsigned _sq_entries = 0;
+    // Tail of the entries handed out by get_sqe(), ahead of _sq_tail until submit().
+    unsigned _sqe_tail = 0;
+
+    unsigned *_cq_head = nullptr;
+    unsigned *_cq_tail = nullptr;
+    unsigned _cq_mask = 0;
+    io_uring_cqe *_cqes = nullptr;
+
+    io_uring_buf_ring *_buf_ring = nullptr;
+    size_t _buf_ring_len = 0;
+    std::vector<char> _buffers {};
+    unsigned _num_buffers = 0;
+    unsigned _buffer_len = 0;
+
+    // The same for all receives: room for any address and a timestamp.
+    struct msghdr _recvmsg_hdr {};
+};
+
+} // namespace dronecore
+
+#endif
@@ -0,0 +1,66 @@
+#include "link_health.h"
+#include <algorithm>
+
+namespace dronecore {
+
+constexpr double LinkHealth::SMOOTHING;
+constexpr double LinkHealth::DELAY_SCALE_S;
+constexpr double LinkHealth::STALE_S;
+constexpr unsigned LinkHealth::RADIO_TIMEOUT_UPDATES;
+constexpr double LinkHealth::GOOD_RADIO_MARGIN;
+constexpr double LinkHealth::MIN_RADIO_FACTOR;
+constexpr uint8_t LinkHealth::CONGESTED_TXBUF;
+
+LinkHealth::LinkHealth() {}
+
+LinkHealth::~LinkHealth() {}
+
+void LinkHealth::update(const Counters &counters)
+{
+    const uint64_t num_messages = counters.num_messages - _last.num_messages;
+    const uint64_t num_lost = counters.num_lost - _last.num_lost;
+    const double delay_s = counters.delay_s - _last.delay_s;
+    _last = counters;
+
+    // Without anything in the interval, the last values are kept.
+    if (num_messages + num_lost > 0) {
+        const double loss = double(num_lost) / double(num_messages + num_lost);
+        _loss += SMOOTHING * (loss - _loss);
+
+        // What came first on this link was not late at all, only the
+        // duplicates add to the delay.
+        const double mean_delay_s = (num_messages > 0) ?
+                                    delay_s / double(num_messages) : 0.0;
+        _delay_s += SMOOTHING * (std::max(mean_delay_s, 0.0) - _delay_s);
+    }
+
+    double radio_factor = 1.0;
+    const unsigned updates_since_radio_status =
+        _updates_since_radio_status.load(std::memory_order_relaxed);
+    if (updates_since_radio_status < RADIO_TIMEOUT_UPDATES) {
+        radio_factor = _radio_factor.load(std::memory_order_relaxed);
+        _updates_since_radio_status.store(updates_since_radio_status + 1,
+                                          std::memory_order_relaxed);
+    }
+
+    double score = (1.0 - _loss) / (1.0 + _delay_s / DELAY_SCALE_S) * radio_factor;
+    if (counters.since_received_s >= STALE_S) {
+        score = 0.0;
+    }
+    _score.store(float(score), std::memory_order_relaxed);
+}
+
+void LinkHealth::add_radio_status(uint8_t rssi, uint8_t remrssi, uint8_t noise,
+                                  uint8_t remnoise, uint8_t txbuf)
+{
+    const double margin = std::min(double(rssi) - double(noise),
+                                   double(remrssi) - double(remnoise));
+    double factor = std::min(std::max(margin / GOOD_RADIO_MARGIN, MIN_RADIO_FACTOR), 1.0);
+    if (txbuf < CONGESTED_TXBUF) {
+        factor *= 0.5;
+    }
+    _radio_factor.store(float(factor), std::memory_order_relaxed);
+    _updates_since_radio_status.store(0, std::memory_order_relaxed);
+}
+
+} // namespace dronecore
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace dronecore {
+
+// How well a link currently works, as a score between 0 and 1 which the
+// routing can compare between links to the same system.
+//
+// update() is called once per heartbeat interval with the counters of the
+// link. The part of the messages lost in that interval and how much later
+// than on another link they came are smoothed, and the score is then
+//
+//     (1 - loss) / (1 + delay_s / DELAY_SCALE_S) * radio
+//
+// where radio comes from the last RADIO_STATUS, if one came on this link
+// within RADIO_TIMEOUT_UPDATES updates: the lower of the local and remote
+// margin between signal and noise compared to GOOD_RADIO_MARGIN, at least
+// MIN_RADIO_FACTOR, and halved if the radio's transmit buffer is below
+// CONGESTED_TXBUF percent. A link which has not received anything for
+// STALE_S scores 0.
+//
+// add_radio_status() and score() can be called from any thread.
+class LinkHealth
+{
+public:
+    LinkHealth();
+    ~LinkHealth();
+
+    struct Counters {
+        uint64_t num_messages;
+        uint64_t num_lost;
+        // Summed up over the messages which came on another link first.
+        double delay_s;
+        double since_received_s;
+    };
+    void update(const Counters &counters);
+
+    void add_radio_status(uint8_t rssi, uint8_t remrssi, uint8_t noise, uint8_t remnoise,
+                          uint8_t txbuf);
+
+    float score() const { return _score.load(std::memory_order_relaxed); }
+
+    static constexpr double SMOOTHING = 0.3;
+    static constexpr double DELAY_SCALE_S = 0.2;
+    static constexpr double STALE_S = 2.0;
+    static constexpr unsigned RADIO_TIMEOUT_UPDATES = 5;
+    static constexpr double GOOD_RADIO_MARGIN = 40.0;
+    static constexpr double MIN_RADIO_FACTOR = 0.1;
+    static constexpr uint8_t CONGESTED_TXBUF = 50;
+
+    // Non-copyable
+    LinkHealth(const LinkHealth &) = delete;
+    const LinkHealth &operator=(const LinkHealth &) = delete;
+
+private:
+    // Links are taken as working well until shown otherwise.
+    std::atomic<float> _score {1.0f};
+    std::atomic<float> _radio_factor {1.0f};
+    std::atomic<unsigned> _updates_since_radio_status {RADIO_TIMEOUT_UPDATES};
+
+    // Only used by update().
+    Counters _last {};
+    double _loss = 0.0;
+    double _delay_s = 0.0;
+};
+
+} // namespace dronecore
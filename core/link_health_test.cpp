@@ -0,0 +1,72 @@
+#include "link_health.h"
+#include <gtest/gtest.h>
+
+using namespace dronecore;
+
+TEST(LinkHealth, FollowsLossAndDelay)
+{
+    LinkHealth good;
+    LinkHealth lossy;
+    LinkHealth late;
+    EXPECT_FLOAT_EQ(good.score(), 1.0f);
+
+    for (uint64_t i = 1; i <= 20; ++i) {
+        good.update(LinkHealth::Counters {i * 100, 0, 0.0, 0.1});
+        // A third of the messages missing.
+        lossy.update(LinkHealth::Counters {i * 100, i * 50, 0.0, 0.1});
+        // All of them coming 200 ms after the other link.
+        late.update(LinkHealth::Counters {i * 100, 0, double(i) * 100 * 0.2, 0.1});
+    }
+    EXPECT_FLOAT_EQ(good.score(), 1.0f);
+    EXPECT_NEAR(lossy.score(), 2.0 / 3.0, 1e-3);
+    EXPECT_NEAR(late.score(), 0.5, 1e-3);
+
+    // Recovers once the loss stops.
+    for (uint64_t i = 21; i <= 40; ++i) {
+        lossy.update(LinkHealth::Counters {i * 100, 1000, 0.0, 0.1});
+    }
+    EXPECT_NEAR(lossy.score(), 1.0, 1e-3);
+}
+
+TEST(LinkHealth, ScoresZeroWhenQuiet)
+{
+    LinkHealth health;
+    health.update(LinkHealth::Counters {100, 0, 0.0, 0.1});
+    EXPECT_FLOAT_EQ(health.score(), 1.0f);
+
+    // Nothing new, but the last values count until the link is stale.
+    health.update(LinkHealth::Counters {100, 0, 0.0, 1.0});
+    EXPECT_FLOAT_EQ(health.score(), 1.0f);
+    health.update(LinkHealth::Counters {100, 0, 0.0, LinkHealth::STALE_S});
+    EXPECT_FLOAT_EQ(health.score(), 0.0f);
+
+    health.update(LinkHealth::Counters {200, 0, 0.0, 0.0});
+    EXPECT_FLOAT_EQ(health.score(), 1.0f);
+}
+
+TEST(LinkHealth, UsesRadioStatusWhileItComes)
+{
+    LinkHealth health;
+
+    // A margin of 20 between signal and noise on the remote side.
+    health.add_radio_status(200, 120, 60, 100, 100);
+    health.update(LinkHealth::Counters {100, 0, 0.0, 0.1});
+    EXPECT_NEAR(health.score(), 0.5, 1e-6);
+
+    // And the transmit buffer filling up.
+    health.add_radio_status(200, 200, 60, 60, LinkHealth::CONGESTED_TXBUF - 1);
+    health.update(LinkHealth::Counters {200, 0, 0.0, 0.1});
+    EXPECT_NEAR(health.score(), 0.5, 1e-6);
+
+    // No margin at all.
+    health.add_radio_status(50, 50, 60, 60, 100);
+    health.update(LinkHealth::Counters {300, 0, 0.0, 0.1});
+    EXPECT_NEAR(health.score(), LinkHealth::MIN_RADIO_FACTOR, 1e-6);
+
+    // Once the radio stops reporting, e.g. as the link now goes through
+    // something without one, the status fades out.
+    for (unsigned i = 0; i < LinkHealth::RADIO_TIMEOUT_UPDATES; ++i) {
+        health.update(LinkHealth::Counters {400, 0, 0.0, 0.1});
+    }
+    EXPECT_FLOAT_EQ(health.score(), 1.0f);
+}
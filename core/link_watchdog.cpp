@@ -0,0 +1,155 @@
+#include "link_watchdog.h"
+#include <algorithm>
+#include <chrono>
+
+namespace dronecore {
+
+constexpr double LinkWatchdog::DEFAULT_DEGRADED_TIMEOUT_S;
+constexpr double LinkWatchdog::DEFAULT_LOST_TIMEOUT_S;
+
+namespace {
+
+int64_t ns_of_s(double duration_s)
+{
+    return int64_t(duration_s * 1e9);
+}
+
+} // namespace
+
+LinkWatchdog::LinkWatchdog(state_callback_t callback) :
+    _callback(std::move(callback)),
+    _degraded_timeout_ns(ns_of_s(DEFAULT_DEGRADED_TIMEOUT_S)),
+    _lost_timeout_ns(ns_of_s(DEFAULT_LOST_TIMEOUT_S))
+{}
+
+LinkWatchdog::~LinkWatchdog()
+{
+    TimerScheduler::timer_id_t timer_id;
+    TimerScheduler::timer_id_t started_timer_id;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _should_exit = true;
+        timer_id = _timer_id;
+        started_timer_id = _started_timer_id;
+        _timer_id = 0;
+        _started_timer_id = 0;
+    }
+    // Without _mutex, which a running check() takes. Once they return, neither
+    // can still run.
+    TimerScheduler::Instance().cancel(timer_id);
+    TimerScheduler::Instance().cancel(started_timer_id);
+}
+
+void LinkWatchdog::set_timeouts(double degraded_timeout_s, double lost_timeout_s)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _degraded_timeout_ns = ns_of_s(std::max(degraded_timeout_s, 0.0));
+    _lost_timeout_ns = std::max(ns_of_s(lost_timeout_s), _degraded_timeout_ns);
+
+    // The timer checks against the new timeouts right away.
+    if (_started.load()) {
+        schedule_locked(_time.steady_time());
+    }
+}
+
+void LinkWatchdog::received(dl_time_t time)
+{
+    _last_received_ns.store(to_ns(time), std::memory_order_relaxed);
+
+    // Most of the time the timer is set and only finds out later.
+    if (_state.load(std::memory_order_relaxed) == State::OK &&
+        _started.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    bool changed;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _started = true;
+        changed = update_locked(time);
+    }
+    if (changed) {
+        notify();
+    }
+}
+
+void LinkWatchdog::check()
+{
+    bool changed;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_should_exit) {
+            return;
+        }
+        changed = update_locked(_time.steady_time());
+    }
+    if (changed) {
+        notify();
+    }
+}
+
+bool LinkWatchdog::update_locked(dl_time_t now)
+{
+    // We assume that we already acquired _mutex in this function.
+
+    const int64_t last_received_ns = _last_received_ns.load(std::memory_order_relaxed);
+    const int64_t since_ns = to_ns(now) - last_received_ns;
+
+    State state;
+    int64_t next_deadline_ns = 0;
+    if (since_ns >= _lost_timeout_ns) {
+        // Nothing to wait for until the next message.
+        state = State::LOST;
+    } else if (since_ns >= _degraded_timeout_ns) {
+        state = State::DEGRADED;
+        next_deadline_ns = last_received_ns + _lost_timeout_ns;
+    } else {
+        state = State::OK;
+        next_deadline_ns = last_received_ns + _degraded_timeout_ns;
+    }
+
+    if (state != State::LOST) {
+        schedule_locked(dl_time_t(std::chrono::duration_cast<dl_time_t::duration>(
+                                      std::chrono::nanoseconds(next_deadline_ns))));
+    }
+
+    return _state.exchange(state) != state;
+}
+
+void LinkWatchdog::schedule_locked(dl_time_t deadline)
+{
+    // We assume that we already acquired _mutex in this function.
+
+    if (_should_exit) {
+        return;
+    }
+    // Without waiting, a check() which is running might be the caller, or wait
+    // for _mutex.
+    if (_timer_id != 0 && !TimerScheduler::Instance().cancel_if_pending(_timer_id)) {
+        // Only one runs at a time, so the one before is done by now.
+        _started_timer_id = _timer_id;
+    }
+    _timer_id = TimerScheduler::Instance().add(std::bind(&LinkWatchdog::check, this), deadline);
+}
+
+void LinkWatchdog::notify()
+{
+    // Whoever comes last reports the state it ended up in, so that a late
+    // thread can't report an older one.
+    std::lock_guard<std::mutex> lock(_notify_mutex);
+    const State state = _state.load();
+    if (state == _notified_state) {
+        return;
+    }
+    _notified_state = state;
+    if (_callback) {
+        _callback(state);
+    }
+}
+
+int64_t LinkWatchdog::to_ns(dl_time_t time)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+} // namespace dronecore
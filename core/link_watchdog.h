@@ -0,0 +1,82 @@
+#pragma once
+
+#include "global_include.h"
+#include "timer_scheduler.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+namespace dronecore {
+
+// Tells how long ago anything was received from a system, as a state which
+// goes to DEGRADED after the degraded timeout and to LOST after the lost
+// timeout, and back to OK with the next message.
+//
+// received() only stores the time, the timeouts are checked by a timer of
+// the TimerScheduler at the exact deadline, so the states change within a
+// millisecond and not only when the system does its periodic work. If
+// something came in meanwhile, the timer is set again for the new deadline.
+//
+// The callback is called for each change, from the thread which found it:
+// the receive thread for OK, the timer thread otherwise. Changes overlapping
+// on two threads are reported once, with the state they ended up in.
+class LinkWatchdog
+{
+public:
+    enum class State {
+        OK,
+        DEGRADED,
+        LOST
+    };
+    typedef std::function<void(State)> state_callback_t;
+
+    static constexpr double DEFAULT_DEGRADED_TIMEOUT_S = 1.0;
+    static constexpr double DEFAULT_LOST_TIMEOUT_S = 3.0;
+
+    explicit LinkWatchdog(state_callback_t callback);
+    ~LinkWatchdog();
+
+    // The lost timeout is at least the degraded timeout.
+    void set_timeouts(double degraded_timeout_s, double lost_timeout_s);
+
+    // The first one starts watching.
+    void received(dl_time_t time);
+
+    State state() const { return _state.load(std::memory_order_relaxed); }
+
+    // Non-copyable
+    LinkWatchdog(const LinkWatchdog &) = delete;
+    const LinkWatchdog &operator=(const LinkWatchdog &) = delete;
+
+private:
+    // Called by the timer.
+    void check();
+    // We assume that _mutex is held. Returns true if the state changed.
+    bool update_locked(dl_time_t now);
+    void schedule_locked(dl_time_t deadline);
+    void notify();
+
+    static int64_t to_ns(dl_time_t time);
+
+    const state_callback_t _callback;
+
+    std::atomic<int64_t> _last_received_ns {0};
+    std::atomic<State> _state {State::OK};
+    std::atomic<bool> _started {false};
+
+    Time _time {};
+
+    std::mutex _mutex {};
+    int64_t _degraded_timeout_ns;
+    int64_t _lost_timeout_ns;
+    TimerScheduler::timer_id_t _timer_id = 0;
+    // The one replaced after it had started, which might still be running.
+    TimerScheduler::timer_id_t _started_timer_id = 0;
+    bool _should_exit = false;
+
+    std::mutex _notify_mutex {};
+    State _notified_state = State::OK;
+};
+
+} // namespace dronecore
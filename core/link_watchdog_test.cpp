@@ -0,0 +1,49 @@
+#include "link_watchdog.h"
+#include "simulated_clock.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace dronecore;
+
+TEST(LinkWatchdog, ReportsDegradedAndLostAtTheDeadline)
+{
+    SimulatedClock::set_enabled(true);
+    Time time;
+
+    std::vector<std::pair<LinkWatchdog::State, double>> changes;
+    dl_time_t start = time.steady_time();
+    {
+        LinkWatchdog watchdog([&](LinkWatchdog::State state) {
+            changes.emplace_back(state, time.elapsed_since_s(start));
+        });
+        watchdog.set_timeouts(0.25, 0.6);
+
+        // Messages every 100 ms keep it OK, without a timer for each of them.
+        for (int i = 0; i < 10; ++i) {
+            watchdog.received(time.steady_time());
+            SimulatedClock::advance(0.1);
+        }
+        EXPECT_TRUE(changes.empty());
+
+        start = time.steady_time();
+        SimulatedClock::advance(1.0);
+        ASSERT_EQ(changes.size(), 2u);
+        EXPECT_EQ(changes[0].first, LinkWatchdog::State::DEGRADED);
+        // The last message was 100 ms before the start.
+        EXPECT_NEAR(changes[0].second, 0.15, 1e-3);
+        EXPECT_EQ(changes[1].first, LinkWatchdog::State::LOST);
+        EXPECT_NEAR(changes[1].second, 0.5, 1e-3);
+        EXPECT_EQ(watchdog.state(), LinkWatchdog::State::LOST);
+
+        watchdog.received(time.steady_time());
+        ASSERT_EQ(changes.size(), 3u);
+        EXPECT_EQ(changes[2].first, LinkWatchdog::State::OK);
+
+        // Nothing more once it is gone.
+        SimulatedClock::advance(0.2);
+    }
+    SimulatedClock::advance(1.0);
+    EXPECT_EQ(changes.size(), 3u);
+
+    SimulatedClock::set_enabled(false);
+}
@@ -0,0 +1,47 @@
+#include "local_projection.h"
+#include <cmath>
+
+namespace dronecore {
+
+constexpr double LocalProjection::EARTH_RADIUS_M;
+
+LocalProjection::LocalProjection(double reference_latitude_deg, double reference_longitude_deg) :
+    _reference_latitude_deg(reference_latitude_deg),
+    _reference_longitude_deg(reference_longitude_deg),
+    _m_per_deg_latitude(EARTH_RADIUS_M * M_PI / 180.0),
+    _m_per_deg_longitude(_m_per_deg_latitude * std::cos(reference_latitude_deg * M_PI / 180.0)),
+    _deg_per_m_latitude(1.0 / _m_per_deg_latitude),
+    _deg_per_m_longitude(1.0 / _m_per_deg_longitude)
+{
+}
+
+void LocalProjection::forward(const double *latitudes_deg, const double *longitudes_deg,
+                              size_t len, double *north_m, double *east_m) const
+{
+    // Copied, so that the compiler knows they don't change with the outputs.
+    const double reference_latitude_deg = _reference_latitude_deg;
+    const double reference_longitude_deg = _reference_longitude_deg;
+    const double m_per_deg_latitude = _m_per_deg_latitude;
+    const double m_per_deg_longitude = _m_per_deg_longitude;
+
+    for (size_t i = 0; i < len; ++i) {
+        north_m[i] = (latitudes_deg[i] - reference_latitude_deg) * m_per_deg_latitude;
+        east_m[i] = (longitudes_deg[i] - reference_longitude_deg) * m_per_deg_longitude;
+    }
+}
+
+void LocalProjection::inverse(const double *north_m, const double *east_m, size_t len,
+                              double *latitudes_deg, double *longitudes_deg) const
+{
+    const double reference_latitude_deg = _reference_latitude_deg;
+    const double reference_longitude_deg = _reference_longitude_deg;
+    const double deg_per_m_latitude = _deg_per_m_latitude;
+    const double deg_per_m_longitude = _deg_per_m_longitude;
+
+    for (size_t i = 0; i < len; ++i) {
+        latitudes_deg[i] = reference_latitude_deg + north_m[i] * deg_per_m_latitude;
+        longitudes_deg[i] = reference_longitude_deg + east_m[i] * deg_per_m_longitude;
+    }
+}
+
+} // namespace dronecore
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+
+namespace dronecore {
+
+// Converts between latitude and longitude and metres north and east of a
+// reference, on the plane tangent there. What depends on the reference, the
+// cosine of its latitude and the metres per degree, is computed once, so a
+// conversion is a subtraction and a multiplication per axis. That is accurate
+// enough within some tens of kilometres of the reference, but not across the
+// antimeridian or near a pole.
+//
+// The batch conversions take the axes in separate arrays and have no
+// dependencies between the iterations, so that the compiler vectorizes them.
+class LocalProjection
+{
+public:
+    static constexpr double EARTH_RADIUS_M = 6371000.0;
+
+    LocalProjection() : LocalProjection(0.0, 0.0) {}
+    LocalProjection(double reference_latitude_deg, double reference_longitude_deg);
+
+    double reference_latitude_deg() const { return _reference_latitude_deg; }
+    double reference_longitude_deg() const { return _reference_longitude_deg; }
+
+    double north_m(double latitude_deg) const
+    {
+        return (latitude_deg - _reference_latitude_deg) * _m_per_deg_latitude;
+    }
+
+    double east_m(double longitude_deg) const
+    {
+        return (longitude_deg - _reference_longitude_deg) * _m_per_deg_longitude;
+    }
+
+    double latitude_deg(double north_m) const
+    {
+        return _reference_latitude_deg + north_m * _deg_per_m_latitude;
+    }
+
+    double longitude_deg(double east_m) const
+    {
+        return _reference_longitude_deg + east_m * _deg_per_m_longitude;
+    }
+
+    void forward(const double *latitudes_deg, const double *longitudes_deg, size_t len,
+                 double *north_m, double *east_m) const;
+    void inverse(const double *north_m, const double *east_m, size_t len,
+                 double *latitudes_deg, double *longitudes_deg) const;
+
+private:
+    double _reference_latitude_deg;
+    double _reference_longitude_deg;
+    double _m_per_deg_latitude;
+    double _m_per_deg_longitude;
+    double _deg_per_m_latitude;
+    double _deg_per_m_longitude;
+};
+
+} // namespace dronecore
@@ -0,0 +1,54 @@
+#include "local_projection.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+
+using namespace dronecore;
+
+TEST(LocalProjection, ConvertsMetresOfDegrees)
+{
+    const LocalProjection projection(47.39, 8.54);
+
+    // One degree of latitude, and of longitude shortened by the latitude.
+    EXPECT_NEAR(projection.north_m(48.39), 111194.9, 0.1);
+    EXPECT_NEAR(projection.east_m(9.54), 111194.9 * std::cos(47.39 * M_PI / 180.0), 0.1);
+    EXPECT_DOUBLE_EQ(projection.north_m(47.39), 0.0);
+    EXPECT_DOUBLE_EQ(projection.east_m(8.54), 0.0);
+}
+
+TEST(LocalProjection, ConvertsBack)
+{
+    const LocalProjection projection(-33.86, 151.21);
+
+    EXPECT_NEAR(projection.latitude_deg(projection.north_m(-33.87)), -33.87, 1e-12);
+    EXPECT_NEAR(projection.longitude_deg(projection.east_m(151.2)), 151.2, 1e-12);
+}
+
+TEST(LocalProjection, ConvertsBatchesLikeSingles)
+{
+    const LocalProjection projection(47.39, 8.54);
+
+    std::vector<double> latitudes_deg;
+    std::vector<double> longitudes_deg;
+    for (unsigned i = 0; i < 37; ++i) {
+        latitudes_deg.push_back(47.39 + 0.001 * i);
+        longitudes_deg.push_back(8.54 - 0.002 * i);
+    }
+
+    std::vector<double> north_m(latitudes_deg.size());
+    std::vector<double> east_m(latitudes_deg.size());
+    projection.forward(latitudes_deg.data(), longitudes_deg.data(), latitudes_deg.size(),
+                       north_m.data(), east_m.data());
+
+    std::vector<double> back_latitudes_deg(latitudes_deg.size());
+    std::vector<double> back_longitudes_deg(latitudes_deg.size());
+    projection.inverse(north_m.data(), east_m.data(), north_m.size(),
+                       back_latitudes_deg.data(), back_longitudes_deg.data());
+
+    for (size_t i = 0; i < latitudes_deg.size(); ++i) {
+        EXPECT_DOUBLE_EQ(north_m[i], projection.north_m(latitudes_deg[i]));
+        EXPECT_DOUBLE_EQ(east_m[i], projection.east_m(longitudes_deg[i]));
+        EXPECT_NEAR(back_latitudes_deg[i], latitudes_deg[i], 1e-12);
+        EXPECT_NEAR(back_longitudes_deg[i], longitudes_deg[i], 1e-12);
+    }
+}
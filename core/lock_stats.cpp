@@ -0,0 +1,133 @@
+#include "lock_stats.h"
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace dronecore {
+
+constexpr unsigned LockStats::NUM_BUCKETS;
+
+namespace {
+
+struct Registry {
+    std::mutex mutex {};
+    std::map<std::string, std::unique_ptr<LockStats>> stats {};
+};
+
+Registry &registry()
+{
+    // Never deleted, so that mutexes of static objects can use it in any order.
+    static Registry *registry = new Registry();
+    return *registry;
+}
+
+unsigned bucket_of(uint64_t ns)
+{
+    unsigned bucket = 0;
+    while (ns > 0 && bucket < LockStats::NUM_BUCKETS - 1) {
+        ns >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+// The upper bound of the bucket the given share of the waits is in.
+uint64_t percentile_ns(const LockStats::Summary &summary, double share)
+{
+    const uint64_t wanted = uint64_t(double(summary.num_locks) * share);
+    uint64_t count = 0;
+    for (unsigned i = 0; i < LockStats::NUM_BUCKETS; ++i) {
+        count += summary.wait_buckets[i];
+        if (count > wanted) {
+            return (i == 0) ? 0 : (uint64_t(1) << i);
+        }
+    }
+    return summary.max_wait_ns;
+}
+
+} // namespace
+
+LockStats &LockStats::get(const char *name)
+{
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    auto &stats = reg.stats[name];
+    if (!stats) {
+        stats.reset(new LockStats());
+    }
+    return *stats;
+}
+
+void LockStats::add_lock(bool is_contended, uint64_t wait_ns)
+{
+    _num_locks.fetch_add(1, std::memory_order_relaxed);
+    _wait_buckets[bucket_of(wait_ns)].fetch_add(1, std::memory_order_relaxed);
+
+    if (is_contended) {
+        _num_contended.fetch_add(1, std::memory_order_relaxed);
+        _total_wait_ns.fetch_add(wait_ns, std::memory_order_relaxed);
+        update_max(_max_wait_ns, wait_ns);
+    }
+}
+
+void LockStats::add_hold(uint64_t hold_ns)
+{
+    update_max(_max_hold_ns, hold_ns);
+}
+
+void LockStats::update_max(std::atomic<uint64_t> &max, uint64_t value)
+{
+    uint64_t current = max.load(std::memory_order_relaxed);
+    while (value > current &&
+           !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+std::vector<LockStats::Summary> LockStats::get_summaries()
+{
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    std::vector<Summary> summaries;
+    for (const auto &entry : reg.stats) {
+        const LockStats &stats = *entry.second;
+
+        Summary summary;
+        summary.name = entry.first;
+        summary.num_locks = stats._num_locks.load(std::memory_order_relaxed);
+        summary.num_contended = stats._num_contended.load(std::memory_order_relaxed);
+        summary.total_wait_ns = stats._total_wait_ns.load(std::memory_order_relaxed);
+        summary.max_wait_ns = stats._max_wait_ns.load(std::memory_order_relaxed);
+        summary.max_hold_ns = stats._max_hold_ns.load(std::memory_order_relaxed);
+        for (unsigned i = 0; i < NUM_BUCKETS; ++i) {
+            summary.wait_buckets[i] = stats._wait_buckets[i].load(std::memory_order_relaxed);
+        }
+        summaries.push_back(summary);
+    }
+    return summaries;
+}
+
+std::string LockStats::get_text()
+{
+    std::string text;
+    char line[256];
+
+    for (const auto &summary : get_summaries()) {
+        snprintf(line, sizeof(line),
+                 "%s: %llu locks, %llu contended, wait total %llu us, p50 < %llu ns, "
+                 "p99 < %llu ns, max %llu ns, hold max %llu ns\n",
+                 summary.name.c_str(),
+                 static_cast<unsigned long long>(summary.num_locks),
+                 static_cast<unsigned long long>(summary.num_contended),
+                 static_cast<unsigned long long>(summary.total_wait_ns / 1000),
+                 static_cast<unsigned long long>(percentile_ns(summary, 0.5)),
+                 static_cast<unsigned long long>(percentile_ns(summary, 0.99)),
+                 static_cast<unsigned long long>(summary.max_wait_ns),
+                 static_cast<unsigned long long>(summary.max_hold_ns));
+        text += line;
+    }
+    return text;
+}
+
+} // namespace dronecore
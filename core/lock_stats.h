@@ -0,0 +1,153 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Set to 1 to record how long the instrumented mutexes are waited for and
+// held, e.g. with cmake -DENABLE_LOCK_STATS=ON. The numbers are logged when
+// DroneCore is destroyed.
+#ifndef DRONECORE_LOCK_STATS
+#define DRONECORE_LOCK_STATS 0
+#endif
+
+namespace dronecore {
+
+// What is recorded for all mutexes with the same name, e.g. the ones of all
+// systems. Kept until the process exits.
+class LockStats
+{
+public:
+    // Bucket i counts waits below 2^i ns, and not below 2^(i-1) ns. The last
+    // one counts all the rest.
+    static constexpr unsigned NUM_BUCKETS = 32;
+
+    struct Summary {
+        std::string name;
+        uint64_t num_locks;
+        // Locks which had to wait because someone else held the mutex.
+        uint64_t num_contended;
+        uint64_t total_wait_ns;
+        uint64_t max_wait_ns;
+        uint64_t max_hold_ns;
+        std::array<uint64_t, NUM_BUCKETS> wait_buckets;
+    };
+
+    static LockStats &get(const char *name);
+
+    void add_lock(bool is_contended, uint64_t wait_ns);
+    void add_hold(uint64_t hold_ns);
+
+    // Of all names in alphabetical order.
+    static std::vector<Summary> get_summaries();
+
+    // A line for each name, with the common percentiles of the wait.
+    static std::string get_text();
+
+    // Non-copyable
+    LockStats(const LockStats &) = delete;
+    const LockStats &operator=(const LockStats &) = delete;
+
+private:
+    LockStats() {}
+
+    static void update_max(std::atomic<uint64_t> &max, uint64_t value);
+
+    std::atomic<uint64_t> _num_locks {0};
+    std::atomic<uint64_t> _num_contended {0};
+    std::atomic<uint64_t> _total_wait_ns {0};
+    std::atomic<uint64_t> _max_wait_ns {0};
+    std::atomic<uint64_t> _max_hold_ns {0};
+    std::array<std::atomic<uint64_t>, NUM_BUCKETS> _wait_buckets {};
+};
+
+// Records every lock into the LockStats of its name. Works for std::mutex
+// and std::recursive_mutex, only the outermost lock of a recursive mutex
+// counts as holding it.
+template <typename Mutex>
+class RecordingMutex
+{
+public:
+    explicit RecordingMutex(const char *name) : _stats(LockStats::get(name)) {}
+
+    void lock()
+    {
+        if (_mutex.try_lock()) {
+            _stats.add_lock(false, 0);
+        } else {
+            const clock::time_point start = clock::now();
+            _mutex.lock();
+            _stats.add_lock(true, to_ns(clock::now() - start));
+        }
+        start_holding();
+    }
+
+    bool try_lock()
+    {
+        if (!_mutex.try_lock()) {
+            return false;
+        }
+        _stats.add_lock(false, 0);
+        start_holding();
+        return true;
+    }
+
+    void unlock()
+    {
+        // Only the thread holding the mutex gets here.
+        if (--_depth == 0) {
+            _stats.add_hold(to_ns(clock::now() - _hold_start));
+        }
+        _mutex.unlock();
+    }
+
+    // Non-copyable
+    RecordingMutex(const RecordingMutex &) = delete;
+    const RecordingMutex &operator=(const RecordingMutex &) = delete;
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    static uint64_t to_ns(clock::duration duration)
+    {
+        return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    }
+
+    void start_holding()
+    {
+        if (_depth++ == 0) {
+            _hold_start = clock::now();
+        }
+    }
+
+    Mutex _mutex {};
+    LockStats &_stats;
+    // Only changed by the thread holding the mutex.
+    unsigned _depth = 0;
+    clock::time_point _hold_start {};
+};
+
+// Just the mutex, the name is only for when the stats are built in.
+template <typename Mutex>
+class NamedMutex : public Mutex
+{
+public:
+    explicit NamedMutex(const char *) {}
+};
+
+#if DRONECORE_LOCK_STATS
+template <typename Mutex>
+using InstrumentedMutex = RecordingMutex<Mutex>;
+#else
+template <typename Mutex>
+using InstrumentedMutex = NamedMutex<Mutex>;
+#endif
+
+typedef InstrumentedMutex<std::mutex> instrumented_mutex_t;
+typedef InstrumentedMutex<std::recursive_mutex> instrumented_recursive_mutex_t;
+
+} // namespace dronecore
@@ -0,0 +1,83 @@
+#include "lock_stats.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+using namespace dronecore;
+
+namespace {
+
+LockStats::Summary summary_of(const std::string &name)
+{
+    for (const auto &summary : LockStats::get_summaries()) {
+        if (summary.name == name) {
+            return summary;
+        }
+    }
+    return LockStats::Summary {name, 0, 0, 0, 0, 0, {}};
+}
+
+} // namespace
+
+TEST(LockStats, CountsLocksOfSameName)
+{
+    RecordingMutex<std::mutex> first("test_same_name");
+    RecordingMutex<std::mutex> second("test_same_name");
+
+    {
+        std::lock_guard<RecordingMutex<std::mutex>> lock(first);
+    }
+    {
+        std::lock_guard<RecordingMutex<std::mutex>> lock(second);
+    }
+    EXPECT_TRUE(first.try_lock());
+    first.unlock();
+
+    const auto summary = summary_of("test_same_name");
+    EXPECT_EQ(summary.num_locks, 3u);
+    EXPECT_EQ(summary.num_contended, 0u);
+    EXPECT_EQ(summary.wait_buckets[0], 3u);
+}
+
+TEST(LockStats, RecordsWaitAndHold)
+{
+    RecordingMutex<std::mutex> mutex("test_wait_and_hold");
+
+    std::atomic<bool> is_started {false};
+
+    mutex.lock();
+    std::thread thread([&mutex, &is_started]() {
+        is_started = true;
+        std::lock_guard<RecordingMutex<std::mutex>> lock(mutex);
+    });
+    while (!is_started) {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    mutex.unlock();
+    thread.join();
+
+    const auto summary = summary_of("test_wait_and_hold");
+    EXPECT_EQ(summary.num_locks, 2u);
+    EXPECT_EQ(summary.num_contended, 1u);
+    EXPECT_GE(summary.max_wait_ns, 10000000u);
+    EXPECT_GE(summary.max_hold_ns, 10000000u);
+    EXPECT_EQ(summary.total_wait_ns, summary.max_wait_ns);
+}
+
+TEST(LockStats, HoldsRecursiveMutexUntilOutermostUnlock)
+{
+    RecordingMutex<std::recursive_mutex> mutex("test_recursive");
+
+    mutex.lock();
+    mutex.lock();
+    mutex.unlock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    mutex.unlock();
+
+    const auto summary = summary_of("test_recursive");
+    EXPECT_EQ(summary.num_locks, 2u);
+    EXPECT_GE(summary.max_hold_ns, 10000000u);
+}
@@ -1,10 +1,9 @@
 #pragma once
 
 #include <sstream>
+#include "async_logger.h"
 
-#if ANDROID
-#include <android/log.h>
-#else
+#if !ANDROID
 #include <iostream>
 #include <ctime>
 #endif
@@ -23,29 +22,27 @@
 #define __FILENAME__  __FILE__
 #endif
 
-// For release builds, don't show debug printfs, and just discard it into the NullStream.
-class NullStream
-{
-public:
-    template<typename TPrintable>
-    NullStream &operator<<(TPrintable const &)
-    {
-        /* no-op */
-        static NullStream nothing;
-        return nothing;
-    }
-};
-
+// Levels below this are compiled out, including the arguments. By default,
+// that is debug for release builds.
+#ifndef DRONECORE_MIN_LOG_LEVEL
 #if DEBUG
-#define LogDebug() LogDebugDetailed(__FILENAME__, __LINE__)
+#define DRONECORE_MIN_LOG_LEVEL 0
 #else
-#define LogDebug() NullStream()
+#define DRONECORE_MIN_LOG_LEVEL 1
+#endif
 #endif
 
+// The arguments are only evaluated if the level is enabled. The else keeps
+// this one statement, also in an if without braces.
+#define DRONECORE_LOG(level, detailed) \
+    if (static_cast<int>(level) < DRONECORE_MIN_LOG_LEVEL || \
+        !::dronecore::AsyncLogger::is_enabled(level)) {} \
+    else ::dronecore::detailed(__FILENAME__, __LINE__)
 
-#define LogInfo() LogInfoDetailed(__FILENAME__, __LINE__)
-#define LogWarn() LogWarnDetailed(__FILENAME__, __LINE__)
-#define LogErr() LogErrDetailed(__FILENAME__, __LINE__)
+#define LogDebug() DRONECORE_LOG(::dronecore::LogLevel::Debug, LogDebugDetailed)
+#define LogInfo() DRONECORE_LOG(::dronecore::LogLevel::Info, LogInfoDetailed)
+#define LogWarn() DRONECORE_LOG(::dronecore::LogLevel::Warn, LogWarnDetailed)
+#define LogErr() DRONECORE_LOG(::dronecore::LogLevel::Err, LogErrDetailed)
 
 
 namespace dronecore {
@@ -67,81 +64,12 @@ public:
 
     virtual ~LogDetailed()
     {
-#if ANDROID
-        switch (_log_level) {
-            case LogLevel::Debug:
-                __android_log_print(ANDROID_LOG_DEBUG, "DroneCore", "%s", _s.str().c_str());
-                break;
-            case LogLevel::Info:
-                __android_log_print(ANDROID_LOG_INFO, "DroneCore", "%s", _s.str().c_str());
-                break;
-            case LogLevel::Warn:
-                __android_log_print(ANDROID_LOG_WARN, "DroneCore", "%s", _s.str().c_str());
-                break;
-            case LogLevel::Err:
-                __android_log_print(ANDROID_LOG_ERROR, "DroneCore", "%s", _s.str().c_str());
-                break;
-        }
-        // Unused:
-        (void)_caller_filename;
-        (void)_caller_filenumber;
-#else
-
-        switch (_log_level) {
-            case LogLevel::Debug:
-                std::cout << ANSI_COLOR_GREEN;
-                break;
-            case LogLevel::Info:
-                std::cout << ANSI_COLOR_BLUE;
-                break;
-            case LogLevel::Warn:
-                std::cout << ANSI_COLOR_YELLOW;
-                break;
-            case LogLevel::Err:
-                std::cout << ANSI_COLOR_RED;
-                break;
-        }
-
-        // Time output taken from:
-        // https://stackoverflow.com/questions/16357999#answer-16358264
-        time_t rawtime;
-        time(&rawtime);
-        struct tm *timeinfo = localtime(&rawtime);
-        char time_buffer[10] {}; // We need 8 characters + \0
-        strftime(time_buffer, sizeof(time_buffer), "%I:%M:%S", timeinfo);
-        std::cout << "[" << time_buffer;
-
-        switch (_log_level) {
-            case LogLevel::Debug:
-                std::cout << "|Debug] ";
-                break;
-            case LogLevel::Info:
-                std::cout << "|Info ] ";
-                break;
-            case LogLevel::Warn:
-                std::cout << "|Warn ] ";
-                break;
-            case LogLevel::Err:
-                std::cout << "|Error] ";
-                break;
-        }
-
-        std::cout << ANSI_COLOR_RESET;
-
-        std::cout << _s.str();
-        std::cout << " (" << _caller_filename << ":" << _caller_filenumber << ")";
-
-        std::cout << std::endl;
-#endif
+        // Formatted here, but written away from the caller's thread.
+        AsyncLogger::instance().log(_log_level, _caller_filename, _caller_filenumber, _s.str());
     }
 
 protected:
-    enum LogLevel {
-        Debug,
-        Info,
-        Warn,
-        Err
-    } _log_level;
+    LogLevel _log_level = LogLevel::Info;
 
 private:
     std::stringstream _s;
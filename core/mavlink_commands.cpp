@@ -1,21 +1,19 @@
 #include "mavlink_commands.h"
+#include "completion.h"
 #include "mavlink_system.h"
-#include <future>
+#include "trace_recorder.h"
+#include <iterator>
 #include <memory>
+#include <string>
 
 namespace dronecore {
 
-// TODO: Currently the mavlink command handling is made in a way to only
-//       process one command at any time. Therefore, the work state is global
-//       for this whole class.
-//       The limitation is made because:
-//       - We are not sure what exactly will happen if the commands are sent in parallel
-//         and what kind of edge cases we might run into.
-//       - The timeout handler only supports the (void *)this cookie and therefore only
-//         really supports one timeout per object. We could use (void *)this of the work
-//         item but it also seems a bit dodgy.
-//       - The queue used does not support going through and checking each and every
-//         item yet.
+constexpr size_t MAVLinkCommands::MAX_IN_FLIGHT;
+
+// Several commands can be in flight at the same time, as long as they go to a
+// different component or are a different command. Acks are matched using the
+// component which sent them and the command id. Commands with the same key are
+// sent one after the other in the order they were queued.
 
 MAVLinkCommands::MAVLinkCommands(MAVLinkSystem &parent) :
     _parent(parent)
@@ -34,71 +32,37 @@ MAVLinkCommands::~MAVLinkCommands()
 MAVLinkCommands::Result
 MAVLinkCommands::send_command(const MAVLinkCommands::CommandInt &command)
 {
-    struct PromiseResult {
-        Result result;
-        float progress;
-    };
-
-    // We wrap the async call with a promise and future.
-    std::shared_ptr<std::promise<PromiseResult>> prom =
-                                                  std::make_shared<std::promise<PromiseResult>>();
+    // We wrap the async call with a completion to wait for.
+    Completion<Result> completion;
 
     queue_command_async(command,
-    [prom](Result result, float progress) {
-        PromiseResult promise_result {};
-        promise_result.result = result;
-        promise_result.progress = progress;
-        prom->set_value(promise_result);
+    [&completion](Result result, float progress) {
+        if (result == Result::IN_PROGRESS) {
+            LogInfo() << "In progress: " << progress;
+            return;
+        }
+        completion.complete(result);
     });
 
-    std::future<PromiseResult> res = prom->get_future();
-    while (true) {
-        // Block now to wait for result.
-        res.wait();
-
-        PromiseResult promise_result = res.get();
-
-        if (promise_result.result == Result::IN_PROGRESS) {
-            LogInfo() << "In progress: " << promise_result.progress;
-            continue;
-        }
-        return promise_result.result;
-    }
+    return completion.wait();
 }
 
 MAVLinkCommands::Result
 MAVLinkCommands::send_command(const MAVLinkCommands::CommandLong &command)
 {
-    struct PromiseResult {
-        Result result;
-        float progress;
-    };
-
-    // We wrap the async call with a promise and future.
-    std::shared_ptr<std::promise<PromiseResult>> prom =
-                                                  std::make_shared<std::promise<PromiseResult>>();
+    // We wrap the async call with a completion to wait for.
+    Completion<Result> completion;
 
     queue_command_async(command,
-    [prom](Result result, float progress) {
-        PromiseResult promise_result {};
-        promise_result.result = result;
-        promise_result.progress = progress;
-        prom->set_value(promise_result);
+    [&completion](Result result, float progress) {
+        if (result == Result::IN_PROGRESS) {
+            LogInfo() << "In progress: " << progress;
+            return;
+        }
+        completion.complete(result);
     });
 
-    std::future<PromiseResult> res = prom->get_future();
-    while (true) {
-        // Block now to wait for result.
-        res.wait();
-
-        PromiseResult promise_result = res.get();
-
-        if (promise_result.result == Result::IN_PROGRESS) {
-            LogInfo() << "In progress: " << promise_result.progress;
-            continue;
-        }
-        return promise_result.result;
-    }
+    return completion.wait();
 }
 
 void
@@ -128,7 +92,8 @@ MAVLinkCommands::queue_command_async(const CommandInt &command,
 
     new_work.callback = callback;
     new_work.mavlink_command = command.command;
-    _work_queue.push_back(new_work);
+    new_work.target_component_id = command.target_component_id;
+    queue_work(std::move(new_work));
 }
 
 void
@@ -139,9 +104,16 @@ MAVLinkCommands::queue_command_async(const CommandLong &command,
     //  << (int)(command.target_system_id)<< ", " << (int)(command.target_component_id;
 
     Work new_work {};
+    pack_command(command, new_work);
+    new_work.callback = callback;
+    queue_work(std::move(new_work));
+}
+
+void MAVLinkCommands::pack_command(const CommandLong &command, Work &work)
+{
     mavlink_msg_command_long_pack(GCSClient::system_id,
                                   GCSClient::component_id,
-                                  &new_work.mavlink_message,
+                                  &work.mavlink_message,
                                   command.target_system_id,
                                   command.target_component_id,
                                   command.command,
@@ -154,199 +126,413 @@ MAVLinkCommands::queue_command_async(const CommandLong &command,
                                   command.params.param6,
                                   command.params.param7);
 
-    new_work.callback = callback;
-    new_work.mavlink_command = command.command;
-    _work_queue.push_back(new_work);
+    work.mavlink_command = command.command;
+    work.target_component_id = command.target_component_id;
 }
 
-void MAVLinkCommands::receive_command_ack(mavlink_message_t message)
+MAVLinkCommands::Result
+MAVLinkCommands::send_commands(const std::vector<CommandLong> &commands,
+                               std::vector<Result> *results)
 {
-    // If nothing is in the queue, we ignore the message all together.
-    if (_work_queue.size() == 0) {
-        return;
-    }
+    Completion<Result> completion;
 
-    Work &work = _work_queue.front();
-
-    mavlink_command_ack_t command_ack;
-    mavlink_msg_command_ack_decode(&message, &command_ack);
+    queue_commands_async(commands,
+    [&completion, results](Result result, const std::vector<Result> &each) {
+        if (results != nullptr) {
+            *results = each;
+        }
+        completion.complete(result);
+    });
 
-    // LogDebug() << "We got an ack: " << command_ack.command;
+    return completion.wait();
+}
 
-    if (work.mavlink_command != command_ack.command) {
-        // If the command does not match with our current command, ignore it.
-        LogWarn() << "Command ack not matching our current command: " << work.mavlink_command;
+void MAVLinkCommands::queue_commands_async(const std::vector<CommandLong> &commands,
+                                           batch_result_callback_t callback)
+{
+    if (commands.empty()) {
+        if (callback) {
+            callback(Result::SUCCESS, std::vector<Result>());
+        }
         return;
     }
 
-    std::lock_guard<std::mutex> lock(_state_mutex);
-    switch (command_ack.result) {
-        case MAV_RESULT_ACCEPTED:
-            _state = State::DONE;
-            if (work.callback) {
-                work.callback(Result::SUCCESS, 1.0f);
+    auto batch = std::make_shared<Batch>();
+    batch->results.assign(commands.size(), Result::UNKNOWN_ERROR);
+    batch->num_left = commands.size();
+    batch->callback = std::move(callback);
+
+    for (size_t i = 0; i < commands.size(); ++i) {
+        Work new_work {};
+        pack_command(commands[i], new_work);
+        new_work.callback = [batch, i](Result result, float progress) {
+            UNUSED(progress);
+            if (result != Result::IN_PROGRESS) {
+                finish_in_batch(*batch, i, result);
             }
-            break;
+        };
+        _new_work.push(std::move(new_work));
+    }
 
-        case MAV_RESULT_DENIED:
-            LogWarn() << "command denied (" << work.mavlink_command << ").";
-            _state = State::FAILED;
-            if (work.callback) {
-                work.callback(Result::COMMAND_DENIED, NAN);
-            }
-            break;
+    // Only once all of them are there for do_work() to pick up.
+    _parent.trigger_work();
+}
 
-        case MAV_RESULT_UNSUPPORTED:
-            LogWarn() << "command unsupported (" << work.mavlink_command << ").";
-            _state = State::FAILED;
-            if (work.callback) {
-                work.callback(Result::COMMAND_DENIED, NAN);
-            }
-            break;
+void MAVLinkCommands::finish_in_batch(Batch &batch, size_t index, Result result)
+{
+    {
+        std::lock_guard<std::mutex> lock(batch.mutex);
+        batch.results[index] = result;
+        if (--batch.num_left > 0) {
+            return;
+        }
+    }
 
-        case MAV_RESULT_TEMPORARILY_REJECTED:
-            LogWarn() << "command temporarily rejected (" << work.mavlink_command << ").";
-            _state = State::FAILED;
-            if (work.callback) {
-                work.callback(Result::COMMAND_DENIED, NAN);
-            }
+    // The last one is done, nothing else touches the batch anymore.
+    Result combined = Result::SUCCESS;
+    for (Result each : batch.results) {
+        if (each != Result::SUCCESS) {
+            combined = each;
             break;
+        }
+    }
+    if (batch.callback) {
+        batch.callback(combined, batch.results);
+    }
+}
 
-        case MAV_RESULT_FAILED:
-            LogWarn() << "command failed (" << work.mavlink_command << ").";
-            _state = State::FAILED;
-            if (work.callback) {
-                work.callback(Result::COMMAND_DENIED, NAN);
-            }
-            break;
+bool MAVLinkCommands::send_command_unacked(const CommandLong &command)
+{
+    {
+        std::lock_guard<std::mutex> lock(_work_mutex);
+        _unacked_commands.insert(command.command);
+    }
 
-        case MAV_RESULT_IN_PROGRESS:
-            if (static_cast<int>(command_ack.progress) != 255) {
-                LogInfo() << "progress: " << static_cast<int>(command_ack.progress)
-                          << " % (" << work.mavlink_command << ").";
-            }
-            // FIXME: We can only call callbacks with promises once, so let's not do it
-            //        on IN_PROGRESS.
-            //if (work.callback) {
-            //    work.callback(Result::IN_PROGRESS, command_ack.progress / 100.0f);
-            //}
-            _state = State::IN_PROGRESS;
-            // If we get a progress update, we can raise the timeout
-            // to something higher because we know the initial command
-            // has arrived. A possible timeout for this case is the initial
-            // timeout * the possible retries because this should match the
-            // case where there is no progress update and we keep trying.
-            _parent.unregister_timeout_handler(_timeout_cookie);
-            _parent.register_timeout_handler(
-                std::bind(&MAVLinkCommands::receive_timeout, this),
-                work.retries_to_do * work.timeout_s, &_timeout_cookie);
-            break;
+    mavlink_message_t message;
+    mavlink_msg_command_long_pack(GCSClient::system_id,
+                                  GCSClient::component_id,
+                                  &message,
+                                  command.target_system_id,
+                                  command.target_component_id,
+                                  command.command,
+                                  command.confirmation,
+                                  command.params.param1,
+                                  command.params.param2,
+                                  command.params.param3,
+                                  command.params.param4,
+                                  command.params.param5,
+                                  command.params.param6,
+                                  command.params.param7);
+    return _parent.send_message(message);
+}
+
+void MAVLinkCommands::queue_work(Work &&work)
+{
+    _new_work.push(std::move(work));
+    _parent.trigger_work();
+}
+
+MAVLinkCommands::work_key_t MAVLinkCommands::key_of(const Work &work)
+{
+    return (work_key_t(work.target_component_id) << 16) | work.mavlink_command;
+}
+
+std::list<MAVLinkCommands::Work>::iterator MAVLinkCommands::find_in_flight(work_key_t key)
+{
+    // We assume that we already acquired _work_mutex in this function.
+
+    for (auto it = _in_flight_work.begin(); it != _in_flight_work.end(); ++it) {
+        if (key_of(*it) == key) {
+            return it;
+        }
     }
+    return _in_flight_work.end();
 }
 
-void MAVLinkCommands::receive_timeout()
+std::list<MAVLinkCommands::Work>::iterator
+MAVLinkCommands::find_for_ack(uint8_t component_id, uint16_t command)
 {
-    // If nothing is in the queue, we ignore the timeout.
-    if (_work_queue.size() == 0) {
-        return;
+    // We assume that we already acquired _work_mutex in this function.
+
+    auto it = find_in_flight((work_key_t(component_id) << 16) | command);
+    if (it != _in_flight_work.end()) {
+        return it;
     }
 
-    Work &work = _work_queue.front();
+    // Commands sent to all components (id 0) can be acked by any of them.
+    return find_in_flight(command);
+}
 
-    std::lock_guard<std::mutex> lock(_state_mutex);
+uint64_t MAVLinkCommands::trace_id_of(const Work &work) const
+{
+    return (uint64_t(_parent.get_system_id()) << 32) | key_of(work);
+}
 
-    if (_state == State::WAITING) {
+void MAVLinkCommands::trace_sent(const Work &work)
+{
+    if (TraceRecorder::is_enabled()) {
+        TraceRecorder::async_begin("command", "command", trace_id_of(work),
+                                   std::to_string(work.mavlink_command).c_str());
+    }
+}
 
-        if (work.retries_to_do > 0) {
+void MAVLinkCommands::trace_step(const Work &work, const char *step)
+{
+    TraceRecorder::async_instant("command", step, trace_id_of(work));
+}
+
+void MAVLinkCommands::trace_finished(const Work &work, const char *result)
+{
+    TraceRecorder::async_end("command", "command", trace_id_of(work), result);
+}
+
+void MAVLinkCommands::call_back(const std::vector<Report> &reports)
+{
+    for (const auto &report : reports) {
+        if (report.callback) {
+            report.callback(report.result, report.progress);
+        }
+    }
+}
+
+void MAVLinkCommands::receive_command_ack(mavlink_message_t message)
+{
+    mavlink_command_ack_t command_ack;
+    mavlink_msg_command_ack_decode(&message, &command_ack);
+
+    // LogDebug() << "We got an ack: " << command_ack.command;
+
+    std::vector<Report> reports;
+    {
+        std::lock_guard<std::mutex> lock(_work_mutex);
+
+        auto it = find_for_ack(message.compid, command_ack.command);
+        if (it == _in_flight_work.end()) {
+            if (_unacked_commands.count(command_ack.command) > 0) {
+                return;
+            }
+            // If the command does not match with any of ours, ignore it.
+            LogWarn() << "Command ack not matching any pending command: " << command_ack.command;
+            return;
+        }
+
+        Work &work = *it;
+        bool finished = true;
+
+        // Whatever the ack says, the command got there. Acks of a command sent
+        // again could be for either transmission.
+        if (work.state == State::WAITING && !work.retransmitted) {
+            _parent.rtt_estimator().add_sample(
+                _parent.get_time().elapsed_since_s(work.sent_time));
+        }
+
+        switch (command_ack.result) {
+            case MAV_RESULT_ACCEPTED:
+                trace_finished(work, "accepted");
+                reports.push_back(Report {work.callback, Result::SUCCESS, 1.0f});
+                break;
+
+            case MAV_RESULT_DENIED:
+                trace_finished(work, "denied");
+                LogWarn() << "command denied (" << work.mavlink_command << ").";
+                reports.push_back(Report {work.callback, Result::COMMAND_DENIED, NAN});
+                break;
+
+            case MAV_RESULT_UNSUPPORTED:
+                trace_finished(work, "unsupported");
+                LogWarn() << "command unsupported (" << work.mavlink_command << ").";
+                reports.push_back(Report {work.callback, Result::COMMAND_DENIED, NAN});
+                break;
+
+            case MAV_RESULT_TEMPORARILY_REJECTED:
+                trace_finished(work, "temporarily rejected");
+                LogWarn() << "command temporarily rejected (" << work.mavlink_command << ").";
+                reports.push_back(Report {work.callback, Result::COMMAND_DENIED, NAN});
+                break;
+
+            case MAV_RESULT_FAILED:
+                trace_finished(work, "failed");
+                LogWarn() << "command failed (" << work.mavlink_command << ").";
+                reports.push_back(Report {work.callback, Result::COMMAND_DENIED, NAN});
+                break;
+
+            case MAV_RESULT_IN_PROGRESS:
+                if (static_cast<int>(command_ack.progress) != 255) {
+                    LogInfo() << "progress: " << static_cast<int>(command_ack.progress)
+                              << " % (" << work.mavlink_command << ").";
+                }
+                // FIXME: We can only call callbacks with promises once, so let's not do it
+                //        on IN_PROGRESS.
+                //if (work.callback) {
+                //    work.callback(Result::IN_PROGRESS, command_ack.progress / 100.0f);
+                //}
+                work.state = State::IN_PROGRESS;
+                trace_step(work, "in progress");
+                // If we get a progress update, we can raise the timeout
+                // to something higher because we know the initial command
+                // has arrived. A possible timeout for this case is the initial
+                // timeout * the possible retries because this should match the
+                // case where there is no progress update and we keep trying.
+                _parent.unregister_timeout_handler(work.timeout_cookie);
+                _parent.register_timeout_handler(
+                    std::bind(&MAVLinkCommands::receive_timeout, this, key_of(work)),
+                    work.retries_to_do * work.timeout_s, &work.timeout_cookie);
+                finished = false;
+                break;
+
+            default:
+                finished = false;
+                break;
+        }
+
+        if (finished) {
+            _parent.unregister_timeout_handler(work.timeout_cookie);
+            _in_flight_work.erase(it);
+        }
+    }
+
+    call_back(reports);
+
+    if (!reports.empty()) {
+        // Something might have been waiting for this one to finish.
+        _parent.trigger_work();
+    }
+}
+
+void MAVLinkCommands::receive_timeout(work_key_t key)
+{
+    std::vector<Report> reports;
+    {
+        std::lock_guard<std::mutex> lock(_work_mutex);
+
+        auto it = find_in_flight(key);
+        if (it == _in_flight_work.end()) {
+            // It has been acked meanwhile.
+            return;
+        }
+
+        Work &work = *it;
+
+        if (work.state == State::WAITING && work.retries_to_do > 0) {
 
             LogInfo() << "sending again, retries to do: " << work.retries_to_do
                       << "  (" << work.mavlink_command << ").";
             // We're not sure the command arrived, let's retransmit.
-            if (!_parent.send_message(work.mavlink_message)) {
-                LogErr() << "connection send error in retransmit (" << work.mavlink_command << ").";
-                if (work.callback) {
-                    work.callback(Result::CONNECTION_ERROR, NAN);
-                }
-                _state = State::FAILED;
-            } else {
+            if (_parent.send_message(work.mavlink_message)) {
+                trace_step(work, "retry");
                 --work.retries_to_do;
+                work.retransmitted = true;
+                work.retry_timeout_s = RttEstimator::backed_off_s(work.retry_timeout_s);
                 _parent.register_timeout_handler(
-                    std::bind(&MAVLinkCommands::receive_timeout, this),
-                    work.timeout_s, &_timeout_cookie);
+                    std::bind(&MAVLinkCommands::receive_timeout, this, key),
+                    work.retry_timeout_s, &work.timeout_cookie);
+                return;
             }
 
-        } else  {
-            // We have tried retransmitting, giving up now.
+            LogErr() << "connection send error in retransmit (" << work.mavlink_command << ").";
+            trace_finished(work, "connection error");
+            reports.push_back(Report {work.callback, Result::CONNECTION_ERROR, NAN});
+
+        } else {
+            // We have tried retransmitting or waited for the progress long
+            // enough, giving up now.
             LogErr() << "Retrying failed (" << work.mavlink_command << ")";
+            trace_finished(work, "timeout");
+            reports.push_back(Report {work.callback, Result::TIMEOUT, NAN});
+        }
 
-            if (work.callback) {
-                if (_state == State::WAITING) {
-                    work.callback(Result::TIMEOUT, NAN);
-                }
-            }
-            _state = State::FAILED;
+        _in_flight_work.erase(it);
+    }
+
+    call_back(reports);
+
+    // This runs from do_work() which is going to start what was waiting.
+}
+
+size_t MAVLinkCommands::num_work()
+{
+    std::lock_guard<std::mutex> lock(_work_mutex);
+    return _queued_work.size() + _in_flight_work.size();
+}
+
+void MAVLinkCommands::retransmit_in_flight()
+{
+    std::lock_guard<std::mutex> lock(_work_mutex);
+
+    for (auto &work : _in_flight_work) {
+        // Once in progress, the ack has obviously arrived.
+        if (work.state != State::WAITING) {
+            continue;
+        }
+        if (_parent.send_message(work.mavlink_message)) {
+            trace_step(work, "retransmit");
+            work.retransmitted = true;
+            _parent.refresh_timeout_handler(work.timeout_cookie);
         }
     }
 }
 
 void MAVLinkCommands::do_work()
 {
-    std::lock_guard<std::mutex> lock(_state_mutex);
-
-    // Clean up first
-    switch (_state) {
-        case State::NONE:
-        // FALLTHROUGH
-        case State::WAITING:
-        // FALLTHROUGH
-        case State::IN_PROGRESS:
-            break;
-        case State::DONE:
-        // FALLTHROUGH
-        case State::FAILED:
-            _parent.unregister_timeout_handler(_timeout_cookie);
-            _work_queue.pop_front();
-            _state = State::NONE;
-            break;
-    }
+    std::vector<Report> reports;
+    {
+        std::lock_guard<std::mutex> lock(_work_mutex);
 
-    // Check if there is work to do.
-    if (_work_queue.size() == 0) {
-        // Nothing to do.
-        return;
-    }
+        Work new_work;
+        while (_new_work.try_pop(new_work)) {
+            _queued_work.push_back(std::move(new_work));
+        }
+
+        // Start whatever does not have to wait for a command with the same key,
+        // keeping the order of the queue for commands with the same key.
+        const auto first_started = (_in_flight_work.empty()) ? _in_flight_work.end() :
+                                   std::prev(_in_flight_work.end());
+        std::vector<mavlink_message_t> burst;
+        for (auto it = _queued_work.begin();
+             it != _queued_work.end() && _in_flight_work.size() < MAX_IN_FLIGHT;
+             /* no ++it */) {
+
+            if (find_in_flight(key_of(*it)) != _in_flight_work.end()) {
+                ++it;
+                continue;
+            }
 
-    // If so, let's get the latest.
-    Work &work = _work_queue.front();
-
-    // If the work state is none, we can start the next command.
-    switch (_state) {
-        case State::NONE:
-            // LogDebug() << "sending it the first time (" << work.mavlink_command << ")";
-            if (!_parent.send_message(work.mavlink_message)) {
-                LogErr() << "connection send error (" << work.mavlink_command << ")";
-                if (work.callback) {
-                    work.callback(Result::CONNECTION_ERROR, NAN);
+            burst.push_back(it->mavlink_message);
+            _in_flight_work.push_back(std::move(*it));
+            it = _queued_work.erase(it);
+        }
+
+        if (!burst.empty()) {
+            // All of them at once, e.g. the commands of a batch.
+            const bool sent = _parent.send_messages(burst.data(), burst.size());
+            const dl_time_t sent_time = _parent.get_time().steady_time();
+
+            auto it = (first_started == _in_flight_work.end()) ?
+                      _in_flight_work.begin() : std::next(first_started);
+            while (it != _in_flight_work.end()) {
+                Work &in_flight = *it;
+                if (!sent) {
+                    LogErr() << "connection send error (" << in_flight.mavlink_command << ")";
+                    reports.push_back(Report {in_flight.callback, Result::CONNECTION_ERROR, NAN});
+                    it = _in_flight_work.erase(it);
+                    continue;
                 }
-                _state = State::FAILED;
-                break;
-            } else {
-                _state = State::WAITING;
+
+                in_flight.state = State::WAITING;
+                in_flight.sent_time = sent_time;
+                in_flight.retransmitted = false;
+                in_flight.retry_timeout_s =
+                    _parent.rtt_estimator().timeout_s(in_flight.timeout_s);
+                trace_sent(in_flight);
                 _parent.register_timeout_handler(
-                    std::bind(&MAVLinkCommands::receive_timeout, this),
-                    work.timeout_s, &_timeout_cookie);
+                    std::bind(&MAVLinkCommands::receive_timeout, this, key_of(in_flight)),
+                    in_flight.retry_timeout_s, &in_flight.timeout_cookie);
+                ++it;
             }
-            break;
-        case State::WAITING:
-        case State::IN_PROGRESS:
-            // LogWarn() << "wait until we can deal with this";
-            break;
-        case State::DONE:
-        // FALLTHROUGH
-        case State::FAILED:
-            break;
+        }
     }
-}
 
+    call_back(reports);
+}
 
 } // namespace dronecore
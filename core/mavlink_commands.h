@@ -1,11 +1,17 @@
 #pragma once
 
+#include "global_include.h"
+#include "inplace_function.h"
 #include "mavlink_include.h"
-#include "locked_queue.h"
+#include "mpsc_queue.h"
 #include <cstdint>
+#include <deque>
+#include <list>
 #include <string>
 #include <functional>
 #include <mutex>
+#include <set>
+#include <vector>
 
 namespace dronecore {
 
@@ -28,7 +34,7 @@ public:
         UNKNOWN_ERROR
     };
 
-    typedef std::function<void(Result, float)> command_result_callback_t;
+    typedef Callback<void(Result, float)> command_result_callback_t;
 
     struct CommandInt {
         uint8_t target_system_id;
@@ -99,8 +105,35 @@ public:
     void queue_command_async(const CommandLong &command,
                              command_result_callback_t callback);
 
+    // Sends the command once right away, for commands which are streamed.
+    // It takes no slot and is not retried, and acks of the same command
+    // which match nothing pending are dropped quietly from then on.
+    bool send_command_unacked(const CommandLong &command);
+
+    // With the result of each command in the order they were given. The
+    // first is SUCCESS if all of them succeeded, otherwise the first other
+    // result.
+    typedef Callback<void(Result, const std::vector<Result> &)> batch_result_callback_t;
+
+    // Independent commands, e.g. of a preflight configuration, are all queued
+    // before any of them is looked at, so that they go out in one burst and
+    // take one round trip instead of one each. The acks are still matched one
+    // by one, and commands with the same component and id go one after the
+    // other as usual.
+    void queue_commands_async(const std::vector<CommandLong> &commands,
+                              batch_result_callback_t callback);
+    Result send_commands(const std::vector<CommandLong> &commands,
+                         std::vector<Result> *results = nullptr);
+
+    // Sends what is waiting for an ack again right away, with its timeout
+    // starting over and without using up a retry.
+    void retransmit_in_flight();
+
     void do_work();
 
+    // Queued or waiting for an ack.
+    size_t num_work();
+
     static const int DEFAULT_COMPONENT_ID_AUTOPILOT = MAV_COMP_ID_AUTOPILOT1;
 
     // Non-copyable
@@ -109,29 +142,74 @@ public:
 
 private:
     enum class State {
-        NONE,
         WAITING,
-        IN_PROGRESS,
-        DONE,
-        FAILED
-    } _state = State::NONE;
-    std::mutex _state_mutex {};
+        IN_PROGRESS
+    };
 
     struct Work {
         int retries_to_do = 3;
         double timeout_s = 0.5;
         uint16_t mavlink_command = 0;
+        uint8_t target_component_id = 0;
         mavlink_message_t mavlink_message {};
         command_result_callback_t callback {};
+        // Only used once the work is in flight.
+        State state = State::WAITING;
+        void *timeout_cookie = nullptr;
+        // Of the first transmission, only that gives a round trip.
+        dl_time_t sent_time {};
+        bool retransmitted = false;
+        // Taken from the measured round trips, timeout_s until there are some.
+        double retry_timeout_s = 0.0;
     };
 
+    // At most one command with the same key is in flight, because the ack
+    // can't tell them apart.
+    typedef uint32_t work_key_t;
+    static work_key_t key_of(const Work &work);
+
+    static void pack_command(const CommandLong &command, Work &work);
+    void queue_work(Work &&work);
+
+    struct Batch {
+        std::mutex mutex {};
+        std::vector<Result> results {};
+        size_t num_left = 0;
+        batch_result_callback_t callback {};
+    };
+    static void finish_in_batch(Batch &batch, size_t index, Result result);
     void receive_command_ack(mavlink_message_t message);
-    void receive_timeout();
+    void receive_timeout(work_key_t key);
+
+    std::list<Work>::iterator find_in_flight(work_key_t key);
+    std::list<Work>::iterator find_for_ack(uint8_t component_id, uint16_t command);
+
+    // Calls callbacks after _work_mutex has been released, because they may
+    // want to queue the next command.
+    struct Report {
+        command_result_callback_t callback;
+        Result result;
+        float progress;
+    };
+    void call_back(const std::vector<Report> &reports);
+
+    // Spans of the trace, from a command being sent until it is finished.
+    uint64_t trace_id_of(const Work &work) const;
+    void trace_sent(const Work &work);
+    void trace_step(const Work &work, const char *step);
+    void trace_finished(const Work &work, const char *result);
 
     MAVLinkSystem &_parent;
-    LockedQueue<Work> _work_queue {};
 
-    void *_timeout_cookie = nullptr;
+    static constexpr size_t MAX_IN_FLIGHT = 8;
+
+    // Queuing does not need _work_mutex, do_work() takes the new work from here.
+    MpscQueue<Work> _new_work {};
+
+    std::mutex _work_mutex {};
+    std::deque<Work> _queued_work {};
+    std::list<Work> _in_flight_work {};
+    std::set<uint16_t> _unacked_commands {};
 };
 
 } // namespace dronecore
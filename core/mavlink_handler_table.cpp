@@ -0,0 +1,163 @@
+#include "mavlink_handler_table.h"
+#include "log.h"
+#include <algorithm>
+#include <chrono>
+
+// Set to 1 to log every message handed to a handler.
+#define MESSAGE_DEBUGGING 0
+
+namespace dronecore {
+
+constexpr uint32_t MAVLinkHandlerTable::NUM_SHORT_IDS;
+constexpr size_t MAVLinkHandlerTable::MAX_DECODED_LEN;
+
+void MAVLinkHandlerUsage::add(uint64_t ns)
+{
+    num_calls.fetch_add(1, std::memory_order_relaxed);
+    total_ns.fetch_add(ns, std::memory_order_relaxed);
+
+    uint64_t max = max_ns.load(std::memory_order_relaxed);
+    while (ns > max && !max_ns.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {}
+}
+
+void MAVLinkHandlerTable::add(uint32_t msg_id, const Entry &entry)
+{
+    if (msg_id < NUM_SHORT_IDS) {
+        uint16_t &slot = _short_id_slots[msg_id];
+        if (slot == 0) {
+            _short_id_entries.emplace_back();
+            slot = uint16_t(_short_id_entries.size());
+        }
+        _short_id_entries[slot - 1].push_back(entry);
+    } else {
+        _by_long_id[msg_id].push_back(entry);
+    }
+}
+
+void MAVLinkHandlerTable::remove_all(const void *cookie)
+{
+    auto has_cookie = [cookie](const Entry & entry) {
+        return entry.cookie == cookie;
+    };
+
+    // The ids left without handlers give up their slot.
+    pmr_vector<entries_t> short_id_entries(_short_id_entries.get_allocator());
+    for (uint32_t msg_id = 0; msg_id < NUM_SHORT_IDS; ++msg_id) {
+        uint16_t &slot = _short_id_slots[msg_id];
+        if (slot == 0) {
+            continue;
+        }
+        entries_t &entries = _short_id_entries[slot - 1];
+        entries.erase(std::remove_if(entries.begin(), entries.end(), has_cookie),
+                      entries.end());
+        if (entries.empty()) {
+            slot = 0;
+        } else {
+            short_id_entries.push_back(std::move(entries));
+            slot = uint16_t(short_id_entries.size());
+        }
+    }
+    _short_id_entries.swap(short_id_entries);
+
+    for (auto it = _by_long_id.begin(); it != _by_long_id.end(); /* no ++it */) {
+        it->second.erase(std::remove_if(it->second.begin(), it->second.end(), has_cookie),
+                         it->second.end());
+        if (it->second.empty()) {
+            it = _by_long_id.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+const MAVLinkHandlerTable::entries_t *MAVLinkHandlerTable::find(uint32_t msg_id) const
+{
+    if (msg_id < NUM_SHORT_IDS) {
+        const uint16_t slot = _short_id_slots[msg_id];
+        return (slot == 0) ? nullptr : &_short_id_entries[slot - 1];
+    }
+
+    auto it = _by_long_id.find(msg_id);
+    if (it == _by_long_id.end()) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+std::vector<uint32_t> MAVLinkHandlerTable::ids() const
+{
+    std::vector<uint32_t> result;
+    for (uint32_t msg_id = 0; msg_id < NUM_SHORT_IDS; ++msg_id) {
+        if (_short_id_slots[msg_id] != 0) {
+            result.push_back(msg_id);
+        }
+    }
+    for (const auto &id_and_entries : _by_long_id) {
+        result.push_back(id_and_entries.first);
+    }
+    return result;
+}
+
+void MAVLinkHandlerTable::dispatch(const entries_t &entries, const MAVLinkMessageView &message)
+{
+    typedef std::chrono::steady_clock clock;
+
+    uint8_t decoded[MAX_DECODED_LEN];
+    bool is_decoded = false;
+
+    // The end of one timed handler is the start of the next, so that the clock
+    // is only read once per handler.
+    clock::time_point start;
+    bool has_start = false;
+
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+#if MESSAGE_DEBUGGING==1
+        LogDebug() << "Forwarding msg " << int(message.msgid()) << " to " << size_t(it->cookie);
+#endif
+        if (it->usage != nullptr && !has_start) {
+            start = clock::now();
+            has_start = true;
+        }
+
+        if (it->view_callback) {
+            it->view_callback(message);
+        } else if (it->decoded_callback) {
+            if (!is_decoded) {
+                it->decoder(message.message(), decoded);
+                is_decoded = true;
+            }
+            it->decoded_callback(decoded);
+        } else {
+            // Only now the message is copied, if not done already.
+            it->callback(message.message());
+        }
+
+        if (it->usage != nullptr) {
+            const clock::time_point end = clock::now();
+            it->usage->add(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                        end - start).count()));
+            start = end;
+        } else {
+            has_start = false;
+        }
+    }
+}
+
+bool MAVLinkHandlerTable::empty() const
+{
+    return _short_id_entries.empty() && _by_long_id.empty();
+}
+
+size_t MAVLinkHandlerTable::size() const
+{
+    size_t num_entries = 0;
+    for (const auto &entries : _short_id_entries) {
+        num_entries += entries.size();
+    }
+    for (const auto &id_and_entries : _by_long_id) {
+        num_entries += id_and_entries.second.size();
+    }
+    return num_entries;
+}
+
+} // namespace dronecore
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "inplace_function.h"
+#include "mavlink_include.h"
+#include "mavlink_message_view.h"
+#include "memory_resource.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace dronecore {
+
+// Handlers are indexed by message id, so finding the ones for an incoming message
+// does not depend on how many handlers are registered. The first 256 ids (all of
+// MAVLink 1) are found directly, and only the higher MAVLink 2 ids use a hash map.
+// Time spent in a handler, added to by whichever thread dispatches to it.
+struct MAVLinkHandlerUsage {
+    std::atomic<uint64_t> num_calls {0};
+    std::atomic<uint64_t> total_ns {0};
+    std::atomic<uint64_t> max_ns {0};
+
+    void add(uint64_t ns);
+};
+
+class MAVLinkHandlerTable
+{
+public:
+    // The table is copied on every change, copying a Callback doesn't allocate.
+    typedef Callback<void(const mavlink_message_t &)> mavlink_message_handler_t;
+    typedef Callback<void(const MAVLinkMessageView &)> mavlink_message_view_handler_t;
+
+    // Typed handlers get the decoded struct. All of them for one id use the same
+    // decoder, so the message is decoded once for all of them.
+    typedef void (*decoder_t)(const mavlink_message_t &message, void *decoded);
+    typedef Callback<void(const void *decoded)> decoded_handler_t;
+
+    struct Entry {
+        mavlink_message_handler_t callback;
+        mavlink_message_view_handler_t view_callback;
+        const void *cookie; // This is the identification to unregister.
+        decoder_t decoder;
+        decoded_handler_t decoded_callback;
+        // Where the time spent in the callback is counted, nullptr to not time it.
+        MAVLinkHandlerUsage *usage;
+    };
+
+    typedef pmr_vector<Entry> entries_t;
+
+    // Decoded structs are packed, so none is larger than the biggest payload.
+    static constexpr size_t MAX_DECODED_LEN = MAVLINK_MAX_PAYLOAD_LEN;
+
+    // Calls all entries with the message, in the order they were added.
+    static void dispatch(const entries_t &entries, const MAVLinkMessageView &message);
+
+    void add(uint32_t msg_id, const Entry &entry);
+    void remove_all(const void *cookie);
+
+    // Returns nullptr if there are no handlers for msg_id.
+    const entries_t *find(uint32_t msg_id) const;
+
+    // Returns the ids which have at least one handler, in no particular order.
+    std::vector<uint32_t> ids() const;
+
+    bool empty() const;
+
+    // Number of entries over all ids.
+    size_t size() const;
+
+private:
+    static constexpr uint32_t NUM_SHORT_IDS = 256;
+
+    // Only the ids with handlers get entries, there is one table per system
+    // and it is copied on every change. The slot is the index into
+    // _short_id_entries plus one, 0 if there are none.
+    std::array<uint16_t, NUM_SHORT_IDS> _short_id_slots {};
+    pmr_vector<entries_t> _short_id_entries {};
+    std::unordered_map<uint32_t, entries_t, std::hash<uint32_t>, std::equal_to<uint32_t>,
+        PolymorphicAllocator<std::pair<const uint32_t, entries_t>>> _by_long_id {};
+};
+
+} // namespace dronecore
@@ -0,0 +1,183 @@
+#include "mavlink_handler_table.h"
+#include "mavlink_message_traits.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+using namespace dronecore;
+
+TEST(MAVLinkHandlerTable, FindShortAndLongIds)
+{
+    MAVLinkHandlerTable table;
+    EXPECT_TRUE(table.empty());
+
+    int cookie;
+    MAVLinkHandlerTable::Entry entry = {nullptr, nullptr, &cookie, nullptr, nullptr, nullptr};
+    table.add(MAVLINK_MSG_ID_HEARTBEAT, entry);
+    table.add(MAVLINK_MSG_ID_CAMERA_INFORMATION, entry);
+    table.add(MAVLINK_MSG_ID_CAMERA_INFORMATION, entry);
+
+    ASSERT_NE(table.find(MAVLINK_MSG_ID_HEARTBEAT), nullptr);
+    EXPECT_EQ(table.find(MAVLINK_MSG_ID_HEARTBEAT)->size(), 1u);
+    ASSERT_NE(table.find(MAVLINK_MSG_ID_CAMERA_INFORMATION), nullptr);
+    EXPECT_EQ(table.find(MAVLINK_MSG_ID_CAMERA_INFORMATION)->size(), 2u);
+
+    EXPECT_EQ(table.find(MAVLINK_MSG_ID_ATTITUDE), nullptr);
+    EXPECT_EQ(table.find(MAVLINK_MSG_ID_VIDEO_STREAM_INFORMATION), nullptr);
+    EXPECT_FALSE(table.empty());
+    EXPECT_EQ(table.size(), 3u);
+}
+
+TEST(MAVLinkHandlerTable, RemoveOnlyOwnCookie)
+{
+    MAVLinkHandlerTable table;
+
+    int cookie1;
+    int cookie2;
+    MAVLinkHandlerTable::Entry entry1 = {nullptr, nullptr, &cookie1, nullptr, nullptr, nullptr};
+    MAVLinkHandlerTable::Entry entry2 = {nullptr, nullptr, &cookie2, nullptr, nullptr, nullptr};
+    table.add(MAVLINK_MSG_ID_HEARTBEAT, entry1);
+    table.add(MAVLINK_MSG_ID_HEARTBEAT, entry2);
+    table.add(MAVLINK_MSG_ID_CAMERA_INFORMATION, entry1);
+
+    table.remove_all(&cookie1);
+
+    ASSERT_NE(table.find(MAVLINK_MSG_ID_HEARTBEAT), nullptr);
+    EXPECT_EQ(table.find(MAVLINK_MSG_ID_HEARTBEAT)->size(), 1u);
+    EXPECT_EQ(table.find(MAVLINK_MSG_ID_HEARTBEAT)->front().cookie, &cookie2);
+    EXPECT_EQ(table.find(MAVLINK_MSG_ID_CAMERA_INFORMATION), nullptr);
+
+    table.remove_all(&cookie2);
+    EXPECT_TRUE(table.empty());
+}
+
+TEST(MAVLinkHandlerTable, ListsIdsWithHandlers)
+{
+    MAVLinkHandlerTable table;
+    EXPECT_TRUE(table.ids().empty());
+
+    int cookie1;
+    int cookie2;
+    MAVLinkHandlerTable::Entry entry1 = {nullptr, nullptr, &cookie1, nullptr, nullptr, nullptr};
+    MAVLinkHandlerTable::Entry entry2 = {nullptr, nullptr, &cookie2, nullptr, nullptr, nullptr};
+    table.add(MAVLINK_MSG_ID_HEARTBEAT, entry1);
+    table.add(MAVLINK_MSG_ID_HEARTBEAT, entry2);
+    table.add(MAVLINK_MSG_ID_CAMERA_INFORMATION, entry1);
+    table.add(MAVLINK_MSG_ID_ATTITUDE, entry2);
+
+    std::vector<uint32_t> ids = table.ids();
+    std::sort(ids.begin(), ids.end());
+    ASSERT_EQ(ids.size(), 3u);
+    EXPECT_EQ(ids[0], uint32_t(MAVLINK_MSG_ID_HEARTBEAT));
+    EXPECT_EQ(ids[1], uint32_t(MAVLINK_MSG_ID_ATTITUDE));
+    EXPECT_EQ(ids[2], uint32_t(MAVLINK_MSG_ID_CAMERA_INFORMATION));
+
+    table.remove_all(&cookie1);
+    ids = table.ids();
+    std::sort(ids.begin(), ids.end());
+    ASSERT_EQ(ids.size(), 2u);
+    EXPECT_EQ(ids[0], uint32_t(MAVLINK_MSG_ID_HEARTBEAT));
+    EXPECT_EQ(ids[1], uint32_t(MAVLINK_MSG_ID_ATTITUDE));
+}
+
+TEST(MAVLinkHandlerTable, ReusesSlotsOfRemovedIds)
+{
+    MAVLinkHandlerTable table;
+
+    int cookie1;
+    int cookie2;
+    MAVLinkHandlerTable::Entry entry1 = {nullptr, nullptr, &cookie1, nullptr, nullptr, nullptr};
+    MAVLinkHandlerTable::Entry entry2 = {nullptr, nullptr, &cookie2, nullptr, nullptr, nullptr};
+    table.add(MAVLINK_MSG_ID_HEARTBEAT, entry1);
+    table.add(MAVLINK_MSG_ID_SYS_STATUS, entry2);
+    table.add(MAVLINK_MSG_ID_ATTITUDE, entry1);
+
+    // The ones after the emptied slot move up and are still found.
+    table.remove_all(&cookie1);
+    EXPECT_EQ(table.find(MAVLINK_MSG_ID_HEARTBEAT), nullptr);
+    EXPECT_EQ(table.find(MAVLINK_MSG_ID_ATTITUDE), nullptr);
+    ASSERT_NE(table.find(MAVLINK_MSG_ID_SYS_STATUS), nullptr);
+    EXPECT_EQ(table.find(MAVLINK_MSG_ID_SYS_STATUS)->front().cookie, &cookie2);
+
+    table.add(MAVLINK_MSG_ID_ATTITUDE, entry1);
+    ASSERT_NE(table.find(MAVLINK_MSG_ID_ATTITUDE), nullptr);
+    EXPECT_EQ(table.find(MAVLINK_MSG_ID_ATTITUDE)->front().cookie, &cookie1);
+    ASSERT_NE(table.find(MAVLINK_MSG_ID_SYS_STATUS), nullptr);
+    EXPECT_EQ(table.find(MAVLINK_MSG_ID_SYS_STATUS)->size(), 1u);
+}
+
+namespace {
+
+unsigned num_decodes = 0;
+
+void counting_decode(const mavlink_message_t &message, void *decoded)
+{
+    ++num_decodes;
+    MAVLinkMessageTraits<mavlink_heartbeat_t>::decode(message, decoded);
+}
+
+} // namespace
+
+TEST(MAVLinkHandlerTable, DecodesOnceForAllTypedHandlers)
+{
+    mavlink_message_t message;
+    mavlink_msg_heartbeat_pack(1, 1, &message, MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_PX4,
+                               MAV_MODE_FLAG_SAFETY_ARMED, 42, MAV_STATE_ACTIVE);
+
+    std::vector<uint32_t> custom_modes;
+    unsigned num_raw = 0;
+    auto typed = [&custom_modes](const void *decoded) {
+        custom_modes.push_back(static_cast<const mavlink_heartbeat_t *>(decoded)->custom_mode);
+    };
+
+    int cookie;
+    MAVLinkHandlerTable::entries_t entries = {
+        {nullptr, nullptr, &cookie, &counting_decode, typed, nullptr},
+        {
+            [&num_raw](const mavlink_message_t &) { ++num_raw; }, nullptr, &cookie, nullptr,
+            nullptr, nullptr
+        },
+        {nullptr, nullptr, &cookie, &counting_decode, typed, nullptr}
+    };
+
+    num_decodes = 0;
+    MAVLinkHandlerTable::dispatch(entries, MAVLinkMessageView(message));
+
+    EXPECT_EQ(num_decodes, 1u);
+    EXPECT_EQ(num_raw, 1u);
+    ASSERT_EQ(custom_modes.size(), 2u);
+    EXPECT_EQ(custom_modes[0], 42u);
+    EXPECT_EQ(custom_modes[1], 42u);
+}
+
+TEST(MAVLinkHandlerTable, CountsTimeOfTimedHandlers)
+{
+    mavlink_message_t message;
+    mavlink_msg_heartbeat_pack(1, 1, &message, MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_PX4,
+                               MAV_MODE_FLAG_SAFETY_ARMED, 42, MAV_STATE_ACTIVE);
+
+    MAVLinkHandlerUsage slow_usage;
+    MAVLinkHandlerUsage fast_usage;
+    auto slow = [](const mavlink_message_t &) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    };
+    auto fast = [](const mavlink_message_t &) {};
+
+    int cookie;
+    MAVLinkHandlerTable::entries_t entries = {
+        {slow, nullptr, &cookie, nullptr, nullptr, &slow_usage},
+        // Not timed, so its time does not end up with the next one.
+        {slow, nullptr, &cookie, nullptr, nullptr, nullptr},
+        {fast, nullptr, &cookie, nullptr, nullptr, &fast_usage}
+    };
+
+    MAVLinkHandlerTable::dispatch(entries, MAVLinkMessageView(message));
+    MAVLinkHandlerTable::dispatch(entries, MAVLinkMessageView(message));
+
+    EXPECT_EQ(slow_usage.num_calls, 2u);
+    EXPECT_GE(slow_usage.total_ns, 4000000u);
+    EXPECT_GE(slow_usage.max_ns, 2000000u);
+    EXPECT_EQ(fast_usage.num_calls, 2u);
+    EXPECT_LT(fast_usage.max_ns, 2000000u);
+}
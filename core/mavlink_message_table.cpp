@@ -0,0 +1,101 @@
+#include "mavlink_message_table.h"
+#include <algorithm>
+#include <array>
+
+namespace dronecore {
+
+constexpr uint32_t MAVLinkMessageTable::NUM_DIRECT_IDS;
+
+namespace {
+
+constexpr mavlink_msg_entry_t ENTRIES[] = MAVLINK_MESSAGE_CRCS;
+constexpr size_t NUM_ENTRIES = sizeof(ENTRIES) / sizeof(ENTRIES[0]);
+
+constexpr size_t middle(size_t begin, size_t end)
+{
+    return begin + (end - begin) / 2;
+}
+
+// Halves the range each time, so that the recursion stays shallow.
+constexpr bool is_sorted(size_t begin, size_t end)
+{
+    return end - begin < 2 ||
+           (ENTRIES[middle(begin, end) - 1].msgid < ENTRIES[middle(begin, end)].msgid &&
+            is_sorted(begin, middle(begin, end)) && is_sorted(middle(begin, end), end));
+}
+
+static_assert(is_sorted(0, NUM_ENTRIES), "Message entries of the dialect need to be sorted by id");
+static_assert(NUM_ENTRIES < UINT16_MAX, "Too many messages in the dialect for the index");
+
+#ifdef MAVLINK_MESSAGE_NAMES
+struct MessageName {
+    const char *name;
+    uint32_t msgid;
+};
+const MessageName NAMES[] = MAVLINK_MESSAGE_NAMES;
+#endif
+
+const mavlink_msg_entry_t *search_entry(uint32_t message_id)
+{
+    const mavlink_msg_entry_t *end = ENTRIES + NUM_ENTRIES;
+    const mavlink_msg_entry_t *entry =
+        std::lower_bound(ENTRIES, end, message_id,
+    [](const mavlink_msg_entry_t &lhs, uint32_t id) { return lhs.msgid < id; });
+    return (entry != end && entry->msgid == message_id) ? entry : nullptr;
+}
+
+struct Index {
+    Index()
+    {
+        for (size_t i = 0; i < NUM_ENTRIES; ++i) {
+            if (ENTRIES[i].msgid < MAVLinkMessageTable::NUM_DIRECT_IDS) {
+                entry_of_id[ENTRIES[i].msgid] = uint16_t(i + 1);
+            }
+        }
+#ifdef MAVLINK_MESSAGE_NAMES
+        for (const auto &message_name : NAMES) {
+            const mavlink_msg_entry_t *entry = search_entry(message_name.msgid);
+            if (entry != nullptr) {
+                name_of_entry[size_t(entry - ENTRIES)] = message_name.name;
+            }
+        }
+#endif
+    }
+
+    // Index into ENTRIES plus one, 0 if there is no such message.
+    std::array<uint16_t, MAVLinkMessageTable::NUM_DIRECT_IDS> entry_of_id {};
+    std::array<const char *, NUM_ENTRIES> name_of_entry {};
+};
+
+const Index &index()
+{
+    static const Index index;
+    return index;
+}
+
+} // namespace
+
+const mavlink_msg_entry_t *MAVLinkMessageTable::entry(uint32_t message_id)
+{
+    if (message_id < NUM_DIRECT_IDS) {
+        const uint16_t entry_plus_one = index().entry_of_id[message_id];
+        return (entry_plus_one != 0) ? &ENTRIES[entry_plus_one - 1] : nullptr;
+    }
+    return search_entry(message_id);
+}
+
+const char *MAVLinkMessageTable::name(uint32_t message_id)
+{
+    const mavlink_msg_entry_t *found = entry(message_id);
+    if (found == nullptr) {
+        return nullptr;
+    }
+    return index().name_of_entry[size_t(found - ENTRIES)];
+}
+
+size_t MAVLinkMessageTable::size()
+{
+    return NUM_ENTRIES;
+}
+
+} // namespace dronecore
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "mavlink_include.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace dronecore {
+
+// Metadata of the messages of the dialect in use: payload lengths, CRC extra,
+// target offsets and names.
+//
+// The entries are the constant table of the dialect header. For ids below
+// NUM_DIRECT_IDS, which all messages of common have, a lookup is a read of a
+// dense index built once from them, instead of the binary search of
+// mavlink_get_msg_entry(). Only higher ids are still searched.
+class MAVLinkMessageTable
+{
+public:
+    // Also the size of the other tables indexed directly by message id.
+    static constexpr uint32_t NUM_DIRECT_IDS = 16384;
+
+    // nullptr if the dialect has no such message.
+    static const mavlink_msg_entry_t *entry(uint32_t message_id);
+
+    // nullptr if the dialect has no such message, or its header comes without
+    // names (MAVLINK_MESSAGE_NAMES).
+    static const char *name(uint32_t message_id);
+
+    // Number of messages of the dialect.
+    static size_t size();
+};
+
+} // namespace dronecore
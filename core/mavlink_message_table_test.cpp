@@ -0,0 +1,34 @@
+#include "mavlink_message_table.h"
+#include <gtest/gtest.h>
+#include <cstring>
+
+using namespace dronecore;
+
+TEST(MAVLinkMessageTable, FindsSameAsMavlink)
+{
+    // All ids of the direct index and some beyond, which are searched.
+    for (uint32_t id = 0; id < 4 * MAVLinkMessageTable::NUM_DIRECT_IDS; ++id) {
+        const mavlink_msg_entry_t *expected = mavlink_get_msg_entry(id);
+        const mavlink_msg_entry_t *entry = MAVLinkMessageTable::entry(id);
+        ASSERT_EQ(entry == nullptr, expected == nullptr) << id;
+        if (entry != nullptr) {
+            EXPECT_EQ(entry->msgid, id);
+            EXPECT_EQ(entry->crc_extra, expected->crc_extra);
+            EXPECT_EQ(entry->max_msg_len, expected->max_msg_len);
+            EXPECT_EQ(entry->flags, expected->flags);
+        }
+    }
+    EXPECT_EQ(MAVLinkMessageTable::entry(MAVLINK_MSG_ID_HEARTBEAT)->max_msg_len,
+              MAVLINK_MSG_ID_HEARTBEAT_LEN);
+    EXPECT_GT(MAVLinkMessageTable::size(), 0u);
+}
+
+TEST(MAVLinkMessageTable, HasNames)
+{
+#ifdef MAVLINK_MESSAGE_NAMES
+    ASSERT_NE(MAVLinkMessageTable::name(MAVLINK_MSG_ID_HEARTBEAT), nullptr);
+    EXPECT_STREQ(MAVLinkMessageTable::name(MAVLINK_MSG_ID_HEARTBEAT), "HEARTBEAT");
+    EXPECT_STREQ(MAVLinkMessageTable::name(MAVLINK_MSG_ID_COMMAND_LONG), "COMMAND_LONG");
+#endif
+    EXPECT_EQ(MAVLinkMessageTable::name(UINT32_MAX), nullptr);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "mavlink_include.h"
+#include <cstdint>
+
+namespace dronecore {
+
+// Maps a decoded MAVLink message struct to its id and decode function, so that
+// typed handlers can be registered with just the struct type, see
+// MAVLinkSystem::register_mavlink_message_handler<T>().
+//
+// Only messages with a specialization below can be used that way. Adding one is
+// a single DRONECORE_MAVLINK_MESSAGE_TRAITS line.
+template<typename T>
+struct MAVLinkMessageTraits;
+
+#define DRONECORE_MAVLINK_MESSAGE_TRAITS(name, NAME) \
+    template<> \
+    struct MAVLinkMessageTraits<mavlink_##name##_t> { \
+        static constexpr uint32_t id = MAVLINK_MSG_ID_##NAME; \
+        static void decode(const mavlink_message_t &message, void *decoded) \
+        { \
+            mavlink_msg_##name##_decode(&message, static_cast<mavlink_##name##_t *>(decoded)); \
+        } \
+    }
+
+DRONECORE_MAVLINK_MESSAGE_TRAITS(heartbeat, HEARTBEAT);
+DRONECORE_MAVLINK_MESSAGE_TRAITS(sys_status, SYS_STATUS);
+DRONECORE_MAVLINK_MESSAGE_TRAITS(extended_sys_state, EXTENDED_SYS_STATE);
+DRONECORE_MAVLINK_MESSAGE_TRAITS(autopilot_version, AUTOPILOT_VERSION);
+DRONECORE_MAVLINK_MESSAGE_TRAITS(statustext, STATUSTEXT);
+DRONECORE_MAVLINK_MESSAGE_TRAITS(command_ack, COMMAND_ACK);
+DRONECORE_MAVLINK_MESSAGE_TRAITS(global_position_int, GLOBAL_POSITION_INT);
+DRONECORE_MAVLINK_MESSAGE_TRAITS(home_position, HOME_POSITION);
+DRONECORE_MAVLINK_MESSAGE_TRAITS(attitude, ATTITUDE);
+DRONECORE_MAVLINK_MESSAGE_TRAITS(attitude_quaternion, ATTITUDE_QUATERNION);
+DRONECORE_MAVLINK_MESSAGE_TRAITS(mount_orientation, MOUNT_ORIENTATION);
+DRONECORE_MAVLINK_MESSAGE_TRAITS(gps_raw_int, GPS_RAW_INT);
+DRONECORE_MAVLINK_MESSAGE_TRAITS(rc_channels, RC_CHANNELS);
+DRONECORE_MAVLINK_MESSAGE_TRAITS(highres_imu, HIGHRES_IMU);
+DRONECORE_MAVLINK_MESSAGE_TRAITS(odometry, ODOMETRY);
+
+#undef DRONECORE_MAVLINK_MESSAGE_TRAITS
+
+} // namespace dronecore
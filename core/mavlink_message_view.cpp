@@ -0,0 +1,82 @@
+#include "mavlink_message_view.h"
+#include "mavlink_message_table.h"
+
+namespace dronecore {
+
+MAVLinkMessageView::MAVLinkMessageView(const uint8_t *frame, mavlink_message_t &storage) :
+    _frame(frame),
+    _payload(nullptr),
+    _payload_len(frame[1]),
+    _sysid(0),
+    _compid(0),
+    _seq(0),
+    _msgid(0),
+    _storage(&storage),
+    _materialized(false)
+{
+    if (frame[0] == MAVLINK_STX) {
+        _seq = frame[4];
+        _sysid = frame[5];
+        _compid = frame[6];
+        _msgid = uint32_t(frame[7]) | (uint32_t(frame[8]) << 8) | (uint32_t(frame[9]) << 16);
+        _payload = &frame[MAVLINK_NUM_HEADER_BYTES];
+    } else {
+        _seq = frame[2];
+        _sysid = frame[3];
+        _compid = frame[4];
+        _msgid = frame[5];
+        _payload = &frame[MAVLINK_CORE_HEADER_MAVLINK1_LEN + 1];
+    }
+}
+
+MAVLinkMessageView::MAVLinkMessageView(const mavlink_message_t &message) :
+    _frame(nullptr),
+    _payload(reinterpret_cast<const uint8_t *>(_MAV_PAYLOAD(&message))),
+    _payload_len(message.len),
+    _sysid(message.sysid),
+    _compid(message.compid),
+    _seq(message.seq),
+    _msgid(message.msgid),
+    // We never write to it because it is already materialized.
+    _storage(const_cast<mavlink_message_t *>(&message)),
+    _materialized(true)
+{}
+
+const mavlink_message_t &MAVLinkMessageView::message() const
+{
+    if (!_materialized) {
+        materialize();
+        _materialized = true;
+    }
+    return *_storage;
+}
+
+void MAVLinkMessageView::materialize() const
+{
+    const bool is_mavlink1 = (_frame[0] == MAVLINK_STX_MAVLINK1);
+
+    _storage->magic = _frame[0];
+    _storage->len = _payload_len;
+    _storage->incompat_flags = is_mavlink1 ? 0 : _frame[2];
+    _storage->compat_flags = is_mavlink1 ? 0 : _frame[3];
+    _storage->seq = _seq;
+    _storage->sysid = _sysid;
+    _storage->compid = _compid;
+    _storage->msgid = _msgid;
+
+    const uint8_t *checksum = &_payload[_payload_len];
+    _storage->ck[0] = checksum[0];
+    _storage->ck[1] = checksum[1];
+    _storage->checksum = uint16_t(checksum[0]) | (uint16_t(checksum[1]) << 8);
+
+    // Zero-fill like mavlink does, because MAVLink 2 trims trailing zeros.
+    char *payload = _MAV_PAYLOAD_NON_CONST(_storage);
+    memcpy(payload, _payload, _payload_len);
+
+    const mavlink_msg_entry_t *entry = MAVLinkMessageTable::entry(_msgid);
+    if (entry != nullptr && _payload_len < entry->max_msg_len) {
+        memset(&payload[_payload_len], 0, entry->max_msg_len - _payload_len);
+    }
+}
+
+} // namespace dronecore
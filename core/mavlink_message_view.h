@@ -0,0 +1,83 @@
+#pragma once
+
+#include "mavlink_include.h"
+#include <cstdint>
+#include <cstring>
+
+namespace dronecore {
+
+// A MAVLinkMessageView gives read access to a received message without first
+// copying it into a mavlink_message_t. For frames taken straight from the
+// receive buffer, it points into that buffer. That means a view is only valid
+// during the dispatch of the message and must not be kept around.
+class MAVLinkMessageView
+{
+public:
+    // View onto a complete and CRC checked MAVLink 1 or 2 frame. The storage is
+    // only filled if the full message is requested using message().
+    MAVLinkMessageView(const uint8_t *frame, mavlink_message_t &storage);
+
+    // View onto a message which has already been parsed.
+    explicit MAVLinkMessageView(const mavlink_message_t &message);
+
+    uint8_t sysid() const { return _sysid; }
+    uint8_t compid() const { return _compid; }
+    uint32_t msgid() const { return _msgid; }
+    uint8_t seq() const { return _seq; }
+    bool is_mavlink1() const
+    {
+        return (_frame ? _frame[0] : _storage->magic) == MAVLINK_STX_MAVLINK1;
+    }
+
+    const uint8_t *payload() const { return _payload; }
+    uint8_t payload_len() const { return _payload_len; }
+
+    // The frame as received, nullptr for a message which has already been
+    // parsed. The frame is never signed.
+    const uint8_t *frame() const { return _frame; }
+    unsigned frame_len() const
+    {
+        return _frame ? unsigned(_payload - _frame) + _payload_len + MAVLINK_NUM_CHECKSUM_BYTES : 0;
+    }
+
+    // Reads a field at its offset in the (wire ordered) payload.
+    // MAVLink 2 trims trailing zeros so anything past the payload reads as 0.
+    template<typename T>
+    T get(unsigned offset) const
+    {
+        T value {};
+        if (offset < _payload_len) {
+            const unsigned available = _payload_len - offset;
+            memcpy(&value, &_payload[offset], (sizeof(T) < available) ? sizeof(T) : available);
+        }
+        return value;
+    }
+
+    // The full message, which is copied out of the frame on first use.
+    const mavlink_message_t &message() const;
+
+private:
+    void materialize() const;
+
+    const uint8_t *_frame;
+    const uint8_t *_payload;
+    uint8_t _payload_len;
+    uint8_t _sysid;
+    uint8_t _compid;
+    uint8_t _seq;
+    uint32_t _msgid;
+
+    mavlink_message_t *_storage;
+    mutable bool _materialized;
+};
+
+// Offsets of the HEARTBEAT fields on the wire, as used by mavlink_msg_heartbeat_get_*.
+namespace heartbeat_offset {
+static constexpr unsigned custom_mode = 0;
+static constexpr unsigned type = 4;
+static constexpr unsigned autopilot = 5;
+static constexpr unsigned base_mode = 6;
+static constexpr unsigned system_status = 7;
+} // namespace heartbeat_offset
+
+} // namespace dronecore
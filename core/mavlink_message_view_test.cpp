@@ -0,0 +1,48 @@
+#include "mavlink_message_view.h"
+#include <gtest/gtest.h>
+
+using namespace dronecore;
+
+TEST(MAVLinkMessageView, FromParsedMessage)
+{
+    mavlink_message_t message;
+    mavlink_msg_heartbeat_pack(3, 1, &message, MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_PX4,
+                               MAV_MODE_FLAG_SAFETY_ARMED, 42, 0);
+
+    MAVLinkMessageView view(message);
+    EXPECT_EQ(view.sysid(), 3);
+    EXPECT_EQ(view.compid(), 1);
+    EXPECT_EQ(view.msgid(), uint32_t(MAVLINK_MSG_ID_HEARTBEAT));
+    EXPECT_EQ(view.get<uint32_t>(heartbeat_offset::custom_mode), 42u);
+    EXPECT_EQ(view.get<uint8_t>(heartbeat_offset::base_mode), MAV_MODE_FLAG_SAFETY_ARMED);
+    EXPECT_EQ(&view.message(), &message);
+    EXPECT_EQ(view.frame(), nullptr);
+    EXPECT_EQ(view.frame_len(), 0u);
+}
+
+TEST(MAVLinkMessageView, FromFrame)
+{
+    mavlink_message_t message;
+    mavlink_msg_heartbeat_pack(3, 1, &message, MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_PX4,
+                               MAV_MODE_FLAG_SAFETY_ARMED, 42, 0);
+
+    uint8_t frame[MAVLINK_MAX_PACKET_LEN];
+    const uint16_t frame_len = mavlink_msg_to_send_buffer(frame, &message);
+
+    mavlink_message_t storage {};
+    MAVLinkMessageView view(frame, storage);
+    EXPECT_EQ(view.sysid(), 3);
+    // For forwarding as it is.
+    EXPECT_EQ(view.frame(), frame);
+    EXPECT_EQ(view.frame_len(), frame_len);
+    EXPECT_EQ(view.get<uint32_t>(heartbeat_offset::custom_mode), 42u);
+
+    // Trimmed trailing zeros and anything past the end read as 0.
+    EXPECT_EQ(view.get<uint8_t>(heartbeat_offset::system_status), 0);
+    EXPECT_EQ(view.get<uint32_t>(200), 0u);
+
+    // Nothing copied until requested.
+    EXPECT_EQ(storage.msgid, 0u);
+    EXPECT_EQ(mavlink_msg_heartbeat_get_custom_mode(&view.message()), 42u);
+    EXPECT_EQ(storage.msgid, uint32_t(MAVLINK_MSG_ID_HEARTBEAT));
+}
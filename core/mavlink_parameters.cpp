@@ -1,8 +1,24 @@
 #include "mavlink_parameters.h"
 #include "mavlink_system.h"
+#include "trace_recorder.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <sstream>
 
 namespace dronecore {
 
+constexpr double MAVLinkParameters::PARAM_CACHE_MAX_AGE_S;
+constexpr double MAVLinkParameters::FETCH_TIMEOUT_S;
+constexpr int MAVLinkParameters::FETCH_MAX_RETRIES;
+constexpr unsigned MAVLinkParameters::FETCH_MAX_REQUESTS_PER_RETRY;
+constexpr const char *MAVLinkParameters::PARAM_HASH_NAME;
+constexpr unsigned MAVLinkParameters::DEFAULT_MAX_IN_FLIGHT;
+constexpr double MAVLinkParameters::PARAM_TIMEOUT_S;
+constexpr int MAVLinkParameters::PARAM_MAX_RETRIES;
+constexpr double MAVLinkParameters::HASH_TIMEOUT_S;
+
 MAVLinkParameters::MAVLinkParameters(MAVLinkSystem &parent) :
     _parent(parent)
 {
@@ -17,6 +33,11 @@ MAVLinkParameters::MAVLinkParameters(MAVLinkSystem &parent) :
     _parent.register_mavlink_message_handler(
         MAVLINK_MSG_ID_PARAM_EXT_ACK,
         std::bind(&MAVLinkParameters::process_param_ext_ack, this, std::placeholders::_1), this);
+
+    const char *cache_dir = std::getenv("DRONECORE_PARAM_CACHE_DIR");
+    if (cache_dir != nullptr) {
+        _persistent_cache_dir = cache_dir;
+    }
 }
 
 MAVLinkParameters::~MAVLinkParameters()
@@ -27,7 +48,8 @@ MAVLinkParameters::~MAVLinkParameters()
 void MAVLinkParameters::set_param_async(const std::string &name,
                                         const ParamValue &value,
                                         set_param_callback_t callback,
-                                        bool extended)
+                                        bool extended,
+                                        uint8_t component_id)
 {
     // if (value.is_float()) {
     //     LogDebug() << "setting param " << name << " to " << value.get_float();
@@ -35,7 +57,8 @@ void MAVLinkParameters::set_param_async(const std::string &name,
     //     LogDebug() << "setting param " << name << " to " << value.get_int();
     // }
 
-    if (name.size() > PARAM_ID_LEN) {
+    ParamId param_id;
+    if (!ParamId::from_name(name, param_id)) {
         LogErr() << "Error: param name too long";
         if (callback) {
             callback(false);
@@ -43,24 +66,31 @@ void MAVLinkParameters::set_param_async(const std::string &name,
         return;
     }
 
-    SetParamWork new_work;
-    new_work.callback = callback;
-    new_work.param_name = name;
+    // Until it's confirmed, we don't know which value the param has.
+    uncache_param(param_id);
+
+    Work new_work;
+    new_work.type = Work::Type::SET;
+    new_work.set_callback = callback;
+    new_work.param_id = param_id;
     new_work.param_value = value;
     new_work.extended = extended;
+    new_work.component_id = extended ? component_id : 0;
 
-    _set_param_queue.push_back(new_work);
-
+    _new_work.push(std::move(new_work));
+    _parent.trigger_work();
 }
 
 
 void MAVLinkParameters::get_param_async(const std::string &name,
                                         get_param_callback_t callback,
-                                        bool extended)
+                                        bool extended,
+                                        uint8_t component_id)
 {
     // LogDebug() << "getting param " << name << ", extended: " << (extended ? "yes" : "no");
 
-    if (name.size() > PARAM_ID_LEN) {
+    ParamId param_id;
+    if (!ParamId::from_name(name, param_id)) {
         LogErr() << "Error: param name too long";
         if (callback) {
             ParamValue empty_param;
@@ -69,12 +99,255 @@ void MAVLinkParameters::get_param_async(const std::string &name,
         return;
     }
 
-    GetParamWork new_work;
-    new_work.callback = callback;
-    new_work.param_name = name;
+    if (!extended) {
+        ParamValue cached_value;
+        if (get_cached_param(param_id, cached_value)) {
+            if (callback) {
+                callback(true, cached_value);
+            }
+            return;
+        }
+    }
+
+    Work new_work;
+    new_work.type = Work::Type::GET;
+    new_work.get_callback = callback;
+    new_work.param_id = param_id;
     new_work.extended = extended;
+    new_work.component_id = extended ? component_id : 0;
 
-    _get_param_queue.push_back(new_work);
+    _new_work.push(std::move(new_work));
+    _parent.trigger_work();
+}
+
+void MAVLinkParameters::get_params_async(const std::vector<std::string> &names,
+                                         get_params_callback_t callback)
+{
+    auto group = std::make_shared<ParamGroup>();
+    group->names = names;
+    group->callback = callback;
+    group->num_remaining = names.size();
+
+    {
+        std::lock_guard<std::mutex> lock(_cache_mutex);
+        if (!_loaded_params.empty()) {
+            _groups_waiting_for_hash.push_back(group);
+            return;
+        }
+    }
+
+    start_group(group);
+}
+
+void MAVLinkParameters::start_group(const std::shared_ptr<ParamGroup> &group)
+{
+    if (group->names.empty()) {
+        if (group->callback) {
+            group->callback(true, group->values);
+        }
+        return;
+    }
+
+    bool queued = false;
+    for (size_t i = 0; i < group->names.size(); ++i) {
+        ParamId param_id;
+        ParamValue cached_value;
+        if (!ParamId::from_name(group->names[i], param_id)) {
+            LogErr() << "Error: param name too long";
+            finish_group_param(group, i, false, ParamValue());
+            continue;
+        }
+        if (get_cached_param(param_id, cached_value)) {
+            finish_group_param(group, i, true, cached_value);
+            continue;
+        }
+
+        Work new_work;
+        new_work.type = Work::Type::GET;
+        new_work.get_callback = [group, i](bool success, ParamValue value) {
+            finish_group_param(group, i, success, value);
+        };
+        new_work.param_id = param_id;
+        new_work.is_prioritized = true;
+
+        _new_work.push(std::move(new_work));
+        queued = true;
+    }
+
+    if (queued) {
+        _parent.trigger_work();
+    }
+}
+
+void MAVLinkParameters::finish_group_param(const std::shared_ptr<ParamGroup> &group,
+                                           size_t index, bool success, ParamValue value)
+{
+    get_params_callback_t callback;
+    {
+        std::lock_guard<std::mutex> lock(group->mutex);
+        if (success) {
+            group->values[group->names[index]] = value;
+        } else {
+            group->success = false;
+        }
+        if (--group->num_remaining > 0) {
+            return;
+        }
+        callback = group->callback;
+    }
+
+    // Nothing changes the group once all params are in.
+    if (callback) {
+        callback(group->success, group->values);
+    }
+}
+
+void MAVLinkParameters::set_params_async(const std::map<std::string, ParamValue> &params,
+                                         set_params_callback_t callback)
+{
+    auto param_set = std::make_shared<ParamSet>();
+    param_set->callback = callback;
+
+    for (const auto &param : params) {
+        ParamId param_id;
+        if (!ParamId::from_name(param.first, param_id)) {
+            LogErr() << "Error: param name too long";
+            param_set->results[param.first] = SetParamResult::FAILED;
+            param_set->success = false;
+            continue;
+        }
+
+        ParamValue cached_value;
+        if (get_cached_param(param_id, cached_value) && cached_value == param.second) {
+            param_set->results[param.first] = SetParamResult::UNCHANGED;
+            continue;
+        }
+
+        param_set->names.push_back(param.first);
+        param_set->ids.push_back(param_id);
+        param_set->values.push_back(param.second);
+    }
+
+    // Counted before any of them goes out, they can be answered right away.
+    param_set->num_remaining = param_set->names.size();
+    if (param_set->num_remaining == 0) {
+        if (callback) {
+            callback(param_set->success, param_set->results);
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < param_set->names.size(); ++i) {
+        // Until it's confirmed, we don't know which value the param has.
+        uncache_param(param_set->ids[i]);
+
+        Work new_work;
+        new_work.type = Work::Type::SET;
+        new_work.get_callback = [param_set, i](bool success, ParamValue value) {
+            finish_set_param(param_set, i, success, value);
+        };
+        new_work.param_id = param_set->ids[i];
+        new_work.param_value = param_set->values[i];
+
+        _new_work.push(std::move(new_work));
+    }
+
+    _parent.trigger_work();
+}
+
+void MAVLinkParameters::finish_set_param(const std::shared_ptr<ParamSet> &param_set,
+                                         size_t index, bool success, ParamValue echoed_value)
+{
+    set_params_callback_t callback;
+    {
+        std::lock_guard<std::mutex> lock(param_set->mutex);
+
+        SetParamResult result = SetParamResult::FAILED;
+        if (success) {
+            // The vehicle may have clamped or refused the value.
+            result = (echoed_value == param_set->values[index]) ? SetParamResult::CHANGED :
+                     SetParamResult::MISMATCH;
+        }
+        if (result != SetParamResult::CHANGED) {
+            LogWarn() << "Setting param " << param_set->names[index] << " failed";
+            param_set->success = false;
+        }
+        param_set->results[param_set->names[index]] = result;
+
+        if (--param_set->num_remaining > 0) {
+            return;
+        }
+        callback = param_set->callback;
+    }
+
+    // Nothing changes the set once all params are in.
+    if (callback) {
+        callback(param_set->success, param_set->results);
+    }
+}
+
+bool MAVLinkParameters::read_param_file(const std::string &path,
+                                        std::map<std::string, ParamValue> &params)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        LogErr() << "Could not open param file: " << path;
+        return false;
+    }
+
+    std::string line;
+    unsigned line_number = 0;
+    while (std::getline(file, line)) {
+        ++line_number;
+        const size_t begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos || line[begin] == '#') {
+            continue;
+        }
+
+        std::istringstream fields(line);
+        unsigned system_id;
+        unsigned component_id;
+        std::string name;
+        std::string value_str;
+        unsigned type;
+        if (!(fields >> system_id >> component_id >> name >> value_str >> type) ||
+            name.size() > ParamId::MAX_LEN) {
+            LogErr() << "Invalid line " << line_number << " in param file: " << path;
+            return false;
+        }
+
+        if (component_id != _parent.get_autopilot_id()) {
+            continue;
+        }
+
+        // Parsed without std::stof and friends, which abort on garbage here.
+        const char *value_begin = value_str.c_str();
+        char *value_end = nullptr;
+        ParamValue value;
+        switch (type) {
+            case MAV_PARAM_TYPE_REAL32:
+                value.set_float(strtof(value_begin, &value_end));
+                break;
+            case MAV_PARAM_TYPE_INT8:
+            case MAV_PARAM_TYPE_UINT8:
+            case MAV_PARAM_TYPE_INT16:
+            case MAV_PARAM_TYPE_UINT16:
+            case MAV_PARAM_TYPE_INT32:
+            case MAV_PARAM_TYPE_UINT32:
+                // All integers are sent as INT32, like the vehicle reports them.
+                value.set_int32(int32_t(strtoll(value_begin, &value_end, 10)));
+                break;
+            default:
+                LogErr() << "Unsupported type " << type << " of " << name << " in param file";
+                return false;
+        }
+        if (value_end == value_begin || *value_end != '\0') {
+            LogErr() << "Invalid value of " << name << " in param file: " << value_str;
+            return false;
+        }
+        params[name] = value;
+    }
+    return true;
 }
 
 //void MAVLinkParameters::save_async()
@@ -83,37 +356,94 @@ void MAVLinkParameters::get_param_async(const std::string &name,
 //                          MAVLinkCommands::Params {1.0f, 1.0f, 0.0f, NAN, NAN, NAN, NAN});
 //}
 
+void MAVLinkParameters::set_max_params_in_flight(unsigned max_in_flight)
+{
+    std::lock_guard<std::mutex> lock(_work_mutex);
+    _max_in_flight = (max_in_flight > 0) ? max_in_flight : 1;
+}
+
+size_t MAVLinkParameters::num_work()
+{
+    std::lock_guard<std::mutex> lock(_work_mutex);
+    return _queued_work.size() + _in_flight_work.size();
+}
+
 void MAVLinkParameters::do_work()
 {
-    std::lock_guard<std::mutex> lock(_state_mutex);
+    std::vector<Report> reports;
+    {
+        std::lock_guard<std::mutex> lock(_work_mutex);
+
+        Work new_work;
+        while (_new_work.try_pop(new_work)) {
+            if (new_work.is_prioritized) {
+                auto it = std::find_if(_queued_work.begin(), _queued_work.end(),
+                [](const Work & work) { return !work.is_prioritized; });
+                _queued_work.insert(it, std::move(new_work));
+            } else {
+                _queued_work.push_back(std::move(new_work));
+            }
+        }
 
-    if (_state != State::NONE) {
-        // If we're still busy, let's wait
-        return;
+        // Fill the window with whatever does not have to wait for a request of
+        // the same param, keeping the order for the same param.
+        for (auto it = _queued_work.begin();
+             it != _queued_work.end() && _in_flight_work.size() < _max_in_flight;
+             /* no ++it */) {
+
+            if (find_in_flight(it->param_id, it->extended, it->component_id) !=
+                _in_flight_work.end()) {
+                ++it;
+                continue;
+            }
+
+            Work &work = *it;
+
+            if (!send_work(work)) {
+                LogErr() << "Error: Send message failed";
+                reports.push_back(Report {work.set_callback, work.get_callback, false,
+                                          ParamValue()});
+                it = _queued_work.erase(it);
+                continue;
+            }
+
+            _in_flight_work.push_back(work);
+            Work &in_flight = _in_flight_work.back();
+            in_flight.sent_time = _parent.get_time().steady_time();
+            in_flight.timeout_s = _parent.rtt_estimator().timeout_s(PARAM_TIMEOUT_S);
+            trace_sent(in_flight);
+            _parent.register_timeout_handler(
+                std::bind(&MAVLinkParameters::receive_timeout, this,
+                          in_flight.param_id, in_flight.extended, in_flight.component_id),
+                in_flight.timeout_s, &in_flight.timeout_cookie);
+
+            it = _queued_work.erase(it);
+        }
     }
 
-    if (_set_param_queue.size() > 0) {
-        // There params to set which we always do first
-        SetParamWork &work = _set_param_queue.front();
+    call_back(reports);
+}
 
-        // We need to wait for this param to get sent back as confirmation.
-        _state = State::SET_PARAM_BUSY;
+bool MAVLinkParameters::send_work(const Work &work)
+{
+    // We assume that we already acquired _work_mutex in this function.
 
-        char param_id[PARAM_ID_LEN] = {};
-        STRNCPY(param_id, work.param_name.c_str(), sizeof(param_id));
+    // Padded to the 16 bytes of the message already.
+    const char *param_id = work.param_id.c_str();
 
-        mavlink_message_t message = {};
+    mavlink_message_t message = {};
+
+    if (work.type == Work::Type::SET) {
         if (work.extended) {
 
             char param_value_buf[128] = {};
             work.param_value.get_128_bytes(param_value_buf);
 
-            // FIXME: extended currently always go to the camera component
             mavlink_msg_param_ext_set_pack(GCSClient::system_id,
                                            GCSClient::component_id,
                                            &message,
                                            _parent.get_system_id(),
-                                           MAV_COMP_ID_CAMERA,
+                                           work.component_id,
                                            param_id,
                                            param_value_buf,
                                            work.param_value.get_mav_param_ext_type());
@@ -128,54 +458,16 @@ void MAVLinkParameters::do_work()
                                        work.param_value.get_4_float_bytes(),
                                        work.param_value.get_mav_param_type());
         }
-
-        if (!_parent.send_message(message)) {
-            LogErr() << "Error: Send message failed";
-            if (work.callback) {
-                work.callback(false);
-            }
-            _state = State::NONE;
-            return;
-        }
-
-        // _last_request_time = _parent.get_time().steady_time();
-
-        // We want to get notified if a timeout happens
-        _parent.register_timeout_handler(std::bind(&MAVLinkParameters::receive_timeout, this),
-                                         0.5,
-                                         &_timeout_cookie);
-
-    } else if (_get_param_queue.size() > 0) {
-
-        GetParamWork work = _get_param_queue.front();
-
-        // The busy flag gets reset when the param comes in
-        // or after a timeout.
-        _state = State::GET_PARAM_BUSY;
-
-        char param_id[PARAM_ID_LEN] = {};
-        STRNCPY(param_id, work.param_name.c_str(), sizeof(param_id));
-
-        // LogDebug() << "now getting: " << work.param_name;
-
-        mavlink_message_t message = {};
+    } else {
         if (work.extended) {
             mavlink_msg_param_ext_request_read_pack(GCSClient::system_id,
                                                     GCSClient::component_id,
                                                     &message,
                                                     _parent.get_system_id(),
-                                                    MAV_COMP_ID_CAMERA,
+                                                    work.component_id,
                                                     param_id,
                                                     -1);
-
         } else {
-            //LogDebug() << "request read: "
-            //    << (int)GCSClient::system_id << ":"
-            //    << (int)GCSClient::component_id <<
-            //    " to "
-            //    << (int)_parent.get_system_id() << ":"
-            //    << (int)_parent.get_autopilot_id();
-
             mavlink_msg_param_request_read_pack(GCSClient::system_id,
                                                 GCSClient::component_id,
                                                 &message,
@@ -184,23 +476,64 @@ void MAVLinkParameters::do_work()
                                                 param_id,
                                                 -1);
         }
+    }
 
-        if (!_parent.send_message(message)) {
-            LogErr() << "Error: Send message failed";
-            if (work.callback) {
-                ParamValue empty_param;
-                work.callback(false, empty_param);
-            }
-            _state = State::NONE;
-            return;
+    return _parent.send_message(message);
+}
+
+std::list<MAVLinkParameters::Work>::iterator
+MAVLinkParameters::find_in_flight(const ParamId &param_id, bool extended, uint8_t component_id)
+{
+    // We assume that we already acquired _work_mutex in this function.
+
+    for (auto it = _in_flight_work.begin(); it != _in_flight_work.end(); ++it) {
+        if (it->param_id == param_id && it->extended == extended &&
+            it->component_id == component_id) {
+            return it;
         }
+    }
+    return _in_flight_work.end();
+}
+
+uint64_t MAVLinkParameters::trace_id_of(const Work &work) const
+{
+    // Only one request for a param of a component is in flight, so its name
+    // tells them apart.
+    const uint64_t name_hash = ParamId::Hash()(work.param_id);
+    return (uint64_t(_parent.get_system_id()) << 56) ^ (uint64_t(work.component_id) << 48) ^
+           (name_hash << 1) ^ uint64_t(work.extended);
+}
 
-        // _last_request_time = _parent.get_time().steady_time();
+const char *MAVLinkParameters::trace_name_of(const Work &work)
+{
+    return (work.type == Work::Type::SET) ? "param set" : "param get";
+}
+
+void MAVLinkParameters::trace_sent(const Work &work)
+{
+    TraceRecorder::async_begin("param", trace_name_of(work), trace_id_of(work),
+                               work.param_id.c_str());
+}
+
+void MAVLinkParameters::trace_step(const Work &work, const char *step)
+{
+    TraceRecorder::async_instant("param", step, trace_id_of(work));
+}
+
+void MAVLinkParameters::trace_finished(const Work &work, const char *result)
+{
+    TraceRecorder::async_end("param", trace_name_of(work), trace_id_of(work), result);
+}
 
-        // We want to get notified if a timeout happens
-        _parent.register_timeout_handler(std::bind(&MAVLinkParameters::receive_timeout, this),
-                                         0.5,
-                                         &_timeout_cookie);
+void MAVLinkParameters::call_back(const std::vector<Report> &reports)
+{
+    for (const auto &report : reports) {
+        if (report.set_callback) {
+            report.set_callback(report.success);
+        }
+        if (report.get_callback) {
+            report.get_callback(report.success, report.value);
+        }
     }
 }
 
@@ -211,219 +544,773 @@ void MAVLinkParameters::process_param_value(const mavlink_message_t &message)
     mavlink_param_value_t param_value;
     mavlink_msg_param_value_decode(&message, &param_value);
 
-    std::lock_guard<std::mutex> lock(_state_mutex);
+    const ParamId param_id = ParamId::from_mavlink(param_value.param_id);
 
-    if (_state == State::NONE) {
-        return;
+    // We only cache what the autopilot has, the camera has its own list.
+    if (message.compid == _parent.get_autopilot_id()) {
+        if (param_id == ParamId::from_mavlink(PARAM_HASH_NAME)) {
+            uint32_t hash;
+            memcpy(&hash, &param_value.param_value, sizeof(hash));
+            process_param_hash(hash);
+        } else {
+            cache_param_value(param_id, param_value);
+        }
     }
 
-    if (_state == State::GET_PARAM_BUSY) {
+    std::vector<Report> reports;
+    {
+        std::lock_guard<std::mutex> lock(_work_mutex);
+
+        auto it = find_in_flight(param_id, false, 0);
+        if (it == _in_flight_work.end()) {
+            // Not for us, or it has timed out already.
+            return;
+        }
+
+        // A set is confirmed by the param value getting sent back.
+        ParamValue value;
+        value.set_from_mavlink_param_value(param_value);
+        reports.push_back(Report {it->set_callback, it->get_callback, true, value});
+        trace_finished(*it, "success");
+        sample_rtt(*it);
 
-        // This means we should have a queue entry to use
-        if (_get_param_queue.size() > 0) {
-            GetParamWork &work = _get_param_queue.front();
+        _parent.unregister_timeout_handler(it->timeout_cookie);
+        _in_flight_work.erase(it);
+    }
 
-            if (strncmp(work.param_name.c_str(), param_value.param_id, PARAM_ID_LEN) == 0) {
+    call_back(reports);
 
-                if (work.callback) {
-                    ParamValue value;
-                    value.set_from_mavlink_param_value(param_value);
-                    work.callback(true, value);
-                }
-                _state = State::NONE;
-                _parent.unregister_timeout_handler(_timeout_cookie);
-                // LogDebug() << "time taken: " << _parent.get_time().elapsed_since_s(_last_request_time);
-                _get_param_queue.pop_front();
-            }
+    // The next one can go out now.
+    _parent.trigger_work();
+}
+
+void MAVLinkParameters::process_param_ext_value(const mavlink_message_t &message)
+{
+    // LogDebug() << "getting param ext value";
+    mavlink_param_ext_value_t param_ext_value;
+    mavlink_msg_param_ext_value_decode(&message, &param_ext_value);
+
+    process_ext_fetch_value(param_ext_value, message.compid);
+
+    std::vector<Report> reports;
+    {
+        std::lock_guard<std::mutex> lock(_work_mutex);
+
+        auto it = find_in_flight(ParamId::from_mavlink(param_ext_value.param_id), true,
+                                 message.compid);
+        // Extended sets are confirmed by PARAM_EXT_ACK instead.
+        if (it == _in_flight_work.end() || it->type != Work::Type::GET) {
+            return;
         }
+
+        ParamValue value;
+        value.set_from_mavlink_param_ext_value(param_ext_value);
+        reports.push_back(Report {nullptr, it->get_callback, true, value});
+        trace_finished(*it, "success");
+        sample_rtt(*it);
+
+        _parent.unregister_timeout_handler(it->timeout_cookie);
+        _in_flight_work.erase(it);
     }
 
-    else if (_state == State::SET_PARAM_BUSY) {
+    call_back(reports);
 
-        // This means we should have a queue entry to use
-        if (_set_param_queue.size() > 0) {
-            SetParamWork &work = _set_param_queue.front();
+    // The next one can go out now.
+    _parent.trigger_work();
+}
 
-            // Now it still needs to match the param name
-            if (strncmp(work.param_name.c_str(), param_value.param_id, PARAM_ID_LEN) == 0) {
+void MAVLinkParameters::process_param_ext_ack(const mavlink_message_t &message)
+{
+    // LogDebug() << "getting param ext ack";
 
-                // We are done, inform caller and go back to idle
-                if (work.callback) {
-                    work.callback(true);
-                }
+    mavlink_param_ext_ack_t param_ext_ack;
+    mavlink_msg_param_ext_ack_decode(&message, &param_ext_ack);
+
+    std::vector<Report> reports;
+    {
+        std::lock_guard<std::mutex> lock(_work_mutex);
+
+        auto it = find_in_flight(ParamId::from_mavlink(param_ext_ack.param_id), true,
+                                 message.compid);
+        if (it == _in_flight_work.end() || it->type != Work::Type::SET) {
+            return;
+        }
+
+        sample_rtt(*it);
+
+        if (param_ext_ack.param_result == PARAM_ACK_IN_PROGRESS) {
+            trace_step(*it, "in progress");
+            // Reset timeout and wait again.
+            _parent.refresh_timeout_handler(it->timeout_cookie);
+            return;
+        }
+
+        if (param_ext_ack.param_result == PARAM_ACK_ACCEPTED) {
+            reports.push_back(Report {it->set_callback, nullptr, true, ParamValue()});
+            trace_finished(*it, "success");
+        } else {
+            LogErr() << "Somehow we did not get an ack, we got: "
+                     << int(param_ext_ack.param_result);
+
+            // TODO: we need better error feedback
+            reports.push_back(Report {it->set_callback, nullptr, false, ParamValue()});
+            trace_finished(*it, "failed");
+        }
+
+        _parent.unregister_timeout_handler(it->timeout_cookie);
+        _in_flight_work.erase(it);
+    }
+
+    call_back(reports);
+
+    // The next one can go out now.
+    _parent.trigger_work();
+}
+
+void MAVLinkParameters::sample_rtt(Work &work)
+{
+    // We assume that we already acquired _work_mutex in this function.
+
+    if (work.retries_done > 0 || work.rtt_sampled) {
+        return;
+    }
+    work.rtt_sampled = true;
+    _parent.rtt_estimator().add_sample(_parent.get_time().elapsed_since_s(work.sent_time));
+}
 
-                _state = State::NONE;
-                _parent.unregister_timeout_handler(_timeout_cookie);
-                // LogDebug() << "time taken: " << _parent.get_time().elapsed_since_s(_last_request_time);
-                _set_param_queue.pop_front();
+void MAVLinkParameters::receive_timeout(const ParamId &param_id, bool extended,
+                                        uint8_t component_id)
+{
+    std::vector<Report> reports;
+    {
+        std::lock_guard<std::mutex> lock(_work_mutex);
+
+        auto it = find_in_flight(param_id, extended, component_id);
+        if (it == _in_flight_work.end()) {
+            // It has been answered meanwhile.
+            return;
+        }
+
+        Work &work = *it;
+
+        if (work.retries_done < PARAM_MAX_RETRIES) {
+            ++work.retries_done;
+            LogDebug() << "Retrying param " << work.param_id.c_str()
+                       << ", retries done: " << work.retries_done;
+
+            if (send_work(work)) {
+                trace_step(work, "retry");
+                work.timeout_s = RttEstimator::backed_off_s(work.timeout_s);
+                _parent.register_timeout_handler(
+                    std::bind(&MAVLinkParameters::receive_timeout, this,
+                              work.param_id, work.extended, work.component_id),
+                    work.timeout_s, &work.timeout_cookie);
+                return;
             }
+            LogErr() << "Error: Send message failed";
+            trace_finished(work, "send error");
+        } else {
+            LogErr() << "Error: param timeout: " << work.param_id.c_str();
+            trace_finished(work, "timeout");
         }
+
+        reports.push_back(Report {work.set_callback, work.get_callback, false, ParamValue()});
+        _in_flight_work.erase(it);
     }
+
+    call_back(reports);
+
+    // The next one can go out now.
+    _parent.trigger_work();
 }
 
-void MAVLinkParameters::process_param_ext_value(const mavlink_message_t &message)
+std::ostream &operator<<(std::ostream &strm, const MAVLinkParameters::ParamValue &obj)
 {
-    // LogDebug() << "getting param ext value";
-    mavlink_param_ext_value_t param_ext_value;
-    mavlink_msg_param_ext_value_decode(&message, &param_ext_value);
+    strm << obj.get_string();
+    return strm;
+}
 
-    std::lock_guard<std::mutex> lock(_state_mutex);
+void MAVLinkParameters::fetch_all_params_async(fetch_all_params_callback_t callback)
+{
+    {
+        std::lock_guard<std::mutex> lock(_cache_mutex);
 
-    if (_state == State::NONE) {
-        return;
+        if (_fetch.active) {
+            LogWarn() << "Already fetching all params";
+            if (callback) {
+                callback(false);
+            }
+            return;
+        }
+
+        _fetch.active = true;
+        _fetch.callback = callback;
+        _fetch.retries_done = 0;
+        // Start from scratch, so that we know what is missing later.
+        for (auto &cached : _cache_by_index) {
+            cached.valid = false;
+        }
+        // Before sending, so that the first value already finds the cookie.
+        register_fetch_timeout();
     }
 
-    if (_state == State::GET_PARAM_BUSY) {
+    if (!send_param_request_list()) {
+        LogErr() << "Error: Send message failed";
+        {
+            std::lock_guard<std::mutex> lock(_cache_mutex);
+            _fetch.active = false;
+            _fetch.callback = nullptr;
+            _parent.unregister_timeout_handler(_fetch.timeout_cookie);
+        }
+        if (callback) {
+            callback(false);
+        }
+    }
+}
 
-        // This means we should have a queue entry to use
-        if (_get_param_queue.size() > 0) {
-            GetParamWork &work = _get_param_queue.front();
+bool MAVLinkParameters::send_param_request_list()
+{
+    mavlink_message_t message = {};
+    mavlink_msg_param_request_list_pack(GCSClient::system_id,
+                                        GCSClient::component_id,
+                                        &message,
+                                        _parent.get_system_id(),
+                                        _parent.get_autopilot_id());
+    return _parent.send_message(message);
+}
 
-            if (strncmp(work.param_name.c_str(), param_ext_value.param_id, PARAM_ID_LEN) == 0) {
+void MAVLinkParameters::register_fetch_timeout()
+{
+    // We assume that we already acquired _cache_mutex in this function.
+    _parent.register_timeout_handler(std::bind(&MAVLinkParameters::receive_fetch_timeout, this),
+                                     FETCH_TIMEOUT_S,
+                                     &_fetch.timeout_cookie);
+}
 
-                if (work.callback) {
-                    ParamValue value;
-                    value.set_from_mavlink_param_ext_value(param_ext_value);
-                    work.callback(true, value);
-                }
-                _state = State::NONE;
-                _parent.unregister_timeout_handler(_timeout_cookie);
-                // LogDebug() << "time taken: " << _parent.get_time().elapsed_since_s(_last_request_time);
-                _get_param_queue.pop_front();
+void MAVLinkParameters::fetch_all_ext_params_async(ext_param_value_callback_t value_callback,
+                                                   fetch_all_params_callback_t callback,
+                                                   uint8_t component_id)
+{
+    {
+        std::lock_guard<std::mutex> lock(_ext_fetch_mutex);
+
+        auto &ext_fetch = _ext_fetches[component_id];
+        if (ext_fetch.active) {
+            LogWarn() << "Already fetching all extended params of " << int(component_id);
+            if (callback) {
+                callback(false);
             }
+            return;
         }
+
+        ext_fetch.active = true;
+        ext_fetch.value_callback = value_callback;
+        ext_fetch.callback = callback;
+        ext_fetch.received.clear();
+        ext_fetch.num_received = 0;
+        // Before sending, so that the first value already finds the cookie.
+        _parent.register_timeout_handler(std::bind(&MAVLinkParameters::receive_ext_fetch_timeout,
+                                                   this, component_id),
+                                         FETCH_TIMEOUT_S,
+                                         &ext_fetch.timeout_cookie);
     }
 
-#if 0
-    else if (_state == State::SET_PARAM_BUSY) {
+    mavlink_message_t message = {};
+    mavlink_msg_param_ext_request_list_pack(GCSClient::system_id,
+                                            GCSClient::component_id,
+                                            &message,
+                                            _parent.get_system_id(),
+                                            component_id);
+
+    if (!_parent.send_message(message)) {
+        LogErr() << "Error: Send message failed";
+        {
+            std::lock_guard<std::mutex> lock(_ext_fetch_mutex);
+            auto &ext_fetch = _ext_fetches[component_id];
+            ext_fetch.active = false;
+            ext_fetch.value_callback = nullptr;
+            ext_fetch.callback = nullptr;
+            _parent.unregister_timeout_handler(ext_fetch.timeout_cookie);
+        }
+        if (callback) {
+            callback(false);
+        }
+    }
+}
 
-        // This means we should have a queue entry to use
-        if (_set_param_queue.size() > 0) {
-            SetParamWork &work = _set_param_queue.front();
+void MAVLinkParameters::process_ext_fetch_value(const mavlink_param_ext_value_t &param_ext_value,
+                                                uint8_t component_id)
+{
+    ext_param_value_callback_t value_callback;
+    fetch_all_params_callback_t callback;
+    {
+        std::lock_guard<std::mutex> lock(_ext_fetch_mutex);
 
-            // Now it still needs to match the param name
-            if (strncmp(work.param_name.c_str(), param_ext_value.param_id, PARAM_ID_LEN) == 0) {
+        auto it = _ext_fetches.find(component_id);
+        if (it == _ext_fetches.end() || !it->second.active) {
+            return;
+        }
+        auto &ext_fetch = it->second;
 
-                // We are done, inform caller and go back to idle
-                if (work.callback) {
-                    work.callback(true);
-                }
+        if (ext_fetch.received.empty()) {
+            ext_fetch.received.assign(param_ext_value.param_count, false);
+        }
 
-                _state = State::NONE;
-                _parent.unregister_timeout_handler(_timeout_cookie);
-                // LogDebug() << "time taken: " << _parent.get_time().elapsed_since_s(_last_request_time);
-                _set_param_queue.pop_front();
-            }
+        const size_t index = param_ext_value.param_index;
+        if (index < ext_fetch.received.size() && !ext_fetch.received[index]) {
+            ext_fetch.received[index] = true;
+            ++ext_fetch.num_received;
         }
+        value_callback = ext_fetch.value_callback;
+
+        if (ext_fetch.num_received >= ext_fetch.received.size()) {
+            ext_fetch.active = false;
+            callback = ext_fetch.callback;
+            ext_fetch.value_callback = nullptr;
+            ext_fetch.callback = nullptr;
+            _parent.unregister_timeout_handler(ext_fetch.timeout_cookie);
+        } else {
+            // The list is still coming, wait as long again after this value.
+            _parent.refresh_timeout_handler(ext_fetch.timeout_cookie);
+        }
+    }
+
+    if (value_callback) {
+        ParamValue value;
+        value.set_from_mavlink_param_ext_value(param_ext_value);
+        value_callback(ParamId::from_mavlink(param_ext_value.param_id).str(), value);
+    }
+
+    if (callback) {
+        callback(true);
     }
-#endif
 }
 
-void MAVLinkParameters::process_param_ext_ack(const mavlink_message_t &message)
+void MAVLinkParameters::receive_ext_fetch_timeout(uint8_t component_id)
 {
-    // LogDebug() << "getting param ext ack";
+    fetch_all_params_callback_t callback;
+    {
+        std::lock_guard<std::mutex> lock(_ext_fetch_mutex);
 
-    mavlink_param_ext_ack_t param_ext_ack;
-    mavlink_msg_param_ext_ack_decode(&message, &param_ext_ack);
+        auto it = _ext_fetches.find(component_id);
+        if (it == _ext_fetches.end() || !it->second.active) {
+            return;
+        }
+        auto &ext_fetch = it->second;
+
+        LogWarn() << "Fetching all extended params of " << int(component_id)
+                  << " stopped, got " << ext_fetch.num_received
+                  << " of " << ext_fetch.received.size();
+        ext_fetch.active = false;
+        callback = ext_fetch.callback;
+        ext_fetch.value_callback = nullptr;
+        ext_fetch.callback = nullptr;
+    }
+
+    if (callback) {
+        callback(false);
+    }
+}
 
-    std::lock_guard<std::mutex> lock(_state_mutex);
+void MAVLinkParameters::invalidate_param_cache()
+{
+    std::lock_guard<std::mutex> lock(_cache_mutex);
 
-    if (_state != State::SET_PARAM_BUSY) {
-        return;
+    _cache_by_index.clear();
+    _cache_index_by_id.clear();
+}
+
+bool MAVLinkParameters::get_cached_param(const ParamId &param_id, ParamValue &value)
+{
+    std::lock_guard<std::mutex> lock(_cache_mutex);
+
+    auto it = _cache_index_by_id.find(param_id);
+    if (it == _cache_index_by_id.end()) {
+        return false;
     }
 
-    // This means we should have a queue entry to use
-    if (_set_param_queue.size() > 0) {
-        SetParamWork &work = _set_param_queue.front();
+    const CachedParam &cached = _cache_by_index[it->second];
+    if (!cached.valid ||
+        _parent.get_time().elapsed_since_s(cached.time) > PARAM_CACHE_MAX_AGE_S) {
+        return false;
+    }
 
-        // Now it still needs to match the param name
-        if (strncmp(work.param_name.c_str(), param_ext_ack.param_id, PARAM_ID_LEN) == 0) {
+    value = cached.value;
+    return true;
+}
 
-            if (param_ext_ack.param_result == PARAM_ACK_ACCEPTED) {
-                // We are done, inform caller and go back to idle
-                if (work.callback) {
-                    work.callback(true);
-                }
+void MAVLinkParameters::uncache_param(const ParamId &param_id)
+{
+    std::lock_guard<std::mutex> lock(_cache_mutex);
 
-                _state = State::NONE;
-                _parent.unregister_timeout_handler(_timeout_cookie);
-                // LogDebug() << "time taken: " << _parent.get_time().elapsed_since_s(_last_request_time);
-                _set_param_queue.pop_front();
+    auto it = _cache_index_by_id.find(param_id);
+    if (it != _cache_index_by_id.end()) {
+        _cache_by_index[it->second].valid = false;
+    }
+}
 
-            } else if (param_ext_ack.param_result == PARAM_ACK_IN_PROGRESS) {
+void MAVLinkParameters::cache_param_value(const ParamId &param_id,
+                                          const mavlink_param_value_t &param_value)
+{
+    ParamValue value;
+    value.set_from_mavlink_param_value(param_value);
+
+    // Also for params we cannot keep, so that none is missed.
+    bool changed = true;
+    bool fetching = false;
+    bool fetch_complete = false;
+    fetch_all_params_callback_t callback;
+    {
+        std::lock_guard<std::mutex> lock(_cache_mutex);
+
+        CachedParam *cached = nullptr;
+        if (param_value.param_count == 0 || param_value.param_index >= param_value.param_count) {
+            // An index of 65535 is used for params not part of the list. We still
+            // keep those by name.
+            auto it = _cache_index_by_id.find(param_id);
+            if (it != _cache_index_by_id.end()) {
+                cached = &_cache_by_index[it->second];
+            }
+        } else {
+            if (_cache_by_index.size() != param_value.param_count) {
+                // The list changed, the indices we have are no good anymore.
+                _cache_by_index.clear();
+                _cache_index_by_id.clear();
+                _cache_by_index.resize(param_value.param_count);
+            }
 
-                // Reset timeout and wait again.
-                _parent.refresh_timeout_handler(_timeout_cookie);
+            cached = &_cache_by_index[param_value.param_index];
+            if (cached->id != param_id) {
+                if (!cached->id.empty()) {
+                    _cache_index_by_id.erase(cached->id);
+                }
+                cached->id = param_id;
+                cached->value = ParamValue();
+                _cache_index_by_id[param_id] = param_value.param_index;
+            }
 
-            } else {
+            fetching = _fetch.active;
+        }
 
-                LogErr() << "Somehow we did not get an ack, we got: " << int(param_ext_ack.param_result);
+        if (cached != nullptr) {
+            // Compared also while invalid, a fetch of all does not change anything.
+            changed = !is_same_value(cached->value, value);
+            cached->value = value;
+            cached->time = _parent.get_time().steady_time();
+            cached->valid = true;
+        }
 
-                // We are done but unsuccessful
-                // TODO: we need better error feedback
-                if (work.callback) {
-                    work.callback(false);
+        if (fetching) {
+            fetch_complete = true;
+            for (const auto &entry : _cache_by_index) {
+                if (!entry.valid) {
+                    fetch_complete = false;
+                    break;
                 }
+            }
+        }
+        // The cookie is only touched with the lock held, as it is set there.
+        if (fetch_complete) {
+            _fetch.active = false;
+            callback = _fetch.callback;
+            _fetch.callback = nullptr;
+            _parent.unregister_timeout_handler(_fetch.timeout_cookie);
+        } else if (fetching) {
+            // More are coming, keep waiting.
+            _parent.refresh_timeout_handler(_fetch.timeout_cookie);
+        }
+    }
+
+    if (changed && !_param_changed_subscriptions.empty()) {
+        _param_changed_subscriptions(param_id, value);
+    }
+
+    if (!fetching) {
+        return;
+    }
 
-                _state = State::NONE;
-                _parent.unregister_timeout_handler(_timeout_cookie);
-                // LogDebug() << "time taken: " << _parent.get_time().elapsed_since_s(_last_request_time);
-                _set_param_queue.pop_front();
+    if (fetch_complete) {
+        if (!_persistent_cache_dir.empty()) {
+            {
+                std::lock_guard<std::mutex> lock(_cache_mutex);
+                _save_on_hash = true;
             }
+            request_param_hash();
+        }
+        if (callback) {
+            callback(true);
+        }
+    }
+}
 
+bool MAVLinkParameters::is_same_value(const ParamValue &lhs, const ParamValue &rhs)
+{
+    // Autopilot params all fit into 4 bytes.
+    if (lhs.type_size() == 0 || rhs.type_size() == 0 ||
+        lhs.get_mav_param_type() != rhs.get_mav_param_type()) {
+        return false;
+    }
+    const float lhs_bytes = lhs.get_4_float_bytes();
+    const float rhs_bytes = rhs.get_4_float_bytes();
+    return memcmp(&lhs_bytes, &rhs_bytes, sizeof(lhs_bytes)) == 0;
+}
+
+callback_handle_t MAVLinkParameters::subscribe_param_changed(const std::string &name,
+                                                             param_changed_callback_t callback,
+                                                             bool is_prefix)
+{
+    ParamId param_id;
+    if (!ParamId::from_name(name, param_id)) {
+        LogErr() << "Error: param name too long";
+        return 0;
+    }
+
+    return _param_changed_subscriptions.add(
+    [param_id, callback, is_prefix](const ParamId &changed_id, ParamValue value) {
+        const bool matches = is_prefix ? changed_id.starts_with(param_id) :
+                             changed_id == param_id;
+        if (matches) {
+            callback(changed_id.str(), value);
         }
+    });
+}
+
+void MAVLinkParameters::unsubscribe_param_changed(callback_handle_t handle)
+{
+    _param_changed_subscriptions.remove(handle);
+}
+
+void MAVLinkParameters::receive_fetch_timeout()
+{
+    std::vector<uint16_t> missing;
+    fetch_all_params_callback_t callback;
+    {
+        std::lock_guard<std::mutex> lock(_cache_mutex);
+
+        if (!_fetch.active) {
+            return;
+        }
+
+        for (size_t i = 0; i < _cache_by_index.size(); ++i) {
+            if (!_cache_by_index[i].valid) {
+                missing.push_back(uint16_t(i));
+            }
+        }
+
+        if (_cache_by_index.empty() || _fetch.retries_done >= FETCH_MAX_RETRIES) {
+            LogErr() << "Error: fetching all params timed out, " << missing.size() << " missing";
+            _fetch.active = false;
+            callback = _fetch.callback;
+            _fetch.callback = nullptr;
+        } else {
+            ++_fetch.retries_done;
+            // This one has fired, the retry needs a new one before it is sent.
+            register_fetch_timeout();
+        }
+    }
+
+    if (callback) {
+        callback(false);
+        return;
+    }
+
+    if (missing.size() > FETCH_MAX_REQUESTS_PER_RETRY) {
+        // The whole list again, rather than many requests one by one.
+        LogDebug() << missing.size() << " params missing, requesting the list again";
+        send_param_request_list();
+        return;
+    }
+
+    // Ask for the missing ones by index, the rest of the list is not sent twice.
+    for (uint16_t index : missing) {
+        mavlink_message_t message = {};
+        mavlink_msg_param_request_read_pack(GCSClient::system_id,
+                                            GCSClient::component_id,
+                                            &message,
+                                            _parent.get_system_id(),
+                                            _parent.get_autopilot_id(),
+                                            "",
+                                            int16_t(index));
+        _parent.send_message(message);
     }
 }
 
-void MAVLinkParameters::receive_timeout()
+void MAVLinkParameters::set_persistent_cache_dir(const std::string &dir)
+{
+    std::lock_guard<std::mutex> lock(_cache_mutex);
+    _persistent_cache_dir = dir;
+}
+
+std::string MAVLinkParameters::persistent_cache_path()
 {
-    std::lock_guard<std::mutex> lock(_state_mutex);
+    // We assume that we already acquired _cache_mutex in this function.
+
+    if (_persistent_cache_dir.empty() || _parent.get_uuid() == 0) {
+        return "";
+    }
 
-    if (_state == State::NONE) {
-        // Strange, a timeout even though we're not doing anything
+    std::stringstream path;
+    path << _persistent_cache_dir << "/params_" << std::hex << _parent.get_uuid() << ".txt";
+    return path.str();
+}
+
+void MAVLinkParameters::request_param_hash()
+{
+    const ParamId param_id = ParamId::from_mavlink(PARAM_HASH_NAME);
+
+    mavlink_message_t message = {};
+    mavlink_msg_param_request_read_pack(GCSClient::system_id,
+                                        GCSClient::component_id,
+                                        &message,
+                                        _parent.get_system_id(),
+                                        _parent.get_autopilot_id(),
+                                        param_id.c_str(),
+                                        -1);
+    _parent.send_message(message);
+}
+
+void MAVLinkParameters::load_persistent_cache()
+{
+    std::lock_guard<std::mutex> lock(_cache_mutex);
+
+    const std::string path = persistent_cache_path();
+    if (path.empty()) {
         return;
     }
 
-    if (_state == State::GET_PARAM_BUSY) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return;
+    }
 
-        // This means work has been going on that we should try again
-        if (_get_param_queue.size() > 0) {
-            GetParamWork &work = _get_param_queue.front();
+    // The format is a line with the hash and count, then one line per param
+    // with index, name, MAV_PARAM_TYPE and the raw 4 bytes of the value.
+    uint32_t hash = 0;
+    size_t count = 0;
+    if (!(file >> std::hex >> hash >> std::dec >> count)) {
+        LogWarn() << "Ignoring corrupt param cache: " << path;
+        return;
+    }
 
-            if (work.callback) {
-                ParamValue empty_value;
-                // Notify about timeout
-                LogErr() << "Error: get param busy timeout: " << work.param_name;
-                // LogErr() << "Got it after: " << _parent.get_time().elapsed_since_s(_last_request_time);
-                work.callback(false, empty_value);
-            }
-            _state = State::NONE;
-            _get_param_queue.pop_front();
+    std::vector<CachedParam> loaded(count);
+    for (size_t i = 0; i < count; ++i) {
+        size_t index;
+        std::string name;
+        unsigned type;
+        uint32_t bytes;
+        if (!(file >> std::dec >> index >> name >> type >> std::hex >> bytes) || index >= count ||
+            !ParamId::from_name(name, loaded[index].id)) {
+            LogWarn() << "Ignoring corrupt param cache: " << path;
+            return;
+        }
+
+        mavlink_param_value_t param_value = {};
+        memcpy(&param_value.param_value, &bytes, sizeof(bytes));
+        param_value.param_type = uint8_t(type);
+        loaded[index].value.set_from_mavlink_param_value(param_value);
+        loaded[index].valid = true;
+    }
+
+    _loaded_params.swap(loaded);
+    _loaded_hash = hash;
+
+    // The cache can only be used if the vehicle still has the same params.
+    request_param_hash();
+    _parent.unregister_timeout_handler(_hash_timeout_cookie);
+    _parent.register_timeout_handler(std::bind(&MAVLinkParameters::receive_hash_timeout, this),
+                                     HASH_TIMEOUT_S, &_hash_timeout_cookie);
+}
+
+void MAVLinkParameters::save_persistent_cache(uint32_t hash)
+{
+    // We assume that we already acquired _cache_mutex in this function.
+
+    const std::string path = persistent_cache_path();
+    if (path.empty()) {
+        return;
+    }
+
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) {
+        LogWarn() << "Could not write param cache: " << path;
+        return;
+    }
+
+    file << std::hex << hash << " " << std::dec << _cache_by_index.size() << "\n";
+    for (size_t i = 0; i < _cache_by_index.size(); ++i) {
+        const CachedParam &cached = _cache_by_index[i];
+        if (!cached.valid) {
+            // Not complete, better not save anything.
+            file.close();
+            std::remove(path.c_str());
+            return;
         }
+        uint32_t bytes;
+        const float value_bytes = cached.value.get_4_float_bytes();
+        memcpy(&bytes, &value_bytes, sizeof(bytes));
+        file << std::dec << i << " " << cached.id.c_str() << " "
+             << unsigned(cached.value.get_mav_param_type()) << " "
+             << std::hex << bytes << "\n";
     }
+}
 
-    else if (_state == State::SET_PARAM_BUSY) {
+void MAVLinkParameters::process_param_hash(uint32_t hash)
+{
+    std::vector<std::shared_ptr<ParamGroup>> waiting;
+    {
+        std::lock_guard<std::mutex> lock(_cache_mutex);
+
+        if (_save_on_hash) {
+            _save_on_hash = false;
+            save_persistent_cache(hash);
+        }
 
-        // This means work has been going on that we should try again
-        if (_set_param_queue.size() > 0) {
-            SetParamWork &work = _set_param_queue.front();
+        if (_loaded_params.empty()) {
+            return;
+        }
 
-            if (work.callback) {
-                // Notify about timeout
-                LogErr() << "Error: set param busy timeout: " << work.param_name;
-                // LogErr() << "Got it after: " << _parent.get_time().elapsed_since_s(_last_request_time);
-                work.callback(false);
+        if (hash == _loaded_hash) {
+            LogDebug() << "Using " << _loaded_params.size() << " params from cache";
+            _cache_by_index.swap(_loaded_params);
+            _cache_index_by_id.clear();
+            const dl_time_t now = _parent.get_time().steady_time();
+            for (size_t i = 0; i < _cache_by_index.size(); ++i) {
+                _cache_by_index[i].time = now;
+                _cache_index_by_id[_cache_by_index[i].id] = i;
             }
-            _state = State::NONE;
-            _set_param_queue.pop_front();
+        } else {
+            LogDebug() << "Params changed, not using cache";
         }
+        _loaded_params.clear();
+        _parent.unregister_timeout_handler(_hash_timeout_cookie);
+        _hash_timeout_cookie = nullptr;
+        waiting.swap(_groups_waiting_for_hash);
+    }
+
+    for (const auto &group : waiting) {
+        start_group(group);
     }
 }
 
-std::ostream &operator<<(std::ostream &strm, const MAVLinkParameters::ParamValue &obj)
+void MAVLinkParameters::receive_hash_timeout()
 {
-    strm << obj.get_string();
-    return strm;
+    std::vector<std::shared_ptr<ParamGroup>> waiting;
+    {
+        std::lock_guard<std::mutex> lock(_cache_mutex);
+
+        _hash_timeout_cookie = nullptr;
+        if (_loaded_params.empty()) {
+            return;
+        }
+
+        LogDebug() << "No param hash, not using cache";
+        _loaded_params.clear();
+        waiting.swap(_groups_waiting_for_hash);
+    }
+
+    for (const auto &group : waiting) {
+        start_group(group);
+    }
 }
 
 } // namespace dronecore
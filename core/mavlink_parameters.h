@@ -2,12 +2,22 @@
 
 #include "log.h"
 #include "global_include.h"
+#include "callback_list.h"
+#include "inplace_function.h"
 #include "mavlink_include.h"
-#include "locked_queue.h"
-#include "any.h"
+#include "mpsc_queue.h"
+#include "param_id.h"
 #include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <functional>
+#include <unordered_map>
+#include <vector>
 #include <cstring> // for memcpy
 #include <cassert>
 
@@ -21,15 +31,16 @@ public:
     explicit MAVLinkParameters(MAVLinkSystem &parent);
     ~MAVLinkParameters();
 
+    // Tagged union with the value stored inline, so copying it does not need
+    // to allocate.
     class ParamValue
     {
     public:
         typedef char custom_type_t[128];
 
-        ParamValue &operator= (ParamValue value)
+        ParamValue()
         {
-            _value = value._value;
-            return *this;
+            memset(&_value, 0, sizeof(_value));
         }
 
         void set_from_mavlink_param_value(mavlink_param_value_t mavlink_value)
@@ -37,16 +48,13 @@ public:
             switch (mavlink_value.param_type) {
                 case MAV_PARAM_TYPE_UINT32:
                 // FALLTHROUGH
-                case MAV_PARAM_TYPE_INT32: {
-                        int32_t temp;
-                        memcpy(&temp, &mavlink_value.param_value, sizeof(temp));
-                        _value = temp;
-                    }
+                case MAV_PARAM_TYPE_INT32:
+                    memcpy(&_value.int32, &mavlink_value.param_value, sizeof(_value.int32));
+                    _type = Type::INT32;
                     break;
                 case MAV_PARAM_TYPE_REAL32:
-                    float temp;
-                    memcpy(&temp, &mavlink_value.param_value, sizeof(temp));
-                    _value = temp;
+                    memcpy(&_value.float32, &mavlink_value.param_value, sizeof(_value.float32));
+                    _type = Type::FLOAT;
                     break;
                 default:
                     // This would be worrying
@@ -58,71 +66,40 @@ public:
         void set_from_mavlink_param_ext_value(mavlink_param_ext_value_t mavlink_ext_value)
         {
             switch (mavlink_ext_value.param_type) {
-                case MAV_PARAM_EXT_TYPE_UINT8: {
-                        uint8_t temp;
-                        memcpy(&temp, &mavlink_ext_value.param_value[0], sizeof(temp));
-                        _value = temp;
-                    }
+                case MAV_PARAM_EXT_TYPE_UINT8:
+                    set_from_bytes(Type::UINT8, mavlink_ext_value.param_value, sizeof(uint8_t));
                     break;
-                case MAV_PARAM_EXT_TYPE_INT8: {
-                        int8_t temp;
-                        memcpy(&temp, &mavlink_ext_value.param_value[0], sizeof(temp));
-                        _value = temp;
-                    }
+                case MAV_PARAM_EXT_TYPE_INT8:
+                    set_from_bytes(Type::INT8, mavlink_ext_value.param_value, sizeof(int8_t));
                     break;
-                case MAV_PARAM_EXT_TYPE_UINT16: {
-                        uint16_t temp;
-                        memcpy(&temp, &mavlink_ext_value.param_value[0], sizeof(temp));
-                        _value = temp;
-                    }
+                case MAV_PARAM_EXT_TYPE_UINT16:
+                    set_from_bytes(Type::UINT16, mavlink_ext_value.param_value, sizeof(uint16_t));
                     break;
-                case MAV_PARAM_EXT_TYPE_INT16: {
-                        int16_t temp;
-                        memcpy(&temp, &mavlink_ext_value.param_value[0], sizeof(temp));
-                        _value = temp;
-                    }
+                case MAV_PARAM_EXT_TYPE_INT16:
+                    set_from_bytes(Type::INT16, mavlink_ext_value.param_value, sizeof(int16_t));
                     break;
-                case MAV_PARAM_EXT_TYPE_UINT32: {
-                        uint32_t temp;
-                        memcpy(&temp, &mavlink_ext_value.param_value[0], sizeof(temp));
-                        _value = temp;
-                    }
+                case MAV_PARAM_EXT_TYPE_UINT32:
+                    set_from_bytes(Type::UINT32, mavlink_ext_value.param_value, sizeof(uint32_t));
                     break;
-                case MAV_PARAM_EXT_TYPE_INT32: {
-                        int32_t temp;
-                        memcpy(&temp, &mavlink_ext_value.param_value[0], sizeof(temp));
-                        _value = temp;
-                    }
+                case MAV_PARAM_EXT_TYPE_INT32:
+                    set_from_bytes(Type::INT32, mavlink_ext_value.param_value, sizeof(int32_t));
                     break;
-                case MAV_PARAM_EXT_TYPE_UINT64: {
-                        uint64_t temp;
-                        memcpy(&temp, &mavlink_ext_value.param_value[0], sizeof(temp));
-                        _value = temp;
-                    }
+                case MAV_PARAM_EXT_TYPE_UINT64:
+                    set_from_bytes(Type::UINT64, mavlink_ext_value.param_value, sizeof(uint64_t));
                     break;
-                case MAV_PARAM_EXT_TYPE_INT64: {
-                        int64_t temp;
-                        memcpy(&temp, &mavlink_ext_value.param_value[0], sizeof(temp));
-                        _value = temp;
-                    }
+                case MAV_PARAM_EXT_TYPE_INT64:
+                    set_from_bytes(Type::INT64, mavlink_ext_value.param_value, sizeof(int64_t));
                     break;
-                case MAV_PARAM_EXT_TYPE_REAL32: {
-                        float temp;
-                        memcpy(&temp, &mavlink_ext_value.param_value[0], sizeof(temp));
-                        _value = temp;
-                    }
+                case MAV_PARAM_EXT_TYPE_REAL32:
+                    set_from_bytes(Type::FLOAT, mavlink_ext_value.param_value, sizeof(float));
                     break;
-                case MAV_PARAM_EXT_TYPE_REAL64: {
-                        double temp;
-                        memcpy(&temp, &mavlink_ext_value.param_value[0], sizeof(temp));
-                        _value = temp;
-                    }
+                case MAV_PARAM_EXT_TYPE_REAL64:
+                    set_from_bytes(Type::DOUBLE, mavlink_ext_value.param_value, sizeof(double));
                     break;
-                case MAV_PARAM_EXT_TYPE_CUSTOM: {
-                        custom_type_t temp;
-                        memcpy(&temp, &mavlink_ext_value.param_value[0], sizeof(temp));
-                        _value = temp;
-                    }
+                case MAV_PARAM_EXT_TYPE_CUSTOM:
+                    set_from_bytes(Type::CUSTOM, mavlink_ext_value.param_value,
+                                   sizeof(custom_type_t));
+
                     break;
                 default:
                     // This would be worrying
@@ -135,35 +112,25 @@ public:
         void set_from_xml(const std::string &type_str, const std::string &value_str)
         {
             if (strcmp(type_str.c_str(), "uint8") == 0) {
-                uint8_t temp = std::stoi(value_str.c_str());
-                _value = temp;
+                set_uint8(std::stoi(value_str.c_str()));
             } else if (strcmp(type_str.c_str(), "int8") == 0) {
-                int8_t temp = std::stoi(value_str.c_str());
-                _value = temp;
+                set_int8(std::stoi(value_str.c_str()));
             } else if (strcmp(type_str.c_str(), "uint16") == 0) {
-                uint16_t temp = std::stoi(value_str.c_str());
-                _value = temp;
+                set_uint16(std::stoi(value_str.c_str()));
             } else if (strcmp(type_str.c_str(), "int16") == 0) {
-                int16_t temp = std::stoi(value_str.c_str());
-                _value = temp;
+                set_int16(std::stoi(value_str.c_str()));
             } else if (strcmp(type_str.c_str(), "uint32") == 0) {
-                uint32_t temp = std::stol(value_str.c_str());
-                _value = temp;
+                set_uint32(std::stol(value_str.c_str()));
             } else if (strcmp(type_str.c_str(), "int32") == 0) {
-                int32_t temp = std::stol(value_str.c_str());
-                _value = temp;
-            } else if (strcmp(type_str.c_str(), "uint64") == 0) {
-                uint64_t temp = std::stoll(value_str.c_str());
-                _value = temp;
+                set_int32(std::stol(value_str.c_str()));
             } else if (strcmp(type_str.c_str(), "uint64") == 0) {
-                int64_t temp = std::stoll(value_str.c_str());
-                _value = temp;
+                set_uint64(std::stoull(value_str.c_str()));
+            } else if (strcmp(type_str.c_str(), "int64") == 0) {
+                set_int64(std::stoll(value_str.c_str()));
             } else if (strcmp(type_str.c_str(), "float") == 0) {
-                float temp = std::stof(value_str.c_str());
-                _value = temp;
+                set_float(std::stof(value_str.c_str()));
             } else if (strcmp(type_str.c_str(), "double") == 0) {
-                double temp = std::stod(value_str.c_str());
-                _value = temp;
+                set_double(std::stod(value_str.c_str()));
             } else {
                 LogErr() << "Unknown type: " << type_str;
             }
@@ -171,258 +138,283 @@ public:
 
         MAV_PARAM_TYPE get_mav_param_type() const
         {
-            if (_value.is<float>()) {
-                return MAV_PARAM_TYPE_REAL32;
-            } else if (_value.is<int32_t>()) {
-                return MAV_PARAM_TYPE_INT32;
-            } else {
-                return MAV_PARAM_TYPE_REAL32;
+            switch (_type) {
+                case Type::INT32:
+                    return MAV_PARAM_TYPE_INT32;
+                case Type::FLOAT:
+                // FALLTHROUGH
+                default:
+                    return MAV_PARAM_TYPE_REAL32;
             }
         }
 
         MAV_PARAM_EXT_TYPE get_mav_param_ext_type() const
         {
-            if (_value.is<uint8_t>()) {
-                return MAV_PARAM_EXT_TYPE_UINT8;
-            } else if (_value.is<int8_t>()) {
-                return MAV_PARAM_EXT_TYPE_INT8;
-            } else if (_value.is<uint16_t>()) {
-                return MAV_PARAM_EXT_TYPE_UINT16;
-            } else if (_value.is<int16_t>()) {
-                return MAV_PARAM_EXT_TYPE_INT16;
-            } else if (_value.is<uint32_t>()) {
-                return MAV_PARAM_EXT_TYPE_UINT32;
-            } else if (_value.is<int32_t>()) {
-                return MAV_PARAM_EXT_TYPE_INT32;
-            } else if (_value.is<uint64_t>()) {
-                return MAV_PARAM_EXT_TYPE_UINT64;
-            } else if (_value.is<int64_t>()) {
-                return MAV_PARAM_EXT_TYPE_INT64;
-            } else if (_value.is<float>()) {
-                return MAV_PARAM_EXT_TYPE_REAL32;
-            } else if (_value.is<double>()) {
-                return MAV_PARAM_EXT_TYPE_REAL64;
-            } else if (_value.is<custom_type_t>()) {
-                return MAV_PARAM_EXT_TYPE_CUSTOM;
-            } else {
-                LogErr() << "Unknown data type for param.";
-                assert(false);
-                return MAV_PARAM_EXT_TYPE_INT32;
+            switch (_type) {
+                case Type::UINT8:
+                    return MAV_PARAM_EXT_TYPE_UINT8;
+                case Type::INT8:
+                    return MAV_PARAM_EXT_TYPE_INT8;
+                case Type::UINT16:
+                    return MAV_PARAM_EXT_TYPE_UINT16;
+                case Type::INT16:
+                    return MAV_PARAM_EXT_TYPE_INT16;
+                case Type::UINT32:
+                    return MAV_PARAM_EXT_TYPE_UINT32;
+                case Type::INT32:
+                    return MAV_PARAM_EXT_TYPE_INT32;
+                case Type::UINT64:
+                    return MAV_PARAM_EXT_TYPE_UINT64;
+                case Type::INT64:
+                    return MAV_PARAM_EXT_TYPE_INT64;
+                case Type::FLOAT:
+                    return MAV_PARAM_EXT_TYPE_REAL32;
+                case Type::DOUBLE:
+                    return MAV_PARAM_EXT_TYPE_REAL64;
+                case Type::CUSTOM:
+                    return MAV_PARAM_EXT_TYPE_CUSTOM;
+                default:
+                    LogErr() << "Unknown data type for param.";
+                    assert(false);
+                    return MAV_PARAM_EXT_TYPE_INT32;
             }
         }
 
         float get_4_float_bytes() const
         {
-            if (_value.is<float>()) {
-                return _value.as<float>();
+            if (_type == Type::FLOAT) {
+                return _value.float32;
             } else {
-                return *(reinterpret_cast<const float *>(&_value.as<int32_t>()));
+                check_type(Type::INT32);
+                float temp;
+                memcpy(&temp, &_value.int32, sizeof(temp));
+                return temp;
             }
         }
 
         void get_128_bytes(char *bytes) const
         {
-            if (_value.is<uint8_t>()) {
-                memcpy(bytes, &_value.as<uint8_t>(), sizeof(uint8_t));
-            } else if (_value.is<int8_t>()) {
-                memcpy(bytes, &_value.as<int8_t>(), sizeof(int8_t));
-            } else if (_value.is<uint16_t>()) {
-                memcpy(bytes, &_value.as<uint16_t>(), sizeof(uint16_t));
-            } else if (_value.is<int16_t>()) {
-                memcpy(bytes, &_value.as<int16_t>(), sizeof(int16_t));
-            } else if (_value.is<uint32_t>()) {
-                memcpy(bytes, &_value.as<uint32_t>(), sizeof(uint32_t));
-            } else if (_value.is<int32_t>()) {
-                memcpy(bytes, &_value.as<int32_t>(), sizeof(int32_t));
-            } else if (_value.is<uint64_t>()) {
-                memcpy(bytes, &_value.as<uint64_t>(), sizeof(uint64_t));
-            } else if (_value.is<int64_t>()) {
-                memcpy(bytes, &_value.as<int64_t>(), sizeof(int64_t));
-            } else if (_value.is<float>()) {
-                memcpy(bytes, &_value.as<float>(), sizeof(float));
-            } else if (_value.is<double>()) {
-                memcpy(bytes, &_value.as<double>(), sizeof(double));
-            } else if (_value.is<custom_type_t>()) {
-                memcpy(bytes, &_value.as<custom_type_t>(), sizeof(custom_type_t));
-            } else {
+            const size_t size = type_size();
+            if (size == 0) {
                 LogErr() << "Unknown data type for param.";
                 assert(false);
+                return;
+            }
+            memcpy(bytes, &_value, size);
+        }
+
+        // Number of bytes of the value, 0 if there is none.
+        size_t type_size() const
+        {
+            switch (_type) {
+                case Type::UINT8:
+                    return sizeof(uint8_t);
+                case Type::INT8:
+                    return sizeof(int8_t);
+                case Type::UINT16:
+                    return sizeof(uint16_t);
+                case Type::INT16:
+                    return sizeof(int16_t);
+                case Type::UINT32:
+                    return sizeof(uint32_t);
+                case Type::INT32:
+                    return sizeof(int32_t);
+                case Type::UINT64:
+                    return sizeof(uint64_t);
+                case Type::INT64:
+                    return sizeof(int64_t);
+                case Type::FLOAT:
+                    return sizeof(float);
+                case Type::DOUBLE:
+                    return sizeof(double);
+                case Type::CUSTOM:
+                    return sizeof(custom_type_t);
+                default:
+                    return 0;
             }
         }
 
         std::string get_string() const
         {
-            if (_value.is<uint8_t>()) {
-                return std::to_string(_value.as<uint8_t>());
-            } else if (_value.is<int8_t>()) {
-                return std::to_string(_value.as<int8_t>());
-            } else if (_value.is<uint16_t>()) {
-                return std::to_string(_value.as<uint16_t>());
-            } else if (_value.is<int16_t>()) {
-                return std::to_string(_value.as<int16_t>());
-            } else if (_value.is<uint32_t>()) {
-                return std::to_string(_value.as<uint32_t>());
-            } else if (_value.is<int32_t>()) {
-                return std::to_string(_value.as<int32_t>());
-            } else if (_value.is<uint64_t>()) {
-                return std::to_string(_value.as<uint64_t>());
-            } else if (_value.is<int64_t>()) {
-                return std::to_string(_value.as<int64_t>());
-            } else if (_value.is<float>()) {
-                return std::to_string(_value.as<float>());
-            } else if (_value.is<double>()) {
-                return std::to_string(_value.as<double>());
-            } else if (_value.is<custom_type_t>()) {
-                return std::string("(custom type)");
-            } else {
-                LogErr() << "Unknown data type for param.";
-                assert(false);
-                return std::string("(unknown)");
+            switch (_type) {
+                case Type::UINT8:
+                    return std::to_string(_value.uint8);
+                case Type::INT8:
+                    return std::to_string(_value.int8);
+                case Type::UINT16:
+                    return std::to_string(_value.uint16);
+                case Type::INT16:
+                    return std::to_string(_value.int16);
+                case Type::UINT32:
+                    return std::to_string(_value.uint32);
+                case Type::INT32:
+                    return std::to_string(_value.int32);
+                case Type::UINT64:
+                    return std::to_string(_value.uint64);
+                case Type::INT64:
+                    return std::to_string(_value.int64);
+                case Type::FLOAT:
+                    return std::to_string(_value.float32);
+                case Type::DOUBLE:
+                    return std::to_string(_value.float64);
+                case Type::CUSTOM:
+                    return std::string("(custom type)");
+                default:
+                    LogErr() << "Unknown data type for param.";
+                    assert(false);
+                    return std::string("(unknown)");
             }
         }
+
         float get_float() const
         {
-            return float(_value);
+            check_type(Type::FLOAT);
+            return _value.float32;
         }
 
         double get_double() const
         {
-            return double(_value);
+            check_type(Type::DOUBLE);
+            return _value.float64;
         }
 
         int8_t get_int8() const
         {
-            return int8_t(_value);
+            check_type(Type::INT8);
+            return _value.int8;
         }
 
         uint8_t get_uint8() const
         {
-            return uint8_t(_value);
+            check_type(Type::UINT8);
+            return _value.uint8;
         }
 
         int32_t get_int32() const
         {
-            return int32_t(_value);
+            check_type(Type::INT32);
+            return _value.int32;
         }
 
         uint32_t get_uint32() const
         {
-            return uint32_t(_value);
+            check_type(Type::UINT32);
+            return _value.uint32;
         }
 
         void set_float(float value)
         {
-            _value = value;
+            _value.float32 = value;
+            _type = Type::FLOAT;
         }
 
         void set_double(double value)
         {
-            _value = value;
+            _value.float64 = value;
+            _type = Type::DOUBLE;
         }
 
         void set_int8(int8_t value)
         {
-            _value = value;
+            _value.int8 = value;
+            _type = Type::INT8;
         }
 
         void set_uint8(uint8_t value)
         {
-            _value = value;
+            _value.uint8 = value;
+            _type = Type::UINT8;
         }
 
         void set_int16(int16_t value)
         {
-            _value = value;
+            _value.int16 = value;
+            _type = Type::INT16;
         }
 
         void set_uint16(uint16_t value)
         {
-            _value = value;
+            _value.uint16 = value;
+            _type = Type::UINT16;
         }
 
         void set_int32(int32_t value)
         {
-            _value = value;
+            _value.int32 = value;
+            _type = Type::INT32;
         }
 
         void set_uint32(uint32_t value)
         {
-            _value = value;
+            _value.uint32 = value;
+            _type = Type::UINT32;
         }
 
         void set_int64(int64_t value)
         {
-            _value = value;
+            _value.int64 = value;
+            _type = Type::INT64;
         }
 
         void set_uint64(uint64_t value)
         {
-            _value = value;
+            _value.uint64 = value;
+            _type = Type::UINT64;
         }
 
         bool is_uint8() const
         {
-            return (_value.is<uint8_t>());
+            return (_type == Type::UINT8);
         }
 
         bool is_int8() const
         {
-            return (_value.is<int8_t>());
+            return (_type == Type::INT8);
         }
 
         bool is_uint16() const
         {
-            return (_value.is<uint16_t>());
+            return (_type == Type::UINT16);
         }
 
         bool is_int16() const
         {
-            return (_value.is<int16_t>());
+            return (_type == Type::INT16);
         }
 
         bool is_uint32() const
         {
-            return (_value.is<uint32_t>());
+            return (_type == Type::UINT32);
         }
 
         bool is_int32() const
         {
-            return (_value.is<int32_t>());
+            return (_type == Type::INT32);
         }
 
         bool is_uint64() const
         {
-            return (_value.is<uint64_t>());
+            return (_type == Type::UINT64);
         }
 
         bool is_int64() const
         {
-            return (_value.is<int64_t>());
+            return (_type == Type::INT64);
         }
 
         bool is_float() const
         {
-            return (_value.is<float>());
+            return (_type == Type::FLOAT);
         }
 
         bool is_double() const
         {
-            return (_value.is<double>());
+            return (_type == Type::DOUBLE);
         }
 
         bool is_same_type(const ParamValue &rhs) const
         {
-            if ((_value.is<uint8_t>() && rhs._value.is<uint8_t>()) ||
-                (_value.is<int8_t>() && rhs._value.is<int8_t>()) ||
-                (_value.is<uint16_t>() && rhs._value.is<uint16_t>()) ||
-                (_value.is<int16_t>() && rhs._value.is<int16_t>()) ||
-                (_value.is<uint32_t>() && rhs._value.is<uint32_t>()) ||
-                (_value.is<int32_t>() && rhs._value.is<int32_t>()) ||
-                (_value.is<uint64_t>() && rhs._value.is<uint64_t>()) ||
-                (_value.is<int64_t>() && rhs._value.is<int64_t>()) ||
-                (_value.is<float>() && rhs._value.is<float>()) ||
-                (_value.is<double>() && rhs._value.is<double>()) ||
-                (_value.is<custom_type_t>() && rhs._value.is<custom_type_t>())) {
+            if (_type != Type::NONE && _type == rhs._type) {
                 return true;
             } else {
                 LogWarn() << "Comparison type mismatch between " << typestr()
@@ -436,108 +428,238 @@ public:
             if (!is_same_type(rhs)) {
                 return false;
             }
-            if (_value.is<uint8_t>()) {
-                return _value.as<uint8_t>() == rhs._value.as<uint8_t>();
-            } else if (_value.is<int8_t>()) {
-                return _value.as<int8_t>() == rhs._value.as<int8_t>();
-            } else if (_value.is<uint16_t>()) {
-                return _value.as<uint16_t>() == rhs._value.as<uint16_t>();
-            } else if (_value.is<int16_t>()) {
-                return _value.as<int16_t>() == rhs._value.as<int16_t>();
-            } else if (_value.is<uint32_t>()) {
-                return _value.as<uint32_t>() == rhs._value.as<uint32_t>();
-            } else if (_value.is<int32_t>()) {
-                return _value.as<int32_t>() == rhs._value.as<int32_t>();
-            } else if (_value.is<uint64_t>()) {
-                return _value.as<uint64_t>() == rhs._value.as<uint64_t>();
-            } else if (_value.is<int64_t>()) {
-                return _value.as<int64_t>() == rhs._value.as<int64_t>();
-            } else if (_value.is<float>()) {
-                return _value.as<float>() == rhs._value.as<float>();
-            } else if (_value.is<double>()) {
-                return _value.as<double>() == rhs._value.as<double>();
-            } else if (_value.is<custom_type_t>()) {
+            switch (_type) {
+                case Type::UINT8:
+                    return _value.uint8 == rhs._value.uint8;
+                case Type::INT8:
+                    return _value.int8 == rhs._value.int8;
+                case Type::UINT16:
+                    return _value.uint16 == rhs._value.uint16;
+                case Type::INT16:
+                    return _value.int16 == rhs._value.int16;
+                case Type::UINT32:
+                    return _value.uint32 == rhs._value.uint32;
+                case Type::INT32:
+                    return _value.int32 == rhs._value.int32;
+                case Type::UINT64:
+                    return _value.uint64 == rhs._value.uint64;
+                case Type::INT64:
+                    return _value.int64 == rhs._value.int64;
+                case Type::FLOAT:
+                    return _value.float32 == rhs._value.float32;
+                case Type::DOUBLE:
+                    return _value.float64 == rhs._value.float64;
+                case Type::CUSTOM:
                 // FIXME: not clear how to handle this
-                return false;
+                // FALLTHROUGH
+                default:
+                    return false;
             }
-            // FIXME: Added to fix CI error (control reading end of non-void function)
-            return false;
         }
 
         bool operator==(const std::string &value_str) const
         {
             // LogDebug() << "Compare " << typestr() << " and " << rhs.typestr();
-            if (_value.is<uint8_t>()) {
-                return _value.as<uint8_t>() == std::stoi(value_str.c_str());
-            } else if (_value.is<int8_t>()) {
-                return _value.as<int8_t>() == std::stoi(value_str.c_str());
-            } else if (_value.is<uint16_t>()) {
-                return _value.as<uint16_t>() == std::stoi(value_str.c_str());
-            } else if (_value.is<int16_t>()) {
-                return _value.as<int16_t>() == std::stoi(value_str.c_str());
-            } else if (_value.is<uint32_t>()) {
-                return _value.as<uint32_t>() == std::stol(value_str.c_str());
-            } else if (_value.is<int32_t>()) {
-                return _value.as<int32_t>() == std::stol(value_str.c_str());
-            } else if (_value.is<uint64_t>()) {
-                return _value.as<uint64_t>() == std::stoull(value_str.c_str());
-            } else if (_value.is<int64_t>()) {
-                return _value.as<int64_t>() == std::stoll(value_str.c_str());
-            } else if (_value.is<float>()) {
-                return _value.as<float>() == std::stof(value_str.c_str());
-            } else if (_value.is<double>()) {
-                return _value.as<double>() == std::stod(value_str.c_str());
-            } else {
-                // This also covers custom_type_t
-                return false;
+            switch (_type) {
+                case Type::UINT8:
+                    return _value.uint8 == std::stoi(value_str.c_str());
+                case Type::INT8:
+                    return _value.int8 == std::stoi(value_str.c_str());
+                case Type::UINT16:
+                    return _value.uint16 == std::stoi(value_str.c_str());
+                case Type::INT16:
+                    return _value.int16 == std::stoi(value_str.c_str());
+                case Type::UINT32:
+                    return _value.uint32 == std::stol(value_str.c_str());
+                case Type::INT32:
+                    return _value.int32 == std::stol(value_str.c_str());
+                case Type::UINT64:
+                    return _value.uint64 == std::stoull(value_str.c_str());
+                case Type::INT64:
+                    return _value.int64 == std::stoll(value_str.c_str());
+                case Type::FLOAT:
+                    return _value.float32 == std::stof(value_str.c_str());
+                case Type::DOUBLE:
+                    return _value.float64 == std::stod(value_str.c_str());
+                default:
+                    // This also covers custom_type_t
+                    return false;
             }
         }
 
         std::string typestr() const
         {
-            if (_value.is<uint8_t>()) {
-                return "uint8_t";
-            } else if (_value.is<int8_t>()) {
-                return "int8_t";
-            } else if (_value.is<uint16_t>()) {
-                return "uint16_t";
-            } else if (_value.is<int16_t>()) {
-                return "int16_t";
-            } else if (_value.is<uint32_t>()) {
-                return "uint32_t";
-            } else if (_value.is<int32_t>()) {
-                return "int32_t";
-            } else if (_value.is<uint64_t>()) {
-                return "uint64_t";
-            } else if (_value.is<int64_t>()) {
-                return "int64_t";
-            } else if (_value.is<float>()) {
-                return "float";
-            } else if (_value.is<double>()) {
-                return "double";
-            } else if (_value.is<custom_type_t>()) {
+            switch (_type) {
+                case Type::UINT8:
+                    return "uint8_t";
+                case Type::INT8:
+                    return "int8_t";
+                case Type::UINT16:
+                    return "uint16_t";
+                case Type::INT16:
+                    return "int16_t";
+                case Type::UINT32:
+                    return "uint32_t";
+                case Type::INT32:
+                    return "int32_t";
+                case Type::UINT64:
+                    return "uint64_t";
+                case Type::INT64:
+                    return "int64_t";
+                case Type::FLOAT:
+                    return "float";
+                case Type::DOUBLE:
+                    return "double";
+                case Type::CUSTOM:
                 // FIXME: not clear how to handle this
-                return "unknown";
+                // FALLTHROUGH
+                default:
+                    return "unknown";
             }
-            // FIXME: Added to fix CI error (control reading end of non-void function)
-            return "unknown";
         }
 
     private:
-        Any _value;
+        enum class Type {
+            NONE,
+            UINT8,
+            INT8,
+            UINT16,
+            INT16,
+            UINT32,
+            INT32,
+            UINT64,
+            INT64,
+            FLOAT,
+            DOUBLE,
+            CUSTOM
+        };
+
+        void set_from_bytes(Type type, const char *bytes, size_t size)
+        {
+            memset(&_value, 0, sizeof(_value));
+            memcpy(&_value, bytes, size);
+            _type = type;
+        }
+
+        void check_type(Type type) const
+        {
+            if (_type != type) {
+                // We don't have exceptions, so we abort like a bad cast would.
+                LogErr() << "Need to abort because " << typestr() << " was accessed as wrong type";
+                abort();
+            }
+        }
 
+        Type _type = Type::NONE;
+        union {
+            uint8_t uint8;
+            int8_t int8;
+            uint16_t uint16;
+            int16_t int16;
+            uint32_t uint32;
+            int32_t int32;
+            uint64_t uint64;
+            int64_t int64;
+            float float32;
+            double float64;
+            custom_type_t custom;
+        } _value;
     };
 
-    typedef std::function <void(bool success)> set_param_callback_t;
+    // Extended params go to the camera with component_id, so that several
+    // cameras of a system can be set up at the same time.
+    typedef Callback<void(bool success)> set_param_callback_t;
     void set_param_async(const std::string &name, const ParamValue &value,
-                         set_param_callback_t callback, bool extended = false);
-
-    typedef std::function <void(bool success, ParamValue value)> get_param_callback_t;
-    void get_param_async(const std::string &name, get_param_callback_t callback, bool extended = false);
+                         set_param_callback_t callback, bool extended = false,
+                         uint8_t component_id = MAV_COMP_ID_CAMERA);
+
+    typedef Callback<void(bool success, ParamValue value)> get_param_callback_t;
+    void get_param_async(const std::string &name, get_param_callback_t callback,
+                         bool extended = false, uint8_t component_id = MAV_COMP_ID_CAMERA);
+
+    // Gets several autopilot params together, e.g. the ones needed at startup.
+    // Those which are not cached are queued ahead of other requests, all at
+    // once so that they are in flight at the same time. Right after connecting,
+    // the params cached from an earlier connection are used once the vehicle
+    // confirmed them, instead of asking for them again. The callback gets the
+    // values which arrived, and true if all of them did.
+    typedef Callback<void(bool success, const std::map<std::string, ParamValue> &values)>
+    get_params_callback_t;
+    void get_params_async(const std::vector<std::string> &names, get_params_callback_t callback);
+
+    // Sets several autopilot params, e.g. all those of a config file. Only
+    // those which differ from the cached value are sent, all at once so that
+    // they go out through the window of requests in flight. Each set is
+    // verified with the value the vehicle echoes. To diff against what the
+    // vehicle has, fetch all params first; params which are not cached are
+    // always sent. The callback gets a result per param, and true if all of
+    // them have the value asked for.
+    enum class SetParamResult {
+        UNCHANGED,
+        CHANGED,
+        MISMATCH,
+        FAILED
+    };
+    typedef Callback<void(bool success, const std::map<std::string, SetParamResult> &results)>
+    set_params_callback_t;
+    void set_params_async(const std::map<std::string, ParamValue> &params,
+                          set_params_callback_t callback);
+
+    // Reads a param file as saved by QGroundControl: lines of system id,
+    // component id, name, value and MAV_PARAM_TYPE, separated by tabs, and
+    // comments starting with '#'. Only the params of the autopilot are taken.
+    bool read_param_file(const std::string &path, std::map<std::string, ParamValue> &params);
+
+    // Requests all parameters with PARAM_REQUEST_LIST and keeps them in a cache.
+    // As long as a cached value is fresh, get_param_async() is answered from the
+    // cache without asking the vehicle again.
+    typedef Callback<void(bool success)> fetch_all_params_callback_t;
+    void fetch_all_params_async(fetch_all_params_callback_t callback);
+
+    // Asks the camera for all its extended params with a single
+    // PARAM_EXT_REQUEST_LIST. Every value is handed to value_callback as it
+    // arrives. The callback gets true once the whole list has arrived and false
+    // if it stopped before, so that the rest can be asked for one by one.
+    // Every camera can have one such fetch going on.
+    typedef Callback<void(const std::string &name, ParamValue value)>
+    ext_param_value_callback_t;
+    void fetch_all_ext_params_async(ext_param_value_callback_t value_callback,
+                                    fetch_all_params_callback_t callback,
+                                    uint8_t component_id = MAV_COMP_ID_CAMERA);
+
+    // Called whenever an autopilot param gets a value other than the cached
+    // one, or its first value, also when it is broadcast because someone else
+    // changed it. With is_prefix, all params starting with name are matched.
+    // Callbacks are called on the receive thread.
+    typedef std::function<void(const std::string &name, ParamValue value)>
+    param_changed_callback_t;
+    callback_handle_t subscribe_param_changed(const std::string &name,
+                                              param_changed_callback_t callback,
+                                              bool is_prefix = false);
+    void unsubscribe_param_changed(callback_handle_t handle);
+
+    // Forgets all cached values, e.g. when the vehicle might have rebooted.
+    void invalidate_param_cache();
+
+    // Once all params have been fetched, they are saved to a file in this
+    // directory, named after the UUID of the system. On the next connect, the
+    // file is used if the vehicle reports the same param hash. This is off if
+    // the directory is empty. MAVLinkSystem sets it to "params" in the state
+    // directory if there is one, otherwise it is $DRONECORE_PARAM_CACHE_DIR.
+    void set_persistent_cache_dir(const std::string &dir);
+
+    // To be called once the system is connected and its UUID known.
+    void load_persistent_cache();
+
+    // How many param requests can be waiting for a reply at the same time.
+    void set_max_params_in_flight(unsigned max_in_flight);
 
     //void save_async();
     void do_work();
 
+    // Queued or waiting for a reply.
+    size_t num_work();
+
     friend std::ostream &operator<<(std::ostream &, const ParamValue &);
 
     // Non-copyable
@@ -547,42 +669,179 @@ private:
     void process_param_value(const mavlink_message_t &message);
     void process_param_ext_value(const mavlink_message_t &message);
     void process_param_ext_ack(const mavlink_message_t &message);
-    void receive_timeout();
+    void receive_timeout(const ParamId &param_id, bool extended, uint8_t component_id);
+
+    bool get_cached_param(const ParamId &param_id, ParamValue &value);
+    void cache_param_value(const ParamId &param_id, const mavlink_param_value_t &param_value);
+    void uncache_param(const ParamId &param_id);
+    void receive_fetch_timeout();
+    bool send_param_request_list();
+    // We assume that _cache_mutex is held.
+    void register_fetch_timeout();
+    void process_ext_fetch_value(const mavlink_param_ext_value_t &param_ext_value,
+                                 uint8_t component_id);
+    void receive_ext_fetch_timeout(uint8_t component_id);
+
+    void request_param_hash();
+    void process_param_hash(uint32_t hash);
+    void receive_hash_timeout();
+    std::string persistent_cache_path();
+    void save_persistent_cache(uint32_t hash);
 
     MAVLinkSystem &_parent;
 
-    enum class State {
-        NONE,
-        SET_PARAM_BUSY,
-        GET_PARAM_BUSY
-    } _state = State::NONE;
-    std::mutex _state_mutex {};
-
-    // Params can be up to 16 chars and without 0-termination.
-    // Therefore we add a 0 here for storing.
-    static constexpr size_t PARAM_ID_LEN = 16 + 1;
+    static constexpr unsigned DEFAULT_MAX_IN_FLIGHT = 10;
+    static constexpr double PARAM_TIMEOUT_S = 0.5;
+    static constexpr int PARAM_MAX_RETRIES = 3;
 
-    struct SetParamWork {
-        set_param_callback_t callback = nullptr;
-        std::string param_name {};
+    struct Work {
+        enum class Type {
+            GET,
+            SET
+        } type = Type::GET;
+        ParamId param_id {};
         ParamValue param_value {};
         bool extended = false;
+        // Of the camera for extended params, 0 otherwise.
+        uint8_t component_id = 0;
+        // Queued behind other prioritized work but ahead of the rest.
+        bool is_prioritized = false;
+        set_param_callback_t set_callback = nullptr;
+        // A set can have this instead, to get the value it was confirmed with.
+        get_param_callback_t get_callback = nullptr;
         int retries_done = 0;
+        // Only used once the work is in flight.
+        void *timeout_cookie = nullptr;
+        dl_time_t sent_time {};
+        // Taken from the measured round trips, PARAM_TIMEOUT_S until there are some.
+        double timeout_s = PARAM_TIMEOUT_S;
+        bool rtt_sampled = false;
     };
 
-    LockedQueue<SetParamWork> _set_param_queue {};
+    bool send_work(const Work &work);
 
-    struct GetParamWork {
-        get_param_callback_t callback = nullptr;
-        std::string param_name {};
-        bool extended = false;
-        int retries_done = 0;
+    // With the first answer to the first transmission, later ones could be to
+    // any of them.
+    void sample_rtt(Work &work);
+
+    // At most one request for the same param of a component is in flight,
+    // because the reply only has the param id to match it.
+    std::list<Work>::iterator find_in_flight(const ParamId &param_id, bool extended,
+                                             uint8_t component_id);
+
+    // Calls callbacks after _work_mutex has been released, because they may
+    // want to queue the next param.
+    struct Report {
+        set_param_callback_t set_callback;
+        get_param_callback_t get_callback;
+        bool success;
+        ParamValue value;
     };
-    LockedQueue<GetParamWork> _get_param_queue {};
+    void call_back(const std::vector<Report> &reports);
+
+    // Spans of the trace, from a request being sent until it is answered.
+    uint64_t trace_id_of(const Work &work) const;
+    static const char *trace_name_of(const Work &work);
+    void trace_sent(const Work &work);
+    void trace_step(const Work &work, const char *step);
+    void trace_finished(const Work &work, const char *result);
+
+    // Queuing does not need _work_mutex, do_work() takes the new work from here.
+    MpscQueue<Work> _new_work {};
 
-    void *_timeout_cookie = nullptr;
+    std::mutex _work_mutex {};
+    std::deque<Work> _queued_work {};
+    std::list<Work> _in_flight_work {};
+    unsigned _max_in_flight = DEFAULT_MAX_IN_FLIGHT;
 
     // dl_time_t _last_request_time = {};
+
+    static constexpr double PARAM_CACHE_MAX_AGE_S = 60.0;
+    // How long to wait after the last PARAM_VALUE of a fetch before we ask again
+    // for the ones which are missing.
+    static constexpr double FETCH_TIMEOUT_S = 1.0;
+    static constexpr int FETCH_MAX_RETRIES = 3;
+    // With more missing, the whole list is requested again instead.
+    static constexpr unsigned FETCH_MAX_REQUESTS_PER_RETRY = 20;
+
+    struct CachedParam {
+        ParamId id {};
+        ParamValue value {};
+        dl_time_t time {};
+        bool valid = false;
+    };
+
+    // Every PARAM_VALUE updates the cache, whether we asked for it or it was
+    // broadcast because someone else changed the param.
+    std::mutex _cache_mutex {};
+    std::vector<CachedParam> _cache_by_index {};
+    std::unordered_map<ParamId, size_t, ParamId::Hash> _cache_index_by_id {};
+
+    // Without the type warning of operator==, the cached value may be empty.
+    static bool is_same_value(const ParamValue &lhs, const ParamValue &rhs);
+
+    CallbackList<const ParamId &, ParamValue> _param_changed_subscriptions {};
+
+    // PX4 reports a hash of all its params as this special param.
+    static constexpr const char *PARAM_HASH_NAME = "_HASH_CHECK";
+
+    std::string _persistent_cache_dir {};
+    // Save once the hash for the freshly fetched params arrives.
+    bool _save_on_hash = false;
+    // Loaded from disk, waiting for the hash to be confirmed.
+    std::vector<CachedParam> _loaded_params {};
+    uint32_t _loaded_hash = 0;
+    // The hash is only asked for once, without it the cache is not used.
+    static constexpr double HASH_TIMEOUT_S = 1.0;
+    void *_hash_timeout_cookie = nullptr;
+
+    struct ParamGroup {
+        std::vector<std::string> names {};
+        get_params_callback_t callback = nullptr;
+        std::mutex mutex {};
+        size_t num_remaining = 0;
+        bool success = true;
+        std::map<std::string, ParamValue> values {};
+    };
+    void start_group(const std::shared_ptr<ParamGroup> &group);
+    static void finish_group_param(const std::shared_ptr<ParamGroup> &group, size_t index,
+                                   bool success, ParamValue value);
+    struct ParamSet {
+        std::vector<std::string> names {};
+        std::vector<ParamId> ids {};
+        std::vector<ParamValue> values {};
+        set_params_callback_t callback = nullptr;
+        std::mutex mutex {};
+        size_t num_remaining = 0;
+        bool success = true;
+        std::map<std::string, SetParamResult> results {};
+    };
+    static void finish_set_param(const std::shared_ptr<ParamSet> &param_set, size_t index,
+                                 bool success, ParamValue echoed_value);
+
+    // Until the params loaded from disk are confirmed or not, protected by _cache_mutex.
+    std::vector<std::shared_ptr<ParamGroup>> _groups_waiting_for_hash {};
+
+    struct Fetch {
+        bool active = false;
+        fetch_all_params_callback_t callback = nullptr;
+        int retries_done = 0;
+        void *timeout_cookie = nullptr;
+    } _fetch {};
+
+    // The camera sends its list without us knowing the names, the count only
+    // comes with the values. There is one fetch per camera component.
+    std::mutex _ext_fetch_mutex {};
+    struct ExtFetch {
+        bool active = false;
+        ext_param_value_callback_t value_callback = nullptr;
+        fetch_all_params_callback_t callback = nullptr;
+        // By param index, sized once the first value tells the count.
+        std::vector<bool> received {};
+        size_t num_received = 0;
+        void *timeout_cookie = nullptr;
+    };
+    std::map<uint8_t, ExtFetch> _ext_fetches {};
 };
 
 } // namespace dronecore
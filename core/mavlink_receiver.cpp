@@ -1,47 +1,165 @@
 #include "mavlink_receiver.h"
 #include "global_include.h"
-
-#if DROP_DEBUG ==1
-#include <iomanip>
-#endif
+#include "mavlink_message_table.h"
+#include <cstring>
 
 namespace dronecore {
 
-MAVLinkReceiver::MAVLinkReceiver(uint8_t channel) :
-    _channel(channel)
-#if DROP_DEBUG == 1
-    , _last_time()
-#endif
+MAVLinkReceiver::MAVLinkReceiver(MAVLinkReceiveCounters *counters) :
+    _counters(counters ? counters : &_own_counters)
 {
 }
 
 void MAVLinkReceiver::set_new_datagram(char *datagram, unsigned datagram_len)
+{
+    set_new_datagram(datagram, datagram_len, std::chrono::steady_clock::now());
+}
+
+void MAVLinkReceiver::set_new_datagram(char *datagram, unsigned datagram_len,
+                                       std::chrono::steady_clock::time_point arrival_time)
 {
     _datagram = datagram;
     _datagram_len = datagram_len;
+    _datagram_time = arrival_time;
 
-#if DROP_DEBUG == 1
-    _bytes_received += _datagram_len;
-#endif
+    MAVLinkReceiveCounters::add(_counters->num_bytes, datagram_len);
 }
 
 bool MAVLinkReceiver::parse_message()
 {
     // Note that one datagram can contain multiple mavlink messages.
-    for (unsigned i = 0; i < _datagram_len; ++i) {
-        if (mavlink_parse_char(_channel, _datagram[i], &_last_message, &_status) == 1) {
 
-            // Move the pointer to the datagram forward by the amount parsed.
-            _datagram += (i + 1);
-            // And decrease the length, so we don't overshoot in the next round.
-            _datagram_len -= (i + 1);
+    // As long as the parser is not in the middle of a frame which was cut
+    // off by the previous read, we try to take whole frames at once and only
+    // use the byte-wise state machine otherwise.
+    if (_datagram_len > 0 &&
+        _rx_status.parse_state <= MAVLINK_PARSE_STATE_IDLE &&
+        !has_replay() &&
+        parse_whole_frame()) {
+        return true;
+    }
+
+    return parse_byte_by_byte();
+}
+
+bool MAVLinkReceiver::parse_whole_frame()
+{
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(_datagram);
+
+    unsigned header_len;
+    unsigned payload_len;
+    unsigned frame_len;
+    uint32_t msgid;
+
+    if (data[0] == MAVLINK_STX) {
+        header_len = MAVLINK_NUM_HEADER_BYTES;
+        if (_datagram_len < header_len) {
+            return false;
+        }
+        // Signed frames and unknown incompat flags are left to mavlink.
+        if (data[2] != 0) {
+            return false;
+        }
+        payload_len = data[1];
+        msgid = uint32_t(data[7]) | (uint32_t(data[8]) << 8) | (uint32_t(data[9]) << 16);
+
+    } else if (data[0] == MAVLINK_STX_MAVLINK1) {
+        header_len = MAVLINK_CORE_HEADER_MAVLINK1_LEN + 1;
+        if (_datagram_len < header_len) {
+            return false;
+        }
+        payload_len = data[1];
+        msgid = data[5];
+
+    } else {
+        // Not at the start of a frame, the state machine needs to resync.
+        return false;
+    }
+
+    frame_len = header_len + payload_len + MAVLINK_NUM_CHECKSUM_BYTES;
+    if (_datagram_len < frame_len) {
+        // Frame is split across reads.
+        return false;
+    }
+
+    const mavlink_msg_entry_t *entry = MAVLinkMessageTable::entry(msgid);
+    if (entry == nullptr || payload_len > entry->max_msg_len) {
+        return false;
+    }
+
+    uint16_t checksum = crc_calculate(&data[1], uint16_t(header_len - 1 + payload_len));
+    crc_accumulate(entry->crc_extra, &checksum);
+
+    const uint8_t ck_a = data[header_len + payload_len];
+    const uint8_t ck_b = data[header_len + payload_len + 1];
+    if (ck_a != uint8_t(checksum & 0xFF) || ck_b != uint8_t(checksum >> 8)) {
+        // Let the state machine deal with and count the bad CRC.
+        return false;
+    }
+
+    // The message only gets copied out of the datagram if someone asks for it.
+    _last_view = MAVLinkMessageView(data, _last_message);
+
+    // Keep the statistics the same as if mavlink had parsed it.
+    if (_rx_status.packet_rx_success_count == 0) {
+        _rx_status.packet_rx_drop_count = 0;
+    }
+    _rx_status.packet_rx_success_count++;
+    _rx_status.current_rx_seq = _last_view.seq();
+    if (data[0] == MAVLINK_STX_MAVLINK1) {
+        _rx_status.flags |= MAVLINK_STATUS_FLAG_IN_MAVLINK1;
+    } else {
+        _rx_status.flags &= ~MAVLINK_STATUS_FLAG_IN_MAVLINK1;
+    }
+
+    _status.msg_received = MAVLINK_FRAMING_OK;
+    _status.current_rx_seq = uint8_t(_rx_status.current_rx_seq + 1);
+    _status.packet_rx_success_count = _rx_status.packet_rx_success_count;
+    _status.packet_rx_drop_count = _rx_status.parse_error;
+    _status.flags = _rx_status.flags;
+
+    _is_skipping = false;
+    count_message(_last_view.sysid(), _last_view.compid(), _last_view.seq());
 
-#if DROP_DEBUG == 1
-            debug_drop_rate();
-#endif
+    consume(frame_len);
+    return true;
+}
+
+bool MAVLinkReceiver::parse_byte_by_byte()
+{
+    bool should_rescan = true;
+    while (should_rescan) {
+        should_rescan = false;
 
-            // We have parsed one message, let's return so it can be handled.
-            return true;
+        // The bytes of a broken frame come before the rest of the datagram.
+        while (has_replay()) {
+            if (parse_char(_replay[_replay_pos++])) {
+                _last_view = MAVLinkMessageView(_last_message);
+                count_message(_last_message.sysid, _last_message.compid, _last_message.seq);
+                return true;
+            }
+        }
+        _replay.clear();
+        _replay_pos = 0;
+
+        for (unsigned i = 0; i < _datagram_len; ++i) {
+            if (parse_char(uint8_t(_datagram[i]))) {
+
+                _last_view = MAVLinkMessageView(_last_message);
+                count_message(_last_message.sysid, _last_message.compid, _last_message.seq);
+
+                // Move the pointer to the datagram forward by the amount parsed.
+                consume(i + 1);
+
+                // We have parsed one message, let's return so it can be handled.
+                return true;
+            }
+
+            if (has_replay()) {
+                consume(i + 1);
+                should_rescan = true;
+                break;
+            }
         }
     }
 
@@ -51,84 +169,107 @@ bool MAVLinkReceiver::parse_message()
     return false;
 }
 
-#if DROP_DEBUG == 1
-void MAVLinkReceiver::debug_drop_rate()
+bool MAVLinkReceiver::parse_char(uint8_t c)
 {
-    if (_last_message.msgid == MAVLINK_MSG_ID_SYS_STATUS) {
+    const bool was_in_frame = (_rx_status.parse_state > MAVLINK_PARSE_STATE_IDLE);
 
-        const unsigned msg_len = (_last_message.len + MAVLINK_NUM_NON_PAYLOAD_BYTES);
+    // Garbage between frames, e.g. after a lost byte, counts once per run.
+    if (!was_in_frame) {
+        _frame_len = 0;
+        if (c != MAVLINK_STX && c != MAVLINK_STX_MAVLINK1) {
+            MAVLinkReceiveCounters::add(_counters->num_bytes_discarded, 1);
+            if (!_is_skipping) {
+                MAVLinkReceiveCounters::add(_counters->num_resyncs, 1);
+                _is_skipping = true;
+            }
+        } else {
+            _is_skipping = false;
+            _frame[_frame_len++] = c;
+        }
+    } else if (_frame_len < _frame.size()) {
+        _frame[_frame_len++] = c;
+    }
 
-        _bytes_received -= msg_len;
+    // This is mavlink_parse_char() with our own state instead of a channel.
+    const uint8_t result = mavlink_frame_char_buffer(&_rx_buffer, &_rx_status, c,
+                                                     &_last_message, &_status);
 
-        mavlink_sys_status_t sys_status;
-        mavlink_msg_sys_status_decode(&_last_message, &sys_status);
+    if (result == MAVLINK_FRAMING_BAD_CRC || result == MAVLINK_FRAMING_BAD_SIGNATURE) {
+        // A bad frame counts as a parse error.
+        _rx_status.parse_error++;
+        _rx_status.msg_received = MAVLINK_FRAMING_INCOMPLETE;
+        _rx_status.parse_state = MAVLINK_PARSE_STATE_IDLE;
+        if (result == MAVLINK_FRAMING_BAD_CRC) {
+            MAVLinkReceiveCounters::add(_counters->num_crc_errors, 1);
+            // Its start was most likely noise, and the real frames are within it.
+            rescan_frame();
+        } else {
+            // The frame itself was fine, only not for us.
+            _frame_len = 0;
+        }
+        return false;
+    }
 
+    if (result == MAVLINK_FRAMING_OK) {
+        _frame_len = 0;
+        return true;
+    }
 
-        if (!_first) {
+    if (was_in_frame && _rx_status.parse_state <= MAVLINK_PARSE_STATE_IDLE) {
+        // The state machine gave up on the header, e.g. for unknown flags.
+        rescan_frame();
+    }
+    return false;
+}
 
-            LogDebug() << "-------------------------------------------------------------------"
-                       << "-----------";
+void MAVLinkReceiver::rescan_frame()
+{
+    if (_frame_len == 0) {
+        return;
+    }
 
-            if (_bytes_received <= sys_status.errors_comm &&
-                sys_status.errors_count2 <= sys_status.errors_comm) {
+    MAVLinkReceiveCounters::add(_counters->num_bytes_discarded, 1);
+    MAVLinkReceiveCounters::add(_counters->num_resyncs, 1);
+    // The bytes up to the next start byte are part of this resync.
+    _is_skipping = true;
 
-                _bytes_sent_overall += sys_status.errors_comm;
-                //_bytes_at_gimbal_overall += sys_status.errors_count1;
-                _bytes_at_camera_overall += sys_status.errors_count2;
-                _bytes_at_sdk_overall += _bytes_received;
+    std::vector<uint8_t> replay(_frame.begin() + 1, _frame.begin() + _frame_len);
+    replay.insert(replay.end(), _replay.begin() + long(_replay_pos), _replay.end());
+    _replay.swap(replay);
+    _replay_pos = 0;
+    _frame_len = 0;
+}
 
-                _time_elapsed += elapsed_since_s(_last_time);
+void MAVLinkReceiver::count_message(uint8_t sysid, uint8_t compid, uint8_t seq)
+{
+    MAVLinkReceiveCounters::add(_counters->num_messages, 1);
+    MAVLinkReceiveCounters::add(_counters->num_messages_by_sysid[sysid], 1);
 
-                print_line("FMU   ", sys_status.errors_comm, sys_status.errors_comm,
-                           _bytes_sent_overall, _bytes_sent_overall);
-                //print_line("Gimbal", sys_status.errors_count1, sys_status.errors_comm,
-                //           _bytes_at_gimbal_overall, _bytes_sent_overall);
-                print_line("Camera", sys_status.errors_count2, sys_status.errors_comm,
-                           _bytes_at_camera_overall, _bytes_sent_overall);
-                print_line("SDK   ", _bytes_received, sys_status.errors_comm,
-                           _bytes_at_sdk_overall, _bytes_sent_overall);
+    std::unique_ptr<next_seqs_t> &next_seqs = _next_seqs[sysid];
+    if (!next_seqs) {
+        next_seqs.reset(new next_seqs_t);
+        next_seqs->fill(-1);
+    }
 
-            } else {
-                LogDebug() << "Missed SYS_STATUS";
-            }
+    int16_t &next_seq = (*next_seqs)[compid];
+    if (next_seq >= 0) {
+        // Anything in between is lost, a repeated or older one (e.g. after a
+        // reboot) is taken as a new start.
+        const uint8_t num_lost = uint8_t(seq - uint8_t(next_seq));
+        if (num_lost > 0 && num_lost < 128) {
+            MAVLinkReceiveCounters::add(_counters->num_lost, num_lost);
+            MAVLinkReceiveCounters::add(_counters->num_lost_by_sysid[sysid], num_lost);
         }
-        _first = false;
-
-        _last_time = steady_time();
-
-        // Reset afterwards:
-        _bytes_received = msg_len;
     }
+    next_seq = int16_t(uint8_t(seq + 1));
 }
 
-void MAVLinkReceiver::print_line(const char *index, unsigned count, unsigned count_total,
-                                 unsigned overall_bytes, unsigned overall_bytes_total)
+void MAVLinkReceiver::consume(unsigned len)
 {
-    LogDebug() << "count "
-               << index
-               << ": "
-               << std::setw(6)
-               << count
-               << ", loss: "
-               << std::setw(6)
-               << count_total -  count
-               << ",  "
-               << std::setw(6)
-               << std::setprecision(2)
-               << std::fixed
-               << 100.0 * float(count) / float(count_total)
-               << " %, overall: "
-               << std::setw(6)
-               << std::setprecision(2)
-               << std::fixed
-               << (100.0 * double(overall_bytes) / double(overall_bytes_total))
-               << " %, "
-               << std::setw(6)
-               << std::setprecision(2)
-               << std::fixed
-               << (double(overall_bytes) / _time_elapsed / 1024.0)
-               << " KiB/s";
+    _datagram += len;
+    // And decrease the length, so we don't overshoot in the next round.
+    _datagram_len -= len;
 }
-#endif
+
 
 } // namespace dronecore
@@ -1,24 +1,65 @@
 #pragma once
 
 #include "mavlink_include.h"
+#include "mavlink_message_view.h"
 #include "global_include.h"
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <memory>
+#include <vector>
 
 namespace dronecore {
 
+// What a receiver counts about its link. Only the receive thread writes, so
+// relaxed atomics are enough for anyone reading them meanwhile.
+struct MAVLinkReceiveCounters {
+    std::atomic<uint64_t> num_bytes {0};
+    std::atomic<uint64_t> num_messages {0};
+    std::atomic<uint64_t> num_crc_errors {0};
+    // Messages missing in the sequence numbers of a sender.
+    std::atomic<uint64_t> num_lost {0};
+    // Times the parser had to skip bytes to find the start of a frame, or
+    // went back into a broken frame to look for one.
+    std::atomic<uint64_t> num_resyncs {0};
+    // Bytes which were in no frame in the end.
+    std::atomic<uint64_t> num_bytes_discarded {0};
+
+    std::array<std::atomic<uint64_t>, 256> num_messages_by_sysid {};
+    std::array<std::atomic<uint64_t>, 256> num_lost_by_sysid {};
+
+    static void add(std::atomic<uint64_t> &counter, uint64_t value)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value,
+                      std::memory_order_relaxed);
+    }
+};
+
+// The parse state is kept here rather than in one of mavlink's global
+// channels, so that there can be as many receivers as there is memory.
+//
+// The bytes of the frame being parsed are kept as well. If it turns out to be
+// broken, e.g. a bad checksum after a corrupted length byte made the state
+// machine wait for far too many bytes, only its start byte is discarded and
+// the rest is parsed again, so that the frames within it are not lost.
 class MAVLinkReceiver
 {
 public:
-    explicit MAVLinkReceiver(uint8_t channel);
+    // Counts into counters if given, so that they can outlive the receiver.
+    explicit MAVLinkReceiver(MAVLinkReceiveCounters *counters = nullptr);
 
-    uint8_t get_channel()
+    mavlink_message_t &get_last_message()
     {
-        return _channel;
+        // Make sure the message has been copied out of the datagram.
+        _last_view.message();
+        return _last_message;
     }
 
-    mavlink_message_t &get_last_message()
+    // Only valid until the next datagram is set.
+    const MAVLinkMessageView &get_last_message_view() const
     {
-        return _last_message;
+        return _last_view;
     }
 
     mavlink_status_t &get_status()
@@ -27,35 +68,56 @@ public:
     }
 
     void set_new_datagram(char *datagram, unsigned datagram_len);
+    // With when it arrived, if that is known better than by the time it is set.
+    void set_new_datagram(char *datagram, unsigned datagram_len,
+                          std::chrono::steady_clock::time_point arrival_time);
+
+    // When the current datagram arrived or was set, for tracing the messages in it.
+    std::chrono::steady_clock::time_point get_datagram_time() const
+    {
+        return _datagram_time;
+    }
 
     bool parse_message();
 
-#if DROP_DEBUG == 1
-    void debug_drop_rate();
-    void print_line(const char *index, unsigned count, unsigned count_total,
-                    unsigned overall_bytes, unsigned overall_bytes_total);
-#endif
+    const MAVLinkReceiveCounters &get_counters() const { return *_counters; }
 
 private:
-    uint8_t _channel;
+    bool parse_whole_frame();
+    bool parse_byte_by_byte();
+    bool parse_char(uint8_t c);
+    void consume(unsigned len);
+    // Parses the frame but its first byte again, ahead of what is left.
+    void rescan_frame();
+    bool has_replay() const { return _replay_pos < _replay.size(); }
+    void count_message(uint8_t sysid, uint8_t compid, uint8_t seq);
+
+    // What mavlink keeps for each channel otherwise.
+    mavlink_message_t _rx_buffer = {};
+    mavlink_status_t _rx_status = {};
+
     mavlink_message_t _last_message = {};
+    MAVLinkMessageView _last_view {_last_message};
     mavlink_status_t _status = {};
     char *_datagram = nullptr;
     unsigned _datagram_len = 0;
+    std::chrono::steady_clock::time_point _datagram_time {};
 
-#if DROP_DEBUG == 1
-    unsigned _bytes_received = 0;
-
-    unsigned _bytes_sent_overall = 0;
-    //unsigned _bytes_at_gimbal_overall = 0;
-    unsigned _bytes_at_camera_overall = 0;
-    unsigned _bytes_at_sdk_overall = 0;
+    MAVLinkReceiveCounters _own_counters {};
+    MAVLinkReceiveCounters *_counters;
+    bool _is_skipping = false;
 
-    bool _first = true;
-    dl_time_t _last_time;
+    // The bytes of the frame the state machine is in.
+    std::array<uint8_t, MAVLINK_MAX_PACKET_LEN> _frame {};
+    unsigned _frame_len = 0;
+    // Bytes of a broken frame which are parsed before the datagram.
+    std::vector<uint8_t> _replay {};
+    size_t _replay_pos = 0;
 
-    double _time_elapsed = 0.0;
-#endif
+    // The next sequence number expected from each component, for the systems
+    // heard so far. Negative until the first message.
+    typedef std::array<int16_t, 256> next_seqs_t;
+    std::array<std::unique_ptr<next_seqs_t>, 256> _next_seqs {};
 };
 
 } // namespace dronecore
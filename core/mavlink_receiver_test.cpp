@@ -0,0 +1,151 @@
+#include "mavlink_receiver.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace dronecore;
+
+static std::vector<char> heartbeats(unsigned num, uint8_t sysid)
+{
+    std::vector<char> bytes;
+    for (unsigned i = 0; i < num; ++i) {
+        mavlink_message_t message;
+        mavlink_msg_heartbeat_pack(sysid, 1, &message, MAV_TYPE_QUADROTOR,
+                                   MAV_AUTOPILOT_PX4, 0, i, 0);
+        uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+        uint16_t len = mavlink_msg_to_send_buffer(buffer, &message);
+        bytes.insert(bytes.end(), buffer, buffer + len);
+    }
+    return bytes;
+}
+
+TEST(MAVLinkReceiver, WholeFrames)
+{
+    MAVLinkReceiver receiver;
+    auto bytes = heartbeats(3, 42);
+
+    receiver.set_new_datagram(bytes.data(), bytes.size());
+
+    unsigned num_parsed = 0;
+    while (receiver.parse_message()) {
+        EXPECT_EQ(receiver.get_last_message().msgid, uint32_t(MAVLINK_MSG_ID_HEARTBEAT));
+        EXPECT_EQ(receiver.get_last_message().sysid, 42u);
+        EXPECT_EQ(mavlink_msg_heartbeat_get_custom_mode(&receiver.get_last_message()), num_parsed);
+        ++num_parsed;
+    }
+    EXPECT_EQ(num_parsed, 3u);
+}
+
+TEST(MAVLinkReceiver, FrameSplitAcrossReads)
+{
+    MAVLinkReceiver receiver;
+    auto bytes = heartbeats(2, 42);
+
+    // Cut in the middle of the second frame.
+    const unsigned first_len = bytes.size() / 2 + 3;
+
+    unsigned num_parsed = 0;
+    receiver.set_new_datagram(bytes.data(), first_len);
+    while (receiver.parse_message()) {
+        ++num_parsed;
+    }
+    EXPECT_EQ(num_parsed, 1u);
+
+    receiver.set_new_datagram(bytes.data() + first_len, bytes.size() - first_len);
+    while (receiver.parse_message()) {
+        EXPECT_EQ(mavlink_msg_heartbeat_get_custom_mode(&receiver.get_last_message()), 1u);
+        ++num_parsed;
+    }
+    EXPECT_EQ(num_parsed, 2u);
+}
+
+TEST(MAVLinkReceiver, GarbageAndBadCrc)
+{
+    MAVLinkReceiver receiver;
+    auto frames = heartbeats(2, 42);
+
+    std::vector<char> bytes {'x', 'y', 'z'};
+    bytes.insert(bytes.end(), frames.begin(), frames.end());
+    // Corrupt the checksum of the last frame.
+    bytes.back() ^= 0x55;
+
+    unsigned num_parsed = 0;
+    receiver.set_new_datagram(bytes.data(), bytes.size());
+    while (receiver.parse_message()) {
+        ++num_parsed;
+    }
+    EXPECT_EQ(num_parsed, 1u);
+}
+
+TEST(MAVLinkReceiver, ManyReceiversKeepTheirOwnState)
+{
+    // More than mavlink has channels, all in the middle of a frame at once.
+    const unsigned num_receivers = 64;
+    std::vector<MAVLinkReceiver> receivers(num_receivers);
+    std::vector<std::vector<char>> bytes;
+    for (unsigned i = 0; i < num_receivers; ++i) {
+        bytes.push_back(heartbeats(1, uint8_t(i + 1)));
+    }
+
+    // Five bytes are not a whole frame, so they go through the state machine.
+    for (unsigned i = 0; i < num_receivers; ++i) {
+        receivers[i].set_new_datagram(bytes[i].data(), 5);
+        EXPECT_FALSE(receivers[i].parse_message());
+    }
+
+    for (unsigned i = 0; i < num_receivers; ++i) {
+        receivers[i].set_new_datagram(bytes[i].data() + 5, bytes[i].size() - 5);
+        ASSERT_TRUE(receivers[i].parse_message());
+        EXPECT_EQ(receivers[i].get_last_message().sysid, i + 1);
+        EXPECT_FALSE(receivers[i].parse_message());
+    }
+}
+
+TEST(MAVLinkReceiver, CountsLostMessagesAndResyncs)
+{
+    MAVLinkReceiveCounters counters;
+    MAVLinkReceiver receiver(&counters);
+
+    auto bytes = heartbeats(10, 42);
+    const unsigned frame_len = unsigned(bytes.size()) / 10;
+    // The fourth and fifth heartbeat are lost, and there is noise after the eighth.
+    std::vector<char> received(bytes.begin(), bytes.begin() + 3 * frame_len);
+    received.insert(received.end(), bytes.begin() + 5 * frame_len, bytes.begin() + 8 * frame_len);
+    received.push_back(0x11);
+    received.push_back(0x22);
+    received.insert(received.end(), bytes.begin() + 8 * frame_len, bytes.end());
+
+    receiver.set_new_datagram(received.data(), received.size());
+    while (receiver.parse_message()) {}
+
+    EXPECT_EQ(counters.num_bytes.load(), received.size());
+    EXPECT_EQ(counters.num_messages.load(), 8u);
+    EXPECT_EQ(counters.num_messages_by_sysid[42].load(), 8u);
+    EXPECT_EQ(counters.num_lost.load(), 2u);
+    EXPECT_EQ(counters.num_lost_by_sysid[42].load(), 2u);
+    EXPECT_EQ(counters.num_resyncs.load(), 1u);
+    EXPECT_EQ(counters.num_crc_errors.load(), 0u);
+}
+
+TEST(MAVLinkReceiver, RecoversFramesAfterCorruptedLength)
+{
+    MAVLinkReceiveCounters counters;
+    MAVLinkReceiver receiver(&counters);
+
+    auto bytes = heartbeats(20, 42);
+    const unsigned frame_len = unsigned(bytes.size()) / 20;
+    // The parser waits for the bogus length, well into the following frames.
+    bytes[1] = 100;
+
+    unsigned num_parsed = 0;
+    receiver.set_new_datagram(bytes.data(), bytes.size());
+    while (receiver.parse_message()) {
+        EXPECT_EQ(mavlink_msg_heartbeat_get_custom_mode(&receiver.get_last_message()),
+                  num_parsed + 1);
+        ++num_parsed;
+    }
+
+    EXPECT_EQ(num_parsed, 19u);
+    EXPECT_EQ(counters.num_crc_errors.load(), 1u);
+    EXPECT_GE(counters.num_resyncs.load(), 1u);
+    EXPECT_EQ(counters.num_bytes_discarded.load(), frame_len);
+}
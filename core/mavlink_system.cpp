@@ -1,4 +1,5 @@
 #include "system.h"
+#include "completion.h"
 #include "global_include.h"
 #include "dronecore_impl.h"
 #include "mavlink_include.h"
@@ -7,6 +8,14 @@
 #include <functional>
 #include <algorithm>
 #include "px4_custom_mode.h"
+#include "trace_recorder.h"
+#include <cmath>
+#include <cstdlib>
+#include <typeinfo>
+
+#if defined(__GNUC__)
+#include <cxxabi.h>
+#endif
 
 // Set to 1 to log incoming/outgoing mavlink messages.
 #define MESSAGE_DEBUGGING 0
@@ -15,18 +24,36 @@ namespace dronecore {
 
 using namespace std::placeholders; // for `_1`
 
+// E.g. "TelemetryImpl", without the namespace.
+static std::string type_name_of(const PluginImplBase &plugin_impl)
+{
+    std::string name = typeid(plugin_impl).name();
+#if defined(__GNUC__)
+    int status = 0;
+    char *demangled = abi::__cxa_demangle(name.c_str(), nullptr, nullptr, &status);
+    if (demangled != nullptr) {
+        name = demangled;
+        free(demangled);
+    }
+#endif
+    const size_t last_colon = name.rfind(':');
+    if (last_colon != std::string::npos) {
+        name = name.substr(last_colon + 1);
+    }
+    return name;
+}
+
 MAVLinkSystem::MAVLinkSystem(DroneCoreImpl &parent,
                              uint8_t system_id, uint8_t comp_id) :
     _system_id(system_id),
     _parent(parent),
+    _link_watchdog(std::bind(&MAVLinkSystem::link_state_changed, this, _1)),
     _params(*this),
     _commands(*this),
     _timeout_handler(_time),
     _call_every_handler(_time)
 {
-    _system_thread = new std::thread(system_thread, this);
-
-    register_mavlink_message_handler(
+    register_mavlink_message_view_handler(
         MAVLINK_MSG_ID_HEARTBEAT,
         std::bind(&MAVLinkSystem::process_heartbeat, this, _1), this);
 
@@ -36,11 +63,41 @@ MAVLinkSystem::MAVLinkSystem(DroneCoreImpl &parent,
         MAVLINK_MSG_ID_AUTOPILOT_VERSION,
         std::bind(&MAVLinkSystem::process_autopilot_version, this, _1), this);
 
+    register_mavlink_message_handler(
+        MAVLINK_MSG_ID_TIMESYNC,
+        std::bind(&MAVLinkSystem::process_timesync, this, _1), this);
+
     register_mavlink_message_handler(
         MAVLINK_MSG_ID_STATUSTEXT,
         std::bind(&MAVLinkSystem::process_statustext, this, _1), this);
 
+    register_mavlink_message_handler<mavlink_global_position_int_t>(
+        std::bind(&MAVLinkSystem::process_global_position_int, this, _1), this);
+
+    register_mavlink_message_handler<mavlink_sys_status_t>(
+        std::bind(&MAVLinkSystem::process_sys_status, this, _1), this);
+
+    {
+        std::lock_guard<std::mutex> lock(_handler_usages_mutex);
+        _owner_names[this] = "MAVLinkSystem";
+        _owner_names[&_params] = "MAVLinkParameters";
+        _owner_names[&_commands] = "MAVLinkCommands";
+    }
+
     add_new_component(comp_id);
+
+    double degraded_timeout_s;
+    double lost_timeout_s;
+    _parent.get_link_loss_timeouts(degraded_timeout_s, lost_timeout_s);
+    _link_watchdog.set_timeouts(degraded_timeout_s, lost_timeout_s);
+
+    const std::string params_dir = state_subdir("params");
+    if (!params_dir.empty()) {
+        _params.set_persistent_cache_dir(params_dir);
+    }
+
+    // The first timesync is sent right away.
+    trigger_work();
 }
 
 MAVLinkSystem::~MAVLinkSystem()
@@ -50,12 +107,24 @@ MAVLinkSystem::~MAVLinkSystem()
 
     unregister_timeout_handler(_autopilot_version_timed_out_cookie);
     unregister_timeout_handler(_heartbeat_timeout_cookie);
+    {
+        std::lock_guard<std::mutex> lock(_status_text_timeout_mutex);
+        unregister_timeout_handler(_status_text_timeout_cookie);
+    }
 
-    if (_system_thread != nullptr) {
-        _system_thread->join();
-        delete _system_thread;
-        _system_thread = nullptr;
+    TimerScheduler::timer_id_t work_timer_id;
+    TimerScheduler::timer_id_t started_work_timer_id;
+    {
+        std::lock_guard<std::mutex> lock(_work_mutex);
+        work_timer_id = _work_timer_id;
+        started_work_timer_id = _started_work_timer_id;
+        _work_timer_id = 0;
+        _started_work_timer_id = 0;
     }
+    // Without _work_mutex, a do_work() which is running takes it. Once they
+    // return, neither can still run.
+    TimerScheduler::Instance().cancel(work_timer_id);
+    TimerScheduler::Instance().cancel(started_work_timer_id);
 }
 
 bool MAVLinkSystem::is_connected() const
@@ -63,38 +132,157 @@ bool MAVLinkSystem::is_connected() const
     return _connected;
 }
 
-void MAVLinkSystem::register_mavlink_message_handler(uint16_t msg_id,
+void MAVLinkSystem::register_mavlink_message_handler(uint32_t msg_id,
                                                      mavlink_message_handler_t callback,
                                                      const void *cookie)
 {
-    std::lock_guard<std::mutex> lock(_mavlink_handler_table_mutex);
+    add_mavlink_message_handler(msg_id, {callback, nullptr, cookie, nullptr, nullptr, nullptr});
+}
+
+void MAVLinkSystem::register_mavlink_message_view_handler(uint32_t msg_id,
+                                                          mavlink_message_view_handler_t callback,
+                                                          const void *cookie)
+{
+    add_mavlink_message_handler(msg_id, {nullptr, callback, cookie, nullptr, nullptr, nullptr});
+}
+
+void MAVLinkSystem::add_mavlink_message_handler(uint32_t msg_id,
+                                                const MAVLinkHandlerTable::Entry &entry)
+{
+    MAVLinkHandlerTable::Entry timed_entry = entry;
+    timed_entry.usage = &handler_usage(entry.cookie, msg_id);
+
+    update_mavlink_handler_table([msg_id, &timed_entry](MAVLinkHandlerTable & table) {
+        table.add(msg_id, timed_entry);
+    });
+}
+
+MAVLinkHandlerUsage &MAVLinkSystem::handler_usage(const void *cookie, uint32_t msg_id)
+{
+    std::lock_guard<std::mutex> lock(_handler_usages_mutex);
 
-    MAVLinkHandlerTableEntry entry = {msg_id, callback, cookie};
-    _mavlink_handler_table.push_back(entry);
+    std::unique_ptr<MAVLinkHandlerUsage> &usage = _handler_usages[std::make_pair(cookie, msg_id)];
+    if (!usage) {
+        usage.reset(new MAVLinkHandlerUsage());
+    }
+    return *usage;
+}
+
+std::vector<MAVLinkSystem::HandlerUsage> MAVLinkSystem::get_handler_usages()
+{
+    std::lock_guard<std::mutex> lock(_handler_usages_mutex);
+
+    std::vector<HandlerUsage> usages;
+    for (const auto &entry : _handler_usages) {
+        const MAVLinkHandlerUsage &usage = *entry.second;
+        usages.push_back(HandlerUsage {
+            entry.first.first, entry.first.second,
+            usage.num_calls.load(std::memory_order_relaxed),
+            usage.total_ns.load(std::memory_order_relaxed),
+            usage.max_ns.load(std::memory_order_relaxed)
+        });
+    }
+    return usages;
+}
+
+std::vector<CallEveryHandler::Usage> MAVLinkSystem::get_call_every_usages()
+{
+    return _call_every_handler.get_usages();
+}
+
+void MAVLinkSystem::add_resource_usage(DroneCore::ResourceUsage &usage)
+{
+    usage.num_handlers += std::atomic_load(&_mavlink_handler_table)->size();
+    usage.num_timers += _timeout_handler.size() + _call_every_handler.size();
+    usage.num_queued_work += _commands.num_work() + _params.num_work();
+
+    std::lock_guard<std::mutex> lock(_plugin_impls_mutex);
+    for (auto plugin_impl : _plugin_impls) {
+        plugin_impl->add_resource_usage(usage);
+    }
+}
+
+std::string MAVLinkSystem::owner_name_of(const void *cookie)
+{
+    std::lock_guard<std::mutex> lock(_handler_usages_mutex);
+
+    auto it = _owner_names.find(cookie);
+    return (it != _owner_names.end()) ? it->second : "unknown";
 }
 
 void MAVLinkSystem::unregister_all_mavlink_message_handlers(const void *cookie)
 {
-    std::lock_guard<std::mutex> lock(_mavlink_handler_table_mutex);
+    update_mavlink_handler_table([cookie](MAVLinkHandlerTable & table) {
+        table.remove_all(cookie);
+    });
 
-    for (auto it = _mavlink_handler_table.begin();
-         it != _mavlink_handler_table.end();
-         /* no ++it */) {
+    _parent.callback_executor().cancel(cookie);
+}
 
-        if (it->cookie == cookie) {
-            it = _mavlink_handler_table.erase(it);
-        } else {
-            ++it;
+void MAVLinkSystem::call_user_callback(const void *cookie, const void *topic,
+                                       CallbackExecutor::task_t callback,
+                                       CallbackExecutor::Overflow overflow)
+{
+    _parent.callback_executor().post(cookie, topic, std::move(callback), overflow);
+}
+
+// Only the address counts, the topic of all results.
+static const char result_topic = 0;
+
+void MAVLinkSystem::call_result_callback(const void *cookie, CallbackExecutor::task_t callback)
+{
+    _parent.callback_executor().post(cookie, &result_topic, std::move(callback),
+                                     CallbackExecutor::Overflow::BLOCK);
+}
+
+// Number of handler tables which the current thread is dispatching from.
+static thread_local unsigned dispatch_depth = 0;
+
+void MAVLinkSystem::update_mavlink_handler_table(
+    std::function<void(MAVLinkHandlerTable &)> change)
+{
+    std::shared_ptr<const MAVLinkHandlerTable> old_table;
+    {
+        std::lock_guard<instrumented_mutex_t> lock(_mavlink_handler_table_mutex);
+
+        old_table = std::atomic_load(&_mavlink_handler_table);
+
+        auto new_table = std::make_shared<MAVLinkHandlerTable>(*old_table);
+        change(*new_table);
+
+        // The bits are updated before the table is published. A message which
+        // passes the bit test meanwhile is simply not found in the old table.
+        uint64_t wanted_ids[NUM_WANTED_IDS / 64] {};
+        for (uint32_t msg_id : new_table->ids()) {
+            if (msg_id < NUM_WANTED_IDS) {
+                wanted_ids[msg_id / 64] |= uint64_t(1) << (msg_id % 64);
+            }
+        }
+        for (size_t i = 0; i < NUM_WANTED_IDS / 64; ++i) {
+            _wanted_ids[i].store(wanted_ids[i], std::memory_order_relaxed);
+        }
+
+        std::atomic_store(&_mavlink_handler_table,
+                          std::shared_ptr<const MAVLinkHandlerTable>(new_table));
+    }
+
+    // Once we return, the caller may destroy whatever the removed callbacks
+    // point to. Therefore, we need to wait until the old table is no longer
+    // used for dispatching. If we are called from a callback itself, we can't
+    // wait for ourselves though.
+    if (dispatch_depth == 0) {
+        while (old_table.use_count() > 1) {
+            std::this_thread::yield();
         }
     }
-    _mavlink_handler_table.clear();
 }
 
-void MAVLinkSystem::register_timeout_handler(std::function<void()> callback,
+void MAVLinkSystem::register_timeout_handler(Callback<void()> callback,
                                              double duration_s,
                                              void **cookie)
 {
-    _timeout_handler.add(callback, duration_s, cookie);
+    _timeout_handler.add(std::move(callback), duration_s, cookie);
+    schedule_work(_time.steady_time_in_future(duration_s));
 }
 
 void MAVLinkSystem::refresh_timeout_handler(const void *cookie)
@@ -107,46 +295,72 @@ void MAVLinkSystem::unregister_timeout_handler(const void *cookie)
     _timeout_handler.remove(cookie);
 }
 
+bool MAVLinkSystem::accept_message(uint32_t msg_id)
+{
+    if (msg_id >= NUM_WANTED_IDS) {
+        return true;
+    }
+
+    if (_wanted_ids[msg_id / 64].load(std::memory_order_relaxed) &
+        (uint64_t(1) << (msg_id % 64))) {
+        return true;
+    }
+
+    _num_unwanted_messages.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+uint64_t MAVLinkSystem::num_unwanted_messages() const
+{
+    return _num_unwanted_messages.load(std::memory_order_relaxed);
+}
+
 void MAVLinkSystem::process_mavlink_message(const mavlink_message_t &message)
 {
+    process_mavlink_message(MAVLinkMessageView(message));
+}
+
+void MAVLinkSystem::process_mavlink_message(const MAVLinkMessageView &message)
+{
+    // Whatever it is, the link works.
+    _link_watchdog.received(_time.cached_steady_time());
+
     if (_communication_locked) {
         return;
     }
 
-    std::lock_guard<std::mutex> lock(_mavlink_handler_table_mutex);
+    const std::shared_ptr<const MAVLinkHandlerTable> table =
+        std::atomic_load(&_mavlink_handler_table);
 
+    const MAVLinkHandlerTable::entries_t *entries = table->find(message.msgid());
+    if (entries == nullptr) {
 #if MESSAGE_DEBUGGING==1
-    bool forwarded = false;
-#endif
-    for (auto it = _mavlink_handler_table.begin(); it != _mavlink_handler_table.end(); ++it) {
-        if (it->msg_id == message.msgid) {
-#if MESSAGE_DEBUGGING==1
-            LogDebug() << "Forwarding msg " << int(message.msgid) << " to " << size_t(it->cookie);
-            forwarded = true;
+        LogDebug() << "Ignoring msg " << int(message.msgid());
 #endif
-            it->callback(message);
-        }
-    }
-#if MESSAGE_DEBUGGING==1
-    if (!forwarded) {
-        LogDebug() << "Ignoring msg " << int(message.msgid);
+        return;
     }
-#endif
+
+    ++dispatch_depth;
+    MAVLinkHandlerTable::dispatch(*entries, message);
+    --dispatch_depth;
 }
 
-void MAVLinkSystem::add_call_every(std::function<void()> callback, float interval_s, void **cookie)
+void MAVLinkSystem::add_call_every(Callback<void()> callback, float interval_s, void **cookie)
 {
-    _call_every_handler.add(callback, interval_s, cookie);
+    _call_every_handler.add(std::move(callback), interval_s, cookie);
+    schedule_next_work();
 }
 
 void MAVLinkSystem::change_call_every(float interval_s, const void *cookie)
 {
     _call_every_handler.change(interval_s, cookie);
+    schedule_next_work();
 }
 
 void MAVLinkSystem::reset_call_every(const void *cookie)
 {
     _call_every_handler.reset(cookie);
+    schedule_next_work();
 }
 
 void MAVLinkSystem::remove_call_every(const void *cookie)
@@ -154,34 +368,128 @@ void MAVLinkSystem::remove_call_every(const void *cookie)
     _call_every_handler.remove(cookie);
 }
 
-void MAVLinkSystem::process_heartbeat(const mavlink_message_t &message)
+bool MAVLinkSystem::get_call_every_jitter(const void *cookie, CallEveryHandler::Jitter &jitter)
 {
-    mavlink_heartbeat_t heartbeat;
-    mavlink_msg_heartbeat_decode(&message, &heartbeat);
+    return _call_every_handler.get_jitter(cookie, jitter);
+}
 
-    if (message.compid == MAVLinkCommands::DEFAULT_COMPONENT_ID_AUTOPILOT) {
-        _armed = ((heartbeat.base_mode & MAV_MODE_FLAG_SAFETY_ARMED) ? true : false);
-        _hitl_enabled = ((heartbeat.base_mode & MAV_MODE_FLAG_HIL_ENABLED) ? true : false);
+void MAVLinkSystem::process_heartbeat(const MAVLinkMessageView &message)
+{
+    if (message.compid() == MAVLinkCommands::DEFAULT_COMPONENT_ID_AUTOPILOT) {
+        const uint8_t base_mode = message.get<uint8_t>(heartbeat_offset::base_mode);
+        _armed = ((base_mode & MAV_MODE_FLAG_SAFETY_ARMED) ? true : false);
+        _hitl_enabled = ((base_mode & MAV_MODE_FLAG_HIL_ENABLED) ? true : false);
+    }
+
+    // A vehicle which speaks both may start with MAVLink 1 until it hears
+    // MAVLink 2, so a MAVLink 1 heartbeat alone doesn't tell.
+    if (!message.is_mavlink1()) {
+        set_mavlink_version(2);
     }
 
     // We do not call on_discovery here but wait with the notification until we know the UUID.
 
     /* If the component is an autopilot and
      * we don't know its UUID, then try to find out. */
-    if (is_autopilot(message.compid) && !have_uuid()) {
-        request_autopilot_version();
+    if (is_autopilot(message.compid()) && !have_uuid()) {
+        if (!restore_state()) {
+            request_autopilot_version();
+        }
 
-    } else if (!is_autopilot(message.compid)
+    } else if (!is_autopilot(message.compid())
                && !have_uuid() && ++_non_autopilot_heartbeats >= 2) {
         // We've received consecutive heartbeats (atleast twice) from a
         // non-autopilot system! Lets not delay for filling UUID anymore.
-        _uuid = message.sysid;
+        _uuid = message.sysid();
         _uuid_initialized = true;
     }
 
     set_connected();
 }
 
+void MAVLinkSystem::set_mavlink_version(unsigned version)
+{
+    // Once MAVLink 2 was seen, that is what it speaks.
+    if (_mavlink_version == version || _mavlink_version == 2) {
+        return;
+    }
+    _mavlink_version = version;
+    LogDebug() << "System " << int(_system_id) << " speaks MAVLink " << version;
+    _parent.set_mavlink_version(_system_id, version);
+}
+
+void MAVLinkSystem::process_timesync(const mavlink_message_t &message)
+{
+    if (message.compid != MAVLinkCommands::DEFAULT_COMPONENT_ID_AUTOPILOT) {
+        return;
+    }
+
+    const int64_t now_ns = host_time_ns();
+
+    mavlink_timesync_t timesync;
+    mavlink_msg_timesync_decode(&message, &timesync);
+
+    if (timesync.tc1 == 0) {
+        // The vehicle wants to know our time.
+        mavlink_message_t answer;
+        mavlink_msg_timesync_pack(GCSClient::system_id, GCSClient::component_id, &answer,
+                                  now_ns, timesync.ts1);
+        send_message(answer);
+        return;
+    }
+
+    if (timesync.ts1 != _timesync_sent_ns || timesync.ts1 == 0) {
+        return;
+    }
+
+    const int64_t last_vehicle_time_ns = _last_vehicle_time_ns.exchange(timesync.tc1);
+    if (last_vehicle_time_ns != 0 &&
+        timesync.tc1 + REBOOT_TIME_JUMP_NS < last_vehicle_time_ns) {
+        vehicle_rebooted();
+    }
+
+    _timesync.add_sample(timesync.ts1, timesync.tc1, now_ns);
+}
+
+void MAVLinkSystem::vehicle_rebooted()
+{
+    if (!is_connected()) {
+        // Everything is set again when it is.
+        return;
+    }
+
+    // Quicker than the heartbeat timeout, so we might not even have noticed.
+    LogInfo() << "System " << int(_system_id) << " rebooted";
+    reapply_msg_rates();
+}
+
+void MAVLinkSystem::send_timesync()
+{
+    const int64_t now_ns = host_time_ns();
+    _timesync_sent_ns = now_ns;
+
+    mavlink_message_t message;
+    mavlink_msg_timesync_pack(GCSClient::system_id, GCSClient::component_id, &message,
+                              0, now_ns);
+    send_message(message);
+}
+
+int64_t MAVLinkSystem::host_time_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               _time.steady_time().time_since_epoch()).count();
+}
+
+bool MAVLinkSystem::vehicle_time_to_host_us(uint64_t vehicle_us, uint64_t &host_us) const
+{
+    int64_t host_ns;
+    if (!_timesync.vehicle_to_host_ns(int64_t(vehicle_us) * 1000, host_ns) || host_ns < 0) {
+        return false;
+    }
+    host_us = uint64_t(host_ns / 1000);
+    return true;
+}
+
 void MAVLinkSystem::process_autopilot_version(const mavlink_message_t &message)
 {
     // Ignore if they don't come from the autopilot component
@@ -195,7 +503,31 @@ void MAVLinkSystem::process_autopilot_version(const mavlink_message_t &message)
     _supports_mission_int =
         ((autopilot_version.capabilities & MAV_PROTOCOL_CAPABILITY_MISSION_INT) ? true : false);
 
-    if (_uuid == 0 && autopilot_version.uid != 0) {
+    if ((autopilot_version.capabilities & MAV_PROTOCOL_CAPABILITY_MAVLINK2) ||
+        message.magic != MAVLINK_STX_MAVLINK1) {
+        set_mavlink_version(2);
+    } else {
+        set_mavlink_version(1);
+    }
+
+    std::unique_lock<std::mutex> uuid_lock(_uuid_mutex);
+    const bool was_restored = _uuid_restored;
+    _uuid_restored = false;
+    const uint64_t uuid = (autopilot_version.uid != 0) ?
+                          autopilot_version.uid : uint64_t(_system_id);
+    if (was_restored && _uuid != uuid) {
+        // Another vehicle got the system id since the state was saved, so
+        // whoever found the old one needs to forget it.
+        LogWarn() << "System " << int(_system_id) << " is not the one of the saved state";
+        uuid_lock.unlock();
+        set_disconnected();
+        uuid_lock.lock();
+        _uuid = uuid;
+
+    } else if (was_restored) {
+        // Just confirmed.
+
+    } else if (_uuid == 0 && autopilot_version.uid != 0) {
 
         // This is the best case. The system has a UUID and we were able to get it.
         _uuid = autopilot_version.uid;
@@ -211,12 +543,162 @@ void MAVLinkSystem::process_autopilot_version(const mavlink_message_t &message)
         LogErr() << "Error: UUID changed";
     }
 
-
     _uuid_initialized = true;
-    set_connected();
-
     _autopilot_version_pending = false;
+    _autopilot_version = autopilot_version;
+    _have_autopilot_version = true;
+    uuid_lock.unlock();
+
     unregister_timeout_handler(_autopilot_version_timed_out_cookie);
+    set_connected();
+
+    if (was_restored) {
+        // The autopilot version might have changed with an update.
+        save_state();
+    }
+}
+
+bool MAVLinkSystem::restore_state()
+{
+    {
+        std::lock_guard<std::mutex> lock(_uuid_mutex);
+        if (_state_checked || _uuid_initialized) {
+            return false;
+        }
+        _state_checked = true;
+    }
+
+    SystemStateStore::Snapshot snapshot;
+    if (!_parent.system_state_store().find_by_system_id(_system_id, snapshot)) {
+        return false;
+    }
+
+    // Before the UUID is set, so that they don't each save the state again.
+    for (uint8_t component_id : snapshot.component_ids) {
+        add_new_component(component_id);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_saved_missions_mutex);
+        for (auto &mission : snapshot.missions) {
+            const uint8_t type = mission.type;
+            _saved_missions[type] = std::move(mission);
+        }
+    }
+
+    if (snapshot.have_autopilot_version) {
+        const uint64_t capabilities = snapshot.autopilot_version.capabilities;
+        _supports_mission_int =
+            ((capabilities & MAV_PROTOCOL_CAPABILITY_MISSION_INT) ? true : false);
+        if (capabilities & MAV_PROTOCOL_CAPABILITY_MAVLINK2) {
+            set_mavlink_version(2);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_uuid_mutex);
+        _uuid = snapshot.uuid;
+        if (snapshot.have_autopilot_version) {
+            _autopilot_version = snapshot.autopilot_version;
+            _have_autopilot_version = true;
+        }
+        _uuid_restored = true;
+        _uuid_initialized = true;
+    }
+    LogDebug() << "Restored " << std::hex << snapshot.uuid << std::dec << " from the saved state";
+
+    // Only to check, an answer would be the same as before most of the time.
+    MAVLinkCommands::CommandLong command {};
+    command.command = MAV_CMD_REQUEST_AUTOPILOT_CAPABILITIES;
+    command.params.param1 = 1.0f;
+    command.target_component_id = get_autopilot_id();
+    send_command_async(command, nullptr);
+    return true;
+}
+
+void MAVLinkSystem::save_state()
+{
+    SystemStateStore &store = _parent.system_state_store();
+    if (!store.is_open()) {
+        return;
+    }
+
+    SystemStateStore::Snapshot snapshot;
+    {
+        std::lock_guard<std::mutex> lock(_uuid_mutex);
+        if (!_uuid_initialized) {
+            return;
+        }
+        snapshot.uuid = _uuid;
+        snapshot.have_autopilot_version = _have_autopilot_version;
+        snapshot.autopilot_version = _autopilot_version;
+    }
+    snapshot.system_id = _system_id;
+    snapshot.component_ids.assign(_components.begin(), _components.end());
+    {
+        std::lock_guard<std::mutex> lock(_saved_missions_mutex);
+        for (const auto &type_and_mission : _saved_missions) {
+            snapshot.missions.push_back(type_and_mission.second);
+        }
+    }
+    store.save(snapshot);
+}
+
+std::string MAVLinkSystem::state_subdir(const std::string &name)
+{
+    return _parent.system_state_store().subdir(name);
+}
+
+bool MAVLinkSystem::get_saved_mission(uint8_t mission_type, uint64_t &hash,
+                                      std::vector<uint64_t> &item_hashes)
+{
+    std::lock_guard<std::mutex> lock(_saved_missions_mutex);
+    auto it = _saved_missions.find(mission_type);
+    if (it == _saved_missions.end()) {
+        return false;
+    }
+    hash = it->second.hash;
+    item_hashes = it->second.item_hashes;
+    return true;
+}
+
+void MAVLinkSystem::save_mission(uint8_t mission_type, bool known, uint64_t hash,
+                                 const std::vector<uint64_t> &item_hashes)
+{
+    {
+        std::lock_guard<std::mutex> lock(_saved_missions_mutex);
+        if (known) {
+            _saved_missions[mission_type] = SystemStateStore::Mission {mission_type, hash,
+                                                                       item_hashes};
+        } else {
+            _saved_missions.erase(mission_type);
+        }
+    }
+    save_state();
+}
+
+void MAVLinkSystem::process_global_position_int(
+    const mavlink_global_position_int_t &global_position_int)
+{
+    const float heading_deg = (global_position_int.hdg == UINT16_MAX) ?
+                              NAN : global_position_int.hdg * 1e-2f;
+
+    _parent.fleet_telemetry_store().set_position(_system_id,
+                                                 global_position_int.lat * 1e-7,
+                                                 global_position_int.lon * 1e-7,
+                                                 global_position_int.alt * 1e-3f,
+                                                 global_position_int.relative_alt * 1e-3f,
+                                                 heading_deg);
+}
+
+void MAVLinkSystem::process_sys_status(const mavlink_sys_status_t &sys_status)
+{
+    const float voltage_v = (sys_status.voltage_battery == UINT16_MAX) ?
+                            NAN : sys_status.voltage_battery * 1e-3f;
+    const float remaining_percent = (sys_status.battery_remaining < 0) ?
+                                    NAN : sys_status.battery_remaining * 1e-2f;
+
+    _parent.fleet_telemetry_store().set_battery(_system_id, voltage_v, remaining_percent);
 }
 
 void MAVLinkSystem::process_statustext(const mavlink_message_t &message)
@@ -224,43 +706,109 @@ void MAVLinkSystem::process_statustext(const mavlink_message_t &message)
     mavlink_statustext_t statustext;
     mavlink_msg_statustext_decode(&message, &statustext);
 
-    std::string debug_str = "MAVLink: ";
+    // The id and chunk_seq of MAVLink 2 follow the text, read from the payload
+    // as they are extensions. They are cut off with the trailing zeros if 0.
+    const uint8_t *payload = reinterpret_cast<const uint8_t *>(message.payload64);
+    const unsigned id_offset = 1 + StatusTextLog::CHUNK_LEN;
+    uint16_t id = 0;
+    uint8_t chunk_seq = 0;
+    if (message.len > id_offset) {
+        id = payload[id_offset];
+    }
+    if (message.len > id_offset + 1) {
+        id = uint16_t(id | (payload[id_offset + 1] << 8));
+    }
+    if (message.len > id_offset + 2) {
+        chunk_seq = payload[id_offset + 2];
+    }
+
+    std::vector<StatusTextLog::Entry> completed;
+    _status_text_log.add(message.compid, statustext.severity, statustext.text, id, chunk_seq,
+                         uint64_t(host_time_ns() / 1000), completed);
+    if (id != 0) {
+        // In case this chunk turns out to be the last one to come.
+        restart_status_text_timeout();
+    }
+    notify_status_texts(completed);
+}
+
+void MAVLinkSystem::notify_status_texts(const std::vector<StatusTextLog::Entry> &completed)
+{
+    if (completed.empty()) {
+        return;
+    }
 
-    switch (statustext.severity) {
+    std::vector<status_text_callback_t> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(_status_text_callbacks_mutex);
+        for (const auto &cookie_and_callback : _status_text_callbacks) {
+            callbacks.push_back(cookie_and_callback.second);
+        }
+    }
+
+    for (const auto &entry : completed) {
+        // Compiled out of release builds, printing takes too long on this thread.
+        LogDebug() << "MAVLink: " << severity_str(entry.severity) << ": " << entry.text;
+        for (const auto &callback : callbacks) {
+            callback(entry);
+        }
+    }
+}
+
+void MAVLinkSystem::restart_status_text_timeout()
+{
+    std::lock_guard<std::mutex> lock(_status_text_timeout_mutex);
+    unregister_timeout_handler(_status_text_timeout_cookie);
+    register_timeout_handler(std::bind(&MAVLinkSystem::status_text_timed_out, this),
+                             StatusTextLog::PENDING_TIMEOUT_S,
+                             &_status_text_timeout_cookie);
+}
+
+void MAVLinkSystem::status_text_timed_out()
+{
+    std::vector<StatusTextLog::Entry> completed;
+    if (_status_text_log.flush_pending(uint64_t(host_time_ns() / 1000), completed)) {
+        // Another component's text got a chunk more recently.
+        restart_status_text_timeout();
+    }
+    notify_status_texts(completed);
+}
+
+const char *MAVLinkSystem::severity_str(uint8_t severity)
+{
+    switch (severity) {
         case MAV_SEVERITY_EMERGENCY:
-            debug_str += "emergency";
-            break;
+            return "emergency";
         case MAV_SEVERITY_ALERT:
-            debug_str += "alert";
-            break;
+            return "alert";
         case MAV_SEVERITY_CRITICAL:
-            debug_str += "critical";
-            break;
+            return "critical";
         case MAV_SEVERITY_ERROR:
-            debug_str += "error";
-            break;
+            return "error";
         case MAV_SEVERITY_WARNING:
-            debug_str += "warning";
-            break;
+            return "warning";
         case MAV_SEVERITY_NOTICE:
-            debug_str += "notice";
-            break;
+            return "notice";
         case MAV_SEVERITY_INFO:
-            debug_str += "info";
-            break;
+            return "info";
         case MAV_SEVERITY_DEBUG:
-            debug_str += "debug";
-            break;
+            return "debug";
         default:
-            break;
+            return "unknown";
     }
+}
 
-    // statustext.text is not null terminated, therefore we copy it first to
-    // an array big enough that is zeroed.
-    char text_with_null[sizeof(statustext.text) + 1] {};
-    memcpy(text_with_null, statustext.text, sizeof(statustext.text));
+void MAVLinkSystem::register_status_text_callback(status_text_callback_t callback,
+                                                  const void *cookie)
+{
+    std::lock_guard<std::mutex> lock(_status_text_callbacks_mutex);
+    _status_text_callbacks[cookie] = std::move(callback);
+}
 
-    LogDebug() << debug_str << ": " << text_with_null;
+void MAVLinkSystem::unregister_status_text_callback(const void *cookie)
+{
+    std::lock_guard<std::mutex> lock(_status_text_callbacks_mutex);
+    _status_text_callbacks.erase(cookie);
 }
 
 void MAVLinkSystem::heartbeats_timed_out()
@@ -269,30 +817,122 @@ void MAVLinkSystem::heartbeats_timed_out()
     set_disconnected();
 }
 
-void MAVLinkSystem::system_thread(MAVLinkSystem *self)
+void MAVLinkSystem::link_state_changed(LinkWatchdog::State state)
+{
+    // Nobody could tell which system it is about yet.
+    if (!have_uuid()) {
+        return;
+    }
+    _parent.notify_on_link_state(_uuid, state);
+}
+
+void MAVLinkSystem::set_link_loss_timeouts(double degraded_timeout_s, double lost_timeout_s)
 {
-    dl_time_t last_time {};
+    _link_watchdog.set_timeouts(degraded_timeout_s, lost_timeout_s);
+}
 
-    while (!self->_should_exit) {
+void MAVLinkSystem::trigger_work()
+{
+    schedule_work(_time.steady_time());
+}
 
-        if (self->_time.elapsed_since_s(last_time) >= MAVLinkSystem::_HEARTBEAT_SEND_INTERVAL_S) {
-            send_heartbeat(*self);
-            last_time = self->_time.steady_time();
-        }
+bool MAVLinkSystem::await_condition(const std::function<bool()> &condition, double timeout_s)
+{
+    if (dispatch_depth > 0) {
+        LogErr() << "Can't wait for a condition in a message handler";
+        return condition();
+    }
 
-        self->_call_every_handler.run_once();
-        self->_timeout_handler.run_once();
-        self->_params.do_work();
-        self->_commands.do_work();
+    std::unique_lock<std::mutex> lock(_waiters_mutex);
+    return _waiters_cv.wait_for(lock, std::chrono::duration<double>(timeout_s), condition);
+}
 
-        if (self->_connected) {
-            // Work fairly fast if we're connected.
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        } else {
-            // Be less aggressive when unconnected.
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+void MAVLinkSystem::notify_waiters()
+{
+    // With the lock, a waiter has either not checked the condition yet or is
+    // already waiting, so the notification can't get lost in between.
+    std::lock_guard<std::mutex> lock(_waiters_mutex);
+    _waiters_cv.notify_all();
+}
+
+void MAVLinkSystem::do_work()
+{
+    TraceScope scope("system", "do_work", get_system_id());
+
+    if (_should_exit) {
+        return;
+    }
+
+    // Our heartbeats are sent by DroneCoreImpl, once for all systems. Once a
+    // second is plenty to follow the drift of the vehicle clock.
+    if (_connected &&
+        _time.elapsed_since_s(_last_timesync_time) >= MAVLinkSystem::_TIMESYNC_SEND_INTERVAL_S) {
+        _last_timesync_time = _time.steady_time();
+        send_timesync();
+    }
+
+    _call_every_handler.run_once();
+    _timeout_handler.run_once();
+    _params.do_work();
+    _commands.do_work();
+
+    schedule_next_work();
+}
+
+void MAVLinkSystem::schedule_next_work()
+{
+    // Params and commands call trigger_work() whenever they have something new
+    // to do, so only the timers need to be considered here. While disconnected
+    // there is no timesync, so without timers we don't wake up at all.
+    bool has_deadline = false;
+    dl_time_t deadline {};
+    if (_connected) {
+        deadline = _last_timesync_time;
+        _time.shift_steady_time_by(deadline, MAVLinkSystem::_TIMESYNC_SEND_INTERVAL_S);
+        has_deadline = true;
+    }
+
+    dl_time_t next_deadline;
+    if (_call_every_handler.next_deadline(next_deadline) &&
+        (!has_deadline || next_deadline < deadline)) {
+        deadline = next_deadline;
+        has_deadline = true;
+    }
+    if (_timeout_handler.next_deadline(next_deadline) &&
+        (!has_deadline || next_deadline < deadline)) {
+        deadline = next_deadline;
+        has_deadline = true;
+    }
+
+    if (has_deadline) {
+        schedule_work(deadline);
+    }
+}
+
+void MAVLinkSystem::schedule_work(dl_time_t deadline)
+{
+    std::lock_guard<std::mutex> lock(_work_mutex);
+
+    if (_should_exit) {
+        return;
+    }
+
+    if (_work_timer_id != 0) {
+        if (_work_deadline <= deadline && TimerScheduler::Instance().is_pending(_work_timer_id)) {
+            // We are going to be woken up early enough anyway.
+            return;
+        }
+        // Without waiting, as the do_work() which is running might be the
+        // caller, or need a lock the caller holds.
+        if (!TimerScheduler::Instance().cancel_if_pending(_work_timer_id)) {
+            // Only one runs at a time, so the one before is done by now.
+            _started_work_timer_id = _work_timer_id;
         }
     }
+
+    _work_deadline = deadline;
+    _work_timer_id = TimerScheduler::Instance().add(
+                         std::bind(&MAVLinkSystem::do_work, this), deadline);
 }
 
 std::string MAVLinkSystem::component_name(uint8_t component_id)
@@ -324,6 +964,9 @@ void MAVLinkSystem::add_new_component(uint8_t component_id)
     auto res_pair = _components.insert(component_id);
     if (res_pair.second) {
         LogDebug() << "Component " << component_name(component_id) << " added.";
+        if (have_uuid()) {
+            save_state();
+        }
     }
 }
 
@@ -379,19 +1022,6 @@ bool MAVLinkSystem::has_gimbal() const
     return get_gimbal_id() == MAV_COMP_ID_GIMBAL;
 }
 
-void MAVLinkSystem::send_heartbeat(MAVLinkSystem &self)
-{
-    mavlink_message_t message;
-    // GCSClient is not autopilot!; hence MAV_AUTOPILOT_INVALID.
-    mavlink_msg_heartbeat_pack(GCSClient::system_id,
-                               GCSClient::component_id,
-                               &message,
-                               MAV_TYPE_GCS,
-                               MAV_AUTOPILOT_INVALID,
-                               0, 0, 0);
-    self.send_message(message);
-}
-
 bool MAVLinkSystem::send_message(const mavlink_message_t &message)
 {
     if (_communication_locked) {
@@ -404,25 +1034,40 @@ bool MAVLinkSystem::send_message(const mavlink_message_t &message)
     return _parent.send_message(message);
 }
 
-void MAVLinkSystem::request_autopilot_version()
+bool MAVLinkSystem::send_messages(const mavlink_message_t *messages, size_t num_messages)
 {
-    if (_uuid_initialized) {
-        // Already initialized, we can exit.
-        return;
+    if (_communication_locked) {
+        return false;
     }
 
-    if (!_autopilot_version_pending && _uuid_retries >= 3) {
-        // We give up getting a UUID and use the system ID.
+    return _parent.send_messages(messages, num_messages);
+}
 
-        LogWarn() << "No UUID received, using system ID instead.";
-        _uuid = _system_id;
-        _uuid_initialized = true;
+void MAVLinkSystem::request_autopilot_version()
+{
+    {
+        std::lock_guard<std::mutex> lock(_uuid_mutex);
+        if (_uuid_initialized || _autopilot_version_pending) {
+            // Already initialized or waiting for the answer, we can exit.
+            return;
+        }
+
+        if (_uuid_retries >= UUID_MAX_RETRIES) {
+            // We give up getting a UUID and use the system ID.
+            LogWarn() << "No UUID received, using system ID instead.";
+            _uuid = _system_id;
+            _uuid_initialized = true;
+        } else {
+            _autopilot_version_pending = true;
+            ++_uuid_retries;
+        }
+    }
+
+    if (_uuid_initialized) {
         set_connected();
         return;
     }
 
-    _autopilot_version_pending = true;
-
     // We don't care about an answer, we mostly care about receiving AUTOPILOT_VERSION.
     MAVLinkCommands::CommandLong command {};
 
@@ -431,19 +1076,15 @@ void MAVLinkSystem::request_autopilot_version()
     command.target_component_id = get_autopilot_id();
 
     send_command_async(command, nullptr);
-    ++_uuid_retries;
 
-    // We set a timeout to stay "pending" for half a second. This way, we don't give up too
-    // early e.g. because multiple components send heartbeats and we receive them all at once
-    // and run out of retries.
-
-    // We create a temp reference, so we don't need to capture `this`.
-    auto &pending_tmp = _autopilot_version_pending;
+    // Instead of waiting for the next heartbeat we ask again soon. Heartbeats of
+    // other components arriving meanwhile don't use up the retries.
     register_timeout_handler(
-    [&pending_tmp]() {
-        pending_tmp = false;
+    [this]() {
+        _autopilot_version_pending = false;
+        request_autopilot_version();
     },
-    0.5,
+    UUID_RETRY_INTERVAL_S,
     &_autopilot_version_timed_out_cookie);
 }
 
@@ -458,6 +1099,8 @@ void MAVLinkSystem::set_connected()
             LogDebug() << "Found " << _components.size() << " component(s).";
 
             LogDebug() << "Discovered " << _uuid;
+            _parent.index_system_uuid(_system_id, _uuid);
+            _parent.fleet_telemetry_store().set_uuid(_system_id, _uuid);
             _parent.notify_on_discover(_uuid);
             _connected = true;
 
@@ -472,9 +1115,20 @@ void MAVLinkSystem::set_connected()
         // If not yet connected there is nothing to do/
     }
     if (enable_needed) {
+        // Timesync starts again right away.
+        trigger_work();
+
+        // Params from an earlier connection might still be good.
+        _params.load_persistent_cache();
+
+        // Before the plugins request theirs, which are merged into these.
+        reapply_msg_rates();
+
+        save_state();
+
         std::lock_guard<std::mutex> lock(_plugin_impls_mutex);
         for (auto plugin_impl : _plugin_impls) {
-            plugin_impl->enable();
+            plugin_impl->on_connected();
         }
     }
 }
@@ -493,10 +1147,27 @@ void MAVLinkSystem::set_disconnected()
         _parent.notify_on_timeout(_uuid);
     }
 
+    // After a reboot the vehicle clock starts over.
+    _timesync.reset();
+    _last_vehicle_time_ns = 0;
+    // The link might be a different one when it comes back.
+    _rtt_estimator.reset();
+
+    {
+        // The vehicle might have rebooted and forgotten the rates, so they need
+        // to be sent again whatever was set before.
+        std::lock_guard<std::mutex> lock(_message_rates_mutex);
+        for (auto &message_rate : _message_rates) {
+            message_rate.second.active_hz = 0.0;
+        }
+    }
+
+    _params.invalidate_param_cache();
+
     {
         std::lock_guard<std::mutex> lock(_plugin_impls_mutex);
         for (auto plugin_impl : _plugin_impls) {
-            plugin_impl->disable();
+            plugin_impl->on_disconnected();
         }
     }
 }
@@ -507,6 +1178,16 @@ uint64_t MAVLinkSystem::get_uuid() const
     return _uuid;
 }
 
+bool MAVLinkSystem::get_autopilot_version(mavlink_autopilot_version_t &autopilot_version)
+{
+    std::lock_guard<std::mutex> lock(_uuid_mutex);
+    if (!_have_autopilot_version) {
+        return false;
+    }
+    autopilot_version = _autopilot_version;
+    return true;
+}
+
 uint8_t MAVLinkSystem::get_system_id() const
 {
     return _system_id;
@@ -557,15 +1238,61 @@ void MAVLinkSystem::get_param_float_async(const std::string &name,
 void MAVLinkSystem::set_param_async(const std::string &name,
                                     MAVLinkParameters::ParamValue value,
                                     success_t callback,
-                                    bool extended)
+                                    bool extended,
+                                    uint8_t component_id)
+{
+    _params.set_param_async(name, value, callback, extended, component_id);
+}
+
+void MAVLinkSystem::get_params_async(const std::vector<std::string> &names,
+                                     MAVLinkParameters::get_params_callback_t callback)
 {
-    _params.set_param_async(name, value, callback, extended);
+    _params.get_params_async(names, callback);
+}
+
+void MAVLinkSystem::set_params_async(
+    const std::map<std::string, MAVLinkParameters::ParamValue> &params,
+    MAVLinkParameters::set_params_callback_t callback)
+{
+    _params.set_params_async(params, callback);
+}
+
+bool MAVLinkSystem::read_param_file(const std::string &path,
+                                    std::map<std::string, MAVLinkParameters::ParamValue> &params)
+{
+    return _params.read_param_file(path, params);
+}
+
+callback_handle_t MAVLinkSystem::subscribe_param_changed(
+    const std::string &name,
+    MAVLinkParameters::param_changed_callback_t callback,
+    bool is_prefix)
+{
+    return _params.subscribe_param_changed(name, callback, is_prefix);
+}
+
+void MAVLinkSystem::unsubscribe_param_changed(callback_handle_t handle)
+{
+    _params.unsubscribe_param_changed(handle);
+}
+
+void MAVLinkSystem::fetch_all_params_async(success_t callback)
+{
+    _params.fetch_all_params_async(callback);
+}
+
+void MAVLinkSystem::fetch_all_ext_params_async(
+    MAVLinkParameters::ext_param_value_callback_t value_callback,
+    success_t callback,
+    uint8_t component_id)
+{
+    _params.fetch_all_ext_params_async(value_callback, callback, component_id);
 }
 
 void MAVLinkSystem::get_param_async(const std::string &name, get_param_callback_t callback,
-                                    bool extended)
+                                    bool extended, uint8_t component_id)
 {
-    _params.get_param_async(name, callback, extended);
+    _params.get_param_async(name, callback, extended, component_id);
 }
 
 MAVLinkCommands::Result
@@ -741,6 +1468,48 @@ MAVLinkSystem::send_command(MAVLinkCommands::CommandInt &command)
     return _commands.send_command(command);
 }
 
+bool MAVLinkSystem::send_command_unacked(MAVLinkCommands::CommandLong &command)
+{
+    if (_system_id == 0 && _components.size() == 0) {
+        return false;
+    }
+    command.target_system_id = get_system_id();
+    return _commands.send_command_unacked(command);
+}
+
+MAVLinkCommands::Result
+MAVLinkSystem::send_commands(std::vector<MAVLinkCommands::CommandLong> &commands,
+                             std::vector<MAVLinkCommands::Result> *results)
+{
+    if (_system_id == 0 && _components.size() == 0) {
+        if (results != nullptr) {
+            results->assign(commands.size(), MAVLinkCommands::Result::NO_SYSTEM);
+        }
+        return MAVLinkCommands::Result::NO_SYSTEM;
+    }
+    for (auto &command : commands) {
+        command.target_system_id = get_system_id();
+    }
+    return _commands.send_commands(commands, results);
+}
+
+void MAVLinkSystem::send_commands_async(std::vector<MAVLinkCommands::CommandLong> &commands,
+                                        batch_result_callback_t callback)
+{
+    if (_system_id == 0 && _components.size() == 0) {
+        if (callback) {
+            callback(MAVLinkCommands::Result::NO_SYSTEM,
+                     std::vector<MAVLinkCommands::Result>(commands.size(),
+                                                          MAVLinkCommands::Result::NO_SYSTEM));
+        }
+        return;
+    }
+    for (auto &command : commands) {
+        command.target_system_id = get_system_id();
+    }
+    _commands.queue_commands_async(commands, std::move(callback));
+}
+
 void MAVLinkSystem::send_command_async(MAVLinkCommands::CommandLong &command,
                                        command_result_callback_t callback)
 {
@@ -773,34 +1542,191 @@ void MAVLinkSystem::send_command_async(MAVLinkCommands::CommandInt &command,
 MAVLinkCommands::Result
 MAVLinkSystem::set_msg_rate(uint16_t message_id,
                             double rate_hz,
-                            uint8_t component_id)
+                            uint8_t component_id,
+                            const void *requester)
 {
-    MAVLinkCommands::CommandLong command_msg_rate {};
+    // We wrap the async call with a completion to wait for.
+    Completion<MAVLinkCommands::Result> completion;
 
-    auto result = make_command_msg_rate(message_id,
-                                        rate_hz,
-                                        component_id,
-                                        command_msg_rate);
-    if (result == MAVLinkCommands::Result::SUCCESS) {
-        result = send_command(command_msg_rate);
-    }
+    set_msg_rate_async(message_id, rate_hz,
+    [&completion](MAVLinkCommands::Result result, float progress) {
+        UNUSED(progress);
+        completion.complete(result);
+    }, component_id, requester);
 
-    return result;
+    return completion.wait();
 }
 
 void MAVLinkSystem::set_msg_rate_async(uint16_t message_id,
                                        double rate_hz,
                                        command_result_callback_t callback,
-                                       uint8_t component_id)
+                                       uint8_t component_id,
+                                       const void *requester)
+{
+    if (!(rate_hz > 0)) {
+        LogErr() << "Rate(Hz) is invalid: " << rate_hz;
+        if (callback) {
+            callback(MAVLinkCommands::Result::UNKNOWN_ERROR, NAN);
+        }
+        return;
+    }
+
+    const message_rate_key_t key = (message_rate_key_t(component_id) << 16) | message_id;
+
+    double max_rate_hz = 0.0;
+    bool already_active = false;
+    {
+        std::lock_guard<std::mutex> lock(_message_rates_mutex);
+
+        MessageRate &message_rate = _message_rates[key];
+        message_rate.requested_hz[requester] = rate_hz;
+
+        for (const auto &requested : message_rate.requested_hz) {
+            max_rate_hz = std::max(max_rate_hz, requested.second);
+        }
+
+        if (message_rate.sending) {
+            // This gets looked at once the command in flight is done.
+            message_rate.pending_callbacks.push_back(callback);
+            return;
+        }
+
+        if (are_equal(max_rate_hz, message_rate.active_hz)) {
+            already_active = true;
+        } else {
+            message_rate.sending = true;
+            message_rate.sending_hz = max_rate_hz;
+            message_rate.sending_callbacks.push_back(callback);
+        }
+    }
+
+    if (already_active) {
+        // Nothing changes on the vehicle, so there is no need to send anything.
+        if (callback) {
+            callback(MAVLinkCommands::Result::SUCCESS, 1.0f);
+        }
+        return;
+    }
+
+    send_msg_rate(key, max_rate_hz);
+}
+
+void MAVLinkSystem::send_msg_rate(message_rate_key_t key, double rate_hz)
 {
     MAVLinkCommands::CommandLong command_msg_rate {};
 
-    auto result = make_command_msg_rate(message_id,
+    auto result = make_command_msg_rate(uint16_t(key & 0xFFFF),
                                         rate_hz,
-                                        component_id,
+                                        uint8_t(key >> 16),
                                         command_msg_rate);
-    if (result == MAVLinkCommands::Result::SUCCESS) {
-        send_command_async(command_msg_rate, callback);
+    if (result != MAVLinkCommands::Result::SUCCESS) {
+        receive_msg_rate_result(key, result);
+        return;
+    }
+
+    send_command_async(command_msg_rate,
+                       std::bind(&MAVLinkSystem::receive_msg_rate_result, this, key, _1));
+}
+
+void MAVLinkSystem::reapply_msg_rates()
+{
+    std::vector<message_rate_key_t> keys;
+    std::vector<MAVLinkCommands::CommandLong> commands;
+    {
+        std::lock_guard<std::mutex> lock(_message_rates_mutex);
+
+        for (auto &key_and_rate : _message_rates) {
+            MessageRate &message_rate = key_and_rate.second;
+            message_rate.active_hz = 0.0;
+            if (message_rate.sending || message_rate.requested_hz.empty()) {
+                // One in flight is looked at again once it is done.
+                continue;
+            }
+
+            double max_rate_hz = 0.0;
+            for (const auto &requested : message_rate.requested_hz) {
+                max_rate_hz = std::max(max_rate_hz, requested.second);
+            }
+
+            MAVLinkCommands::CommandLong command {};
+            if (make_command_msg_rate(uint16_t(key_and_rate.first & 0xFFFF),
+                                      max_rate_hz,
+                                      uint8_t(key_and_rate.first >> 16),
+                                      command) != MAVLinkCommands::Result::SUCCESS) {
+                continue;
+            }
+
+            message_rate.sending = true;
+            message_rate.sending_hz = max_rate_hz;
+            keys.push_back(key_and_rate.first);
+            commands.push_back(command);
+        }
+    }
+
+    if (commands.empty()) {
+        return;
+    }
+
+    LogDebug() << "Setting " << commands.size() << " message rate(s) again";
+    auto shared_keys = std::make_shared<std::vector<message_rate_key_t>>(std::move(keys));
+    send_commands_async(commands,
+                        [this, shared_keys](MAVLinkCommands::Result result,
+    const std::vector<MAVLinkCommands::Result> &results) {
+        UNUSED(result);
+        for (size_t i = 0; i < shared_keys->size(); ++i) {
+            receive_msg_rate_result((*shared_keys)[i], results[i]);
+        }
+    });
+}
+
+void MAVLinkSystem::receive_msg_rate_result(message_rate_key_t key,
+                                            MAVLinkCommands::Result result)
+{
+    std::vector<command_result_callback_t> done_callbacks;
+    std::vector<command_result_callback_t> also_done_callbacks;
+    bool send_again = false;
+    double max_rate_hz = 0.0;
+    {
+        std::lock_guard<std::mutex> lock(_message_rates_mutex);
+
+        MessageRate &message_rate = _message_rates[key];
+        message_rate.sending = false;
+        if (result == MAVLinkCommands::Result::SUCCESS) {
+            message_rate.active_hz = message_rate.sending_hz;
+        }
+        done_callbacks.swap(message_rate.sending_callbacks);
+
+        if (!message_rate.pending_callbacks.empty()) {
+            for (const auto &requested : message_rate.requested_hz) {
+                max_rate_hz = std::max(max_rate_hz, requested.second);
+            }
+
+            if (are_equal(max_rate_hz, message_rate.active_hz)) {
+                // The requests in between were superseded by what we just set.
+                also_done_callbacks.swap(message_rate.pending_callbacks);
+            } else {
+                send_again = true;
+                message_rate.sending = true;
+                message_rate.sending_hz = max_rate_hz;
+                message_rate.sending_callbacks.swap(message_rate.pending_callbacks);
+            }
+        }
+    }
+
+    const float progress = (result == MAVLinkCommands::Result::SUCCESS) ? 1.0f : NAN;
+    for (const auto &callback : done_callbacks) {
+        if (callback) {
+            callback(result, progress);
+        }
+    }
+    for (const auto &callback : also_done_callbacks) {
+        if (callback) {
+            callback(MAVLinkCommands::Result::SUCCESS, 1.0f);
+        }
+    }
+
+    if (send_again) {
+        send_msg_rate(key, max_rate_hz);
     }
 }
 
@@ -833,6 +1759,13 @@ void MAVLinkSystem::register_plugin(PluginImplBase *plugin_impl)
 {
     assert(plugin_impl);
 
+    {
+        // Plugins use themselves as the cookie for their handlers. The name is
+        // kept, as the handlers are counted after the plugin is gone.
+        std::lock_guard<std::mutex> lock(_handler_usages_mutex);
+        _owner_names[dynamic_cast<const void *>(plugin_impl)] = type_name_of(*plugin_impl);
+    }
+
     plugin_impl->init();
 
     {
@@ -842,10 +1775,15 @@ void MAVLinkSystem::register_plugin(PluginImplBase *plugin_impl)
 
     // If we're connected already, let's enable it straightaway.
     if (_connected) {
-        plugin_impl->enable();
+        plugin_impl->on_connected();
     }
 }
 
+bool MAVLinkSystem::plugins_on_first_use() const
+{
+    return _parent.plugins_on_first_use();
+}
+
 void MAVLinkSystem::unregister_plugin(PluginImplBase *plugin_impl)
 {
     assert(plugin_impl);
@@ -1,11 +1,24 @@
 #pragma once
 
 #include "global_include.h"
+#include "callback_executor.h"
+#include "dronecore.h"
 #include "mavlink_include.h"
+#include "mavlink_message_table.h"
+#include "mavlink_message_view.h"
+#include "mavlink_handler_table.h"
+#include "lock_stats.h"
+#include "mavlink_message_traits.h"
 #include "mavlink_parameters.h"
 #include "mavlink_commands.h"
 #include "timeout_handler.h"
 #include "call_every_handler.h"
+#include "timer_scheduler.h"
+#include "timesync_estimator.h"
+#include "rtt_estimator.h"
+#include "link_watchdog.h"
+#include "system_state_store.h"
+#include "status_text_log.h"
 #include <cstdint>
 #include <functional>
 #include <atomic>
@@ -14,6 +27,10 @@
 #include <map>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <string>
+#include <utility>
 
 namespace dronecore {
 
@@ -51,29 +68,108 @@ public:
     ~MAVLinkSystem();
 
     void process_mavlink_message(const mavlink_message_t &message);
+    void process_mavlink_message(const MAVLinkMessageView &message);
 
-    typedef std::function<void(const mavlink_message_t &)> mavlink_message_handler_t;
+    // Returns false if no handler is registered for msg_id and counts the message
+    // as unwanted, so the caller can drop it before doing anything else with it.
+    bool accept_message(uint32_t msg_id);
+    uint64_t num_unwanted_messages() const;
 
-    void register_mavlink_message_handler(uint16_t msg_id,
+    typedef MAVLinkHandlerTable::mavlink_message_handler_t mavlink_message_handler_t;
+
+    void register_mavlink_message_handler(uint32_t msg_id,
                                           mavlink_message_handler_t callback,
                                           const void *cookie);
 
+    // View handlers get the message without it being copied first. The view
+    // is only valid during the callback.
+    typedef MAVLinkHandlerTable::mavlink_message_view_handler_t mavlink_message_view_handler_t;
+
+    void register_mavlink_message_view_handler(uint32_t msg_id,
+                                               mavlink_message_view_handler_t callback,
+                                               const void *cookie);
+
+    // Typed handlers get the decoded struct, with the id taken from
+    // MAVLinkMessageTraits, e.g.
+    //   register_mavlink_message_handler<mavlink_heartbeat_t>(callback, this);
+    // However many typed handlers there are, a message is only decoded once.
+    template<typename T, typename F>
+    void register_mavlink_message_handler(F callback, const void *cookie)
+    {
+        static_assert(sizeof(T) <= MAVLinkHandlerTable::MAX_DECODED_LEN,
+                      "Decoded message does not fit");
+
+        add_mavlink_message_handler(
+            MAVLinkMessageTraits<T>::id, {
+            nullptr, nullptr, cookie, &MAVLinkMessageTraits<T>::decode,
+            [callback](const void *decoded) {
+                callback(*static_cast<const T *>(decoded));
+            },
+            nullptr
+        });
+    }
+
+    // Also drops the user callbacks of cookie which have not been called yet.
     void unregister_all_mavlink_message_handlers(const void *cookie);
 
-    void register_timeout_handler(std::function<void()> callback,
+    // Calls a user callback off the receive thread, after the ones before with
+    // the same cookie and topic, see CallbackExecutor. All plugin callbacks go
+    // through this or call_result_callback(), so none runs on the receive thread.
+    void call_user_callback(const void *cookie, const void *topic,
+                            CallbackExecutor::task_t callback,
+                            CallbackExecutor::Overflow overflow =
+                                CallbackExecutor::Overflow::DROP_OLDEST);
+    // Same for the result of a request, which is never dropped. The results
+    // of one cookie are called in the order they came.
+    void call_result_callback(const void *cookie, CallbackExecutor::task_t callback);
+
+    void register_timeout_handler(Callback<void()> callback,
                                   double duration_s,
                                   void **cookie);
     void refresh_timeout_handler(const void *cookie);
     void unregister_timeout_handler(const void *cookie);
 
-    void add_call_every(std::function<void()> callback, float interval_s, void **cookie);
+    void add_call_every(Callback<void()> callback, float interval_s, void **cookie);
     void change_call_every(float interval_s, const void *cookie);
     void reset_call_every(const void *cookie);
     void remove_call_every(const void *cookie);
+    bool get_call_every_jitter(const void *cookie, CallEveryHandler::Jitter &jitter);
+
+    // Time spent in the handlers registered with a cookie for a message id,
+    // on whichever thread dispatched to them.
+    struct HandlerUsage {
+        const void *cookie;
+        uint32_t msg_id;
+        uint64_t num_calls;
+        uint64_t total_ns;
+        uint64_t max_ns;
+    };
+    std::vector<HandlerUsage> get_handler_usages();
+    std::vector<CallEveryHandler::Usage> get_call_every_usages();
+    // Of the core of the system and all its plugins.
+    void add_resource_usage(DroneCore::ResourceUsage &usage);
+
+    // The plugin or part of the core which registered with the cookie, or
+    // "unknown".
+    std::string owner_name_of(const void *cookie);
+
+    // Makes sure that queued parameter or command work gets looked at soon.
+    void trigger_work();
+
+    // Blocks until condition() returns true or timeout_s has passed, instead of
+    // polling. The condition is checked again whenever notify_waiters() is
+    // called, so whoever changes what it looks at has to call that afterwards,
+    // without holding a lock which the condition takes. Returns false on
+    // timeout. Must not be used in a message handler, that would stall the
+    // receiving.
+    bool await_condition(const std::function<bool()> &condition, double timeout_s);
+    void notify_waiters();
 
     bool send_message(const mavlink_message_t &message);
+    // For bursts, e.g. the same message to many systems.
+    bool send_messages(const mavlink_message_t *messages, size_t num_messages);
 
-    typedef std::function<void(MAVLinkCommands::Result, float)> command_result_callback_t;
+    typedef MAVLinkCommands::command_result_callback_t command_result_callback_t;
 
     // FIXME: I tried to use templates for these;
     // but I get undefined reference. Need to dig it later.
@@ -87,13 +183,33 @@ public:
     void send_command_async(MAVLinkCommands::CommandInt &command,
                             command_result_callback_t callback);
 
+    bool send_command_unacked(MAVLinkCommands::CommandLong &command);
+
+    // Sends independent commands in one burst and completes once all are
+    // acked or failed, see MAVLinkCommands::queue_commands_async().
+    typedef MAVLinkCommands::batch_result_callback_t batch_result_callback_t;
+    MAVLinkCommands::Result send_commands(std::vector<MAVLinkCommands::CommandLong> &commands,
+                                          std::vector<MAVLinkCommands::Result> *results = nullptr);
+    void send_commands_async(std::vector<MAVLinkCommands::CommandLong> &commands,
+                             batch_result_callback_t callback);
+
+    // When the system is now reached on another connection.
+    void retransmit_commands() { _commands.retransmit_in_flight(); }
+
+    // The rate requested for a message is remembered for each requester (usually
+    // the plugin) and the highest one wins. Requests made while the previous one
+    // for the same message is still being sent are merged into one command.
+    // All of them are set again in one burst when the system connects again or
+    // its autopilot reboots.
     MAVLinkCommands::Result
     set_msg_rate(uint16_t message_id, double rate_hz,
-                 uint8_t component_id = MAV_COMP_ID_AUTOPILOT1);
+                 uint8_t component_id = MAV_COMP_ID_AUTOPILOT1,
+                 const void *requester = nullptr);
 
     void set_msg_rate_async(uint16_t message_id, double rate_hz,
                             command_result_callback_t callback,
-                            uint8_t component_id = MAV_COMP_ID_AUTOPILOT1);
+                            uint8_t component_id = MAV_COMP_ID_AUTOPILOT1,
+                            const void *requester = nullptr);
 
     void request_autopilot_version();
 
@@ -113,13 +229,45 @@ public:
     uint64_t get_uuid() const;
     uint8_t get_system_id() const;
 
+    // The AUTOPILOT_VERSION of the autopilot, once received. It is kept across
+    // reconnects, so plugins made later get it without asking again.
+    bool get_autopilot_version(mavlink_autopilot_version_t &autopilot_version);
+
     void set_system_id(uint8_t system_id);
 
     bool does_support_mission_int() const { return _supports_mission_int; }
 
+    // See DroneCore::set_link_loss_timeouts().
+    void set_link_loss_timeouts(double degraded_timeout_s, double lost_timeout_s);
+
+    // The directory for the cache of this name in the state directory, see
+    // DroneCore::set_state_dir(), or an empty string if there is none.
+    std::string state_subdir(const std::string &name);
+
+    // The hashes of the mission of this type which the vehicle holds, kept with
+    // the state of the system, so possibly from an earlier run.
+    bool get_saved_mission(uint8_t mission_type, uint64_t &hash,
+                           std::vector<uint64_t> &item_hashes);
+    void save_mission(uint8_t mission_type, bool known, uint64_t hash,
+                      const std::vector<uint64_t> &item_hashes);
+
+    // The STATUSTEXT messages of all components, put back together. The
+    // callbacks are called on the receive thread with each complete text.
+    typedef std::function<void(const StatusTextLog::Entry &)> status_text_callback_t;
+    void register_status_text_callback(status_text_callback_t callback, const void *cookie);
+    void unregister_status_text_callback(const void *cookie);
+    uint64_t get_status_texts(uint64_t since_seq, std::vector<StatusTextLog::Entry> &entries) const
+    {
+        return _status_text_log.copy_since(since_seq, entries);
+    }
+
+    // 2 once a frame or AUTOPILOT_VERSION shows MAVLink 2, 1 if the vehicle
+    // left it out of its capabilities, 0 until then.
+    unsigned mavlink_version() const { return _mavlink_version; }
+
     bool is_armed() const { return _armed; }
 
-    typedef std::function <void(bool success)> success_t;
+    typedef Callback<void(bool success)> success_t;
     void set_param_float_async(const std::string &name, float value, success_t callback);
     void set_param_int_async(const std::string &name, int32_t value, success_t callback);
     void set_param_ext_float_async(const std::string &name, float value, success_t callback);
@@ -132,29 +280,67 @@ public:
                                command_result_callback_t callback,
                                uint8_t component_id = MAV_COMP_ID_AUTOPILOT1);
 
-    typedef std::function <void(bool success, float value)> get_param_float_callback_t;
-    typedef std::function <void(bool success, int32_t value)> get_param_int_callback_t;
+    typedef Callback<void(bool success, float value)> get_param_float_callback_t;
+    typedef Callback<void(bool success, int32_t value)> get_param_int_callback_t;
 
     void get_param_float_async(const std::string &name, get_param_float_callback_t callback);
     void get_param_int_async(const std::string &name, get_param_int_callback_t callback);
     void get_param_ext_float_async(const std::string &name, get_param_float_callback_t callback);
     void get_param_ext_int_async(const std::string &name, get_param_int_callback_t callback);
 
-    typedef std::function <void(bool success, MAVLinkParameters::ParamValue value)>
+    typedef Callback<void(bool success, MAVLinkParameters::ParamValue value)>
     get_param_callback_t;
 
+    // Extended params are those of the camera with component_id.
     void set_param_async(const std::string &name,
                          MAVLinkParameters::ParamValue value,
                          success_t callback,
-                         bool extended = false);
+                         bool extended = false,
+                         uint8_t component_id = MAV_COMP_ID_CAMERA);
+
+    // Gets several autopilot params ahead of other requests, see MAVLinkParameters.
+    void get_params_async(const std::vector<std::string> &names,
+                          MAVLinkParameters::get_params_callback_t callback);
+
+    // Sets only the params which differ from the cached values, see MAVLinkParameters.
+    void set_params_async(const std::map<std::string, MAVLinkParameters::ParamValue> &params,
+                          MAVLinkParameters::set_params_callback_t callback);
+
+    bool read_param_file(const std::string &path,
+                         std::map<std::string, MAVLinkParameters::ParamValue> &params);
+
+    // Notices changes of autopilot params without polling them.
+    callback_handle_t subscribe_param_changed(
+        const std::string &name,
+        MAVLinkParameters::param_changed_callback_t callback,
+        bool is_prefix = false);
+    void unsubscribe_param_changed(callback_handle_t handle);
+
+    // Fills the param cache so that getting autopilot params is answered locally.
+    void fetch_all_params_async(success_t callback);
+
+    // Gets all camera params with one request, each one handed over as it arrives.
+    void fetch_all_ext_params_async(MAVLinkParameters::ext_param_value_callback_t value_callback,
+                                    success_t callback,
+                                    uint8_t component_id = MAV_COMP_ID_CAMERA);
+
     void get_param_async(const std::string &name, get_param_callback_t callback,
-                         bool extended = false);
+                         bool extended = false, uint8_t component_id = MAV_COMP_ID_CAMERA);
 
     bool is_connected() const;
 
     Time &get_time() { return _time; };
 
+    // Puts a time of the vehicle, since its boot, on the steady clock of
+    // get_time(). Returns false until TIMESYNC has given an estimate.
+    bool vehicle_time_to_host_us(uint64_t vehicle_us, uint64_t &host_us) const;
+    TimesyncEstimator::Status get_timesync_status() const { return _timesync.status(); }
+
+    // Round trips of commands and params, for their timeouts.
+    RttEstimator &rtt_estimator() { return _rtt_estimator; }
+
     void register_plugin(PluginImplBase *plugin_impl);
+    bool plugins_on_first_use() const;
     void unregister_plugin(PluginImplBase *plugin_impl);
 
     // This allows a plugin to lock and unlock all mavlink communication.
@@ -175,17 +361,36 @@ private:
 
     bool have_uuid() const { return _uuid != 0 && _uuid_initialized; }
 
-    void process_heartbeat(const mavlink_message_t &message);
+    void process_heartbeat(const MAVLinkMessageView &message);
     void process_autopilot_version(const mavlink_message_t &message);
+    // Takes the UUID and what else is known from the state of an earlier run,
+    // instead of waiting for AUTOPILOT_VERSION, which is still asked for to
+    // check it. Returns false if there is none for this system id.
+    bool restore_state();
+    void save_state();
+    void set_mavlink_version(unsigned version);
+    void process_timesync(const mavlink_message_t &message);
+    void send_timesync();
+    int64_t host_time_ns();
     void process_statustext(const mavlink_message_t &message);
+    // Also for the texts completed by StatusTextLog::flush_pending().
+    void notify_status_texts(const std::vector<StatusTextLog::Entry> &completed);
+    void restart_status_text_timeout();
+    void status_text_timed_out();
+    static const char *severity_str(uint8_t severity);
+    // Only for the fleet telemetry, plugins have handlers of their own.
+    void process_global_position_int(const mavlink_global_position_int_t &global_position_int);
+    void process_sys_status(const mavlink_sys_status_t &sys_status);
     void heartbeats_timed_out();
+    void link_state_changed(LinkWatchdog::State state);
     void set_connected();
     void set_disconnected();
 
     static std::string component_name(uint8_t component_id);
 
-    static void system_thread(MAVLinkSystem *self);
-    static void send_heartbeat(MAVLinkSystem &self);
+    void do_work();
+    void schedule_work(dl_time_t deadline);
+    void schedule_next_work();
 
     // Last argument will hold Flight mode command.
     MAVLinkCommands::Result
@@ -200,30 +405,65 @@ private:
                           uint8_t component_id,
                           MAVLinkCommands::CommandLong &command);
 
+    typedef uint32_t message_rate_key_t;
+    void send_msg_rate(message_rate_key_t key, double rate_hz);
+    void reapply_msg_rates();
+    void vehicle_rebooted();
+    void receive_msg_rate_result(message_rate_key_t key, MAVLinkCommands::Result result);
+
     static void receive_float_param(bool success, MAVLinkParameters::ParamValue value,
                                     get_param_float_callback_t callback);
     static void receive_int_param(bool success, MAVLinkParameters::ParamValue value,
                                   get_param_int_callback_t callback);
 
-    struct MAVLinkHandlerTableEntry {
-        uint16_t msg_id;
-        mavlink_message_handler_t callback;
-        const void *cookie; // This is the identification to unregister.
+    void add_mavlink_message_handler(uint32_t msg_id, const MAVLinkHandlerTable::Entry &entry);
+    MAVLinkHandlerUsage &handler_usage(const void *cookie, uint32_t msg_id);
+    void update_mavlink_handler_table(std::function<void(MAVLinkHandlerTable &)> change);
+
+    // The table is never modified once published. Dispatch reads the current table
+    // using atomic_load without locking, while registration copies it, applies the
+    // change and publishes the copy. The mutex only serializes the writers.
+    instrumented_mutex_t _mavlink_handler_table_mutex {"mavlink_handler_table"};
+    std::shared_ptr<const MAVLinkHandlerTable> _mavlink_handler_table {
+        std::make_shared<const MAVLinkHandlerTable>()
     };
 
-    std::mutex _mavlink_handler_table_mutex {};
-    std::vector<MAVLinkHandlerTableEntry> _mavlink_handler_table {};
+    // Kept after the handlers are unregistered, as an old table might still be
+    // dispatching to them.
+    std::mutex _handler_usages_mutex {};
+    std::map<std::pair<const void *, uint32_t>, std::unique_ptr<MAVLinkHandlerUsage>>
+    _handler_usages {};
+    std::map<const void *, std::string> _owner_names {};
+
+    // One bit per message id which has handlers, kept in sync with the table by
+    // the writers. It covers the ids in use today; messages with higher ids are
+    // always looked up in the table.
+    static constexpr uint32_t NUM_WANTED_IDS = MAVLinkMessageTable::NUM_DIRECT_IDS;
+    std::atomic<uint64_t> _wanted_ids[NUM_WANTED_IDS / 64] {};
+    std::atomic<uint64_t> _num_unwanted_messages {0};
 
     std::atomic<uint8_t> _system_id;
 
     uint64_t _uuid {0};
 
+    // Guards the UUID while it is requested from the receive and timer threads.
+    std::mutex _uuid_mutex {};
     int _uuid_retries = 0;
+    static constexpr int UUID_MAX_RETRIES = 4;
+    static constexpr double UUID_RETRY_INTERVAL_S = 0.25;
     std::atomic<bool> _uuid_initialized {false};
+    // Guarded by _uuid_mutex, like the UUID which comes with it.
+    bool _have_autopilot_version = false;
+    mavlink_autopilot_version_t _autopilot_version {};
+    // The saved state is only looked for once, and the UUID taken from it is
+    // not confirmed until AUTOPILOT_VERSION comes.
+    bool _state_checked = false;
+    bool _uuid_restored = false;
 
     uint8_t _non_autopilot_heartbeats = 0;
 
     bool _supports_mission_int {false};
+    std::atomic<unsigned> _mavlink_version {0};
     std::atomic<bool> _armed {false};
     std::atomic<bool> _hitl_enabled {false};
 
@@ -231,11 +471,25 @@ private:
 
     command_result_callback_t _command_result_callback {nullptr};
 
-    std::thread *_system_thread {nullptr};
     std::atomic<bool> _should_exit {false};
 
+    // Instead of a thread per system, the work is done on the shared timer
+    // scheduler whenever the next timeout, call every or timesync is due.
+    std::mutex _work_mutex {};
+    TimerScheduler::timer_id_t _work_timer_id = 0;
+    // The one replaced after it had started, which might still be running.
+    TimerScheduler::timer_id_t _started_work_timer_id = 0;
+    dl_time_t _work_deadline {};
+    dl_time_t _last_timesync_time {};
+
+    std::mutex _waiters_mutex {};
+    std::condition_variable _waiters_cv {};
+
     static constexpr double _HEARTBEAT_TIMEOUT_S = 3.0;
 
+    // Fed by every message of the system, on its own timer.
+    LinkWatchdog _link_watchdog;
+
     std::mutex _connection_mutex {};
     bool _connected {false};
     void *_heartbeat_timeout_cookie = nullptr;
@@ -243,7 +497,10 @@ private:
     std::atomic<bool> _autopilot_version_pending {false};
     void *_autopilot_version_timed_out_cookie = nullptr;
 
-    static constexpr double _HEARTBEAT_SEND_INTERVAL_S = 1.0;
+    static constexpr double _TIMESYNC_SEND_INTERVAL_S = 1.0;
+
+    // Before the users of it.
+    RttEstimator _rtt_estimator {};
 
     MAVLinkParameters _params;
 
@@ -254,11 +511,42 @@ private:
 
     Time _time {};
 
+    TimesyncEstimator _timesync {};
+    // Of the last request, to tell our answers from those to someone else.
+    std::atomic<int64_t> _timesync_sent_ns {0};
+    // The clock of the autopilot counts from boot, so it going back means a reboot.
+    std::atomic<int64_t> _last_vehicle_time_ns {0};
+    static constexpr int64_t REBOOT_TIME_JUMP_NS = 1000000000;
+
     std::atomic<bool> _communication_locked {false};
 
+    struct MessageRate {
+        std::map<const void *, double> requested_hz {};
+        // What the vehicle confirmed last, 0 if nothing.
+        double active_hz = 0.0;
+        // The command currently being sent, and who waits for it.
+        bool sending = false;
+        double sending_hz = 0.0;
+        std::vector<command_result_callback_t> sending_callbacks {};
+        // Requests which came in meanwhile.
+        std::vector<command_result_callback_t> pending_callbacks {};
+    };
+    std::mutex _message_rates_mutex {};
+    std::map<message_rate_key_t, MessageRate> _message_rates {};
+
     std::mutex _plugin_impls_mutex {};
     std::vector<PluginImplBase *> _plugin_impls {};
 
+    std::mutex _saved_missions_mutex {};
+    std::map<uint8_t, SystemStateStore::Mission> _saved_missions {};
+
+    StatusTextLog _status_text_log {};
+    // For chunked texts whose last chunk got lost.
+    std::mutex _status_text_timeout_mutex {};
+    void *_status_text_timeout_cookie = nullptr;
+    std::mutex _status_text_callbacks_mutex {};
+    std::map<const void *, status_text_callback_t> _status_text_callbacks {};
+
     // We used set to maintain unique component ids
     std::unordered_set<uint8_t> _components;
 };
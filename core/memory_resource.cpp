@@ -0,0 +1,99 @@
+#include "memory_resource.h"
+#include "log.h"
+#include <cstdlib>
+#include <new>
+
+namespace dronecore {
+
+namespace {
+
+class NewDeleteResource : public MemoryResource
+{
+protected:
+    void *do_allocate(size_t bytes, size_t alignment) override
+    {
+        // C++11 new does not respect over-alignment, nothing in here needs it.
+        (void)alignment;
+        return ::operator new(bytes);
+    }
+
+    void do_deallocate(void *pointer, size_t bytes, size_t alignment) override
+    {
+        (void)bytes;
+        (void)alignment;
+        ::operator delete(pointer);
+    }
+};
+
+std::atomic<MemoryResource *> &default_resource()
+{
+    static std::atomic<MemoryResource *> resource {new_delete_resource()};
+    return resource;
+}
+
+} // namespace
+
+MemoryResource *new_delete_resource()
+{
+    static NewDeleteResource resource;
+    return &resource;
+}
+
+MemoryResource *get_default_resource()
+{
+    return default_resource().load();
+}
+
+MemoryResource *set_default_resource(MemoryResource *resource)
+{
+    return default_resource().exchange(resource ? resource : new_delete_resource());
+}
+
+MonotonicBufferResource::MonotonicBufferResource(void *buffer, size_t size,
+                                                 MemoryResource *upstream) :
+    _buffer(static_cast<uint8_t *>(buffer)),
+    _size(size),
+    _upstream(upstream)
+{
+}
+
+MonotonicBufferResource::~MonotonicBufferResource()
+{
+}
+
+void *MonotonicBufferResource::do_allocate(size_t bytes, size_t alignment)
+{
+    const uintptr_t begin = reinterpret_cast<uintptr_t>(_buffer);
+
+    // Taken without a lock, whoever moves _used first gets the part.
+    size_t used = _used.load();
+    while (true) {
+        const uintptr_t aligned = (begin + used + alignment - 1) / alignment * alignment;
+        const size_t end = size_t(aligned - begin) + bytes;
+        if (end > _size) {
+            break;
+        }
+        if (_used.compare_exchange_weak(used, end)) {
+            return reinterpret_cast<void *>(aligned);
+        }
+    }
+
+    if (_upstream) {
+        return _upstream->allocate(bytes, alignment);
+    }
+
+    // We don't have exceptions, so we abort like a failed new would.
+    LogErr() << "Memory buffer of " << _size << " bytes used up, " << bytes << " more needed";
+    abort();
+}
+
+void MonotonicBufferResource::do_deallocate(void *pointer, size_t bytes, size_t alignment)
+{
+    const uintptr_t begin = reinterpret_cast<uintptr_t>(_buffer);
+    const uintptr_t part = reinterpret_cast<uintptr_t>(pointer);
+    if (_upstream && (part < begin || part >= begin + _size)) {
+        _upstream->deallocate(pointer, bytes, alignment);
+    }
+}
+
+} // namespace dronecore
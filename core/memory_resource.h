@@ -0,0 +1,180 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace dronecore {
+
+/**
+ * @brief Source of memory for the internals of DroneCore, like std::pmr::memory_resource.
+ *
+ * Queues, handler tables and telemetry histories allocate from the resource which is the
+ * default when they are constructed, see DroneCore::set_memory_resource().
+ *
+ * Resources need to be thread-safe, they are used by all threads of DroneCore.
+ */
+class MemoryResource
+{
+public:
+    virtual ~MemoryResource() {}
+
+    /**
+     * @brief Allocate memory, never returns nullptr.
+     */
+    void *allocate(size_t bytes, size_t alignment = alignof(std::max_align_t))
+    {
+        return do_allocate(bytes, alignment);
+    }
+
+    /**
+     * @brief Give back memory from allocate() with the same size and alignment.
+     */
+    void deallocate(void *pointer, size_t bytes, size_t alignment = alignof(std::max_align_t))
+    {
+        do_deallocate(pointer, bytes, alignment);
+    }
+
+    /**
+     * @brief Whether memory from one resource can be given back to the other.
+     */
+    bool is_equal(const MemoryResource &other) const
+    {
+        return this == &other || do_is_equal(other);
+    }
+
+protected:
+    /** @private */
+    virtual void *do_allocate(size_t bytes, size_t alignment) = 0;
+    /** @private */
+    virtual void do_deallocate(void *pointer, size_t bytes, size_t alignment) = 0;
+    /** @private */
+    virtual bool do_is_equal(const MemoryResource &other) const
+    {
+        (void)other;
+        return false;
+    }
+};
+
+/**
+ * @brief The resource using new and delete, which is the default one.
+ */
+MemoryResource *new_delete_resource();
+
+/**
+ * @brief The resource internals take when they are constructed.
+ */
+MemoryResource *get_default_resource();
+
+/**
+ * @brief Replace the default resource, nullptr sets new_delete_resource() again.
+ *
+ * @return The resource which was the default before.
+ */
+MemoryResource *set_default_resource(MemoryResource *resource);
+
+/**
+ * @brief Resource handing out consecutive parts of a buffer, like an arena.
+ *
+ * Giving memory back does not free anything, it all stays in use until the
+ * resource is gone. Once the buffer is used up, the upstream resource is used.
+ * Without an upstream resource, running out is a fatal error, so that memory
+ * use is bounded by the buffer.
+ */
+class MonotonicBufferResource : public MemoryResource
+{
+public:
+    /**
+     * @brief The buffer needs to outlive the resource and everything using it.
+     */
+    MonotonicBufferResource(void *buffer, size_t size, MemoryResource *upstream = nullptr);
+    ~MonotonicBufferResource();
+
+    /**
+     * @brief How much of the buffer has been handed out, including alignment.
+     */
+    size_t bytes_used() const { return _used; }
+
+    /**
+     * @brief Size of the buffer.
+     */
+    size_t bytes_total() const { return _size; }
+
+    // Non-copyable
+    MonotonicBufferResource(const MonotonicBufferResource &) = delete;
+    const MonotonicBufferResource &operator=(const MonotonicBufferResource &) = delete;
+
+protected:
+    /** @private */
+    void *do_allocate(size_t bytes, size_t alignment) override;
+    /** @private */
+    void do_deallocate(void *pointer, size_t bytes, size_t alignment) override;
+
+private:
+    uint8_t *const _buffer;
+    const size_t _size;
+    MemoryResource *const _upstream;
+    std::atomic<size_t> _used {0};
+};
+
+/**
+ * @brief Allocator for the standard containers, using a MemoryResource.
+ *
+ * Like std::pmr::polymorphic_allocator, a default constructed one takes the
+ * default resource.
+ */
+template<typename T>
+class PolymorphicAllocator
+{
+public:
+    /** @private */
+    typedef T value_type;
+
+    PolymorphicAllocator() : _resource(get_default_resource()) {}
+    /** @private */
+    explicit PolymorphicAllocator(MemoryResource *resource) : _resource(resource) {}
+
+    /** @private */
+    template<typename U>
+    PolymorphicAllocator(const PolymorphicAllocator<U> &other) : _resource(other.resource()) {}
+
+    /** @private */
+    T *allocate(size_t n)
+    {
+        return static_cast<T *>(_resource->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    /** @private */
+    void deallocate(T *pointer, size_t n)
+    {
+        _resource->deallocate(pointer, n * sizeof(T), alignof(T));
+    }
+
+    /** @private */
+    MemoryResource *resource() const { return _resource; }
+
+private:
+    MemoryResource *_resource;
+};
+
+/** @private */
+template<typename T, typename U>
+bool operator==(const PolymorphicAllocator<T> &lhs, const PolymorphicAllocator<U> &rhs)
+{
+    return lhs.resource()->is_equal(*rhs.resource());
+}
+
+/** @private */
+template<typename T, typename U>
+bool operator!=(const PolymorphicAllocator<T> &lhs, const PolymorphicAllocator<U> &rhs)
+{
+    return !(lhs == rhs);
+}
+
+/** @private */
+template<typename T>
+using pmr_vector = std::vector<T, PolymorphicAllocator<T>>;
+
+} // namespace dronecore
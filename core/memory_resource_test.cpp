@@ -0,0 +1,113 @@
+#include "memory_resource.h"
+#include "ring_queue.h"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+using namespace dronecore;
+
+namespace {
+
+class CountingResource : public MemoryResource
+{
+public:
+    size_t num_allocations = 0;
+    size_t num_bytes_in_use = 0;
+
+protected:
+    void *do_allocate(size_t bytes, size_t alignment) override
+    {
+        ++num_allocations;
+        num_bytes_in_use += bytes;
+        return new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *pointer, size_t bytes, size_t alignment) override
+    {
+        num_bytes_in_use -= bytes;
+        new_delete_resource()->deallocate(pointer, bytes, alignment);
+    }
+};
+
+} // namespace
+
+TEST(MemoryResource, DefaultIsUsedByContainers)
+{
+    CountingResource counting;
+    EXPECT_EQ(set_default_resource(&counting), new_delete_resource());
+    EXPECT_EQ(get_default_resource(), &counting);
+
+    {
+        RingQueue<int> queue;
+        for (int i = 0; i < 100; ++i) {
+            queue.push_back(i);
+        }
+        EXPECT_GT(counting.num_allocations, 0u);
+        EXPECT_GT(counting.num_bytes_in_use, 0u);
+    }
+    EXPECT_EQ(counting.num_bytes_in_use, 0u);
+
+    EXPECT_EQ(set_default_resource(nullptr), &counting);
+    EXPECT_EQ(get_default_resource(), new_delete_resource());
+}
+
+TEST(MemoryResource, MonotonicBufferHandsOutAlignedParts)
+{
+    alignas(16) uint8_t buffer[256];
+    MonotonicBufferResource arena(buffer, sizeof(buffer));
+
+    void *first = arena.allocate(3, 1);
+    void *second = arena.allocate(8, 8);
+    EXPECT_EQ(first, buffer);
+    EXPECT_EQ(second, buffer + 8);
+    EXPECT_EQ(arena.bytes_used(), 16u);
+
+    // Nothing is freed.
+    arena.deallocate(second, 8, 8);
+    EXPECT_EQ(arena.bytes_used(), 16u);
+}
+
+TEST(MemoryResource, MonotonicBufferFallsBackToUpstream)
+{
+    alignas(16) uint8_t buffer[64];
+    CountingResource upstream;
+    MonotonicBufferResource arena(buffer, sizeof(buffer), &upstream);
+
+    {
+        pmr_vector<uint64_t> values {PolymorphicAllocator<uint64_t>(&arena)};
+        values.reserve(4);
+        EXPECT_EQ(upstream.num_allocations, 0u);
+        values.reserve(64);
+        EXPECT_EQ(upstream.num_allocations, 1u);
+    }
+    EXPECT_EQ(upstream.num_bytes_in_use, 0u);
+}
+
+TEST(MemoryResource, MonotonicBufferFromThreads)
+{
+    std::vector<uint8_t> buffer(64 * 1024);
+    MonotonicBufferResource arena(buffer.data(), buffer.size());
+
+    std::vector<std::vector<void *>> parts(4);
+    std::vector<std::thread> threads;
+    for (auto &thread_parts : parts) {
+        threads.emplace_back([&arena, &thread_parts]() {
+            for (unsigned i = 0; i < 1000; ++i) {
+                thread_parts.push_back(arena.allocate(8, 8));
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    // No part was handed out twice.
+    std::vector<void *> all;
+    for (const auto &thread_parts : parts) {
+        all.insert(all.end(), thread_parts.begin(), thread_parts.end());
+    }
+    std::sort(all.begin(), all.end());
+    EXPECT_EQ(std::unique(all.begin(), all.end()), all.end());
+    EXPECT_EQ(arena.bytes_used(), 4u * 1000u * 8u);
+}
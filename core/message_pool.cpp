@@ -0,0 +1,178 @@
+#include "message_pool.h"
+#include <cstring>
+#include <new>
+#include <utility>
+
+namespace dronecore {
+
+constexpr size_t MessagePool::NUM_SIZE_CLASSES;
+constexpr size_t MessagePool::BLOCKS_PER_SLAB;
+
+// With the block in front, these make blocks of 64, 128 and 288 bytes. Most
+// messages of a vehicle, like HEARTBEAT or ATTITUDE, fit into the first one.
+const std::array<size_t, MessagePool::NUM_SIZE_CLASSES> MessagePool::FRAME_CAPACITY {{
+        48, 112, MAVLINK_NUM_NON_PAYLOAD_BYTES + MAVLINK_MAX_PAYLOAD_LEN
+    }
+};
+
+MessagePool::MessagePool() :
+    _resource(get_default_resource())
+{
+}
+
+MessagePool::~MessagePool()
+{
+    for (size_t i = 0; i < NUM_SIZE_CLASSES; ++i) {
+        for (uint8_t *slab : _size_classes[i].slabs) {
+            _resource->deallocate(slab, block_stride(i) * BLOCKS_PER_SLAB, alignof(Block));
+        }
+    }
+}
+
+MessagePool::Handle MessagePool::store(const MAVLinkMessageView &message)
+{
+    // The frame of a parsed message is at most as long as the one on the wire.
+    const size_t frame_len = message.frame() ? message.frame_len() :
+                             MAVLINK_NUM_NON_PAYLOAD_BYTES + message.payload_len();
+
+    Block *block = allocate(size_class_of(frame_len));
+    uint8_t *frame = frame_of(block);
+    if (message.frame()) {
+        memcpy(frame, message.frame(), frame_len);
+        block->frame_len = uint16_t(frame_len);
+    } else {
+        block->frame_len = uint16_t(write_frame(message.message(), frame));
+    }
+    return Handle(block);
+}
+
+MessagePool::Stats MessagePool::stats(size_t size_class) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    const SizeClass &sizes = _size_classes[size_class];
+    const size_t num_blocks = sizes.slabs.size() * BLOCKS_PER_SLAB;
+    return Stats {num_blocks, num_blocks - sizes.free_blocks.size()};
+}
+
+uint8_t *MessagePool::frame_of(Block *block)
+{
+    return reinterpret_cast<uint8_t *>(block) + sizeof(Block);
+}
+
+size_t MessagePool::block_stride(size_t size_class)
+{
+    // Keeps the blocks of a slab aligned for the next Block.
+    const size_t size = sizeof(Block) + FRAME_CAPACITY[size_class];
+    return (size + alignof(Block) - 1) / alignof(Block) * alignof(Block);
+}
+
+size_t MessagePool::size_class_of(size_t frame_len)
+{
+    for (size_t i = 0; i + 1 < NUM_SIZE_CLASSES; ++i) {
+        if (frame_len <= FRAME_CAPACITY[i]) {
+            return i;
+        }
+    }
+    return NUM_SIZE_CLASSES - 1;
+}
+
+size_t MessagePool::write_frame(const mavlink_message_t &message, uint8_t *frame)
+{
+    size_t header_len;
+    if (message.magic == MAVLINK_STX_MAVLINK1) {
+        frame[0] = MAVLINK_STX_MAVLINK1;
+        frame[1] = message.len;
+        frame[2] = message.seq;
+        frame[3] = message.sysid;
+        frame[4] = message.compid;
+        frame[5] = uint8_t(message.msgid);
+        header_len = MAVLINK_CORE_HEADER_MAVLINK1_LEN + 1;
+    } else {
+        frame[0] = MAVLINK_STX;
+        frame[1] = message.len;
+        // The signature is not kept, as with frames from the receive buffer.
+        frame[2] = message.incompat_flags & ~MAVLINK_IFLAG_SIGNED;
+        frame[3] = message.compat_flags;
+        frame[4] = message.seq;
+        frame[5] = message.sysid;
+        frame[6] = message.compid;
+        frame[7] = uint8_t(message.msgid);
+        frame[8] = uint8_t(message.msgid >> 8);
+        frame[9] = uint8_t(message.msgid >> 16);
+        header_len = MAVLINK_NUM_HEADER_BYTES;
+    }
+
+    memcpy(&frame[header_len], _MAV_PAYLOAD(&message), message.len);
+    frame[header_len + message.len] = message.ck[0];
+    frame[header_len + message.len + 1] = message.ck[1];
+    return header_len + message.len + MAVLINK_NUM_CHECKSUM_BYTES;
+}
+
+MessagePool::Block *MessagePool::allocate(size_t size_class)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    SizeClass &sizes = _size_classes[size_class];
+
+    if (sizes.free_blocks.empty()) {
+        const size_t stride = block_stride(size_class);
+        uint8_t *slab = static_cast<uint8_t *>(
+                            _resource->allocate(stride * BLOCKS_PER_SLAB, alignof(Block)));
+        for (size_t i = 0; i < BLOCKS_PER_SLAB; ++i) {
+            Block *block = new (slab + i * stride) Block;
+            block->pool = this;
+            block->size_class = uint8_t(size_class);
+            sizes.free_blocks.push_back(block);
+        }
+        sizes.slabs.push_back(slab);
+    }
+
+    Block *block = sizes.free_blocks.back();
+    sizes.free_blocks.pop_back();
+    block->num_refs.store(1, std::memory_order_relaxed);
+    return block;
+}
+
+void MessagePool::recycle(Block *block)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _size_classes[block->size_class].free_blocks.push_back(block);
+}
+
+MessagePool::Handle::Handle(const Handle &other) :
+    _block(other._block)
+{
+    if (_block) {
+        _block->num_refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+MessagePool::Handle::Handle(Handle &&other) :
+    _block(other._block)
+{
+    other._block = nullptr;
+}
+
+MessagePool::Handle &MessagePool::Handle::operator=(Handle other)
+{
+    std::swap(_block, other._block);
+    return *this;
+}
+
+MAVLinkMessageView MessagePool::Handle::view(mavlink_message_t &storage) const
+{
+    return MAVLinkMessageView(frame_of(_block), storage);
+}
+
+void MessagePool::Handle::reset()
+{
+    if (!_block) {
+        return;
+    }
+    // Whoever releases the last handle sees all writes to the message.
+    if (_block->num_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        _block->pool->recycle(_block);
+    }
+    _block = nullptr;
+}
+
+} // namespace dronecore
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "mavlink_include.h"
+#include "mavlink_message_view.h"
+#include "memory_resource.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace dronecore {
+
+// Keeps received messages for later dispatch, e.g. in a queue, without
+// copying a whole mavlink_message_t or allocating for each one.
+//
+// A message is kept as its frame, in a block of the smallest size class it
+// fits into, so that most messages take a fraction of a mavlink_message_t.
+// Blocks come from slabs which are only allocated while the pool grows, and
+// are recycled once the last handle to them is gone. The slabs come from the
+// default memory resource of when the pool was made. Handles can be copied,
+// given to other threads and released there. The pool has to outlive all of
+// its handles.
+class MessagePool
+{
+public:
+    class Handle;
+
+    MessagePool();
+    ~MessagePool();
+
+    // Copies the message into a block of the pool.
+    Handle store(const MAVLinkMessageView &message);
+
+    struct Stats {
+        size_t num_blocks;
+        size_t num_in_use;
+    };
+    Stats stats(size_t size_class) const;
+
+    // Largest frame each size class holds, the last one fits any frame.
+    static constexpr size_t NUM_SIZE_CLASSES = 3;
+    static const std::array<size_t, NUM_SIZE_CLASSES> FRAME_CAPACITY;
+
+    // Non-copyable
+    MessagePool(const MessagePool &) = delete;
+    const MessagePool &operator=(const MessagePool &) = delete;
+
+private:
+    struct Block {
+        MessagePool *pool;
+        std::atomic<uint32_t> num_refs;
+        uint16_t frame_len;
+        uint8_t size_class;
+        // The frame follows right after the block.
+    };
+
+    static constexpr size_t BLOCKS_PER_SLAB = 64;
+
+    static uint8_t *frame_of(Block *block);
+    static size_t block_stride(size_t size_class);
+    static size_t size_class_of(size_t frame_len);
+    // Writes the frame of an already parsed message, without the signature.
+    static size_t write_frame(const mavlink_message_t &message, uint8_t *frame);
+
+    Block *allocate(size_t size_class);
+    void recycle(Block *block);
+
+    struct SizeClass {
+        pmr_vector<uint8_t *> slabs {};
+        pmr_vector<Block *> free_blocks {};
+    };
+
+    MemoryResource *const _resource;
+
+    mutable std::mutex _mutex {};
+    std::array<SizeClass, NUM_SIZE_CLASSES> _size_classes {};
+};
+
+// Reference to a message in a MessagePool, empty if default constructed.
+class MessagePool::Handle
+{
+public:
+    Handle() {}
+    ~Handle() { reset(); }
+
+    Handle(const Handle &other);
+    Handle(Handle &&other);
+    Handle &operator=(Handle other);
+
+    explicit operator bool() const { return _block != nullptr; }
+
+    // The message is only copied into storage if the full message is needed,
+    // see MAVLinkMessageView. Must not be empty.
+    MAVLinkMessageView view(mavlink_message_t &storage) const;
+
+    void reset();
+
+private:
+    friend class MessagePool;
+    explicit Handle(Block *block) : _block(block) {}
+
+    Block *_block = nullptr;
+};
+
+} // namespace dronecore
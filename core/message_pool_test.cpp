@@ -0,0 +1,115 @@
+#include "message_pool.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+using namespace dronecore;
+
+namespace {
+
+mavlink_message_t make_heartbeat(uint8_t sysid, uint32_t custom_mode)
+{
+    mavlink_message_t message;
+    mavlink_msg_heartbeat_pack(sysid, 1, &message, MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_PX4,
+                               MAV_MODE_FLAG_SAFETY_ARMED, custom_mode, 0);
+    return message;
+}
+
+} // namespace
+
+TEST(MessagePool, StoresFrames)
+{
+    MessagePool pool;
+
+    const mavlink_message_t message = make_heartbeat(3, 42);
+    uint8_t frame[MAVLINK_MAX_PACKET_LEN];
+    const uint16_t frame_len = mavlink_msg_to_send_buffer(frame, &message);
+
+    mavlink_message_t receive_storage {};
+    MessagePool::Handle handle = pool.store(MAVLinkMessageView(frame, receive_storage));
+    ASSERT_TRUE(handle);
+    // The receive buffer can be reused right away.
+    memset(frame, 0, sizeof(frame));
+
+    mavlink_message_t storage {};
+    const MAVLinkMessageView view = handle.view(storage);
+    EXPECT_EQ(view.sysid(), 3);
+    EXPECT_EQ(view.msgid(), uint32_t(MAVLINK_MSG_ID_HEARTBEAT));
+    EXPECT_EQ(view.frame_len(), frame_len);
+    EXPECT_EQ(view.get<uint32_t>(heartbeat_offset::custom_mode), 42u);
+    EXPECT_EQ(mavlink_msg_heartbeat_get_custom_mode(&view.message()), 42u);
+    EXPECT_EQ(view.message().checksum, message.checksum);
+
+    // A heartbeat takes the smallest block.
+    EXPECT_EQ(pool.stats(0).num_in_use, 1u);
+    EXPECT_EQ(pool.stats(2).num_blocks, 0u);
+}
+
+TEST(MessagePool, StoresParsedMessages)
+{
+    MessagePool pool;
+
+    const mavlink_message_t message = make_heartbeat(5, 7);
+    MessagePool::Handle handle = pool.store(MAVLinkMessageView(message));
+
+    mavlink_message_t storage {};
+    const MAVLinkMessageView view = handle.view(storage);
+    EXPECT_EQ(view.sysid(), 5);
+    EXPECT_EQ(view.seq(), message.seq);
+    EXPECT_EQ(view.payload_len(), message.len);
+    EXPECT_EQ(mavlink_msg_heartbeat_get_custom_mode(&view.message()), 7u);
+    EXPECT_EQ(view.message().checksum, message.checksum);
+}
+
+TEST(MessagePool, RecyclesOnceAllHandlesAreGone)
+{
+    MessagePool pool;
+
+    const mavlink_message_t message = make_heartbeat(1, 0);
+    MessagePool::Handle first = pool.store(MAVLinkMessageView(message));
+    MessagePool::Handle copy = first;
+    MessagePool::Handle moved = std::move(first);
+    EXPECT_FALSE(first);
+    EXPECT_EQ(pool.stats(0).num_in_use, 1u);
+
+    copy.reset();
+    EXPECT_EQ(pool.stats(0).num_in_use, 1u);
+    moved.reset();
+    EXPECT_EQ(pool.stats(0).num_in_use, 0u);
+
+    // The block is used again instead of a new one.
+    const size_t num_blocks = pool.stats(0).num_blocks;
+    MessagePool::Handle again = pool.store(MAVLinkMessageView(message));
+    EXPECT_EQ(pool.stats(0).num_blocks, num_blocks);
+}
+
+TEST(MessagePool, PicksTheSizeClassByLength)
+{
+    MessagePool pool;
+
+    mavlink_message_t message = make_heartbeat(1, 0);
+    std::vector<MessagePool::Handle> handles;
+    for (size_t i = 0; i < MessagePool::NUM_SIZE_CLASSES; ++i) {
+        message.len = uint8_t(MessagePool::FRAME_CAPACITY[i] - MAVLINK_NUM_NON_PAYLOAD_BYTES);
+        handles.push_back(pool.store(MAVLinkMessageView(message)));
+        EXPECT_EQ(pool.stats(i).num_in_use, 1u);
+    }
+
+    mavlink_message_t storage {};
+    EXPECT_EQ(handles.back().view(storage).payload_len(), message.len);
+}
+
+TEST(MessagePool, ReleasesOnOtherThreads)
+{
+    MessagePool pool;
+    const mavlink_message_t message = make_heartbeat(1, 0);
+
+    std::vector<MessagePool::Handle> handles;
+    for (unsigned i = 0; i < 1000; ++i) {
+        handles.push_back(pool.store(MAVLinkMessageView(message)));
+    }
+
+    std::thread releaser([&handles]() { handles.clear(); });
+    releaser.join();
+    EXPECT_EQ(pool.stats(0).num_in_use, 0u);
+}
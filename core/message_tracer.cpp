@@ -0,0 +1,181 @@
+#include "message_tracer.h"
+#include <algorithm>
+
+namespace dronecore {
+
+constexpr unsigned MessageTracer::NUM_BUCKETS;
+
+namespace {
+
+// The message being traced on this thread, if any.
+thread_local MessageTracer::Trace *current_trace = nullptr;
+
+uint64_t to_us(MessageTracer::clock::duration duration)
+{
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    return (us > 0) ? uint64_t(us) : 0;
+}
+
+// A lambda can't take the work by move in C++11.
+struct TimedCallback {
+    MessageTracer *tracer;
+    uint32_t msgid;
+    MessageTracer::clock::time_point received;
+    MessageTracer::clock::time_point posted;
+    CallbackExecutor::task_t work;
+
+    void operator()() const
+    {
+        work();
+        const auto now = MessageTracer::clock::now();
+        tracer->add(msgid, MessageTracer::CALLBACK, now - posted);
+        tracer->add(msgid, MessageTracer::TOTAL, now - received);
+    }
+};
+
+} // namespace
+
+MessageTracer::MessageTracer() {}
+
+MessageTracer::~MessageTracer()
+{
+    for (auto &entry : _short_ids) {
+        delete entry.load();
+    }
+}
+
+void MessageTracer::add(uint32_t msgid, Stage stage, clock::duration latency)
+{
+    stages_of(msgid).stages[stage].add(to_us(latency));
+}
+
+std::vector<MessageTracer::Latencies> MessageTracer::latencies() const
+{
+    std::vector<Latencies> result;
+
+    auto add_latencies = [&result](uint32_t msgid, const MessageStages &stages) {
+        Latencies latencies;
+        latencies.msgid = msgid;
+        for (unsigned i = 0; i < NUM_STAGES; ++i) {
+            latencies.stages[i] = stages.stages[i].load();
+        }
+        result.push_back(latencies);
+    };
+
+    for (unsigned msgid = 0; msgid < _short_ids.size(); ++msgid) {
+        const MessageStages *stages = _short_ids[msgid].load(std::memory_order_acquire);
+        if (stages != nullptr) {
+            add_latencies(msgid, *stages);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(_long_ids_mutex);
+    const size_t num_short = result.size();
+    for (const auto &entry : _long_ids) {
+        add_latencies(entry.first, *entry.second);
+    }
+    std::sort(result.begin() + num_short, result.end(),
+    [](const Latencies & lhs, const Latencies & rhs) { return lhs.msgid < rhs.msgid; });
+
+    return result;
+}
+
+MessageTracer::MessageStages &MessageTracer::stages_of(uint32_t msgid)
+{
+    if (msgid < _short_ids.size()) {
+        MessageStages *stages = _short_ids[msgid].load(std::memory_order_acquire);
+        if (stages != nullptr) {
+            return *stages;
+        }
+        // Whoever comes second deletes theirs.
+        std::unique_ptr<MessageStages> new_stages(new MessageStages());
+        if (_short_ids[msgid].compare_exchange_strong(stages, new_stages.get(),
+                                                      std::memory_order_acq_rel)) {
+            return *new_stages.release();
+        }
+        return *stages;
+    }
+
+    std::lock_guard<std::mutex> lock(_long_ids_mutex);
+    std::unique_ptr<MessageStages> &stages = _long_ids[msgid];
+    if (!stages) {
+        stages.reset(new MessageStages());
+    }
+    return *stages;
+}
+
+unsigned MessageTracer::bucket_of(uint64_t us)
+{
+    unsigned bucket = 0;
+    while (us > 0 && bucket < NUM_BUCKETS - 1) {
+        us >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+void MessageTracer::AtomicHistogram::add(uint64_t us)
+{
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum_us.fetch_add(us, std::memory_order_relaxed);
+    buckets[bucket_of(us)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t max = max_us.load(std::memory_order_relaxed);
+    while (us > max && !max_us.compare_exchange_weak(max, us, std::memory_order_relaxed)) {}
+}
+
+MessageTracer::Histogram MessageTracer::AtomicHistogram::load() const
+{
+    Histogram histogram;
+    histogram.count = count.load(std::memory_order_relaxed);
+    histogram.sum_us = sum_us.load(std::memory_order_relaxed);
+    histogram.max_us = max_us.load(std::memory_order_relaxed);
+    for (unsigned i = 0; i < NUM_BUCKETS; ++i) {
+        histogram.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+    }
+    return histogram;
+}
+
+MessageTracer::Trace::Trace(MessageTracer &tracer, uint32_t msgid, clock::time_point received) :
+    _tracer(tracer),
+    _msgid(msgid),
+    _received(received),
+    _outer(current_trace)
+{
+    _tracer.add(_msgid, PARSE, clock::now() - _received);
+    current_trace = this;
+}
+
+MessageTracer::Trace::~Trace()
+{
+    current_trace = _outer;
+
+    if (_is_looked_up) {
+        const auto now = clock::now();
+        _tracer.add(_msgid, DISPATCH, now - _looked_up);
+    }
+}
+
+void MessageTracer::mark_looked_up()
+{
+    Trace *trace = current_trace;
+    if (trace == nullptr || trace->_is_looked_up) {
+        return;
+    }
+    trace->_looked_up = clock::now();
+    trace->_is_looked_up = true;
+    trace->_tracer.add(trace->_msgid, LOOKUP, trace->_looked_up - trace->_received);
+}
+
+CallbackExecutor::task_t MessageTracer::wrap_callback(CallbackExecutor::task_t work)
+{
+    const Trace *trace = current_trace;
+    if (trace == nullptr) {
+        return work;
+    }
+
+    return TimedCallback {&trace->_tracer, trace->_msgid, trace->_received, clock::now(),
+                          std::move(work)};
+}
+
+} // namespace dronecore
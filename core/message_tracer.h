@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "callback_executor.h"
+
+namespace dronecore {
+
+// Measures how long each message takes from arriving on a link to its
+// callbacks having run, by stage and message id. It is off by default and
+// costs one relaxed load per message then.
+//
+// The receive thread times a message while a Trace of it is alive. Work
+// posted to the CallbackExecutor meanwhile is wrapped, so that its return is
+// timed as well, on whatever thread it runs.
+class MessageTracer
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+    enum Stage {
+        PARSE, // Datagram received to message parsed.
+        LOOKUP, // Parsed to its system found.
+        DISPATCH, // System found to all handlers returned.
+        CALLBACK, // Posted to the user callback returned.
+        TOTAL, // Datagram received to the user callback returned.
+        NUM_STAGES
+    };
+
+    // Bucket i counts latencies below 2^i us, and not below 2^(i-1) us. The
+    // last one counts all the rest.
+    static constexpr unsigned NUM_BUCKETS = 24;
+
+    struct Histogram {
+        uint64_t count;
+        uint64_t sum_us;
+        uint64_t max_us;
+        std::array<uint64_t, NUM_BUCKETS> buckets;
+    };
+
+    struct Latencies {
+        uint32_t msgid;
+        std::array<Histogram, NUM_STAGES> stages;
+    };
+
+    MessageTracer();
+    ~MessageTracer();
+
+    void set_enabled(bool enabled) { _is_enabled.store(enabled, std::memory_order_relaxed); }
+    bool is_enabled() const { return _is_enabled.load(std::memory_order_relaxed); }
+
+    // Can be called from any thread.
+    void add(uint32_t msgid, Stage stage, clock::duration latency);
+
+    // The message ids seen so far, in ascending order.
+    std::vector<Latencies> latencies() const;
+
+    // Timestamps the stages of one message on the receive thread.
+    class Trace
+    {
+    public:
+        // Marks the message as parsed.
+        Trace(MessageTracer &tracer, uint32_t msgid, clock::time_point received);
+        // Marks the handlers as returned, if the system was found.
+        ~Trace();
+
+        // Non-copyable
+        Trace(const Trace &) = delete;
+        const Trace &operator=(const Trace &) = delete;
+
+    private:
+        friend class MessageTracer;
+
+        MessageTracer &_tracer;
+        const uint32_t _msgid;
+        const clock::time_point _received;
+        clock::time_point _looked_up {};
+        bool _is_looked_up = false;
+        Trace *const _outer;
+    };
+
+    // Called once the system of the message being traced on this thread is
+    // found. Does nothing without a trace.
+    static void mark_looked_up();
+
+    // Returns work which also times when it returns, if a message is being
+    // traced on this thread. Otherwise work is returned as it is.
+    static CallbackExecutor::task_t wrap_callback(CallbackExecutor::task_t work);
+
+    // Non-copyable
+    MessageTracer(const MessageTracer &) = delete;
+    const MessageTracer &operator=(const MessageTracer &) = delete;
+
+private:
+    struct AtomicHistogram {
+        std::atomic<uint64_t> count {0};
+        std::atomic<uint64_t> sum_us {0};
+        std::atomic<uint64_t> max_us {0};
+        std::array<std::atomic<uint64_t>, NUM_BUCKETS> buckets {};
+
+        void add(uint64_t us);
+        Histogram load() const;
+    };
+
+    struct MessageStages {
+        std::array<AtomicHistogram, NUM_STAGES> stages {};
+    };
+
+    MessageStages &stages_of(uint32_t msgid);
+
+    static unsigned bucket_of(uint64_t us);
+
+    std::atomic<bool> _is_enabled {false};
+
+    // Common message ids without locking, allocated once they are first seen.
+    std::array<std::atomic<MessageStages *>, 256> _short_ids {};
+
+    mutable std::mutex _long_ids_mutex {};
+    std::unordered_map<uint32_t, std::unique_ptr<MessageStages>> _long_ids {};
+};
+
+} // namespace dronecore
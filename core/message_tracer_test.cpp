@@ -0,0 +1,83 @@
+#include "message_tracer.h"
+#include <gtest/gtest.h>
+#include <chrono>
+
+using namespace dronecore;
+
+TEST(MessageTracer, CountsByBucket)
+{
+    MessageTracer tracer;
+
+    tracer.add(30, MessageTracer::PARSE, std::chrono::microseconds(0));
+    tracer.add(30, MessageTracer::PARSE, std::chrono::microseconds(5));
+    tracer.add(30, MessageTracer::PARSE, std::chrono::microseconds(7));
+    tracer.add(30, MessageTracer::PARSE, std::chrono::seconds(100));
+
+    const auto latencies = tracer.latencies();
+    ASSERT_EQ(latencies.size(), 1u);
+    EXPECT_EQ(latencies[0].msgid, 30u);
+
+    const auto &parse = latencies[0].stages[MessageTracer::PARSE];
+    EXPECT_EQ(parse.count, 4u);
+    EXPECT_EQ(parse.max_us, 100000000u);
+    EXPECT_EQ(parse.sum_us, 100000012u);
+    EXPECT_EQ(parse.buckets[0], 1u);
+    // 5 and 7 are both below 8.
+    EXPECT_EQ(parse.buckets[3], 2u);
+    EXPECT_EQ(parse.buckets[MessageTracer::NUM_BUCKETS - 1], 1u);
+
+    EXPECT_EQ(latencies[0].stages[MessageTracer::DISPATCH].count, 0u);
+}
+
+TEST(MessageTracer, SortsMessageIds)
+{
+    MessageTracer tracer;
+
+    tracer.add(12900, MessageTracer::TOTAL, std::chrono::microseconds(1));
+    tracer.add(300, MessageTracer::TOTAL, std::chrono::microseconds(1));
+    tracer.add(0, MessageTracer::TOTAL, std::chrono::microseconds(1));
+    tracer.add(33, MessageTracer::TOTAL, std::chrono::microseconds(1));
+
+    const auto latencies = tracer.latencies();
+    ASSERT_EQ(latencies.size(), 4u);
+    EXPECT_EQ(latencies[0].msgid, 0u);
+    EXPECT_EQ(latencies[1].msgid, 33u);
+    EXPECT_EQ(latencies[2].msgid, 300u);
+    EXPECT_EQ(latencies[3].msgid, 12900u);
+}
+
+TEST(MessageTracer, TimesStagesOfTrace)
+{
+    MessageTracer tracer;
+    CallbackExecutor::task_t callback;
+    bool is_called = false;
+
+    {
+        MessageTracer::Trace trace(tracer, 24, MessageTracer::clock::now());
+        MessageTracer::mark_looked_up();
+        callback = MessageTracer::wrap_callback([&is_called]() { is_called = true; });
+    }
+
+    auto stages = tracer.latencies().at(0).stages;
+    EXPECT_EQ(stages[MessageTracer::PARSE].count, 1u);
+    EXPECT_EQ(stages[MessageTracer::LOOKUP].count, 1u);
+    EXPECT_EQ(stages[MessageTracer::DISPATCH].count, 1u);
+    EXPECT_EQ(stages[MessageTracer::CALLBACK].count, 0u);
+
+    callback();
+    EXPECT_TRUE(is_called);
+
+    stages = tracer.latencies().at(0).stages;
+    EXPECT_EQ(stages[MessageTracer::CALLBACK].count, 1u);
+    EXPECT_EQ(stages[MessageTracer::TOTAL].count, 1u);
+}
+
+TEST(MessageTracer, IgnoresWorkWithoutTrace)
+{
+    MessageTracer tracer;
+
+    MessageTracer::mark_looked_up();
+    MessageTracer::wrap_callback([]() {})();
+
+    EXPECT_TRUE(tracer.latencies().empty());
+}
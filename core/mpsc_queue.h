@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+namespace dronecore {
+
+// Lock-free queue for any number of producer threads and one consumer at a
+// time. A push is one allocation and one atomic exchange, it never waits for
+// the consumer or other producers.
+//
+// An item being pushed concurrently may not be visible to try_pop() yet, even
+// if later items are. Producers therefore wake the consumer after pushing, and
+// the consumer pops until the queue is empty.
+//
+// T needs to be default constructible and movable.
+template<typename T>
+class MpscQueue
+{
+public:
+    MpscQueue() :
+        _tail(new Node())
+    {
+        _head.store(_tail, std::memory_order_relaxed);
+    }
+
+    ~MpscQueue()
+    {
+        T item;
+        while (try_pop(item)) {}
+        delete _tail;
+    }
+
+    // Can be called from any thread.
+    void push(T &&item)
+    {
+        Node *node = new Node();
+        node->item = std::move(item);
+
+        Node *previous = _head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    // Only to be called by the consumer. Moves the oldest item out, returns
+    // false if there is none.
+    bool try_pop(T &item)
+    {
+        Node *next = _tail->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            return false;
+        }
+
+        // The one popped becomes the new stub, so only its item is taken.
+        item = std::move(next->item);
+        delete _tail;
+        _tail = next;
+        return true;
+    }
+
+    // Non-copyable
+    MpscQueue(const MpscQueue &) = delete;
+    const MpscQueue &operator=(const MpscQueue &) = delete;
+
+private:
+    struct Node {
+        std::atomic<Node *> next {nullptr};
+        T item {};
+    };
+
+    std::atomic<Node *> _head {nullptr};
+    // Only used by the consumer.
+    Node *_tail;
+};
+
+} // namespace dronecore
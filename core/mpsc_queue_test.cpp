@@ -0,0 +1,79 @@
+#include "mpsc_queue.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace dronecore;
+
+TEST(MpscQueue, PopsInOrder)
+{
+    MpscQueue<int> queue;
+
+    int item = 0;
+    EXPECT_FALSE(queue.try_pop(item));
+
+    queue.push(1);
+    queue.push(2);
+    queue.push(3);
+
+    for (int i = 1; i <= 3; ++i) {
+        ASSERT_TRUE(queue.try_pop(item));
+        EXPECT_EQ(item, i);
+    }
+    EXPECT_FALSE(queue.try_pop(item));
+}
+
+TEST(MpscQueue, TakesMoveOnlyItems)
+{
+    MpscQueue<std::unique_ptr<int>> queue;
+
+    std::unique_ptr<int> pushed(new int(42));
+    queue.push(std::move(pushed));
+    EXPECT_EQ(pushed, nullptr);
+
+    // Whatever is left is destroyed with the queue.
+    queue.push(std::unique_ptr<int>(new int(43)));
+
+    std::unique_ptr<int> popped;
+    ASSERT_TRUE(queue.try_pop(popped));
+    ASSERT_NE(popped, nullptr);
+    EXPECT_EQ(*popped, 42);
+}
+
+TEST(MpscQueue, KeepsOrderOfEachProducer)
+{
+    MpscQueue<std::pair<int, int>> queue;
+
+    const int num_producers = 4;
+    const int num_items = 10000;
+
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < num_producers; ++producer) {
+        producers.push_back(std::thread([&queue, producer]() {
+            for (int i = 0; i < num_items; ++i) {
+                queue.push(std::make_pair(producer, i));
+            }
+        }));
+    }
+
+    std::vector<int> next(num_producers, 0);
+    int num_popped = 0;
+    while (num_popped < num_producers * num_items) {
+        std::pair<int, int> item;
+        if (!queue.try_pop(item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        EXPECT_EQ(item.second, next[item.first]);
+        next[item.first] = item.second + 1;
+        ++num_popped;
+    }
+
+    for (auto &producer : producers) {
+        producer.join();
+    }
+    for (int producer = 0; producer < num_producers; ++producer) {
+        EXPECT_EQ(next[producer], num_items);
+    }
+}
@@ -0,0 +1,242 @@
+#include "outgoing_scheduler.h"
+#include "thread_roles.h"
+#include <algorithm>
+#include <cstring>
+
+namespace dronecore {
+
+constexpr double OutgoingScheduler::BURST_S;
+constexpr size_t OutgoingScheduler::MAX_QUEUED_CONTROL;
+constexpr size_t OutgoingScheduler::MAX_QUEUED;
+
+OutgoingScheduler::OutgoingScheduler(send_t send) :
+    _send(send)
+{}
+
+OutgoingScheduler::~OutgoingScheduler()
+{
+    stop();
+}
+
+void OutgoingScheduler::set_budget(double bytes_per_s)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_should_exit) {
+        return;
+    }
+
+    _bytes_per_s = std::max(bytes_per_s, 0.0);
+    _tokens = burst_bytes();
+    _last_refill = clock::now();
+
+    if (_bytes_per_s > 0.0) {
+        start_thread();
+    }
+    _cv.notify_one();
+}
+
+void OutgoingScheduler::set_queue(size_t max_queued, Overflow overflow)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_should_exit) {
+        return;
+    }
+
+    _max_queued = max_queued;
+    _overflow = overflow;
+
+    if (_max_queued > 0) {
+        start_thread();
+    }
+    _cv.notify_one();
+}
+
+void OutgoingScheduler::start_thread()
+{
+    // We assume that we already acquired the mutex in this function.
+    if (_thread == nullptr) {
+        _thread = new std::thread(&OutgoingScheduler::run, this);
+    }
+}
+
+double OutgoingScheduler::get_budget() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _bytes_per_s;
+}
+
+bool OutgoingScheduler::sends_right_away() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return !_should_exit && _bytes_per_s <= 0.0 && _max_queued == 0;
+}
+
+bool OutgoingScheduler::send(const uint8_t *frame, unsigned frame_len, uint8_t target_system,
+                             Priority priority)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_should_exit) {
+            return false;
+        }
+
+        const bool always_queue = (_max_queued > 0);
+        if (_bytes_per_s > 0.0 || always_queue) {
+            refill();
+            if (always_queue || !is_empty() || _tokens < double(frame_len)) {
+                std::deque<Frame> &queue = _queues[static_cast<int>(priority)];
+                if (priority == Priority::CONTROL) {
+                    // An old setpoint is of no use once there is a newer one.
+                    if (queue.size() >= MAX_QUEUED_CONTROL) {
+                        queue.pop_front();
+                        ++_stats.num_dropped;
+                    }
+                } else if (queue.size() >= (always_queue ? _max_queued : MAX_QUEUED)) {
+                    ++_stats.num_dropped;
+                    if (_overflow == Overflow::DROP_NEWEST) {
+                        return false;
+                    }
+                    queue.pop_front();
+                }
+
+                Frame queued;
+                memcpy(queued.data.data(), frame, std::min<size_t>(frame_len, queued.data.size()));
+                queued.len = frame_len;
+                queued.target_system = target_system;
+                queue.push_back(queued);
+                ++_stats.num_queued;
+                _stats.max_depth = std::max<uint64_t>(_stats.max_depth, depth());
+                _cv.notify_one();
+                return true;
+            }
+            _tokens -= double(frame_len);
+        }
+    }
+
+    return _send(frame, frame_len, target_system);
+}
+
+void OutgoingScheduler::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _should_exit = true;
+        for (auto &queue : _queues) {
+            queue.clear();
+        }
+        _cv.notify_one();
+    }
+
+    if (_thread != nullptr) {
+        _thread->join();
+        delete _thread;
+        _thread = nullptr;
+    }
+}
+
+OutgoingScheduler::Priority OutgoingScheduler::priority_of(uint32_t message_id)
+{
+    switch (message_id) {
+        case MAVLINK_MSG_ID_HEARTBEAT:
+        case MAVLINK_MSG_ID_SET_POSITION_TARGET_LOCAL_NED:
+        case MAVLINK_MSG_ID_SET_POSITION_TARGET_GLOBAL_INT:
+        case MAVLINK_MSG_ID_SET_ATTITUDE_TARGET:
+        case MAVLINK_MSG_ID_MANUAL_CONTROL:
+        case MAVLINK_MSG_ID_FOLLOW_TARGET:
+            return Priority::CONTROL;
+        case MAVLINK_MSG_ID_COMMAND_LONG:
+        case MAVLINK_MSG_ID_COMMAND_INT:
+        case MAVLINK_MSG_ID_COMMAND_ACK:
+            return Priority::COMMAND;
+        default:
+            // Missions, parameters, files and everything else.
+            return Priority::BULK;
+    }
+}
+
+OutgoingScheduler::Stats OutgoingScheduler::stats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Stats stats = _stats;
+    stats.depth = depth();
+    return stats;
+}
+
+void OutgoingScheduler::run()
+{
+    ThreadRoles::apply_to_this_thread(DroneCore::ThreadRole::SEND, "send");
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (!_should_exit) {
+        if (is_empty()) {
+            _cv.wait(lock);
+            continue;
+        }
+
+        std::deque<Frame> *queue = nullptr;
+        for (auto &candidate : _queues) {
+            if (!candidate.empty()) {
+                queue = &candidate;
+                break;
+            }
+        }
+
+        refill();
+        const double frame_len = double(queue->front().len);
+        if (_bytes_per_s > 0.0 && _tokens < frame_len) {
+            // A frame of a higher priority may still come in while waiting.
+            _cv.wait_for(lock, std::chrono::duration<double>((frame_len - _tokens) / _bytes_per_s));
+            continue;
+        }
+
+        if (_bytes_per_s > 0.0) {
+            _tokens -= frame_len;
+        }
+        const Frame frame = queue->front();
+        queue->pop_front();
+
+        lock.unlock();
+        _send(frame.data.data(), frame.len, frame.target_system);
+        lock.lock();
+    }
+}
+
+void OutgoingScheduler::refill()
+{
+    // We assume that we already acquired the mutex in this function.
+    const clock::time_point now = clock::now();
+    const double elapsed_s = std::chrono::duration<double>(now - _last_refill).count();
+    _last_refill = now;
+    _tokens = std::min(_tokens + elapsed_s * _bytes_per_s, burst_bytes());
+}
+
+bool OutgoingScheduler::is_empty() const
+{
+    // We assume that we already acquired the mutex in this function.
+    for (const auto &queue : _queues) {
+        if (!queue.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t OutgoingScheduler::depth() const
+{
+    // We assume that we already acquired the mutex in this function.
+    size_t num_frames = 0;
+    for (const auto &queue : _queues) {
+        num_frames += queue.size();
+    }
+    return num_frames;
+}
+
+double OutgoingScheduler::burst_bytes() const
+{
+    // We assume that we already acquired the mutex in this function.
+    // At least one whole frame needs to fit, however small the budget.
+    return std::max(_bytes_per_s * BURST_S, double(MAVLINK_MAX_PACKET_LEN));
+}
+
+} // namespace dronecore
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "mavlink_include.h"
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace dronecore {
+
+// Keeps the frames sent on a connection within a budget of bytes per second,
+// e.g. the capacity of a telemetry radio. Within the budget, frames are sent
+// right away on the caller's thread. Beyond it, they are queued by priority
+// and sent by a thread of its own, so that heartbeats and setpoints are not
+// held up by a mission upload or a parameter sync.
+class OutgoingScheduler
+{
+public:
+    enum class Priority {
+        CONTROL = 0,
+        COMMAND,
+        BULK
+    };
+
+    typedef std::function<bool(const uint8_t *frame, unsigned frame_len, uint8_t target_system)>
+    send_t;
+
+    explicit OutgoingScheduler(send_t send);
+    ~OutgoingScheduler();
+
+    // 0 to send everything right away, which is the default.
+    void set_budget(double bytes_per_s);
+    double get_budget() const;
+
+    // What happens to a frame that doesn't fit into its queue. Control frames
+    // always replace the oldest one.
+    enum class Overflow {
+        DROP_NEWEST,
+        DROP_OLDEST
+    };
+
+    // With max_queued > 0, every frame is queued and sent by the thread of the
+    // scheduler, so send() never waits for the connection. With 0, the default,
+    // frames are only queued once the budget is used up, at most MAX_QUEUED.
+    void set_queue(size_t max_queued, Overflow overflow);
+    // Whether send() would send right away, i.e. there is no budget.
+    bool sends_right_away() const;
+
+    // Returns false if the frame could not be sent or was dropped because its
+    // queue was full. A queued frame counts as sent.
+    bool send(const uint8_t *frame, unsigned frame_len, uint8_t target_system,
+              Priority priority);
+
+    // Drops what is still queued, nothing is sent after this.
+    void stop();
+
+    static Priority priority_of(uint32_t message_id);
+
+    struct Stats {
+        uint64_t num_queued;
+        // Control frames are replaced by newer ones, others as set by the overflow.
+        uint64_t num_dropped;
+        // Frames in the queues now, and the most there ever were.
+        uint64_t depth;
+        uint64_t max_depth;
+    };
+    Stats stats() const;
+
+    // Of a budget, how much can be sent at once.
+    static constexpr double BURST_S = 0.1;
+    static constexpr size_t MAX_QUEUED_CONTROL = 8;
+    static constexpr size_t MAX_QUEUED = 256;
+
+    // Non-copyable
+    OutgoingScheduler(const OutgoingScheduler &) = delete;
+    const OutgoingScheduler &operator=(const OutgoingScheduler &) = delete;
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    struct Frame {
+        std::array<uint8_t, MAVLINK_MAX_PACKET_LEN> data;
+        unsigned len;
+        uint8_t target_system;
+    };
+
+    void run();
+    void start_thread();
+    void refill();
+    bool is_empty() const;
+    size_t depth() const;
+    double burst_bytes() const;
+
+    const send_t _send;
+
+    mutable std::mutex _mutex {};
+    std::condition_variable _cv {};
+    std::deque<Frame> _queues[3] {};
+    double _bytes_per_s = 0.0;
+    double _tokens = 0.0;
+    size_t _max_queued = 0;
+    Overflow _overflow = Overflow::DROP_NEWEST;
+    clock::time_point _last_refill {};
+    Stats _stats {};
+    bool _should_exit = false;
+    std::thread *_thread = nullptr;
+};
+
+} // namespace dronecore
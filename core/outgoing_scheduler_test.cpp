@@ -0,0 +1,182 @@
+#include "outgoing_scheduler.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace dronecore;
+
+namespace {
+
+struct Recorder {
+    std::mutex mutex {};
+    std::vector<uint8_t> first_bytes {};
+    unsigned num_bytes = 0;
+
+    bool send(const uint8_t *frame, unsigned frame_len)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        first_bytes.push_back(frame[0]);
+        num_bytes += frame_len;
+        return true;
+    }
+
+    size_t num_sent()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return first_bytes.size();
+    }
+};
+
+} // namespace
+
+TEST(OutgoingScheduler, SendsRightAwayWithoutBudget)
+{
+    Recorder recorder;
+    OutgoingScheduler scheduler([&recorder](const uint8_t *frame, unsigned len, uint8_t) {
+        return recorder.send(frame, len);
+    });
+
+    uint8_t frame[100] {};
+    for (unsigned i = 0; i < 100; ++i) {
+        EXPECT_TRUE(scheduler.send(frame, sizeof(frame), 0, OutgoingScheduler::Priority::BULK));
+    }
+    // All on this thread already.
+    EXPECT_EQ(recorder.num_sent(), 100u);
+    EXPECT_EQ(scheduler.stats().num_queued, 0u);
+}
+
+TEST(OutgoingScheduler, ControlOvertakesBulk)
+{
+    Recorder recorder;
+    OutgoingScheduler scheduler([&recorder](const uint8_t *frame, unsigned len, uint8_t) {
+        return recorder.send(frame, len);
+    });
+    // The burst lets the first frames through, the rest is queued.
+    scheduler.set_budget(10000.0);
+
+    uint8_t bulk[200] {};
+    bulk[0] = 'b';
+    for (unsigned i = 0; i < 20; ++i) {
+        EXPECT_TRUE(scheduler.send(bulk, sizeof(bulk), 0, OutgoingScheduler::Priority::BULK));
+    }
+    uint8_t control[50] {};
+    control[0] = 'c';
+    EXPECT_TRUE(scheduler.send(control, sizeof(control), 0,
+                               OutgoingScheduler::Priority::CONTROL));
+
+    while (recorder.num_sent() < 21) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::lock_guard<std::mutex> lock(recorder.mutex);
+    unsigned control_index = 0;
+    for (unsigned i = 0; i < recorder.first_bytes.size(); ++i) {
+        if (recorder.first_bytes[i] == 'c') {
+            control_index = i;
+        }
+    }
+    // Right after what went out with the burst, not behind all bulk frames.
+    EXPECT_LE(control_index, 6u);
+}
+
+TEST(OutgoingScheduler, KeepsToBudget)
+{
+    Recorder recorder;
+    OutgoingScheduler scheduler([&recorder](const uint8_t *frame, unsigned len, uint8_t) {
+        return recorder.send(frame, len);
+    });
+    scheduler.set_budget(5000.0);
+
+    uint8_t frame[100] {};
+    for (unsigned i = 0; i < 100; ++i) {
+        EXPECT_TRUE(scheduler.send(frame, sizeof(frame), 0, OutgoingScheduler::Priority::BULK));
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    // About the burst and half a second at the budget.
+    const unsigned num_bytes = recorder.num_sent() * sizeof(frame);
+    EXPECT_GE(num_bytes, 2500u);
+    EXPECT_LE(num_bytes, 500u + 2500u + 500u);
+}
+
+TEST(OutgoingScheduler, LimitsQueues)
+{
+    OutgoingScheduler scheduler([](const uint8_t *, unsigned, uint8_t) {
+        return true;
+    });
+    scheduler.set_budget(1.0);
+
+    uint8_t frame[MAVLINK_MAX_PACKET_LEN] {};
+    unsigned num_refused = 0;
+    for (unsigned i = 0; i < OutgoingScheduler::MAX_QUEUED + 10; ++i) {
+        if (!scheduler.send(frame, sizeof(frame), 0, OutgoingScheduler::Priority::BULK)) {
+            ++num_refused;
+        }
+    }
+    EXPECT_GE(num_refused, 9u);
+
+    // Setpoints replace each other instead.
+    for (unsigned i = 0; i < OutgoingScheduler::MAX_QUEUED_CONTROL + 10; ++i) {
+        EXPECT_TRUE(scheduler.send(frame, sizeof(frame), 0,
+                                   OutgoingScheduler::Priority::CONTROL));
+    }
+    EXPECT_GE(scheduler.stats().num_dropped, num_refused + 10);
+}
+
+TEST(OutgoingScheduler, QueuesWhileLinkBlocks)
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool blocked = true;
+    std::vector<uint8_t> sent;
+
+    OutgoingScheduler scheduler([&](const uint8_t *frame, unsigned, uint8_t) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&blocked]() { return !blocked; });
+        sent.push_back(frame[0]);
+        return true;
+    });
+    scheduler.set_queue(4, OutgoingScheduler::Overflow::DROP_OLDEST);
+
+    // None of these wait for the link, the thread is stuck on the first one.
+    uint8_t frame[10] {};
+    for (uint8_t i = 0; i < 10; ++i) {
+        frame[0] = i;
+        EXPECT_TRUE(scheduler.send(frame, sizeof(frame), 0, OutgoingScheduler::Priority::BULK));
+    }
+    const OutgoingScheduler::Stats stats = scheduler.stats();
+    EXPECT_EQ(stats.num_queued, 10u);
+    EXPECT_GE(stats.num_dropped, 5u);
+    EXPECT_LE(stats.depth, 4u);
+    EXPECT_EQ(stats.max_depth, 4u);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        blocked = false;
+    }
+    cv.notify_all();
+
+    while (scheduler.stats().depth > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    scheduler.stop();
+
+    // The newest ones were kept.
+    std::lock_guard<std::mutex> lock(mutex);
+    ASSERT_GE(sent.size(), 4u);
+    EXPECT_EQ(sent.back(), 9u);
+    EXPECT_EQ(sent[sent.size() - 4], 6u);
+}
+
+TEST(OutgoingScheduler, Priorities)
+{
+    EXPECT_EQ(OutgoingScheduler::priority_of(MAVLINK_MSG_ID_HEARTBEAT),
+              OutgoingScheduler::Priority::CONTROL);
+    EXPECT_EQ(OutgoingScheduler::priority_of(MAVLINK_MSG_ID_COMMAND_LONG),
+              OutgoingScheduler::Priority::COMMAND);
+    EXPECT_EQ(OutgoingScheduler::priority_of(MAVLINK_MSG_ID_PARAM_SET),
+              OutgoingScheduler::Priority::BULK);
+}
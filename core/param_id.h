@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace dronecore {
+
+// Id of a MAVLink param, at most 16 chars. It is kept inline and padded with
+// zeros as in the messages, so that it can be copied, compared and hashed
+// without allocating and packed into a message as it is.
+class ParamId
+{
+public:
+    static constexpr size_t MAX_LEN = 16;
+
+    ParamId()
+    {
+        memset(_id, 0, sizeof(_id));
+    }
+
+    // Returns false if the name is too long to be a param id.
+    static bool from_name(const std::string &name, ParamId &id)
+    {
+        if (name.size() > MAX_LEN) {
+            return false;
+        }
+        id = ParamId();
+        memcpy(id._id, name.data(), name.size());
+        return true;
+    }
+
+    // The id of a message is not 0-terminated if it uses all 16 chars.
+    static ParamId from_mavlink(const char *param_id)
+    {
+        ParamId id;
+        strncpy(id._id, param_id, MAX_LEN);
+        return id;
+    }
+
+    // The 16 bytes of a message, also 0-terminated.
+    const char *c_str() const { return _id; }
+    std::string str() const { return std::string(_id); }
+    bool empty() const { return _id[0] == '\0'; }
+
+    bool starts_with(const ParamId &prefix) const
+    {
+        const size_t len = strnlen(prefix._id, MAX_LEN);
+        return memcmp(_id, prefix._id, len) == 0;
+    }
+
+    bool operator==(const ParamId &rhs) const { return memcmp(_id, rhs._id, MAX_LEN) == 0; }
+    bool operator!=(const ParamId &rhs) const { return !(*this == rhs); }
+    bool operator<(const ParamId &rhs) const { return memcmp(_id, rhs._id, MAX_LEN) < 0; }
+
+    struct Hash {
+        size_t operator()(const ParamId &id) const
+        {
+            uint64_t words[2];
+            memcpy(words, id._id, sizeof(words));
+            // Mixed so that ids with the same start still spread.
+            const uint64_t hash = (words[0] * 0x9e3779b97f4a7c15ull) ^
+                                  (words[1] + 0x7f4a7c159e3779b9ull + (words[0] >> 29));
+            return size_t(hash ^ (hash >> 32));
+        }
+    };
+
+private:
+    // One more for the 0 of c_str(), it is not compared.
+    char _id[MAX_LEN + 1];
+};
+
+} // namespace dronecore
@@ -0,0 +1,55 @@
+#include "param_id.h"
+#include <gtest/gtest.h>
+#include <unordered_set>
+
+using namespace dronecore;
+
+TEST(ParamId, FromName)
+{
+    ParamId id;
+    EXPECT_TRUE(id.empty());
+
+    ASSERT_TRUE(ParamId::from_name("MPC_XY_CRUISE", id));
+    EXPECT_STREQ(id.c_str(), "MPC_XY_CRUISE");
+    EXPECT_EQ(id.str(), "MPC_XY_CRUISE");
+
+    ASSERT_TRUE(ParamId::from_name("SIXTEEN_CHARS_ID", id));
+    EXPECT_EQ(id.str(), "SIXTEEN_CHARS_ID");
+
+    EXPECT_FALSE(ParamId::from_name("SEVENTEEN_CHARS_I", id));
+    EXPECT_EQ(id.str(), "SIXTEEN_CHARS_ID");
+}
+
+TEST(ParamId, FromMavlink)
+{
+    // Not 0-terminated, followed by whatever comes next in the message.
+    const char message[] = "SIXTEEN_CHARS_IDxyz";
+    const ParamId id = ParamId::from_mavlink(message);
+    EXPECT_EQ(id.str(), "SIXTEEN_CHARS_ID");
+
+    ParamId expected;
+    ASSERT_TRUE(ParamId::from_name("SIXTEEN_CHARS_ID", expected));
+    EXPECT_EQ(id, expected);
+
+    EXPECT_EQ(ParamId::from_mavlink("NAV_FT_DST"), ParamId::from_mavlink("NAV_FT_DST\0x"));
+}
+
+TEST(ParamId, CompareAndHash)
+{
+    const ParamId a = ParamId::from_mavlink("NAV_FT_DST");
+    const ParamId b = ParamId::from_mavlink("NAV_FT_FS");
+    const ParamId prefix = ParamId::from_mavlink("NAV_FT_");
+
+    EXPECT_NE(a, b);
+    EXPECT_TRUE(a < b);
+    EXPECT_FALSE(b < a);
+    EXPECT_TRUE(a.starts_with(prefix));
+    EXPECT_TRUE(b.starts_with(prefix));
+    EXPECT_FALSE(prefix.starts_with(a));
+    EXPECT_TRUE(a.starts_with(ParamId()));
+
+    std::unordered_set<ParamId, ParamId::Hash> ids {a, b, prefix};
+    EXPECT_EQ(ids.size(), 3u);
+    EXPECT_EQ(ids.count(ParamId::from_mavlink("NAV_FT_DST")), 1u);
+    EXPECT_EQ(ids.count(ParamId::from_mavlink("NAV_FT_RS")), 0u);
+}
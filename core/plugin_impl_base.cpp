@@ -1,6 +1,7 @@
 #include "system.h"
 #include "global_include.h"
 #include "plugin_impl_base.h"
+#include "mavlink_system.h"
 
 
 namespace dronecore {
@@ -8,4 +9,46 @@ namespace dronecore {
 PluginImplBase::PluginImplBase(System &system) :
     _parent(system.mavlink_system()) {}
 
+void PluginImplBase::allow_enable_on_first_use()
+{
+    _lazy = _parent->plugins_on_first_use();
+}
+
+void PluginImplBase::on_connected()
+{
+    std::lock_guard<std::mutex> lock(_enable_mutex);
+    _connected = true;
+    enable_if_needed();
+}
+
+void PluginImplBase::on_disconnected()
+{
+    std::lock_guard<std::mutex> lock(_enable_mutex);
+    _connected = false;
+    if (_enabled) {
+        _enabled = false;
+        disable();
+    }
+}
+
+void PluginImplBase::activate()
+{
+    if (!_lazy || _activated) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_enable_mutex);
+    _activated = true;
+    enable_if_needed();
+}
+
+void PluginImplBase::enable_if_needed()
+{
+    if (!_connected || _enabled || (_lazy && !_activated)) {
+        return;
+    }
+    _enabled = true;
+    enable();
+}
+
 } // namespace dronecore
@@ -1,5 +1,8 @@
 #pragma once
+#include "dronecore.h"
+#include <atomic>
 #include <memory>
+#include <mutex>
 
 namespace dronecore {
 
@@ -38,6 +41,9 @@ public:
      * system to be connected such as setting/getting parameters.
      *
      * If any threads, call_every or timeouts are needed, they can be started now.
+     *
+     * For plugins which allow it with `allow_enable_on_first_use()`, this can be
+     * delayed until `activate()` is first called.
      */
     virtual void enable() = 0;
 
@@ -54,12 +60,50 @@ public:
      */
     virtual void disable() = 0;
 
+    /*
+     * Called by MAVLinkSystem instead of `enable()` and `disable()`, so that the
+     * plugin is only enabled once it is used if it is lazy.
+     */
+    void on_connected();
+    void on_disconnected();
+
+    /*
+     * Plugins which allow to be enabled on first use call this before whatever
+     * needs the plugin to be enabled, e.g. a getter of a value which depends on
+     * params read in `enable()`. It is cheap after the first call.
+     */
+    void activate();
+
+    /*
+     * Plugins which run threads of their own or keep data that grows with use,
+     * e.g. a history or a mission, add it to what DroneCore::resource_usage()
+     * reports. It can be called from any thread while the plugin is registered.
+     */
+    virtual void add_resource_usage(DroneCore::ResourceUsage &usage) { (void)usage; }
+
     // Non-copyable
     PluginImplBase(const PluginImplBase &) = delete;
     const PluginImplBase &operator=(const PluginImplBase &) = delete;
 
 protected:
+    /*
+     * To be called in the constructor, before registering with _parent. If
+     * DroneCore is set up for it, `enable()` is then only called once
+     * `activate()` has been called and the system is connected.
+     */
+    void allow_enable_on_first_use();
+
     std::shared_ptr<MAVLinkSystem> _parent;
+
+private:
+    // We assume that we already acquired _enable_mutex in this function.
+    void enable_if_needed();
+
+    std::mutex _enable_mutex {};
+    bool _connected {false};
+    bool _enabled {false};
+    bool _lazy {false};
+    std::atomic<bool> _activated {false};
 };
 
 } // namespace dronecore
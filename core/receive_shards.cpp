@@ -0,0 +1,171 @@
+#include "receive_shards.h"
+#include "thread_roles.h"
+#include <algorithm>
+#include <utility>
+
+namespace dronecore {
+
+constexpr size_t ReceiveShards::QUEUE_LEN;
+constexpr size_t ReceiveShards::NUM_CLASSES;
+
+ReceiveShards::ReceiveShards(unsigned num_shards, dispatch_t dispatch) :
+    _dispatch(dispatch)
+{
+    for (unsigned i = 0; i < std::max(num_shards, 1u); ++i) {
+        _shards.emplace_back(new Shard());
+    }
+    for (auto &shard : _shards) {
+        shard->thread = new std::thread(&ReceiveShards::run, this, std::ref(*shard));
+    }
+}
+
+ReceiveShards::~ReceiveShards()
+{
+    for (auto &shard : _shards) {
+        {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            shard->should_exit = true;
+            for (auto &lane : shard->lanes) {
+                lane.queue.clear();
+            }
+        }
+        shard->cv.notify_all();
+    }
+    for (auto &shard : _shards) {
+        shard->thread->join();
+        delete shard->thread;
+        shard->thread = nullptr;
+    }
+}
+
+DroneCore::DispatchClass ReceiveShards::dispatch_class_of(uint32_t message_id)
+{
+    // What something is waiting for, or what tells us whether a vehicle is there.
+    switch (message_id) {
+        case MAVLINK_MSG_ID_HEARTBEAT:
+        case MAVLINK_MSG_ID_COMMAND_ACK:
+        case MAVLINK_MSG_ID_AUTOPILOT_VERSION:
+        case MAVLINK_MSG_ID_TIMESYNC:
+        case MAVLINK_MSG_ID_PARAM_VALUE:
+        case MAVLINK_MSG_ID_PARAM_EXT_VALUE:
+        case MAVLINK_MSG_ID_PARAM_EXT_ACK:
+        case MAVLINK_MSG_ID_MISSION_REQUEST:
+        case MAVLINK_MSG_ID_MISSION_REQUEST_INT:
+        case MAVLINK_MSG_ID_MISSION_COUNT:
+        case MAVLINK_MSG_ID_MISSION_ITEM_INT:
+        case MAVLINK_MSG_ID_MISSION_ACK:
+        case MAVLINK_MSG_ID_MISSION_ITEM_REACHED:
+            return DroneCore::DispatchClass::PRIORITY;
+        default:
+            return DroneCore::DispatchClass::BULK;
+    }
+}
+
+void ReceiveShards::post(const MAVLinkMessageView &message, Connection *connection)
+{
+    // The view points into the receive buffer, so the message is copied.
+    Shard &shard = *_shards[message.sysid() % _shards.size()];
+    Lane &lane = shard.lanes[size_t(dispatch_class_of(message.msgid()))];
+    MessagePool::Handle stored = shard.pool.store(message);
+    {
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        shard.cv.wait(lock, [&shard, &lane]() {
+            return lane.queue.size() < QUEUE_LEN || shard.should_exit;
+        });
+        if (shard.should_exit) {
+            return;
+        }
+        lane.queue.push_back(Item {std::move(stored), connection});
+        lane.max_depth = std::max(lane.max_depth, lane.queue.size());
+    }
+    shard.cv.notify_all();
+}
+
+bool ReceiveShards::is_empty(const Shard &shard)
+{
+    for (const auto &lane : shard.lanes) {
+        if (!lane.queue.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+ReceiveShards::Lane &ReceiveShards::next_lane(Shard &shard)
+{
+    // The lanes are in the order of the dispatch classes, priority first.
+    for (auto &lane : shard.lanes) {
+        if (!lane.queue.empty()) {
+            return lane;
+        }
+    }
+    return shard.lanes.back();
+}
+
+void ReceiveShards::run(Shard &shard)
+{
+    ThreadRoles::apply_to_this_thread(DroneCore::ThreadRole::DISPATCH, "receive_shard");
+
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    while (true) {
+        shard.cv.wait(lock, [&shard]() { return !is_empty(shard) || shard.should_exit; });
+        if (shard.should_exit) {
+            return;
+        }
+        Lane &lane = next_lane(shard);
+        Item item = lane.queue.pop_front();
+        ++lane.num_dispatched;
+        lock.unlock();
+        // Wake up the receive thread if it waits for room.
+        shard.cv.notify_all();
+
+        mavlink_message_t storage;
+        _dispatch(item.message.view(storage), item.connection);
+        // All handlers are done with it.
+        item.message.reset();
+
+        lock.lock();
+        ++lane.num_finished;
+        // Only wait_until_dispatched() waits for this.
+        shard.cv.notify_all();
+    }
+}
+
+void ReceiveShards::wait_until_dispatched()
+{
+    for (auto &shard : _shards) {
+        std::unique_lock<std::mutex> lock(shard->mutex);
+        // Each lane is in order, so the ones queued now are done once as many
+        // are finished as have been popped or are still waiting.
+        std::array<uint64_t, NUM_CLASSES> num_posted {};
+        for (size_t i = 0; i < NUM_CLASSES; ++i) {
+            num_posted[i] = shard->lanes[i].num_dispatched + shard->lanes[i].queue.size();
+        }
+        shard->cv.wait(lock, [&shard, &num_posted]() {
+            if (shard->should_exit) {
+                return true;
+            }
+            for (size_t i = 0; i < NUM_CLASSES; ++i) {
+                if (shard->lanes[i].num_finished < num_posted[i]) {
+                    return false;
+                }
+            }
+            return true;
+        });
+    }
+}
+
+DroneCore::DispatchStats ReceiveShards::stats(DroneCore::DispatchClass dispatch_class) const
+{
+    DroneCore::DispatchStats stats {0, 0, 0};
+    for (const auto &shard : _shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        const Lane &lane = shard->lanes[size_t(dispatch_class)];
+        stats.num_dispatched += lane.num_dispatched;
+        stats.queue_depth += lane.queue.size();
+        stats.max_queue_depth = std::max(stats.max_queue_depth, uint64_t(lane.max_depth));
+    }
+    return stats;
+}
+
+} // namespace dronecore
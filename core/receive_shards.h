@@ -0,0 +1,96 @@
+#pragma once
+
+#include "dronecore.h"
+#include "mavlink_include.h"
+#include "mavlink_message_view.h"
+#include "message_pool.h"
+#include "ring_queue.h"
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dronecore {
+
+class Connection;
+
+// Hands received messages over to worker threads, so that the receive thread
+// only has to frame them. Messages of one system always go to the same shard
+// and are dispatched in the order they arrived, while different systems are
+// dispatched in parallel.
+//
+// Each shard has a queue for each dispatch class, and priority messages are
+// dispatched first, so that e.g. a command ack doesn't wait behind a burst of
+// log data. The order of one system is then only kept within each class.
+class ReceiveShards
+{
+public:
+    typedef std::function<void(const MAVLinkMessageView &message, Connection *connection)>
+    dispatch_t;
+
+    // If a queue of a shard falls this far behind, the receive thread waits for it.
+    static constexpr size_t QUEUE_LEN = 1024;
+
+    ReceiveShards(unsigned num_shards, dispatch_t dispatch);
+    // What is still queued is dropped, its connection might be gone already.
+    ~ReceiveShards();
+
+    void post(const MAVLinkMessageView &message, Connection *connection);
+
+    // Returns once everything posted before has been dispatched, e.g. so that
+    // a connection it came from can go. Not to be called from a dispatch.
+    void wait_until_dispatched();
+
+    unsigned num_shards() const { return unsigned(_shards.size()); }
+
+    static DroneCore::DispatchClass dispatch_class_of(uint32_t message_id);
+
+    DroneCore::DispatchStats stats(DroneCore::DispatchClass dispatch_class) const;
+
+    // Non-copyable
+    ReceiveShards(const ReceiveShards &) = delete;
+    const ReceiveShards &operator=(const ReceiveShards &) = delete;
+
+private:
+    // Only as long as the frame, instead of a whole mavlink_message_t.
+    struct Item {
+        MessagePool::Handle message;
+        Connection *connection;
+    };
+
+    static constexpr size_t NUM_CLASSES = 2;
+
+    struct Lane {
+        RingQueue<Item> queue {};
+        uint64_t num_dispatched = 0;
+        // Lags behind num_dispatched while one is being dispatched.
+        uint64_t num_finished = 0;
+        size_t max_depth = 0;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex {};
+        std::condition_variable cv {};
+        // Before the lanes, so that it outlives what they hold.
+        MessagePool pool {};
+        // Indexed by the dispatch class.
+        std::array<Lane, NUM_CLASSES> lanes {};
+        bool should_exit = false;
+        std::thread *thread = nullptr;
+    };
+
+    // We assume that we already acquired the mutex of the shard in these.
+    static bool is_empty(const Shard &shard);
+    static Lane &next_lane(Shard &shard);
+
+    void run(Shard &shard);
+
+    const dispatch_t _dispatch;
+    std::vector<std::unique_ptr<Shard>> _shards {};
+};
+
+} // namespace dronecore
@@ -0,0 +1,150 @@
+#include "receive_shards.h"
+#include <gtest/gtest.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace dronecore;
+
+TEST(ReceiveShards, KeepsOrderOfEachSystem)
+{
+    const unsigned num_systems = 8;
+    const unsigned num_per_system = 200;
+
+    std::mutex mutex;
+    std::array<std::vector<uint8_t>, num_systems + 1> seqs;
+    std::map<uint8_t, std::thread::id> threads;
+    bool same_thread = true;
+    unsigned num_dispatched = 0;
+
+    {
+        ReceiveShards shards(3, [&](const MAVLinkMessageView & message, Connection *) {
+            std::lock_guard<std::mutex> lock(mutex);
+            seqs[message.sysid()].push_back(message.seq());
+            auto it = threads.find(message.sysid());
+            if (it == threads.end()) {
+                threads[message.sysid()] = std::this_thread::get_id();
+            } else if (it->second != std::this_thread::get_id()) {
+                same_thread = false;
+            }
+            ++num_dispatched;
+        });
+        EXPECT_EQ(shards.num_shards(), 3u);
+
+        for (unsigned i = 0; i < num_per_system; ++i) {
+            for (uint8_t sysid = 1; sysid <= num_systems; ++sysid) {
+                mavlink_message_t message;
+                mavlink_msg_heartbeat_pack(sysid, MAV_COMP_ID_AUTOPILOT1, &message,
+                                           MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_PX4, 0, 0,
+                                           MAV_STATE_ACTIVE);
+                message.seq = uint8_t(i);
+                shards.post(MAVLinkMessageView(message), nullptr);
+            }
+        }
+
+        for (unsigned i = 0; i < 1000; ++i) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (num_dispatched == num_systems * num_per_system) {
+                    break;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    EXPECT_TRUE(same_thread);
+    for (uint8_t sysid = 1; sysid <= num_systems; ++sysid) {
+        ASSERT_EQ(seqs[sysid].size(), num_per_system);
+        for (unsigned i = 0; i < num_per_system; ++i) {
+            EXPECT_EQ(seqs[sysid][i], uint8_t(i));
+        }
+    }
+}
+
+TEST(ReceiveShards, DispatchesPriorityFirst)
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool blocked = false;
+    bool released = false;
+    std::vector<uint32_t> msgids;
+
+    ReceiveShards shards(1, [&](const MAVLinkMessageView & message, Connection *) {
+        std::unique_lock<std::mutex> lock(mutex);
+        msgids.push_back(message.msgid());
+        if (msgids.size() == 1) {
+            // Hold up the shard until the rest is queued.
+            blocked = true;
+            cv.notify_all();
+            cv.wait(lock, [&released]() { return released; });
+        }
+        cv.notify_all();
+    });
+
+    mavlink_message_t message;
+    mavlink_msg_heartbeat_pack(1, MAV_COMP_ID_AUTOPILOT1, &message, MAV_TYPE_QUADROTOR,
+                               MAV_AUTOPILOT_PX4, 0, 0, MAV_STATE_ACTIVE);
+    shards.post(MAVLinkMessageView(message), nullptr);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&blocked]() { return blocked; });
+    }
+
+    for (unsigned i = 0; i < 10; ++i) {
+        mavlink_msg_attitude_pack(1, MAV_COMP_ID_AUTOPILOT1, &message, i, 0.0f, 0.0f, 0.0f,
+                                  0.0f, 0.0f, 0.0f);
+        shards.post(MAVLinkMessageView(message), nullptr);
+    }
+    mavlink_msg_command_ack_pack(1, MAV_COMP_ID_AUTOPILOT1, &message, MAV_CMD_COMPONENT_ARM_DISARM,
+                                 MAV_RESULT_ACCEPTED, 0, 0, 0, 0);
+    shards.post(MAVLinkMessageView(message), nullptr);
+
+    const DroneCore::DispatchStats bulk = shards.stats(DroneCore::DispatchClass::BULK);
+    EXPECT_EQ(bulk.queue_depth, 10u);
+    EXPECT_EQ(bulk.max_queue_depth, 10u);
+    EXPECT_EQ(shards.stats(DroneCore::DispatchClass::PRIORITY).queue_depth, 1u);
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        released = true;
+        cv.notify_all();
+        cv.wait_for(lock, std::chrono::seconds(1), [&msgids]() { return msgids.size() == 12; });
+    }
+
+    ASSERT_EQ(msgids.size(), 12u);
+    EXPECT_EQ(msgids[0], uint32_t(MAVLINK_MSG_ID_HEARTBEAT));
+    EXPECT_EQ(msgids[1], uint32_t(MAVLINK_MSG_ID_COMMAND_ACK));
+    EXPECT_EQ(msgids[11], uint32_t(MAVLINK_MSG_ID_ATTITUDE));
+    EXPECT_EQ(shards.stats(DroneCore::DispatchClass::PRIORITY).num_dispatched, 2u);
+    EXPECT_EQ(shards.stats(DroneCore::DispatchClass::BULK).num_dispatched, 10u);
+}
+
+TEST(ReceiveShards, WaitsUntilDispatched)
+{
+    std::atomic<unsigned> num_dispatched {0};
+
+    ReceiveShards shards(2, [&](const MAVLinkMessageView &, Connection *) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        ++num_dispatched;
+    });
+
+    for (unsigned i = 0; i < 100; ++i) {
+        mavlink_message_t message;
+        mavlink_msg_heartbeat_pack(uint8_t(1 + i % 4), MAV_COMP_ID_AUTOPILOT1, &message,
+                                   MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_PX4, 0, 0,
+                                   MAV_STATE_ACTIVE);
+        shards.post(MAVLinkMessageView(message), nullptr);
+    }
+
+    shards.wait_until_dispatched();
+    EXPECT_EQ(num_dispatched.load(), 100u);
+
+    // Also with nothing queued.
+    shards.wait_until_dispatched();
+}
@@ -0,0 +1,68 @@
+#include "received_ranges.h"
+#include <algorithm>
+
+namespace dronecore {
+
+void ReceivedRanges::add(uint32_t begin, uint32_t end)
+{
+    if (begin >= end) {
+        return;
+    }
+
+    // Appending is what happens most.
+    if (_ranges.empty() || begin > _ranges.back().second) {
+        _ranges.push_back(std::make_pair(begin, end));
+        _num_bytes += end - begin;
+        return;
+    }
+
+    // The first range which ends at or after begin, it and the ones up to end
+    // are merged into one.
+    auto first = std::lower_bound(_ranges.begin(), _ranges.end(), begin,
+    [](const std::pair<uint32_t, uint32_t> &range, uint32_t value) {
+        return range.second < value;
+    });
+
+    auto last = first;
+    while (last != _ranges.end() && last->first <= end) {
+        begin = std::min(begin, last->first);
+        end = std::max(end, last->second);
+        _num_bytes -= last->second - last->first;
+        ++last;
+    }
+
+    first = _ranges.erase(first, last);
+    _ranges.insert(first, std::make_pair(begin, end));
+    _num_bytes += end - begin;
+}
+
+bool ReceivedRanges::first_gap(uint32_t size, uint32_t &begin, uint32_t &end) const
+{
+    uint32_t position = 0;
+    for (const auto &range : _ranges) {
+        if (position >= size) {
+            return false;
+        }
+        if (range.first > position) {
+            begin = position;
+            end = std::min(range.first, size);
+            return true;
+        }
+        position = range.second;
+    }
+
+    if (position < size) {
+        begin = position;
+        end = size;
+        return true;
+    }
+    return false;
+}
+
+void ReceivedRanges::clear()
+{
+    _ranges.clear();
+    _num_bytes = 0;
+}
+
+} // namespace dronecore
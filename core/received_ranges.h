@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace dronecore {
+
+// The parts of a file received so far, as sorted and merged ranges of bytes,
+// so that what is still missing can be asked for again. A transfer mostly
+// appends to the last range, so there are only as many ranges as gaps.
+class ReceivedRanges
+{
+public:
+    ReceivedRanges() {}
+    ~ReceivedRanges() {}
+
+    // The range is [begin, end), and may overlap what is there already.
+    void add(uint32_t begin, uint32_t end);
+
+    // The lowest range missing below size, returns false if there is none.
+    bool first_gap(uint32_t size, uint32_t &begin, uint32_t &end) const;
+
+    uint32_t num_bytes() const { return _num_bytes; }
+
+    void clear();
+
+private:
+    std::vector<std::pair<uint32_t, uint32_t>> _ranges {};
+    uint32_t _num_bytes = 0;
+};
+
+} // namespace dronecore
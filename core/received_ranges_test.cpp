@@ -0,0 +1,63 @@
+#include "received_ranges.h"
+#include <gtest/gtest.h>
+
+using namespace dronecore;
+
+TEST(ReceivedRanges, AppendsInOrder)
+{
+    ReceivedRanges ranges;
+    ranges.add(0, 100);
+    ranges.add(100, 200);
+    EXPECT_EQ(ranges.num_bytes(), 200u);
+
+    uint32_t begin, end;
+    EXPECT_FALSE(ranges.first_gap(200, begin, end));
+    EXPECT_TRUE(ranges.first_gap(300, begin, end));
+    EXPECT_EQ(begin, 200u);
+    EXPECT_EQ(end, 300u);
+}
+
+TEST(ReceivedRanges, FindsGaps)
+{
+    ReceivedRanges ranges;
+    ranges.add(100, 200);
+    ranges.add(300, 400);
+
+    uint32_t begin, end;
+    EXPECT_TRUE(ranges.first_gap(400, begin, end));
+    EXPECT_EQ(begin, 0u);
+    EXPECT_EQ(end, 100u);
+
+    ranges.add(0, 100);
+    EXPECT_TRUE(ranges.first_gap(400, begin, end));
+    EXPECT_EQ(begin, 200u);
+    EXPECT_EQ(end, 300u);
+
+    // Only what is below the size counts.
+    EXPECT_TRUE(ranges.first_gap(250, begin, end));
+    EXPECT_EQ(begin, 200u);
+    EXPECT_EQ(end, 250u);
+    EXPECT_FALSE(ranges.first_gap(150, begin, end));
+}
+
+TEST(ReceivedRanges, MergesOverlaps)
+{
+    ReceivedRanges ranges;
+    ranges.add(0, 10);
+    ranges.add(20, 30);
+    ranges.add(40, 50);
+    EXPECT_EQ(ranges.num_bytes(), 30u);
+
+    // Received twice.
+    ranges.add(20, 30);
+    EXPECT_EQ(ranges.num_bytes(), 30u);
+
+    ranges.add(5, 45);
+    EXPECT_EQ(ranges.num_bytes(), 50u);
+
+    uint32_t begin, end;
+    EXPECT_FALSE(ranges.first_gap(50, begin, end));
+
+    ranges.clear();
+    EXPECT_EQ(ranges.num_bytes(), 0u);
+}
@@ -0,0 +1,140 @@
+#include "replay_connection.h"
+#include "log.h"
+#include "thread_roles.h"
+#include <algorithm>
+
+namespace dronecore {
+
+constexpr double ReplayConnection::MAX_WAIT_S;
+
+ReplayConnection::ReplayConnection(DroneCoreImpl &parent, const std::string &path,
+                                   double speed) :
+    Connection(parent),
+    _path(path),
+    _speed(std::max(speed, 0.0)),
+    _time(_own_time)
+{}
+
+ReplayConnection::ReplayConnection(DroneCoreImpl &parent, const std::string &path,
+                                   double speed, Time &time) :
+    Connection(parent),
+    _path(path),
+    _speed(std::max(speed, 0.0)),
+    _time(time)
+{}
+
+ReplayConnection::~ReplayConnection()
+{
+    // If no one explicitly called stop before, we should at least do it.
+    stop();
+}
+
+bool ReplayConnection::is_ok() const
+{
+    return true;
+}
+
+ConnectionResult ReplayConnection::start()
+{
+    start_mavlink_receiver();
+
+    if (!_reader.open(_path)) {
+        return ConnectionResult::CONNECTION_ERROR;
+    }
+
+    _should_exit = false;
+    _is_done = false;
+    _replay_thread = new std::thread(replay, this);
+
+    return ConnectionResult::SUCCESS;
+}
+
+ConnectionResult ReplayConnection::stop()
+{
+    _should_exit = true;
+
+    stop_outgoing_scheduler();
+
+    if (_replay_thread) {
+        _replay_thread->join();
+        delete _replay_thread;
+        _replay_thread = nullptr;
+    }
+
+    // We need to stop this after stopping the replay thread, otherwise
+    // it can happen that we interfere with the parsing of a message.
+    stop_mavlink_receiver();
+
+    return ConnectionResult::SUCCESS;
+}
+
+bool ReplayConnection::send_frame(const uint8_t *frame, unsigned frame_len,
+                                  uint8_t target_system)
+{
+    UNUSED(frame);
+    UNUSED(frame_len);
+    UNUSED(target_system);
+
+    // There is no one to send to, so it is as good as sent.
+    return true;
+}
+
+void ReplayConnection::replay(ReplayConnection *parent)
+{
+    ThreadRoles::apply_to_this_thread(DroneCore::ThreadRole::RECEIVE, "replay");
+
+    ReplayReader::Record record {};
+    bool has_first = false;
+    uint64_t first_time_us = 0;
+    dl_time_t start_time {};
+    uint64_t num_records = 0;
+
+    while (!parent->_should_exit && parent->_reader.read_next(record)) {
+        if (parent->_speed > 0.0) {
+            if (!has_first) {
+                first_time_us = record.time_us;
+                start_time = parent->_time.steady_time();
+                has_first = true;
+            }
+            // Records out of order are replayed right away.
+            const double since_first_s = record.time_us > first_time_us ?
+                                         double(record.time_us - first_time_us) * 1e-6 : 0.0;
+            if (!parent->wait_until_due(since_first_s / parent->_speed, start_time)) {
+                return;
+            }
+        }
+
+        if (record.data.empty()) {
+            continue;
+        }
+        ++num_records;
+
+        parent->_mavlink_receiver->set_new_datagram(reinterpret_cast<char *>(&record.data[0]),
+                                                    unsigned(record.data.size()));
+        // Parse all mavlink messages in one data packet. Once exhausted, we'll exit while.
+        while (parent->_mavlink_receiver->parse_message()) {
+            parent->receive_message(parent->_mavlink_receiver->get_last_message_view());
+        }
+    }
+
+    if (!parent->_should_exit) {
+        LogInfo() << "Replayed " << num_records << " records of " << parent->_path;
+        parent->_is_done = true;
+    }
+}
+
+bool ReplayConnection::wait_until_due(double due_s, const dl_time_t &start_time)
+{
+    while (!_should_exit) {
+        const double wait_s = due_s - _time.elapsed_since_s(start_time);
+        if (wait_s <= 0.0) {
+            return true;
+        }
+        // At least a microsecond, so that a FakeTime moves on.
+        _time.sleep_for(std::chrono::microseconds(
+                            std::max(int64_t(std::min(wait_s, MAX_WAIT_S) * 1e6), int64_t(1))));
+    }
+    return false;
+}
+
+} // namespace dronecore
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include "connection.h"
+#include "global_include.h"
+#include "replay_reader.h"
+
+namespace dronecore {
+
+// Feeds a recording into DroneCore as if it was received, see ReplayReader
+// for the formats. What is sent is dropped.
+//
+// At a speed of 1, the messages come at the times they were recorded, at 2
+// twice as fast, and at 0 as fast as they can be parsed. The pacing uses the
+// given Time, so that with a FakeTime a benchmark replays the same way
+// however busy the host is.
+class ReplayConnection : public Connection
+{
+public:
+    explicit ReplayConnection(DroneCoreImpl &parent, const std::string &path, double speed);
+    explicit ReplayConnection(DroneCoreImpl &parent, const std::string &path, double speed,
+                              Time &time);
+    ~ReplayConnection();
+    bool is_ok() const;
+    ConnectionResult start();
+    ConnectionResult stop();
+
+    bool send_frame(const uint8_t *frame, unsigned frame_len, uint8_t target_system) override;
+
+    // Whether all of the recording was replayed.
+    bool is_done() const { return _is_done; }
+
+    // Non-copyable
+    ReplayConnection(const ReplayConnection &) = delete;
+    const ReplayConnection &operator=(const ReplayConnection &) = delete;
+
+private:
+    static void replay(ReplayConnection *parent);
+    // Returns false if stopped before.
+    bool wait_until_due(double due_s, const dl_time_t &start_time);
+
+    // Waits are split up so that stop() does not hang on a long gap.
+    static constexpr double MAX_WAIT_S = 0.1;
+
+    const std::string _path;
+    const double _speed;
+
+    Time _own_time {};
+    Time &_time;
+
+    ReplayReader _reader {};
+
+    std::thread *_replay_thread = nullptr;
+    std::atomic_bool _should_exit {false};
+    std::atomic_bool _is_done {false};
+};
+
+} // namespace dronecore
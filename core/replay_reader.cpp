@@ -0,0 +1,245 @@
+#include "replay_reader.h"
+#include "log.h"
+
+namespace dronecore {
+
+constexpr uint32_t ReplayReader::PCAP_MAGIC_US;
+constexpr uint32_t ReplayReader::PCAP_MAGIC_NS;
+constexpr uint32_t ReplayReader::LINKTYPE_NULL;
+constexpr uint32_t ReplayReader::LINKTYPE_ETHERNET;
+constexpr uint32_t ReplayReader::LINKTYPE_RAW;
+constexpr uint32_t ReplayReader::LINKTYPE_LINUX_SLL;
+constexpr uint32_t ReplayReader::MAX_PCAP_RECORD_LEN;
+
+namespace {
+
+uint16_t big_endian_u16(const uint8_t *bytes)
+{
+    return uint16_t((bytes[0] << 8) | bytes[1]);
+}
+
+uint32_t big_endian_u32(const uint8_t *bytes)
+{
+    return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) |
+           (uint32_t(bytes[2]) << 8) | uint32_t(bytes[3]);
+}
+
+uint32_t little_endian_u32(const uint8_t *bytes)
+{
+    return (uint32_t(bytes[3]) << 24) | (uint32_t(bytes[2]) << 16) |
+           (uint32_t(bytes[1]) << 8) | uint32_t(bytes[0]);
+}
+
+} // namespace
+
+ReplayReader::ReplayReader() {}
+
+ReplayReader::~ReplayReader() {}
+
+bool ReplayReader::open(const std::string &path)
+{
+    _file.open(path.c_str(), std::ios::binary);
+    if (!_file.is_open()) {
+        LogErr() << "Could not open " << path;
+        return false;
+    }
+
+    uint8_t magic[4];
+    if (!read_bytes(magic, sizeof(magic))) {
+        LogErr() << path << " is empty";
+        return false;
+    }
+
+    const uint32_t magic_le = little_endian_u32(magic);
+    const uint32_t magic_be = big_endian_u32(magic);
+    if (magic_le == PCAP_MAGIC_US || magic_le == PCAP_MAGIC_NS ||
+        magic_be == PCAP_MAGIC_US || magic_be == PCAP_MAGIC_NS) {
+        _format = Format::PCAP;
+        _pcap_swapped = (magic_le != PCAP_MAGIC_US && magic_le != PCAP_MAGIC_NS);
+        _pcap_nanoseconds = (magic_le == PCAP_MAGIC_NS || magic_be == PCAP_MAGIC_NS);
+        return read_pcap_header();
+    }
+
+    _format = Format::TLOG;
+    _file.seekg(0);
+    return true;
+}
+
+bool ReplayReader::read_next(Record &record)
+{
+    if (!_file.is_open()) {
+        return false;
+    }
+    return _format == Format::PCAP ? read_pcap(record) : read_tlog(record);
+}
+
+bool ReplayReader::read_tlog(Record &record)
+{
+    uint8_t time[8];
+    if (!read_bytes(time, sizeof(time))) {
+        return false;
+    }
+    record.time_us = (uint64_t(big_endian_u32(&time[0])) << 32) | big_endian_u32(&time[4]);
+
+    // The start marker and payload length tell how long the frame is.
+    uint8_t header[3];
+    if (!read_bytes(header, 2)) {
+        return false;
+    }
+
+    unsigned frame_len = 0;
+    unsigned header_len = 2;
+    if (header[0] == 0xFE) {
+        // MAVLink 1: 6 header bytes, payload, 2 checksum bytes.
+        frame_len = 8u + header[1];
+    } else if (header[0] == 0xFD) {
+        // MAVLink 2: 10 header bytes, payload, 2 checksum bytes and maybe a
+        // 13 byte signature.
+        if (!read_bytes(&header[2], 1)) {
+            return false;
+        }
+        header_len = 3;
+        frame_len = 12u + header[1] + ((header[2] & 0x01) ? 13u : 0u);
+    } else {
+        LogErr() << "tlog is corrupt, stopping there";
+        return false;
+    }
+
+    record.data.resize(frame_len);
+    for (unsigned i = 0; i < header_len; ++i) {
+        record.data[i] = header[i];
+    }
+    return read_bytes(&record.data[header_len], frame_len - header_len);
+}
+
+bool ReplayReader::read_pcap_header()
+{
+    // After the magic: version, time zone, accuracy, snap length, link type.
+    uint8_t header[20];
+    if (!read_bytes(header, sizeof(header))) {
+        LogErr() << "pcap header is cut off";
+        return false;
+    }
+
+    _pcap_linktype = pcap_u32(&header[16]);
+    if (_pcap_linktype != LINKTYPE_NULL && _pcap_linktype != LINKTYPE_ETHERNET &&
+        _pcap_linktype != LINKTYPE_RAW && _pcap_linktype != LINKTYPE_LINUX_SLL) {
+        LogErr() << "pcap link type " << _pcap_linktype << " not supported";
+        return false;
+    }
+    return true;
+}
+
+bool ReplayReader::read_pcap(Record &record)
+{
+    while (true) {
+        // Seconds, micro- or nanoseconds, captured and original length.
+        uint8_t header[16];
+        if (!read_bytes(header, sizeof(header))) {
+            return false;
+        }
+
+        const uint32_t seconds = pcap_u32(&header[0]);
+        const uint32_t fraction = pcap_u32(&header[4]);
+        const uint32_t captured_len = pcap_u32(&header[8]);
+        if (captured_len > MAX_PCAP_RECORD_LEN) {
+            LogErr() << "pcap is corrupt, stopping there";
+            return false;
+        }
+
+        record.time_us = uint64_t(seconds) * 1000000 +
+                         (_pcap_nanoseconds ? fraction / 1000 : fraction);
+        record.data.resize(captured_len);
+        if (captured_len > 0 && !read_bytes(&record.data[0], captured_len)) {
+            return false;
+        }
+
+        if (strip_to_udp_payload(record.data)) {
+            return true;
+        }
+    }
+}
+
+bool ReplayReader::strip_to_udp_payload(std::vector<uint8_t> &data) const
+{
+    size_t offset = 0;
+
+    switch (_pcap_linktype) {
+        case LINKTYPE_NULL:
+            // The address family, in the byte order of the capturing host,
+            // the IP version tells the same.
+            offset = 4;
+            break;
+        case LINKTYPE_ETHERNET: {
+                offset = 12;
+                // VLAN tags come before the actual type.
+                while (data.size() >= offset + 2 && big_endian_u16(&data[offset]) == 0x8100) {
+                    offset += 4;
+                }
+                if (data.size() < offset + 2) {
+                    return false;
+                }
+                const uint16_t ethertype = big_endian_u16(&data[offset]);
+                if (ethertype != 0x0800 && ethertype != 0x86DD) {
+                    return false;
+                }
+                offset += 2;
+                break;
+            }
+        case LINKTYPE_LINUX_SLL:
+            offset = 16;
+            break;
+        default:
+            break;
+    }
+
+    if (data.size() < offset + 1) {
+        return false;
+    }
+
+    const unsigned ip_version = data[offset] >> 4;
+    if (ip_version == 4) {
+        if (data.size() < offset + 20) {
+            return false;
+        }
+        const size_t ip_header_len = size_t(data[offset] & 0x0F) * 4;
+        // Fragments don't have the whole datagram.
+        const uint16_t fragment = big_endian_u16(&data[offset + 6]);
+        if (data[offset + 9] != 17 || (fragment & 0x3FFF) != 0) {
+            return false;
+        }
+        offset += ip_header_len;
+    } else if (ip_version == 6) {
+        if (data.size() < offset + 40 || data[offset + 6] != 17) {
+            return false;
+        }
+        offset += 40;
+    } else {
+        return false;
+    }
+
+    if (data.size() < offset + 8) {
+        return false;
+    }
+    const size_t udp_len = big_endian_u16(&data[offset + 4]);
+    if (udp_len < 8 || data.size() < offset + udp_len) {
+        return false;
+    }
+
+    data.erase(data.begin(), data.begin() + std::ptrdiff_t(offset + 8));
+    data.resize(udp_len - 8);
+    return true;
+}
+
+bool ReplayReader::read_bytes(void *buffer, size_t len)
+{
+    _file.read(static_cast<char *>(buffer), std::streamsize(len));
+    return size_t(_file.gcount()) == len;
+}
+
+uint32_t ReplayReader::pcap_u32(const uint8_t *bytes) const
+{
+    return _pcap_swapped ? big_endian_u32(bytes) : little_endian_u32(bytes);
+}
+
+} // namespace dronecore
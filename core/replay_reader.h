@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace dronecore {
+
+// Reads the MAVLink traffic of a recording, one record at a time.
+//
+// A tlog, as written by QGroundControl or MAVProxy, is a sequence of frames,
+// each after its time as big endian microseconds since the epoch. In a pcap
+// capture, the payloads of UDP datagrams over IPv4 or IPv6 are taken, other
+// packets are skipped. Ethernet, loopback, raw IP and Linux cooked captures
+// are supported, in either byte order and with micro- or nanoseconds.
+class ReplayReader
+{
+public:
+    enum class Format {
+        TLOG,
+        PCAP
+    };
+
+    struct Record {
+        uint64_t time_us;
+        // One frame for a tlog, a datagram with any number of them for pcap.
+        std::vector<uint8_t> data;
+    };
+
+    ReplayReader();
+    ~ReplayReader();
+
+    // The format is told apart by the pcap magic.
+    bool open(const std::string &path);
+    Format format() const { return _format; }
+
+    // Returns false at the end, or once the rest can't be read.
+    bool read_next(Record &record);
+
+    // Non-copyable
+    ReplayReader(const ReplayReader &) = delete;
+    const ReplayReader &operator=(const ReplayReader &) = delete;
+
+private:
+    bool read_tlog(Record &record);
+    bool read_pcap(Record &record);
+    bool read_pcap_header();
+    // Leaves only the UDP payload in data, returns false if there is none.
+    bool strip_to_udp_payload(std::vector<uint8_t> &data) const;
+    bool read_bytes(void *buffer, size_t len);
+    uint32_t pcap_u32(const uint8_t *bytes) const;
+
+    static constexpr uint32_t PCAP_MAGIC_US = 0xa1b2c3d4;
+    static constexpr uint32_t PCAP_MAGIC_NS = 0xa1b23c4d;
+    static constexpr uint32_t LINKTYPE_NULL = 0;
+    static constexpr uint32_t LINKTYPE_ETHERNET = 1;
+    static constexpr uint32_t LINKTYPE_RAW = 101;
+    static constexpr uint32_t LINKTYPE_LINUX_SLL = 113;
+    // Far more than any datagram, anything longer is a corrupt capture.
+    static constexpr uint32_t MAX_PCAP_RECORD_LEN = 262144;
+
+    std::ifstream _file {};
+    Format _format = Format::TLOG;
+
+    bool _pcap_swapped = false;
+    bool _pcap_nanoseconds = false;
+    uint32_t _pcap_linktype = 0;
+};
+
+} // namespace dronecore
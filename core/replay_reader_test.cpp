@@ -0,0 +1,129 @@
+#include "replay_reader.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+
+using namespace dronecore;
+
+namespace {
+
+void write_file(const std::string &path, const std::vector<uint8_t> &data)
+{
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(data.data()), std::streamsize(data.size()));
+}
+
+void append(std::vector<uint8_t> &data, const std::vector<uint8_t> &bytes)
+{
+    data.insert(data.end(), bytes.begin(), bytes.end());
+}
+
+// Little endian, as written on most hosts.
+void append_u32(std::vector<uint8_t> &data, uint32_t value)
+{
+    for (unsigned i = 0; i < 4; ++i) {
+        data.push_back(uint8_t(value >> (8 * i)));
+    }
+}
+
+std::vector<uint8_t> udp_over_ipv4(const std::vector<uint8_t> &payload, uint8_t protocol)
+{
+    const unsigned udp_len = 8 + unsigned(payload.size());
+    const unsigned ip_len = 20 + udp_len;
+    std::vector<uint8_t> packet {
+        0x45, 0, uint8_t(ip_len >> 8), uint8_t(ip_len), 0, 0, 0x40, 0, 64, protocol, 0, 0,
+        127, 0, 0, 1, 127, 0, 0, 1,
+        0x38, 0xd6, 0x37, 0x7e, uint8_t(udp_len >> 8), uint8_t(udp_len), 0, 0
+    };
+    append(packet, payload);
+    return packet;
+}
+
+} // namespace
+
+TEST(ReplayReader, ReadsTlog)
+{
+    const std::string path = "replay_reader_test.tlog";
+
+    std::vector<uint8_t> data;
+    // MAVLink 1 with a payload of 2 bytes.
+    append(data, {0, 0, 0, 0, 0, 0, 0x01, 0x00});
+    const std::vector<uint8_t> frame1 {0xFE, 2, 0, 1, 1, 0, 0xAA, 0xBB, 0xC1, 0xC2};
+    append(data, frame1);
+    // Signed MAVLink 2 with a payload of 1 byte.
+    append(data, {0, 0, 0, 0, 0, 0, 0x02, 0x00});
+    std::vector<uint8_t> frame2 {0xFD, 1, 0x01, 0, 2, 1, 1, 0, 0, 0, 0xCC, 0xC1, 0xC2};
+    frame2.resize(frame2.size() + 13, 0x55);
+    append(data, frame2);
+    write_file(path, data);
+
+    ReplayReader reader;
+    ASSERT_TRUE(reader.open(path));
+    EXPECT_EQ(reader.format(), ReplayReader::Format::TLOG);
+
+    ReplayReader::Record record {};
+    ASSERT_TRUE(reader.read_next(record));
+    EXPECT_EQ(record.time_us, 256u);
+    EXPECT_EQ(record.data, frame1);
+    ASSERT_TRUE(reader.read_next(record));
+    EXPECT_EQ(record.time_us, 512u);
+    EXPECT_EQ(record.data, frame2);
+    EXPECT_FALSE(reader.read_next(record));
+
+    remove(path.c_str());
+}
+
+TEST(ReplayReader, ReadsUdpFromPcap)
+{
+    const std::string path = "replay_reader_test.pcap";
+    const std::vector<uint8_t> payload {0xFE, 0, 0, 1, 1, 0, 0xC1, 0xC2};
+
+    std::vector<uint8_t> data;
+    append_u32(data, 0xa1b2c3d4);
+    append(data, {2, 0, 4, 0});
+    append_u32(data, 0);
+    append_u32(data, 0);
+    append_u32(data, 65535);
+    // Ethernet
+    append_u32(data, 1);
+
+    const std::vector<uint8_t> ethernet {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x08, 0x00};
+
+    // TCP is skipped.
+    std::vector<uint8_t> tcp_packet = ethernet;
+    append(tcp_packet, udp_over_ipv4(payload, 6));
+    append_u32(data, 10);
+    append_u32(data, 0);
+    append_u32(data, uint32_t(tcp_packet.size()));
+    append_u32(data, uint32_t(tcp_packet.size()));
+    append(data, tcp_packet);
+
+    std::vector<uint8_t> udp_packet = ethernet;
+    append(udp_packet, udp_over_ipv4(payload, 17));
+    append_u32(data, 11);
+    append_u32(data, 500);
+    append_u32(data, uint32_t(udp_packet.size()));
+    append_u32(data, uint32_t(udp_packet.size()));
+    append(data, udp_packet);
+    write_file(path, data);
+
+    ReplayReader reader;
+    ASSERT_TRUE(reader.open(path));
+    EXPECT_EQ(reader.format(), ReplayReader::Format::PCAP);
+
+    ReplayReader::Record record {};
+    ASSERT_TRUE(reader.read_next(record));
+    EXPECT_EQ(record.time_us, 11000500u);
+    EXPECT_EQ(record.data, payload);
+    EXPECT_FALSE(reader.read_next(record));
+
+    remove(path.c_str());
+}
+
+TEST(ReplayReader, FailsOnMissingFile)
+{
+    ReplayReader reader;
+    EXPECT_FALSE(reader.open("replay_reader_test_missing.tlog"));
+    ReplayReader::Record record {};
+    EXPECT_FALSE(reader.read_next(record));
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "memory_resource.h"
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace dronecore {
+
+// FIFO on a ring which grows like a vector. Unlike std::deque, pushing and
+// popping never allocate once it has been as long as it gets. The slots come
+// from the default memory resource. Not thread-safe.
+template<typename T>
+class RingQueue
+{
+public:
+    RingQueue() = default;
+    ~RingQueue() = default;
+
+    bool empty() const
+    {
+        return _size == 0;
+    }
+
+    size_t size() const
+    {
+        return _size;
+    }
+
+    void push_back(T item)
+    {
+        if (_size == _slots.size()) {
+            grow();
+        }
+        _slots[index_of(_size)] = std::move(item);
+        ++_size;
+    }
+
+    // Must not be empty.
+    T pop_front()
+    {
+        T item = std::move(_slots[_begin]);
+        // Whatever the item holds on to should not live on in the slot.
+        _slots[_begin] = T();
+        _begin = index_of(1);
+        --_size;
+        return item;
+    }
+
+    // Keeps the slots for later.
+    void clear()
+    {
+        while (!empty()) {
+            pop_front();
+        }
+        _begin = 0;
+    }
+
+private:
+    static constexpr size_t MIN_SLOTS = 8;
+
+    size_t index_of(size_t offset) const
+    {
+        return (_begin + offset) % _slots.size();
+    }
+
+    void grow()
+    {
+        pmr_vector<T> slots(_slots.get_allocator());
+        slots.resize(std::max(_slots.size() * 2, MIN_SLOTS));
+        for (size_t i = 0; i < _size; ++i) {
+            slots[i] = std::move(_slots[index_of(i)]);
+        }
+        _slots.swap(slots);
+        _begin = 0;
+    }
+
+    pmr_vector<T> _slots {};
+    size_t _begin = 0;
+    size_t _size = 0;
+};
+
+template<typename T>
+constexpr size_t RingQueue<T>::MIN_SLOTS;
+
+} // namespace dronecore
@@ -0,0 +1,52 @@
+#include "ring_queue.h"
+#include "allocation_counter.h"
+#include <gtest/gtest.h>
+#include <memory>
+
+using namespace dronecore;
+
+TEST(RingQueue, KeepsOrderWhileGrowing)
+{
+    RingQueue<int> queue;
+    EXPECT_TRUE(queue.empty());
+
+    // Wraps around before it has to grow.
+    for (int i = 0; i < 6; ++i) {
+        queue.push_back(i);
+    }
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(queue.pop_front(), i);
+    }
+    for (int i = 6; i < 30; ++i) {
+        queue.push_back(i);
+    }
+
+    EXPECT_EQ(queue.size(), 26u);
+    for (int i = 4; i < 30; ++i) {
+        EXPECT_EQ(queue.pop_front(), i);
+    }
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(RingQueue, DoesNotAllocateOnceGrown)
+{
+    RingQueue<std::shared_ptr<int>> queue;
+    auto item = std::make_shared<int>(1);
+    for (int i = 0; i < 20; ++i) {
+        queue.push_back(item);
+    }
+    queue.clear();
+    EXPECT_EQ(item.use_count(), 1);
+
+    AllocationCounter::reset();
+    AllocationCounter::count_this_thread();
+    for (int i = 0; i < 1000; ++i) {
+        queue.push_back(item);
+        if (queue.size() > 10) {
+            queue.pop_front();
+        }
+    }
+    AllocationCounter::stop_counting_this_thread();
+
+    EXPECT_EQ(AllocationCounter::num_allocations(), 0u);
+}
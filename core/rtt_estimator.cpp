@@ -0,0 +1,64 @@
+#include "rtt_estimator.h"
+#include <algorithm>
+#include <cmath>
+
+namespace dronecore {
+
+constexpr double RttEstimator::ALPHA;
+constexpr double RttEstimator::BETA;
+constexpr double RttEstimator::MIN_TIMEOUT_S;
+constexpr double RttEstimator::MAX_TIMEOUT_S;
+
+RttEstimator::RttEstimator() {}
+
+RttEstimator::~RttEstimator() {}
+
+void RttEstimator::reset()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _status = Status {false, 0.0, 0.0, 0};
+}
+
+void RttEstimator::add_sample(double rtt_s)
+{
+    if (!(rtt_s >= 0.0)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (!_status.valid) {
+        _status.valid = true;
+        _status.srtt_s = rtt_s;
+        _status.rttvar_s = rtt_s / 2.0;
+    } else {
+        // The variation uses the round trip from before this sample.
+        _status.rttvar_s += BETA * (std::fabs(_status.srtt_s - rtt_s) - _status.rttvar_s);
+        _status.srtt_s += ALPHA * (rtt_s - _status.srtt_s);
+    }
+    ++_status.num_samples;
+}
+
+double RttEstimator::timeout_s(double default_s) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (!_status.valid) {
+        return default_s;
+    }
+    return std::min(std::max(_status.srtt_s + 4.0 * _status.rttvar_s, MIN_TIMEOUT_S),
+                    MAX_TIMEOUT_S);
+}
+
+double RttEstimator::backed_off_s(double timeout_s)
+{
+    return std::min(2.0 * timeout_s, std::max(MAX_TIMEOUT_S, timeout_s));
+}
+
+RttEstimator::Status RttEstimator::status() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _status;
+}
+
+} // namespace dronecore
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+namespace dronecore {
+
+// Estimates how long the vehicle takes to answer, from the round trips of
+// commands and params, so that we retransmit neither too early on a slow
+// link nor wait for nothing on a fast one.
+//
+// The smoothed round trip and its variation are kept as in RFC 6298, the
+// timeout is the round trip plus four times the variation. Round trips of
+// retransmitted requests must not be added, the answer could be to any of
+// the transmissions.
+class RttEstimator
+{
+public:
+    RttEstimator();
+    ~RttEstimator();
+
+    void reset();
+
+    void add_sample(double rtt_s);
+
+    // The timeout for a request, or default_s until there are samples.
+    double timeout_s(double default_s) const;
+
+    // The timeout after the one given ran out, for the retransmission.
+    static double backed_off_s(double timeout_s);
+
+    struct Status {
+        bool valid;
+        double srtt_s;
+        double rttvar_s;
+        uint64_t num_samples;
+    };
+    Status status() const;
+
+    static constexpr double ALPHA = 1.0 / 8.0;
+    static constexpr double BETA = 1.0 / 4.0;
+    static constexpr double MIN_TIMEOUT_S = 0.1;
+    static constexpr double MAX_TIMEOUT_S = 5.0;
+
+    // Non-copyable
+    RttEstimator(const RttEstimator &) = delete;
+    const RttEstimator &operator=(const RttEstimator &) = delete;
+
+private:
+    mutable std::mutex _mutex {};
+    Status _status {false, 0.0, 0.0, 0};
+};
+
+} // namespace dronecore
@@ -0,0 +1,53 @@
+#include "rtt_estimator.h"
+#include <gtest/gtest.h>
+
+using namespace dronecore;
+
+TEST(RttEstimator, UsesDefaultUntilSampled)
+{
+    RttEstimator estimator;
+    EXPECT_DOUBLE_EQ(estimator.timeout_s(0.5), 0.5);
+    EXPECT_FALSE(estimator.status().valid);
+
+    // First sample: rtt + 4 * rtt / 2.
+    estimator.add_sample(0.1);
+    EXPECT_NEAR(estimator.timeout_s(0.5), 0.3, 1e-9);
+
+    estimator.reset();
+    EXPECT_DOUBLE_EQ(estimator.timeout_s(0.5), 0.5);
+}
+
+TEST(RttEstimator, FollowsTheLink)
+{
+    RttEstimator estimator;
+
+    // A fast and steady link goes down to the minimum.
+    for (unsigned i = 0; i < 100; ++i) {
+        estimator.add_sample(0.005);
+    }
+    EXPECT_NEAR(estimator.status().srtt_s, 0.005, 1e-6);
+    EXPECT_DOUBLE_EQ(estimator.timeout_s(0.5), RttEstimator::MIN_TIMEOUT_S);
+
+    // A slow one with a lot of jitter, such as a telemetry radio.
+    for (unsigned i = 0; i < 100; ++i) {
+        estimator.add_sample((i % 2 == 0) ? 0.4 : 0.8);
+    }
+    const double timeout_s = estimator.timeout_s(0.5);
+    EXPECT_GT(timeout_s, 0.8);
+    EXPECT_LT(timeout_s, 2.0);
+
+    // And it is never above the maximum.
+    for (unsigned i = 0; i < 100; ++i) {
+        estimator.add_sample(10.0);
+    }
+    EXPECT_DOUBLE_EQ(estimator.timeout_s(0.5), RttEstimator::MAX_TIMEOUT_S);
+    EXPECT_EQ(estimator.status().num_samples, 300u);
+}
+
+TEST(RttEstimator, BacksOff)
+{
+    EXPECT_DOUBLE_EQ(RttEstimator::backed_off_s(0.3), 0.6);
+    EXPECT_DOUBLE_EQ(RttEstimator::backed_off_s(4.0), RttEstimator::MAX_TIMEOUT_S);
+    // Timeouts asked for which are longer anyway stay as they are.
+    EXPECT_DOUBLE_EQ(RttEstimator::backed_off_s(8.0), 8.0);
+}
@@ -1,50 +1,137 @@
 #pragma once
 
-#include <queue>
+#include <chrono>
+#include <deque>
 #include <mutex>
 #include <condition_variable>
-#include <cstdio>
+#include <cstddef>
+#include <utility>
+#include <vector>
 
 namespace dronecore {
 
 /*
- * Thread-safe queue taken from:
+ * Thread-safe queue, originally taken from:
  * http://stackoverflow.com/questions/15278343/c11-thread-safe-queue#answer-16075550
+ *
+ * It can be bounded, in which case the overflow policy says what happens to an
+ * item enqueued when the queue is full.
  */
 
 template <class T>
 class SafeQueue
 {
 public:
-    SafeQueue() :
+    enum class Overflow {
+        BLOCK, // Wait until there is space again.
+        DROP_OLDEST, // Make space by dropping the item at the front.
+        REJECT // Don't enqueue the new item.
+    };
+
+    // A capacity of 0 means unbounded.
+    explicit SafeQueue(size_t capacity = 0, Overflow overflow = Overflow::BLOCK) :
         _queue(),
         _mutex(),
-        _condition_var()
+        _condition_var(),
+        _capacity(capacity),
+        _overflow(overflow)
     {}
     ~SafeQueue() {}
 
-    void enqueue(T item)
+    // Returns false if the item was rejected or the queue has been stopped.
+    bool enqueue(T item)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
-        _queue.push(item);
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_capacity > 0 && _queue.size() >= _capacity) {
+            switch (_overflow) {
+                case Overflow::BLOCK:
+                    _space_condition_var.wait(lock, [this]() {
+                        return _queue.size() < _capacity || _should_exit;
+                    });
+                    break;
+                case Overflow::DROP_OLDEST:
+                    _queue.pop_front();
+                    ++_num_dropped;
+                    break;
+                case Overflow::REJECT:
+                    ++_num_dropped;
+                    return false;
+            }
+        }
+        if (_should_exit) {
+            return false;
+        }
+        _queue.push_back(std::move(item));
         _condition_var.notify_one();
+        return true;
     }
 
+    // Returns an empty item once stopped and empty.
     T dequeue()
     {
         std::unique_lock<std::mutex> lock(_mutex);
         while (_queue.empty()) {
             if (_should_exit) {
-                return nullptr;
+                return T();
             }
             // Release lock during the wait and re-aquire it afterwards.
             _condition_var.wait(lock);
         }
-        T item = _queue.front();
-        _queue.pop();
+        T item = std::move(_queue.front());
+        _queue.pop_front();
+        _space_condition_var.notify_one();
         return item;
     }
 
+    // Like dequeue() but gives up after timeout, returns false if there was no item.
+    template<class Rep, class Period>
+    bool dequeue_for(T &item, const std::chrono::duration<Rep, Period> &timeout)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        const bool woken = _condition_var.wait_for(lock, timeout, [this]() {
+            return !_queue.empty() || _should_exit;
+        });
+        if (!woken || _queue.empty()) {
+            return false;
+        }
+        item = std::move(_queue.front());
+        _queue.pop_front();
+        _space_condition_var.notify_one();
+        return true;
+    }
+
+    // Waits for at least one item and then appends up to max_items to items,
+    // all with one lock. Returns how many there were, 0 once stopped and empty.
+    size_t dequeue_batch(std::vector<T> &items, size_t max_items)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition_var.wait(lock, [this]() { return !_queue.empty() || _should_exit; });
+
+        size_t count = 0;
+        while (!_queue.empty() && count < max_items) {
+            items.push_back(std::move(_queue.front()));
+            _queue.pop_front();
+            ++count;
+        }
+        if (count > 0) {
+            _space_condition_var.notify_all();
+        }
+        return count;
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _queue.size();
+    }
+
+    // Items dropped or rejected because the queue was full.
+    size_t num_dropped() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _num_dropped;
+    }
+
     void stop()
     {
         // This can be used if the wait needs to be interrupted, e.g.
@@ -52,12 +139,17 @@ public:
         std::lock_guard<std::mutex> lock(_mutex);
         _should_exit = true;
         _condition_var.notify_all();
+        _space_condition_var.notify_all();
     }
 
 private:
-    std::queue<T> _queue;
+    std::deque<T> _queue;
     mutable std::mutex _mutex;
     std::condition_variable _condition_var;
+    std::condition_variable _space_condition_var {};
+    const size_t _capacity;
+    const Overflow _overflow;
+    size_t _num_dropped = 0;
     bool _should_exit = false;
 };
 
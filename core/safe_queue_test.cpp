@@ -0,0 +1,91 @@
+#include "safe_queue.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace dronecore;
+
+TEST(SafeQueue, DequeuesInOrder)
+{
+    SafeQueue<int> queue;
+    EXPECT_TRUE(queue.enqueue(1));
+    EXPECT_TRUE(queue.enqueue(2));
+    EXPECT_EQ(queue.size(), 2u);
+
+    EXPECT_EQ(queue.dequeue(), 1);
+    EXPECT_EQ(queue.dequeue(), 2);
+
+    queue.stop();
+    EXPECT_EQ(queue.dequeue(), 0);
+    EXPECT_FALSE(queue.enqueue(3));
+}
+
+TEST(SafeQueue, DequeuesBatch)
+{
+    SafeQueue<std::unique_ptr<int>> queue;
+    for (int i = 0; i < 5; ++i) {
+        queue.enqueue(std::unique_ptr<int>(new int(i)));
+    }
+
+    std::vector<std::unique_ptr<int>> items;
+    EXPECT_EQ(queue.dequeue_batch(items, 3), 3u);
+    EXPECT_EQ(queue.dequeue_batch(items, 3), 2u);
+    ASSERT_EQ(items.size(), 5u);
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_EQ(*items[i], i);
+    }
+
+    queue.stop();
+    EXPECT_EQ(queue.dequeue_batch(items, 3), 0u);
+}
+
+TEST(SafeQueue, TimesOut)
+{
+    SafeQueue<int> queue;
+
+    int item = 0;
+    EXPECT_FALSE(queue.dequeue_for(item, std::chrono::milliseconds(10)));
+
+    queue.enqueue(42);
+    EXPECT_TRUE(queue.dequeue_for(item, std::chrono::milliseconds(10)));
+    EXPECT_EQ(item, 42);
+}
+
+TEST(SafeQueue, DropsOldestOrRejectsWhenFull)
+{
+    SafeQueue<int> dropping(2, SafeQueue<int>::Overflow::DROP_OLDEST);
+    EXPECT_TRUE(dropping.enqueue(1));
+    EXPECT_TRUE(dropping.enqueue(2));
+    EXPECT_TRUE(dropping.enqueue(3));
+    EXPECT_EQ(dropping.num_dropped(), 1u);
+    EXPECT_EQ(dropping.dequeue(), 2);
+    EXPECT_EQ(dropping.dequeue(), 3);
+
+    SafeQueue<int> rejecting(2, SafeQueue<int>::Overflow::REJECT);
+    EXPECT_TRUE(rejecting.enqueue(1));
+    EXPECT_TRUE(rejecting.enqueue(2));
+    EXPECT_FALSE(rejecting.enqueue(3));
+    EXPECT_EQ(rejecting.num_dropped(), 1u);
+    EXPECT_EQ(rejecting.dequeue(), 1);
+    EXPECT_EQ(rejecting.dequeue(), 2);
+}
+
+TEST(SafeQueue, BlocksWhenFull)
+{
+    SafeQueue<int> queue(1, SafeQueue<int>::Overflow::BLOCK);
+    EXPECT_TRUE(queue.enqueue(1));
+
+    std::thread producer([&queue]() {
+        EXPECT_TRUE(queue.enqueue(2));
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(queue.size(), 1u);
+
+    EXPECT_EQ(queue.dequeue(), 1);
+    EXPECT_EQ(queue.dequeue(), 2);
+    producer.join();
+    EXPECT_EQ(queue.num_dropped(), 0u);
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+namespace dronecore {
+
+// Holds a value which is read a lot more often than it is written. Readers
+// never take a lock and never hold up a writer, they copy the value and retry
+// if a write happened meanwhile. Writers are serialized among each other.
+//
+// The value is kept as atomic words so that a read racing a write is not a
+// data race, only a torn copy which then gets thrown away.
+template<typename T>
+class SeqLock
+{
+public:
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "SeqLock can only hold trivially copyable types");
+
+    explicit SeqLock(const T &value = T())
+    {
+        write(value);
+    }
+
+    T load() const
+    {
+        uint64_t words[NUM_WORDS];
+        uint32_t seq_before;
+        uint32_t seq_after;
+        do {
+            seq_before = _seq.load(std::memory_order_acquire);
+            while (seq_before & 1) {
+                // A write is going on, it only takes a few stores.
+                std::this_thread::yield();
+                seq_before = _seq.load(std::memory_order_acquire);
+            }
+
+            for (unsigned i = 0; i < NUM_WORDS; ++i) {
+                words[i] = _words[i].load(std::memory_order_relaxed);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            seq_after = _seq.load(std::memory_order_relaxed);
+        } while (seq_before != seq_after);
+
+        T value;
+        memcpy(&value, words, sizeof(value));
+        return value;
+    }
+
+    void store(const T &value)
+    {
+        std::lock_guard<std::mutex> lock(_write_mutex);
+        write(value);
+    }
+
+    // Changes part of the value, e.g. one field of a struct.
+    template<typename F>
+    void update(F modify)
+    {
+        std::lock_guard<std::mutex> lock(_write_mutex);
+        T value = load();
+        modify(value);
+        write(value);
+    }
+
+    // Non-copyable
+    SeqLock(const SeqLock &) = delete;
+    const SeqLock &operator=(const SeqLock &) = delete;
+
+private:
+    static constexpr unsigned NUM_WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    void write(const T &value)
+    {
+        // We assume that we already acquired _write_mutex in this function.
+
+        uint64_t words[NUM_WORDS] = {};
+        memcpy(words, &value, sizeof(value));
+
+        const uint32_t seq = _seq.load(std::memory_order_relaxed);
+        _seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (unsigned i = 0; i < NUM_WORDS; ++i) {
+            _words[i].store(words[i], std::memory_order_relaxed);
+        }
+
+        _seq.store(seq + 2, std::memory_order_release);
+    }
+
+    // Odd while a write is going on.
+    std::atomic<uint32_t> _seq {0};
+    std::atomic<uint64_t> _words[NUM_WORDS];
+    std::mutex _write_mutex {};
+};
+
+} // namespace dronecore
@@ -0,0 +1,78 @@
+#include "seqlock.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+
+using namespace dronecore;
+
+namespace {
+
+// Every field is the same so that a torn read is easy to spot.
+struct Sample {
+    double a;
+    double b;
+    float c;
+    uint32_t d;
+};
+
+Sample make_sample(uint32_t i)
+{
+    return Sample {double(i), double(i), float(i), i};
+}
+
+bool is_consistent(const Sample &sample)
+{
+    return sample.a == double(sample.d) &&
+           sample.b == double(sample.d) &&
+           sample.c == float(sample.d);
+}
+
+} // namespace
+
+TEST(SeqLock, LoadReturnsStored)
+{
+    SeqLock<Sample> seqlock(make_sample(3));
+    EXPECT_EQ(seqlock.load().d, 3u);
+
+    seqlock.store(make_sample(42));
+    EXPECT_EQ(seqlock.load().d, 42u);
+    EXPECT_TRUE(is_consistent(seqlock.load()));
+}
+
+TEST(SeqLock, Update)
+{
+    SeqLock<Sample> seqlock(make_sample(1));
+
+    seqlock.update([](Sample & sample) {
+        sample.c = 7.0f;
+    });
+
+    const Sample sample = seqlock.load();
+    EXPECT_EQ(sample.c, 7.0f);
+    EXPECT_EQ(sample.d, 1u);
+}
+
+TEST(SeqLock, NoTornReads)
+{
+    SeqLock<Sample> seqlock(make_sample(0));
+    std::atomic_bool should_exit {false};
+
+    std::thread writer([&seqlock, &should_exit]() {
+        uint32_t i = 0;
+        while (!should_exit) {
+            seqlock.store(make_sample(++i));
+        }
+    });
+
+    uint32_t last = 0;
+    for (unsigned i = 0; i < 100000; ++i) {
+        const Sample sample = seqlock.load();
+        EXPECT_TRUE(is_consistent(sample));
+        // Values never go backwards.
+        EXPECT_GE(sample.d, last);
+        last = sample.d;
+    }
+
+    should_exit = true;
+    writer.join();
+}
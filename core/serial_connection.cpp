@@ -1,13 +1,19 @@
 #if !defined(WINDOWS)
 #include "serial_connection.h"
 #include "global_include.h"
+#include "io_reactor.h"
 #include "log.h"
+#include "thread_roles.h"
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
 
 #ifdef LINUX
 #include <asm/termbits.h>
+#include <linux/serial.h>
 #include <sys/ioctl.h>
 #endif
 
@@ -24,10 +30,15 @@
 
 namespace dronecore {
 
-SerialConnection::SerialConnection(DroneCoreImpl &parent, const std::string &path, int baudrate):
+constexpr unsigned SerialConnection::MIN_READ_BUFFER_SIZE;
+constexpr unsigned SerialConnection::MAX_CC;
+
+SerialConnection::SerialConnection(DroneCoreImpl &parent, const std::string &path, int baudrate,
+                                   const DroneCore::SerialConfig &config):
     Connection(parent),
     _serial_node(path),
-    _baudrate(baudrate)
+    _baudrate(baudrate),
+    _config(config)
 {
     if (baudrate == 0) {
         _baudrate = DEFAULT_SERIAL_BAUDRATE;
@@ -35,6 +46,9 @@ SerialConnection::SerialConnection(DroneCoreImpl &parent, const std::string &pat
     if (path == "") {
         _serial_node = DEFAULT_SERIAL_DEV_PATH;
     }
+    _config.read_min_bytes = std::min(std::max(_config.read_min_bytes, 1u), MAX_CC);
+    _config.read_timeout_ds = std::min(_config.read_timeout_ds, MAX_CC);
+    _config.read_buffer_size = std::max(_config.read_buffer_size, MIN_READ_BUFFER_SIZE);
 }
 
 SerialConnection::~SerialConnection()
@@ -51,42 +65,40 @@ bool SerialConnection::is_ok() const
 
 ConnectionResult SerialConnection::start()
 {
-    if (!start_mavlink_receiver()) {
-        return ConnectionResult::CONNECTIONS_EXHAUSTED;
-    }
+    start_mavlink_receiver();
 
     ConnectionResult ret = setup_port();
     if (ret != ConnectionResult::SUCCESS) {
         return ret;
     }
 
-    start_recv_thread();
+    // A pipe is used to wake up the I/O thread for new frames and on stop.
+    if (pipe(_wake_up_fds) != 0) {
+        LogErr() << "Could not create serial pipe: " << GET_ERROR(errno);
+        close(_fd);
+        _fd = -1;
+        return ConnectionResult::CONNECTION_ERROR;
+    }
+    fcntl(_wake_up_fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(_wake_up_fds[1], F_SETFL, O_NONBLOCK);
+
+    _read_buffer.resize(_config.read_buffer_size);
+    _read_len = 0;
+    _should_exit = false;
+    _io_thread = new std::thread(run, this);
 
     return ConnectionResult::SUCCESS;
 }
 
 ConnectionResult SerialConnection::setup_port()
 {
-#if defined(LINUX)
-    _fd = open(_serial_node.c_str(), O_RDWR | O_NOCTTY);
-    if (_fd == -1) {
-        LogErr() << "open failed: " << GET_ERROR(errno);
-        return ConnectionResult::CONNECTION_ERROR;
-    }
-#elif defined(APPLE)
-    // open() hangs on macOS unless you give it O_NONBLOCK
+    // The port stays non-blocking, reads and writes wait in poll() instead.
+    // Without O_NONBLOCK, open() also hangs on macOS.
     _fd = open(_serial_node.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
     if (_fd == -1) {
         LogErr() << "open failed: " << GET_ERROR(errno);
         return ConnectionResult::CONNECTION_ERROR;
     }
-    // We need to clear the O_NONBLOCK again because we can block while reading
-    // as we do it in a separate thread.
-    if (fcntl(_fd, F_SETFL, 0) == -1) {
-        LogErr() << "fcntl failed: " << GET_ERROR(errno);
-        return ConnectionResult::CONNECTION_ERROR;
-    }
-#endif
 
 #if defined(LINUX)
     struct termios2 tc;
@@ -114,13 +126,18 @@ ConnectionResult SerialConnection::setup_port()
     tc.c_cflag &= ~(CSIZE | PARENB | CRTSCTS);
     tc.c_cflag |= CS8;
 
-    tc.c_cc[VMIN] = 1; // We want at least 1 byte to be available.
-    tc.c_cc[VTIME] = 0; // We don't timeout but wait indefinitely.
+    // As the port is non-blocking, read() does not wait for these, but without
+    // a timeout poll() only wakes up once VMIN bytes are there. The timeout is
+    // kept by the I/O thread, see read_timeout_ms().
+    tc.c_cc[VMIN] = cc_t(_config.read_min_bytes);
+    tc.c_cc[VTIME] = cc_t(_config.read_timeout_ds);
 
 #if defined(LINUX)
     // CBAUD and BOTHER don't seem to be available for macOS with termios.
     tc.c_cflag &= ~(CBAUD);
     tc.c_cflag |= BOTHER;
+    tc.c_ispeed = speed_t(_baudrate);
+    tc.c_ospeed = speed_t(_baudrate);
 
     if (ioctl(_fd, TCSETS2, &tc) == -1) {
         LogErr() << "Could not set terminal attributes " << GET_ERROR(errno);
@@ -134,6 +151,10 @@ ConnectionResult SerialConnection::setup_port()
         close(_fd);
         return ConnectionResult::CONNECTION_ERROR;
     }
+
+    if (_config.low_latency) {
+        set_low_latency();
+    }
 #elif defined(APPLE)
     tc.c_cflag |= CLOCAL; // Without this a write() blocks indefinitely.
 
@@ -150,32 +171,82 @@ ConnectionResult SerialConnection::setup_port()
     return ConnectionResult::SUCCESS;
 }
 
-void SerialConnection::start_recv_thread()
+void SerialConnection::set_low_latency()
 {
-    _recv_thread = new std::thread(receive, this);
+#if defined(LINUX)
+    // E.g. FTDI adapters otherwise hold back received bytes for up to 16 ms.
+    // Not all drivers support it, so this is best effort.
+    struct serial_struct serial;
+    bzero(&serial, sizeof(serial));
+
+    if (ioctl(_fd, TIOCGSERIAL, &serial) == -1) {
+        LogDebug() << "Could not get serial flags " << GET_ERROR(errno);
+        return;
+    }
+
+    serial.flags |= ASYNC_LOW_LATENCY;
+
+    if (ioctl(_fd, TIOCSSERIAL, &serial) == -1) {
+        LogDebug() << "Could not set low latency " << GET_ERROR(errno);
+    }
+#endif
+}
+
+void SerialConnection::request_stop()
+{
+    _should_exit = true;
+
+    if (_io_thread) {
+        wake_up();
+    }
 }
 
 ConnectionResult SerialConnection::stop()
 {
     _should_exit = true;
-    //TODO for windows
-    close(_fd);
 
-    if (_recv_thread) {
-        _recv_thread->join();
-        delete _recv_thread;
-        _recv_thread = nullptr;
+    // Its frames are written to the port, which is closed below.
+    stop_outgoing_scheduler();
+
+    if (_io_thread) {
+        wake_up();
+        _io_thread->join();
+        delete _io_thread;
+        _io_thread = nullptr;
     }
 
-    // We need to stop this after stopping the receive thread, otherwise
+    {
+        // Once the port is closed, send_frame() does not touch the pipe either.
+        std::lock_guard<std::mutex> lock(_write_mutex);
+        //TODO for windows
+        if (_fd >= 0) {
+            close(_fd);
+            _fd = -1;
+        }
+        _write_queue.clear();
+        _write_offset = 0;
+        _write_queue_full = false;
+    }
+
+    if (_wake_up_fds[0] >= 0) {
+        close(_wake_up_fds[0]);
+        close(_wake_up_fds[1]);
+        _wake_up_fds[0] = -1;
+        _wake_up_fds[1] = -1;
+    }
+
+    // We need to stop this after stopping the I/O thread, otherwise
     // it can happen that we interfere with the parsing of a message.
     stop_mavlink_receiver();
 
     return ConnectionResult::SUCCESS;
 }
 
-bool SerialConnection::send_message(const mavlink_message_t &message)
+bool SerialConnection::send_frame(const uint8_t *frame, unsigned frame_len,
+                                  uint8_t target_system)
 {
+    UNUSED(target_system);
+
     if (_serial_node.empty()) {
         LogErr() << "Dev Path unknown";
         return false;
@@ -186,38 +257,204 @@ bool SerialConnection::send_message(const mavlink_message_t &message)
         return false;
     }
 
-    uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
-    uint16_t buffer_len = mavlink_msg_to_send_buffer(buffer, &message);
+    std::lock_guard<std::mutex> lock(_write_mutex);
 
-    int send_len =  write(_fd, buffer, buffer_len);
+    if (_fd < 0) {
+        return false;
+    }
+
+    unsigned num_written = 0;
+    const size_t num_queued = _write_queue.size() - _write_offset;
+
+    if (num_queued == 0) {
+        // Nothing is waiting, so what the driver takes can go out right away.
+        const ssize_t send_len = write(_fd, frame, frame_len);
+        if (send_len > 0) {
+            num_written = unsigned(send_len);
+        } else if (send_len == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            LogErr() << "write failure: " << GET_ERROR(errno);
+            return false;
+        }
+        if (num_written == frame_len) {
+            return true;
+        }
+    }
 
-    if (send_len != buffer_len) {
-        LogErr() << "write failure: " << GET_ERROR(errno);
+    // The rest of a frame which is partly written has to follow, whatever is queued.
+    if (num_written == 0 && num_queued + frame_len > _config.write_queue_size) {
+        if (!_write_queue_full) {
+            LogWarn() << "Serial write queue full, dropping messages";
+            _write_queue_full = true;
+        }
         return false;
     }
 
+    _write_queue.insert(_write_queue.end(), frame + num_written, frame + frame_len);
+    if (num_queued == 0) {
+        wake_up();
+    }
     return true;
 }
 
-void SerialConnection::receive(SerialConnection *parent)
+void SerialConnection::run(SerialConnection *parent)
 {
-    // Enough for MTU 1500 bytes.
-    char buffer[2048];
+    ThreadRoles::apply_to_this_thread(DroneCore::ThreadRole::RECEIVE, "serial_io");
 
     while (!parent->_should_exit) {
-        int recv_len = read(parent->_fd, buffer, sizeof(buffer));
-        if (recv_len < -1) {
-            LogErr() << "read failure: " << GET_ERROR(errno);
+        parent->run_once();
+    }
+}
+
+void SerialConnection::run_once()
+{
+    bool has_queued;
+    {
+        std::lock_guard<std::mutex> lock(_write_mutex);
+        has_queued = _write_offset < _write_queue.size();
+    }
+
+    struct pollfd fds[2];
+    fds[0].fd = _fd;
+    fds[0].events = POLLIN;
+    if (has_queued) {
+        fds[0].events |= POLLOUT;
+    }
+    fds[0].revents = 0;
+    fds[1].fd = _wake_up_fds[0];
+    fds[1].events = POLLIN;
+    fds[1].revents = 0;
+
+    const int ret = poll(fds, 2, read_timeout_ms());
+    if (ret == -1) {
+        if (errno != EINTR) {
+            LogErr() << "poll failure: " << GET_ERROR(errno);
+            _should_exit = true;
+        }
+        return;
+    }
+
+    if (fds[1].revents & POLLIN) {
+        drain_wake_up();
+    }
+
+    if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+        // E.g. the adapter was unplugged, there is nothing to wait for anymore.
+        LogErr() << "Serial port " << _serial_node << " failed";
+        _should_exit = true;
+        return;
+    }
+
+    if (fds[0].revents & POLLIN) {
+        read_available();
+    }
+
+    if (fds[0].revents & POLLOUT) {
+        write_queued();
+    }
+
+    if (_read_len > 0 && read_timeout_ms() == 0) {
+        parse_read();
+    }
+}
+
+void SerialConnection::read_available()
+{
+    while (_read_len < _read_buffer.size()) {
+        const size_t num_free = _read_buffer.size() - _read_len;
+        const ssize_t recv_len = read(_fd, &_read_buffer[_read_len], num_free);
+        if (recv_len == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                LogErr() << "read failure: " << GET_ERROR(errno);
+            }
+            return;
         }
-        if (recv_len > static_cast<int>(sizeof(buffer)) || recv_len == 0) {
-            continue;
+        if (recv_len <= 0) {
+            return;
         }
-        parent->_mavlink_receiver->set_new_datagram(buffer, recv_len);
-        // Parse all mavlink messages in one data packet. Once exhausted, we'll exit while.
-        while (parent->_mavlink_receiver->parse_message()) {
-            parent->receive_message(parent->_mavlink_receiver->get_last_message());
+        _read_len += unsigned(recv_len);
+        _last_read_time = clock::now();
+        // Less than asked for means that the driver has nothing more for now,
+        // asking again would only cost another syscall.
+        if (size_t(recv_len) < num_free) {
+            return;
         }
     }
 }
+
+int SerialConnection::read_timeout_ms() const
+{
+    if (_read_len == 0) {
+        return -1;
+    }
+    if (_read_len >= _config.read_min_bytes || _read_len >= _read_buffer.size()) {
+        return 0;
+    }
+    if (_config.read_timeout_ds == 0) {
+        return -1;
+    }
+
+    const auto timeout = std::chrono::milliseconds(_config.read_timeout_ds * 100);
+    const auto since_read = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                clock::now() - _last_read_time);
+    return since_read >= timeout ? 0 : int((timeout - since_read).count());
+}
+
+void SerialConnection::parse_read()
+{
+    _mavlink_receiver->set_new_datagram(&_read_buffer[0], _read_len);
+    _read_len = 0;
+    TimeBatch time_batch;
+    // Parse all mavlink messages in one data packet. Once exhausted, we'll exit while.
+    while (_mavlink_receiver->parse_message()) {
+        receive_message(_mavlink_receiver->get_last_message_view());
+    }
+}
+
+void SerialConnection::write_queued()
+{
+    std::lock_guard<std::mutex> lock(_write_mutex);
+
+    const size_t num_queued = _write_queue.size() - _write_offset;
+    if (num_queued == 0) {
+        return;
+    }
+
+    const ssize_t send_len = write(_fd, &_write_queue[_write_offset], num_queued);
+    if (send_len == -1) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            LogErr() << "write failure: " << GET_ERROR(errno);
+            _write_queue.clear();
+            _write_offset = 0;
+        }
+        return;
+    }
+
+    _write_offset += size_t(send_len);
+    if (_write_offset == _write_queue.size()) {
+        _write_queue.clear();
+        _write_offset = 0;
+        _write_queue_full = false;
+    } else if (_write_offset >= _write_queue.size() / 2) {
+        // Moving the rest to the front only now keeps the copying linear.
+        _write_queue.erase(_write_queue.begin(),
+                           _write_queue.begin() + std::ptrdiff_t(_write_offset));
+        _write_offset = 0;
+    }
+}
+
+void SerialConnection::wake_up()
+{
+    // If the pipe is full, the thread is going to wake up anyway.
+    const char dummy = 0;
+    if (write(_wake_up_fds[1], &dummy, 1) != 1 && errno != EAGAIN) {
+        LogWarn() << "Could not wake up serial thread";
+    }
+}
+
+void SerialConnection::drain_wake_up()
+{
+    char dummy[16];
+    while (read(_wake_up_fds[0], dummy, sizeof(dummy)) > 0) {}
+}
 } // namespace dronecore
 #endif
@@ -3,41 +3,77 @@
 
 #include <mutex>
 #include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
 #include "connection.h"
 
 namespace dronecore {
 
+// The port is non-blocking and served by a thread of its own, which waits
+// with poll() until it is readable, or writable while something is queued.
+// Frames are written right away as far as the driver takes them, the rest is
+// queued and written by the thread, so send_frame() never waits for the UART.
 class SerialConnection : public Connection
 {
 public:
     explicit SerialConnection(DroneCoreImpl &parent,
                               const std::string &path,
-                              int baudrate);
+                              int baudrate,
+                              const DroneCore::SerialConfig &config = DroneCore::SerialConfig());
     bool is_ok() const;
     ConnectionResult start();
     ConnectionResult stop();
+    void request_stop() override;
     ~SerialConnection();
 
-    bool send_message(const mavlink_message_t &message);
+    // Returns false if the write queue is full, the frame is dropped then.
+    bool send_frame(const uint8_t *frame, unsigned frame_len, uint8_t target_system) override;
 
     // Non-copyable
     SerialConnection(const SerialConnection &) = delete;
     const SerialConnection &operator=(const SerialConnection &) = delete;
 
 private:
+    typedef std::chrono::steady_clock clock;
+
     ConnectionResult setup_port();
-    void start_recv_thread();
-    static void receive(SerialConnection *parent);
+    void set_low_latency();
+    static void run(SerialConnection *parent);
+    void run_once();
+    void read_available();
+    void parse_read();
+    // How long poll() may wait for the bytes read so far to be parsed, -1 for ever.
+    int read_timeout_ms() const;
+    void write_queued();
+    void wake_up();
+    void drain_wake_up();
 
     static constexpr int DEFAULT_SERIAL_BAUDRATE = 9600;
     static constexpr auto DEFAULT_SERIAL_DEV_PATH = "/dev/ttyS0";
+    // Enough for MTU 1500 bytes.
+    static constexpr unsigned MIN_READ_BUFFER_SIZE = 2048;
+    // The most VMIN and VTIME take.
+    static constexpr unsigned MAX_CC = 255;
     std::string _serial_node = {};
     int _baudrate = DEFAULT_SERIAL_BAUDRATE;
+    DroneCore::SerialConfig _config {};
 
-    std::mutex _mutex = {};
     int _fd = -1;
-    std::thread *_recv_thread = nullptr;
+    int _wake_up_fds[2] = {-1, -1};
+    std::thread *_io_thread = nullptr;
     std::atomic_bool _should_exit{false};
+
+    // Only used by the I/O thread.
+    std::vector<char> _read_buffer {};
+    unsigned _read_len = 0;
+    clock::time_point _last_read_time {};
+
+    std::mutex _write_mutex {};
+    // Bytes before _write_offset are written already.
+    std::vector<uint8_t> _write_queue {};
+    size_t _write_offset = 0;
+    bool _write_queue_full = false;
 };
 
 } // namespace dronecore
@@ -0,0 +1,178 @@
+#include "shm_connection.h"
+
+#if defined(SHM_CONNECTION_SUPPORTED)
+
+#include "global_include.h"
+#include "log.h"
+#include "thread_roles.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define GET_ERROR(_x) strerror(_x)
+
+namespace dronecore {
+
+constexpr int ShmConnection::RECEIVE_TIMEOUT_MS;
+
+ShmConnection::ShmConnection(DroneCoreImpl &parent, const std::string &name) :
+    Connection(parent),
+    _path(name.empty() || name[0] != '/' ? "/" + name : name)
+{}
+
+ShmConnection::~ShmConnection()
+{
+    // If no one explicitly called stop before, we should at least do it.
+    stop();
+}
+
+bool ShmConnection::is_ok() const
+{
+    return _segment != nullptr;
+}
+
+ConnectionResult ShmConnection::start()
+{
+    start_mavlink_receiver();
+
+    ConnectionResult ret = setup_segment();
+    if (ret != ConnectionResult::SUCCESS) {
+        return ret;
+    }
+
+    _send_ring.reset(new ShmRing(_segment->to_vehicle));
+    _receive_ring.reset(new ShmRing(_segment->to_ground));
+
+    _should_exit = false;
+    _recv_thread = new std::thread(receive, this);
+
+    return ConnectionResult::SUCCESS;
+}
+
+ConnectionResult ShmConnection::setup_segment()
+{
+    _fd = shm_open(_path.c_str(), O_RDWR | O_CREAT, 0660);
+    if (_fd == -1) {
+        LogErr() << "shm_open " << _path << " failed: " << GET_ERROR(errno);
+        return ConnectionResult::CONNECTION_ERROR;
+    }
+
+    // Whichever side is first sizes it, the zeros are empty rings.
+    struct stat st;
+    if (fstat(_fd, &st) == -1 ||
+        (size_t(st.st_size) < sizeof(ShmSegment) && ftruncate(_fd, sizeof(ShmSegment)) == -1)) {
+        LogErr() << "Could not size shared memory " << _path << ": " << GET_ERROR(errno);
+        close(_fd);
+        _fd = -1;
+        return ConnectionResult::CONNECTION_ERROR;
+    }
+
+    void *memory = mmap(nullptr, sizeof(ShmSegment), PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (memory == MAP_FAILED) {
+        LogErr() << "mmap " << _path << " failed: " << GET_ERROR(errno);
+        close(_fd);
+        _fd = -1;
+        return ConnectionResult::CONNECTION_ERROR;
+    }
+    ShmSegment *segment = static_cast<ShmSegment *>(memory);
+
+    uint32_t magic = 0;
+    if (!segment->magic.compare_exchange_strong(magic, ShmSegment::MAGIC) &&
+        magic != ShmSegment::MAGIC) {
+        LogErr() << "Shared memory " << _path << " has an unknown layout";
+        munmap(memory, sizeof(ShmSegment));
+        close(_fd);
+        _fd = -1;
+        return ConnectionResult::CONNECTION_ERROR;
+    }
+
+    _segment = segment;
+    return ConnectionResult::SUCCESS;
+}
+
+void ShmConnection::request_stop()
+{
+    _should_exit = true;
+
+    if (_recv_thread) {
+        _receive_ring->wake_up();
+    }
+}
+
+ConnectionResult ShmConnection::stop()
+{
+    _should_exit = true;
+
+    stop_outgoing_scheduler();
+
+    if (_recv_thread) {
+        _receive_ring->wake_up();
+        _recv_thread->join();
+        delete _recv_thread;
+        _recv_thread = nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_send_mutex);
+        _send_ring.reset();
+        _receive_ring.reset();
+
+        if (_segment != nullptr) {
+            munmap(_segment, sizeof(ShmSegment));
+            _segment = nullptr;
+        }
+        if (_fd >= 0) {
+            close(_fd);
+            _fd = -1;
+        }
+    }
+
+    // We need to stop this after stopping the receive thread, otherwise
+    // it can happen that we interfere with the parsing of a message.
+    stop_mavlink_receiver();
+
+    return ConnectionResult::SUCCESS;
+}
+
+bool ShmConnection::send_frame(const uint8_t *frame, unsigned frame_len, uint8_t target_system)
+{
+    UNUSED(target_system);
+
+    std::lock_guard<std::mutex> lock(_send_mutex);
+
+    if (!_send_ring) {
+        return false;
+    }
+
+    return _send_ring->write(frame, frame_len);
+}
+
+void ShmConnection::receive(ShmConnection *parent)
+{
+    ThreadRoles::apply_to_this_thread(DroneCore::ThreadRole::RECEIVE, "shm_receive");
+
+    // Enough for many frames at once, the rest is read in the next round.
+    uint8_t buffer[4096];
+
+    while (!parent->_should_exit) {
+        if (!parent->_receive_ring->wait(RECEIVE_TIMEOUT_MS)) {
+            continue;
+        }
+
+        const uint32_t recv_len = parent->_receive_ring->read(buffer, sizeof(buffer));
+
+        parent->_mavlink_receiver->set_new_datagram(reinterpret_cast<char *>(buffer), recv_len);
+        TimeBatch time_batch;
+        // Parse all mavlink messages in one data packet. Once exhausted, we'll exit while.
+        while (parent->_mavlink_receiver->parse_message()) {
+            parent->receive_message(parent->_mavlink_receiver->get_last_message_view());
+        }
+    }
+}
+
+} // namespace dronecore
+
+#endif
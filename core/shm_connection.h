@@ -0,0 +1,64 @@
+#pragma once
+
+// There is no POSIX shared memory on Android.
+#if defined(LINUX) && !defined(__ANDROID__)
+#define SHM_CONNECTION_SUPPORTED
+#endif
+
+#if defined(SHM_CONNECTION_SUPPORTED)
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "connection.h"
+#include "shm_ring.h"
+
+namespace dronecore {
+
+// Exchanges frames with a process on the same machine, e.g. a simulator or a
+// MAVLink bridge, through a pair of rings in POSIX shared memory named
+// "/<name>", see ShmSegment for the layout. Whichever side is first creates
+// it, and it is left in place on stop for the other side to keep using.
+class ShmConnection : public Connection
+{
+public:
+    explicit ShmConnection(DroneCoreImpl &parent, const std::string &name);
+    ~ShmConnection();
+    bool is_ok() const;
+    ConnectionResult start();
+    ConnectionResult stop();
+    void request_stop() override;
+
+    // Returns false if the other side does not keep up and the ring is full.
+    bool send_frame(const uint8_t *frame, unsigned frame_len, uint8_t target_system) override;
+
+    // Non-copyable
+    ShmConnection(const ShmConnection &) = delete;
+    const ShmConnection &operator=(const ShmConnection &) = delete;
+
+private:
+    ConnectionResult setup_segment();
+    static void receive(ShmConnection *parent);
+
+    // Short enough for stop() not to wait long if the wake up was missed.
+    static constexpr int RECEIVE_TIMEOUT_MS = 100;
+
+    std::string _path {};
+
+    int _fd = -1;
+    ShmSegment *_segment = nullptr;
+
+    // The ring only takes one writer at a time.
+    std::mutex _send_mutex {};
+    std::unique_ptr<ShmRing> _send_ring {};
+    std::unique_ptr<ShmRing> _receive_ring {};
+
+    std::thread *_recv_thread = nullptr;
+    std::atomic_bool _should_exit {false};
+};
+
+} // namespace dronecore
+
+#endif
@@ -0,0 +1,115 @@
+#include "shm_ring.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#if defined(LINUX)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace dronecore {
+
+constexpr uint32_t ShmRing::CAPACITY;
+constexpr uint32_t ShmSegment::MAGIC;
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "The futex needs to be a plain 32 bit word");
+
+ShmRing::ShmRing(Shared &shared) :
+    _shared(shared),
+    _cached_head(shared.head.load(std::memory_order_acquire))
+{}
+
+ShmRing::~ShmRing() {}
+
+bool ShmRing::write(const uint8_t *data, uint32_t data_len)
+{
+    const uint32_t tail = _shared.tail.load(std::memory_order_relaxed);
+
+    if (CAPACITY - (tail - _cached_head) < data_len) {
+        // Looks full, but the reader could have made space meanwhile.
+        _cached_head = _shared.head.load(std::memory_order_acquire);
+        if (CAPACITY - (tail - _cached_head) < data_len) {
+            return false;
+        }
+    }
+
+    const uint32_t offset = tail % CAPACITY;
+    const uint32_t first_len = std::min(data_len, CAPACITY - offset);
+    memcpy(&_shared.data[offset], data, first_len);
+    memcpy(&_shared.data[0], data + first_len, data_len - first_len);
+
+    _shared.tail.store(tail + data_len, std::memory_order_release);
+
+    // Pairs with the fence in wait(), either the reader sees the new tail or
+    // we see that it is waiting.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_shared.reader_waiting.load(std::memory_order_relaxed) != 0) {
+        wake_up();
+    }
+    return true;
+}
+
+uint32_t ShmRing::read(uint8_t *buffer, uint32_t buffer_len)
+{
+    const uint32_t head = _shared.head.load(std::memory_order_relaxed);
+    const uint32_t tail = _shared.tail.load(std::memory_order_acquire);
+
+    const uint32_t read_len = std::min(tail - head, buffer_len);
+    const uint32_t offset = head % CAPACITY;
+    const uint32_t first_len = std::min(read_len, CAPACITY - offset);
+    memcpy(buffer, &_shared.data[offset], first_len);
+    memcpy(buffer + first_len, &_shared.data[0], read_len - first_len);
+
+    _shared.head.store(head + read_len, std::memory_order_release);
+    return read_len;
+}
+
+bool ShmRing::wait(int timeout_ms)
+{
+    if (!is_empty()) {
+        return true;
+    }
+
+    _shared.reader_waiting.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (is_empty()) {
+#if defined(LINUX)
+        timespec timeout;
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_nsec = long(timeout_ms % 1000) * 1000000;
+        // Returns right away if the writer has cleared the flag already. The
+        // futex is not private as the writer may be another process.
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&_shared.reader_waiting),
+                FUTEX_WAIT, 1, &timeout, nullptr, 0);
+#else
+        // Without a futex, this is polling, which is good enough to fall back.
+        std::this_thread::sleep_for(std::chrono::milliseconds(std::min(timeout_ms, 1)));
+#endif
+    }
+
+    _shared.reader_waiting.store(0, std::memory_order_relaxed);
+    return !is_empty();
+}
+
+void ShmRing::wake_up()
+{
+    _shared.reader_waiting.store(0, std::memory_order_relaxed);
+#if defined(LINUX)
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&_shared.reader_waiting),
+            FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#endif
+}
+
+bool ShmRing::is_empty() const
+{
+    return _shared.tail.load(std::memory_order_acquire) ==
+           _shared.head.load(std::memory_order_relaxed);
+}
+
+} // namespace dronecore
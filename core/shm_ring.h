@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace dronecore {
+
+// Ring of bytes for one writer and one reader, which can be in different
+// processes mapping the same memory. The MAVLink frames in it are parsed as
+// a stream, just like from a serial port. A write which does not fit fails
+// as a whole, so that frames are never cut off.
+//
+// The reader waits on a futex, which the writer only wakes up while the
+// reader is actually waiting, so that a busy ring costs no syscalls.
+class ShmRing
+{
+public:
+    static constexpr uint32_t CAPACITY = 1 << 16;
+
+    // What both processes map. All zeros is an empty ring, so this is valid
+    // as created by ftruncate(). The indices are free running, the writer
+    // and the reader each write their own cache line.
+    struct Shared {
+        char padding_head[64];
+        // Up to where the reader has read.
+        std::atomic<uint32_t> head;
+        char padding_tail[64 - sizeof(std::atomic<uint32_t>)];
+        // Up to where the writer has written.
+        std::atomic<uint32_t> tail;
+        char padding_waiting[64 - sizeof(std::atomic<uint32_t>)];
+        // 1 while the reader is waiting on it.
+        std::atomic<uint32_t> reader_waiting;
+        char padding_data[64 - sizeof(std::atomic<uint32_t>)];
+        uint8_t data[CAPACITY];
+    };
+
+    explicit ShmRing(Shared &shared);
+    ~ShmRing();
+
+    // Only to be called by the writer. Returns false if there is not enough
+    // space, nothing is written then.
+    bool write(const uint8_t *data, uint32_t data_len);
+
+    // Only to be called by the reader. Returns how many bytes were read.
+    uint32_t read(uint8_t *buffer, uint32_t buffer_len);
+
+    // Only to be called by the reader. Returns true once there is something
+    // to read, false after timeout_ms or wake_up().
+    bool wait(int timeout_ms);
+
+    // E.g. to stop a reader which is waiting.
+    void wake_up();
+
+    // Non-copyable
+    ShmRing(const ShmRing &) = delete;
+    const ShmRing &operator=(const ShmRing &) = delete;
+
+private:
+    bool is_empty() const;
+
+    Shared &_shared;
+    // Only used by the writer, to not read the head index on every write.
+    uint32_t _cached_head = 0;
+};
+
+// The shared memory of a connection, as DroneCore creates or opens it. The
+// other end, e.g. a simulator or MAVLink bridge, maps the same layout.
+struct ShmSegment {
+    // "DCS1", as set by whichever side is first.
+    static constexpr uint32_t MAGIC = 0x31534344;
+
+    std::atomic<uint32_t> magic;
+    char padding[64 - sizeof(std::atomic<uint32_t>)];
+    // Written by DroneCore.
+    ShmRing::Shared to_vehicle;
+    // Written by the other end.
+    ShmRing::Shared to_ground;
+};
+
+} // namespace dronecore
@@ -0,0 +1,75 @@
+#include "shm_ring.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace dronecore;
+
+TEST(ShmRing, WritesAndReadsAcrossTheEnd)
+{
+    std::unique_ptr<ShmRing::Shared> shared(new ShmRing::Shared());
+    ShmRing writer(*shared);
+    ShmRing reader(*shared);
+
+    std::vector<uint8_t> data(1000);
+    std::vector<uint8_t> buffer(1000);
+    // Enough rounds to go around several times, at an odd offset.
+    for (unsigned round = 0; round < 3 * ShmRing::CAPACITY / 1000; ++round) {
+        for (unsigned i = 0; i < data.size(); ++i) {
+            data[i] = uint8_t(round + i);
+        }
+        EXPECT_TRUE(writer.write(data.data(), uint32_t(data.size())));
+        EXPECT_EQ(reader.read(buffer.data(), uint32_t(buffer.size())), 1000u);
+        EXPECT_EQ(buffer, data);
+    }
+    EXPECT_EQ(reader.read(buffer.data(), uint32_t(buffer.size())), 0u);
+}
+
+TEST(ShmRing, RefusesWhatDoesNotFit)
+{
+    std::unique_ptr<ShmRing::Shared> shared(new ShmRing::Shared());
+    ShmRing writer(*shared);
+    ShmRing reader(*shared);
+
+    std::vector<uint8_t> data(ShmRing::CAPACITY - 10);
+    EXPECT_TRUE(writer.write(data.data(), uint32_t(data.size())));
+    EXPECT_FALSE(writer.write(data.data(), 11));
+    EXPECT_TRUE(writer.write(data.data(), 10));
+
+    std::vector<uint8_t> buffer(100);
+    EXPECT_EQ(reader.read(buffer.data(), uint32_t(buffer.size())), 100u);
+    // The writer notices the space only once it runs out of what it knew.
+    EXPECT_TRUE(writer.write(data.data(), 100));
+    EXPECT_FALSE(writer.write(data.data(), 1));
+}
+
+TEST(ShmRing, WakesUpWaitingReader)
+{
+    std::unique_ptr<ShmRing::Shared> shared(new ShmRing::Shared());
+    ShmRing writer(*shared);
+    ShmRing reader(*shared);
+
+    // Nothing there, it times out.
+    EXPECT_FALSE(reader.wait(10));
+
+    std::atomic<bool> has_data {false};
+    std::thread reader_thread([&reader, &has_data]() {
+        has_data = reader.wait(5000);
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const auto write_time = std::chrono::steady_clock::now();
+    const uint8_t byte = 42;
+    EXPECT_TRUE(writer.write(&byte, 1));
+    reader_thread.join();
+
+    EXPECT_TRUE(has_data);
+    EXPECT_LT(std::chrono::steady_clock::now() - write_time, std::chrono::seconds(1));
+
+    uint8_t buffer = 0;
+    EXPECT_EQ(reader.read(&buffer, 1), 1u);
+    EXPECT_EQ(buffer, 42);
+}
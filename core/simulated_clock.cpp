@@ -0,0 +1,50 @@
+#include "simulated_clock.h"
+#include "timer_scheduler.h"
+
+namespace dronecore {
+
+std::atomic<bool> SimulatedClock::_is_enabled {false};
+std::atomic<int64_t> SimulatedClock::_now_ns {0};
+
+void SimulatedClock::set_enabled(bool enabled)
+{
+    if (enabled == _is_enabled) {
+        return;
+    }
+
+    const dl_time_t steady_now = std::chrono::steady_clock::now();
+    if (enabled) {
+        _now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      steady_now.time_since_epoch()).count();
+        _is_enabled = true;
+        TimerScheduler::Instance().switch_clock(steady_now, steady_now);
+    } else {
+        // The steady clock is behind by however far the simulation went.
+        _is_enabled = false;
+        TimerScheduler::Instance().switch_clock(now(), steady_now);
+    }
+}
+
+dl_time_t SimulatedClock::now()
+{
+    return dl_time_t(std::chrono::duration_cast<dl_time_t::duration>(
+                         std::chrono::nanoseconds(_now_ns.load())));
+}
+
+uint64_t SimulatedClock::advance(double duration_s)
+{
+    const dl_time_t until = now() + std::chrono::duration_cast<dl_time_t::duration>(
+                                std::chrono::duration<double>(duration_s));
+    return TimerScheduler::Instance().run_until(until);
+}
+
+void SimulatedClock::move_to(dl_time_t time)
+{
+    const int64_t time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                time.time_since_epoch()).count();
+    if (time_ns > _now_ns) {
+        _now_ns = time_ns;
+    }
+}
+
+} // namespace dronecore
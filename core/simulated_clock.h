@@ -0,0 +1,39 @@
+#pragma once
+
+#include "global_include.h"
+#include <atomic>
+#include <cstdint>
+
+namespace dronecore {
+
+// Process-wide virtual clock for simulations, see DroneCore::enable_simulated_time().
+//
+// While it is enabled, Time and the TimerScheduler use it instead of the steady
+// clock. It only moves on in advance(), which jumps from one timer deadline to
+// the next and runs the timers on the calling thread, in the order of their
+// deadlines. All scheduling of DroneCore is done by timers, so a scenario runs
+// the same way every time, and as fast as the timers run.
+class SimulatedClock
+{
+public:
+    // Needs to be enabled before anything is scheduled. It starts at the time of
+    // the steady clock then. Timers still pending when it is disabled again keep
+    // the time they had left.
+    static void set_enabled(bool enabled);
+    static bool is_enabled() { return _is_enabled.load(std::memory_order_relaxed); }
+
+    static dl_time_t now();
+
+    // Runs everything due within the duration, returns the number of timers run.
+    static uint64_t advance(double duration_s);
+
+private:
+    friend class TimerScheduler;
+    // Only moves forward.
+    static void move_to(dl_time_t time);
+
+    static std::atomic<bool> _is_enabled;
+    static std::atomic<int64_t> _now_ns;
+};
+
+} // namespace dronecore
@@ -0,0 +1,76 @@
+#include "simulated_clock.h"
+#include "dronecore_impl.h"
+#include "timer_scheduler.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+using namespace dronecore;
+
+TEST(SimulatedClock, OnlyMovesOnWhenAdvanced)
+{
+    SimulatedClock::set_enabled(true);
+    Time time;
+
+    const dl_time_t start = time.steady_time();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(time.steady_time(), start);
+
+    SimulatedClock::advance(1.5);
+    EXPECT_DOUBLE_EQ(time.elapsed_since_s(start), 1.5);
+
+    SimulatedClock::set_enabled(false);
+}
+
+TEST(SimulatedClock, RunsAnHourOfTimersInOrder)
+{
+    SimulatedClock::set_enabled(true);
+    Time time;
+    const dl_time_t start = time.steady_time();
+    const auto real_start = std::chrono::steady_clock::now();
+
+    // Like periodic work, which schedules itself again each time.
+    std::vector<double> called_at_s;
+    TimerScheduler::timer_id_t id = 0;
+    std::function<void()> every_second = [&]() {
+        called_at_s.push_back(time.elapsed_since_s(start));
+        id = TimerScheduler::Instance().add(every_second, time.steady_time_in_future(1.0));
+    };
+    id = TimerScheduler::Instance().add(every_second, time.steady_time_in_future(1.0));
+
+    // Deadlines are rounded up to the millisecond of the scheduler.
+    const uint64_t num_run = SimulatedClock::advance(3600.5);
+    TimerScheduler::Instance().cancel(id);
+
+    EXPECT_EQ(num_run, 3600u);
+    ASSERT_EQ(called_at_s.size(), 3600u);
+    for (size_t i = 0; i < called_at_s.size(); ++i) {
+        EXPECT_NEAR(called_at_s[i], double(i + 1), 1e-3);
+    }
+    EXPECT_DOUBLE_EQ(time.elapsed_since_s(start), 3600.5);
+    EXPECT_LT(std::chrono::steady_clock::now() - real_start, std::chrono::seconds(5));
+
+    SimulatedClock::set_enabled(false);
+}
+
+TEST(SimulatedClock, DiscoversSimulatedVehicles)
+{
+    SimulatedClock::set_enabled(true);
+
+    {
+        DroneCoreImpl impl;
+        ASSERT_EQ(impl.add_any_connection("sim://3"), ConnectionResult::SUCCESS);
+
+        // Heartbeats, the request for the autopilot version and its answer.
+        SimulatedClock::advance(5.0);
+        EXPECT_EQ(impl.get_system_uuids().size(), 3u);
+
+        // An hour later they are still there.
+        SimulatedClock::advance(3600.0);
+        EXPECT_EQ(impl.get_system_uuids().size(), 3u);
+    }
+
+    SimulatedClock::set_enabled(false);
+}
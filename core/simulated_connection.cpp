@@ -0,0 +1,225 @@
+#include "simulated_connection.h"
+#include "log.h"
+#include <algorithm>
+#include <cstring>
+
+namespace dronecore {
+
+constexpr unsigned SimulatedConnection::MAX_VEHICLES;
+constexpr double SimulatedConnection::STEP_INTERVAL_S;
+constexpr unsigned SimulatedConnection::STEPS_PER_HEARTBEAT;
+constexpr double SimulatedConnection::ANSWER_DELAY_S;
+constexpr double SimulatedConnection::CIRCLE_RADIUS_M;
+constexpr double SimulatedConnection::CIRCLE_PERIOD_S;
+
+namespace {
+
+// Where PX4 SITL starts, the vehicles are spread out to the east of it.
+constexpr double HOME_LATITUDE_DEG = 47.397742;
+constexpr double HOME_LONGITUDE_DEG = 8.545594;
+constexpr double VEHICLE_SPACING_DEG = 0.002;
+constexpr double METERS_PER_DEG = 111320.0;
+constexpr float ALTITUDE_M = 10.0f;
+
+} // namespace
+
+SimulatedConnection::SimulatedConnection(DroneCoreImpl &parent, unsigned num_vehicles) :
+    Connection(parent),
+    _num_vehicles(std::min(num_vehicles, MAX_VEHICLES))
+{}
+
+SimulatedConnection::~SimulatedConnection()
+{
+    // If no one explicitly called stop before, we should at least do it.
+    stop();
+}
+
+bool SimulatedConnection::is_ok() const
+{
+    return true;
+}
+
+ConnectionResult SimulatedConnection::start()
+{
+    if (_num_vehicles == 0) {
+        return ConnectionResult::CONNECTION_URL_INVALID;
+    }
+
+    _should_exit = false;
+    _num_steps = 0;
+
+    std::lock_guard<std::mutex> lock(_timers_mutex);
+    _step_timer_id = TimerScheduler::Instance().add(
+                         std::bind(&SimulatedConnection::step, this), _time.steady_time());
+    return ConnectionResult::SUCCESS;
+}
+
+ConnectionResult SimulatedConnection::stop()
+{
+    _should_exit = true;
+
+    stop_outgoing_scheduler();
+
+    TimerScheduler::timer_id_t step_timer_id;
+    TimerScheduler::timer_id_t answer_timer_id;
+    {
+        std::lock_guard<std::mutex> lock(_timers_mutex);
+        step_timer_id = _step_timer_id;
+        answer_timer_id = _answer_timer_id;
+        _step_timer_id = 0;
+        _answer_timer_id = 0;
+    }
+    // Without _timers_mutex, which a running step() takes to schedule the next.
+    TimerScheduler::Instance().cancel(step_timer_id);
+    TimerScheduler::Instance().cancel(answer_timer_id);
+    return ConnectionResult::SUCCESS;
+}
+
+bool SimulatedConnection::send_frame(const uint8_t *frame, unsigned frame_len,
+                                     uint8_t target_system)
+{
+    UNUSED(target_system);
+
+    char buffer[MAVLINK_MAX_PACKET_LEN];
+    const unsigned len = std::min(frame_len, unsigned(sizeof(buffer)));
+    memcpy(buffer, frame, len);
+
+    std::lock_guard<std::mutex> lock(_parser_mutex);
+    _parser.set_new_datagram(buffer, len);
+    while (_parser.parse_message()) {
+        answer(_parser.get_last_message());
+    }
+    return true;
+}
+
+void SimulatedConnection::step()
+{
+    if (_should_exit) {
+        return;
+    }
+
+    const double time_s = double(_num_steps) * STEP_INTERVAL_S;
+    const double angle_rad = 2.0 * M_PI * time_s / CIRCLE_PERIOD_S;
+    const double speed_m_s = 2.0 * M_PI * CIRCLE_RADIUS_M / CIRCLE_PERIOD_S;
+
+    for (unsigned i = 0; i < _num_vehicles; ++i) {
+        const uint8_t system_id = uint8_t(i + 1);
+        mavlink_message_t message;
+
+        if (_num_steps % STEPS_PER_HEARTBEAT == 0) {
+            mavlink_heartbeat_t heartbeat {};
+            heartbeat.type = MAV_TYPE_QUADROTOR;
+            heartbeat.autopilot = MAV_AUTOPILOT_PX4;
+            heartbeat.base_mode = MAV_MODE_FLAG_CUSTOM_MODE_ENABLED;
+            heartbeat.system_status = MAV_STATE_ACTIVE;
+            mavlink_msg_heartbeat_encode(system_id, MAV_COMP_ID_AUTOPILOT1, &message, &heartbeat);
+            receive(message);
+        }
+
+        const double latitude_deg = HOME_LATITUDE_DEG +
+                                    CIRCLE_RADIUS_M * sin(angle_rad) / METERS_PER_DEG;
+        const double longitude_deg = HOME_LONGITUDE_DEG + i * VEHICLE_SPACING_DEG +
+                                     CIRCLE_RADIUS_M * cos(angle_rad) / METERS_PER_DEG;
+        mavlink_global_position_int_t position {};
+        position.time_boot_ms = uint32_t(time_s * 1e3);
+        position.lat = int32_t(latitude_deg * 1e7);
+        position.lon = int32_t(longitude_deg * 1e7);
+        position.alt = int32_t(ALTITUDE_M * 1e3f);
+        position.relative_alt = int32_t(ALTITUDE_M * 1e3f);
+        position.vx = int16_t(speed_m_s * cos(angle_rad) * 1e2);
+        position.vy = int16_t(-speed_m_s * sin(angle_rad) * 1e2);
+        position.hdg = uint16_t(fmod(to_deg_from_rad(-angle_rad) + 720.0, 360.0) * 1e2);
+        mavlink_msg_global_position_int_encode(system_id, MAV_COMP_ID_AUTOPILOT1, &message,
+                                               &position);
+        receive(message);
+    }
+
+    ++_num_steps;
+
+    std::lock_guard<std::mutex> lock(_timers_mutex);
+    if (!_should_exit) {
+        _step_timer_id = TimerScheduler::Instance().add(
+                             std::bind(&SimulatedConnection::step, this),
+                             _time.steady_time_in_future(STEP_INTERVAL_S));
+    }
+}
+
+void SimulatedConnection::answer(const mavlink_message_t &message)
+{
+    uint32_t command;
+    uint8_t target_system;
+    if (message.msgid == MAVLINK_MSG_ID_COMMAND_LONG) {
+        command = mavlink_msg_command_long_get_command(&message);
+        target_system = mavlink_msg_command_long_get_target_system(&message);
+    } else if (message.msgid == MAVLINK_MSG_ID_COMMAND_INT) {
+        command = mavlink_msg_command_int_get_command(&message);
+        target_system = mavlink_msg_command_int_get_target_system(&message);
+    } else {
+        return;
+    }
+
+    for (unsigned i = 0; i < _num_vehicles; ++i) {
+        const uint8_t system_id = uint8_t(i + 1);
+        if (target_system != 0 && target_system != system_id) {
+            continue;
+        }
+
+        mavlink_message_t answer_message;
+
+        if (command == MAV_CMD_REQUEST_AUTOPILOT_CAPABILITIES) {
+            mavlink_autopilot_version_t version {};
+            version.capabilities = MAV_PROTOCOL_CAPABILITY_MAVLINK2;
+            version.uid = 0x51000000 + system_id;
+            mavlink_msg_autopilot_version_encode(system_id, MAV_COMP_ID_AUTOPILOT1,
+                                                 &answer_message, &version);
+            queue_answer(answer_message);
+        }
+
+        mavlink_command_ack_t ack {};
+        ack.command = uint16_t(command);
+        ack.result = MAV_RESULT_ACCEPTED;
+        mavlink_msg_command_ack_encode(system_id, MAV_COMP_ID_AUTOPILOT1, &answer_message, &ack);
+        queue_answer(answer_message);
+    }
+}
+
+void SimulatedConnection::queue_answer(const mavlink_message_t &answer_message)
+{
+    {
+        std::lock_guard<std::mutex> lock(_answers_mutex);
+        _answers.push_back(answer_message);
+    }
+
+    // Answering right away would call back into whoever is sending.
+    std::lock_guard<std::mutex> lock(_timers_mutex);
+    // One which has started might have taken the answers already.
+    if (!_should_exit && (_answer_timer_id == 0 ||
+                          !TimerScheduler::Instance().is_pending(_answer_timer_id))) {
+        _answer_timer_id = TimerScheduler::Instance().add(
+                               std::bind(&SimulatedConnection::send_answers, this),
+                               _time.steady_time_in_future(ANSWER_DELAY_S));
+    }
+}
+
+void SimulatedConnection::send_answers()
+{
+    if (_should_exit) {
+        return;
+    }
+
+    std::vector<mavlink_message_t> answers;
+    {
+        std::lock_guard<std::mutex> lock(_answers_mutex);
+        answers.swap(_answers);
+    }
+    for (auto &answer_message : answers) {
+        receive(answer_message);
+    }
+}
+
+void SimulatedConnection::receive(const mavlink_message_t &message)
+{
+    receive_message(MAVLinkMessageView(message));
+}
+
+} // namespace dronecore
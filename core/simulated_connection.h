@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "connection.h"
+#include "global_include.h"
+#include "mavlink_receiver.h"
+#include "timer_scheduler.h"
+
+namespace dronecore {
+
+// Plays vehicles, for simulations and tests without a real one or an external
+// simulator, see SimulatedClock.
+//
+// Each vehicle sends a HEARTBEAT every second and GLOBAL_POSITION_INT at
+// 10 Hz, flying circles around its own center. Commands are accepted, and a
+// request for the autopilot capabilities is answered with AUTOPILOT_VERSION,
+// so that the vehicles are discovered. Everything is sent from timers, so with
+// the simulated clock it runs in step with DroneCore.
+class SimulatedConnection : public Connection
+{
+public:
+    // The vehicles get the system ids from 1 up.
+    explicit SimulatedConnection(DroneCoreImpl &parent, unsigned num_vehicles);
+    ~SimulatedConnection();
+    bool is_ok() const;
+    ConnectionResult start();
+    ConnectionResult stop();
+
+    bool send_frame(const uint8_t *frame, unsigned frame_len, uint8_t target_system) override;
+
+    // 255 is taken by ground stations.
+    static constexpr unsigned MAX_VEHICLES = 254;
+
+    // Non-copyable
+    SimulatedConnection(const SimulatedConnection &) = delete;
+    const SimulatedConnection &operator=(const SimulatedConnection &) = delete;
+
+private:
+    void step();
+    void send_answers();
+    void answer(const mavlink_message_t &message);
+    void queue_answer(const mavlink_message_t &answer);
+    void receive(const mavlink_message_t &message);
+
+    static constexpr double STEP_INTERVAL_S = 0.1;
+    static constexpr unsigned STEPS_PER_HEARTBEAT = 10;
+    // Like the latency of a link, answers are not received right away.
+    static constexpr double ANSWER_DELAY_S = 0.01;
+    static constexpr double CIRCLE_RADIUS_M = 50.0;
+    static constexpr double CIRCLE_PERIOD_S = 60.0;
+
+    const unsigned _num_vehicles;
+    uint64_t _num_steps = 0;
+    Time _time {};
+
+    // What we send is parsed as the vehicles would.
+    std::mutex _parser_mutex {};
+    MAVLinkReceiver _parser {};
+
+    std::mutex _answers_mutex {};
+    std::vector<mavlink_message_t> _answers {};
+
+    std::mutex _timers_mutex {};
+    TimerScheduler::timer_id_t _step_timer_id = 0;
+    TimerScheduler::timer_id_t _answer_timer_id = 0;
+    std::atomic_bool _should_exit {false};
+};
+
+} // namespace dronecore
@@ -0,0 +1,205 @@
+#include "spatial_grid.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace dronecore {
+
+SpatialGrid::SpatialGrid(double cell_size_m) :
+    _cell_size_m(cell_size_m)
+{}
+
+void SpatialGrid::set(unsigned id, const Point &point)
+{
+    if (id >= _entries.size()) {
+        _entries.resize(id + 1, Entry {Point {0.0, 0.0}, 0, false});
+    }
+
+    Entry &entry = _entries[id];
+    const cell_key_t cell = key_of(index_of(point.north_m), index_of(point.east_m));
+    entry.point = point;
+
+    if (entry.is_set && entry.cell == cell) {
+        // Still in the same cell, which is what happens most of the time.
+        return;
+    }
+    if (entry.is_set) {
+        remove(id);
+    }
+
+    _cells[cell].push_back(id);
+    entry.cell = cell;
+    entry.is_set = true;
+    ++_size;
+}
+
+void SpatialGrid::remove(unsigned id)
+{
+    if (id >= _entries.size() || !_entries[id].is_set) {
+        return;
+    }
+    Entry &entry = _entries[id];
+
+    auto it = _cells.find(entry.cell);
+    if (it != _cells.end()) {
+        std::vector<unsigned> &ids = it->second;
+        ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+        if (ids.empty()) {
+            _cells.erase(it);
+        }
+    }
+    entry.is_set = false;
+    --_size;
+}
+
+bool SpatialGrid::get(unsigned id, Point &point) const
+{
+    if (id >= _entries.size() || !_entries[id].is_set) {
+        return false;
+    }
+    point = _entries[id].point;
+    return true;
+}
+
+void SpatialGrid::get_within_radius(const Point &center, double radius_m,
+                                    std::vector<unsigned> &ids) const
+{
+    ids.clear();
+    const double radius_squared = radius_m * radius_m;
+    for_each_in_box(Point {center.north_m - radius_m, center.east_m - radius_m},
+                    Point {center.north_m + radius_m, center.east_m + radius_m},
+    [&ids, &center, radius_squared](unsigned id, const Point & point) {
+        if (distance_squared(point, center) <= radius_squared) {
+            ids.push_back(id);
+        }
+    });
+}
+
+void SpatialGrid::get_nearest(const Point &center, size_t k, std::vector<unsigned> &ids) const
+{
+    ids.clear();
+    if (k == 0 || _size == 0) {
+        return;
+    }
+    k = std::min(k, _size);
+
+    // Once the circle holds k of them, none outside of it can be closer, so
+    // it only needs to grow until then.
+    double radius_m = _cell_size_m;
+    get_within_radius(center, radius_m, ids);
+    while (ids.size() < k) {
+        radius_m *= 2.0;
+        get_within_radius(center, radius_m, ids);
+    }
+
+    std::sort(ids.begin(), ids.end(), [this, &center](unsigned lhs, unsigned rhs) {
+        return distance_squared(_entries[lhs].point, center) <
+               distance_squared(_entries[rhs].point, center);
+    });
+    ids.resize(k);
+}
+
+void SpatialGrid::get_inside_polygon(const std::vector<Point> &polygon,
+                                     std::vector<unsigned> &ids) const
+{
+    ids.clear();
+    if (polygon.size() < 3) {
+        return;
+    }
+
+    Point min = polygon.front();
+    Point max = polygon.front();
+    for (const auto &vertex : polygon) {
+        min.north_m = std::min(min.north_m, vertex.north_m);
+        min.east_m = std::min(min.east_m, vertex.east_m);
+        max.north_m = std::max(max.north_m, vertex.north_m);
+        max.east_m = std::max(max.east_m, vertex.east_m);
+    }
+
+    for_each_in_box(min, max, [&ids, &polygon](unsigned id, const Point & point) {
+        if (is_inside_polygon(polygon, point)) {
+            ids.push_back(id);
+        }
+    });
+}
+
+int32_t SpatialGrid::index_of(double m) const
+{
+    const double index = std::floor(m / _cell_size_m);
+    // Far beyond anything a fleet covers, but keeps the key well-defined.
+    const double limit = double(std::numeric_limits<int32_t>::max());
+    return int32_t(std::max(-limit, std::min(index, limit)));
+}
+
+SpatialGrid::cell_key_t SpatialGrid::key_of(int32_t north_index, int32_t east_index)
+{
+    return (cell_key_t(uint32_t(north_index)) << 32) | cell_key_t(uint32_t(east_index));
+}
+
+template<typename F>
+void SpatialGrid::for_each_in_box(const Point &min, const Point &max, F visit) const
+{
+    const int32_t min_north = index_of(min.north_m);
+    const int32_t max_north = index_of(max.north_m);
+    const int32_t min_east = index_of(min.east_m);
+    const int32_t max_east = index_of(max.east_m);
+
+    const double num_box_cells = (double(max_north) - double(min_north) + 1.0) *
+                                 (double(max_east) - double(min_east) + 1.0);
+
+    if (num_box_cells > double(_cells.size())) {
+        // A big box, it is quicker to go through the cells which have points.
+        for (const auto &cell_and_ids : _cells) {
+            for (unsigned id : cell_and_ids.second) {
+                const Point &point = _entries[id].point;
+                const int32_t north = index_of(point.north_m);
+                const int32_t east = index_of(point.east_m);
+                if (north >= min_north && north <= max_north &&
+                    east >= min_east && east <= max_east) {
+                    visit(id, point);
+                }
+            }
+        }
+        return;
+    }
+
+    for (int64_t north = min_north; north <= max_north; ++north) {
+        for (int64_t east = min_east; east <= max_east; ++east) {
+            auto it = _cells.find(key_of(int32_t(north), int32_t(east)));
+            if (it == _cells.end()) {
+                continue;
+            }
+            for (unsigned id : it->second) {
+                visit(id, _entries[id].point);
+            }
+        }
+    }
+}
+
+double SpatialGrid::distance_squared(const Point &lhs, const Point &rhs)
+{
+    const double north_m = lhs.north_m - rhs.north_m;
+    const double east_m = lhs.east_m - rhs.east_m;
+    return north_m * north_m + east_m * east_m;
+}
+
+bool SpatialGrid::is_inside_polygon(const std::vector<Point> &polygon, const Point &point)
+{
+    // Counts the edges crossed by a ray going east from the point.
+    bool is_inside = false;
+    for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+        const Point &a = polygon[i];
+        const Point &b = polygon[j];
+        if ((a.north_m > point.north_m) != (b.north_m > point.north_m)) {
+            const double east_m = a.east_m + (point.north_m - a.north_m) *
+                                  (b.east_m - a.east_m) / (b.north_m - a.north_m);
+            if (point.east_m < east_m) {
+                is_inside = !is_inside;
+            }
+        }
+    }
+    return is_inside;
+}
+
+} // namespace dronecore
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace dronecore {
+
+// Finds the points in a plane which are close to a position without looking
+// at all of them. Points are kept in square cells, and a query only looks at
+// the cells it overlaps. Moving a point only touches its old and new cell.
+//
+// Ids are small numbers, e.g. system ids. Not thread-safe.
+class SpatialGrid
+{
+public:
+    // Local tangent plane coordinates, e.g. north and east of a reference.
+    struct Point {
+        double north_m;
+        double east_m;
+    };
+
+    explicit SpatialGrid(double cell_size_m);
+    ~SpatialGrid() = default;
+
+    void set(unsigned id, const Point &point);
+    void remove(unsigned id);
+
+    // Returns false if there is no point with this id.
+    bool get(unsigned id, Point &point) const;
+
+    size_t size() const { return _size; }
+
+    // All ids within radius_m of center, in no particular order.
+    void get_within_radius(const Point &center, double radius_m,
+                           std::vector<unsigned> &ids) const;
+
+    // The k ids closest to center, closest first.
+    void get_nearest(const Point &center, size_t k, std::vector<unsigned> &ids) const;
+
+    // All ids inside the polygon, given by its vertices in either direction.
+    void get_inside_polygon(const std::vector<Point> &polygon,
+                            std::vector<unsigned> &ids) const;
+
+    // Non-copyable
+    SpatialGrid(const SpatialGrid &) = delete;
+    const SpatialGrid &operator=(const SpatialGrid &) = delete;
+
+private:
+    typedef uint64_t cell_key_t;
+
+    struct Entry {
+        Point point;
+        cell_key_t cell;
+        bool is_set;
+    };
+
+    int32_t index_of(double m) const;
+    static cell_key_t key_of(int32_t north_index, int32_t east_index);
+
+    // Calls visit(id, point) for every point in the cells overlapping the box.
+    template<typename F>
+    void for_each_in_box(const Point &min, const Point &max, F visit) const;
+
+    static double distance_squared(const Point &lhs, const Point &rhs);
+    static bool is_inside_polygon(const std::vector<Point> &polygon, const Point &point);
+
+    const double _cell_size_m;
+    std::vector<Entry> _entries {};
+    std::unordered_map<cell_key_t, std::vector<unsigned>> _cells {};
+    size_t _size = 0;
+};
+
+} // namespace dronecore
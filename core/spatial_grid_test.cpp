@@ -0,0 +1,97 @@
+#include "spatial_grid.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace dronecore;
+
+namespace {
+
+std::vector<unsigned> sorted(std::vector<unsigned> ids)
+{
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+} // namespace
+
+TEST(SpatialGrid, FindsWithinRadius)
+{
+    SpatialGrid grid(100.0);
+    grid.set(1, {0.0, 0.0});
+    grid.set(2, {150.0, 0.0});
+    grid.set(3, {0.0, -199.0});
+    grid.set(4, {300.0, 300.0});
+    EXPECT_EQ(grid.size(), 4u);
+
+    std::vector<unsigned> ids;
+    grid.get_within_radius({0.0, 0.0}, 200.0, ids);
+    EXPECT_EQ(sorted(ids), (std::vector<unsigned> {1, 2, 3}));
+
+    // Moved into another cell.
+    grid.set(4, {10.0, 10.0});
+    grid.set(2, {1000.0, 0.0});
+    grid.get_within_radius({0.0, 0.0}, 200.0, ids);
+    EXPECT_EQ(sorted(ids), (std::vector<unsigned> {1, 3, 4}));
+
+    grid.remove(1);
+    EXPECT_EQ(grid.size(), 3u);
+    grid.get_within_radius({0.0, 0.0}, 200.0, ids);
+    EXPECT_EQ(sorted(ids), (std::vector<unsigned> {3, 4}));
+}
+
+TEST(SpatialGrid, FindsNearestClosestFirst)
+{
+    SpatialGrid grid(100.0);
+    grid.set(1, {0.0, 0.0});
+    grid.set(2, {5000.0, 0.0});
+    grid.set(3, {0.0, 50.0});
+    grid.set(4, {-900.0, 0.0});
+
+    std::vector<unsigned> ids;
+    grid.get_nearest({0.0, 0.0}, 3, ids);
+    EXPECT_EQ(ids, (std::vector<unsigned> {1, 3, 4}));
+
+    grid.get_nearest({0.0, 0.0}, 10, ids);
+    EXPECT_EQ(ids, (std::vector<unsigned> {1, 3, 4, 2}));
+}
+
+TEST(SpatialGrid, FindsInsidePolygon)
+{
+    SpatialGrid grid(100.0);
+    grid.set(1, {50.0, 50.0});
+    grid.set(2, {150.0, 50.0});
+    grid.set(3, {250.0, 250.0});
+
+    // A triangle which has 2 inside and 3 outside its bounding box.
+    const std::vector<SpatialGrid::Point> triangle {{0.0, 0.0}, {300.0, 0.0}, {0.0, 300.0}};
+    std::vector<unsigned> ids;
+    grid.get_inside_polygon(triangle, ids);
+    EXPECT_EQ(sorted(ids), (std::vector<unsigned> {1, 2}));
+}
+
+TEST(SpatialGrid, AgreesWithAllPairs)
+{
+    SpatialGrid grid(100.0);
+    std::vector<SpatialGrid::Point> points;
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<double> distribution(-5000.0, 5000.0);
+    for (unsigned id = 0; id < 250; ++id) {
+        points.push_back({distribution(generator), distribution(generator)});
+        grid.set(id, points.back());
+    }
+
+    for (unsigned center = 0; center < points.size(); center += 10) {
+        std::vector<unsigned> expected;
+        for (unsigned id = 0; id < points.size(); ++id) {
+            if (std::hypot(points[id].north_m - points[center].north_m,
+                           points[id].east_m - points[center].east_m) <= 800.0) {
+                expected.push_back(id);
+            }
+        }
+        std::vector<unsigned> ids;
+        grid.get_within_radius(points[center], 800.0, ids);
+        EXPECT_EQ(sorted(ids), expected);
+    }
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "memory_resource.h"
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace dronecore {
+
+// Wait-free ring for exactly one producer thread and one consumer thread.
+// The storage is allocated once, a push onto a full queue fails instead of
+// waiting, so a slow consumer can never hold up the producer. The storage
+// comes from the default memory resource.
+template<typename T>
+class SpscQueue
+{
+public:
+    // The capacity is rounded up to a power of two.
+    explicit SpscQueue(size_t capacity) :
+        _items(round_up_to_power_of_two(capacity)),
+        _mask(_items.size() - 1)
+    {
+    }
+
+    ~SpscQueue() = default;
+
+    // Only to be called from the producer thread.
+    bool push(const T &item)
+    {
+        const size_t tail = _tail_index.value.load(std::memory_order_relaxed);
+
+        if (tail - _cached_head == _items.size()) {
+            // Looks full, but the consumer could have made space meanwhile.
+            _cached_head = _head_index.value.load(std::memory_order_acquire);
+            if (tail - _cached_head == _items.size()) {
+                return false;
+            }
+        }
+
+        _items[tail & _mask] = item;
+        _tail_index.value.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Only to be called from the consumer thread. Appends up to max_items and
+    // returns how many there were.
+    size_t pop_batch(std::vector<T> &items, size_t max_items = size_t(-1))
+    {
+        const size_t head = _head_index.value.load(std::memory_order_relaxed);
+        const size_t tail = _tail_index.value.load(std::memory_order_acquire);
+
+        size_t count = tail - head;
+        if (count > max_items) {
+            count = max_items;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            items.push_back(_items[(head + i) & _mask]);
+        }
+
+        _head_index.value.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    // Only to be called from the producer thread. At least this many pushes
+    // succeed from now on.
+    size_t free_space()
+    {
+        const size_t tail = _tail_index.value.load(std::memory_order_relaxed);
+        _cached_head = _head_index.value.load(std::memory_order_acquire);
+        return _items.size() - (tail - _cached_head);
+    }
+
+    size_t capacity() const
+    {
+        return _items.size();
+    }
+
+    // Non-copyable
+    SpscQueue(const SpscQueue &) = delete;
+    const SpscQueue &operator=(const SpscQueue &) = delete;
+
+private:
+    static size_t round_up_to_power_of_two(size_t value)
+    {
+        size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    pmr_vector<T> _items;
+    const size_t _mask;
+
+    // Producer and consumer each write their own cache line. This is padding
+    // rather than alignas because C++11 new does not respect over-alignment.
+    struct PaddedIndex {
+        char padding_before[64];
+        std::atomic<size_t> value;
+        char padding_after[64 - sizeof(std::atomic<size_t>)];
+    };
+
+    PaddedIndex _head_index {{}, {0}, {}};
+    PaddedIndex _tail_index {{}, {0}, {}};
+    // Only used by the producer, to not read the head index on every push.
+    size_t _cached_head = 0;
+};
+
+} // namespace dronecore
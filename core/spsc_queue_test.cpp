@@ -0,0 +1,72 @@
+#include "spsc_queue.h"
+#include <gtest/gtest.h>
+#include <thread>
+
+using namespace dronecore;
+
+TEST(SpscQueue, PushAndPop)
+{
+    SpscQueue<int> queue(3);
+    EXPECT_EQ(queue.capacity(), 4u);
+
+    EXPECT_TRUE(queue.push(1));
+    EXPECT_TRUE(queue.push(2));
+
+    std::vector<int> items;
+    EXPECT_EQ(queue.pop_batch(items), 2u);
+    ASSERT_EQ(items.size(), 2u);
+    EXPECT_EQ(items[0], 1);
+    EXPECT_EQ(items[1], 2);
+
+    EXPECT_EQ(queue.pop_batch(items), 0u);
+}
+
+TEST(SpscQueue, FullPushFails)
+{
+    SpscQueue<int> queue(4);
+    EXPECT_EQ(queue.free_space(), 4u);
+
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(queue.push(i));
+    }
+    EXPECT_EQ(queue.free_space(), 0u);
+    EXPECT_FALSE(queue.push(4));
+
+    std::vector<int> items;
+    EXPECT_EQ(queue.pop_batch(items, 1), 1u);
+    EXPECT_EQ(queue.free_space(), 1u);
+    EXPECT_TRUE(queue.push(5));
+
+    items.clear();
+    EXPECT_EQ(queue.pop_batch(items), 4u);
+    EXPECT_EQ(items.front(), 1);
+    EXPECT_EQ(items.back(), 5);
+}
+
+TEST(SpscQueue, KeepsOrderAcrossThreads)
+{
+    SpscQueue<unsigned> queue(64);
+    const unsigned num_items = 200000;
+
+    std::thread producer([&queue, num_items]() {
+        for (unsigned i = 0; i < num_items; /* no ++i */) {
+            if (queue.push(i)) {
+                ++i;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::vector<unsigned> items;
+    while (items.size() < num_items) {
+        if (queue.pop_batch(items) == 0) {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+
+    for (unsigned i = 0; i < num_items; ++i) {
+        ASSERT_EQ(items[i], i);
+    }
+}
@@ -0,0 +1,113 @@
+#include "status_text_log.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace dronecore {
+
+constexpr size_t StatusTextLog::CAPACITY;
+constexpr size_t StatusTextLog::CHUNK_LEN;
+constexpr double StatusTextLog::PENDING_TIMEOUT_S;
+
+namespace {
+
+const char LOST_CHUNK_MARKER[] = "[...]";
+
+} // namespace
+
+StatusTextLog::StatusTextLog() :
+    _entries(CAPACITY)
+{
+}
+
+StatusTextLog::~StatusTextLog() {}
+
+void StatusTextLog::add(uint8_t component_id, uint8_t severity, const char *text, uint16_t id,
+                        uint8_t chunk_seq, uint64_t time_us, std::vector<Entry> &completed)
+{
+    // The text is only null terminated if it is shorter than the field.
+    std::string chunk(text, strnlen(text, CHUNK_LEN));
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto it = _pending.find(component_id);
+    if (it != _pending.end() && (id == 0 || id != it->second.id)) {
+        // Its last chunk got lost, it is as complete as it gets.
+        Pending &pending = it->second;
+        append_locked(component_id, pending.severity, pending.time_us,
+                      pending.text + LOST_CHUNK_MARKER, completed);
+        _pending.erase(it);
+        it = _pending.end();
+    }
+
+    if (id == 0) {
+        append_locked(component_id, severity, time_us, std::move(chunk), completed);
+        return;
+    }
+
+    if (it == _pending.end()) {
+        const Pending new_pending {id, 0, severity, time_us, time_us, ""};
+        it = _pending.insert(std::make_pair(component_id, new_pending)).first;
+    }
+    Pending &pending = it->second;
+    pending.last_time_us = time_us;
+
+    if (chunk_seq < pending.next_chunk_seq) {
+        // A repeated one.
+        return;
+    }
+    if (chunk_seq > pending.next_chunk_seq) {
+        pending.text += LOST_CHUNK_MARKER;
+    }
+    pending.text += chunk;
+    pending.next_chunk_seq = uint8_t(chunk_seq + 1);
+
+    if (chunk.size() < CHUNK_LEN) {
+        append_locked(component_id, pending.severity, pending.time_us, std::move(pending.text),
+                      completed);
+        _pending.erase(it);
+    }
+}
+
+bool StatusTextLog::flush_pending(uint64_t time_us, std::vector<Entry> &completed)
+{
+    const uint64_t timeout_us = uint64_t(PENDING_TIMEOUT_S * 1e6);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (auto it = _pending.begin(); it != _pending.end();) {
+        const Pending &pending = it->second;
+        if (time_us - pending.last_time_us < timeout_us) {
+            ++it;
+            continue;
+        }
+        // Its last chunk got lost and no other text came after it.
+        append_locked(it->first, pending.severity, pending.time_us,
+                      pending.text + LOST_CHUNK_MARKER, completed);
+        it = _pending.erase(it);
+    }
+    return !_pending.empty();
+}
+
+void StatusTextLog::append_locked(uint8_t component_id, uint8_t severity, uint64_t time_us,
+                                  std::string text, std::vector<Entry> &completed)
+{
+    Entry &entry = _entries[_next_seq % CAPACITY];
+    entry = Entry {_next_seq, time_us, component_id, severity, std::move(text)};
+    ++_next_seq;
+    completed.push_back(entry);
+}
+
+uint64_t StatusTextLog::copy_since(uint64_t seq, std::vector<Entry> &entries) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // The older ones have been overwritten.
+    const uint64_t oldest_seq = (_next_seq > CAPACITY) ? _next_seq - CAPACITY : 0;
+    for (uint64_t i = std::max(seq, oldest_seq); i < _next_seq; ++i) {
+        entries.push_back(_entries[i % CAPACITY]);
+    }
+    return _next_seq;
+}
+
+} // namespace dronecore
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace dronecore {
+
+// Keeps the last STATUSTEXT messages of a system, with the chunks of the long
+// ones of MAVLink 2 put back together.
+//
+// A chunked text is complete with its first chunk shorter than CHUNK_LEN. Lost
+// chunks are marked with "[...]" in the text. If the last chunk is lost, the
+// text is complete once the component sends another one, or with
+// flush_pending() once no chunk came for PENDING_TIMEOUT_S.
+//
+// The texts are numbered one after the other, so that a reader can fetch what
+// came since it last looked. Only the last CAPACITY of them are kept.
+class StatusTextLog
+{
+public:
+    static constexpr size_t CAPACITY = 256;
+    static constexpr size_t CHUNK_LEN = 50;
+    static constexpr double PENDING_TIMEOUT_S = 0.5;
+
+    struct Entry {
+        uint64_t seq;
+        // Of the first chunk.
+        uint64_t time_us;
+        uint8_t component_id;
+        uint8_t severity;
+        std::string text;
+    };
+
+    StatusTextLog();
+    ~StatusTextLog();
+
+    // The text is the field as received, so without a null if it is CHUNK_LEN
+    // long. An id of 0 means it is not chunked. Appends the texts which are
+    // complete with this one to completed.
+    void add(uint8_t component_id, uint8_t severity, const char *text, uint16_t id,
+             uint8_t chunk_seq, uint64_t time_us, std::vector<Entry> &completed);
+
+    // Appends the chunked texts which got no chunk for PENDING_TIMEOUT_S by
+    // time_us to completed. Returns whether there are others pending still.
+    bool flush_pending(uint64_t time_us, std::vector<Entry> &completed);
+
+    // Appends the texts from seq onwards to entries, oldest first. Returns the
+    // seq the next text will get.
+    uint64_t copy_since(uint64_t seq, std::vector<Entry> &entries) const;
+
+    // Non-copyable
+    StatusTextLog(const StatusTextLog &) = delete;
+    const StatusTextLog &operator=(const StatusTextLog &) = delete;
+
+private:
+    struct Pending {
+        uint16_t id;
+        uint8_t next_chunk_seq;
+        uint8_t severity;
+        uint64_t time_us;
+        // Of the last chunk.
+        uint64_t last_time_us;
+        std::string text;
+    };
+
+    // We assume that _mutex is held in these.
+    void append_locked(uint8_t component_id, uint8_t severity, uint64_t time_us,
+                       std::string text, std::vector<Entry> &completed);
+
+    mutable std::mutex _mutex {};
+    std::vector<Entry> _entries;
+    uint64_t _next_seq = 0;
+    // Chunked texts of each component which are not complete yet.
+    std::map<uint8_t, Pending> _pending {};
+};
+
+} // namespace dronecore
@@ -0,0 +1,123 @@
+#include "status_text_log.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using namespace dronecore;
+
+static void add_chunked(StatusTextLog &log, const std::string &text, uint16_t id,
+                        std::vector<StatusTextLog::Entry> &completed,
+                        uint8_t skipped_chunk_seq = 255)
+{
+    for (size_t offset = 0, chunk_seq = 0; offset <= text.size();
+         offset += StatusTextLog::CHUNK_LEN, ++chunk_seq) {
+        if (chunk_seq == skipped_chunk_seq) {
+            continue;
+        }
+        char field[StatusTextLog::CHUNK_LEN] {};
+        text.copy(field, StatusTextLog::CHUNK_LEN, offset);
+        log.add(1, 4, field, id, uint8_t(chunk_seq), 1000, completed);
+    }
+}
+
+TEST(StatusTextLog, KeepsSingleTexts)
+{
+    StatusTextLog log;
+    std::vector<StatusTextLog::Entry> completed;
+
+    char field[StatusTextLog::CHUNK_LEN] {};
+    std::string("Takeoff detected").copy(field, sizeof(field));
+    log.add(1, 6, field, 0, 0, 1000, completed);
+
+    ASSERT_EQ(completed.size(), 1u);
+    EXPECT_EQ(completed[0].seq, 0u);
+    EXPECT_EQ(completed[0].severity, 6);
+    EXPECT_EQ(completed[0].text, "Takeoff detected");
+
+    // A whole field has no null.
+    std::string(StatusTextLog::CHUNK_LEN, 'x').copy(field, sizeof(field));
+    log.add(1, 6, field, 0, 0, 2000, completed);
+    ASSERT_EQ(completed.size(), 2u);
+    EXPECT_EQ(completed[1].text.size(), StatusTextLog::CHUNK_LEN);
+}
+
+TEST(StatusTextLog, ReassemblesChunks)
+{
+    StatusTextLog log;
+    std::vector<StatusTextLog::Entry> completed;
+
+    const std::string text = "Preflight Fail: " + std::string(100, 'a') + " end";
+    add_chunked(log, text, 7, completed);
+    ASSERT_EQ(completed.size(), 1u);
+    EXPECT_EQ(completed[0].text, text);
+
+    // Exactly two chunks long, ended by an empty one.
+    const std::string even_text(2 * StatusTextLog::CHUNK_LEN, 'b');
+    add_chunked(log, even_text, 8, completed);
+    ASSERT_EQ(completed.size(), 2u);
+    EXPECT_EQ(completed[1].text, even_text);
+}
+
+TEST(StatusTextLog, MarksLostChunks)
+{
+    StatusTextLog log;
+    std::vector<StatusTextLog::Entry> completed;
+
+    const std::string text = std::string(50, 'a') + std::string(50, 'b') + "c";
+    add_chunked(log, text, 9, completed, 1);
+    ASSERT_EQ(completed.size(), 1u);
+    EXPECT_EQ(completed[0].text, std::string(50, 'a') + "[...]c");
+
+    // Without its last chunk, the text is done with the next one.
+    add_chunked(log, text, 10, completed, 2);
+    EXPECT_EQ(completed.size(), 1u);
+    char field[StatusTextLog::CHUNK_LEN] {'d'};
+    log.add(1, 4, field, 0, 0, 3000, completed);
+    ASSERT_EQ(completed.size(), 3u);
+    EXPECT_EQ(completed[1].text, std::string(50, 'a') + std::string(50, 'b') + "[...]");
+    EXPECT_EQ(completed[2].text, "d");
+}
+
+TEST(StatusTextLog, FlushesTextsWithoutLastChunk)
+{
+    StatusTextLog log;
+    std::vector<StatusTextLog::Entry> completed;
+
+    // All chunks are added at 1000 us, the last one is lost.
+    const std::string text = std::string(50, 'a') + std::string(50, 'b') + "c";
+    add_chunked(log, text, 11, completed, 2);
+    EXPECT_TRUE(completed.empty());
+
+    const uint64_t timeout_us = uint64_t(StatusTextLog::PENDING_TIMEOUT_S * 1e6);
+    EXPECT_TRUE(log.flush_pending(1000 + timeout_us - 1, completed));
+    EXPECT_TRUE(completed.empty());
+
+    EXPECT_FALSE(log.flush_pending(1000 + timeout_us, completed));
+    ASSERT_EQ(completed.size(), 1u);
+    EXPECT_EQ(completed[0].text, std::string(50, 'a') + std::string(50, 'b') + "[...]");
+    EXPECT_EQ(completed[0].time_us, 1000u);
+
+    EXPECT_FALSE(log.flush_pending(1000 + 2 * timeout_us, completed));
+    EXPECT_EQ(completed.size(), 1u);
+}
+
+TEST(StatusTextLog, KeepsTheLastOnes)
+{
+    StatusTextLog log;
+    std::vector<StatusTextLog::Entry> completed;
+
+    char field[StatusTextLog::CHUNK_LEN] {'e'};
+    for (size_t i = 0; i < StatusTextLog::CAPACITY + 10; ++i) {
+        log.add(1, 6, field, 0, 0, i, completed);
+    }
+
+    std::vector<StatusTextLog::Entry> entries;
+    EXPECT_EQ(log.copy_since(0, entries), StatusTextLog::CAPACITY + 10);
+    ASSERT_EQ(entries.size(), StatusTextLog::CAPACITY);
+    EXPECT_EQ(entries.front().seq, 10u);
+    EXPECT_EQ(entries.back().seq, StatusTextLog::CAPACITY + 9);
+
+    entries.clear();
+    log.copy_since(StatusTextLog::CAPACITY + 5, entries);
+    EXPECT_EQ(entries.size(), 5u);
+}
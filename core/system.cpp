@@ -48,16 +48,26 @@ bool System::has_gimbal() const
     return _mavlink_system->has_gimbal();
 }
 
+uint64_t System::num_unwanted_messages() const
+{
+    return _mavlink_system->num_unwanted_messages();
+}
+
 void System::add_new_component(uint8_t component_id)
 {
     return _mavlink_system->add_new_component(component_id);
 }
 
-void System::process_mavlink_message(const mavlink_message_t &message)
+void System::process_mavlink_message(const MAVLinkMessageView &message)
 {
     return _mavlink_system->process_mavlink_message(message);
 }
 
+bool System::accept_message(uint32_t msg_id)
+{
+    return _mavlink_system->accept_message(msg_id);
+}
+
 void System::set_system_id(uint8_t system_id)
 {
     return _mavlink_system->set_system_id(system_id);
@@ -6,8 +6,10 @@
 namespace dronecore {
 
 class MAVLinkSystem;
+class MAVLinkMessageView;
 class DroneCoreImpl;
 class PluginImplBase;
+class SwarmOffboardImpl;
 
 /**
  * @brief This class represents a system, made up of one or more components
@@ -62,6 +64,14 @@ public:
      */
     bool has_gimbal() const;
 
+    /**
+     * @brief Number of messages from the system which were dropped on arrival.
+     *
+     * Messages are dropped right away if no plugin in use handles them.
+     * @return Number of messages dropped since the system was discovered.
+     */
+    uint64_t num_unwanted_messages() const;
+
 
     // Non-copyable
     /**
@@ -77,7 +87,8 @@ public:
 private:
 
     void add_new_component(uint8_t component_id);
-    void process_mavlink_message(const mavlink_message_t &message);
+    void process_mavlink_message(const MAVLinkMessageView &message);
+    bool accept_message(uint32_t msg_id);
     void set_system_id(uint8_t system_id);
     bool is_connected() const;
     uint64_t get_uuid() const;
@@ -89,9 +100,11 @@ private:
      * For now,
      * - DroneCoreImpl wants to access private methods of System.
      * - PluginImplBase requests System class to get instance of MAVLinkSystem class.
+     * - SwarmOffboardImpl does the same for the systems of a swarm.
     */
     friend DroneCoreImpl;
     friend PluginImplBase;
+    friend SwarmOffboardImpl;
 
     std::shared_ptr<MAVLinkSystem> _mavlink_system;
 };
@@ -0,0 +1,321 @@
+#include "system_state_store.h"
+#include "global_include.h"
+#include "log.h"
+
+#ifndef WINDOWS
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace dronecore {
+
+constexpr uint32_t SystemStateStore::VERSION;
+constexpr size_t SystemStateStore::HEADER_LEN;
+
+namespace {
+
+const char MAGIC[] = {'D', 'C', 'S', 'Y'};
+const char FILE_PREFIX[] = "system_";
+const char FILE_SUFFIX[] = ".state";
+
+template<typename T>
+void append(std::vector<uint8_t> &buffer, T value)
+{
+    const size_t offset = buffer.size();
+    buffer.resize(offset + sizeof(value));
+    memcpy(&buffer[offset], &value, sizeof(value));
+}
+
+// Reads one value after the other and remembers if any of them was past the end.
+class Reader
+{
+public:
+    Reader(const uint8_t *data, size_t len) : _data(data), _len(len) {}
+
+    template<typename T>
+    T read()
+    {
+        T value {};
+        read_bytes(&value, sizeof(value));
+        return value;
+    }
+
+    void read_bytes(void *destination, size_t len)
+    {
+        if (!_ok || _len - _offset < len) {
+            _ok = false;
+            return;
+        }
+        memcpy(destination, _data + _offset, len);
+        _offset += len;
+    }
+
+    bool ok() const { return _ok; }
+    bool at_end() const { return _offset == _len; }
+
+private:
+    const uint8_t *_data;
+    size_t _len;
+    size_t _offset = 0;
+    bool _ok = true;
+};
+
+bool make_dir(const std::string &dir)
+{
+#ifdef WINDOWS
+    UNUSED(dir);
+    return false;
+#else
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        LogErr() << "Could not make " << dir << ": " << strerror(errno);
+        return false;
+    }
+    return true;
+#endif
+}
+
+} // namespace
+
+SystemStateStore::SystemStateStore() {}
+
+SystemStateStore::~SystemStateStore() {}
+
+bool SystemStateStore::open(const std::string &dir)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _dir.clear();
+    _entries.clear();
+    _next_order = 0;
+
+    if (dir.empty()) {
+        return true;
+    }
+
+#ifdef WINDOWS
+    LogErr() << "A state directory is not supported on Windows";
+    return false;
+#else
+    if (!make_dir(dir)) {
+        return false;
+    }
+
+    DIR *directory = opendir(dir.c_str());
+    if (directory == nullptr) {
+        LogErr() << "Could not open " << dir << ": " << strerror(errno);
+        return false;
+    }
+
+    const size_t prefix_len = sizeof(FILE_PREFIX) - 1;
+    const size_t suffix_len = sizeof(FILE_SUFFIX) - 1;
+    while (const dirent *directory_entry = readdir(directory)) {
+        const std::string name = directory_entry->d_name;
+        if (name.size() <= prefix_len + suffix_len ||
+            name.compare(0, prefix_len, FILE_PREFIX) != 0 ||
+            name.compare(name.size() - suffix_len, suffix_len, FILE_SUFFIX) != 0) {
+            continue;
+        }
+
+        const std::string path = dir + "/" + name;
+        struct stat file_stat;
+        Snapshot snapshot;
+        if (stat(path.c_str(), &file_stat) != 0 || !read_file(path, snapshot)) {
+            LogWarn() << "Ignoring system state " << path;
+            continue;
+        }
+
+        // Which one is newer only matters between files, so seconds are enough.
+        const uint64_t order = uint64_t(file_stat.st_mtime);
+        if (order >= _next_order) {
+            _next_order = order + 1;
+        }
+        const uint64_t uuid = snapshot.uuid;
+        _entries[uuid] = Entry {std::move(snapshot), order};
+    }
+    closedir(directory);
+
+    LogDebug() << "Found the state of " << _entries.size() << " system(s) in " << dir;
+    _dir = dir;
+    return true;
+#endif
+}
+
+bool SystemStateStore::is_open() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return !_dir.empty();
+}
+
+std::string SystemStateStore::subdir(const std::string &name) const
+{
+    std::string dir;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_dir.empty()) {
+            return "";
+        }
+        dir = _dir + "/" + name;
+    }
+    return make_dir(dir) ? dir : "";
+}
+
+bool SystemStateStore::find_by_system_id(uint8_t system_id, Snapshot &snapshot) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const Entry *newest = nullptr;
+    for (const auto &uuid_and_entry : _entries) {
+        const Entry &entry = uuid_and_entry.second;
+        if (entry.snapshot.system_id == system_id &&
+            (newest == nullptr || entry.order > newest->order)) {
+            newest = &entry;
+        }
+    }
+    if (newest == nullptr) {
+        return false;
+    }
+    snapshot = newest->snapshot;
+    return true;
+}
+
+void SystemStateStore::save(const Snapshot &snapshot)
+{
+    if (snapshot.uuid == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_dir.empty()) {
+        return;
+    }
+
+    const std::vector<uint8_t> buffer = serialize(snapshot);
+    if (buffer.empty()) {
+        return;
+    }
+
+    const std::string path = path_of(snapshot.uuid);
+    const std::string temporary_path = path + ".tmp";
+    std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(buffer.data()), std::streamsize(buffer.size()));
+    file.close();
+    if (!file || std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+        LogWarn() << "Could not write system state " << path;
+        std::remove(temporary_path.c_str());
+        return;
+    }
+
+    _entries[snapshot.uuid] = Entry {snapshot, _next_order++};
+}
+
+std::string SystemStateStore::path_of(uint64_t uuid) const
+{
+    // We assume that we already acquired _mutex in this function.
+    std::stringstream path;
+    path << _dir << "/" << FILE_PREFIX << std::hex << uuid << FILE_SUFFIX;
+    return path.str();
+}
+
+std::vector<uint8_t> SystemStateStore::serialize(const Snapshot &snapshot)
+{
+    if (snapshot.component_ids.size() > UINT8_MAX || snapshot.missions.size() > UINT8_MAX) {
+        LogErr() << "Too many components or missions for the system state";
+        return {};
+    }
+
+    std::vector<uint8_t> buffer(MAGIC, MAGIC + sizeof(MAGIC));
+    append(buffer, VERSION);
+    append(buffer, snapshot.uuid);
+    append(buffer, snapshot.system_id);
+    append(buffer, uint8_t(snapshot.component_ids.size()));
+    append(buffer, uint8_t(snapshot.have_autopilot_version ? 1 : 0));
+    append(buffer, uint8_t(snapshot.missions.size()));
+    append(buffer, uint32_t(sizeof(snapshot.autopilot_version)));
+
+    buffer.insert(buffer.end(), snapshot.component_ids.begin(), snapshot.component_ids.end());
+    append(buffer, snapshot.autopilot_version);
+
+    for (const auto &mission : snapshot.missions) {
+        append(buffer, mission.type);
+        append(buffer, uint32_t(mission.item_hashes.size()));
+        append(buffer, mission.hash);
+        for (uint64_t item_hash : mission.item_hashes) {
+            append(buffer, item_hash);
+        }
+    }
+    return buffer;
+}
+
+bool SystemStateStore::read_file(const std::string &path, Snapshot &snapshot)
+{
+#ifdef WINDOWS
+    UNUSED(path);
+    UNUSED(snapshot);
+    return false;
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || size_t(file_stat.st_size) < HEADER_LEN) {
+        ::close(fd);
+        return false;
+    }
+
+    const size_t len = size_t(file_stat.st_size);
+    void *mapping = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid without the descriptor.
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    Reader reader(static_cast<const uint8_t *>(mapping), len);
+    char magic[sizeof(MAGIC)];
+    reader.read_bytes(magic, sizeof(magic));
+    const uint32_t version = reader.read<uint32_t>();
+    snapshot.uuid = reader.read<uint64_t>();
+    snapshot.system_id = reader.read<uint8_t>();
+    const uint8_t num_components = reader.read<uint8_t>();
+    snapshot.have_autopilot_version = (reader.read<uint8_t>() != 0);
+    const uint8_t num_missions = reader.read<uint8_t>();
+    const uint32_t autopilot_version_len = reader.read<uint32_t>();
+
+    bool valid = reader.ok() && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                 version == VERSION &&
+                 autopilot_version_len == sizeof(snapshot.autopilot_version);
+    if (valid) {
+        snapshot.component_ids.resize(num_components);
+        reader.read_bytes(snapshot.component_ids.data(), num_components);
+        reader.read_bytes(&snapshot.autopilot_version, sizeof(snapshot.autopilot_version));
+
+        snapshot.missions.clear();
+        for (unsigned i = 0; i < num_missions && reader.ok(); ++i) {
+            Mission mission;
+            mission.type = reader.read<uint8_t>();
+            const uint32_t num_items = reader.read<uint32_t>();
+            mission.hash = reader.read<uint64_t>();
+            for (uint32_t j = 0; j < num_items && reader.ok(); ++j) {
+                mission.item_hashes.push_back(reader.read<uint64_t>());
+            }
+            snapshot.missions.push_back(std::move(mission));
+        }
+        valid = reader.ok() && reader.at_end() && snapshot.uuid != 0;
+    }
+
+    munmap(mapping, len);
+    return valid;
+#endif
+}
+
+} // namespace dronecore
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "mavlink_include.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace dronecore {
+
+// What was found out about each system in an earlier run, kept in a state
+// directory so that a restarted process knows a system as soon as its first
+// heartbeat comes in, instead of asking for the autopilot version again.
+//
+// Each system has one file "system_<uuid in hex>.state", in host byte order
+// (little endian on all supported platforms):
+//   Header:   magic "DCSY", version (u32), UUID (u64), system id (u8),
+//             number of components (u8), whether there is an autopilot
+//             version (u8), number of missions (u8), length of the autopilot
+//             version (u32).
+//   Then:     the component ids (u8 each), the autopilot version as the
+//             MAVLink struct, and per mission: type (u8), number of items
+//             (u32) and hash (u64), then the hash of each item (u64).
+//
+// A file is written to a temporary name and renamed, so a crash leaves the
+// last complete one. open() maps all files once; a file with another version
+// or length than expected, e.g. from a different dialect, is ignored.
+//
+// Caches of other parts, like params and camera definitions, go into their
+// own subdirectory given by subdir().
+//
+// All methods can be called from any thread.
+class SystemStateStore
+{
+public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t HEADER_LEN = 24;
+
+    struct Mission {
+        uint8_t type;
+        uint64_t hash;
+        std::vector<uint64_t> item_hashes;
+    };
+
+    struct Snapshot {
+        uint64_t uuid = 0;
+        uint8_t system_id = 0;
+        std::vector<uint8_t> component_ids {};
+        bool have_autopilot_version = false;
+        mavlink_autopilot_version_t autopilot_version {};
+        std::vector<Mission> missions {};
+    };
+
+    SystemStateStore();
+    ~SystemStateStore();
+
+    // Loads the snapshots found in dir, which is made if needed. An empty dir
+    // turns the store off again. Returns false if the directory can't be used,
+    // or memory-mapped files are not supported on this platform.
+    bool open(const std::string &dir);
+    bool is_open() const;
+
+    // The subdirectory for the cache of the given name, made if needed,
+    // or an empty string if the store is not open.
+    std::string subdir(const std::string &name) const;
+
+    // Of all snapshots with this system id, the one saved last.
+    bool find_by_system_id(uint8_t system_id, Snapshot &snapshot) const;
+
+    // Writes the file of snapshot.uuid. Does nothing if the store is not open.
+    void save(const Snapshot &snapshot);
+
+    // Non-copyable
+    SystemStateStore(const SystemStateStore &) = delete;
+    const SystemStateStore &operator=(const SystemStateStore &) = delete;
+
+private:
+    struct Entry {
+        Snapshot snapshot;
+        // Saved after all entries with a lower one.
+        uint64_t order;
+    };
+
+    static bool read_file(const std::string &path, Snapshot &snapshot);
+    static std::vector<uint8_t> serialize(const Snapshot &snapshot);
+    std::string path_of(uint64_t uuid) const;
+
+    mutable std::mutex _mutex {};
+    std::string _dir {};
+    std::map<uint64_t, Entry> _entries {};
+    uint64_t _next_order = 0;
+};
+
+} // namespace dronecore
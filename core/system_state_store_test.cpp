@@ -0,0 +1,111 @@
+#include "system_state_store.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+using namespace dronecore;
+
+#ifndef WINDOWS
+
+namespace {
+
+std::string make_temporary_dir()
+{
+    char dir_template[] = "/tmp/dronecore_state_XXXXXX";
+    const char *dir = mkdtemp(dir_template);
+    return (dir != nullptr) ? dir : "";
+}
+
+SystemStateStore::Snapshot make_snapshot(uint64_t uuid, uint8_t system_id)
+{
+    SystemStateStore::Snapshot snapshot;
+    snapshot.uuid = uuid;
+    snapshot.system_id = system_id;
+    snapshot.component_ids = {1, 100};
+    snapshot.have_autopilot_version = true;
+    snapshot.autopilot_version.uid = uuid;
+    snapshot.autopilot_version.capabilities = 0x2c;
+    snapshot.missions.push_back(SystemStateStore::Mission {0, 42, {1, 2, 3}});
+    return snapshot;
+}
+
+} // namespace
+
+TEST(SystemStateStore, RestoresSavedSnapshots)
+{
+    const std::string dir = make_temporary_dir();
+    ASSERT_FALSE(dir.empty());
+
+    {
+        SystemStateStore store;
+        EXPECT_FALSE(store.is_open());
+        ASSERT_TRUE(store.open(dir));
+        EXPECT_TRUE(store.is_open());
+        store.save(make_snapshot(0x1234, 1));
+        store.save(make_snapshot(0x5678, 2));
+    }
+
+    SystemStateStore store;
+    ASSERT_TRUE(store.open(dir));
+
+    SystemStateStore::Snapshot snapshot;
+    ASSERT_TRUE(store.find_by_system_id(2, snapshot));
+    EXPECT_EQ(snapshot.uuid, 0x5678u);
+    EXPECT_EQ(snapshot.component_ids.size(), 2u);
+    EXPECT_TRUE(snapshot.have_autopilot_version);
+    EXPECT_EQ(snapshot.autopilot_version.uid, 0x5678u);
+    EXPECT_EQ(snapshot.autopilot_version.capabilities, 0x2cu);
+    ASSERT_EQ(snapshot.missions.size(), 1u);
+    EXPECT_EQ(snapshot.missions[0].hash, 42u);
+    EXPECT_EQ(snapshot.missions[0].item_hashes.size(), 3u);
+
+    EXPECT_FALSE(store.find_by_system_id(3, snapshot));
+
+    // The one saved last wins if another vehicle took over the system id.
+    store.save(make_snapshot(0x9abc, 1));
+    ASSERT_TRUE(store.find_by_system_id(1, snapshot));
+    EXPECT_EQ(snapshot.uuid, 0x9abcu);
+
+    EXPECT_FALSE(store.subdir("params").empty());
+
+    std::remove((dir + "/system_1234.state").c_str());
+    std::remove((dir + "/system_5678.state").c_str());
+    std::remove((dir + "/system_9abc.state").c_str());
+    std::remove((dir + "/params").c_str());
+    std::remove(dir.c_str());
+}
+
+TEST(SystemStateStore, IgnoresCorruptFiles)
+{
+    const std::string dir = make_temporary_dir();
+    ASSERT_FALSE(dir.empty());
+
+    const std::string path = dir + "/system_1234.state";
+    {
+        SystemStateStore store;
+        ASSERT_TRUE(store.open(dir));
+        store.save(make_snapshot(0x1234, 1));
+    }
+
+    {
+        // Cut off in the middle of the item hashes.
+        std::ifstream in(path, std::ios::binary);
+        std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        in.close();
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << content.substr(0, content.size() - 4);
+    }
+
+    SystemStateStore store;
+    ASSERT_TRUE(store.open(dir));
+    SystemStateStore::Snapshot snapshot;
+    EXPECT_FALSE(store.find_by_system_id(1, snapshot));
+
+    std::remove(path.c_str());
+    std::remove(dir.c_str());
+}
+
+#endif
@@ -1,10 +1,14 @@
 #include "tcp_connection.h"
 #include "global_include.h"
+#include "io_reactor.h"
 #include "log.h"
+#include "thread_roles.h"
 
 #ifndef WINDOWS
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <arpa/inet.h>
 #include <errno.h>
 #include <unistd.h> // for close()
@@ -12,7 +16,8 @@
 #pragma comment(lib, "Ws2_32.lib") // Without this, Ws2_32.lib is not included in static library.
 #endif
 
-#include <cassert>
+#include <algorithm>
+#include <functional>
 
 #ifndef WINDOWS
 #define GET_ERROR(_x) strerror(_x)
@@ -20,15 +25,34 @@
 #define GET_ERROR(_x) WSAGetLastError()
 #endif
 
+// A send to a peer which is gone must not raise SIGPIPE, on macOS this is a
+// socket option instead.
+#if defined(LINUX)
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
 namespace dronecore {
 
+constexpr size_t TcpConnection::MAX_COALESCED_BYTES;
+constexpr size_t TcpConnection::MAX_SEND_BUFFER_BYTES;
+constexpr int TcpConnection::SEND_TIMEOUT_S;
+
 /* change to remote_ip and remote_port */
 TcpConnection::TcpConnection(DroneCoreImpl &parent,
                              const std::string &remote_ip,
-                             int remote_port): Connection(parent),
+                             int remote_port,
+                             const DroneCore::TcpConfig &config): Connection(parent),
     _remote_ip(remote_ip),
     _remote_port_number(remote_port),
-    _should_exit(false) {}
+    _config(config),
+    _should_exit(false)
+{
+    // Otherwise the backoff would never grow.
+    _config.reconnect_min_s = std::max(_config.reconnect_min_s, 0.01);
+    _config.reconnect_max_s = std::max(_config.reconnect_max_s, _config.reconnect_min_s);
+}
 
 TcpConnection::~TcpConnection()
 {
@@ -43,20 +67,40 @@ bool TcpConnection::is_ok() const
 
 ConnectionResult TcpConnection::start()
 {
-    if (!start_mavlink_receiver()) {
-        return ConnectionResult::CONNECTIONS_EXHAUSTED;
-    }
+    start_mavlink_receiver();
 
     ConnectionResult ret = setup_port();
     if (ret != ConnectionResult::SUCCESS) {
         return ret;
     }
 
+    start_send_thread();
     start_recv_thread();
 
     return ConnectionResult::SUCCESS;
 }
 
+ConnectionResult TcpConnection::start(IoReactor &reactor)
+{
+    start_mavlink_receiver();
+
+    ConnectionResult ret = setup_port();
+    if (ret != ConnectionResult::SUCCESS) {
+        return ret;
+    }
+
+    start_send_thread();
+
+    _reactor = &reactor;
+    _in_reactor = true;
+    if (!reactor.add_fd(_socket_fd, std::bind(&TcpConnection::receive_once_from_reactor, this))) {
+        _in_reactor = false;
+        start_recv_thread();
+    }
+
+    return ConnectionResult::SUCCESS;
+}
+
 ConnectionResult TcpConnection::setup_port()
 {
 
@@ -69,38 +113,74 @@ ConnectionResult TcpConnection::setup_port()
     }
 #endif
 
-    _socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+    const int socket_fd = socket(AF_INET, SOCK_STREAM, 0);
 
-    if (_socket_fd < 0) {
+    if (socket_fd < 0) {
         LogErr() << "socket error" << GET_ERROR(errno);
         _is_ok = false;
         return ConnectionResult::SOCKET_ERROR;
     }
 
+    const int no_delay = _config.no_delay ? 1 : 0;
+    if (setsockopt(socket_fd, IPPROTO_TCP, TCP_NODELAY,
+                   reinterpret_cast<const char *>(&no_delay), sizeof(no_delay)) != 0) {
+        LogWarn() << "Could not set TCP_NODELAY: " << GET_ERROR(errno);
+    }
+
+#ifndef WINDOWS
+    struct timeval send_timeout {};
+    send_timeout.tv_sec = SEND_TIMEOUT_S;
+    setsockopt(socket_fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+#endif
+
+#if defined(APPLE)
+    const int no_sigpipe = 1;
+    setsockopt(socket_fd, SOL_SOCKET, SO_NOSIGPIPE, &no_sigpipe, sizeof(no_sigpipe));
+#endif
+
     struct sockaddr_in remote_addr {};
     remote_addr.sin_family = AF_INET;
     remote_addr.sin_port = htons(_remote_port_number);
     remote_addr.sin_addr.s_addr = inet_addr(_remote_ip.c_str());
 
-    if (connect(_socket_fd, reinterpret_cast<sockaddr *>(&remote_addr),
+    if (connect(socket_fd, reinterpret_cast<sockaddr *>(&remote_addr),
                 sizeof(struct sockaddr_in)) < 0) {
         LogErr() << "connect error: " << GET_ERROR(errno);
+#ifndef WINDOWS
+        close(socket_fd);
+#else
+        closesocket(socket_fd);
+#endif
         _is_ok = false;
         return ConnectionResult::SOCKET_CONNECTION_ERROR;
     }
 
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        // Otherwise stop() might have closed the old socket already, but
+        // would then miss this one.
+        if (_should_exit) {
+#ifndef WINDOWS
+            close(socket_fd);
+#else
+            closesocket(socket_fd);
+#endif
+            return ConnectionResult::SOCKET_CONNECTION_ERROR;
+        }
+        _socket_fd = socket_fd;
+    }
+
     _is_ok = true;
     return ConnectionResult::SUCCESS;
 }
 
-void TcpConnection::start_recv_thread()
+void TcpConnection::close_socket()
 {
-    _recv_thread = new std::thread(receive, this);
-}
+    std::lock_guard<std::mutex> lock(_mutex);
 
-ConnectionResult TcpConnection::stop()
-{
-    _should_exit = true;
+    if (_socket_fd < 0) {
+        return;
+    }
 
 #ifndef WINDOWS
     // This should interrupt a recv/recvfrom call.
@@ -112,7 +192,72 @@ ConnectionResult TcpConnection::stop()
     shutdown(_socket_fd, SD_BOTH);
 
     closesocket(_socket_fd);
+#endif
+
+    _socket_fd = -1;
+}
+
+void TcpConnection::start_recv_thread()
+{
+    _recv_thread = new std::thread(receive, this);
+}
+
+void TcpConnection::start_send_thread()
+{
+    if (_config.write_coalesce_s > 0.0) {
+        _send_thread = new std::thread(send_coalesced, this);
+    }
+}
+
+void TcpConnection::request_stop()
+{
+    _should_exit = true;
+
+    {
+        // Taking the lock makes sure that a waiting thread sees _should_exit.
+        std::lock_guard<std::mutex> lock(_send_mutex);
+    }
+    _send_cv.notify_all();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_recv_thread && _socket_fd >= 0) {
+        // Interrupts recv, the socket is closed in stop().
+#ifndef WINDOWS
+        shutdown(_socket_fd, SHUT_RDWR);
+#else
+        shutdown(_socket_fd, SD_BOTH);
+#endif
+    }
+}
+
+ConnectionResult TcpConnection::stop()
+{
+    _should_exit = true;
 
+    stop_outgoing_scheduler();
+
+    if (_reactor) {
+        // This also waits for a receive callback which might still be running.
+        _reactor->remove_fd(_socket_fd);
+        _in_reactor = false;
+        _reactor = nullptr;
+    }
+
+    {
+        // Taking the lock makes sure that a waiting thread sees _should_exit.
+        std::lock_guard<std::mutex> lock(_send_mutex);
+    }
+    _send_cv.notify_all();
+
+    if (_send_thread) {
+        _send_thread->join();
+        delete _send_thread;
+        _send_thread = nullptr;
+    }
+
+    close_socket();
+
+#ifdef WINDOWS
     WSACleanup();
 #endif
 
@@ -122,6 +267,11 @@ ConnectionResult TcpConnection::stop()
         _recv_thread = nullptr;
     }
 
+    {
+        std::lock_guard<std::mutex> lock(_send_mutex);
+        _send_buffer.clear();
+    }
+
     // We need to stop this after stopping the receive thread, otherwise
     // it can happen that we interfere with the parsing of a message.
     stop_mavlink_receiver();
@@ -129,8 +279,10 @@ ConnectionResult TcpConnection::stop()
     return ConnectionResult::SUCCESS;
 }
 
-bool TcpConnection::send_message(const mavlink_message_t &message)
+bool TcpConnection::send_frame(const uint8_t *frame, unsigned frame_len, uint8_t target_system)
 {
+    UNUSED(target_system);
+
     if (_remote_ip.empty()) {
         LogErr() << "Remote IP unknown";
         return false;
@@ -141,67 +293,176 @@ bool TcpConnection::send_message(const mavlink_message_t &message)
         return false;
     }
 
-    struct sockaddr_in dest_addr {};
-    dest_addr.sin_family = AF_INET;
-
-    inet_pton(AF_INET, _remote_ip.c_str(), &dest_addr.sin_addr.s_addr);
+    if (!_is_ok) {
+        return false;
+    }
 
-    dest_addr.sin_port = htons(_remote_port_number);
+    if (_config.write_coalesce_s <= 0.0) {
+        return send_now(frame, frame_len);
+    }
 
-    uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
-    uint16_t buffer_len = mavlink_msg_to_send_buffer(buffer, &message);
+    {
+        std::lock_guard<std::mutex> lock(_send_mutex);
 
-    // TODO: remove this assert again
-    assert(buffer_len <= MAVLINK_MAX_PACKET_LEN);
+        if (_send_buffer.size() + frame_len > MAX_SEND_BUFFER_BYTES) {
+            return false;
+        }
 
-    int send_len = sendto(_socket_fd, reinterpret_cast<char *>(buffer), buffer_len, 0,
-                          reinterpret_cast<const sockaddr *>(&dest_addr), sizeof(dest_addr));
+        const bool was_empty = _send_buffer.empty();
+        if (was_empty) {
+            _flush_time = clock::now() + std::chrono::duration_cast<clock::duration>(
+                              std::chrono::duration<double>(_config.write_coalesce_s));
+        }
+        _send_buffer.insert(_send_buffer.end(), frame, frame + frame_len);
 
-    if (send_len != buffer_len) {
-        LogErr() << "sendto failure: " << GET_ERROR(errno);
-        _is_ok = false;
-        return false;
+        // Otherwise the send thread is waiting for the flush time already.
+        if (!was_empty && _send_buffer.size() < MAX_COALESCED_BYTES) {
+            return true;
+        }
     }
+    _send_cv.notify_one();
     return true;
 }
 
-void TcpConnection::receive(TcpConnection *parent)
+bool TcpConnection::send_now(const uint8_t *data, size_t data_len)
 {
-    // Enough for MTU 1500 bytes.
-    char buffer[2048];
-
-    while (!parent->_should_exit) {
+    std::lock_guard<std::mutex> lock(_mutex);
 
-        if (!parent->_is_ok) {
-            LogErr() << "TCP receive error, trying to reconnect...";
-            std::this_thread::sleep_for(std::chrono::seconds(1));
-            parent->setup_port();
+    size_t num_sent = 0;
+    while (num_sent < data_len) {
+        const auto send_len = send(_socket_fd, reinterpret_cast<const char *>(data + num_sent),
+                                   data_len - num_sent, SEND_FLAGS);
+        if (send_len < 0 && errno == EINTR) {
+            continue;
+        }
+        if (send_len <= 0) {
+            LogErr() << "send failure: " << GET_ERROR(errno);
+            _is_ok = false;
+            // The receive side then notices it too and reconnects.
+#ifndef WINDOWS
+            shutdown(_socket_fd, SHUT_RDWR);
+#else
+            shutdown(_socket_fd, SD_BOTH);
+#endif
+            return false;
         }
+        num_sent += size_t(send_len);
+    }
+    return true;
+}
 
-        int recv_len = recv(parent->_socket_fd, buffer, sizeof(buffer), 0);
+void TcpConnection::send_coalesced(TcpConnection *parent)
+{
+    ThreadRoles::apply_to_this_thread(DroneCore::ThreadRole::SEND, "tcp_send");
 
-        if (recv_len == 0) {
-            // This can happen when shutdown is called on the socket,
-            // therefore we check _should_exit again.
-            parent->_is_ok = false;
+    std::unique_lock<std::mutex> lock(parent->_send_mutex);
+
+    while (!parent->_should_exit) {
+        if (parent->_send_buffer.empty()) {
+            parent->_send_cv.wait(lock);
             continue;
         }
 
-        if (recv_len < 0) {
-            // This happens on desctruction when close(_socket_fd) is called,
-            // therefore be quiet.
-            //LogErr() << "recvfrom error: " << GET_ERROR(errno);
-            // Something went wrong, we should try to re-connect in next iteration.
-            parent->_is_ok = false;
+        if (parent->_send_buffer.size() < MAX_COALESCED_BYTES &&
+            clock::now() < parent->_flush_time) {
+            parent->_send_cv.wait_until(lock, parent->_flush_time);
             continue;
         }
 
-        parent->_mavlink_receiver->set_new_datagram(buffer, recv_len);
+        // New frames can be added while these are sent.
+        parent->_sending_buffer.swap(parent->_send_buffer);
+        lock.unlock();
+        parent->send_now(parent->_sending_buffer.data(), parent->_sending_buffer.size());
+        parent->_sending_buffer.clear();
+        lock.lock();
+    }
+}
+
+void TcpConnection::receive(TcpConnection *parent)
+{
+    ThreadRoles::apply_to_this_thread(DroneCore::ThreadRole::RECEIVE, "tcp_receive");
+
+    double wait_s = parent->_config.reconnect_min_s;
+    bool is_reconnecting = false;
+
+    while (!parent->_should_exit) {
 
-        // Parse all mavlink messages in one data packet. Once exhausted, we'll exit while.
-        while (parent->_mavlink_receiver->parse_message()) {
-            parent->receive_message(parent->_mavlink_receiver->get_last_message());
+        if (!parent->_is_ok) {
+            if (!is_reconnecting) {
+                LogWarn() << "TCP connection to " << parent->_remote_ip << ":"
+                          << parent->_remote_port_number << " lost, reconnecting";
+                is_reconnecting = true;
+            }
+            // The peer is to see right away that the old connection is gone.
+            parent->close_socket();
+
+            if (!parent->wait_to_reconnect(wait_s)) {
+                break;
+            }
+            if (parent->setup_port() != ConnectionResult::SUCCESS) {
+                wait_s = std::min(wait_s * 2.0, parent->_config.reconnect_max_s);
+                continue;
+            }
+
+            LogInfo() << "TCP connection to " << parent->_remote_ip << ":"
+                      << parent->_remote_port_number << " restored";
+            wait_s = parent->_config.reconnect_min_s;
+            is_reconnecting = false;
         }
+
+        parent->receive_once();
+    }
+}
+
+bool TcpConnection::wait_to_reconnect(double wait_s)
+{
+    std::unique_lock<std::mutex> lock(_send_mutex);
+    return !_send_cv.wait_for(lock, std::chrono::duration<double>(wait_s), [this]() {
+        return bool(_should_exit);
+    });
+}
+
+void TcpConnection::receive_once_from_reactor()
+{
+    receive_once();
+
+    if (!_is_ok && !_should_exit && _in_reactor.exchange(false)) {
+        // Reconnecting involves waiting, so we must not do it on the reactor
+        // thread. Instead, the receive thread takes over from here.
+        _reactor->remove_fd(_socket_fd);
+        start_recv_thread();
+    }
+}
+
+void TcpConnection::receive_once()
+{
+    // Enough for MTU 1500 bytes.
+    char buffer[2048];
+
+    int recv_len = recv(_socket_fd, buffer, sizeof(buffer), 0);
+
+    if (recv_len == 0) {
+        // This can happen when shutdown is called on the socket,
+        // therefore we check _should_exit again.
+        _is_ok = false;
+        return;
+    }
+
+    if (recv_len < 0) {
+        // This happens on desctruction when close(_socket_fd) is called,
+        // therefore be quiet.
+        //LogErr() << "recvfrom error: " << GET_ERROR(errno);
+        // Something went wrong, we should try to re-connect in next iteration.
+        _is_ok = false;
+        return;
+    }
+
+    _mavlink_receiver->set_new_datagram(buffer, recv_len);
+    TimeBatch time_batch;
+
+    // Parse all mavlink messages in one data packet. Once exhausted, we'll exit while.
+    while (_mavlink_receiver->parse_message()) {
+        receive_message(_mavlink_receiver->get_last_message_view());
     }
 }
 
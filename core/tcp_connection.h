@@ -2,6 +2,10 @@
 
 #include <mutex>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+#include <vector>
 #include "connection.h"
 #include <sys/types.h>
 #ifndef WINDOWS
@@ -15,35 +19,79 @@
 
 namespace dronecore {
 
+// Once the connection breaks, the receive thread connects it again with an
+// exponential backoff, see DroneCore::TcpConfig.
+//
+// With write coalescing, frames are collected and sent together by a thread
+// of their own once the first of them waited long enough, or once they fill
+// a segment.
 class TcpConnection : public Connection
 {
 public:
     explicit TcpConnection(DroneCoreImpl &parent,
                            const std::string &remote_ip,
-                           int remote_port);
+                           int remote_port,
+                           const DroneCore::TcpConfig &config = DroneCore::TcpConfig());
     ~TcpConnection();
     bool is_ok() const;
     ConnectionResult start();
+    ConnectionResult start(IoReactor &reactor);
     ConnectionResult stop();
+    void request_stop() override;
 
-    bool send_message(const mavlink_message_t &message);
+    // Returns false while the connection is broken, the frame is dropped then.
+    bool send_frame(const uint8_t *frame, unsigned frame_len, uint8_t target_system) override;
 
     // Non-copyable
     TcpConnection(const TcpConnection &) = delete;
     const TcpConnection &operator=(const TcpConnection &) = delete;
 
 private:
+    typedef std::chrono::steady_clock clock;
+
+    // Connects a new socket and replaces the old one with it.
     ConnectionResult setup_port();
+    void close_socket();
     void start_recv_thread();
+    void start_send_thread();
     int resolve_address(const std::string &ip_address, int port, struct sockaddr_in *addr);
     static void receive(TcpConnection *parent);
+    // Returns false if the connection was stopped while waiting.
+    bool wait_to_reconnect(double wait_s);
+    void receive_once();
+    void receive_once_from_reactor();
+    static void send_coalesced(TcpConnection *parent);
+    bool send_now(const uint8_t *data, size_t data_len);
+
+    // About what fits into one segment.
+    static constexpr size_t MAX_COALESCED_BYTES = 1400;
+    // Beyond that, frames are dropped while the socket is stuck.
+    static constexpr size_t MAX_SEND_BUFFER_BYTES = 65536;
+    // Also for connect(), so that a dead peer does not hold up reconnecting or stop().
+    static constexpr int SEND_TIMEOUT_S = 2;
 
     std::string _remote_ip = {};
     int _remote_port_number;
+    DroneCore::TcpConfig _config {};
 
+    // Held while the socket is used to send, or replaced.
     std::mutex _mutex = {};
     int _socket_fd = -1;
 
+    // Also used to wake up the receive thread waiting to reconnect on stop().
+    std::mutex _send_mutex {};
+    std::condition_variable _send_cv {};
+    std::vector<uint8_t> _send_buffer {};
+    // When the first frame in _send_buffer has waited long enough.
+    clock::time_point _flush_time {};
+    // Only used by the send thread.
+    std::vector<uint8_t> _sending_buffer {};
+    std::thread *_send_thread = nullptr;
+
+    IoReactor *_reactor = nullptr;
+    // Cleared once the link broke and the receive thread took over reconnecting.
+    std::atomic_bool _in_reactor {false};
+
     std::thread *_recv_thread = nullptr;
     std::atomic_bool _should_exit;
     std::atomic_bool _is_ok {false};
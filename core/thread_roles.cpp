@@ -0,0 +1,167 @@
+#include "thread_roles.h"
+#include "global_include.h"
+#include "log.h"
+#include "trace_recorder.h"
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+
+#if defined(LINUX) || defined(APPLE)
+#include <pthread.h>
+#endif
+#if defined(LINUX)
+#include <sched.h>
+#endif
+
+namespace dronecore {
+
+namespace {
+
+struct Registry {
+    std::mutex mutex {};
+    std::map<DroneCore::ThreadRole, DroneCore::ThreadConfig> configs {};
+};
+
+Registry &registry()
+{
+    // Never destroyed, threads might still start while statics are torn down.
+    static Registry *registry = new Registry();
+    return *registry;
+}
+
+std::atomic<unsigned> num_running_threads {0};
+
+// Counts the thread for as long as it runs.
+struct RunningThread {
+    RunningThread() { ++num_running_threads; }
+    ~RunningThread() { --num_running_threads; }
+};
+
+} // namespace
+
+void ThreadRoles::set_config(DroneCore::ThreadRole role, const DroneCore::ThreadConfig &config)
+{
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.configs[role] = config;
+}
+
+void ThreadRoles::apply_to_this_thread(DroneCore::ThreadRole role, const char *default_name)
+{
+    static thread_local RunningThread running_thread;
+    UNUSED(running_thread);
+
+    TraceRecorder::set_thread_name(default_name);
+
+    DroneCore::ThreadConfig config {};
+    bool has_config = false;
+    {
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        auto it = reg.configs.find(role);
+        if (it != reg.configs.end()) {
+            config = it->second;
+            has_config = true;
+        }
+    }
+
+    set_name(config.name.empty() ? default_name : config.name.c_str());
+    if (!has_config) {
+        return;
+    }
+    set_cpus(role, config.cpus);
+    set_scheduling(role, config.policy, config.priority);
+}
+
+unsigned ThreadRoles::num_running()
+{
+    return num_running_threads.load();
+}
+
+const char *ThreadRoles::role_str(DroneCore::ThreadRole role)
+{
+    switch (role) {
+        case DroneCore::ThreadRole::RECEIVE:
+            return "receive";
+        case DroneCore::ThreadRole::DISPATCH:
+            return "dispatch";
+        case DroneCore::ThreadRole::CALLBACK:
+            return "callback";
+        case DroneCore::ThreadRole::WORK:
+            return "work";
+        case DroneCore::ThreadRole::SEND:
+            return "send";
+        case DroneCore::ThreadRole::OFFBOARD:
+            return "offboard";
+        case DroneCore::ThreadRole::HTTP:
+            return "http";
+        case DroneCore::ThreadRole::LOGGING:
+            return "logging";
+        default:
+            return "unknown";
+    }
+}
+
+void ThreadRoles::set_name(const char *name)
+{
+    // Longer names are refused, not cut.
+    char short_name[16] {};
+    strncpy(short_name, name, sizeof(short_name) - 1);
+
+#if defined(LINUX)
+    pthread_setname_np(pthread_self(), short_name);
+#elif defined(APPLE)
+    pthread_setname_np(short_name);
+#else
+    UNUSED(short_name);
+#endif
+}
+
+void ThreadRoles::set_cpus(DroneCore::ThreadRole role, const std::vector<unsigned> &cpus)
+{
+    if (cpus.empty()) {
+        return;
+    }
+
+#if defined(LINUX)
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (unsigned cpu : cpus) {
+        CPU_SET(cpu, &cpu_set);
+    }
+    const int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+    if (ret != 0) {
+        LogWarn() << "Could not set CPUs of " << role_str(role) << " thread: " << strerror(ret);
+    }
+#else
+    LogWarn() << "CPUs of " << role_str(role) << " thread not set, only supported on Linux";
+#endif
+}
+
+void ThreadRoles::set_scheduling(DroneCore::ThreadRole role, DroneCore::ThreadPolicy policy,
+                                 int priority)
+{
+    if (policy == DroneCore::ThreadPolicy::NORMAL) {
+        return;
+    }
+
+#if defined(LINUX)
+    sched_param param {};
+    param.sched_priority = priority;
+    const int ret = pthread_setschedparam(pthread_self(),
+                                          (policy == DroneCore::ThreadPolicy::FIFO) ?
+                                          SCHED_FIFO : SCHED_RR,
+                                          &param);
+    if (ret != 0) {
+        LogWarn() << "Could not set priority " << priority << " of " << role_str(role)
+                  << " thread: " << strerror(ret);
+    }
+#else
+    UNUSED(priority);
+    LogWarn() << "Scheduling of " << role_str(role) << " thread not set, only supported on Linux";
+#endif
+}
+
+} // namespace dronecore
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "dronecore.h"
+
+namespace dronecore {
+
+// Keeps the thread config of each role for the whole process, as set with
+// DroneCore::set_thread_config(), and applies it to threads as they start.
+class ThreadRoles
+{
+public:
+    static void set_config(DroneCore::ThreadRole role, const DroneCore::ThreadConfig &config);
+
+    // To be called first thing by every thread DroneCore starts. The name is
+    // used if the config has none, and always for traces, so it needs to be a
+    // string literal.
+    static void apply_to_this_thread(DroneCore::ThreadRole role, const char *default_name);
+
+    // Threads which called apply_to_this_thread() and have not exited yet.
+    static unsigned num_running();
+
+    static const char *role_str(DroneCore::ThreadRole role);
+
+private:
+    static void set_name(const char *name);
+    static void set_cpus(DroneCore::ThreadRole role, const std::vector<unsigned> &cpus);
+    static void set_scheduling(DroneCore::ThreadRole role, DroneCore::ThreadPolicy policy,
+                               int priority);
+};
+
+} // namespace dronecore
@@ -0,0 +1,72 @@
+#include "thread_roles.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+
+#if defined(LINUX)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace dronecore;
+
+#if defined(LINUX)
+TEST(ThreadRoles, AppliesNameAndCpus)
+{
+    DroneCore::ThreadConfig config {};
+    config.name = "a_rather_long_thread_name";
+    config.cpus = {0};
+    config.policy = DroneCore::ThreadPolicy::NORMAL;
+    config.priority = 0;
+    ThreadRoles::set_config(DroneCore::ThreadRole::HTTP, config);
+
+    std::string name;
+    bool only_on_cpu_0 = false;
+    std::thread thread([&name, &only_on_cpu_0]() {
+        ThreadRoles::apply_to_this_thread(DroneCore::ThreadRole::HTTP, "http_loader");
+
+        char buffer[16] {};
+        pthread_getname_np(pthread_self(), buffer, sizeof(buffer));
+        name = buffer;
+
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        pthread_getaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+        only_on_cpu_0 = CPU_ISSET(0, &cpu_set) && CPU_COUNT(&cpu_set) == 1;
+    });
+    thread.join();
+
+    // Cut to what the OS takes.
+    EXPECT_EQ(name, "a_rather_long_t");
+    EXPECT_TRUE(only_on_cpu_0);
+
+    // Back to the default name, the other threads are not bothered.
+    ThreadRoles::set_config(DroneCore::ThreadRole::HTTP, DroneCore::ThreadConfig {});
+    thread = std::thread([&name]() {
+        ThreadRoles::apply_to_this_thread(DroneCore::ThreadRole::HTTP, "http_loader");
+
+        char buffer[16] {};
+        pthread_getname_np(pthread_self(), buffer, sizeof(buffer));
+        name = buffer;
+    });
+    thread.join();
+    EXPECT_EQ(name, "http_loader");
+}
+#endif
+
+TEST(ThreadRoles, CountsRunningThreads)
+{
+    const unsigned num_before = ThreadRoles::num_running();
+
+    unsigned num_while_running = 0;
+    std::thread thread([&num_while_running]() {
+        ThreadRoles::apply_to_this_thread(DroneCore::ThreadRole::HTTP, "http_loader");
+        // Only counted once, however often it is applied.
+        ThreadRoles::apply_to_this_thread(DroneCore::ThreadRole::HTTP, "http_loader");
+        num_while_running = ThreadRoles::num_running();
+    });
+    thread.join();
+
+    EXPECT_EQ(num_while_running, num_before + 1);
+    EXPECT_EQ(ThreadRoles::num_running(), num_before);
+}
@@ -11,18 +11,16 @@ TimeoutHandler::~TimeoutHandler()
 {
 }
 
-void TimeoutHandler::add(std::function<void()> callback, double duration_s, void **cookie)
+void TimeoutHandler::add(Callback<void()> callback, double duration_s, void **cookie)
 {
-    auto new_timeout = std::make_shared<Timeout>();
-    new_timeout->callback = callback;
-    new_timeout->time = _time.steady_time_in_future(duration_s);
-    new_timeout->duration_s = duration_s;
-
-    void *new_cookie = static_cast<void *>(new_timeout.get());
-
+    void *new_cookie;
     {
         std::lock_guard<std::mutex> lock(_timeouts_mutex);
-        _timeouts.insert(std::pair<void *, std::shared_ptr<Timeout>>(new_cookie, new_timeout));
+
+        const size_t slot = _timeouts.add(Timeout {std::move(callback),
+                                                   _time.steady_time_in_future(duration_s),
+                                                   duration_s});
+        new_cookie = _timeouts.cookie_of(slot);
     }
 
     if (cookie != nullptr) {
@@ -34,10 +32,17 @@ void TimeoutHandler::refresh(const void *cookie)
 {
     std::lock_guard<std::mutex> lock(_timeouts_mutex);
 
-    auto it = _timeouts.find(const_cast<void *>(cookie));
-    if (it != _timeouts.end()) {
-        dl_time_t future_time = _time.steady_time_in_future(it->second->duration_s);
-        it->second->time = future_time;
+    size_t slot;
+    if (_timeouts.find(cookie, slot)) {
+        Timeout &timeout = _timeouts[slot];
+        // Refreshed for each message, so the time of the batch is good enough.
+        // It can be older than the time of the last refresh on another thread.
+        dl_time_t deadline = _time.cached_steady_time();
+        _time.shift_steady_time_by(deadline, timeout.duration_s);
+        if (deadline > timeout.deadline) {
+            timeout.deadline = deadline;
+            _timeouts.update(slot);
+        }
     }
 }
 
@@ -45,9 +50,9 @@ void TimeoutHandler::remove(const void *cookie)
 {
     std::lock_guard<std::mutex> lock(_timeouts_mutex);
 
-    auto it = _timeouts.find(const_cast<void *>(cookie));
-    if (it != _timeouts.end()) {
-        _timeouts.erase(const_cast<void *>(cookie));
+    size_t slot;
+    if (_timeouts.find(cookie, slot)) {
+        _timeouts.remove(slot);
     }
 }
 
@@ -55,33 +60,44 @@ void TimeoutHandler::run_once()
 {
     _timeouts_mutex.lock();
 
-    dl_time_t now = _time.steady_time();
-
-    for (auto it = _timeouts.begin(); it != _timeouts.end(); /* no ++it */) {
+    dl_time_t now = _time.cached_steady_time();
 
-        // If time is passed, call timeout callback.
-        if (it->second->time < now) {
+    // If time is passed, call timeout callback.
+    while (!_timeouts.empty() && _timeouts[_timeouts.front()].deadline < now) {
 
-            if (it->second->callback) {
+        const size_t slot = _timeouts.front();
 
-                // Get a copy for the callback because we will remove it.
-                std::function<void()> callback = it->second->callback;
+        // Get the callback out because we will remove it.
+        Callback<void()> callback = std::move(_timeouts[slot].callback);
 
-                // Self-destruct before calling to avoid locking issues.
-                _timeouts.erase(it++);
+        // Self-destruct before calling to avoid locking issues.
+        _timeouts.remove(slot);
 
-                // Unlock while we callback because it might in turn want to add timeouts.
-                _timeouts_mutex.unlock();
-                callback();
-                _timeouts_mutex.lock();
-            }
-
-
-        } else {
-            ++it;
+        if (callback) {
+            // Unlock while we callback because it might in turn want to add timeouts.
+            _timeouts_mutex.unlock();
+            callback();
+            _timeouts_mutex.lock();
         }
     }
     _timeouts_mutex.unlock();
 }
 
+bool TimeoutHandler::next_deadline(dl_time_t &deadline)
+{
+    std::lock_guard<std::mutex> lock(_timeouts_mutex);
+
+    if (_timeouts.empty()) {
+        return false;
+    }
+    deadline = _timeouts[_timeouts.front()].deadline;
+    return true;
+}
+
+size_t TimeoutHandler::size()
+{
+    std::lock_guard<std::mutex> lock(_timeouts_mutex);
+    return _timeouts.size();
+}
+
 } // namespace dronecore
@@ -1,10 +1,12 @@
 #pragma once
 
 #include <mutex>
-#include <memory>
+#include <cstdint>
 #include <functional>
-#include <map>
+#include <vector>
+#include "deadline_heap.h"
 #include "global_include.h"
+#include "inplace_function.h"
 
 namespace dronecore {
 
@@ -20,20 +22,27 @@ public:
     TimeoutHandler &operator=(TimeoutHandler const &) = delete; // Copy assign
     TimeoutHandler &operator=(TimeoutHandler &&) = delete;      // Move assign
 
-    void add(std::function<void()> callback, double duration_s, void **cookie);
+    // The cookie is an opaque handle for refresh() and remove(). It stays valid
+    // until the timeout fired or got removed, and is never reused after that.
+    void add(Callback<void()> callback, double duration_s, void **cookie);
     void refresh(const void *cookie);
     void remove(const void *cookie);
 
     void run_once();
 
+    // Returns false if there are no timeouts.
+    bool next_deadline(dl_time_t &deadline);
+
+    size_t size();
+
 private:
     struct Timeout {
-        std::function<void()> callback;
-        dl_time_t time;
+        Callback<void()> callback;
+        dl_time_t deadline;
         double duration_s;
     };
 
-    std::map<void *, std::shared_ptr<Timeout>> _timeouts {};
+    DeadlineHeap<Timeout> _timeouts {};
     std::mutex _timeouts_mutex {};
 
     Time &_time;
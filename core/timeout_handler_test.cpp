@@ -1,6 +1,7 @@
 #include "timeout_handler.h"
 #include <gtest/gtest.h>
 #include <atomic>
+#include <vector>
 
 #ifdef FAKE_TIME
 #define Time FakeTime
@@ -148,3 +149,78 @@ TEST(TimeoutHandler, TimeoutRemovedDuringCallback)
     th.run_once();
     EXPECT_TRUE(timeout_happened);
 }
+
+TEST(TimeoutHandler, OldCookieIsIgnored)
+{
+    Time time {};
+    TimeoutHandler th(time);
+
+    void *old_cookie = nullptr;
+    th.add([]() {}, 0.5, &old_cookie);
+    th.remove(old_cookie);
+
+    // This one is likely to get the same slot as the old one.
+    bool timeout_happened = false;
+    void *cookie = nullptr;
+    th.add([&timeout_happened]() {
+        timeout_happened = true;
+    }, 0.5, &cookie);
+    EXPECT_NE(old_cookie, cookie);
+
+    th.remove(old_cookie);
+    time.sleep_for(std::chrono::milliseconds(600));
+    th.run_once();
+    EXPECT_TRUE(timeout_happened);
+}
+
+TEST(TimeoutHandler, FiresInOrder)
+{
+    Time time {};
+    TimeoutHandler th(time);
+
+    std::vector<int> order;
+    for (int i = 9; i >= 0; --i) {
+        th.add([&order, i]() {
+            order.push_back(i);
+        }, 0.1 * (i + 1), nullptr);
+    }
+
+    time.sleep_for(std::chrono::milliseconds(1100));
+    th.run_once();
+    ASSERT_EQ(order.size(), 10u);
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_EQ(order[i], i);
+    }
+}
+
+TEST(TimeoutHandler, ScalesToThousandsOfTimeouts)
+{
+    for (unsigned num_timeouts : {100u, 1000u, 10000u}) {
+        FakeTime time {};
+        TimeoutHandler th(time);
+
+        unsigned num_timed_out = 0;
+        std::vector<void *> cookies(num_timeouts);
+
+        for (unsigned i = 0; i < num_timeouts; ++i) {
+            th.add([&num_timed_out]() {
+                ++num_timed_out;
+            }, 1.0 + 0.001 * (i % 100), &cookies[i]);
+        }
+
+        // Like heartbeats, every timeout gets refreshed over and over again.
+        const unsigned num_rounds = 10;
+        for (unsigned round = 0; round < num_rounds; ++round) {
+            time.sleep_for(std::chrono::milliseconds(500));
+            for (void *cookie : cookies) {
+                th.refresh(cookie);
+            }
+            th.run_once();
+        }
+        EXPECT_EQ(num_timed_out, 0u);
+
+        time.sleep_for(std::chrono::milliseconds(1200));
+        th.run_once();
+        EXPECT_EQ(num_timed_out, num_timeouts);
+    }
+}
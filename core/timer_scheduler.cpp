@@ -0,0 +1,238 @@
+#include "timer_scheduler.h"
+#include "simulated_clock.h"
+#include "thread_roles.h"
+#include <algorithm>
+
+namespace dronecore {
+
+TimerScheduler &TimerScheduler::Instance()
+{
+    static TimerScheduler instance;
+    return instance;
+}
+
+TimerScheduler::TimerScheduler() :
+    _epoch(std::chrono::steady_clock::now())
+{
+    _thread = new std::thread(&TimerScheduler::run, this);
+}
+
+TimerScheduler::~TimerScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _should_exit = true;
+    }
+    _cv.notify_one();
+
+    if (_thread != nullptr) {
+        _thread->join();
+        delete _thread;
+        _thread = nullptr;
+    }
+}
+
+TimerScheduler::timer_id_t TimerScheduler::add(TimerWheel::callback_t callback,
+                                               dl_time_t deadline)
+{
+    bool wake_up = false;
+    timer_id_t id;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        const TimerWheel::tick_t tick = tick_at_or_after(deadline);
+        id = _wheel.add(tick, std::move(callback));
+
+        // Only wake up the thread if it would otherwise sleep past this one.
+        if (_wakeup_tick == 0 || tick < _wakeup_tick) {
+            _wakeup_tick = tick;
+            wake_up = true;
+        }
+    }
+
+    if (wake_up) {
+        _cv.notify_one();
+    }
+    return id;
+}
+
+void TimerScheduler::cancel(timer_id_t id)
+{
+    if (id == 0) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (cancel_pending_locked(id)) {
+        return;
+    }
+
+    if (_running_thread == std::this_thread::get_id()) {
+        return;
+    }
+    _running_cv.wait(lock, [this, id]() { return _running_id != id; });
+}
+
+bool TimerScheduler::cancel_if_pending(timer_id_t id)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return cancel_pending_locked(id);
+}
+
+bool TimerScheduler::cancel_pending_locked(timer_id_t id)
+{
+    // We assume that we already acquired _mutex in this function.
+
+    if (_wheel.cancel(id)) {
+        return true;
+    }
+
+    // It might have been taken out of the wheel already but still be waiting for
+    // its turn.
+    for (auto &entry : _due) {
+        if (entry.first == id && entry.second) {
+            entry.second = nullptr;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TimerScheduler::is_pending(timer_id_t id) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_wheel.contains(id)) {
+        return true;
+    }
+    for (const auto &entry : _due) {
+        if (entry.first == id && entry.second) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TimerScheduler::is_scheduler_thread() const
+{
+    return _thread != nullptr && std::this_thread::get_id() == _thread->get_id();
+}
+
+uint64_t TimerScheduler::run_until(dl_time_t time)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    uint64_t num_run = 0;
+
+    TimerWheel::tick_t next_tick;
+    while (_wheel.next_expiry(next_tick) && time_of_tick(next_tick) <= time) {
+        // The expiry can be early, then the wheel just moves on to the next one.
+        next_tick = std::max(next_tick, tick_at_or_before(SimulatedClock::now()));
+        SimulatedClock::move_to(time_of_tick(next_tick));
+        _wheel.advance(next_tick, _due);
+        num_run += run_due(lock);
+    }
+
+    SimulatedClock::move_to(time);
+    return num_run;
+}
+
+void TimerScheduler::switch_clock(dl_time_t from, dl_time_t to)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (from > to) {
+            _epoch -= from - to;
+        }
+        _wakeup_tick = 0;
+    }
+    _cv.notify_one();
+}
+
+void TimerScheduler::run()
+{
+    ThreadRoles::apply_to_this_thread(DroneCore::ThreadRole::WORK, "timer_scheduler");
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (!_should_exit) {
+
+        if (SimulatedClock::is_enabled()) {
+            // The timers are run by run_until() instead.
+            _wakeup_tick = 0;
+            _cv.wait(lock);
+            continue;
+        }
+
+        _wheel.advance(tick_at_or_before(now()), _due);
+        run_due(lock);
+
+        TimerWheel::tick_t next_tick;
+        if (_wheel.next_expiry(next_tick)) {
+            _wakeup_tick = next_tick;
+            _cv.wait_until(lock, time_of_tick(next_tick));
+        } else {
+            _wakeup_tick = 0;
+            _cv.wait(lock);
+        }
+    }
+}
+
+uint64_t TimerScheduler::run_due(std::unique_lock<std::mutex> &lock)
+{
+    uint64_t num_run = 0;
+    // The timers of one tick share the time it is read at.
+    TimeBatch time_batch;
+
+    while (!_due.empty()) {
+        // Run them in order but leave the rest in _due so that they can
+        // still be cancelled meanwhile.
+        const timer_id_t id = _due.front().first;
+        TimerWheel::callback_t callback = std::move(_due.front().second);
+        _due.erase(_due.begin());
+
+        if (callback) {
+            _running_id = id;
+            _running_thread = std::this_thread::get_id();
+            lock.unlock();
+            callback();
+            // Whatever it holds goes before cancel() returns.
+            callback = nullptr;
+            lock.lock();
+            _running_id = 0;
+            _running_thread = std::thread::id();
+            _running_cv.notify_all();
+            ++num_run;
+        }
+    }
+    return num_run;
+}
+
+dl_time_t TimerScheduler::now()
+{
+    return SimulatedClock::is_enabled() ? SimulatedClock::now() : std::chrono::steady_clock::now();
+}
+
+TimerWheel::tick_t TimerScheduler::tick_at_or_after(dl_time_t time) const
+{
+    if (time <= _epoch) {
+        return 0;
+    }
+    auto since_epoch = std::chrono::duration_cast<std::chrono::microseconds>(time - _epoch);
+    return TimerWheel::tick_t((since_epoch.count() + 999) / 1000);
+}
+
+TimerWheel::tick_t TimerScheduler::tick_at_or_before(dl_time_t time) const
+{
+    if (time <= _epoch) {
+        return 0;
+    }
+    auto since_epoch = std::chrono::duration_cast<std::chrono::milliseconds>(time - _epoch);
+    return TimerWheel::tick_t(since_epoch.count());
+}
+
+dl_time_t TimerScheduler::time_of_tick(TimerWheel::tick_t tick) const
+{
+    return _epoch + std::chrono::milliseconds(tick);
+}
+
+} // namespace dronecore
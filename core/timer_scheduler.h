@@ -0,0 +1,93 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "global_include.h"
+#include "timer_wheel.h"
+
+namespace dronecore {
+
+// Process-wide scheduler which runs timer callbacks on one thread. The thread
+// sleeps until the next deadline instead of polling, deadlines have a
+// resolution of one millisecond.
+//
+// With the SimulatedClock enabled, the thread runs nothing, the timers are run
+// by run_until() instead.
+class TimerScheduler
+{
+public:
+    typedef TimerWheel::timer_id_t timer_id_t;
+
+    static TimerScheduler &Instance();
+
+    // The callback is called once on the scheduler thread at or after the deadline.
+    timer_id_t add(TimerWheel::callback_t callback, dl_time_t deadline);
+
+    // Once this returns, the callback is not running and won't get started
+    // anymore. If it is running, this waits for it, unless called from within it.
+    // So it must not be called with a lock held which the callback takes.
+    void cancel(timer_id_t id);
+    // Never waits: returns true if the callback was cancelled before it started,
+    // false if it has started or is done already.
+    bool cancel_if_pending(timer_id_t id);
+    // True until the callback is started.
+    bool is_pending(timer_id_t id) const;
+
+    bool is_scheduler_thread() const;
+
+    // Runs the timers due until the time on the calling thread, moving the
+    // SimulatedClock along to each of them. Returns the number of timers run.
+    uint64_t run_until(dl_time_t time);
+
+    // Non-copyable
+    TimerScheduler(const TimerScheduler &) = delete;
+    const TimerScheduler &operator=(const TimerScheduler &) = delete;
+
+private:
+    TimerScheduler();
+    ~TimerScheduler();
+
+    void run();
+    // We assume that lock is held, it is released while a callback runs.
+    uint64_t run_due(std::unique_lock<std::mutex> &lock);
+    // We assume that _mutex is held.
+    bool cancel_pending_locked(timer_id_t id);
+    static dl_time_t now();
+
+    friend class SimulatedClock;
+    // Called when the SimulatedClock goes on or off. Going back to the steady
+    // clock, the wheel is moved to it, pending timers keep the time they had left.
+    void switch_clock(dl_time_t from, dl_time_t to);
+
+    TimerWheel::tick_t tick_at_or_after(dl_time_t time) const;
+    TimerWheel::tick_t tick_at_or_before(dl_time_t time) const;
+    dl_time_t time_of_tick(TimerWheel::tick_t tick) const;
+
+    // Guarded by _mutex, it only moves when the clock is switched.
+    dl_time_t _epoch;
+
+    mutable std::mutex _mutex {};
+    std::condition_variable _cv {};
+    TimerWheel _wheel {};
+
+    // Timers taken out of the wheel which have not been called yet.
+    std::vector<std::pair<timer_id_t, TimerWheel::callback_t>> _due {};
+
+    // The timer whose callback runs right now, 0 if none, and the thread it
+    // runs on. cancel() waits on _running_cv for it to finish.
+    timer_id_t _running_id = 0;
+    std::thread::id _running_thread {};
+    std::condition_variable _running_cv {};
+
+    // Tick for which the thread is going to wake up, 0 if it waits for timers.
+    TimerWheel::tick_t _wakeup_tick = 0;
+
+    bool _should_exit = false;
+    std::thread *_thread = nullptr;
+};
+
+} // namespace dronecore
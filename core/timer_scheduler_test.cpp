@@ -0,0 +1,100 @@
+#include "timer_scheduler.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <mutex>
+
+using namespace dronecore;
+
+TEST(TimerScheduler, CallsBackAtDeadline)
+{
+    std::atomic<bool> called {false};
+    const dl_time_t deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(20);
+
+    TimerScheduler::Instance().add([&called]() { called = true; }, deadline);
+
+    for (int i = 0; i < 100 && !called; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_TRUE(called);
+    EXPECT_GE(std::chrono::steady_clock::now(), deadline);
+}
+
+TEST(TimerScheduler, EarlierTimerWakesUpScheduler)
+{
+    std::atomic<bool> late_called {false};
+    std::atomic<bool> early_called {false};
+    const dl_time_t now = std::chrono::steady_clock::now();
+
+    const TimerScheduler::timer_id_t late_id = TimerScheduler::Instance().add(
+    [&late_called]() { late_called = true; }, now + std::chrono::seconds(10));
+    TimerScheduler::Instance().add(
+    [&early_called]() { early_called = true; }, now + std::chrono::milliseconds(10));
+
+    for (int i = 0; i < 100 && !early_called; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_TRUE(early_called);
+    EXPECT_FALSE(late_called);
+
+    TimerScheduler::Instance().cancel(late_id);
+}
+
+TEST(TimerScheduler, Cancel)
+{
+    std::atomic<bool> called {false};
+
+    const TimerScheduler::timer_id_t id = TimerScheduler::Instance().add(
+    [&called]() { called = true; },
+    std::chrono::steady_clock::now() + std::chrono::milliseconds(20));
+
+    TimerScheduler::Instance().cancel(id);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(called);
+}
+
+TEST(TimerScheduler, CancelWaitsForRunningCallback)
+{
+    std::atomic<bool> started {false};
+    std::atomic<bool> finished {false};
+
+    const TimerScheduler::timer_id_t id = TimerScheduler::Instance().add(
+    [&started, &finished]() {
+        started = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        finished = true;
+    }, std::chrono::steady_clock::now());
+
+    for (int i = 0; i < 100 && !started; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_TRUE(started);
+    EXPECT_FALSE(TimerScheduler::Instance().is_pending(id));
+    EXPECT_FALSE(TimerScheduler::Instance().cancel_if_pending(id));
+
+    TimerScheduler::Instance().cancel(id);
+    EXPECT_TRUE(finished);
+}
+
+TEST(TimerScheduler, CancelFromWithinCallback)
+{
+    std::atomic<bool> finished {false};
+    TimerScheduler::timer_id_t id = 0;
+    std::mutex id_mutex;
+
+    {
+        std::lock_guard<std::mutex> lock(id_mutex);
+        id = TimerScheduler::Instance().add([&]() {
+            std::lock_guard<std::mutex> callback_lock(id_mutex);
+            // Would wait for itself otherwise.
+            TimerScheduler::Instance().cancel(id);
+            finished = true;
+        }, std::chrono::steady_clock::now());
+        EXPECT_TRUE(TimerScheduler::Instance().is_pending(id));
+    }
+
+    for (int i = 0; i < 100 && !finished; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_TRUE(finished);
+}
@@ -0,0 +1,236 @@
+#include "timer_wheel.h"
+#include <algorithm>
+
+namespace dronecore {
+
+constexpr unsigned TimerWheel::LEVEL_BITS;
+constexpr unsigned TimerWheel::NUM_SLOTS;
+constexpr unsigned TimerWheel::NUM_LEVELS;
+
+static unsigned count_trailing_zeros(uint64_t value)
+{
+    // value must not be 0.
+    unsigned count = 0;
+    while ((value & 1) == 0) {
+        value >>= 1;
+        ++count;
+    }
+    return count;
+}
+
+TimerWheel::TimerWheel(tick_t now) :
+    _current(now)
+{
+}
+
+TimerWheel::~TimerWheel()
+{
+    for (auto &entry : _timers) {
+        delete entry.second;
+    }
+}
+
+TimerWheel::timer_id_t TimerWheel::add(tick_t expiry, callback_t callback)
+{
+    Timer *timer = new Timer();
+    timer->id = _next_id++;
+    // The current tick has already been handled, so the earliest is the next one.
+    timer->expiry = std::max(expiry, _current + 1);
+    timer->callback = std::move(callback);
+
+    insert(timer);
+    _timers[timer->id] = timer;
+
+    return timer->id;
+}
+
+bool TimerWheel::cancel(timer_id_t id)
+{
+    auto it = _timers.find(id);
+    if (it == _timers.end()) {
+        return false;
+    }
+
+    unlink(it->second);
+    delete it->second;
+    _timers.erase(it);
+    return true;
+}
+
+void TimerWheel::insert(Timer *timer)
+{
+    const tick_t expiry = std::max(timer->expiry, _current);
+
+    // A timer goes to the lowest level on which it is in the same block as the
+    // current tick. It then gets moved down as the wheel turns.
+    unsigned level = 0;
+    while (level < NUM_LEVELS - 1 &&
+           (expiry >> ((level + 1) * LEVEL_BITS)) != (_current >> ((level + 1) * LEVEL_BITS))) {
+        ++level;
+    }
+
+    const tick_t turn = tick_t(1) << (NUM_LEVELS * LEVEL_BITS);
+
+    unsigned slot;
+    if (expiry - _current >= turn) {
+        // Too far in the future for the wheel, park it in the top level slot that
+        // comes up last and have another look at it then.
+        slot = (slot_index(_current, level) + NUM_SLOTS - 1) % NUM_SLOTS;
+    } else {
+        // This can be in the next turn of the top level, which is fine because
+        // the slot is behind the current one until then.
+        slot = slot_index(expiry, level);
+    }
+
+    timer->level = level;
+    timer->slot = slot;
+    timer->prev = nullptr;
+    timer->next = _slots[level][slot].head;
+    if (timer->next) {
+        timer->next->prev = timer;
+    }
+    _slots[level][slot].head = timer;
+    _occupied[level] |= (uint64_t(1) << slot);
+}
+
+void TimerWheel::unlink(Timer *timer)
+{
+    Slot &slot = _slots[timer->level][timer->slot];
+
+    if (timer->prev) {
+        timer->prev->next = timer->next;
+    } else {
+        slot.head = timer->next;
+    }
+    if (timer->next) {
+        timer->next->prev = timer->prev;
+    }
+
+    if (slot.head == nullptr) {
+        _occupied[timer->level] &= ~(uint64_t(1) << timer->slot);
+    }
+}
+
+void TimerWheel::cascade(unsigned level)
+{
+    const unsigned index = slot_index(_current, level);
+    Timer *timer = _slots[level][index].head;
+    _slots[level][index].head = nullptr;
+    _occupied[level] &= ~(uint64_t(1) << index);
+
+    while (timer != nullptr) {
+        Timer *next = timer->next;
+        insert(timer);
+        timer = next;
+    }
+}
+
+void TimerWheel::collect_slot(std::vector<Timer *> &expired)
+{
+    const unsigned index = slot_index(_current, 0);
+    Timer *timer = _slots[0][index].head;
+    _slots[0][index].head = nullptr;
+    _occupied[0] &= ~(uint64_t(1) << index);
+
+    while (timer != nullptr) {
+        expired.push_back(timer);
+        timer = timer->next;
+    }
+}
+
+TimerWheel::tick_t TimerWheel::next_interesting_tick() const
+{
+    // Either a slot for the lowest level comes up, or a slot of a higher level
+    // needs to be cascaded down, whichever is first.
+    tick_t next = 0;
+    bool found = false;
+
+    for (unsigned level = 0; level < NUM_LEVELS; ++level) {
+        const unsigned index = slot_index(_current, level);
+        const unsigned shift = level * LEVEL_BITS;
+        const tick_t block_start = (_current >> (shift + LEVEL_BITS)) << (shift + LEVEL_BITS);
+
+        const uint64_t ahead = (index == NUM_SLOTS - 1) ? 0 :
+                               (_occupied[level] & (~uint64_t(0) << (index + 1)));
+        tick_t candidate;
+        if (ahead != 0) {
+            candidate = block_start + (tick_t(count_trailing_zeros(ahead)) << shift);
+        } else if (level == NUM_LEVELS - 1 && _occupied[level] != 0) {
+            // Only the top level wraps around, the slots behind are due in the
+            // next turn.
+            candidate = block_start + (tick_t(1) << (shift + LEVEL_BITS)) +
+                        (tick_t(count_trailing_zeros(_occupied[level])) << shift);
+        } else {
+            continue;
+        }
+
+        if (!found || candidate < next) {
+            next = candidate;
+            found = true;
+        }
+    }
+
+    return next;
+}
+
+void TimerWheel::advance(tick_t now, std::vector<std::pair<timer_id_t, callback_t>> &due)
+{
+    std::vector<Timer *> expired;
+
+    while (_current < now) {
+
+        if (all_slots_empty()) {
+            _current = now;
+            break;
+        }
+
+        // Skip over all the ticks where nothing happens.
+        const tick_t next = next_interesting_tick();
+        if (next > now) {
+            _current = now;
+            break;
+        }
+        _current = next;
+
+        for (unsigned level = NUM_LEVELS - 1; level > 0; --level) {
+            const tick_t mask = (tick_t(1) << (level * LEVEL_BITS)) - 1;
+            if ((_current & mask) == 0) {
+                cascade(level);
+            }
+        }
+
+        collect_slot(expired);
+    }
+
+    std::sort(expired.begin(), expired.end(), [](const Timer * lhs, const Timer * rhs) {
+        return (lhs->expiry != rhs->expiry) ? (lhs->expiry < rhs->expiry) : (lhs->id < rhs->id);
+    });
+
+    for (Timer *timer : expired) {
+        due.push_back(std::make_pair(timer->id, std::move(timer->callback)));
+        _timers.erase(timer->id);
+        delete timer;
+    }
+}
+
+bool TimerWheel::all_slots_empty() const
+{
+    for (unsigned level = 0; level < NUM_LEVELS; ++level) {
+        if (_occupied[level] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TimerWheel::next_expiry(tick_t &expiry) const
+{
+    if (_timers.empty()) {
+        return false;
+    }
+
+    expiry = next_interesting_tick();
+    return true;
+}
+
+} // namespace dronecore
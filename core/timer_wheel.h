@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include "inplace_function.h"
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <cstddef>
+#include <vector>
+
+namespace dronecore {
+
+// Hierarchical timer wheel with a resolution of one tick. Adding or cancelling
+// a timer is O(1) and advancing only touches the slots which are due.
+//
+// Timer ids are never reused, so cancelling a timer which already fired is safe.
+//
+// This class is not thread-safe, it is meant to be wrapped by a scheduler.
+class TimerWheel
+{
+public:
+    typedef uint64_t tick_t;
+    typedef uint64_t timer_id_t;
+    typedef Callback<void()> callback_t;
+
+    explicit TimerWheel(tick_t now = 0);
+    ~TimerWheel();
+
+    timer_id_t add(tick_t expiry, callback_t callback);
+    bool cancel(timer_id_t id);
+    bool contains(timer_id_t id) const { return _timers.count(id) != 0; }
+
+    // Moves the wheel forward to now and hands out all timers which are due,
+    // ordered by their expiry.
+    void advance(tick_t now, std::vector<std::pair<timer_id_t, callback_t>> &due);
+
+    // Returns false if there are no timers. The expiry returned can be before the
+    // actual next expiry but never after it.
+    bool next_expiry(tick_t &expiry) const;
+
+    size_t size() const { return _timers.size(); }
+
+    // Non-copyable
+    TimerWheel(const TimerWheel &) = delete;
+    const TimerWheel &operator=(const TimerWheel &) = delete;
+
+private:
+    static constexpr unsigned LEVEL_BITS = 6;
+    static constexpr unsigned NUM_SLOTS = 1 << LEVEL_BITS;
+    static constexpr unsigned NUM_LEVELS = 4;
+
+    struct Timer {
+        timer_id_t id;
+        tick_t expiry;
+        callback_t callback;
+        unsigned level;
+        unsigned slot;
+        Timer *prev;
+        Timer *next;
+    };
+
+    struct Slot {
+        Timer *head = nullptr;
+    };
+
+    void insert(Timer *timer);
+    void unlink(Timer *timer);
+    void cascade(unsigned level);
+    void collect_slot(std::vector<Timer *> &expired);
+    tick_t next_interesting_tick() const;
+    bool all_slots_empty() const;
+
+    static unsigned slot_index(tick_t tick, unsigned level)
+    {
+        return unsigned(tick >> (level * LEVEL_BITS)) & (NUM_SLOTS - 1);
+    }
+
+    Slot _slots[NUM_LEVELS][NUM_SLOTS] {};
+    // One bit per slot which is not empty.
+    uint64_t _occupied[NUM_LEVELS] {};
+
+    tick_t _current;
+    timer_id_t _next_id = 1;
+    std::unordered_map<timer_id_t, Timer *> _timers {};
+};
+
+} // namespace dronecore
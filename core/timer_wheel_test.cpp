@@ -0,0 +1,90 @@
+#include "timer_wheel.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace dronecore;
+
+typedef std::vector<std::pair<TimerWheel::timer_id_t, TimerWheel::callback_t>> due_t;
+
+TEST(TimerWheel, FiresWhenDue)
+{
+    TimerWheel wheel;
+
+    int num_called = 0;
+    wheel.add(10, [&num_called]() { ++num_called; });
+
+    due_t due;
+    wheel.advance(9, due);
+    EXPECT_EQ(due.size(), 0u);
+
+    wheel.advance(10, due);
+    ASSERT_EQ(due.size(), 1u);
+    due[0].second();
+    EXPECT_EQ(num_called, 1);
+    EXPECT_EQ(wheel.size(), 0u);
+}
+
+TEST(TimerWheel, FiresInOrder)
+{
+    TimerWheel wheel(1000);
+
+    const TimerWheel::timer_id_t late = wheel.add(1000 + 70000, nullptr);
+    const TimerWheel::timer_id_t early = wheel.add(1000 + 5, nullptr);
+    const TimerWheel::timer_id_t middle = wheel.add(1000 + 300, nullptr);
+
+    due_t due;
+    wheel.advance(1000 + 100000, due);
+    ASSERT_EQ(due.size(), 3u);
+    EXPECT_EQ(due[0].first, early);
+    EXPECT_EQ(due[1].first, middle);
+    EXPECT_EQ(due[2].first, late);
+}
+
+TEST(TimerWheel, Cancel)
+{
+    TimerWheel wheel;
+
+    const TimerWheel::timer_id_t id = wheel.add(100, nullptr);
+    EXPECT_TRUE(wheel.cancel(id));
+    EXPECT_FALSE(wheel.cancel(id));
+
+    due_t due;
+    wheel.advance(200, due);
+    EXPECT_EQ(due.size(), 0u);
+}
+
+TEST(TimerWheel, PastExpiryFiresOnNextTick)
+{
+    TimerWheel wheel(50);
+
+    wheel.add(10, nullptr);
+
+    due_t due;
+    wheel.advance(50, due);
+    EXPECT_EQ(due.size(), 0u);
+    wheel.advance(51, due);
+    EXPECT_EQ(due.size(), 1u);
+}
+
+TEST(TimerWheel, NextExpiryIsNeverLate)
+{
+    TimerWheel wheel(3);
+
+    TimerWheel::tick_t next;
+    EXPECT_FALSE(wheel.next_expiry(next));
+
+    // Further out than the wheel covers in one turn.
+    const TimerWheel::tick_t expiry = 3 + (TimerWheel::tick_t(1) << 26);
+    wheel.add(expiry, nullptr);
+
+    due_t due;
+    TimerWheel::tick_t now = 3;
+    while (due.empty()) {
+        ASSERT_TRUE(wheel.next_expiry(next));
+        ASSERT_GT(next, now);
+        ASSERT_LE(next, expiry);
+        now = next;
+        wheel.advance(now, due);
+    }
+    EXPECT_EQ(now, expiry);
+}
@@ -0,0 +1,130 @@
+#include "timesync_estimator.h"
+#include <algorithm>
+#include <cmath>
+
+namespace dronecore {
+
+constexpr unsigned TimesyncEstimator::CONVERGED_SAMPLES;
+constexpr double TimesyncEstimator::MAX_RTT_FACTOR;
+constexpr int64_t TimesyncEstimator::MAX_RTT_NS;
+constexpr int64_t TimesyncEstimator::MAX_ERROR_NS;
+constexpr unsigned TimesyncEstimator::RESET_SAMPLES;
+constexpr double TimesyncEstimator::MAX_SKEW;
+
+TimesyncEstimator::TimesyncEstimator() {}
+
+TimesyncEstimator::~TimesyncEstimator() {}
+
+void TimesyncEstimator::reset()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _estimate = Estimate {};
+    _rtt_ns = 0.0;
+    _num_accepted = 0;
+    _num_far_off = 0;
+    _num_slow = 0;
+    _status = Status {};
+    _published.store(_estimate);
+}
+
+bool TimesyncEstimator::add_sample(int64_t sent_ns, int64_t vehicle_ns, int64_t received_ns)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const int64_t rtt_ns = received_ns - sent_ns;
+    if (rtt_ns < 0 || rtt_ns > MAX_RTT_NS) {
+        ++_status.num_rejected;
+        return false;
+    }
+
+    if (_num_accepted > 0 && double(rtt_ns) > MAX_RTT_FACTOR * _rtt_ns &&
+        ++_num_slow < CONVERGED_SAMPLES) {
+        ++_status.num_rejected;
+        return false;
+    }
+    _num_slow = 0;
+
+    const int64_t host_ns = sent_ns + rtt_ns / 2;
+    const double measured_ns = double(vehicle_ns - host_ns);
+
+    if (!_estimate.valid) {
+        start_over(host_ns, measured_ns, double(rtt_ns));
+        return true;
+    }
+
+    const double dt_ns = double(host_ns - _estimate.reference_ns);
+    const double predicted_ns = _estimate.offset_ns + _estimate.skew * dt_ns;
+    const double error_ns = measured_ns - predicted_ns;
+
+    if (std::fabs(error_ns) > double(MAX_ERROR_NS)) {
+        ++_status.num_rejected;
+        if (++_num_far_off >= RESET_SAMPLES) {
+            start_over(host_ns, measured_ns, double(rtt_ns));
+            return true;
+        }
+        return false;
+    }
+    _num_far_off = 0;
+
+    // Fast to begin with, smooth once there are enough samples.
+    ++_num_accepted;
+    const double alpha = std::max(1.0 / double(_num_accepted), 0.1);
+    const double beta = alpha * alpha / 2.0;
+
+    _estimate.offset_ns = predicted_ns + alpha * error_ns;
+    if (dt_ns > 0.0) {
+        _estimate.skew = std::min(std::max(_estimate.skew + beta * error_ns / dt_ns, -MAX_SKEW),
+                                  MAX_SKEW);
+    }
+    _estimate.reference_ns = host_ns;
+    _rtt_ns += alpha * (double(rtt_ns) - _rtt_ns);
+
+    _status.converged = (_num_accepted >= CONVERGED_SAMPLES);
+    _status.offset_s = _estimate.offset_ns * 1e-9;
+    _status.skew_ppm = _estimate.skew * 1e6;
+    _status.rtt_s = _rtt_ns * 1e-9;
+    ++_status.num_samples;
+
+    _published.store(_estimate);
+    return true;
+}
+
+void TimesyncEstimator::start_over(int64_t host_ns, double offset_ns, double rtt_ns)
+{
+    // We assume that we already acquired the mutex in this function.
+    _estimate = Estimate {true, host_ns, offset_ns, 0.0};
+    _rtt_ns = rtt_ns;
+    _num_accepted = 1;
+    _num_far_off = 0;
+    _num_slow = 0;
+
+    _status.converged = false;
+    _status.offset_s = offset_ns * 1e-9;
+    _status.skew_ppm = 0.0;
+    _status.rtt_s = rtt_ns * 1e-9;
+    ++_status.num_samples;
+
+    _published.store(_estimate);
+}
+
+bool TimesyncEstimator::vehicle_to_host_ns(int64_t vehicle_ns, int64_t &host_ns) const
+{
+    const Estimate estimate = _published.load();
+    if (!estimate.valid) {
+        return false;
+    }
+
+    // vehicle - host = offset + skew * (host - reference), solved for host.
+    const double since_reference_ns =
+        (double(vehicle_ns - estimate.reference_ns) - estimate.offset_ns) / (1.0 + estimate.skew);
+    host_ns = estimate.reference_ns + int64_t(std::llround(since_reference_ns));
+    return true;
+}
+
+TimesyncEstimator::Status TimesyncEstimator::status() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _status;
+}
+
+} // namespace dronecore
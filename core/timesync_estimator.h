@@ -0,0 +1,82 @@
+#pragma once
+
+#include "seqlock.h"
+#include <cstdint>
+#include <mutex>
+
+namespace dronecore {
+
+// Estimates the offset of the vehicle clock against ours from TIMESYNC round
+// trips, so that times of the vehicle can be put on our clock.
+//
+// Each round trip gives the vehicle time at about the middle of it. Round
+// trips much slower than usual are left out, as the middle is then anything
+// but certain. The offset is then tracked by an alpha-beta filter, which
+// also estimates how fast the clocks drift apart, the skew. Several offsets
+// far off from the estimate in a row mean the vehicle has rebooted and the
+// estimate is started over.
+//
+// Samples are added by the receive threads, the estimate can be read from
+// any thread without blocking.
+class TimesyncEstimator
+{
+public:
+    TimesyncEstimator();
+    ~TimesyncEstimator();
+
+    void reset();
+
+    // All in nanoseconds. Returns false if the sample was left out.
+    bool add_sample(int64_t sent_ns, int64_t vehicle_ns, int64_t received_ns);
+
+    // Returns false until there is an estimate.
+    bool vehicle_to_host_ns(int64_t vehicle_ns, int64_t &host_ns) const;
+
+    struct Status {
+        bool converged;
+        // Vehicle time minus ours.
+        double offset_s;
+        double skew_ppm;
+        double rtt_s;
+        uint64_t num_samples;
+        uint64_t num_rejected;
+    };
+    Status status() const;
+
+    // Samples until the estimate counts as converged.
+    static constexpr unsigned CONVERGED_SAMPLES = 10;
+    // To the filtered round trip time.
+    static constexpr double MAX_RTT_FACTOR = 3.0;
+    static constexpr int64_t MAX_RTT_NS = 1000000000;
+    static constexpr int64_t MAX_ERROR_NS = 100000000;
+    static constexpr unsigned RESET_SAMPLES = 3;
+    static constexpr double MAX_SKEW = 1e-3;
+
+    // Non-copyable
+    TimesyncEstimator(const TimesyncEstimator &) = delete;
+    const TimesyncEstimator &operator=(const TimesyncEstimator &) = delete;
+
+private:
+    // What other threads read, the offset is at host time reference_ns.
+    struct Estimate {
+        bool valid;
+        int64_t reference_ns;
+        double offset_ns;
+        double skew;
+    };
+
+    void start_over(int64_t host_ns, double offset_ns, double rtt_ns);
+
+    mutable std::mutex _mutex {};
+    Estimate _estimate {};
+    double _rtt_ns = 0.0;
+    unsigned _num_accepted = 0;
+    unsigned _num_far_off = 0;
+    // Slow round trips in a row, after a few of them they are what is usual.
+    unsigned _num_slow = 0;
+    Status _status {};
+
+    SeqLock<Estimate> _published {};
+};
+
+} // namespace dronecore
@@ -0,0 +1,92 @@
+#include "timesync_estimator.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdlib>
+
+using namespace dronecore;
+
+namespace {
+
+// A vehicle booted 1000 s after us, with a clock which is 50 ppm fast.
+struct Vehicle {
+    double skew = 50e-6;
+    int64_t offset_ns = -1000000000000;
+
+    int64_t time_ns(int64_t host_ns) const
+    {
+        return host_ns + offset_ns + int64_t(double(host_ns) * skew);
+    }
+};
+
+} // namespace
+
+TEST(TimesyncEstimator, ConvergesOnOffsetAndSkew)
+{
+    TimesyncEstimator estimator;
+    Vehicle vehicle;
+
+    int64_t host_ns = 2000000000000;
+    srand(42);
+    for (unsigned i = 0; i < 200; ++i) {
+        // 20 to 40 ms round trip, not always symmetric.
+        const int64_t rtt_ns = 20000000 + (rand() % 20000000);
+        const int64_t there_ns = rtt_ns / 2 + (rand() % 2000000) - 1000000;
+        EXPECT_TRUE(estimator.add_sample(host_ns, vehicle.time_ns(host_ns + there_ns),
+                                         host_ns + rtt_ns));
+        host_ns += 1000000000;
+    }
+
+    const TimesyncEstimator::Status status = estimator.status();
+    EXPECT_TRUE(status.converged);
+    EXPECT_NEAR(status.skew_ppm, 50.0, 10.0);
+    EXPECT_NEAR(status.rtt_s, 0.03, 0.01);
+
+    int64_t converted_ns = 0;
+    EXPECT_TRUE(estimator.vehicle_to_host_ns(vehicle.time_ns(host_ns), converted_ns));
+    // Within a millisecond.
+    EXPECT_LT(std::llabs(converted_ns - host_ns), 1000000);
+}
+
+TEST(TimesyncEstimator, LeavesOutSlowRoundTrips)
+{
+    TimesyncEstimator estimator;
+    Vehicle vehicle;
+
+    int64_t host_ns = 2000000000000;
+    for (unsigned i = 0; i < 20; ++i) {
+        estimator.add_sample(host_ns, vehicle.time_ns(host_ns + 5000000), host_ns + 10000000);
+        host_ns += 1000000000;
+    }
+    // Stuck in a buffer on the way back.
+    EXPECT_FALSE(estimator.add_sample(host_ns, vehicle.time_ns(host_ns + 5000000),
+                                      host_ns + 500000000));
+    EXPECT_EQ(estimator.status().num_rejected, 1u);
+}
+
+TEST(TimesyncEstimator, StartsOverAfterReboot)
+{
+    TimesyncEstimator estimator;
+    int64_t converted_ns = 0;
+    EXPECT_FALSE(estimator.vehicle_to_host_ns(0, converted_ns));
+
+    Vehicle vehicle;
+    int64_t host_ns = 2000000000000;
+    for (unsigned i = 0; i < 20; ++i) {
+        estimator.add_sample(host_ns, vehicle.time_ns(host_ns + 5000000), host_ns + 10000000);
+        host_ns += 1000000000;
+    }
+
+    // A single outlier is ignored.
+    vehicle.offset_ns -= host_ns;
+    EXPECT_FALSE(estimator.add_sample(host_ns, vehicle.time_ns(host_ns + 5000000),
+                                      host_ns + 10000000));
+    host_ns += 1000000000;
+    for (unsigned i = 1; i < TimesyncEstimator::RESET_SAMPLES; ++i) {
+        estimator.add_sample(host_ns, vehicle.time_ns(host_ns + 5000000), host_ns + 10000000);
+        host_ns += 1000000000;
+    }
+    EXPECT_FALSE(estimator.status().converged);
+
+    EXPECT_TRUE(estimator.vehicle_to_host_ns(vehicle.time_ns(host_ns), converted_ns));
+    EXPECT_LT(std::llabs(converted_ns - host_ns), 1000000);
+}
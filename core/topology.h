@@ -0,0 +1,31 @@
+#pragma once
+
+// Set to 1 for a build which talks to one vehicle over one connection, e.g. on
+// a companion computer, with cmake -DENABLE_SINGLE_SYSTEM=ON. Messages then go
+// from the receive thread straight to the system, without the duplicate
+// filter, forwarding, shards or route changes, and a second connection is
+// refused.
+#ifndef DRONECORE_SINGLE_SYSTEM
+#define DRONECORE_SINGLE_SYSTEM 0
+#endif
+
+namespace dronecore {
+
+// What DroneCoreImpl is built for. As these are constants, the paths a build
+// doesn't need are left out by the compiler.
+template<bool single_system>
+struct TopologyPolicy {
+    static constexpr bool SINGLE_SYSTEM = false;
+    // 0 for no limit.
+    static constexpr unsigned MAX_CONNECTIONS = 0;
+};
+
+template<>
+struct TopologyPolicy<true> {
+    static constexpr bool SINGLE_SYSTEM = true;
+    static constexpr unsigned MAX_CONNECTIONS = 1;
+};
+
+typedef TopologyPolicy<DRONECORE_SINGLE_SYSTEM != 0> Topology;
+
+} // namespace dronecore
@@ -0,0 +1,382 @@
+#include "trace_recorder.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace dronecore {
+
+constexpr unsigned TraceRecorder::DETAIL_LEN;
+constexpr unsigned TraceRecorder::QUEUE_LEN;
+constexpr size_t TraceRecorder::MAX_EVENTS;
+constexpr int TraceRecorder::COLLECT_INTERVAL_MS;
+
+std::atomic<bool> TraceRecorder::_is_enabled {false};
+
+namespace {
+
+// Stops the thread of the recorder once the process exits.
+struct StopAtExit {
+    ~StopAtExit() { TraceRecorder::instance().set_enabled(false); }
+} stop_at_exit;
+
+// Kept until the thread records, so that naming it costs nothing before.
+thread_local const char *thread_name = nullptr;
+
+void copy_detail(char *dest, const char *detail)
+{
+    if (detail == nullptr) {
+        dest[0] = '\0';
+        return;
+    }
+    const size_t len = std::min(strlen(detail), size_t(TraceRecorder::DETAIL_LEN - 1));
+    memcpy(dest, detail, len);
+    dest[len] = '\0';
+}
+
+} // namespace
+
+TraceRecorder &TraceRecorder::instance()
+{
+    // Never deleted, so that it can be used from other static objects in any order.
+    static TraceRecorder *recorder = new TraceRecorder();
+    return *recorder;
+}
+
+TraceRecorder::TraceRecorder() :
+    _start_time(clock::now())
+{
+    _collected.reserve(QUEUE_LEN);
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    set_enabled(false);
+}
+
+TraceRecorder::ThreadQueueHandle::~ThreadQueueHandle()
+{
+    if (queue != nullptr) {
+        queue->is_finished.store(true, std::memory_order_release);
+    }
+}
+
+TraceRecorder::ThreadQueue &TraceRecorder::thread_queue()
+{
+    thread_local ThreadQueueHandle handle;
+
+    if (handle.queue == nullptr) {
+        // Only the first event of a thread takes the lock.
+        std::unique_ptr<ThreadQueue> queue(new ThreadQueue());
+        handle.queue = queue.get();
+        std::lock_guard<std::mutex> lock(_queues_mutex);
+        queue->tid = _next_tid++;
+        if (thread_name != nullptr) {
+            _thread_names[queue->tid] = thread_name;
+        }
+        _queues.push_back(std::move(queue));
+    }
+    return *handle.queue;
+}
+
+void TraceRecorder::set_enabled(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(_control_mutex);
+
+    if (enabled == _thread.joinable()) {
+        return;
+    }
+
+    if (enabled) {
+        {
+            std::lock_guard<std::mutex> events_lock(_events_mutex);
+            // Whatever is left in the queues is from the last recording.
+            collect();
+            _events.clear();
+            _num_dropped = 0;
+        }
+        {
+            std::lock_guard<std::mutex> wake_lock(_wake_mutex);
+            _should_exit = false;
+        }
+        _is_enabled.store(true, std::memory_order_relaxed);
+        _thread = std::thread(&TraceRecorder::run, this);
+        return;
+    }
+
+    _is_enabled.store(false, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> wake_lock(_wake_mutex);
+        _should_exit = true;
+    }
+    _wake_cv.notify_all();
+    _thread.join();
+
+    std::lock_guard<std::mutex> events_lock(_events_mutex);
+    collect();
+}
+
+void TraceRecorder::run()
+{
+    std::unique_lock<std::mutex> wake_lock(_wake_mutex);
+
+    while (!_should_exit) {
+        _wake_cv.wait_for(wake_lock, std::chrono::milliseconds(COLLECT_INTERVAL_MS));
+
+        wake_lock.unlock();
+        {
+            std::lock_guard<std::mutex> lock(_events_mutex);
+            collect();
+        }
+        wake_lock.lock();
+    }
+}
+
+void TraceRecorder::collect()
+{
+    // We assume that we already acquired _events_mutex in this function.
+
+    std::lock_guard<std::mutex> lock(_queues_mutex);
+
+    for (auto it = _queues.begin(); it != _queues.end();) {
+        // Checked first, as everything the thread pushed is visible then.
+        const bool is_finished = (*it)->is_finished.load(std::memory_order_acquire);
+        (*it)->events.pop_batch(_collected);
+        _num_dropped += (*it)->num_dropped.exchange(0, std::memory_order_relaxed);
+
+        for (const auto &event : _collected) {
+            _events.push_back(event);
+        }
+        _collected.clear();
+
+        if (is_finished) {
+            it = _queues.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    while (_events.size() > MAX_EVENTS) {
+        _events.pop_front();
+        ++_num_dropped;
+    }
+}
+
+void TraceRecorder::set_thread_name(const char *name)
+{
+    thread_name = name;
+}
+
+uint64_t TraceRecorder::to_us(clock::time_point time) const
+{
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                        time - _start_time).count();
+    return (us > 0) ? uint64_t(us) : 0;
+}
+
+void TraceRecorder::record(char phase, const char *category, const char *name,
+                           clock::time_point start, clock::time_point end, uint64_t id,
+                           const char *detail)
+{
+    TraceRecorder &recorder = instance();
+    ThreadQueue &queue = recorder.thread_queue();
+
+    Event event;
+    event.phase = phase;
+    event.tid = queue.tid;
+    event.category = category;
+    event.name = name;
+    event.timestamp_us = recorder.to_us(start);
+    event.duration_us = recorder.to_us(end) - event.timestamp_us;
+    event.id = id;
+    copy_detail(event.detail, detail);
+
+    if (!queue.events.push(event)) {
+        queue.num_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void TraceRecorder::instant(const char *category, const char *name, const char *detail)
+{
+    if (!is_enabled()) {
+        return;
+    }
+    const auto now = clock::now();
+    record('i', category, name, now, now, 0, detail);
+}
+
+void TraceRecorder::async_begin(const char *category, const char *name, uint64_t id,
+                                const char *detail)
+{
+    if (!is_enabled()) {
+        return;
+    }
+    const auto now = clock::now();
+    record('b', category, name, now, now, id, detail);
+}
+
+void TraceRecorder::async_end(const char *category, const char *name, uint64_t id,
+                              const char *detail)
+{
+    if (!is_enabled()) {
+        return;
+    }
+    const auto now = clock::now();
+    record('e', category, name, now, now, id, detail);
+}
+
+void TraceRecorder::async_instant(const char *category, const char *name, uint64_t id,
+                                  const char *detail)
+{
+    if (!is_enabled()) {
+        return;
+    }
+    const auto now = clock::now();
+    record('n', category, name, now, now, id, detail);
+}
+
+bool TraceRecorder::write_chrome_json(const std::string &path)
+{
+    const std::string json = chrome_json();
+
+    std::ofstream file(path, std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+    file << json;
+    return bool(file);
+}
+
+std::string TraceRecorder::chrome_json()
+{
+    std::lock_guard<std::mutex> lock(_events_mutex);
+    collect();
+
+    std::string json = "{\"traceEvents\":[\n";
+    char buffer[128];
+    bool is_first = true;
+
+    auto start_event = [&json, &is_first]() {
+        if (!is_first) {
+            json += ",\n";
+        }
+        is_first = false;
+    };
+
+    {
+        std::lock_guard<std::mutex> queues_lock(_queues_mutex);
+        for (const auto &thread_name : _thread_names) {
+            start_event();
+            snprintf(buffer, sizeof(buffer),
+                     "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,"
+                     "\"args\":{\"name\":", thread_name.first);
+            json += buffer;
+            append_json_string(json, thread_name.second.c_str());
+            json += "}}";
+        }
+    }
+
+    for (const auto &event : _events) {
+        start_event();
+        snprintf(buffer, sizeof(buffer), "{\"ph\":\"%c\",\"pid\":1,\"tid\":%u,\"ts\":%llu,",
+                 event.phase, event.tid, static_cast<unsigned long long>(event.timestamp_us));
+        json += buffer;
+        json += "\"cat\":";
+        append_json_string(json, event.category);
+        json += ",\"name\":";
+        append_json_string(json, event.name);
+
+        switch (event.phase) {
+            case 'X':
+                snprintf(buffer, sizeof(buffer), ",\"dur\":%llu",
+                         static_cast<unsigned long long>(event.duration_us));
+                json += buffer;
+                break;
+            case 'i':
+                json += ",\"s\":\"t\"";
+                break;
+            default:
+                // JSON numbers that large lose precision in the viewers.
+                snprintf(buffer, sizeof(buffer), ",\"id\":\"0x%llx\"",
+                         static_cast<unsigned long long>(event.id));
+                json += buffer;
+                break;
+        }
+
+        if (event.detail[0] != '\0') {
+            json += ",\"args\":{\"detail\":";
+            append_json_string(json, event.detail);
+            json += "}";
+        }
+        json += "}";
+    }
+
+    if (_num_dropped > 0) {
+        start_event();
+        snprintf(buffer, sizeof(buffer),
+                 "{\"ph\":\"i\",\"pid\":1,\"tid\":0,\"ts\":0,\"s\":\"g\",\"cat\":\"trace\","
+                 "\"name\":\"dropped %llu events\"}",
+                 static_cast<unsigned long long>(_num_dropped));
+        json += buffer;
+    }
+
+    json += "\n]}\n";
+    return json;
+}
+
+void TraceRecorder::append_json_string(std::string &json, const char *text)
+{
+    json += '"';
+    for (const char *c = text; *c != '\0'; ++c) {
+        switch (*c) {
+            case '"':
+                json += "\\\"";
+                break;
+            case '\\':
+                json += "\\\\";
+                break;
+            default:
+                if (static_cast<unsigned char>(*c) < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", unsigned(*c));
+                    json += escaped;
+                } else {
+                    json += *c;
+                }
+                break;
+        }
+    }
+    json += '"';
+}
+
+TraceScope::TraceScope(const char *category, const char *name, const char *detail) :
+    _category(category),
+    _name(name),
+    _is_enabled(TraceRecorder::is_enabled())
+{
+    if (_is_enabled) {
+        copy_detail(_detail, detail);
+        _start = std::chrono::steady_clock::now();
+    }
+}
+
+TraceScope::TraceScope(const char *category, const char *name, uint32_t value) :
+    _category(category),
+    _name(name),
+    _is_enabled(TraceRecorder::is_enabled())
+{
+    if (_is_enabled) {
+        snprintf(_detail, sizeof(_detail), "%u", value);
+        _start = std::chrono::steady_clock::now();
+    }
+}
+
+TraceScope::~TraceScope()
+{
+    if (_is_enabled) {
+        TraceRecorder::record('X', _category, _name, _start, std::chrono::steady_clock::now(), 0,
+                              _detail);
+    }
+}
+
+} // namespace dronecore
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "spsc_queue.h"
+
+namespace dronecore {
+
+// Records what the threads of the process are doing, to be looked at as a
+// timeline in chrome://tracing or ui.perfetto.dev. It is off by default and
+// costs one relaxed load per event then.
+//
+// Like the AsyncLogger, every thread which records gets a ring of its own,
+// which it pushes to without locking. A thread of the recorder collects the
+// events from the rings while recording. Only the latest MAX_EVENTS are kept.
+//
+// Categories and names have to be string literals, as they are not copied.
+class TraceRecorder
+{
+public:
+    static constexpr unsigned DETAIL_LEN = 32;
+    static constexpr unsigned QUEUE_LEN = 4096;
+    static constexpr size_t MAX_EVENTS = 100000;
+
+    static TraceRecorder &instance();
+
+    static bool is_enabled() { return _is_enabled.load(std::memory_order_relaxed); }
+
+    // Starts or stops recording, what was recorded is kept until the next
+    // start.
+    void set_enabled(bool enabled);
+
+    // Writes what was recorded so far in the Chrome trace event format.
+    bool write_chrome_json(const std::string &path);
+    std::string chrome_json();
+
+    // Names the calling thread in the timeline, before it records anything.
+    // The name has to be a string literal.
+    static void set_thread_name(const char *name);
+
+    // Something which happened at one point in time.
+    static void instant(const char *category, const char *name, const char *detail = nullptr);
+
+    // Something which spans threads, like a command from being sent until its
+    // ack. Begin and end have to use the same category, name and id.
+    static void async_begin(const char *category, const char *name, uint64_t id,
+                            const char *detail = nullptr);
+    static void async_end(const char *category, const char *name, uint64_t id,
+                          const char *detail = nullptr);
+    // Something which happened during such a span.
+    static void async_instant(const char *category, const char *name, uint64_t id,
+                              const char *detail = nullptr);
+
+    // Non-copyable
+    TraceRecorder(const TraceRecorder &) = delete;
+    const TraceRecorder &operator=(const TraceRecorder &) = delete;
+
+private:
+    friend class TraceScope;
+
+    typedef std::chrono::steady_clock clock;
+
+    struct Event {
+        char phase;
+        unsigned tid;
+        const char *category;
+        const char *name;
+        uint64_t timestamp_us;
+        uint64_t duration_us;
+        uint64_t id;
+        char detail[DETAIL_LEN];
+    };
+
+    struct ThreadQueue {
+        ThreadQueue() : events(QUEUE_LEN) {}
+
+        SpscQueue<Event> events;
+        std::atomic<uint64_t> num_dropped {0};
+        // Set once its thread has exited.
+        std::atomic<bool> is_finished {false};
+        unsigned tid = 0;
+    };
+
+    // Marks the queue of a thread as finished when the thread exits.
+    struct ThreadQueueHandle {
+        ThreadQueue *queue = nullptr;
+        ~ThreadQueueHandle();
+    };
+
+    TraceRecorder();
+    ~TraceRecorder();
+
+    static void record(char phase, const char *category, const char *name,
+                       clock::time_point start, clock::time_point end, uint64_t id,
+                       const char *detail);
+
+    ThreadQueue &thread_queue();
+    uint64_t to_us(clock::time_point time) const;
+    void run();
+    void collect();
+    static void append_json_string(std::string &json, const char *text);
+
+    static constexpr int COLLECT_INTERVAL_MS = 100;
+
+    static std::atomic<bool> _is_enabled;
+
+    const clock::time_point _start_time;
+
+    // Held while taking events out of the queues, as they have one consumer only.
+    std::mutex _events_mutex {};
+    std::deque<Event> _events {};
+    std::vector<Event> _collected {};
+    uint64_t _num_dropped = 0;
+
+    std::mutex _queues_mutex {};
+    std::vector<std::unique_ptr<ThreadQueue>> _queues {};
+    std::map<unsigned, std::string> _thread_names {};
+    unsigned _next_tid = 1;
+
+    // Held while starting or stopping the thread.
+    std::mutex _control_mutex {};
+    std::mutex _wake_mutex {};
+    std::condition_variable _wake_cv {};
+    bool _should_exit = false;
+    std::thread _thread {};
+};
+
+// Records how long its scope took on the calling thread.
+class TraceScope
+{
+public:
+    TraceScope(const char *category, const char *name, const char *detail = nullptr);
+    // The number is only formatted while recording.
+    TraceScope(const char *category, const char *name, uint32_t value);
+    ~TraceScope();
+
+    // Non-copyable
+    TraceScope(const TraceScope &) = delete;
+    const TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *const _category;
+    const char *const _name;
+    char _detail[TraceRecorder::DETAIL_LEN];
+    const bool _is_enabled;
+    std::chrono::steady_clock::time_point _start {};
+};
+
+} // namespace dronecore
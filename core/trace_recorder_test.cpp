@@ -0,0 +1,78 @@
+#include "trace_recorder.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+
+using namespace dronecore;
+
+namespace {
+
+size_t count_of(const std::string &text, const std::string &part)
+{
+    size_t count = 0;
+    for (size_t pos = text.find(part); pos != std::string::npos; pos = text.find(part, pos + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+} // namespace
+
+TEST(TraceRecorder, RecordsNothingWhenDisabled)
+{
+    auto &recorder = TraceRecorder::instance();
+    recorder.set_enabled(true);
+    recorder.set_enabled(false);
+
+    TraceRecorder::instant("test", "not recorded");
+    {
+        TraceScope scope("test", "not recorded either");
+    }
+
+    EXPECT_EQ(count_of(recorder.chrome_json(), "not recorded"), 0u);
+}
+
+TEST(TraceRecorder, WritesEventsOfThreads)
+{
+    auto &recorder = TraceRecorder::instance();
+    recorder.set_enabled(true);
+
+    {
+        TraceScope scope("test", "scope", "with \"quotes\"");
+        TraceRecorder::instant("test", "instant");
+    }
+    std::thread thread([]() {
+        TraceRecorder::set_thread_name("other thread");
+        TraceRecorder::async_begin("test", "async", 0x1234);
+        TraceRecorder::async_end("test", "async", 0x1234, "done");
+    });
+    thread.join();
+
+    recorder.set_enabled(false);
+    const std::string json = recorder.chrome_json();
+
+    EXPECT_EQ(count_of(json, "\"ph\":\"X\""), 1u);
+    EXPECT_EQ(count_of(json, "\"ph\":\"i\""), 1u);
+    EXPECT_EQ(count_of(json, "\"ph\":\"b\""), 1u);
+    EXPECT_EQ(count_of(json, "\"ph\":\"e\""), 1u);
+    EXPECT_EQ(count_of(json, "\"id\":\"0x1234\""), 2u);
+    EXPECT_EQ(count_of(json, "\"detail\":\"with \\\"quotes\\\"\""), 1u);
+    EXPECT_EQ(count_of(json, "\"name\":\"other thread\""), 1u);
+    EXPECT_EQ(json.find("{\"traceEvents\":["), 0u);
+}
+
+TEST(TraceRecorder, StartsOverWhenEnabledAgain)
+{
+    auto &recorder = TraceRecorder::instance();
+    recorder.set_enabled(true);
+    TraceRecorder::instant("test", "first recording");
+    recorder.set_enabled(false);
+
+    recorder.set_enabled(true);
+    TraceRecorder::instant("test", "second recording");
+    recorder.set_enabled(false);
+
+    const std::string json = recorder.chrome_json();
+    EXPECT_EQ(count_of(json, "first recording"), 0u);
+    EXPECT_EQ(count_of(json, "second recording"), 1u);
+}
@@ -0,0 +1,282 @@
+#include "traffic_capture.h"
+#include "global_include.h"
+#include "log.h"
+#include "thread_roles.h"
+
+#ifndef WINDOWS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+namespace dronecore {
+
+constexpr size_t TrafficCapture::NUM_SLOTS;
+constexpr size_t TrafficCapture::SEGMENT_LEN;
+constexpr double TrafficCapture::FLUSH_INTERVAL_S;
+constexpr size_t TrafficCapture::TIME_LEN;
+constexpr size_t TrafficCapture::SLOT_MASK;
+
+TrafficCapture::TrafficCapture() {}
+
+TrafficCapture::~TrafficCapture()
+{
+    close();
+}
+
+bool TrafficCapture::open(const std::string &path)
+{
+    close();
+
+    std::lock_guard<std::mutex> lock(_open_mutex);
+
+#ifdef WINDOWS
+    UNUSED(path);
+    LogErr() << "Capturing traffic is not supported on Windows";
+    return false;
+#else
+    if (!_slots) {
+        _slots.reset(new Slot[NUM_SLOTS]);
+    }
+    // Nothing is added while closed, so the ring is empty and can start over.
+    for (size_t i = 0; i < NUM_SLOTS; ++i) {
+        _slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    _enqueue_position.store(0, std::memory_order_relaxed);
+    _dequeue_position = 0;
+    _num_dropped = 0;
+
+    _path = path;
+    _segment_index = 0;
+    if (!open_segment()) {
+        return false;
+    }
+
+    const int64_t system_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                                  std::chrono::system_clock::now().time_since_epoch()).count();
+    const int64_t steady_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                                  Time().steady_time().time_since_epoch()).count();
+    _epoch_offset_us = system_us - steady_us;
+
+    _should_exit = false;
+    _writer_thread = new std::thread(&TrafficCapture::write_loop, this);
+    _open = true;
+    return true;
+#endif
+}
+
+void TrafficCapture::close()
+{
+    std::lock_guard<std::mutex> lock(_open_mutex);
+    if (!_open.exchange(false)) {
+        return;
+    }
+
+    // Those which saw it open a moment ago are done soon.
+    while (_num_adding.load() > 0) {
+        std::this_thread::yield();
+    }
+
+    {
+        std::lock_guard<std::mutex> writer_lock(_writer_mutex);
+        _should_exit = true;
+    }
+    _writer_cv.notify_all();
+    _writer_thread->join();
+    delete _writer_thread;
+    _writer_thread = nullptr;
+
+    if (_num_dropped > 0) {
+        LogWarn() << "Capture " << _path << " dropped " << _num_dropped << " frame(s)";
+    }
+}
+
+void TrafficCapture::add(const uint8_t *frame, unsigned frame_len, int64_t steady_ns)
+{
+    if (!_open.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    ++_num_adding;
+    // It might have been closed meanwhile, then close() waits for us.
+    if (_open.load() &&
+        !push(frame, frame_len, uint64_t(steady_ns / 1000 + _epoch_offset_us.load()))) {
+        _num_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    --_num_adding;
+}
+
+bool TrafficCapture::push(const uint8_t *frame, unsigned frame_len, uint64_t time_us)
+{
+    if (frame_len > MAVLINK_MAX_PACKET_LEN) {
+        return false;
+    }
+
+    size_t position = _enqueue_position.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true) {
+        slot = &_slots[position & SLOT_MASK];
+        const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        if (sequence == position) {
+            if (_enqueue_position.compare_exchange_weak(position, position + 1,
+                                                        std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (sequence < position) {
+            // A lap behind, the writer has not taken it out yet.
+            return false;
+        } else {
+            position = _enqueue_position.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->time_us = time_us;
+    slot->len = uint16_t(frame_len);
+    memcpy(slot->data, frame, frame_len);
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+bool TrafficCapture::pop(Slot &slot)
+{
+    Slot &next = _slots[_dequeue_position & SLOT_MASK];
+    if (next.sequence.load(std::memory_order_acquire) != _dequeue_position + 1) {
+        // Empty, or the next one is still being written.
+        return false;
+    }
+
+    slot.time_us = next.time_us;
+    slot.len = next.len;
+    memcpy(slot.data, next.data, next.len);
+    next.sequence.store(_dequeue_position + NUM_SLOTS, std::memory_order_release);
+    ++_dequeue_position;
+    return true;
+}
+
+void TrafficCapture::write_loop()
+{
+    ThreadRoles::apply_to_this_thread(DroneCore::ThreadRole::LOGGING, "capture");
+
+    bool failed = false;
+    bool should_exit = false;
+    Slot slot;
+    while (!should_exit) {
+        {
+            std::unique_lock<std::mutex> lock(_writer_mutex);
+            _writer_cv.wait_for(lock, std::chrono::duration<double>(FLUSH_INTERVAL_S),
+            [this]() { return _should_exit; });
+            // Whatever is left is written out once more below.
+            should_exit = _should_exit;
+        }
+
+        while (pop(slot)) {
+            if (!failed && !write_record(slot)) {
+                LogErr() << "Capture " << _path << " stopped";
+                failed = true;
+            }
+        }
+        flush_segment();
+    }
+
+    close_segment();
+}
+
+bool TrafficCapture::write_record(const Slot &slot)
+{
+    if (_written + TIME_LEN + slot.len > SEGMENT_LEN) {
+        close_segment();
+        ++_segment_index;
+        if (!open_segment()) {
+            return false;
+        }
+    }
+    if (_mapping == nullptr) {
+        return false;
+    }
+
+    uint8_t *record = _mapping + _written;
+    for (unsigned i = 0; i < TIME_LEN; ++i) {
+        record[i] = uint8_t(slot.time_us >> (8 * (TIME_LEN - 1 - i)));
+    }
+    memcpy(record + TIME_LEN, slot.data, slot.len);
+    _written += TIME_LEN + slot.len;
+    return true;
+}
+
+bool TrafficCapture::open_segment()
+{
+#ifdef WINDOWS
+    return false;
+#else
+    std::stringstream path;
+    path << _path << "-" << std::setw(4) << std::setfill('0') << _segment_index << ".tlog";
+
+    _fd = ::open(path.str().c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (_fd < 0) {
+        LogErr() << "Could not open " << path.str() << ": " << strerror(errno);
+        return false;
+    }
+
+    if (ftruncate(_fd, off_t(SEGMENT_LEN)) != 0) {
+        LogErr() << "Could not grow " << path.str() << ": " << strerror(errno);
+        ::close(_fd);
+        _fd = -1;
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, SEGMENT_LEN, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (mapping == MAP_FAILED) {
+        LogErr() << "Could not map " << path.str() << ": " << strerror(errno);
+        ::close(_fd);
+        _fd = -1;
+        return false;
+    }
+
+    _mapping = static_cast<uint8_t *>(mapping);
+    _written = 0;
+    _flushed = 0;
+    return true;
+#endif
+}
+
+void TrafficCapture::flush_segment()
+{
+#ifndef WINDOWS
+    if (_mapping == nullptr || _written == _flushed) {
+        return;
+    }
+
+    // From the page the last flush ended in, the kernel writes it back meanwhile.
+    const size_t page_len = size_t(sysconf(_SC_PAGESIZE));
+    const size_t begin = _flushed / page_len * page_len;
+    msync(_mapping + begin, _written - begin, MS_ASYNC);
+    _flushed = _written;
+#endif
+}
+
+void TrafficCapture::close_segment()
+{
+#ifndef WINDOWS
+    if (_fd < 0) {
+        return;
+    }
+
+    flush_segment();
+    munmap(_mapping, SEGMENT_LEN);
+    _mapping = nullptr;
+
+    if (ftruncate(_fd, off_t(_written)) != 0) {
+        LogWarn() << "Could not cut capture segment: " << strerror(errno);
+    }
+    ::close(_fd);
+    _fd = -1;
+#endif
+}
+
+} // namespace dronecore
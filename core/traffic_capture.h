@@ -0,0 +1,110 @@
+#pragma once
+
+#include "mavlink_include.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace dronecore {
+
+// Records the frames received and sent on a connection as a tlog, which
+// ReplayConnection plays back like one written by QGroundControl: each frame
+// after the time it went through, as big endian microseconds since the epoch.
+//
+// The threads receiving and sending only copy the frame into a slot of a
+// lock-free ring, they never wait for the file. If the ring is full, the frame
+// is dropped and counted. A thread of its own empties the ring every
+// FLUSH_INTERVAL_S into the memory-mapped segment and lets the kernel write it
+// back in the background.
+//
+// The recording is split into segments of up to SEGMENT_LEN bytes, named
+// <path>-0000.tlog, <path>-0001.tlog and so on, each a complete tlog. A
+// segment is made at full length and cut to what was written when the next
+// one starts; after a crash the zeros at the end read like the end of the log.
+class TrafficCapture
+{
+public:
+    static constexpr size_t NUM_SLOTS = 4096;
+    static constexpr size_t SEGMENT_LEN = 64 * 1024 * 1024;
+    static constexpr double FLUSH_INTERVAL_S = 0.05;
+    static constexpr size_t TIME_LEN = 8;
+
+    TrafficCapture();
+    ~TrafficCapture();
+
+    // Returns false if the first segment could not be made, or memory-mapped
+    // files are not supported on this platform.
+    bool open(const std::string &path);
+    // Writes out what is left and cuts the last segment.
+    void close();
+    bool is_open() const { return _open.load(std::memory_order_relaxed); }
+
+    // Can be called from any thread. Does nothing if not open.
+    void add(const uint8_t *frame, unsigned frame_len, int64_t steady_ns);
+
+    uint64_t num_dropped() const { return _num_dropped.load(std::memory_order_relaxed); }
+
+    // Non-copyable
+    TrafficCapture(const TrafficCapture &) = delete;
+    const TrafficCapture &operator=(const TrafficCapture &) = delete;
+
+private:
+    struct Slot {
+        // As in the bounded queue of Dmitry Vyukov: the position the slot is
+        // free for, plus one once it is written.
+        std::atomic<size_t> sequence;
+        uint64_t time_us;
+        uint16_t len;
+        uint8_t data[MAVLINK_MAX_PACKET_LEN];
+    };
+
+    bool push(const uint8_t *frame, unsigned frame_len, uint64_t time_us);
+    // Only used by the writer thread.
+    bool pop(Slot &slot);
+
+    void write_loop();
+    // Return false if the segment could not be made or written.
+    bool write_record(const Slot &slot);
+    bool open_segment();
+    void close_segment();
+    void flush_segment();
+
+    static constexpr size_t SLOT_MASK = NUM_SLOTS - 1;
+    static_assert((NUM_SLOTS & SLOT_MASK) == 0, "The number of slots needs to be a power of two");
+
+    // Only made on the first open, and kept until destruction so that a late
+    // add() never touches freed memory.
+    std::unique_ptr<Slot[]> _slots {};
+    std::atomic<size_t> _enqueue_position {0};
+    size_t _dequeue_position = 0;
+
+    std::atomic<bool> _open {false};
+    // Taken by add() while it pushes, so that close() writes out all of them.
+    std::atomic<unsigned> _num_adding {0};
+    std::atomic<uint64_t> _num_dropped {0};
+    // Microseconds to add to the steady clock for the time since the epoch.
+    std::atomic<int64_t> _epoch_offset_us {0};
+
+    // Guards open() and close() against each other.
+    std::mutex _open_mutex {};
+    std::string _path {};
+
+    std::mutex _writer_mutex {};
+    std::condition_variable _writer_cv {};
+    bool _should_exit = false;
+    std::thread *_writer_thread = nullptr;
+
+    // Only used by the writer thread once it runs.
+    unsigned _segment_index = 0;
+    int _fd = -1;
+    uint8_t *_mapping = nullptr;
+    size_t _written = 0;
+    size_t _flushed = 0;
+};
+
+} // namespace dronecore
@@ -0,0 +1,85 @@
+#include "traffic_capture.h"
+#include "replay_reader.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace dronecore;
+
+#ifndef WINDOWS
+
+namespace {
+
+// A MAVLink 2 header with the payload length, the rest is not looked at.
+std::vector<uint8_t> make_frame(uint8_t payload_len, uint8_t fill)
+{
+    std::vector<uint8_t> frame(12u + payload_len, fill);
+    frame[0] = 0xFD;
+    frame[1] = payload_len;
+    frame[2] = 0;
+    return frame;
+}
+
+} // namespace
+
+TEST(TrafficCapture, WritesATlogTheReplayReads)
+{
+    const std::string path = "/tmp/dronecore_capture_test";
+    const std::string segment_path = path + "-0000.tlog";
+
+    TrafficCapture capture;
+    EXPECT_FALSE(capture.is_open());
+    // Not recorded while closed.
+    const std::vector<uint8_t> before = make_frame(3, 7);
+    capture.add(before.data(), unsigned(before.size()), 0);
+
+    ASSERT_TRUE(capture.open(path));
+    EXPECT_TRUE(capture.is_open());
+
+    // Added from several threads at once, like receiving and sending.
+    const unsigned num_threads = 4;
+    const unsigned num_per_thread = 500;
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&capture, t]() {
+            const std::vector<uint8_t> frame = make_frame(uint8_t(10 + t), uint8_t(t));
+            for (unsigned i = 0; i < num_per_thread; ++i) {
+                capture.add(frame.data(), unsigned(frame.size()), int64_t(i) * 1000000);
+                if (i % 100 == 0) {
+                    // Gives the writer a chance, the ring only has NUM_SLOTS.
+                    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    capture.close();
+    EXPECT_FALSE(capture.is_open());
+
+    ReplayReader reader;
+    ASSERT_TRUE(reader.open(segment_path));
+    ReplayReader::Record record;
+    std::vector<unsigned> num_of_thread(num_threads, 0);
+    unsigned num_records = 0;
+    while (reader.read_next(record)) {
+        ++num_records;
+        ASSERT_GE(record.data.size(), 12u);
+        const uint8_t t = uint8_t(record.data[1] - 10);
+        ASSERT_LT(t, num_threads);
+        EXPECT_EQ(record.data.size(), 12u + 10 + t);
+        EXPECT_EQ(record.data.back(), t);
+        ++num_of_thread[t];
+    }
+    EXPECT_EQ(capture.num_dropped(), 0u);
+    EXPECT_EQ(num_records, num_threads * num_per_thread);
+    for (unsigned t = 0; t < num_threads; ++t) {
+        EXPECT_EQ(num_of_thread[t], num_per_thread);
+    }
+
+    std::remove(segment_path.c_str());
+}
+
+#endif
@@ -1,6 +1,8 @@
 #include "udp_connection.h"
 #include "global_include.h"
+#include "io_reactor.h"
 #include "log.h"
+#include "thread_roles.h"
 
 #ifndef WINDOWS
 #include <netinet/in.h>
@@ -9,13 +11,13 @@
 #include <errno.h>
 #include <unistd.h> // for close()
 #else
-#include <winsock2.h>
 #include <Ws2tcpip.h> // For InetPton
-#undef SOCKET_ERROR // conflicts with ConnectionResult::SOCKET_ERROR
 #pragma comment(lib, "Ws2_32.lib") // Without this, Ws2_32.lib is not included in static library.
 #endif
 
-#include <cassert>
+#include <cstring>
+#include <functional>
+#include <ctime>
 
 #ifndef WINDOWS
 #define GET_ERROR(_x) strerror(_x)
@@ -25,10 +27,24 @@
 
 namespace dronecore {
 
+constexpr size_t UdpConnection::RECV_BUFFER_LEN;
+#if defined(LINUX)
+constexpr size_t UdpConnection::RECV_CONTROL_LEN;
+#endif
+
 UdpConnection::UdpConnection(DroneCoreImpl &parent,
-                             int local_port_number):
+                             int local_port_number,
+                             const DroneCore::UdpConfig &config):
     Connection(parent),
-    _local_port_number(local_port_number) {}
+    _local_port_number(local_port_number),
+    _config(config),
+    _recv_batch_size(config.recv_batch_size)
+{
+    if (_recv_batch_size == 0) {
+        LogWarn() << "Receive batch size of 0 not possible, using 1 instead";
+        _recv_batch_size = 1;
+    }
+}
 
 UdpConnection::~UdpConnection()
 {
@@ -43,9 +59,7 @@ bool UdpConnection::is_ok() const
 
 ConnectionResult UdpConnection::start()
 {
-    if (!start_mavlink_receiver()) {
-        return ConnectionResult::CONNECTIONS_EXHAUSTED;
-    }
+    start_mavlink_receiver();
 
     ConnectionResult ret = setup_port();
     if (ret != ConnectionResult::SUCCESS) {
@@ -57,6 +71,33 @@ ConnectionResult UdpConnection::start()
     return ConnectionResult::SUCCESS;
 }
 
+ConnectionResult UdpConnection::start(IoReactor &reactor)
+{
+    start_mavlink_receiver();
+
+    ConnectionResult ret = setup_port();
+    if (ret != ConnectionResult::SUCCESS) {
+        return ret;
+    }
+
+#if defined(LINUX)
+    setup_recv_batch();
+#endif
+
+    // Only blocking reads busy poll, so that needs a thread of its own.
+    using namespace std::placeholders;
+    if (_config.busy_poll_us == 0 &&
+        (reactor.add_datagram_fd(_socket_fd, std::bind(&UdpConnection::receive_datagram, this,
+                                                       _1)) ||
+         reactor.add_fd(_socket_fd, std::bind(&UdpConnection::receive_once, this, false)))) {
+        _reactor = &reactor;
+    } else {
+        start_recv_thread();
+    }
+
+    return ConnectionResult::SUCCESS;
+}
+
 ConnectionResult UdpConnection::setup_port()
 {
 
@@ -75,6 +116,8 @@ ConnectionResult UdpConnection::setup_port()
         return ConnectionResult::SOCKET_ERROR;
     }
 
+    setup_socket_options();
+
     struct sockaddr_in addr {};
     addr.sin_family = AF_INET;
     addr.sin_port = htons(_local_port_number);
@@ -88,15 +131,100 @@ ConnectionResult UdpConnection::setup_port()
     return ConnectionResult::SUCCESS;
 }
 
+void UdpConnection::setup_socket_options()
+{
+    // None of these is needed to work, so failing is only warned about.
+    if (_config.recv_buffer_bytes > 0) {
+        const int len = _config.recv_buffer_bytes;
+        if (setsockopt(_socket_fd, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char *>(&len),
+                       sizeof(len)) != 0) {
+            LogWarn() << "Could not set receive buffer: " << GET_ERROR(errno);
+        }
+    }
+    if (_config.send_buffer_bytes > 0) {
+        const int len = _config.send_buffer_bytes;
+        if (setsockopt(_socket_fd, SOL_SOCKET, SO_SNDBUF, reinterpret_cast<const char *>(&len),
+                       sizeof(len)) != 0) {
+            LogWarn() << "Could not set send buffer: " << GET_ERROR(errno);
+        }
+    }
+
+    // What is given is capped silently, by net.core.rmem_max and wmem_max on Linux.
+    int recv_len = 0;
+    int send_len = 0;
+    socklen_t opt_len = sizeof(recv_len);
+    getsockopt(_socket_fd, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<char *>(&recv_len), &opt_len);
+    opt_len = sizeof(send_len);
+    getsockopt(_socket_fd, SOL_SOCKET, SO_SNDBUF, reinterpret_cast<char *>(&send_len), &opt_len);
+#if defined(LINUX)
+    // Linux doubles what it is asked for, for its own bookkeeping.
+    recv_len /= 2;
+    send_len /= 2;
+#endif
+    if (recv_len < _config.recv_buffer_bytes) {
+        LogWarn() << "Receive buffer of " << recv_len << " bytes instead of "
+                  << _config.recv_buffer_bytes;
+    }
+    if (send_len < _config.send_buffer_bytes) {
+        LogWarn() << "Send buffer of " << send_len << " bytes instead of "
+                  << _config.send_buffer_bytes;
+    }
+
+#if defined(LINUX)
+    if (_config.kernel_timestamps) {
+        const int enable = 1;
+        if (setsockopt(_socket_fd, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) != 0) {
+            LogWarn() << "Could not enable kernel timestamps: " << GET_ERROR(errno);
+        }
+    }
+    if (_config.busy_poll_us > 0) {
+        const int busy_poll_us = int(_config.busy_poll_us);
+        if (setsockopt(_socket_fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us,
+                       sizeof(busy_poll_us)) != 0) {
+            LogWarn() << "Could not enable busy polling: " << GET_ERROR(errno);
+        }
+    }
+#else
+    if (_config.kernel_timestamps || _config.busy_poll_us > 0) {
+        LogWarn() << "Kernel timestamps and busy polling only supported on Linux";
+    }
+#endif
+}
+
 void UdpConnection::start_recv_thread()
 {
+#if defined(LINUX)
+    setup_recv_batch();
+#endif
     _recv_thread = new std::thread(receive, this);
 }
 
+void UdpConnection::request_stop()
+{
+    _should_exit = true;
+
+    if (_recv_thread) {
+        // Interrupts recv/recvfrom, the socket is closed in stop().
+#ifndef WINDOWS
+        shutdown(_socket_fd, SHUT_RDWR);
+#else
+        shutdown(_socket_fd, SD_BOTH);
+#endif
+    }
+}
+
 ConnectionResult UdpConnection::stop()
 {
     _should_exit = true;
 
+    // It still sends on the socket, which is shut down below.
+    stop_outgoing_scheduler();
+
+    if (_reactor) {
+        _reactor->remove_fd(_socket_fd);
+        _reactor = nullptr;
+    }
+
 #ifndef WINDOWS
     // This should interrupt a recv/recvfrom call.
     shutdown(_socket_fd, SHUT_RDWR);
@@ -124,40 +252,115 @@ ConnectionResult UdpConnection::stop()
     return ConnectionResult::SUCCESS;
 }
 
-bool UdpConnection::send_message(const mavlink_message_t &message)
+bool UdpConnection::send_frame(const uint8_t *frame, unsigned frame_len, uint8_t target_system)
 {
-    struct sockaddr_in dest_addr {};
-
+    std::vector<struct sockaddr_in> dest_addrs;
     {
         std::lock_guard<std::mutex> lock(_remote_mutex);
 
-        if (_remote_ip.empty()) {
-            LogErr() << "Remote IP unknown";
+        if (_remotes.empty()) {
+            LogErr() << "Remote unknown";
             return false;
         }
+        add_dest_addrs(target_system, dest_addrs);
+    }
+
+    bool success = true;
+    for (const auto &dest_addr : dest_addrs) {
+        success = send_to(dest_addr, frame, frame_len) && success;
+    }
+    return success;
+}
+
+bool UdpConnection::send_frames(const Frame *frames, size_t num_frames)
+{
+#if defined(LINUX)
+    std::lock_guard<std::mutex> send_lock(_send_mutex);
 
-        if (_remote_port_number == 0) {
-            LogErr() << "Remote port unknown";
+    _send_dest_addrs.clear();
+    _send_iovecs.clear();
+    {
+        std::lock_guard<std::mutex> lock(_remote_mutex);
+
+        if (_remotes.empty()) {
+            LogErr() << "Remote unknown";
             return false;
         }
 
-        dest_addr.sin_family = AF_INET;
+        // One datagram for every frame and address it goes to.
+        for (size_t i = 0; i < num_frames; ++i) {
+            const size_t first = _send_dest_addrs.size();
+            add_dest_addrs(frames[i].target_system, _send_dest_addrs);
+            for (size_t j = first; j < _send_dest_addrs.size(); ++j) {
+                struct iovec iovec {};
+                iovec.iov_base = const_cast<uint8_t *>(frames[i].data);
+                iovec.iov_len = frames[i].len;
+                _send_iovecs.push_back(iovec);
+            }
+        }
+    }
 
-        inet_pton(AF_INET, _remote_ip.c_str(), &dest_addr.sin_addr.s_addr);
+    // Only now that the vectors don't grow anymore, they can be pointed to.
+    _send_msgs.resize(_send_dest_addrs.size());
+    for (size_t i = 0; i < _send_msgs.size(); ++i) {
+        struct msghdr &header = _send_msgs[i].msg_hdr;
+        header = msghdr {};
+        header.msg_name = &_send_dest_addrs[i];
+        header.msg_namelen = sizeof(_send_dest_addrs[i]);
+        header.msg_iov = &_send_iovecs[i];
+        header.msg_iovlen = 1;
+    }
 
-        dest_addr.sin_port = htons(_remote_port_number);
+    // It can send fewer than asked for, e.g. if the socket buffer is full.
+    size_t num_sent = 0;
+    while (num_sent < _send_msgs.size()) {
+        const int ret = sendmmsg(_socket_fd, &_send_msgs[num_sent],
+                                 unsigned(_send_msgs.size() - num_sent), 0);
+        if (ret <= 0) {
+            LogErr() << "sendmmsg failure: " << GET_ERROR(errno);
+            return false;
+        }
+        num_sent += size_t(ret);
     }
+    return true;
+#else
+    return Connection::send_frames(frames, num_frames);
+#endif
+}
 
-    uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
-    uint16_t buffer_len = mavlink_msg_to_send_buffer(buffer, &message);
+void UdpConnection::add_dest_addrs(uint8_t target_system,
+                                   std::vector<struct sockaddr_in> &dest_addrs) const
+{
+    auto it = _remotes.find(target_system);
+    if (target_system != 0 && it != _remotes.end()) {
+        dest_addrs.push_back(it->second);
+        return;
+    }
 
-    // TODO: remove this assert again
-    assert(buffer_len <= MAVLINK_MAX_PACKET_LEN);
+    // Several systems can be behind the same address, e.g. a
+    // companion computer, they only need it once.
+    const size_t first = dest_addrs.size();
+    for (const auto &remote : _remotes) {
+        bool is_new = true;
+        for (size_t i = first; i < dest_addrs.size(); ++i) {
+            if (is_same_address(dest_addrs[i], remote.second)) {
+                is_new = false;
+                break;
+            }
+        }
+        if (is_new) {
+            dest_addrs.push_back(remote.second);
+        }
+    }
+}
 
-    int send_len = sendto(_socket_fd, reinterpret_cast<char *>(buffer), buffer_len, 0,
+bool UdpConnection::send_to(const struct sockaddr_in &dest_addr,
+                            const uint8_t *buffer, unsigned buffer_len)
+{
+    int send_len = sendto(_socket_fd, reinterpret_cast<const char *>(buffer), buffer_len, 0,
                           reinterpret_cast<const sockaddr *>(&dest_addr), sizeof(dest_addr));
 
-    if (send_len != buffer_len) {
+    if (send_len != int(buffer_len)) {
         LogErr() << "sendto failure: " << GET_ERROR(errno);
         return false;
     }
@@ -165,67 +368,205 @@ bool UdpConnection::send_message(const mavlink_message_t &message)
     return true;
 }
 
+bool UdpConnection::is_same_address(const struct sockaddr_in &lhs,
+                                    const struct sockaddr_in &rhs)
+{
+    return lhs.sin_addr.s_addr == rhs.sin_addr.s_addr && lhs.sin_port == rhs.sin_port;
+}
+
 void UdpConnection::receive(UdpConnection *parent)
 {
-    // Enough for MTU 1500 bytes.
-    char buffer[2048];
+    ThreadRoles::apply_to_this_thread(DroneCore::ThreadRole::RECEIVE, "udp_receive");
 
     while (!parent->_should_exit) {
+        parent->receive_once(true);
+    }
+}
 
-        struct sockaddr_in src_addr = {};
-        socklen_t src_addr_len = sizeof(src_addr);
-        int recv_len = recvfrom(parent->_socket_fd, buffer, sizeof(buffer), 0,
-                                reinterpret_cast<struct sockaddr *>(&src_addr), &src_addr_len);
+void UdpConnection::receive_once(bool blocking)
+{
+#ifndef WINDOWS
+    const int flags = blocking ? 0 : MSG_DONTWAIT;
+#else
+    UNUSED(blocking);
+    const int flags = 0;
+#endif
 
-        if (recv_len == 0) {
-            // This can happen when shutdown is called on the socket,
-            // therefore we check _should_exit again.
-            continue;
-        }
+#if defined(LINUX)
+    if (!_recv_msgs.empty()) {
+        receive_batched(flags);
+        return;
+    }
+#endif
+    receive_single(flags);
+}
 
-        if (recv_len < 0) {
-            // This happens on desctruction when close(_socket_fd) is called,
-            // therefore be quiet.
-            //LogErr() << "recvfrom error: " << GET_ERROR(errno);
-            continue;
-        }
+void UdpConnection::receive_single(int flags)
+{
+    char buffer[RECV_BUFFER_LEN];
 
-        {
-            std::lock_guard<std::mutex> lock(parent->_remote_mutex);
+    struct sockaddr_in src_addr = {};
+    socklen_t src_addr_len = sizeof(src_addr);
+    int recv_len = recvfrom(_socket_fd, buffer, sizeof(buffer), flags,
+                            reinterpret_cast<struct sockaddr *>(&src_addr), &src_addr_len);
 
-            int new_remote_port_number = ntohs(src_addr.sin_port);
-            std::string new_remote_ip(inet_ntoa(src_addr.sin_addr));
+    if (recv_len == 0) {
+        // This can happen when shutdown is called on the socket,
+        // therefore we check _should_exit again.
+        return;
+    }
 
-            if (parent->_remote_ip.empty() ||
-                parent->_remote_port_number == 0) {
+    if (recv_len < 0) {
+        // This happens on desctruction when close(_socket_fd) is called,
+        // therefore be quiet.
+        //LogErr() << "recvfrom error: " << GET_ERROR(errno);
+        return;
+    }
 
-                // Set IP if we don't know it yet.
-                parent->_remote_ip = new_remote_ip;
-                parent->_remote_port_number = new_remote_port_number;
+    handle_datagram(src_addr, buffer, recv_len, std::chrono::steady_clock::now());
+}
 
-                LogInfo() << "New device on: " << parent->_remote_ip
-                          << ":" << parent->_remote_port_number;
+#if defined(LINUX)
+void UdpConnection::setup_recv_batch()
+{
+    // Also for single datagrams if the timestamps are needed, as they come with
+    // the control data which recvfrom() does not give.
+    if (_recv_batch_size <= 1 && !_config.kernel_timestamps) {
+        return;
+    }
 
-            } else if (parent->_remote_ip.compare(new_remote_ip) != 0 ||
-                       parent->_remote_port_number != new_remote_port_number) {
+    _recv_buffers.resize(_recv_batch_size * RECV_BUFFER_LEN);
+    if (_config.kernel_timestamps) {
+        _recv_controls.resize(_recv_batch_size * RECV_CONTROL_LEN);
+    }
+    _recv_src_addrs.resize(_recv_batch_size);
+    _recv_iovecs.resize(_recv_batch_size);
+    _recv_msgs.resize(_recv_batch_size);
+}
 
-                // It is possible that wifi disconnects and a device might get a new
-                // IP and/or UDP port.
-                parent->_remote_ip = new_remote_ip;
-                parent->_remote_port_number = new_remote_port_number;
+void UdpConnection::receive_batched(int flags)
+{
+    const unsigned batch_size = _recv_msgs.size();
+
+    for (unsigned i = 0; i < batch_size; ++i) {
+        _recv_iovecs[i].iov_base = &_recv_buffers[i * RECV_BUFFER_LEN];
+        _recv_iovecs[i].iov_len = RECV_BUFFER_LEN;
+        _recv_msgs[i] = {};
+        _recv_msgs[i].msg_hdr.msg_name = &_recv_src_addrs[i];
+        _recv_msgs[i].msg_hdr.msg_namelen = sizeof(_recv_src_addrs[i]);
+        _recv_msgs[i].msg_hdr.msg_iov = &_recv_iovecs[i];
+        _recv_msgs[i].msg_hdr.msg_iovlen = 1;
+        if (!_recv_controls.empty()) {
+            _recv_msgs[i].msg_hdr.msg_control = &_recv_controls[i * RECV_CONTROL_LEN];
+            _recv_msgs[i].msg_hdr.msg_controllen = RECV_CONTROL_LEN;
+        }
+    }
 
-                LogInfo() << "Device changed to: " << new_remote_ip << ":" << new_remote_port_number;
-            }
+    // With MSG_WAITFORONE we block until at least one datagram is there
+    // and then collect whatever else is already queued.
+    int num_received = recvmmsg(_socket_fd, _recv_msgs.data(), batch_size,
+                                flags | MSG_WAITFORONE, nullptr);
+
+    if (num_received <= 0) {
+        // This happens on desctruction when close(_socket_fd) is called,
+        // therefore be quiet and check _should_exit again.
+        return;
+    }
+
+    // Without timestamps, they all arrived by now.
+    const auto now = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_received; ++i) {
+        if (_recv_msgs[i].msg_len == 0) {
+            continue;
         }
+        const struct msghdr &header = _recv_msgs[i].msg_hdr;
+        handle_datagram(_recv_src_addrs[i], &_recv_buffers[i * RECV_BUFFER_LEN],
+                        static_cast<int>(_recv_msgs[i].msg_len),
+                        _recv_controls.empty() ? now :
+                        arrival_time_of(header.msg_control, unsigned(header.msg_controllen)));
+    }
+}
+#endif
 
-        parent->_mavlink_receiver->set_new_datagram(buffer, recv_len);
+void UdpConnection::receive_datagram(const IoReactor::Datagram &datagram)
+{
+    struct sockaddr_in addr {};
+    if (datagram.src_addr_len < sizeof(addr)) {
+        return;
+    }
+    memcpy(&addr, datagram.src_addr, sizeof(addr));
+    handle_datagram(addr, datagram.data, int(datagram.len),
+                    arrival_time_of(datagram.control, datagram.control_len));
+}
 
-        // Parse all mavlink messages in one datagram. Once exhausted, we'll exit while.
-        while (parent->_mavlink_receiver->parse_message()) {
-            parent->receive_message(parent->_mavlink_receiver->get_last_message());
+std::chrono::steady_clock::time_point UdpConnection::arrival_time_of(const void *control,
+                                                                     unsigned control_len)
+{
+    const auto now = std::chrono::steady_clock::now();
+
+#if defined(LINUX)
+    struct msghdr header {};
+    header.msg_control = const_cast<void *>(control);
+    header.msg_controllen = control_len;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&header); cmsg;
+         cmsg = CMSG_NXTHDR(&header, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_TIMESTAMPNS) {
+            continue;
+        }
+        struct timespec stamp;
+        memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+
+        // The kernel stamps by the wall clock, so it is taken to the steady
+        // clock by how long ago that was.
+        const auto age = std::chrono::system_clock::now().time_since_epoch() -
+                         (std::chrono::seconds(stamp.tv_sec) +
+                          std::chrono::nanoseconds(stamp.tv_nsec));
+        if (age <= std::chrono::system_clock::duration::zero()) {
+            // The wall clock was set back in between.
+            return now;
         }
+        return now - std::chrono::duration_cast<std::chrono::steady_clock::duration>(age);
     }
+#else
+    UNUSED(control);
+    UNUSED(control_len);
+#endif
+    return now;
 }
 
+void UdpConnection::handle_datagram(const struct sockaddr_in &src_addr,
+                                    char *buffer, int buffer_len,
+                                    std::chrono::steady_clock::time_point arrival_time)
+{
+    _mavlink_receiver->set_new_datagram(buffer, buffer_len, arrival_time);
+    TimeBatch time_batch;
+
+    // Parse all mavlink messages in one datagram. Once exhausted, we'll exit while.
+    while (_mavlink_receiver->parse_message()) {
+        update_remote(_mavlink_receiver->get_last_message_view().sysid(), src_addr);
+        receive_message(_mavlink_receiver->get_last_message_view());
+    }
+}
+
+void UdpConnection::update_remote(uint8_t system_id, const struct sockaddr_in &src_addr)
+{
+    std::lock_guard<std::mutex> lock(_remote_mutex);
+
+    auto it = _remotes.find(system_id);
+    if (it == _remotes.end()) {
+        _remotes.insert(std::make_pair(system_id, src_addr));
+
+        LogInfo() << "New device on: " << inet_ntoa(src_addr.sin_addr)
+                  << ":" << ntohs(src_addr.sin_port) << " (system " << int(system_id) << ")";
+
+    } else if (!is_same_address(it->second, src_addr)) {
+        // It is possible that wifi disconnects and a device might get a new
+        // IP and/or UDP port.
+        it->second = src_addr;
+
+        LogInfo() << "Device changed to: " << inet_ntoa(src_addr.sin_addr)
+                  << ":" << ntohs(src_addr.sin_port) << " (system " << int(system_id) << ")";
+    }
+}
 
 } // namespace dronecore
@@ -4,20 +4,40 @@
 #include <mutex>
 #include <thread>
 #include <atomic>
+#include <chrono>
+#include <map>
+#include <vector>
 #include "connection.h"
+#include "io_reactor.h"
+
+#ifndef WINDOWS
+#include <netinet/in.h>
+#include <sys/socket.h>
+#else
+#include <winsock2.h>
+#undef SOCKET_ERROR // conflicts with ConnectionResult::SOCKET_ERROR
+#endif
 
 namespace dronecore {
 
 class UdpConnection : public Connection
 {
 public:
-    explicit UdpConnection(DroneCoreImpl &parent, int local_port_number);
+    explicit UdpConnection(DroneCoreImpl &parent, int local_port_number,
+                           const DroneCore::UdpConfig &config = DroneCore::UdpConfig());
     ~UdpConnection();
     bool is_ok() const;
     ConnectionResult start();
+    ConnectionResult start(IoReactor &reactor);
     ConnectionResult stop();
+    void request_stop() override;
 
-    bool send_message(const mavlink_message_t &message);
+    // Sent to the system the frame is for, if it is known on which address
+    // it is. Frames for all systems, without a target or for a system not
+    // heard of yet go to all addresses known.
+    bool send_frame(const uint8_t *frame, unsigned frame_len, uint8_t target_system) override;
+    // Where sendmmsg exists, all frames go out with one call.
+    bool send_frames(const Frame *frames, size_t num_frames) override;
 
     // Non-copyable
     UdpConnection(const UdpConnection &) = delete;
@@ -25,17 +45,64 @@ public:
 
 private:
     ConnectionResult setup_port();
+    void setup_socket_options();
     void start_recv_thread();
 
     static void receive(UdpConnection *parent);
+    void receive_once(bool blocking);
+    void receive_single(int flags);
+#if defined(LINUX)
+    void setup_recv_batch();
+    void receive_batched(int flags);
+#endif
+    // Of the datagrams the reactor received itself.
+    void receive_datagram(const IoReactor::Datagram &datagram);
+    // When the kernel received the datagram, by the timestamp in its control
+    // data, or now if there is none.
+    static std::chrono::steady_clock::time_point arrival_time_of(const void *control,
+                                                                 unsigned control_len);
+    void handle_datagram(const struct sockaddr_in &src_addr, char *buffer, int buffer_len,
+                         std::chrono::steady_clock::time_point arrival_time);
+    void update_remote(uint8_t system_id, const struct sockaddr_in &src_addr);
+    // We assume that we already acquired _remote_mutex in this function.
+    void add_dest_addrs(uint8_t target_system, std::vector<struct sockaddr_in> &dest_addrs) const;
+    bool send_to(const struct sockaddr_in &dest_addr, const uint8_t *buffer, unsigned buffer_len);
+    static bool is_same_address(const struct sockaddr_in &lhs, const struct sockaddr_in &rhs);
+
+    // Enough for MTU 1500 bytes.
+    static constexpr size_t RECV_BUFFER_LEN = 2048;
+#if defined(LINUX)
+    // Enough for the timestamp, the only control data asked for.
+    static constexpr size_t RECV_CONTROL_LEN = CMSG_SPACE(sizeof(struct timespec));
+#endif
 
     int _local_port_number;
+    DroneCore::UdpConfig _config;
+    // Maximum number of datagrams pulled in by one receive call, only
+    // honoured where recvmmsg exists.
+    unsigned _recv_batch_size;
 
+    // Where each system was last heard from, by system id.
     std::mutex _remote_mutex = {};
-    std::string _remote_ip = {};
-    int _remote_port_number = 0;
+    std::map<uint8_t, struct sockaddr_in> _remotes = {};
+
+#if defined(LINUX)
+    // Allocated once in start() and then reused for every recvmmsg call.
+    std::vector<char> _recv_buffers {};
+    std::vector<struct sockaddr_in> _recv_src_addrs {};
+    std::vector<char> _recv_controls {};
+    std::vector<struct iovec> _recv_iovecs {};
+    std::vector<struct mmsghdr> _recv_msgs {};
+
+    // Reused for every sendmmsg call.
+    std::mutex _send_mutex {};
+    std::vector<struct sockaddr_in> _send_dest_addrs {};
+    std::vector<struct iovec> _send_iovecs {};
+    std::vector<struct mmsghdr> _send_msgs {};
+#endif
 
     int _socket_fd = -1;
+    IoReactor *_reactor = nullptr;
     std::thread *_recv_thread = nullptr;
     std::atomic_bool _should_exit {false};
 };
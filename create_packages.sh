@@ -23,9 +23,11 @@ library_files="\
     build/default/core/libdronecore.so=/usr/lib/libdronecore.so \
     plugins/action/action.h=/usr/include/dronecore/action.h \
     plugins/follow_me/follow_me.h=/usr/include/dronecore/follow_me.h \
+    plugins/ftp/ftp.h=/usr/include/dronecore/ftp.h \
     plugins/gimbal/gimbal.h=/usr/include/dronecore/gimbal.h \
     plugins/info/info.h=/usr/include/dronecore/info.h \
     plugins/logging/logging.h=/usr/include/dronecore/logging.h \
+    plugins/logging/ulog_reader.h=/usr/include/dronecore/ulog_reader.h \
     plugins/mission/mission.h=/usr/include/dronecore/mission.h \
     plugins/mission/mission_item.h=/usr/include/dronecore/mission_item.h \
     plugins/offboard/offboard.h=/usr/include/dronecore/offboard.h \
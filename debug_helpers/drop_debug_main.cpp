@@ -3,10 +3,6 @@
 #include "dronecore.h"
 #include <thread>
 
-#if DROP_DEBUG != 1
-#error DROB_DEBUG needs to be set for this test to work
-#endif
-
 #define UNUSED(x) (void)(x)
 
 bool _discovered_system = false;
@@ -35,6 +31,13 @@ int main(int argc, const char *argv[])
         if (!_discovered_system) {
             std::cout << "waiting for system to appear..." << std::endl;
         }
+        for (const auto &stats : dc.link_stats()) {
+            std::cout << "received: " << stats.num_bytes_received << " bytes, "
+                      << stats.num_messages_received << " messages, lost: "
+                      << stats.num_lost << ", CRC errors: " << stats.num_crc_errors
+                      << ", resyncs: " << stats.num_resyncs
+                      << ", discarded: " << stats.num_bytes_discarded << " bytes" << std::endl;
+        }
         std::this_thread::sleep_for(std::chrono::seconds(1));
     }
 
@@ -0,0 +1,786 @@
+// Pretends to be many vehicles at once, to find out how DroneCore scales
+// without running a simulator for each of them. Every vehicle streams
+// heartbeats and telemetry, acks commands and answers parameter requests,
+// so that it is discovered and can be used like a real one.
+//
+// Usage: load_generator <num_vehicles> [url] [telemetry_rate_hz]
+//
+//   udp://host:port  sends to DroneCore listening there, the default is
+//                    udp://127.0.0.1:14540
+//   tcp://:port      listens for DroneCore to connect, as to tcp://host:port
+//   shm://name       as the other end of DroneCore's shm://name
+//
+// The vehicles have the system ids 1 to num_vehicles, so there are at most 254.
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "mavlink_include.h"
+#include "mavlink_receiver.h"
+#if defined(LINUX)
+#include "shm_ring.h"
+#endif
+
+namespace {
+
+typedef std::chrono::steady_clock clock_type;
+
+// Where the vehicles are, each sending the bytes of whole messages.
+class Link
+{
+public:
+    virtual ~Link() {}
+
+    virtual bool send(const uint8_t *data, unsigned data_len) = 0;
+
+    // Returns how many bytes were read, 0 after timeout_ms.
+    virtual int receive(uint8_t *buffer, unsigned buffer_len, int timeout_ms) = 0;
+};
+
+class UdpLink : public Link
+{
+public:
+    ~UdpLink()
+    {
+        if (_fd != -1) {
+            close(_fd);
+        }
+    }
+
+    bool open(const std::string &host, int port)
+    {
+        _fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (_fd == -1) {
+            std::cout << "socket failed: " << strerror(errno) << std::endl;
+            return false;
+        }
+
+        memset(&_remote, 0, sizeof(_remote));
+        _remote.sin_family = AF_INET;
+        _remote.sin_port = htons(uint16_t(port));
+        if (inet_pton(AF_INET, host.c_str(), &_remote.sin_addr) != 1) {
+            std::cout << "Invalid address: " << host << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool send(const uint8_t *data, unsigned data_len) override
+    {
+        // One datagram per message, as a flight controller sends them.
+        return sendto(_fd, data, data_len, 0, reinterpret_cast<const sockaddr *>(&_remote),
+                      sizeof(_remote)) == ssize_t(data_len);
+    }
+
+    int receive(uint8_t *buffer, unsigned buffer_len, int timeout_ms) override
+    {
+        pollfd fds = {_fd, POLLIN, 0};
+        if (poll(&fds, 1, timeout_ms) <= 0) {
+            return 0;
+        }
+        const ssize_t len = recv(_fd, buffer, buffer_len, 0);
+        return len > 0 ? int(len) : 0;
+    }
+
+private:
+    int _fd = -1;
+    sockaddr_in _remote {};
+};
+
+// Serves one client at a time, the next once it has gone.
+class TcpLink : public Link
+{
+public:
+    ~TcpLink()
+    {
+        close_client();
+        if (_listen_fd != -1) {
+            close(_listen_fd);
+        }
+    }
+
+    bool open(int port)
+    {
+        _listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (_listen_fd == -1) {
+            std::cout << "socket failed: " << strerror(errno) << std::endl;
+            return false;
+        }
+
+        const int enable = 1;
+        setsockopt(_listen_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+        sockaddr_in addr {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(uint16_t(port));
+        if (bind(_listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == -1 ||
+            listen(_listen_fd, 1) == -1) {
+            std::cout << "Could not listen on port " << port << ": " << strerror(errno)
+                      << std::endl;
+            return false;
+        }
+        std::cout << "Waiting for DroneCore on port " << port << std::endl;
+        return true;
+    }
+
+    bool send(const uint8_t *data, unsigned data_len) override
+    {
+        if (_client_fd == -1) {
+            return false;
+        }
+
+        unsigned sent_len = 0;
+        while (sent_len < data_len) {
+            const ssize_t len = ::send(_client_fd, data + sent_len, data_len - sent_len,
+                                       MSG_NOSIGNAL);
+            if (len <= 0) {
+                close_client();
+                return false;
+            }
+            sent_len += unsigned(len);
+        }
+        return true;
+    }
+
+    int receive(uint8_t *buffer, unsigned buffer_len, int timeout_ms) override
+    {
+        pollfd fds = {_client_fd != -1 ? _client_fd : _listen_fd, POLLIN, 0};
+        if (poll(&fds, 1, timeout_ms) <= 0) {
+            return 0;
+        }
+
+        if (_client_fd == -1) {
+            _client_fd = accept(_listen_fd, nullptr, nullptr);
+            if (_client_fd != -1) {
+                std::cout << "DroneCore connected" << std::endl;
+            }
+            return 0;
+        }
+
+        const ssize_t len = recv(_client_fd, buffer, buffer_len, 0);
+        if (len <= 0) {
+            std::cout << "DroneCore disconnected" << std::endl;
+            close_client();
+            return 0;
+        }
+        return int(len);
+    }
+
+private:
+    void close_client()
+    {
+        if (_client_fd != -1) {
+            close(_client_fd);
+            _client_fd = -1;
+        }
+    }
+
+    int _listen_fd = -1;
+    int _client_fd = -1;
+};
+
+#if defined(LINUX)
+// The vehicle side of ShmConnection, it writes to_ground and reads to_vehicle.
+class ShmLink : public Link
+{
+public:
+    ~ShmLink()
+    {
+        _send_ring.reset();
+        _receive_ring.reset();
+        if (_segment != nullptr) {
+            munmap(_segment, sizeof(dronecore::ShmSegment));
+        }
+        if (_fd != -1) {
+            close(_fd);
+        }
+    }
+
+    bool open(const std::string &name)
+    {
+        const std::string path = "/" + name;
+        _fd = shm_open(path.c_str(), O_RDWR | O_CREAT, 0660);
+        struct stat st;
+        if (_fd == -1 || fstat(_fd, &st) == -1 ||
+            (size_t(st.st_size) < sizeof(dronecore::ShmSegment) &&
+             ftruncate(_fd, sizeof(dronecore::ShmSegment)) == -1)) {
+            std::cout << "Could not open shared memory " << path << ": " << strerror(errno)
+                      << std::endl;
+            return false;
+        }
+
+        void *memory = mmap(nullptr, sizeof(dronecore::ShmSegment), PROT_READ | PROT_WRITE,
+                            MAP_SHARED, _fd, 0);
+        if (memory == MAP_FAILED) {
+            std::cout << "mmap " << path << " failed: " << strerror(errno) << std::endl;
+            return false;
+        }
+        _segment = static_cast<dronecore::ShmSegment *>(memory);
+
+        uint32_t magic = 0;
+        if (!_segment->magic.compare_exchange_strong(magic, dronecore::ShmSegment::MAGIC) &&
+            magic != dronecore::ShmSegment::MAGIC) {
+            std::cout << "Shared memory " << path << " has an unknown layout" << std::endl;
+            return false;
+        }
+
+        _send_ring.reset(new dronecore::ShmRing(_segment->to_ground));
+        _receive_ring.reset(new dronecore::ShmRing(_segment->to_vehicle));
+        return true;
+    }
+
+    bool send(const uint8_t *data, unsigned data_len) override
+    {
+        return _send_ring->write(data, data_len);
+    }
+
+    int receive(uint8_t *buffer, unsigned buffer_len, int timeout_ms) override
+    {
+        if (!_receive_ring->wait(timeout_ms)) {
+            return 0;
+        }
+        return int(_receive_ring->read(buffer, buffer_len));
+    }
+
+private:
+    int _fd = -1;
+    dronecore::ShmSegment *_segment = nullptr;
+    std::unique_ptr<dronecore::ShmRing> _send_ring {};
+    std::unique_ptr<dronecore::ShmRing> _receive_ring {};
+};
+#endif
+
+struct Param {
+    const char *name;
+    uint8_t type;
+    float value;
+};
+
+// Some of what PX4 has. Integers are kept in the bytes of the float as in
+// PARAM_VALUE, these are all 0.
+const Param DEFAULT_PARAMS[] = {
+    {"MIS_TAKEOFF_ALT", MAV_PARAM_TYPE_REAL32, 2.5f},
+    {"MPC_XY_VEL_MAX", MAV_PARAM_TYPE_REAL32, 12.0f},
+    {"MPC_LAND_SPEED", MAV_PARAM_TYPE_REAL32, 0.7f},
+    {"RTL_RETURN_ALT", MAV_PARAM_TYPE_REAL32, 30.0f},
+    {"COM_RC_LOSS_T", MAV_PARAM_TYPE_REAL32, 0.5f},
+    {"NAV_RCL_ACT", MAV_PARAM_TYPE_INT32, 0.0f},
+    {"SYS_AUTOSTART", MAV_PARAM_TYPE_INT32, 0.0f},
+    {"SYS_HITL", MAV_PARAM_TYPE_INT32, 0.0f},
+};
+
+const unsigned NUM_PARAMS = sizeof(DEFAULT_PARAMS) / sizeof(DEFAULT_PARAMS[0]);
+
+struct Vehicle {
+    uint8_t sysid;
+    uint8_t seq;
+    bool is_armed;
+    std::vector<Param> params;
+    clock_type::time_point next_heartbeat;
+    clock_type::time_point next_telemetry;
+};
+
+class LoadGenerator
+{
+public:
+    LoadGenerator(Link &link, unsigned num_vehicles, double telemetry_rate_hz) :
+        _link(link),
+        _telemetry_interval(std::chrono::duration_cast<clock_type::duration>(
+                                std::chrono::duration<double>(1.0 / telemetry_rate_hz))),
+        _start_time(clock_type::now()),
+        _next_stats_time(_start_time + STATS_INTERVAL)
+    {
+        for (unsigned i = 0; i < num_vehicles; ++i) {
+            Vehicle vehicle;
+            vehicle.sysid = uint8_t(i + 1);
+            vehicle.seq = 0;
+            vehicle.is_armed = false;
+            vehicle.params.assign(DEFAULT_PARAMS, DEFAULT_PARAMS + NUM_PARAMS);
+            // Spread out, so that the messages don't all come in one burst.
+            vehicle.next_heartbeat = _start_time + HEARTBEAT_INTERVAL * i / num_vehicles;
+            vehicle.next_telemetry = _start_time + _telemetry_interval * i / num_vehicles;
+            _vehicles.push_back(vehicle);
+        }
+    }
+
+    void run()
+    {
+        uint8_t buffer[2048];
+
+        while (true) {
+            const auto now = clock_type::now();
+            auto next_time = _next_stats_time;
+
+            for (auto &vehicle : _vehicles) {
+                if (now >= vehicle.next_heartbeat) {
+                    send_heartbeat(vehicle);
+                    send_status(vehicle);
+                    vehicle.next_heartbeat = next_due(vehicle.next_heartbeat,
+                                                      HEARTBEAT_INTERVAL, now);
+                }
+                if (now >= vehicle.next_telemetry) {
+                    send_telemetry(vehicle, now);
+                    vehicle.next_telemetry = next_due(vehicle.next_telemetry,
+                                                      _telemetry_interval, now);
+                }
+                next_time = std::min(next_time, std::min(vehicle.next_heartbeat,
+                                                         vehicle.next_telemetry));
+            }
+
+            if (now >= _next_stats_time) {
+                print_stats();
+                _next_stats_time += STATS_INTERVAL;
+            }
+
+            const auto timeout_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                        next_time - clock_type::now()).count();
+            const int len = _link.receive(buffer, sizeof(buffer),
+                                          int(std::max<int64_t>(0, timeout_ms)));
+            if (len > 0) {
+                _receiver.set_new_datagram(reinterpret_cast<char *>(buffer), unsigned(len));
+                while (_receiver.parse_message()) {
+                    handle(_receiver.get_last_message());
+                }
+            }
+        }
+    }
+
+private:
+    static constexpr uint8_t COMPONENT_ID = MAV_COMP_ID_AUTOPILOT1;
+    static constexpr uint64_t UID_BASE = 0x4c47000000000000ULL;
+
+    // Skips what is overdue instead of bursting, once the host does not keep up.
+    clock_type::time_point next_due(clock_type::time_point due,
+                                           clock_type::duration interval,
+                                           clock_type::time_point now)
+    {
+        due += interval;
+        if (due < now) {
+            due = now + interval;
+            ++_num_skipped;
+        }
+        return due;
+    }
+
+    uint32_t time_boot_ms(clock_type::time_point now) const
+    {
+        return uint32_t(std::chrono::duration_cast<std::chrono::milliseconds>(
+                            now - _start_time).count());
+    }
+
+    void send(const mavlink_message_t &message)
+    {
+        uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+        const uint16_t len = mavlink_msg_to_send_buffer(buffer, &message);
+        if (_link.send(buffer, len)) {
+            ++_num_sent;
+        } else {
+            ++_num_send_failed;
+        }
+    }
+
+    // To be called before packing a message of the vehicle. The sequence
+    // numbers are per vehicle, as DroneCore counts the messages lost per system.
+    void set_sequence(Vehicle &vehicle)
+    {
+        mavlink_get_channel_status(MAVLINK_COMM_0)->current_tx_seq = vehicle.seq++;
+    }
+
+    void send_heartbeat(Vehicle &vehicle)
+    {
+        mavlink_heartbeat_t heartbeat {};
+        heartbeat.type = MAV_TYPE_QUADROTOR;
+        heartbeat.autopilot = MAV_AUTOPILOT_PX4;
+        heartbeat.base_mode = MAV_MODE_FLAG_CUSTOM_MODE_ENABLED |
+                              (vehicle.is_armed ? MAV_MODE_FLAG_SAFETY_ARMED : 0);
+        heartbeat.system_status = vehicle.is_armed ? MAV_STATE_ACTIVE : MAV_STATE_STANDBY;
+        heartbeat.mavlink_version = 3;
+
+        mavlink_message_t message;
+        set_sequence(vehicle);
+        mavlink_msg_heartbeat_encode(vehicle.sysid, COMPONENT_ID, &message, &heartbeat);
+        send(message);
+    }
+
+    // What changes slowly, sent along with the heartbeat.
+    void send_status(Vehicle &vehicle)
+    {
+        const uint32_t sensors = MAV_SYS_STATUS_SENSOR_3D_GYRO | MAV_SYS_STATUS_SENSOR_3D_ACCEL |
+                                 MAV_SYS_STATUS_SENSOR_3D_MAG | MAV_SYS_STATUS_SENSOR_GPS;
+
+        mavlink_sys_status_t sys_status {};
+        sys_status.onboard_control_sensors_present = sensors;
+        sys_status.onboard_control_sensors_enabled = sensors;
+        sys_status.onboard_control_sensors_health = sensors;
+        sys_status.voltage_battery = 12150;
+        sys_status.current_battery = -1;
+        sys_status.battery_remaining = 80;
+
+        mavlink_message_t message;
+        set_sequence(vehicle);
+        mavlink_msg_sys_status_encode(vehicle.sysid, COMPONENT_ID, &message, &sys_status);
+        send(message);
+
+        mavlink_extended_sys_state_t extended_sys_state {};
+        extended_sys_state.landed_state = vehicle.is_armed ? MAV_LANDED_STATE_IN_AIR :
+                                          MAV_LANDED_STATE_ON_GROUND;
+        set_sequence(vehicle);
+        mavlink_msg_extended_sys_state_encode(vehicle.sysid, COMPONENT_ID, &message,
+                                              &extended_sys_state);
+        send(message);
+
+        mavlink_home_position_t home_position {};
+        home_position.latitude = home_latitude(vehicle);
+        home_position.longitude = home_longitude(vehicle);
+        home_position.altitude = 488000;
+        home_position.q[0] = 1.0f;
+        set_sequence(vehicle);
+        mavlink_msg_home_position_encode(vehicle.sysid, COMPONENT_ID, &message, &home_position);
+        send(message);
+    }
+
+    // Position and attitude, each vehicle flying a circle around its home.
+    void send_telemetry(Vehicle &vehicle, clock_type::time_point now)
+    {
+        const uint32_t time_ms = time_boot_ms(now);
+        const double angle = 0.1 * time_ms / 1000.0 + vehicle.sysid;
+
+        mavlink_global_position_int_t position {};
+        position.time_boot_ms = time_ms;
+        position.lat = home_latitude(vehicle) + int32_t(200.0 * std::cos(angle));
+        position.lon = home_longitude(vehicle) + int32_t(200.0 * std::sin(angle));
+        position.alt = vehicle.is_armed ? 498000 : 488000;
+        position.relative_alt = vehicle.is_armed ? 10000 : 0;
+        position.vx = int16_t(-200.0 * std::sin(angle));
+        position.vy = int16_t(200.0 * std::cos(angle));
+        position.hdg = uint16_t(int(angle * 18000.0 / M_PI) % 36000);
+
+        mavlink_message_t message;
+        set_sequence(vehicle);
+        mavlink_msg_global_position_int_encode(vehicle.sysid, COMPONENT_ID, &message, &position);
+        send(message);
+
+        mavlink_attitude_t attitude {};
+        attitude.time_boot_ms = time_ms;
+        attitude.roll = 0.05f;
+        attitude.pitch = -0.02f;
+        attitude.yaw = float(std::fmod(angle, 2.0 * M_PI) - M_PI);
+        attitude.yawspeed = 0.1f;
+        set_sequence(vehicle);
+        mavlink_msg_attitude_encode(vehicle.sysid, COMPONENT_ID, &message, &attitude);
+        send(message);
+    }
+
+    // In 1e-7 degrees, on a grid of about 100 m.
+    static int32_t home_latitude(const Vehicle &vehicle)
+    {
+        return 473977420 + (vehicle.sysid / 16) * 9000;
+    }
+
+    static int32_t home_longitude(const Vehicle &vehicle)
+    {
+        return 85455940 + (vehicle.sysid % 16) * 13000;
+    }
+
+    void handle(const mavlink_message_t &message)
+    {
+        ++_num_received;
+
+        switch (message.msgid) {
+            case MAVLINK_MSG_ID_COMMAND_LONG: {
+                    mavlink_command_long_t command;
+                    mavlink_msg_command_long_decode(&message, &command);
+                    for_target(command.target_system, [this, &command](Vehicle & vehicle) {
+                        handle_command(vehicle, command.command, command.param1);
+                    });
+                    break;
+                }
+            case MAVLINK_MSG_ID_COMMAND_INT: {
+                    mavlink_command_int_t command;
+                    mavlink_msg_command_int_decode(&message, &command);
+                    for_target(command.target_system, [this, &command](Vehicle & vehicle) {
+                        handle_command(vehicle, command.command, command.param1);
+                    });
+                    break;
+                }
+            case MAVLINK_MSG_ID_PARAM_REQUEST_READ: {
+                    mavlink_param_request_read_t request;
+                    mavlink_msg_param_request_read_decode(&message, &request);
+                    for_target(request.target_system, [this, &request](Vehicle & vehicle) {
+                        const int index = find_param(vehicle, request.param_id,
+                                                     request.param_index);
+                        if (index >= 0) {
+                            send_param(vehicle, unsigned(index));
+                        }
+                    });
+                    break;
+                }
+            case MAVLINK_MSG_ID_PARAM_REQUEST_LIST: {
+                    mavlink_param_request_list_t request;
+                    mavlink_msg_param_request_list_decode(&message, &request);
+                    for_target(request.target_system, [this](Vehicle & vehicle) {
+                        for (unsigned i = 0; i < vehicle.params.size(); ++i) {
+                            send_param(vehicle, i);
+                        }
+                    });
+                    break;
+                }
+            case MAVLINK_MSG_ID_PARAM_SET: {
+                    mavlink_param_set_t param_set;
+                    mavlink_msg_param_set_decode(&message, &param_set);
+                    for_target(param_set.target_system, [this, &param_set](Vehicle & vehicle) {
+                        const int index = find_param(vehicle, param_set.param_id, -1);
+                        if (index >= 0) {
+                            vehicle.params[index].value = param_set.param_value;
+                            send_param(vehicle, unsigned(index));
+                        }
+                    });
+                    break;
+                }
+            default:
+                break;
+        }
+    }
+
+    // 0 is for all vehicles.
+    template<typename F>
+    void for_target(uint8_t target_system, F handle_vehicle)
+    {
+        if (target_system == 0) {
+            for (auto &vehicle : _vehicles) {
+                handle_vehicle(vehicle);
+            }
+        } else if (target_system <= _vehicles.size()) {
+            handle_vehicle(_vehicles[target_system - 1]);
+        }
+    }
+
+    void handle_command(Vehicle &vehicle, uint16_t command, float param1)
+    {
+        ++_num_commands;
+
+        switch (command) {
+            case MAV_CMD_COMPONENT_ARM_DISARM:
+                vehicle.is_armed = (param1 > 0.5f);
+                break;
+            case MAV_CMD_NAV_TAKEOFF:
+                vehicle.is_armed = true;
+                break;
+            case MAV_CMD_NAV_LAND:
+                vehicle.is_armed = false;
+                break;
+            default:
+                break;
+        }
+
+        mavlink_command_ack_t command_ack {};
+        command_ack.command = command;
+        command_ack.result = MAV_RESULT_ACCEPTED;
+
+        mavlink_message_t message;
+        set_sequence(vehicle);
+        mavlink_msg_command_ack_encode(vehicle.sysid, COMPONENT_ID, &message, &command_ack);
+        send(message);
+
+        if (command == MAV_CMD_REQUEST_AUTOPILOT_CAPABILITIES) {
+            send_autopilot_version(vehicle);
+        }
+    }
+
+    // With a UID of its own, so that every vehicle gets a UUID of its own.
+    void send_autopilot_version(Vehicle &vehicle)
+    {
+        mavlink_autopilot_version_t autopilot_version {};
+        autopilot_version.capabilities = MAV_PROTOCOL_CAPABILITY_MAVLINK2 |
+                                         MAV_PROTOCOL_CAPABILITY_MISSION_INT |
+                                         MAV_PROTOCOL_CAPABILITY_COMMAND_INT |
+                                         MAV_PROTOCOL_CAPABILITY_PARAM_FLOAT;
+        autopilot_version.uid = UID_BASE + vehicle.sysid;
+        autopilot_version.flight_sw_version = 0x01080000;
+
+        mavlink_message_t message;
+        set_sequence(vehicle);
+        mavlink_msg_autopilot_version_encode(vehicle.sysid, COMPONENT_ID, &message,
+                                             &autopilot_version);
+        send(message);
+    }
+
+    // By name, or by index if it is not negative.
+    static int find_param(const Vehicle &vehicle, const char *param_id, int16_t param_index)
+    {
+        if (param_index >= 0) {
+            return param_index < int(vehicle.params.size()) ? param_index : -1;
+        }
+        for (unsigned i = 0; i < vehicle.params.size(); ++i) {
+            // Not null terminated if it takes all 16 characters.
+            if (strncmp(vehicle.params[i].name, param_id, 16) == 0) {
+                return int(i);
+            }
+        }
+        return -1;
+    }
+
+    void send_param(Vehicle &vehicle, unsigned index)
+    {
+        ++_num_param_requests;
+
+        mavlink_param_value_t param_value {};
+        // Not null terminated if it takes all 16 characters.
+        const char *name = vehicle.params[index].name;
+        memcpy(param_value.param_id, name, std::min(strlen(name), sizeof(param_value.param_id)));
+        param_value.param_value = vehicle.params[index].value;
+        param_value.param_type = vehicle.params[index].type;
+        param_value.param_count = uint16_t(vehicle.params.size());
+        param_value.param_index = uint16_t(index);
+
+        mavlink_message_t message;
+        set_sequence(vehicle);
+        mavlink_msg_param_value_encode(vehicle.sysid, COMPONENT_ID, &message, &param_value);
+        send(message);
+    }
+
+    void print_stats()
+    {
+        const double interval_s = std::chrono::duration<double>(STATS_INTERVAL).count();
+        std::cout << _vehicles.size() << " vehicles, sent: " << _num_sent / interval_s
+                  << " msg/s, failed: " << _num_send_failed << ", skipped: " << _num_skipped
+                  << ", received: " << _num_received / interval_s << " msg/s, commands: "
+                  << _num_commands << ", params: " << _num_param_requests << std::endl;
+
+        _num_sent = 0;
+        _num_send_failed = 0;
+        _num_skipped = 0;
+        _num_received = 0;
+        _num_commands = 0;
+        _num_param_requests = 0;
+    }
+
+    static constexpr clock_type::duration HEARTBEAT_INTERVAL = std::chrono::seconds(1);
+    static constexpr clock_type::duration STATS_INTERVAL = std::chrono::seconds(1);
+
+    Link &_link;
+    const clock_type::duration _telemetry_interval;
+    const clock_type::time_point _start_time;
+    clock_type::time_point _next_stats_time;
+    std::vector<Vehicle> _vehicles {};
+    dronecore::MAVLinkReceiver _receiver {};
+
+    uint64_t _num_sent = 0;
+    uint64_t _num_send_failed = 0;
+    uint64_t _num_received = 0;
+    uint64_t _num_commands = 0;
+    uint64_t _num_param_requests = 0;
+    uint64_t _num_skipped = 0;
+};
+
+constexpr uint8_t LoadGenerator::COMPONENT_ID;
+constexpr uint64_t LoadGenerator::UID_BASE;
+constexpr clock_type::duration LoadGenerator::HEARTBEAT_INTERVAL;
+constexpr clock_type::duration LoadGenerator::STATS_INTERVAL;
+
+// Splits "scheme://host:port" with either of host and port optional.
+bool parse_url(const std::string &url, std::string &scheme, std::string &host, int &port)
+{
+    const size_t scheme_end = url.find("://");
+    if (scheme_end == std::string::npos) {
+        return false;
+    }
+    scheme = url.substr(0, scheme_end);
+    const std::string rest = url.substr(scheme_end + 3);
+
+    const size_t colon = rest.rfind(':');
+    if (colon == std::string::npos) {
+        host = rest;
+        return true;
+    }
+    host = rest.substr(0, colon);
+    port = std::atoi(rest.substr(colon + 1).c_str());
+    return port > 0;
+}
+
+void print_usage(const char *name)
+{
+    std::cout << "Usage: " << name << " <num_vehicles> [url] [telemetry_rate_hz]" << std::endl
+              << "  url: udp://host:port (default udp://127.0.0.1:14540), tcp://:port"
+#if defined(LINUX)
+              << " or shm://name"
+#endif
+              << std::endl;
+}
+
+} // namespace
+
+int main(int argc, const char *argv[])
+{
+    if (argc < 2) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    const int num_vehicles = std::atoi(argv[1]);
+    const std::string url = argc > 2 ? argv[2] : "udp://127.0.0.1:14540";
+    const double telemetry_rate_hz = argc > 3 ? std::atof(argv[3]) : 10.0;
+
+    if (num_vehicles < 1 || num_vehicles > 254 || telemetry_rate_hz <= 0.0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::string scheme;
+    std::string host;
+    int port = 14540;
+    if (!parse_url(url, scheme, host, port)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::unique_ptr<Link> link;
+    if (scheme == "udp") {
+        std::unique_ptr<UdpLink> udp_link(new UdpLink());
+        if (!udp_link->open(host.empty() ? "127.0.0.1" : host, port)) {
+            return 1;
+        }
+        link = std::move(udp_link);
+    } else if (scheme == "tcp") {
+        std::unique_ptr<TcpLink> tcp_link(new TcpLink());
+        if (!tcp_link->open(port)) {
+            return 1;
+        }
+        link = std::move(tcp_link);
+#if defined(LINUX)
+    } else if (scheme == "shm") {
+        std::unique_ptr<ShmLink> shm_link(new ShmLink());
+        if (!shm_link->open(host)) {
+            return 1;
+        }
+        link = std::move(shm_link);
+#endif
+    } else {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::cout << "Simulating " << num_vehicles << " vehicles at " << telemetry_rate_hz
+              << " Hz on " << url << std::endl;
+
+    LoadGenerator generator(*link, unsigned(num_vehicles), telemetry_rate_hz);
+    generator.run();
+
+    return 0;
+}
@@ -0,0 +1,98 @@
+//
+// Example to demonstrate how to fly several vehicles from one thread with the
+// C++20 awaitables of DroneCore: every vehicle takes off and lands in a
+// coroutine of its own, and all of them are resumed by one RunLoop.
+//
+
+#include <chrono>
+#include <cstdint>
+#include <dronecore/action_awaitable.h>
+#include <dronecore/awaitable.h>
+#include <dronecore/dronecore.h>
+#include <dronecore/telemetry_awaitable.h>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace dronecore;
+using namespace std::this_thread;
+using namespace std::chrono;
+
+Task<bool> takeoff_and_land(DroneCore &dc, uint64_t uuid, RunLoop &loop)
+{
+    System &system = dc.system(uuid);
+    Action action(system);
+    Telemetry telemetry(system);
+    AwaitableAction awaitable_action(action, loop.executor());
+    AwaitableTelemetry awaitable_telemetry(telemetry, loop.executor());
+
+    co_await awaitable_telemetry.until_health_all_ok();
+
+    ActionResult result = co_await awaitable_action.arm();
+    if (result != ActionResult::SUCCESS) {
+        std::cout << uuid << ": arming failed: " << action_result_str(result) << std::endl;
+        co_return false;
+    }
+
+    result = co_await awaitable_action.takeoff();
+    if (result != ActionResult::SUCCESS) {
+        std::cout << uuid << ": takeoff failed: " << action_result_str(result) << std::endl;
+        co_return false;
+    }
+    co_await awaitable_telemetry.until_in_air(true);
+
+    result = co_await awaitable_action.land();
+    if (result != ActionResult::SUCCESS) {
+        std::cout << uuid << ": landing failed: " << action_result_str(result) << std::endl;
+        co_return false;
+    }
+    co_await awaitable_telemetry.until_in_air(false);
+
+    std::cout << uuid << ": landed" << std::endl;
+    co_return true;
+}
+
+Task<> fly(DroneCore &dc, uint64_t uuid, RunLoop &loop, unsigned &num_flying)
+{
+    co_await takeoff_and_land(dc, uuid, loop);
+
+    // The last one stops the loop.
+    if (--num_flying == 0) {
+        loop.stop();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    DroneCore dc;
+
+    ConnectionResult connection_result = (argc == 1) ? dc.add_any_connection() :
+                                         dc.add_any_connection(argv[1]);
+    if (connection_result != ConnectionResult::SUCCESS) {
+        std::cout << "Connection failed: " << connection_result_str(connection_result)
+                  << std::endl;
+        return 1;
+    }
+
+    std::cout << "Waiting to discover systems..." << std::endl;
+    sleep_for(seconds(3));
+
+    const std::vector<uint64_t> uuids = dc.system_uuids();
+    if (uuids.empty()) {
+        std::cout << "No system found, exiting." << std::endl;
+        return 1;
+    }
+
+    // Everything, including the user callbacks, runs on this thread.
+    RunLoop loop;
+    dc.set_callback_executor(loop.executor());
+
+    unsigned num_flying = unsigned(uuids.size());
+    for (auto uuid : uuids) {
+        fly(dc, uuid, loop, num_flying).start();
+    }
+    loop.run();
+
+    dc.set_callback_executor(nullptr);
+    return 0;
+}
@@ -5,6 +5,7 @@
 #include <atomic>
 #include "integration_test_helper.h"
 #include "dronecore.h"
+#include "performance_gate.h"
 #include "plugins/telemetry/telemetry.h"
 #include "plugins/action/action.h"
 #include "plugins/mission/mission.h"
@@ -122,6 +123,8 @@ TEST_F(SitlTest, MissionAddWaypointsAndFly)
         // std::future.
         auto prom = std::make_shared<std::promise<void>>();
         auto future_result = prom->get_future();
+        Time time;
+        const dl_time_t upload_time = time.steady_time();
         mission->upload_mission_async(
         mission_items, [prom](Mission::Result result) {
             ASSERT_EQ(result, Mission::Result::SUCCESS);
@@ -130,6 +133,9 @@ TEST_F(SitlTest, MissionAddWaypointsAndFly)
         });
 
         future_result.get();
+        PerformanceGate::instance().check(
+            "mission_upload_" + std::to_string(mission_items.size()) + "_items",
+            time.elapsed_since_s(upload_time));
     }
 
     {
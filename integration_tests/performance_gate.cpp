@@ -0,0 +1,105 @@
+#include "performance_gate.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include "log.h"
+
+namespace dronecore {
+
+namespace {
+
+std::string env_or(const char *name, const char *fallback)
+{
+    const char *value = getenv(name);
+    return (value != nullptr && value[0] != '\0') ? value : fallback;
+}
+
+} // namespace
+
+PerformanceGate &PerformanceGate::instance()
+{
+    static PerformanceGate gate;
+    return gate;
+}
+
+PerformanceGate::PerformanceGate() :
+    _results_path(env_or("DRONECORE_PERF_RESULTS", "perf_results.json"))
+{
+    load_thresholds(env_or("DRONECORE_PERF_THRESHOLDS", "perf_thresholds.txt"));
+}
+
+void PerformanceGate::load_thresholds(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file) {
+        LogWarn() << "No performance thresholds in " << path << ", only recording";
+        return;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string name;
+        double threshold_s;
+        if (fields >> name >> threshold_s) {
+            _thresholds[name] = threshold_s;
+        } else {
+            LogWarn() << "Ignoring threshold line: " << line;
+        }
+    }
+}
+
+void PerformanceGate::check(const std::string &name, double duration_s)
+{
+    Result result {name, duration_s, false, 0.0};
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _thresholds.find(name);
+        if (it != _thresholds.end()) {
+            result.has_threshold = true;
+            result.threshold_s = it->second;
+        }
+        _results.push_back(result);
+        write_results();
+    }
+
+    LogInfo() << "Performance: " << name << " took " << duration_s << " s";
+    if (result.has_threshold) {
+        EXPECT_LE(duration_s, result.threshold_s) << name << " got slower than its threshold";
+    }
+}
+
+void PerformanceGate::write_results() const
+{
+    // We assume that we already acquired _mutex in this function.
+
+    std::ofstream file(_results_path, std::ios::trunc);
+    if (!file) {
+        LogErr() << "Could not write performance results to " << _results_path;
+        return;
+    }
+
+    file << "{\"results\":[\n";
+    for (size_t i = 0; i < _results.size(); ++i) {
+        const Result &result = _results[i];
+        char line[256];
+        if (result.has_threshold) {
+            snprintf(line, sizeof(line),
+                     "{\"name\":\"%s\",\"duration_s\":%.6f,\"threshold_s\":%.6f,\"passed\":%s}",
+                     result.name.c_str(), result.duration_s, result.threshold_s,
+                     (result.duration_s <= result.threshold_s) ? "true" : "false");
+        } else {
+            snprintf(line, sizeof(line), "{\"name\":\"%s\",\"duration_s\":%.6f}",
+                     result.name.c_str(), result.duration_s);
+        }
+        file << line << ((i + 1 < _results.size()) ? ",\n" : "\n");
+    }
+    file << "]}\n";
+}
+
+} // namespace dronecore
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace dronecore {
+
+// Timings measured by the integration tests, so that slowdowns show up.
+//
+// Every result is written to the JSON file in DRONECORE_PERF_RESULTS, or
+// perf_results.json, as soon as it is known. It fails the test if it is
+// above its threshold. The thresholds are read from the file in
+// DRONECORE_PERF_THRESHOLDS, or perf_thresholds.txt, with a line of
+// "<name> <max_seconds>" each. Results without a threshold are only written.
+class PerformanceGate
+{
+public:
+    static PerformanceGate &instance();
+
+    void check(const std::string &name, double duration_s);
+
+    // Non-copyable
+    PerformanceGate(const PerformanceGate &) = delete;
+    const PerformanceGate &operator=(const PerformanceGate &) = delete;
+
+private:
+    struct Result {
+        std::string name;
+        double duration_s;
+        bool has_threshold;
+        double threshold_s;
+    };
+
+    PerformanceGate();
+
+    void load_thresholds(const std::string &path);
+    void write_results() const;
+
+    std::mutex _mutex {};
+    std::map<std::string, double> _thresholds {};
+    std::vector<Result> _results {};
+    std::string _results_path {};
+};
+
+} // namespace dronecore
@@ -1,7 +1,10 @@
 #include <iostream>
+#include <future>
 #include "integration_test_helper.h"
 #include "global_include.h"
 #include "dronecore.h"
+#include "performance_gate.h"
+#include "plugins/telemetry/telemetry.h"
 
 using namespace dronecore;
 
@@ -47,3 +50,29 @@ TEST_F(SitlTest, TwoConnections)
     delete dc;
     std::cout << "exiting" << std::endl;
 }
+
+TEST_F(SitlTest, TimeToDiscoverAndReady)
+{
+    DroneCore dc;
+    Time time;
+
+    std::promise<void> discovered;
+    dc.register_on_discover([&discovered](uint64_t uuid) {
+        UNUSED(uuid);
+        discovered.set_value();
+    });
+
+    const dl_time_t connect_time = time.steady_time();
+    ASSERT_EQ(dc.add_udp_connection(14540), ConnectionResult::SUCCESS);
+
+    ASSERT_EQ(discovered.get_future().wait_for(std::chrono::seconds(10)),
+              std::future_status::ready);
+    PerformanceGate::instance().check("time_to_discover", time.elapsed_since_s(connect_time));
+
+    Telemetry telemetry(dc.system());
+    while (!telemetry.health_all_ok()) {
+        ASSERT_LT(time.elapsed_since_s(connect_time), 120.0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    PerformanceGate::instance().check("time_to_ready", time.elapsed_since_s(connect_time));
+}
@@ -1,6 +1,7 @@
 #include <iostream>
 #include "integration_test_helper.h"
 #include "dronecore.h"
+#include "performance_gate.h"
 #include "plugins/telemetry/telemetry.h"
 
 #define CAMERA_AVAILABLE 0 // Set to 1 if camera is available and should be tested.
@@ -66,6 +67,18 @@ TEST_F(SitlTest, TelemetryAsync)
 
     auto telemetry = std::make_shared<Telemetry>(system);
 
+    {
+        // Setting a rate is a command which the autopilot acks.
+        const int num_round_trips = 10;
+        Time time;
+        const dl_time_t start_time = time.steady_time();
+        for (int i = 0; i < num_round_trips; ++i) {
+            EXPECT_EQ(telemetry->set_rate_position(10.0), Telemetry::Result::SUCCESS);
+        }
+        PerformanceGate::instance().check("command_round_trip",
+                                          time.elapsed_since_s(start_time) / num_round_trips);
+    }
+
     telemetry->set_rate_position_async(10.0, std::bind(&receive_result, _1));
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "action.h"
+#include "awaitable.h"
+
+namespace dronecore {
+
+/**
+ * @brief Awaitable variants of the `*_async` calls of Action (C++20).
+ *
+ * Each coroutine is resumed on the executor once the vehicle answered, e.g.
+ * `ActionResult result = co_await action.arm();`.
+ */
+class AwaitableAction
+{
+public:
+    /**
+     * @brief Constructor.
+     *
+     * @param action Action plugin, which needs to outlive this.
+     * @param executor Executor to resume on, e.g. RunLoop::executor().
+     */
+    AwaitableAction(Action &action, executor_t executor) :
+        _action(action),
+        _executor(std::move(executor)) {}
+
+    /** @brief See Action::arm_async(). */
+    CallbackAwaitable<ActionResult> arm()
+    {
+        return {_executor, [this](Action::result_callback_t callback) {
+            _action.arm_async(callback);
+        }};
+    }
+
+    /** @brief See Action::disarm_async(). */
+    CallbackAwaitable<ActionResult> disarm()
+    {
+        return {_executor, [this](Action::result_callback_t callback) {
+            _action.disarm_async(callback);
+        }};
+    }
+
+    /** @brief See Action::kill_async(). */
+    CallbackAwaitable<ActionResult> kill()
+    {
+        return {_executor, [this](Action::result_callback_t callback) {
+            _action.kill_async(callback);
+        }};
+    }
+
+    /** @brief See Action::takeoff_async(). */
+    CallbackAwaitable<ActionResult> takeoff()
+    {
+        return {_executor, [this](Action::result_callback_t callback) {
+            _action.takeoff_async(callback);
+        }};
+    }
+
+    /** @brief See Action::land_async(). */
+    CallbackAwaitable<ActionResult> land()
+    {
+        return {_executor, [this](Action::result_callback_t callback) {
+            _action.land_async(callback);
+        }};
+    }
+
+    /** @brief See Action::return_to_launch_async(). */
+    CallbackAwaitable<ActionResult> return_to_launch()
+    {
+        return {_executor, [this](Action::result_callback_t callback) {
+            _action.return_to_launch_async(callback);
+        }};
+    }
+
+    /** @brief See Action::transition_to_fixedwing_async(). */
+    CallbackAwaitable<ActionResult> transition_to_fixedwing()
+    {
+        return {_executor, [this](Action::result_callback_t callback) {
+            _action.transition_to_fixedwing_async(callback);
+        }};
+    }
+
+    /** @brief See Action::transition_to_multicopter_async(). */
+    CallbackAwaitable<ActionResult> transition_to_multicopter()
+    {
+        return {_executor, [this](Action::result_callback_t callback) {
+            _action.transition_to_multicopter_async(callback);
+        }};
+    }
+
+private:
+    Action &_action;
+    executor_t _executor;
+};
+
+} // namespace dronecore
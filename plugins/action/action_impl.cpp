@@ -21,8 +21,7 @@ ActionImpl::~ActionImpl()
 void ActionImpl::init()
 {
     // We need the system state.
-    _parent->register_mavlink_message_handler(
-        MAVLINK_MSG_ID_EXTENDED_SYS_STATE,
+    _parent->register_mavlink_message_handler<mavlink_extended_sys_state_t>(
         std::bind(&ActionImpl::process_extended_sys_state, this, _1), this);
 }
 
@@ -38,7 +37,7 @@ void ActionImpl::enable()
     // we won't receive an answer anyway in init because the receive loop is not
     // called while we are being created here.
     _parent->set_msg_rate_async(MAVLINK_MSG_ID_EXTENDED_SYS_STATE, 1.0, nullptr,
-                                MAVLinkCommands::DEFAULT_COMPONENT_ID_AUTOPILOT);
+                                MAVLinkCommands::DEFAULT_COMPONENT_ID_AUTOPILOT, this);
 }
 
 void ActionImpl::disable() {}
@@ -152,16 +151,12 @@ ActionResult ActionImpl::transition_to_fixedwing() const
 void ActionImpl::transition_to_fixedwing_async(const Action::result_callback_t &callback)
 {
     if (!_vtol_transition_support_known) {
-        if (callback) {
-            callback(ActionResult::VTOL_TRANSITION_SUPPORT_UNKNOWN);
-        }
+        report_result(callback, ActionResult::VTOL_TRANSITION_SUPPORT_UNKNOWN);
         return;
     }
 
     if (!_vtol_transition_possible) {
-        if (callback) {
-            callback(ActionResult::NO_VTOL_TRANSITION_SUPPORT);
-        }
+        report_result(callback, ActionResult::NO_VTOL_TRANSITION_SUPPORT);
         return;
     }
 
@@ -172,7 +167,7 @@ void ActionImpl::transition_to_fixedwing_async(const Action::result_callback_t &
     command.target_component_id = _parent->get_autopilot_id();
 
     _parent->send_command_async(command, std::bind(&ActionImpl::command_result_callback,
-                                                   _1, callback));
+                                                   this, _1, callback));
 }
 
 ActionResult ActionImpl::transition_to_multicopter() const
@@ -197,16 +192,12 @@ ActionResult ActionImpl::transition_to_multicopter() const
 void ActionImpl::transition_to_multicopter_async(const Action::result_callback_t &callback)
 {
     if (!_vtol_transition_support_known) {
-        if (callback) {
-            callback(ActionResult::VTOL_TRANSITION_SUPPORT_UNKNOWN);
-        }
+        report_result(callback, ActionResult::VTOL_TRANSITION_SUPPORT_UNKNOWN);
         return;
     }
 
     if (!_vtol_transition_possible) {
-        if (callback) {
-            callback(ActionResult::NO_VTOL_TRANSITION_SUPPORT);
-        }
+        report_result(callback, ActionResult::NO_VTOL_TRANSITION_SUPPORT);
         return;
     }
     MAVLinkCommands::CommandLong command {};
@@ -216,16 +207,14 @@ void ActionImpl::transition_to_multicopter_async(const Action::result_callback_t
     command.target_component_id = _parent->get_autopilot_id();
 
     _parent->send_command_async(command, std::bind(&ActionImpl::command_result_callback,
-                                                   _1, callback));
+                                                   this, _1, callback));
 }
 
 void ActionImpl::arm_async(const Action::result_callback_t &callback)
 {
     ActionResult ret = arming_allowed();
     if (ret != ActionResult::SUCCESS) {
-        if (callback) {
-            callback(ret);
-        }
+        report_result(callback, ret);
         return;
     }
 
@@ -248,16 +237,14 @@ void ActionImpl::arm_async_continued(MAVLinkCommands::Result previous_result,
     command.target_component_id = _parent->get_autopilot_id();
 
     _parent->send_command_async(command, std::bind(&ActionImpl::command_result_callback,
-                                                   _1, callback));
+                                                   this, _1, callback));
 }
 
 void ActionImpl::disarm_async(const Action::result_callback_t &callback)
 {
     ActionResult ret = disarming_allowed();
     if (ret != ActionResult::SUCCESS) {
-        if (callback) {
-            callback(ret);
-        }
+        report_result(callback, ret);
         return;
     }
     MAVLinkCommands::CommandLong command {};
@@ -267,7 +254,7 @@ void ActionImpl::disarm_async(const Action::result_callback_t &callback)
     command.target_component_id = _parent->get_autopilot_id();
 
     _parent->send_command_async(command, std::bind(&ActionImpl::command_result_callback,
-                                                   _1, callback));
+                                                   this, _1, callback));
 }
 
 void ActionImpl::kill_async(const Action::result_callback_t &callback)
@@ -279,16 +266,14 @@ void ActionImpl::kill_async(const Action::result_callback_t &callback)
     command.target_component_id = _parent->get_autopilot_id();
 
     _parent->send_command_async(command, std::bind(&ActionImpl::command_result_callback,
-                                                   _1, callback));
+                                                   this, _1, callback));
 }
 
 void ActionImpl::takeoff_async(const Action::result_callback_t &callback)
 {
     ActionResult ret = taking_off_allowed();
     if (ret != ActionResult::SUCCESS) {
-        if (callback) {
-            callback(ret);
-        }
+        report_result(callback, ret);
         return;
     }
 
@@ -310,7 +295,7 @@ void ActionImpl::takeoff_async_continued(MAVLinkCommands::Result previous_result
     command.target_component_id = _parent->get_autopilot_id();
 
     _parent->send_command_async(command, std::bind(&ActionImpl::command_result_callback,
-                                                   _1, callback));
+                                                   this, _1, callback));
 }
 
 void ActionImpl::land_async(const Action::result_callback_t &callback)
@@ -321,14 +306,14 @@ void ActionImpl::land_async(const Action::result_callback_t &callback)
     command.target_component_id = _parent->get_autopilot_id();
 
     _parent->send_command_async(command, std::bind(&ActionImpl::command_result_callback,
-                                                   _1, callback));
+                                                   this, _1, callback));
 }
 
 void ActionImpl::return_to_launch_async(const Action::result_callback_t &callback)
 {
     _parent->set_flight_mode_async(
         MAVLinkSystem::FlightMode::RETURN_TO_LAUNCH,
-        std::bind(&ActionImpl::command_result_callback, _1, callback));
+        std::bind(&ActionImpl::command_result_callback, this, _1, callback));
 }
 
 ActionResult ActionImpl::arming_allowed() const
@@ -370,10 +355,8 @@ ActionResult ActionImpl::disarming_allowed() const
     return ActionResult::SUCCESS;
 }
 
-void ActionImpl::process_extended_sys_state(const mavlink_message_t &message)
+void ActionImpl::process_extended_sys_state(const mavlink_extended_sys_state_t &extended_sys_state)
 {
-    mavlink_extended_sys_state_t extended_sys_state;
-    mavlink_msg_extended_sys_state_decode(&message, &extended_sys_state);
     if (extended_sys_state.landed_state == MAV_LANDED_STATE_IN_AIR) {
         _in_air = true;
     } else if (extended_sys_state.landed_state == MAV_LANDED_STATE_ON_GROUND) {
@@ -473,11 +456,17 @@ ActionImpl::action_result_from_command_result(MAVLinkCommands::Result result)
 void ActionImpl::command_result_callback(MAVLinkCommands::Result command_result,
                                          const Action::result_callback_t &callback)
 {
-    ActionResult action_result = action_result_from_command_result(command_result);
+    report_result(callback, action_result_from_command_result(command_result));
+}
 
-    if (callback) {
-        callback(action_result);
+void ActionImpl::report_result(const Action::result_callback_t &callback, ActionResult result)
+{
+    if (!callback) {
+        return;
     }
+    _parent->call_result_callback(this, [callback, result]() {
+        callback(result);
+    });
 }
 
 
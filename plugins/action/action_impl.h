@@ -59,7 +59,7 @@ private:
     ActionResult disarming_allowed() const;
     ActionResult taking_off_allowed() const;
 
-    void process_extended_sys_state(const mavlink_message_t &message);
+    void process_extended_sys_state(const mavlink_extended_sys_state_t &extended_sys_state);
 
     void receive_max_speed_result(bool success, float new_speed_m_s);
 
@@ -67,8 +67,9 @@ private:
 
     static ActionResult action_result_from_command_result(MAVLinkCommands::Result result);
 
-    static void command_result_callback(MAVLinkCommands::Result command_result,
-                                        const Action::result_callback_t &callback);
+    void command_result_callback(MAVLinkCommands::Result command_result,
+                                 const Action::result_callback_t &callback);
+    void report_result(const Action::result_callback_t &callback, ActionResult result);
 
     std::atomic<bool> _in_air_state_known {false};
     std::atomic<bool> _in_air {false};
@@ -1,5 +1,6 @@
 #include <gmock/gmock.h>
 
+#include "action/action.h"
 #include "action/action_result.h"
 
 namespace dronecore {
@@ -8,9 +9,14 @@ namespace testing {
 class MockAction
 {
 public:
+    typedef Action::result_callback_t result_callback_t;
+
     MOCK_CONST_METHOD0(arm, ActionResult());
     MOCK_CONST_METHOD0(takeoff, ActionResult());
     MOCK_CONST_METHOD0(land, ActionResult());
+    MOCK_METHOD1(arm_async, void(result_callback_t));
+    MOCK_METHOD1(takeoff_async, void(result_callback_t));
+    MOCK_METHOD1(land_async, void(result_callback_t));
 };
 
 } // namespace testing
@@ -3,9 +3,9 @@
 
 namespace dronecore {
 
-Camera::Camera(System &system) :
+Camera::Camera(System &system, int camera_id) :
     PluginBase(),
-    _impl { new CameraImpl(system) }
+    _impl { new CameraImpl(system, camera_id) }
 {
 }
 
@@ -103,6 +103,23 @@ void Camera::capture_info_async(capture_info_callback_t callback)
     _impl->capture_info_async(callback);
 }
 
+void Camera::get_capture_log(std::vector<CaptureInfo> &captures)
+{
+    _impl->get_capture_log(captures);
+}
+
+void Camera::download_photos_async(const std::vector<CaptureInfo> &captures,
+                                   const std::string &directory,
+                                   download_photos_callback_t callback)
+{
+    _impl->download_photos_async(captures, directory, callback);
+}
+
+void Camera::clear_capture_log()
+{
+    _impl->clear_capture_log();
+}
+
 void Camera::set_option_async(const std::string &setting,
                               const std::string &option,
                               const result_callback_t &callback)
@@ -16,9 +16,8 @@ class System;
  * @brief The Camera class can be used to manage cameras that implement the
  * MAVLink Camera Protocol: https://mavlink.io/en/protocol/camera.html.
  *
- * Currently only a single camera is supported.
- * When multiple cameras are supported the plugin will need to be
- * instantiated separately for every camera.
+ * The plugin is instantiated separately for every camera of a system, and the cameras are
+ * brought up at the same time.
  *
  * Synchronous and asynchronous variants of the camera methods are supplied.
  */
@@ -34,9 +33,16 @@ public:
      *     auto camera = std::make_shared<Camera>(system);
      *     ```
      *
+     * For the other cameras of a system, their ID is given as well:
+     *
+     *     ```cpp
+     *     auto second_camera = std::make_shared<Camera>(system, 1);
+     *     ```
+     *
      * @param system The specific system associated with this plugin.
+     * @param camera_id ID of the camera starting from 0, see System::has_camera().
      */
-    explicit Camera(System &system);
+    explicit Camera(System &system, int camera_id = 0);
 
     /**
      * @brief Destructor (internal use only).
@@ -331,6 +337,60 @@ public:
      */
     void capture_info_async(capture_info_callback_t callback);
 
+    /**
+     * @brief Get all captures logged since the log was last cleared (synchronous).
+     *
+     * Every capture the camera reports is logged, whether capture info updates are
+     * subscribed to or not. Captures which were skipped according to their index are
+     * asked for again in batches, so that the log is complete for geotagging after
+     * the flight.
+     *
+     * @param captures Is filled with the captures, sorted by index.
+     */
+    void get_capture_log(std::vector<CaptureInfo> &captures);
+
+    /**
+     * @brief Progress of downloading photos.
+     */
+    struct DownloadProgress {
+        unsigned num_photos; /**< @brief Number of photos to download. */
+        unsigned num_downloaded; /**< @brief Number of photos downloaded so far. */
+        unsigned num_failed; /**< @brief Number of photos which could not be downloaded. */
+        int percentage; /**< @brief Progress of all photos together (range: 0 to 100). */
+    };
+
+    /**
+     * @brief Callback type for downloading photos.
+     */
+    typedef std::function<void(Result, DownloadProgress)> download_photos_callback_t;
+
+    /**
+     * @brief Download the photos of captures to a local directory (asynchronous).
+     *
+     * The photos are downloaded from the file URL of the captures, with several transfers
+     * at a time and reusing the connections to the camera. A file is named like in its URL.
+     * Transfers which fail are continued where they stopped, and so are files which are
+     * partly in the directory already.
+     *
+     * The callback is called with IN_PROGRESS as the photos come in, and a last time with
+     * SUCCESS, or ERROR if any photo could not be downloaded.
+     *
+     * @param captures Captures of the photos, e.g. from get_capture_log().
+     * @param directory Existing local directory to download to.
+     * @param callback Function to call with the progress.
+     */
+    void download_photos_async(const std::vector<CaptureInfo> &captures,
+                               const std::string &directory,
+                               download_photos_callback_t callback);
+
+    /**
+     * @brief Clear the capture log.
+     *
+     * The camera counts the index from 0 again once armed, so the log should be
+     * cleared before every flight.
+     */
+    void clear_capture_log();
+
     /**
      * @brief Information about camera status.
      */
@@ -357,6 +417,10 @@ public:
     /**
      * @brief Get camera status (asynchronous).
      *
+     * The status is requested from the camera for this call, nothing is polled meanwhile.
+     * Calls made while a request is going on get its answer. If the camera streams its
+     * capture status, e.g. while recording video, only the storage information is requested.
+     *
      * @param callback Function to call with camera status.
      */
     void get_status_async(get_status_callback_t callback);
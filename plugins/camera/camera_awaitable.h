@@ -0,0 +1,114 @@
+#pragma once
+
+#include <string>
+
+#include "awaitable.h"
+#include "camera.h"
+
+namespace dronecore {
+
+/**
+ * @brief Awaitable variants of the `*_async` calls of Camera (C++20).
+ *
+ * Calls with several results give a std::tuple, e.g.
+ * `auto [result, mode] = co_await camera.get_mode();`.
+ */
+class AwaitableCamera
+{
+public:
+    /**
+     * @brief Constructor.
+     *
+     * @param camera Camera plugin, which needs to outlive this.
+     * @param executor Executor to resume on, e.g. RunLoop::executor().
+     */
+    AwaitableCamera(Camera &camera, executor_t executor) :
+        _camera(camera),
+        _executor(std::move(executor)) {}
+
+    /** @brief See Camera::take_photo_async(). */
+    CallbackAwaitable<Camera::Result> take_photo()
+    {
+        return {_executor, [this](Camera::result_callback_t callback) {
+            _camera.take_photo_async(callback);
+        }};
+    }
+
+    /** @brief See Camera::start_photo_interval_async(). */
+    CallbackAwaitable<Camera::Result> start_photo_interval(float interval_s)
+    {
+        return {_executor, [this, interval_s](Camera::result_callback_t callback) {
+            _camera.start_photo_interval_async(interval_s, callback);
+        }};
+    }
+
+    /** @brief See Camera::stop_photo_interval_async(). */
+    CallbackAwaitable<Camera::Result> stop_photo_interval()
+    {
+        return {_executor, [this](Camera::result_callback_t callback) {
+            _camera.stop_photo_interval_async(callback);
+        }};
+    }
+
+    /** @brief See Camera::start_video_async(). */
+    CallbackAwaitable<Camera::Result> start_video()
+    {
+        return {_executor, [this](Camera::result_callback_t callback) {
+            _camera.start_video_async(callback);
+        }};
+    }
+
+    /** @brief See Camera::stop_video_async(). */
+    CallbackAwaitable<Camera::Result> stop_video()
+    {
+        return {_executor, [this](Camera::result_callback_t callback) {
+            _camera.stop_video_async(callback);
+        }};
+    }
+
+    /** @brief See Camera::set_mode_async(). */
+    CallbackAwaitable<Camera::Result, const Camera::Mode &> set_mode(Camera::Mode mode)
+    {
+        return {_executor, [this, mode](Camera::mode_callback_t callback) {
+            _camera.set_mode_async(mode, callback);
+        }};
+    }
+
+    /** @brief See Camera::get_mode_async(). */
+    CallbackAwaitable<Camera::Result, const Camera::Mode &> get_mode()
+    {
+        return {_executor, [this](Camera::mode_callback_t callback) {
+            _camera.get_mode_async(callback);
+        }};
+    }
+
+    /** @brief See Camera::get_status_async(). */
+    CallbackAwaitable<Camera::Result, const Camera::Status &> get_status()
+    {
+        return {_executor, [this](Camera::get_status_callback_t callback) {
+            _camera.get_status_async(callback);
+        }};
+    }
+
+    /** @brief See Camera::get_option_async(). */
+    CallbackAwaitable<Camera::Result, const std::string &> get_option(std::string setting)
+    {
+        return {_executor, [this, setting](Camera::get_option_callback_t callback) {
+            _camera.get_option_async(setting, callback);
+        }};
+    }
+
+    /** @brief See Camera::set_option_async(). */
+    CallbackAwaitable<Camera::Result> set_option(std::string setting, std::string option)
+    {
+        return {_executor, [this, setting, option](Camera::result_callback_t callback) {
+            _camera.set_option_async(setting, option, callback);
+        }};
+    }
+
+private:
+    Camera &_camera;
+    executor_t _executor;
+};
+
+} // namespace dronecore
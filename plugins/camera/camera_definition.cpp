@@ -1,9 +1,146 @@
 #include "global_include.h"
 #include "log.h"
 #include "camera_definition.h"
+#include <cstring>
 
 namespace dronecore {
 
+constexpr uint32_t CameraDefinition::BINARY_VERSION;
+
+namespace {
+
+// The binary is in host byte order, it is only a cache.
+void write_u32(std::string &data, uint32_t value)
+{
+    data.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void write_bool(std::string &data, bool value)
+{
+    data.push_back(value ? 1 : 0);
+}
+
+void write_string(std::string &data, const std::string &str)
+{
+    write_u32(data, uint32_t(str.size()));
+    data.append(str);
+}
+
+void write_param_value(std::string &data, const MAVLinkParameters::ParamValue &value)
+{
+    // Values of an unknown type in the XML have none, 0 is not a param type.
+    const size_t size = value.type_size();
+    if (size == 0) {
+        data.push_back(0);
+        return;
+    }
+
+    data.push_back(char(value.get_mav_param_ext_type()));
+    MAVLinkParameters::ParamValue::custom_type_t bytes;
+    value.get_128_bytes(bytes);
+    data.append(bytes, size);
+}
+
+// Reads what is written above, every read fails once the data has ended.
+class BinaryReader
+{
+public:
+    explicit BinaryReader(const std::string &data) :
+        _data(data)
+    {
+    }
+
+    bool read_u32(uint32_t &value) { return read_bytes(&value, sizeof(value)); }
+
+    bool read_bool(bool &value)
+    {
+        uint8_t byte;
+        if (!read_bytes(&byte, sizeof(byte)) || byte > 1) {
+            return false;
+        }
+        value = (byte == 1);
+        return true;
+    }
+
+    bool read_string(std::string &str)
+    {
+        uint32_t size;
+        if (!read_u32(size) || size > _data.size() - _pos) {
+            return false;
+        }
+        str.assign(_data, _pos, size);
+        _pos += size;
+        return true;
+    }
+
+    bool read_param_value(MAVLinkParameters::ParamValue &value)
+    {
+        uint8_t type;
+        if (!read_bytes(&type, sizeof(type))) {
+            return false;
+        }
+
+        if (type == 0) {
+            value = MAVLinkParameters::ParamValue {};
+            return true;
+        }
+
+        if (type < MAV_PARAM_EXT_TYPE_UINT8 || type > MAV_PARAM_EXT_TYPE_CUSTOM) {
+            return false;
+        }
+
+        // The type tells the size, the bytes follow.
+        mavlink_param_ext_value_t ext_value {};
+        ext_value.param_type = type;
+        value.set_from_mavlink_param_ext_value(ext_value);
+        if (!read_bytes(ext_value.param_value, value.type_size())) {
+            return false;
+        }
+        value.set_from_mavlink_param_ext_value(ext_value);
+        return true;
+    }
+
+    bool read_bytes(void *destination, size_t size)
+    {
+        if (size > _data.size() - _pos) {
+            return false;
+        }
+        memcpy(destination, _data.data() + _pos, size);
+        _pos += size;
+        return true;
+    }
+
+    bool at_end() const { return _pos == _data.size(); }
+
+    // False if fewer are left than a count read from the data claims, as each
+    // one takes at least its length. Checked before making room for them.
+    bool can_hold_strings(uint32_t num_strings) const
+    {
+        return num_strings <= (_data.size() - _pos) / sizeof(uint32_t);
+    }
+
+private:
+    const std::string &_data;
+    size_t _pos = 0;
+};
+
+size_t num_bit_words(size_t num_bits)
+{
+    return (num_bits + 63) / 64;
+}
+
+void set_bit(std::vector<uint64_t> &bits, size_t i)
+{
+    bits[i / 64] |= uint64_t(1) << (i % 64);
+}
+
+bool test_bit(const std::vector<uint64_t> &bits, size_t i)
+{
+    return (bits[i / 64] >> (i % 64)) & 1;
+}
+
+} // namespace
+
 CameraDefinition::CameraDefinition() {}
 
 CameraDefinition::~CameraDefinition() {}
@@ -30,6 +167,162 @@ bool CameraDefinition::load_string(const std::string &content)
     return parse_xml();
 }
 
+void CameraDefinition::save_binary(std::string &data) const
+{
+    data.assign("DCCD");
+    write_u32(data, BINARY_VERSION);
+    write_string(data, _model);
+    write_string(data, _vendor);
+
+    write_u32(data, uint32_t(_parameter_map.size()));
+    for (const auto &parameter : _parameter_map) {
+        write_string(data, parameter.first);
+        write_string(data, parameter.second->description);
+        write_bool(data, parameter.second->is_control);
+        write_bool(data, parameter.second->is_readonly);
+        write_bool(data, parameter.second->is_writeonly);
+
+        write_u32(data, uint32_t(parameter.second->updates.size()));
+        for (const auto &update : parameter.second->updates) {
+            write_string(data, update);
+        }
+
+        write_u32(data, uint32_t(parameter.second->options.size()));
+        for (const auto &option : parameter.second->options) {
+            write_string(data, option->name);
+            write_param_value(data, option->value);
+            write_bool(data, option->is_default);
+
+            write_u32(data, uint32_t(option->exclusions.size()));
+            for (const auto &exclusion : option->exclusions) {
+                write_string(data, exclusion);
+            }
+
+            write_u32(data, uint32_t(option->parameter_ranges.size()));
+            for (const auto &parameter_range : option->parameter_ranges) {
+                write_string(data, parameter_range.first);
+                write_u32(data, uint32_t(parameter_range.second.size()));
+                for (const auto &range : parameter_range.second) {
+                    write_string(data, range.first);
+                    write_param_value(data, range.second);
+                }
+            }
+        }
+    }
+}
+
+bool CameraDefinition::load_binary(const std::string &data)
+{
+    BinaryReader reader(data);
+
+    char magic[4];
+    uint32_t version = 0;
+    if (!reader.read_bytes(magic, sizeof(magic)) || memcmp(magic, "DCCD", sizeof(magic)) != 0 ||
+        !reader.read_u32(version) || version != BINARY_VERSION) {
+        LogErr() << "Camera definition binary of unknown format";
+        return false;
+    }
+
+    std::string model;
+    std::string vendor;
+    std::map<std::string, std::shared_ptr<Parameter>> parameter_map;
+
+    auto read_parameters = [&]() -> bool {
+        uint32_t num_parameters;
+        if (!reader.read_string(model) || !reader.read_string(vendor) ||
+            !reader.read_u32(num_parameters)) {
+            return false;
+        }
+
+        for (uint32_t i = 0; i < num_parameters; ++i) {
+            std::string param_name;
+            auto new_parameter = std::make_shared<Parameter>();
+            uint32_t num_updates;
+            if (!reader.read_string(param_name) ||
+                !reader.read_string(new_parameter->description) ||
+                !reader.read_bool(new_parameter->is_control) ||
+                !reader.read_bool(new_parameter->is_readonly) ||
+                !reader.read_bool(new_parameter->is_writeonly) ||
+                !reader.read_u32(num_updates) || !reader.can_hold_strings(num_updates)) {
+                return false;
+            }
+
+            new_parameter->updates.resize(num_updates);
+            for (auto &update : new_parameter->updates) {
+                if (!reader.read_string(update)) {
+                    return false;
+                }
+            }
+
+            uint32_t num_options;
+            if (!reader.read_u32(num_options)) {
+                return false;
+            }
+            for (uint32_t j = 0; j < num_options; ++j) {
+                auto new_option = std::make_shared<Option>();
+                uint32_t num_exclusions;
+                if (!reader.read_string(new_option->name) ||
+                    !reader.read_param_value(new_option->value) ||
+                    !reader.read_bool(new_option->is_default) ||
+                    !reader.read_u32(num_exclusions) ||
+                    !reader.can_hold_strings(num_exclusions)) {
+                    return false;
+                }
+
+                new_option->exclusions.resize(num_exclusions);
+                for (auto &exclusion : new_option->exclusions) {
+                    if (!reader.read_string(exclusion)) {
+                        return false;
+                    }
+                }
+
+                uint32_t num_parameter_ranges;
+                if (!reader.read_u32(num_parameter_ranges)) {
+                    return false;
+                }
+                for (uint32_t k = 0; k < num_parameter_ranges; ++k) {
+                    std::string range_parameter;
+                    uint32_t num_ranges;
+                    if (!reader.read_string(range_parameter) || !reader.read_u32(num_ranges)) {
+                        return false;
+                    }
+
+                    parameter_range_t &new_parameter_range =
+                        new_option->parameter_ranges[range_parameter];
+                    for (uint32_t l = 0; l < num_ranges; ++l) {
+                        std::string range_name;
+                        MAVLinkParameters::ParamValue range_value;
+                        if (!reader.read_string(range_name) ||
+                            !reader.read_param_value(range_value)) {
+                            return false;
+                        }
+                        new_parameter_range[range_name] = range_value;
+                    }
+                }
+
+                new_parameter->options.push_back(new_option);
+            }
+
+            parameter_map[param_name] = new_parameter;
+        }
+        return reader.at_end();
+    };
+
+    if (!read_parameters()) {
+        LogErr() << "Camera definition binary corrupt";
+        return false;
+    }
+
+    _model = model;
+    _vendor = vendor;
+    _parameter_map.swap(parameter_map);
+
+    // Same as after parsing, nothing is known about the current settings.
+    build_index();
+
+    return true;
+}
+
 std::string CameraDefinition::get_model() const
 {
     return _model;
@@ -289,39 +582,146 @@ bool CameraDefinition::parse_xml()
         }
 
         _parameter_map[param_name] = new_parameter;
-
-        InternalCurrentSetting empty_setting {};
-        empty_setting.needs_updating = true;
-        _current_settings[param_name] = empty_setting;
     }
 
+    build_index();
+
     return true;
 }
 
-void CameraDefinition::assume_default_settings()
+void CameraDefinition::build_index()
 {
-    _current_settings.clear();
+    _parameters.clear();
+    _parameter_ids.clear();
 
     for (const auto &parameter : _parameter_map) {
-        for (const auto &option : parameter.second->options) {
+        ParamId param_id;
+        if (ParamId::from_name(parameter.first, param_id)) {
+            _parameter_ids[param_id] = _parameters.size();
+        } else {
+            // It could not be set or read over MAVLink anyway.
+            LogWarn() << "Param name too long: " << parameter.first;
+        }
+
+        IndexedParameter new_parameter {};
+        new_parameter.name = parameter.first;
+        new_parameter.parameter = parameter.second.get();
+        _parameters.push_back(new_parameter);
+    }
+
+    for (auto &parameter : _parameters) {
+        for (const auto &update : parameter.parameter->updates) {
+            size_t update_id;
+            if (find_parameter_id(update, update_id)) {
+                parameter.updates.push_back(update_id);
+            }
+        }
+
+        for (const auto &option : parameter.parameter->options) {
+            IndexedOption new_option {};
+            new_option.option = option.get();
+
+            new_option.exclusions.assign(num_bit_words(_parameters.size()), 0);
+            for (const auto &exclusion : option->exclusions) {
+                size_t exclusion_id;
+                if (find_parameter_id(exclusion, exclusion_id)) {
+                    set_bit(new_option.exclusions, exclusion_id);
+                }
+            }
+
+            // An empty range does not restrict anything, a range without any
+            // known option allows none.
+            for (const auto &parameter_range : option->parameter_ranges) {
+                size_t range_id;
+                if (parameter_range.second.empty() ||
+                    !find_parameter_id(parameter_range.first, range_id)) {
+                    continue;
+                }
+
+                const auto &range_options = _parameters[range_id].parameter->options;
+                bitset_t allowed(num_bit_words(range_options.size()), 0);
+                for (size_t i = 0; i < range_options.size(); ++i) {
+                    for (const auto &range : parameter_range.second) {
+                        if (range_options[i]->value == range.second) {
+                            set_bit(allowed, i);
+                        }
+                    }
+                }
+                new_option.ranges.push_back(std::make_pair(range_id, allowed));
+            }
+
+            parameter.options.push_back(new_option);
+        }
+    }
+
+    InternalCurrentSetting empty_setting {};
+    empty_setting.needs_updating = true;
+    empty_setting.option = -1;
+    _current_settings.assign(_parameters.size(), empty_setting);
+    _current_exclusions_valid = false;
+}
+
+bool CameraDefinition::find_parameter_id(const std::string &name, size_t &id) const
+{
+    ParamId param_id;
+    if (!ParamId::from_name(name, param_id)) {
+        return false;
+    }
+
+    auto it = _parameter_ids.find(param_id);
+    if (it == _parameter_ids.end()) {
+        return false;
+    }
+    id = it->second;
+    return true;
+}
+
+const CameraDefinition::bitset_t &CameraDefinition::current_exclusions()
+{
+    if (_current_exclusions_valid) {
+        return _current_exclusions;
+    }
 
-            if (!option->is_default) {
-                // LogDebug() << option->name << " not default";
+    _current_exclusions.assign(num_bit_words(_parameters.size()), 0);
+    for (size_t id = 0; id < _parameters.size(); ++id) {
+        const auto &current_setting = _current_settings[id];
+        if (current_setting.needs_updating || current_setting.option < 0) {
+            continue;
+        }
+        const auto &exclusions = _parameters[id].options[current_setting.option].exclusions;
+        for (size_t i = 0; i < exclusions.size(); ++i) {
+            _current_exclusions[i] |= exclusions[i];
+        }
+    }
+    _current_exclusions_valid = true;
+
+    return _current_exclusions;
+}
+
+void CameraDefinition::assume_default_settings()
+{
+    for (size_t id = 0; id < _parameters.size(); ++id) {
+        const auto &options = _parameters[id].options;
+        for (size_t i = 0; i < options.size(); ++i) {
+
+            if (!options[i].option->is_default) {
+                // LogDebug() << options[i].option->name << " not default";
                 continue;
             }
-            // LogDebug() << option->name << " default value: " << option->value << " (type: " << option->value.typestr() << ")";
 
-            _current_settings[parameter.first] = InternalCurrentSetting {option->value, false};
+            _current_settings[id] =
+                InternalCurrentSetting {options[i].option->value, false, int(i)};
         }
     }
+    _current_exclusions_valid = false;
 }
 
 bool CameraDefinition::get_all_settings(std::map<std::string, MAVLinkParameters::ParamValue>
                                         &settings)
 {
     settings.clear();
-    for (const auto &current_setting : _current_settings) {
-        settings[current_setting.first] = current_setting.second.value;
+    for (size_t id = 0; id < _parameters.size(); ++id) {
+        settings[_parameters[id].name] = _current_settings[id].value;
     }
 
     return (settings.size() > 0);
@@ -332,39 +732,13 @@ bool CameraDefinition::get_possible_settings(
 {
     settings.clear();
 
-    // Find all exclusions
-    // TODO: use set instead of vector
-    std::vector<std::string> exclusions {};
+    const auto &exclusions = current_exclusions();
 
-    for (const auto &parameter : _parameter_map) {
-        for (const auto &option : parameter.second->options) {
-            if (_current_settings[parameter.first].needs_updating) {
-                continue;
-            }
-            if (_current_settings[parameter.first].value == option->value) {
-                for (const auto &exclusion : option->exclusions) {
-                    // LogDebug() << "found exclusion for " << parameter.first
-                    //            << "(" << option->value << "): " << exclusion;
-                    exclusions.push_back(exclusion);
-                }
-            }
-        }
-    }
-
-    for (const auto &setting : _current_settings) {
-        bool excluded = false;
-        for (const auto &exclusion : exclusions) {
-            if (setting.first == exclusion) {
-                excluded = true;
-            }
-        }
-        if (!_parameter_map[setting.first]->is_control) {
+    for (size_t id = 0; id < _parameters.size(); ++id) {
+        if (!_parameters[id].parameter->is_control || test_bit(exclusions, id)) {
             continue;
         }
-
-        if (!excluded) {
-            settings[setting.first] = setting.second.value;
-        }
+        settings[_parameters[id].name] = _current_settings[id].value;
     }
 
     return (settings.size() > 0);
@@ -373,7 +747,8 @@ bool CameraDefinition::get_possible_settings(
 bool CameraDefinition::set_setting(const std::string &name,
                                    const MAVLinkParameters::ParamValue &value)
 {
-    if (_parameter_map.find(name) == _parameter_map.end()) {
+    size_t id;
+    if (!find_parameter_id(name, id)) {
         LogErr() << "Unknown setting to set";
         return false;
     }
@@ -397,34 +772,42 @@ bool CameraDefinition::set_setting(const std::string &name,
         }
     }
 
+    // The option is only looked up here, so that the queries can go by index.
+    int option_index = -1;
+    const auto &options = _parameters[id].options;
+    for (size_t i = 0; i < options.size(); ++i) {
+        if (options[i].option->value == changed_value) {
+            option_index = int(i);
+            break;
+        }
+    }
+
     // LogDebug() << "Setting " << name << " of type: " << changed_value.typestr();
-    _current_settings[name].value = changed_value;
-    _current_settings[name].needs_updating = false;
+    _current_settings[id] = InternalCurrentSetting {changed_value, false, option_index};
 
     // Some param changes cause other params to change, so they need to be updated.
     // The camera definition just keeps track of these params but the actual param fetching
     // needs to happen outside of this class.
-    for (const auto &update : _parameter_map[name]->updates) {
-        if (_current_settings.find(update) == _current_settings.end()) {
-            // LogDebug() << "Update to '" << update << "' not understood.";
-            continue;
-        }
-        _current_settings[update].needs_updating = true;
+    for (const auto update_id : _parameters[id].updates) {
+        _current_settings[update_id].needs_updating = true;
     }
 
+    _current_exclusions_valid = false;
+
     return true;
 }
 
 bool CameraDefinition::get_setting(const std::string &name,
                                    MAVLinkParameters::ParamValue &value)
 {
-    if (_current_settings.find(name) == _current_settings.end()) {
+    size_t id;
+    if (!find_parameter_id(name, id)) {
         LogErr() << "Unknown setting to get";
         return false;
     }
 
-    if (!_current_settings.at(name).needs_updating) {
-        value = _current_settings.at(name).value;
+    if (!_current_settings[id].needs_updating) {
+        value = _current_settings[id].value;
         return true;
     } else {
         return false;
@@ -435,19 +818,19 @@ bool CameraDefinition::get_option_value(const std::string &param_name,
                                         const std::string &option_value,
                                         MAVLinkParameters::ParamValue &value)
 {
-    if (_parameter_map.find(param_name) == _parameter_map.end()) {
+    size_t id;
+    if (!find_parameter_id(param_name, id)) {
         LogErr() << "Unknown parameter to get option";
         return false;
     }
 
-    for (const auto &option : _parameter_map[param_name]->options) {
-        if (option->value == option_value) {
-            value = option->value;
+    for (const auto &option : _parameters[id].options) {
+        if (option.option->value == option_value) {
+            value = option.option->value;
             return true;
         }
     }
 
-
     return false;
 }
 
@@ -456,13 +839,14 @@ bool CameraDefinition::get_all_options(
 {
     values.clear();
 
-    if (_parameter_map.find(name) == _parameter_map.end()) {
+    size_t id;
+    if (!find_parameter_id(name, id)) {
         LogErr() << "Unknown parameter to get all options";
         return false;
     }
 
-    for (const auto &option : _parameter_map[name]->options) {
-        values.push_back(option->value);
+    for (const auto &option : _parameters[id].options) {
+        values.push_back(option.option->value);
     }
 
     return true;
@@ -473,91 +857,52 @@ bool CameraDefinition::get_possible_options(
 {
     values.clear();
 
-    if (_parameter_map.find(name) == _parameter_map.end()) {
+    size_t id;
+    if (!find_parameter_id(name, id)) {
         LogErr() << "Unknown parameter to get possible options";
         return false;
     }
 
-    std::map<std::string, MAVLinkParameters::ParamValue> settings;
-    if (!get_possible_settings(settings)) {
-        return false;
-    }
-    if (settings.find(name) == settings.end()) {
+    // Excluded parameters are not applicable and need to be neglected for the
+    // range check below.
+    const auto &exclusions = current_exclusions();
+
+    if (!_parameters[id].parameter->is_control || test_bit(exclusions, id)) {
         LogErr() << "Setting " << name << " currently not applicable";
         return false;
     }
 
-    // Find all exclusions because excluded parameters need to be neglected for range
-    // check below.
-    // TODO: use set instead of vector
-    std::vector<std::string> exclusions {};
-
-    for (const auto &parameter : _parameter_map) {
-        for (const auto &option : parameter.second->options) {
-            if (_current_settings[parameter.first].needs_updating) {
-                // LogWarn() << parameter.first << " needs updating";
-                continue;
-            }
-            if (_current_settings[parameter.first].value == option->value) {
-                for (const auto &exclusion : option->exclusions) {
-                    // LogDebug() << "found exclusion for " << parameter.first
-                    //            << "(" << option->value << "): " << exclusion;
-                    exclusions.push_back(exclusion);
-                }
-            }
-        }
-    }
-
-    // TODO: use set instead of vector for this
-    std::vector<MAVLinkParameters::ParamValue> allowed_ranges {};
+    // Options allowed by the ranges of the current options of the others.
+    const auto &options = _parameters[id].options;
+    bitset_t allowed(num_bit_words(options.size()), 0);
+    bool restricted = false;
 
-    // Check allowed ranges.
-    for (const auto &parameter : _parameter_map) {
-
-        if (!parameter.second->is_control) {
+    for (size_t other_id = 0; other_id < _parameters.size(); ++other_id) {
+        if (!_parameters[other_id].parameter->is_control || test_bit(exclusions, other_id)) {
             continue;
         }
 
-        bool excluded = false;
-        for (const auto &exclusion : exclusions) {
-            if (parameter.first == exclusion) {
-                excluded = true;
-            }
-        }
-        if (excluded) {
+        const auto &current_setting = _current_settings[other_id];
+        if (current_setting.needs_updating || current_setting.option < 0) {
             continue;
         }
 
-        for (const auto &option : parameter.second->options) {
-            if (_current_settings[parameter.first].needs_updating) {
-                // LogWarn() << parameter.first << " needs updating";
+        // Only look at the current option and the range concerning the
+        // parameter that we're interested in.
+        for (const auto &range : _parameters[other_id].options[current_setting.option].ranges) {
+            if (range.first != id) {
                 continue;
             }
-            // Only look at current set option.
-            if (_current_settings[parameter.first].value == option->value) {
-                // Go through parameter ranges but only concerning the parameter that
-                // we're interested in..
-                if (option->parameter_ranges.find(name)
-                    != option->parameter_ranges.end()) {
-
-                    for (const auto &range : option->parameter_ranges[name]) {
-                        allowed_ranges.push_back(range.second);
-                    }
-                }
+            for (size_t i = 0; i < allowed.size(); ++i) {
+                allowed[i] |= range.second[i];
             }
+            restricted = true;
         }
     }
 
-    // Intersect
-    for (const auto &option : _parameter_map[name]->options) {
-        bool option_allowed = false;
-        for (const auto &allowed_range : allowed_ranges) {
-            if (option->value == allowed_range) {
-                option_allowed = true;
-            }
-        }
-        if (option_allowed || allowed_ranges.size() == 0) {
-            values.push_back(option->value);
+    for (size_t i = 0; i < options.size(); ++i) {
+        if (!restricted || test_bit(allowed, i)) {
+            values.push_back(options[i].option->value);
         }
     }
 
@@ -568,9 +913,9 @@ bool CameraDefinition::get_unknown_params(std::vector<std::string> &params)
 {
     params.clear();
 
-    for (const auto &parameter : _parameter_map) {
-        if (_current_settings[parameter.first].needs_updating) {
-            params.push_back(parameter.first);
+    for (size_t id = 0; id < _parameters.size(); ++id) {
+        if (_current_settings[id].needs_updating) {
+            params.push_back(_parameters[id].name);
         }
     }
     return true;
@@ -578,21 +923,23 @@ bool CameraDefinition::get_unknown_params(std::vector<std::string> &params)
 
 void CameraDefinition::set_all_params_unknown()
 {
-    for (auto &parameter : _parameter_map) {
-        _current_settings[parameter.first].needs_updating = true;
+    for (auto &current_setting : _current_settings) {
+        current_setting.needs_updating = true;
     }
+    _current_exclusions_valid = false;
 }
 
 bool CameraDefinition::get_setting_str(const std::string &name, std::string &description)
 {
     description.clear();
 
-    if (_parameter_map.find(name) == _parameter_map.end()) {
+    size_t id;
+    if (!find_parameter_id(name, id)) {
         LogWarn() << "Setting " << name << " not found.";
         return false;
     }
 
-    description = _parameter_map[name]->description;
+    description = _parameters[id].parameter->description;
     return true;
 }
 
@@ -602,16 +949,15 @@ bool CameraDefinition::get_option_str(const std::string &setting_name,
 {
     description.clear();
 
-    if (_parameter_map.find(setting_name) == _parameter_map.end()) {
+    size_t id;
+    if (!find_parameter_id(setting_name, id)) {
         LogWarn() << "Setting " << setting_name << " not found.";
         return false;
     }
 
-    for (const auto &option : _parameter_map[setting_name]->options) {
-        std::stringstream value_ss {};
-        value_ss << option->value;
-        if (option->value == option_name) {
-            description = option->name;
+    for (const auto &option : _parameters[id].options) {
+        if (option.option->value == option_name) {
+            description = option.option->name;
             return true;
         }
     }
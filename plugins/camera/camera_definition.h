@@ -6,6 +6,8 @@
 #include <memory>
 #include <map>
 #include <string>
+#include <unordered_map>
+#include <utility>
 
 namespace dronecore {
 
@@ -18,6 +20,12 @@ public:
     bool load_file(const std::string &filepath);
     bool load_string(const std::string &content);
 
+    // The parsed definition as a compact binary, so that it can be cached and
+    // loaded again without any XML. Only meant to be read again by the same
+    // build on the same machine.
+    void save_binary(std::string &data) const;
+    bool load_binary(const std::string &data);
+
     std::string get_vendor() const;
     std::string get_model() const;
 
@@ -73,18 +81,60 @@ private:
         std::vector<std::string> updates;
         std::vector<std::shared_ptr<Option>> options;
     };
+
     bool parse_xml();
 
+    // Interns the parameters and options of _parameter_map into the ids and
+    // bits below, so that the queries work without comparing names or values.
+    void build_index();
+
+    static constexpr uint32_t BINARY_VERSION = 1;
+
     tinyxml2::XMLDocument _doc {};
 
+    // As loaded, only used to build the index and to save.
     std::map<std::string, std::shared_ptr<Parameter>> _parameter_map;
 
+    // A bit per parameter id or per option of a parameter.
+    typedef std::vector<uint64_t> bitset_t;
+
+    struct IndexedOption {
+        const Option *option;
+        // Parameters which don't apply while this option is set.
+        bitset_t exclusions;
+        // Options of other parameters which are possible while this one is
+        // set, by parameter id, only for those with a range.
+        std::vector<std::pair<size_t, bitset_t>> ranges;
+    };
+
+    struct IndexedParameter {
+        std::string name;
+        const Parameter *parameter;
+        std::vector<IndexedOption> options;
+        // Parameter ids, unknown names are left out.
+        std::vector<size_t> updates;
+    };
+
+    // The id is the index, in the order of the names.
+    std::vector<IndexedParameter> _parameters {};
+    std::unordered_map<ParamId, size_t, ParamId::Hash> _parameter_ids {};
+
+    bool find_parameter_id(const std::string &name, size_t &id) const;
+    const bitset_t &current_exclusions();
+
     struct InternalCurrentSetting {
         MAVLinkParameters::ParamValue value;
         bool needs_updating;
+        // Index of the option with this value, -1 if none has it.
+        int option;
     };
 
-    std::map<std::string, InternalCurrentSetting> _current_settings;
+    // By parameter id.
+    std::vector<InternalCurrentSetting> _current_settings {};
+
+    // Of the current settings, only computed again once they changed.
+    bitset_t _current_exclusions {};
+    bool _current_exclusions_valid = false;
 
     std::string _model;
     std::string _vendor;
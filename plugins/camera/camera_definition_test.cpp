@@ -5,6 +5,7 @@
 #include <map>
 #include <memory>
 #include <fstream>
+#include <cstring>
 
 using namespace dronecore;
 
@@ -486,3 +487,98 @@ TEST(CameraDefinition, E90OptionHumanReadable)
     EXPECT_FALSE(cd.get_option_str("PIPAPO", "123", description));
     EXPECT_STREQ(description.c_str(), "");
 }
+
+TEST(CameraDefinition, E90LoadBinary)
+{
+    // Run this from root.
+    CameraDefinition cd_xml;
+    ASSERT_TRUE(cd_xml.load_file(e90_unit_test_file));
+
+    std::string binary;
+    cd_xml.save_binary(binary);
+
+    CameraDefinition cd;
+    ASSERT_TRUE(cd.load_binary(binary));
+    EXPECT_STREQ(cd.get_vendor().c_str(), "Yuneec");
+    EXPECT_STREQ(cd.get_model().c_str(), "E90");
+
+    cd.assume_default_settings();
+
+    {
+        std::map<std::string, MAVLinkParameters::ParamValue> settings {};
+        EXPECT_TRUE(cd.get_all_settings(settings));
+        EXPECT_EQ(settings.size(), 16);
+        EXPECT_FLOAT_EQ(settings["CAM_SHUTTERSPD"].get_float(), 0.016666f);
+    }
+
+    {
+        // Exclusions still apply.
+        std::vector<MAVLinkParameters::ParamValue> values;
+        EXPECT_FALSE(cd.get_possible_options("CAM_SHUTTERSPD", values));
+    }
+
+    {
+        // And so do the ranges, HEVC allows fewer resolutions.
+        MAVLinkParameters::ParamValue value;
+        value.set_uint32(3);
+        EXPECT_TRUE(cd.set_setting("CAM_VIDFMT", value));
+
+        std::vector<MAVLinkParameters::ParamValue> values;
+        EXPECT_TRUE(cd.get_possible_options("CAM_VIDRES", values));
+        EXPECT_EQ(values.size(), 26);
+    }
+
+    std::string description {};
+    EXPECT_TRUE(cd.get_option_str("CAM_WBMODE", "5", description));
+    EXPECT_STREQ(description.c_str(), "Cloudy");
+
+    // Saving again gives the same.
+    std::string binary_again;
+    cd.save_binary(binary_again);
+    EXPECT_EQ(binary, binary_again);
+}
+
+TEST(CameraDefinition, E90LoadBinaryCorrupt)
+{
+    // Run this from root.
+    CameraDefinition cd_xml;
+    ASSERT_TRUE(cd_xml.load_file(e90_unit_test_file));
+
+    std::string binary;
+    cd_xml.save_binary(binary);
+
+    CameraDefinition cd;
+    EXPECT_FALSE(cd.load_binary(binary.substr(0, binary.size() - 1)));
+    EXPECT_FALSE(cd.load_binary(binary + "x"));
+    EXPECT_FALSE(cd.load_binary(""));
+    EXPECT_FALSE(cd.load_binary("XXXX" + binary.substr(4)));
+}
+
+TEST(CameraDefinition, E90LoadBinaryHugeCount)
+{
+    // Run this from root.
+    CameraDefinition cd_xml;
+    ASSERT_TRUE(cd_xml.load_file(e90_unit_test_file));
+
+    // Only the magic and version stay.
+    std::string binary;
+    cd_xml.save_binary(binary);
+    binary.resize(8);
+    auto append_u32 = [&binary](uint32_t value) {
+        char bytes[sizeof(value)];
+        memcpy(bytes, &value, sizeof(value));
+        binary.append(bytes, sizeof(bytes));
+    };
+    // Model, vendor and one parameter with empty name and description.
+    append_u32(0);
+    append_u32(0);
+    append_u32(1);
+    append_u32(0);
+    append_u32(0);
+    binary.append(3, '\0');
+    // More updates than could ever be in what is left.
+    append_u32(0xffffffff);
+
+    CameraDefinition cd;
+    EXPECT_FALSE(cd.load_binary(binary));
+}
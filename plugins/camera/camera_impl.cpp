@@ -4,16 +4,33 @@
 #include "global_include.h"
 #include "mavlink_include.h"
 #include "http_loader.h"
+#include "inflater.h"
+#include "thread_roles.h"
+#include <cstdlib>
+#include <fstream>
 #include <functional>
+#include <memory>
+#include <set>
+#include <sstream>
 
 namespace dronecore {
 
 using namespace std::placeholders; // for `_1`
 
-CameraImpl::CameraImpl(System &system) :
-    PluginImplBase(system)
+std::mutex CameraImpl::_definition_cache_mutex {};
+std::map<std::pair<std::string, uint16_t>, std::string> CameraImpl::_definition_cache {};
+
+CameraImpl::CameraImpl(System &system, int camera_id) :
+    PluginImplBase(system),
+    _component_id(uint8_t(MAV_COMP_ID_CAMERA + camera_id))
 {
     _parent->register_plugin(this);
+
+    _definition_cache_dir = _parent->state_subdir("camera_definitions");
+    const char *cache_dir = std::getenv("DRONECORE_CAMERA_DEFINITION_CACHE_DIR");
+    if (_definition_cache_dir.empty() && cache_dir != nullptr) {
+        _definition_cache_dir = cache_dir;
+    }
 }
 
 CameraImpl::~CameraImpl()
@@ -61,6 +78,30 @@ void CameraImpl::init()
 void CameraImpl::deinit()
 {
     _parent->unregister_all_mavlink_message_handlers(this);
+    {
+        // No new one is started once the handlers are gone.
+        std::thread thread;
+        {
+            std::lock_guard<std::mutex> lock(_definition_loading.mutex);
+            thread = std::move(_definition_loading.thread);
+        }
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    {
+        // Waits for the transfers which are running.
+        std::lock_guard<std::mutex> lock(_http.mutex);
+        if (_http.loader) {
+            _http.loader->stop();
+            _http.loader.reset();
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(_capture_log.mutex);
+        _parent->unregister_timeout_handler(_capture_log.timeout_cookie);
+        _capture_log.timeout_cookie = nullptr;
+    }
 }
 
 void CameraImpl::enable()
@@ -73,6 +114,24 @@ void CameraImpl::disable()
     invalidate_params();
 }
 
+void CameraImpl::add_resource_usage(DroneCore::ResourceUsage &usage)
+{
+    {
+        std::lock_guard<std::mutex> lock(_definition_loading.mutex);
+        if (_definition_loading.is_loading) {
+            ++usage.num_threads;
+        }
+    }
+    {
+        // The loader runs the transfers on a thread of its own.
+        std::lock_guard<std::mutex> lock(_http.mutex);
+        if (_http.loader) {
+            ++usage.num_threads;
+        }
+    }
+    usage.camera_definition_bytes += _camera_definition_bytes.load();
+}
+
 MAVLinkCommands::CommandLong
 CameraImpl::make_command_request_camera_info()
 {
@@ -80,7 +139,7 @@ CameraImpl::make_command_request_camera_info()
 
     command_camera_info.command = MAV_CMD_REQUEST_CAMERA_INFORMATION;
     command_camera_info.params.param1 = 1.0f; // Request it
-    command_camera_info.target_component_id = MAV_COMP_ID_CAMERA;
+    command_camera_info.target_component_id = _component_id;
 
     return command_camera_info;
 }
@@ -95,7 +154,7 @@ CameraImpl::make_command_take_photo(float interval_s, float no_of_photos)
     cmd_take_photo.params.param2 = interval_s;
     cmd_take_photo.params.param3 = no_of_photos;
     cmd_take_photo.params.param4 = float(_capture.sequence++);
-    cmd_take_photo.target_component_id = MAV_COMP_ID_CAMERA;
+    cmd_take_photo.target_component_id = _component_id;
 
     return cmd_take_photo;
 }
@@ -106,7 +165,7 @@ CameraImpl::make_command_stop_photo()
     MAVLinkCommands::CommandLong cmd_stop_photo {};
 
     cmd_stop_photo.command = MAV_CMD_IMAGE_STOP_CAPTURE;
-    cmd_stop_photo.target_component_id = MAV_COMP_ID_CAMERA;
+    cmd_stop_photo.target_component_id = _component_id;
 
     return cmd_stop_photo;
 }
@@ -119,7 +178,7 @@ CameraImpl::make_command_start_video(float capture_status_rate_hz)
     cmd_start_video.command = MAV_CMD_VIDEO_START_CAPTURE;
     cmd_start_video.params.param1 = 0.f; // Reserved, set to 0
     cmd_start_video.params.param2 = capture_status_rate_hz;
-    cmd_start_video.target_component_id = MAV_COMP_ID_CAMERA;
+    cmd_start_video.target_component_id = _component_id;
 
     return cmd_start_video;
 }
@@ -131,7 +190,7 @@ CameraImpl::make_command_stop_video()
 
     cmd_stop_video.command = MAV_CMD_VIDEO_STOP_CAPTURE;
     cmd_stop_video.params.param1 = 0.f; // Reserved, set to 0
-    cmd_stop_video.target_component_id = MAV_COMP_ID_CAMERA;
+    cmd_stop_video.target_component_id = _component_id;
 
     return cmd_stop_video;
 }
@@ -144,7 +203,7 @@ CameraImpl::make_command_set_camera_mode(float mavlink_mode)
     cmd_set_camera_mode.command = MAV_CMD_SET_CAMERA_MODE;
     cmd_set_camera_mode.params.param1 = 0.0f; // Reserved, set to 0
     cmd_set_camera_mode.params.param2 = mavlink_mode;
-    cmd_set_camera_mode.target_component_id = MAV_COMP_ID_CAMERA;
+    cmd_set_camera_mode.target_component_id = _component_id;
 
     return  cmd_set_camera_mode;
 }
@@ -156,7 +215,7 @@ CameraImpl::make_command_request_camera_settings()
 
     cmd_req_camera_settings.command = MAV_CMD_REQUEST_CAMERA_SETTINGS;
     cmd_req_camera_settings.params.param1 = 1.f; // Request it
-    cmd_req_camera_settings.target_component_id = MAV_COMP_ID_CAMERA;
+    cmd_req_camera_settings.target_component_id = _component_id;
 
     return cmd_req_camera_settings;
 }
@@ -180,7 +239,7 @@ CameraImpl::make_command_request_storage_info()
     cmd_req_storage_info.command = MAV_CMD_REQUEST_STORAGE_INFORMATION;
     cmd_req_storage_info.params.param1 = 0.f; // Reserved, set to 0
     cmd_req_storage_info.params.param2 = 1.f; // Request it
-    cmd_req_storage_info.target_component_id = MAV_COMP_ID_CAMERA;
+    cmd_req_storage_info.target_component_id = _component_id;
 
     return cmd_req_storage_info;
 }
@@ -191,7 +250,7 @@ CameraImpl::make_command_start_video_streaming()
     MAVLinkCommands::CommandLong cmd_start_video_streaming {};
 
     cmd_start_video_streaming.command = MAV_CMD_VIDEO_START_STREAMING;
-    cmd_start_video_streaming.target_component_id = MAV_COMP_ID_CAMERA;
+    cmd_start_video_streaming.target_component_id = _component_id;
 
     return  cmd_start_video_streaming;
 }
@@ -202,7 +261,7 @@ CameraImpl::make_command_stop_video_streaming()
     MAVLinkCommands::CommandLong cmd_stop_video_streaming {};
 
     cmd_stop_video_streaming.command = MAV_CMD_VIDEO_STOP_STREAMING;
-    cmd_stop_video_streaming.target_component_id = MAV_COMP_ID_CAMERA;
+    cmd_stop_video_streaming.target_component_id = _component_id;
 
     return  cmd_stop_video_streaming;
 
@@ -217,8 +276,8 @@ CameraImpl::make_message_set_video_stream_settings(const Camera::VideoStreamSett
                                                GCSClient::component_id,
                                                &msg,
                                                _parent->get_system_id(),
-                                               MAV_COMP_ID_CAMERA,
-                                               MAV_COMP_ID_CAMERA, // Is it right ?
+                                               _component_id,
+                                               _component_id, // Is it right ?
                                                settings.frame_rate_hz,
                                                settings.horizontal_resolution_pix,
                                                settings.vertical_resolution_pix,
@@ -236,11 +295,24 @@ CameraImpl::make_command_request_video_stream_info()
 
     cmd_req_video_stream_info.command = MAV_CMD_REQUEST_VIDEO_STREAM_INFORMATION;
     cmd_req_video_stream_info.params.param2 = 1.0f;
-    cmd_req_video_stream_info.target_component_id = MAV_COMP_ID_CAMERA;
+    cmd_req_video_stream_info.target_component_id = _component_id;
 
     return cmd_req_video_stream_info;
 }
 
+MAVLinkCommands::CommandLong
+CameraImpl::make_command_request_image_captured(int index)
+{
+    MAVLinkCommands::CommandLong cmd_req_image_captured {};
+
+    cmd_req_image_captured.command = MAV_CMD_REQUEST_MESSAGE;
+    cmd_req_image_captured.params.param1 = float(MAVLINK_MSG_ID_CAMERA_IMAGE_CAPTURED);
+    cmd_req_image_captured.params.param2 = float(index);
+    cmd_req_image_captured.target_component_id = _component_id;
+
+    return cmd_req_image_captured;
+}
+
 Camera::Result CameraImpl::take_photo()
 {
     // TODO: check whether we are in photo mode.
@@ -402,28 +474,36 @@ Camera::Result CameraImpl::stop_video_streaming()
 Camera::Result
 CameraImpl::get_video_stream_info(Camera::VideoStreamInfo &info)
 {
-    Camera::Result result = Camera::Result::SUCCESS;
     {
         std::lock_guard<std::mutex> lock(_video_stream_info.mutex);
-
-        do {
-            if (!_video_stream_info.available) { // Request if not available
-                auto command = make_command_request_video_stream_info();
-                result = camera_result_from_command_result(_parent->send_command(command));
-                if (result != Camera::Result::SUCCESS) {
-                    LogErr() << "Failed to request video stream info";
-                    break;
-                }
-                while (!_video_stream_info.available) { // Wait for video stream info
-                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
-                }
-            }
-            // Copy to application, once video stream info is available.
+        if (_video_stream_info.available) {
             info = _video_stream_info.info;
-        } while (false);
+            return Camera::Result::SUCCESS;
+        }
+    }
+
+    // Request if not available. The lock is not held while waiting, so that
+    // the answer can be taken in.
+    auto command = make_command_request_video_stream_info();
+    auto result = camera_result_from_command_result(_parent->send_command(command));
+    if (result != Camera::Result::SUCCESS) {
+        LogErr() << "Failed to request video stream info";
+        return result;
+    }
+
+    auto is_available = [this]() {
+        std::lock_guard<std::mutex> lock(_video_stream_info.mutex);
+        return _video_stream_info.available;
+    };
+    if (!_parent->await_condition(is_available, DEFAULT_TIMEOUT_S)) {
+        LogErr() << "Timeout waiting for video stream info";
+        return Camera::Result::TIMEOUT;
     }
 
-    return result;;
+    // Copy to application, once video stream info is available.
+    std::lock_guard<std::mutex> lock(_video_stream_info.mutex);
+    info = _video_stream_info.info;
+    return Camera::Result::SUCCESS;
 }
 
 Camera::Result
@@ -511,52 +591,52 @@ void CameraImpl::get_status_async(Camera::get_status_callback_t callback)
         return;
     }
 
+    bool request_capture_status;
     {
         std::lock_guard<std::mutex> lock(_status.mutex);
 
-        // If we're already trying to get the status, we need to wait.
-        if (_status.callback != nullptr) {
-            if (callback) {
-                Camera::Status empty_status = {};
-                callback(Camera::Result::IN_PROGRESS, empty_status);
-                return;
-            }
+        _status.callbacks.push_back(callback);
+        if (_status.callbacks.size() > 1) {
+            // The request going on answers this one too.
+            return;
         }
-        // Let's create a subscription for the (hopefully) incoming messages.
-        _status.callback = callback;
+
+        request_capture_status =
+            !_status.has_capture_status ||
+            _parent->get_time().elapsed_since_s(_status.capture_status_time) >
+            CAPTURE_STATUS_MAX_AGE_S;
+        _status.awaiting_capture_status = request_capture_status;
+        _status.awaiting_storage_information = true;
+
+        _parent->register_timeout_handler(std::bind(&CameraImpl::status_timeout_happened, this),
+                                          DEFAULT_TIMEOUT_S, &_status.timeout_cookie);
     }
 
-    auto cmd_req_camera_capture_stat = make_command_request_camera_capture_status();
-    _parent->send_command_async(cmd_req_camera_capture_stat,
-                                std::bind(&CameraImpl::receive_camera_capture_status_result, this, _1));
+    // Both go out right away, the answers are waited for together.
+    if (request_capture_status) {
+        auto cmd_req_camera_capture_stat = make_command_request_camera_capture_status();
+        _parent->send_command_async(cmd_req_camera_capture_stat,
+                                    std::bind(&CameraImpl::receive_camera_capture_status_result,
+                                              this, _1));
+    }
 
     auto cmd_req_storage_info = make_command_request_storage_info();
     _parent->send_command_async(cmd_req_storage_info,
                                 std::bind(&CameraImpl::receive_storage_information_result, this, _1));
-
-    _parent->register_timeout_handler(std::bind(&CameraImpl::status_timeout_happened, this),
-                                      DEFAULT_TIMEOUT_S, &_status.timeout_cookie);
 }
 
 void CameraImpl::receive_camera_capture_status_result(MAVLinkCommands::Result result)
 {
-    std::lock_guard<std::mutex> lock(_status.mutex);
-
-    if (_status.callback == nullptr) {
-        // We're not expecting this message, let's ignore it.
-        return;
-    }
-
     if (result != MAVLinkCommands::Result::SUCCESS) {
-        if (_status.callback) {
-            Camera::Status empty_status = {};
-            _status.callback(camera_result_from_command_result(result), empty_status);
-        }
         // Something went wrong, we give up.
-        _status.callback = nullptr;
+        finish_status(camera_result_from_command_result(result));
+        return;
     }
 
-    _parent->refresh_timeout_handler(_status.timeout_cookie);
+    std::lock_guard<std::mutex> lock(_status.mutex);
+    if (!_status.callbacks.empty()) {
+        _parent->refresh_timeout_handler(_status.timeout_cookie);
+    }
 }
 
 void CameraImpl::capture_info_async(Camera::capture_info_callback_t callback)
@@ -566,8 +646,105 @@ void CameraImpl::capture_info_async(Camera::capture_info_callback_t callback)
     _capture_info.callback = callback;
 }
 
+void CameraImpl::get_capture_log(std::vector<Camera::CaptureInfo> &captures)
+{
+    std::lock_guard<std::mutex> lock(_capture_log.mutex);
+    _capture_log.log.export_captures(captures);
+}
+
+void CameraImpl::clear_capture_log()
+{
+    std::lock_guard<std::mutex> lock(_capture_log.mutex);
+    _capture_log.log.clear();
+    _parent->unregister_timeout_handler(_capture_log.timeout_cookie);
+    _capture_log.timeout_cookie = nullptr;
+}
+
+void CameraImpl::download_photos_async(const std::vector<Camera::CaptureInfo> &captures,
+                                       const std::string &directory,
+                                       Camera::download_photos_callback_t callback)
+{
+    std::vector<HttpLoader::BatchFile> files;
+    for (const auto &capture : captures) {
+        if (capture.file_url.empty()) {
+            continue;
+        }
+
+        // Named like in the URL, without any query.
+        std::string file_name = capture.file_url.substr(0, capture.file_url.find('?'));
+        file_name = file_name.substr(file_name.find_last_of('/') + 1);
+        if (file_name.empty()) {
+            file_name = "capture_" + std::to_string(capture.index);
+        }
+
+        files.push_back(HttpLoader::BatchFile {capture.file_url, directory + "/" + file_name});
+    }
+
+    get_http_loader()->download_batch_async(
+        files, PHOTO_DOWNLOAD_PARALLEL,
+    [this, callback](const HttpLoader::BatchProgress & batch_progress) {
+        if (!callback) {
+            return;
+        }
+
+        Camera::DownloadProgress progress {};
+        progress.num_photos = unsigned(batch_progress.num_files);
+        progress.num_downloaded = unsigned(batch_progress.num_succeeded);
+        progress.num_failed = unsigned(batch_progress.num_failed);
+        progress.percentage = batch_progress.percentage;
+
+        Camera::Result result = Camera::Result::IN_PROGRESS;
+        if (batch_progress.finished) {
+            result = (progress.num_failed == 0) ? Camera::Result::SUCCESS : Camera::Result::ERROR;
+        }
+
+        // Progress which is not taken in time is dropped, the end is always reported.
+        _parent->call_user_callback(this, &_http, [callback, result, progress]() {
+            callback(result, progress);
+        });
+    });
+}
+
+std::shared_ptr<HttpLoader> CameraImpl::get_http_loader()
+{
+    std::lock_guard<std::mutex> lock(_http.mutex);
+    if (!_http.loader) {
+        _http.loader = std::make_shared<HttpLoader>();
+    }
+    return _http.loader;
+}
+
+void CameraImpl::request_missing_captures()
+{
+    std::vector<int> batch;
+    {
+        std::lock_guard<std::mutex> lock(_capture_log.mutex);
+        _capture_log.timeout_cookie = nullptr;
+
+        batch = _capture_log.log.next_missing_batch(CAPTURE_REQUEST_BATCH);
+        if (batch.empty()) {
+            return;
+        }
+
+        // Again for the rest, and for these if they still don't arrive.
+        _parent->register_timeout_handler(
+            std::bind(&CameraImpl::request_missing_captures, this),
+            CAPTURE_REQUEST_INTERVAL_S, &_capture_log.timeout_cookie);
+    }
+
+    LogDebug() << "Requesting " << batch.size() << " missing captures";
+    for (int index : batch) {
+        auto command = make_command_request_image_captured(index);
+        _parent->send_command_async(command, nullptr);
+    }
+}
+
 void CameraImpl::process_camera_capture_status(const mavlink_message_t &message)
 {
+    if (message.compid != _component_id) {
+        return;
+    }
+
     mavlink_camera_capture_status_t camera_capture_status;
     mavlink_msg_camera_capture_status_decode(&message, &camera_capture_status);
 
@@ -577,7 +754,9 @@ void CameraImpl::process_camera_capture_status(const mavlink_message_t &message)
         _status.data.video_on = (camera_capture_status.video_status == 1);
         _status.data.photo_interval_on = (camera_capture_status.image_status == 2 ||
                                           camera_capture_status.image_status == 3);
-        _status.received_camera_capture_status = true;
+        _status.has_capture_status = true;
+        _status.capture_status_time = _parent->get_time().steady_time();
+        _status.awaiting_capture_status = false;
     }
 
     check_status();
@@ -585,6 +764,10 @@ void CameraImpl::process_camera_capture_status(const mavlink_message_t &message)
 
 void CameraImpl::process_storage_information(const mavlink_message_t &message)
 {
+    if (message.compid != _component_id) {
+        return;
+    }
+
     mavlink_storage_information_t storage_information;
     mavlink_msg_storage_information_decode(&message, &storage_information);
 
@@ -600,7 +783,7 @@ void CameraImpl::process_storage_information(const mavlink_message_t &message)
         _status.data.available_storage_mib = storage_information.available_capacity;
         _status.data.used_storage_mib = storage_information.used_capacity;
         _status.data.total_storage_mib = storage_information.total_capacity;
-        _status.received_storage_information = true;
+        _status.awaiting_storage_information = false;
     }
 
     check_status();
@@ -608,33 +791,60 @@ void CameraImpl::process_storage_information(const mavlink_message_t &message)
 
 void CameraImpl::process_camera_image_captured(const mavlink_message_t &message)
 {
+    if (message.compid != _component_id) {
+        return;
+    }
+
     mavlink_camera_image_captured_t image_captured;
     mavlink_msg_camera_image_captured_decode(&message, &image_captured);
 
+    Camera::CaptureInfo capture_info = {};
+    capture_info.position.latitude_deg = image_captured.lat / 1e7;
+    capture_info.position.longitude_deg = image_captured.lon / 1e7;
+    capture_info.position.absolute_altitude_m = image_captured.alt / 1e3f;
+    capture_info.position.relative_altitude_m = image_captured.relative_alt / 1e3f;
+    capture_info.time_utc_us = image_captured.time_utc;
+    capture_info.quaternion.w = image_captured.q[0];
+    capture_info.quaternion.x = image_captured.q[1];
+    capture_info.quaternion.y = image_captured.q[2];
+    capture_info.quaternion.z = image_captured.q[3];
+    capture_info.file_url = std::string(image_captured.file_url);
+    capture_info.success = (image_captured.capture_result == 1);
+    capture_info.index = image_captured.image_index;
+
+    {
+        std::lock_guard<std::mutex> lock(_capture_log.mutex);
+        _capture_log.log.add(capture_info);
+
+        // Give the missing ones a moment in case they only come out of order.
+        if (_capture_log.log.num_missing() > 0 && _capture_log.timeout_cookie == nullptr) {
+            _parent->register_timeout_handler(
+                std::bind(&CameraImpl::request_missing_captures, this),
+                CAPTURE_REQUEST_INTERVAL_S, &_capture_log.timeout_cookie);
+        }
+    }
+
+    Camera::capture_info_callback_t callback;
     {
         std::lock_guard<std::mutex> lock(_capture_info.mutex);
+        callback = _capture_info.callback;
+    }
 
-        if (_capture_info.callback) {
-            Camera::CaptureInfo capture_info = {};
-            capture_info.position.latitude_deg = image_captured.lat / 1e7;
-            capture_info.position.longitude_deg = image_captured.lon / 1e7;
-            capture_info.position.absolute_altitude_m = image_captured.alt / 1e3f;
-            capture_info.position.relative_altitude_m = image_captured.relative_alt / 1e3f;
-            capture_info.time_utc_us = image_captured.time_utc;
-            capture_info.quaternion.w = image_captured.q[0];
-            capture_info.quaternion.x = image_captured.q[1];
-            capture_info.quaternion.y = image_captured.q[2];
-            capture_info.quaternion.z = image_captured.q[3];
-            capture_info.file_url = std::string(image_captured.file_url);
-            capture_info.success = (image_captured.capture_result == 1);
-            capture_info.index = image_captured.image_index;
-            _capture_info.callback(capture_info);
-        }
+    if (callback) {
+        // Every capture is reported, none dropped. The lock is not held, so that
+        // waiting for a slow callback can't block it from setting a new one.
+        _parent->call_user_callback(this, &_capture_info, [callback, capture_info]() {
+            callback(capture_info);
+        }, CallbackExecutor::Overflow::BLOCK);
     }
 }
 
 void CameraImpl::process_camera_settings(const mavlink_message_t &message)
 {
+    if (message.compid != _component_id) {
+        return;
+    }
+
     std::lock_guard<std::mutex> lock(_get_mode.mutex);
 
     if (_get_mode.callback == nullptr) {
@@ -674,14 +884,41 @@ void CameraImpl::process_camera_settings(const mavlink_message_t &message)
 
 void CameraImpl::process_camera_information(const mavlink_message_t &message)
 {
+    if (message.compid != _component_id) {
+        return;
+    }
+
     mavlink_camera_information_t camera_information;
     mavlink_msg_camera_information_decode(&message, &camera_information);
 
-    load_definition_file(camera_information.cam_definition_uri);
+    // Downloading and parsing the definition takes a while, so it is done next
+    // to receiving, and the cameras of a system are brought up at the same time.
+    std::lock_guard<std::mutex> lock(_definition_loading.mutex);
+    if (_definition_loading.is_loading) {
+        return;
+    }
+    if (_definition_loading.thread.joinable()) {
+        _definition_loading.thread.join();
+    }
+    _definition_loading.is_loading = true;
+
+    const std::string uri = camera_information.cam_definition_uri;
+    const uint16_t version = camera_information.cam_definition_version;
+    _definition_loading.thread = std::thread([this, uri, version]() {
+        ThreadRoles::apply_to_this_thread(DroneCore::ThreadRole::HTTP, "camera_definition");
+        load_definition_file(uri, version);
+
+        std::lock_guard<std::mutex> loading_lock(_definition_loading.mutex);
+        _definition_loading.is_loading = false;
+    });
 }
 
 void CameraImpl::process_video_information(const mavlink_message_t &message)
 {
+    if (message.compid != _component_id) {
+        return;
+    }
+
     mavlink_video_stream_information_t received_video_info;
     mavlink_msg_video_stream_information_decode(&message, &received_video_info);
 
@@ -699,37 +936,59 @@ void CameraImpl::process_video_information(const mavlink_message_t &message)
 
         _video_stream_info.available = true;
     }
+
+    _parent->notify_waiters();
 }
 
 void CameraImpl::check_status()
 {
-    std::lock_guard<std::mutex> lock(_status.mutex);
-
-    if (_status.received_camera_capture_status &&
-        _status.received_storage_information) {
-
-        if (_status.callback) {
-            _status.callback(Camera::Result::SUCCESS, _status.data);
-            _status.callback = nullptr;
-            _status.received_camera_capture_status = false;
-            _status.received_storage_information = false;
-            _parent->unregister_timeout_handler(_status.timeout_cookie);
+    {
+        std::lock_guard<std::mutex> lock(_status.mutex);
+        if (_status.callbacks.empty() || _status.awaiting_capture_status ||
+            _status.awaiting_storage_information) {
+            return;
         }
     }
+
+    finish_status(Camera::Result::SUCCESS);
 }
 
 void CameraImpl::status_timeout_happened()
 {
-    std::lock_guard<std::mutex> lock(_status.mutex);
+    {
+        // The timeout is gone already.
+        std::lock_guard<std::mutex> lock(_status.mutex);
+        _status.timeout_cookie = nullptr;
+    }
+    finish_status(Camera::Result::TIMEOUT);
+}
+
+void CameraImpl::finish_status(Camera::Result result)
+{
+    std::vector<Camera::get_status_callback_t> callbacks;
+    Camera::Status status {};
+    {
+        std::lock_guard<std::mutex> lock(_status.mutex);
+        if (_status.callbacks.empty()) {
+            // We're not expecting this, let's ignore it.
+            return;
+        }
+        callbacks.swap(_status.callbacks);
+        if (result == Camera::Result::SUCCESS) {
+            status = _status.data;
+        }
+        _status.awaiting_capture_status = false;
+        _status.awaiting_storage_information = false;
+        if (_status.timeout_cookie != nullptr) {
+            _parent->unregister_timeout_handler(_status.timeout_cookie);
+            _status.timeout_cookie = nullptr;
+        }
+    }
 
-    if (_status.callback) {
-        // Send empty settings with timeout error.
-        Camera::Status empty_status = {};
-        _status.callback(Camera::Result::TIMEOUT, empty_status);
-        // Then give up.
+    // Called without the lock, so that they can ask again.
+    for (const auto &callback : callbacks) {
+        callback(result, status);
     }
-    // Discard the subscription
-    _status.callback = nullptr;
 }
 
 void CameraImpl::receive_command_result(MAVLinkCommands::Result command_result,
@@ -745,24 +1004,16 @@ void CameraImpl::receive_command_result(MAVLinkCommands::Result command_result,
 
 void CameraImpl::receive_storage_information_result(MAVLinkCommands::Result result)
 {
-    std::lock_guard<std::mutex> lock(_status.mutex);
-    if (_status.callback == nullptr) {
-        // We're not expecting this message, let's ignore it.
-        return;
-    }
-
     if (result != MAVLinkCommands::Result::SUCCESS) {
-        if (_status.callback) {
-            Camera::Status empty_status = {};
-            _status.callback(camera_result_from_command_result(result), empty_status);
-        }
         // Something went wrong, we give up.
-        _status.callback = nullptr;
+        finish_status(camera_result_from_command_result(result));
+        return;
     }
 
-    // TODO: decode and save values
-
-    _parent->refresh_timeout_handler(_status.timeout_cookie);
+    std::lock_guard<std::mutex> lock(_status.mutex);
+    if (!_status.callbacks.empty()) {
+        _parent->refresh_timeout_handler(_status.timeout_cookie);
+    }
 }
 
 void CameraImpl::receive_set_mode_command_result(MAVLinkCommands::Result command_result,
@@ -829,22 +1080,151 @@ void CameraImpl::get_mode_timeout_happened()
     }
 }
 
-void CameraImpl::load_definition_file(const std::string &uri)
+void CameraImpl::load_definition_file(const std::string &uri, uint16_t version)
 {
-    HttpLoader http_loader;
-    std::string content;
-    LogInfo() << "Downloading camera definition from: " << uri;
-    if (!http_loader.download_text_sync(uri, content)) {
-        LogErr() << "Failed to download camera definition.";
-        return;
+    std::unique_ptr<CameraDefinition> camera_definition(new CameraDefinition());
+
+    std::string binary;
+    if (load_cached_definition(uri, version, binary) && camera_definition->load_binary(binary)) {
+        LogDebug() << "Using cached camera definition of: " << uri;
+
+    } else {
+        std::string content;
+        LogInfo() << "Downloading camera definition from: " << uri;
+        if (!download_definition(uri, content)) {
+            LogErr() << "Failed to download camera definition.";
+            return;
+        }
+
+        camera_definition.reset(new CameraDefinition());
+        if (camera_definition->load_string(content)) {
+            camera_definition->save_binary(binary);
+            save_cached_definition(uri, version, binary);
+        }
     }
 
-    _camera_definition.reset(new CameraDefinition());
-    _camera_definition->load_string(content);
+    _camera_definition = std::move(camera_definition);
+    _camera_definition_bytes = binary.size();
 
     refresh_params();
 }
 
+static bool ends_with(const std::string &text, const std::string &suffix)
+{
+    return text.size() >= suffix.size() &&
+           text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool CameraImpl::download_definition(const std::string &uri, std::string &content)
+{
+    if (ends_with(uri, ".xml.xz")) {
+        LogErr() << "Camera definitions compressed with xz are not supported: " << uri;
+        return false;
+    }
+
+    if (!ends_with(uri, ".xml.gz")) {
+        // Next to any photos which are being downloaded, not after them.
+        return get_http_loader()->download_text_sync(uri, content);
+    }
+
+    // The compressed file is never kept, it goes to the parser decompressed.
+    Inflater inflater;
+    bool is_first_chunk = true;
+    bool is_compressed = true;
+    const bool success = get_http_loader()->download_stream_sync(
+    uri, [&](const char *data, size_t size) {
+        if (is_first_chunk) {
+            // Unless the server sent it with Content-Encoding and curl decoded it.
+            is_compressed = Inflater::is_gzip(data, size);
+            is_first_chunk = false;
+        }
+        if (!is_compressed) {
+            content.append(data, size);
+            return true;
+        }
+        return inflater.feed(data, size, content);
+    });
+
+    if (success && is_compressed && !inflater.is_finished()) {
+        LogErr() << "Camera definition ended before its compressed data: " << uri;
+        return false;
+    }
+    return success;
+}
+
+bool CameraImpl::load_cached_definition(const std::string &uri, uint16_t version,
+                                        std::string &binary)
+{
+    std::lock_guard<std::mutex> lock(_definition_cache_mutex);
+
+    auto it = _definition_cache.find(std::make_pair(uri, version));
+    if (it != _definition_cache.end()) {
+        binary = it->second;
+        return true;
+    }
+
+    const std::string path = definition_cache_path(uri, version);
+    if (path.empty()) {
+        return false;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    // The URI comes first, the name of the file is only a hash of it.
+    std::string file_uri;
+    if (!std::getline(file, file_uri) || file_uri != uri) {
+        return false;
+    }
+
+    std::stringstream content;
+    content << file.rdbuf();
+    binary = content.str();
+    _definition_cache[std::make_pair(uri, version)] = binary;
+    return true;
+}
+
+void CameraImpl::save_cached_definition(const std::string &uri, uint16_t version,
+                                        const std::string &binary)
+{
+    std::lock_guard<std::mutex> lock(_definition_cache_mutex);
+
+    _definition_cache[std::make_pair(uri, version)] = binary;
+
+    const std::string path = definition_cache_path(uri, version);
+    if (path.empty()) {
+        return;
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        LogWarn() << "Could not write camera definition cache: " << path;
+        return;
+    }
+    file << uri << "\n";
+    file.write(binary.data(), std::streamsize(binary.size()));
+}
+
+std::string CameraImpl::definition_cache_path(const std::string &uri, uint16_t version) const
+{
+    if (_definition_cache_dir.empty()) {
+        return "";
+    }
+
+    // FNV-1a, so the name stays the same across runs.
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : uri) {
+        hash = (hash ^ uint8_t(c)) * 1099511628211ull;
+    }
+
+    std::stringstream path;
+    path << _definition_cache_dir << "/camera_definition_" << std::hex << hash
+         << "_" << std::dec << version << ".bin";
+    return path.str();
+}
+
 bool CameraImpl::get_possible_settings(std::vector<std::string> &settings)
 {
     settings.clear();
@@ -947,7 +1327,7 @@ void CameraImpl::set_option_async(const std::string &setting,
             }
         }
     },
-    true);
+    true, _component_id);
 
 }
 
@@ -982,7 +1362,7 @@ void CameraImpl::get_option_async(const std::string &setting,
                 return;
             }
             this->_camera_definition->set_setting(setting, value);
-        }, true);
+        }, true, _component_id);
 
         // At this point it might be a good idea to refresh but it's a bit scary
         // as the stack keeps growing at this point.
@@ -996,6 +1376,43 @@ void CameraImpl::refresh_params()
         return;
     }
 
+    std::vector<std::string> params {};
+    if (!_camera_definition->get_unknown_params(params) || params.empty()) {
+        return;
+    }
+
+    if (params.size() == 1) {
+        request_unknown_params();
+        return;
+    }
+
+    // The camera sends all its params for one request, instead of one round
+    // trip each. Only the unknown ones are taken, as they come in, so that the
+    // UI can show them right away.
+    auto unknown_params = std::make_shared<std::set<std::string>>(params.begin(), params.end());
+
+    _parent->fetch_all_ext_params_async(
+    [unknown_params, this](const std::string &name, MAVLinkParameters::ParamValue value) {
+        // We need to check again by the time this callback runs
+        if (!this->_camera_definition ||
+            unknown_params->find(name) == unknown_params->end()) {
+            return;
+        }
+        this->_camera_definition->set_setting(name, value);
+    },
+    [this](bool success) {
+        UNUSED(success);
+        // Whatever did not come with the list is asked for one by one.
+        request_unknown_params();
+    }, _component_id);
+}
+
+void CameraImpl::request_unknown_params()
+{
+    if (!_camera_definition) {
+        return;
+    }
+
     std::vector<std::string> params {};
     if (!_camera_definition->get_unknown_params(params)) {
         return;
@@ -1013,7 +1430,7 @@ void CameraImpl::refresh_params()
                 return;
             }
             this->_camera_definition->set_setting(param_name, value);
-        }, true);
+        }, true, _component_id);
     }
 }
 
@@ -4,14 +4,23 @@
 #include "camera.h"
 #include "plugin_impl_base.h"
 #include "camera_definition.h"
+#include "capture_log.h"
+#include "http_loader.h"
 #include "mavlink_system.h"
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace dronecore {
 
 class CameraImpl : public PluginImplBase
 {
 public:
-    CameraImpl(System &system);
+    CameraImpl(System &system, int camera_id);
     ~CameraImpl();
 
     void init() override;
@@ -19,6 +28,7 @@ public:
 
     void enable() override;
     void disable() override;
+    void add_resource_usage(DroneCore::ResourceUsage &usage) override;
 
     Camera::Result take_photo();
 
@@ -44,6 +54,11 @@ public:
     void get_mode_async(Camera::mode_callback_t callback);
 
     void capture_info_async(Camera::capture_info_callback_t callback);
+    void get_capture_log(std::vector<Camera::CaptureInfo> &captures);
+    void clear_capture_log();
+    void download_photos_async(const std::vector<Camera::CaptureInfo> &captures,
+                               const std::string &directory,
+                               Camera::download_photos_callback_t callback);
 
     void get_status_async(Camera::get_status_callback_t callback);
 
@@ -68,16 +83,26 @@ public:
     const CameraImpl &operator=(const CameraImpl &) = delete;
 
 private:
+    // Of the camera this instance is for, messages of other ones are ignored.
+    const uint8_t _component_id;
+
+    // Callers asking while a request is going on get the same answer. The
+    // status is only requested when someone asks, and a capture status which
+    // the camera streams is used instead of asking for it.
     struct {
         std::mutex mutex {};
-        Camera::get_status_callback_t callback {nullptr};
+        std::vector<Camera::get_status_callback_t> callbacks {};
         Camera::Status data {};
-        bool received_camera_capture_status {false};
-        bool received_storage_information {false};
+        bool has_capture_status {false};
+        dl_time_t capture_status_time {};
+        bool awaiting_capture_status {false};
+        bool awaiting_storage_information {false};
         void *timeout_cookie {nullptr};
     } _status;
 
     static constexpr double DEFAULT_TIMEOUT_S = 3.0;
+    // A capture status received since is recent enough not to ask for one.
+    static constexpr double CAPTURE_STATUS_MAX_AGE_S = 1.0;
 
     struct {
         std::mutex mutex {};
@@ -95,6 +120,27 @@ private:
         Camera::capture_info_callback_t callback {nullptr};
     } _capture_info;
 
+    struct {
+        std::mutex mutex {};
+        CaptureLog log {};
+        void *timeout_cookie {nullptr};
+    } _capture_log;
+
+    // Kept, so that the connections to the camera are reused by the next downloads,
+    // and shared by the photos and camera definitions.
+    struct {
+        std::mutex mutex {};
+        std::shared_ptr<HttpLoader> loader {};
+    } _http;
+
+    std::shared_ptr<HttpLoader> get_http_loader();
+
+    static constexpr unsigned PHOTO_DOWNLOAD_PARALLEL = 4;
+
+    // Long enough for captures which only came out of order.
+    static constexpr double CAPTURE_REQUEST_INTERVAL_S = 1.0;
+    static constexpr size_t CAPTURE_REQUEST_BATCH = 10;
+
     struct {
         std::mutex mutex {};
         Camera::VideoStreamInfo info;
@@ -139,12 +185,32 @@ private:
     void receive_camera_capture_status_result(MAVLinkCommands::Result result);
 
     void check_status();
+    // Calls back everyone waiting for the status with result.
+    void finish_status(Camera::Result result);
 
     void status_timeout_happened();
 
-    void load_definition_file(const std::string &uri);
+    void request_missing_captures();
+
+    // Runs on the thread of _definition_loading.
+    void load_definition_file(const std::string &uri, uint16_t version);
+    // Definitions ending in .xml.gz are decompressed while they arrive.
+    bool download_definition(const std::string &uri, std::string &content);
+
+    // A new CAMERA_INFORMATION while one is being loaded is ignored.
+    struct {
+        std::mutex mutex {};
+        std::thread thread {};
+        bool is_loading {false};
+    } _definition_loading;
+
+    bool load_cached_definition(const std::string &uri, uint16_t version, std::string &binary);
+    void save_cached_definition(const std::string &uri, uint16_t version,
+                                const std::string &binary);
+    std::string definition_cache_path(const std::string &uri, uint16_t version) const;
 
     void refresh_params();
+    void request_unknown_params();
     void invalidate_params();
 
     // Utility methods for convenience
@@ -167,9 +233,20 @@ private:
     make_message_set_video_stream_settings(const Camera::VideoStreamSettings &settings);
 
     MAVLinkCommands::CommandLong make_command_request_video_stream_info();
+    MAVLinkCommands::CommandLong make_command_request_image_captured(int index);
 
 
     std::unique_ptr<CameraDefinition> _camera_definition {};
+    // Of its binary form.
+    std::atomic<size_t> _camera_definition_bytes {0};
+
+    // Parsed definitions by URI and version, shared by all cameras so that
+    // reconnecting needs neither the download nor the XML. They are also kept
+    // in this directory, in the state directory or set by
+    // $DRONECORE_CAMERA_DEFINITION_CACHE_DIR.
+    static std::mutex _definition_cache_mutex;
+    static std::map<std::pair<std::string, uint16_t>, std::string> _definition_cache;
+    std::string _definition_cache_dir {};
 };
 
 
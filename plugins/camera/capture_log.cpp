@@ -0,0 +1,86 @@
+#include "capture_log.h"
+#include "log.h"
+
+namespace dronecore {
+
+constexpr size_t CaptureLog::DEFAULT_CAPACITY;
+constexpr unsigned CaptureLog::MAX_REQUESTS;
+constexpr int CaptureLog::MAX_GAP;
+
+CaptureLog::CaptureLog(size_t capacity) :
+    _capacity(capacity)
+{
+    _records.reserve(_capacity);
+    _slots.reserve(_capacity);
+}
+
+CaptureLog::~CaptureLog() {}
+
+bool CaptureLog::add(const Camera::CaptureInfo &capture_info)
+{
+    const int index = capture_info.index;
+    if (index < 0 || index >= int(_slots.size()) + MAX_GAP) {
+        LogWarn() << "Capture index " << index << " out of range";
+        return false;
+    }
+
+    const size_t slot_index = size_t(index);
+    if (slot_index < _slots.size()) {
+        if (_slots[slot_index].record >= 0) {
+            return false;
+        }
+        --_num_missing;
+    } else {
+        // Everything skipped up to this one is missing.
+        _num_missing += slot_index - _slots.size();
+        _slots.resize(slot_index + 1);
+    }
+
+    _slots[slot_index].record = int32_t(_records.size());
+    _records.push_back(capture_info);
+
+    while (_first_missing < _slots.size() && _slots[_first_missing].record >= 0) {
+        ++_first_missing;
+    }
+
+    return true;
+}
+
+std::vector<int> CaptureLog::next_missing_batch(size_t max_count)
+{
+    std::vector<int> batch;
+
+    for (size_t i = _first_missing; i < _slots.size() && batch.size() < max_count; ++i) {
+        Slot &slot = _slots[i];
+        if (slot.record >= 0 || slot.requests >= MAX_REQUESTS) {
+            continue;
+        }
+        ++slot.requests;
+        batch.push_back(int(i));
+    }
+
+    return batch;
+}
+
+void CaptureLog::export_captures(std::vector<Camera::CaptureInfo> &captures) const
+{
+    captures.clear();
+    captures.reserve(_records.size());
+
+    for (const auto &slot : _slots) {
+        if (slot.record >= 0) {
+            captures.push_back(_records[size_t(slot.record)]);
+        }
+    }
+}
+
+void CaptureLog::clear()
+{
+    // The reserved room is kept for the next flight.
+    _records.clear();
+    _slots.clear();
+    _num_missing = 0;
+    _first_missing = 0;
+}
+
+} // namespace dronecore
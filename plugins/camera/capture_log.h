@@ -0,0 +1,66 @@
+#pragma once
+
+#include "camera.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dronecore {
+
+// Every capture of a flight, kept for geotagging. The records are appended in
+// the order they arrive, into room reserved up front, so that a survey does
+// not reallocate while capturing. Captures are told apart by their image
+// index, indices which are skipped are kept track of as missing until they
+// arrive after all.
+//
+// The camera counts the index from 0 again once armed, so the log needs to be
+// cleared before each flight.
+class CaptureLog
+{
+public:
+    explicit CaptureLog(size_t capacity = DEFAULT_CAPACITY);
+    ~CaptureLog();
+
+    // Returns false if the capture is already logged or its index is out of range.
+    bool add(const Camera::CaptureInfo &capture_info);
+
+    // Up to max_count missing indices, the lowest first, which have not been
+    // asked for MAX_REQUESTS times yet. They count as asked for once returned.
+    std::vector<int> next_missing_batch(size_t max_count);
+
+    // All captures, sorted by index.
+    void export_captures(std::vector<Camera::CaptureInfo> &captures) const;
+
+    size_t size() const { return _records.size(); }
+    size_t num_missing() const { return _num_missing; }
+
+    void clear();
+
+    static constexpr size_t DEFAULT_CAPACITY = 4096;
+    static constexpr unsigned MAX_REQUESTS = 3;
+    // An index this far beyond the highest one is taken as bogus rather than
+    // as that many missing captures.
+    static constexpr int MAX_GAP = 10000;
+
+    // Non-copyable
+    CaptureLog(const CaptureLog &) = delete;
+    const CaptureLog &operator=(const CaptureLog &) = delete;
+
+private:
+    const size_t _capacity;
+
+    std::vector<Camera::CaptureInfo> _records {};
+
+    struct Slot {
+        // Into _records, -1 while missing.
+        int32_t record = -1;
+        uint8_t requests = 0;
+    };
+    // By image index, up to the highest one logged.
+    std::vector<Slot> _slots {};
+    size_t _num_missing = 0;
+    // No index below this one is missing, so that the search starts there.
+    size_t _first_missing = 0;
+};
+
+} // namespace dronecore
@@ -0,0 +1,84 @@
+#include "capture_log.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace dronecore;
+
+static Camera::CaptureInfo make_capture(int index)
+{
+    Camera::CaptureInfo capture_info {};
+    capture_info.index = index;
+    capture_info.time_utc_us = 1000000ull * uint64_t(index);
+    capture_info.success = true;
+    capture_info.file_url = "http://camera/" + std::to_string(index) + ".jpg";
+    return capture_info;
+}
+
+TEST(CaptureLog, ExportsSortedByIndex)
+{
+    CaptureLog log;
+    EXPECT_TRUE(log.add(make_capture(0)));
+    EXPECT_TRUE(log.add(make_capture(2)));
+    EXPECT_TRUE(log.add(make_capture(1)));
+    EXPECT_FALSE(log.add(make_capture(1)));
+
+    EXPECT_EQ(log.size(), 3u);
+    EXPECT_EQ(log.num_missing(), 0u);
+
+    std::vector<Camera::CaptureInfo> captures;
+    log.export_captures(captures);
+    ASSERT_EQ(captures.size(), 3u);
+    for (size_t i = 0; i < captures.size(); ++i) {
+        EXPECT_EQ(captures[i].index, int(i));
+        EXPECT_EQ(captures[i].file_url, make_capture(int(i)).file_url);
+    }
+}
+
+TEST(CaptureLog, DetectsGaps)
+{
+    CaptureLog log;
+    EXPECT_TRUE(log.add(make_capture(0)));
+    EXPECT_TRUE(log.add(make_capture(3)));
+    EXPECT_TRUE(log.add(make_capture(6)));
+    EXPECT_EQ(log.num_missing(), 4u);
+
+    EXPECT_EQ(log.next_missing_batch(3), std::vector<int>({1, 2, 4}));
+    EXPECT_EQ(log.next_missing_batch(10), std::vector<int>({1, 2, 4, 5}));
+
+    EXPECT_TRUE(log.add(make_capture(2)));
+    EXPECT_TRUE(log.add(make_capture(4)));
+    EXPECT_EQ(log.num_missing(), 2u);
+}
+
+TEST(CaptureLog, GivesUpAfterMaxRequests)
+{
+    CaptureLog log;
+    EXPECT_TRUE(log.add(make_capture(0)));
+    EXPECT_TRUE(log.add(make_capture(2)));
+
+    for (unsigned i = 0; i < CaptureLog::MAX_REQUESTS; ++i) {
+        EXPECT_EQ(log.next_missing_batch(10), std::vector<int>({1}));
+    }
+    EXPECT_TRUE(log.next_missing_batch(10).empty());
+    EXPECT_EQ(log.num_missing(), 1u);
+}
+
+TEST(CaptureLog, RejectsBogusIndices)
+{
+    CaptureLog log;
+    EXPECT_FALSE(log.add(make_capture(-1)));
+    EXPECT_FALSE(log.add(make_capture(CaptureLog::MAX_GAP)));
+    EXPECT_EQ(log.size(), 0u);
+    EXPECT_EQ(log.num_missing(), 0u);
+}
+
+TEST(CaptureLog, Clears)
+{
+    CaptureLog log;
+    EXPECT_TRUE(log.add(make_capture(5)));
+    log.clear();
+    EXPECT_EQ(log.size(), 0u);
+    EXPECT_EQ(log.num_missing(), 0u);
+    EXPECT_TRUE(log.add(make_capture(0)));
+    EXPECT_TRUE(log.next_missing_batch(10).empty());
+}
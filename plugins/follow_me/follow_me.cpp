@@ -23,6 +23,11 @@ FollowMe::Result FollowMe::set_config(const FollowMe::Config &config)
     return _impl->set_config(config);
 }
 
+void FollowMe::set_config_async(const FollowMe::Config &config, result_callback_t callback)
+{
+    _impl->set_config_async(config, callback);
+}
+
 bool FollowMe::is_active() const
 {
     return _impl->is_active();
@@ -113,6 +113,24 @@ public:
      */
     Result set_config(const Config &config);
 
+    /**
+     * @brief Callback type for asynchronous FollowMe calls.
+     */
+    typedef std::function<void(Result)> result_callback_t;
+
+    /**
+     * @brief Applies FollowMe configuration by sending it to system (asynchronous).
+     *
+     * All changed parameters are sent at once, the callback is called when
+     * the system has answered all of them.
+     *
+     * @param[in] config FollowMe configuration to be applied.
+     * @param callback Function to call with result of request,
+     *        FollowMe::Result::BUSY if a previous configuration is still being applied.
+     * @sa set_config()
+     */
+    void set_config_async(const Config &config, result_callback_t callback);
+
     /**
      * @brief Checks whether FollowMe is active.
      * @return `true` if FollowMe is active, `false` otherwise.
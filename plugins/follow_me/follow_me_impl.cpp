@@ -1,5 +1,6 @@
 #include "follow_me_impl.h"
 #include "system.h"
+#include "completion.h"
 #include "global_include.h"
 #include "px4_custom_mode.h"
 
@@ -7,6 +8,8 @@ namespace dronecore {
 
 using namespace std::placeholders; // for `_1`
 
+constexpr double FollowMeImpl::CONFIG_TIMEOUT_S;
+
 FollowMeImpl::FollowMeImpl(System &system) :
     PluginImplBase(system)
 {
@@ -24,8 +27,7 @@ FollowMeImpl::~FollowMeImpl()
 
 void FollowMeImpl::init()
 {
-    _parent->register_mavlink_message_handler(
-        MAVLINK_MSG_ID_HEARTBEAT,
+    _parent->register_mavlink_message_handler<mavlink_heartbeat_t>(
         std::bind(&FollowMeImpl::process_heartbeat, this, _1), static_cast<void *>(this));
     set_default_config();
 }
@@ -48,11 +50,30 @@ const FollowMe::Config &FollowMeImpl::get_config() const
 }
 
 FollowMe::Result FollowMeImpl::set_config(const FollowMe::Config &config)
+{
+    Completion<FollowMe::Result> completion;
+
+    set_config_async(config, [&completion](FollowMe::Result result) {
+        completion.complete(result);
+    });
+
+    FollowMe::Result result = FollowMe::Result::TIMEOUT;
+    if (!completion.wait_for(CONFIG_TIMEOUT_S, result)) {
+        // The parameters time out on their own, which is only waited for
+        // when leaving.
+        LogErr() << debug_str << "Timeout waiting for the new configuration";
+    }
+    return result;
+}
+
+void FollowMeImpl::set_config_async(const FollowMe::Config &config,
+                                    const FollowMe::result_callback_t &callback)
 {
     // Valdidate configuration
     if (!is_config_ok(config)) {
         LogErr() << debug_str << "set_config() failed. Last configuration is preserved.";
-        return FollowMe::Result::SET_CONFIG_FAILED;
+        report_config_result(callback, FollowMe::Result::SET_CONFIG_FAILED);
+        return;
     }
 
     auto height = config.min_height_m;
@@ -60,79 +81,86 @@ FollowMe::Result FollowMeImpl::set_config(const FollowMe::Config &config)
     int32_t direction = static_cast<int32_t>(config.follow_direction);
     auto responsiveness = config.responsiveness;
 
-    _config_change_requested = 0;
-
-    // Send configuration to Vehicle
+    config_val_t change_requested = 0;
     if (_config.min_height_m != height) {
+        change_requested |= ConfigParameter::MIN_HEIGHT;
+    }
+    if (_config.follow_distance_m != distance) {
+        change_requested |= ConfigParameter::DISTANCE;
+    }
+    if (_config.follow_direction != config.follow_direction) {
+        change_requested |= ConfigParameter::FOLLOW_DIRECTION;
+    }
+    if (_config.responsiveness != responsiveness) {
+        change_requested |= ConfigParameter::RESPONSIVENESS;
+    }
+
+    if (change_requested == 0) {
+        LogDebug() << debug_str <<  "Requested configuration is NO different from existing one!";
+        report_config_result(callback, FollowMe::Result::SUCCESS);
+        return;
+    }
+
+    // The requests are noted before sending, so that a fast answer finds them,
+    // and the callback is only called once all of them are answered.
+    {
+        std::lock_guard<std::mutex> lock(_config_mutex);
+        if (_config_change_requested != 0) {
+            LogWarn() << debug_str << "set_config() is still waiting for the last configuration";
+            report_config_result(callback, FollowMe::Result::BUSY);
+            return;
+        }
+        _config_change_requested = change_requested;
+        _requested_config = config;
+        _config_callback = callback;
+    }
+
+    // Send configuration to Vehicle, all parameters at once without waiting
+    // for the answers in between.
+    if ((change_requested & ConfigParameter::MIN_HEIGHT) != 0) {
         _parent->set_param_float_async("NAV_MIN_FT_HT", height,
                                        std::bind(&FollowMeImpl::receive_param_min_height,
                                                  this, _1, height));
-        _config_change_requested |= ConfigParameter::MIN_HEIGHT;
     }
-    if (_config.follow_distance_m != distance) {
+    if ((change_requested & ConfigParameter::DISTANCE) != 0) {
         _parent->set_param_float_async("NAV_FT_DST", distance,
                                        std::bind(&FollowMeImpl::receive_param_follow_distance,
                                                  this, _1, distance));
-        _config_change_requested |= ConfigParameter::DISTANCE;
     }
-    if (_config.follow_direction != config.follow_direction) {
+    if ((change_requested & ConfigParameter::FOLLOW_DIRECTION) != 0) {
         _parent->set_param_int_async("NAV_FT_FS", direction,
                                      std::bind(&FollowMeImpl::receive_param_follow_direction,
                                                this, _1, direction));
-        _config_change_requested |= ConfigParameter::FOLLOW_DIRECTION;
     }
-    if (_config.responsiveness != responsiveness) {
+    if ((change_requested & ConfigParameter::RESPONSIVENESS) != 0) {
         _parent->set_param_float_async("NAV_FT_RS", responsiveness,
                                        std::bind(&FollowMeImpl::receive_param_responsiveness,
                                                  this, _1, responsiveness));
-        _config_change_requested |= ConfigParameter::RESPONSIVENESS;
     }
-
-    if (_config_change_requested == 0) {
-        LogDebug() << debug_str <<  "Requested configuration is NO different from existing one!";
-    } else {
-        using namespace std::this_thread; // for sleep_for()
-        using namespace std::chrono; // for milliseconds()
-        // Lets wait for confirmation from Vehicle about configuration change.
-        while (_config_change_requested) {
-            LogDebug() << debug_str <<  "Waiting for the system confirmation of the new configuration..";
-            sleep_for(milliseconds(10));
-        }
-        LogInfo() << debug_str <<  "Configured: " << ANSI_COLOR_BLUE << "Min height: " <<
-                  _config.min_height_m <<
-                  " meters, Follow distance: " <<
-                  _config.follow_distance_m << " meters, Follow direction: " <<
-                  FollowMe::Config::to_str(_config.follow_direction) << ", Responsiveness: " <<
-                  _config.responsiveness << ANSI_COLOR_RESET;
-    }
-
-    return FollowMe::Result::SUCCESS;
 }
 
 void FollowMeImpl::set_target_location(const FollowMe::TargetLocation &location)
 {
     _mutex.lock();
     _target_location = location;
-    // We're interested only in lat, long.
+    _predictor.add_fix(location, _time.elapsed_s());
+    // The velocity is estimated if not given.
     _estimatation_capabilities |= (1 << static_cast<int>(EstimationCapabilites::POS));
+    _estimatation_capabilities |= (1 << static_cast<int>(EstimationCapabilites::VEL));
 
     if (_mode != Mode::ACTIVE) {
         _mutex.unlock();
         return;
     }
-    // If set already, reschedule it.
-    if (_target_location_cookie) {
-        _parent->reset_call_every(_target_location_cookie);
-        _target_location_cookie = nullptr;
-    } else {
-        // Regiter now for sending in the next cycle.
+    if (!_target_location_cookie) {
+        // Regiter now for checking in the next cycle.
         _parent->add_call_every([this]() { send_target_location(); },
-        SENDER_RATE,
+        CHECK_INTERVAL_S,
         &_target_location_cookie);
     }
     _mutex.unlock();
 
-    // Send it immediately for now.
+    // The new location may be due right away.
     send_target_location();
 }
 
@@ -158,9 +186,9 @@ FollowMe::Result FollowMeImpl::start()
         // If location was set before, lets send it to vehicle
         std::lock_guard<std::mutex> lock(
             _mutex); // locking is not necessary here but lets do it for integrity
-        if (is_target_location_set()) {
+        if (is_target_location_set() && !_target_location_cookie) {
             _parent->add_call_every([this]() { send_target_location(); },
-            SENDER_RATE,
+            CHECK_INTERVAL_S,
             &_target_location_cookie);
         }
     }
@@ -231,20 +259,20 @@ void FollowMeImpl::receive_param_min_height(bool success, float min_height_m)
 {
     if (success) {
         _config.min_height_m = min_height_m;
-        _config_change_requested &= ~(ConfigParameter::MIN_HEIGHT);
     } else {
         LogErr() << debug_str <<  "Failed to set NAV_MIN_FT_HT: " << min_height_m << "m";
     }
+    config_change_answered(ConfigParameter::MIN_HEIGHT);
 }
 
 void FollowMeImpl::receive_param_follow_distance(bool success, float follow_distance_m)
 {
     if (success) {
         _config.follow_distance_m = follow_distance_m;
-        _config_change_requested &= ~(ConfigParameter::DISTANCE);
     } else {
         LogErr() << debug_str <<  "Failed to set NAV_FT_DST: " << follow_distance_m << "m";
     }
+    config_change_answered(ConfigParameter::DISTANCE);
 }
 
 void FollowMeImpl::receive_param_follow_direction(bool success, int32_t direction)
@@ -260,21 +288,63 @@ void FollowMeImpl::receive_param_follow_direction(bool success, int32_t directio
     if (success) {
         if (new_direction != FollowMe::Config::FollowDirection::NONE) {
             _config.follow_direction = new_direction;
-            _config_change_requested &= ~(ConfigParameter::FOLLOW_DIRECTION);
         }
     } else {
         LogErr() << debug_str <<  "Failed to set NAV_FT_FS: " <<  FollowMe::Config::to_str(new_direction);
     }
+    config_change_answered(ConfigParameter::FOLLOW_DIRECTION);
 }
 
 void FollowMeImpl::receive_param_responsiveness(bool success, float responsiveness)
 {
     if (success) {
         _config.responsiveness = responsiveness;
-        _config_change_requested &= ~(ConfigParameter::RESPONSIVENESS);
     } else {
         LogErr() << debug_str <<  "Failed to set NAV_FT_RS: " << responsiveness;
     }
+    config_change_answered(ConfigParameter::RESPONSIVENESS);
+}
+
+void FollowMeImpl::config_change_answered(ConfigParameter parameter)
+{
+    FollowMe::result_callback_t callback = nullptr;
+    FollowMe::Config requested_config {};
+    {
+        std::lock_guard<std::mutex> lock(_config_mutex);
+        _config_change_requested &= ~parameter;
+        if (_config_change_requested != 0) {
+            return;
+        }
+        std::swap(callback, _config_callback);
+        requested_config = _requested_config;
+    }
+
+    // Failed parameters are answered too, but leave the configuration as it was.
+    if (_config.min_height_m != requested_config.min_height_m ||
+        _config.follow_distance_m != requested_config.follow_distance_m ||
+        _config.follow_direction != requested_config.follow_direction ||
+        _config.responsiveness != requested_config.responsiveness) {
+        LogErr() << debug_str << "set_config() failed. Configuration is only partly applied.";
+        report_config_result(callback, FollowMe::Result::SET_CONFIG_FAILED);
+        return;
+    }
+
+    LogInfo() << debug_str <<  "Configured: " << ANSI_COLOR_BLUE << "Min height: " <<
+              _config.min_height_m <<
+              " meters, Follow distance: " <<
+              _config.follow_distance_m << " meters, Follow direction: " <<
+              FollowMe::Config::to_str(_config.follow_direction) << ", Responsiveness: " <<
+              _config.responsiveness << ANSI_COLOR_RESET;
+
+    report_config_result(callback, FollowMe::Result::SUCCESS);
+}
+
+void FollowMeImpl::report_config_result(const FollowMe::result_callback_t &callback,
+                                        FollowMe::Result result)
+{
+    if (callback) {
+        callback(result);
+    }
 }
 
 FollowMe::Result
@@ -312,20 +382,28 @@ void FollowMeImpl::send_target_location()
         return;
     }
 
-    dl_time_t now = _time.steady_time();
+    const double now_s = _time.elapsed_s();
     // needed by http://mavlink.org/messages/common#FOLLOW_TARGET
-    uint64_t elapsed_msec = static_cast<uint64_t>(_time.elapsed_since_s(now) * 1000); // milliseconds
+    uint64_t elapsed_msec = static_cast<uint64_t>(now_s * 1000); // milliseconds
 
+    // Only once the vehicle would be off by too much otherwise, and then
+    // where the target is by now rather than where it was last seen.
     _mutex.lock();
-//   LogDebug() << debug_str <<  "Lat: " << _target_location.latitude_deg << " Lon: " << _target_location.longitude_deg <<
-//	" Alt: " << _target_location.absolute_altitude_m;
-    const int32_t lat_int = static_cast<int32_t>(_target_location.latitude_deg * 1e7);
-    const int32_t lon_int = static_cast<int32_t>(_target_location.longitude_deg * 1e7);
-    const float alt = static_cast<float>(_target_location.absolute_altitude_m);
+    if (!_predictor.should_send(now_s)) {
+        _mutex.unlock();
+        return;
+    }
+    const FollowMe::TargetLocation location = _predictor.take_for_sending(now_s);
     _mutex.unlock();
 
+    const int32_t lat_int = static_cast<int32_t>(location.latitude_deg * 1e7);
+    const int32_t lon_int = static_cast<int32_t>(location.longitude_deg * 1e7);
+    const float alt = static_cast<float>(location.absolute_altitude_m);
+
     const float pos_std_dev[] = { NAN, NAN, NAN };
-    const float vel[] = { NAN, NAN, NAN };
+    const float vel[] = {
+        location.velocity_x_m_s, location.velocity_y_m_s, location.velocity_z_m_s
+    };
     const float accel_unknown[] = { NAN, NAN, NAN };
     const float attitude_q_unknown[] = { 1.f, NAN, NAN, NAN };
     const float rates_unknown[] = { NAN, NAN, NAN };
@@ -351,7 +429,7 @@ void FollowMeImpl::send_target_location()
         LogErr() << debug_str <<  "send_target_location() failed..";
     } else {
         std::lock_guard<std::mutex> lock(_mutex);
-        _last_location = _target_location;
+        _last_location = location;
     }
 }
 
@@ -362,14 +440,13 @@ void FollowMeImpl::stop_sending_target_location()
         _parent->remove_call_every(_target_location_cookie);
         _target_location_cookie = nullptr;
     }
+    // The next time, the vehicle needs to be told right away.
+    _predictor.forget_sent();
     _mode = Mode::NOT_ACTIVE;
 }
 
-void FollowMeImpl::process_heartbeat(const mavlink_message_t &message)
+void FollowMeImpl::process_heartbeat(const mavlink_heartbeat_t &heartbeat)
 {
-    mavlink_heartbeat_t heartbeat;
-    mavlink_msg_heartbeat_decode(&message, &heartbeat);
-
     bool follow_me_active = false; // tells whether we're in FollowMe mode right now
     if (heartbeat.base_mode & MAV_MODE_FLAG_CUSTOM_MODE_ENABLED) {
 
@@ -391,8 +468,6 @@ void FollowMeImpl::process_heartbeat(const mavlink_message_t &message)
         } else if (follow_me_active && _mode == Mode::NOT_ACTIVE) {
             // We're in FollowMe mode now
             _mode = Mode::ACTIVE;
-            _mutex.unlock(); // we must unlock to avoid deadlock in send_target_location()
-            return;
         }
     }
 }
@@ -8,6 +8,7 @@
 #include "timeout_handler.h"
 #include "global_include.h"
 #include "log.h"
+#include "target_predictor.h"
 
 namespace dronecore {
 
@@ -25,6 +26,8 @@ public:
 
     const FollowMe::Config &get_config() const;
     FollowMe::Result set_config(const FollowMe::Config &config);
+    void set_config_async(const FollowMe::Config &config,
+                          const FollowMe::result_callback_t &callback);
 
     void set_target_location(const FollowMe::TargetLocation &location);
     const FollowMe::TargetLocation &get_last_location() const;
@@ -36,7 +39,7 @@ public:
 
 private:
     typedef unsigned int config_val_t;
-    void process_heartbeat(const mavlink_message_t &message);
+    void process_heartbeat(const mavlink_heartbeat_t &heartbeat);
 
     enum class ConfigParameter;
     // Config methods
@@ -46,6 +49,9 @@ private:
     void receive_param_follow_distance(bool success, float distance);
     void receive_param_follow_direction(bool success, int32_t direction);
     void receive_param_responsiveness(bool success, float rsp);
+    void config_change_answered(ConfigParameter parameter);
+    static void report_config_result(const FollowMe::result_callback_t &callback,
+                                     FollowMe::Result result);
     FollowMe::Result to_follow_me_result(MAVLinkCommands::Result result) const;
 
     bool is_target_location_set() const;
@@ -78,6 +84,10 @@ private:
     {
         return (config_val) | static_cast<config_val_t>(cfgp);
     }
+    friend config_val_t operator &(config_val_t config_val, ConfigParameter cfgp)
+    {
+        return (config_val) & static_cast<config_val_t>(cfgp);
+    }
     friend config_val_t operator |=(config_val_t &config_val, ConfigParameter cfgp)
     {
         return config_val = config_val | static_cast<config_val_t>(cfgp);
@@ -92,16 +102,24 @@ private:
     }
 
     mutable std::mutex _mutex {};
-    FollowMe::TargetLocation _target_location; // sent to vehicle
+    FollowMe::TargetLocation _target_location; // as set by the app
     FollowMe::TargetLocation _last_location; // sent to vehicle
+    TargetPredictor _predictor {};
     void *_target_location_cookie = nullptr;
 
     Time _time {};
     uint8_t _estimatation_capabilities = 0; // sent to vehicle
     FollowMe::Config _config {}; // has FollowMe configuration settings
+    // Parameters of set_config() which have not been answered yet.
+    std::mutex _config_mutex {};
     config_val_t _config_change_requested = 0;
+    FollowMe::Config _requested_config {};
+    FollowMe::result_callback_t _config_callback = nullptr;
+    static constexpr double CONFIG_TIMEOUT_S = 5.0;
 
-    const float SENDER_RATE = 1.0f; // send location updates once in a second
+    // How often to check whether a location is due, the predictor decides
+    // how often one is sent.
+    const float CHECK_INTERVAL_S = 0.05f;
 
     std::string debug_str = "FollowMe: ";
 };
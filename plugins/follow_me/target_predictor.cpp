@@ -0,0 +1,199 @@
+#include "target_predictor.h"
+#include "global_include.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace dronecore {
+
+constexpr double TargetPredictor::MAX_ERROR_M;
+constexpr double TargetPredictor::MIN_INTERVAL_S;
+constexpr double TargetPredictor::MAX_INTERVAL_S;
+constexpr unsigned TargetPredictor::NUM_AXES;
+constexpr double TargetPredictor::POSITION_VARIANCE;
+constexpr double TargetPredictor::VELOCITY_VARIANCE;
+constexpr double TargetPredictor::INITIAL_VELOCITY_VARIANCE;
+constexpr double TargetPredictor::ACCELERATION_NOISE;
+
+TargetPredictor::TargetPredictor() {}
+
+TargetPredictor::~TargetPredictor() {}
+
+void TargetPredictor::reset()
+{
+    _has_fix = false;
+    _has_sent = false;
+}
+
+void TargetPredictor::add_fix(const FollowMe::TargetLocation &location, double time_s)
+{
+    if (!std::isfinite(location.latitude_deg) || !std::isfinite(location.longitude_deg)) {
+        return;
+    }
+
+    const float velocities[NUM_AXES] = {
+        location.velocity_x_m_s, location.velocity_y_m_s, location.velocity_z_m_s
+    };
+
+    if (!_has_fix) {
+        _projection = LocalProjection(location.latitude_deg, location.longitude_deg);
+        _reference_altitude_m = std::isfinite(location.absolute_altitude_m) ?
+                                location.absolute_altitude_m : 0.0;
+
+        for (unsigned i = 0; i < NUM_AXES; ++i) {
+            const bool has_velocity = std::isfinite(velocities[i]);
+            _axes[i] = Axis {
+                0.0,
+                has_velocity ? double(velocities[i]) : 0.0,
+                POSITION_VARIANCE,
+                0.0,
+                has_velocity ? VELOCITY_VARIANCE : INITIAL_VELOCITY_VARIANCE
+            };
+        }
+        _fix_time_s = time_s;
+        _has_fix = true;
+        return;
+    }
+
+    // A fix out of order is taken as one at the time of the last.
+    const double dt_s = std::max(time_s - _fix_time_s, 0.0);
+    _fix_time_s = std::max(time_s, _fix_time_s);
+
+    double local[NUM_AXES];
+    to_local(location, local);
+
+    for (unsigned i = 0; i < NUM_AXES; ++i) {
+        predict_axis(_axes[i], dt_s);
+        if (std::isfinite(local[i])) {
+            measure_position(_axes[i], local[i], POSITION_VARIANCE);
+        }
+        if (std::isfinite(velocities[i])) {
+            measure_velocity(_axes[i], double(velocities[i]), VELOCITY_VARIANCE);
+        }
+    }
+}
+
+FollowMe::TargetLocation TargetPredictor::predict(double time_s) const
+{
+    double position[NUM_AXES];
+    double velocity[NUM_AXES];
+    predict_local(time_s, position, velocity);
+    return to_location(position, velocity);
+}
+
+double TargetPredictor::predicted_error_m(double time_s) const
+{
+    if (!_has_sent) {
+        return std::numeric_limits<double>::infinity();
+    }
+
+    double position[NUM_AXES];
+    double velocity[NUM_AXES];
+    predict_local(time_s, position, velocity);
+
+    const double since_sent_s = time_s - _sent_time_s;
+    double sum_squares = 0.0;
+    for (unsigned i = 0; i < NUM_AXES; ++i) {
+        const double assumed = _sent_position[i] + _sent_velocity[i] * since_sent_s;
+        sum_squares += (position[i] - assumed) * (position[i] - assumed);
+    }
+    return std::sqrt(sum_squares);
+}
+
+bool TargetPredictor::should_send(double time_s) const
+{
+    if (!_has_fix) {
+        return false;
+    }
+    if (!_has_sent) {
+        return true;
+    }
+
+    const double since_sent_s = time_s - _sent_time_s;
+    if (since_sent_s < MIN_INTERVAL_S) {
+        return false;
+    }
+    if (since_sent_s >= MAX_INTERVAL_S) {
+        return true;
+    }
+    return predicted_error_m(time_s) > MAX_ERROR_M;
+}
+
+FollowMe::TargetLocation TargetPredictor::take_for_sending(double time_s)
+{
+    predict_local(time_s, _sent_position, _sent_velocity);
+    _sent_time_s = time_s;
+    _has_sent = true;
+    return to_location(_sent_position, _sent_velocity);
+}
+
+void TargetPredictor::predict_axis(Axis &axis, double dt_s)
+{
+    const double q = ACCELERATION_NOISE;
+    axis.position += axis.velocity * dt_s;
+    axis.p00 += dt_s * (2.0 * axis.p01 + dt_s * axis.p11) + q * dt_s * dt_s * dt_s / 3.0;
+    axis.p01 += dt_s * axis.p11 + q * dt_s * dt_s / 2.0;
+    axis.p11 += q * dt_s;
+}
+
+void TargetPredictor::measure_position(Axis &axis, double position, double variance)
+{
+    const double s = axis.p00 + variance;
+    const double k0 = axis.p00 / s;
+    const double k1 = axis.p01 / s;
+    const double innovation = position - axis.position;
+
+    axis.position += k0 * innovation;
+    axis.velocity += k1 * innovation;
+    axis.p11 -= k1 * axis.p01;
+    axis.p01 *= (1.0 - k0);
+    axis.p00 *= (1.0 - k0);
+}
+
+void TargetPredictor::measure_velocity(Axis &axis, double velocity, double variance)
+{
+    const double s = axis.p11 + variance;
+    const double k0 = axis.p01 / s;
+    const double k1 = axis.p11 / s;
+    const double innovation = velocity - axis.velocity;
+
+    axis.position += k0 * innovation;
+    axis.velocity += k1 * innovation;
+    axis.p00 -= k0 * axis.p01;
+    axis.p01 *= (1.0 - k1);
+    axis.p11 *= (1.0 - k1);
+}
+
+void TargetPredictor::to_local(const FollowMe::TargetLocation &location,
+                               double local[NUM_AXES]) const
+{
+    local[0] = _projection.north_m(location.latitude_deg);
+    local[1] = _projection.east_m(location.longitude_deg);
+    // Down, a missing altitude stays missing.
+    local[2] = _reference_altitude_m - location.absolute_altitude_m;
+}
+
+FollowMe::TargetLocation TargetPredictor::to_location(const double position[NUM_AXES],
+                                                      const double velocity[NUM_AXES]) const
+{
+    FollowMe::TargetLocation location;
+    location.latitude_deg = _projection.latitude_deg(position[0]);
+    location.longitude_deg = _projection.longitude_deg(position[1]);
+    location.absolute_altitude_m = _reference_altitude_m - position[2];
+    location.velocity_x_m_s = float(velocity[0]);
+    location.velocity_y_m_s = float(velocity[1]);
+    location.velocity_z_m_s = float(velocity[2]);
+    return location;
+}
+
+void TargetPredictor::predict_local(double time_s, double position[NUM_AXES],
+                                    double velocity[NUM_AXES]) const
+{
+    const double dt_s = std::max(time_s - _fix_time_s, 0.0);
+    for (unsigned i = 0; i < NUM_AXES; ++i) {
+        position[i] = _axes[i].position + _axes[i].velocity * dt_s;
+        velocity[i] = _axes[i].velocity;
+    }
+}
+
+} // namespace dronecore
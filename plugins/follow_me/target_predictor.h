@@ -0,0 +1,92 @@
+#pragma once
+
+#include "follow_me.h"
+#include "local_projection.h"
+
+namespace dronecore {
+
+// Estimates where the target is and decides when the vehicle needs to hear
+// about it. Every axis has a Kalman filter with a constant velocity model,
+// so that the target can be carried on to the time a location is sent, and
+// its velocity is known even if the app only gives positions.
+//
+// The vehicle is taken to carry the last location sent on at the velocity
+// sent along with it. A new location is only due once that is off from the
+// estimate by more than MAX_ERROR_M, or once the last one is MAX_INTERVAL_S
+// old. A target standing still is then sent once a second, one which
+// speeds up or turns as often as every MIN_INTERVAL_S.
+//
+// Positions are converted to metres north, east and down of the first fix,
+// which is accurate enough for follow me distances.
+class TargetPredictor
+{
+public:
+    TargetPredictor();
+    ~TargetPredictor();
+
+    void reset();
+
+    // Velocities which are NAN are left out, they are estimated from the
+    // positions then.
+    void add_fix(const FollowMe::TargetLocation &location, double time_s);
+    bool has_fix() const { return _has_fix; }
+
+    // The estimate carried on to time_s.
+    FollowMe::TargetLocation predict(double time_s) const;
+
+    // How far off the location which the vehicle assumes is at time_s.
+    double predicted_error_m(double time_s) const;
+
+    bool should_send(double time_s) const;
+    // Returns the estimate at time_s and notes it as sent.
+    FollowMe::TargetLocation take_for_sending(double time_s);
+    // The next location is then due right away.
+    void forget_sent() { _has_sent = false; }
+
+    static constexpr double MAX_ERROR_M = 0.5;
+    static constexpr double MIN_INTERVAL_S = 0.1;
+    static constexpr double MAX_INTERVAL_S = 1.0;
+
+private:
+    static constexpr unsigned NUM_AXES = 3;
+    // Of the fixes, as from a phone GPS, in m^2 and (m/s)^2.
+    static constexpr double POSITION_VARIANCE = 1.0;
+    static constexpr double VELOCITY_VARIANCE = 0.25;
+    // Until a velocity is known.
+    static constexpr double INITIAL_VELOCITY_VARIANCE = 25.0;
+    // How much the target changes its velocity, as acceleration noise in m^2/s^3.
+    static constexpr double ACCELERATION_NOISE = 1.0;
+
+    struct Axis {
+        double position;
+        double velocity;
+        // Covariance of position and velocity.
+        double p00;
+        double p01;
+        double p11;
+    };
+
+    static void predict_axis(Axis &axis, double dt_s);
+    static void measure_position(Axis &axis, double position, double variance);
+    static void measure_velocity(Axis &axis, double velocity, double variance);
+
+    void to_local(const FollowMe::TargetLocation &location, double local[NUM_AXES]) const;
+    FollowMe::TargetLocation to_location(const double position[NUM_AXES],
+                                         const double velocity[NUM_AXES]) const;
+    void predict_local(double time_s, double position[NUM_AXES],
+                       double velocity[NUM_AXES]) const;
+
+    bool _has_fix = false;
+    double _fix_time_s = 0.0;
+    LocalProjection _projection {};
+    double _reference_altitude_m = 0.0;
+    Axis _axes[NUM_AXES] {};
+
+    // What the vehicle was told last.
+    bool _has_sent = false;
+    double _sent_time_s = 0.0;
+    double _sent_position[NUM_AXES] {};
+    double _sent_velocity[NUM_AXES] {};
+};
+
+} // namespace dronecore
@@ -0,0 +1,109 @@
+#include "target_predictor.h"
+#include <gtest/gtest.h>
+#include <cmath>
+
+using namespace dronecore;
+
+namespace {
+
+const double LATITUDE_DEG = 47.39;
+const double LONGITUDE_DEG = 8.54;
+// Metres per degree of latitude.
+const double M_PER_DEG = 6371000.0 * M_PI / 180.0;
+
+FollowMe::TargetLocation make_location(double north_m, double east_m,
+                                       float velocity_x_m_s = NAN, float velocity_y_m_s = NAN)
+{
+    return FollowMe::TargetLocation {
+        LATITUDE_DEG + north_m / M_PER_DEG,
+        LONGITUDE_DEG + east_m / (M_PER_DEG * std::cos(LATITUDE_DEG * M_PI / 180.0)),
+        500.0,
+        velocity_x_m_s, velocity_y_m_s, NAN
+    };
+}
+
+double north_m_of(const FollowMe::TargetLocation &location)
+{
+    return (location.latitude_deg - LATITUDE_DEG) * M_PER_DEG;
+}
+
+// Fixes come at 10 Hz, the predictor is asked at 50 Hz.
+template<typename F>
+unsigned count_sends(TargetPredictor &predictor, double duration_s, F location_at)
+{
+    unsigned num_sends = 0;
+    for (unsigned i = 0; i < unsigned(duration_s * 50); ++i) {
+        const double time_s = i / 50.0;
+        if (i % 5 == 0) {
+            predictor.add_fix(location_at(time_s), time_s);
+        }
+        if (predictor.should_send(time_s)) {
+            predictor.take_for_sending(time_s);
+            ++num_sends;
+        }
+    }
+    return num_sends;
+}
+
+} // namespace
+
+TEST(TargetPredictor, SendsNothingWithoutFix)
+{
+    TargetPredictor predictor;
+    EXPECT_FALSE(predictor.has_fix());
+    EXPECT_FALSE(predictor.should_send(0.0));
+
+    predictor.add_fix(make_location(0.0, 0.0), 0.0);
+    EXPECT_TRUE(predictor.has_fix());
+    EXPECT_TRUE(predictor.should_send(0.0));
+
+    predictor.reset();
+    EXPECT_FALSE(predictor.should_send(1.0));
+}
+
+TEST(TargetPredictor, SendsRarelyWhileStandingStill)
+{
+    TargetPredictor predictor;
+    const unsigned num_sends = count_sends(predictor, 10.0, [](double) {
+        return make_location(0.0, 0.0);
+    });
+    // Once a second, instead of with every fix.
+    EXPECT_GE(num_sends, 10u);
+    EXPECT_LE(num_sends, 11u);
+}
+
+TEST(TargetPredictor, ExtrapolatesMovingTarget)
+{
+    TargetPredictor predictor;
+    // 10 m/s north, only positions given.
+    count_sends(predictor, 10.0, [](double time_s) {
+        return make_location(10.0 * time_s, 0.0);
+    });
+
+    const FollowMe::TargetLocation location = predictor.predict(10.5);
+    EXPECT_NEAR(north_m_of(location), 105.0, 0.5);
+    EXPECT_NEAR(location.velocity_x_m_s, 10.0f, 0.2f);
+    EXPECT_NEAR(location.velocity_y_m_s, 0.0f, 0.2f);
+    EXPECT_NEAR(location.absolute_altitude_m, 500.0, 0.1);
+}
+
+TEST(TargetPredictor, SendsMoreOftenWhileTurning)
+{
+    TargetPredictor straight;
+    const unsigned num_straight = count_sends(straight, 20.0, [](double time_s) {
+        return make_location(10.0 * time_s, 0.0, 10.0f, 0.0f);
+    });
+
+    // The same speed on a circle of 20 m radius.
+    TargetPredictor turning;
+    const unsigned num_turning = count_sends(turning, 20.0, [](double time_s) {
+        const double angle = 0.5 * time_s;
+        return make_location(20.0 * std::sin(angle), 20.0 * (1.0 - std::cos(angle)),
+                             float(10.0 * std::cos(angle)), float(10.0 * std::sin(angle)));
+    });
+
+    EXPECT_LE(num_straight, 25u);
+    EXPECT_GT(num_turning, 2 * num_straight);
+    // Still fewer than one per fix.
+    EXPECT_LT(num_turning, 200u);
+}
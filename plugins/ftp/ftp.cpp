@@ -0,0 +1,52 @@
+#include "ftp.h"
+#include "ftp_impl.h"
+
+namespace dronecore {
+
+Ftp::Ftp(System &system) :
+    PluginBase(),
+    _impl { new FtpImpl(system) }
+{
+}
+
+Ftp::~Ftp()
+{
+}
+
+void Ftp::download_async(const std::string &remote_path, const std::string &local_path,
+                         download_callback_t callback)
+{
+    _impl->download_async(remote_path, local_path, callback);
+}
+
+void Ftp::set_target_component_id(uint8_t component_id)
+{
+    _impl->set_target_component_id(component_id);
+}
+
+const char *Ftp::result_str(Result result)
+{
+    switch (result) {
+        case Result::SUCCESS:
+            return "Success";
+        case Result::IN_PROGRESS:
+            return "In progress";
+        case Result::BUSY:
+            return "Busy";
+        case Result::TIMEOUT:
+            return "Timeout";
+        case Result::FILE_NOT_FOUND:
+            return "File not found";
+        case Result::FILE_IO_ERROR:
+            return "File IO error";
+        case Result::PROTOCOL_ERROR:
+            return "Protocol error";
+        case Result::NO_SYSTEM:
+            return "No system";
+        case Result::UNKNOWN:
+        default:
+            return "Unknown";
+    }
+}
+
+} // namespace dronecore
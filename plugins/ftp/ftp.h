@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include "plugin_base.h"
+
+namespace dronecore {
+
+class FtpImpl;
+class System;
+
+/**
+ * @brief The Ftp class allows to download files from a component with MAVLink FTP,
+ * e.g. logs from the autopilot, over any link without needing a network.
+ */
+class Ftp : public PluginBase
+{
+public:
+    /**
+     * @brief Constructor. Creates the plugin for a specific System.
+     *
+     * The plugin is typically created as shown below:
+     *
+     *     ```cpp
+     *     auto ftp = std::make_shared<Ftp>(system);
+     *     ```
+     *
+     * @param system The specific system associated with this plugin.
+     */
+    explicit Ftp(System &system);
+
+    /**
+     * @brief Destructor (internal use only).
+     */
+    ~Ftp();
+
+    /**
+     * @brief Results for FTP requests.
+     */
+    enum class Result {
+        SUCCESS = 0, /**< @brief %Request succeeded. */
+        IN_PROGRESS, /**< @brief %Transfer is still going on. */
+        BUSY, /**< @brief Another transfer is still going on. */
+        TIMEOUT, /**< @brief Timeout. */
+        FILE_NOT_FOUND, /**< @brief %File does not exist on the component. */
+        FILE_IO_ERROR, /**< @brief Local file could not be written. */
+        PROTOCOL_ERROR, /**< @brief Component refused or answered unexpectedly. */
+        NO_SYSTEM, /**< @brief No system connected. */
+        UNKNOWN /**< @brief Unknown error. */
+    };
+
+    /**
+     * @brief Returns human-readable English string for Ftp::Result.
+     *
+     * @param result Enum for which string is required.
+     * @return result Human-readable string for Ftp::Result.
+     */
+    static const char *result_str(Result result);
+
+    /**
+     * @brief Progress of a transfer.
+     */
+    struct ProgressData {
+        uint32_t bytes_transferred; /**< @brief Bytes received so far. */
+        uint32_t total_bytes; /**< @brief Size of the file. */
+    };
+
+    /**
+     * @brief Callback type for downloads.
+     */
+    typedef std::function<void(Result, ProgressData)> download_callback_t;
+
+    /**
+     * @brief Download a file from the component (asynchronous).
+     *
+     * The file is read in bursts, which the component sends without waiting for each
+     * packet to be requested, and parts lost on the way are read again afterwards. Only
+     * one transfer runs at a time.
+     *
+     * The callback is called with IN_PROGRESS as the file comes in, and a last time with
+     * the result. A file which could not be downloaded completely is removed.
+     *
+     * @param remote_path Path of the file on the component.
+     * @param local_path Path to save the file to.
+     * @param callback Function to call with the progress and result.
+     */
+    void download_async(const std::string &remote_path, const std::string &local_path,
+                        download_callback_t callback);
+
+    /**
+     * @brief Set the component to transfer files from, the autopilot by default.
+     *
+     * @param component_id MAVLink component ID, e.g. of a camera.
+     */
+    void set_target_component_id(uint8_t component_id);
+
+    // Non-copyable
+    /**
+     * @brief Copy constructor (object is not copyable).
+     */
+    Ftp(const Ftp &) = delete;
+    /**
+    * @brief Equality operator (object is not copyable).
+    */
+    const Ftp &operator=(const Ftp &) = delete;
+
+private:
+    /** @private Underlying implementation, set at instantiation */
+    std::unique_ptr<FtpImpl> _impl;
+};
+
+} // namespace dronecore
@@ -0,0 +1,402 @@
+#include "global_include.h"
+#include "ftp_impl.h"
+#include "dronecore_impl.h"
+#include <algorithm>
+#include <cstring>
+
+namespace dronecore {
+
+constexpr unsigned FtpImpl::HeaderOffset::seq_number;
+constexpr unsigned FtpImpl::HeaderOffset::session;
+constexpr unsigned FtpImpl::HeaderOffset::opcode;
+constexpr unsigned FtpImpl::HeaderOffset::size;
+constexpr unsigned FtpImpl::HeaderOffset::req_opcode;
+constexpr unsigned FtpImpl::HeaderOffset::burst_complete;
+constexpr unsigned FtpImpl::HeaderOffset::offset;
+constexpr unsigned FtpImpl::HeaderOffset::data;
+constexpr uint8_t FtpImpl::DATA_MAX_LEN;
+constexpr double FtpImpl::TIMEOUT_S;
+constexpr unsigned FtpImpl::MAX_RETRIES;
+
+FtpImpl::FtpImpl(System &system) :
+    PluginImplBase(system)
+{
+    _parent->register_plugin(this);
+}
+
+FtpImpl::~FtpImpl()
+{
+    _parent->unregister_plugin(this);
+}
+
+void FtpImpl::init()
+{
+    using namespace std::placeholders; // for `_1`
+
+    // The data is written to the file straight out of the received frame.
+    _parent->register_mavlink_message_view_handler(
+        MAVLINK_MSG_ID_FILE_TRANSFER_PROTOCOL,
+        std::bind(&FtpImpl::process_file_transfer_protocol, this, _1), this);
+}
+
+void FtpImpl::deinit()
+{
+    _parent->unregister_all_mavlink_message_handlers(this);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_download.state != Download::State::NONE) {
+        finish(lock, Ftp::Result::UNKNOWN);
+    }
+}
+
+void FtpImpl::enable() {}
+
+void FtpImpl::disable() {}
+
+void FtpImpl::set_target_component_id(uint8_t component_id)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _target_component_id = component_id;
+}
+
+void FtpImpl::download_async(const std::string &remote_path, const std::string &local_path,
+                             const Ftp::download_callback_t &callback)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (_download.state != Download::State::NONE) {
+        lock.unlock();
+        if (callback) {
+            callback(Ftp::Result::BUSY, Ftp::ProgressData {0, 0});
+        }
+        return;
+    }
+
+    if (remote_path.size() > DATA_MAX_LEN) {
+        LogErr() << "Error: FTP path too long";
+        lock.unlock();
+        if (callback) {
+            callback(Ftp::Result::UNKNOWN, Ftp::ProgressData {0, 0});
+        }
+        return;
+    }
+
+    _download.state = Download::State::OPENING;
+    _download.remote_path = remote_path;
+    _download.local_path = local_path;
+    _download.callback = callback;
+
+    _parent->register_timeout_handler(std::bind(&FtpImpl::process_timeout, this),
+                                      TIMEOUT_S, &_timeout_cookie);
+
+    if (!send_request(CMD_OPEN_FILE_RO, 0, uint8_t(remote_path.size()), remote_path.c_str())) {
+        finish(lock, Ftp::Result::NO_SYSTEM);
+    }
+}
+
+void FtpImpl::process_file_transfer_protocol(const MAVLinkMessageView &message)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (_download.state == Download::State::NONE ||
+        message.compid() != _target_component_id) {
+        return;
+    }
+
+    const uint8_t opcode = message.get<uint8_t>(HeaderOffset::opcode);
+    if (opcode == RSP_ACK) {
+        process_ack(lock, message);
+    } else if (opcode == RSP_NAK) {
+        process_nak(lock, message);
+    }
+}
+
+void FtpImpl::process_ack(std::unique_lock<std::mutex> &lock, const MAVLinkMessageView &message)
+{
+    const uint8_t req_opcode = message.get<uint8_t>(HeaderOffset::req_opcode);
+    const uint8_t size = message.get<uint8_t>(HeaderOffset::size);
+    const uint32_t offset = message.get<uint32_t>(HeaderOffset::offset);
+
+    if (_download.state == Download::State::OPENING && req_opcode == CMD_OPEN_FILE_RO) {
+        _download.session = message.get<uint8_t>(HeaderOffset::session);
+        _download.file_size = message.get<uint32_t>(HeaderOffset::data);
+
+        _download.file = fopen(_download.local_path.c_str(), "wb");
+        if (_download.file == nullptr) {
+            LogErr() << "Error: cannot open " << _download.local_path << " for downloading";
+            send_request(CMD_TERMINATE_SESSION, 0, 0);
+            finish(lock, Ftp::Result::FILE_IO_ERROR);
+            return;
+        }
+
+        _download.state = Download::State::BURST;
+        _download.retries = 0;
+        _parent->refresh_timeout_handler(_timeout_cookie);
+        report_progress();
+
+        if (_download.file_size == 0) {
+            request_next_gap(lock);
+        } else {
+            request_burst(0);
+        }
+        return;
+    }
+
+    if (message.get<uint8_t>(HeaderOffset::session) != _download.session) {
+        return;
+    }
+
+    if (_download.state == Download::State::BURST && req_opcode == CMD_BURST_READ_FILE) {
+        if (!write_data(message, offset, size)) {
+            send_request(CMD_TERMINATE_SESSION, 0, 0);
+            finish(lock, Ftp::Result::FILE_IO_ERROR);
+            return;
+        }
+        _download.burst_end = std::max(_download.burst_end, offset + size);
+        _download.retries = 0;
+        _parent->refresh_timeout_handler(_timeout_cookie);
+        report_progress();
+
+        if (message.get<uint8_t>(HeaderOffset::burst_complete) == 0) {
+            return;
+        }
+
+        if (_download.burst_end < _download.file_size) {
+            request_burst(_download.burst_end);
+        } else {
+            _download.state = Download::State::FILLING_GAPS;
+            request_next_gap(lock);
+        }
+        return;
+    }
+
+    if (_download.state == Download::State::FILLING_GAPS && req_opcode == CMD_READ_FILE &&
+        offset == _download.request_offset) {
+        if (!write_data(message, offset, size)) {
+            send_request(CMD_TERMINATE_SESSION, 0, 0);
+            finish(lock, Ftp::Result::FILE_IO_ERROR);
+            return;
+        }
+        _download.retries = 0;
+        _parent->refresh_timeout_handler(_timeout_cookie);
+        report_progress();
+        request_next_gap(lock);
+    }
+}
+
+void FtpImpl::process_nak(std::unique_lock<std::mutex> &lock, const MAVLinkMessageView &message)
+{
+    const uint8_t req_opcode = message.get<uint8_t>(HeaderOffset::req_opcode);
+    const uint8_t error = message.get<uint8_t>(HeaderOffset::data);
+
+    if (_download.state == Download::State::OPENING && req_opcode == CMD_OPEN_FILE_RO) {
+        // Some components only tell errno, which doesn't say more to us.
+        if (error == ERR_FILE_NOT_FOUND || error == ERR_FAIL_ERRNO) {
+            finish(lock, Ftp::Result::FILE_NOT_FOUND);
+        } else {
+            LogErr() << "FTP open of " << _download.remote_path << " refused: " << int(error);
+            finish(lock, Ftp::Result::PROTOCOL_ERROR);
+        }
+        return;
+    }
+
+    if (message.get<uint8_t>(HeaderOffset::session) != _download.session) {
+        return;
+    }
+
+    if (error == ERR_EOF && (req_opcode == CMD_BURST_READ_FILE || req_opcode == CMD_READ_FILE)) {
+        // The end of a burst can also have got lost, only a read tells that the
+        // file ends before the size it had when opened.
+        if (req_opcode == CMD_READ_FILE) {
+            _download.file_size = std::min(_download.file_size, _download.request_offset);
+        }
+        _download.state = Download::State::FILLING_GAPS;
+        _download.retries = 0;
+        _parent->refresh_timeout_handler(_timeout_cookie);
+        request_next_gap(lock);
+        return;
+    }
+
+    if (req_opcode == CMD_BURST_READ_FILE || req_opcode == CMD_READ_FILE) {
+        LogErr() << "FTP read of " << _download.remote_path << " refused: " << int(error);
+        send_request(CMD_TERMINATE_SESSION, 0, 0);
+        finish(lock, Ftp::Result::PROTOCOL_ERROR);
+    }
+}
+
+void FtpImpl::process_timeout()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (_download.state == Download::State::NONE) {
+        return;
+    }
+
+    if (_download.retries++ >= MAX_RETRIES) {
+        LogWarn() << "FTP download of " << _download.remote_path << " timed out";
+        if (_download.state != Download::State::OPENING) {
+            send_request(CMD_TERMINATE_SESSION, 0, 0);
+        }
+        finish(lock, Ftp::Result::TIMEOUT);
+        return;
+    }
+
+    _parent->register_timeout_handler(std::bind(&FtpImpl::process_timeout, this),
+                                      TIMEOUT_S, &_timeout_cookie);
+
+    switch (_download.state) {
+        case Download::State::OPENING:
+            send_request(CMD_OPEN_FILE_RO, 0, uint8_t(_download.remote_path.size()),
+                         _download.remote_path.c_str());
+            break;
+        case Download::State::BURST:
+            // The end of the burst got lost, what is missing before it is read
+            // again later.
+            request_burst(_download.burst_end);
+            break;
+        case Download::State::FILLING_GAPS:
+            send_request(CMD_READ_FILE, _download.request_offset, _download.request_size);
+            break;
+        case Download::State::NONE:
+            break;
+    }
+}
+
+bool FtpImpl::send_request(Opcode opcode, uint32_t offset, uint8_t size, const void *data)
+{
+    // We assume that we already acquired _mutex in this function.
+
+    // The payload without the target bytes in front.
+    uint8_t payload[sizeof(mavlink_file_transfer_protocol_t::payload)] {};
+    const unsigned header = 3;
+    const uint16_t seq_number = _seq_number++;
+    memcpy(&payload[HeaderOffset::seq_number - header], &seq_number, sizeof(seq_number));
+    payload[HeaderOffset::session - header] = _download.session;
+    payload[HeaderOffset::opcode - header] = opcode;
+    payload[HeaderOffset::size - header] = size;
+    memcpy(&payload[HeaderOffset::offset - header], &offset, sizeof(offset));
+    if (data != nullptr) {
+        memcpy(&payload[HeaderOffset::data - header], data, size);
+    }
+
+    mavlink_message_t message;
+    mavlink_msg_file_transfer_protocol_pack(GCSClient::system_id,
+                                            GCSClient::component_id,
+                                            &message,
+                                            0,
+                                            _parent->get_system_id(),
+                                            _target_component_id,
+                                            payload);
+
+    return _parent->send_message(message);
+}
+
+void FtpImpl::request_burst(uint32_t offset)
+{
+    // We assume that we already acquired _mutex in this function.
+
+    _download.request_offset = offset;
+    _download.request_size = DATA_MAX_LEN;
+    send_request(CMD_BURST_READ_FILE, offset, DATA_MAX_LEN);
+}
+
+void FtpImpl::request_next_gap(std::unique_lock<std::mutex> &lock)
+{
+    uint32_t begin, end;
+    if (!_download.received.first_gap(_download.file_size, begin, end)) {
+        send_request(CMD_TERMINATE_SESSION, 0, 0);
+        finish(lock, Ftp::Result::SUCCESS);
+        return;
+    }
+
+    _download.request_offset = begin;
+    _download.request_size = uint8_t(std::min<uint32_t>(end - begin, DATA_MAX_LEN));
+    send_request(CMD_READ_FILE, _download.request_offset, _download.request_size);
+}
+
+bool FtpImpl::write_data(const MAVLinkMessageView &message, uint32_t offset, uint8_t size)
+{
+    // We assume that we already acquired _mutex in this function.
+
+    // Not as in the protocol, it is read again later.
+    if (size > DATA_MAX_LEN) {
+        return true;
+    }
+
+    // Data past the end of the file, e.g. of a file which grew, is not kept.
+    if (offset >= _download.file_size) {
+        return true;
+    }
+    size = uint8_t(std::min<uint32_t>(size, _download.file_size - offset));
+
+    if (offset != _download.file_position &&
+        fseek(_download.file, long(offset), SEEK_SET) != 0) {
+        return false;
+    }
+
+    // MAVLink 2 cuts off zeros at the end of the payload, they are added back.
+    unsigned available = 0;
+    if (message.payload_len() > HeaderOffset::data) {
+        available = std::min<unsigned>(size, message.payload_len() - HeaderOffset::data);
+    }
+    if (fwrite(message.payload() + HeaderOffset::data, 1, available, _download.file) != available) {
+        return false;
+    }
+    for (unsigned i = available; i < size; ++i) {
+        if (fputc(0, _download.file) == EOF) {
+            return false;
+        }
+    }
+
+    _download.file_position = offset + size;
+    _download.received.add(offset, offset + size);
+    return true;
+}
+
+void FtpImpl::report_progress()
+{
+    // We assume that we already acquired _mutex in this function.
+
+    const uint32_t bytes_transferred = _download.received.num_bytes();
+    const uint32_t total_bytes = _download.file_size;
+    const int percentage = (total_bytes > 0) ?
+                           int(uint64_t(bytes_transferred) * 100 / total_bytes) : 100;
+    if (percentage == _download.reported_percentage || !_download.callback) {
+        return;
+    }
+    _download.reported_percentage = percentage;
+
+    const Ftp::download_callback_t callback = _download.callback;
+    _parent->call_user_callback(this, &_download, [callback, bytes_transferred, total_bytes]() {
+        callback(Ftp::Result::IN_PROGRESS, Ftp::ProgressData {bytes_transferred, total_bytes});
+    });
+}
+
+void FtpImpl::finish(std::unique_lock<std::mutex> &lock, Ftp::Result result)
+{
+    _parent->unregister_timeout_handler(_timeout_cookie);
+
+    if (_download.file != nullptr) {
+        if (fclose(_download.file) != 0 && result == Ftp::Result::SUCCESS) {
+            result = Ftp::Result::FILE_IO_ERROR;
+        }
+        _download.file = nullptr;
+    }
+    if (result != Ftp::Result::SUCCESS && _download.state != Download::State::OPENING) {
+        remove(_download.local_path.c_str());
+    }
+
+    const Ftp::download_callback_t callback = std::move(_download.callback);
+    const Ftp::ProgressData progress {_download.received.num_bytes(), _download.file_size};
+    _download = Download {};
+
+    lock.unlock();
+    if (callback) {
+        // After the progress, which is called the same way.
+        _parent->call_user_callback(this, &_download, [callback, result, progress]() {
+            callback(result, progress);
+        }, CallbackExecutor::Overflow::BLOCK);
+    }
+}
+
+} // namespace dronecore
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include "plugin_impl_base.h"
+#include "mavlink_include.h"
+#include "mavlink_message_view.h"
+#include "system.h"
+#include "mavlink_system.h"
+#include "ftp.h"
+#include "received_ranges.h"
+
+namespace dronecore {
+
+class FtpImpl : public PluginImplBase
+{
+public:
+    FtpImpl(System &system);
+    ~FtpImpl();
+
+    void init() override;
+    void deinit() override;
+
+    void enable() override;
+    void disable() override;
+
+    void download_async(const std::string &remote_path, const std::string &local_path,
+                        const Ftp::download_callback_t &callback);
+
+    void set_target_component_id(uint8_t component_id);
+
+private:
+    // As in the MAVLink FTP protocol.
+    enum Opcode : uint8_t {
+        CMD_NONE = 0,
+        CMD_TERMINATE_SESSION = 1,
+        CMD_RESET_SESSIONS = 2,
+        CMD_LIST_DIRECTORY = 3,
+        CMD_OPEN_FILE_RO = 4,
+        CMD_READ_FILE = 5,
+        CMD_BURST_READ_FILE = 15,
+        RSP_ACK = 128,
+        RSP_NAK = 129
+    };
+
+    enum ServerError : uint8_t {
+        ERR_NONE = 0,
+        ERR_FAIL = 1,
+        ERR_FAIL_ERRNO = 2,
+        ERR_INVALID_DATA_SIZE = 3,
+        ERR_INVALID_SESSION = 4,
+        ERR_NO_SESSIONS_AVAILABLE = 5,
+        ERR_EOF = 6,
+        ERR_UNKNOWN_COMMAND = 7,
+        ERR_FILE_EXISTS = 8,
+        ERR_FILE_PROTECTED = 9,
+        ERR_FILE_NOT_FOUND = 10
+    };
+
+    // Offsets of the FTP header in the payload of FILE_TRANSFER_PROTOCOL, which
+    // starts after target_network, target_system and target_component.
+    struct HeaderOffset {
+        static constexpr unsigned seq_number = 3;
+        static constexpr unsigned session = 5;
+        static constexpr unsigned opcode = 6;
+        static constexpr unsigned size = 7;
+        static constexpr unsigned req_opcode = 8;
+        static constexpr unsigned burst_complete = 9;
+        static constexpr unsigned offset = 11;
+        static constexpr unsigned data = 15;
+    };
+
+    static constexpr uint8_t DATA_MAX_LEN = 239;
+
+    void process_file_transfer_protocol(const MAVLinkMessageView &message);
+    void process_ack(std::unique_lock<std::mutex> &lock, const MAVLinkMessageView &message);
+    void process_nak(std::unique_lock<std::mutex> &lock, const MAVLinkMessageView &message);
+    void process_timeout();
+
+    // We assume that we already acquired _mutex in these functions.
+    bool send_request(Opcode opcode, uint32_t offset, uint8_t size,
+                      const void *data = nullptr);
+    void request_burst(uint32_t offset);
+    void request_next_gap(std::unique_lock<std::mutex> &lock);
+    bool write_data(const MAVLinkMessageView &message, uint32_t offset, uint8_t size);
+    void report_progress();
+
+    // This takes the lock so that the callback can be called without it.
+    void finish(std::unique_lock<std::mutex> &lock, Ftp::Result result);
+
+    std::mutex _mutex {};
+
+    uint8_t _target_component_id = MAV_COMP_ID_AUTOPILOT1;
+    uint16_t _seq_number = 0;
+
+    struct Download {
+        enum class State {
+            NONE,
+            OPENING,
+            // The component sends the file on its own.
+            BURST,
+            // What got lost is read packet by packet.
+            FILLING_GAPS
+        } state = State::NONE;
+
+        std::string remote_path {};
+        std::string local_path {};
+        Ftp::download_callback_t callback {};
+
+        FILE *file = nullptr;
+        // Where the next write goes without seeking.
+        uint32_t file_position = 0;
+        uint32_t file_size = 0;
+        uint8_t session = 0;
+
+        // What was asked for last, to be asked for again on timeout.
+        uint32_t request_offset = 0;
+        uint8_t request_size = 0;
+        // The end of the highest data received with the burst.
+        uint32_t burst_end = 0;
+
+        ReceivedRanges received {};
+        int reported_percentage = -1;
+        unsigned retries = 0;
+    } _download {};
+
+    static constexpr double TIMEOUT_S = 0.5;
+    static constexpr unsigned MAX_RETRIES = 5;
+    void *_timeout_cookie = nullptr;
+};
+
+} // namespace dronecore
@@ -0,0 +1,409 @@
+#include "fence_index.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+namespace dronecore {
+
+constexpr unsigned FenceIndex::EDGES_PER_BAND;
+constexpr unsigned FenceIndex::MAX_BANDS_PER_POLYGON;
+constexpr unsigned FenceIndex::MAX_CELLS_PER_SIDE;
+
+namespace {
+
+bool is_valid_vertex(const Mission::GeofenceVertex &vertex)
+{
+    return std::isfinite(vertex.latitude_deg) && std::isfinite(vertex.longitude_deg) &&
+           std::fabs(vertex.latitude_deg) <= 90.0 && std::fabs(vertex.longitude_deg) <= 180.0;
+}
+
+} // namespace
+
+bool FenceIndex::build(const std::vector<Mission::GeofencePolygon> &polygons)
+{
+    _polygons.clear();
+    _edges.clear();
+    _has_inclusions = false;
+    _band_offsets.assign(1, 0);
+    _band_edges.clear();
+    _num_cells_x = 0;
+    _num_cells_y = 0;
+    _cell_edge_offsets.clear();
+    _cell_edges.clear();
+    _cell_polygon_offsets.clear();
+    _cell_polygons.clear();
+
+    if (polygons.empty()) {
+        return true;
+    }
+
+    double min_latitude_deg = 90.0;
+    double max_latitude_deg = -90.0;
+    double min_longitude_deg = 180.0;
+    double max_longitude_deg = -180.0;
+    size_t num_edges = 0;
+    for (const auto &polygon : polygons) {
+        if (polygon.vertices.size() < 3) {
+            return false;
+        }
+        for (const auto &vertex : polygon.vertices) {
+            if (!is_valid_vertex(vertex)) {
+                return false;
+            }
+            min_latitude_deg = std::min(min_latitude_deg, vertex.latitude_deg);
+            max_latitude_deg = std::max(max_latitude_deg, vertex.latitude_deg);
+            min_longitude_deg = std::min(min_longitude_deg, vertex.longitude_deg);
+            max_longitude_deg = std::max(max_longitude_deg, vertex.longitude_deg);
+        }
+        num_edges += polygon.vertices.size();
+    }
+
+    _projection = LocalProjection((min_latitude_deg + max_latitude_deg) / 2.0,
+                                  (min_longitude_deg + max_longitude_deg) / 2.0);
+
+    _polygons.reserve(polygons.size());
+    _edges.reserve(num_edges);
+    for (const auto &mission_polygon : polygons) {
+        const uint32_t first_edge = uint32_t(_edges.size());
+        const size_t num_vertices = mission_polygon.vertices.size();
+
+        Polygon polygon {};
+        polygon.type = mission_polygon.type;
+        polygon.box = Box {
+            std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity(),
+            -std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity()
+        };
+
+        for (size_t i = 0; i < num_vertices; ++i) {
+            const auto &from = mission_polygon.vertices[i];
+            const auto &to = mission_polygon.vertices[(i + 1) % num_vertices];
+
+            Edge edge {};
+            edge.from = to_local(from.latitude_deg, from.longitude_deg);
+            edge.to = to_local(to.latitude_deg, to.longitude_deg);
+            edge.dx = edge.to.x - edge.from.x;
+            edge.dy = edge.to.y - edge.from.y;
+            const double length_sq = edge.dx * edge.dx + edge.dy * edge.dy;
+            edge.inv_length_sq = (length_sq > 0.0) ? 1.0 / length_sq : 0.0;
+            edge.x_per_y = (edge.dy != 0.0) ? edge.dx / edge.dy : 0.0;
+            edge.polygon_index = uint32_t(_polygons.size());
+            _edges.push_back(edge);
+
+            polygon.box.min_x = std::min(polygon.box.min_x, edge.from.x);
+            polygon.box.min_y = std::min(polygon.box.min_y, edge.from.y);
+            polygon.box.max_x = std::max(polygon.box.max_x, edge.from.x);
+            polygon.box.max_y = std::max(polygon.box.max_y, edge.from.y);
+        }
+
+        build_bands(polygon, first_edge, uint32_t(num_vertices));
+        if (polygon.type == Mission::GeofencePolygon::Type::INCLUSION) {
+            _has_inclusions = true;
+        }
+        _polygons.push_back(polygon);
+    }
+
+    build_grid();
+    return true;
+}
+
+FenceIndex::Point FenceIndex::to_local(double latitude_deg, double longitude_deg) const
+{
+    return Point {_projection.east_m(longitude_deg), _projection.north_m(latitude_deg)};
+}
+
+void FenceIndex::build_bands(Polygon &polygon, uint32_t first_edge, uint32_t num_edges)
+{
+    const double height_m = polygon.box.max_y - polygon.box.min_y;
+
+    polygon.num_bands = std::max(1u, std::min(num_edges / EDGES_PER_BAND,
+                                              MAX_BANDS_PER_POLYGON));
+    if (!(height_m > 0.0)) {
+        polygon.num_bands = 1;
+    }
+    polygon.band_height_m = (height_m > 0.0) ? height_m / polygon.num_bands : 1.0;
+    polygon.first_band = uint32_t(_band_offsets.size() - 1);
+
+    auto band_of = [&polygon](double y) {
+        const double band = std::floor((y - polygon.box.min_y) / polygon.band_height_m);
+        return uint32_t(std::min(std::max(band, 0.0), double(polygon.num_bands - 1)));
+    };
+
+    // Counted first, so that every band can be filled in place.
+    std::vector<uint32_t> counts(polygon.num_bands, 0);
+    for (uint32_t i = first_edge; i < first_edge + num_edges; ++i) {
+        const Edge &edge = _edges[i];
+        const uint32_t first = band_of(std::min(edge.from.y, edge.to.y));
+        const uint32_t last = band_of(std::max(edge.from.y, edge.to.y));
+        for (uint32_t band = first; band <= last; ++band) {
+            ++counts[band];
+        }
+    }
+
+    std::vector<uint32_t> cursors(polygon.num_bands);
+    for (uint32_t band = 0; band < polygon.num_bands; ++band) {
+        cursors[band] = _band_offsets.back();
+        _band_offsets.push_back(_band_offsets.back() + counts[band]);
+    }
+    _band_edges.resize(_band_offsets.back());
+
+    for (uint32_t i = first_edge; i < first_edge + num_edges; ++i) {
+        const Edge &edge = _edges[i];
+        const uint32_t first = band_of(std::min(edge.from.y, edge.to.y));
+        const uint32_t last = band_of(std::max(edge.from.y, edge.to.y));
+        for (uint32_t band = first; band <= last; ++band) {
+            _band_edges[cursors[band]++] = i;
+        }
+    }
+}
+
+void FenceIndex::build_grid()
+{
+    _grid_box = _polygons.front().box;
+    for (const auto &polygon : _polygons) {
+        _grid_box.min_x = std::min(_grid_box.min_x, polygon.box.min_x);
+        _grid_box.min_y = std::min(_grid_box.min_y, polygon.box.min_y);
+        _grid_box.max_x = std::max(_grid_box.max_x, polygon.box.max_x);
+        _grid_box.max_y = std::max(_grid_box.max_y, polygon.box.max_y);
+    }
+
+    const double width_m = _grid_box.max_x - _grid_box.min_x;
+    const double height_m = _grid_box.max_y - _grid_box.min_y;
+    const double side_m = std::max(width_m, height_m);
+
+    // Square cells, about EDGES_PER_BAND edges each if they were spread evenly.
+    const unsigned num_cells = std::max(1u, std::min(
+                                            unsigned(std::ceil(std::sqrt(double(_edges.size()) /
+                                                                         EDGES_PER_BAND))),
+                                            MAX_CELLS_PER_SIDE));
+    _cell_size_m = (side_m > 0.0) ? side_m / num_cells : 1.0;
+    _num_cells_x = std::max(1u, std::min(num_cells, unsigned(std::ceil(width_m / _cell_size_m))));
+    _num_cells_y = std::max(1u, std::min(num_cells, unsigned(std::ceil(height_m / _cell_size_m))));
+
+    // Lists for every cell the items whose box reaches into it.
+    auto fill = [this](size_t num_items, std::vector<uint32_t> &offsets,
+    std::vector<uint32_t> &items, std::function<Box(size_t)> box_of) {
+        const size_t num_cells_total = size_t(_num_cells_x) * _num_cells_y;
+        std::vector<uint32_t> counts(num_cells_total, 0);
+        unsigned min_cx, min_cy, max_cx, max_cy;
+        for (size_t i = 0; i < num_items; ++i) {
+            cell_range(box_of(i), min_cx, min_cy, max_cx, max_cy);
+            for (unsigned cy = min_cy; cy <= max_cy; ++cy) {
+                for (unsigned cx = min_cx; cx <= max_cx; ++cx) {
+                    ++counts[size_t(cy) * _num_cells_x + cx];
+                }
+            }
+        }
+
+        offsets.assign(num_cells_total + 1, 0);
+        for (size_t cell = 0; cell < num_cells_total; ++cell) {
+            offsets[cell + 1] = offsets[cell] + counts[cell];
+        }
+        items.resize(offsets.back());
+
+        std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < num_items; ++i) {
+            cell_range(box_of(i), min_cx, min_cy, max_cx, max_cy);
+            for (unsigned cy = min_cy; cy <= max_cy; ++cy) {
+                for (unsigned cx = min_cx; cx <= max_cx; ++cx) {
+                    items[cursors[size_t(cy) * _num_cells_x + cx]++] = uint32_t(i);
+                }
+            }
+        }
+    };
+
+    fill(_edges.size(), _cell_edge_offsets, _cell_edges, [this](size_t i) {
+        const Edge &edge = _edges[i];
+        return Box {
+            std::min(edge.from.x, edge.to.x), std::min(edge.from.y, edge.to.y),
+            std::max(edge.from.x, edge.to.x), std::max(edge.from.y, edge.to.y)
+        };
+    });
+    fill(_polygons.size(), _cell_polygon_offsets, _cell_polygons, [this](size_t i) {
+        return _polygons[i].box;
+    });
+}
+
+unsigned FenceIndex::cell_of(double value, double min, unsigned num_cells) const
+{
+    const double cell = std::floor((value - min) / _cell_size_m);
+    return unsigned(std::min(std::max(cell, 0.0), double(num_cells - 1)));
+}
+
+void FenceIndex::cell_range(const Box &box, unsigned &min_cx, unsigned &min_cy,
+                            unsigned &max_cx, unsigned &max_cy) const
+{
+    min_cx = cell_of(box.min_x, _grid_box.min_x, _num_cells_x);
+    min_cy = cell_of(box.min_y, _grid_box.min_y, _num_cells_y);
+    max_cx = cell_of(box.max_x, _grid_box.min_x, _num_cells_x);
+    max_cy = cell_of(box.max_y, _grid_box.min_y, _num_cells_y);
+}
+
+bool FenceIndex::contains(size_t polygon_index, double latitude_deg, double longitude_deg) const
+{
+    if (polygon_index >= _polygons.size()) {
+        return false;
+    }
+    return contains_local(_polygons[polygon_index], to_local(latitude_deg, longitude_deg));
+}
+
+bool FenceIndex::contains_local(const Polygon &polygon, Point point) const
+{
+    if (point.x < polygon.box.min_x || point.x > polygon.box.max_x ||
+        point.y < polygon.box.min_y || point.y > polygon.box.max_y) {
+        return false;
+    }
+
+    const double band_in_polygon =
+        std::floor((point.y - polygon.box.min_y) / polygon.band_height_m);
+    const uint32_t band = polygon.first_band + uint32_t(
+                              std::min(std::max(band_in_polygon, 0.0),
+                                       double(polygon.num_bands - 1)));
+
+    // Every edge which the ray east can cross reaches into this band.
+    bool is_inside = false;
+    for (uint32_t i = _band_offsets[band]; i < _band_offsets[band + 1]; ++i) {
+        const Edge &edge = _edges[_band_edges[i]];
+        if ((edge.from.y > point.y) != (edge.to.y > point.y) &&
+            point.x < edge.from.x + (point.y - edge.from.y) * edge.x_per_y) {
+            is_inside = !is_inside;
+        }
+    }
+    return is_inside;
+}
+
+double FenceIndex::distance_sq(const Edge &edge, Point point)
+{
+    const double px = point.x - edge.from.x;
+    const double py = point.y - edge.from.y;
+    const double t = std::min(std::max((px * edge.dx + py * edge.dy) * edge.inv_length_sq, 0.0),
+                              1.0);
+    const double x = px - t * edge.dx;
+    const double y = py - t * edge.dy;
+    return x * x + y * y;
+}
+
+template<typename Wanted>
+int FenceIndex::nearest_edge(Point point, double max_distance_m, Wanted wanted,
+                             double &distance_m) const
+{
+    const int cx = int(cell_of(point.x, _grid_box.min_x, _num_cells_x));
+    const int cy = int(cell_of(point.y, _grid_box.min_y, _num_cells_y));
+    const int num_cells_x = int(_num_cells_x);
+    const int num_cells_y = int(_num_cells_y);
+
+    double best_distance_sq = max_distance_m * max_distance_m;
+    int best = -1;
+
+    for (int ring = 0; ; ++ring) {
+        for (int y = std::max(cy - ring, 0); y <= std::min(cy + ring, num_cells_y - 1); ++y) {
+            const bool is_edge_row = (y == cy - ring || y == cy + ring);
+            for (int x = std::max(cx - ring, 0); x <= std::min(cx + ring, num_cells_x - 1); ++x) {
+                // Only the cells on the ring, the inner ones are done.
+                if (!is_edge_row && x != cx - ring && x != cx + ring) {
+                    continue;
+                }
+                const size_t cell = size_t(y) * _num_cells_x + size_t(x);
+                for (uint32_t i = _cell_edge_offsets[cell]; i < _cell_edge_offsets[cell + 1];
+                     ++i) {
+                    const Edge &edge = _edges[_cell_edges[i]];
+                    if (!wanted(edge.polygon_index)) {
+                        continue;
+                    }
+                    const double edge_distance_sq = distance_sq(edge, point);
+                    if (edge_distance_sq < best_distance_sq) {
+                        best_distance_sq = edge_distance_sq;
+                        best = int(_cell_edges[i]);
+                    }
+                }
+            }
+        }
+
+        // How far the cells not looked at yet are at least.
+        double remaining_m = std::numeric_limits<double>::infinity();
+        if (cx - ring > 0) {
+            remaining_m = std::min(remaining_m,
+                                   point.x - (_grid_box.min_x + (cx - ring) * _cell_size_m));
+        }
+        if (cx + ring < num_cells_x - 1) {
+            remaining_m = std::min(remaining_m,
+                                   _grid_box.min_x + (cx + ring + 1) * _cell_size_m - point.x);
+        }
+        if (cy - ring > 0) {
+            remaining_m = std::min(remaining_m,
+                                   point.y - (_grid_box.min_y + (cy - ring) * _cell_size_m));
+        }
+        if (cy + ring < num_cells_y - 1) {
+            remaining_m = std::min(remaining_m,
+                                   _grid_box.min_y + (cy + ring + 1) * _cell_size_m - point.y);
+        }
+        if (std::isinf(remaining_m)) {
+            // All cells are done.
+            break;
+        }
+        remaining_m = std::max(remaining_m, 0.0);
+        if (best_distance_sq <= remaining_m * remaining_m) {
+            break;
+        }
+    }
+
+    if (best >= 0) {
+        distance_m = std::sqrt(best_distance_sq);
+    }
+    return best;
+}
+
+FenceIndex::Check FenceIndex::check(double latitude_deg, double longitude_deg,
+                                    double max_distance_m) const
+{
+    Check result {false, -1, NAN};
+    if (_polygons.empty()) {
+        return result;
+    }
+
+    const Point point = to_local(latitude_deg, longitude_deg);
+    const double infinity = std::numeric_limits<double>::infinity();
+
+    int excluded_by = -1;
+    bool is_included = false;
+    if (point.x >= _grid_box.min_x && point.x <= _grid_box.max_x &&
+        point.y >= _grid_box.min_y && point.y <= _grid_box.max_y) {
+        const size_t cell = size_t(cell_of(point.y, _grid_box.min_y, _num_cells_y)) *
+                            _num_cells_x + cell_of(point.x, _grid_box.min_x, _num_cells_x);
+        for (uint32_t i = _cell_polygon_offsets[cell]; i < _cell_polygon_offsets[cell + 1]; ++i) {
+            const Polygon &polygon = _polygons[_cell_polygons[i]];
+            const bool is_exclusion = (polygon.type == Mission::GeofencePolygon::Type::EXCLUSION);
+            if ((is_exclusion || !is_included) && contains_local(polygon, point)) {
+                if (is_exclusion) {
+                    excluded_by = int(_cell_polygons[i]);
+                    break;
+                }
+                is_included = true;
+            }
+        }
+    }
+
+    int edge = -1;
+    if (excluded_by >= 0) {
+        result.is_breached = true;
+        const uint32_t polygon_index = uint32_t(excluded_by);
+        edge = nearest_edge(point, infinity, [polygon_index](uint32_t index) {
+            return index == polygon_index;
+        }, result.distance_m);
+    } else if (_has_inclusions && !is_included) {
+        result.is_breached = true;
+        edge = nearest_edge(point, infinity, [this](uint32_t index) {
+            return _polygons[index].type == Mission::GeofencePolygon::Type::INCLUSION;
+        }, result.distance_m);
+    } else {
+        edge = nearest_edge(point, max_distance_m, [](uint32_t) { return true; },
+                            result.distance_m);
+    }
+
+    if (edge >= 0) {
+        result.polygon_index = int(_edges[size_t(edge)].polygon_index);
+    }
+    return result;
+}
+
+} // namespace dronecore
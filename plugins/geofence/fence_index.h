@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "local_projection.h"
+#include "mission.h"
+
+namespace dronecore {
+
+// Answers which polygons of a geofence contain a position and how far the
+// nearest boundary is, fast enough to check many vehicles against hundreds of
+// polygons at every position update.
+//
+// The vertices are converted to metres east and north of the centre of the
+// fence, which is accurate enough for fences of some tens of kilometres, and
+// every edge keeps what the queries need of it. Edges are then sorted into
+// two indexes:
+//
+// - Every polygon is cut into horizontal bands, each listing the edges which
+//   reach into it. Containment casts a ray east and only counts the crossings
+//   with the edges of the band the position is in.
+// - A grid over the whole fence lists the edges and the bounding boxes of the
+//   polygons reaching into each cell. A position only looks at the polygons
+//   of its cell, and the nearest edge is searched ring by ring around it
+//   until no cell left can have a nearer one.
+//
+// Both indexes are flat arrays of offsets into one array of indices each.
+// Once built, the index is not changed, so it can be queried from any thread.
+// Fences across the antimeridian or a pole are not supported.
+class FenceIndex
+{
+public:
+    FenceIndex() {}
+    ~FenceIndex() {}
+
+    // Returns false if a polygon has less than 3 vertices or one of them is
+    // not a valid position, the index is empty then.
+    bool build(const std::vector<Mission::GeofencePolygon> &polygons);
+
+    size_t num_polygons() const { return _polygons.size(); }
+
+    struct Check {
+        // Within an exclusion polygon, or outside of all inclusion ones.
+        bool is_breached;
+        // The polygon breached or with the nearest boundary, -1 for none.
+        int polygon_index;
+        // To the boundary of that polygon, a NAN if further than the
+        // max_distance_m asked for.
+        double distance_m;
+    };
+
+    // A breach is always found. The distance of the boundary that is
+    // breached is always known, otherwise boundaries further than
+    // max_distance_m are not searched for.
+    Check check(double latitude_deg, double longitude_deg, double max_distance_m) const;
+
+    bool contains(size_t polygon_index, double latitude_deg, double longitude_deg) const;
+
+    // Non-copyable
+    FenceIndex(const FenceIndex &) = delete;
+    const FenceIndex &operator=(const FenceIndex &) = delete;
+
+private:
+    struct Point {
+        double x;
+        double y;
+    };
+
+    struct Box {
+        double min_x;
+        double min_y;
+        double max_x;
+        double max_y;
+    };
+
+    struct Edge {
+        Point from;
+        Point to;
+        // to - from, and 1 / its squared length for the distance.
+        double dx;
+        double dy;
+        double inv_length_sq;
+        // How far east the edge goes for every metre north, for the crossings.
+        double x_per_y;
+        uint32_t polygon_index;
+    };
+
+    struct Polygon {
+        Mission::GeofencePolygon::Type type;
+        Box box;
+        uint32_t first_band;
+        uint32_t num_bands;
+        double band_height_m;
+    };
+
+    // Roughly how many edges a band or a cell should list.
+    static constexpr unsigned EDGES_PER_BAND = 4;
+    static constexpr unsigned MAX_BANDS_PER_POLYGON = 256;
+    static constexpr unsigned MAX_CELLS_PER_SIDE = 256;
+
+    Point to_local(double latitude_deg, double longitude_deg) const;
+
+    bool contains_local(const Polygon &polygon, Point point) const;
+    static double distance_sq(const Edge &edge, Point point);
+
+    // Nearest edge of the polygons for which wanted() is true. Returns -1 if
+    // there is none within max_distance_m.
+    template<typename Wanted>
+    int nearest_edge(Point point, double max_distance_m, Wanted wanted, double &distance_m) const;
+
+    void cell_range(const Box &box, unsigned &min_cx, unsigned &min_cy,
+                    unsigned &max_cx, unsigned &max_cy) const;
+    unsigned cell_of(double value, double min, unsigned num_cells) const;
+
+    void build_bands(Polygon &polygon, uint32_t first_edge, uint32_t num_edges);
+    void build_grid();
+
+    LocalProjection _projection {};
+
+    std::vector<Polygon> _polygons {};
+    std::vector<Edge> _edges {};
+    bool _has_inclusions = false;
+
+    // Band b of all polygons lists _band_edges[_band_offsets[b]] up to
+    // _band_edges[_band_offsets[b + 1]].
+    std::vector<uint32_t> _band_offsets {};
+    std::vector<uint32_t> _band_edges {};
+
+    Box _grid_box {};
+    double _cell_size_m = 1.0;
+    unsigned _num_cells_x = 0;
+    unsigned _num_cells_y = 0;
+    std::vector<uint32_t> _cell_edge_offsets {};
+    std::vector<uint32_t> _cell_edges {};
+    std::vector<uint32_t> _cell_polygon_offsets {};
+    std::vector<uint32_t> _cell_polygons {};
+};
+
+} // namespace dronecore
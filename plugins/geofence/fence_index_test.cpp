@@ -0,0 +1,176 @@
+#include "fence_index.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace dronecore;
+
+namespace {
+
+const double LATITUDE_DEG = 47.39;
+const double LONGITUDE_DEG = 8.54;
+// Metres per degree of latitude.
+const double M_PER_DEG = 6371000.0 * M_PI / 180.0;
+
+Mission::GeofenceVertex make_vertex(double north_m, double east_m)
+{
+    return Mission::GeofenceVertex {
+        LATITUDE_DEG + north_m / M_PER_DEG,
+        LONGITUDE_DEG + east_m / (M_PER_DEG * std::cos(LATITUDE_DEG * M_PI / 180.0))
+    };
+}
+
+Mission::GeofencePolygon make_square(double north_m, double east_m, double size_m,
+                                     Mission::GeofencePolygon::Type type)
+{
+    Mission::GeofencePolygon polygon;
+    polygon.type = type;
+    polygon.vertices = {
+        make_vertex(north_m, east_m),
+        make_vertex(north_m, east_m + size_m),
+        make_vertex(north_m + size_m, east_m + size_m),
+        make_vertex(north_m + size_m, east_m)
+    };
+    return polygon;
+}
+
+// A star with jagged edges, so that it is concave and has many vertices.
+Mission::GeofencePolygon make_star(double north_m, double east_m, double radius_m,
+                                   unsigned num_vertices)
+{
+    Mission::GeofencePolygon polygon;
+    polygon.type = Mission::GeofencePolygon::Type::EXCLUSION;
+    for (unsigned i = 0; i < num_vertices; ++i) {
+        const double angle = 2.0 * M_PI * i / num_vertices;
+        const double radius = (i % 2 == 0) ? radius_m : radius_m * 0.4;
+        polygon.vertices.push_back(make_vertex(north_m + radius * std::sin(angle),
+                                               east_m + radius * std::cos(angle)));
+    }
+    return polygon;
+}
+
+// Plain ray cast over all vertices, in degrees, which is the same as in
+// metres as long as the conversion is linear.
+bool naive_contains(const Mission::GeofencePolygon &polygon, double latitude_deg,
+                    double longitude_deg)
+{
+    bool is_inside = false;
+    const auto &vertices = polygon.vertices;
+    for (size_t i = 0, j = vertices.size() - 1; i < vertices.size(); j = i++) {
+        if ((vertices[i].latitude_deg > latitude_deg) !=
+            (vertices[j].latitude_deg > latitude_deg) &&
+            longitude_deg < vertices[i].longitude_deg +
+            (latitude_deg - vertices[i].latitude_deg) *
+            (vertices[j].longitude_deg - vertices[i].longitude_deg) /
+            (vertices[j].latitude_deg - vertices[i].latitude_deg)) {
+            is_inside = !is_inside;
+        }
+    }
+    return is_inside;
+}
+
+} // namespace
+
+TEST(FenceIndex, RejectsInvalidPolygons)
+{
+    FenceIndex index;
+    Mission::GeofencePolygon polygon;
+    polygon.vertices = {make_vertex(0.0, 0.0), make_vertex(10.0, 0.0)};
+    EXPECT_FALSE(index.build({polygon}));
+    EXPECT_EQ(index.num_polygons(), 0u);
+
+    polygon.vertices.push_back(Mission::GeofenceVertex {NAN, LONGITUDE_DEG});
+    EXPECT_FALSE(index.build({polygon}));
+
+    EXPECT_TRUE(index.build({}));
+    const auto check = index.check(LATITUDE_DEG, LONGITUDE_DEG, 100.0);
+    EXPECT_FALSE(check.is_breached);
+    EXPECT_EQ(check.polygon_index, -1);
+}
+
+TEST(FenceIndex, ChecksInclusion)
+{
+    FenceIndex index;
+    ASSERT_TRUE(index.build({
+        make_square(0.0, 0.0, 1000.0, Mission::GeofencePolygon::Type::INCLUSION)
+    }));
+
+    // In the middle, no boundary within 100 m.
+    auto position = make_vertex(500.0, 500.0);
+    auto check = index.check(position.latitude_deg, position.longitude_deg, 100.0);
+    EXPECT_FALSE(check.is_breached);
+    EXPECT_EQ(check.polygon_index, -1);
+    EXPECT_TRUE(std::isnan(check.distance_m));
+
+    // 50 m from the eastern boundary.
+    position = make_vertex(500.0, 950.0);
+    check = index.check(position.latitude_deg, position.longitude_deg, 100.0);
+    EXPECT_FALSE(check.is_breached);
+    EXPECT_EQ(check.polygon_index, 0);
+    EXPECT_NEAR(check.distance_m, 50.0, 0.5);
+
+    // 200 m out, far away boundaries are found when breached.
+    position = make_vertex(500.0, 1200.0);
+    check = index.check(position.latitude_deg, position.longitude_deg, 100.0);
+    EXPECT_TRUE(check.is_breached);
+    EXPECT_EQ(check.polygon_index, 0);
+    EXPECT_NEAR(check.distance_m, 200.0, 1.0);
+}
+
+TEST(FenceIndex, ChecksExclusionWithinInclusion)
+{
+    FenceIndex index;
+    ASSERT_TRUE(index.build({
+        make_square(0.0, 0.0, 1000.0, Mission::GeofencePolygon::Type::INCLUSION),
+        make_square(400.0, 400.0, 200.0, Mission::GeofencePolygon::Type::EXCLUSION)
+    }));
+
+    // 10 m into the exclusion.
+    auto position = make_vertex(500.0, 410.0);
+    auto check = index.check(position.latitude_deg, position.longitude_deg, 10.0);
+    EXPECT_TRUE(check.is_breached);
+    EXPECT_EQ(check.polygon_index, 1);
+    EXPECT_NEAR(check.distance_m, 10.0, 0.1);
+
+    // 20 m before it.
+    position = make_vertex(500.0, 380.0);
+    check = index.check(position.latitude_deg, position.longitude_deg, 30.0);
+    EXPECT_FALSE(check.is_breached);
+    EXPECT_EQ(check.polygon_index, 1);
+    EXPECT_NEAR(check.distance_m, 20.0, 0.1);
+}
+
+TEST(FenceIndex, MatchesNaiveChecks)
+{
+    std::vector<Mission::GeofencePolygon> polygons;
+    for (unsigned i = 0; i < 100; ++i) {
+        polygons.push_back(make_star((i / 10) * 300.0, (i % 10) * 300.0, 140.0, 6 + 2 * (i % 30)));
+    }
+    FenceIndex index;
+    ASSERT_TRUE(index.build(polygons));
+
+    std::srand(42);
+    for (unsigned i = 0; i < 2000; ++i) {
+        const auto position = make_vertex(double(std::rand() % 3400) - 200.0,
+                                          double(std::rand() % 3400) - 200.0);
+
+        int naive_polygon = -1;
+        for (size_t j = 0; j < polygons.size(); ++j) {
+            EXPECT_EQ(index.contains(j, position.latitude_deg, position.longitude_deg),
+                      naive_contains(polygons[j], position.latitude_deg, position.longitude_deg));
+            if (naive_contains(polygons[j], position.latitude_deg, position.longitude_deg)) {
+                naive_polygon = int(j);
+            }
+        }
+
+        const auto check = index.check(position.latitude_deg, position.longitude_deg, 50.0);
+        EXPECT_EQ(check.is_breached, naive_polygon >= 0);
+        if (check.is_breached) {
+            EXPECT_EQ(check.polygon_index, naive_polygon);
+            EXPECT_GE(check.distance_m, 0.0);
+        } else if (check.polygon_index >= 0) {
+            EXPECT_LE(check.distance_m, 50.0);
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#include "geofence.h"
+#include "geofence_impl.h"
+
+namespace dronecore {
+
+Geofence::Geofence(System &system) :
+    PluginBase(),
+    _impl { new GeofenceImpl(system) }
+{
+}
+
+Geofence::~Geofence()
+{
+}
+
+Geofence::Result Geofence::set_polygons(Mission::shared_geofence_t polygons)
+{
+    return _impl->set_polygons(polygons);
+}
+
+void Geofence::set_approach_distance(double distance_m)
+{
+    _impl->set_approach_distance(distance_m);
+}
+
+Geofence::Status Geofence::check(double latitude_deg, double longitude_deg) const
+{
+    return _impl->check(latitude_deg, longitude_deg);
+}
+
+Geofence::Status Geofence::status() const
+{
+    return _impl->status();
+}
+
+Geofence::subscription_handle_t Geofence::status_async(status_callback_t callback)
+{
+    return _impl->status_async(callback);
+}
+
+void Geofence::unsubscribe(subscription_handle_t handle)
+{
+    _impl->unsubscribe(handle);
+}
+
+const char *Geofence::result_str(Result result)
+{
+    switch (result) {
+        case Result::SUCCESS:
+            return "Success";
+        case Result::INVALID_ARGUMENT:
+            return "Invalid argument";
+        case Result::UNKNOWN:
+        default:
+            return "Unknown";
+    }
+}
+
+} // namespace dronecore
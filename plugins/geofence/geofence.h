@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "mission.h"
+#include "plugin_base.h"
+
+namespace dronecore {
+
+class System;
+class GeofenceImpl;
+
+/**
+ * @brief The Geofence class checks the position of a system against geofence polygons.
+ *
+ * Unlike a geofence uploaded with Mission, which is enforced by the vehicle, this checks on the
+ * ground. Every position update is checked as it is received, also against hundreds of
+ * polygons, and changes from inside to approaching or breaching a boundary are reported.
+ */
+class Geofence : public PluginBase
+{
+public:
+    /**
+     * @brief Constructor. Creates the plugin for a specific System.
+     *
+     * The plugin is typically created as shown below:
+     *
+     *     ```cpp
+     *     auto geofence = std::make_shared<Geofence>(system);
+     *     ```
+     *
+     * @param system The specific system associated with this plugin.
+     */
+    explicit Geofence(System &system);
+
+    /**
+     * @brief Destructor (internal use only).
+     */
+    ~Geofence();
+
+    /**
+     * @brief Possible results returned for geofence requests.
+     */
+    enum class Result {
+        SUCCESS = 0, /**< @brief Request succeeded. */
+        INVALID_ARGUMENT, /**< @brief A polygon has less than 3 vertices or an invalid one. */
+        UNKNOWN /**< @brief Unknown error. */
+    };
+
+    /**
+     * @brief Returns a human-readable English string for a Geofence::Result.
+     *
+     * @param result The enum value for which a human readable string is required.
+     * @return Human readable string for the Geofence::Result.
+     */
+    static const char *result_str(Result result);
+
+    /**
+     * @brief Sets the polygons to check positions against.
+     *
+     * The polygons are kept, not copied, so the same ones can be uploaded with
+     * Mission::upload_geofence_async(Mission::shared_geofence_t, Mission::result_callback_t).
+     * They are preprocessed here, so this should not be called at every position update.
+     *
+     * The system breaches the geofence if it is within an exclusion polygon, or if there are
+     * inclusion polygons and it is outside of all of them.
+     *
+     * @param polygons Polygons of the geofence, `nullptr` or an empty vector removes it.
+     * @return Result of the request, the polygons are not changed unless it succeeds.
+     */
+    Result set_polygons(Mission::shared_geofence_t polygons);
+
+    /**
+     * @brief Sets how close to a boundary the system is reported as approaching it.
+     *
+     * @param distance_m Distance in metres, 0 to only report breaches. The default is 50 m.
+     */
+    void set_approach_distance(double distance_m);
+
+    /**
+     * @brief Where the system is with respect to the geofence.
+     */
+    enum class State {
+        CLEAR, /**< @brief Further from all boundaries than the approach distance. */
+        APPROACHING, /**< @brief Within the approach distance of a boundary. */
+        BREACHED /**< @brief Outside of what is allowed. */
+    };
+
+    /**
+     * @brief Status of a position.
+     */
+    struct Status {
+        State state; /**< @brief State of the position. */
+        /**
+         * @brief Index of the polygon breached or approached, -1 if clear.
+         */
+        int polygon_index;
+        /**
+         * @brief Distance in metres to the boundary of that polygon, NAN if clear.
+         */
+        double distance_m;
+    };
+
+    /**
+     * @brief Checks a position against the polygons set, e.g. a planned one.
+     *
+     * @param latitude_deg Latitude in degrees.
+     * @param longitude_deg Longitude in degrees.
+     * @return Status of the position.
+     */
+    Status check(double latitude_deg, double longitude_deg) const;
+
+    /**
+     * @brief Status of the last position received from the system.
+     *
+     * It is clear until a position was received.
+     *
+     * @return Status of the system.
+     */
+    Status status() const;
+
+    /**
+     * @brief Handle for a subscription, see unsubscribe().
+     */
+    typedef uint64_t subscription_handle_t;
+
+    /**
+     * @brief Callback type for status changes.
+     */
+    typedef std::function<void(Status)> status_callback_t;
+
+    /**
+     * @brief Subscribe to changes of the status (asynchronous).
+     *
+     * The callback is called whenever the state of the system changes or another polygon is
+     * breached or approached, not at every position update. No changes are dropped.
+     *
+     * @param callback Function to call with changes.
+     * @return Handle to unsubscribe this callback again.
+     */
+    subscription_handle_t status_async(status_callback_t callback);
+
+    /**
+     * @brief Remove one subscriber again.
+     *
+     * @param handle Handle returned when subscribing.
+     */
+    void unsubscribe(subscription_handle_t handle);
+
+    // Non-copyable
+    /**
+     * @brief Copy constructor (object is not copyable).
+     */
+    Geofence(const Geofence &) = delete;
+    /**
+     * @brief Equality operator (object is not copyable).
+     */
+    const Geofence &operator=(const Geofence &) = delete;
+
+private:
+    /** @private Underlying implementation, set at instantiation */
+    std::unique_ptr<GeofenceImpl> _impl;
+};
+
+} // namespace dronecore
@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include "geofence_impl.h"
+#include "system.h"
+#include "mavlink_system.h"
+#include "global_include.h"
+#include "log.h"
+
+namespace dronecore {
+
+GeofenceImpl::GeofenceImpl(System &system) :
+    PluginImplBase(system)
+{
+    _parent->register_plugin(this);
+}
+
+GeofenceImpl::~GeofenceImpl()
+{
+    _parent->unregister_plugin(this);
+}
+
+void GeofenceImpl::init()
+{
+    using namespace std::placeholders; // for `_1`
+
+    _parent->register_mavlink_message_handler<mavlink_global_position_int_t>(
+        std::bind(&GeofenceImpl::process_global_position_int, this, _1), this);
+}
+
+void GeofenceImpl::deinit()
+{
+    _parent->unregister_all_mavlink_message_handlers(this);
+}
+
+void GeofenceImpl::enable() {}
+
+void GeofenceImpl::disable() {}
+
+Geofence::Result GeofenceImpl::set_polygons(Mission::shared_geofence_t polygons)
+{
+    auto index = std::make_shared<FenceIndex>();
+    if (polygons != nullptr && !index->build(*polygons)) {
+        LogErr() << "Geofence polygon invalid";
+        return Geofence::Result::INVALID_ARGUMENT;
+    }
+
+    std::atomic_store(&_index, std::shared_ptr<const FenceIndex>(index));
+    return Geofence::Result::SUCCESS;
+}
+
+void GeofenceImpl::set_approach_distance(double distance_m)
+{
+    _approach_distance_m = std::max(distance_m, 0.0);
+}
+
+Geofence::Status GeofenceImpl::check(double latitude_deg, double longitude_deg) const
+{
+    const std::shared_ptr<const FenceIndex> index = std::atomic_load(&_index);
+    const auto result = index->check(latitude_deg, longitude_deg, _approach_distance_m);
+
+    if (result.is_breached) {
+        return Geofence::Status {Geofence::State::BREACHED, result.polygon_index,
+                                 result.distance_m};
+    }
+    if (result.polygon_index >= 0) {
+        return Geofence::Status {Geofence::State::APPROACHING, result.polygon_index,
+                                 result.distance_m};
+    }
+    return Geofence::Status {Geofence::State::CLEAR, -1, NAN};
+}
+
+Geofence::Status GeofenceImpl::status() const
+{
+    std::lock_guard<std::mutex> lock(_status_mutex);
+    return _status;
+}
+
+Geofence::subscription_handle_t GeofenceImpl::status_async(Geofence::status_callback_t callback)
+{
+    if (callback == nullptr) {
+        return 0;
+    }
+    return _status_subscriptions.add(callback);
+}
+
+void GeofenceImpl::unsubscribe(Geofence::subscription_handle_t handle)
+{
+    _status_subscriptions.remove(handle);
+}
+
+void GeofenceImpl::process_global_position_int(
+    const mavlink_global_position_int_t &global_position_int)
+{
+    const Geofence::Status new_status = check(global_position_int.lat * 1e-7,
+                                              global_position_int.lon * 1e-7);
+
+    bool has_changed;
+    {
+        std::lock_guard<std::mutex> lock(_status_mutex);
+        has_changed = (new_status.state != _status.state ||
+                       new_status.polygon_index != _status.polygon_index);
+        _status = new_status;
+    }
+
+    if (has_changed && !_status_subscriptions.empty()) {
+        // Changes must not get lost, unlike telemetry updates.
+        _parent->call_user_callback(this, &_status_subscriptions, [this, new_status]() {
+            _status_subscriptions(new_status);
+        }, CallbackExecutor::Overflow::BLOCK);
+    }
+}
+
+} // namespace dronecore
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include "callback_list.h"
+#include "fence_index.h"
+#include "geofence.h"
+#include "mavlink_include.h"
+#include "plugin_impl_base.h"
+
+namespace dronecore {
+
+class GeofenceImpl : public PluginImplBase
+{
+public:
+    GeofenceImpl(System &system);
+    ~GeofenceImpl();
+
+    void init() override;
+    void deinit() override;
+
+    void enable() override;
+    void disable() override;
+
+    Geofence::Result set_polygons(Mission::shared_geofence_t polygons);
+    void set_approach_distance(double distance_m);
+
+    Geofence::Status check(double latitude_deg, double longitude_deg) const;
+    Geofence::Status status() const;
+
+    Geofence::subscription_handle_t status_async(Geofence::status_callback_t callback);
+    void unsubscribe(Geofence::subscription_handle_t handle);
+
+private:
+    void process_global_position_int(const mavlink_global_position_int_t &global_position_int);
+
+    // Swapped as a whole, so that positions are checked without a lock.
+    std::shared_ptr<const FenceIndex> _index {std::make_shared<const FenceIndex>()};
+    std::atomic<double> _approach_distance_m {50.0};
+
+    mutable std::mutex _status_mutex {};
+    Geofence::Status _status {Geofence::State::CLEAR, -1, NAN};
+
+    CallbackList<Geofence::Status> _status_subscriptions {};
+};
+
+} // namespace dronecore
@@ -34,6 +34,31 @@ void Gimbal::set_roi_location_async(double latitude_deg, double longitude_deg, f
     _impl->set_roi_location_async(latitude_deg, longitude_deg, altitude_m, callback);
 }
 
+Gimbal::Result Gimbal::start_streaming(float rate_hz)
+{
+    return _impl->start_streaming(rate_hz);
+}
+
+void Gimbal::stop_streaming()
+{
+    _impl->stop_streaming();
+}
+
+void Gimbal::stream_pitch_and_yaw(float pitch_deg, float yaw_deg)
+{
+    _impl->stream_pitch_and_yaw(pitch_deg, yaw_deg);
+}
+
+void Gimbal::stream_pitch_and_yaw_rate(float pitch_rate_deg_s, float yaw_rate_deg_s)
+{
+    _impl->stream_pitch_and_yaw_rate(pitch_rate_deg_s, yaw_rate_deg_s);
+}
+
+void Gimbal::stream_roi_location(double latitude_deg, double longitude_deg, float altitude_m)
+{
+    _impl->stream_roi_location(latitude_deg, longitude_deg, altitude_m);
+}
+
 const char *Gimbal::result_str(Result result)
 {
     switch (result) {
@@ -118,6 +118,66 @@ public:
     void set_roi_location_async(double latitude_deg, double longitude_deg, float altitude_m,
                                 result_callback_t callback);
 
+    /**
+     * @brief Start streaming gimbal setpoints at a fixed rate.
+     *
+     * For tracking a target, setpoints are sent as unacknowledged messages
+     * rather than as commands which are acknowledged and retried one by one.
+     * Only the latest setpoint given by stream_pitch_and_yaw() or
+     * stream_pitch_and_yaw_rate() is sent, setting one never blocks.
+     *
+     * Calling it again while streaming changes the rate.
+     *
+     * @param rate_hz Rate at which setpoints are sent.
+     * @return Gimbal::Result::SUCCESS if streaming started,
+     *         Gimbal::Result::ERROR if the rate is invalid.
+     */
+    Result start_streaming(float rate_hz);
+
+    /**
+     * @brief Stop streaming gimbal setpoints.
+     *
+     * The gimbal stays at the last angles sent.
+     */
+    void stop_streaming();
+
+    /**
+     * @brief Set the gimbal pitch and yaw angles to stream.
+     *
+     * @param pitch_deg The pitch angle in degrees. Negative to point down.
+     * @param yaw_deg The yaw angle in degrees. Positive for clock-wise, range -180..180.
+     * @sa start_streaming()
+     */
+    void stream_pitch_and_yaw(float pitch_deg, float yaw_deg);
+
+    /**
+     * @brief Set the gimbal pitch and yaw rates to stream.
+     *
+     * The angles sent are moved on by the rates at every send, starting
+     * from the last angles sent.
+     *
+     * @param pitch_rate_deg_s The pitch rate in degrees per second. Negative to move down.
+     * @param yaw_rate_deg_s The yaw rate in degrees per second. Positive for clock-wise.
+     * @sa start_streaming()
+     */
+    void stream_pitch_and_yaw_rate(float pitch_rate_deg_s, float yaw_rate_deg_s);
+
+    /**
+     * @brief Set a region of interest (ROI) to track while streaming.
+     *
+     * Call it whenever a new position of the target is known. In between, the target is
+     * moved on with the velocity of the last two positions, for at most a second. The angles
+     * to it are computed from the position and attitude of the vehicle, so every send is an
+     * unacknowledged angle setpoint rather than a command. Until the vehicle position and
+     * attitude are known, the ROI is streamed instead.
+     *
+     * @param latitude_deg Latitude of the target in degrees.
+     * @param longitude_deg Longitude of the target in degrees.
+     * @param altitude_m Altitude of the target in meters (AMSL).
+     * @sa start_streaming()
+     */
+    void stream_roi_location(double latitude_deg, double longitude_deg, float altitude_m);
+
     /**
      * @brief Copy constructor (object is not copyable).
      */
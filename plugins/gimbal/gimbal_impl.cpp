@@ -2,10 +2,15 @@
 #include "mavlink_system.h"
 #include "global_include.h"
 #include "mavlink_include.h"
+#include "local_projection.h"
+#include <algorithm>
+#include <cmath>
 #include <functional>
 
 namespace dronecore {
 
+constexpr double GimbalImpl::MAX_ROI_PREDICTION_S;
+
 GimbalImpl::GimbalImpl(System &system) :
     PluginImplBase(system)
 {
@@ -17,13 +22,29 @@ GimbalImpl::~GimbalImpl()
     _parent->unregister_plugin(this);
 }
 
-void GimbalImpl::init() {}
+void GimbalImpl::init()
+{
+    using namespace std::placeholders; // for `_1`
+
+    // Only needed to point at an ROI, but cheap to keep up to date.
+    _parent->register_mavlink_message_handler<mavlink_global_position_int_t>(
+        std::bind(&GimbalImpl::process_global_position_int, this, _1), this);
+    _parent->register_mavlink_message_handler<mavlink_attitude_t>(
+        std::bind(&GimbalImpl::process_attitude, this, _1), this);
+}
 
-void GimbalImpl::deinit() {}
+void GimbalImpl::deinit()
+{
+    stop_streaming();
+    _parent->unregister_all_mavlink_message_handlers(this);
+}
 
 void GimbalImpl::enable() {}
 
-void GimbalImpl::disable() {}
+void GimbalImpl::disable()
+{
+    stop_streaming();
+}
 
 Gimbal::Result GimbalImpl::set_pitch_and_yaw(float pitch_deg, float yaw_deg)
 {
@@ -54,7 +75,7 @@ void GimbalImpl::set_pitch_and_yaw_async(float pitch_deg, float yaw_deg,
     command.target_component_id = _parent->get_autopilot_id();
 
     _parent->send_command_async(command, std::bind(&GimbalImpl::receive_command_result,
-                                                   std::placeholders::_1, callback));
+                                                   this, std::placeholders::_1, callback));
 }
 
 Gimbal::Result GimbalImpl::set_roi_location(double latitude_deg, double longitude_deg,
@@ -83,7 +104,177 @@ void GimbalImpl::set_roi_location_async(double latitude_deg, double longitude_de
     command.target_component_id = _parent->get_autopilot_id();
 
     _parent->send_command_async(command, std::bind(&GimbalImpl::receive_command_result,
-                                                   std::placeholders::_1, callback));
+                                                   this, std::placeholders::_1, callback));
+}
+
+Gimbal::Result GimbalImpl::start_streaming(float rate_hz)
+{
+    if (!std::isfinite(rate_hz) || rate_hz <= 0.0f) {
+        LogErr() << "Invalid gimbal stream rate: " << rate_hz << " Hz";
+        return Gimbal::Result::ERROR;
+    }
+
+    std::lock_guard<std::mutex> lock(_stream_mutex);
+    if (_stream_cookie) {
+        _parent->remove_call_every(_stream_cookie);
+        _stream_cookie = nullptr;
+    }
+    _last_stream_time = _time.steady_time();
+    _parent->add_call_every([this]() { send_stream_setpoint(); },
+    1.0f / rate_hz,
+    &_stream_cookie);
+    return Gimbal::Result::SUCCESS;
+}
+
+void GimbalImpl::stop_streaming()
+{
+    std::lock_guard<std::mutex> lock(_stream_mutex);
+    if (_stream_cookie) {
+        _parent->remove_call_every(_stream_cookie);
+        _stream_cookie = nullptr;
+    }
+}
+
+void GimbalImpl::stream_pitch_and_yaw(float pitch_deg, float yaw_deg)
+{
+    _stream_setpoint.update([pitch_deg, yaw_deg](StreamSetpoint &setpoint) {
+        setpoint.mode = StreamSetpoint::Mode::ANGLE;
+        setpoint.pitch = pitch_deg;
+        setpoint.yaw = yaw_deg;
+    });
+}
+
+void GimbalImpl::stream_pitch_and_yaw_rate(float pitch_rate_deg_s, float yaw_rate_deg_s)
+{
+    _stream_setpoint.update([pitch_rate_deg_s, yaw_rate_deg_s](StreamSetpoint &setpoint) {
+        setpoint.mode = StreamSetpoint::Mode::RATE;
+        setpoint.pitch = pitch_rate_deg_s;
+        setpoint.yaw = yaw_rate_deg_s;
+    });
+}
+
+void GimbalImpl::stream_roi_location(double latitude_deg, double longitude_deg, float altitude_m)
+{
+    const dl_time_t now = _time.steady_time();
+
+    _stream_setpoint.update([&](StreamSetpoint &setpoint) {
+        float velocity_north_m_s = 0.0f;
+        float velocity_east_m_s = 0.0f;
+        float velocity_up_m_s = 0.0f;
+
+        // The velocity only makes sense between positions close in time.
+        if (setpoint.mode == StreamSetpoint::Mode::ROI) {
+            const double dt_s = std::chrono::duration<double>(now - setpoint.time).count();
+            if (dt_s > 0.0 && dt_s <= MAX_ROI_PREDICTION_S) {
+                const LocalProjection projection(setpoint.latitude_deg, setpoint.longitude_deg);
+                velocity_north_m_s = float(projection.north_m(latitude_deg) / dt_s);
+                velocity_east_m_s = float(projection.east_m(longitude_deg) / dt_s);
+                velocity_up_m_s = float(double(altitude_m - setpoint.altitude_m) / dt_s);
+            }
+        }
+
+        setpoint.mode = StreamSetpoint::Mode::ROI;
+        setpoint.latitude_deg = latitude_deg;
+        setpoint.longitude_deg = longitude_deg;
+        setpoint.altitude_m = altitude_m;
+        setpoint.velocity_north_m_s = velocity_north_m_s;
+        setpoint.velocity_east_m_s = velocity_east_m_s;
+        setpoint.velocity_up_m_s = velocity_up_m_s;
+        setpoint.time = now;
+    });
+}
+
+void GimbalImpl::process_global_position_int(const mavlink_global_position_int_t
+                                             &global_position_int)
+{
+    _vehicle_state.update([&global_position_int](VehicleState &state) {
+        state.has_position = true;
+        state.latitude_deg = global_position_int.lat * 1e-7;
+        state.longitude_deg = global_position_int.lon * 1e-7;
+        state.altitude_m = global_position_int.alt * 1e-3f;
+    });
+}
+
+void GimbalImpl::process_attitude(const mavlink_attitude_t &attitude)
+{
+    _vehicle_state.update([&attitude](VehicleState &state) {
+        state.has_attitude = true;
+        state.yaw_deg = to_deg_from_rad(attitude.yaw);
+    });
+}
+
+bool GimbalImpl::angles_to_roi(double latitude_deg, double longitude_deg, float altitude_m,
+                               float &pitch_deg, float &yaw_deg) const
+{
+    const VehicleState vehicle = _vehicle_state.load();
+    if (!vehicle.has_position || !vehicle.has_attitude) {
+        return false;
+    }
+
+    const LocalProjection projection(vehicle.latitude_deg, vehicle.longitude_deg);
+    const double north_m = projection.north_m(latitude_deg);
+    const double east_m = projection.east_m(longitude_deg);
+    const double up_m = double(altitude_m - vehicle.altitude_m);
+
+    // The yaw of MAVLINK_TARGETING is relative to the heading of the vehicle.
+    pitch_deg = float(to_deg_from_rad(std::atan2(up_m, std::hypot(north_m, east_m))));
+    yaw_deg = std::remainder(float(to_deg_from_rad(std::atan2(east_m, north_m))) -
+                             vehicle.yaw_deg, 360.0f);
+    return true;
+}
+
+void GimbalImpl::send_stream_setpoint()
+{
+    const StreamSetpoint setpoint = _stream_setpoint.load();
+
+    const dl_time_t now = _time.steady_time();
+    const float dt_s = float(_time.elapsed_since_s(_last_stream_time));
+    _last_stream_time = now;
+
+    if (setpoint.mode == StreamSetpoint::Mode::ROI) {
+        const double prediction_s =
+            std::min(std::chrono::duration<double>(now - setpoint.time).count(),
+                     MAX_ROI_PREDICTION_S);
+        const LocalProjection projection(setpoint.latitude_deg, setpoint.longitude_deg);
+        const double latitude_deg =
+            projection.latitude_deg(double(setpoint.velocity_north_m_s) * prediction_s);
+        const double longitude_deg =
+            projection.longitude_deg(double(setpoint.velocity_east_m_s) * prediction_s);
+        const float altitude_m =
+            setpoint.altitude_m + setpoint.velocity_up_m_s * float(prediction_s);
+
+        if (!angles_to_roi(latitude_deg, longitude_deg, altitude_m,
+                           _stream_pitch_deg, _stream_yaw_deg)) {
+            // Without knowing where the vehicle is, the autopilot has to point at it.
+            // COMMAND_LONG only carries it as float, which is about a metre.
+            MAVLinkCommands::CommandLong command {};
+            command.command = MAV_CMD_DO_SET_ROI_LOCATION;
+            command.params.param5 = float(latitude_deg);
+            command.params.param6 = float(longitude_deg);
+            command.params.param7 = altitude_m;
+            command.target_component_id = _parent->get_autopilot_id();
+            _parent->send_command_unacked(command);
+            return;
+        }
+    } else if (setpoint.mode == StreamSetpoint::Mode::RATE) {
+        _stream_pitch_deg += setpoint.pitch * dt_s;
+        _stream_yaw_deg = std::remainder(_stream_yaw_deg + setpoint.yaw * dt_s, 360.0f);
+    } else {
+        _stream_pitch_deg = setpoint.pitch;
+        _stream_yaw_deg = setpoint.yaw;
+    }
+
+    const float roll_deg = 0.0f;
+    MAVLinkCommands::CommandLong command {};
+
+    command.command = MAV_CMD_DO_MOUNT_CONTROL;
+    command.params.param1 = _stream_pitch_deg;
+    command.params.param2 = roll_deg;
+    command.params.param3 = _stream_yaw_deg;
+    command.params.param7 = float(MAV_MOUNT_MODE_MAVLINK_TARGETING);
+    command.target_component_id = _parent->get_autopilot_id();
+
+    _parent->send_command_unacked(command);
 }
 
 void GimbalImpl::receive_command_result(MAVLinkCommands::Result command_result,
@@ -92,7 +283,9 @@ void GimbalImpl::receive_command_result(MAVLinkCommands::Result command_result,
     Gimbal::Result gimbal_result = gimbal_result_from_command_result(command_result);
 
     if (callback) {
-        callback(gimbal_result);
+        _parent->call_result_callback(this, [callback, gimbal_result]() {
+            callback(gimbal_result);
+        });
     }
 }
 
@@ -4,6 +4,9 @@
 #include "mavlink_system.h"
 #include "gimbal.h"
 #include "plugin_impl_base.h"
+#include "seqlock.h"
+#include "global_include.h"
+#include <mutex>
 
 namespace dronecore {
 
@@ -29,6 +32,12 @@ public:
     void set_roi_location_async(double latitude_deg, double longitude_deg, float altitude_m,
                                 Gimbal::result_callback_t callback);
 
+    Gimbal::Result start_streaming(float rate_hz);
+    void stop_streaming();
+    void stream_pitch_and_yaw(float pitch_deg, float yaw_deg);
+    void stream_pitch_and_yaw_rate(float pitch_rate_deg_s, float yaw_rate_deg_s);
+    void stream_roi_location(double latitude_deg, double longitude_deg, float altitude_m);
+
     // Non-copyable
     GimbalImpl(const GimbalImpl &) = delete;
     const GimbalImpl &operator=(const GimbalImpl &) = delete;
@@ -37,8 +46,68 @@ private:
     static Gimbal::Result gimbal_result_from_command_result(MAVLinkCommands::Result
                                                             command_result);
 
-    static void receive_command_result(MAVLinkCommands::Result command_result,
-                                       const Gimbal::result_callback_t &callback);
+    void receive_command_result(MAVLinkCommands::Result command_result,
+                                const Gimbal::result_callback_t &callback);
+
+    void send_stream_setpoint();
+    // Returns false if the vehicle position or attitude is not known yet.
+    bool angles_to_roi(double latitude_deg, double longitude_deg, float altitude_m,
+                       float &pitch_deg, float &yaw_deg) const;
+
+    void process_global_position_int(const mavlink_global_position_int_t &global_position_int);
+    void process_attitude(const mavlink_attitude_t &attitude);
+
+    struct StreamSetpoint {
+        enum class Mode {
+            ANGLE,
+            RATE,
+            ROI
+        } mode;
+        // In deg or deg/s.
+        float pitch;
+        float yaw;
+
+        // Of the target in ROI mode, with its velocity estimated from the last
+        // two positions and the time of the last one.
+        double latitude_deg;
+        double longitude_deg;
+        float altitude_m;
+        float velocity_north_m_s;
+        float velocity_east_m_s;
+        float velocity_up_m_s;
+        dl_time_t time;
+    };
+    // The latest setpoint, set without waiting for the sending.
+    SeqLock<StreamSetpoint> _stream_setpoint {
+        StreamSetpoint {
+            StreamSetpoint::Mode::ANGLE, 0.0f, 0.0f,
+            0.0, 0.0, 0.0f, 0.0f, 0.0f, 0.0f, dl_time_t {}
+        }
+    };
+
+    // How far the target is moved on past its last position.
+    static constexpr double MAX_ROI_PREDICTION_S = 1.0;
+
+    struct VehicleState {
+        bool has_position;
+        bool has_attitude;
+        double latitude_deg;
+        double longitude_deg;
+        float altitude_m;
+        float yaw_deg;
+    };
+    SeqLock<VehicleState> _vehicle_state {
+        VehicleState {false, false, 0.0, 0.0, 0.0f, 0.0f}
+    };
+
+    std::mutex _stream_mutex {};
+    void *_stream_cookie = nullptr;
+
+    // Only used by send_stream_setpoint().
+    Time _time {};
+    dl_time_t _last_stream_time {};
+    float _stream_pitch_deg = 0.0f;
+    float _stream_yaw_deg = 0.0f;
 };
 
 
@@ -33,4 +33,9 @@ Info::Product Info::get_product() const
     return _impl->get_product();
 }
 
+void Info::subscribe_info(info_callback_t callback)
+{
+    _impl->subscribe_info(callback);
+}
+
 } // namespace dronecore
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include "plugin_base.h"
 
@@ -97,6 +98,22 @@ public:
      */
     Product get_product() const;
 
+    /**
+     * @brief Callback type for system version and product information.
+     */
+    typedef std::function<void(Version version, Product product)> info_callback_t;
+
+    /**
+     * @brief Subscribe to system version and product information (asynchronous).
+     *
+     * The information is part of what the system sends when it is discovered, so there is no
+     * need to poll is_complete(). The callback is called once it is received, or right away if
+     * it already was, also on a connection earlier on.
+     *
+     * @param callback Function to call with the information, nullptr to unsubscribe.
+     */
+    void subscribe_info(info_callback_t callback);
+
     // Non-copyable
     /**
      * @brief Copy Constructor (object is not copyable).
@@ -23,13 +23,16 @@ void InfoImpl::init()
 {
     using namespace std::placeholders; // for `_1`
 
-    _parent->register_mavlink_message_handler(
-        MAVLINK_MSG_ID_HEARTBEAT,
-        std::bind(&InfoImpl::process_heartbeat, this, _1), this);
-
-    _parent->register_mavlink_message_handler(
-        MAVLINK_MSG_ID_AUTOPILOT_VERSION,
+    // The system requests AUTOPILOT_VERSION itself until it has it, for the
+    // UUID, so we only need to listen. If it came before the plugin was made,
+    // the system still has it.
+    _parent->register_mavlink_message_handler<mavlink_autopilot_version_t>(
         std::bind(&InfoImpl::process_autopilot_version, this, _1), this);
+
+    mavlink_autopilot_version_t autopilot_version;
+    if (_parent->get_autopilot_version(autopilot_version)) {
+        process_autopilot_version(autopilot_version);
+    }
 }
 
 void InfoImpl::deinit()
@@ -41,24 +44,8 @@ void InfoImpl::enable() {}
 
 void InfoImpl::disable() {}
 
-void InfoImpl::process_heartbeat(const mavlink_message_t &message)
+void InfoImpl::process_autopilot_version(const mavlink_autopilot_version_t &autopilot_version)
 {
-    UNUSED(message);
-
-    if (!is_complete()) {
-        // We try to request more info if not all info is available.
-        // We can't rely on System to request the autopilot_version,
-        // so we do it here, anyway.
-        _parent->request_autopilot_version();
-    }
-}
-
-void InfoImpl::process_autopilot_version(const mavlink_message_t &message)
-{
-    mavlink_autopilot_version_t autopilot_version;
-
-    mavlink_msg_autopilot_version_decode(&message, &autopilot_version);
-
     Info::Version version {};
 
     version.flight_sw_major = (autopilot_version.flight_sw_version >> (8 * 3)) & 0xFF;
@@ -111,9 +98,39 @@ void InfoImpl::process_autopilot_version(const mavlink_message_t &message)
     STRNCPY(product.product_name, product_name, sizeof(product.product_name));
 
     set_product(product);
+    _received = true;
+
+    report_info();
+}
+
+void InfoImpl::subscribe_info(Info::info_callback_t callback)
+{
+    {
+        std::lock_guard<std::mutex> lock(_subscription_mutex);
+        _info_callback = callback;
+    }
+
+    if (_received) {
+        report_info();
+    }
+}
+
+void InfoImpl::report_info()
+{
+    std::lock_guard<std::mutex> lock(_subscription_mutex);
+    if (_info_callback == nullptr) {
+        return;
+    }
+
+    const Info::info_callback_t callback = _info_callback;
+    const Info::Version version = get_version();
+    const Info::Product product = get_product();
+    _parent->call_user_callback(this, &_info_callback, [callback, version, product]() {
+        callback(version, product);
+    });
 }
 
-void InfoImpl::translate_binary_to_str(uint8_t *binary, unsigned binary_len,
+void InfoImpl::translate_binary_to_str(const uint8_t *binary, unsigned binary_len,
                                        char *str, unsigned str_len)
 {
     for (unsigned i = 0; i < binary_len; ++i) {
@@ -3,6 +3,7 @@
 #include "info.h"
 #include "mavlink_include.h"
 #include "plugin_impl_base.h"
+#include <atomic>
 #include <mutex>
 
 namespace dronecore {
@@ -24,12 +25,19 @@ public:
     Info::Version get_version() const;
     Info::Product get_product() const;
 
+    void subscribe_info(Info::info_callback_t callback);
+
 private:
     void set_version(Info::Version version);
     void set_product(Info::Product product);
+    void report_info();
+
+    void process_autopilot_version(const mavlink_autopilot_version_t &autopilot_version);
+
+    std::atomic<bool> _received {false};
 
-    void process_heartbeat(const mavlink_message_t &message);
-    void process_autopilot_version(const mavlink_message_t &message);
+    std::mutex _subscription_mutex {};
+    Info::info_callback_t _info_callback = nullptr;
 
     mutable std::mutex _version_mutex;
     Info::Version _version = {};
@@ -40,7 +48,7 @@ private:
     static const char *vendor_id_str(uint16_t vendor_id);
     static const char *product_id_str(uint16_t product_id);
 
-    static void translate_binary_to_str(uint8_t *binary, unsigned binary_len,
+    static void translate_binary_to_str(const uint8_t *binary, unsigned binary_len,
                                         char *str, unsigned str_len);
 };
 
@@ -3,6 +3,8 @@
 
 namespace dronecore {
 
+constexpr unsigned Logging::MAX_TOPIC_FIELDS;
+
 Logging::Logging(System &system) :
     PluginBase(),
     _impl { new LoggingImpl(system) }
@@ -23,6 +25,11 @@ Logging::Result Logging::stop_logging() const
     return _impl->stop_logging();
 }
 
+Logging::Result Logging::start_logging_to_file(const std::string &path)
+{
+    return _impl->start_logging_to_file(path);
+}
+
 void Logging::start_logging_async(result_callback_t callback)
 {
     _impl->start_logging_async(callback);
@@ -33,6 +40,39 @@ void Logging::stop_logging_async(result_callback_t callback)
     _impl->stop_logging_async(callback);
 }
 
+Logging::StreamStats Logging::get_stream_stats() const
+{
+    return _impl->get_stream_stats();
+}
+
+void Logging::get_log_list_async(log_list_callback_t callback)
+{
+    _impl->get_log_list_async(callback);
+}
+
+void Logging::download_log_async(LogEntry entry, const std::string &path,
+                                 download_callback_t callback)
+{
+    _impl->download_log_async(entry, path, callback);
+}
+
+Logging::Result Logging::enable_topic_stream(const std::string &topic,
+                                             const std::vector<std::string> &fields,
+                                             size_t capacity)
+{
+    return _impl->enable_topic_stream(topic, fields, capacity);
+}
+
+size_t Logging::drain_topic_stream(const std::string &topic, std::vector<TopicSample> &samples)
+{
+    return _impl->drain_topic_stream(topic, samples);
+}
+
+uint64_t Logging::topic_stream_dropped(const std::string &topic) const
+{
+    return _impl->topic_stream_dropped(topic);
+}
+
 const char *Logging::result_str(Result result)
 {
     switch (result) {
@@ -48,6 +88,12 @@ const char *Logging::result_str(Result result)
             return "Command denied";
         case Result::TIMEOUT:
             return "Timeout";
+        case Result::FILE_IO_ERROR:
+            return "File IO error";
+        case Result::IN_PROGRESS:
+            return "In progress";
+        case Result::INVALID_ARGUMENT:
+            return "Invalid argument";
         case Result::UNKNOWN:
         default:
             return "Unknown";
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 #include "plugin_base.h"
 
 namespace dronecore {
@@ -11,8 +15,6 @@ class System;
 
 /**
  * @brief The Logging class allows log data using logger and log streaming from the vehicle.
- *
- * **This feature is not yet implemented**.
  */
 class Logging : public PluginBase
 {
@@ -45,6 +47,9 @@ public:
         BUSY, /**< @brief %System busy. */
         COMMAND_DENIED, /**< @brief Command denied. */
         TIMEOUT, /**< @brief Timeout. */
+        FILE_IO_ERROR, /**< @brief Log file could not be created. */
+        IN_PROGRESS, /**< @brief Download is still going on. */
+        INVALID_ARGUMENT, /**< @brief Invalid argument, e.g. too many fields. */
         UNKNOWN /**< @brief Unknown error. */
     };
 
@@ -64,8 +69,6 @@ public:
     /**
      * @brief Start logging (synchronous).
      *
-     * **This feature is not yet implemented**.
-     *
      * @return Result of request.
      */
     Result start_logging() const;
@@ -73,16 +76,25 @@ public:
     /**
      * @brief Stop logging (synchronous).
      *
-     * **This feature is not yet implemented**.
+     * This also closes the log file, if any.
      *
      * @return Result of request.
      */
     Result stop_logging() const;
 
     /**
-     * @brief Start logging (asynchronous).
+     * @brief Start logging and stream the log to a file (synchronous).
      *
-     * **This feature is not yet implemented**.
+     * The vehicle sends its ULog log over MAVLink as it is written. Lost parts are
+     * marked as dropouts, so that the file can be read as ULog file still.
+     *
+     * @param path Path of the ULog file to create.
+     * @return Result of request.
+     */
+    Result start_logging_to_file(const std::string &path);
+
+    /**
+     * @brief Start logging (asynchronous).
      *
      * @param callback Callback to get result of request.
      */
@@ -91,12 +103,139 @@ public:
     /**
      * @brief Stop logging (asynchronous).
      *
-     * **This feature is not yet implemented**.
+     * This also closes the log file, if any.
      *
      * @param callback Callback to get result of request.
      */
     void stop_logging_async(result_callback_t callback);
 
+    /**
+     * @brief Statistics of the log streamed to a file.
+     */
+    struct StreamStats {
+        uint64_t num_bytes; /**< @brief Bytes written to the file. */
+        uint64_t num_dropped_messages; /**< @brief Messages lost on the link. */
+        uint64_t num_dropped_bytes; /**< @brief Bytes left out as the disk was too slow. */
+    };
+
+    /**
+     * @brief Get the statistics of the log streamed to a file.
+     *
+     * @return Statistics since start_logging_to_file().
+     */
+    StreamStats get_stream_stats() const;
+
+    /**
+     * @brief A log file stored on the vehicle.
+     */
+    struct LogEntry {
+        uint16_t id; /**< @brief Id of the log on the vehicle. */
+        uint32_t time_utc_s; /**< @brief UTC time of the log in seconds since 1970, 0 if not
+                                  known. */
+        uint32_t size_bytes; /**< @brief Size of the log in bytes. */
+    };
+
+    /**
+     * @brief Callback type for the list of logs.
+     */
+    typedef std::function<void(Result, std::vector<LogEntry>)> log_list_callback_t;
+
+    /**
+     * @brief Get the list of logs stored on the vehicle (asynchronous).
+     *
+     * @param callback Callback to get the result and the logs, sorted by id.
+     */
+    void get_log_list_async(log_list_callback_t callback);
+
+    /**
+     * @brief Progress of a log download.
+     */
+    struct DownloadProgress {
+        uint32_t bytes_received; /**< @brief Bytes received so far. */
+        uint32_t total_bytes; /**< @brief Size of the log. */
+    };
+
+    /**
+     * @brief Callback type for log downloads.
+     */
+    typedef std::function<void(Result, DownloadProgress)> download_callback_t;
+
+    /**
+     * @brief Download a log stored on the vehicle to a file (asynchronous).
+     *
+     * This works over any link, also without a network to the vehicle. The log is asked
+     * for in large windows which the vehicle sends without waiting, and what got lost is
+     * asked for again afterwards. The file is allocated to the size of the log up front and
+     * every part is written in its place.
+     *
+     * The callback is called with IN_PROGRESS as the log comes in, and a last time with the
+     * result. A log which could not be downloaded completely is removed.
+     *
+     * @param entry Log as in the list of logs, see get_log_list_async().
+     * @param path Path of the file to create.
+     * @param callback Callback to get the progress and the result.
+     */
+    void download_log_async(LogEntry entry, const std::string &path,
+                            download_callback_t callback);
+
+    /**
+     * @brief Most fields which can be decoded of one topic.
+     */
+    static constexpr unsigned MAX_TOPIC_FIELDS = 16;
+
+    /**
+     * @brief A message of a ULog topic, decoded from the log stream.
+     */
+    struct TopicSample {
+        uint64_t timestamp_us; /**< @brief Timestamp of the vehicle, 0 if the topic has none. */
+        uint8_t multi_id; /**< @brief Instance of the topic. */
+        /**
+         * @brief Values of the fields in the order asked for, NAN for fields which the
+         * topic does not have and the ones which were not asked for.
+         */
+        double values[MAX_TOPIC_FIELDS];
+    };
+
+    /**
+     * @brief Decode a ULog topic of the log stream into a queue to be drained in batches.
+     *
+     * While the log is streamed, see start_logging_to_file(), this gives topics at the rates
+     * they are logged at, which can be much higher than telemetry, e.g. the full estimator
+     * state. Only topics which are enabled are decoded; the others cost a lookup per message.
+     * Samples arriving while the queue is full are dropped and counted, see
+     * topic_stream_dropped().
+     *
+     * Topics can be enabled before or during streaming, the formats of the stream are kept
+     * from its start on.
+     *
+     * @param topic Name of the topic, e.g. "estimator_states".
+     * @param fields Fields to decode, named as in the format, e.g. "states[3]" for an
+     *        element of an array or "outer.inner" for a field of a nested format.
+     * @param capacity Number of samples the queue can hold, 0 to turn the topic off.
+     * @return Result of request, INVALID_ARGUMENT for more than MAX_TOPIC_FIELDS fields.
+     */
+    Result enable_topic_stream(const std::string &topic, const std::vector<std::string> &fields,
+                               size_t capacity);
+
+    /**
+     * @brief Move all queued samples of a topic out, oldest first.
+     *
+     * Only one thread at a time may drain a topic.
+     *
+     * @param topic Name of the topic.
+     * @param samples Vector the samples are appended to.
+     * @return Number of samples appended.
+     */
+    size_t drain_topic_stream(const std::string &topic, std::vector<TopicSample> &samples);
+
+    /**
+     * @brief Number of samples of a topic dropped because the queue was full.
+     *
+     * @param topic Name of the topic.
+     * @return Dropped samples since the topic was enabled.
+     */
+    uint64_t topic_stream_dropped(const std::string &topic) const;
+
     // Non-copyable
     /**
      * @brief Copy constructor (object is not copyable).
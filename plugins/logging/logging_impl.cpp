@@ -3,11 +3,26 @@
 #include "dronecore_impl.h"
 #include "px4_custom_mode.h"
 
+#ifndef WINDOWS
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
 namespace dronecore {
 
+constexpr uint32_t LoggingImpl::WINDOW_LEN;
+constexpr double LoggingImpl::TIMEOUT_S;
+constexpr unsigned LoggingImpl::MAX_RETRIES;
+
 LoggingImpl::LoggingImpl(System &system) :
     PluginImplBase(system)
 {
+    _stream_writer.set_decoder(&_topic_decoder);
     _parent->register_plugin(this);
 }
 
@@ -27,17 +42,43 @@ void LoggingImpl::init()
     _parent->register_mavlink_message_handler(
         MAVLINK_MSG_ID_LOGGING_DATA_ACKED,
         std::bind(&LoggingImpl::process_logging_data_acked, this, _1), this);
+
+    _parent->register_mavlink_message_handler(
+        MAVLINK_MSG_ID_LOG_ENTRY,
+        std::bind(&LoggingImpl::process_log_entry, this, _1), this);
+
+    _parent->register_mavlink_message_handler(
+        MAVLINK_MSG_ID_LOG_DATA,
+        std::bind(&LoggingImpl::process_log_data, this, _1), this);
 }
 
 void LoggingImpl::deinit()
 {
     _parent->unregister_all_mavlink_message_handlers(this);
+    close_stream();
+
+    std::unique_lock<std::mutex> lock(_log_mutex);
+    if (_list.is_active) {
+        finish_list(lock, Logging::Result::UNKNOWN);
+        lock.lock();
+    }
+    if (_download.is_active) {
+        finish_download(lock, Logging::Result::UNKNOWN);
+    }
 }
 
 void LoggingImpl::enable() {}
 
 void LoggingImpl::disable() {}
 
+void LoggingImpl::add_resource_usage(DroneCore::ResourceUsage &usage)
+{
+    // The writer has a thread while a file is open.
+    if (_stream_writer.is_open()) {
+        ++usage.num_threads;
+    }
+}
+
 Logging::Result LoggingImpl::start_logging() const
 {
     MAVLinkCommands::CommandLong command {};
@@ -49,8 +90,27 @@ Logging::Result LoggingImpl::start_logging() const
     return logging_result_from_command_result(_parent->send_command(command));
 }
 
-Logging::Result LoggingImpl::stop_logging() const
+Logging::Result LoggingImpl::start_logging_to_file(const std::string &path)
 {
+    {
+        std::lock_guard<std::mutex> lock(_stream_mutex);
+        if (!_stream_writer.open(path)) {
+            return Logging::Result::FILE_IO_ERROR;
+        }
+    }
+
+    Logging::Result result = start_logging();
+    if (result != Logging::Result::SUCCESS) {
+        close_stream();
+    }
+    return result;
+}
+
+Logging::Result LoggingImpl::stop_logging()
+{
+    // What still comes after the stop is not needed.
+    close_stream();
+
     MAVLinkCommands::CommandLong command {};
 
     command.command = MAV_CMD_LOGGING_STOP;
@@ -75,6 +135,8 @@ void LoggingImpl::start_logging_async(const Logging::result_callback_t &callback
 
 void LoggingImpl::stop_logging_async(const Logging::result_callback_t &callback)
 {
+    close_stream();
+
     MAVLinkCommands::CommandLong command {};
 
     command.command = MAV_CMD_LOGGING_STOP;
@@ -90,6 +152,12 @@ void LoggingImpl::process_logging_data(const mavlink_message_t &message)
 {
     mavlink_logging_data_t logging_data;
     mavlink_msg_logging_data_decode(&message, &logging_data);
+
+    std::unique_lock<std::mutex> lock(_stream_mutex, std::try_to_lock);
+    if (lock.owns_lock()) {
+        _stream_writer.add(logging_data.sequence, logging_data.first_message_offset,
+                           logging_data.data, logging_data.length);
+    }
 }
 
 void LoggingImpl::process_logging_data_acked(const mavlink_message_t &message)
@@ -97,6 +165,7 @@ void LoggingImpl::process_logging_data_acked(const mavlink_message_t &message)
     mavlink_logging_data_acked_t logging_data_acked;
     mavlink_msg_logging_data_acked_decode(&message, &logging_data_acked);
 
+    // The vehicle holds back the next ones until it has the ack.
     mavlink_message_t answer;
     mavlink_msg_logging_ack_pack(GCSClient::system_id,
                                  GCSClient::component_id,
@@ -106,6 +175,389 @@ void LoggingImpl::process_logging_data_acked(const mavlink_message_t &message)
                                  logging_data_acked.sequence);
 
     _parent->send_message(answer);
+
+    std::unique_lock<std::mutex> lock(_stream_mutex, std::try_to_lock);
+    if (lock.owns_lock()) {
+        _stream_writer.add(logging_data_acked.sequence, logging_data_acked.first_message_offset,
+                           logging_data_acked.data, logging_data_acked.length);
+    }
+}
+
+void LoggingImpl::close_stream()
+{
+    std::lock_guard<std::mutex> lock(_stream_mutex);
+    _stream_writer.close();
+}
+
+Logging::StreamStats LoggingImpl::get_stream_stats() const
+{
+    // Made of atomics. Taking _stream_mutex would make the receive thread skip
+    // data while the user polls.
+    const ULogStreamWriter::Stats stats = _stream_writer.stats();
+    return Logging::StreamStats {stats.num_bytes, stats.num_dropped_messages,
+                                 stats.num_dropped_bytes};
+}
+
+Logging::Result LoggingImpl::enable_topic_stream(const std::string &topic,
+                                                 const std::vector<std::string> &fields,
+                                                 size_t capacity)
+{
+    return _topic_decoder.enable(topic, fields, capacity) ? Logging::Result::SUCCESS :
+           Logging::Result::INVALID_ARGUMENT;
+}
+
+size_t LoggingImpl::drain_topic_stream(const std::string &topic,
+                                       std::vector<Logging::TopicSample> &samples)
+{
+    return _topic_decoder.drain(topic, samples);
+}
+
+uint64_t LoggingImpl::topic_stream_dropped(const std::string &topic) const
+{
+    return _topic_decoder.dropped(topic);
+}
+
+void LoggingImpl::get_log_list_async(const Logging::log_list_callback_t &callback)
+{
+    std::unique_lock<std::mutex> lock(_log_mutex);
+
+    if (_list.is_active) {
+        lock.unlock();
+        if (callback) {
+            callback(Logging::Result::BUSY, std::vector<Logging::LogEntry> {});
+        }
+        return;
+    }
+
+    _list.is_active = true;
+    _list.callback = callback;
+
+    _parent->register_timeout_handler(std::bind(&LoggingImpl::process_list_timeout, this),
+                                      TIMEOUT_S, &_list_timeout_cookie);
+    request_log_list();
+}
+
+void LoggingImpl::download_log_async(Logging::LogEntry entry, const std::string &path,
+                                     const Logging::download_callback_t &callback)
+{
+    std::unique_lock<std::mutex> lock(_log_mutex);
+
+    if (_download.is_active) {
+        lock.unlock();
+        if (callback) {
+            callback(Logging::Result::BUSY, Logging::DownloadProgress {0, entry.size_bytes});
+        }
+        return;
+    }
+
+    int fd = -1;
+    if (!create_log_file(path, entry.size_bytes, fd)) {
+        lock.unlock();
+        if (callback) {
+            callback(Logging::Result::FILE_IO_ERROR,
+                     Logging::DownloadProgress {0, entry.size_bytes});
+        }
+        return;
+    }
+
+    _download.is_active = true;
+    _download.entry = entry;
+    _download.path = path;
+    _download.callback = callback;
+    _download.fd = fd;
+
+    _parent->register_timeout_handler(std::bind(&LoggingImpl::process_download_timeout, this),
+                                      TIMEOUT_S, &_download_timeout_cookie);
+    report_progress();
+    request_next_window(lock);
+}
+
+void LoggingImpl::process_log_entry(const mavlink_message_t &message)
+{
+    mavlink_log_entry_t log_entry;
+    mavlink_msg_log_entry_decode(&message, &log_entry);
+
+    std::unique_lock<std::mutex> lock(_log_mutex);
+
+    if (!_list.is_active) {
+        return;
+    }
+
+    // Without logs, the one entry only tells that.
+    if (log_entry.num_logs == 0) {
+        finish_list(lock, Logging::Result::SUCCESS);
+        return;
+    }
+
+    _list.num_logs = log_entry.num_logs;
+    _list.entries[log_entry.id] = Logging::LogEntry {
+        log_entry.id, log_entry.time_utc, log_entry.size
+    };
+    _list.retries = 0;
+    _parent->refresh_timeout_handler(_list_timeout_cookie);
+
+    if (_list.entries.size() >= size_t(_list.num_logs)) {
+        finish_list(lock, Logging::Result::SUCCESS);
+    }
+}
+
+void LoggingImpl::process_log_data(const mavlink_message_t &message)
+{
+    mavlink_log_data_t log_data;
+    mavlink_msg_log_data_decode(&message, &log_data);
+
+    std::unique_lock<std::mutex> lock(_log_mutex);
+
+    if (!_download.is_active || log_data.id != _download.entry.id) {
+        return;
+    }
+
+    _download.retries = 0;
+    _parent->refresh_timeout_handler(_download_timeout_cookie);
+
+    const uint32_t offset = log_data.ofs;
+    uint32_t &size = _download.entry.size_bytes;
+
+    // Nothing at an offset within the size means that the log is shorter.
+    if (log_data.count == 0) {
+        if (offset < size) {
+            size = offset;
+#ifndef WINDOWS
+            if (ftruncate(_download.fd, off_t(size)) != 0) {
+                finish_download(lock, Logging::Result::FILE_IO_ERROR);
+                return;
+            }
+#endif
+        }
+        request_next_window(lock);
+        return;
+    }
+
+    if (offset >= size) {
+        return;
+    }
+
+    const uint32_t count = std::min<uint32_t>(
+                               std::min<uint32_t>(log_data.count, sizeof(log_data.data)),
+                               size - offset);
+#ifndef WINDOWS
+    // Every part goes to its place, so nothing needs to be held back for the
+    // parts before it which got lost.
+    if (pwrite(_download.fd, log_data.data, count, off_t(offset)) != ssize_t(count)) {
+        LogErr() << "Could not write " << _download.path << ": " << strerror(errno);
+        finish_download(lock, Logging::Result::FILE_IO_ERROR);
+        return;
+    }
+#endif
+    _download.received.add(offset, offset + count);
+    _download.stream_end = std::max(_download.stream_end, offset + count);
+    report_progress();
+
+    if (offset + count >= _download.request_end) {
+        request_next_window(lock);
+    }
+}
+
+void LoggingImpl::process_list_timeout()
+{
+    std::unique_lock<std::mutex> lock(_log_mutex);
+
+    if (!_list.is_active) {
+        return;
+    }
+
+    if (_list.retries++ >= MAX_RETRIES) {
+        LogWarn() << "Log list timed out";
+        finish_list(lock, Logging::Result::TIMEOUT);
+        return;
+    }
+
+    _parent->register_timeout_handler(std::bind(&LoggingImpl::process_list_timeout, this),
+                                      TIMEOUT_S, &_list_timeout_cookie);
+    request_log_list();
+}
+
+void LoggingImpl::process_download_timeout()
+{
+    std::unique_lock<std::mutex> lock(_log_mutex);
+
+    if (!_download.is_active) {
+        return;
+    }
+
+    if (_download.retries++ >= MAX_RETRIES) {
+        LogWarn() << "Download of log " << _download.entry.id << " timed out";
+        finish_download(lock, Logging::Result::TIMEOUT);
+        return;
+    }
+
+    _parent->register_timeout_handler(std::bind(&LoggingImpl::process_download_timeout, this),
+                                      TIMEOUT_S, &_download_timeout_cookie);
+    // The end of the window got lost, what is missing before it is asked for
+    // again later.
+    request_next_window(lock);
+}
+
+void LoggingImpl::request_log_list()
+{
+    // We assume that we already acquired _log_mutex in this function.
+
+    mavlink_message_t message;
+    mavlink_msg_log_request_list_pack(GCSClient::system_id,
+                                      GCSClient::component_id,
+                                      &message,
+                                      _parent->get_system_id(),
+                                      _parent->get_autopilot_id(),
+                                      0,
+                                      UINT16_MAX);
+    _parent->send_message(message);
+}
+
+void LoggingImpl::request_next_window(std::unique_lock<std::mutex> &lock)
+{
+    const uint32_t size = _download.entry.size_bytes;
+
+    // All of the log is asked for once before anything that got lost.
+    if (_download.stream_end < size) {
+        request_data(_download.stream_end, std::min(size - _download.stream_end, WINDOW_LEN));
+        return;
+    }
+
+    uint32_t begin, end;
+    if (!_download.received.first_gap(size, begin, end)) {
+        finish_download(lock, Logging::Result::SUCCESS);
+        return;
+    }
+    request_data(begin, std::min(end - begin, WINDOW_LEN));
+}
+
+void LoggingImpl::request_data(uint32_t offset, uint32_t len)
+{
+    // We assume that we already acquired _log_mutex in this function.
+
+    _download.request_end = offset + len;
+
+    mavlink_message_t message;
+    mavlink_msg_log_request_data_pack(GCSClient::system_id,
+                                      GCSClient::component_id,
+                                      &message,
+                                      _parent->get_system_id(),
+                                      _parent->get_autopilot_id(),
+                                      _download.entry.id,
+                                      offset,
+                                      len);
+    _parent->send_message(message);
+}
+
+void LoggingImpl::report_progress()
+{
+    // We assume that we already acquired _log_mutex in this function.
+
+    const uint32_t bytes_received = _download.received.num_bytes();
+    const uint32_t total_bytes = _download.entry.size_bytes;
+    const int percentage = (total_bytes > 0) ?
+                           int(uint64_t(bytes_received) * 100 / total_bytes) : 100;
+    if (percentage == _download.reported_percentage || !_download.callback) {
+        return;
+    }
+    _download.reported_percentage = percentage;
+
+    const Logging::download_callback_t callback = _download.callback;
+    _parent->call_user_callback(this, &_download, [callback, bytes_received, total_bytes]() {
+        callback(Logging::Result::IN_PROGRESS,
+                 Logging::DownloadProgress {bytes_received, total_bytes});
+    });
+}
+
+void LoggingImpl::finish_list(std::unique_lock<std::mutex> &lock, Logging::Result result)
+{
+    _parent->unregister_timeout_handler(_list_timeout_cookie);
+
+    auto entries = std::make_shared<std::vector<Logging::LogEntry>>();
+    for (const auto &entry : _list.entries) {
+        entries->push_back(entry.second);
+    }
+    const Logging::log_list_callback_t callback = std::move(_list.callback);
+    _list = LogList {};
+
+    lock.unlock();
+    if (callback) {
+        _parent->call_user_callback(this, &_list, [callback, result, entries]() {
+            callback(result, *entries);
+        }, CallbackExecutor::Overflow::BLOCK);
+    }
+}
+
+void LoggingImpl::finish_download(std::unique_lock<std::mutex> &lock, Logging::Result result)
+{
+    _parent->unregister_timeout_handler(_download_timeout_cookie);
+
+    // The vehicle stops sending, and e.g. ArduPilot only logs again after this.
+    mavlink_message_t message;
+    mavlink_msg_log_request_end_pack(GCSClient::system_id,
+                                     GCSClient::component_id,
+                                     &message,
+                                     _parent->get_system_id(),
+                                     _parent->get_autopilot_id());
+    _parent->send_message(message);
+
+#ifndef WINDOWS
+    if (_download.fd >= 0) {
+        if (::close(_download.fd) != 0 && result == Logging::Result::SUCCESS) {
+            result = Logging::Result::FILE_IO_ERROR;
+        }
+    }
+#endif
+    if (result != Logging::Result::SUCCESS) {
+        remove(_download.path.c_str());
+    }
+
+    const Logging::download_callback_t callback = std::move(_download.callback);
+    const Logging::DownloadProgress progress {
+        _download.received.num_bytes(), _download.entry.size_bytes
+    };
+    _download = Download {};
+
+    lock.unlock();
+    if (callback) {
+        // After the progress, which is called the same way.
+        _parent->call_user_callback(this, &_download, [callback, result, progress]() {
+            callback(result, progress);
+        }, CallbackExecutor::Overflow::BLOCK);
+    }
+}
+
+bool LoggingImpl::create_log_file(const std::string &path, uint32_t size, int &fd)
+{
+#ifdef WINDOWS
+    UNUSED(path);
+    UNUSED(size);
+    UNUSED(fd);
+    LogErr() << "Log download is not supported on Windows";
+    return false;
+#else
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        LogErr() << "Could not create " << path << ": " << strerror(errno);
+        return false;
+    }
+
+    // Allocated up front, so that the disk is not full half way through and
+    // the writes into the middle do not fragment the file.
+    int error = EINVAL;
+#ifdef __linux__
+    error = (size > 0) ? posix_fallocate(fd, 0, off_t(size)) : 0;
+#endif
+    // Not all file systems can, the writes then allocate as they come.
+    if (error != 0 && ftruncate(fd, off_t(size)) != 0) {
+        LogErr() << "Could not allocate " << path << ": " << strerror(errno);
+        ::close(fd);
+        remove(path.c_str());
+        fd = -1;
+        return false;
+    }
+    return true;
+#endif
 }
 
 Logging::Result
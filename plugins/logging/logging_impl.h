@@ -5,6 +5,13 @@
 #include "system.h"
 #include "mavlink_system.h"
 #include "logging.h"
+#include "ulog_stream_writer.h"
+#include "ulog_topic_decoder.h"
+#include "received_ranges.h"
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
 
 namespace dronecore {
 
@@ -19,21 +26,101 @@ public:
 
     void enable() override;
     void disable() override;
+    void add_resource_usage(DroneCore::ResourceUsage &usage) override;
 
     Logging::Result start_logging() const;
-    Logging::Result stop_logging() const;
+    Logging::Result stop_logging();
+    Logging::Result start_logging_to_file(const std::string &path);
 
     void start_logging_async(const Logging::result_callback_t &callback);
     void stop_logging_async(const Logging::result_callback_t &callback);
 
+    Logging::StreamStats get_stream_stats() const;
+
+    void get_log_list_async(const Logging::log_list_callback_t &callback);
+    void download_log_async(Logging::LogEntry entry, const std::string &path,
+                            const Logging::download_callback_t &callback);
+
+    Logging::Result enable_topic_stream(const std::string &topic,
+                                        const std::vector<std::string> &fields,
+                                        size_t capacity);
+    size_t drain_topic_stream(const std::string &topic,
+                              std::vector<Logging::TopicSample> &samples);
+    uint64_t topic_stream_dropped(const std::string &topic) const;
+
 private:
     void process_logging_data(const mavlink_message_t &message);
     void process_logging_data_acked(const mavlink_message_t &message);
 
+    void process_log_entry(const mavlink_message_t &message);
+    void process_log_data(const mavlink_message_t &message);
+    void process_list_timeout();
+    void process_download_timeout();
+
+    // We assume that we already acquired _log_mutex in these functions.
+    void request_log_list();
+    void request_next_window(std::unique_lock<std::mutex> &lock);
+    void request_data(uint32_t offset, uint32_t len);
+    void report_progress();
+
+    // These take the lock so that the callback can be called without it.
+    void finish_list(std::unique_lock<std::mutex> &lock, Logging::Result result);
+    void finish_download(std::unique_lock<std::mutex> &lock, Logging::Result result);
+
+    static bool create_log_file(const std::string &path, uint32_t size, int &fd);
+
     static Logging::Result logging_result_from_command_result(MAVLinkCommands::Result result);
 
     static void command_result_callback(MAVLinkCommands::Result command_result,
                                         const Logging::result_callback_t &callback);
+
+    void close_stream();
+
+    // The receive thread only tries to take it, so that opening and closing the
+    // file never holds it up.
+    std::mutex _stream_mutex {};
+    ULogStreamWriter _stream_writer {};
+    // Fed by the writer, which splits the stream into messages also when no
+    // file is open.
+    ULogTopicDecoder _topic_decoder {};
+
+    std::mutex _log_mutex {};
+
+    struct LogList {
+        bool is_active = false;
+        Logging::log_list_callback_t callback {};
+        // By id, as they can come more than once.
+        std::map<uint16_t, Logging::LogEntry> entries {};
+        // Unknown until the first entry came.
+        int num_logs = -1;
+        unsigned retries = 0;
+    } _list {};
+
+    struct Download {
+        bool is_active = false;
+        Logging::LogEntry entry {};
+        std::string path {};
+        Logging::download_callback_t callback {};
+        int fd = -1;
+
+        // Up to where the log was asked for, from the start or after a gap.
+        uint32_t request_end = 0;
+        // Up to where the log came in order, what is missing before it is
+        // asked for again once all of it was asked for once.
+        uint32_t stream_end = 0;
+
+        ReceivedRanges received {};
+        int reported_percentage = -1;
+        unsigned retries = 0;
+    } _download {};
+
+    // The vehicle sends all of a window without waiting, so it is large enough
+    // for the round trip between windows not to matter.
+    static constexpr uint32_t WINDOW_LEN = 90 * 1024;
+    static constexpr double TIMEOUT_S = 0.5;
+    static constexpr unsigned MAX_RETRIES = 5;
+    void *_list_timeout_cookie = nullptr;
+    void *_download_timeout_cookie = nullptr;
 };
 
 } // namespace dronecore
@@ -0,0 +1,401 @@
+#include "ulog_reader.h"
+#include "global_include.h"
+#include "log.h"
+
+#ifndef WINDOWS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace dronecore {
+
+constexpr uint64_t ULogReader::INDEX_INTERVAL;
+constexpr size_t ULogReader::FILE_HEADER_LEN;
+constexpr size_t ULogReader::MESSAGE_HEADER_LEN;
+constexpr size_t ULogReader::NUM_APPENDED_OFFSETS;
+
+namespace {
+
+const uint8_t MAGIC[] = {'U', 'L', 'o', 'g', 0x01, 0x12, 0x35};
+
+// Bit 0 of the first incompatible flag: data is appended at the given offsets.
+const uint8_t INCOMPAT_FLAG0_DATA_APPENDED = 0x01;
+const size_t NUM_FLAG_BYTES = 8;
+
+template<typename T>
+T read_at(const uint8_t *source)
+{
+    T value;
+    memcpy(&value, source, sizeof(value));
+    return value;
+}
+
+} // namespace
+
+ULogReader::ULogReader() {}
+
+ULogReader::~ULogReader()
+{
+    close();
+}
+
+bool ULogReader::open(const std::string &path)
+{
+    close();
+
+#ifdef WINDOWS
+    UNUSED(path);
+    LogErr() << "Memory-mapped ULog reading is not supported on Windows";
+    return false;
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LogErr() << "Could not open " << path << ": " << strerror(errno);
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        LogErr() << "Could not get size of " << path << ": " << strerror(errno);
+        ::close(fd);
+        return false;
+    }
+
+    const size_t len = size_t(file_stat.st_size);
+    if (len < FILE_HEADER_LEN) {
+        LogErr() << path << " is too short for a ULog file";
+        ::close(fd);
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid without the descriptor.
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        LogErr() << "Could not map " << path << ": " << strerror(errno);
+        return false;
+    }
+
+    _data = static_cast<const uint8_t *>(mapping);
+    _len = len;
+
+    // The index is built in one pass from start to end, later queries jump around.
+    madvise(mapping, len, MADV_SEQUENTIAL);
+    const bool success = build_index();
+    madvise(mapping, len, MADV_RANDOM);
+
+    if (!success) {
+        LogErr() << path << " is no valid ULog file";
+        close();
+        return false;
+    }
+    return true;
+#endif
+}
+
+void ULogReader::close()
+{
+#ifndef WINDOWS
+    if (_data != nullptr) {
+        munmap(const_cast<uint8_t *>(_data), _len);
+    }
+#endif
+    _data = nullptr;
+    _len = 0;
+    _segments.clear();
+    _start_time_us = 0;
+    _formats.clear();
+    _subscriptions.clear();
+}
+
+bool ULogReader::build_index()
+{
+    if (memcmp(_data, MAGIC, sizeof(MAGIC)) != 0) {
+        return false;
+    }
+    _start_time_us = read_at<uint64_t>(_data + 8);
+
+    // By msg_id, into _subscriptions, -1 if not in use.
+    std::vector<int32_t> active(UINT16_MAX + 1, -1);
+    // Where data was appended to a log which was cut off, the lowest last.
+    std::vector<size_t> appended {};
+
+    size_t offset = FILE_HEADER_LEN;
+    Segment segment {offset, offset};
+    bool first = true;
+
+    while (true) {
+        const size_t next_appended = appended.empty() ? _len : appended.back();
+        if (offset == next_appended && !appended.empty()) {
+            // The log went on without a gap.
+            appended.pop_back();
+            continue;
+        }
+
+        size_t message_len = 0;
+        if (offset + MESSAGE_HEADER_LEN <= next_appended) {
+            message_len = MESSAGE_HEADER_LEN + read_at<uint16_t>(_data + offset);
+        }
+
+        if (message_len == 0 || offset + message_len > next_appended) {
+            segment.end = offset;
+            if (segment.end > segment.begin) {
+                _segments.push_back(segment);
+            }
+            if (appended.empty()) {
+                if (offset != _len) {
+                    LogWarn() << "ULog file ends in the middle of a message";
+                }
+                break;
+            }
+            // Whatever is left of the message which was cut off is skipped.
+            offset = appended.back();
+            appended.pop_back();
+            segment.begin = offset;
+            continue;
+        }
+
+        const uint8_t *message = _data + offset;
+        const uint8_t *payload = message + MESSAGE_HEADER_LEN;
+        const size_t payload_len = message_len - MESSAGE_HEADER_LEN;
+
+        switch (message[2]) {
+            case 'B':
+                // Only counts as the first message.
+                if (!first) {
+                    break;
+                }
+                if (!read_flag_bits(payload, payload_len, appended)) {
+                    return false;
+                }
+                // Offsets which are behind us already, or past the end, are of no use.
+                appended.erase(std::remove_if(appended.begin(), appended.end(),
+                [this, offset, message_len](size_t appended_offset) {
+                    return appended_offset < offset + message_len || appended_offset >= _len;
+                }), appended.end());
+                std::sort(appended.begin(), appended.end(), std::greater<size_t>());
+                break;
+
+            case 'F': {
+                const char *format = reinterpret_cast<const char *>(payload);
+                const char *colon = static_cast<const char *>(memchr(format, ':', payload_len));
+                if (colon != nullptr) {
+                    _formats[std::string(format, colon)] =
+                        std::string(colon + 1, format + payload_len);
+                }
+                break;
+            }
+
+            case 'A': {
+                if (payload_len < 3) {
+                    break;
+                }
+                const uint16_t msg_id = read_at<uint16_t>(payload + 1);
+                if (active[msg_id] >= 0) {
+                    _subscriptions[size_t(active[msg_id])].end = offset;
+                }
+                Subscription subscription {};
+                subscription.name = std::string(reinterpret_cast<const char *>(payload + 3),
+                                                payload_len - 3);
+                subscription.multi_id = payload[0];
+                subscription.msg_id = msg_id;
+                active[msg_id] = int32_t(_subscriptions.size());
+                _subscriptions.push_back(subscription);
+                break;
+            }
+
+            case 'R': {
+                if (payload_len < 2) {
+                    break;
+                }
+                const uint16_t msg_id = read_at<uint16_t>(payload);
+                if (active[msg_id] >= 0) {
+                    _subscriptions[size_t(active[msg_id])].end = offset;
+                    active[msg_id] = -1;
+                }
+                break;
+            }
+
+            case 'D': {
+                // The msg_id and at least the timestamp.
+                if (payload_len < sizeof(uint16_t) + sizeof(uint64_t)) {
+                    break;
+                }
+                const int32_t index = active[read_at<uint16_t>(payload)];
+                if (index < 0) {
+                    break;
+                }
+                Subscription &subscription = _subscriptions[size_t(index)];
+                const uint64_t time_us = read_at<uint64_t>(payload + sizeof(uint16_t));
+                if (subscription.num_messages == 0) {
+                    subscription.first_time_us = time_us;
+                }
+                if (subscription.num_messages % INDEX_INTERVAL == 0) {
+                    subscription.index.push_back(IndexEntry {time_us, offset});
+                }
+                subscription.last_time_us = time_us;
+                ++subscription.num_messages;
+                break;
+            }
+
+            default:
+                break;
+        }
+
+        first = false;
+        offset += message_len;
+    }
+
+    for (const auto index : active) {
+        if (index >= 0) {
+            _subscriptions[size_t(index)].end = _len;
+        }
+    }
+
+    return true;
+}
+
+bool ULogReader::read_flag_bits(const uint8_t *payload, size_t len,
+                                std::vector<size_t> &appended) const
+{
+    if (len < 2 * NUM_FLAG_BYTES + NUM_APPENDED_OFFSETS * sizeof(uint64_t)) {
+        LogWarn() << "ULog flag bits too short";
+        return true;
+    }
+
+    const uint8_t *incompat_flags = payload + NUM_FLAG_BYTES;
+    if ((incompat_flags[0] & ~INCOMPAT_FLAG0_DATA_APPENDED) != 0) {
+        LogErr() << "ULog file uses incompatible features";
+        return false;
+    }
+    for (size_t i = 1; i < NUM_FLAG_BYTES; ++i) {
+        if (incompat_flags[i] != 0) {
+            LogErr() << "ULog file uses incompatible features";
+            return false;
+        }
+    }
+
+    if (incompat_flags[0] & INCOMPAT_FLAG0_DATA_APPENDED) {
+        for (size_t i = 0; i < NUM_APPENDED_OFFSETS; ++i) {
+            const uint64_t appended_offset =
+                read_at<uint64_t>(payload + 2 * NUM_FLAG_BYTES + i * sizeof(uint64_t));
+            if (appended_offset != 0) {
+                appended.push_back(size_t(appended_offset));
+            }
+        }
+    }
+    return true;
+}
+
+std::vector<ULogReader::Topic> ULogReader::topics() const
+{
+    std::vector<Topic> topics;
+
+    for (const auto &subscription : _subscriptions) {
+        auto it = std::find_if(topics.begin(), topics.end(),
+        [&subscription](const Topic & topic) {
+            return topic.name == subscription.name && topic.multi_id == subscription.multi_id;
+        });
+
+        if (it == topics.end()) {
+            topics.push_back(Topic {subscription.name, subscription.multi_id, 0, 0, 0});
+            it = topics.end() - 1;
+        }
+        if (subscription.num_messages == 0) {
+            continue;
+        }
+        if (it->num_messages == 0) {
+            it->first_time_us = subscription.first_time_us;
+        }
+        it->last_time_us = subscription.last_time_us;
+        it->num_messages += subscription.num_messages;
+    }
+
+    return topics;
+}
+
+uint64_t ULogReader::read(const std::string &name, uint8_t multi_id, uint64_t first_time_us,
+                          uint64_t last_time_us, const message_callback_t &callback) const
+{
+    uint64_t num_found = 0;
+
+    for (const auto &subscription : _subscriptions) {
+        if (subscription.name != name || subscription.multi_id != multi_id ||
+            subscription.num_messages == 0 ||
+            subscription.last_time_us < first_time_us ||
+            subscription.first_time_us > last_time_us) {
+            continue;
+        }
+
+        // Start at the last entry before the first time, so that no message
+        // with that time is left out.
+        auto it = std::lower_bound(subscription.index.begin(), subscription.index.end(),
+                                   first_time_us,
+        [](const IndexEntry & entry, uint64_t time_us) {
+            return entry.time_us < time_us;
+        });
+        if (it != subscription.index.begin()) {
+            --it;
+        }
+
+        if (!scan(subscription, it->offset, first_time_us, last_time_us, callback, num_found)) {
+            break;
+        }
+    }
+
+    return num_found;
+}
+
+bool ULogReader::scan(const Subscription &subscription, size_t offset, uint64_t first_time_us,
+                      uint64_t last_time_us, const message_callback_t &callback,
+                      uint64_t &num_found) const
+{
+    auto segment = std::upper_bound(_segments.begin(), _segments.end(), offset,
+    [](size_t value, const Segment & s) {
+        return value < s.begin;
+    }) - 1;
+
+    while (offset < subscription.end) {
+        if (offset >= segment->end) {
+            if (++segment == _segments.end()) {
+                break;
+            }
+            offset = segment->begin;
+            continue;
+        }
+
+        const uint8_t *message = _data + offset;
+        const size_t payload_len = read_at<uint16_t>(message);
+        offset += MESSAGE_HEADER_LEN + payload_len;
+
+        if (message[2] != 'D' ||
+            payload_len < sizeof(uint16_t) + sizeof(uint64_t) ||
+            read_at<uint16_t>(message + MESSAGE_HEADER_LEN) != subscription.msg_id) {
+            continue;
+        }
+
+        const uint8_t *data = message + MESSAGE_HEADER_LEN + sizeof(uint16_t);
+        const uint64_t time_us = read_at<uint64_t>(data);
+        if (time_us > last_time_us) {
+            break;
+        }
+        if (time_us < first_time_us) {
+            continue;
+        }
+
+        ++num_found;
+        if (!callback(Message {time_us, data, payload_len - sizeof(uint16_t)})) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace dronecore
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace dronecore {
+
+/**
+ * @brief Reads ULog files (.ulg) such as those written by the logging plugin.
+ *
+ * The file is memory-mapped and indexed in one pass when it is opened, after
+ * that, the messages of a topic in a time range are found without reading the
+ * rest of the file. For every topic, the index keeps the offset and time of
+ * every INDEX_INTERVAL-th message only, so that it stays small even for logs
+ * of several GB.
+ *
+ * Once opened, the reader can be queried from several threads at once.
+ */
+class ULogReader
+{
+public:
+    /**
+     * @brief Constructor.
+     */
+    ULogReader();
+
+    /**
+     * @brief Destructor, closes the file.
+     */
+    ~ULogReader();
+
+    /**
+     * @brief Maps and indexes a ULog file.
+     *
+     * A file which ends in the middle of a message, e.g. because logging was
+     * cut off, is read up to the last complete message.
+     *
+     * @param path Path of the .ulg file.
+     * @return false if the file could not be mapped or is no ULog file.
+     */
+    bool open(const std::string &path);
+
+    /**
+     * @brief Unmaps the file. Messages handed out before are invalid after this.
+     */
+    void close();
+
+    /**
+     * @brief Whether a file is open.
+     */
+    bool is_open() const { return _data != nullptr; }
+
+    /**
+     * @brief Time the log was started at in us, as in the file header.
+     */
+    uint64_t start_time_us() const { return _start_time_us; }
+
+    /**
+     * @brief Message formats by name, as in the file, e.g. "uint64_t timestamp;float x".
+     */
+    const std::map<std::string, std::string> &formats() const { return _formats; }
+
+    /**
+     * @brief Describes a logged topic.
+     */
+    struct Topic {
+        std::string name; /**< @brief Name of the topic, the name of its format as well. */
+        uint8_t multi_id; /**< @brief Instance of the topic. */
+        uint64_t num_messages; /**< @brief Number of messages logged. */
+        uint64_t first_time_us; /**< @brief Timestamp of the first message. */
+        uint64_t last_time_us; /**< @brief Timestamp of the last message. */
+    };
+
+    /**
+     * @brief All topics which have been logged, in the order they were first added.
+     */
+    std::vector<Topic> topics() const;
+
+    /**
+     * @brief A logged message of a topic.
+     */
+    struct Message {
+        uint64_t time_us; /**< @brief Timestamp, the first field of the message. */
+        const uint8_t *data; /**< @brief Fields as in the format, into the mapped file. */
+        size_t len; /**< @brief Length of data in bytes. */
+    };
+
+    /**
+     * @brief Callback type for messages, returning false stops the search.
+     */
+    typedef std::function<bool(const Message &)> message_callback_t;
+
+    /**
+     * @brief Hands out the messages of a topic between two times, in the order logged.
+     *
+     * The timestamps of a topic are taken as increasing, which they are in
+     * the logs written by PX4.
+     *
+     * @param name Name of the topic.
+     * @param multi_id Instance of the topic.
+     * @param first_time_us Messages before this are left out.
+     * @param last_time_us Messages after this are left out.
+     * @param callback Called for every message found, on the calling thread.
+     * @return Number of messages handed out.
+     */
+    uint64_t read(const std::string &name, uint8_t multi_id, uint64_t first_time_us,
+                  uint64_t last_time_us, const message_callback_t &callback) const;
+
+    /**
+     * @brief Every this many messages of a topic, the index keeps one.
+     */
+    static constexpr uint64_t INDEX_INTERVAL = 64;
+
+    // Non-copyable
+    ULogReader(const ULogReader &) = delete;
+    const ULogReader &operator=(const ULogReader &) = delete;
+
+private:
+    static constexpr size_t FILE_HEADER_LEN = 16;
+    static constexpr size_t MESSAGE_HEADER_LEN = 3;
+    static constexpr size_t NUM_APPENDED_OFFSETS = 3;
+
+    struct IndexEntry {
+        uint64_t time_us;
+        size_t offset;
+    };
+
+    // One for every time a topic is added. A msg_id can be given to another
+    // topic once the first one is removed.
+    struct Subscription {
+        std::string name;
+        uint8_t multi_id;
+        uint16_t msg_id;
+        // Past the last message, where the topic is removed or the file ends.
+        size_t end;
+        uint64_t num_messages;
+        uint64_t first_time_us;
+        uint64_t last_time_us;
+        std::vector<IndexEntry> index;
+    };
+
+    // Runs of complete messages. There is more than one if data was appended
+    // to a log which ends in the middle of a message.
+    struct Segment {
+        size_t begin;
+        size_t end;
+    };
+
+    bool build_index();
+    bool read_flag_bits(const uint8_t *payload, size_t len, std::vector<size_t> &appended) const;
+    // Returns false if the callback asked to stop.
+    bool scan(const Subscription &subscription, size_t offset, uint64_t first_time_us,
+              uint64_t last_time_us, const message_callback_t &callback,
+              uint64_t &num_found) const;
+
+    const uint8_t *_data = nullptr;
+    size_t _len = 0;
+    std::vector<Segment> _segments {};
+
+    uint64_t _start_time_us = 0;
+    std::map<std::string, std::string> _formats {};
+    std::vector<Subscription> _subscriptions {};
+};
+
+} // namespace dronecore
@@ -0,0 +1,237 @@
+#include "ulog_reader.h"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace dronecore;
+
+namespace {
+
+const char *const LOG_PATH = "ulog_reader_test.ulg";
+
+template<typename T>
+std::string bytes_of(const T &value)
+{
+    return std::string(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+std::string message(char type, const std::string &payload)
+{
+    return bytes_of(uint16_t(payload.size())) + type + payload;
+}
+
+std::string file_header()
+{
+    return std::string("ULog\x01\x12\x35\x01", 8) + bytes_of(uint64_t(123456));
+}
+
+std::string add_message(uint8_t multi_id, uint16_t msg_id, const std::string &name)
+{
+    return message('A', std::string(1, char(multi_id)) + bytes_of(msg_id) + name);
+}
+
+std::string data_message(uint16_t msg_id, uint64_t time_us, float value)
+{
+    return message('D', bytes_of(msg_id) + bytes_of(time_us) + bytes_of(value));
+}
+
+float value_of(const ULogReader::Message &message)
+{
+    float value;
+    memcpy(&value, message.data + sizeof(uint64_t), sizeof(value));
+    return value;
+}
+
+void write_file(const std::string &bytes)
+{
+    std::ofstream file(LOG_PATH, std::ios::binary | std::ios::trunc);
+    file.write(bytes.data(), std::streamsize(bytes.size()));
+}
+
+// An "attitude" message every ms and a "gps" one every 10 ms, with the
+// time in ms as value.
+std::string make_log(unsigned duration_ms)
+{
+    std::string log = file_header();
+    log += message('F', "attitude:uint64_t timestamp;float value");
+    log += message('F', "gps:uint64_t timestamp;float value");
+    log += add_message(0, 0, "attitude");
+    log += add_message(1, 1, "gps");
+
+    for (unsigned i = 0; i < duration_ms; ++i) {
+        log += data_message(0, 1000ull * i, float(i));
+        if (i % 10 == 0) {
+            log += data_message(1, 1000ull * i, float(i));
+        }
+        if (i % 100 == 0) {
+            log += message('O', bytes_of(uint16_t(0)));
+        }
+    }
+    return log;
+}
+
+std::vector<float> read_values(const ULogReader &reader, const std::string &name,
+                               uint8_t multi_id, uint64_t first_time_us, uint64_t last_time_us)
+{
+    std::vector<float> values;
+    const uint64_t num_found = reader.read(name, multi_id, first_time_us, last_time_us,
+    [&values](const ULogReader::Message & msg) {
+        EXPECT_EQ(msg.len, sizeof(uint64_t) + sizeof(float));
+        EXPECT_EQ(msg.time_us, uint64_t(value_of(msg) * 1000));
+        values.push_back(value_of(msg));
+        return true;
+    });
+    EXPECT_EQ(num_found, values.size());
+    return values;
+}
+
+std::vector<float> range(unsigned first, unsigned last, unsigned step = 1)
+{
+    std::vector<float> values;
+    for (unsigned i = first; i <= last; i += step) {
+        values.push_back(float(i));
+    }
+    return values;
+}
+
+} // namespace
+
+TEST(ULogReader, IndexesTopicsAndFormats)
+{
+    write_file(make_log(1000));
+
+    ULogReader reader;
+    ASSERT_TRUE(reader.open(LOG_PATH));
+    EXPECT_TRUE(reader.is_open());
+    EXPECT_EQ(reader.start_time_us(), 123456u);
+
+    ASSERT_EQ(reader.formats().size(), 2u);
+    EXPECT_EQ(reader.formats().at("gps"), "uint64_t timestamp;float value");
+
+    const std::vector<ULogReader::Topic> topics = reader.topics();
+    ASSERT_EQ(topics.size(), 2u);
+    EXPECT_EQ(topics[0].name, "attitude");
+    EXPECT_EQ(topics[0].multi_id, 0);
+    EXPECT_EQ(topics[0].num_messages, 1000u);
+    EXPECT_EQ(topics[0].first_time_us, 0u);
+    EXPECT_EQ(topics[0].last_time_us, 999000u);
+    EXPECT_EQ(topics[1].name, "gps");
+    EXPECT_EQ(topics[1].multi_id, 1);
+    EXPECT_EQ(topics[1].num_messages, 100u);
+
+    reader.close();
+    EXPECT_FALSE(reader.is_open());
+    EXPECT_TRUE(reader.topics().empty());
+    remove(LOG_PATH);
+}
+
+TEST(ULogReader, ReadsTimeRanges)
+{
+    write_file(make_log(1000));
+
+    ULogReader reader;
+    ASSERT_TRUE(reader.open(LOG_PATH));
+
+    EXPECT_EQ(read_values(reader, "attitude", 0, 0, UINT64_MAX), range(0, 999));
+    // Around and on the messages the index keeps.
+    EXPECT_EQ(read_values(reader, "attitude", 0, 63000, 64000), range(63, 64));
+    EXPECT_EQ(read_values(reader, "attitude", 0, 64000, 64000), range(64, 64));
+    EXPECT_EQ(read_values(reader, "attitude", 0, 500500, 700000), range(501, 700));
+    EXPECT_EQ(read_values(reader, "gps", 1, 95000, 305000), range(100, 300, 10));
+    EXPECT_EQ(read_values(reader, "attitude", 0, 999500, 2000000), std::vector<float>());
+
+    EXPECT_TRUE(read_values(reader, "gps", 0, 0, UINT64_MAX).empty());
+    EXPECT_TRUE(read_values(reader, "position", 0, 0, UINT64_MAX).empty());
+
+    unsigned num_called = 0;
+    EXPECT_EQ(reader.read("attitude", 0, 0, UINT64_MAX,
+    [&num_called](const ULogReader::Message &) {
+        return ++num_called < 3;
+    }), 3u);
+    remove(LOG_PATH);
+}
+
+TEST(ULogReader, FollowsTopicsWhichAreAddedAgain)
+{
+    std::string log = file_header();
+    log += message('F', "attitude:uint64_t timestamp;float value");
+    log += message('F', "gps:uint64_t timestamp;float value");
+    log += add_message(0, 0, "attitude");
+    for (unsigned i = 0; i < 100; ++i) {
+        log += data_message(0, 1000ull * i, float(i));
+    }
+    // The msg_id is given to another topic and the first one comes back with another id.
+    log += message('R', bytes_of(uint16_t(0)));
+    log += add_message(0, 0, "gps");
+    log += add_message(0, 1, "attitude");
+    for (unsigned i = 100; i < 200; ++i) {
+        log += data_message(0, 1000ull * i, float(i));
+        log += data_message(1, 1000ull * i, float(i));
+    }
+    write_file(log);
+
+    ULogReader reader;
+    ASSERT_TRUE(reader.open(LOG_PATH));
+    ASSERT_EQ(reader.topics().size(), 2u);
+    EXPECT_EQ(reader.topics()[0].num_messages, 200u);
+    EXPECT_EQ(read_values(reader, "attitude", 0, 90000, 110000), range(90, 110));
+    EXPECT_EQ(read_values(reader, "gps", 0, 0, UINT64_MAX), range(100, 199));
+    remove(LOG_PATH);
+}
+
+TEST(ULogReader, ReadsLogWhichWasCutOff)
+{
+    std::string log = make_log(200);
+    log += data_message(0, 200000, 200.0f).substr(0, 7);
+    write_file(log);
+
+    ULogReader reader;
+    ASSERT_TRUE(reader.open(LOG_PATH));
+    EXPECT_EQ(read_values(reader, "attitude", 0, 0, UINT64_MAX), range(0, 199));
+    remove(LOG_PATH);
+}
+
+TEST(ULogReader, ReadsAppendedData)
+{
+    std::string log = file_header();
+    // Compatible and incompatible flags, then the appended offsets.
+    std::string flag_bits(40, '\0');
+    flag_bits[8] = 1;
+    log += message('B', flag_bits);
+    log += message('F', "attitude:uint64_t timestamp;float value");
+    log += add_message(0, 0, "attitude");
+    for (unsigned i = 0; i < 100; ++i) {
+        log += data_message(0, 1000ull * i, float(i));
+    }
+    // Cut off in the middle of a message, then the rest is appended.
+    log += data_message(0, 100000, 100.0f).substr(0, 5);
+    const uint64_t appended_offset = log.size();
+    for (unsigned i = 101; i < 200; ++i) {
+        log += data_message(0, 1000ull * i, float(i));
+    }
+    log.replace(16 + 3 + 16, sizeof(appended_offset), bytes_of(appended_offset));
+    write_file(log);
+
+    ULogReader reader;
+    ASSERT_TRUE(reader.open(LOG_PATH));
+    std::vector<float> expected = range(0, 99);
+    const std::vector<float> rest = range(101, 199);
+    expected.insert(expected.end(), rest.begin(), rest.end());
+    EXPECT_EQ(read_values(reader, "attitude", 0, 0, UINT64_MAX), expected);
+    EXPECT_EQ(read_values(reader, "attitude", 0, 99000, 102000),
+              std::vector<float>({99.0f, 101.0f, 102.0f}));
+    remove(LOG_PATH);
+}
+
+TEST(ULogReader, RejectsOtherFiles)
+{
+    write_file(std::string("Not a ULog file at all"));
+
+    ULogReader reader;
+    EXPECT_FALSE(reader.open(LOG_PATH));
+    EXPECT_FALSE(reader.is_open());
+    EXPECT_FALSE(reader.open("does_not_exist.ulg"));
+    remove(LOG_PATH);
+}
@@ -0,0 +1,301 @@
+#include "ulog_stream_writer.h"
+#include "ulog_topic_decoder.h"
+#include "log.h"
+#include "thread_roles.h"
+#include <algorithm>
+#include <cstring>
+
+namespace dronecore {
+
+constexpr size_t ULogStreamWriter::DEFAULT_CAPACITY;
+constexpr uint8_t ULogStreamWriter::NO_MESSAGE_START;
+constexpr size_t ULogStreamWriter::CHUNK_LEN;
+constexpr size_t ULogStreamWriter::FILE_HEADER_LEN;
+constexpr size_t ULogStreamWriter::MESSAGE_HEADER_LEN;
+constexpr int ULogStreamWriter::WRITE_INTERVAL_MS;
+
+ULogStreamWriter::ULogStreamWriter(size_t capacity) :
+    _chunks(std::max<size_t>(capacity / sizeof(Chunk), 1))
+{
+    _message.reserve(MESSAGE_HEADER_LEN + UINT16_MAX);
+}
+
+ULogStreamWriter::~ULogStreamWriter()
+{
+    close();
+}
+
+bool ULogStreamWriter::open(const std::string &path)
+{
+    close();
+
+    _file = fopen(path.c_str(), "wb");
+    if (_file == nullptr) {
+        LogErr() << "Error: cannot open " << path << " for the log";
+        return false;
+    }
+
+    _first = true;
+    _resync = false;
+    _file_header_left = 0;
+    _message.clear();
+    _message_len = 0;
+    _dropout_pending = false;
+    _out.len = 0;
+    _num_bytes = 0;
+    _num_dropped_messages = 0;
+    _num_dropped_bytes = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _should_exit = false;
+    }
+    _thread = new std::thread(&ULogStreamWriter::write_thread, this);
+    _open = true;
+    return true;
+}
+
+void ULogStreamWriter::close()
+{
+    if (!_open) {
+        return;
+    }
+    _open = false;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _should_exit = true;
+        _cv.notify_all();
+    }
+
+    if (_thread != nullptr) {
+        _thread->join();
+        delete _thread;
+        _thread = nullptr;
+    }
+
+    // Whatever came in while the thread was stopping.
+    write_chunks();
+    fclose(_file);
+    _file = nullptr;
+}
+
+void ULogStreamWriter::add(uint16_t sequence, uint8_t first_message_offset,
+                           const uint8_t *data, uint8_t length)
+{
+    if (!_open && _decoder == nullptr) {
+        return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const bool is_header = (length >= FILE_HEADER_LEN && memcmp(data, "ULog", 4) == 0);
+
+    // Logging was started again. A file only ever gets one stream, it is
+    // opened for every start.
+    if (is_header && !_first && !_open) {
+        _first = true;
+        _message.clear();
+        _message_len = 0;
+    }
+
+    if (_first) {
+        _first = false;
+        _last_add_time = now;
+        // The header is at the start of the stream, without it there is
+        // nothing a ULog reader can do with the file.
+        if (is_header) {
+            _file_header_left = FILE_HEADER_LEN;
+            _resync = false;
+            if (_decoder != nullptr) {
+                _decoder->restart();
+            }
+        } else {
+            LogWarn() << "Log stream does not start with a ULog header";
+            _resync = true;
+        }
+
+    } else if (sequence != _next_sequence) {
+        // It wraps, so anything up to half way back counts as seen already.
+        const int16_t gap = int16_t(uint16_t(sequence - _next_sequence));
+        if (gap < 0) {
+            return;
+        }
+        _num_dropped_messages += uint64_t(gap);
+        lose_message();
+        _resync = true;
+    }
+
+    _next_sequence = uint16_t(sequence + 1);
+
+    size_t offset = 0;
+    if (_resync) {
+        if (first_message_offset == NO_MESSAGE_START || first_message_offset >= length) {
+            return;
+        }
+        offset = first_message_offset;
+        _resync = false;
+    }
+
+    take(data + offset, length - offset);
+    flush();
+    _last_add_time = now;
+}
+
+void ULogStreamWriter::take(const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        if (_file_header_left > 0) {
+            const size_t n = std::min(len, _file_header_left);
+            emit(data, n);
+            _file_header_left -= n;
+            data += n;
+            len -= n;
+            continue;
+        }
+
+        // The header of a message tells its size, the header included.
+        const size_t needed = (_message.size() < MESSAGE_HEADER_LEN) ?
+                              MESSAGE_HEADER_LEN - _message.size() :
+                              _message_len - _message.size();
+        const size_t n = std::min(len, needed);
+        _message.insert(_message.end(), data, data + n);
+        data += n;
+        len -= n;
+
+        if (_message.size() == MESSAGE_HEADER_LEN && _message_len == 0) {
+            uint16_t msg_size;
+            memcpy(&msg_size, _message.data(), sizeof(msg_size));
+            _message_len = MESSAGE_HEADER_LEN + msg_size;
+        }
+
+        if (_message_len > 0 && _message.size() == _message_len) {
+            emit_message(_message.data(), _message.size());
+            _message.clear();
+            _message_len = 0;
+        }
+    }
+}
+
+void ULogStreamWriter::emit_message(const uint8_t *message, size_t len)
+{
+    if (_decoder != nullptr) {
+        _decoder->add_message(message, len);
+    }
+    if (!_open) {
+        return;
+    }
+
+    if (_dropout_pending) {
+        // ULog dropout message: msg_size (u16), msg_type 'O', duration in ms (u16).
+        const auto duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                     _last_add_time - _dropout_time).count();
+        const uint16_t msg_size = 2;
+        const uint16_t duration = uint16_t(std::min<int64_t>(duration_ms, UINT16_MAX));
+
+        uint8_t dropout[MESSAGE_HEADER_LEN + 2];
+        memcpy(&dropout[0], &msg_size, sizeof(msg_size));
+        dropout[2] = 'O';
+        memcpy(&dropout[3], &duration, sizeof(duration));
+
+        if (!emit(dropout, sizeof(dropout))) {
+            _num_dropped_bytes += len;
+            return;
+        }
+        _dropout_pending = false;
+    }
+
+    if (!emit(message, len)) {
+        _num_dropped_bytes += len;
+        if (!_dropout_pending) {
+            _dropout_pending = true;
+            _dropout_time = _last_add_time;
+        }
+    }
+}
+
+bool ULogStreamWriter::emit(const uint8_t *data, size_t len)
+{
+    if (!_open) {
+        return true;
+    }
+
+    // All of it or nothing, a message cut short would break the file.
+    const size_t needed = (_out.len + len + CHUNK_LEN - 1) / CHUNK_LEN;
+    if (_chunks.free_space() < needed) {
+        return false;
+    }
+
+    _num_bytes += len;
+    while (len > 0) {
+        const size_t n = std::min(len, CHUNK_LEN - _out.len);
+        memcpy(&_out.data[_out.len], data, n);
+        _out.len = uint8_t(_out.len + n);
+        data += n;
+        len -= n;
+
+        if (_out.len == CHUNK_LEN) {
+            _chunks.push(_out);
+            _out.len = 0;
+        }
+    }
+    return true;
+}
+
+void ULogStreamWriter::flush()
+{
+    // There is space for it, emit() made sure of that.
+    if (_out.len > 0 && _chunks.push(_out)) {
+        _out.len = 0;
+    }
+}
+
+void ULogStreamWriter::lose_message()
+{
+    _message.clear();
+    _message_len = 0;
+    if (!_dropout_pending) {
+        _dropout_pending = true;
+        _dropout_time = _last_add_time;
+    }
+}
+
+void ULogStreamWriter::write_thread()
+{
+    ThreadRoles::apply_to_this_thread(DroneCore::ThreadRole::LOGGING, "ulog_writer");
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_should_exit) {
+        lock.unlock();
+        write_chunks();
+        lock.lock();
+        _cv.wait_for(lock, std::chrono::milliseconds(WRITE_INTERVAL_MS));
+    }
+}
+
+void ULogStreamWriter::write_chunks()
+{
+    std::vector<Chunk> chunks;
+    chunks.reserve(64);
+
+    bool wrote = false;
+    while (_chunks.pop_batch(chunks, 64) > 0) {
+        for (const auto &chunk : chunks) {
+            if (fwrite(chunk.data, 1, chunk.len, _file) != chunk.len) {
+                LogErr() << "Error: cannot write the log";
+            }
+        }
+        chunks.clear();
+        wrote = true;
+    }
+
+    if (wrote) {
+        fflush(_file);
+    }
+}
+
+ULogStreamWriter::Stats ULogStreamWriter::stats() const
+{
+    return Stats {_num_bytes, _num_dropped_messages, _num_dropped_bytes};
+}
+
+} // namespace dronecore
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "spsc_queue.h"
+
+namespace dronecore {
+
+class ULogTopicDecoder;
+
+// Writes the ULog stream of LOGGING_DATA messages to a file. The data is
+// copied into a ring allocated up front and written by a thread of its own,
+// so adding never waits for the disk.
+//
+// The stream is split into ULog messages as it comes in and only complete
+// messages go into the ring. Where data is lost, on the link or because the
+// ring is full, the incomplete message is left out and a dropout message is
+// written instead, so the file stays a valid ULog file. After a loss on the
+// link, the stream continues with the next message which starts. Data
+// repeated because an ack got lost is skipped.
+//
+// With a decoder, the stream is split into messages for it also while no
+// file is open, and a new stream is noticed by its header.
+//
+// add() may only be called from one thread, e.g. the receive thread.
+class ULogStreamWriter
+{
+public:
+    explicit ULogStreamWriter(size_t capacity = DEFAULT_CAPACITY);
+    ~ULogStreamWriter();
+
+    // Creates or truncates the file at path.
+    bool open(const std::string &path);
+    // Writes what is left and closes the file.
+    void close();
+    bool is_open() const { return _open; }
+
+    // Gets every complete message, to be set before anything is added.
+    void set_decoder(ULogTopicDecoder *decoder) { _decoder = decoder; }
+
+    // As in LOGGING_DATA, first_message_offset is NO_MESSAGE_START if no
+    // message starts in the data.
+    void add(uint16_t sequence, uint8_t first_message_offset, const uint8_t *data,
+             uint8_t length);
+
+    struct Stats {
+        uint64_t num_bytes; // Handed to the writer thread.
+        uint64_t num_dropped_messages; // LOGGING_DATA lost on the link.
+        uint64_t num_dropped_bytes; // Because the ring was full.
+    };
+    Stats stats() const;
+
+    // Bytes of the ring.
+    static constexpr size_t DEFAULT_CAPACITY = 1024 * 1024;
+    static constexpr uint8_t NO_MESSAGE_START = 255;
+
+    // Non-copyable
+    ULogStreamWriter(const ULogStreamWriter &) = delete;
+    const ULogStreamWriter &operator=(const ULogStreamWriter &) = delete;
+
+private:
+    static constexpr size_t CHUNK_LEN = 255;
+    static constexpr size_t FILE_HEADER_LEN = 16;
+    static constexpr size_t MESSAGE_HEADER_LEN = 3;
+
+    struct Chunk {
+        uint8_t len;
+        uint8_t data[CHUNK_LEN];
+    };
+
+    void take(const uint8_t *data, size_t len);
+    void emit_message(const uint8_t *message, size_t len);
+    bool emit(const uint8_t *data, size_t len);
+    void flush();
+    void lose_message();
+
+    void write_thread();
+    void write_chunks();
+
+    SpscQueue<Chunk> _chunks;
+
+    std::mutex _mutex {};
+    std::condition_variable _cv {};
+    bool _should_exit = false;
+    std::thread *_thread = nullptr;
+    FILE *_file = nullptr;
+    std::atomic<bool> _open {false};
+    ULogTopicDecoder *_decoder = nullptr;
+
+    // Only used by whoever adds.
+    bool _first = true;
+    uint16_t _next_sequence = 0;
+    // After a loss on the link, nothing is taken until the next message starts.
+    bool _resync = false;
+    size_t _file_header_left = 0;
+    // The message which is not complete yet, with room for the largest one.
+    std::vector<uint8_t> _message {};
+    size_t _message_len = 0;
+    bool _dropout_pending = false;
+    std::chrono::steady_clock::time_point _dropout_time {};
+    std::chrono::steady_clock::time_point _last_add_time {};
+    // The chunk which is being filled.
+    Chunk _out {};
+
+    std::atomic<uint64_t> _num_bytes {0};
+    std::atomic<uint64_t> _num_dropped_messages {0};
+    std::atomic<uint64_t> _num_dropped_bytes {0};
+
+    // The writer looks for new data this often, so that adding does not need
+    // to wake it up.
+    static constexpr int WRITE_INTERVAL_MS = 20;
+};
+
+} // namespace dronecore
@@ -0,0 +1,200 @@
+#include "ulog_stream_writer.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace dronecore;
+
+namespace {
+
+const char *const LOG_PATH = "ulog_stream_writer_test.ulg";
+
+struct Packet {
+    uint16_t sequence;
+    uint8_t first_message_offset;
+    std::string data;
+};
+
+struct Stream {
+    std::string bytes {};
+    std::set<size_t> message_starts {};
+    std::vector<std::string> messages {};
+};
+
+Stream make_stream(unsigned num_messages)
+{
+    Stream stream;
+    // Magic, version and timestamp.
+    stream.bytes = std::string("ULog\x01\x12\x35\x01", 8) + std::string(8, '\0');
+
+    for (unsigned i = 0; i < num_messages; ++i) {
+        const uint16_t msg_size = uint16_t(5 + (i * 37) % 300);
+        std::string message;
+        message.push_back(char(msg_size & 0xff));
+        message.push_back(char(msg_size >> 8));
+        message.push_back('D');
+        for (unsigned j = 0; j < msg_size; ++j) {
+            message.push_back(char(i + j));
+        }
+        stream.message_starts.insert(stream.bytes.size());
+        stream.messages.push_back(message);
+        stream.bytes += message;
+    }
+    return stream;
+}
+
+std::vector<Packet> make_packets(const Stream &stream, size_t packet_len)
+{
+    std::vector<Packet> packets;
+    for (size_t begin = 0; begin < stream.bytes.size(); begin += packet_len) {
+        const size_t end = std::min(begin + packet_len, stream.bytes.size());
+        auto it = stream.message_starts.lower_bound(begin);
+        uint8_t first_message_offset = ULogStreamWriter::NO_MESSAGE_START;
+        if (it != stream.message_starts.end() && *it < end) {
+            first_message_offset = uint8_t(*it - begin);
+        }
+        packets.push_back(Packet {uint16_t(packets.size()), first_message_offset,
+                                  stream.bytes.substr(begin, end - begin)
+                                 });
+    }
+    return packets;
+}
+
+void add(ULogStreamWriter &writer, const Packet &packet)
+{
+    writer.add(packet.sequence, packet.first_message_offset,
+               reinterpret_cast<const uint8_t *>(packet.data.data()),
+               uint8_t(packet.data.size()));
+}
+
+std::string read_file(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+// Splits the file into its messages, returns false if it isn't made up of them.
+bool parse_messages(const std::string &file, std::vector<std::string> &messages)
+{
+    if (file.size() < 16 || file.compare(0, 4, "ULog") != 0) {
+        return false;
+    }
+    size_t position = 16;
+    while (position < file.size()) {
+        if (file.size() - position < 3) {
+            return false;
+        }
+        const size_t msg_size = uint8_t(file[position]) | (uint8_t(file[position + 1]) << 8);
+        if (file.size() - position < 3 + msg_size) {
+            return false;
+        }
+        messages.push_back(file.substr(position, 3 + msg_size));
+        position += 3 + msg_size;
+    }
+    return true;
+}
+
+} // namespace
+
+TEST(ULogStreamWriter, WritesStreamAsIs)
+{
+    const Stream stream = make_stream(200);
+
+    ULogStreamWriter writer;
+    ASSERT_TRUE(writer.open(LOG_PATH));
+    for (const auto &packet : make_packets(stream, 249)) {
+        add(writer, packet);
+    }
+    writer.close();
+
+    EXPECT_EQ(read_file(LOG_PATH), stream.bytes);
+    EXPECT_EQ(writer.stats().num_bytes, stream.bytes.size());
+    EXPECT_EQ(writer.stats().num_dropped_messages, 0u);
+    remove(LOG_PATH);
+}
+
+TEST(ULogStreamWriter, SkipsRepeatedData)
+{
+    const Stream stream = make_stream(100);
+    const auto packets = make_packets(stream, 100);
+
+    ULogStreamWriter writer;
+    ASSERT_TRUE(writer.open(LOG_PATH));
+    for (size_t i = 0; i < packets.size(); ++i) {
+        add(writer, packets[i]);
+        if (i % 3 == 0) {
+            add(writer, packets[i]);
+        }
+    }
+    writer.close();
+
+    EXPECT_EQ(read_file(LOG_PATH), stream.bytes);
+    remove(LOG_PATH);
+}
+
+TEST(ULogStreamWriter, MarksLostDataAsDropout)
+{
+    const Stream stream = make_stream(200);
+    const auto packets = make_packets(stream, 100);
+
+    ULogStreamWriter writer;
+    ASSERT_TRUE(writer.open(LOG_PATH));
+    for (size_t i = 0; i < packets.size(); ++i) {
+        if (i == 10 || i == 11 || i == 50) {
+            continue;
+        }
+        add(writer, packets[i]);
+    }
+    writer.close();
+
+    EXPECT_EQ(writer.stats().num_dropped_messages, 3u);
+
+    std::vector<std::string> messages;
+    ASSERT_TRUE(parse_messages(read_file(LOG_PATH), messages));
+
+    // The rest is what was sent, in order.
+    unsigned num_dropouts = 0;
+    size_t next = 0;
+    for (const auto &message : messages) {
+        if (message[2] == 'O') {
+            ++num_dropouts;
+            continue;
+        }
+        while (next < stream.messages.size() && stream.messages[next] != message) {
+            ++next;
+        }
+        ASSERT_LT(next, stream.messages.size());
+        ++next;
+    }
+    EXPECT_EQ(num_dropouts, 2u);
+    EXPECT_LT(messages.size() - num_dropouts, stream.messages.size());
+    remove(LOG_PATH);
+}
+
+TEST(ULogStreamWriter, StaysValidWhenRingIsFull)
+{
+    const Stream stream = make_stream(2000);
+
+    // Much less than the stream, so that the writer can't keep up.
+    ULogStreamWriter writer(4096);
+    ASSERT_TRUE(writer.open(LOG_PATH));
+    for (const auto &packet : make_packets(stream, 249)) {
+        add(writer, packet);
+    }
+    writer.close();
+
+    const ULogStreamWriter::Stats stats = writer.stats();
+    EXPECT_GT(stats.num_dropped_bytes, 0u);
+
+    const std::string file = read_file(LOG_PATH);
+    EXPECT_EQ(file.size(), stats.num_bytes);
+    std::vector<std::string> messages;
+    EXPECT_TRUE(parse_messages(file, messages));
+    remove(LOG_PATH);
+}
@@ -0,0 +1,353 @@
+#include "ulog_topic_decoder.h"
+#include "log.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace dronecore {
+
+constexpr size_t ULogTopicDecoder::MESSAGE_HEADER_LEN;
+constexpr unsigned ULogTopicDecoder::MAX_NESTING;
+
+namespace {
+
+template<typename T>
+T read_at(const uint8_t *source)
+{
+    T value;
+    memcpy(&value, source, sizeof(value));
+    return value;
+}
+
+} // namespace
+
+void ULogTopicDecoder::restart()
+{
+    _formats.clear();
+    _subscriptions.clear();
+    _decodings.clear();
+}
+
+void ULogTopicDecoder::add_message(const uint8_t *message, size_t len)
+{
+    if (len < MESSAGE_HEADER_LEN) {
+        return;
+    }
+    const uint8_t *payload = message + MESSAGE_HEADER_LEN;
+    const size_t payload_len = len - MESSAGE_HEADER_LEN;
+
+    switch (message[2]) {
+        case 'D':
+            decode(payload, payload_len);
+            break;
+
+        case 'F':
+            add_format(reinterpret_cast<const char *>(payload), payload_len);
+            break;
+
+        case 'A':
+            if (payload_len >= 3) {
+                add_subscription(read_at<uint16_t>(payload + 1), payload[0],
+                                 std::string(reinterpret_cast<const char *>(payload + 3),
+                                             payload_len - 3));
+            }
+            break;
+
+        case 'R':
+            if (payload_len >= 2) {
+                const uint16_t msg_id = read_at<uint16_t>(payload);
+                _subscriptions.erase(msg_id);
+                if (msg_id < _decodings.size()) {
+                    _decodings[msg_id].reset();
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+bool ULogTopicDecoder::enable(const std::string &topic, const std::vector<std::string> &fields,
+                              size_t capacity)
+{
+    if (fields.size() > Logging::MAX_TOPIC_FIELDS) {
+        LogErr() << "At most " << Logging::MAX_TOPIC_FIELDS << " fields of " << topic
+                 << " can be decoded";
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(_wanted_mutex);
+
+    auto wanted = std::make_shared<wanted_map_t>(*std::atomic_load(&_wanted));
+    if (capacity == 0) {
+        wanted->erase(topic);
+    } else {
+        (*wanted)[topic] = std::make_shared<Wanted>(fields, capacity);
+    }
+    std::atomic_store(&_wanted, std::shared_ptr<const wanted_map_t>(wanted));
+    ++_generation;
+    return true;
+}
+
+size_t ULogTopicDecoder::drain(const std::string &topic,
+                               std::vector<Logging::TopicSample> &samples)
+{
+    const auto wanted = std::atomic_load(&_wanted);
+    const auto it = wanted->find(topic);
+    if (it == wanted->end()) {
+        return 0;
+    }
+    return it->second->queue.pop_batch(samples);
+}
+
+uint64_t ULogTopicDecoder::dropped(const std::string &topic) const
+{
+    const auto wanted = std::atomic_load(&_wanted);
+    const auto it = wanted->find(topic);
+    if (it == wanted->end()) {
+        return 0;
+    }
+    return it->second->dropped;
+}
+
+void ULogTopicDecoder::add_format(const char *format, size_t len)
+{
+    const char *colon = static_cast<const char *>(memchr(format, ':', len));
+    if (colon == nullptr) {
+        return;
+    }
+    _formats[std::string(format, colon)] = std::string(colon + 1, format + len);
+}
+
+void ULogTopicDecoder::add_subscription(uint16_t msg_id, uint8_t multi_id,
+                                        const std::string &name)
+{
+    update_wanted();
+
+    const Subscription subscription {name, multi_id};
+    _subscriptions[msg_id] = subscription;
+
+    if (msg_id >= _decodings.size()) {
+        _decodings.resize(size_t(msg_id) + 1);
+    }
+    _decodings[msg_id].reset();
+
+    if (_decoded_wanted) {
+        const auto it = _decoded_wanted->find(name);
+        if (it != _decoded_wanted->end()) {
+            _decodings[msg_id] = make_decoding(subscription, it->second);
+        }
+    }
+}
+
+void ULogTopicDecoder::decode(const uint8_t *data, size_t len)
+{
+    update_wanted();
+
+    if (len < sizeof(uint16_t)) {
+        return;
+    }
+    const uint16_t msg_id = read_at<uint16_t>(data);
+    if (msg_id >= _decodings.size() || !_decodings[msg_id]) {
+        return;
+    }
+    const Decoding &decoding = *_decodings[msg_id];
+
+    data += sizeof(uint16_t);
+    len -= sizeof(uint16_t);
+
+    Logging::TopicSample sample;
+    // Read as it is, a double would round it.
+    const Field &timestamp = decoding.timestamp;
+    sample.timestamp_us = (timestamp.is_known && timestamp.type == Type::UINT64 &&
+                           timestamp.offset + sizeof(uint64_t) <= len) ?
+                          read_at<uint64_t>(data + timestamp.offset) : 0;
+    sample.multi_id = decoding.multi_id;
+    for (size_t i = 0; i < Logging::MAX_TOPIC_FIELDS; ++i) {
+        sample.values[i] = (i < decoding.fields.size()) ?
+                           read_field(data, len, decoding.fields[i]) : double(NAN);
+    }
+
+    if (!decoding.wanted->queue.push(sample)) {
+        ++decoding.wanted->dropped;
+    }
+}
+
+void ULogTopicDecoder::update_wanted()
+{
+    const uint64_t generation = _generation;
+    if (generation == _decoded_generation) {
+        return;
+    }
+    _decoded_generation = generation;
+    _decoded_wanted = std::atomic_load(&_wanted);
+    rebuild_decodings();
+}
+
+void ULogTopicDecoder::rebuild_decodings()
+{
+    for (auto &decoding : _decodings) {
+        decoding.reset();
+    }
+
+    for (const auto &subscription : _subscriptions) {
+        const auto it = _decoded_wanted->find(subscription.second.name);
+        if (it == _decoded_wanted->end()) {
+            continue;
+        }
+        if (subscription.first >= _decodings.size()) {
+            _decodings.resize(size_t(subscription.first) + 1);
+        }
+        _decodings[subscription.first] = make_decoding(subscription.second, it->second);
+    }
+}
+
+std::unique_ptr<ULogTopicDecoder::Decoding>
+ULogTopicDecoder::make_decoding(const Subscription &subscription,
+                                const std::shared_ptr<Wanted> &wanted) const
+{
+    std::map<std::string, Field> layout;
+    if (flatten(subscription.name, "", 0, layout, 0) == 0) {
+        LogWarn() << "No ULog format for " << subscription.name;
+    }
+
+    const Field unknown {Type::UINT8, 0, false};
+    auto find = [&layout, &unknown](const std::string &name) {
+        const auto it = layout.find(name);
+        return (it != layout.end()) ? it->second : unknown;
+    };
+
+    std::unique_ptr<Decoding> decoding(new Decoding {wanted, subscription.multi_id,
+                                                     find("timestamp"), {}});
+    for (const auto &field : wanted->fields) {
+        decoding->fields.push_back(find(field));
+    }
+    return decoding;
+}
+
+uint32_t ULogTopicDecoder::flatten(const std::string &format_name, const std::string &prefix,
+                                   uint32_t offset, std::map<std::string, Field> &layout,
+                                   unsigned depth) const
+{
+    const auto format = _formats.find(format_name);
+    if (format == _formats.end() || depth > MAX_NESTING) {
+        return 0;
+    }
+
+    const uint32_t begin = offset;
+    const std::string &fields = format->second;
+
+    // As in "uint64_t timestamp;float[3] x;".
+    size_t position = 0;
+    while (position < fields.size()) {
+        size_t end = fields.find(';', position);
+        if (end == std::string::npos) {
+            end = fields.size();
+        }
+        const std::string field = fields.substr(position, end - position);
+        position = end + 1;
+
+        const size_t space = field.find(' ');
+        if (space == std::string::npos) {
+            continue;
+        }
+        std::string type_name = field.substr(0, space);
+        const std::string name = field.substr(space + 1);
+
+        // Arrays are named and counted on their own, also of one element.
+        int num_elements = -1;
+        const size_t bracket = type_name.find('[');
+        if (bracket != std::string::npos) {
+            num_elements = atoi(type_name.c_str() + bracket + 1);
+            type_name.resize(bracket);
+        }
+
+        for (int i = 0; i < std::max(num_elements, 1); ++i) {
+            const std::string element_name = (num_elements < 0) ? prefix + name :
+                                             prefix + name + "[" + std::to_string(i) + "]";
+            Type type;
+            uint32_t size;
+            if (type_of(type_name, type, size)) {
+                layout[element_name] = Field {type, offset, true};
+            } else {
+                size = flatten(type_name, element_name + ".", offset, layout, depth + 1);
+                if (size == 0) {
+                    return 0;
+                }
+            }
+            offset += size;
+        }
+    }
+    return offset - begin;
+}
+
+bool ULogTopicDecoder::type_of(const std::string &name, Type &type, uint32_t &size)
+{
+    struct Known {
+        const char *name;
+        Type type;
+        uint32_t size;
+    };
+    static const Known known[] = {
+        {"int8_t", Type::INT8, 1},
+        {"uint8_t", Type::UINT8, 1},
+        {"int16_t", Type::INT16, 2},
+        {"uint16_t", Type::UINT16, 2},
+        {"int32_t", Type::INT32, 4},
+        {"uint32_t", Type::UINT32, 4},
+        {"int64_t", Type::INT64, 8},
+        {"uint64_t", Type::UINT64, 8},
+        {"float", Type::FLOAT, 4},
+        {"double", Type::DOUBLE, 8},
+        {"bool", Type::BOOL, 1},
+        {"char", Type::CHAR, 1}
+    };
+
+    for (const auto &entry : known) {
+        if (name == entry.name) {
+            type = entry.type;
+            size = entry.size;
+            return true;
+        }
+    }
+    return false;
+}
+
+double ULogTopicDecoder::read_field(const uint8_t *data, size_t len, Field field)
+{
+    if (!field.is_known || field.offset >= len) {
+        return double(NAN);
+    }
+    const uint8_t *source = data + field.offset;
+    const size_t left = len - field.offset;
+
+    switch (field.type) {
+        case Type::INT8:
+            return double(int8_t(source[0]));
+        case Type::UINT8:
+        case Type::BOOL:
+        case Type::CHAR:
+            return double(source[0]);
+        case Type::INT16:
+            return (left >= 2) ? double(read_at<int16_t>(source)) : double(NAN);
+        case Type::UINT16:
+            return (left >= 2) ? double(read_at<uint16_t>(source)) : double(NAN);
+        case Type::INT32:
+            return (left >= 4) ? double(read_at<int32_t>(source)) : double(NAN);
+        case Type::UINT32:
+            return (left >= 4) ? double(read_at<uint32_t>(source)) : double(NAN);
+        case Type::INT64:
+            return (left >= 8) ? double(read_at<int64_t>(source)) : double(NAN);
+        case Type::UINT64:
+            return (left >= 8) ? double(read_at<uint64_t>(source)) : double(NAN);
+        case Type::FLOAT:
+            return (left >= 4) ? double(read_at<float>(source)) : double(NAN);
+        case Type::DOUBLE:
+            return (left >= 8) ? read_at<double>(source) : double(NAN);
+    }
+    return double(NAN);
+}
+
+} // namespace dronecore
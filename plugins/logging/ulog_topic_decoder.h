@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "logging.h"
+#include "spsc_queue.h"
+
+namespace dronecore {
+
+// Decodes the data messages of selected topics of a ULog stream into queues,
+// as the stream comes in.
+//
+// All format definitions and subscriptions of the stream are kept, which only
+// costs something at the start. Where a topic is wanted, the offsets and
+// types of the wanted fields are worked out once per subscription, so that a
+// data message only needs a lookup by msg_id and a read of those fields. Data
+// messages of topics which are not wanted are skipped after the lookup.
+//
+// add_message() and restart() may only be called from one thread, e.g. the
+// receive thread. Each topic may be drained from one thread at a time.
+class ULogTopicDecoder
+{
+public:
+    ULogTopicDecoder() {}
+    ~ULogTopicDecoder() {}
+
+    // A new stream starts, with formats and subscriptions of its own.
+    void restart();
+
+    // A complete ULog message, with its header.
+    void add_message(const uint8_t *message, size_t len);
+
+    // Fields are named as in the format, elements of arrays as in "x[2]" and
+    // fields of nested formats as in "outer.inner". Returns false if there are
+    // too many fields. A capacity of 0 turns the topic off again.
+    bool enable(const std::string &topic, const std::vector<std::string> &fields,
+                size_t capacity);
+    size_t drain(const std::string &topic, std::vector<Logging::TopicSample> &samples);
+    uint64_t dropped(const std::string &topic) const;
+
+    // Non-copyable
+    ULogTopicDecoder(const ULogTopicDecoder &) = delete;
+    const ULogTopicDecoder &operator=(const ULogTopicDecoder &) = delete;
+
+private:
+    static constexpr size_t MESSAGE_HEADER_LEN = 3;
+
+    enum class Type : uint8_t {
+        INT8,
+        UINT8,
+        INT16,
+        UINT16,
+        INT32,
+        UINT32,
+        INT64,
+        UINT64,
+        FLOAT,
+        DOUBLE,
+        BOOL,
+        CHAR
+    };
+
+    struct Field {
+        Type type;
+        // Into the data, after the msg_id.
+        uint32_t offset;
+        // Not all fields asked for need to be in the format.
+        bool is_known;
+    };
+
+    struct Wanted {
+        std::vector<std::string> fields;
+        SpscQueue<Logging::TopicSample> queue;
+        std::atomic<uint64_t> dropped {0};
+
+        Wanted(const std::vector<std::string> &wanted_fields, size_t capacity) :
+            fields(wanted_fields),
+            queue(capacity)
+        {}
+    };
+
+    typedef std::map<std::string, std::shared_ptr<Wanted>> wanted_map_t;
+
+    // What a subscription of a wanted topic is decoded with.
+    struct Decoding {
+        std::shared_ptr<Wanted> wanted;
+        uint8_t multi_id;
+        Field timestamp;
+        std::vector<Field> fields;
+    };
+
+    struct Subscription {
+        std::string name;
+        uint8_t multi_id;
+    };
+
+    void add_format(const char *format, size_t len);
+    void add_subscription(uint16_t msg_id, uint8_t multi_id, const std::string &name);
+    void decode(const uint8_t *data, size_t len);
+    void update_wanted();
+    void rebuild_decodings();
+    std::unique_ptr<Decoding> make_decoding(const Subscription &subscription,
+                                            const std::shared_ptr<Wanted> &wanted) const;
+
+    // Adds the fields of a format, with their offsets from offset on, to the
+    // layout, and returns its size, 0 if the format is not known.
+    uint32_t flatten(const std::string &format_name, const std::string &prefix,
+                     uint32_t offset, std::map<std::string, Field> &layout,
+                     unsigned depth) const;
+    static bool type_of(const std::string &name, Type &type, uint32_t &size);
+    // NAN if the field is not known or not within len.
+    static double read_field(const uint8_t *data, size_t len, Field field);
+
+    // Nested formats deeper than this are taken as broken.
+    static constexpr unsigned MAX_NESTING = 8;
+
+    // Replaced as a whole on every change, the decoding thread keeps the
+    // wanted topics alive while it still decodes them.
+    std::shared_ptr<const wanted_map_t> _wanted {std::make_shared<const wanted_map_t>()};
+    std::mutex _wanted_mutex {};
+    // Counts the changes, so that the decoding thread only needs to look at
+    // _wanted after one.
+    std::atomic<uint64_t> _generation {0};
+
+    // Only used by the decoding thread.
+    std::map<std::string, std::string> _formats {};
+    std::map<uint16_t, Subscription> _subscriptions {};
+    std::shared_ptr<const wanted_map_t> _decoded_wanted {};
+    uint64_t _decoded_generation = 0;
+    // By msg_id, nullptr where a topic is not wanted.
+    std::vector<std::unique_ptr<Decoding>> _decodings {};
+};
+
+} // namespace dronecore
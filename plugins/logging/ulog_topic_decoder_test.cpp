@@ -0,0 +1,175 @@
+#include "ulog_topic_decoder.h"
+#include "ulog_stream_writer.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace dronecore;
+
+namespace {
+
+std::string make_message(char type, const std::string &payload)
+{
+    std::string message;
+    message.push_back(char(payload.size() & 0xff));
+    message.push_back(char(payload.size() >> 8));
+    message.push_back(type);
+    return message + payload;
+}
+
+std::string make_add(uint8_t multi_id, uint16_t msg_id, const std::string &name)
+{
+    std::string payload;
+    payload.push_back(char(multi_id));
+    payload.append(reinterpret_cast<const char *>(&msg_id), sizeof(msg_id));
+    return make_message('A', payload + name);
+}
+
+template<typename T>
+void append(std::string &data, T value)
+{
+    data.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+// A sample of "vector3:float[3] xyz" and
+// "pose:uint64_t timestamp;int16_t flags;vector3 position;uint8_t[2] _padding0;double height".
+std::string make_pose(uint16_t msg_id, uint64_t timestamp_us, float x, double height)
+{
+    std::string data;
+    append(data, msg_id);
+    append(data, timestamp_us);
+    append(data, int16_t(-3));
+    append(data, x);
+    append(data, x + 1.0f);
+    append(data, x + 2.0f);
+    data.append(2, '\0');
+    append(data, height);
+    return make_message('D', data);
+}
+
+void add(ULogTopicDecoder &decoder, const std::string &message)
+{
+    decoder.add_message(reinterpret_cast<const uint8_t *>(message.data()), message.size());
+}
+
+void add_definitions(ULogTopicDecoder &decoder)
+{
+    add(decoder, make_message('F', "vector3:float[3] xyz;"));
+    add(decoder, make_message('F', "pose:uint64_t timestamp;int16_t flags;vector3 position;"
+                              "uint8_t[2] _padding0;double height;"));
+    add(decoder, make_message('F', "other:uint64_t timestamp;float value;"));
+}
+
+} // namespace
+
+TEST(ULogTopicDecoder, DecodesWantedFields)
+{
+    ULogTopicDecoder decoder;
+    ASSERT_TRUE(decoder.enable("pose", {"height", "position.xyz[2]", "flags", "missing"}, 16));
+
+    add_definitions(decoder);
+    add(decoder, make_add(1, 7, "pose"));
+    add(decoder, make_add(0, 8, "other"));
+    add(decoder, make_pose(7, 123456789012ull, 1.5f, 42.25));
+
+    // Not wanted, only looked up.
+    std::string other;
+    append(other, uint16_t(8));
+    append(other, uint64_t(1));
+    append(other, 3.0f);
+    add(decoder, make_message('D', other));
+
+    std::vector<Logging::TopicSample> samples;
+    ASSERT_EQ(decoder.drain("pose", samples), 1u);
+    EXPECT_EQ(samples[0].timestamp_us, 123456789012ull);
+    EXPECT_EQ(samples[0].multi_id, 1);
+    EXPECT_DOUBLE_EQ(samples[0].values[0], 42.25);
+    EXPECT_DOUBLE_EQ(samples[0].values[1], 3.5);
+    EXPECT_DOUBLE_EQ(samples[0].values[2], -3.0);
+    EXPECT_TRUE(std::isnan(samples[0].values[3]));
+    EXPECT_TRUE(std::isnan(samples[0].values[4]));
+
+    EXPECT_EQ(decoder.drain("other", samples), 0u);
+}
+
+TEST(ULogTopicDecoder, EnablesDuringTheStream)
+{
+    ULogTopicDecoder decoder;
+    add_definitions(decoder);
+    add(decoder, make_add(0, 3, "pose"));
+    add(decoder, make_pose(3, 1, 0.0f, 1.0));
+
+    std::vector<Logging::TopicSample> samples;
+    EXPECT_EQ(decoder.drain("pose", samples), 0u);
+
+    ASSERT_TRUE(decoder.enable("pose", {"height"}, 16));
+    add(decoder, make_pose(3, 2, 0.0f, 2.0));
+    ASSERT_EQ(decoder.drain("pose", samples), 1u);
+    EXPECT_DOUBLE_EQ(samples[0].values[0], 2.0);
+
+    // Turned off, and then the data of a removed subscription.
+    ASSERT_TRUE(decoder.enable("pose", {}, 0));
+    add(decoder, make_pose(3, 3, 0.0f, 3.0));
+    EXPECT_EQ(decoder.drain("pose", samples), 0u);
+
+    ASSERT_TRUE(decoder.enable("pose", {"height"}, 16));
+    std::string remove;
+    append(remove, uint16_t(3));
+    add(decoder, make_message('R', remove));
+    add(decoder, make_pose(3, 4, 0.0f, 4.0));
+    EXPECT_EQ(decoder.drain("pose", samples), 0u);
+}
+
+TEST(ULogTopicDecoder, CountsDropped)
+{
+    ULogTopicDecoder decoder;
+    ASSERT_TRUE(decoder.enable("pose", {"height"}, 4));
+    add_definitions(decoder);
+    add(decoder, make_add(0, 1, "pose"));
+    for (unsigned i = 0; i < 10; ++i) {
+        add(decoder, make_pose(1, i, 0.0f, double(i)));
+    }
+
+    std::vector<Logging::TopicSample> samples;
+    EXPECT_EQ(decoder.drain("pose", samples), 4u);
+    EXPECT_EQ(decoder.dropped("pose"), 6u);
+
+    EXPECT_FALSE(decoder.enable("pose", std::vector<std::string>(Logging::MAX_TOPIC_FIELDS + 1,
+                                                                 "height"), 4));
+}
+
+TEST(ULogTopicDecoder, IsFedByTheStreamWithoutFile)
+{
+    ULogTopicDecoder decoder;
+    ASSERT_TRUE(decoder.enable("other", {"value"}, 16));
+
+    ULogStreamWriter writer;
+    writer.set_decoder(&decoder);
+
+    std::string data;
+    append(data, uint16_t(2));
+    append(data, uint64_t(5));
+    append(data, 7.5f);
+
+    const std::string stream = std::string("ULog\x01\x12\x35\x01", 8) + std::string(8, '\0') +
+                               make_message('F', "other:uint64_t timestamp;float value;") +
+                               make_add(0, 2, "other") + make_message('D', data);
+
+    // Cut into packets as LOGGING_DATA, the first message starts after the header.
+    uint16_t sequence = 0;
+    for (size_t begin = 0; begin < stream.size(); begin += 20) {
+        const size_t len = std::min<size_t>(20, stream.size() - begin);
+        const uint8_t first_message_offset = (begin == 0) ? 16 :
+                                             ULogStreamWriter::NO_MESSAGE_START;
+        writer.add(sequence++, first_message_offset,
+                   reinterpret_cast<const uint8_t *>(stream.data() + begin), uint8_t(len));
+    }
+
+    std::vector<Logging::TopicSample> samples;
+    ASSERT_EQ(decoder.drain("other", samples), 1u);
+    EXPECT_EQ(samples[0].timestamp_us, 5u);
+    EXPECT_DOUBLE_EQ(samples[0].values[0], 7.5);
+}
@@ -0,0 +1,79 @@
+#include "mavlink_passthrough.h"
+#include "mavlink_passthrough_impl.h"
+
+namespace dronecore {
+
+MAVLinkPassthrough::MAVLinkPassthrough(System &system) :
+    PluginBase(),
+    _impl { new MAVLinkPassthroughImpl(system) }
+{
+}
+
+MAVLinkPassthrough::~MAVLinkPassthrough()
+{
+}
+
+MAVLinkPassthrough::subscription_handle_t
+MAVLinkPassthrough::subscribe_frames(const std::vector<uint32_t> &message_ids,
+                                     frame_callback_t callback)
+{
+    return _impl->subscribe_frames(message_ids, callback);
+}
+
+MAVLinkPassthrough::subscription_handle_t
+MAVLinkPassthrough::subscribe_messages_async(const std::vector<uint32_t> &message_ids,
+                                             message_callback_t callback)
+{
+    return _impl->subscribe_messages_async(message_ids, callback);
+}
+
+void MAVLinkPassthrough::unsubscribe(subscription_handle_t handle)
+{
+    _impl->unsubscribe(handle);
+}
+
+MAVLinkPassthrough::Result MAVLinkPassthrough::send_message(const mavlink_message_t &message)
+{
+    return _impl->send_messages(&message, 1);
+}
+
+MAVLinkPassthrough::Result
+MAVLinkPassthrough::send_messages(const std::vector<mavlink_message_t> &messages)
+{
+    return _impl->send_messages(messages.data(), messages.size());
+}
+
+uint8_t MAVLinkPassthrough::get_our_sysid() const
+{
+    return _impl->get_our_sysid();
+}
+
+uint8_t MAVLinkPassthrough::get_our_compid() const
+{
+    return _impl->get_our_compid();
+}
+
+uint8_t MAVLinkPassthrough::get_target_sysid() const
+{
+    return _impl->get_target_sysid();
+}
+
+uint8_t MAVLinkPassthrough::get_target_compid() const
+{
+    return _impl->get_target_compid();
+}
+
+const char *MAVLinkPassthrough::result_str(Result result)
+{
+    switch (result) {
+        case Result::SUCCESS:
+            return "Success";
+        case Result::CONNECTION_ERROR:
+            return "Connection error";
+        case Result::UNKNOWN:
+        default:
+            return "Unknown";
+    }
+}
+
+} // namespace dronecore
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "mavlink_include.h"
+#include "plugin_base.h"
+
+namespace dronecore {
+
+class System;
+class MAVLinkPassthroughImpl;
+
+/**
+ * @brief The MAVLinkPassthrough class gives access to the raw MAVLink messages of a system.
+ *
+ * It is meant for messages which no other plugin covers. Only messages of the dialect
+ * DroneCore is built with can be received, as their CRC can't be checked otherwise.
+ */
+class MAVLinkPassthrough : public PluginBase
+{
+public:
+    /**
+     * @brief Constructor. Creates the plugin for a specific System.
+     *
+     * The plugin is typically created as shown below:
+     *
+     *     ```cpp
+     *     auto mavlink_passthrough = std::make_shared<MAVLinkPassthrough>(system);
+     *     ```
+     *
+     * @param system The specific system associated with this plugin.
+     */
+    explicit MAVLinkPassthrough(System &system);
+
+    /**
+     * @brief Destructor (internal use only).
+     */
+    ~MAVLinkPassthrough();
+
+    /**
+     * @brief Possible results returned when sending messages.
+     */
+    enum class Result {
+        SUCCESS = 0, /**< @brief Success. The messages were sent. */
+        CONNECTION_ERROR, /**< @brief Connection error. Not all messages could be sent. */
+        UNKNOWN /**< @brief Unspecified error. */
+    };
+
+    /**
+     * @brief Returns a human-readable English string for MAVLinkPassthrough::Result.
+     *
+     * @param result The enum value for which a human readable string is required.
+     * @return Human readable string for the MAVLinkPassthrough::Result.
+     */
+    static const char *result_str(Result result);
+
+    /**
+     * @brief A received message, without it being copied.
+     *
+     * It points into the receive buffer, so it is only valid during the callback.
+     */
+    struct FrameView {
+        uint32_t message_id; /**< @brief Message id. */
+        uint8_t system_id; /**< @brief System id of the sender. */
+        uint8_t component_id; /**< @brief Component id of the sender. */
+        uint8_t seq; /**< @brief Sequence number of the frame. */
+        /** @brief Payload in wire order, MAVLink 2 trims trailing zeros. */
+        const uint8_t *payload;
+        uint8_t payload_len; /**< @brief Length of the payload in bytes. */
+        /** @brief The frame as received, or packed again if it did not arrive in one piece. */
+        const uint8_t *frame;
+        unsigned frame_len; /**< @brief Length of the frame in bytes. */
+    };
+
+    /**
+     * @brief Handle for a subscription, see unsubscribe().
+     */
+    typedef uint64_t subscription_handle_t;
+
+    /**
+     * @brief Callback type for frames.
+     */
+    typedef std::function<void(const FrameView &)> frame_callback_t;
+
+    /**
+     * @brief Subscribe to the frames of some messages, called right as they are received.
+     *
+     * The callback is called on the thread which receives the messages, so it must be quick
+     * and must neither block nor call back into DroneCore, else receiving stalls.
+     *
+     * @param message_ids Ids of the messages to get.
+     * @param callback Function to call with every frame.
+     * @return Handle to unsubscribe this callback again.
+     */
+    subscription_handle_t subscribe_frames(const std::vector<uint32_t> &message_ids,
+                                           frame_callback_t callback);
+
+    /**
+     * @brief Callback type for messages.
+     */
+    typedef std::function<void(const mavlink_message_t &)> message_callback_t;
+
+    /**
+     * @brief Subscribe to some messages (asynchronous).
+     *
+     * The messages are copied and the callback is called off the receive thread, like for the
+     * other plugins. If the callback falls behind, the oldest messages are dropped.
+     *
+     * @param message_ids Ids of the messages to get.
+     * @param callback Function to call with every message.
+     * @return Handle to unsubscribe this callback again.
+     */
+    subscription_handle_t subscribe_messages_async(const std::vector<uint32_t> &message_ids,
+                                                   message_callback_t callback);
+
+    /**
+     * @brief Remove a subscription again.
+     *
+     * Once this returns, the callback is not called anymore.
+     *
+     * @param handle Handle returned when subscribing.
+     */
+    void unsubscribe(subscription_handle_t handle);
+
+    /**
+     * @brief Send a message to the system.
+     *
+     * @param message The message, packed e.g. with get_our_sysid() and get_our_compid().
+     * @return Result of the send.
+     */
+    Result send_message(const mavlink_message_t &message);
+
+    /**
+     * @brief Send several messages to the system at once.
+     *
+     * Where the connection supports it, they go out together, e.g. with one system call.
+     *
+     * @param messages The messages to send, in order.
+     * @return Result of the send.
+     */
+    Result send_messages(const std::vector<mavlink_message_t> &messages);
+
+    /**
+     * @brief System id which DroneCore sends with.
+     */
+    uint8_t get_our_sysid() const;
+
+    /**
+     * @brief Component id which DroneCore sends with.
+     */
+    uint8_t get_our_compid() const;
+
+    /**
+     * @brief System id of the system this plugin is for.
+     */
+    uint8_t get_target_sysid() const;
+
+    /**
+     * @brief Component id of the autopilot of the system this plugin is for.
+     */
+    uint8_t get_target_compid() const;
+
+    // Non-copyable
+    /**
+     * @brief Copy Constructor (object is not copyable).
+     */
+    MAVLinkPassthrough(const MAVLinkPassthrough &) = delete;
+    /**
+     * @brief Equality operator (object is not copyable).
+     */
+    const MAVLinkPassthrough &operator=(const MAVLinkPassthrough &) = delete;
+
+private:
+    /** @private Underlying implementation, set at instantiation */
+    std::unique_ptr<MAVLinkPassthroughImpl> _impl;
+};
+
+} // namespace dronecore
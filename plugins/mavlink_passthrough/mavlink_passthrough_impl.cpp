@@ -0,0 +1,147 @@
+#include "mavlink_passthrough_impl.h"
+#include "mavlink_message_view.h"
+#include "mavlink_system.h"
+#include "global_include.h"
+
+namespace dronecore {
+
+MAVLinkPassthroughImpl::MAVLinkPassthroughImpl(System &system) :
+    PluginImplBase(system)
+{
+    _parent->register_plugin(this);
+}
+
+MAVLinkPassthroughImpl::~MAVLinkPassthroughImpl()
+{
+    _parent->unregister_plugin(this);
+}
+
+void MAVLinkPassthroughImpl::init() {}
+
+void MAVLinkPassthroughImpl::deinit()
+{
+    unsubscribe_all();
+}
+
+void MAVLinkPassthroughImpl::enable() {}
+
+void MAVLinkPassthroughImpl::disable() {}
+
+MAVLinkPassthrough::subscription_handle_t
+MAVLinkPassthroughImpl::subscribe_frames(const std::vector<uint32_t> &message_ids,
+                                         MAVLinkPassthrough::frame_callback_t callback)
+{
+    auto subscription = std::make_shared<Subscription>(Subscription {callback, nullptr});
+
+    for (uint32_t message_id : message_ids) {
+        _parent->register_mavlink_message_view_handler(
+        message_id, [subscription](const MAVLinkMessageView & view) {
+            MAVLinkPassthrough::FrameView frame {
+                view.msgid(), view.sysid(), view.compid(), view.seq(),
+                view.payload(), view.payload_len(), view.frame(), view.frame_len()
+            };
+            // Only messages which were parsed byte by byte have no frame.
+            uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+            if (frame.frame == nullptr) {
+                frame.frame_len = mavlink_msg_to_send_buffer(buffer, &view.message());
+                frame.frame = buffer;
+            }
+            subscription->frame_callback(frame);
+        }, subscription.get());
+    }
+
+    return add_subscription(subscription);
+}
+
+MAVLinkPassthrough::subscription_handle_t
+MAVLinkPassthroughImpl::subscribe_messages_async(const std::vector<uint32_t> &message_ids,
+                                                 MAVLinkPassthrough::message_callback_t callback)
+{
+    auto subscription = std::make_shared<Subscription>(Subscription {nullptr, callback});
+
+    for (uint32_t message_id : message_ids) {
+        _parent->register_mavlink_message_handler(
+        message_id, [this, subscription](const mavlink_message_t &message) {
+            _parent->call_user_callback(subscription.get(), subscription.get(),
+            [subscription, message]() {
+                subscription->message_callback(message);
+            });
+        }, subscription.get());
+    }
+
+    return add_subscription(subscription);
+}
+
+MAVLinkPassthrough::subscription_handle_t
+MAVLinkPassthroughImpl::add_subscription(const std::shared_ptr<Subscription> &subscription)
+{
+    std::lock_guard<std::mutex> lock(_subscriptions_mutex);
+    const MAVLinkPassthrough::subscription_handle_t handle = _next_handle++;
+    _subscriptions[handle] = subscription;
+    return handle;
+}
+
+void MAVLinkPassthroughImpl::unsubscribe(MAVLinkPassthrough::subscription_handle_t handle)
+{
+    std::shared_ptr<Subscription> subscription;
+    {
+        std::lock_guard<std::mutex> lock(_subscriptions_mutex);
+        auto it = _subscriptions.find(handle);
+        if (it == _subscriptions.end()) {
+            return;
+        }
+        subscription = it->second;
+        _subscriptions.erase(it);
+    }
+
+    // Also drops its messages which have not been passed on yet.
+    _parent->unregister_all_mavlink_message_handlers(subscription.get());
+}
+
+void MAVLinkPassthroughImpl::unsubscribe_all()
+{
+    std::map<MAVLinkPassthrough::subscription_handle_t, std::shared_ptr<Subscription>>
+    subscriptions;
+    {
+        std::lock_guard<std::mutex> lock(_subscriptions_mutex);
+        subscriptions.swap(_subscriptions);
+    }
+
+    for (const auto &subscription : subscriptions) {
+        _parent->unregister_all_mavlink_message_handlers(subscription.second.get());
+    }
+}
+
+MAVLinkPassthrough::Result MAVLinkPassthroughImpl::send_messages(const mavlink_message_t *messages,
+                                                                 size_t num_messages)
+{
+    if (num_messages == 0) {
+        return MAVLinkPassthrough::Result::SUCCESS;
+    }
+
+    return _parent->send_messages(messages, num_messages) ?
+           MAVLinkPassthrough::Result::SUCCESS :
+           MAVLinkPassthrough::Result::CONNECTION_ERROR;
+}
+
+uint8_t MAVLinkPassthroughImpl::get_our_sysid() const
+{
+    return GCSClient::system_id;
+}
+
+uint8_t MAVLinkPassthroughImpl::get_our_compid() const
+{
+    return GCSClient::component_id;
+}
+
+uint8_t MAVLinkPassthroughImpl::get_target_sysid() const
+{
+    return _parent->get_system_id();
+}
+
+uint8_t MAVLinkPassthroughImpl::get_target_compid() const
+{
+    return _parent->get_autopilot_id();
+}
+
+} // namespace dronecore
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "mavlink_passthrough.h"
+#include "mavlink_include.h"
+#include "plugin_impl_base.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace dronecore {
+
+class MAVLinkPassthroughImpl : public PluginImplBase
+{
+public:
+    MAVLinkPassthroughImpl(System &system);
+    ~MAVLinkPassthroughImpl();
+
+    void init() override;
+    void deinit() override;
+
+    void enable() override;
+    void disable() override;
+
+    MAVLinkPassthrough::subscription_handle_t
+    subscribe_frames(const std::vector<uint32_t> &message_ids,
+                     MAVLinkPassthrough::frame_callback_t callback);
+    MAVLinkPassthrough::subscription_handle_t
+    subscribe_messages_async(const std::vector<uint32_t> &message_ids,
+                             MAVLinkPassthrough::message_callback_t callback);
+    void unsubscribe(MAVLinkPassthrough::subscription_handle_t handle);
+
+    MAVLinkPassthrough::Result send_messages(const mavlink_message_t *messages,
+                                             size_t num_messages);
+
+    uint8_t get_our_sysid() const;
+    uint8_t get_our_compid() const;
+    uint8_t get_target_sysid() const;
+    uint8_t get_target_compid() const;
+
+private:
+    // Each subscription is the cookie of its own handlers, so that they can
+    // be removed on their own. The handlers share it, as a dispatch might
+    // still be using it while it is unsubscribed.
+    struct Subscription {
+        MAVLinkPassthrough::frame_callback_t frame_callback;
+        MAVLinkPassthrough::message_callback_t message_callback;
+    };
+
+    MAVLinkPassthrough::subscription_handle_t
+    add_subscription(const std::shared_ptr<Subscription> &subscription);
+    void unsubscribe_all();
+
+    std::mutex _subscriptions_mutex {};
+    std::map<MAVLinkPassthrough::subscription_handle_t, std::shared_ptr<Subscription>>
+    _subscriptions {};
+    MAVLinkPassthrough::subscription_handle_t _next_handle = 1;
+};
+
+} // namespace dronecore
@@ -0,0 +1,31 @@
+#include "fleet_mission.h"
+#include "fleet_mission_impl.h"
+
+namespace dronecore {
+
+FleetMission::FleetMission(const std::vector<Mission *> &missions) :
+    _impl { new FleetMissionImpl(missions) }
+{
+}
+
+FleetMission::~FleetMission()
+{
+}
+
+size_t FleetMission::num_systems() const
+{
+    return _impl->num_systems();
+}
+
+void FleetMission::upload_mission_async(const Mission::mission_data_t &mission_data,
+                                        results_callback_t callback)
+{
+    _impl->upload_mission_async(mission_data, callback);
+}
+
+FleetMission::Progress FleetMission::get_upload_progress() const
+{
+    return _impl->get_upload_progress();
+}
+
+} // namespace dronecore
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "mission.h"
+
+namespace dronecore {
+
+class FleetMissionImpl;
+
+/**
+ * @brief The FleetMission class uploads the same mission to several systems at once.
+ *
+ * The MAVLink items of the mission are packed once and shared by the uploads, which all run
+ * at the same time. Each system goes through its Mission instance, which is busy until its
+ * upload is done, and afterwards knows the mission as if it had been uploaded with it.
+ */
+class FleetMission
+{
+public:
+    /**
+     * @brief Constructor. Creates the fleet for the Mission instances of specific systems.
+     *
+     *     ```cpp
+     *     auto fleet = std::make_shared<FleetMission>(std::vector<Mission *> {&mission_1,
+     *                                                                         &mission_2});
+     *     ```
+     *
+     * @param missions The Mission instances of the systems, which need to outlive the fleet.
+     */
+    explicit FleetMission(const std::vector<Mission *> &missions);
+
+    /**
+     * @brief Destructor, uploads in progress still go on.
+     */
+    ~FleetMission();
+
+    /**
+     * @brief Number of systems in the fleet.
+     */
+    size_t num_systems() const;
+
+    /**
+     * @brief Callback type for the results of an upload, one per system in the order of the
+     * systems.
+     */
+    typedef std::function<void(const std::vector<Mission::Result> &results)> results_callback_t;
+
+    /**
+     * @brief Uploads the mission to all systems at the same time (asynchronous).
+     *
+     * @param mission_data The mission items.
+     * @param callback Callback to receive the results once all uploads are done.
+     */
+    void upload_mission_async(const Mission::mission_data_t &mission_data,
+                              results_callback_t callback);
+
+    /**
+     * @brief Progress of an upload.
+     */
+    struct Progress {
+        float overall; /**< @brief From 0 to 1, over all systems. */
+        std::vector<float> systems; /**< @brief From 0 to 1, in the order of the systems. */
+    };
+
+    /**
+     * @brief Get the progress of the last upload.
+     *
+     * @return The progress, 1 for systems which are done whether it succeeded or not.
+     */
+    Progress get_upload_progress() const;
+
+    // Non-copyable
+    /**
+     * @brief Copy constructor (object is not copyable).
+     */
+    FleetMission(const FleetMission &) = delete;
+    /**
+     * @brief Equality operator (object is not copyable).
+     */
+    const FleetMission &operator=(const FleetMission &) = delete;
+
+private:
+    /** @private Underlying implementation, set at instantiation */
+    std::unique_ptr<FleetMissionImpl> _impl;
+};
+
+} // namespace dronecore
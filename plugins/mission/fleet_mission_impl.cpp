@@ -0,0 +1,111 @@
+#include "fleet_mission_impl.h"
+#include "log.h"
+
+namespace dronecore {
+
+FleetMissionImpl::FleetMissionImpl(const std::vector<Mission *> &missions) :
+    _missions(impls_of(missions))
+{
+}
+
+FleetMissionImpl::~FleetMissionImpl()
+{
+}
+
+std::vector<MissionImpl *> FleetMissionImpl::impls_of(const std::vector<Mission *> &missions)
+{
+    std::vector<MissionImpl *> impls;
+    impls.reserve(missions.size());
+    for (Mission *mission : missions) {
+        impls.push_back(mission->_impl.get());
+    }
+    return impls;
+}
+
+void FleetMissionImpl::upload_mission_async(const Mission::mission_data_t &mission_data,
+                                            const FleetMission::results_callback_t &callback)
+{
+    auto upload = std::make_shared<Upload>();
+    upload->results.assign(_missions.size(), Mission::Result::UNKNOWN);
+    upload->done.assign(_missions.size(), false);
+    upload->callback = callback;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _upload = upload;
+    }
+
+    if (_missions.empty()) {
+        if (callback) {
+            callback(upload->results);
+        }
+        return;
+    }
+
+    // Packed once for all of them, the transfers only fill in the addressing.
+    auto packed = std::make_shared<MissionImpl::PackedMission>();
+    if (!MissionImpl::pack_mission(mission_data, *packed)) {
+        for (size_t i = 0; i < _missions.size(); ++i) {
+            receive_result(upload, i, Mission::Result::INVALID_ARGUMENT);
+        }
+        return;
+    }
+
+    const std::shared_ptr<const MissionImpl::PackedMission> shared_packed = packed;
+    for (size_t i = 0; i < _missions.size(); ++i) {
+        _missions[i]->upload_packed_mission_async(
+        shared_packed, [upload, i](Mission::Result result) {
+            receive_result(upload, i, result);
+        });
+    }
+}
+
+void FleetMissionImpl::receive_result(const std::shared_ptr<Upload> &upload, size_t index,
+                                      Mission::Result result)
+{
+    FleetMission::results_callback_t callback;
+    std::vector<Mission::Result> results;
+    {
+        std::lock_guard<std::mutex> lock(upload->mutex);
+        upload->results[index] = result;
+        upload->done[index] = true;
+        if (++upload->num_done < upload->results.size()) {
+            return;
+        }
+        callback = std::move(upload->callback);
+        results = upload->results;
+    }
+
+    if (callback) {
+        callback(results);
+    }
+}
+
+FleetMission::Progress FleetMissionImpl::get_upload_progress() const
+{
+    FleetMission::Progress progress {0.0f, std::vector<float>(_missions.size(), 0.0f)};
+
+    std::shared_ptr<Upload> upload;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        upload = _upload;
+    }
+    if (!upload || _missions.empty()) {
+        return progress;
+    }
+
+    std::vector<bool> done;
+    {
+        std::lock_guard<std::mutex> lock(upload->mutex);
+        done = upload->done;
+    }
+
+    float sum = 0.0f;
+    for (size_t i = 0; i < _missions.size(); ++i) {
+        progress.systems[i] = done[i] ? 1.0f : _missions[i]->upload_progress();
+        sum += progress.systems[i];
+    }
+    progress.overall = sum / float(_missions.size());
+    return progress;
+}
+
+} // namespace dronecore
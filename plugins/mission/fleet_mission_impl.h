@@ -0,0 +1,50 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "fleet_mission.h"
+#include "mission_impl.h"
+
+namespace dronecore {
+
+class FleetMissionImpl
+{
+public:
+    explicit FleetMissionImpl(const std::vector<Mission *> &missions);
+    ~FleetMissionImpl();
+
+    size_t num_systems() const { return _missions.size(); }
+
+    void upload_mission_async(const Mission::mission_data_t &mission_data,
+                              const FleetMission::results_callback_t &callback);
+
+    FleetMission::Progress get_upload_progress() const;
+
+    // Non-copyable
+    FleetMissionImpl(const FleetMissionImpl &) = delete;
+    const FleetMissionImpl &operator=(const FleetMissionImpl &) = delete;
+
+private:
+    static std::vector<MissionImpl *> impls_of(const std::vector<Mission *> &missions);
+
+    // Shared with the callbacks of the uploads, so that it is fine to go
+    // away before they are done.
+    struct Upload {
+        std::mutex mutex {};
+        std::vector<Mission::Result> results {};
+        std::vector<bool> done {};
+        size_t num_done = 0;
+        FleetMission::results_callback_t callback {};
+    };
+
+    static void receive_result(const std::shared_ptr<Upload> &upload, size_t index,
+                               Mission::Result result);
+
+    const std::vector<MissionImpl *> _missions;
+
+    mutable std::mutex _mutex {};
+    std::shared_ptr<Upload> _upload {};
+};
+
+} // namespace dronecore
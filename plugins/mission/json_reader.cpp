@@ -0,0 +1,297 @@
+#include "json_reader.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace dronecore {
+
+JsonReader::JsonReader(std::istream &in) :
+    _buf(in.rdbuf())
+{
+}
+
+JsonReader::~JsonReader()
+{
+}
+
+JsonReader::Token JsonReader::next()
+{
+    if (_failed) {
+        return Token::ERROR;
+    }
+
+    skip_whitespace();
+    int c = get();
+
+    if (_stack.empty() && _after_value) {
+        // The root value is complete, only whitespace may follow.
+        if (c != EOF) {
+            return error();
+        }
+        return Token::END;
+    }
+
+    if (c == EOF) {
+        return error();
+    }
+
+    if (c == '}' || c == ']') {
+        const char opening = (c == '}') ? '{' : '[';
+        // Closing is fine after a value or right after opening, not after a ',' or a key.
+        if (_stack.empty() || _stack.back() != opening || (!_after_value && !_just_opened)) {
+            return error();
+        }
+        _stack.pop_back();
+        _after_value = true;
+        _just_opened = false;
+        return (c == '}') ? Token::OBJECT_END : Token::ARRAY_END;
+    }
+
+    if (_after_value) {
+        if (c != ',') {
+            return error();
+        }
+        _after_value = false;
+        skip_whitespace();
+        c = get();
+    }
+    _just_opened = false;
+
+    const bool in_object = !_stack.empty() && _stack.back() == '{';
+    if (in_object && !_after_key) {
+        if (c != '"' || !read_string()) {
+            return error();
+        }
+        skip_whitespace();
+        if (get() != ':') {
+            return error();
+        }
+        _after_key = true;
+        return Token::KEY;
+    }
+    _after_key = false;
+
+    return read_value(c);
+}
+
+bool JsonReader::skip_value()
+{
+    return skip_value(next());
+}
+
+bool JsonReader::skip_value(Token token)
+{
+    if (token == Token::OBJECT_BEGIN || token == Token::ARRAY_BEGIN) {
+        unsigned depth = 1;
+        while (depth > 0) {
+            token = next();
+            switch (token) {
+                case Token::OBJECT_BEGIN:
+                case Token::ARRAY_BEGIN:
+                    ++depth;
+                    break;
+                case Token::OBJECT_END:
+                case Token::ARRAY_END:
+                    --depth;
+                    break;
+                case Token::END:
+                case Token::ERROR:
+                    return false;
+                default:
+                    break;
+            }
+        }
+        return true;
+    }
+
+    return token == Token::STRING || token == Token::NUMBER ||
+           token == Token::BOOL || token == Token::NULL_VALUE;
+}
+
+int JsonReader::peek()
+{
+    const auto c = _buf->sgetc();
+    return (c == std::char_traits<char>::eof()) ? EOF : c;
+}
+
+int JsonReader::get()
+{
+    const auto c = _buf->sbumpc();
+    return (c == std::char_traits<char>::eof()) ? EOF : c;
+}
+
+void JsonReader::skip_whitespace()
+{
+    int c = peek();
+    while (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+        get();
+        c = peek();
+    }
+}
+
+JsonReader::Token JsonReader::read_value(int c)
+{
+    switch (c) {
+        case '{':
+            _stack.push_back('{');
+            _just_opened = true;
+            return Token::OBJECT_BEGIN;
+        case '[':
+            _stack.push_back('[');
+            _just_opened = true;
+            return Token::ARRAY_BEGIN;
+        case '"':
+            if (!read_string()) {
+                return error();
+            }
+            _after_value = true;
+            return Token::STRING;
+        case 't':
+            if (!read_literal("rue")) {
+                return error();
+            }
+            _boolean = true;
+            _after_value = true;
+            return Token::BOOL;
+        case 'f':
+            if (!read_literal("alse")) {
+                return error();
+            }
+            _boolean = false;
+            _after_value = true;
+            return Token::BOOL;
+        case 'n':
+            if (!read_literal("ull")) {
+                return error();
+            }
+            _after_value = true;
+            return Token::NULL_VALUE;
+        default:
+            if (c != '-' && (c < '0' || c > '9')) {
+                return error();
+            }
+            _string.assign(1, char(c));
+            if (!read_number()) {
+                return error();
+            }
+            _after_value = true;
+            return Token::NUMBER;
+    }
+}
+
+bool JsonReader::read_string()
+{
+    // The opening quote is already read. The string is reused, so reading
+    // keys does not allocate once it is long enough.
+    _string.clear();
+
+    while (true) {
+        int c = get();
+        if (c == EOF || (c >= 0 && c < 0x20)) {
+            return false;
+        }
+        if (c == '"') {
+            return true;
+        }
+        if (c != '\\') {
+            _string.push_back(char(c));
+            continue;
+        }
+
+        c = get();
+        switch (c) {
+            case '"':
+            case '\\':
+            case '/':
+                _string.push_back(char(c));
+                break;
+            case 'b':
+                _string.push_back('\b');
+                break;
+            case 'f':
+                _string.push_back('\f');
+                break;
+            case 'n':
+                _string.push_back('\n');
+                break;
+            case 'r':
+                _string.push_back('\r');
+                break;
+            case 't':
+                _string.push_back('\t');
+                break;
+            case 'u':
+                if (!read_unicode_escape()) {
+                    return false;
+                }
+                break;
+            default:
+                return false;
+        }
+    }
+}
+
+bool JsonReader::read_unicode_escape()
+{
+    // The backslash and the u are already read.
+    unsigned code_point = 0;
+    for (int i = 0; i < 4; ++i) {
+        const int c = get();
+        code_point <<= 4;
+        if (c >= '0' && c <= '9') {
+            code_point |= unsigned(c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            code_point |= unsigned(c - 'a' + 10);
+        } else if (c >= 'A' && c <= 'F') {
+            code_point |= unsigned(c - 'A' + 10);
+        } else {
+            return false;
+        }
+    }
+
+    // Surrogate pairs are not combined, none of the keys we look for need them.
+    if (code_point < 0x80) {
+        _string.push_back(char(code_point));
+    } else if (code_point < 0x800) {
+        _string.push_back(char(0xc0 | (code_point >> 6)));
+        _string.push_back(char(0x80 | (code_point & 0x3f)));
+    } else {
+        _string.push_back(char(0xe0 | (code_point >> 12)));
+        _string.push_back(char(0x80 | ((code_point >> 6) & 0x3f)));
+        _string.push_back(char(0x80 | (code_point & 0x3f)));
+    }
+    return true;
+}
+
+bool JsonReader::read_number()
+{
+    // The first character is already in _string.
+    int c = peek();
+    while ((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-') {
+        _string.push_back(char(get()));
+        c = peek();
+    }
+
+    char *end = nullptr;
+    _number = std::strtod(_string.c_str(), &end);
+    return end == _string.c_str() + _string.size();
+}
+
+bool JsonReader::read_literal(const char *literal)
+{
+    // The first character is already read.
+    for (size_t i = 0; i < std::strlen(literal); ++i) {
+        if (get() != literal[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+JsonReader::Token JsonReader::error()
+{
+    _failed = true;
+    return Token::ERROR;
+}
+
+} // namespace dronecore
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace dronecore {
+
+// Pull parser for JSON, it reads one token after the other straight from a
+// stream without building a document. Whatever is not needed can be skipped
+// with skip_value(), so memory does not grow with the size of the input.
+//
+// Structure is checked as far as it is read: a missing separator, an
+// unbalanced bracket or trailing garbage is an ERROR.
+class JsonReader
+{
+public:
+    enum class Token {
+        OBJECT_BEGIN,
+        OBJECT_END,
+        ARRAY_BEGIN,
+        ARRAY_END,
+        KEY, // Name of the member that follows, see string().
+        STRING,
+        NUMBER,
+        BOOL,
+        NULL_VALUE,
+        END, // The whole document was read.
+        ERROR
+    };
+
+    explicit JsonReader(std::istream &in);
+    ~JsonReader();
+
+    Token next();
+
+    // Skips the value following a KEY, or the next array element. If it is an
+    // object or array, it is skipped with all its content. Returns false on
+    // ERROR, or if there is no value but e.g. the end of the array.
+    bool skip_value();
+    // Same, for a value whose first token was already read.
+    bool skip_value(Token token);
+
+    // Of the last KEY or STRING.
+    const std::string &string() const { return _string; }
+    // Of the last NUMBER.
+    double number() const { return _number; }
+    // Of the last BOOL.
+    bool boolean() const { return _boolean; }
+
+    // Non-copyable
+    JsonReader(const JsonReader &) = delete;
+    const JsonReader &operator=(const JsonReader &) = delete;
+
+private:
+    int peek();
+    int get();
+    void skip_whitespace();
+
+    Token read_value(int c);
+    bool read_string();
+    bool read_unicode_escape();
+    bool read_number();
+    bool read_literal(const char *literal);
+
+    Token error();
+
+    std::streambuf *_buf;
+
+    // Open objects ('{') and arrays ('[').
+    std::vector<char> _stack {};
+    // A value was just read, so a separator or closing bracket comes next.
+    bool _after_value = false;
+    // An object or array was just opened, so it may be closed right away.
+    bool _just_opened = false;
+    // A key was just read, so its value comes next.
+    bool _after_key = false;
+    bool _failed = false;
+
+    std::string _string {};
+    double _number = 0.0;
+    bool _boolean = false;
+};
+
+} // namespace dronecore
@@ -0,0 +1,82 @@
+#include "json_reader.h"
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace dronecore;
+
+typedef JsonReader::Token Token;
+
+TEST(JsonReader, ReadsTokens)
+{
+    std::istringstream in("{\"a\": [1, -2.5e1, \"x\\n\\u00e4\"], \"b\": {}, \"c\": [true, null]}");
+    JsonReader reader(in);
+
+    EXPECT_EQ(reader.next(), Token::OBJECT_BEGIN);
+    EXPECT_EQ(reader.next(), Token::KEY);
+    EXPECT_EQ(reader.string(), "a");
+    EXPECT_EQ(reader.next(), Token::ARRAY_BEGIN);
+    EXPECT_EQ(reader.next(), Token::NUMBER);
+    EXPECT_DOUBLE_EQ(reader.number(), 1.0);
+    EXPECT_EQ(reader.next(), Token::NUMBER);
+    EXPECT_DOUBLE_EQ(reader.number(), -25.0);
+    EXPECT_EQ(reader.next(), Token::STRING);
+    EXPECT_EQ(reader.string(), "x\n\xc3\xa4");
+    EXPECT_EQ(reader.next(), Token::ARRAY_END);
+    EXPECT_EQ(reader.next(), Token::KEY);
+    EXPECT_EQ(reader.string(), "b");
+    EXPECT_EQ(reader.next(), Token::OBJECT_BEGIN);
+    EXPECT_EQ(reader.next(), Token::OBJECT_END);
+    EXPECT_EQ(reader.next(), Token::KEY);
+    EXPECT_EQ(reader.string(), "c");
+    EXPECT_EQ(reader.next(), Token::ARRAY_BEGIN);
+    EXPECT_EQ(reader.next(), Token::BOOL);
+    EXPECT_TRUE(reader.boolean());
+    EXPECT_EQ(reader.next(), Token::NULL_VALUE);
+    EXPECT_EQ(reader.next(), Token::ARRAY_END);
+    EXPECT_EQ(reader.next(), Token::OBJECT_END);
+    EXPECT_EQ(reader.next(), Token::END);
+}
+
+TEST(JsonReader, SkipsValues)
+{
+    std::istringstream in("{\"skip\": {\"x\": [[1], {\"y\": 2}]}, \"keep\": 3}");
+    JsonReader reader(in);
+
+    EXPECT_EQ(reader.next(), Token::OBJECT_BEGIN);
+    EXPECT_EQ(reader.next(), Token::KEY);
+    EXPECT_TRUE(reader.skip_value());
+    EXPECT_EQ(reader.next(), Token::KEY);
+    EXPECT_EQ(reader.string(), "keep");
+    EXPECT_EQ(reader.next(), Token::NUMBER);
+    EXPECT_DOUBLE_EQ(reader.number(), 3.0);
+    EXPECT_EQ(reader.next(), Token::OBJECT_END);
+    EXPECT_EQ(reader.next(), Token::END);
+}
+
+TEST(JsonReader, FailsOnMalformed)
+{
+    const char *malformed[] = {
+        "",
+        "{",
+        "[1 2]",
+        "[1,]",
+        "{\"a\" 1}",
+        "{\"a\": 1,}",
+        "{\"a\"}",
+        "[1}",
+        "[tru]",
+        "[1.2.3]",
+        "{} {}",
+    };
+
+    for (const char *json : malformed) {
+        std::istringstream in(json);
+        JsonReader reader(in);
+
+        Token token;
+        do {
+            token = reader.next();
+        } while (token != Token::END && token != Token::ERROR);
+        EXPECT_EQ(token, Token::ERROR) << json;
+    }
+}
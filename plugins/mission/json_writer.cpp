@@ -0,0 +1,186 @@
+#include "json_writer.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace dronecore {
+
+JsonWriter::JsonWriter(std::ostream &out) :
+    _out(out)
+{
+}
+
+JsonWriter::~JsonWriter() {}
+
+void JsonWriter::begin_object()
+{
+    begin_container('{');
+}
+
+void JsonWriter::end_object()
+{
+    end_container('}');
+}
+
+void JsonWriter::begin_array()
+{
+    begin_container('[');
+}
+
+void JsonWriter::end_array()
+{
+    end_container(']');
+}
+
+void JsonWriter::key(const char *name)
+{
+    begin_value();
+    write_string(name, strlen(name));
+    _out.write(": ", 2);
+    _after_key = true;
+}
+
+void JsonWriter::value(double number)
+{
+    if (!std::isfinite(number)) {
+        null_value();
+        return;
+    }
+
+    begin_value();
+
+    // Most numbers of a plan, like coordinates, are short with 15 digits,
+    // only some need all 17 to be read back the same.
+    char buffer[32];
+    int len = snprintf(buffer, sizeof(buffer), "%.15g", number);
+    if (strtod(buffer, nullptr) != number) {
+        len = snprintf(buffer, sizeof(buffer), "%.17g", number);
+    }
+    _out.write(buffer, len);
+}
+
+void JsonWriter::value(int number)
+{
+    begin_value();
+
+    char buffer[16];
+    const int len = snprintf(buffer, sizeof(buffer), "%d", number);
+    _out.write(buffer, len);
+}
+
+void JsonWriter::value(bool boolean)
+{
+    begin_value();
+    if (boolean) {
+        _out.write("true", 4);
+    } else {
+        _out.write("false", 5);
+    }
+}
+
+void JsonWriter::value(const char *string)
+{
+    begin_value();
+    write_string(string, strlen(string));
+}
+
+void JsonWriter::value(const std::string &string)
+{
+    begin_value();
+    write_string(string.data(), string.size());
+}
+
+void JsonWriter::null_value()
+{
+    begin_value();
+    _out.write("null", 4);
+}
+
+void JsonWriter::begin_value()
+{
+    if (_after_key) {
+        _after_key = false;
+        return;
+    }
+    if (_stack.empty()) {
+        return;
+    }
+    if (!_empty) {
+        _out.put(',');
+    }
+    _empty = false;
+    write_indent();
+}
+
+void JsonWriter::begin_container(char bracket)
+{
+    begin_value();
+    _out.put(bracket);
+    _stack.push_back(bracket);
+    _empty = true;
+}
+
+void JsonWriter::end_container(char bracket)
+{
+    _stack.pop_back();
+    if (!_empty) {
+        write_indent();
+    }
+    _out.put(bracket);
+    _empty = false;
+
+    if (_stack.empty()) {
+        _out.put('\n');
+    }
+}
+
+void JsonWriter::write_string(const char *string, size_t len)
+{
+    _out.put('"');
+    for (size_t i = 0; i < len; ++i) {
+        const char c = string[i];
+        switch (c) {
+            case '"':
+                _out.write("\\\"", 2);
+                break;
+            case '\\':
+                _out.write("\\\\", 2);
+                break;
+            case '\n':
+                _out.write("\\n", 2);
+                break;
+            case '\r':
+                _out.write("\\r", 2);
+                break;
+            case '\t':
+                _out.write("\\t", 2);
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buffer[8];
+                    snprintf(buffer, sizeof(buffer), "\\u%04x", unsigned(c));
+                    _out.write(buffer, 6);
+                } else {
+                    // UTF-8 goes through as it is.
+                    _out.put(c);
+                }
+        }
+    }
+    _out.put('"');
+}
+
+void JsonWriter::write_indent()
+{
+    // Indented like the plans of QGroundControl, 4 spaces per level.
+    static const char spaces[] = "                                ";
+    _out.put('\n');
+    size_t indent = _stack.size() * 4;
+    while (indent > 0) {
+        const size_t len = indent < sizeof(spaces) - 1 ? indent : sizeof(spaces) - 1;
+        _out.write(spaces, len);
+        indent -= len;
+    }
+}
+
+} // namespace dronecore
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace dronecore {
+
+// Writes JSON token by token straight to a stream, the counterpart of
+// JsonReader. Nothing is kept but the open objects and arrays, so memory does
+// not grow with the size of the output.
+//
+// Separators and indentation are taken care of, but the order of the calls is
+// up to the caller: a value in an object needs to follow a key().
+class JsonWriter
+{
+public:
+    explicit JsonWriter(std::ostream &out);
+    ~JsonWriter();
+
+    void begin_object();
+    void end_object();
+    void begin_array();
+    void end_array();
+
+    // Name of the member whose value is written next.
+    void key(const char *name);
+
+    // Numbers are written as short as they can be read back to the same
+    // double. JSON has no NaN or infinity, they are written as null.
+    void value(double number);
+    void value(int number);
+    void value(bool boolean);
+    void value(const char *string);
+    void value(const std::string &string);
+    void null_value();
+
+    // Non-copyable
+    JsonWriter(const JsonWriter &) = delete;
+    const JsonWriter &operator=(const JsonWriter &) = delete;
+
+private:
+    // Before each key or array element.
+    void begin_value();
+    void begin_container(char bracket);
+    void end_container(char bracket);
+    void write_string(const char *string, size_t len);
+    void write_indent();
+
+    std::ostream &_out;
+
+    // Open objects ('{') and arrays ('[').
+    std::vector<char> _stack {};
+    // Nothing was written in the innermost object or array yet.
+    bool _empty = true;
+    // A key was just written, so its value follows on the same line.
+    bool _after_key = false;
+};
+
+} // namespace dronecore
@@ -0,0 +1,74 @@
+#include "json_reader.h"
+#include "json_writer.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <sstream>
+
+using namespace dronecore;
+
+typedef JsonReader::Token Token;
+
+TEST(JsonWriter, WritesIndented)
+{
+    std::ostringstream out;
+    JsonWriter writer(out);
+
+    writer.begin_object();
+    writer.key("a");
+    writer.begin_array();
+    writer.value(1);
+    writer.value(-2.5);
+    writer.end_array();
+    writer.key("b");
+    writer.begin_object();
+    writer.end_object();
+    writer.key("c");
+    writer.value(true);
+    writer.end_object();
+
+    EXPECT_EQ(out.str(),
+              "{\n"
+              "    \"a\": [\n"
+              "        1,\n"
+              "        -2.5\n"
+              "    ],\n"
+              "    \"b\": {},\n"
+              "    \"c\": true\n"
+              "}\n");
+}
+
+TEST(JsonWriter, ReadsBackTheSame)
+{
+    const double numbers[] = {47.39781011, 0.1, 1.0 / 3.0, -1e-300, 8.54553801};
+
+    std::ostringstream out;
+    JsonWriter writer(out);
+    writer.begin_array();
+    for (double number : numbers) {
+        writer.value(number);
+    }
+    writer.value(double(NAN));
+    writer.value("x\n\"\\\x01\xc3\xa4");
+    writer.value(false);
+    writer.null_value();
+    writer.end_array();
+
+    std::istringstream in(out.str());
+    JsonReader reader(in);
+    EXPECT_EQ(reader.next(), Token::ARRAY_BEGIN);
+    for (double number : numbers) {
+        EXPECT_EQ(reader.next(), Token::NUMBER);
+        EXPECT_EQ(reader.number(), number);
+    }
+    EXPECT_EQ(reader.next(), Token::NULL_VALUE);
+    EXPECT_EQ(reader.next(), Token::STRING);
+    EXPECT_EQ(reader.string(), "x\n\"\\\x01\xc3\xa4");
+    EXPECT_EQ(reader.next(), Token::BOOL);
+    EXPECT_FALSE(reader.boolean());
+    EXPECT_EQ(reader.next(), Token::NULL_VALUE);
+    EXPECT_EQ(reader.next(), Token::ARRAY_END);
+    EXPECT_EQ(reader.next(), Token::END);
+
+    // Short numbers stay short.
+    EXPECT_NE(out.str().find("47.39781011,"), std::string::npos);
+}
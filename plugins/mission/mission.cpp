@@ -1,5 +1,7 @@
 #include "mission.h"
 #include "mission_impl.h"
+#include "survey_generator.h"
+#include <utility>
 #include <vector>
 #include "mavlink_include.h"
 
@@ -22,11 +24,60 @@ void Mission::upload_mission_async(const std::vector<std::shared_ptr<MissionItem
     _impl->upload_mission_async(mission_items, callback);
 }
 
+void Mission::upload_mission_async(const mission_data_t &mission_data,
+                                   result_callback_t callback)
+{
+    _impl->upload_mission_async(mission_data, callback);
+}
+
+void Mission::upload_mission_async(mission_data_t &&mission_data, result_callback_t callback)
+{
+    _impl->upload_mission_async(std::move(mission_data), callback);
+}
+
+void Mission::upload_mission_async(int count, mission_item_source_t source,
+                                   result_callback_t callback)
+{
+    _impl->upload_mission_async(count, source, callback);
+}
+
+void Mission::set_differential_upload(bool enable)
+{
+    _impl->set_differential_upload(enable);
+}
+
+void Mission::set_download_window(unsigned window)
+{
+    _impl->set_download_window(window);
+}
+
+void Mission::set_cached_download(bool enable)
+{
+    _impl->set_cached_download(enable);
+}
+
 void Mission::download_mission_async(Mission::mission_items_and_result_callback_t callback)
 {
     _impl->download_mission_async(callback);
 }
 
+void Mission::upload_geofence_async(const std::vector<GeofencePolygon> &polygons,
+                                    result_callback_t callback)
+{
+    _impl->upload_geofence_async(polygons, callback);
+}
+
+void Mission::upload_geofence_async(shared_geofence_t polygons, result_callback_t callback)
+{
+    _impl->upload_geofence_async(polygons, callback);
+}
+
+void Mission::upload_rally_points_async(const std::vector<RallyPoint> &rally_points,
+                                        result_callback_t callback)
+{
+    _impl->upload_rally_points_async(rally_points, callback);
+}
+
 void Mission::start_mission_async(result_callback_t callback)
 {
     _impl->start_mission_async(callback);
@@ -70,6 +121,10 @@ const char *Mission::result_str(Result result)
             return "Failed to parse QGC plan";
         case Result::UNSUPPORTED_MISSION_CMD:
             return "Unsupported Mission command";
+        case Result::FAILED_TO_WRITE_FILE:
+            return "Failed to write file";
+        case Result::INVALID_MISSION_FILE:
+            return "Invalid mission file";
         case Result::UNKNOWN:
         default:
             return "Unknown";
@@ -91,10 +146,46 @@ void Mission::subscribe_progress(progress_callback_t callback)
     _impl->subscribe_progress(callback);
 }
 
+void Mission::subscribe_progress_details(progress_details_callback_t callback)
+{
+    _impl->subscribe_progress_details(callback);
+}
+
 Mission::Result Mission::import_qgroundcontrol_mission(Mission::mission_items_t &mission_items,
                                                        const std::string &qgc_plan_file)
 {
     return MissionImpl::import_qgroundcontrol_mission(mission_items, qgc_plan_file);
 }
 
+Mission::Result Mission::import_qgroundcontrol_mission(Mission::mission_data_t &mission_data,
+                                                       const std::string &qgc_plan_file)
+{
+    return MissionImpl::import_qgroundcontrol_mission(mission_data, qgc_plan_file);
+}
+
+Mission::Result Mission::export_qgroundcontrol_mission(const Mission::mission_data_t &mission_data,
+                                                       const std::string &qgc_plan_file)
+{
+    return MissionImpl::export_qgroundcontrol_mission(mission_data, qgc_plan_file);
+}
+
+Mission::Result Mission::save_mission(const Mission::mission_data_t &mission_data,
+                                      const std::string &mission_file)
+{
+    return MissionImpl::save_mission(mission_data, mission_file);
+}
+
+Mission::Result Mission::load_mission(Mission::mission_data_t &mission_data,
+                                      const std::string &mission_file)
+{
+    return MissionImpl::load_mission(mission_data, mission_file);
+}
+
+Mission::Result Mission::generate_survey(Mission::mission_data_t &mission_data,
+                                         const std::vector<SurveyVertex> &polygon,
+                                         const SurveySettings &settings)
+{
+    return SurveyGenerator::generate(mission_data, polygon, settings);
+}
+
 } // namespace dronelin
@@ -50,7 +50,9 @@ public:
         NO_MISSION_AVAILABLE, /**< @brief No mission available on system. */
         FAILED_TO_OPEN_QGC_PLAN, /**< @brief Failed to open QGroundControl plan */
         FAILED_TO_PARSE_QGC_PLAN, /**< @brief Failed to parse QGroundControl plan */
-        UNSUPPORTED_MISSION_CMD /**< @brief Unsupported mission command */
+        UNSUPPORTED_MISSION_CMD, /**< @brief Unsupported mission command */
+        FAILED_TO_WRITE_FILE, /**< @brief Failed to write QGroundControl plan or mission file */
+        INVALID_MISSION_FILE /**< @brief Failed to open mission file or it is damaged */
     };
 
     /**
@@ -71,6 +73,14 @@ public:
      */
     typedef std::vector<std::shared_ptr<MissionItem>> mission_items_t;
 
+    /**
+     * @brief Type for vector of mission items stored by value.
+     *
+     * This needs one allocation for the whole mission instead of one per item and is
+     * preferable for large missions.
+     */
+    typedef std::vector<MissionItemData> mission_data_t;
+
     /**
      * @brief Imports a **QGroundControl** (QGC) mission plan.
      *
@@ -89,6 +99,101 @@ public:
     static Result import_qgroundcontrol_mission(mission_items_t &mission_items,
                                                 const std::string &qgc_plan_file);
 
+    /**
+     * @brief Imports a **QGroundControl** (QGC) mission plan into plain mission item data.
+     *
+     * Same as the overload for `mission_items_t`, without an allocation per item.
+     *
+     * @param[out] mission_data Vector of mission item data imported from QGC plan.
+     * @param qgc_plan_file File path of the QGC plan.
+     * @return Result::SUCCESS if successful in importing QGC mission items.
+     *     Otherwise one of the error codes: Result::FAILED_TO_OPEN_QGC_PLAN,
+     *     Result::FAILED_TO_PARSE_QGC_PLAN, Result::UNSUPPORTED_MISSION_CMD.
+     */
+    static Result import_qgroundcontrol_mission(mission_data_t &mission_data,
+                                                const std::string &qgc_plan_file);
+
+    /**
+     * @brief Exports mission item data as a **QGroundControl** (QGC) mission plan.
+     *
+     * The plan is written while the items are converted, so that memory does not grow with
+     * the size of the mission. It can be imported again with import_qgroundcontrol_mission().
+     *
+     * @param mission_data Vector of mission item data to export.
+     * @param qgc_plan_file File path of the QGC plan, it is replaced if it exists.
+     * @return Result::SUCCESS if successful in exporting the mission.
+     *     Otherwise one of the error codes: Result::TOO_MANY_MISSION_ITEMS,
+     *     Result::FAILED_TO_WRITE_FILE.
+     */
+    static Result export_qgroundcontrol_mission(const mission_data_t &mission_data,
+                                                const std::string &qgc_plan_file);
+
+    /**
+     * @brief Saves mission item data in the binary mission file format of %DroneCore.
+     *
+     * The items are stored as they are, so this is much faster to save and load than a QGC
+     * plan and meant to archive or cache missions. The format is versioned, files of other
+     * versions of %DroneCore may not load.
+     *
+     * @param mission_data Vector of mission item data to save.
+     * @param mission_file File path of the mission file, it is replaced if it exists.
+     * @return Result::SUCCESS if successful, otherwise Result::FAILED_TO_WRITE_FILE.
+     */
+    static Result save_mission(const mission_data_t &mission_data,
+                               const std::string &mission_file);
+
+    /**
+     * @brief Loads mission item data saved with save_mission().
+     *
+     * The file is memory-mapped and the items are copied straight out of it. Not supported on
+     * Windows.
+     *
+     * @param[out] mission_data Vector of mission item data loaded, left as it is on failure.
+     * @param mission_file File path of the mission file.
+     * @return Result::SUCCESS if successful, otherwise Result::INVALID_MISSION_FILE.
+     */
+    static Result load_mission(mission_data_t &mission_data, const std::string &mission_file);
+
+    /**
+     * @brief Vertex of a survey area.
+     */
+    struct SurveyVertex {
+        double latitude_deg; /**< @brief Latitude in degrees. */
+        double longitude_deg; /**< @brief Longitude in degrees. */
+    };
+
+    /**
+     * @brief Settings for generate_survey().
+     */
+    struct SurveySettings {
+        double line_spacing_m = 20.0; /**< @brief Distance between the lines in metres. */
+        /** @brief Direction of the lines in degrees (0: north, positive clock-wise). */
+        double heading_deg = 0.0;
+        float relative_altitude_m = 20.0f; /**< @brief Altitude relative to takeoff in metres. */
+        float speed_m_s = 5.0f; /**< @brief Speed along the lines in metres/second. */
+        /** @brief Distance between photos along the lines in metres, 0 for no photos. */
+        double photo_distance_m = 0.0;
+    };
+
+    /**
+     * @brief Generates a lawnmower survey over a polygon (synchronous).
+     *
+     * Parallel lines with the given spacing and heading are laid over the polygon and flown in
+     * alternating directions. If photos are requested, photos are captured at an interval
+     * matching the distance while flying along a line, with the gimbal pointing down.
+     *
+     * The items are appended, so e.g. a takeoff item can be added before. The polygon should
+     * not be larger than a few kilometres, the geometry is computed in a plane tangent to it.
+     *
+     * @param[out] mission_data Vector the mission item data is appended to.
+     * @param polygon Vertices of the area to survey, at least 3.
+     * @param settings Settings of the survey.
+     * @return Result::SUCCESS if the survey was generated, otherwise Result::INVALID_ARGUMENT.
+     */
+    static Result generate_survey(mission_data_t &mission_data,
+                                  const std::vector<SurveyVertex> &polygon,
+                                  const SurveySettings &settings);
+
     /**
      * @brief Uploads a vector of mission items to the system (asynchronous).
      *
@@ -101,6 +206,180 @@ public:
     void upload_mission_async(const std::vector<std::shared_ptr<MissionItem>> &mission_items,
                               result_callback_t callback);
 
+    /**
+     * @brief Uploads a vector of mission item data to the system (asynchronous).
+     *
+     * Same as the overload for mission items, the data is copied once and packed to MAVLink
+     * straight from the contiguous copy.
+     *
+     * @param mission_data Reference to vector of mission item data.
+     * @param callback Callback to receive result of this request.
+     */
+    void upload_mission_async(const mission_data_t &mission_data, result_callback_t callback);
+
+    /**
+     * @brief Uploads a vector of mission item data to the system, taking it over (asynchronous).
+     *
+     * Same as the overload above, but without the copy, e.g. for large surveys.
+     *
+     * @param mission_data Mission item data, which is moved from.
+     * @param callback Callback to receive result of this request.
+     */
+    void upload_mission_async(mission_data_t &&mission_data, result_callback_t callback);
+
+    /**
+     * @brief Callback type to get the mission item with an index for uploading.
+     *
+     * It has to give the same item every time it is called for the same index.
+     *
+     * @param index Index of the mission item (0 based).
+     * @return The mission item.
+     */
+    typedef std::function<std::shared_ptr<MissionItem>(int index)> mission_item_source_t;
+
+    /**
+     * @brief Uploads mission items which are generated on demand (asynchronous).
+     *
+     * Unlike with a vector, the items don't all need to exist at once. Each item is requested
+     * from `source` once when the upload starts, to count the MAVLink items, and once more when
+     * the system asks for it. This keeps memory low for very large missions, e.g. surveys.
+     *
+     * `source` is called from DroneCore's threads and must not call back into Mission.
+     *
+     * @param count Number of mission items.
+     * @param source Callback which gives the mission item for an index.
+     * @param callback Callback to receive result of this request.
+     */
+    void upload_mission_async(int count, mission_item_source_t source,
+                              result_callback_t callback);
+
+    /**
+     * @brief Only upload the mission items which changed (synchronous).
+     *
+     * If enabled, an upload is compared with the mission which was last uploaded to or
+     * downloaded from the system. If only some items changed, just the range from the first to
+     * the last changed item is written using a partial write, if nothing changed the upload
+     * succeeds right away. If the number of MAVLink items differs or the system does not support
+     * partial writes, the whole mission is uploaded as usual.
+     *
+     * What a system holds is remembered by its UUID for as long as DroneCore runs, so uploading
+     * the same mission again e.g. after reconnecting returns right away as well.
+     *
+     * Changes made to the mission by somebody else (e.g. another ground station) are not
+     * noticed, so this should only be enabled if DroneCore is the only one writing missions.
+     *
+     * This applies to geofence and rally point uploads as well.
+     *
+     * @param enable true to enable differential uploads, false (default) to always upload all.
+     */
+    void set_differential_upload(bool enable);
+
+    /**
+     * @brief Sets how many mission items are requested at once when downloading.
+     *
+     * By default, the next item is only requested once the previous one arrived, so a download
+     * takes at least one round trip per item. With a larger window, several requests are
+     * outstanding and the replies can come in any order. On a timeout, only the items which are
+     * still missing are requested again.
+     *
+     * Not all autopilots answer requests which are not in order, so this should only be raised
+     * for systems known to support it.
+     *
+     * @param window Number of outstanding item requests, 1 (default) requests one at a time.
+     */
+    void set_download_window(unsigned window);
+
+    /**
+     * @brief Enables or disables downloads which take the mission already known of a system.
+     *
+     * If enabled, a download first asks the system for the number of items. If that matches
+     * the mission last uploaded to or downloaded from the system, the known mission is returned
+     * right away instead of downloading all items again, e.g. after reconnecting. The progress
+     * is still followed by the current item which the system sends anyway.
+     *
+     * The known mission is kept by UUID, for as long as DroneCore runs. Only the number of
+     * items is compared, so changes by somebody else (e.g. another ground station) which
+     * keep the number of items are not noticed. This should only be enabled if DroneCore is
+     * the only one writing missions.
+     *
+     * @param enable true to use the known mission, false (default) to always download all.
+     */
+    void set_cached_download(bool enable);
+
+    /**
+     * @brief Vertex of a geofence polygon.
+     */
+    struct GeofenceVertex {
+        double latitude_deg; /**< @brief Latitude in degrees. */
+        double longitude_deg; /**< @brief Longitude in degrees. */
+    };
+
+    /**
+     * @brief Polygon of a geofence.
+     */
+    struct GeofencePolygon {
+        /**
+         * @brief Whether the vehicle has to stay inside or outside of the polygon.
+         */
+        enum class Type {
+            INCLUSION, /**< @brief The vehicle has to stay inside. */
+            EXCLUSION /**< @brief The vehicle has to stay outside. */
+        };
+
+        Type type = Type::INCLUSION; /**< @brief Type of the polygon. */
+        std::vector<GeofenceVertex> vertices {}; /**< @brief Vertices, at least 3. */
+    };
+
+    /**
+     * @brief Uploads a geofence to the system (asynchronous).
+     *
+     * The geofence replaces the one on the system. It is transferred the same way as a mission,
+     * so it can consist of thousands of vertices and can be uploaded while a mission transfer
+     * is going on.
+     *
+     * @param polygons Polygons of the geofence, an empty vector removes the geofence.
+     * @param callback Callback to receive result of this request.
+     */
+    void upload_geofence_async(const std::vector<GeofencePolygon> &polygons,
+                               result_callback_t callback);
+
+    /**
+     * @brief Polygons of a geofence which are shared rather than copied, e.g. with Geofence.
+     */
+    typedef std::shared_ptr<const std::vector<GeofencePolygon>> shared_geofence_t;
+
+    /**
+     * @brief Uploads a geofence to the system without copying it (asynchronous).
+     *
+     * Like upload_geofence_async(const std::vector<GeofencePolygon> &, result_callback_t), but
+     * the polygons are only referenced until the upload is done, so the same ones can be given
+     * to Geofence::set_polygons() for checking positions.
+     *
+     * @param polygons Polygons of the geofence, an empty vector removes the geofence.
+     * @param callback Callback to receive result of this request.
+     */
+    void upload_geofence_async(shared_geofence_t polygons, result_callback_t callback);
+
+    /**
+     * @brief Rally point, where the vehicle can go instead of home on return.
+     */
+    struct RallyPoint {
+        double latitude_deg; /**< @brief Latitude in degrees. */
+        double longitude_deg; /**< @brief Longitude in degrees. */
+        float relative_altitude_m; /**< @brief Altitude relative to takeoff in metres. */
+    };
+
+    /**
+     * @brief Uploads rally points to the system (asynchronous).
+     *
+     * The rally points replace the ones on the system.
+     *
+     * @param rally_points Rally points, an empty vector removes them.
+     * @param callback Callback to receive result of this request.
+     */
+    void upload_rally_points_async(const std::vector<RallyPoint> &rally_points,
+                                   result_callback_t callback);
+
     /**
      * @brief Callback type for `download_mission_async()` call to get mission items and result.
      */
@@ -194,6 +473,42 @@ public:
      */
     void subscribe_progress(progress_callback_t callback);
 
+    /**
+     * @brief Mission progress with what is left of the mission.
+     *
+     * Distances are along the mission items, from the position of the system to the current
+     * item and from there on in straight lines. The time is estimated with the speeds set by
+     * the mission items, or the cruise speed of the system (MPC_XY_CRUISE) where none is set,
+     * as well as the loiter times.
+     */
+    struct ProgressDetails {
+        int current; /**< @brief Current mission item index (0 based). */
+        int total; /**< @brief Total number of mission items. */
+        double next_item_distance_m; /**< @brief Distance to the current mission item. */
+        double remaining_distance_m; /**< @brief Distance left until the end of the mission. */
+        /** @brief Time left until the end of the mission, NAN if the cruise speed is needed
+         * but not known. */
+        double remaining_time_s;
+    };
+
+    /**
+     * @brief Callback type to receive mission progress with what is left of the mission.
+     *
+     * @param details The progress.
+     */
+    typedef std::function<void(const ProgressDetails &details)> progress_details_callback_t;
+
+    /**
+     * @brief Subscribes to mission progress with what is left of the mission (asynchronous).
+     *
+     * It is called at the same times as the callback of subscribe_progress(). The distances
+     * along the mission are summed up once the mission is uploaded or downloaded, so nothing is
+     * walked through at each update.
+     *
+     * @param callback Callback to receive mission progress.
+     */
+    void subscribe_progress_details(progress_details_callback_t callback);
+
     // Non-copyable
     /**
      * @brief Copy constructor (object is not copyable).
@@ -205,6 +520,9 @@ public:
     const Mission &operator=(const Mission &) = delete;
 
 private:
+    /** @private Uploads through the implementation of each system. */
+    friend class FleetMissionImpl;
+
     /** @private Underlying implementation, set at instantiation */
     std::unique_ptr<MissionImpl> _impl;
 };
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "awaitable.h"
+#include "mission.h"
+
+namespace dronecore {
+
+/**
+ * @brief Awaitable variants of the `*_async` calls of Mission (C++20).
+ *
+ * A mission can be flown as one sequence, e.g.
+ * `co_await mission.upload_mission(items); co_await mission.start_mission();
+ * co_await mission.finished();`.
+ */
+class AwaitableMission
+{
+public:
+    /**
+     * @brief Constructor.
+     *
+     * @param mission Mission plugin, which needs to outlive this.
+     * @param executor Executor to resume on, e.g. RunLoop::executor().
+     */
+    AwaitableMission(Mission &mission, executor_t executor) :
+        _mission(mission),
+        _executor(std::move(executor)) {}
+
+    /** @brief See Mission::upload_mission_async(). */
+    CallbackAwaitable<Mission::Result>
+    upload_mission(std::vector<std::shared_ptr<MissionItem>> mission_items)
+    {
+        return {_executor, [this, mission_items](Mission::result_callback_t callback) {
+            _mission.upload_mission_async(mission_items, callback);
+        }};
+    }
+
+    /** @brief See Mission::upload_mission_async(), the data is moved on. */
+    CallbackAwaitable<Mission::Result> upload_mission(Mission::mission_data_t mission_data)
+    {
+        auto data = std::make_shared<Mission::mission_data_t>(std::move(mission_data));
+        return {_executor, [this, data](Mission::result_callback_t callback) {
+            _mission.upload_mission_async(std::move(*data), callback);
+        }};
+    }
+
+    /** @brief See Mission::download_mission_async(), gives the result and the items. */
+    CallbackAwaitable<Mission::Result, std::vector<std::shared_ptr<MissionItem>>>
+    download_mission()
+    {
+        return {_executor, [this](Mission::mission_items_and_result_callback_t callback) {
+            _mission.download_mission_async(callback);
+        }};
+    }
+
+    /** @brief See Mission::start_mission_async(). */
+    CallbackAwaitable<Mission::Result> start_mission()
+    {
+        return {_executor, [this](Mission::result_callback_t callback) {
+            _mission.start_mission_async(callback);
+        }};
+    }
+
+    /** @brief See Mission::pause_mission_async(). */
+    CallbackAwaitable<Mission::Result> pause_mission()
+    {
+        return {_executor, [this](Mission::result_callback_t callback) {
+            _mission.pause_mission_async(callback);
+        }};
+    }
+
+    /** @brief See Mission::set_current_mission_item_async(). */
+    CallbackAwaitable<Mission::Result> set_current_mission_item(int current)
+    {
+        return {_executor, [this, current](Mission::result_callback_t callback) {
+            _mission.set_current_mission_item_async(current, callback);
+        }};
+    }
+
+    /**
+     * @brief Awaits the next progress, as current and total item.
+     *
+     * This takes the place of Mission::subscribe_progress() while waiting.
+     */
+    SubscriptionAwaitable<std::pair<int, int>> progress()
+    {
+        return progress_until(nullptr);
+    }
+
+    /**
+     * @brief Awaits the progress which says the mission is finished, see progress().
+     */
+    SubscriptionAwaitable<std::pair<int, int>> finished()
+    {
+        return progress_until([](const std::pair<int, int> &progress) {
+            return progress.first == progress.second;
+        });
+    }
+
+private:
+    SubscriptionAwaitable<std::pair<int, int>>
+    progress_until(SubscriptionAwaitable<std::pair<int, int>>::predicate_t predicate)
+    {
+        return {_executor,
+        [this](std::function<void(std::pair<int, int>)> callback) {
+            _mission.subscribe_progress([callback](int current, int total) {
+                callback(std::make_pair(current, total));
+            });
+            return uint64_t(0);
+        }, [this](uint64_t /* subscription */) {
+            _mission.subscribe_progress(nullptr);
+        }, predicate};
+    }
+
+    Mission &_mission;
+    executor_t _executor;
+};
+
+} // namespace dronecore
@@ -0,0 +1,179 @@
+#include "mission_file.h"
+#include "global_include.h"
+#include "log.h"
+
+#ifndef WINDOWS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace dronecore {
+
+constexpr uint32_t MissionFile::VERSION;
+constexpr size_t MissionFile::HEADER_LEN;
+constexpr size_t MissionFile::RECORD_LEN;
+
+namespace {
+
+const char MAGIC[] = {'D', 'C', 'M', 'S'};
+
+template<typename T>
+void write_at(uint8_t *destination, T value)
+{
+    memcpy(destination, &value, sizeof(value));
+}
+
+template<typename T>
+T read_at(const uint8_t *source)
+{
+    T value;
+    memcpy(&value, source, sizeof(value));
+    return value;
+}
+
+} // namespace
+
+MissionFile::MissionFile() {}
+
+MissionFile::~MissionFile()
+{
+    close();
+}
+
+bool MissionFile::write(const std::string &path, const Mission::mission_data_t &mission_data)
+{
+    if (mission_data.size() > UINT32_MAX) {
+        LogErr() << "Too many mission items for a mission file: " << mission_data.size();
+        return false;
+    }
+
+    // All of it is put together first, so that it is written at once.
+    std::vector<uint8_t> buffer(HEADER_LEN + mission_data.size() * RECORD_LEN, 0);
+    memcpy(buffer.data(), MAGIC, sizeof(MAGIC));
+    write_at(&buffer[4], VERSION);
+    write_at(&buffer[8], uint32_t(RECORD_LEN));
+    write_at(&buffer[12], uint32_t(mission_data.size()));
+
+    uint8_t *record = buffer.data() + HEADER_LEN;
+    for (const auto &data : mission_data) {
+        write_at(record, data.latitude_deg);
+        write_at(record + 8, data.longitude_deg);
+        write_at(record + 16, data.camera_photo_interval_s);
+        write_at(record + 24, data.relative_altitude_m);
+        write_at(record + 28, data.speed_m_s);
+        write_at(record + 32, data.gimbal_pitch_deg);
+        write_at(record + 36, data.gimbal_yaw_deg);
+        write_at(record + 40, data.loiter_time_s);
+        record[44] = uint8_t(data.camera_action);
+        record[45] = data.fly_through ? 1 : 0;
+        record += RECORD_LEN;
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(buffer.data()), std::streamsize(buffer.size()));
+    file.close();
+    if (!file) {
+        LogErr() << "Could not write mission file " << path;
+        return false;
+    }
+    return true;
+}
+
+bool MissionFile::open(const std::string &path)
+{
+    close();
+
+#ifdef WINDOWS
+    UNUSED(path);
+    LogErr() << "Memory-mapped mission files are not supported on Windows";
+    return false;
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LogErr() << "Could not open " << path << ": " << strerror(errno);
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        LogErr() << "Could not get size of " << path << ": " << strerror(errno);
+        ::close(fd);
+        return false;
+    }
+
+    const size_t len = size_t(file_stat.st_size);
+    if (len < HEADER_LEN) {
+        LogErr() << path << " is too short for a mission file";
+        ::close(fd);
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid without the descriptor.
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        LogErr() << "Could not map " << path << ": " << strerror(errno);
+        return false;
+    }
+
+    _data = static_cast<const uint8_t *>(mapping);
+    _len = len;
+
+    const size_t num_items = read_at<uint32_t>(_data + 12);
+    if (memcmp(_data, MAGIC, sizeof(MAGIC)) != 0 ||
+        read_at<uint32_t>(_data + 4) != VERSION ||
+        read_at<uint32_t>(_data + 8) != RECORD_LEN ||
+        len != HEADER_LEN + num_items * RECORD_LEN) {
+        LogErr() << path << " is no valid mission file";
+        close();
+        return false;
+    }
+    _num_items = num_items;
+    return true;
+#endif
+}
+
+void MissionFile::close()
+{
+#ifndef WINDOWS
+    if (_data != nullptr) {
+        munmap(const_cast<uint8_t *>(_data), _len);
+    }
+#endif
+    _data = nullptr;
+    _len = 0;
+    _num_items = 0;
+}
+
+bool MissionFile::item(size_t index, MissionItemData &data) const
+{
+    if (index >= _num_items) {
+        return false;
+    }
+
+    const uint8_t *record = _data + HEADER_LEN + index * RECORD_LEN;
+    if (record[44] > uint8_t(MissionItem::CameraAction::NONE) || record[45] > 1) {
+        return false;
+    }
+
+    data.latitude_deg = read_at<double>(record);
+    data.longitude_deg = read_at<double>(record + 8);
+    data.camera_photo_interval_s = read_at<double>(record + 16);
+    data.relative_altitude_m = read_at<float>(record + 24);
+    data.speed_m_s = read_at<float>(record + 28);
+    data.gimbal_pitch_deg = read_at<float>(record + 32);
+    data.gimbal_yaw_deg = read_at<float>(record + 36);
+    data.loiter_time_s = read_at<float>(record + 40);
+    data.camera_action = static_cast<MissionItem::CameraAction>(record[44]);
+    data.fly_through = (record[45] != 0);
+    return true;
+}
+
+} // namespace dronecore
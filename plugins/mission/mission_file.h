@@ -0,0 +1,56 @@
+#pragma once
+
+#include "mission.h"
+#include "mission_item.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace dronecore {
+
+// Missions stored as fixed-width records, to archive and cache them without
+// any text to format or parse.
+//
+// File layout, in host byte order (little endian on all supported platforms):
+//   Header:  magic "DCMS", version (u32), record length (u32),
+//            number of items (u32).
+//   Records: latitude, longitude, photo interval (f64), relative altitude,
+//            speed, gimbal pitch, gimbal yaw, loiter time (f32),
+//            camera action (u8), fly-through (u8), 2 bytes padding.
+//
+// Opening a file maps it and only checks the header against its length, the
+// items are read straight out of the mapping when they are asked for.
+class MissionFile
+{
+public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t HEADER_LEN = 16;
+    static constexpr size_t RECORD_LEN = 48;
+
+    MissionFile();
+    ~MissionFile();
+
+    // Creates or truncates the file at path.
+    static bool write(const std::string &path, const Mission::mission_data_t &mission_data);
+
+    // Returns false if it is no mission file of this version, or memory-mapped
+    // files are not supported on this platform.
+    bool open(const std::string &path);
+    void close();
+    bool is_open() const { return _data != nullptr; }
+
+    size_t size() const { return _num_items; }
+    // Returns false if the record is no valid item, e.g. of a damaged file.
+    bool item(size_t index, MissionItemData &data) const;
+
+    // Non-copyable
+    MissionFile(const MissionFile &) = delete;
+    const MissionFile &operator=(const MissionFile &) = delete;
+
+private:
+    const uint8_t *_data = nullptr;
+    size_t _len = 0;
+    size_t _num_items = 0;
+};
+
+} // namespace dronecore
@@ -0,0 +1,82 @@
+#include "mission_file.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+
+using namespace dronecore;
+
+#ifndef WINDOWS
+
+TEST(MissionFile, ReadsWhatWasWritten)
+{
+    Mission::mission_data_t mission_data(3);
+    mission_data[0].latitude_deg = 47.39781011;
+    mission_data[0].longitude_deg = 8.54553801;
+    mission_data[0].relative_altitude_m = 15.0f;
+    mission_data[0].fly_through = true;
+    mission_data[1].speed_m_s = 4.5f;
+    mission_data[1].gimbal_pitch_deg = -90.0f;
+    mission_data[1].camera_action = MissionItem::CameraAction::START_PHOTO_INTERVAL;
+    mission_data[1].camera_photo_interval_s = 2.5;
+    mission_data[2].loiter_time_s = 30.0f;
+
+    const std::string path = "mission_file_test.mission";
+    ASSERT_TRUE(MissionFile::write(path, mission_data));
+
+    MissionFile file;
+    ASSERT_TRUE(file.open(path));
+    ASSERT_EQ(file.size(), mission_data.size());
+    for (size_t i = 0; i < file.size(); ++i) {
+        MissionItemData data;
+        ASSERT_TRUE(file.item(i, data));
+
+        MissionItem item;
+        item.set_data(data);
+        MissionItem expected;
+        expected.set_data(mission_data[i]);
+        EXPECT_EQ(item, expected);
+    }
+    MissionItemData data;
+    EXPECT_FALSE(file.item(file.size(), data));
+    file.close();
+
+    Mission::mission_data_t loaded;
+    EXPECT_EQ(Mission::load_mission(loaded, path), Mission::Result::SUCCESS);
+    EXPECT_EQ(loaded.size(), mission_data.size());
+
+    std::remove(path.c_str());
+}
+
+TEST(MissionFile, RejectsOtherFiles)
+{
+    const std::string path = "mission_file_test_invalid.mission";
+    ASSERT_TRUE(MissionFile::write(path, Mission::mission_data_t(2)));
+
+    // Cut off in the middle of the last item.
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::string content((std::istreambuf_iterator<char>(in)),
+                            std::istreambuf_iterator<char>());
+        in.close();
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(content.data(), std::streamsize(content.size() - 1));
+    }
+
+    MissionFile file;
+    EXPECT_FALSE(file.open(path));
+
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << "{\"fileType\": \"Plan\"}";
+    }
+    EXPECT_FALSE(file.open(path));
+
+    Mission::mission_data_t mission_data(1);
+    EXPECT_EQ(Mission::load_mission(mission_data, path), Mission::Result::INVALID_MISSION_FILE);
+    EXPECT_EQ(mission_data.size(), 1);
+
+    std::remove(path.c_str());
+    EXPECT_FALSE(file.open(path));
+}
+
+#endif
@@ -1,15 +1,20 @@
 #include "mission_impl.h"
 #include "mission_item_impl.h"
+#include "mission_file.h"
 #include "system.h"
 #include "global_include.h"
 #include <fstream> // for `std::ifstream`
 #include <sstream> // for `std::stringstream`
+#include <algorithm>
 #include <cmath>
 
 namespace dronecore {
 
 MissionImpl::MissionImpl(System &system) :
-    PluginImplBase(system)
+    PluginImplBase(system),
+    _mission_transfer(*_parent, MAV_MISSION_TYPE_MISSION),
+    _fence_transfer(*_parent, MAV_MISSION_TYPE_FENCE),
+    _rally_transfer(*_parent, MAV_MISSION_TYPE_RALLY)
 {
     _parent->register_plugin(this);
 }
@@ -23,18 +28,6 @@ void MissionImpl::init()
 {
     using namespace std::placeholders; // for `_1`
 
-    _parent->register_mavlink_message_handler(
-        MAVLINK_MSG_ID_MISSION_REQUEST,
-        std::bind(&MissionImpl::process_mission_request, this, _1), this);
-
-    _parent->register_mavlink_message_handler(
-        MAVLINK_MSG_ID_MISSION_REQUEST_INT,
-        std::bind(&MissionImpl::process_mission_request_int, this, _1), this);
-
-    _parent->register_mavlink_message_handler(
-        MAVLINK_MSG_ID_MISSION_ACK,
-        std::bind(&MissionImpl::process_mission_ack, this, _1), this);
-
     _parent->register_mavlink_message_handler(
         MAVLINK_MSG_ID_MISSION_CURRENT,
         std::bind(&MissionImpl::process_mission_current, this, _1), this);
@@ -44,114 +37,47 @@ void MissionImpl::init()
         std::bind(&MissionImpl::process_mission_item_reached, this, _1), this);
 
     _parent->register_mavlink_message_handler(
-        MAVLINK_MSG_ID_MISSION_COUNT,
-        std::bind(&MissionImpl::process_mission_count, this, _1), this);
+        MAVLINK_MSG_ID_GLOBAL_POSITION_INT,
+        std::bind(&MissionImpl::process_global_position_int, this, _1), this);
 
-    _parent->register_mavlink_message_handler(
-        MAVLINK_MSG_ID_MISSION_ITEM_INT,
-        std::bind(&MissionImpl::process_mission_item_int, this, _1), this);
+    _mission_transfer.init();
+    _fence_transfer.init();
+    _rally_transfer.init();
 }
 
-void MissionImpl::enable() {}
-
-void MissionImpl::disable()
+void MissionImpl::enable()
 {
-    _parent->unregister_timeout_handler(_timeout_cookie);
-}
+    using namespace std::placeholders; // for `_1`
 
-void MissionImpl::deinit()
-{
-    _parent->unregister_all_mavlink_message_handlers(this);
+    // For the legs of the mission without a speed of their own.
+    _parent->get_param_float_async("MPC_XY_CRUISE",
+                                   std::bind(&MissionImpl::receive_cruise_speed, this, _1, _2));
 }
 
-void MissionImpl::process_mission_request(const mavlink_message_t &unused)
+void MissionImpl::disable()
 {
-    // We only support int, so we nack this and thus tell the autopilot to use int.
-    UNUSED(unused);
-
-    mavlink_message_t message;
-    mavlink_msg_mission_ack_pack(GCSClient::system_id,
-                                 GCSClient::component_id,
-                                 &message,
-                                 _parent->get_system_id(),
-                                 _parent->get_autopilot_id(),
-                                 MAV_MISSION_UNSUPPORTED,
-                                 MAV_MISSION_TYPE_MISSION);
-
-    _parent->send_message(message);
-
-    // Reset the timeout because we're still communicating.
-    _parent->refresh_timeout_handler(_timeout_cookie);
+    _mission_transfer.disable();
+    _fence_transfer.disable();
+    _rally_transfer.disable();
 }
 
-void MissionImpl::process_mission_request_int(const mavlink_message_t &message)
+void MissionImpl::add_resource_usage(DroneCore::ResourceUsage &usage)
 {
     std::lock_guard<std::mutex> lock(_mutex);
-
-    mavlink_mission_request_int_t mission_request_int;
-    mavlink_msg_mission_request_int_decode(&message, &mission_request_int);
-
-    if (mission_request_int.target_system != GCSClient::system_id &&
-        mission_request_int.target_component != GCSClient::component_id) {
-
-        LogWarn() << "Ignore mission request int that is not for us";
-        return;
-    }
-
-    if (_activity != Activity::SET_MISSION) {
-        LogWarn() << "Ignoring mission request int, not active";
-        return;
-    }
-
-    _retries = 0;
-    upload_mission_item(mission_request_int.seq);
-
-
-    // Reset the timeout because we're still communicating.
-    _parent->refresh_timeout_handler(_timeout_cookie);
+    usage.mission_bytes += _mission_items.size() *
+                           (sizeof(std::shared_ptr<MissionItem>) + sizeof(MissionItem) +
+                            sizeof(MissionItemImpl)) +
+                           _first_seq_of_mission_items.capacity() * sizeof(int) +
+                           _route.bytes();
 }
 
-void MissionImpl::process_mission_ack(const mavlink_message_t &message)
+void MissionImpl::deinit()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-
-    if (_activity != Activity::SET_MISSION) {
-        LogWarn() << "Error: not sure how to process Mission ack.";
-        return;
-    }
-
-    mavlink_mission_ack_t mission_ack;
-    mavlink_msg_mission_ack_decode(&message, &mission_ack);
-
-    if (mission_ack.target_system != GCSClient::system_id &&
-        mission_ack.target_component != GCSClient::component_id) {
-
-        LogWarn() << "Ignore mission ack that is not for us";
-        return;
-    }
-
-    // We got some response, so it wasn't a timeout and we can remove it.
-    _parent->unregister_timeout_handler(_timeout_cookie);
-
-    if (mission_ack.type == MAV_MISSION_ACCEPTED) {
-
-        // Reset current and reached; we don't want to get confused
-        // from earlier messages.
-        _last_current_mavlink_mission_item = -1;
-        _last_reached_mavlink_mission_item = -1;
-
-        _activity = Activity::NONE;
-
-        report_mission_result(_result_callback, Mission::Result::SUCCESS);
-        LogInfo() << "Mission accepted";
-    } else if (mission_ack.type == MAV_MISSION_NO_SPACE) {
-        LogErr() << "Error: too many waypoints: " << int(mission_ack.type);
-        report_mission_result(_result_callback, Mission::Result::TOO_MANY_MISSION_ITEMS);
-    } else {
-        LogErr() << "Error: unknown mission ack: " << int(mission_ack.type);
-        report_mission_result(_result_callback, Mission::Result::ERROR);
-    }
+    _parent->unregister_all_mavlink_message_handlers(this);
 
+    _mission_transfer.deinit();
+    _fence_transfer.deinit();
+    _rally_transfer.deinit();
 }
 
 void MissionImpl::process_mission_current(const mavlink_message_t &message)
@@ -170,7 +96,6 @@ void MissionImpl::process_mission_current(const mavlink_message_t &message)
         _last_current_mavlink_mission_item == mission_current.seq) {
         report_mission_result(_result_callback, Mission::Result::SUCCESS);
         _last_current_mavlink_mission_item = -1;
-        _parent->unregister_timeout_handler(_timeout_cookie);
         _activity = Activity::NONE;
     }
 }
@@ -188,395 +113,559 @@ void MissionImpl::process_mission_item_reached(const mavlink_message_t &message)
     }
 }
 
-void MissionImpl::process_mission_count(const mavlink_message_t &message)
+void MissionImpl::process_global_position_int(const mavlink_message_t &message)
 {
+    mavlink_global_position_int_t global_position_int;
+    mavlink_msg_global_position_int_decode(&message, &global_position_int);
+
+    // Only kept for the next progress, it is not reported by itself.
     std::lock_guard<std::mutex> lock(_mutex);
+    _position.latitude_deg = global_position_int.lat * 1e-7;
+    _position.longitude_deg = global_position_int.lon * 1e-7;
+    _position.relative_altitude_m = global_position_int.relative_alt * 1e-3f;
+}
 
-    if (_activity != Activity::GET_MISSION) {
+void MissionImpl::receive_cruise_speed(bool success, float speed_m_s)
+{
+    if (!success) {
+        LogDebug() << "No cruise speed, the mission time can't be estimated";
         return;
     }
 
-    mavlink_mission_count_t mission_count;
-    mavlink_msg_mission_count_decode(&message, &mission_count);
-
-    _num_mission_items_to_download = mission_count.count;
-    _next_mission_item_to_download = 0;
-    // We are now requesting mission items and use a lower timeout for this.
-    _parent->unregister_timeout_handler(_timeout_cookie);
-
-    _parent->register_timeout_handler(std::bind(&MissionImpl::process_timeout, this),
-                                      RETRY_TIMEOUT_S, &_timeout_cookie);
-    download_next_mission_item();
+    std::lock_guard<std::mutex> lock(_mutex);
+    _cruise_speed_m_s = double(speed_m_s);
 }
 
-void MissionImpl::process_mission_item_int(const mavlink_message_t &message)
+void MissionImpl::upload_mission_async(const std::vector<std::shared_ptr<MissionItem>>
+                                       &mission_items,
+                                       const Mission::result_callback_t &callback)
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-
-    auto mission_item_int_ptr = std::make_shared<mavlink_mission_item_int_t>();
-    mavlink_msg_mission_item_int_decode(&message, mission_item_int_ptr.get());
+    // Only the pointers are copied, the items are packed once they are requested.
+    auto items = std::make_shared<const Mission::mission_items_t>(mission_items);
+    upload_mission_data_async(int(items->size()), [items](int index, MissionItemData & data) {
+        const std::shared_ptr<MissionItem> &item = items->at(size_t(index));
+        if (!item) {
+            return false;
+        }
+        data = item->_impl->get_data();
+        return true;
+    }, callback);
+}
 
-    if (mission_item_int_ptr->seq == _next_mission_item_to_download) {
-        LogDebug() << "Received mission item " << _next_mission_item_to_download;
+void MissionImpl::upload_mission_async(const Mission::mission_data_t &mission_data,
+                                       const Mission::result_callback_t &callback)
+{
+    upload_mission_async(Mission::mission_data_t(mission_data), callback);
+}
 
-        _mavlink_mission_items_downloaded.push_back(mission_item_int_ptr);
-        _retries = 0;
+void MissionImpl::upload_mission_async(Mission::mission_data_t &&mission_data,
+                                       const Mission::result_callback_t &callback)
+{
+    auto items = std::make_shared<const Mission::mission_data_t>(std::move(mission_data));
+    upload_mission_data_async(int(items->size()), [items](int index, MissionItemData & data) {
+        data = items->at(size_t(index));
+        return true;
+    }, callback);
+}
 
-        if (_next_mission_item_to_download + 1 == _num_mission_items_to_download) {
+void MissionImpl::upload_mission_async(int count,
+                                       const Mission::mission_item_source_t &source,
+                                       const Mission::result_callback_t &callback)
+{
+    if (!source) {
+        report_mission_result(callback, Mission::Result::INVALID_ARGUMENT);
+        return;
+    }
 
-            // Wrap things up if we're finished.
-            _parent->unregister_timeout_handler(_timeout_cookie);
+    upload_mission_data_async(count, [source](int index, MissionItemData & data) {
+        std::shared_ptr<MissionItem> item = source(index);
+        if (!item) {
+            return false;
+        }
+        data = item->_impl->get_data();
+        return true;
+    }, callback);
+}
 
-            mavlink_message_t ack_message;
-            mavlink_msg_mission_ack_pack(GCSClient::system_id,
-                                         GCSClient::component_id,
-                                         &ack_message,
-                                         _parent->get_system_id(),
-                                         _parent->get_autopilot_id(),
-                                         MAV_MISSION_ACCEPTED,
-                                         MAV_MISSION_TYPE_MISSION);
+void MissionImpl::upload_mission_data_async(int count,
+                                            const data_source_t &source,
+                                            const Mission::result_callback_t &callback)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
 
-            _parent->send_message(ack_message);
+    if (_activity != Activity::NONE) {
+        report_mission_result(callback, Mission::Result::BUSY);
+        return;
+    }
 
-            assemble_mission_items();
+    if (count < 0 || !source) {
+        report_mission_result(callback, Mission::Result::INVALID_ARGUMENT);
+        return;
+    }
 
-        } else {
-            // Otherwise keep going.
-            ++_next_mission_item_to_download;
-            _parent->refresh_timeout_handler(_timeout_cookie);
-            download_next_mission_item();
+    // The count has to be sent first, so we go through the items once to see
+    // how many MAVLink items they turn into. Only the first seq of each is kept,
+    // and the hashes which tell the transfer what changed.
+    auto upload = std::make_shared<Upload>();
+    upload->source = source;
+    upload->num_mission_items = count;
+    std::vector<int> first_seq_of_mission_items;
+    first_seq_of_mission_items.reserve(size_t(count));
+    std::vector<uint64_t> item_hashes;
+    LastPosition last_position {};
+    MissionRoute route;
+    MissionItemData data;
+    for (int i = 0; i < count; ++i) {
+        if (!source(i, data)) {
+            LogErr() << "No mission item for index " << i;
+            report_mission_result(callback, Mission::Result::INVALID_ARGUMENT);
+            return;
         }
+        route.append(data);
+        first_seq_of_mission_items.push_back(int(item_hashes.size()));
+        assemble_mavlink_mission_items(data, int(item_hashes.size()),
+                                       last_position, upload->items);
+        for (const auto &item : upload->items) {
+            item_hashes.push_back(MissionTransfer::hash_item(item));
+        }
+    }
+    rewind_upload(*upload);
 
-    } else {
-        LogDebug() << "Received mission item " << int(mission_item_int_ptr->seq)
-                   << " instead of " << _next_mission_item_to_download << " (ignored)";
+    _num_mission_items = count;
+    _num_mavlink_mission_items = int(item_hashes.size());
+    _first_seq_of_mission_items = std::move(first_seq_of_mission_items);
+    _route = std::move(route);
+    _mission_items.clear();
+    _activity = Activity::SET_MISSION;
 
-        // Refresh because we at least still seem to be active.
-        _parent->refresh_timeout_handler(_timeout_cookie);
+    // The transfer calls back without its lock, so we must not hold ours.
+    lock.unlock();
+    _mission_transfer.upload_async(
+        std::move(item_hashes),
+    [this, upload](int seq, mavlink_mission_item_int_t & item) {
+        return pack_mavlink_mission_item(*upload, seq, item);
+    },
+    [this, callback](Mission::Result result) {
+        receive_upload_result(result, callback);
+    });
+}
 
-        // And request it again in case our request got lost.
-        download_next_mission_item();
-        return;
+bool MissionImpl::pack_mission(const Mission::mission_data_t &mission_data,
+                               PackedMission &packed)
+{
+    packed = PackedMission {};
+    packed.num_mission_items = int(mission_data.size());
+    packed.first_seq_of_mission_items.reserve(mission_data.size());
+
+    LastPosition last_position {};
+    std::vector<mavlink_mission_item_int_t> items;
+    for (const auto &data : mission_data) {
+        packed.route.append(data);
+        packed.first_seq_of_mission_items.push_back(int(packed.items.size()));
+        assemble_mavlink_mission_items(data, int(packed.items.size()), last_position, items);
+        packed.items.insert(packed.items.end(), items.begin(), items.end());
     }
 
+    if (packed.items.size() > UINT16_MAX) {
+        LogErr() << "Too many MAVLink mission items: " << packed.items.size();
+        return false;
+    }
+
+    packed.item_hashes.reserve(packed.items.size());
+    for (const auto &item : packed.items) {
+        packed.item_hashes.push_back(MissionTransfer::hash_item(item));
+    }
+    return true;
 }
 
-void MissionImpl::upload_mission_async(const std::vector<std::shared_ptr<MissionItem>>
-                                       &mission_items,
-                                       const Mission::result_callback_t &callback)
+void MissionImpl::upload_packed_mission_async(const std::shared_ptr<const PackedMission> &packed,
+                                              const Mission::result_callback_t &callback)
 {
-    std::lock_guard<std::mutex> lock(_mutex);
+    std::unique_lock<std::mutex> lock(_mutex);
 
     if (_activity != Activity::NONE) {
         report_mission_result(callback, Mission::Result::BUSY);
         return;
     }
 
-    if (!_parent->does_support_mission_int()) {
-        LogWarn() << "Mission int messages not supported";
-        report_mission_result(callback, Mission::Result::ERROR);
+    if (!packed) {
+        report_mission_result(callback, Mission::Result::INVALID_ARGUMENT);
         return;
     }
 
-    copy_mission_item_vector(mission_items);
+    _num_mission_items = packed->num_mission_items;
+    _num_mavlink_mission_items = int(packed->items.size());
+    _first_seq_of_mission_items = packed->first_seq_of_mission_items;
+    _route = packed->route;
+    _mission_items.clear();
+    _activity = Activity::SET_MISSION;
 
-    assemble_mavlink_messages();
+    // The transfer calls back without its lock, so we must not hold ours.
+    lock.unlock();
+    _mission_transfer.upload_async(
+        std::vector<uint64_t>(packed->item_hashes),
+    [packed](int seq, mavlink_mission_item_int_t & item) {
+        if (seq < 0 || seq >= int(packed->items.size())) {
+            return false;
+        }
+        item = packed->items[size_t(seq)];
+        return true;
+    },
+    [this, callback](Mission::Result result) {
+        receive_upload_result(result, callback);
+    });
+}
 
-    mavlink_message_t message;
-    mavlink_msg_mission_count_pack(GCSClient::system_id,
-                                   GCSClient::component_id,
-                                   &message,
-                                   _parent->get_system_id(),
-                                   _parent->get_autopilot_id(),
-                                   _mavlink_mission_item_messages.size(),
-                                   MAV_MISSION_TYPE_MISSION);
+float MissionImpl::upload_progress()
+{
+    return _mission_transfer.upload_progress();
+}
 
-    if (!_parent->send_message(message)) {
-        report_mission_result(callback, Mission::Result::ERROR);
-        return;
+void MissionImpl::receive_upload_result(Mission::Result result,
+                                        const Mission::result_callback_t &callback)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (result == Mission::Result::SUCCESS) {
+        // Reset current and reached; we don't want to get confused
+        // from earlier messages.
+        _last_current_mavlink_mission_item = -1;
+        _last_reached_mavlink_mission_item = -1;
     }
 
-    // We use the longer process timeout here because essentially the autopilot needs to pull
-    // the items up.
-    _parent->register_timeout_handler(std::bind(&MissionImpl::process_timeout, this),
-                                      PROCESS_TIMEOUT_S, &_timeout_cookie);
+    _activity = Activity::NONE;
+    report_mission_result(callback, result);
+}
+
+void MissionImpl::set_differential_upload(bool enable)
+{
+    _mission_transfer.set_differential_upload(enable);
+    _fence_transfer.set_differential_upload(enable);
+    _rally_transfer.set_differential_upload(enable);
+}
 
-    _activity = Activity::SET_MISSION;
-    _result_callback = callback;
+void MissionImpl::set_download_window(unsigned window)
+{
+    _mission_transfer.set_download_window(window);
+}
+
+void MissionImpl::set_cached_download(bool enable)
+{
+    _mission_transfer.set_cached_download(enable);
 }
 
 void MissionImpl::download_mission_async(const Mission::mission_items_and_result_callback_t
                                          &callback)
 {
-    std::lock_guard<std::mutex> lock(_mutex);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
 
-    if (_activity != Activity::NONE) {
-        report_mission_items_and_result(callback, Mission::Result::BUSY);
-        return;
+        if (_activity != Activity::NONE) {
+            report_mission_items_and_result(callback, Mission::Result::BUSY);
+            return;
+        }
+
+        _activity = Activity::GET_MISSION;
     }
 
-    mavlink_message_t message;
-    mavlink_msg_mission_request_list_pack(GCSClient::system_id,
-                                          GCSClient::component_id,
-                                          &message,
-                                          _parent->get_system_id(),
-                                          _parent->get_autopilot_id(),
-                                          MAV_MISSION_TYPE_MISSION);
+    _mission_transfer.download_async(
+    [this, callback](Mission::Result result, std::vector<mavlink_mission_item_int_t> items) {
+        std::lock_guard<std::mutex> lock(_mutex);
 
-    if (!_parent->send_message(message)) {
-        report_mission_items_and_result(callback, Mission::Result::ERROR);
+        _activity = Activity::NONE;
+        if (result != Mission::Result::SUCCESS) {
+            report_mission_items_and_result(callback, result);
+            return;
+        }
+        assemble_mission_items(items, callback);
+    });
+}
+
+void MissionImpl::upload_geofence_async(const std::vector<Mission::GeofencePolygon> &polygons,
+                                        const Mission::result_callback_t &callback)
+{
+    upload_geofence_async(std::make_shared<const std::vector<Mission::GeofencePolygon>>(polygons),
+                          callback);
+}
+
+void MissionImpl::upload_geofence_async(Mission::shared_geofence_t polygons,
+                                        const Mission::result_callback_t &callback)
+{
+    if (polygons == nullptr) {
+        report_mission_result(callback, Mission::Result::INVALID_ARGUMENT);
         return;
     }
 
-    // We retry the list request and mission item request, so we use the lower timeout.
-    _parent->register_timeout_handler(std::bind(&MissionImpl::process_timeout, this),
-                                      RETRY_TIMEOUT_S, &_timeout_cookie);
+    // Every vertex is one item. The polygons are kept, not copied, and the
+    // items are packed from them when they are requested.
+    auto fence = std::make_shared<Fence>();
+    fence->polygons = std::move(polygons);
+    fence->first_seq_of_polygons.reserve(fence->polygons->size());
+
+    std::vector<uint64_t> item_hashes;
+    mavlink_mission_item_int_t item;
+    for (const auto &polygon : *fence->polygons) {
+        if (polygon.vertices.size() < 3) {
+            LogErr() << "Geofence polygon needs at least 3 vertices";
+            report_mission_result(callback, Mission::Result::INVALID_ARGUMENT);
+            return;
+        }
+
+        fence->first_seq_of_polygons.push_back(int(item_hashes.size()));
+        for (size_t i = 0; i < polygon.vertices.size(); ++i) {
+            if (!std::isfinite(polygon.vertices[i].latitude_deg) ||
+                !std::isfinite(polygon.vertices[i].longitude_deg)) {
+                LogErr() << "Geofence vertex invalid";
+                report_mission_result(callback, Mission::Result::INVALID_ARGUMENT);
+                return;
+            }
+            pack_geofence_item(polygon, i, int(item_hashes.size()), item);
+            item_hashes.push_back(MissionTransfer::hash_item(item));
+        }
+    }
 
-    // Clear our internal cache and re-populate it.
-    _mavlink_mission_items_downloaded.clear();
-    _activity = Activity::GET_MISSION;
-    _retries = 0;
-    _mission_items_and_result_callback = callback;
+    _fence_transfer.upload_async(
+        std::move(item_hashes),
+    [fence](int seq, mavlink_mission_item_int_t & fence_item) {
+        // The last polygon starting at or before seq.
+        auto it = std::upper_bound(fence->first_seq_of_polygons.begin(),
+                                   fence->first_seq_of_polygons.end(), seq);
+        if (it == fence->first_seq_of_polygons.begin()) {
+            return false;
+        }
+        const size_t index = size_t(it - fence->first_seq_of_polygons.begin()) - 1;
+        const Mission::GeofencePolygon &polygon = (*fence->polygons)[index];
+        const size_t vertex = size_t(seq - fence->first_seq_of_polygons[index]);
+        if (vertex >= polygon.vertices.size()) {
+            return false;
+        }
+        pack_geofence_item(polygon, vertex, seq, fence_item);
+        return true;
+    },
+    callback);
 }
 
-void MissionImpl::assemble_mavlink_messages()
+void MissionImpl::upload_rally_points_async(const std::vector<Mission::RallyPoint> &rally_points,
+                                            const Mission::result_callback_t &callback)
 {
-    _mavlink_mission_item_messages.clear();
-
-    bool last_position_valid = false; // This flag is to protect us from using an invalid x/y.
-    MAV_FRAME last_frame;
-    int32_t last_x;
-    int32_t last_y;
-    float last_z;
-
-    unsigned item_i = 0;
-    for (auto item : _mission_items) {
-
-        MissionItemImpl &mission_item_impl = (*(item)->_impl);
-
-        if (mission_item_impl.is_position_finite()) {
-            // Current is the 0th waypoint
-            uint8_t current = ((_mavlink_mission_item_messages.size() == 0) ? 1 : 0);
-
-            auto message = std::make_shared<mavlink_message_t>();
-            mavlink_msg_mission_item_int_pack(GCSClient::system_id,
-                                              GCSClient::component_id,
-                                              message.get(),
-                                              _parent->get_system_id(),
-                                              _parent->get_autopilot_id(),
-                                              _mavlink_mission_item_messages.size(),
-                                              mission_item_impl.get_mavlink_frame(),
-                                              mission_item_impl.get_mavlink_cmd(),
-                                              current,
-                                              mission_item_impl.get_mavlink_autocontinue(),
-                                              mission_item_impl.get_mavlink_param1(),
-                                              mission_item_impl.get_mavlink_param2(),
-                                              mission_item_impl.get_mavlink_param3(),
-                                              mission_item_impl.get_mavlink_param4(),
-                                              mission_item_impl.get_mavlink_x(),
-                                              mission_item_impl.get_mavlink_y(),
-                                              mission_item_impl.get_mavlink_z(),
-                                              MAV_MISSION_TYPE_MISSION);
-
-            last_position_valid = true; // because we checked is_position_finite
-            last_x = mission_item_impl.get_mavlink_x();
-            last_y = mission_item_impl.get_mavlink_y();
-            last_z = mission_item_impl.get_mavlink_z();
-            last_frame = mission_item_impl.get_mavlink_frame();
-
-            _mavlink_mission_item_to_mission_item_indices.insert(
-                std::pair <int, int>
-            {static_cast<int>(_mavlink_mission_item_messages.size()), item_i});
-            _mavlink_mission_item_messages.push_back(message);
+    auto points = std::make_shared<const std::vector<Mission::RallyPoint>>(rally_points);
+
+    std::vector<uint64_t> item_hashes;
+    item_hashes.reserve(points->size());
+    mavlink_mission_item_int_t item;
+    for (size_t i = 0; i < points->size(); ++i) {
+        const Mission::RallyPoint &point = points->at(i);
+        if (!std::isfinite(point.latitude_deg) || !std::isfinite(point.longitude_deg) ||
+            !std::isfinite(point.relative_altitude_m)) {
+            LogErr() << "Rally point invalid";
+            report_mission_result(callback, Mission::Result::INVALID_ARGUMENT);
+            return;
         }
+        pack_rally_item(point, int(i), item);
+        item_hashes.push_back(MissionTransfer::hash_item(item));
+    }
 
-        if (std::isfinite(mission_item_impl.get_speed_m_s())) {
-
-            // The speed has changed, we need to add a speed command.
-
-            // Current is the 0th waypoint
-            uint8_t current = ((_mavlink_mission_item_messages.size() == 0) ? 1 : 0);
-
-            uint8_t autocontinue = 1;
-
-            auto message_speed = std::make_shared<mavlink_message_t>();
-            mavlink_msg_mission_item_int_pack(GCSClient::system_id,
-                                              GCSClient::component_id,
-                                              message_speed.get(),
-                                              _parent->get_system_id(),
-                                              _parent->get_autopilot_id(),
-                                              _mavlink_mission_item_messages.size(),
-                                              MAV_FRAME_MISSION,
-                                              MAV_CMD_DO_CHANGE_SPEED,
-                                              current,
-                                              autocontinue,
-                                              1.0f, // ground speed
-                                              mission_item_impl.get_speed_m_s(),
-                                              -1.0f, // no throttle change
-                                              0.0f, // absolute
-                                              0,
-                                              0,
-                                              NAN,
-                                              MAV_MISSION_TYPE_MISSION);
-
-            _mavlink_mission_item_to_mission_item_indices.insert(
-                std::pair <int, int>
-            {static_cast<int>(_mavlink_mission_item_messages.size()), item_i});
-            _mavlink_mission_item_messages.push_back(message_speed);
+    _rally_transfer.upload_async(
+        std::move(item_hashes),
+    [points](int seq, mavlink_mission_item_int_t & rally_item) {
+        if (size_t(seq) >= points->size()) {
+            return false;
         }
+        pack_rally_item(points->at(size_t(seq)), seq, rally_item);
+        return true;
+    },
+    callback);
+}
 
-        if (std::isfinite(mission_item_impl.get_gimbal_yaw_deg()) ||
-            std::isfinite(mission_item_impl.get_gimbal_pitch_deg())) {
-            // The gimbal has changed, we need to add a gimbal command.
-
-            // Current is the 0th waypoint
-            uint8_t current = ((_mavlink_mission_item_messages.size() == 0) ? 1 : 0);
-
-            uint8_t autocontinue = 1;
-
-            auto message_gimbal = std::make_shared<mavlink_message_t>();
-            mavlink_msg_mission_item_int_pack(GCSClient::system_id,
-                                              GCSClient::component_id,
-                                              message_gimbal.get(),
-                                              _parent->get_system_id(),
-                                              _parent->get_autopilot_id(),
-                                              _mavlink_mission_item_messages.size(),
-                                              MAV_FRAME_MISSION,
-                                              MAV_CMD_DO_MOUNT_CONTROL,
-                                              current,
-                                              autocontinue,
-                                              mission_item_impl.get_gimbal_pitch_deg(), // pitch
-                                              0.0f, // roll (yes it is a weird order)
-                                              mission_item_impl.get_gimbal_yaw_deg(), // yaw
-                                              NAN,
-                                              0,
-                                              0,
-                                              MAV_MOUNT_MODE_MAVLINK_TARGETING,
-                                              MAV_MISSION_TYPE_MISSION);
-
-            _mavlink_mission_item_to_mission_item_indices.insert(
-                std::pair <int, int>
-            {static_cast<int>(_mavlink_mission_item_messages.size()), item_i});
-            _mavlink_mission_item_messages.push_back(message_gimbal);
-        }
+void MissionImpl::pack_geofence_item(const Mission::GeofencePolygon &polygon,
+                                     size_t vertex, int seq,
+                                     mavlink_mission_item_int_t &item)
+{
+    item = mavlink_mission_item_int_t {};
+    item.seq = uint16_t(seq);
+    item.frame = MAV_FRAME_GLOBAL_INT;
+    item.command = (polygon.type == Mission::GeofencePolygon::Type::INCLUSION) ?
+                   MAV_CMD_NAV_FENCE_POLYGON_VERTEX_INCLUSION :
+                   MAV_CMD_NAV_FENCE_POLYGON_VERTEX_EXCLUSION;
+    // Every vertex carries the number of vertices of its polygon.
+    item.param1 = float(polygon.vertices.size());
+    item.x = int32_t(polygon.vertices[vertex].latitude_deg * 1e7);
+    item.y = int32_t(polygon.vertices[vertex].longitude_deg * 1e7);
+    item.mission_type = MAV_MISSION_TYPE_FENCE;
+}
 
-        // FIXME: It is a bit of a hack to set a LOITER_TIME waypoint to add a delay.
-        //        A better solution would be to properly use NAV_DELAY instead. This
-        //        would not require us to keep the last lat/lon.
-        if (std::isfinite(mission_item_impl.get_loiter_time_s())) {
-            if (!last_position_valid) {
-                // In the case where we get a delay without a previous position, we will have to
-                // ignore it.
-                LogErr() << "Can't set camera action delay without previous position set.";
+void MissionImpl::pack_rally_item(const Mission::RallyPoint &point, int seq,
+                                  mavlink_mission_item_int_t &item)
+{
+    item = mavlink_mission_item_int_t {};
+    item.seq = uint16_t(seq);
+    item.frame = MAV_FRAME_GLOBAL_RELATIVE_ALT_INT;
+    item.command = MAV_CMD_NAV_RALLY_POINT;
+    item.x = int32_t(point.latitude_deg * 1e7);
+    item.y = int32_t(point.longitude_deg * 1e7);
+    item.z = point.relative_altitude_m;
+    item.mission_type = MAV_MISSION_TYPE_RALLY;
+}
 
-            } else {
+void MissionImpl::assemble_mavlink_mission_items(const MissionItemData &data,
+                                                 int first_seq,
+                                                 LastPosition &last_position,
+                                                 std::vector<mavlink_mission_item_int_t> &items)
+{
+    items.clear();
+
+    // The addressing is filled in by the transfer, so that the items can be
+    // packed once for several systems.
+    auto add_item = [&items, first_seq](MAV_FRAME frame, uint16_t command,
+                                        uint8_t autocontinue,
+                                        float param1, float param2,
+                                        float param3, float param4,
+                                        int32_t x, int32_t y, float z) {
+        mavlink_mission_item_int_t item {};
+        item.seq = uint16_t(first_seq + int(items.size()));
+        item.frame = uint8_t(frame);
+        item.command = command;
+        // Current is the 0th waypoint
+        item.current = (item.seq == 0) ? 1 : 0;
+        item.autocontinue = autocontinue;
+        item.param1 = param1;
+        item.param2 = param2;
+        item.param3 = param3;
+        item.param4 = param4;
+        item.x = x;
+        item.y = y;
+        item.z = z;
+        item.mission_type = MAV_MISSION_TYPE_MISSION;
+        items.push_back(item);
+    };
+
+    if (MissionItemImpl::is_position_finite(data)) {
+        add_item(MissionItemImpl::get_mavlink_frame(data),
+                 MissionItemImpl::get_mavlink_cmd(data),
+                 MissionItemImpl::get_mavlink_autocontinue(data),
+                 MissionItemImpl::get_mavlink_param1(data),
+                 MissionItemImpl::get_mavlink_param2(data),
+                 MissionItemImpl::get_mavlink_param3(data),
+                 MissionItemImpl::get_mavlink_param4(data),
+                 MissionItemImpl::get_mavlink_x(data),
+                 MissionItemImpl::get_mavlink_y(data),
+                 MissionItemImpl::get_mavlink_z(data));
+
+        last_position.valid = true; // because we checked is_position_finite
+        last_position.x = MissionItemImpl::get_mavlink_x(data);
+        last_position.y = MissionItemImpl::get_mavlink_y(data);
+        last_position.z = MissionItemImpl::get_mavlink_z(data);
+        last_position.frame = MissionItemImpl::get_mavlink_frame(data);
+    }
 
-                // Current is the 0th waypoint
-                uint8_t current = ((_mavlink_mission_item_messages.size() == 0) ? 1 : 0);
-
-                uint8_t autocontinue = 1;
-
-                std::shared_ptr<mavlink_message_t> message_delay(new mavlink_message_t());
-                mavlink_msg_mission_item_int_pack(GCSClient::system_id,
-                                                  GCSClient::component_id,
-                                                  message_delay.get(),
-                                                  _parent->get_system_id(),
-                                                  _parent->get_autopilot_id(),
-                                                  _mavlink_mission_item_messages.size(),
-                                                  last_frame,
-                                                  MAV_CMD_NAV_LOITER_TIME,
-                                                  current,
-                                                  autocontinue,
-                                                  mission_item_impl.get_loiter_time_s(), // loiter time in seconds
-                                                  NAN, // empty
-                                                  0.0f, // radius around waypoint in meters ?
-                                                  0.0f, // loiter at center of waypoint
-                                                  last_x,
-                                                  last_y,
-                                                  last_z,
-                                                  MAV_MISSION_TYPE_MISSION);
-
-                _mavlink_mission_item_to_mission_item_indices.insert(
-                    std::pair <int, int>
-                {static_cast<int>(_mavlink_mission_item_messages.size()), item_i});
-                _mavlink_mission_item_messages.push_back(message_delay);
-            }
-        }
+    if (std::isfinite(data.speed_m_s)) {
+
+        // The speed has changed, we need to add a speed command.
+        add_item(MAV_FRAME_MISSION,
+                 MAV_CMD_DO_CHANGE_SPEED,
+                 1, // autocontinue
+                 1.0f, // ground speed
+                 data.speed_m_s,
+                 -1.0f, // no throttle change
+                 0.0f, // absolute
+                 0,
+                 0,
+                 NAN);
+    }
 
-        if (mission_item_impl.get_camera_action() != MissionItem::CameraAction::NONE) {
-            // There is a camera action that we need to send.
-
-            // Current is the 0th waypoint
-            uint8_t current = ((_mavlink_mission_item_messages.size() == 0) ? 1 : 0);
-
-            uint8_t autocontinue = 1;
-
-            uint16_t command = 0;
-            float param1 = NAN;
-            float param2 = NAN;
-            float param3 = NAN;
-            switch (mission_item_impl.get_camera_action()) {
-                case MissionItem::CameraAction::TAKE_PHOTO:
-                    command = MAV_CMD_IMAGE_START_CAPTURE;
-                    param1 = 0.0f; // all camera IDs
-                    param2 = 0.0f; // no duration, take only one picture
-                    param3 = 1.0f; // only take one picture
-                    break;
-                case MissionItem::CameraAction::START_PHOTO_INTERVAL:
-                    command = MAV_CMD_IMAGE_START_CAPTURE;
-                    param1 = 0.0f; // all camera IDs
-                    param2 = mission_item_impl.get_camera_photo_interval_s();
-                    param3 = 0.0f; // unlimited photos
-                    break;
-                case MissionItem::CameraAction::STOP_PHOTO_INTERVAL:
-                    command = MAV_CMD_IMAGE_STOP_CAPTURE;
-                    param1 = 0.0f; // all camera IDs
-                    break;
-                case MissionItem::CameraAction::START_VIDEO:
-                    command = MAV_CMD_VIDEO_START_CAPTURE;
-                    param1 = 0.0f; // all camera IDs
-                    break;
-                case MissionItem::CameraAction::STOP_VIDEO:
-                    command = MAV_CMD_VIDEO_STOP_CAPTURE;
-                    param1 = 0.0f; // all camera IDs
-                    break;
-                default:
-                    LogErr() << "Error: camera action not supported";
-                    break;
-            }
+    if (std::isfinite(data.gimbal_yaw_deg) ||
+        std::isfinite(data.gimbal_pitch_deg)) {
+        // The gimbal has changed, we need to add a gimbal command.
+        add_item(MAV_FRAME_MISSION,
+                 MAV_CMD_DO_MOUNT_CONTROL,
+                 1, // autocontinue
+                 data.gimbal_pitch_deg, // pitch
+                 0.0f, // roll (yes it is a weird order)
+                 data.gimbal_yaw_deg, // yaw
+                 NAN,
+                 0,
+                 0,
+                 MAV_MOUNT_MODE_MAVLINK_TARGETING);
+    }
+
+    // FIXME: It is a bit of a hack to set a LOITER_TIME waypoint to add a delay.
+    //        A better solution would be to properly use NAV_DELAY instead. This
+    //        would not require us to keep the last lat/lon.
+    if (std::isfinite(data.loiter_time_s)) {
+        if (!last_position.valid) {
+            // In the case where we get a delay without a previous position, we will have to
+            // ignore it.
+            LogErr() << "Can't set camera action delay without previous position set.";
 
-            auto message_camera = std::make_shared<mavlink_message_t>();
-            mavlink_msg_mission_item_int_pack(GCSClient::system_id,
-                                              GCSClient::component_id,
-                                              message_camera.get(),
-                                              _parent->get_system_id(),
-                                              _parent->get_autopilot_id(),
-                                              _mavlink_mission_item_messages.size(),
-                                              MAV_FRAME_MISSION,
-                                              command,
-                                              current,
-                                              autocontinue,
-                                              param1,
-                                              param2,
-                                              param3,
-                                              NAN,
-                                              0,
-                                              0,
-                                              NAN,
-                                              MAV_MISSION_TYPE_MISSION);
-
-            _mavlink_mission_item_to_mission_item_indices.insert(
-                std::pair <int, int>
-            {static_cast<int>(_mavlink_mission_item_messages.size()), item_i});
-            _mavlink_mission_item_messages.push_back(message_camera);
+        } else {
+            add_item(last_position.frame,
+                     MAV_CMD_NAV_LOITER_TIME,
+                     1, // autocontinue
+                     data.loiter_time_s, // loiter time in seconds
+                     NAN, // empty
+                     0.0f, // radius around waypoint in meters ?
+                     0.0f, // loiter at center of waypoint
+                     last_position.x,
+                     last_position.y,
+                     last_position.z);
         }
+    }
 
-        ++item_i;
+    if (data.camera_action != MissionItem::CameraAction::NONE) {
+        // There is a camera action that we need to send.
+
+        uint16_t command = 0;
+        float param1 = NAN;
+        float param2 = NAN;
+        float param3 = NAN;
+        switch (data.camera_action) {
+            case MissionItem::CameraAction::TAKE_PHOTO:
+                command = MAV_CMD_IMAGE_START_CAPTURE;
+                param1 = 0.0f; // all camera IDs
+                param2 = 0.0f; // no duration, take only one picture
+                param3 = 1.0f; // only take one picture
+                break;
+            case MissionItem::CameraAction::START_PHOTO_INTERVAL:
+                command = MAV_CMD_IMAGE_START_CAPTURE;
+                param1 = 0.0f; // all camera IDs
+                param2 = data.camera_photo_interval_s;
+                param3 = 0.0f; // unlimited photos
+                break;
+            case MissionItem::CameraAction::STOP_PHOTO_INTERVAL:
+                command = MAV_CMD_IMAGE_STOP_CAPTURE;
+                param1 = 0.0f; // all camera IDs
+                break;
+            case MissionItem::CameraAction::START_VIDEO:
+                command = MAV_CMD_VIDEO_START_CAPTURE;
+                param1 = 0.0f; // all camera IDs
+                break;
+            case MissionItem::CameraAction::STOP_VIDEO:
+                command = MAV_CMD_VIDEO_STOP_CAPTURE;
+                param1 = 0.0f; // all camera IDs
+                break;
+            default:
+                LogErr() << "Error: camera action not supported";
+                break;
+        }
+
+        add_item(MAV_FRAME_MISSION,
+                 command,
+                 1, // autocontinue
+                 param1,
+                 param2,
+                 param3,
+                 NAN,
+                 0,
+                 0,
+                 NAN);
     }
 }
 
-void MissionImpl::assemble_mission_items()
+void MissionImpl::assemble_mission_items(const std::vector<mavlink_mission_item_int_t> &items,
+                                         const Mission::mission_items_and_result_callback_t
+                                         &callback)
 {
+    // We assume that we already acquired _mutex in this function.
     _mission_items.clear();
 
     Mission::Result result = Mission::Result::SUCCESS;
@@ -584,27 +673,27 @@ void MissionImpl::assemble_mission_items()
     auto new_mission_item = std::make_shared<MissionItem>();
     bool have_set_position = false;
 
-    if (_mavlink_mission_items_downloaded.size() > 0) {
+    if (items.size() > 0) {
         // The first mission item needs to be a waypoint with position.
-        if (_mavlink_mission_items_downloaded.at(0)->command != MAV_CMD_NAV_WAYPOINT) {
+        if (items.at(0).command != MAV_CMD_NAV_WAYPOINT) {
             LogErr() << "First mission item is not a waypoint";
-            result = Mission::Result::UNSUPPORTED;
+            report_mission_items_and_result(callback, Mission::Result::UNSUPPORTED);
             return;
         }
     }
 
-    if (_mavlink_mission_items_downloaded.size() == 0) {
+    if (items.size() == 0) {
         LogErr() << "No downloaded mission items";
-        result = Mission::Result::NO_MISSION_AVAILABLE;
+        report_mission_items_and_result(callback, Mission::Result::NO_MISSION_AVAILABLE);
         return;
     }
 
-    for (auto &it : _mavlink_mission_items_downloaded) {
-        LogDebug() << "Assembling Message: " << int(it->seq);
+    for (const auto &it : items) {
+        LogDebug() << "Assembling Message: " << int(it.seq);
 
 
-        if (it->command == MAV_CMD_NAV_WAYPOINT) {
-            if (it->frame != MAV_FRAME_GLOBAL_RELATIVE_ALT_INT) {
+        if (it.command == MAV_CMD_NAV_WAYPOINT) {
+            if (it.frame != MAV_FRAME_GLOBAL_RELATIVE_ALT_INT) {
                 LogErr() << "Waypoint frame not supported unsupported";
                 result = Mission::Result::UNSUPPORTED;
                 break;
@@ -617,27 +706,27 @@ void MissionImpl::assemble_mission_items()
                 have_set_position = false;
             }
 
-            new_mission_item->set_position(double(it->x) * 1e-7, double(it->y) * 1e-7);
-            new_mission_item->set_relative_altitude(it->z);
+            new_mission_item->set_position(double(it.x) * 1e-7, double(it.y) * 1e-7);
+            new_mission_item->set_relative_altitude(it.z);
 
-            new_mission_item->set_fly_through(!(it->param1 > 0));
+            new_mission_item->set_fly_through(!(it.param1 > 0));
 
             have_set_position = true;
 
-        } else if (it->command == MAV_CMD_DO_MOUNT_CONTROL) {
-            if (int(it->z) != MAV_MOUNT_MODE_MAVLINK_TARGETING) {
+        } else if (it.command == MAV_CMD_DO_MOUNT_CONTROL) {
+            if (int(it.z) != MAV_MOUNT_MODE_MAVLINK_TARGETING) {
                 LogErr() << "Gimbal mount mode unsupported";
                 result = Mission::Result::UNSUPPORTED;
                 break;
             }
 
-            new_mission_item->set_gimbal_pitch_and_yaw(it->param1, it->param3);
+            new_mission_item->set_gimbal_pitch_and_yaw(it.param1, it.param3);
 
-        } else if (it->command == MAV_CMD_IMAGE_START_CAPTURE) {
-            if (it->param2 > 0 && int(it->param3) == 0) {
+        } else if (it.command == MAV_CMD_IMAGE_START_CAPTURE) {
+            if (it.param2 > 0 && int(it.param3) == 0) {
                 new_mission_item->set_camera_action(MissionItem::CameraAction::START_PHOTO_INTERVAL);
-                new_mission_item->set_camera_photo_interval(double(it->param2));
-            } else if (int(it->param2) == 0 && int(it->param3) == 1) {
+                new_mission_item->set_camera_photo_interval(double(it.param2));
+            } else if (int(it.param2) == 0 && int(it.param3) == 1) {
                 new_mission_item->set_camera_action(MissionItem::CameraAction::TAKE_PHOTO);
             } else {
                 LogErr() << "Mission item START_CAPTURE params unsupported.";
@@ -645,28 +734,28 @@ void MissionImpl::assemble_mission_items()
                 break;
             }
 
-        } else if (it->command == MAV_CMD_IMAGE_STOP_CAPTURE) {
+        } else if (it.command == MAV_CMD_IMAGE_STOP_CAPTURE) {
             new_mission_item->set_camera_action(MissionItem::CameraAction::STOP_PHOTO_INTERVAL);
 
-        } else if (it->command == MAV_CMD_VIDEO_START_CAPTURE) {
+        } else if (it.command == MAV_CMD_VIDEO_START_CAPTURE) {
             new_mission_item->set_camera_action(MissionItem::CameraAction::START_VIDEO);
 
-        } else if (it->command == MAV_CMD_VIDEO_STOP_CAPTURE) {
+        } else if (it.command == MAV_CMD_VIDEO_STOP_CAPTURE) {
             new_mission_item->set_camera_action(MissionItem::CameraAction::STOP_VIDEO);
 
-        } else if (it->command == MAV_CMD_DO_CHANGE_SPEED) {
-            if (int(it->param1) == 1 && it->param3 < 0 && int(it->param4) == 0) {
-                new_mission_item->set_speed(it->param2);
+        } else if (it.command == MAV_CMD_DO_CHANGE_SPEED) {
+            if (int(it.param1) == 1 && it.param3 < 0 && int(it.param4) == 0) {
+                new_mission_item->set_speed(it.param2);
             } else {
                 LogErr() << "Mission item DO_CHANGE_SPEED params unsupported";
                 result = Mission::Result::UNSUPPORTED;
             }
 
-        } else if (it->command == MAV_CMD_NAV_LOITER_TIME) {
-            new_mission_item->set_loiter_time(it->param1);
+        } else if (it.command == MAV_CMD_NAV_LOITER_TIME) {
+            new_mission_item->set_loiter_time(it.param1);
 
         } else {
-            LogErr() << "UNSUPPORTED mission item command (" << it->command << ")";
+            LogErr() << "UNSUPPORTED mission item command (" << it.command << ")";
             result = Mission::Result::UNSUPPORTED;
             break;
         }
@@ -674,25 +763,14 @@ void MissionImpl::assemble_mission_items()
 
     // Don't forget to add last mission item.
     _mission_items.push_back(new_mission_item);
+    _num_mission_items = int(_mission_items.size());
 
-    report_mission_items_and_result(_mission_items_and_result_callback, result);
-    _activity = Activity::NONE;
-}
-
-void MissionImpl::download_next_mission_item()
-{
-    mavlink_message_t message;
-    mavlink_msg_mission_request_int_pack(GCSClient::system_id,
-                                         GCSClient::component_id,
-                                         &message,
-                                         _parent->get_system_id(),
-                                         _parent->get_autopilot_id(),
-                                         _next_mission_item_to_download,
-                                         MAV_MISSION_TYPE_MISSION);
-
-    LogDebug() << "Requested mission item " << _next_mission_item_to_download;
+    _route.clear();
+    for (const auto &mission_item : _mission_items) {
+        _route.append(mission_item->_impl->get_data());
+    }
 
-    _parent->send_message(message);
+    report_mission_items_and_result(callback, result);
 }
 
 void MissionImpl::start_mission_async(const Mission::result_callback_t &callback)
@@ -743,13 +821,15 @@ void MissionImpl::set_current_mission_item_async(int current, Mission::result_ca
     }
 
     int mavlink_index = -1;
-    // We need to find the first mavlink item which maps to the current mission item.
-    for (auto it = _mavlink_mission_item_to_mission_item_indices.begin();
-         it != _mavlink_mission_item_to_mission_item_indices.end();
-         ++it) {
-        if (it->second == current) {
-            mavlink_index = it->first;
-            break;
+    // We need to find the first mavlink item which maps to the current mission item,
+    // unless it did not turn into any.
+    if (current >= 0 && current < int(_first_seq_of_mission_items.size())) {
+        const int first_seq = _first_seq_of_mission_items[size_t(current)];
+        const int next_first_seq = (current + 1 < int(_first_seq_of_mission_items.size())) ?
+                                   _first_seq_of_mission_items[size_t(current + 1)] :
+                                   _num_mavlink_mission_items;
+        if (next_first_seq > first_seq) {
+            mavlink_index = first_seq;
         }
     }
 
@@ -776,26 +856,40 @@ void MissionImpl::set_current_mission_item_async(int current, Mission::result_ca
     _result_callback = callback;
 }
 
-void MissionImpl::upload_mission_item(uint16_t seq)
+bool MissionImpl::pack_mavlink_mission_item(Upload &upload, int seq,
+                                            mavlink_mission_item_int_t &item)
 {
-    LogDebug() << "Send mission item " << int(seq);
-    if (seq >= _mavlink_mission_item_messages.size()) {
-        LogErr() << "Mission item requested out of bounds.";
-        return;
+    // The autopilot asks for one item after the other, so usually the item is
+    // packed already or comes from the next mission item. Only if it goes back,
+    // we need to start over.
+    if (seq < upload.first_seq) {
+        rewind_upload(upload);
+    }
+
+    while (seq >= upload.first_seq + int(upload.items.size())) {
+        upload.first_seq += int(upload.items.size());
+        ++upload.mission_item;
+
+        MissionItemData data;
+        if (upload.mission_item >= upload.num_mission_items ||
+            !upload.source(upload.mission_item, data)) {
+            rewind_upload(upload);
+            return false;
+        }
+        assemble_mavlink_mission_items(data, upload.first_seq,
+                                       upload.last_position, upload.items);
     }
 
-    _parent->send_message(*_mavlink_mission_item_messages.at(seq));
+    item = upload.items[size_t(seq - upload.first_seq)];
+    return true;
 }
 
-void MissionImpl::copy_mission_item_vector(const std::vector<std::shared_ptr<MissionItem>>
-                                           &mission_items)
+void MissionImpl::rewind_upload(Upload &upload)
 {
-    _mission_items.clear();
-
-    // Copy over the shared_ptr into our own vector.
-    for (auto item : mission_items) {
-        _mission_items.push_back(item);
-    }
+    upload.mission_item = -1;
+    upload.first_seq = 0;
+    upload.last_position = LastPosition {};
+    upload.items.clear();
 }
 
 void MissionImpl::report_mission_result(const Mission::result_callback_t &callback,
@@ -806,7 +900,9 @@ void MissionImpl::report_mission_result(const Mission::result_callback_t &callba
         return;
     }
 
-    callback(result);
+    _parent->call_result_callback(this, [callback, result]() {
+        callback(result);
+    });
 }
 
 void MissionImpl::report_mission_items_and_result(const Mission::mission_items_and_result_callback_t
@@ -822,16 +918,48 @@ void MissionImpl::report_mission_items_and_result(const Mission::mission_items_a
         // Don't return garbage, better clear it.
         _mission_items.clear();
     }
-    callback(result, _mission_items);
+    const std::vector<std::shared_ptr<MissionItem>> mission_items = _mission_items;
+    _parent->call_result_callback(this, [callback, result, mission_items]() {
+        callback(result, mission_items);
+    });
 }
 
 void MissionImpl::report_progress()
 {
+    report_progress_details();
+
     if (_progress_callback == nullptr) {
         return;
     }
 
-    _progress_callback(current_mission_item(), total_mission_items());
+    // Only the latest progress matters, so older one is dropped if the callback
+    // can't keep up. This is called with _mutex held, so it must not wait anyway.
+    const Mission::progress_callback_t callback = _progress_callback;
+    const int current = current_mission_item();
+    const int total = total_mission_items();
+    _parent->call_user_callback(this, &_progress_callback, [callback, current, total]() {
+        callback(current, total);
+    });
+}
+
+void MissionImpl::report_progress_details()
+{
+    // We assume that we already acquired _mutex in this function.
+    if (_progress_details_callback == nullptr) {
+        return;
+    }
+
+    const Mission::progress_details_callback_t callback = _progress_details_callback;
+    const int current = current_mission_item();
+    const MissionRoute::Remaining remaining =
+        _route.remaining(current, _cruise_speed_m_s, _position.latitude_deg,
+                         _position.longitude_deg, _position.relative_altitude_m);
+    const Mission::ProgressDetails details {current, total_mission_items(),
+                                            remaining.next_item_distance_m,
+                                            remaining.distance_m, remaining.time_s};
+    _parent->call_user_callback(this, &_progress_details_callback, [callback, details]() {
+        callback(details);
+    });
 }
 
 void MissionImpl::receive_command_result(MAVLinkCommands::Result result,
@@ -843,9 +971,6 @@ void MissionImpl::receive_command_result(MAVLinkCommands::Result result,
         _activity = Activity::NONE;
     }
 
-    // We got a command back, so we can get rid of the timeout handler.
-    _parent->unregister_timeout_handler(_timeout_cookie);
-
     if (result == MAVLinkCommands::Result::SUCCESS) {
         report_mission_result(callback, Mission::Result::SUCCESS);
     } else {
@@ -863,15 +988,14 @@ bool MissionImpl::is_mission_finished() const
         return false;
     }
 
-    if (_mavlink_mission_item_messages.size() == 0) {
+    if (_num_mavlink_mission_items == 0) {
         return false;
     }
 
     // It is not straightforward to look at "current" because it jumps to 0
     // once the last item has been done. Therefore we have to lo decide using
     // "reached" here.
-    return (unsigned(_last_reached_mavlink_mission_item + 1)
-            == _mavlink_mission_item_messages.size());
+    return (_last_reached_mavlink_mission_item + 1 == _num_mavlink_mission_items);
 }
 
 int MissionImpl::current_mission_item() const
@@ -883,22 +1007,23 @@ int MissionImpl::current_mission_item() const
     }
 
     // We want to return the current mission item and not the underlying
-    // mavlink mission item. Therefore we check the index map.
-    auto entry = _mavlink_mission_item_to_mission_item_indices.find(
-                     _last_current_mavlink_mission_item);
-
-    if (entry != _mavlink_mission_item_to_mission_item_indices.end()) {
-        return entry->second;
-
-    } else {
-        // Somehow we couldn't find it in the map
+    // mavlink mission item. It is the last one starting at or before it, the
+    // ones before it with the same first seq did not turn into any.
+    if (_last_current_mavlink_mission_item < 0 ||
+        _last_current_mavlink_mission_item >= _num_mavlink_mission_items) {
+        // Somehow it is not one of ours
         return -1;
     }
+
+    auto it = std::upper_bound(_first_seq_of_mission_items.begin(),
+                               _first_seq_of_mission_items.end(),
+                               _last_current_mavlink_mission_item);
+    return int(it - _first_seq_of_mission_items.begin()) - 1;
 }
 
 int MissionImpl::total_mission_items() const
 {
-    return _mission_items.size();
+    return _num_mission_items;
 }
 
 void MissionImpl::subscribe_progress(Mission::progress_callback_t callback)
@@ -906,36 +1031,35 @@ void MissionImpl::subscribe_progress(Mission::progress_callback_t callback)
     _progress_callback = callback;
 }
 
-void MissionImpl::process_timeout()
+void MissionImpl::subscribe_progress_details(Mission::progress_details_callback_t callback)
 {
-    std::lock_guard<std::mutex> lock(_mutex);
+    _progress_details_callback = callback;
+}
 
-    if (_activity == Activity::SET_MISSION) {
-        // We can't retry this, the autopilot should be requesting the items
-        // again.
-        _activity = Activity::NONE;
-        LogWarn() << "Mission handling timed out while uploading mission.";
-
-    } else if (_activity == Activity::GET_MISSION) {
-        if (_retries++ > MAX_RETRIES) {
-            _activity = Activity::NONE;
-            _retries = 0;
-            LogWarn() << "Mission handling timed out while downloading mission.";
-            report_mission_result(_result_callback, Mission::Result::TIMEOUT);
-        } else {
-            LogWarn() << "Retrying requesting mission item...";
-            // We are retrying, so we use the lower timeout.
-            _parent->register_timeout_handler(std::bind(&MissionImpl::process_timeout, this),
-                                              RETRY_TIMEOUT_S, &_timeout_cookie);
-            download_next_mission_item();
-        }
-    } else {
-        LogWarn() << "unknown mission timeout";
+Mission::Result
+MissionImpl::import_qgroundcontrol_mission(Mission::mission_items_t &mission_items,
+                                           const std::string &qgc_plan_file)
+{
+    Mission::mission_data_t mission_data;
+    Mission::Result result = import_qgroundcontrol_mission(mission_data, qgc_plan_file);
+    if (result == Mission::Result::FAILED_TO_OPEN_QGC_PLAN ||
+        result == Mission::Result::FAILED_TO_PARSE_QGC_PLAN) {
+        return result;
+    }
+
+    // Clear old mission items
+    mission_items.clear();
+    mission_items.reserve(mission_data.size());
+    for (const auto &data : mission_data) {
+        auto mission_item = std::make_shared<MissionItem>();
+        mission_item->set_data(data);
+        mission_items.push_back(mission_item);
     }
+    return result;
 }
 
 Mission::Result
-MissionImpl::import_qgroundcontrol_mission(Mission::mission_items_t &mission_items,
+MissionImpl::import_qgroundcontrol_mission(Mission::mission_data_t &mission_data,
                                            const std::string &qgc_plan_file)
 {
     std::ifstream file(qgc_plan_file);
@@ -943,29 +1067,188 @@ MissionImpl::import_qgroundcontrol_mission(Mission::mission_items_t &mission_ite
         return Mission::Result::FAILED_TO_OPEN_QGC_PLAN;
     }
 
-    // Read QGC plan into a string stream
-    std::stringstream ss;
-    ss << file.rdbuf();
+    // The plan is parsed while it is read, without a document of all of it.
+    // The old mission items are only replaced if it could be parsed.
+    Mission::mission_data_t imported;
+    JsonReader reader(file);
+    const Mission::Result result = import_mission_items(imported, reader);
+    if (result != Mission::Result::FAILED_TO_PARSE_QGC_PLAN) {
+        mission_data.swap(imported);
+    }
+    return result;
+}
+
+Mission::Result
+MissionImpl::export_qgroundcontrol_mission(const Mission::mission_data_t &mission_data,
+                                           const std::string &qgc_plan_file)
+{
+    // The MAVLink items are the ones which would be uploaded, so that the plan
+    // flies the same in QGroundControl.
+    PackedMission packed;
+    if (!pack_mission(mission_data, packed)) {
+        return Mission::Result::TOO_MANY_MISSION_ITEMS;
+    }
+
+    std::ofstream file(qgc_plan_file, std::ios::trunc);
+    if (!file) {
+        return Mission::Result::FAILED_TO_WRITE_FILE;
+    }
+
+    JsonWriter writer(file);
+    writer.begin_object();
+    writer.key("fileType");
+    writer.value("Plan");
+
+    writer.key("geoFence");
+    writer.begin_object();
+    writer.key("circles");
+    writer.begin_array();
+    writer.end_array();
+    writer.key("polygons");
+    writer.begin_array();
+    writer.end_array();
+    writer.key("version");
+    writer.value(2);
+    writer.end_object();
+
+    writer.key("groundStation");
+    writer.value("DroneCore");
+
+    writer.key("mission");
+    writer.begin_object();
+    // The defaults of QGroundControl, it needs them but they are not used by the items.
+    writer.key("cruiseSpeed");
+    writer.value(15);
+    writer.key("firmwareType");
+    writer.value(int(MAV_AUTOPILOT_PX4));
+    writer.key("hoverSpeed");
+    writer.value(5);
+    writer.key("items");
+    writer.begin_array();
+    for (const auto &item : packed.items) {
+        export_mission_item(writer, item);
+    }
+    writer.end_array();
+
+    // There is no home before a vehicle is connected, the first position is closest to it.
+    writer.key("plannedHomePosition");
+    writer.begin_array();
+    auto first_position = std::find_if(mission_data.begin(), mission_data.end(),
+                                       MissionItemImpl::is_position_finite);
+    if (first_position != mission_data.end()) {
+        writer.value(first_position->latitude_deg);
+        writer.value(first_position->longitude_deg);
+    } else {
+        writer.value(0);
+        writer.value(0);
+    }
+    writer.value(0);
+    writer.end_array();
+    writer.key("vehicleType");
+    writer.value(int(MAV_TYPE_QUADROTOR));
+    writer.key("version");
+    writer.value(2);
+    writer.end_object();
+
+    writer.key("rallyPoints");
+    writer.begin_object();
+    writer.key("points");
+    writer.begin_array();
+    writer.end_array();
+    writer.key("version");
+    writer.value(2);
+    writer.end_object();
+
+    writer.key("version");
+    writer.value(1);
+    writer.end_object();
+
     file.close();
+    if (!file) {
+        return Mission::Result::FAILED_TO_WRITE_FILE;
+    }
+    return Mission::Result::SUCCESS;
+}
 
-    std::string err;
-    const auto parsed_plan = Json::parse(ss.str(), err); // parse QGC plan
-    if (!err.empty()) { // Parse error
-        return Mission::Result::FAILED_TO_PARSE_QGC_PLAN;
+void MissionImpl::export_mission_item(JsonWriter &writer, const mavlink_mission_item_int_t &item)
+{
+    // Plans have positions in degrees, with the frames which are not _INT.
+    MAV_FRAME frame = static_cast<MAV_FRAME>(item.frame);
+    bool is_global = true;
+    switch (frame) {
+        case MAV_FRAME_GLOBAL_INT:
+            frame = MAV_FRAME_GLOBAL;
+            break;
+        case MAV_FRAME_GLOBAL_RELATIVE_ALT_INT:
+            frame = MAV_FRAME_GLOBAL_RELATIVE_ALT;
+            break;
+        default:
+            is_global = false;
+            break;
     }
 
-    // Clear old mission items
-    mission_items.clear();
+    writer.begin_object();
+    writer.key("autoContinue");
+    writer.value(item.autocontinue != 0);
+    writer.key("command");
+    writer.value(int(item.command));
+    writer.key("doJumpId");
+    writer.value(int(item.seq) + 1);
+    writer.key("frame");
+    writer.value(int(frame));
+    writer.key("params");
+    writer.begin_array();
+    writer.value(double(item.param1));
+    writer.value(double(item.param2));
+    writer.value(double(item.param3));
+    writer.value(double(item.param4));
+    if (is_global) {
+        writer.value(item.x * 1e-7);
+        writer.value(item.y * 1e-7);
+    } else {
+        writer.value(double(item.x));
+        writer.value(double(item.y));
+    }
+    writer.value(double(item.z));
+    writer.end_array();
+    writer.key("type");
+    writer.value("SimpleItem");
+    writer.end_object();
+}
 
-    // Import mission items
-    return import_mission_items(mission_items, parsed_plan);
+Mission::Result MissionImpl::save_mission(const Mission::mission_data_t &mission_data,
+                                          const std::string &mission_file)
+{
+    if (!MissionFile::write(mission_file, mission_data)) {
+        return Mission::Result::FAILED_TO_WRITE_FILE;
+    }
+    return Mission::Result::SUCCESS;
+}
+
+Mission::Result MissionImpl::load_mission(Mission::mission_data_t &mission_data,
+                                          const std::string &mission_file)
+{
+    MissionFile file;
+    if (!file.open(mission_file)) {
+        return Mission::Result::INVALID_MISSION_FILE;
+    }
+
+    Mission::mission_data_t loaded(file.size());
+    for (size_t i = 0; i < loaded.size(); ++i) {
+        if (!file.item(i, loaded[i])) {
+            LogErr() << "Mission item " << i << " of " << mission_file << " is damaged";
+            return Mission::Result::INVALID_MISSION_FILE;
+        }
+    }
+    mission_data.swap(loaded);
+    return Mission::Result::SUCCESS;
 }
 
 // Build a mission item out of command, params and add them to the mission vector.
 Mission::Result
-MissionImpl::build_mission_items(MAV_CMD command, std::vector<double> params,
-                                 std::shared_ptr<MissionItem> &new_mission_item,
-                                 Mission::mission_items_t &all_mission_items)
+MissionImpl::build_mission_items(MAV_CMD command, const std::vector<double> &params,
+                                 MissionItemData &new_mission_item,
+                                 Mission::mission_data_t &all_mission_items)
 {
     Mission::Result result = Mission::Result::SUCCESS;
 
@@ -974,37 +1257,35 @@ MissionImpl::build_mission_items(MAV_CMD command, std::vector<double> params,
         if (command == MAV_CMD_NAV_WAYPOINT ||
             command == MAV_CMD_NAV_TAKEOFF ||
             command == MAV_CMD_NAV_LAND) {
-            if (new_mission_item->has_position_set()) {
+            if (MissionItemImpl::is_position_finite(new_mission_item)) {
                 all_mission_items.push_back(new_mission_item);
-                new_mission_item = std::make_shared<MissionItem>();
+                new_mission_item = MissionItemData {};
             }
 
             if (command == MAV_CMD_NAV_WAYPOINT) {
                 auto is_fly_thru = !(int(params[0]) > 0);
-                new_mission_item->set_fly_through(is_fly_thru);
+                new_mission_item.fly_through = is_fly_thru;
             }
-            auto lat = params[4], lon = params[5];
-            new_mission_item->set_position(lat, lon);
+            new_mission_item.latitude_deg = params[4];
+            new_mission_item.longitude_deg = params[5];
 
-            auto rel_alt = float(params[6]);
-            new_mission_item->set_relative_altitude(rel_alt);
+            new_mission_item.relative_altitude_m = float(params[6]);
 
         } else if (command == MAV_CMD_DO_MOUNT_CONTROL) {
-            auto pitch = float(params[0]), yaw = float(params[2]);
-            new_mission_item->set_gimbal_pitch_and_yaw(pitch, yaw);
+            new_mission_item.gimbal_pitch_deg = float(params[0]);
+            new_mission_item.gimbal_yaw_deg = float(params[2]);
 
         } else if (command == MAV_CMD_NAV_LOITER_TIME) {
-            auto loiter_time_s = float(params[0]);
-            new_mission_item->set_loiter_time(loiter_time_s);
+            new_mission_item.loiter_time_s = float(params[0]);
 
         } else if (command == MAV_CMD_IMAGE_START_CAPTURE) {
             auto photo_interval = int(params[1]),  photo_count = int(params[2]);
 
             if (photo_interval > 0 && photo_count == 0) {
-                new_mission_item->set_camera_action(MissionItem::CameraAction::START_PHOTO_INTERVAL);
-                new_mission_item->set_camera_photo_interval(photo_interval);
+                new_mission_item.camera_action = MissionItem::CameraAction::START_PHOTO_INTERVAL;
+                new_mission_item.camera_photo_interval_s = double(photo_interval);
             } else if (photo_interval == 0 && photo_count == 1) {
-                new_mission_item->set_camera_action(MissionItem::CameraAction::TAKE_PHOTO);
+                new_mission_item.camera_action = MissionItem::CameraAction::TAKE_PHOTO;
             } else {
                 LogErr() << "Mission item START_CAPTURE params unsupported.";
                 result = Mission::Result::UNSUPPORTED;
@@ -1012,13 +1293,13 @@ MissionImpl::build_mission_items(MAV_CMD command, std::vector<double> params,
             }
 
         } else if (command == MAV_CMD_IMAGE_STOP_CAPTURE) {
-            new_mission_item->set_camera_action(MissionItem::CameraAction::STOP_PHOTO_INTERVAL);
+            new_mission_item.camera_action = MissionItem::CameraAction::STOP_PHOTO_INTERVAL;
 
         } else if (command == MAV_CMD_VIDEO_START_CAPTURE) {
-            new_mission_item->set_camera_action(MissionItem::CameraAction::START_VIDEO);
+            new_mission_item.camera_action = MissionItem::CameraAction::START_VIDEO;
 
         } else if (command == MAV_CMD_VIDEO_STOP_CAPTURE) {
-            new_mission_item->set_camera_action(MissionItem::CameraAction::STOP_VIDEO);
+            new_mission_item.camera_action = MissionItem::CameraAction::STOP_VIDEO;
 
         } else if (command == MAV_CMD_DO_CHANGE_SPEED) {
             enum { AirSpeed = 0, GroundSpeed = 1 };
@@ -1028,7 +1309,7 @@ MissionImpl::build_mission_items(MAV_CMD command, std::vector<double> params,
             auto is_absolute = (params[3] == 0);
 
             if (speed_type == int(GroundSpeed) && throttle < 0 && is_absolute) {
-                new_mission_item->set_speed(speed_m_s);
+                new_mission_item.speed_m_s = speed_m_s;
             } else {
                 LogErr() << command << "Mission item DO_CHANGE_SPEED params unsupported";
                 result = Mission::Result::UNSUPPORTED;
@@ -1042,35 +1323,121 @@ MissionImpl::build_mission_items(MAV_CMD command, std::vector<double> params,
     return result;
 }
 
+// Reads a value which should be a number, anything else counts as 0.
+static bool read_number_or_zero(JsonReader &reader, JsonReader::Token token, double &number)
+{
+    number = (token == JsonReader::Token::NUMBER) ? reader.number() : 0.0;
+    return reader.skip_value(token);
+}
+
 Mission::Result
-MissionImpl::import_mission_items(Mission::mission_items_t &all_mission_items,
-                                  const Json &qgc_plan_json)
+MissionImpl::import_mission_items(Mission::mission_data_t &all_mission_items,
+                                  JsonReader &reader)
 {
-    const auto json_mission_items = qgc_plan_json["mission"];
+    typedef JsonReader::Token Token;
     Mission::Result result = Mission::Result::SUCCESS;
-    auto new_mission_item = std::make_shared<MissionItem>();
+    MissionItemData new_mission_item {};
 
-    // Iterate JSON mission items and build DroneCore mission items
-    for (auto &json_mission_item : json_mission_items["items"].array_items()) {
-        // Parameters of Mission item & MAV command of it.
-        MAV_CMD command = static_cast<MAV_CMD>(json_mission_item["command"].int_value());
+    // Only "items" of "mission" are of interest, everything else is skipped.
+    if (reader.next() != Token::OBJECT_BEGIN) {
+        return Mission::Result::FAILED_TO_PARSE_QGC_PLAN;
+    }
 
-        // Extract parameters of each mission item
-        std::vector<double> params;
-        for (auto &p : json_mission_item["params"].array_items()) {
-            params.push_back(p.number_value());
+    Token token;
+    while ((token = reader.next()) == Token::KEY) {
+        if (reader.string() != "mission") {
+            if (!reader.skip_value()) {
+                return Mission::Result::FAILED_TO_PARSE_QGC_PLAN;
+            }
+            continue;
         }
 
-        result = build_mission_items(command, params,
-                                     new_mission_item,
-                                     all_mission_items);
-        if (result != Mission::Result::SUCCESS) {
-            break;
+        if (reader.next() != Token::OBJECT_BEGIN) {
+            return Mission::Result::FAILED_TO_PARSE_QGC_PLAN;
+        }
+        while ((token = reader.next()) == Token::KEY) {
+            if (reader.string() != "items") {
+                if (!reader.skip_value()) {
+                    return Mission::Result::FAILED_TO_PARSE_QGC_PLAN;
+                }
+                continue;
+            }
+
+            if (reader.next() != Token::ARRAY_BEGIN) {
+                return Mission::Result::FAILED_TO_PARSE_QGC_PLAN;
+            }
+            // Reused for all items, so that it is only allocated once.
+            std::vector<double> params;
+            while ((token = reader.next()) == Token::OBJECT_BEGIN) {
+                // Parameters of Mission item & MAV command of it.
+                MAV_CMD command;
+                if (!import_mission_item(reader, command, params)) {
+                    return Mission::Result::FAILED_TO_PARSE_QGC_PLAN;
+                }
+                result = build_mission_items(command, params,
+                                             new_mission_item,
+                                             all_mission_items);
+                if (result != Mission::Result::SUCCESS) {
+                    // Don't forget to add the last mission which possibly didn't have position set.
+                    all_mission_items.push_back(new_mission_item);
+                    return result;
+                }
+            }
+            if (token != Token::ARRAY_END) {
+                return Mission::Result::FAILED_TO_PARSE_QGC_PLAN;
+            }
+        }
+        if (token != Token::OBJECT_END) {
+            return Mission::Result::FAILED_TO_PARSE_QGC_PLAN;
         }
     }
+    if (token != Token::OBJECT_END || reader.next() != Token::END) {
+        return Mission::Result::FAILED_TO_PARSE_QGC_PLAN;
+    }
+
     // Don't forget to add the last mission which possibly didn't have position set.
     all_mission_items.push_back(new_mission_item);
     return result;
 }
 
+// Reads the command and params of a JSON mission item, its opening bracket is already read.
+bool MissionImpl::import_mission_item(JsonReader &reader, MAV_CMD &command,
+                                      std::vector<double> &params)
+{
+    typedef JsonReader::Token Token;
+    command = static_cast<MAV_CMD>(0);
+    params.clear();
+
+    Token token;
+    while ((token = reader.next()) == Token::KEY) {
+        double number;
+        if (reader.string() == "command") {
+            if (!read_number_or_zero(reader, reader.next(), number)) {
+                return false;
+            }
+            command = static_cast<MAV_CMD>(int(number));
+
+        } else if (reader.string() == "params") {
+            token = reader.next();
+            if (token != Token::ARRAY_BEGIN) {
+                if (!reader.skip_value(token)) {
+                    return false;
+                }
+                continue;
+            }
+            // Extract parameters of each mission item
+            while ((token = reader.next()) != Token::ARRAY_END) {
+                if (!read_number_or_zero(reader, token, number)) {
+                    return false;
+                }
+                params.push_back(number);
+            }
+
+        } else if (!reader.skip_value()) {
+            return false;
+        }
+    }
+    return token == Token::OBJECT_END;
+}
+
 } // namespace dronecore
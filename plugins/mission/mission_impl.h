@@ -1,7 +1,8 @@
 #pragma once
 
+#include <cmath>
 #include <memory>
-#include <map>
+#include <vector>
 #include <mutex>
 
 #include "system.h"
@@ -9,9 +10,10 @@
 #include "mavlink_include.h"
 #include "mission.h"
 #include "plugin_impl_base.h"
-#include <json11.hpp>
-
-using namespace json11;
+#include "json_reader.h"
+#include "json_writer.h"
+#include "mission_route.h"
+#include "mission_transfer.h"
 
 namespace dronecore {
 
@@ -26,12 +28,45 @@ public:
 
     void enable() override;
     void disable() override;
+    void add_resource_usage(DroneCore::ResourceUsage &usage) override;
 
     void upload_mission_async(const std::vector<std::shared_ptr<MissionItem>> &mission_items,
                               const Mission::result_callback_t &callback);
+    void upload_mission_async(const Mission::mission_data_t &mission_data,
+                              const Mission::result_callback_t &callback);
+    void upload_mission_async(Mission::mission_data_t &&mission_data,
+                              const Mission::result_callback_t &callback);
+    void upload_mission_async(int count, const Mission::mission_item_source_t &source,
+                              const Mission::result_callback_t &callback);
+
+    // The MAVLink items of a mission, packed once so that they can be uploaded
+    // to several systems.
+    struct PackedMission {
+        int num_mission_items = 0;
+        std::vector<mavlink_mission_item_int_t> items {};
+        std::vector<uint64_t> item_hashes {};
+        std::vector<int> first_seq_of_mission_items {};
+        MissionRoute route {};
+    };
+    static bool pack_mission(const Mission::mission_data_t &mission_data, PackedMission &packed);
+    void upload_packed_mission_async(const std::shared_ptr<const PackedMission> &packed,
+                                     const Mission::result_callback_t &callback);
+    // Of the upload in progress, from 0 to 1.
+    float upload_progress();
+
+    void set_differential_upload(bool enable);
+    void set_download_window(unsigned window);
+    void set_cached_download(bool enable);
 
     void download_mission_async(const Mission::mission_items_and_result_callback_t &callback);
 
+    void upload_geofence_async(const std::vector<Mission::GeofencePolygon> &polygons,
+                               const Mission::result_callback_t &callback);
+    void upload_geofence_async(Mission::shared_geofence_t polygons,
+                               const Mission::result_callback_t &callback);
+    void upload_rally_points_async(const std::vector<Mission::RallyPoint> &rally_points,
+                                   const Mission::result_callback_t &callback);
+
     void start_mission_async(const Mission::result_callback_t &callback);
     void pause_mission_async(const Mission::result_callback_t &callback);
 
@@ -43,55 +78,107 @@ public:
     int total_mission_items() const;
 
     void subscribe_progress(Mission::progress_callback_t callback);
+    void subscribe_progress_details(Mission::progress_details_callback_t callback);
 
     static Mission::Result import_qgroundcontrol_mission(Mission::mission_items_t &mission_items,
                                                          const std::string &qgc_plan_file);
+    static Mission::Result import_qgroundcontrol_mission(Mission::mission_data_t &mission_data,
+                                                         const std::string &qgc_plan_file);
+    static Mission::Result
+    export_qgroundcontrol_mission(const Mission::mission_data_t &mission_data,
+                                  const std::string &qgc_plan_file);
+    static Mission::Result save_mission(const Mission::mission_data_t &mission_data,
+                                        const std::string &mission_file);
+    static Mission::Result load_mission(Mission::mission_data_t &mission_data,
+                                        const std::string &mission_file);
     // Non-copyable
     MissionImpl(const MissionImpl &) = delete;
     const MissionImpl &operator=(const MissionImpl &) = delete;
 
 private:
-    void process_mission_request(const mavlink_message_t &message);
-    void process_mission_request_int(const mavlink_message_t &message);
-    void process_mission_ack(const mavlink_message_t &message);
     void process_mission_current(const mavlink_message_t &message);
     void process_mission_item_reached(const mavlink_message_t &message);
-    void process_mission_count(const mavlink_message_t &message);
-    void process_mission_item_int(const mavlink_message_t &message);
-
-    void process_timeout();
-
-    void upload_mission_item(uint16_t seq);
-
-    void copy_mission_item_vector(const std::vector<std::shared_ptr<MissionItem>> &mission_items);
-
-    void assemble_mavlink_messages();
-
-    static void report_mission_result(const Mission::result_callback_t &callback,
-                                      Mission::Result result);
+    void process_global_position_int(const mavlink_message_t &message);
+    void receive_cruise_speed(bool success, float speed_m_s);
+
+    // Copies the data of the mission item with index into data, returns false if there is none.
+    // All the ways to upload end up here, so packing only ever deals with plain data.
+    typedef std::function<bool(int index, MissionItemData &data)> data_source_t;
+
+    void upload_mission_data_async(int count, const data_source_t &source,
+                                   const Mission::result_callback_t &callback);
+
+    void receive_upload_result(Mission::Result result, const Mission::result_callback_t &callback);
+
+    // A loiter time item needs the position of the item before.
+    struct LastPosition {
+        bool valid = false;
+        MAV_FRAME frame = MAV_FRAME_GLOBAL_RELATIVE_ALT_INT;
+        int32_t x = 0;
+        int32_t y = 0;
+        float z = 0.0f;
+    };
+
+    // Items are only packed once the autopilot requests them, so only the ones
+    // of the last requested mission item are kept. It belongs to the upload and
+    // is only used by the transfer, so it is not protected by _mutex.
+    struct Upload {
+        data_source_t source {};
+        int num_mission_items = 0;
+        int mission_item = -1;
+        int first_seq = 0;
+        // As it was after mission_item.
+        LastPosition last_position {};
+        std::vector<mavlink_mission_item_int_t> items {};
+    };
+
+    bool pack_mavlink_mission_item(Upload &upload, int seq, mavlink_mission_item_int_t &item);
+    static void rewind_upload(Upload &upload);
+
+    // Packs the MAVLink items which one mission item turns into, numbered from first_seq.
+    static void assemble_mavlink_mission_items(const MissionItemData &data,
+                                               int first_seq,
+                                               LastPosition &last_position,
+                                               std::vector<mavlink_mission_item_int_t> &items);
+
+    struct Fence {
+        Mission::shared_geofence_t polygons {};
+        std::vector<int> first_seq_of_polygons {};
+    };
+
+    static void pack_geofence_item(const Mission::GeofencePolygon &polygon,
+                                   size_t vertex, int seq,
+                                   mavlink_mission_item_int_t &item);
+    static void pack_rally_item(const Mission::RallyPoint &point, int seq,
+                                mavlink_mission_item_int_t &item);
+
+    void report_mission_result(const Mission::result_callback_t &callback,
+                               Mission::Result result);
 
     void report_mission_items_and_result(const Mission::mission_items_and_result_callback_t &callback,
                                          Mission::Result result);
 
     void report_progress();
+    void report_progress_details();
 
     void receive_command_result(MAVLinkCommands::Result result,
                                 const Mission::result_callback_t &callback);
 
-    void download_next_mission_item();
-    void assemble_mission_items();
+    void assemble_mission_items(const std::vector<mavlink_mission_item_int_t> &items,
+                                const Mission::mission_items_and_result_callback_t &callback);
 
     static Mission::Result
-    import_mission_items(Mission::mission_items_t &mission_items,
-                         const Json &mission_json);
+    import_mission_items(Mission::mission_data_t &mission_data, JsonReader &reader);
+    static bool import_mission_item(JsonReader &reader, MAV_CMD &command,
+                                    std::vector<double> &params);
+    static void export_mission_item(JsonWriter &writer, const mavlink_mission_item_int_t &item);
     static Mission::Result
-    build_mission_items(MAV_CMD command, std::vector<double> params,
-                        std::shared_ptr<MissionItem> &new_mission_item,
-                        Mission::mission_items_t &all_mission_items);
+    build_mission_items(MAV_CMD command, const std::vector<double> &params,
+                        MissionItemData &new_mission_item,
+                        Mission::mission_data_t &all_mission_items);
 
     std::mutex _mutex {};
     Mission::result_callback_t _result_callback = nullptr;
-    Mission::mission_items_and_result_callback_t _mission_items_and_result_callback = nullptr;
 
     enum class Activity {
         NONE,
@@ -101,18 +188,33 @@ private:
         SEND_COMMAND
     } _activity = Activity::NONE;
 
-    unsigned _retries = 0;
-    static constexpr unsigned MAX_RETRIES = 3;
-
     int _last_current_mavlink_mission_item = -1;
     int _last_reached_mavlink_mission_item = -1;
 
     std::vector<std::shared_ptr<MissionItem>> _mission_items {};
-    std::vector<std::shared_ptr<mavlink_message_t>> _mavlink_mission_item_messages {};
+    int _num_mission_items = 0;
 
-    std::map<int, int> _mavlink_mission_item_to_mission_item_indices {};
+    int _num_mavlink_mission_items = 0;
+    // Maps the MAVLink items back to the mission items for the progress.
+    std::vector<int> _first_seq_of_mission_items {};
 
     Mission::progress_callback_t _progress_callback = nullptr;
+    Mission::progress_details_callback_t _progress_details_callback = nullptr;
+
+    // Of the mission on the vehicle, as far as we know it.
+    MissionRoute _route {};
+    double _cruise_speed_m_s = NAN;
+
+    struct {
+        double latitude_deg = NAN;
+        double longitude_deg = NAN;
+        float relative_altitude_m = NAN;
+    } _position {};
+
+    // They have their own locks and are never called with _mutex held.
+    MissionTransfer _mission_transfer;
+    MissionTransfer _fence_transfer;
+    MissionTransfer _rally_transfer;
 
     static constexpr uint8_t VEHICLE_MODE_FLAG_CUSTOM_MODE_ENABLED = 1;
 
@@ -122,14 +224,6 @@ private:
     static constexpr uint8_t PX4_CUSTOM_MAIN_MODE_AUTO = 4;
     static constexpr uint8_t PX4_CUSTOM_SUB_MODE_AUTO_LOITER = 3;
     static constexpr uint8_t PX4_CUSTOM_SUB_MODE_AUTO_MISSION = 4;
-
-    int _num_mission_items_to_download = -1;
-    int _next_mission_item_to_download = -1;
-    std::vector<std::shared_ptr<mavlink_mission_item_int_t>> _mavlink_mission_items_downloaded {};
-
-    static constexpr double RETRY_TIMEOUT_S = 0.250;
-    static constexpr double PROCESS_TIMEOUT_S = 1.5;
-    void *_timeout_cookie = nullptr;
 };
 
 } // namespace dronecore
@@ -5,12 +5,19 @@
 
 #include <gtest/gtest.h>
 #include <atomic>
-#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
 #include "mission.h"
 #include "mavlink_include.h"
 #include "global_include.h"
 #include "log.h"
 
+#ifndef WINDOWS
+#include <unistd.h>
+#endif
+
 // To locate QGroundControl plan file during Unit test.
 #ifdef WINDOWS
 const std::string SLASH = "\\";
@@ -87,6 +94,134 @@ TEST(QGCMissionImport, ValidateQGCMissonItems)
     }
 }
 
+TEST(QGCMissionImport, ImportsSameAsMissionData)
+{
+    std::string self_file_path = __FILE__;
+    std::string self_dir_path = self_file_path.substr(0, self_file_path.rfind(SLASH));
+    const std::string QGC_SAMPLE_PLAN = self_dir_path + SLASH + "qgroundcontrol_sample.plan";
+
+    Mission::mission_items_t mission_items;
+    ASSERT_EQ(Mission::import_qgroundcontrol_mission(mission_items, QGC_SAMPLE_PLAN),
+              Mission::Result::SUCCESS);
+
+    Mission::mission_data_t mission_data;
+    ASSERT_EQ(Mission::import_qgroundcontrol_mission(mission_data, QGC_SAMPLE_PLAN),
+              Mission::Result::SUCCESS);
+
+    ASSERT_EQ(mission_items.size(), mission_data.size());
+    for (unsigned i = 0; i < mission_data.size(); ++i) {
+        auto mission_item = std::make_shared<MissionItem>();
+        mission_item->set_data(mission_data.at(i));
+        EXPECT_EQ(*mission_item, *mission_items.at(i));
+    }
+}
+
+#ifndef WINDOWS
+TEST(QGCMissionImport, ImportsScaledUpPlan)
+{
+    // How many times the items of the sample plan are repeated, the import
+    // time of large plans is in benchmarks/mission_import_benchmark.cpp.
+    const unsigned scale = 3;
+
+    std::string self_file_path = __FILE__;
+    std::string self_dir_path = self_file_path.substr(0, self_file_path.rfind(SLASH));
+    const std::string QGC_SAMPLE_PLAN = self_dir_path + SLASH + "qgroundcontrol_sample.plan";
+
+    std::ifstream sample_file(QGC_SAMPLE_PLAN);
+    ASSERT_TRUE(sample_file.good());
+    std::stringstream sample_stream;
+    sample_stream << sample_file.rdbuf();
+    const std::string sample = sample_stream.str();
+
+    // Find the content of the items array by its matching bracket.
+    const size_t items_key = sample.find("\"items\"");
+    ASSERT_NE(items_key, std::string::npos);
+    const size_t items_begin = sample.find('[', items_key) + 1;
+    size_t items_end = items_begin;
+    for (int depth = 1; depth > 0; ++items_end) {
+        ASSERT_LT(items_end, sample.size());
+        if (sample[items_end] == '[') {
+            ++depth;
+        } else if (sample[items_end] == ']') {
+            --depth;
+        }
+    }
+    --items_end;
+    const std::string items = sample.substr(items_begin, items_end - items_begin);
+
+    char dir_template[] = "/tmp/dronecore_mission_XXXXXX";
+    const char *dir = mkdtemp(dir_template);
+    ASSERT_NE(dir, nullptr);
+    const std::string scaled_plan = std::string(dir) + SLASH + "scaled.plan";
+    {
+        std::ofstream scaled_file(scaled_plan);
+        scaled_file << sample.substr(0, items_begin) << items;
+        for (unsigned i = 1; i < scale; ++i) {
+            scaled_file << "," << items;
+        }
+        scaled_file << sample.substr(items_end);
+    }
+
+    Mission::mission_data_t sample_data;
+    ASSERT_EQ(Mission::import_qgroundcontrol_mission(sample_data, QGC_SAMPLE_PLAN),
+              Mission::Result::SUCCESS);
+
+    Mission::mission_data_t mission_data;
+    EXPECT_EQ(Mission::import_qgroundcontrol_mission(mission_data, scaled_plan),
+              Mission::Result::SUCCESS);
+
+    Mission::mission_items_t mission_items;
+    EXPECT_EQ(Mission::import_qgroundcontrol_mission(mission_items, scaled_plan),
+              Mission::Result::SUCCESS);
+
+    std::remove(scaled_plan.c_str());
+    rmdir(dir);
+
+    ASSERT_EQ(mission_data.size(), scale * sample_data.size());
+    ASSERT_EQ(mission_items.size(), mission_data.size());
+    for (unsigned i = 0; i < mission_data.size(); ++i) {
+        auto expected = std::make_shared<MissionItem>();
+        expected->set_data(sample_data.at(i % sample_data.size()));
+        EXPECT_EQ(*expected, *mission_items.at(i));
+    }
+}
+#endif
+
+TEST(QGCMissionImport, ImportsExportedPlan)
+{
+    std::string self_file_path = __FILE__;
+    std::string self_dir_path = self_file_path.substr(0, self_file_path.rfind(SLASH));
+    const std::string QGC_SAMPLE_PLAN = self_dir_path + SLASH + "qgroundcontrol_sample.plan";
+
+    Mission::mission_data_t sample_data;
+    ASSERT_EQ(Mission::import_qgroundcontrol_mission(sample_data, QGC_SAMPLE_PLAN),
+              Mission::Result::SUCCESS);
+
+    const std::string exported_plan = "mission_import_qgc_test_exported.plan";
+    ASSERT_EQ(Mission::export_qgroundcontrol_mission(sample_data, exported_plan),
+              Mission::Result::SUCCESS);
+
+    Mission::mission_data_t mission_data;
+    EXPECT_EQ(Mission::import_qgroundcontrol_mission(mission_data, exported_plan),
+              Mission::Result::SUCCESS);
+    std::remove(exported_plan.c_str());
+
+    // Positions go through the 1e-7 degrees of MAVLink, the rest stays the same.
+    ASSERT_EQ(mission_data.size(), sample_data.size());
+    for (unsigned i = 0; i < mission_data.size(); ++i) {
+        EXPECT_NEAR(mission_data[i].latitude_deg, sample_data[i].latitude_deg, 1e-7);
+        EXPECT_NEAR(mission_data[i].longitude_deg, sample_data[i].longitude_deg, 1e-7);
+        mission_data[i].latitude_deg = sample_data[i].latitude_deg;
+        mission_data[i].longitude_deg = sample_data[i].longitude_deg;
+
+        auto mission_item = std::make_shared<MissionItem>();
+        mission_item->set_data(mission_data[i]);
+        auto sample_item = std::make_shared<MissionItem>();
+        sample_item->set_data(sample_data[i]);
+        EXPECT_EQ(*mission_item, *sample_item);
+    }
+}
+
 Mission::Result compose_mission_items(MAV_CMD command, std::vector<double> params,
                                       std::shared_ptr<MissionItem> &new_mission_item,
                                       Mission::mission_items_t &mission_items)
@@ -70,7 +70,7 @@ double MissionItem::get_longitude_deg() const
 
 bool MissionItem::has_position_set() const
 {
-    return _impl->is_position_finite();
+    return MissionItemImpl::is_position_finite(_impl->get_data());
 }
 
 float MissionItem::get_relative_altitude_m() const
@@ -113,6 +113,16 @@ double MissionItem::get_camera_photo_interval_s() const
     return _impl->get_camera_photo_interval_s();
 }
 
+MissionItemData MissionItem::get_data() const
+{
+    return _impl->get_data();
+}
+
+void MissionItem::set_data(const MissionItemData &data)
+{
+    _impl->set_data(data);
+}
+
 std::string MissionItem::to_str(MissionItem::CameraAction camera_action)
 {
     switch (camera_action) {
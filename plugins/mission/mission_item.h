@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cmath>
 #include <memory>
 #include <ostream>
 #include <string>
@@ -8,6 +9,7 @@ namespace dronecore {
 
 class MissionItemImpl;
 class MissionImpl;
+struct MissionItemData;
 
 /**
  * @brief A mission is a vector of `MissionItem`s.
@@ -196,6 +198,20 @@ public:
      */
     double get_camera_photo_interval_s() const;
 
+    /**
+     * @brief Get all properties of this mission item as plain data.
+     *
+     * @return Copy of the properties.
+     */
+    MissionItemData get_data() const;
+
+    /**
+     * @brief Set all properties of this mission item from plain data.
+     *
+     * @param data The new properties.
+     */
+    void set_data(const MissionItemData &data);
+
     /**
      * @private
      * We need to make MissionImpl a friend so it can access _impl.
@@ -217,6 +233,27 @@ private:
     std::unique_ptr<MissionItemImpl> _impl;
 };
 
+/**
+ * @brief Properties of a mission item as plain data.
+ *
+ * Unlike MissionItem, this can be stored by value, so a large mission fits in one contiguous
+ * vector (see Mission::mission_data_t) instead of needing an allocation per item.
+ * The fields mean the same as for MissionItem, NAN stands for not set.
+ */
+struct MissionItemData {
+    double latitude_deg = double(NAN); /**< @brief Latitude in degrees. */
+    double longitude_deg = double(NAN); /**< @brief Longitude in degrees. */
+    float relative_altitude_m = NAN; /**< @brief Altitude relative to takeoff in metres. */
+    float speed_m_s = NAN; /**< @brief Speed to use after this item in metres/second. */
+    bool fly_through = false; /**< @brief Whether to fly through without stopping. */
+    float gimbal_pitch_deg = NAN; /**< @brief Gimbal pitch in degrees. */
+    float gimbal_yaw_deg = NAN; /**< @brief Gimbal yaw in degrees. */
+    float loiter_time_s = NAN; /**< @brief Loiter time in seconds. */
+    /** @brief Camera action at this item. */
+    MissionItem::CameraAction camera_action = MissionItem::CameraAction::NONE;
+    double camera_photo_interval_s = 1.0; /**< @brief Photo interval in seconds, must be > 0. */
+};
+
 bool operator==(const MissionItem &lhs, const MissionItem &rhs);
 std::ostream &operator<<(std::ostream &str, MissionItem const &mission_item);
 std::ostream &operator<<(std::ostream &str, MissionItem::CameraAction const &camera_action);
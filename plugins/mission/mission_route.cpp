@@ -0,0 +1,117 @@
+#include "mission_route.h"
+#include <cmath>
+
+namespace dronecore {
+
+void MissionRoute::clear()
+{
+    _legs.clear();
+    _last_with_position = -1;
+    _speed_m_s = NAN;
+}
+
+void MissionRoute::append(const MissionItemData &data)
+{
+    const bool has_position = std::isfinite(data.latitude_deg) &&
+                              std::isfinite(data.longitude_deg);
+    if (has_position && _last_with_position < 0) {
+        // Missions are small enough for the plane at their first position.
+        _projection = LocalProjection(data.latitude_deg, data.longitude_deg);
+    }
+
+    Leg leg {};
+    leg.has_position = has_position;
+    leg.speed_m_s = _speed_m_s;
+    if (has_position) {
+        leg.north_m = _projection.north_m(data.latitude_deg);
+        leg.east_m = _projection.east_m(data.longitude_deg);
+        leg.up_m = std::isfinite(data.relative_altitude_m) ? double(data.relative_altitude_m) : 0.0;
+    }
+
+    double distance_m = 0.0;
+    if (has_position && _last_with_position >= 0) {
+        const Leg &from = _legs[size_t(_last_with_position)];
+        distance_m = std::sqrt((leg.north_m - from.north_m) * (leg.north_m - from.north_m) +
+                               (leg.east_m - from.east_m) * (leg.east_m - from.east_m) +
+                               (leg.up_m - from.up_m) * (leg.up_m - from.up_m));
+    }
+
+    const Leg *before = _legs.empty() ? nullptr : &_legs.back();
+    leg.sum_distance_m = (before ? before->sum_distance_m : 0.0) + distance_m;
+    leg.sum_cruise_distance_m = (before ? before->sum_cruise_distance_m : 0.0) +
+                                (std::isfinite(leg.speed_m_s) ? 0.0 : distance_m);
+    leg.sum_time_s = (before ? before->sum_time_s : 0.0) +
+                     (std::isfinite(leg.speed_m_s) ? distance_m / double(leg.speed_m_s) : 0.0);
+    if (std::isfinite(data.loiter_time_s) && data.loiter_time_s > 0.0f) {
+        leg.loiter_time_s = double(data.loiter_time_s);
+        leg.sum_time_s += leg.loiter_time_s;
+    }
+
+    if (has_position) {
+        _last_with_position = int(_legs.size());
+    }
+    // The speed is for what comes after the item.
+    if (std::isfinite(data.speed_m_s) && data.speed_m_s > 0.0f) {
+        _speed_m_s = data.speed_m_s;
+    }
+    _legs.push_back(leg);
+}
+
+MissionRoute::Remaining MissionRoute::remaining(int current, double cruise_speed_m_s) const
+{
+    if (current < 0 || current >= size()) {
+        return Remaining {0.0, 0.0, 0.0};
+    }
+    const double before_m = (current > 0) ? _legs[size_t(current - 1)].sum_distance_m : 0.0;
+    return remaining_after(current, _legs[size_t(current)].sum_distance_m - before_m,
+                           cruise_speed_m_s);
+}
+
+MissionRoute::Remaining MissionRoute::remaining(int current, double cruise_speed_m_s,
+                                                double latitude_deg, double longitude_deg,
+                                                float relative_altitude_m) const
+{
+    if (current < 0 || current >= size() || !_legs[size_t(current)].has_position ||
+        !std::isfinite(latitude_deg) || !std::isfinite(longitude_deg)) {
+        return remaining(current, cruise_speed_m_s);
+    }
+
+    const Leg &to = _legs[size_t(current)];
+    const double north_m = _projection.north_m(latitude_deg) - to.north_m;
+    const double east_m = _projection.east_m(longitude_deg) - to.east_m;
+    const double up_m = (std::isfinite(relative_altitude_m) ?
+                         double(relative_altitude_m) : to.up_m) - to.up_m;
+    return remaining_after(current, std::sqrt(north_m * north_m + east_m * east_m + up_m * up_m),
+                           cruise_speed_m_s);
+}
+
+MissionRoute::Remaining MissionRoute::remaining_after(int current, double next_item_distance_m,
+                                                      double cruise_speed_m_s) const
+{
+    const Leg &at = _legs[size_t(current)];
+    const Leg &last = _legs.back();
+
+    const double cruise_distance_m = last.sum_cruise_distance_m - at.sum_cruise_distance_m;
+    double time_s = last.sum_time_s - at.sum_time_s + at.loiter_time_s +
+                    time_of(next_item_distance_m, at.speed_m_s, cruise_speed_m_s);
+    if (cruise_distance_m > 0.0) {
+        time_s += time_of(cruise_distance_m, NAN, cruise_speed_m_s);
+    }
+
+    return Remaining {next_item_distance_m,
+                      next_item_distance_m + last.sum_distance_m - at.sum_distance_m,
+                      time_s};
+}
+
+double MissionRoute::time_of(double distance_m, float speed_m_s, double cruise_speed_m_s)
+{
+    if (distance_m <= 0.0) {
+        return 0.0;
+    }
+    if (std::isfinite(speed_m_s)) {
+        return distance_m / double(speed_m_s);
+    }
+    return (cruise_speed_m_s > 0.0) ? distance_m / cruise_speed_m_s : double(NAN);
+}
+
+} // namespace dronecore
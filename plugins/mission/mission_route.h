@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+#include "local_projection.h"
+#include "mission.h"
+
+namespace dronecore {
+
+// Distances and times along a mission, summed up once as the mission items
+// are added, so that what is left of the mission is known in constant time at
+// every progress update.
+//
+// The leg of an item is the way to it from the item before with a position,
+// flown at the speed set by an item before, or the cruise speed if none was.
+// Legs at the cruise speed are summed up by distance, so that the cruise speed
+// can still change afterwards.
+class MissionRoute
+{
+public:
+    void clear();
+    void append(const MissionItemData &data);
+
+    int size() const { return int(_legs.size()); }
+    size_t bytes() const { return _legs.capacity() * sizeof(Leg); }
+
+    struct Remaining {
+        double next_item_distance_m;
+        double distance_m;
+        // NAN if the cruise speed is needed but not known.
+        double time_s;
+    };
+
+    // From the vehicle position to the current item and on to the end. Without
+    // a position, the whole leg to the current item is left.
+    Remaining remaining(int current, double cruise_speed_m_s) const;
+    Remaining remaining(int current, double cruise_speed_m_s, double latitude_deg,
+                        double longitude_deg, float relative_altitude_m) const;
+
+private:
+    struct Leg {
+        double north_m;
+        double east_m;
+        double up_m;
+        bool has_position;
+        // Of this leg, set or NAN for the cruise speed.
+        float speed_m_s;
+        // At the item, once the leg is flown.
+        double loiter_time_s;
+        // Sums up to and including this leg.
+        double sum_distance_m;
+        double sum_cruise_distance_m;
+        double sum_time_s;
+    };
+
+    Remaining remaining_after(int current, double next_item_distance_m,
+                              double cruise_speed_m_s) const;
+    static double time_of(double distance_m, float speed_m_s, double cruise_speed_m_s);
+
+    LocalProjection _projection {};
+    std::vector<Leg> _legs {};
+    // Of the last item with a position, and set for the next legs.
+    int _last_with_position = -1;
+    float _speed_m_s = NAN;
+};
+
+} // namespace dronecore
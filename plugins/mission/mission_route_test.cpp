@@ -0,0 +1,105 @@
+#include "mission_route.h"
+#include <gtest/gtest.h>
+#include <cmath>
+
+using namespace dronecore;
+
+namespace {
+
+const double REF_LATITUDE_DEG = 47.40;
+const double REF_LONGITUDE_DEG = 8.45;
+const double M_PER_DEG = 6371000.0 * M_PI / 180.0;
+const double M_PER_DEG_LONGITUDE = M_PER_DEG * std::cos(REF_LATITUDE_DEG * M_PI / 180.0);
+
+MissionItemData waypoint(double north_m, double east_m, float altitude_m = 10.0f)
+{
+    MissionItemData data;
+    data.latitude_deg = REF_LATITUDE_DEG + north_m / M_PER_DEG;
+    data.longitude_deg = REF_LONGITUDE_DEG + east_m / M_PER_DEG_LONGITUDE;
+    data.relative_altitude_m = altitude_m;
+    return data;
+}
+
+} // namespace
+
+TEST(MissionRoute, SumsUpLegs)
+{
+    MissionRoute route;
+    route.append(waypoint(0.0, 0.0));
+    route.append(waypoint(100.0, 0.0));
+    route.append(waypoint(100.0, 50.0));
+    ASSERT_EQ(route.size(), 3);
+
+    // At the first item, nothing is flown yet to get there.
+    MissionRoute::Remaining remaining = route.remaining(0, 5.0);
+    EXPECT_NEAR(remaining.next_item_distance_m, 0.0, 1e-6);
+    EXPECT_NEAR(remaining.distance_m, 150.0, 1e-6);
+    EXPECT_NEAR(remaining.time_s, 30.0, 1e-6);
+
+    remaining = route.remaining(1, 5.0);
+    EXPECT_NEAR(remaining.next_item_distance_m, 100.0, 1e-6);
+    EXPECT_NEAR(remaining.distance_m, 150.0, 1e-6);
+
+    remaining = route.remaining(2, 5.0);
+    EXPECT_NEAR(remaining.next_item_distance_m, 50.0, 1e-6);
+    EXPECT_NEAR(remaining.distance_m, 50.0, 1e-6);
+    EXPECT_NEAR(remaining.time_s, 10.0, 1e-6);
+
+    // Finished.
+    remaining = route.remaining(3, 5.0);
+    EXPECT_DOUBLE_EQ(remaining.distance_m, 0.0);
+    EXPECT_DOUBLE_EQ(remaining.time_s, 0.0);
+}
+
+TEST(MissionRoute, TakesPositionOfVehicle)
+{
+    MissionRoute route;
+    route.append(waypoint(0.0, 0.0));
+    route.append(waypoint(100.0, 0.0));
+    route.append(waypoint(100.0, 50.0));
+
+    // Halfway along the first leg.
+    const MissionItemData position = waypoint(50.0, 0.0);
+    const MissionRoute::Remaining remaining =
+        route.remaining(1, 5.0, position.latitude_deg, position.longitude_deg,
+                        position.relative_altitude_m);
+    EXPECT_NEAR(remaining.next_item_distance_m, 50.0, 1e-3);
+    EXPECT_NEAR(remaining.distance_m, 100.0, 1e-3);
+    EXPECT_NEAR(remaining.time_s, 20.0, 1e-3);
+}
+
+TEST(MissionRoute, UsesSpeedsAndLoiterTimes)
+{
+    MissionRoute route;
+    MissionItemData first = waypoint(0.0, 0.0);
+    // For the legs after it.
+    first.speed_m_s = 10.0f;
+    route.append(first);
+    MissionItemData second = waypoint(100.0, 0.0);
+    second.loiter_time_s = 30.0f;
+    route.append(second);
+    // Without a position, it is where the one before is.
+    MissionItemData action;
+    route.append(action);
+    route.append(waypoint(200.0, 0.0));
+
+    MissionRoute::Remaining remaining = route.remaining(1, 5.0);
+    EXPECT_NEAR(remaining.distance_m, 200.0, 1e-6);
+    EXPECT_NEAR(remaining.time_s, 10.0 + 30.0 + 10.0, 1e-6);
+
+    remaining = route.remaining(2, 5.0);
+    EXPECT_NEAR(remaining.next_item_distance_m, 0.0, 1e-6);
+    EXPECT_NEAR(remaining.distance_m, 100.0, 1e-6);
+    EXPECT_NEAR(remaining.time_s, 10.0, 1e-6);
+}
+
+TEST(MissionRoute, TimeUnknownWithoutCruiseSpeed)
+{
+    MissionRoute route;
+    route.append(waypoint(0.0, 0.0));
+    route.append(waypoint(100.0, 0.0));
+
+    const MissionRoute::Remaining remaining = route.remaining(1, NAN);
+    EXPECT_NEAR(remaining.distance_m, 100.0, 1e-6);
+    EXPECT_TRUE(std::isnan(remaining.time_s));
+}
@@ -0,0 +1,746 @@
+#include "mission_transfer.h"
+#include "global_include.h"
+#include "log.h"
+#include <algorithm>
+
+namespace dronecore {
+
+std::mutex MissionTransfer::_vehicle_items_mutex {};
+std::map<std::pair<uint64_t, int>, MissionTransfer::VehicleItems>
+MissionTransfer::_vehicle_items {};
+
+MissionTransfer::MissionTransfer(MAVLinkSystem &parent, MAV_MISSION_TYPE type) :
+    _parent(parent),
+    _type(type)
+{
+}
+
+MissionTransfer::~MissionTransfer()
+{
+}
+
+void MissionTransfer::init()
+{
+    using namespace std::placeholders; // for `_1`
+
+    _parent.register_mavlink_message_handler(
+        MAVLINK_MSG_ID_MISSION_REQUEST,
+        std::bind(&MissionTransfer::process_mission_request, this, _1), this);
+
+    _parent.register_mavlink_message_handler(
+        MAVLINK_MSG_ID_MISSION_REQUEST_INT,
+        std::bind(&MissionTransfer::process_mission_request_int, this, _1), this);
+
+    _parent.register_mavlink_message_handler(
+        MAVLINK_MSG_ID_MISSION_ACK,
+        std::bind(&MissionTransfer::process_mission_ack, this, _1), this);
+
+    _parent.register_mavlink_message_handler(
+        MAVLINK_MSG_ID_MISSION_COUNT,
+        std::bind(&MissionTransfer::process_mission_count, this, _1), this);
+
+    _parent.register_mavlink_message_handler(
+        MAVLINK_MSG_ID_MISSION_ITEM_INT,
+        std::bind(&MissionTransfer::process_mission_item_int, this, _1), this);
+}
+
+void MissionTransfer::deinit()
+{
+    _parent.unregister_all_mavlink_message_handlers(this);
+}
+
+void MissionTransfer::disable()
+{
+    _parent.unregister_timeout_handler(_timeout_cookie);
+}
+
+void MissionTransfer::upload_async(std::vector<uint64_t> item_hashes,
+                                   const item_source_t &source,
+                                   const result_callback_t &callback)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (_activity != Activity::NONE) {
+        lock.unlock();
+        if (callback) {
+            callback(Mission::Result::BUSY);
+        }
+        return;
+    }
+
+    _activity = Activity::UPLOAD;
+    _upload.source = source;
+    _upload.callback = callback;
+    _upload.item_hashes = std::move(item_hashes);
+    _upload.hash = hash_items(_upload.item_hashes);
+    _upload.partial = false;
+    _upload.end_sent = 0;
+    _upload.num_items = int(_upload.item_hashes.size());
+
+    if (!_parent.does_support_mission_int()) {
+        LogWarn() << "Mission int messages not supported";
+        finish_upload(lock, Mission::Result::ERROR);
+        return;
+    }
+
+    if (!source) {
+        finish_upload(lock, Mission::Result::INVALID_ARGUMENT);
+        return;
+    }
+
+    if (_upload.item_hashes.size() > UINT16_MAX) {
+        LogErr() << "Too many MAVLink mission items: " << _upload.item_hashes.size();
+        finish_upload(lock, Mission::Result::TOO_MANY_MISSION_ITEMS);
+        return;
+    }
+
+    // A partial write can't change the number of items, so then it all has to go.
+    bool unchanged = false;
+    int first_changed = -1;
+    int last_changed = -1;
+    with_vehicle_items([&, this](VehicleItems & vehicle_items) {
+        if (_differential_upload && vehicle_items.known &&
+            vehicle_items.item_hashes.size() == _upload.item_hashes.size()) {
+
+            if (vehicle_items.hash == _upload.hash) {
+                unchanged = true;
+                return;
+            }
+
+            if (!vehicle_items.partial_write_unsupported) {
+                for (size_t i = 0; i < _upload.item_hashes.size(); ++i) {
+                    if (_upload.item_hashes[i] != vehicle_items.item_hashes[i]) {
+                        if (first_changed < 0) {
+                            first_changed = int(i);
+                        }
+                        last_changed = int(i);
+                    }
+                }
+            }
+        }
+
+        // The items which are not sent again stay as the vehicle holds them.
+        if (vehicle_items.items.size() == _upload.item_hashes.size()) {
+            _upload.items = std::move(vehicle_items.items);
+            _upload.known.assign(_upload.items.size(), true);
+        } else {
+            _upload.items.assign(_upload.item_hashes.size(), mavlink_mission_item_int_t {});
+            _upload.known.assign(_upload.item_hashes.size(), false);
+        }
+
+        // Until it is accepted we can't be sure what the vehicle holds.
+        vehicle_items.known = false;
+        vehicle_items.hash = 0;
+        vehicle_items.item_hashes.clear();
+        vehicle_items.items.clear();
+    });
+
+    if (unchanged) {
+        LogDebug() << "Vehicle already has these items, nothing to upload";
+        // Nothing was sent, so the vehicle still holds them.
+        with_vehicle_items([this](VehicleItems & vehicle_items) {
+            vehicle_items.known = true;
+            vehicle_items.hash = _upload.hash;
+            vehicle_items.item_hashes = _upload.item_hashes;
+            vehicle_items.items = std::move(_upload.items);
+        });
+        finish_upload(lock, Mission::Result::SUCCESS);
+        return;
+    }
+
+    _upload.partial = (first_changed >= 0);
+    const bool sent = _upload.partial ?
+                      send_mission_write_partial_list(first_changed, last_changed) :
+                      send_mission_count();
+    if (!sent) {
+        finish_upload(lock, Mission::Result::ERROR);
+    }
+}
+
+void MissionTransfer::download_async(const items_and_result_callback_t &callback)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (_activity != Activity::NONE) {
+        lock.unlock();
+        if (callback) {
+            callback(Mission::Result::BUSY, {});
+        }
+        return;
+    }
+
+    _activity = Activity::DOWNLOAD;
+    _download = Download {};
+    _download.callback = callback;
+    _retries = 0;
+
+    if (_cached_download) {
+        with_vehicle_items([this](VehicleItems & vehicle_items) {
+            if (are_items_valid(vehicle_items)) {
+                _download.cached_items = vehicle_items.items;
+            }
+        });
+    }
+
+    if (!send_mission_request_list()) {
+        finish_download(lock, Mission::Result::ERROR);
+        return;
+    }
+
+    // We retry the list request and item request, so we use the lower timeout.
+    _parent.register_timeout_handler(std::bind(&MissionTransfer::process_timeout, this),
+                                     RETRY_TIMEOUT_S, &_timeout_cookie);
+}
+
+float MissionTransfer::upload_progress()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_upload.num_items == 0) {
+        return (_upload.end_sent > 0) ? 1.0f : 0.0f;
+    }
+    return float(_upload.end_sent) / float(_upload.num_items);
+}
+
+void MissionTransfer::set_differential_upload(bool enable)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _differential_upload = enable;
+}
+
+void MissionTransfer::set_download_window(unsigned window)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _download_window = (window > 0) ? window : 1;
+}
+
+void MissionTransfer::set_cached_download(bool enable)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _cached_download = enable;
+}
+
+void MissionTransfer::process_mission_request(const mavlink_message_t &message)
+{
+    mavlink_mission_request_t mission_request;
+    mavlink_msg_mission_request_decode(&message, &mission_request);
+
+    if (mission_request.mission_type != _type) {
+        return;
+    }
+
+    // We only support int, so we nack this and thus tell the autopilot to use int.
+    send_mission_ack(MAV_MISSION_UNSUPPORTED);
+
+    // Reset the timeout because we're still communicating.
+    _parent.refresh_timeout_handler(_timeout_cookie);
+}
+
+void MissionTransfer::process_mission_request_int(const mavlink_message_t &message)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    mavlink_mission_request_int_t mission_request_int;
+    mavlink_msg_mission_request_int_decode(&message, &mission_request_int);
+
+    if (mission_request_int.mission_type != _type) {
+        return;
+    }
+
+    if (mission_request_int.target_system != GCSClient::system_id &&
+        mission_request_int.target_component != GCSClient::component_id) {
+
+        LogWarn() << "Ignore mission request int that is not for us";
+        return;
+    }
+
+    if (_activity != Activity::UPLOAD) {
+        LogWarn() << "Ignoring mission request int, not active";
+        return;
+    }
+
+    _retries = 0;
+    upload_item(mission_request_int.seq);
+
+    // Reset the timeout because we're still communicating.
+    _parent.refresh_timeout_handler(_timeout_cookie);
+}
+
+void MissionTransfer::process_mission_ack(const mavlink_message_t &message)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    mavlink_mission_ack_t mission_ack;
+    mavlink_msg_mission_ack_decode(&message, &mission_ack);
+
+    if (mission_ack.mission_type != _type) {
+        return;
+    }
+
+    if (_activity != Activity::UPLOAD) {
+        LogWarn() << "Error: not sure how to process Mission ack.";
+        return;
+    }
+
+    if (mission_ack.target_system != GCSClient::system_id &&
+        mission_ack.target_component != GCSClient::component_id) {
+
+        LogWarn() << "Ignore mission ack that is not for us";
+        return;
+    }
+
+    // We got some response, so it wasn't a timeout and we can remove it.
+    _parent.unregister_timeout_handler(_timeout_cookie);
+
+    if (mission_ack.type == MAV_MISSION_ACCEPTED) {
+        with_vehicle_items([this](VehicleItems & vehicle_items) {
+            vehicle_items.known = true;
+            vehicle_items.hash = _upload.hash;
+            vehicle_items.item_hashes = std::move(_upload.item_hashes);
+            const bool all_known =
+                std::find(_upload.known.begin(), _upload.known.end(), false) == _upload.known.end();
+            if (all_known) {
+                vehicle_items.items = std::move(_upload.items);
+            }
+        });
+
+        LogInfo() << "Mission accepted";
+        finish_upload(lock, Mission::Result::SUCCESS);
+    } else if (_upload.partial) {
+        fall_back_to_full_upload(lock);
+    } else if (mission_ack.type == MAV_MISSION_NO_SPACE) {
+        LogErr() << "Error: too many waypoints: " << int(mission_ack.type);
+        finish_upload(lock, Mission::Result::TOO_MANY_MISSION_ITEMS);
+    } else {
+        LogErr() << "Error: unknown mission ack: " << int(mission_ack.type);
+        finish_upload(lock, Mission::Result::ERROR);
+    }
+}
+
+void MissionTransfer::process_mission_count(const mavlink_message_t &message)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    mavlink_mission_count_t mission_count;
+    mavlink_msg_mission_count_decode(&message, &mission_count);
+
+    if (mission_count.mission_type != _type || _activity != Activity::DOWNLOAD) {
+        return;
+    }
+
+    _download.count = mission_count.count;
+    _download.next = 0;
+    _download.num_outstanding = 0;
+    _download.num_received = 0;
+    _download.items.assign(size_t(mission_count.count), mavlink_mission_item_int_t {});
+    _download.received.assign(size_t(mission_count.count), false);
+    _retries = 0;
+
+    // We are now requesting items and use a lower timeout for this.
+    _parent.unregister_timeout_handler(_timeout_cookie);
+
+    if (!_download.cached_items.empty()) {
+        if (_download.count == int(_download.cached_items.size())) {
+            // The vehicle doesn't tell more than the count, so that has to do.
+            LogDebug() << "Vehicle still holds the known items, not downloading them";
+            send_mission_ack(MAV_MISSION_ACCEPTED);
+            _download.items = std::move(_download.cached_items);
+            finish_download(lock, Mission::Result::SUCCESS);
+            return;
+        }
+        LogDebug() << "Vehicle holds other items than known, downloading them";
+        _download.cached_items.clear();
+    }
+
+    if (_download.count == 0) {
+        send_mission_ack(MAV_MISSION_ACCEPTED);
+        finish_download(lock, Mission::Result::SUCCESS);
+        return;
+    }
+
+    _parent.register_timeout_handler(std::bind(&MissionTransfer::process_timeout, this),
+                                     RETRY_TIMEOUT_S, &_timeout_cookie);
+    request_next_items();
+}
+
+void MissionTransfer::process_mission_item_int(const mavlink_message_t &message)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    mavlink_mission_item_int_t mission_item_int;
+    mavlink_msg_mission_item_int_decode(&message, &mission_item_int);
+
+    if (mission_item_int.mission_type != _type || _activity != Activity::DOWNLOAD) {
+        return;
+    }
+
+    // With several requests outstanding, replies can come in any order. Only
+    // items which were requested and are still missing are taken.
+    const int seq = mission_item_int.seq;
+    if (seq >= _download.next || _download.received[size_t(seq)]) {
+        // The timeout is not refreshed, so that a vehicle which keeps sending
+        // the wrong items still gets the missing ones requested again.
+        LogDebug() << "Received mission item " << seq << " which is not missing (ignored)";
+        return;
+    }
+
+    LogDebug() << "Received mission item " << seq;
+
+    _download.items[size_t(seq)] = mission_item_int;
+    _download.received[size_t(seq)] = true;
+    --_download.num_outstanding;
+    ++_download.num_received;
+    _retries = 0;
+
+    if (_download.num_received < _download.count) {
+        // Otherwise keep going.
+        _parent.refresh_timeout_handler(_timeout_cookie);
+        request_next_items();
+        return;
+    }
+
+    // Wrap things up if we're finished.
+    _parent.unregister_timeout_handler(_timeout_cookie);
+    send_mission_ack(MAV_MISSION_ACCEPTED);
+
+    // This is what the vehicle holds now, a differential upload can compare with it.
+    std::vector<uint64_t> item_hashes;
+    item_hashes.reserve(_download.items.size());
+    for (const auto &item : _download.items) {
+        item_hashes.push_back(hash_item(item));
+    }
+    with_vehicle_items([this, &item_hashes](VehicleItems & vehicle_items) {
+        vehicle_items.known = true;
+        vehicle_items.hash = hash_items(item_hashes);
+        vehicle_items.item_hashes = std::move(item_hashes);
+        vehicle_items.items = _download.items;
+    });
+
+    finish_download(lock, Mission::Result::SUCCESS);
+}
+
+void MissionTransfer::process_timeout()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (_activity == Activity::UPLOAD && _upload.partial) {
+        // Some autopilots ignore partial writes altogether.
+        fall_back_to_full_upload(lock);
+
+    } else if (_activity == Activity::UPLOAD) {
+        // We can't retry this, the autopilot should be requesting the items
+        // again.
+        LogWarn() << "Mission handling timed out while uploading mission.";
+        finish_upload(lock, Mission::Result::TIMEOUT);
+
+    } else if (_activity == Activity::DOWNLOAD) {
+        if (_retries++ > MAX_RETRIES) {
+            _retries = 0;
+            LogWarn() << "Mission handling timed out while downloading mission.";
+            finish_download(lock, Mission::Result::TIMEOUT);
+        } else {
+            LogWarn() << "Retrying requesting mission item...";
+            // We are retrying, so we use the lower timeout.
+            _parent.register_timeout_handler(std::bind(&MissionTransfer::process_timeout, this),
+                                             RETRY_TIMEOUT_S, &_timeout_cookie);
+            if (_download.count < 0) {
+                send_mission_request_list();
+            } else {
+                // Only what got lost, the rest of the window is still on its way.
+                request_missing_items();
+            }
+        }
+    } else {
+        LogWarn() << "unknown mission timeout";
+    }
+}
+
+bool MissionTransfer::send_mission_count()
+{
+    // We assume that we already acquired _mutex in this function.
+    mavlink_message_t message;
+    mavlink_msg_mission_count_pack(GCSClient::system_id,
+                                   GCSClient::component_id,
+                                   &message,
+                                   _parent.get_system_id(),
+                                   _parent.get_autopilot_id(),
+                                   uint16_t(_upload.item_hashes.size()),
+                                   _type);
+
+    if (!_parent.send_message(message)) {
+        return false;
+    }
+
+    // We use the longer process timeout here because essentially the autopilot needs to pull
+    // the items up.
+    _parent.register_timeout_handler(std::bind(&MissionTransfer::process_timeout, this),
+                                     PROCESS_TIMEOUT_S, &_timeout_cookie);
+    return true;
+}
+
+bool MissionTransfer::send_mission_write_partial_list(int start_index, int end_index)
+{
+    // We assume that we already acquired _mutex in this function.
+    LogDebug() << "Writing mission items " << start_index << " to " << end_index;
+
+    mavlink_message_t message;
+    mavlink_msg_mission_write_partial_list_pack(GCSClient::system_id,
+                                                GCSClient::component_id,
+                                                &message,
+                                                _parent.get_system_id(),
+                                                _parent.get_autopilot_id(),
+                                                int16_t(start_index),
+                                                int16_t(end_index),
+                                                _type);
+
+    if (!_parent.send_message(message)) {
+        return false;
+    }
+
+    // Same as for the count, the autopilot pulls the items in the range.
+    _parent.register_timeout_handler(std::bind(&MissionTransfer::process_timeout, this),
+                                     PROCESS_TIMEOUT_S, &_timeout_cookie);
+    return true;
+}
+
+bool MissionTransfer::send_mission_request_list()
+{
+    mavlink_message_t message;
+    mavlink_msg_mission_request_list_pack(GCSClient::system_id,
+                                          GCSClient::component_id,
+                                          &message,
+                                          _parent.get_system_id(),
+                                          _parent.get_autopilot_id(),
+                                          _type);
+
+    return _parent.send_message(message);
+}
+
+void MissionTransfer::send_mission_ack(MAV_MISSION_RESULT result)
+{
+    mavlink_message_t message;
+    mavlink_msg_mission_ack_pack(GCSClient::system_id,
+                                 GCSClient::component_id,
+                                 &message,
+                                 _parent.get_system_id(),
+                                 _parent.get_autopilot_id(),
+                                 result,
+                                 _type);
+
+    _parent.send_message(message);
+}
+
+void MissionTransfer::upload_item(int seq)
+{
+    // We assume that we already acquired _mutex in this function.
+    LogDebug() << "Send mission item " << seq;
+    if (seq >= int(_upload.item_hashes.size())) {
+        LogErr() << "Mission item requested out of bounds.";
+        return;
+    }
+
+    mavlink_mission_item_int_t item {};
+    if (!_upload.source(seq, item)) {
+        LogErr() << "Mission item " << seq << " went missing.";
+        return;
+    }
+    item.target_system = _parent.get_system_id();
+    item.target_component = _parent.get_autopilot_id();
+    item.seq = uint16_t(seq);
+    item.mission_type = _type;
+    _upload.items[size_t(seq)] = item;
+    _upload.known[size_t(seq)] = true;
+    _upload.end_sent = std::max(_upload.end_sent, seq + 1);
+
+    mavlink_message_t message;
+    mavlink_msg_mission_item_int_encode(GCSClient::system_id,
+                                        GCSClient::component_id,
+                                        &message,
+                                        &item);
+    _parent.send_message(message);
+}
+
+void MissionTransfer::fall_back_to_full_upload(std::unique_lock<std::mutex> &lock)
+{
+    LogWarn() << "Partial mission write failed, uploading all items.";
+
+    // Not trying again with this vehicle, it would most likely fail the same way.
+    with_vehicle_items([](VehicleItems & vehicle_items) {
+        vehicle_items.partial_write_unsupported = true;
+    });
+    _upload.partial = false;
+
+    if (!send_mission_count()) {
+        finish_upload(lock, Mission::Result::ERROR);
+    }
+}
+
+void MissionTransfer::request_next_items()
+{
+    // We assume that we already acquired _mutex in this function.
+    while (_download.num_outstanding < int(_download_window) &&
+           _download.next < _download.count) {
+        request_item(_download.next++);
+        ++_download.num_outstanding;
+    }
+}
+
+void MissionTransfer::request_missing_items()
+{
+    // We assume that we already acquired _mutex in this function.
+    for (int seq = 0; seq < _download.next; ++seq) {
+        if (!_download.received[size_t(seq)]) {
+            request_item(seq);
+        }
+    }
+}
+
+void MissionTransfer::request_item(int seq)
+{
+    mavlink_message_t message;
+    mavlink_msg_mission_request_int_pack(GCSClient::system_id,
+                                         GCSClient::component_id,
+                                         &message,
+                                         _parent.get_system_id(),
+                                         _parent.get_autopilot_id(),
+                                         uint16_t(seq),
+                                         _type);
+
+    LogDebug() << "Requested mission item " << seq;
+
+    _parent.send_message(message);
+}
+
+void MissionTransfer::finish_upload(std::unique_lock<std::mutex> &lock, Mission::Result result)
+{
+    _activity = Activity::NONE;
+    if (result == Mission::Result::SUCCESS) {
+        // Also if nothing needed to be sent.
+        _upload.end_sent = std::max(_upload.num_items, 1);
+    }
+    _upload.item_hashes.clear();
+    _upload.items.clear();
+    _upload.known.clear();
+    // The source can hold a lot, so it is not kept around.
+    _upload.source = nullptr;
+    const result_callback_t callback = std::move(_upload.callback);
+    _upload.callback = nullptr;
+
+    lock.unlock();
+    if (callback) {
+        callback(result);
+    }
+}
+
+void MissionTransfer::finish_download(std::unique_lock<std::mutex> &lock, Mission::Result result)
+{
+    _activity = Activity::NONE;
+    std::vector<mavlink_mission_item_int_t> items;
+    if (result == Mission::Result::SUCCESS) {
+        items = std::move(_download.items);
+    }
+    const items_and_result_callback_t callback = std::move(_download.callback);
+    _download = Download {};
+
+    lock.unlock();
+    if (callback) {
+        callback(result, std::move(items));
+    }
+}
+
+uint64_t MissionTransfer::hash_item(const mavlink_mission_item_int_t &item)
+{
+    // FNV-1a of the content only, the addressing and current flag are not
+    // the same for items uploaded and downloaded.
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&hash](const void *field, size_t len) {
+        const uint8_t *bytes = static_cast<const uint8_t *>(field);
+        for (size_t i = 0; i < len; ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    };
+
+    add(&item.seq, sizeof(item.seq));
+    add(&item.frame, sizeof(item.frame));
+    add(&item.command, sizeof(item.command));
+    add(&item.autocontinue, sizeof(item.autocontinue));
+    add(&item.param1, sizeof(item.param1));
+    add(&item.param2, sizeof(item.param2));
+    add(&item.param3, sizeof(item.param3));
+    add(&item.param4, sizeof(item.param4));
+    add(&item.x, sizeof(item.x));
+    add(&item.y, sizeof(item.y));
+    add(&item.z, sizeof(item.z));
+    return hash;
+}
+
+uint64_t MissionTransfer::hash_items(const std::vector<uint64_t> &item_hashes)
+{
+    // Same FNV-1a, over the item hashes in order.
+    uint64_t hash = 14695981039346656037ull;
+    for (uint64_t item_hash : item_hashes) {
+        for (unsigned i = 0; i < sizeof(item_hash); ++i) {
+            hash = (hash ^ ((item_hash >> (8 * i)) & 0xff)) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+bool MissionTransfer::are_items_valid(const VehicleItems &vehicle_items)
+{
+    if (!vehicle_items.known || vehicle_items.items.empty() ||
+        vehicle_items.items.size() != vehicle_items.item_hashes.size()) {
+        return false;
+    }
+
+    std::vector<uint64_t> item_hashes;
+    item_hashes.reserve(vehicle_items.items.size());
+    for (const auto &item : vehicle_items.items) {
+        item_hashes.push_back(hash_item(item));
+    }
+    return hash_items(item_hashes) == vehicle_items.hash;
+}
+
+void MissionTransfer::with_vehicle_items(const std::function<void(VehicleItems &)> &f)
+{
+    // We assume that we already acquired _mutex in this function.
+    const uint64_t uuid = _parent.get_uuid();
+    if (uuid == 0) {
+        f(_own_vehicle_items);
+        return;
+    }
+
+    bool changed = false;
+    bool known = false;
+    uint64_t hash = 0;
+    std::vector<uint64_t> item_hashes;
+    {
+        std::lock_guard<std::mutex> lock(_vehicle_items_mutex);
+        const auto key = std::make_pair(uuid, int(_type));
+        auto it = _vehicle_items.find(key);
+        if (it == _vehicle_items.end()) {
+            // What the vehicle held in an earlier run is good enough to tell
+            // what changed, the items themselves are not kept.
+            it = _vehicle_items.emplace(key, VehicleItems {}).first;
+            it->second.known = _parent.get_saved_mission(uint8_t(_type), it->second.hash,
+                                                         it->second.item_hashes);
+        }
+
+        VehicleItems &vehicle_items = it->second;
+        const bool known_before = vehicle_items.known;
+        const uint64_t hash_before = vehicle_items.hash;
+        f(vehicle_items);
+
+        changed = (vehicle_items.known != known_before || vehicle_items.hash != hash_before);
+        if (changed) {
+            known = vehicle_items.known;
+            hash = vehicle_items.hash;
+            item_hashes = vehicle_items.item_hashes;
+        }
+    }
+
+    if (changed) {
+        _parent.save_mission(uint8_t(_type), known, hash, item_hashes);
+    }
+}
+
+} // namespace dronecore
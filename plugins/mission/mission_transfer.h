@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "mavlink_system.h"
+#include "mavlink_include.h"
+#include "mission.h"
+
+namespace dronecore {
+
+// Transfers the items of one type (mission, geofence or rally points) with the
+// MAVLink mission protocol. It does not know what the items mean: an upload
+// pulls the MAVLink items from a source as the autopilot requests them and a
+// download hands back the MAVLink items as received.
+//
+// Every instance registers its own message handlers and only takes the
+// messages of its type, so transfers of different types can run at the same
+// time. The callbacks are called without the lock held, so they may call back
+// into the owner, but upload_async() and download_async() must not be called
+// with a lock held which the callbacks take.
+class MissionTransfer
+{
+public:
+    // Copies the MAVLink item with seq into item, returns false if there is none.
+    // The addressing and type are filled in before sending. Items are mostly
+    // asked for in order, so a source can pack them lazily.
+    typedef std::function<bool(int seq, mavlink_mission_item_int_t &item)> item_source_t;
+
+    typedef std::function<void(Mission::Result)> result_callback_t;
+    typedef std::function<void(Mission::Result, std::vector<mavlink_mission_item_int_t>)>
+    items_and_result_callback_t;
+
+    MissionTransfer(MAVLinkSystem &parent, MAV_MISSION_TYPE type);
+    ~MissionTransfer();
+
+    void init();
+    void deinit();
+    void disable();
+
+    // There has to be one hash_item() for each item, so that differential
+    // uploads can compare without going through the source.
+    void upload_async(std::vector<uint64_t> item_hashes,
+                      const item_source_t &source,
+                      const result_callback_t &callback);
+
+    void download_async(const items_and_result_callback_t &callback);
+
+    // How far the items of the current or last upload got requested, from 0 to 1.
+    // A successful upload counts as all of them.
+    float upload_progress();
+
+    void set_differential_upload(bool enable);
+    void set_download_window(unsigned window);
+    void set_cached_download(bool enable);
+
+    static uint64_t hash_item(const mavlink_mission_item_int_t &item);
+
+    // Non-copyable
+    MissionTransfer(const MissionTransfer &) = delete;
+    const MissionTransfer &operator=(const MissionTransfer &) = delete;
+
+private:
+    void process_mission_request(const mavlink_message_t &message);
+    void process_mission_request_int(const mavlink_message_t &message);
+    void process_mission_ack(const mavlink_message_t &message);
+    void process_mission_count(const mavlink_message_t &message);
+    void process_mission_item_int(const mavlink_message_t &message);
+
+    void process_timeout();
+
+    bool send_mission_count();
+    bool send_mission_write_partial_list(int start_index, int end_index);
+    bool send_mission_request_list();
+    void send_mission_ack(MAV_MISSION_RESULT result);
+    void upload_item(int seq);
+    void fall_back_to_full_upload(std::unique_lock<std::mutex> &lock);
+
+    void request_next_items();
+    void request_missing_items();
+    void request_item(int seq);
+
+    // These take the lock so that the callback can be called without it.
+    void finish_upload(std::unique_lock<std::mutex> &lock, Mission::Result result);
+    void finish_download(std::unique_lock<std::mutex> &lock, Mission::Result result);
+
+    static uint64_t hash_items(const std::vector<uint64_t> &item_hashes);
+
+    // What we know a vehicle holds.
+    struct VehicleItems {
+        bool known = false;
+        uint64_t hash = 0;
+        std::vector<uint64_t> item_hashes {};
+        // All of the items, or none if some of them are not known.
+        std::vector<mavlink_mission_item_int_t> items {};
+        bool partial_write_unsupported = false;
+    };
+
+    // Whether the items of a vehicle still match the hash they were known by.
+    static bool are_items_valid(const VehicleItems &vehicle_items);
+
+    // Calls f with what is known about the vehicle, under the lock of the registry.
+    void with_vehicle_items(const std::function<void(VehicleItems &)> &f);
+
+    MAVLinkSystem &_parent;
+    const MAV_MISSION_TYPE _type;
+
+    std::mutex _mutex {};
+
+    enum class Activity {
+        NONE,
+        UPLOAD,
+        DOWNLOAD
+    } _activity = Activity::NONE;
+
+    unsigned _retries = 0;
+    static constexpr unsigned MAX_RETRIES = 3;
+
+    struct Upload {
+        item_source_t source {};
+        result_callback_t callback {};
+        // Of all items, what the vehicle holds once accepted.
+        std::vector<uint64_t> item_hashes {};
+        uint64_t hash = 0;
+        // Only writing the changed range.
+        bool partial = false;
+        // As sent, or as the vehicle held them if they are not sent again.
+        std::vector<mavlink_mission_item_int_t> items {};
+        std::vector<bool> known {};
+        // One past the highest item sent, of all num_items.
+        int end_sent = 0;
+        int num_items = 0;
+    } _upload {};
+
+    bool _differential_upload = false;
+    bool _cached_download = false;
+
+    // Items are requested in order, up to window of them at a time. The ones
+    // below next have been requested at least once, those still missing are
+    // requested again on timeout.
+    struct Download {
+        items_and_result_callback_t callback {};
+        int count = -1;
+        int next = -1;
+        int num_outstanding = 0;
+        int num_received = 0;
+        // By seq.
+        std::vector<mavlink_mission_item_int_t> items {};
+        std::vector<bool> received {};
+        // Taken instead of downloading if the count of the vehicle matches.
+        std::vector<mavlink_mission_item_int_t> cached_items {};
+    } _download {};
+
+    unsigned _download_window = 1;
+
+    // By vehicle UUID and type and shared by all instances, so that it is still
+    // known after reconnecting or when Mission is created again. Only vehicles
+    // without UUID use the one of the instance.
+    static std::mutex _vehicle_items_mutex;
+    static std::map<std::pair<uint64_t, int>, VehicleItems> _vehicle_items;
+    VehicleItems _own_vehicle_items {};
+
+    static constexpr double RETRY_TIMEOUT_S = 0.250;
+    static constexpr double PROCESS_TIMEOUT_S = 1.5;
+    void *_timeout_cookie = nullptr;
+};
+
+} // namespace dronecore
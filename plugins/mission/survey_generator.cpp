@@ -0,0 +1,159 @@
+#include "survey_generator.h"
+#include "global_include.h"
+#include "local_projection.h"
+#include "log.h"
+#include <algorithm>
+#include <cmath>
+
+namespace dronecore {
+
+constexpr double SurveyGenerator::MIN_SEGMENT_LENGTH_M;
+
+Mission::Result SurveyGenerator::generate(Mission::mission_data_t &mission_data,
+                                          const std::vector<Mission::SurveyVertex> &polygon,
+                                          const Mission::SurveySettings &settings)
+{
+    if (!is_valid(polygon, settings)) {
+        return Mission::Result::INVALID_ARGUMENT;
+    }
+
+    const size_t num_vertices = polygon.size();
+
+    double ref_latitude_deg = 0.0;
+    double ref_longitude_deg = 0.0;
+    for (const auto &vertex : polygon) {
+        ref_latitude_deg += vertex.latitude_deg;
+        ref_longitude_deg += vertex.longitude_deg;
+    }
+    ref_latitude_deg /= double(num_vertices);
+    ref_longitude_deg /= double(num_vertices);
+
+    const LocalProjection projection(ref_latitude_deg, ref_longitude_deg);
+    const double sin_heading = std::sin(to_rad_from_deg(settings.heading_deg));
+    const double cos_heading = std::cos(to_rad_from_deg(settings.heading_deg));
+
+    // Along the lines (u) and across them (v), in metres. The vertices are kept
+    // in separate arrays and projected in loops without dependencies between
+    // the iterations, so that the compiler can vectorize them.
+    std::vector<double> latitudes_deg(num_vertices);
+    std::vector<double> longitudes_deg(num_vertices);
+    for (size_t i = 0; i < num_vertices; ++i) {
+        latitudes_deg[i] = polygon[i].latitude_deg;
+        longitudes_deg[i] = polygon[i].longitude_deg;
+    }
+    std::vector<double> vertex_north_m(num_vertices);
+    std::vector<double> vertex_east_m(num_vertices);
+    projection.forward(latitudes_deg.data(), longitudes_deg.data(), num_vertices,
+                       vertex_north_m.data(), vertex_east_m.data());
+
+    std::vector<double> u(num_vertices);
+    std::vector<double> v(num_vertices);
+    for (size_t i = 0; i < num_vertices; ++i) {
+        u[i] = vertex_east_m[i] * sin_heading + vertex_north_m[i] * cos_heading;
+        v[i] = vertex_east_m[i] * cos_heading - vertex_north_m[i] * sin_heading;
+    }
+
+    const double v_min = *std::min_element(v.begin(), v.end());
+    const double v_max = *std::max_element(v.begin(), v.end());
+
+    // The lines are centred, so the margin is the same on both sides. Rounding
+    // errors of the projection must not add a line.
+    const double width_m = v_max - v_min;
+    const int num_lines =
+        std::max(1, int(std::ceil(width_m / settings.line_spacing_m - 1e-6)));
+    const double first_line_v = v_min + (width_m - (num_lines - 1) * settings.line_spacing_m) / 2.0;
+
+    const bool take_photos = settings.photo_distance_m > 0.0;
+    const size_t size_before = mission_data.size();
+    mission_data.reserve(size_before + 2 * size_t(num_lines));
+
+    auto add_waypoint = [&](double along_m, double across_m,
+                            MissionItem::CameraAction camera_action) {
+        // The rotation is its own inverse.
+        const double east_m = along_m * sin_heading + across_m * cos_heading;
+        const double north_m = along_m * cos_heading - across_m * sin_heading;
+
+        MissionItemData data {};
+        data.latitude_deg = projection.latitude_deg(north_m);
+        data.longitude_deg = projection.longitude_deg(east_m);
+        data.relative_altitude_m = settings.relative_altitude_m;
+        data.fly_through = true;
+        if (mission_data.size() == size_before) {
+            data.speed_m_s = settings.speed_m_s;
+            if (take_photos) {
+                data.gimbal_pitch_deg = -90.0f;
+                data.gimbal_yaw_deg = 0.0f;
+            }
+        }
+        if (take_photos) {
+            data.camera_action = camera_action;
+            data.camera_photo_interval_s = settings.photo_distance_m / double(settings.speed_m_s);
+        }
+        mission_data.push_back(data);
+    };
+
+    std::vector<double> crossings;
+    crossings.reserve(num_vertices);
+    for (int line = 0; line < num_lines; ++line) {
+        const double line_v = first_line_v + line * settings.line_spacing_m;
+
+        crossings.clear();
+        for (size_t i = 0, j = num_vertices - 1; i < num_vertices; j = i++) {
+            // One end is counted as above, so a vertex on the line only crosses once.
+            if ((v[i] > line_v) != (v[j] > line_v)) {
+                const double t = (line_v - v[j]) / (v[i] - v[j]);
+                crossings.push_back(u[j] + t * (u[i] - u[j]));
+            }
+        }
+        std::sort(crossings.begin(), crossings.end());
+
+        // Every other line is flown the other way round.
+        if (line % 2 == 1) {
+            std::reverse(crossings.begin(), crossings.end());
+        }
+
+        // Concave polygons give several segments, the gaps are flown without photos.
+        for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+            if (std::fabs(crossings[i + 1] - crossings[i]) < MIN_SEGMENT_LENGTH_M) {
+                continue;
+            }
+            add_waypoint(crossings[i], line_v, MissionItem::CameraAction::START_PHOTO_INTERVAL);
+            add_waypoint(crossings[i + 1], line_v, MissionItem::CameraAction::STOP_PHOTO_INTERVAL);
+        }
+    }
+
+    if (mission_data.size() == size_before) {
+        LogErr() << "Survey polygon has no area";
+        return Mission::Result::INVALID_ARGUMENT;
+    }
+    return Mission::Result::SUCCESS;
+}
+
+bool SurveyGenerator::is_valid(const std::vector<Mission::SurveyVertex> &polygon,
+                               const Mission::SurveySettings &settings)
+{
+    if (polygon.size() < 3) {
+        LogErr() << "Survey polygon needs at least 3 vertices";
+        return false;
+    }
+
+    for (const auto &vertex : polygon) {
+        if (!std::isfinite(vertex.latitude_deg) || !std::isfinite(vertex.longitude_deg)) {
+            LogErr() << "Survey polygon vertex invalid";
+            return false;
+        }
+    }
+
+    if (!(settings.line_spacing_m > 0.0) || !std::isfinite(settings.line_spacing_m) ||
+        !std::isfinite(settings.heading_deg) ||
+        !std::isfinite(settings.relative_altitude_m) ||
+        !(settings.speed_m_s > 0.0f) || !std::isfinite(settings.speed_m_s) ||
+        !(settings.photo_distance_m >= 0.0) || !std::isfinite(settings.photo_distance_m)) {
+        LogErr() << "Survey settings invalid";
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace dronecore
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+#include "mission.h"
+
+namespace dronecore {
+
+// Generates lawnmower surveys for Mission::generate_survey().
+//
+// The polygon is projected into a plane tangent at its centre, rotated so that
+// the lines run along one axis. Each line then only needs the crossings with the
+// polygon edges, which are flown in pairs from one edge to the next.
+class SurveyGenerator
+{
+public:
+    static Mission::Result generate(Mission::mission_data_t &mission_data,
+                                    const std::vector<Mission::SurveyVertex> &polygon,
+                                    const Mission::SurveySettings &settings);
+
+private:
+    static bool is_valid(const std::vector<Mission::SurveyVertex> &polygon,
+                         const Mission::SurveySettings &settings);
+
+    // Shorter segments, e.g. where a line touches a corner, are left out.
+    static constexpr double MIN_SEGMENT_LENGTH_M = 0.01;
+};
+
+} // namespace dronecore
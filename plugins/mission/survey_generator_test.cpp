@@ -0,0 +1,131 @@
+#include "survey_generator.h"
+#include <gtest/gtest.h>
+#include <cmath>
+
+using namespace dronecore;
+
+namespace {
+
+const double REF_LATITUDE_DEG = 47.40;
+const double REF_LONGITUDE_DEG = 8.45;
+const double M_PER_DEG = 6371000.0 * M_PI / 180.0;
+const double M_PER_DEG_LONGITUDE = M_PER_DEG * std::cos(REF_LATITUDE_DEG * M_PI / 180.0);
+
+Mission::SurveyVertex vertex(double east_m, double north_m)
+{
+    return {REF_LATITUDE_DEG + north_m / M_PER_DEG,
+            REF_LONGITUDE_DEG + east_m / M_PER_DEG_LONGITUDE};
+}
+
+double east_m(const MissionItemData &data)
+{
+    return (data.longitude_deg - REF_LONGITUDE_DEG) * M_PER_DEG_LONGITUDE;
+}
+
+double north_m(const MissionItemData &data)
+{
+    return (data.latitude_deg - REF_LATITUDE_DEG) * M_PER_DEG;
+}
+
+} // namespace
+
+TEST(SurveyGenerator, CoversSquare)
+{
+    const std::vector<Mission::SurveyVertex> square {
+        vertex(-50.0, -50.0), vertex(50.0, -50.0), vertex(50.0, 50.0), vertex(-50.0, 50.0)
+    };
+    Mission::SurveySettings settings;
+    settings.line_spacing_m = 20.0;
+    settings.heading_deg = 0.0;
+    settings.speed_m_s = 5.0f;
+    settings.photo_distance_m = 10.0;
+
+    Mission::mission_data_t mission_data;
+    ASSERT_EQ(SurveyGenerator::generate(mission_data, square, settings),
+              Mission::Result::SUCCESS);
+
+    // 5 lines going north and south, from one edge to the other.
+    ASSERT_EQ(mission_data.size(), 10u);
+    for (size_t i = 0; i < mission_data.size(); ++i) {
+        const MissionItemData &data = mission_data[i];
+        const size_t line = i / 2;
+        const bool line_start = (i % 2 == 0);
+        const bool northwards = (line % 2 == 0);
+
+        EXPECT_NEAR(east_m(data), -40.0 + 20.0 * double(line), 0.01);
+        EXPECT_NEAR(north_m(data), (line_start == northwards) ? -50.0 : 50.0, 0.01);
+        EXPECT_FLOAT_EQ(data.relative_altitude_m, settings.relative_altitude_m);
+        EXPECT_EQ(data.camera_action, line_start ?
+                  MissionItem::CameraAction::START_PHOTO_INTERVAL :
+                  MissionItem::CameraAction::STOP_PHOTO_INTERVAL);
+        EXPECT_DOUBLE_EQ(data.camera_photo_interval_s, 2.0);
+    }
+    EXPECT_FLOAT_EQ(mission_data[0].speed_m_s, 5.0f);
+    EXPECT_FLOAT_EQ(mission_data[0].gimbal_pitch_deg, -90.0f);
+}
+
+TEST(SurveyGenerator, FollowsHeading)
+{
+    const std::vector<Mission::SurveyVertex> square {
+        vertex(-50.0, -50.0), vertex(50.0, -50.0), vertex(50.0, 50.0), vertex(-50.0, 50.0)
+    };
+    Mission::SurveySettings settings;
+    settings.line_spacing_m = 20.0;
+    settings.heading_deg = 90.0;
+
+    Mission::mission_data_t mission_data;
+    ASSERT_EQ(SurveyGenerator::generate(mission_data, square, settings),
+              Mission::Result::SUCCESS);
+
+    // The lines run east now, without photos.
+    ASSERT_EQ(mission_data.size(), 10u);
+    EXPECT_NEAR(east_m(mission_data[0]), -50.0, 0.01);
+    EXPECT_NEAR(east_m(mission_data[1]), 50.0, 0.01);
+    EXPECT_NEAR(north_m(mission_data[0]), north_m(mission_data[1]), 0.01);
+    EXPECT_NEAR(std::fabs(north_m(mission_data[0])), 40.0, 0.01);
+    EXPECT_EQ(mission_data[0].camera_action, MissionItem::CameraAction::NONE);
+}
+
+TEST(SurveyGenerator, SplitsLinesOfConcavePolygon)
+{
+    // A U shape, the middle lines cross both arms.
+    const std::vector<Mission::SurveyVertex> u_shape {
+        vertex(-30.0, 0.0), vertex(30.0, 0.0), vertex(30.0, 100.0), vertex(10.0, 100.0),
+        vertex(10.0, 40.0), vertex(-10.0, 40.0), vertex(-10.0, 100.0), vertex(-30.0, 100.0)
+    };
+    Mission::SurveySettings settings;
+    settings.line_spacing_m = 20.0;
+    settings.heading_deg = 90.0;
+
+    Mission::mission_data_t mission_data;
+    ASSERT_EQ(SurveyGenerator::generate(mission_data, u_shape, settings),
+              Mission::Result::SUCCESS);
+
+    // 5 lines, the upper 3 in two segments each.
+    EXPECT_EQ(mission_data.size(), 16u);
+}
+
+TEST(SurveyGenerator, RejectsInvalidInput)
+{
+    Mission::mission_data_t mission_data;
+    Mission::SurveySettings settings;
+
+    EXPECT_EQ(SurveyGenerator::generate(mission_data, {vertex(0.0, 0.0), vertex(10.0, 0.0)},
+                                        settings),
+              Mission::Result::INVALID_ARGUMENT);
+
+    const std::vector<Mission::SurveyVertex> line {
+        vertex(0.0, 0.0), vertex(10.0, 0.0), vertex(20.0, 0.0)
+    };
+    EXPECT_EQ(SurveyGenerator::generate(mission_data, line, settings),
+              Mission::Result::INVALID_ARGUMENT);
+
+    const std::vector<Mission::SurveyVertex> triangle {
+        vertex(0.0, 0.0), vertex(10.0, 0.0), vertex(0.0, 10.0)
+    };
+    settings.line_spacing_m = 0.0;
+    EXPECT_EQ(SurveyGenerator::generate(mission_data, triangle, settings),
+              Mission::Result::INVALID_ARGUMENT);
+
+    EXPECT_TRUE(mission_data.empty());
+}
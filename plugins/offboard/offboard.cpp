@@ -48,6 +48,61 @@ void Offboard::set_velocity_body(Offboard::VelocityBodyYawspeed velocity_body_ya
     return _impl->set_velocity_body(velocity_body_yawspeed);
 }
 
+void Offboard::set_position_ned(Offboard::PositionNEDYaw position_ned_yaw)
+{
+    return _impl->set_position_ned(position_ned_yaw);
+}
+
+void Offboard::set_acceleration_ned(Offboard::AccelerationNED acceleration_ned)
+{
+    return _impl->set_acceleration_ned(acceleration_ned);
+}
+
+void Offboard::set_attitude(Offboard::Attitude attitude)
+{
+    return _impl->set_attitude(attitude);
+}
+
+bool Offboard::set_trajectory(const std::vector<TrajectoryPoint> &trajectory)
+{
+    return _impl->set_trajectory(trajectory);
+}
+
+bool Offboard::enable_dedicated_sender(SenderConfig config)
+{
+    return _impl->enable_dedicated_sender(config);
+}
+
+void Offboard::disable_dedicated_sender()
+{
+    _impl->disable_dedicated_sender();
+}
+
+Offboard::SenderStats Offboard::get_sender_stats() const
+{
+    return _impl->get_sender_stats();
+}
+
+void Offboard::set_manual_control(ManualControl manual_control)
+{
+    _impl->set_manual_control(manual_control);
+}
+
+bool Offboard::start_manual_control(SenderConfig config)
+{
+    return _impl->start_manual_control(config);
+}
+
+void Offboard::stop_manual_control()
+{
+    _impl->stop_manual_control();
+}
+
+Offboard::SenderStats Offboard::get_manual_control_stats() const
+{
+    return _impl->get_manual_control_stats();
+}
+
 const char *Offboard::result_str(Result result)
 {
     switch (result) {
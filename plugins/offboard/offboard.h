@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <vector>
 #include "plugin_base.h"
 
 namespace dronecore {
@@ -11,15 +13,16 @@ class System;
 
 
 /**
- * @brief This class is used to control a drone with velocity commands.
+ * @brief This class is used to control a drone with position, velocity, acceleration or
+ * attitude commands, or along a trajectory.
  *
- * The module is called offboard because the velocity commands can be sent from external sources
+ * The module is called offboard because the commands can be sent from external sources
  * as opposed to onboard control right inside the autopilot "board".
  *
  * Client code must specify a setpoint before starting offboard mode.
- * DroneCore automatically resends setpoints at 20Hz (PX4 Offboard mode requires that setpoints are
- * minimally resent at 2Hz). If more precise control is required, clients can call the
- * setpoint methods at whatever rate is required.
+ * DroneCore automatically resends setpoints at 10Hz (PX4 Offboard mode requires that setpoints are
+ * minimally resent at 2Hz), trajectories at 50Hz. If more precise control is required, clients
+ * can call the setpoint methods at whatever rate is required.
  *
  * **Attention:** this is work in progress, use with caution!
  */
@@ -93,6 +96,44 @@ public:
                                    looking from above). */
     };
 
+    /**
+     * @brief Type for position commands in NED (North East Down) coordinates and yaw.
+     */
+    struct PositionNEDYaw {
+        float north_m; /**< @brief Position North in metres. */
+        float east_m; /**< @brief Position East in metres. */
+        float down_m; /**< @brief Position Down in metres. */
+        float yaw_deg; /**< @brief Yaw in degrees (0 North, positive is clock-wise looking from
+                            above). */
+    };
+
+    /**
+     * @brief Type for acceleration commands in NED (North East Down) coordinates.
+     */
+    struct AccelerationNED {
+        float north_m_s2; /**< @brief Acceleration North in metres/second^2. */
+        float east_m_s2; /**< @brief Acceleration East in metres/second^2. */
+        float down_m_s2; /**< @brief Acceleration Down in metres/second^2. */
+    };
+
+    /**
+     * @brief Type for attitude commands in Euler angles and thrust.
+     */
+    struct Attitude {
+        float roll_deg; /**< @brief Roll angle in degrees (positive is right side down). */
+        float pitch_deg; /**< @brief Pitch angle in degrees (positive is nose up). */
+        float yaw_deg; /**< @brief Yaw angle in degrees (0 North, positive is clock-wise). */
+        float thrust_value; /**< @brief Thrust, from 0 (none) to 1 (full). */
+    };
+
+    /**
+     * @brief Point of a trajectory.
+     */
+    struct TrajectoryPoint {
+        float time_s; /**< @brief Time of the point in seconds after the trajectory is set. */
+        PositionNEDYaw position_ned_yaw; /**< @brief Position and yaw at that time. */
+    };
+
     /**
      * @brief Start offboard control (synchronous).
      *
@@ -153,6 +194,147 @@ public:
      */
     void set_velocity_body(VelocityBodyYawspeed velocity_body_yawspeed);
 
+    /**
+     * @brief Set the position in NED coordinates and yaw.
+     *
+     * @param position_ned_yaw Position and yaw `struct`.
+     */
+    void set_position_ned(PositionNEDYaw position_ned_yaw);
+
+    /**
+     * @brief Set the acceleration in NED coordinates.
+     *
+     * @param acceleration_ned Acceleration `struct`.
+     */
+    void set_acceleration_ned(AccelerationNED acceleration_ned);
+
+    /**
+     * @brief Set the attitude and thrust.
+     *
+     * @param attitude Attitude and thrust `struct`.
+     */
+    void set_attitude(Attitude attitude);
+
+    /**
+     * @brief Fly along a trajectory.
+     *
+     * The trajectory starts now and replaces any other setpoint. Between two
+     * points, the position and yaw are interpolated linearly and sent together
+     * with the velocity from one point to the next. Before the first and after
+     * the last point, the vehicle holds the position of that point. This way, a
+     * whole plan takes one call instead of one per setpoint.
+     *
+     * @param trajectory Points of the trajectory, by increasing time.
+     * @return `false` if the trajectory is empty or its times don't increase.
+     */
+    bool set_trajectory(const std::vector<TrajectoryPoint> &trajectory);
+
+    /**
+     * @brief Configuration of the dedicated setpoint sender.
+     */
+    struct SenderConfig {
+        float rate_hz; /**< @brief Rate the setpoints are sent at. */
+        int priority; /**< @brief Real-time (SCHED_FIFO) priority of the sender thread, 0 to
+                           keep the normal scheduling. */
+        int cpu; /**< @brief CPU to run the sender thread on, -1 for any. */
+        bool send_immediately; /**< @brief Send a new setpoint right away from the calling
+                                    thread, the interval then starts over from there. */
+    };
+
+    /**
+     * @brief Statistics of the dedicated setpoint sender.
+     */
+    struct SenderStats {
+        uint64_t num_sent; /**< @brief Setpoints sent by the sender thread. */
+        uint64_t num_sent_immediately; /**< @brief Setpoints sent right away when set. */
+        uint64_t num_skipped; /**< @brief Sends which were skipped because the sender was late
+                                   by more than an interval. */
+        double mean_lateness_s; /**< @brief Mean time the sends were late after their deadline. */
+        double max_lateness_s; /**< @brief Longest time a send was late after its deadline. */
+        double mean_latency_s; /**< @brief Mean time from setting a setpoint until it was sent. */
+        double max_latency_s; /**< @brief Longest time from setting a setpoint until it was sent. */
+    };
+
+    /**
+     * @brief Send setpoints from a thread of its own instead of the shared timers (optional).
+     *
+     * The thread sends the latest setpoint at a fixed rate, sleeping until
+     * absolute deadlines, and can be given a real-time priority and a CPU of
+     * its own (Linux only, a priority needs the permission for it). This is
+     * for control at higher rates, e.g. 50 Hz, where the shared timers are
+     * too irregular.
+     *
+     * Unless `send_immediately` is set, setpoints are then no longer sent
+     * immediately when set, but at the next deadline, so it is up to the
+     * rate how soon they go out.
+     *
+     * @param config Rate, priority and CPU of the sender.
+     * @return `false` if the rate is invalid.
+     */
+    bool enable_dedicated_sender(SenderConfig config);
+
+    /**
+     * @brief Go back to sending setpoints from the shared timers.
+     */
+    void disable_dedicated_sender();
+
+    /**
+     * @brief Get statistics of the dedicated setpoint sender since it was enabled.
+     *
+     * @return Statistics of the sender.
+     */
+    SenderStats get_sender_stats() const;
+
+    /**
+     * @brief Manual control input, as from a joystick, see set_manual_control().
+     */
+    struct ManualControl {
+        float x; /**< @brief Pitch stick, forward positive, from -1 to 1. */
+        float y; /**< @brief Roll stick, right positive, from -1 to 1. */
+        float z; /**< @brief Thrust stick, usually from 0 to 1, -1 to 1 with reverse thrust. */
+        float r; /**< @brief Yaw stick, clockwise positive, from -1 to 1. */
+        uint16_t buttons; /**< @brief One bit for each button pressed. */
+    };
+
+    /**
+     * @brief Set the manual control input sent by start_manual_control().
+     *
+     * Only the latest input is kept, it is handed over without a lock, so this can be called
+     * at any rate from a joystick thread. Values outside of their range are limited to it.
+     *
+     * @param manual_control Stick and button input.
+     */
+    void set_manual_control(ManualControl manual_control);
+
+    /**
+     * @brief Send MANUAL_CONTROL at a fixed rate from a thread of its own, for teleoperation.
+     *
+     * Like the dedicated setpoint sender, the thread sleeps until absolute deadlines, so the
+     * input goes out at an even rate however the joystick is read. With send_immediately, a
+     * new input is sent right away from the thread setting it, and the interval starts over,
+     * so the latency does not include waiting for the next deadline. Nothing is sent until
+     * the first input is set.
+     *
+     * This is independent of offboard control, the vehicle uses the input in its manual
+     * modes.
+     *
+     * @param config Rate, and scheduling of the sender thread.
+     * @return `false` if the config is invalid.
+     */
+    bool start_manual_control(SenderConfig config);
+
+    /**
+     * @brief Stop sending MANUAL_CONTROL. The input is forgotten.
+     */
+    void stop_manual_control();
+
+    /**
+     * @brief Get statistics of the manual control sender since it was started.
+     *
+     * @return Statistics of the sender.
+     */
+    SenderStats get_manual_control_stats() const;
+
     /**
      * @brief Copy constructor (object is not copyable).
      */
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "awaitable.h"
+#include "offboard.h"
+
+namespace dronecore {
+
+/**
+ * @brief Awaitable variants of the `*_async` calls of Offboard (C++20).
+ *
+ * The setpoints are set as before, only starting and stopping is awaited.
+ */
+class AwaitableOffboard
+{
+public:
+    /**
+     * @brief Constructor.
+     *
+     * @param offboard Offboard plugin, which needs to outlive this.
+     * @param executor Executor to resume on, e.g. RunLoop::executor().
+     */
+    AwaitableOffboard(Offboard &offboard, executor_t executor) :
+        _offboard(offboard),
+        _executor(std::move(executor)) {}
+
+    /** @brief See Offboard::start_async(). */
+    CallbackAwaitable<Offboard::Result> start()
+    {
+        return {_executor, [this](Offboard::result_callback_t callback) {
+            _offboard.start_async(callback);
+        }};
+    }
+
+    /** @brief See Offboard::stop_async(). */
+    CallbackAwaitable<Offboard::Result> stop()
+    {
+        return {_executor, [this](Offboard::result_callback_t callback) {
+            _offboard.stop_async(callback);
+        }};
+    }
+
+private:
+    Offboard &_offboard;
+    executor_t _executor;
+};
+
+} // namespace dronecore
@@ -2,9 +2,29 @@
 #include "offboard_impl.h"
 #include "dronecore_impl.h"
 #include "px4_custom_mode.h"
+#include <algorithm>
+#include <cmath>
 
 namespace dronecore {
 
+namespace {
+
+// Type mask of SET_POSITION_TARGET_LOCAL_NED.
+const uint16_t IGNORE_X = (1 << 0);
+const uint16_t IGNORE_Y = (1 << 1);
+const uint16_t IGNORE_Z = (1 << 2);
+const uint16_t IGNORE_VX = (1 << 3);
+const uint16_t IGNORE_VY = (1 << 4);
+const uint16_t IGNORE_VZ = (1 << 5);
+const uint16_t IGNORE_AX = (1 << 6);
+const uint16_t IGNORE_AY = (1 << 7);
+const uint16_t IGNORE_AZ = (1 << 8);
+//const uint16_t IS_FORCE = (1 << 9);
+const uint16_t IGNORE_YAW = (1 << 10);
+const uint16_t IGNORE_YAW_RATE = (1 << 11);
+
+} // namespace
+
 OffboardImpl::OffboardImpl(System &system) :
     PluginImplBase(system)
 {
@@ -19,8 +39,7 @@ OffboardImpl::~OffboardImpl()
 void OffboardImpl::init()
 {
     // We need the system state.
-    _parent->register_mavlink_message_handler(
-        MAVLINK_MSG_ID_HEARTBEAT,
+    _parent->register_mavlink_message_handler<mavlink_heartbeat_t>(
         std::bind(&OffboardImpl::process_heartbeat, this, std::placeholders::_1),
         this);
 }
@@ -28,12 +47,24 @@ void OffboardImpl::init()
 void OffboardImpl::deinit()
 {
     _parent->unregister_all_mavlink_message_handlers(this);
+    _sender.stop();
+    _manual_control_sender.stop();
 }
 
 void OffboardImpl::enable() {}
 
 void OffboardImpl::disable() {}
 
+void OffboardImpl::add_resource_usage(DroneCore::ResourceUsage &usage)
+{
+    if (_sender.is_running()) {
+        ++usage.num_threads;
+    }
+    if (_manual_control_sender.is_running()) {
+        ++usage.num_threads;
+    }
+}
+
 Offboard::Result OffboardImpl::start()
 {
     {
@@ -66,9 +97,7 @@ void OffboardImpl::start_async(Offboard::result_callback_t callback)
         std::lock_guard<std::mutex> lock(_mutex);
 
         if (_mode == Mode::NOT_ACTIVE) {
-            if (callback) {
-                callback(Offboard::Result::NO_SETPOINT_SET);
-            }
+            report_result(callback, Offboard::Result::NO_SETPOINT_SET);
             return;
         }
     }
@@ -103,144 +132,370 @@ bool OffboardImpl::is_active() const
 void OffboardImpl::receive_command_result(MAVLinkCommands::Result result,
                                           const Offboard::result_callback_t &callback)
 {
-    Offboard::Result offboard_result = offboard_result_from_command_result(result);
-    if (callback) {
-        callback(offboard_result);
+    report_result(callback, offboard_result_from_command_result(result));
+}
+
+void OffboardImpl::report_result(const Offboard::result_callback_t &callback,
+                                 Offboard::Result result)
+{
+    if (!callback) {
+        return;
     }
+    _parent->call_result_callback(this, [callback, result]() {
+        callback(result);
+    });
 }
 
 void OffboardImpl::set_velocity_ned(Offboard::VelocityNEDYaw velocity_ned_yaw)
 {
-    _mutex.lock();
-    _velocity_ned_yaw = velocity_ned_yaw;
+    _setpoint.update([&velocity_ned_yaw](Setpoint & setpoint) {
+        setpoint.mode = Mode::VELOCITY_NED;
+        setpoint.velocity_ned_yaw = velocity_ned_yaw;
+    });
+    setpoint_changed(Mode::VELOCITY_NED);
+}
 
-    if (_mode != Mode::VELOCITY_NED) {
-        if (_call_every_cookie) {
-            // If we're already sending other setpoints, stop that now.
-            _parent->remove_call_every(_call_every_cookie);
-            _call_every_cookie = nullptr;
+void OffboardImpl::set_velocity_body(Offboard::VelocityBodyYawspeed velocity_body_yawspeed)
+{
+    _setpoint.update([&velocity_body_yawspeed](Setpoint & setpoint) {
+        setpoint.mode = Mode::VELOCITY_BODY;
+        setpoint.velocity_body_yawspeed = velocity_body_yawspeed;
+    });
+    setpoint_changed(Mode::VELOCITY_BODY);
+}
+
+void OffboardImpl::set_position_ned(Offboard::PositionNEDYaw position_ned_yaw)
+{
+    _setpoint.update([&position_ned_yaw](Setpoint & setpoint) {
+        setpoint.mode = Mode::POSITION_NED;
+        setpoint.position_ned_yaw = position_ned_yaw;
+    });
+    setpoint_changed(Mode::POSITION_NED);
+}
+
+void OffboardImpl::set_acceleration_ned(Offboard::AccelerationNED acceleration_ned)
+{
+    _setpoint.update([&acceleration_ned](Setpoint & setpoint) {
+        setpoint.mode = Mode::ACCELERATION_NED;
+        setpoint.acceleration_ned = acceleration_ned;
+    });
+    setpoint_changed(Mode::ACCELERATION_NED);
+}
+
+void OffboardImpl::set_attitude(Offboard::Attitude attitude)
+{
+    _setpoint.update([&attitude](Setpoint & setpoint) {
+        setpoint.mode = Mode::ATTITUDE;
+        setpoint.attitude = attitude;
+    });
+    setpoint_changed(Mode::ATTITUDE);
+}
+
+bool OffboardImpl::set_trajectory(const std::vector<Offboard::TrajectoryPoint> &trajectory)
+{
+    if (trajectory.empty()) {
+        LogErr() << "Empty trajectory";
+        return false;
+    }
+    for (size_t i = 1; i < trajectory.size(); ++i) {
+        if (!(trajectory[i].time_s > trajectory[i - 1].time_s)) {
+            LogErr() << "Trajectory times need to increase";
+            return false;
         }
-        // We automatically send NED setpoints from now on.
-        _parent->add_call_every([this]() { send_velocity_ned(); },
-        SEND_INTERVAL_S,
-        &_call_every_cookie);
+    }
 
-        _mode = Mode::VELOCITY_NED;
-    } else {
-        // We're already sending these kind of setpoints. Since the setpoint change, let's
-        // reschedule the next call, so we don't send setpoints too often.
-        _parent->reset_call_every(_call_every_cookie);
+    auto new_trajectory = std::make_shared<Trajectory>();
+    new_trajectory->points = trajectory;
+    new_trajectory->start_time = _parent->get_time().steady_time();
+
+    std::atomic_store(&_trajectory, std::shared_ptr<const Trajectory>(new_trajectory));
+    _setpoint.update([](Setpoint & setpoint) {
+        setpoint.mode = Mode::TRAJECTORY;
+    });
+    setpoint_changed(Mode::TRAJECTORY);
+    return true;
+}
+
+void OffboardImpl::setpoint_changed(Mode mode)
+{
+    // The usual case in a control loop is more of the same kind of setpoint.
+    // It goes on the wire right away, without _mutex, which the receive
+    // thread takes as well.
+    if (_mode == mode) {
+        send_setpoint_now();
+        return;
+    }
+
+    bool send_now;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        send_now = start_sending_setpoints(mode);
     }
-    _mutex.unlock();
 
     // also send it right now to reduce latency
-    send_velocity_ned();
+    if (send_now) {
+        send_setpoint();
+    }
 }
 
-void OffboardImpl::set_velocity_body(Offboard::VelocityBodyYawspeed velocity_body_yawspeed)
+void OffboardImpl::send_setpoint_now()
+{
+    if (!_use_sender) {
+        send_setpoint();
+        // The keep-alive starts over from this send.
+        _parent->reset_call_every(_call_every_cookie);
+        return;
+    }
+
+    if (_send_immediately) {
+        send_setpoint();
+        _sender.notify_sent();
+    } else {
+        _sender.notify_new_setpoint();
+    }
+}
+
+bool OffboardImpl::start_sending_setpoints(Mode mode)
 {
-    _mutex.lock();
-    _velocity_body_yawspeed = velocity_body_yawspeed;
+    // We assume that we already acquired the mutex in this function.
 
-    if (_mode != Mode::VELOCITY_BODY) {
+    if (_use_sender) {
+        _mode = mode;
+        if (_send_immediately) {
+            _sender.notify_sent();
+            return true;
+        }
+        _sender.notify_new_setpoint();
+        return false;
+    }
+
+    if (_mode != mode) {
         if (_call_every_cookie) {
             // If we're already sending other setpoints, stop that now.
             _parent->remove_call_every(_call_every_cookie);
             _call_every_cookie = nullptr;
         }
-        // We automatically send body setpoints from now on.
-        _parent->add_call_every([this]() { send_velocity_body(); },
-        SEND_INTERVAL_S,
-        &_call_every_cookie);
-
-        _mode = Mode::VELOCITY_BODY;
+        // We automatically send these setpoints from now on.
+        add_call_every(mode);
+        _mode = mode;
     } else {
         // We're already sending these kind of setpoints. Since the setpoint change, let's
         // reschedule the next call, so we don't send setpoints too often.
         _parent->reset_call_every(_call_every_cookie);
     }
-    _mutex.unlock();
+    return true;
+}
 
-    // also send it right now to reduce latency
-    send_velocity_body();
-}
-
-void OffboardImpl::send_velocity_ned()
-{
-    const static uint16_t IGNORE_X = (1 << 0);
-    const static uint16_t IGNORE_Y = (1 << 1);
-    const static uint16_t IGNORE_Z = (1 << 2);
-    //const static uint16_t IGNORE_VX = (1 << 3);
-    //const static uint16_t IGNORE_VY = (1 << 4);
-    //const static uint16_t IGNORE_VZ = (1 << 5);
-    const static uint16_t IGNORE_AX = (1 << 6);
-    const static uint16_t IGNORE_AY = (1 << 7);
-    const static uint16_t IGNORE_AZ = (1 << 8);
-    //const static uint16_t IS_FORCE = (1 << 9);
-    //const static uint16_t IGNORE_YAW = (1 << 10);
-    const static uint16_t IGNORE_YAW_RATE = (1 << 11);
-
-    _mutex.lock();
-    const float yaw = to_rad_from_deg(_velocity_ned_yaw.yaw_deg);
-    const float yaw_rate = 0.0f;
-    const float x = 0.0f;
-    const float y = 0.0f;
-    const float z = 0.0f;
-    const float vx = _velocity_ned_yaw.north_m_s;
-    const float vy = _velocity_ned_yaw.east_m_s;
-    const float vz = _velocity_ned_yaw.down_m_s;
-    const float afx = 0.0f;
-    const float afy = 0.0f;
-    const float afz = 0.0f;
-    _mutex.unlock();
+void OffboardImpl::add_call_every(Mode mode)
+{
+    // We assume that we already acquired the mutex in this function.
+
+    // A trajectory changes all the time, so it is sent more often.
+    void *cookie = nullptr;
+    _parent->add_call_every([this]() { send_setpoint(); },
+    (mode == Mode::TRAJECTORY) ? TRAJECTORY_SEND_INTERVAL_S : SEND_INTERVAL_S,
+    &cookie);
+    _call_every_cookie = cookie;
+}
+
+bool OffboardImpl::send_setpoint()
+{
+    // Called on the sender thread as well, which must not wait for _mutex.
+    if (_mode == Mode::NOT_ACTIVE) {
+        // The slot can briefly say otherwise while a setter races a stop.
+        return false;
+    }
+    const Setpoint setpoint = _setpoint.load();
+
+    switch (setpoint.mode) {
+        case Mode::VELOCITY_NED:
+            send_velocity_ned(setpoint.velocity_ned_yaw);
+            return true;
+        case Mode::VELOCITY_BODY:
+            send_velocity_body(setpoint.velocity_body_yawspeed);
+            return true;
+        case Mode::POSITION_NED:
+            send_position_ned(setpoint.position_ned_yaw);
+            return true;
+        case Mode::ACCELERATION_NED:
+            send_acceleration_ned(setpoint.acceleration_ned);
+            return true;
+        case Mode::ATTITUDE:
+            send_attitude(setpoint.attitude);
+            return true;
+        case Mode::TRAJECTORY:
+            send_trajectory();
+            return true;
+        default:
+            return false;
+    }
+}
+
+void OffboardImpl::send_velocity_ned(const Offboard::VelocityNEDYaw &velocity_ned_yaw)
+{
+    send_position_target(MAV_FRAME_LOCAL_NED,
+                         IGNORE_X | IGNORE_Y | IGNORE_Z |
+                         IGNORE_AX | IGNORE_AY | IGNORE_AZ |
+                         IGNORE_YAW_RATE,
+                         0.0f, 0.0f, 0.0f,
+                         velocity_ned_yaw.north_m_s,
+                         velocity_ned_yaw.east_m_s,
+                         velocity_ned_yaw.down_m_s,
+                         0.0f, 0.0f, 0.0f,
+                         to_rad_from_deg(velocity_ned_yaw.yaw_deg), 0.0f);
+}
+
+void OffboardImpl::send_velocity_body(
+    const Offboard::VelocityBodyYawspeed &velocity_body_yawspeed)
+{
+    send_position_target(MAV_FRAME_BODY_NED,
+                         IGNORE_X | IGNORE_Y | IGNORE_Z |
+                         IGNORE_AX | IGNORE_AY | IGNORE_AZ |
+                         IGNORE_YAW,
+                         0.0f, 0.0f, 0.0f,
+                         velocity_body_yawspeed.forward_m_s,
+                         velocity_body_yawspeed.right_m_s,
+                         velocity_body_yawspeed.down_m_s,
+                         0.0f, 0.0f, 0.0f,
+                         0.0f, to_rad_from_deg(velocity_body_yawspeed.yawspeed_deg_s));
+}
+
+void OffboardImpl::send_position_ned(const Offboard::PositionNEDYaw &position_ned_yaw)
+{
+    send_position_target(MAV_FRAME_LOCAL_NED,
+                         IGNORE_VX | IGNORE_VY | IGNORE_VZ |
+                         IGNORE_AX | IGNORE_AY | IGNORE_AZ |
+                         IGNORE_YAW_RATE,
+                         position_ned_yaw.north_m,
+                         position_ned_yaw.east_m,
+                         position_ned_yaw.down_m,
+                         0.0f, 0.0f, 0.0f,
+                         0.0f, 0.0f, 0.0f,
+                         to_rad_from_deg(position_ned_yaw.yaw_deg), 0.0f);
+}
+
+void OffboardImpl::send_acceleration_ned(const Offboard::AccelerationNED &acceleration_ned)
+{
+    send_position_target(MAV_FRAME_LOCAL_NED,
+                         IGNORE_X | IGNORE_Y | IGNORE_Z |
+                         IGNORE_VX | IGNORE_VY | IGNORE_VZ |
+                         IGNORE_YAW | IGNORE_YAW_RATE,
+                         0.0f, 0.0f, 0.0f,
+                         0.0f, 0.0f, 0.0f,
+                         acceleration_ned.north_m_s2,
+                         acceleration_ned.east_m_s2,
+                         acceleration_ned.down_m_s2,
+                         0.0f, 0.0f);
+}
+
+void OffboardImpl::send_attitude(const Offboard::Attitude &attitude)
+{
+    const static uint8_t IGNORE_BODY_ROLL_RATE = (1 << 0);
+    const static uint8_t IGNORE_BODY_PITCH_RATE = (1 << 1);
+    const static uint8_t IGNORE_BODY_YAW_RATE = (1 << 2);
+    //const static uint8_t IGNORE_THRUST = (1 << 6);
+    //const static uint8_t IGNORE_ATTITUDE = (1 << 7);
+
+    const double cos_phi_2 = cos(double(to_rad_from_deg(attitude.roll_deg)) / 2.0);
+    const double sin_phi_2 = sin(double(to_rad_from_deg(attitude.roll_deg)) / 2.0);
+    const double cos_theta_2 = cos(double(to_rad_from_deg(attitude.pitch_deg)) / 2.0);
+    const double sin_theta_2 = sin(double(to_rad_from_deg(attitude.pitch_deg)) / 2.0);
+    const double cos_psi_2 = cos(double(to_rad_from_deg(attitude.yaw_deg)) / 2.0);
+    const double sin_psi_2 = sin(double(to_rad_from_deg(attitude.yaw_deg)) / 2.0);
+
+    // Need to disable astyle for this block.
+    // *INDENT-OFF*
+    const float q[4] = {
+        float(cos_phi_2 * cos_theta_2 * cos_psi_2 + sin_phi_2 * sin_theta_2 * sin_psi_2),
+        float(sin_phi_2 * cos_theta_2 * cos_psi_2 - cos_phi_2 * sin_theta_2 * sin_psi_2),
+        float(cos_phi_2 * sin_theta_2 * cos_psi_2 + sin_phi_2 * cos_theta_2 * sin_psi_2),
+        float(cos_phi_2 * cos_theta_2 * sin_psi_2 - sin_phi_2 * sin_theta_2 * cos_psi_2)
+    };
+    // *INDENT-ON*
 
     mavlink_message_t message;
-    mavlink_msg_set_position_target_local_ned_pack(GCSClient::system_id,
-                                                   GCSClient::component_id,
-                                                   &message,
-                                                   static_cast<uint32_t>(_parent->get_time().elapsed_s() * 1e3),
-                                                   _parent->get_system_id(),
-                                                   _parent->get_autopilot_id(),
-                                                   MAV_FRAME_LOCAL_NED,
-                                                   IGNORE_X | IGNORE_Y | IGNORE_Z |
-                                                   IGNORE_AX | IGNORE_AY | IGNORE_AZ |
-                                                   IGNORE_YAW_RATE,
-                                                   x, y, z, vx, vy, vz, afx, afy, afz,
-                                                   yaw, yaw_rate);
+    const uint32_t time_boot_ms = static_cast<uint32_t>(_parent->get_time().elapsed_s() * 1e3);
+    mavlink_msg_set_attitude_target_pack(GCSClient::system_id,
+                                         GCSClient::component_id,
+                                         &message,
+                                         time_boot_ms,
+                                         _parent->get_system_id(),
+                                         _parent->get_autopilot_id(),
+                                         IGNORE_BODY_ROLL_RATE |
+                                         IGNORE_BODY_PITCH_RATE |
+                                         IGNORE_BODY_YAW_RATE,
+                                         q, 0.0f, 0.0f, 0.0f,
+                                         attitude.thrust_value);
     _parent->send_message(message);
 }
 
-void OffboardImpl::send_velocity_body()
-{
-
-    const static uint16_t IGNORE_X = (1 << 0);
-    const static uint16_t IGNORE_Y = (1 << 1);
-    const static uint16_t IGNORE_Z = (1 << 2);
-    //const static uint16_t IGNORE_VX = (1 << 3);
-    //const static uint16_t IGNORE_VY = (1 << 4);
-    //const static uint16_t IGNORE_VZ = (1 << 5);
-    const static uint16_t IGNORE_AX = (1 << 6);
-    const static uint16_t IGNORE_AY = (1 << 7);
-    const static uint16_t IGNORE_AZ = (1 << 8);
-    //const static uint16_t IS_FORCE = (1 << 9);
-    const static uint16_t IGNORE_YAW = (1 << 10);
-    //const static uint16_t IGNORE_YAW_RATE = (1 << 11);
-
-
-    _mutex.lock();
-    const float yaw = 0.0f;
-    const float yaw_rate = to_rad_from_deg(_velocity_body_yawspeed.yawspeed_deg_s);
-    const float x = 0.0f;
-    const float y = 0.0f;
-    const float z = 0.0f;
-    const float vx = _velocity_body_yawspeed.forward_m_s;
-    const float vy = _velocity_body_yawspeed.right_m_s;
-    const float vz = _velocity_body_yawspeed.down_m_s;
-    const float afx = 0.0f;
-    const float afy = 0.0f;
-    const float afz = 0.0f;
-    _mutex.unlock();
+void OffboardImpl::send_trajectory()
+{
+    const std::shared_ptr<const Trajectory> trajectory = std::atomic_load(&_trajectory);
+    if (!trajectory) {
+        return;
+    }
+    const std::vector<Offboard::TrajectoryPoint> &points = trajectory->points;
+
+    const float time_s = float(_parent->get_time().elapsed_since_s(trajectory->start_time));
+
+    // The first point after now, the segment before it is where we are.
+    auto next = std::upper_bound(points.begin(), points.end(), time_s,
+    [](float value, const Offboard::TrajectoryPoint & point) {
+        return value < point.time_s;
+    });
+
+    if (next == points.begin() || next == points.end()) {
+        // Before the start or after the end, the vehicle holds the point.
+        const Offboard::PositionNEDYaw &position = (next == points.end()) ?
+                                                   points.back().position_ned_yaw :
+                                                   points.front().position_ned_yaw;
+        send_position_target(MAV_FRAME_LOCAL_NED,
+                             IGNORE_AX | IGNORE_AY | IGNORE_AZ |
+                             IGNORE_YAW_RATE,
+                             position.north_m, position.east_m, position.down_m,
+                             0.0f, 0.0f, 0.0f,
+                             0.0f, 0.0f, 0.0f,
+                             to_rad_from_deg(position.yaw_deg), 0.0f);
+        return;
+    }
+
+    const Offboard::TrajectoryPoint &from = *(next - 1);
+    const Offboard::TrajectoryPoint &to = *next;
+    const float duration_s = to.time_s - from.time_s;
+    const float ratio = (time_s - from.time_s) / duration_s;
+
+    const float north_m_s = (to.position_ned_yaw.north_m - from.position_ned_yaw.north_m) /
+                            duration_s;
+    const float east_m_s = (to.position_ned_yaw.east_m - from.position_ned_yaw.east_m) /
+                           duration_s;
+    const float down_m_s = (to.position_ned_yaw.down_m - from.position_ned_yaw.down_m) /
+                           duration_s;
+
+    // Yaw turns the short way round.
+    float yaw_change_deg = to.position_ned_yaw.yaw_deg - from.position_ned_yaw.yaw_deg;
+    yaw_change_deg = std::remainder(yaw_change_deg, 360.0f);
+
+    // The velocity is the feed forward for the position.
+    const float time_into_s = time_s - from.time_s;
+    send_position_target(MAV_FRAME_LOCAL_NED,
+                         IGNORE_AX | IGNORE_AY | IGNORE_AZ |
+                         IGNORE_YAW_RATE,
+                         from.position_ned_yaw.north_m + north_m_s * time_into_s,
+                         from.position_ned_yaw.east_m + east_m_s * time_into_s,
+                         from.position_ned_yaw.down_m + down_m_s * time_into_s,
+                         north_m_s, east_m_s, down_m_s,
+                         0.0f, 0.0f, 0.0f,
+                         to_rad_from_deg(from.position_ned_yaw.yaw_deg + yaw_change_deg * ratio),
+                         0.0f);
+}
 
+void OffboardImpl::send_position_target(uint8_t frame, uint16_t type_mask,
+                                        float x, float y, float z,
+                                        float vx, float vy, float vz,
+                                        float afx, float afy, float afz,
+                                        float yaw, float yaw_rate)
+{
     mavlink_message_t message;
     mavlink_msg_set_position_target_local_ned_pack(GCSClient::system_id,
                                                    GCSClient::component_id,
@@ -248,20 +503,132 @@ void OffboardImpl::send_velocity_body()
                                                    static_cast<uint32_t>(_parent->get_time().elapsed_s() * 1e3),
                                                    _parent->get_system_id(),
                                                    _parent->get_autopilot_id(),
-                                                   MAV_FRAME_BODY_NED,
-                                                   IGNORE_X | IGNORE_Y | IGNORE_Z |
-                                                   IGNORE_AX | IGNORE_AY | IGNORE_AZ |
-                                                   IGNORE_YAW,
+                                                   frame,
+                                                   type_mask,
                                                    x, y, z, vx, vy, vz, afx, afy, afz,
                                                    yaw, yaw_rate);
     _parent->send_message(message);
 }
 
-void OffboardImpl::process_heartbeat(const mavlink_message_t &message)
+bool OffboardImpl::enable_dedicated_sender(Offboard::SenderConfig config)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (!_sender.start(SetpointSender::Config {config.rate_hz, config.priority, config.cpu})) {
+        return false;
+    }
+    _send_immediately = config.send_immediately;
+
+    if (_call_every_cookie != nullptr) {
+        // The sender takes over from here.
+        _parent->remove_call_every(_call_every_cookie);
+        _call_every_cookie = nullptr;
+    }
+    _use_sender = true;
+    return true;
+}
+
+void OffboardImpl::disable_dedicated_sender()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (!_use_sender) {
+        return;
+    }
+    _sender.stop();
+    _use_sender = false;
+
+    // Carry on sending with the call every.
+    if (_mode != Mode::NOT_ACTIVE) {
+        add_call_every(_mode);
+    }
+}
+
+Offboard::SenderStats OffboardImpl::get_sender_stats() const
+{
+    return sender_stats_from(_sender.stats());
+}
+
+void OffboardImpl::set_manual_control(Offboard::ManualControl manual_control)
+{
+    _manual_control.store(manual_control);
+    _manual_control_set = true;
+
+    if (!_manual_control_sender.is_running()) {
+        return;
+    }
+    if (_send_manual_control_immediately) {
+        send_manual_control();
+        _manual_control_sender.notify_sent();
+    } else {
+        _manual_control_sender.notify_new_setpoint();
+    }
+}
+
+bool OffboardImpl::start_manual_control(Offboard::SenderConfig config)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _manual_control_sender.stop();
+    _send_manual_control_immediately = config.send_immediately;
+    return _manual_control_sender.start(
+               SetpointSender::Config {config.rate_hz, config.priority, config.cpu});
+}
+
+void OffboardImpl::stop_manual_control()
 {
-    mavlink_heartbeat_t heartbeat;
-    mavlink_msg_heartbeat_decode(&message, &heartbeat);
+    std::lock_guard<std::mutex> lock(_mutex);
 
+    _manual_control_sender.stop();
+    // An old input must not be sent when started again.
+    _manual_control_set = false;
+}
+
+Offboard::SenderStats OffboardImpl::get_manual_control_stats() const
+{
+    return sender_stats_from(_manual_control_sender.stats());
+}
+
+bool OffboardImpl::send_manual_control()
+{
+    if (!_manual_control_set) {
+        return false;
+    }
+
+    // MANUAL_CONTROL takes the axes from -1000 to 1000.
+    auto to_axis = [](float value) {
+        return int16_t(std::round(std::min(std::max(value, -1.0f), 1.0f) * 1000.0f));
+    };
+
+    const Offboard::ManualControl manual_control = _manual_control.load();
+    mavlink_message_t message;
+    mavlink_msg_manual_control_pack(GCSClient::system_id,
+                                    GCSClient::component_id,
+                                    &message,
+                                    _parent->get_system_id(),
+                                    to_axis(manual_control.x),
+                                    to_axis(manual_control.y),
+                                    to_axis(manual_control.z),
+                                    to_axis(manual_control.r),
+                                    manual_control.buttons);
+    return _parent->send_message(message);
+}
+
+Offboard::SenderStats OffboardImpl::sender_stats_from(const SetpointSender::Stats &stats)
+{
+    return Offboard::SenderStats {
+        stats.num_sent,
+        stats.num_sent_immediately,
+        stats.num_skipped,
+        stats.mean_lateness_s,
+        stats.max_lateness_s,
+        stats.mean_latency_s,
+        stats.max_latency_s
+    };
+}
+
+void OffboardImpl::process_heartbeat(const mavlink_heartbeat_t &heartbeat)
+{
     bool offboard_mode_active = false;
     if (heartbeat.base_mode & MAV_MODE_FLAG_CUSTOM_MODE_ENABLED) {
 
@@ -273,9 +640,11 @@ void OffboardImpl::process_heartbeat(const mavlink_message_t &message)
         }
     }
 
-    {
+    // Only take the mutex if there is something to stop, so that the receive
+    // thread does not hold up setting setpoints.
+    if (!offboard_mode_active && _mode != Mode::NOT_ACTIVE) {
         std::lock_guard<std::mutex> lock(_mutex);
-        if (!offboard_mode_active && _mode != Mode::NOT_ACTIVE) {
+        if (_mode != Mode::NOT_ACTIVE) {
             // It seems that we are no longer in offboard mode but still trying to send
             // setpoints. Let's stop for now.
             stop_sending_setpoints();
@@ -288,9 +657,30 @@ void OffboardImpl::stop_sending_setpoints()
     // We assume that we already acquired the mutex in this function.
 
     if (_call_every_cookie != nullptr) {
+        CallEveryHandler::Jitter jitter;
+        if (_parent->get_call_every_jitter(_call_every_cookie, jitter)) {
+            LogDebug() << "Setpoints sent: " << jitter.num_calls
+                       << ", skipped: " << jitter.num_skipped
+                       << ", mean late: " << jitter.mean_s * 1e3 << " ms"
+                       << ", max late: " << jitter.max_s * 1e3 << " ms";
+        }
         _parent->remove_call_every(_call_every_cookie);
         _call_every_cookie = nullptr;
     }
+
+    if (_use_sender) {
+        const SetpointSender::Stats stats = _sender.stats();
+        LogDebug() << "Setpoints sent: " << stats.num_sent
+                   << ", skipped: " << stats.num_skipped
+                   << ", mean late: " << stats.mean_lateness_s * 1e3 << " ms"
+                   << ", max late: " << stats.max_lateness_s * 1e3 << " ms"
+                   << ", max latency: " << stats.max_latency_s * 1e3 << " ms";
+    }
+
+    // The sender thread keeps running but has nothing to send anymore.
+    _setpoint.update([](Setpoint & setpoint) {
+        setpoint.mode = Mode::NOT_ACTIVE;
+    });
     _mode = Mode::NOT_ACTIVE;
 }
 
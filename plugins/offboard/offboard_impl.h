@@ -1,11 +1,16 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <mutex>
+#include <vector>
 #include "plugin_impl_base.h"
 #include "mavlink_include.h"
 #include "system.h"
 #include "mavlink_system.h"
 #include "offboard.h"
+#include "seqlock.h"
+#include "setpoint_sender.h"
 
 namespace dronecore {
 
@@ -20,6 +25,7 @@ public:
 
     void enable() override;
     void disable() override;
+    void add_resource_usage(DroneCore::ResourceUsage &usage) override;
 
     Offboard::Result start();
     Offboard::Result stop();
@@ -31,32 +37,103 @@ public:
 
     void set_velocity_ned(Offboard::VelocityNEDYaw velocity_ned_yaw);
     void set_velocity_body(Offboard::VelocityBodyYawspeed velocity_body_yawspeed);
+    void set_position_ned(Offboard::PositionNEDYaw position_ned_yaw);
+    void set_acceleration_ned(Offboard::AccelerationNED acceleration_ned);
+    void set_attitude(Offboard::Attitude attitude);
+    bool set_trajectory(const std::vector<Offboard::TrajectoryPoint> &trajectory);
 
-private:
-    void send_velocity_ned();
-    void send_velocity_body();
+    bool enable_dedicated_sender(Offboard::SenderConfig config);
+    void disable_dedicated_sender();
+    Offboard::SenderStats get_sender_stats() const;
 
-    void process_heartbeat(const mavlink_message_t &message);
-    void receive_command_result(MAVLinkCommands::Result result,
-                                const Offboard::result_callback_t &callback);
+    void set_manual_control(Offboard::ManualControl manual_control);
+    bool start_manual_control(Offboard::SenderConfig config);
+    void stop_manual_control();
+    Offboard::SenderStats get_manual_control_stats() const;
 
+    // Also used by SwarmOffboardImpl.
     static Offboard::Result offboard_result_from_command_result(
         MAVLinkCommands::Result result);
+    static Offboard::SenderStats sender_stats_from(const SetpointSender::Stats &stats);
 
-    void stop_sending_setpoints();
-
-    mutable std::mutex _mutex {};
+private:
     enum class Mode {
         NOT_ACTIVE,
         VELOCITY_NED,
-        VELOCITY_BODY
-    } _mode = Mode::NOT_ACTIVE;
-    Offboard::VelocityNEDYaw _velocity_ned_yaw {};
-    Offboard::VelocityBodyYawspeed _velocity_body_yawspeed {};
+        VELOCITY_BODY,
+        POSITION_NED,
+        ACCELERATION_NED,
+        ATTITUDE,
+        TRAJECTORY
+    };
+
+    void setpoint_changed(Mode mode);
+    void send_setpoint_now();
+    // Returns true if the setpoint should be sent right away as well.
+    bool start_sending_setpoints(Mode mode);
+    void add_call_every(Mode mode);
+
+    bool send_setpoint();
+    void send_velocity_ned(const Offboard::VelocityNEDYaw &velocity_ned_yaw);
+    void send_velocity_body(const Offboard::VelocityBodyYawspeed &velocity_body_yawspeed);
+    void send_position_ned(const Offboard::PositionNEDYaw &position_ned_yaw);
+    void send_acceleration_ned(const Offboard::AccelerationNED &acceleration_ned);
+    void send_attitude(const Offboard::Attitude &attitude);
+    void send_trajectory();
+    void send_position_target(uint8_t frame, uint16_t type_mask,
+                              float x, float y, float z,
+                              float vx, float vy, float vz,
+                              float afx, float afy, float afz,
+                              float yaw, float yaw_rate);
+
+    void process_heartbeat(const mavlink_heartbeat_t &heartbeat);
+    void receive_command_result(MAVLinkCommands::Result result,
+                                const Offboard::result_callback_t &callback);
+    void report_result(const Offboard::result_callback_t &callback, Offboard::Result result);
 
-    void *_call_every_cookie = nullptr;
+    void stop_sending_setpoints();
+
+    // Changes of the mode are made under _mutex, but it is read without.
+    mutable std::mutex _mutex {};
+    std::atomic<Mode> _mode {Mode::NOT_ACTIVE};
+
+    // The latest setpoint, read without a lock whenever it is sent.
+    struct Setpoint {
+        Mode mode;
+        Offboard::VelocityNEDYaw velocity_ned_yaw;
+        Offboard::VelocityBodyYawspeed velocity_body_yawspeed;
+        Offboard::PositionNEDYaw position_ned_yaw;
+        Offboard::AccelerationNED acceleration_ned;
+        Offboard::Attitude attitude;
+    };
+    SeqLock<Setpoint> _setpoint {};
+
+    // Replaced as a whole, never changed, so that it is read without a lock
+    // as well.
+    struct Trajectory {
+        std::vector<Offboard::TrajectoryPoint> points;
+        dl_time_t start_time;
+    };
+    std::shared_ptr<const Trajectory> _trajectory {};
+
+    std::atomic<void *> _call_every_cookie {nullptr};
+
+    // Used instead of the call every if enabled.
+    std::atomic<bool> _use_sender {false};
+    // A new setpoint is sent by the setter if set, otherwise it goes out with the
+    // next deadline of the sender. The same goes for the manual control below.
+    std::atomic<bool> _send_immediately {false};
+    SetpointSender _sender {std::bind(&OffboardImpl::send_setpoint, this)};
+
+    // The latest input, independent of offboard control.
+    SeqLock<Offboard::ManualControl> _manual_control {};
+    std::atomic<bool> _manual_control_set {false};
+    std::atomic<bool> _send_manual_control_immediately {false};
+    bool send_manual_control();
+    SetpointSender _manual_control_sender {std::bind(&OffboardImpl::send_manual_control, this)};
 
     const float SEND_INTERVAL_S = 0.1f;
+    const float TRAJECTORY_SEND_INTERVAL_S = 0.02f;
 };
 
 } // namespace dronecore
@@ -0,0 +1,200 @@
+#include "setpoint_sender.h"
+#include "global_include.h"
+#include "log.h"
+#include "thread_roles.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+
+#if defined(LINUX)
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#endif
+
+namespace dronecore {
+
+SetpointSender::SetpointSender(send_callback_t send_callback) :
+    _send_callback(send_callback)
+{}
+
+SetpointSender::~SetpointSender()
+{
+    stop();
+}
+
+bool SetpointSender::start(const Config &config)
+{
+    if (!std::isfinite(config.rate_hz) || config.rate_hz <= 0.0f) {
+        LogErr() << "Invalid setpoint rate: " << config.rate_hz << " Hz";
+        return false;
+    }
+
+    stop();
+
+    _new_setpoint_ns = 0;
+    _sent_ns = 0;
+    _num_sent_immediately = 0;
+    _stats.store(Stats {});
+    _should_exit = false;
+    _thread = new std::thread(&SetpointSender::run, this, config);
+    return true;
+}
+
+void SetpointSender::stop()
+{
+    if (_thread == nullptr) {
+        return;
+    }
+
+    _should_exit = true;
+    _thread->join();
+    delete _thread;
+    _thread = nullptr;
+}
+
+void SetpointSender::notify_new_setpoint()
+{
+    const int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               clock::now().time_since_epoch()).count();
+    // Only the first change since the last send counts, a later one is sent
+    // just as soon.
+    int64_t expected = 0;
+    _new_setpoint_ns.compare_exchange_strong(expected, now_ns);
+}
+
+void SetpointSender::notify_sent()
+{
+    const int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               clock::now().time_since_epoch()).count();
+    // The new setpoint is out, there is no latency to measure.
+    _new_setpoint_ns = 0;
+    _sent_ns = now_ns;
+    ++_num_sent_immediately;
+}
+
+SetpointSender::Stats SetpointSender::stats() const
+{
+    Stats stats = _stats.load();
+    stats.num_sent_immediately = _num_sent_immediately;
+    return stats;
+}
+
+void SetpointSender::run(Config config)
+{
+    ThreadRoles::apply_to_this_thread(DroneCore::ThreadRole::OFFBOARD, "setpoints");
+
+    set_scheduling(config);
+
+    const auto interval = std::chrono::duration_cast<clock::duration>(
+                              std::chrono::duration<double>(1.0 / double(config.rate_hz)));
+
+    Stats stats {};
+    double sum_lateness_s = 0.0;
+    double sum_latency_s = 0.0;
+    uint64_t num_latencies = 0;
+
+    clock::time_point deadline = clock::now() + interval;
+
+    while (!_should_exit) {
+        sleep_until(deadline);
+        if (_should_exit) {
+            break;
+        }
+
+        const int64_t sent_ns = _sent_ns.exchange(0);
+        if (sent_ns != 0) {
+            const clock::time_point after_sent =
+                clock::time_point(std::chrono::duration_cast<clock::duration>(
+                                      std::chrono::nanoseconds(sent_ns))) + interval;
+            if (after_sent > deadline) {
+                deadline = after_sent;
+                continue;
+            }
+        }
+
+        const int64_t new_setpoint_ns = _new_setpoint_ns.exchange(0);
+        const bool sent = _send_callback();
+        const clock::time_point now = clock::now();
+        const double lateness_s = std::chrono::duration<double>(now - deadline).count();
+
+        // Being late does not move the next deadlines, unless whole intervals
+        // were missed, these are skipped rather than made up for in a burst.
+        deadline += interval;
+        if (!sent) {
+            while (deadline <= now) {
+                deadline += interval;
+            }
+            continue;
+        }
+        while (deadline <= now) {
+            deadline += interval;
+            ++stats.num_skipped;
+        }
+
+        sum_lateness_s += lateness_s;
+        stats.max_lateness_s = std::max(stats.max_lateness_s, lateness_s);
+        ++stats.num_sent;
+        stats.mean_lateness_s = sum_lateness_s / double(stats.num_sent);
+
+        if (new_setpoint_ns != 0) {
+            const double latency_s = std::chrono::duration<double>(
+                                         now.time_since_epoch() -
+                                         std::chrono::nanoseconds(new_setpoint_ns)).count();
+            sum_latency_s += latency_s;
+            ++num_latencies;
+            stats.max_latency_s = std::max(stats.max_latency_s, latency_s);
+            stats.mean_latency_s = sum_latency_s / double(num_latencies);
+        }
+
+        _stats.store(stats);
+    }
+}
+
+void SetpointSender::set_scheduling(const Config &config)
+{
+#if defined(LINUX)
+    if (config.priority > 0) {
+        sched_param param {};
+        param.sched_priority = config.priority;
+        const int ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (ret != 0) {
+            LogWarn() << "Could not set setpoint priority " << config.priority << ": "
+                      << strerror(ret);
+        }
+    }
+
+    if (config.cpu >= 0) {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(config.cpu, &cpu_set);
+        const int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+        if (ret != 0) {
+            LogWarn() << "Could not run setpoints on CPU " << config.cpu << ": " << strerror(ret);
+        }
+    }
+#else
+    if (config.priority > 0 || config.cpu >= 0) {
+        LogWarn() << "Setpoint priority and CPU are only supported on Linux";
+    }
+#endif
+}
+
+void SetpointSender::sleep_until(clock::time_point deadline)
+{
+#if defined(LINUX)
+    // The steady clock is CLOCK_MONOTONIC, sleeping until an absolute time of
+    // it is not thrown off by how long it took to get here.
+    const auto since_epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 deadline.time_since_epoch()).count();
+    timespec ts;
+    ts.tv_sec = time_t(since_epoch / 1000000000);
+    ts.tv_nsec = long(since_epoch % 1000000000);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+#else
+    std::this_thread::sleep_until(deadline);
+#endif
+}
+
+} // namespace dronecore
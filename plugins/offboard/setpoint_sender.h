@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include "seqlock.h"
+
+namespace dronecore {
+
+// Calls a send function at a fixed rate on a thread of its own. The thread
+// sleeps until absolute deadlines, so that being late once does not shift
+// all later sends, and can be given a real-time priority and a CPU.
+//
+// The setpoint itself is not kept here, the send function is expected to
+// read it from a slot which does not block, e.g. a SeqLock. The thread keeps
+// waking up while there is nothing to send, so that it never needs to be
+// started or stopped from a thread which must not wait.
+class SetpointSender
+{
+public:
+    struct Config {
+        float rate_hz;
+        // SCHED_FIFO priority, 0 to keep the normal scheduling.
+        int priority;
+        // CPU to run on, -1 for any.
+        int cpu;
+    };
+
+    struct Stats {
+        uint64_t num_sent;
+        // Sent by the caller, see notify_sent().
+        uint64_t num_sent_immediately;
+        // Deadlines which passed while the thread was still late.
+        uint64_t num_skipped;
+        // How late the sends were after their deadline.
+        double mean_lateness_s;
+        double max_lateness_s;
+        // From a new setpoint until it was first sent.
+        double mean_latency_s;
+        double max_latency_s;
+    };
+
+    // Returns false if there was nothing to send.
+    typedef std::function<bool()> send_callback_t;
+
+    explicit SetpointSender(send_callback_t send_callback);
+    ~SetpointSender();
+
+    // Returns false if the config is invalid. Priority and CPU are best
+    // effort, e.g. a priority needs the rights for it.
+    bool start(const Config &config);
+    // Waits until the thread has stopped, at most for one interval.
+    void stop();
+    bool is_running() const { return _thread != nullptr; }
+
+    // For the latency, to be called whenever the setpoint changes.
+    void notify_new_setpoint();
+    // To be called when the setpoint was sent right away by the caller. The
+    // interval then starts over from that send, so that the next one is not
+    // sent just after it.
+    void notify_sent();
+
+    Stats stats() const;
+
+    // Non-copyable
+    SetpointSender(const SetpointSender &) = delete;
+    const SetpointSender &operator=(const SetpointSender &) = delete;
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    void run(Config config);
+    static void set_scheduling(const Config &config);
+    static void sleep_until(clock::time_point deadline);
+
+    const send_callback_t _send_callback;
+
+    std::thread *_thread = nullptr;
+    std::atomic<bool> _should_exit {false};
+
+    // Time of the setpoint which has not been sent yet, 0 if there is none.
+    std::atomic<int64_t> _new_setpoint_ns {0};
+    // Time of the last send by the caller, 0 if there was none since the
+    // thread looked.
+    std::atomic<int64_t> _sent_ns {0};
+    std::atomic<uint64_t> _num_sent_immediately {0};
+
+    SeqLock<Stats> _stats {};
+};
+
+} // namespace dronecore
@@ -0,0 +1,87 @@
+#include "setpoint_sender.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace dronecore;
+
+TEST(SetpointSender, SendsAtRate)
+{
+    std::atomic<unsigned> num_calls {0};
+    SetpointSender sender([&num_calls]() {
+        ++num_calls;
+        return true;
+    });
+
+    EXPECT_TRUE(sender.start(SetpointSender::Config {100.0f, 0, -1}));
+    EXPECT_TRUE(sender.is_running());
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    sender.stop();
+    EXPECT_FALSE(sender.is_running());
+
+    // The deadlines are absolute, so however late single sends are, the
+    // count stays close to the rate.
+    const SetpointSender::Stats stats = sender.stats();
+    EXPECT_EQ(stats.num_sent, num_calls);
+    EXPECT_GE(stats.num_sent + stats.num_skipped, 45u);
+    EXPECT_LE(stats.num_sent + stats.num_skipped, 51u);
+    EXPECT_GE(stats.mean_lateness_s, 0.0);
+    EXPECT_GE(stats.max_lateness_s, stats.mean_lateness_s);
+}
+
+TEST(SetpointSender, MeasuresLatency)
+{
+    std::atomic<bool> active {false};
+    SetpointSender sender([&active]() {
+        return active.load();
+    });
+
+    EXPECT_TRUE(sender.start(SetpointSender::Config {20.0f, 0, -1}));
+    std::this_thread::sleep_for(std::chrono::milliseconds(120));
+    // Nothing to send is not counted.
+    EXPECT_EQ(sender.stats().num_sent, 0u);
+
+    active = true;
+    sender.notify_new_setpoint();
+    std::this_thread::sleep_for(std::chrono::milliseconds(120));
+    sender.stop();
+
+    const SetpointSender::Stats stats = sender.stats();
+    EXPECT_GE(stats.num_sent, 1u);
+    EXPECT_GT(stats.max_latency_s, 0.0);
+    // It goes out at the next deadline at the latest.
+    EXPECT_LE(stats.max_latency_s, 0.05 + 0.02);
+    EXPECT_DOUBLE_EQ(stats.mean_latency_s, stats.max_latency_s);
+}
+
+TEST(SetpointSender, StartsOverAfterImmediateSend)
+{
+    std::atomic<unsigned> num_calls {0};
+    SetpointSender sender([&num_calls]() {
+        ++num_calls;
+        return true;
+    });
+
+    EXPECT_TRUE(sender.start(SetpointSender::Config {10.0f, 0, -1}));
+    for (unsigned i = 0; i < 15; ++i) {
+        sender.notify_sent();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    // There was never a whole interval without a send.
+    EXPECT_EQ(num_calls, 0u);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    sender.stop();
+    EXPECT_GE(num_calls, 1u);
+    EXPECT_EQ(sender.stats().num_sent_immediately, 15u);
+}
+
+TEST(SetpointSender, RejectsInvalidRate)
+{
+    SetpointSender sender([]() {
+        return true;
+    });
+    EXPECT_FALSE(sender.start(SetpointSender::Config {0.0f, 0, -1}));
+    EXPECT_FALSE(sender.is_running());
+}
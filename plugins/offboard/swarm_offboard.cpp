@@ -0,0 +1,55 @@
+#include "swarm_offboard.h"
+#include "swarm_offboard_impl.h"
+
+namespace dronecore {
+
+SwarmOffboard::SwarmOffboard(const std::vector<System *> &systems) :
+    _impl { new SwarmOffboardImpl(systems) }
+{
+}
+
+SwarmOffboard::~SwarmOffboard()
+{
+}
+
+size_t SwarmOffboard::num_systems() const
+{
+    return _impl->num_systems();
+}
+
+bool SwarmOffboard::set_position_ned(const std::vector<Offboard::PositionNEDYaw> &setpoints)
+{
+    return _impl->set_position_ned(setpoints);
+}
+
+bool SwarmOffboard::set_velocity_ned(const std::vector<Offboard::VelocityNEDYaw> &setpoints)
+{
+    return _impl->set_velocity_ned(setpoints);
+}
+
+bool SwarmOffboard::start_sending(Offboard::SenderConfig config)
+{
+    return _impl->start_sending(config);
+}
+
+void SwarmOffboard::stop_sending()
+{
+    _impl->stop_sending();
+}
+
+std::vector<Offboard::Result> SwarmOffboard::start()
+{
+    return _impl->start();
+}
+
+std::vector<Offboard::Result> SwarmOffboard::stop()
+{
+    return _impl->stop();
+}
+
+SwarmOffboard::Stats SwarmOffboard::get_stats() const
+{
+    return _impl->get_stats();
+}
+
+} // namespace dronecore
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "offboard.h"
+
+namespace dronecore {
+
+class System;
+class SwarmOffboardImpl;
+
+/**
+ * @brief The SwarmOffboard class controls several systems in offboard mode in lockstep,
+ * e.g. for formation flight.
+ *
+ * Instead of an Offboard instance with a timer of its own per system, the setpoints of all
+ * systems are sent together by one thread: at every tick they are packed with the same time
+ * and handed over to the connections in one batch. A system should not be controlled with
+ * Offboard at the same time.
+ */
+class SwarmOffboard
+{
+public:
+    /**
+     * @brief Constructor. Creates the swarm for specific systems.
+     *
+     * The setpoints are given in the same order as the systems here.
+     *
+     *     ```cpp
+     *     auto swarm = std::make_shared<SwarmOffboard>(std::vector<System *> {&system_1,
+     *                                                                         &system_2});
+     *     ```
+     *
+     * @param systems The systems of the swarm, which need to outlive it.
+     */
+    explicit SwarmOffboard(const std::vector<System *> &systems);
+
+    /**
+     * @brief Destructor, stops sending.
+     */
+    ~SwarmOffboard();
+
+    /**
+     * @brief Number of systems in the swarm.
+     */
+    size_t num_systems() const;
+
+    /**
+     * @brief Set the position in NED coordinates and yaw of every system.
+     *
+     * @param setpoints One setpoint per system.
+     * @return false if there is not one setpoint per system.
+     */
+    bool set_position_ned(const std::vector<Offboard::PositionNEDYaw> &setpoints);
+
+    /**
+     * @brief Set the velocity in NED coordinates and yaw of every system.
+     *
+     * @param setpoints One setpoint per system.
+     * @return false if there is not one setpoint per system.
+     */
+    bool set_velocity_ned(const std::vector<Offboard::VelocityNEDYaw> &setpoints);
+
+    /**
+     * @brief Start sending the latest setpoints of all systems together.
+     *
+     * Setpoints need to be sent before offboard mode can be started with start().
+     *
+     * @param config Rate and scheduling of the thread which sends, Offboard::SenderConfig::
+     *        send_immediately is not supported and ignored.
+     * @return false if the config is invalid.
+     */
+    bool start_sending(Offboard::SenderConfig config);
+
+    /**
+     * @brief Stop sending setpoints.
+     */
+    void stop_sending();
+
+    /**
+     * @brief Start offboard mode on all systems at the same time (synchronous).
+     *
+     * @return The result of every system, Offboard::Result::NO_SETPOINT_SET for all if no
+     *         setpoints are being sent.
+     */
+    std::vector<Offboard::Result> start();
+
+    /**
+     * @brief Stop offboard mode on all systems at the same time, they hold (synchronous).
+     *
+     * Setpoints are still sent until stop_sending().
+     *
+     * @return The result of every system.
+     */
+    std::vector<Offboard::Result> stop();
+
+    /**
+     * @brief Statistics of the setpoints sent to one system.
+     *
+     * The skew is how long after the tick started the setpoint of the system was handed over
+     * to the connections, so how far the systems got their setpoints apart.
+     */
+    struct SystemStats {
+        uint64_t num_sent; /**< @brief Setpoints handed over to the connections. */
+        uint64_t num_failed; /**< @brief Setpoints which could not be sent. */
+        double mean_skew_s; /**< @brief Mean skew of the setpoints. */
+        double max_skew_s; /**< @brief Largest skew of a setpoint. */
+    };
+
+    /**
+     * @brief Statistics since sending started.
+     */
+    struct Stats {
+        Offboard::SenderStats sender; /**< @brief Timing of the ticks. */
+        std::vector<SystemStats> systems; /**< @brief Per system, in the order of the systems. */
+    };
+
+    /**
+     * @brief Get statistics since sending started.
+     *
+     * @return Statistics of the ticks and of every system.
+     */
+    Stats get_stats() const;
+
+    // Non-copyable
+    /**
+     * @brief Copy constructor (object is not copyable).
+     */
+    SwarmOffboard(const SwarmOffboard &) = delete;
+    /**
+     * @brief Equality operator (object is not copyable).
+     */
+    const SwarmOffboard &operator=(const SwarmOffboard &) = delete;
+
+private:
+    /** @private Underlying implementation, set at instantiation */
+    std::unique_ptr<SwarmOffboardImpl> _impl;
+};
+
+} // namespace dronecore
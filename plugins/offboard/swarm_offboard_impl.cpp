@@ -0,0 +1,230 @@
+#include "global_include.h"
+#include "swarm_offboard_impl.h"
+#include "offboard_impl.h"
+#include "completion.h"
+#include "log.h"
+#include <algorithm>
+
+namespace dronecore {
+
+namespace {
+
+// Type mask of SET_POSITION_TARGET_LOCAL_NED.
+const uint16_t IGNORE_X = (1 << 0);
+const uint16_t IGNORE_Y = (1 << 1);
+const uint16_t IGNORE_Z = (1 << 2);
+const uint16_t IGNORE_VX = (1 << 3);
+const uint16_t IGNORE_VY = (1 << 4);
+const uint16_t IGNORE_VZ = (1 << 5);
+const uint16_t IGNORE_AX = (1 << 6);
+const uint16_t IGNORE_AY = (1 << 7);
+const uint16_t IGNORE_AZ = (1 << 8);
+const uint16_t IGNORE_YAW_RATE = (1 << 11);
+
+} // namespace
+
+SwarmOffboardImpl::SwarmOffboardImpl(const std::vector<System *> &systems) :
+    _systems(mavlink_systems_of(systems)),
+    _sender(std::bind(&SwarmOffboardImpl::send_setpoints, this)),
+    _messages(systems.size()),
+    _sums(systems.size(), SystemSums {0, 0, 0.0, 0.0})
+{
+}
+
+SwarmOffboardImpl::~SwarmOffboardImpl()
+{
+    _sender.stop();
+}
+
+std::vector<std::shared_ptr<MAVLinkSystem>>
+SwarmOffboardImpl::mavlink_systems_of(const std::vector<System *> &systems)
+{
+    std::vector<std::shared_ptr<MAVLinkSystem>> mavlink_systems;
+    for (auto system : systems) {
+        mavlink_systems.push_back(system->mavlink_system());
+    }
+    return mavlink_systems;
+}
+
+bool SwarmOffboardImpl::set_position_ned(
+    const std::vector<Offboard::PositionNEDYaw> &setpoints)
+{
+    if (setpoints.size() != _systems.size()) {
+        LogErr() << "Swarm needs " << _systems.size() << " setpoints, got " << setpoints.size();
+        return false;
+    }
+
+    auto converted = std::make_shared<std::vector<Setpoint>>();
+    converted->reserve(setpoints.size());
+    for (const auto &setpoint : setpoints) {
+        converted->push_back(Setpoint {
+            IGNORE_VX | IGNORE_VY | IGNORE_VZ |
+            IGNORE_AX | IGNORE_AY | IGNORE_AZ |
+            IGNORE_YAW_RATE,
+            setpoint.north_m, setpoint.east_m, setpoint.down_m,
+            0.0f, 0.0f, 0.0f,
+            to_rad_from_deg(setpoint.yaw_deg)
+        });
+    }
+    set_setpoints(converted);
+    return true;
+}
+
+bool SwarmOffboardImpl::set_velocity_ned(
+    const std::vector<Offboard::VelocityNEDYaw> &setpoints)
+{
+    if (setpoints.size() != _systems.size()) {
+        LogErr() << "Swarm needs " << _systems.size() << " setpoints, got " << setpoints.size();
+        return false;
+    }
+
+    auto converted = std::make_shared<std::vector<Setpoint>>();
+    converted->reserve(setpoints.size());
+    for (const auto &setpoint : setpoints) {
+        converted->push_back(Setpoint {
+            IGNORE_X | IGNORE_Y | IGNORE_Z |
+            IGNORE_AX | IGNORE_AY | IGNORE_AZ |
+            IGNORE_YAW_RATE,
+            0.0f, 0.0f, 0.0f,
+            setpoint.north_m_s, setpoint.east_m_s, setpoint.down_m_s,
+            to_rad_from_deg(setpoint.yaw_deg)
+        });
+    }
+    set_setpoints(converted);
+    return true;
+}
+
+void SwarmOffboardImpl::set_setpoints(setpoints_t setpoints)
+{
+    std::atomic_store(&_setpoints, setpoints);
+    _sender.notify_new_setpoint();
+}
+
+bool SwarmOffboardImpl::start_sending(Offboard::SenderConfig config)
+{
+    {
+        std::lock_guard<std::mutex> lock(_stats_mutex);
+        std::fill(_sums.begin(), _sums.end(), SystemSums {0, 0, 0.0, 0.0});
+    }
+    return _sender.start(SetpointSender::Config {config.rate_hz, config.priority, config.cpu});
+}
+
+void SwarmOffboardImpl::stop_sending()
+{
+    _sender.stop();
+}
+
+bool SwarmOffboardImpl::send_setpoints()
+{
+    const setpoints_t setpoints = std::atomic_load(&_setpoints);
+    if (!setpoints || _systems.empty()) {
+        return false;
+    }
+
+    const dl_time_t tick_time = _time.steady_time();
+    // All systems get the same time, they are meant for the same instant.
+    const uint32_t time_boot_ms = static_cast<uint32_t>(_time.elapsed_s() * 1e3);
+
+    for (size_t i = 0; i < _systems.size(); ++i) {
+        const Setpoint &setpoint = (*setpoints)[i];
+        mavlink_msg_set_position_target_local_ned_pack(GCSClient::system_id,
+                                                       GCSClient::component_id,
+                                                       &_messages[i],
+                                                       time_boot_ms,
+                                                       _systems[i]->get_system_id(),
+                                                       _systems[i]->get_autopilot_id(),
+                                                       MAV_FRAME_LOCAL_NED,
+                                                       setpoint.type_mask,
+                                                       setpoint.x, setpoint.y, setpoint.z,
+                                                       setpoint.vx, setpoint.vy, setpoint.vz,
+                                                       0.0f, 0.0f, 0.0f,
+                                                       setpoint.yaw, 0.0f);
+    }
+
+    // All systems share the connections, so any of them hands over the batch.
+    const bool success = _systems.front()->send_messages(_messages.data(), _messages.size());
+
+    // The batch is handed over as a whole, so every system of it has the
+    // same skew: from the start of the tick until it was out.
+    const double skew_s = _time.elapsed_since_s(tick_time);
+
+    std::lock_guard<std::mutex> lock(_stats_mutex);
+    for (auto &sums : _sums) {
+        if (!success) {
+            ++sums.num_failed;
+            continue;
+        }
+        ++sums.num_sent;
+        sums.sum_skew_s += skew_s;
+        sums.max_skew_s = std::max(sums.max_skew_s, skew_s);
+    }
+    return true;
+}
+
+std::vector<Offboard::Result> SwarmOffboardImpl::start()
+{
+    if (!_sender.is_running() || !std::atomic_load(&_setpoints)) {
+        return std::vector<Offboard::Result>(_systems.size(), Offboard::Result::NO_SETPOINT_SET);
+    }
+    return set_flight_mode(MAVLinkSystem::FlightMode::OFFBOARD);
+}
+
+std::vector<Offboard::Result> SwarmOffboardImpl::stop()
+{
+    return set_flight_mode(MAVLinkSystem::FlightMode::HOLD);
+}
+
+std::vector<Offboard::Result>
+SwarmOffboardImpl::set_flight_mode(MAVLinkSystem::FlightMode flight_mode)
+{
+    // The commands are all queued before waiting for any of them, so that the
+    // systems switch at about the same time rather than one after the other.
+    std::vector<std::unique_ptr<Completion<MAVLinkCommands::Result>>> completions;
+    for (auto &system : _systems) {
+        completions.emplace_back(new Completion<MAVLinkCommands::Result>());
+        Completion<MAVLinkCommands::Result> &completion = *completions.back();
+        system->set_flight_mode_async(
+            flight_mode,
+        [&completion](MAVLinkCommands::Result result, float) {
+            if (result == MAVLinkCommands::Result::IN_PROGRESS) {
+                return;
+            }
+            completion.complete(result);
+        });
+    }
+
+    std::vector<Offboard::Result> results;
+    for (auto &completion : completions) {
+        results.push_back(OffboardImpl::offboard_result_from_command_result(completion->wait()));
+    }
+    return results;
+}
+
+SwarmOffboard::Stats SwarmOffboardImpl::get_stats() const
+{
+    const SetpointSender::Stats sender = _sender.stats();
+
+    SwarmOffboard::Stats stats {};
+    stats.sender = Offboard::SenderStats {
+        sender.num_sent,
+        sender.num_sent_immediately,
+        sender.num_skipped,
+        sender.mean_lateness_s,
+        sender.max_lateness_s,
+        sender.mean_latency_s,
+        sender.max_latency_s
+    };
+
+    std::lock_guard<std::mutex> lock(_stats_mutex);
+    for (const auto &sums : _sums) {
+        stats.systems.push_back(SwarmOffboard::SystemStats {
+            sums.num_sent,
+            sums.num_failed,
+            (sums.num_sent > 0) ? sums.sum_skew_s / double(sums.num_sent) : 0.0,
+            sums.max_skew_s
+        });
+    }
+    return stats;
+}
+
+} // namespace dronecore
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "mavlink_include.h"
+#include "system.h"
+#include "mavlink_system.h"
+#include "swarm_offboard.h"
+#include "setpoint_sender.h"
+
+namespace dronecore {
+
+class SwarmOffboardImpl
+{
+public:
+    explicit SwarmOffboardImpl(const std::vector<System *> &systems);
+    ~SwarmOffboardImpl();
+
+    size_t num_systems() const { return _systems.size(); }
+
+    bool set_position_ned(const std::vector<Offboard::PositionNEDYaw> &setpoints);
+    bool set_velocity_ned(const std::vector<Offboard::VelocityNEDYaw> &setpoints);
+
+    bool start_sending(Offboard::SenderConfig config);
+    void stop_sending();
+
+    std::vector<Offboard::Result> start();
+    std::vector<Offboard::Result> stop();
+
+    SwarmOffboard::Stats get_stats() const;
+
+    // Non-copyable
+    SwarmOffboardImpl(const SwarmOffboardImpl &) = delete;
+    const SwarmOffboardImpl &operator=(const SwarmOffboardImpl &) = delete;
+
+private:
+    // What goes into SET_POSITION_TARGET_LOCAL_NED, the rest is ignored.
+    struct Setpoint {
+        uint16_t type_mask;
+        float x;
+        float y;
+        float z;
+        float vx;
+        float vy;
+        float vz;
+        float yaw;
+    };
+
+    typedef std::shared_ptr<const std::vector<Setpoint>> setpoints_t;
+
+    static std::vector<std::shared_ptr<MAVLinkSystem>>
+    mavlink_systems_of(const std::vector<System *> &systems);
+
+    void set_setpoints(setpoints_t setpoints);
+    bool send_setpoints();
+    std::vector<Offboard::Result> set_flight_mode(MAVLinkSystem::FlightMode flight_mode);
+
+    const std::vector<std::shared_ptr<MAVLinkSystem>> _systems;
+
+    // Swapped as a whole with atomic_load/atomic_store, so that all systems
+    // always get setpoints of the same call and the sender never waits.
+    setpoints_t _setpoints {};
+
+    SetpointSender _sender;
+
+    // Only used on the sender thread.
+    Time _time {};
+    std::vector<mavlink_message_t> _messages {};
+
+    struct SystemSums {
+        uint64_t num_sent;
+        uint64_t num_failed;
+        double sum_skew_s;
+        double max_skew_s;
+    };
+    mutable std::mutex _stats_mutex {};
+    std::vector<SystemSums> _sums {};
+};
+
+} // namespace dronecore
@@ -1,6 +1,8 @@
 #include "global_include.h"
 #include "math_conversions.h"
+#include "local_projection.h"
 #include <cmath>
+#include <limits>
 
 namespace dronecore {
 
@@ -43,5 +45,107 @@ Telemetry::Quaternion to_quaternion_from_euler_angle(Telemetry::EulerAngle euler
     return quaternion;
 }
 
+namespace {
+
+// Polynomial approximation, off by less than 2e-6 rad. The conditions are
+// selects rather than branches so that this can be inlined into a vectorized
+// loop, see CMakeLists.txt for the flags that needs.
+inline float fast_atan2(float y, float x)
+{
+    const float abs_x = std::fabs(x);
+    const float abs_y = std::fabs(y);
+    const float larger = (abs_x > abs_y) ? abs_x : abs_y;
+    const float smaller = (abs_x > abs_y) ? abs_y : abs_x;
+
+    // Adding the smallest float avoids 0/0 for atan2(0, 0) which is then 0.
+    const float r = smaller / (larger + std::numeric_limits<float>::min());
+    const float s = r * r;
+
+    // Need to disable astyle for this block.
+    // *INDENT-OFF*
+    float angle = r * (0.99997726f + s * (-0.33262347f + s * (0.19354346f
+                  + s * (-0.11643287f + s * (0.05265332f + s * -0.01172120f)))));
+    // *INDENT-ON*
+
+    angle = (abs_y > abs_x) ? 1.57079637f - angle : angle;
+    angle = (x < 0.0f) ? 3.14159274f - angle : angle;
+    angle = (y < 0.0f) ? -angle : angle;
+    return angle;
+}
+
+inline float fast_asin(float value)
+{
+    // Rounding can give slightly more than 1 for a unit quaternion.
+    value = (value > 1.0f) ? 1.0f : ((value < -1.0f) ? -1.0f : value);
+    return fast_atan2(value, std::sqrt(1.0f - value * value));
+}
+
+} // namespace
+
+void to_euler_angles_from_quaternions(size_t count,
+                                      const float *w, const float *x,
+                                      const float *y, const float *z,
+                                      float *roll_deg, float *pitch_deg, float *yaw_deg)
+{
+    const float rad_to_deg = 180.0f / 3.14159265f;
+
+    // One loop per output, because with all of them in one loop there are too
+    // many pointers which could alias for the compiler to still vectorize it.
+    for (size_t i = 0; i < count; ++i) {
+        roll_deg[i] = rad_to_deg * fast_atan2(2.0f * (w[i] * x[i] + y[i] * z[i]),
+                                              1.0f - 2.0f * (x[i] * x[i] + y[i] * y[i]));
+    }
+    for (size_t i = 0; i < count; ++i) {
+        pitch_deg[i] = rad_to_deg * fast_asin(2.0f * (w[i] * y[i] - z[i] * x[i]));
+    }
+    for (size_t i = 0; i < count; ++i) {
+        yaw_deg[i] = rad_to_deg * fast_atan2(2.0f * (w[i] * z[i] + x[i] * y[i]),
+                                             1.0f - 2.0f * (y[i] * y[i] + z[i] * z[i]));
+    }
+}
+
+namespace {
+
+// Of a direction in degrees clockwise from North, from 0 to 360.
+float to_heading_deg(double north, double east)
+{
+    double heading_deg = to_deg_from_rad(std::atan2(east, north));
+    if (heading_deg < 0.0) {
+        heading_deg += 360.0;
+    }
+    return float(heading_deg);
+}
+
+} // namespace
+
+Telemetry::GroundTrack to_ground_track_from_ground_speed_ned(
+    Telemetry::GroundSpeedNED ground_speed_ned)
+{
+    const double north = double(ground_speed_ned.velocity_north_m_s);
+    const double east = double(ground_speed_ned.velocity_east_m_s);
+    const double ground_speed_m_s = std::sqrt(north * north + east * east);
+
+    Telemetry::GroundTrack ground_track {
+        float(ground_speed_m_s),
+        (ground_speed_m_s > 0.0) ? to_heading_deg(north, east) : NAN,
+        -ground_speed_ned.velocity_down_m_s
+    };
+    return ground_track;
+}
+
+Telemetry::HomeVector to_home_vector(Telemetry::Position position,
+                                     Telemetry::Position home_position)
+{
+    // Home is the reference, which is also what makes this NAN without one.
+    const LocalProjection projection(home_position.latitude_deg, home_position.longitude_deg);
+    const double north_m = 0.0 - projection.north_m(position.latitude_deg);
+    const double east_m = 0.0 - projection.east_m(position.longitude_deg);
+
+    Telemetry::HomeVector home_vector {
+        float(std::sqrt(north_m * north_m + east_m * east_m)),
+        to_heading_deg(north_m, east_m)
+    };
+    return home_vector;
+}
 
 } // namespace dronecore
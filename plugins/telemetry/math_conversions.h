@@ -1,10 +1,32 @@
 #pragma once
 
 #include "telemetry.h"
+#include <cstddef>
 
 namespace dronecore {
 
 Telemetry::EulerAngle to_euler_angle_from_quaternion(Telemetry::Quaternion quaternion);
 Telemetry::Quaternion to_quaternion_from_euler_angle(Telemetry::EulerAngle euler_angle);
 
+// Converts count unit quaternions, given as separate arrays of w, x, y and z,
+// to Euler angles in degrees, written to separate arrays of roll, pitch and yaw.
+//
+// This is meant for many samples at once: it uses approximations of atan2 and
+// asin which are off by at most BATCH_EULER_ANGLE_MAX_ERROR_DEG, and the loop
+// has no branches so that the compiler can vectorize it.
+constexpr float BATCH_EULER_ANGLE_MAX_ERROR_DEG = 0.001f;
+
+void to_euler_angles_from_quaternions(size_t count,
+                                      const float *w, const float *x,
+                                      const float *y, const float *z,
+                                      float *roll_deg, float *pitch_deg, float *yaw_deg);
+
+Telemetry::GroundTrack to_ground_track_from_ground_speed_ned(
+    Telemetry::GroundSpeedNED ground_speed_ned);
+
+// On the plane tangent at home, see LocalProjection, so only meant for distances
+// of some tens of kilometres.
+Telemetry::HomeVector to_home_vector(Telemetry::Position position,
+                                     Telemetry::Position home_position);
+
 } // namespace dronecore
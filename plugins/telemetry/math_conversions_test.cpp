@@ -0,0 +1,118 @@
+#include "math_conversions.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace dronecore;
+
+namespace {
+
+double angle_difference_deg(double lhs, double rhs)
+{
+    double diff = std::fabs(lhs - rhs);
+    return (diff > 180.0) ? 360.0 - diff : diff;
+}
+
+} // namespace
+
+TEST(MathConversions, BatchEulerAnglesWithinErrorBound)
+{
+    const size_t count = 100000;
+
+    std::vector<float> w(count), x(count), y(count), z(count);
+    std::mt19937 generator(42);
+    std::normal_distribution<float> distribution(0.0f, 1.0f);
+    for (size_t i = 0; i < count; ++i) {
+        // Normally distributed components give uniformly distributed rotations.
+        w[i] = distribution(generator);
+        x[i] = distribution(generator);
+        y[i] = distribution(generator);
+        z[i] = distribution(generator);
+        const float norm = std::sqrt(w[i] * w[i] + x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+        w[i] /= norm;
+        x[i] /= norm;
+        y[i] /= norm;
+        z[i] /= norm;
+    }
+
+    std::vector<float> roll(count), pitch(count), yaw(count);
+    to_euler_angles_from_quaternions(count, w.data(), x.data(), y.data(), z.data(),
+                                     roll.data(), pitch.data(), yaw.data());
+
+    const double rad_to_deg = 180.0 / M_PI;
+    const double max_error_deg = double(BATCH_EULER_ANGLE_MAX_ERROR_DEG);
+
+    for (size_t i = 0; i < count; ++i) {
+        const double qw = double(w[i]);
+        const double qx = double(x[i]);
+        const double qy = double(y[i]);
+        const double qz = double(z[i]);
+        const double sin_pitch = std::max(-1.0, std::min(1.0, 2.0 * (qw * qy - qz * qx)));
+
+        const double expected_roll = rad_to_deg * std::atan2(2.0 * (qw * qx + qy * qz),
+                                                             1.0 - 2.0 * (qx * qx + qy * qy));
+        const double expected_pitch = rad_to_deg * std::asin(sin_pitch);
+        const double expected_yaw = rad_to_deg * std::atan2(2.0 * (qw * qz + qx * qy),
+                                                            1.0 - 2.0 * (qy * qy + qz * qz));
+
+        ASSERT_LE(angle_difference_deg(double(roll[i]), expected_roll), max_error_deg);
+        ASSERT_LE(std::fabs(double(pitch[i]) - expected_pitch), max_error_deg);
+        ASSERT_LE(angle_difference_deg(double(yaw[i]), expected_yaw), max_error_deg);
+    }
+}
+
+TEST(MathConversions, BatchEulerAnglesMatchSingle)
+{
+    const Telemetry::Quaternion quaternion {0.9238795f, 0.0f, 0.3826834f, 0.0f};
+    const Telemetry::EulerAngle euler_angle = to_euler_angle_from_quaternion(quaternion);
+
+    float roll, pitch, yaw;
+    to_euler_angles_from_quaternions(1, &quaternion.w, &quaternion.x, &quaternion.y,
+                                     &quaternion.z, &roll, &pitch, &yaw);
+
+    EXPECT_NEAR(roll, euler_angle.roll_deg, BATCH_EULER_ANGLE_MAX_ERROR_DEG);
+    EXPECT_NEAR(pitch, euler_angle.pitch_deg, BATCH_EULER_ANGLE_MAX_ERROR_DEG);
+    EXPECT_NEAR(yaw, euler_angle.yaw_deg, BATCH_EULER_ANGLE_MAX_ERROR_DEG);
+    EXPECT_NEAR(pitch, 45.0f, 0.01f);
+}
+
+TEST(MathConversions, GroundTrackFromGroundSpeedNED)
+{
+    auto ground_track = to_ground_track_from_ground_speed_ned(
+                            Telemetry::GroundSpeedNED {3.0f, -4.0f, -1.5f});
+    EXPECT_FLOAT_EQ(ground_track.ground_speed_m_s, 5.0f);
+    EXPECT_NEAR(ground_track.course_deg, 360.0 - 53.130102, 1e-3);
+    EXPECT_FLOAT_EQ(ground_track.climb_rate_m_s, 1.5f);
+
+    ground_track = to_ground_track_from_ground_speed_ned(
+                       Telemetry::GroundSpeedNED {0.0f, 0.0f, 0.0f});
+    EXPECT_FLOAT_EQ(ground_track.ground_speed_m_s, 0.0f);
+    EXPECT_TRUE(std::isnan(ground_track.course_deg));
+}
+
+TEST(MathConversions, HomeVector)
+{
+    const Telemetry::Position home {47.39, 8.54, 500.0f, 0.0f};
+
+    // About 1 km north-east of home, so home is to the south-west.
+    const double m_per_deg = 6371000.0 * M_PI / 180.0;
+    const double offset_m = 1000.0 / std::sqrt(2.0);
+    const Telemetry::Position position {
+        home.latitude_deg + offset_m / m_per_deg,
+        home.longitude_deg + offset_m / (m_per_deg * std::cos(home.latitude_deg * M_PI / 180.0)),
+        520.0f, 20.0f
+    };
+
+    auto home_vector = to_home_vector(position, home);
+    EXPECT_NEAR(home_vector.distance_m, 1000.0, 0.1);
+    EXPECT_NEAR(home_vector.bearing_deg, 225.0, 0.01);
+
+    home_vector = to_home_vector(home, home);
+    EXPECT_FLOAT_EQ(home_vector.distance_m, 0.0f);
+
+    const Telemetry::Position unknown {double(NAN), double(NAN), NAN, NAN};
+    home_vector = to_home_vector(position, unknown);
+    EXPECT_TRUE(std::isnan(home_vector.distance_m));
+    EXPECT_TRUE(std::isnan(home_vector.bearing_deg));
+}
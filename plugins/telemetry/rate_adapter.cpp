@@ -0,0 +1,64 @@
+#include "rate_adapter.h"
+#include <algorithm>
+
+namespace dronecore {
+
+constexpr double RateAdapter::MIN_SCALE;
+constexpr uint8_t RateAdapter::CONGESTED_TXBUF;
+constexpr uint8_t RateAdapter::CLEAR_TXBUF;
+constexpr double RateAdapter::HOLD_S;
+constexpr double RateAdapter::RECOVERY_S;
+
+RateAdapter::RateAdapter() {}
+
+RateAdapter::~RateAdapter() {}
+
+void RateAdapter::reset()
+{
+    _scale = 1.0;
+    _has_status = false;
+    _clear_since_s = -1.0;
+}
+
+bool RateAdapter::add_radio_status(uint8_t txbuf, uint16_t rxerrors, double time_s)
+{
+    if (!_has_status) {
+        // The error count only means something compared to the last one.
+        _has_status = true;
+        _rxerrors = rxerrors;
+        _changed_time_s = time_s;
+        return false;
+    }
+
+    // The counter wraps around, or starts over when the radio reboots.
+    const bool has_new_errors = (rxerrors != _rxerrors);
+    _rxerrors = rxerrors;
+
+    if (txbuf < CONGESTED_TXBUF || has_new_errors) {
+        _clear_since_s = -1.0;
+        if (_scale <= MIN_SCALE || time_s - _changed_time_s < HOLD_S) {
+            return false;
+        }
+        _scale = std::max(_scale * 0.5, MIN_SCALE);
+        _changed_time_s = time_s;
+        return true;
+    }
+
+    if (txbuf < CLEAR_TXBUF) {
+        _clear_since_s = -1.0;
+        return false;
+    }
+
+    if (_clear_since_s < 0.0) {
+        _clear_since_s = time_s;
+    }
+    if (_scale >= 1.0 || time_s - _clear_since_s < RECOVERY_S ||
+        time_s - _changed_time_s < RECOVERY_S) {
+        return false;
+    }
+    _scale = std::min(_scale * 1.25, 1.0);
+    _changed_time_s = time_s;
+    return true;
+}
+
+} // namespace dronecore
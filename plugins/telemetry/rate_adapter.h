@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+
+namespace dronecore {
+
+// Decides from RADIO_STATUS how much of the configured telemetry rates the
+// radio link can carry, as a scale between MIN_SCALE and 1.
+//
+// The link counts as congested when the radio's transmit buffer is filling
+// up, i.e. txbuf (free space in percent) drops below CONGESTED_TXBUF, or
+// when rxerrors goes up. The scale is then halved, at most once per
+// HOLD_S, so that the vehicle has time to follow the lower rates before the
+// next look. Once the buffer has stayed above CLEAR_TXBUF without new
+// errors for RECOVERY_S, the scale goes up again by a quarter at a time.
+class RateAdapter
+{
+public:
+    RateAdapter();
+    ~RateAdapter();
+
+    void reset();
+
+    // Returns true if the scale changed.
+    bool add_radio_status(uint8_t txbuf, uint16_t rxerrors, double time_s);
+
+    double scale() const { return _scale; }
+
+    static constexpr double MIN_SCALE = 0.1;
+    static constexpr uint8_t CONGESTED_TXBUF = 50;
+    static constexpr uint8_t CLEAR_TXBUF = 80;
+    static constexpr double HOLD_S = 2.0;
+    static constexpr double RECOVERY_S = 5.0;
+
+private:
+    double _scale = 1.0;
+    bool _has_status = false;
+    uint16_t _rxerrors = 0;
+    double _changed_time_s = 0.0;
+    // Since when the link has been clear, negative if it is not.
+    double _clear_since_s = -1.0;
+};
+
+} // namespace dronecore
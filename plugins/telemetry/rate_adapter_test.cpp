@@ -0,0 +1,54 @@
+#include "rate_adapter.h"
+#include <gtest/gtest.h>
+
+using namespace dronecore;
+
+TEST(RateAdapter, KeepsRatesOnClearLink)
+{
+    RateAdapter adapter;
+    for (unsigned i = 0; i < 100; ++i) {
+        EXPECT_FALSE(adapter.add_radio_status(100, 3, double(i)));
+    }
+    EXPECT_DOUBLE_EQ(adapter.scale(), 1.0);
+}
+
+TEST(RateAdapter, BacksOffAndRecovers)
+{
+    RateAdapter adapter;
+    adapter.add_radio_status(100, 0, 0.0);
+
+    // Filling buffer, but only halved once per hold time.
+    EXPECT_TRUE(adapter.add_radio_status(30, 0, 2.0));
+    EXPECT_DOUBLE_EQ(adapter.scale(), 0.5);
+    EXPECT_FALSE(adapter.add_radio_status(30, 0, 3.0));
+    EXPECT_DOUBLE_EQ(adapter.scale(), 0.5);
+
+    // New receive errors count as congestion too.
+    EXPECT_TRUE(adapter.add_radio_status(100, 7, 4.0));
+    EXPECT_DOUBLE_EQ(adapter.scale(), 0.25);
+
+    // Has to stay clear for a while before going up.
+    double time_s = 5.0;
+    for (; time_s < 9.0; time_s += 1.0) {
+        EXPECT_FALSE(adapter.add_radio_status(100, 7, time_s));
+    }
+    unsigned num_steps = 0;
+    for (; time_s < 100.0; time_s += 1.0) {
+        if (adapter.add_radio_status(100, 7, time_s)) {
+            ++num_steps;
+        }
+    }
+    EXPECT_DOUBLE_EQ(adapter.scale(), 1.0);
+    // 0.25 to 1 in quarters: 0.3125, 0.39, 0.49, 0.61, 0.76, 0.95, 1.
+    EXPECT_EQ(num_steps, 7u);
+}
+
+TEST(RateAdapter, StopsAtMinScale)
+{
+    RateAdapter adapter;
+    adapter.add_radio_status(0, 0, 0.0);
+    for (unsigned i = 1; i < 50; ++i) {
+        adapter.add_radio_status(0, 0, double(i) * RateAdapter::HOLD_S);
+    }
+    EXPECT_DOUBLE_EQ(adapter.scale(), RateAdapter::MIN_SCALE);
+}
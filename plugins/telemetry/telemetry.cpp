@@ -6,6 +6,8 @@
 
 namespace dronecore {
 
+constexpr unsigned Telemetry::MAX_RC_CHANNELS;
+
 Telemetry::Telemetry(System &system) :
     PluginBase(),
     _impl { new TelemetryImpl(system) }
@@ -105,6 +107,51 @@ void Telemetry::set_rate_rc_status_async(double rate_hz, result_callback_t callb
     _impl->set_rate_rc_status_async(rate_hz, callback);
 }
 
+Telemetry::Result Telemetry::set_rates(const std::vector<TopicRate> &rates)
+{
+    return _impl->set_rates(rates);
+}
+
+void Telemetry::set_rates_async(const std::vector<TopicRate> &rates, result_callback_t callback)
+{
+    _impl->set_rates_async(rates, callback);
+}
+
+Telemetry::Result Telemetry::enable_adaptive_rates(const std::vector<AdaptiveRate> &rates)
+{
+    return _impl->enable_adaptive_rates(rates);
+}
+
+Telemetry::Result Telemetry::disable_adaptive_rates()
+{
+    return _impl->disable_adaptive_rates();
+}
+
+double Telemetry::adaptive_rate_scale() const
+{
+    return _impl->adaptive_rate_scale();
+}
+
+void Telemetry::add_rate_profile(const std::string &name, const std::vector<TopicRate> &rates)
+{
+    _impl->add_rate_profile(name, rates);
+}
+
+Telemetry::Result Telemetry::set_rate_profile(const std::string &name)
+{
+    return _impl->set_rate_profile(name);
+}
+
+std::string Telemetry::rate_profile() const
+{
+    return _impl->rate_profile();
+}
+
+Telemetry::TimesyncStatus Telemetry::timesync_status() const
+{
+    return _impl->timesync_status();
+}
+
 Telemetry::Position Telemetry::position() const
 {
     return _impl->get_position();
@@ -150,6 +197,16 @@ Telemetry::GroundSpeedNED Telemetry::ground_speed_ned() const
     return _impl->get_ground_speed_ned();
 }
 
+Telemetry::GroundTrack Telemetry::ground_track() const
+{
+    return _impl->get_ground_track();
+}
+
+Telemetry::HomeVector Telemetry::home_vector() const
+{
+    return _impl->get_home_vector();
+}
+
 Telemetry::GPSInfo Telemetry::gps_info() const
 {
     return _impl->get_gps_info();
@@ -165,79 +222,225 @@ Telemetry::FlightMode Telemetry::flight_mode() const
     return _impl->get_flight_mode();
 }
 
+// Health and RC status depend on what is set up in enable(), so the plugin is
+// only enabled once they are used, if DroneCore is set up for it.
 Telemetry::Health Telemetry::health() const
 {
+    _impl->activate();
     return _impl->get_health();
 }
 
 bool Telemetry::health_all_ok() const
 {
+    _impl->activate();
     return _impl->get_health_all_ok();
 }
 
 Telemetry::RCStatus Telemetry::rc_status() const
 {
+    _impl->activate();
     return _impl->get_rc_status();
 }
 
-void Telemetry::position_async(position_callback_t callback)
+Telemetry::Snapshot Telemetry::snapshot() const
+{
+    _impl->activate();
+    return _impl->get_snapshot();
+}
+
+void Telemetry::set_history_capacity(size_t num_samples)
+{
+    _impl->set_history_capacity(num_samples);
+}
+
+std::vector<Telemetry::PositionSample> Telemetry::history_position(uint64_t since_us) const
+{
+    return _impl->get_history_position(since_us);
+}
+
+std::vector<Telemetry::QuaternionSample>
+Telemetry::history_attitude_quaternion(uint64_t since_us) const
+{
+    return _impl->get_history_attitude_quaternion(since_us);
+}
+
+std::vector<Telemetry::GroundSpeedNEDSample>
+Telemetry::history_ground_speed_ned(uint64_t since_us) const
+{
+    return _impl->get_history_ground_speed_ned(since_us);
+}
+
+Telemetry::Result Telemetry::enable_imu_stream(size_t capacity, double rate_hz)
+{
+    return _impl->enable_imu_stream(capacity, rate_hz);
+}
+
+size_t Telemetry::drain_imu_stream(std::vector<Imu> &samples)
+{
+    return _impl->drain_imu_stream(samples);
+}
+
+uint64_t Telemetry::imu_stream_dropped() const
+{
+    return _impl->get_imu_stream_dropped();
+}
+
+Telemetry::Result Telemetry::enable_odometry_stream(size_t capacity, double rate_hz)
 {
-    return _impl->position_async(callback);
+    return _impl->enable_odometry_stream(capacity, rate_hz);
 }
 
-void Telemetry::home_position_async(position_callback_t callback)
+size_t Telemetry::drain_odometry_stream(std::vector<Odometry> &samples)
 {
-    return _impl->home_position_async(callback);
+    return _impl->drain_odometry_stream(samples);
 }
 
-void Telemetry::in_air_async(in_air_callback_t callback)
+uint64_t Telemetry::odometry_stream_dropped() const
 {
-    return _impl->in_air_async(callback);
+    return _impl->get_odometry_stream_dropped();
 }
 
-void Telemetry::armed_async(armed_callback_t callback)
+Telemetry::Result Telemetry::enable_rc_channels_stream(size_t capacity, double rate_hz)
 {
-    return _impl->armed_async(callback);
+    return _impl->enable_rc_channels_stream(capacity, rate_hz);
 }
 
-void Telemetry::attitude_quaternion_async(attitude_quaternion_callback_t callback)
+size_t Telemetry::drain_rc_channels_stream(std::vector<RcChannels> &samples)
 {
-    return _impl->attitude_quaternion_async(callback);
+    return _impl->drain_rc_channels_stream(samples);
 }
 
-void Telemetry::attitude_euler_angle_async(attitude_euler_angle_callback_t callback)
+uint64_t Telemetry::rc_channels_stream_dropped() const
 {
-    return _impl->attitude_euler_angle_async(callback);
+    return _impl->get_rc_channels_stream_dropped();
 }
 
-void Telemetry::camera_attitude_quaternion_async(attitude_quaternion_callback_t callback)
+Telemetry::Result Telemetry::enable_attitude_stream(size_t capacity, double rate_hz)
 {
-    return _impl->camera_attitude_quaternion_async(callback);
+    return _impl->enable_attitude_stream(capacity, rate_hz);
 }
 
-void Telemetry::camera_attitude_euler_angle_async(attitude_euler_angle_callback_t callback)
+size_t Telemetry::drain_attitude_stream(std::vector<Attitude> &samples)
 {
-    return _impl->camera_attitude_euler_angle_async(callback);
+    return _impl->drain_attitude_stream(samples);
 }
 
-void Telemetry::ground_speed_ned_async(ground_speed_ned_callback_t callback)
+uint64_t Telemetry::attitude_stream_dropped() const
 {
-    return _impl->ground_speed_ned_async(callback);
+    return _impl->get_attitude_stream_dropped();
 }
 
-void Telemetry::gps_info_async(gps_info_callback_t callback)
+bool Telemetry::start_recording(const std::string &directory)
 {
-    return _impl->gps_info_async(callback);
+    return _impl->start_recording(directory);
 }
 
-void Telemetry::battery_async(battery_callback_t callback)
+void Telemetry::stop_recording()
 {
-    return _impl->battery_async(callback);
+    _impl->stop_recording();
 }
 
-void Telemetry::flight_mode_async(flight_mode_callback_t callback)
+void Telemetry::unsubscribe(subscription_handle_t handle)
 {
-    return _impl->flight_mode_async(callback);
+    _impl->unsubscribe(handle);
+}
+
+Telemetry::subscription_handle_t
+Telemetry::position_async(position_callback_t callback,
+                          const SubscriptionOptions &options)
+{
+    return _impl->position_async(callback, options);
+}
+
+Telemetry::subscription_handle_t
+Telemetry::home_position_async(position_callback_t callback,
+                               const SubscriptionOptions &options)
+{
+    return _impl->home_position_async(callback, options);
+}
+
+Telemetry::subscription_handle_t
+Telemetry::in_air_async(in_air_callback_t callback,
+                        const SubscriptionOptions &options)
+{
+    return _impl->in_air_async(callback, options);
+}
+
+Telemetry::subscription_handle_t
+Telemetry::armed_async(armed_callback_t callback,
+                       const SubscriptionOptions &options)
+{
+    return _impl->armed_async(callback, options);
+}
+
+Telemetry::subscription_handle_t
+Telemetry::attitude_quaternion_async(attitude_quaternion_callback_t callback,
+                                     const SubscriptionOptions &options)
+{
+    return _impl->attitude_quaternion_async(callback, options);
+}
+
+Telemetry::subscription_handle_t
+Telemetry::attitude_euler_angle_async(attitude_euler_angle_callback_t callback,
+                                      const SubscriptionOptions &options)
+{
+    return _impl->attitude_euler_angle_async(callback, options);
+}
+
+Telemetry::subscription_handle_t
+Telemetry::camera_attitude_quaternion_async(attitude_quaternion_callback_t callback,
+                                            const SubscriptionOptions &options)
+{
+    return _impl->camera_attitude_quaternion_async(callback, options);
+}
+
+Telemetry::subscription_handle_t
+Telemetry::camera_attitude_euler_angle_async(attitude_euler_angle_callback_t callback,
+                                             const SubscriptionOptions &options)
+{
+    return _impl->camera_attitude_euler_angle_async(callback, options);
+}
+
+Telemetry::subscription_handle_t
+Telemetry::ground_speed_ned_async(ground_speed_ned_callback_t callback,
+                                  const SubscriptionOptions &options)
+{
+    return _impl->ground_speed_ned_async(callback, options);
+}
+
+Telemetry::subscription_handle_t
+Telemetry::ground_track_async(ground_track_callback_t callback,
+                              const SubscriptionOptions &options)
+{
+    return _impl->ground_track_async(callback, options);
+}
+
+Telemetry::subscription_handle_t
+Telemetry::home_vector_async(home_vector_callback_t callback,
+                             const SubscriptionOptions &options)
+{
+    return _impl->home_vector_async(callback, options);
+}
+
+Telemetry::subscription_handle_t
+Telemetry::gps_info_async(gps_info_callback_t callback,
+                          const SubscriptionOptions &options)
+{
+    return _impl->gps_info_async(callback, options);
+}
+
+Telemetry::subscription_handle_t
+Telemetry::battery_async(battery_callback_t callback,
+                         const SubscriptionOptions &options)
+{
+    return _impl->battery_async(callback, options);
+}
+
+Telemetry::subscription_handle_t
+Telemetry::flight_mode_async(flight_mode_callback_t callback,
+                             const SubscriptionOptions &options)
+{
+    return _impl->flight_mode_async(callback, options);
 }
 
 std::string Telemetry::flight_mode_str(FlightMode flight_mode)
@@ -266,19 +469,59 @@ std::string Telemetry::flight_mode_str(FlightMode flight_mode)
 
 }
 
-void Telemetry::health_async(health_callback_t callback)
+Telemetry::subscription_handle_t
+Telemetry::health_async(health_callback_t callback,
+                        const SubscriptionOptions &options)
+{
+    _impl->activate();
+    return _impl->health_async(callback, options);
+}
+
+Telemetry::subscription_handle_t
+Telemetry::health_all_ok_async(health_all_ok_callback_t callback,
+                               const SubscriptionOptions &options)
+{
+    _impl->activate();
+    return _impl->health_all_ok_async(callback, options);
+}
+
+Telemetry::subscription_handle_t
+Telemetry::rc_status_async(rc_status_callback_t callback,
+                           const SubscriptionOptions &options)
+{
+    _impl->activate();
+    return _impl->rc_status_async(callback, options);
+}
+
+Telemetry::subscription_handle_t Telemetry::status_text_async(status_text_callback_t callback)
+{
+    return _impl->status_text_async(callback);
+}
+
+std::vector<Telemetry::StatusText> Telemetry::status_texts(uint64_t since_seq) const
+{
+    return _impl->status_texts(since_seq);
+}
+
+Telemetry::subscription_handle_t
+Telemetry::position_sample_async(position_sample_callback_t callback,
+                                 const SubscriptionOptions &options)
 {
-    return _impl->health_async(callback);
+    return _impl->position_sample_async(callback, options);
 }
 
-void Telemetry::health_all_ok_async(health_all_ok_callback_t callback)
+Telemetry::subscription_handle_t
+Telemetry::attitude_quaternion_sample_async(attitude_quaternion_sample_callback_t callback,
+                                            const SubscriptionOptions &options)
 {
-    return _impl->health_all_ok_async(callback);
+    return _impl->attitude_quaternion_sample_async(callback, options);
 }
 
-void Telemetry::rc_status_async(rc_status_callback_t callback)
+Telemetry::subscription_handle_t
+Telemetry::ground_speed_ned_sample_async(ground_speed_ned_sample_callback_t callback,
+                                         const SubscriptionOptions &options)
 {
-    return _impl->rc_status_async(callback);
+    return _impl->ground_speed_ned_sample_async(callback, options);
 }
 
 const char *Telemetry::result_str(Result result)
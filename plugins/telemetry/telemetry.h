@@ -1,7 +1,10 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 #include "plugin_base.h"
 
 namespace dronecore {
@@ -86,6 +89,32 @@ public:
         float velocity_down_m_s; /**< @brief Velocity in Down direction in metres/second. */
     };
 
+    /**
+     * @brief Ground track type, derived from the ground speed.
+     */
+    struct GroundTrack {
+        float ground_speed_m_s; /**< @brief Horizontal speed in metres/second. */
+        /**
+         * @brief Direction of the horizontal movement in degrees clockwise from North,
+         * 0 to 360, NAN when not moving.
+         */
+        float course_deg;
+        float climb_rate_m_s; /**< @brief Vertical speed upwards in metres/second. */
+    };
+
+    /**
+     * @brief Where home is from the system, derived from the position and home position.
+     *
+     * Both are NAN until the home position is known.
+     */
+    struct HomeVector {
+        float distance_m; /**< @brief Horizontal distance to home in metres. */
+        /**
+         * @brief Direction from the system to home in degrees clockwise from North, 0 to 360.
+         */
+        float bearing_deg;
+    };
+
     /**
      * @brief GPS information type.
      */
@@ -150,6 +179,180 @@ public:
         float signal_strength_percent; /**< @brief Signal strength as a percentage (range: 0 to 100). */
     };
 
+    /**
+     * @brief Severity of a status text, as in MAVLink's MAV_SEVERITY.
+     */
+    enum class StatusTextSeverity {
+        EMERGENCY, /**< @brief System is unusable. */
+        ALERT, /**< @brief Action needs to be taken right away. */
+        CRITICAL, /**< @brief Failure of a primary system. */
+        ERROR, /**< @brief Failure of a secondary or redundant system. */
+        WARNING, /**< @brief Might become an error if nothing is done. */
+        NOTICE, /**< @brief Unusual, but not an error. */
+        INFO, /**< @brief Normal operation. */
+        DEBUG_ONLY /**< @brief Only of interest for debugging. */
+    };
+
+    /**
+     * @brief Text sent by a component of the vehicle, e.g. why arming was denied.
+     */
+    struct StatusText {
+        /** @brief Number of the text, one up from the one before, see status_texts(). */
+        uint64_t seq;
+        uint64_t time_us; /**< @brief Receive time, of the first part if it came in parts. */
+        uint8_t component_id; /**< @brief MAVLink component ID of the sender. */
+        StatusTextSeverity severity; /**< @brief Severity. */
+        std::string text; /**< @brief Text, put back together if it came in parts. */
+    };
+
+    /**
+     * @brief All telemetry fields at one point in time.
+     *
+     * Each field comes with the time it was last received, in microseconds of a
+     * monotonic clock, or 0 if it has not been received yet.
+     */
+    struct Snapshot {
+        Position position; /**< @brief Position. */
+        uint64_t position_time_us; /**< @brief Receive time of position. */
+        Position home_position; /**< @brief Home position. */
+        uint64_t home_position_time_us; /**< @brief Receive time of home position. */
+        bool in_air; /**< @brief true if in air. */
+        uint64_t in_air_time_us; /**< @brief Receive time of in air state. */
+        bool armed; /**< @brief true if armed. */
+        uint64_t armed_time_us; /**< @brief Receive time of armed state. */
+        Quaternion attitude_quaternion; /**< @brief Attitude. */
+        uint64_t attitude_quaternion_time_us; /**< @brief Receive time of attitude. */
+        EulerAngle camera_attitude_euler_angle; /**< @brief Camera/gimbal attitude. */
+        /** @brief Receive time of camera attitude. */
+        uint64_t camera_attitude_euler_angle_time_us;
+        GroundSpeedNED ground_speed_ned; /**< @brief Ground speed. */
+        uint64_t ground_speed_ned_time_us; /**< @brief Receive time of ground speed. */
+        GPSInfo gps_info; /**< @brief GPS information. */
+        uint64_t gps_info_time_us; /**< @brief Receive time of GPS information. */
+        Battery battery; /**< @brief Battery. */
+        uint64_t battery_time_us; /**< @brief Receive time of battery. */
+        FlightMode flight_mode; /**< @brief Flight mode. */
+        uint64_t flight_mode_time_us; /**< @brief Receive time of flight mode. */
+        Health health; /**< @brief Health flags. */
+        uint64_t health_time_us; /**< @brief Receive time of the latest health flag. */
+        RCStatus rc_status; /**< @brief RC status. */
+        uint64_t rc_status_time_us; /**< @brief Receive time of RC status. */
+        /** @brief Time the vehicle took the position on the same clock, see PositionSample. */
+        uint64_t position_sample_time_us;
+        /** @brief Time the vehicle took the attitude on the same clock, see PositionSample. */
+        uint64_t attitude_quaternion_sample_time_us;
+    };
+
+    /**
+     * @brief State of the clock synchronisation with the vehicle, see timesync_status().
+     */
+    struct TimesyncStatus {
+        bool converged; /**< @brief true once enough TIMESYNC round trips were in. */
+        double offset_s; /**< @brief Vehicle time minus the time of the Snapshot clock. */
+        double skew_ppm; /**< @brief How fast the vehicle clock runs ahead, in ppm. */
+        double rtt_s; /**< @brief Filtered round trip time of TIMESYNC. */
+        uint64_t num_samples; /**< @brief Round trips used. */
+        uint64_t num_rejected; /**< @brief Round trips left out, e.g. as they were too slow. */
+    };
+
+    /**
+     * @brief Position with the time it was received, see Snapshot for the clock.
+     */
+    struct PositionSample {
+        uint64_t time_us; /**< @brief Receive time. */
+        Position position; /**< @brief Position. */
+        uint64_t vehicle_time_us; /**< @brief Time since vehicle boot when it was taken. */
+        /**
+         * @brief Vehicle time on the clock of time_us, 0 until the clocks are synchronised.
+         *
+         * The difference to the current time is how old the sample is, including the link.
+         */
+        uint64_t sample_time_us;
+    };
+
+    /**
+     * @brief Attitude with the time it was received, see Snapshot for the clock.
+     */
+    struct QuaternionSample {
+        uint64_t time_us; /**< @brief Receive time. */
+        Quaternion quaternion; /**< @brief Attitude. */
+        uint64_t vehicle_time_us; /**< @brief Time since vehicle boot when it was taken. */
+        uint64_t sample_time_us; /**< @brief Vehicle time on our clock, see PositionSample. */
+    };
+
+    /**
+     * @brief Ground speed with the time it was received, see Snapshot for the clock.
+     */
+    struct GroundSpeedNEDSample {
+        uint64_t time_us; /**< @brief Receive time. */
+        GroundSpeedNED ground_speed_ned; /**< @brief Ground speed. */
+        uint64_t vehicle_time_us; /**< @brief Time since vehicle boot when it was taken. */
+        uint64_t sample_time_us; /**< @brief Vehicle time on our clock, see PositionSample. */
+    };
+
+    /**
+     * @brief Raw IMU sample, see enable_imu_stream().
+     */
+    struct Imu {
+        uint64_t time_us; /**< @brief Sample time of the vehicle in microseconds. */
+        float acc_x_m_s2; /**< @brief Acceleration in X in metres/second^2. */
+        float acc_y_m_s2; /**< @brief Acceleration in Y in metres/second^2. */
+        float acc_z_m_s2; /**< @brief Acceleration in Z in metres/second^2. */
+        float gyro_x_rad_s; /**< @brief Angular speed around X in radians/second. */
+        float gyro_y_rad_s; /**< @brief Angular speed around Y in radians/second. */
+        float gyro_z_rad_s; /**< @brief Angular speed around Z in radians/second. */
+        float mag_x_gauss; /**< @brief Magnetic field in X in Gauss. */
+        float mag_y_gauss; /**< @brief Magnetic field in Y in Gauss. */
+        float mag_z_gauss; /**< @brief Magnetic field in Z in Gauss. */
+        float abs_pressure_hpa; /**< @brief Absolute pressure in hectopascal. */
+        float temperature_degc; /**< @brief Temperature in degrees Celsius. */
+    };
+
+    /**
+     * @brief Odometry sample, see enable_odometry_stream().
+     */
+    struct Odometry {
+        uint64_t time_us; /**< @brief Sample time of the vehicle in microseconds. */
+        float x_m; /**< @brief Position in X in metres. */
+        float y_m; /**< @brief Position in Y in metres. */
+        float z_m; /**< @brief Position in Z in metres. */
+        Quaternion q; /**< @brief Attitude. */
+        float vx_m_s; /**< @brief Velocity in X in metres/second. */
+        float vy_m_s; /**< @brief Velocity in Y in metres/second. */
+        float vz_m_s; /**< @brief Velocity in Z in metres/second. */
+        float rollspeed_rad_s; /**< @brief Roll speed in radians/second. */
+        float pitchspeed_rad_s; /**< @brief Pitch speed in radians/second. */
+        float yawspeed_rad_s; /**< @brief Yaw speed in radians/second. */
+    };
+
+    /**
+     * @brief Attitude sample with angular speeds, see enable_attitude_stream().
+     */
+    struct Attitude {
+        uint64_t time_us; /**< @brief Time since vehicle boot in microseconds. */
+        EulerAngle euler_angle; /**< @brief Attitude. */
+        float rollspeed_rad_s; /**< @brief Roll speed in radians/second. */
+        float pitchspeed_rad_s; /**< @brief Pitch speed in radians/second. */
+        float yawspeed_rad_s; /**< @brief Yaw speed in radians/second. */
+    };
+
+    /**
+     * @brief Number of channels in RcChannels.
+     */
+    static constexpr unsigned MAX_RC_CHANNELS = 18;
+
+    /**
+     * @brief All RC channels as received by the vehicle, see enable_rc_channels_stream().
+     */
+    struct RcChannels {
+        uint64_t time_us; /**< @brief Time since vehicle boot in microseconds. */
+        uint8_t num_channels; /**< @brief Number of channels of the receiver, 0 without RC. */
+        uint16_t channels_us[MAX_RC_CHANNELS]; /**< @brief PWM of each channel in microseconds,
+                                                    UINT16_MAX for channels not used. */
+        float signal_strength_percent; /**< @brief Signal strength from 0 to 100, NaN if the
+                                            receiver does not tell. */
+    };
+
     /**
      * @brief Results enum for telemetry requests.
      */
@@ -176,6 +379,29 @@ public:
      */
     typedef std::function<void(Result)> result_callback_t;
 
+    /**
+     * @brief Topics whose rate can be set, see set_rates().
+     */
+    enum class Topic {
+        POSITION, /**< @brief Position, see set_rate_position(). */
+        HOME_POSITION, /**< @brief Home position, see set_rate_home_position(). */
+        IN_AIR, /**< @brief In-air state, see set_rate_in_air(). */
+        ATTITUDE, /**< @brief Attitude, see set_rate_attitude(). */
+        CAMERA_ATTITUDE, /**< @brief Camera attitude, see set_rate_camera_attitude(). */
+        GROUND_SPEED_NED, /**< @brief Ground speed, see set_rate_ground_speed_ned(). */
+        GPS_INFO, /**< @brief GPS information, see set_rate_gps_info(). */
+        BATTERY, /**< @brief Battery, see set_rate_battery(). */
+        RC_STATUS /**< @brief RC status, see set_rate_rc_status(). */
+    };
+
+    /**
+     * @brief Rate for one topic, see set_rates().
+     */
+    struct TopicRate {
+        Topic topic; /**< @brief Topic. */
+        double rate_hz; /**< @brief Rate in Hz. */
+    };
+
     /**
      * @brief Set rate of position updates (synchronous).
      *
@@ -320,6 +546,109 @@ public:
      */
     void set_rate_rc_status_async(double rate_hz, result_callback_t callback);
 
+    /**
+     * @brief Set the rates of several topics at once (synchronous).
+     *
+     * Topics sent in the same message, such as position and ground speed, get
+     * one request with the higher of their rates. All requests are queued at
+     * once, so this is faster than calling the set_rate_* methods one by one.
+     *
+     * @param rates Rates to set.
+     * @return SUCCESS if all requests succeeded, otherwise the first error.
+     */
+    Result set_rates(const std::vector<TopicRate> &rates);
+
+    /**
+     * @brief Set the rates of several topics at once (asynchronous).
+     *
+     * See set_rates().
+     *
+     * @param rates Rates to set.
+     * @param callback Callback called once with the result of all requests.
+     */
+    void set_rates_async(const std::vector<TopicRate> &rates, result_callback_t callback);
+
+    /**
+     * @brief Rate of a topic which is lowered when the radio link is congested.
+     */
+    struct AdaptiveRate {
+        Topic topic; /**< @brief Topic. */
+        double rate_hz; /**< @brief Rate in Hz while the link is clear. */
+        double min_rate_hz; /**< @brief Lowest rate in Hz it is lowered to. */
+    };
+
+    /**
+     * @brief Adapt the rates of some topics to the quality of the radio link (synchronous).
+     *
+     * The rates are first set as given. When RADIO_STATUS then shows the radio's transmit
+     * buffer filling up or receive errors going up, they are lowered step by step, down to
+     * their minimum rates. Once the link is clear again for a while, they are raised back.
+     *
+     * Topics which are not given, e.g. the ones needed for control, are left as they are.
+     * Calling this again replaces the topics adapted before.
+     *
+     * @param rates Topics to adapt, with their rates.
+     * @return Result of setting the rates as given.
+     */
+    Result enable_adaptive_rates(const std::vector<AdaptiveRate> &rates);
+
+    /**
+     * @brief Stop adapting rates and set them as given to enable_adaptive_rates() (synchronous).
+     *
+     * @return Result of setting the rates.
+     */
+    Result disable_adaptive_rates();
+
+    /**
+     * @brief Get how much of the adaptive rates is currently requested.
+     *
+     * @return Scale between 0.1 and 1, 1 while the link is clear.
+     */
+    double adaptive_rate_scale() const;
+
+    /**
+     * @brief Add a named set of rates, e.g. for mapping or inspection, see set_rate_profile().
+     *
+     * Adding one with a name already added replaces it. This only keeps the rates, they are
+     * set once the profile is selected.
+     *
+     * @param name Name of the profile.
+     * @param rates Rates of the profile.
+     */
+    void add_rate_profile(const std::string &name, const std::vector<TopicRate> &rates);
+
+    /**
+     * @brief Select the rate profile to use (synchronous).
+     *
+     * The rates are set at once, as with set_rates(): right away if the vehicle is connected,
+     * otherwise as soon as it is discovered. When it reconnects or its autopilot reboots,
+     * all rates requested are set again in one burst, without another call.
+     *
+     * Topics which are not in the profile are left as they are.
+     *
+     * @param name Name given to add_rate_profile().
+     * @return Result of setting the rates, SUCCESS if they are set later, UNKNOWN if there is
+     *         no profile with this name.
+     */
+    Result set_rate_profile(const std::string &name);
+
+    /**
+     * @brief Get the name of the rate profile selected with set_rate_profile().
+     *
+     * @return Name of the profile, empty if none was selected.
+     */
+    std::string rate_profile() const;
+
+    /**
+     * @brief Get the state of the clock synchronisation with the vehicle (synchronous).
+     *
+     * TIMESYNC is exchanged once a second, to put the times of the vehicle on the clock
+     * of Snapshot, see PositionSample::sample_time_us.
+     *
+     * @return Clock synchronisation state.
+     */
+    TimesyncStatus timesync_status() const;
+
     /**
      * @brief Get the current position (synchronous).
      *
@@ -387,6 +716,25 @@ public:
      */
     GroundSpeedNED ground_speed_ned() const;
 
+    /**
+     * @brief Get the current ground track (synchronous).
+     *
+     * Derived values are only computed once they are asked for, from then on once at every
+     * update of what they are derived from, however many subscribers there are.
+     *
+     * @return Ground track.
+     */
+    GroundTrack ground_track() const;
+
+    /**
+     * @brief Get where home is from the system (synchronous).
+     *
+     * It is computed like ground_track().
+     *
+     * @return Home vector.
+     */
+    HomeVector home_vector() const;
+
     /**
      * @brief Get the current GPS information (synchronous).
      *
@@ -427,6 +775,223 @@ public:
      */
     RCStatus rc_status() const;
 
+    /**
+     * @brief Get all telemetry fields at once (synchronous).
+     *
+     * This is cheaper than calling all getters one by one, and fields which
+     * arrive in the same message are always consistent with each other.
+     *
+     * @return Snapshot of all fields.
+     */
+    Snapshot snapshot() const;
+
+    /**
+     * @brief Keep the last samples of position, attitude and ground speed.
+     *
+     * The storage is allocated once here, so keeping the history does not
+     * allocate while receiving. Existing samples are dropped.
+     *
+     * @param num_samples Number of samples to keep per topic, 0 to turn it off.
+     */
+    void set_history_capacity(size_t num_samples);
+
+    /**
+     * @brief Get the position history, oldest first (synchronous).
+     *
+     * To get the last 10 seconds, use the receive time of a snapshot minus 10e6.
+     *
+     * @param since_us Only samples received at this time or later.
+     * @return Position samples.
+     */
+    std::vector<PositionSample> history_position(uint64_t since_us) const;
+
+    /**
+     * @brief Get the attitude history, oldest first (synchronous).
+     *
+     * @param since_us Only samples received at this time or later.
+     * @return Attitude samples.
+     */
+    std::vector<QuaternionSample> history_attitude_quaternion(uint64_t since_us) const;
+
+    /**
+     * @brief Get the ground speed history, oldest first (synchronous).
+     *
+     * @param since_us Only samples received at this time or later.
+     * @return Ground speed samples.
+     */
+    std::vector<GroundSpeedNEDSample> history_ground_speed_ned(uint64_t since_us) const;
+
+    /**
+     * @brief Receive HIGHRES_IMU into a queue to be drained in batches (synchronous).
+     *
+     * Meant for rates too high to be delivered one callback at a time. The
+     * queue is allocated here and samples arriving while it is full are
+     * dropped and counted, see imu_stream_dropped().
+     *
+     * @param capacity Number of samples the queue can hold, 0 to turn the stream off.
+     * @param rate_hz Rate requested from the vehicle, unchanged if the stream is turned off.
+     * @return Result of request.
+     */
+    Result enable_imu_stream(size_t capacity, double rate_hz);
+
+    /**
+     * @brief Move all queued IMU samples out, oldest first.
+     *
+     * Only one thread at a time may drain a stream.
+     *
+     * @param samples Vector the samples are appended to.
+     * @return Number of samples appended.
+     */
+    size_t drain_imu_stream(std::vector<Imu> &samples);
+
+    /**
+     * @brief Number of IMU samples dropped because the queue was full.
+     *
+     * @return Dropped samples since the stream was first enabled.
+     */
+    uint64_t imu_stream_dropped() const;
+
+    /**
+     * @brief Receive ODOMETRY into a queue to be drained in batches (synchronous).
+     *
+     * See enable_imu_stream().
+     *
+     * @param capacity Number of samples the queue can hold, 0 to turn the stream off.
+     * @param rate_hz Rate requested from the vehicle, unchanged if the stream is turned off.
+     * @return Result of request.
+     */
+    Result enable_odometry_stream(size_t capacity, double rate_hz);
+
+    /**
+     * @brief Move all queued odometry samples out, oldest first.
+     *
+     * Only one thread at a time may drain a stream.
+     *
+     * @param samples Vector the samples are appended to.
+     * @return Number of samples appended.
+     */
+    size_t drain_odometry_stream(std::vector<Odometry> &samples);
+
+    /**
+     * @brief Number of odometry samples dropped because the queue was full.
+     *
+     * @return Dropped samples since the stream was first enabled.
+     */
+    uint64_t odometry_stream_dropped() const;
+
+    /**
+     * @brief Receive ATTITUDE into a queue to be drained in batches (synchronous).
+     *
+     * See enable_imu_stream().
+     *
+     * @param capacity Number of samples the queue can hold, 0 to turn the stream off.
+     * @param rate_hz Rate requested from the vehicle, unchanged if the stream is turned off.
+     * @return Result of request.
+     */
+    Result enable_attitude_stream(size_t capacity, double rate_hz);
+
+    /**
+     * @brief Move all queued attitude samples out, oldest first.
+     *
+     * Only one thread at a time may drain a stream.
+     *
+     * @param samples Vector the samples are appended to.
+     * @return Number of samples appended.
+     */
+    size_t drain_attitude_stream(std::vector<Attitude> &samples);
+
+    /**
+     * @brief Number of attitude samples dropped because the queue was full.
+     *
+     * @return Dropped samples since the stream was first enabled.
+     */
+    uint64_t attitude_stream_dropped() const;
+
+    /**
+     * @brief Receive RC_CHANNELS into a queue to be drained in batches (synchronous).
+     *
+     * Unlike rc_status(), which only tells whether RC is there, this has the value of
+     * every channel. See enable_imu_stream().
+     *
+     * @param capacity Number of samples the queue can hold, 0 to turn the stream off.
+     * @param rate_hz Rate requested from the vehicle, unchanged if the stream is turned off.
+     * @return Result of request.
+     */
+    Result enable_rc_channels_stream(size_t capacity, double rate_hz);
+
+    /**
+     * @brief Move all queued RC channels samples out, oldest first.
+     *
+     * Only one thread at a time may drain a stream.
+     *
+     * @param samples Vector the samples are appended to.
+     * @return Number of samples appended.
+     */
+    size_t drain_rc_channels_stream(std::vector<RcChannels> &samples);
+
+    /**
+     * @brief Number of RC channels samples dropped because the queue was full.
+     *
+     * @return Dropped samples since the stream was first enabled.
+     */
+    uint64_t rc_channels_stream_dropped() const;
+
+    /**
+     * @brief Record position, attitude, ground speed and battery to files.
+     *
+     * Each topic goes to its own file in the directory, `position.dccf`,
+     * `attitude_quaternion.dccf`, `ground_speed_ned.dccf` and `battery.dccf`,
+     * with the receive times of Snapshot. The files are memory-mapped and
+     * hold fixed-width records column by column in blocks, each block starting
+     * with its number of records and time range so that a reader can seek by
+     * time. See core/column_file.h for the exact layout.
+     *
+     * Existing files are overwritten. A running recording is stopped first.
+     *
+     * @param directory Existing directory to record into.
+     * @return true if all files could be created.
+     */
+    bool start_recording(const std::string &directory);
+
+    /**
+     * @brief Stop recording and cut the files to what was recorded.
+     */
+    void stop_recording();
+
+    /**
+     * @brief Handle for a subscription, see unsubscribe().
+     *
+     * Every `*_async` call adds one more subscriber to the topic.
+     */
+    typedef uint64_t subscription_handle_t;
+
+    /**
+     * @brief Options to filter updates for one subscriber, before its callback is called.
+     *
+     * The vehicle keeps sending at the rate set with `set_rate_*`, so subscribers
+     * which need fewer updates can use this instead of slowing down everyone.
+     * `SubscriptionOptions {}` delivers every update.
+     */
+    struct SubscriptionOptions {
+        double max_rate_hz; /**< @brief Maximum delivery rate, 0 for no limit. */
+        /**
+         * @brief Only deliver if the value changed by more than this, 0 to deliver everything.
+         *
+         * The unit depends on the topic: metres for positions and the home vector, degrees
+         * for attitudes, m/s for ground speed and ground track, volts for battery and
+         * percent for RC signal strength.
+         * For all other topics, any value above 0 means only changes are delivered.
+         */
+        double deadband;
+    };
+
+    /**
+     * @brief Remove one subscriber again.
+     *
+     * @param handle Handle returned when subscribing.
+     */
+    void unsubscribe(subscription_handle_t handle);
+
     /**
      * @brief Callback type for position updates.
      */
@@ -435,16 +1000,24 @@ public:
     /**
      * @brief Subscribe to position updates (asynchronous).
      *
-     * @param callback Function to call with updates.
+     * @param callback Function to call with updates, nullptr removes all subscribers.
+     * @param options Rate limit and deadband for this subscriber.
+     * @return Handle to unsubscribe this callback again.
      */
-    void position_async(position_callback_t callback);
+    subscription_handle_t position_async(
+        position_callback_t callback,
+        const SubscriptionOptions &options = SubscriptionOptions {});
 
     /**
      * @brief Subscribe to home position updates (asynchronous).
      *
-     * @param callback Function to call with updates.
+     * @param callback Function to call with updates, nullptr removes all subscribers.
+     * @param options Rate limit and deadband for this subscriber.
+     * @return Handle to unsubscribe this callback again.
      */
-    void home_position_async(position_callback_t callback);
+    subscription_handle_t home_position_async(
+        position_callback_t callback,
+        const SubscriptionOptions &options = SubscriptionOptions {});
 
     /**
      * @brief Callback type for in-air updates.
@@ -456,9 +1029,13 @@ public:
     /**
      * @brief Subscribe to in-air updates (asynchronous).
      *
-     * @param callback Function to call with updates.
+     * @param callback Function to call with updates, nullptr removes all subscribers.
+     * @param options Rate limit and deadband for this subscriber.
+     * @return Handle to unsubscribe this callback again.
      */
-    void in_air_async(in_air_callback_t callback);
+    subscription_handle_t in_air_async(
+        in_air_callback_t callback,
+        const SubscriptionOptions &options = SubscriptionOptions {});
 
     /**
      * @brief Callback type for armed updates (asynchronous).
@@ -472,9 +1049,13 @@ public:
      *
      * Note that armed updates are limited to 1Hz.
      *
-     * @param callback Function to call with updates.
+     * @param callback Function to call with updates, nullptr removes all subscribers.
+     * @param options Rate limit and deadband for this subscriber.
+     * @return Handle to unsubscribe this callback again.
      */
-    void armed_async(armed_callback_t callback);
+    subscription_handle_t armed_async(
+        armed_callback_t callback,
+        const SubscriptionOptions &options = SubscriptionOptions {});
 
     /**
      * @brief Callback type for attitude updates in quaternion.
@@ -486,9 +1067,13 @@ public:
     /**
      * @brief Subscribe to attitude updates in quaternion (asynchronous).
      *
-     * @param callback Function to call with updates.
+     * @param callback Function to call with updates, nullptr removes all subscribers.
+     * @param options Rate limit and deadband for this subscriber.
+     * @return Handle to unsubscribe this callback again.
      */
-    void attitude_quaternion_async(attitude_quaternion_callback_t callback);
+    subscription_handle_t attitude_quaternion_async(
+        attitude_quaternion_callback_t callback,
+        const SubscriptionOptions &options = SubscriptionOptions {});
 
     /**
      * @brief Callback type for attitude updates in Euler angles.
@@ -500,23 +1085,35 @@ public:
     /**
      * @brief Subscribe to attitude updates in Euler angles (asynchronous).
      *
-     * @param callback Function to call with updates.
+     * @param callback Function to call with updates, nullptr removes all subscribers.
+     * @param options Rate limit and deadband for this subscriber.
+     * @return Handle to unsubscribe this callback again.
      */
-    void attitude_euler_angle_async(attitude_euler_angle_callback_t callback);
+    subscription_handle_t attitude_euler_angle_async(
+        attitude_euler_angle_callback_t callback,
+        const SubscriptionOptions &options = SubscriptionOptions {});
 
     /**
      * @brief Subscribe to camera attitude updates in quaternion (asynchronous).
      *
-     * @param callback Function to call with updates.
+     * @param callback Function to call with updates, nullptr removes all subscribers.
+     * @param options Rate limit and deadband for this subscriber.
+     * @return Handle to unsubscribe this callback again.
      */
-    void camera_attitude_quaternion_async(attitude_quaternion_callback_t callback);
+    subscription_handle_t camera_attitude_quaternion_async(
+        attitude_quaternion_callback_t callback,
+        const SubscriptionOptions &options = SubscriptionOptions {});
 
     /**
      * @brief Subscribe to camera attitude updates in Euler angles (asynchronous).
      *
-     * @param callback Function to call with updates.
+     * @param callback Function to call with updates, nullptr removes all subscribers.
+     * @param options Rate limit and deadband for this subscriber.
+     * @return Handle to unsubscribe this callback again.
      */
-    void camera_attitude_euler_angle_async(attitude_euler_angle_callback_t callback);
+    subscription_handle_t camera_attitude_euler_angle_async(
+        attitude_euler_angle_callback_t callback,
+        const SubscriptionOptions &options = SubscriptionOptions {});
 
     /**
      * @brief Callback type for ground speed (NED) updates.
@@ -528,9 +1125,53 @@ public:
     /**
      * @brief Subscribe to ground speed (NED) updates (asynchronous).
      *
-     * @param callback Function to call with updates.
+     * @param callback Function to call with updates, nullptr removes all subscribers.
+     * @param options Rate limit and deadband for this subscriber.
+     * @return Handle to unsubscribe this callback again.
      */
-    void ground_speed_ned_async(ground_speed_ned_callback_t callback);
+    subscription_handle_t ground_speed_ned_async(
+        ground_speed_ned_callback_t callback,
+        const SubscriptionOptions &options = SubscriptionOptions {});
+
+    /**
+     * @brief Callback type for ground track updates.
+     *
+     * @param ground_track Ground track.
+     */
+    typedef std::function<void(GroundTrack ground_track)> ground_track_callback_t;
+
+    /**
+     * @brief Subscribe to ground track updates (asynchronous).
+     *
+     * They come with the ground speed updates, see ground_track().
+     *
+     * @param callback Function to call with updates, nullptr removes all subscribers.
+     * @param options Rate limit and deadband for this subscriber.
+     * @return Handle to unsubscribe this callback again.
+     */
+    subscription_handle_t ground_track_async(
+        ground_track_callback_t callback,
+        const SubscriptionOptions &options = SubscriptionOptions {});
+
+    /**
+     * @brief Callback type for home vector updates.
+     *
+     * @param home_vector Home vector.
+     */
+    typedef std::function<void(HomeVector home_vector)> home_vector_callback_t;
+
+    /**
+     * @brief Subscribe to home vector updates (asynchronous).
+     *
+     * They come with the position and home position updates, see home_vector().
+     *
+     * @param callback Function to call with updates, nullptr removes all subscribers.
+     * @param options Rate limit and deadband for this subscriber.
+     * @return Handle to unsubscribe this callback again.
+     */
+    subscription_handle_t home_vector_async(
+        home_vector_callback_t callback,
+        const SubscriptionOptions &options = SubscriptionOptions {});
 
     /**
      * @brief Callback type for GPS information updates.
@@ -542,9 +1183,13 @@ public:
     /**
      * @brief Subscribe to GPS information updates (asynchronous).
      *
-     * @param callback Function to call with updates.
+     * @param callback Function to call with updates, nullptr removes all subscribers.
+     * @param options Rate limit and deadband for this subscriber.
+     * @return Handle to unsubscribe this callback again.
      */
-    void gps_info_async(gps_info_callback_t callback);
+    subscription_handle_t gps_info_async(
+        gps_info_callback_t callback,
+        const SubscriptionOptions &options = SubscriptionOptions {});
 
     /**
      * @brief Callback type for battery status updates.
@@ -556,9 +1201,13 @@ public:
     /**
      * @brief Subscribe to battery status updates (asynchronous).
      *
-     * @param callback Function to call with updates.
+     * @param callback Function to call with updates, nullptr removes all subscribers.
+     * @param options Rate limit and deadband for this subscriber.
+     * @return Handle to unsubscribe this callback again.
      */
-    void battery_async(battery_callback_t callback);
+    subscription_handle_t battery_async(
+        battery_callback_t callback,
+        const SubscriptionOptions &options = SubscriptionOptions {});
 
     /**
      * @brief Callback type for flight mode updates.
@@ -572,9 +1221,13 @@ public:
      *
      * Note that flight mode updates are limited to 1Hz.
      *
-     * @param callback Function to call with updates.
+     * @param callback Function to call with updates, nullptr removes all subscribers.
+     * @param options Rate limit and deadband for this subscriber.
+     * @return Handle to unsubscribe this callback again.
      */
-    void flight_mode_async(flight_mode_callback_t callback);
+    subscription_handle_t flight_mode_async(
+        flight_mode_callback_t callback,
+        const SubscriptionOptions &options = SubscriptionOptions {});
 
     /**
      * @brief Callback type for health status updates.
@@ -588,9 +1241,13 @@ public:
      *
      * Note that health status updates are limited to 1Hz.
      *
-     * @param callback Function to call with updates.
+     * @param callback Function to call with updates, nullptr removes all subscribers.
+     * @param options Rate limit and deadband for this subscriber.
+     * @return Handle to unsubscribe this callback again.
      */
-    void health_async(health_callback_t callback);
+    subscription_handle_t health_async(
+        health_callback_t callback,
+        const SubscriptionOptions &options = SubscriptionOptions {});
 
     /**
      * @brief Callback type for health status updates.
@@ -604,9 +1261,13 @@ public:
      *
      * Note that overall health status updates are limited to 1Hz.
      *
-     * @param callback Function to call with updates.
+     * @param callback Function to call with updates, nullptr removes all subscribers.
+     * @param options Rate limit and deadband for this subscriber.
+     * @return Handle to unsubscribe this callback again.
      */
-    void health_all_ok_async(health_all_ok_callback_t callback);
+    subscription_handle_t health_all_ok_async(
+        health_all_ok_callback_t callback,
+        const SubscriptionOptions &options = SubscriptionOptions {});
 
     /**
      * @brief Callback type for RC status updates.
@@ -618,9 +1279,89 @@ public:
     /**
      * @brief Subscribe to RC status updates (asynchronous).
      *
-     * @param callback Function to call with updates.
+     * @param callback Function to call with updates, nullptr removes all subscribers.
+     * @param options Rate limit and deadband for this subscriber.
+     * @return Handle to unsubscribe this callback again.
+     */
+    subscription_handle_t rc_status_async(
+        rc_status_callback_t callback,
+        const SubscriptionOptions &options = SubscriptionOptions {});
+
+    /**
+     * @brief Callback type for status texts.
+     *
+     * @param status_text Status text.
+     */
+    typedef std::function<void(StatusText status_text)> status_text_callback_t;
+
+    /**
+     * @brief Subscribe to the status texts of the vehicle (asynchronous).
+     *
+     * Every text is delivered, once all of its parts are in.
+     *
+     * @param callback Function to call with each text, nullptr removes all subscribers.
+     * @return Handle to unsubscribe this callback again.
+     */
+    subscription_handle_t status_text_async(status_text_callback_t callback);
+
+    /**
+     * @brief Get the last status texts of the vehicle (synchronous).
+     *
+     * They are kept from the start, also without a subscriber, but only the last 256 of
+     * them. To get each one once, pass one more than the seq of the last one fetched.
+     *
+     * @param since_seq First seq to get, 0 for all of them.
+     * @return Status texts, oldest first.
+     */
+    std::vector<StatusText> status_texts(uint64_t since_seq = 0) const;
+
+    /**
+     * @brief Callback type for position updates with their times.
+     */
+    typedef std::function<void(PositionSample)> position_sample_callback_t;
+
+    /**
+     * @brief Subscribe to position updates with their times (asynchronous).
+     *
+     * @param callback Function to call with updates, nullptr removes all subscribers.
+     * @param options Rate limit and deadband for this subscriber.
+     * @return Handle to unsubscribe this callback again.
+     */
+    subscription_handle_t position_sample_async(
+        position_sample_callback_t callback,
+        const SubscriptionOptions &options = SubscriptionOptions {});
+
+    /**
+     * @brief Callback type for attitude updates with their times.
+     */
+    typedef std::function<void(QuaternionSample)> attitude_quaternion_sample_callback_t;
+
+    /**
+     * @brief Subscribe to attitude updates with their times (asynchronous).
+     *
+     * @param callback Function to call with updates, nullptr removes all subscribers.
+     * @param options Rate limit and deadband for this subscriber.
+     * @return Handle to unsubscribe this callback again.
+     */
+    subscription_handle_t attitude_quaternion_sample_async(
+        attitude_quaternion_sample_callback_t callback,
+        const SubscriptionOptions &options = SubscriptionOptions {});
+
+    /**
+     * @brief Callback type for ground speed updates with their times.
+     */
+    typedef std::function<void(GroundSpeedNEDSample)> ground_speed_ned_sample_callback_t;
+
+    /**
+     * @brief Subscribe to ground speed updates with their times (asynchronous).
+     *
+     * @param callback Function to call with updates, nullptr removes all subscribers.
+     * @param options Rate limit and deadband for this subscriber.
+     * @return Handle to unsubscribe this callback again.
      */
-    void rc_status_async(rc_status_callback_t callback);
+    subscription_handle_t ground_speed_ned_sample_async(
+        ground_speed_ned_sample_callback_t callback,
+        const SubscriptionOptions &options = SubscriptionOptions {});
 
     // Non-copyable
     /**
@@ -0,0 +1,84 @@
+#include "telemetry.h"
+#include "allocation_counter.h"
+#include "dronecore_impl.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+
+using namespace dronecore;
+
+namespace {
+
+mavlink_message_t global_position_int(uint32_t time_boot_ms)
+{
+    mavlink_message_t message;
+    mavlink_msg_global_position_int_pack(1, MAV_COMP_ID_AUTOPILOT1, &message, time_boot_ms,
+                                         473977420, 85455940, 488000, 10000, 100, -50, 0, 9000);
+    return message;
+}
+
+mavlink_message_t attitude(uint32_t time_boot_ms)
+{
+    mavlink_message_t message;
+    mavlink_msg_attitude_pack(1, MAV_COMP_ID_AUTOPILOT1, &message, time_boot_ms,
+                              0.1f, 0.2f, 0.3f, 0.01f, 0.02f, 0.03f);
+    return message;
+}
+
+} // namespace
+
+// Once the queues have grown, receiving telemetry and calling back with it
+// should not allocate anything, neither on the receive thread nor on the
+// callback thread.
+TEST(TelemetryAllocation, SteadyStateReceptionDoesNotAllocate)
+{
+    DroneCoreImpl dc;
+
+    mavlink_message_t heartbeat;
+    mavlink_msg_heartbeat_pack(1, MAV_COMP_ID_AUTOPILOT1, &heartbeat, MAV_TYPE_QUADROTOR,
+                               MAV_AUTOPILOT_PX4, 0, 0, MAV_STATE_ACTIVE);
+    dc.receive_message(heartbeat);
+
+    Telemetry telemetry(dc.get_system());
+
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::atomic<unsigned> num_called {0};
+    telemetry.position_async([&num_called, released](Telemetry::Position position) {
+        // Stuck at first, so that the queue fills up once.
+        released.wait();
+        AllocationCounter::count_this_thread();
+        if (position.relative_altitude_m > 0.0f) {
+            ++num_called;
+        }
+    });
+
+    uint32_t time_boot_ms = 0;
+    for (size_t i = 0; i < 2 * CallbackExecutor::DROP_OLDEST_QUEUE_LEN; ++i) {
+        dc.receive_message(global_position_int(++time_boot_ms));
+        dc.receive_message(attitude(time_boot_ms));
+    }
+    release.set_value();
+    while (num_called == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    // Whatever is still queued from before gets through first.
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    AllocationCounter::reset();
+    AllocationCounter::count_this_thread();
+    for (unsigned i = 0; i < 200; ++i) {
+        const unsigned num_before = num_called;
+        dc.receive_message(global_position_int(++time_boot_ms));
+        dc.receive_message(attitude(time_boot_ms));
+        // One at a time, so that none is dropped.
+        while (num_called == num_before) {
+            std::this_thread::yield();
+        }
+    }
+    AllocationCounter::stop_counting_this_thread();
+
+    EXPECT_EQ(AllocationCounter::num_allocations(), 0u);
+}
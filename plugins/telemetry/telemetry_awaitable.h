@@ -0,0 +1,140 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "awaitable.h"
+#include "telemetry.h"
+
+namespace dronecore {
+
+/**
+ * @brief Awaitable variants of the `*_async` calls of Telemetry (C++20).
+ *
+ * The subscriptions give the next update, or wait for a state, e.g.
+ * `co_await telemetry.until_in_air(true);`. Each await subscribes, and
+ * unsubscribes again when resuming.
+ */
+class AwaitableTelemetry
+{
+public:
+    /**
+     * @brief Constructor.
+     *
+     * @param telemetry Telemetry plugin, which needs to outlive this.
+     * @param executor Executor to resume on, e.g. RunLoop::executor().
+     */
+    AwaitableTelemetry(Telemetry &telemetry, executor_t executor) :
+        _telemetry(telemetry),
+        _executor(std::move(executor)) {}
+
+    /** @brief See Telemetry::set_rates_async(). */
+    CallbackAwaitable<Telemetry::Result> set_rates(std::vector<Telemetry::TopicRate> rates)
+    {
+        return {_executor, [this, rates](Telemetry::result_callback_t callback) {
+            _telemetry.set_rates_async(rates, callback);
+        }};
+    }
+
+    /** @brief Next update of Telemetry::position_async(). */
+    SubscriptionAwaitable<Telemetry::Position> position()
+    {
+        return next<Telemetry::Position>(&Telemetry::position_async);
+    }
+
+    /** @brief First position for which predicate is true. */
+    SubscriptionAwaitable<Telemetry::Position>
+    until_position(SubscriptionAwaitable<Telemetry::Position>::predicate_t predicate)
+    {
+        return next<Telemetry::Position>(&Telemetry::position_async, predicate);
+    }
+
+    /** @brief Next update of Telemetry::home_position_async(). */
+    SubscriptionAwaitable<Telemetry::Position> home_position()
+    {
+        return next<Telemetry::Position>(&Telemetry::home_position_async);
+    }
+
+    /** @brief Next update of Telemetry::in_air_async(). */
+    SubscriptionAwaitable<bool> in_air()
+    {
+        return next<bool>(&Telemetry::in_air_async);
+    }
+
+    /** @brief Waits until the vehicle is in the air, or on the ground. */
+    SubscriptionAwaitable<bool> until_in_air(bool in_air)
+    {
+        return next<bool>(&Telemetry::in_air_async, [in_air](const bool &value) {
+            return value == in_air;
+        });
+    }
+
+    /** @brief Next update of Telemetry::armed_async(). */
+    SubscriptionAwaitable<bool> armed()
+    {
+        return next<bool>(&Telemetry::armed_async);
+    }
+
+    /** @brief Waits until the vehicle is armed, or disarmed. */
+    SubscriptionAwaitable<bool> until_armed(bool armed)
+    {
+        return next<bool>(&Telemetry::armed_async, [armed](const bool &value) {
+            return value == armed;
+        });
+    }
+
+    /** @brief Next update of Telemetry::health_async(). */
+    SubscriptionAwaitable<Telemetry::Health> health()
+    {
+        return next<Telemetry::Health>(&Telemetry::health_async);
+    }
+
+    /** @brief Waits until all health checks are ok, see Telemetry::health_all_ok_async(). */
+    SubscriptionAwaitable<bool> until_health_all_ok()
+    {
+        return next<bool>(&Telemetry::health_all_ok_async, [](const bool &value) {
+            return value;
+        });
+    }
+
+    /** @brief Next update of Telemetry::battery_async(). */
+    SubscriptionAwaitable<Telemetry::Battery> battery()
+    {
+        return next<Telemetry::Battery>(&Telemetry::battery_async);
+    }
+
+    /** @brief Next update of Telemetry::gps_info_async(). */
+    SubscriptionAwaitable<Telemetry::GPSInfo> gps_info()
+    {
+        return next<Telemetry::GPSInfo>(&Telemetry::gps_info_async);
+    }
+
+    /** @brief Next update of Telemetry::flight_mode_async(). */
+    SubscriptionAwaitable<Telemetry::FlightMode> flight_mode()
+    {
+        return next<Telemetry::FlightMode>(&Telemetry::flight_mode_async);
+    }
+
+private:
+    template <typename T>
+    using subscribe_t = Telemetry::subscription_handle_t (Telemetry::*)(
+                            std::function<void(T)>, const Telemetry::SubscriptionOptions &);
+
+    template <typename T>
+    SubscriptionAwaitable<T> next(subscribe_t<T> subscribe,
+                                  typename SubscriptionAwaitable<T>::predicate_t predicate =
+                                      nullptr)
+    {
+        return {_executor,
+        [this, subscribe](typename SubscriptionAwaitable<T>::callback_t callback) {
+            return (_telemetry.*subscribe)(callback, Telemetry::SubscriptionOptions {0.0, 0.0});
+        }, [this](uint64_t subscription) {
+            _telemetry.unsubscribe(subscription);
+        }, predicate};
+    }
+
+    Telemetry &_telemetry;
+    executor_t _executor;
+};
+
+} // namespace dronecore
@@ -1,55 +1,52 @@
 #include "telemetry_impl.h"
 #include "system.h"
+#include "completion.h"
 #include "math_conversions.h"
 #include "global_include.h"
 #include "px4_custom_mode.h"
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <functional>
+#include <map>
 
 namespace dronecore {
 
 TelemetryImpl::TelemetryImpl(System &system) :
     PluginImplBase(system),
-    _position_mutex(),
     _position(Telemetry::Position {double(NAN), double(NAN), NAN, NAN}),
-    _home_position_mutex(),
     _home_position(Telemetry::Position {double(NAN), double(NAN), NAN, NAN}),
     _in_air(false),
     _armed(false),
-    _attitude_quaternion_mutex(),
     _attitude_quaternion(Telemetry::Quaternion {NAN, NAN, NAN, NAN}),
-    _camera_attitude_euler_angle_mutex(),
     _camera_attitude_euler_angle(Telemetry::EulerAngle {NAN, NAN, NAN}),
-    _ground_speed_ned_mutex(),
     _ground_speed_ned(Telemetry::GroundSpeedNED {NAN, NAN, NAN}),
-    _gps_info_mutex(),
+    _ground_track(Telemetry::GroundTrack {NAN, NAN, NAN}),
+    _home_vector(Telemetry::HomeVector {NAN, NAN}),
     _gps_info(Telemetry::GPSInfo {0, 0}),
-    _battery_mutex(),
     _battery(Telemetry::Battery {NAN, NAN}),
-    _flight_mode_mutex(),
     _flight_mode(Telemetry::FlightMode::UNKNOWN),
-    _health_mutex(),
     _health(Telemetry::Health {false, false, false, false, false, false, false}),
-    _rc_status_mutex(),
     _rc_status(Telemetry::RCStatus {false, false, 0.0f}),
-    _position_subscription(nullptr),
-    _home_position_subscription(nullptr),
-    _in_air_subscription(nullptr),
-    _armed_subscription(nullptr),
-    _attitude_quaternion_subscription(nullptr),
-    _attitude_euler_angle_subscription(nullptr),
-    _camera_attitude_quaternion_subscription(nullptr),
-    _camera_attitude_euler_angle_subscription(nullptr),
-    _ground_speed_ned_subscription(nullptr),
-    _gps_info_subscription(nullptr),
-    _battery_subscription(nullptr),
-    _flight_mode_subscription(nullptr),
-    _health_subscription(nullptr),
-    _health_all_ok_subscription(nullptr),
-    _rc_status_subscription(nullptr),
+    _snapshot(),
     _ground_speed_ned_rate_hz(0.0),
     _position_rate_hz(-1.0)
 {
+    // Start with the same defaults as the fields, only the times are 0.
+    Telemetry::Snapshot snapshot {};
+    snapshot.position = _position.load();
+    snapshot.home_position = _home_position.load();
+    snapshot.attitude_quaternion = _attitude_quaternion.load();
+    snapshot.camera_attitude_euler_angle = _camera_attitude_euler_angle.load();
+    snapshot.ground_speed_ned = _ground_speed_ned.load();
+    snapshot.gps_info = _gps_info.load();
+    snapshot.battery = _battery.load();
+    snapshot.flight_mode = _flight_mode.load();
+    snapshot.health = _health.load();
+    snapshot.rc_status = _rc_status.load();
+    _snapshot.store(snapshot);
+
+    allow_enable_on_first_use();
     _parent->register_plugin(this);
 }
 
@@ -82,30 +79,51 @@ void TelemetryImpl::init()
         MAVLINK_MSG_ID_GPS_RAW_INT,
         std::bind(&TelemetryImpl::process_gps_raw_int, this, _1), this);
 
-    _parent->register_mavlink_message_handler(
-        MAVLINK_MSG_ID_EXTENDED_SYS_STATE,
+    _parent->register_mavlink_message_handler<mavlink_extended_sys_state_t>(
         std::bind(&TelemetryImpl::process_extended_sys_state, this, _1), this);
 
     _parent->register_mavlink_message_handler(
         MAVLINK_MSG_ID_SYS_STATUS,
         std::bind(&TelemetryImpl::process_sys_status, this, _1), this);
 
-    _parent->register_mavlink_message_handler(
+    _parent->register_mavlink_message_view_handler(
         MAVLINK_MSG_ID_HEARTBEAT,
         std::bind(&TelemetryImpl::process_heartbeat, this, _1), this);
 
     _parent->register_mavlink_message_handler(
         MAVLINK_MSG_ID_RC_CHANNELS,
         std::bind(&TelemetryImpl::process_rc_channels, this, _1), this);
+
+    _parent->register_mavlink_message_handler(
+        MAVLINK_MSG_ID_HIGHRES_IMU,
+        std::bind(&TelemetryImpl::process_highres_imu, this, _1), this);
+
+    _parent->register_mavlink_message_handler(
+        MAVLINK_MSG_ID_ODOMETRY,
+        std::bind(&TelemetryImpl::process_odometry, this, _1), this);
+
+    _parent->register_mavlink_message_handler(
+        MAVLINK_MSG_ID_ATTITUDE,
+        std::bind(&TelemetryImpl::process_attitude, this, _1), this);
+
+    _parent->register_mavlink_message_handler(
+        MAVLINK_MSG_ID_RADIO_STATUS,
+        std::bind(&TelemetryImpl::process_radio_status, this, _1), this);
+
+    _parent->register_status_text_callback(
+        std::bind(&TelemetryImpl::receive_status_text, this, _1), this);
 }
 
 void TelemetryImpl::deinit()
 {
     _parent->unregister_all_mavlink_message_handlers(this);
+    _parent->unregister_status_text_callback(this);
 }
 
 void TelemetryImpl::enable()
 {
+    // Requested as soon as the vehicle is there, in one go with what is set again.
+    apply_rate_profile();
 
     _parent->register_timeout_handler(
         std::bind(&TelemetryImpl::receive_rc_channels_timeout, this), 1.0, &_timeout_cookie);
@@ -113,34 +131,21 @@ void TelemetryImpl::enable()
     // FIXME: The calibration check should eventually be better than this.
     //        For now, we just do the same as QGC does.
 
-    _parent->get_param_int_async(std::string("CAL_GYRO0_ID"),
-                                 std::bind(&TelemetryImpl::receive_param_cal_gyro,
-                                           this,
-                                           std::placeholders::_1,
-                                           std::placeholders::_2));
-
-    _parent->get_param_int_async(std::string("CAL_ACC0_ID"),
-                                 std::bind(&TelemetryImpl::receive_param_cal_accel,
-                                           this,
-                                           std::placeholders::_1,
-                                           std::placeholders::_2));
-
-    _parent->get_param_int_async(std::string("CAL_MAG0_ID"),
-                                 std::bind(&TelemetryImpl::receive_param_cal_mag,
-                                           this,
-                                           std::placeholders::_1,
-                                           std::placeholders::_2));
-
+    // All at once and ahead of other params, so that the health is known right
+    // away, and from the cache if it is still valid from the last connection.
+    std::vector<std::string> names {"CAL_GYRO0_ID", "CAL_ACC0_ID", "CAL_MAG0_ID"};
 #ifdef LEVEL_CALIBRATION
-    _parent->get_param_float_async(std::string("SENS_BOARD_X_OFF"),
-                                   std::bind(&TelemetryImpl::receive_param_cal_level,
-                                             this,
-                                             std::placeholders::_1,
-                                             std::placeholders::_2));
+    names.push_back("SENS_BOARD_X_OFF");
 #else
     // If not available, just hardcode it to true.
     set_health_level_calibration(true);
 #endif
+
+    _parent->get_params_async(names,
+                              std::bind(&TelemetryImpl::receive_calibration_params,
+                                        this,
+                                        std::placeholders::_1,
+                                        std::placeholders::_2));
 }
 
 void TelemetryImpl::disable()
@@ -148,37 +153,48 @@ void TelemetryImpl::disable()
     _parent->unregister_timeout_handler(_timeout_cookie);
 }
 
+void TelemetryImpl::add_resource_usage(DroneCore::ResourceUsage &usage)
+{
+    usage.history_bytes += _position_history.bytes() + _attitude_quaternion_history.bytes() +
+                           _ground_speed_ned_history.bytes();
+}
+
 Telemetry::Result TelemetryImpl::set_rate_position(double rate_hz)
 {
     _position_rate_hz = rate_hz;
     double max_rate_hz = std::max(_position_rate_hz, _ground_speed_ned_rate_hz);
 
     return telemetry_result_from_command_result(
-               _parent->set_msg_rate(MAVLINK_MSG_ID_GLOBAL_POSITION_INT, max_rate_hz));
+               _parent->set_msg_rate(MAVLINK_MSG_ID_GLOBAL_POSITION_INT, max_rate_hz,
+                                     MAV_COMP_ID_AUTOPILOT1, this));
 }
 
 Telemetry::Result TelemetryImpl::set_rate_home_position(double rate_hz)
 {
     return telemetry_result_from_command_result(
-               _parent->set_msg_rate(MAVLINK_MSG_ID_HOME_POSITION, rate_hz));
+               _parent->set_msg_rate(MAVLINK_MSG_ID_HOME_POSITION, rate_hz, MAV_COMP_ID_AUTOPILOT1,
+                                     this));
 }
 
 Telemetry::Result TelemetryImpl::set_rate_in_air(double rate_hz)
 {
     return telemetry_result_from_command_result(
-               _parent->set_msg_rate(MAVLINK_MSG_ID_EXTENDED_SYS_STATE, rate_hz));
+               _parent->set_msg_rate(MAVLINK_MSG_ID_EXTENDED_SYS_STATE, rate_hz,
+                                     MAV_COMP_ID_AUTOPILOT1, this));
 }
 
 Telemetry::Result TelemetryImpl::set_rate_attitude(double rate_hz)
 {
     return telemetry_result_from_command_result(
-               _parent->set_msg_rate(MAVLINK_MSG_ID_ATTITUDE_QUATERNION, rate_hz));
+               _parent->set_msg_rate(MAVLINK_MSG_ID_ATTITUDE_QUATERNION, rate_hz,
+                                     MAV_COMP_ID_AUTOPILOT1, this));
 }
 
 Telemetry::Result TelemetryImpl::set_rate_camera_attitude(double rate_hz)
 {
     return telemetry_result_from_command_result(
-               _parent->set_msg_rate(MAVLINK_MSG_ID_MOUNT_ORIENTATION, rate_hz));
+               _parent->set_msg_rate(MAVLINK_MSG_ID_MOUNT_ORIENTATION, rate_hz,
+                                     MAV_COMP_ID_AUTOPILOT1, this));
 }
 
 Telemetry::Result TelemetryImpl::set_rate_ground_speed_ned(double rate_hz)
@@ -187,25 +203,29 @@ Telemetry::Result TelemetryImpl::set_rate_ground_speed_ned(double rate_hz)
     double max_rate_hz = std::max(_position_rate_hz, _ground_speed_ned_rate_hz);
 
     return telemetry_result_from_command_result(
-               _parent->set_msg_rate(MAVLINK_MSG_ID_GLOBAL_POSITION_INT, max_rate_hz));
+               _parent->set_msg_rate(MAVLINK_MSG_ID_GLOBAL_POSITION_INT, max_rate_hz,
+                                     MAV_COMP_ID_AUTOPILOT1, this));
 }
 
 Telemetry::Result TelemetryImpl::set_rate_gps_info(double rate_hz)
 {
     return telemetry_result_from_command_result(
-               _parent->set_msg_rate(MAVLINK_MSG_ID_GPS_RAW_INT, rate_hz));
+               _parent->set_msg_rate(MAVLINK_MSG_ID_GPS_RAW_INT, rate_hz, MAV_COMP_ID_AUTOPILOT1,
+                                     this));
 }
 
 Telemetry::Result TelemetryImpl::set_rate_battery(double rate_hz)
 {
     return telemetry_result_from_command_result(
-               _parent->set_msg_rate(MAVLINK_MSG_ID_SYS_STATUS, rate_hz));
+               _parent->set_msg_rate(MAVLINK_MSG_ID_SYS_STATUS, rate_hz, MAV_COMP_ID_AUTOPILOT1,
+                                     this));
 }
 
 Telemetry::Result TelemetryImpl::set_rate_rc_status(double rate_hz)
 {
     return telemetry_result_from_command_result(
-               _parent->set_msg_rate(MAVLINK_MSG_ID_RC_CHANNELS, rate_hz));
+               _parent->set_msg_rate(MAVLINK_MSG_ID_RC_CHANNELS, rate_hz, MAV_COMP_ID_AUTOPILOT1,
+                                     this));
 }
 
 void TelemetryImpl::set_rate_position_async(double rate_hz, Telemetry::result_callback_t callback)
@@ -216,7 +236,8 @@ void TelemetryImpl::set_rate_position_async(double rate_hz, Telemetry::result_ca
     _parent->set_msg_rate_async(
         MAVLINK_MSG_ID_GLOBAL_POSITION_INT,
         max_rate_hz,
-        std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback));
+        std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback),
+        MAV_COMP_ID_AUTOPILOT1, this);
 
 }
 
@@ -226,7 +247,8 @@ void TelemetryImpl::set_rate_home_position_async(double rate_hz,
     _parent->set_msg_rate_async(
         MAVLINK_MSG_ID_HOME_POSITION,
         rate_hz,
-        std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback));
+        std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback),
+        MAV_COMP_ID_AUTOPILOT1, this);
 }
 
 void TelemetryImpl::set_rate_in_air_async(double rate_hz, Telemetry::result_callback_t callback)
@@ -234,7 +256,8 @@ void TelemetryImpl::set_rate_in_air_async(double rate_hz, Telemetry::result_call
     _parent->set_msg_rate_async(
         MAVLINK_MSG_ID_EXTENDED_SYS_STATE,
         rate_hz,
-        std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback));
+        std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback),
+        MAV_COMP_ID_AUTOPILOT1, this);
 }
 
 void TelemetryImpl::set_rate_attitude_async(double rate_hz, Telemetry::result_callback_t callback)
@@ -242,7 +265,8 @@ void TelemetryImpl::set_rate_attitude_async(double rate_hz, Telemetry::result_ca
     _parent->set_msg_rate_async(
         MAVLINK_MSG_ID_ATTITUDE_QUATERNION,
         rate_hz,
-        std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback));
+        std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback),
+        MAV_COMP_ID_AUTOPILOT1, this);
 }
 
 void TelemetryImpl::set_rate_camera_attitude_async(double rate_hz,
@@ -251,7 +275,8 @@ void TelemetryImpl::set_rate_camera_attitude_async(double rate_hz,
     _parent->set_msg_rate_async(
         MAVLINK_MSG_ID_MOUNT_ORIENTATION,
         rate_hz,
-        std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback));
+        std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback),
+        MAV_COMP_ID_AUTOPILOT1, this);
 }
 
 void TelemetryImpl::set_rate_ground_speed_ned_async(double rate_hz,
@@ -263,7 +288,8 @@ void TelemetryImpl::set_rate_ground_speed_ned_async(double rate_hz,
     _parent->set_msg_rate_async(
         MAVLINK_MSG_ID_GLOBAL_POSITION_INT,
         max_rate_hz,
-        std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback));
+        std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback),
+        MAV_COMP_ID_AUTOPILOT1, this);
 }
 
 void TelemetryImpl::set_rate_gps_info_async(double rate_hz, Telemetry::result_callback_t callback)
@@ -271,7 +297,8 @@ void TelemetryImpl::set_rate_gps_info_async(double rate_hz, Telemetry::result_ca
     _parent->set_msg_rate_async(
         MAVLINK_MSG_ID_GPS_RAW_INT,
         rate_hz,
-        std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback));
+        std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback),
+        MAV_COMP_ID_AUTOPILOT1, this);
 }
 
 void TelemetryImpl::set_rate_battery_async(double rate_hz, Telemetry::result_callback_t callback)
@@ -279,7 +306,8 @@ void TelemetryImpl::set_rate_battery_async(double rate_hz, Telemetry::result_cal
     _parent->set_msg_rate_async(
         MAVLINK_MSG_ID_SYS_STATUS,
         rate_hz,
-        std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback));
+        std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback),
+        MAV_COMP_ID_AUTOPILOT1, this);
 }
 
 void TelemetryImpl::set_rate_rc_status_async(double rate_hz, Telemetry::result_callback_t callback)
@@ -287,7 +315,215 @@ void TelemetryImpl::set_rate_rc_status_async(double rate_hz, Telemetry::result_c
     _parent->set_msg_rate_async(
         MAVLINK_MSG_ID_RC_CHANNELS,
         rate_hz,
-        std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback));
+        std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback),
+        MAV_COMP_ID_AUTOPILOT1, this);
+}
+
+Telemetry::Result TelemetryImpl::set_rates(const std::vector<Telemetry::TopicRate> &rates)
+{
+    // We wrap the async call with a completion to wait for.
+    Completion<Telemetry::Result> completion;
+
+    set_rates_async(rates, [&completion](Telemetry::Result result) {
+        completion.complete(result);
+    });
+
+    return completion.wait();
+}
+
+void TelemetryImpl::set_rates_async(const std::vector<Telemetry::TopicRate> &rates,
+                                    Telemetry::result_callback_t callback)
+{
+    // One request per message, with the fastest rate of the topics in it.
+    std::map<uint16_t, double> rate_hz_by_message_id;
+    for (const auto &topic_rate : rates) {
+        if (topic_rate.topic == Telemetry::Topic::POSITION) {
+            _position_rate_hz = topic_rate.rate_hz;
+        } else if (topic_rate.topic == Telemetry::Topic::GROUND_SPEED_NED) {
+            _ground_speed_ned_rate_hz = topic_rate.rate_hz;
+        }
+
+        const uint16_t message_id = message_id_of_topic(topic_rate.topic);
+        auto it = rate_hz_by_message_id.find(message_id);
+        if (it == rate_hz_by_message_id.end()) {
+            rate_hz_by_message_id[message_id] = topic_rate.rate_hz;
+        } else {
+            it->second = std::max(it->second, topic_rate.rate_hz);
+        }
+    }
+
+    auto it = rate_hz_by_message_id.find(MAVLINK_MSG_ID_GLOBAL_POSITION_INT);
+    if (it != rate_hz_by_message_id.end()) {
+        // Also one of the two topics may have been set before.
+        it->second = std::max(_position_rate_hz, _ground_speed_ned_rate_hz);
+    }
+
+    if (rate_hz_by_message_id.empty()) {
+        if (callback) {
+            callback(Telemetry::Result::SUCCESS);
+        }
+        return;
+    }
+
+    // The requests are all queued right away, the commands queue sends the
+    // next one as soon as an ack is in. The callback is called once the
+    // last one is done.
+    struct Pending {
+        std::mutex mutex;
+        size_t remaining;
+        Telemetry::Result result;
+    };
+    auto pending = std::make_shared<Pending>();
+    pending->remaining = rate_hz_by_message_id.size();
+    pending->result = Telemetry::Result::SUCCESS;
+
+    for (const auto &message_rate : rate_hz_by_message_id) {
+        _parent->set_msg_rate_async(
+            message_rate.first,
+            message_rate.second,
+        [pending, callback](MAVLinkCommands::Result command_result, float progress) {
+            UNUSED(progress);
+            const Telemetry::Result result = telemetry_result_from_command_result(command_result);
+
+            bool done;
+            Telemetry::Result aggregate;
+            {
+                std::lock_guard<std::mutex> lock(pending->mutex);
+                if (result != Telemetry::Result::SUCCESS
+                    && pending->result == Telemetry::Result::SUCCESS) {
+                    pending->result = result;
+                }
+                done = (--pending->remaining == 0);
+                aggregate = pending->result;
+            }
+
+            if (done && callback) {
+                callback(aggregate);
+            }
+        },
+        MAV_COMP_ID_AUTOPILOT1, this);
+    }
+}
+
+Telemetry::Result
+TelemetryImpl::enable_adaptive_rates(const std::vector<Telemetry::AdaptiveRate> &rates)
+{
+    {
+        std::lock_guard<instrumented_mutex_t> lock(_adaptive_rates_mutex);
+        _adaptive_rates = rates;
+        _rate_adapter.reset();
+    }
+    return set_rates(scaled_rates(rates, 1.0));
+}
+
+Telemetry::Result TelemetryImpl::disable_adaptive_rates()
+{
+    std::vector<Telemetry::AdaptiveRate> rates;
+    {
+        std::lock_guard<instrumented_mutex_t> lock(_adaptive_rates_mutex);
+        rates.swap(_adaptive_rates);
+        _rate_adapter.reset();
+    }
+    return set_rates(scaled_rates(rates, 1.0));
+}
+
+double TelemetryImpl::adaptive_rate_scale() const
+{
+    std::lock_guard<instrumented_mutex_t> lock(_adaptive_rates_mutex);
+    return _rate_adapter.scale();
+}
+
+void TelemetryImpl::add_rate_profile(const std::string &name,
+                                     const std::vector<Telemetry::TopicRate> &rates)
+{
+    std::lock_guard<instrumented_mutex_t> lock(_rate_profiles_mutex);
+    _rate_profiles[name] = rates;
+}
+
+Telemetry::Result TelemetryImpl::set_rate_profile(const std::string &name)
+{
+    std::vector<Telemetry::TopicRate> rates;
+    {
+        std::lock_guard<instrumented_mutex_t> lock(_rate_profiles_mutex);
+        auto it = _rate_profiles.find(name);
+        if (it == _rate_profiles.end()) {
+            LogErr() << "No rate profile " << name;
+            return Telemetry::Result::UNKNOWN;
+        }
+        _rate_profile = name;
+        rates = it->second;
+    }
+
+    if (!_parent->is_connected()) {
+        // enable() sets them.
+        return Telemetry::Result::SUCCESS;
+    }
+    return set_rates(rates);
+}
+
+std::string TelemetryImpl::rate_profile() const
+{
+    std::lock_guard<instrumented_mutex_t> lock(_rate_profiles_mutex);
+    return _rate_profile;
+}
+
+void TelemetryImpl::apply_rate_profile()
+{
+    std::vector<Telemetry::TopicRate> rates;
+    std::string name;
+    {
+        std::lock_guard<instrumented_mutex_t> lock(_rate_profiles_mutex);
+        auto it = _rate_profiles.find(_rate_profile);
+        if (it == _rate_profiles.end()) {
+            return;
+        }
+        name = _rate_profile;
+        rates = it->second;
+    }
+
+    // Not waited for, this is called while connecting.
+    set_rates_async(rates, [name](Telemetry::Result result) {
+        if (result != Telemetry::Result::SUCCESS) {
+            LogWarn() << "Could not set rate profile " << name << ": "
+                      << Telemetry::result_str(result);
+        }
+    });
+}
+
+std::vector<Telemetry::TopicRate>
+TelemetryImpl::scaled_rates(const std::vector<Telemetry::AdaptiveRate> &rates, double scale)
+{
+    std::vector<Telemetry::TopicRate> topic_rates;
+    for (const auto &rate : rates) {
+        topic_rates.push_back(Telemetry::TopicRate {
+            rate.topic, std::max(rate.rate_hz * scale, std::min(rate.min_rate_hz, rate.rate_hz))
+        });
+    }
+    return topic_rates;
+}
+
+uint16_t TelemetryImpl::message_id_of_topic(Telemetry::Topic topic)
+{
+    switch (topic) {
+        case Telemetry::Topic::POSITION:
+        case Telemetry::Topic::GROUND_SPEED_NED:
+            return MAVLINK_MSG_ID_GLOBAL_POSITION_INT;
+        case Telemetry::Topic::HOME_POSITION:
+            return MAVLINK_MSG_ID_HOME_POSITION;
+        case Telemetry::Topic::IN_AIR:
+            return MAVLINK_MSG_ID_EXTENDED_SYS_STATE;
+        case Telemetry::Topic::ATTITUDE:
+            return MAVLINK_MSG_ID_ATTITUDE_QUATERNION;
+        case Telemetry::Topic::CAMERA_ATTITUDE:
+            return MAVLINK_MSG_ID_MOUNT_ORIENTATION;
+        case Telemetry::Topic::GPS_INFO:
+            return MAVLINK_MSG_ID_GPS_RAW_INT;
+        case Telemetry::Topic::BATTERY:
+            return MAVLINK_MSG_ID_SYS_STATUS;
+        case Telemetry::Topic::RC_STATUS:
+        default:
+            return MAVLINK_MSG_ID_RC_CHANNELS;
+    }
 }
 
 Telemetry::Result TelemetryImpl::telemetry_result_from_command_result(
@@ -319,26 +555,44 @@ void TelemetryImpl::command_result_callback(MAVLinkCommands::Result command_resu
     callback(action_result);
 }
 
+template<typename T>
+void TelemetryImpl::notify(const CallbackList<T> &subscriptions, const T &value)
+{
+    _parent->call_user_callback(this, &subscriptions, [&subscriptions, value]() {
+        subscriptions(value);
+    });
+}
+
 void TelemetryImpl::process_global_position_int(const mavlink_message_t &message)
 {
     mavlink_global_position_int_t global_position_int;
     mavlink_msg_global_position_int_decode(&message, &global_position_int);
-    set_position(Telemetry::Position({global_position_int.lat * 1e-7,
-                                      global_position_int.lon * 1e-7,
-                                      global_position_int.alt * 1e-3f,
-                                      global_position_int.relative_alt * 1e-3f
-                                     }));
-    set_ground_speed_ned({global_position_int.vx * 1e-2f,
-                          global_position_int.vy * 1e-2f,
-                          global_position_int.vz * 1e-2f
-                         });
 
-    if (_position_subscription) {
-        _position_subscription(get_position());
+    const Telemetry::Position position {
+        global_position_int.lat * 1e-7,
+        global_position_int.lon * 1e-7,
+        global_position_int.alt * 1e-3f,
+        global_position_int.relative_alt * 1e-3f
+    };
+    const Telemetry::GroundSpeedNED ground_speed_ned {
+        global_position_int.vx * 1e-2f,
+        global_position_int.vy * 1e-2f,
+        global_position_int.vz * 1e-2f
+    };
+    set_position_velocity_ned(position, ground_speed_ned,
+                              uint64_t(global_position_int.time_boot_ms) * 1000);
+
+    if (!_position_subscriptions.empty()) {
+        notify(_position_subscriptions, position);
     }
 
-    if (_ground_speed_ned_subscription) {
-        _ground_speed_ned_subscription(get_ground_speed_ned());
+    if (!_ground_speed_ned_subscriptions.empty()) {
+        notify(_ground_speed_ned_subscriptions, ground_speed_ned);
+    }
+
+    if (_derived_wanted) {
+        update_ground_track(ground_speed_ned);
+        update_home_vector(position, get_home_position());
     }
 }
 
@@ -355,8 +609,12 @@ void TelemetryImpl::process_home_position(const mavlink_message_t &message)
 
     set_health_home_position(true);
 
-    if (_home_position_subscription) {
-        _home_position_subscription(get_home_position());
+    if (!_home_position_subscriptions.empty()) {
+        notify(_home_position_subscriptions, get_home_position());
+    }
+
+    if (_derived_wanted) {
+        update_home_vector(get_position(), get_home_position());
     }
 }
 
@@ -372,14 +630,14 @@ void TelemetryImpl::process_attitude_quaternion(const mavlink_message_t &message
         attitude_quaternion.q4
     };
 
-    set_attitude_quaternion(quaternion);
+    set_attitude_quaternion(quaternion, uint64_t(attitude_quaternion.time_boot_ms) * 1000);
 
-    if (_attitude_quaternion_subscription) {
-        _attitude_quaternion_subscription(get_attitude_quaternion());
+    if (!_attitude_quaternion_subscriptions.empty()) {
+        notify(_attitude_quaternion_subscriptions, get_attitude_quaternion());
     }
 
-    if (_attitude_euler_angle_subscription) {
-        _attitude_euler_angle_subscription(get_attitude_euler_angle());
+    if (!_attitude_euler_angle_subscriptions.empty()) {
+        notify(_attitude_euler_angle_subscriptions, get_attitude_euler_angle());
     }
 }
 
@@ -396,12 +654,12 @@ void TelemetryImpl::process_mount_orientation(const mavlink_message_t &message)
 
     set_camera_attitude_euler_angle(euler_angle);
 
-    if (_camera_attitude_quaternion_subscription) {
-        _camera_attitude_quaternion_subscription(get_camera_attitude_quaternion());
+    if (!_camera_attitude_quaternion_subscriptions.empty()) {
+        notify(_camera_attitude_quaternion_subscriptions, get_camera_attitude_quaternion());
     }
 
-    if (_camera_attitude_euler_angle_subscription) {
-        _camera_attitude_euler_angle_subscription(get_camera_attitude_euler_angle());
+    if (!_camera_attitude_euler_angle_subscriptions.empty()) {
+        notify(_camera_attitude_euler_angle_subscriptions, get_camera_attitude_euler_angle());
     }
 }
 
@@ -422,16 +680,14 @@ void TelemetryImpl::process_gps_raw_int(const mavlink_message_t &message)
     // Local is not different from global for now until things like flow are in place.
     set_health_local_position(gps_ok);
 
-    if (_gps_info_subscription) {
-        _gps_info_subscription(get_gps_info());
+    if (!_gps_info_subscriptions.empty()) {
+        notify(_gps_info_subscriptions, get_gps_info());
     }
 }
 
-void TelemetryImpl::process_extended_sys_state(const mavlink_message_t &message)
+void TelemetryImpl::process_extended_sys_state(
+    const mavlink_extended_sys_state_t &extended_sys_state)
 {
-    mavlink_extended_sys_state_t extended_sys_state;
-    mavlink_msg_extended_sys_state_decode(&message, &extended_sys_state);
-
     if (extended_sys_state.landed_state == MAV_LANDED_STATE_IN_AIR) {
         set_in_air(true);
     } else if (extended_sys_state.landed_state == MAV_LANDED_STATE_ON_GROUND) {
@@ -439,8 +695,8 @@ void TelemetryImpl::process_extended_sys_state(const mavlink_message_t &message)
     }
     // If landed_state is undefined, we use what we have received last.
 
-    if (_in_air_subscription) {
-        _in_air_subscription(in_air());
+    if (!_in_air_subscriptions.empty()) {
+        notify(_in_air_subscriptions, in_air());
     }
 
 }
@@ -450,41 +706,43 @@ void TelemetryImpl::process_sys_status(const mavlink_message_t &message)
     mavlink_sys_status_t sys_status;
     mavlink_msg_sys_status_decode(&message, &sys_status);
     set_battery(Telemetry::Battery({sys_status.voltage_battery * 1e-3f,
-                                    // FIXME: it is strange calling it percent when the range goes from 0 to 1.
+                                    // FIXME: it is strange calling it percent when the range
+                                    // goes from 0 to 1.
                                     sys_status.battery_remaining * 1e-2f
                                    }));
 
-    if (_battery_subscription) {
-        _battery_subscription(get_battery());
+    if (!_battery_subscriptions.empty()) {
+        notify(_battery_subscriptions, get_battery());
     }
 }
 
-void TelemetryImpl::process_heartbeat(const mavlink_message_t &message)
+void TelemetryImpl::process_heartbeat(const MAVLinkMessageView &message)
 {
-    mavlink_heartbeat_t heartbeat;
-    mavlink_msg_heartbeat_decode(&message, &heartbeat);
+    // We only need two fields, so there is no need to decode it all.
+    const uint8_t base_mode = message.get<uint8_t>(heartbeat_offset::base_mode);
+    const uint32_t custom_mode = message.get<uint32_t>(heartbeat_offset::custom_mode);
 
-    set_armed(((heartbeat.base_mode & MAV_MODE_FLAG_SAFETY_ARMED) ? true : false));
+    set_armed(((base_mode & MAV_MODE_FLAG_SAFETY_ARMED) ? true : false));
 
-    if (_armed_subscription) {
-        _armed_subscription(armed());
+    if (!_armed_subscriptions.empty()) {
+        notify(_armed_subscriptions, armed());
     }
 
-    if (heartbeat.base_mode & MAV_MODE_FLAG_CUSTOM_MODE_ENABLED) {
+    if (base_mode & MAV_MODE_FLAG_CUSTOM_MODE_ENABLED) {
 
-        Telemetry::FlightMode flight_mode = to_flight_mode_from_custom_mode(heartbeat.custom_mode);
+        Telemetry::FlightMode flight_mode = to_flight_mode_from_custom_mode(custom_mode);
         set_flight_mode(flight_mode);
 
-        if (_flight_mode_subscription) {
-            _flight_mode_subscription(get_flight_mode());
+        if (!_flight_mode_subscriptions.empty()) {
+            notify(_flight_mode_subscriptions, get_flight_mode());
         }
     }
 
-    if (_health_subscription) {
-        _health_subscription(get_health());
+    if (!_health_subscriptions.empty()) {
+        notify(_health_subscriptions, get_health());
     }
-    if (_health_all_ok_subscription) {
-        _health_all_ok_subscription(get_health_all_ok());
+    if (!_health_all_ok_subscriptions.empty()) {
+        notify(_health_all_ok_subscriptions, get_health_all_ok());
     }
 }
 
@@ -496,11 +754,129 @@ void TelemetryImpl::process_rc_channels(const mavlink_message_t &message)
     bool rc_ok = (rc_channels.chancount > 0);
     set_rc_status(rc_ok, rc_channels.rssi);
 
-    if (_rc_status_subscription) {
-        _rc_status_subscription(get_rc_status());
+    if (!_rc_status_subscriptions.empty()) {
+        notify(_rc_status_subscriptions, get_rc_status());
     }
 
     _parent->refresh_timeout_handler(_timeout_cookie);
+
+    if (_rc_channels_stream.queue.load(std::memory_order_relaxed) == nullptr) {
+        return;
+    }
+
+    Telemetry::RcChannels channels;
+    channels.time_us = uint64_t(rc_channels.time_boot_ms) * 1000;
+    channels.num_channels = rc_channels.chancount;
+    const uint16_t channels_us[Telemetry::MAX_RC_CHANNELS] = {
+        rc_channels.chan1_raw, rc_channels.chan2_raw, rc_channels.chan3_raw,
+        rc_channels.chan4_raw, rc_channels.chan5_raw, rc_channels.chan6_raw,
+        rc_channels.chan7_raw, rc_channels.chan8_raw, rc_channels.chan9_raw,
+        rc_channels.chan10_raw, rc_channels.chan11_raw, rc_channels.chan12_raw,
+        rc_channels.chan13_raw, rc_channels.chan14_raw, rc_channels.chan15_raw,
+        rc_channels.chan16_raw, rc_channels.chan17_raw, rc_channels.chan18_raw
+    };
+    memcpy(channels.channels_us, channels_us, sizeof(channels_us));
+    // 255 is unknown, the rest goes up to 254.
+    channels.signal_strength_percent = (rc_channels.rssi == UINT8_MAX) ? NAN :
+                                       float(rc_channels.rssi) * 100.0f / 254.0f;
+
+    _rc_channels_stream.push(channels);
+}
+
+void TelemetryImpl::process_highres_imu(const mavlink_message_t &message)
+{
+    mavlink_highres_imu_t highres_imu;
+    mavlink_msg_highres_imu_decode(&message, &highres_imu);
+
+    Telemetry::Imu imu;
+    imu.time_us = highres_imu.time_usec;
+    imu.acc_x_m_s2 = highres_imu.xacc;
+    imu.acc_y_m_s2 = highres_imu.yacc;
+    imu.acc_z_m_s2 = highres_imu.zacc;
+    imu.gyro_x_rad_s = highres_imu.xgyro;
+    imu.gyro_y_rad_s = highres_imu.ygyro;
+    imu.gyro_z_rad_s = highres_imu.zgyro;
+    imu.mag_x_gauss = highres_imu.xmag;
+    imu.mag_y_gauss = highres_imu.ymag;
+    imu.mag_z_gauss = highres_imu.zmag;
+    imu.abs_pressure_hpa = highres_imu.abs_pressure;
+    imu.temperature_degc = highres_imu.temperature;
+
+    _imu_stream.push(imu);
+}
+
+void TelemetryImpl::process_odometry(const mavlink_message_t &message)
+{
+    mavlink_odometry_t odometry_msg;
+    mavlink_msg_odometry_decode(&message, &odometry_msg);
+
+    Telemetry::Odometry odometry;
+    odometry.time_us = odometry_msg.time_usec;
+    odometry.x_m = odometry_msg.x;
+    odometry.y_m = odometry_msg.y;
+    odometry.z_m = odometry_msg.z;
+    odometry.q = Telemetry::Quaternion {
+        odometry_msg.q[0],
+        odometry_msg.q[1],
+        odometry_msg.q[2],
+        odometry_msg.q[3]
+    };
+    odometry.vx_m_s = odometry_msg.vx;
+    odometry.vy_m_s = odometry_msg.vy;
+    odometry.vz_m_s = odometry_msg.vz;
+    odometry.rollspeed_rad_s = odometry_msg.rollspeed;
+    odometry.pitchspeed_rad_s = odometry_msg.pitchspeed;
+    odometry.yawspeed_rad_s = odometry_msg.yawspeed;
+
+    _odometry_stream.push(odometry);
+}
+
+void TelemetryImpl::process_radio_status(const mavlink_message_t &message)
+{
+    mavlink_radio_status_t radio_status;
+    mavlink_msg_radio_status_decode(&message, &radio_status);
+
+    std::vector<Telemetry::TopicRate> rates;
+    {
+        std::lock_guard<instrumented_mutex_t> lock(_adaptive_rates_mutex);
+        if (_adaptive_rates.empty()) {
+            return;
+        }
+        if (!_rate_adapter.add_radio_status(radio_status.txbuf, radio_status.rxerrors,
+                                            _time.elapsed_s())) {
+            return;
+        }
+        rates = scaled_rates(_adaptive_rates, _rate_adapter.scale());
+        LogDebug() << "Radio link " << (radio_status.txbuf < RateAdapter::CONGESTED_TXBUF ?
+                                        "congested" : "quality changed")
+                   << ", telemetry rates at " << _rate_adapter.scale();
+    }
+
+    // Not waited for, this is the receive thread.
+    set_rates_async(rates, [](Telemetry::Result result) {
+        if (result != Telemetry::Result::SUCCESS) {
+            LogWarn() << "Could not adapt telemetry rates: " << Telemetry::result_str(result);
+        }
+    });
+}
+
+void TelemetryImpl::process_attitude(const mavlink_message_t &message)
+{
+    mavlink_attitude_t attitude_msg;
+    mavlink_msg_attitude_decode(&message, &attitude_msg);
+
+    Telemetry::Attitude attitude;
+    attitude.time_us = uint64_t(attitude_msg.time_boot_ms) * 1000;
+    attitude.euler_angle = Telemetry::EulerAngle {
+        to_deg_from_rad(attitude_msg.roll),
+        to_deg_from_rad(attitude_msg.pitch),
+        to_deg_from_rad(attitude_msg.yaw)
+    };
+    attitude.rollspeed_rad_s = attitude_msg.rollspeed;
+    attitude.pitchspeed_rad_s = attitude_msg.pitchspeed;
+    attitude.yawspeed_rad_s = attitude_msg.yawspeed;
+
+    _attitude_stream.push(attitude);
 }
 
 Telemetry::FlightMode TelemetryImpl::to_flight_mode_from_custom_mode(uint32_t custom_mode)
@@ -535,6 +911,27 @@ Telemetry::FlightMode TelemetryImpl::to_flight_mode_from_custom_mode(uint32_t cu
     }
 }
 
+void TelemetryImpl::receive_calibration_params(
+    bool success, const std::map<std::string, MAVLinkParameters::ParamValue> &values)
+{
+    UNUSED(success);
+
+    // Every one which failed is reported on its own.
+    auto it = values.find("CAL_GYRO0_ID");
+    receive_param_cal_gyro(it != values.end(), it != values.end() ? it->second.get_int32() : 0);
+
+    it = values.find("CAL_ACC0_ID");
+    receive_param_cal_accel(it != values.end(), it != values.end() ? it->second.get_int32() : 0);
+
+    it = values.find("CAL_MAG0_ID");
+    receive_param_cal_mag(it != values.end(), it != values.end() ? it->second.get_int32() : 0);
+
+#ifdef LEVEL_CALIBRATION
+    it = values.find("SENS_BOARD_X_OFF");
+    receive_param_cal_level(it != values.end(), it != values.end() ? it->second.get_float() : 0.0f);
+#endif
+}
+
 void TelemetryImpl::receive_param_cal_gyro(bool success, int value)
 {
     if (!success) {
@@ -589,26 +986,118 @@ void TelemetryImpl::receive_rc_channels_timeout()
 
 Telemetry::Position TelemetryImpl::get_position() const
 {
-    std::lock_guard<std::mutex> lock(_position_mutex);
-    return _position;
+    return _position.load();
 }
 
-void TelemetryImpl::set_position(Telemetry::Position position)
+void TelemetryImpl::set_position_velocity_ned(Telemetry::Position position,
+                                              Telemetry::GroundSpeedNED ground_speed_ned,
+                                              uint64_t vehicle_time_us)
 {
-    std::lock_guard<std::mutex> lock(_position_mutex);
-    _position = position;
+    _position.store(position);
+    _ground_speed_ned.store(ground_speed_ned);
+
+    const uint64_t time_us = receive_time_us();
+    const uint64_t sample_time = sample_time_us(vehicle_time_us);
+    const Telemetry::PositionSample position_sample {
+        time_us, position, vehicle_time_us, sample_time
+    };
+    const Telemetry::GroundSpeedNEDSample ground_speed_ned_sample {
+        time_us, ground_speed_ned, vehicle_time_us, sample_time
+    };
+    _position_history.add(position_sample);
+    _ground_speed_ned_history.add(ground_speed_ned_sample);
+
+    if (!_position_sample_subscriptions.empty()) {
+        notify(_position_sample_subscriptions, position_sample);
+    }
+    if (!_ground_speed_ned_sample_subscriptions.empty()) {
+        notify(_ground_speed_ned_sample_subscriptions, ground_speed_ned_sample);
+    }
+
+    const double position_values[] = {
+        position.latitude_deg,
+        position.longitude_deg,
+        double(position.absolute_altitude_m),
+        double(position.relative_altitude_m)
+    };
+    _position_recording.append(time_us, position_values);
+
+    const double ground_speed_ned_values[] = {
+        double(ground_speed_ned.velocity_north_m_s),
+        double(ground_speed_ned.velocity_east_m_s),
+        double(ground_speed_ned.velocity_down_m_s)
+    };
+    _ground_speed_ned_recording.append(time_us, ground_speed_ned_values);
+
+    _snapshot.update([&position, &ground_speed_ned, time_us, sample_time](
+    Telemetry::Snapshot & snapshot) {
+        snapshot.position = position;
+        snapshot.position_time_us = time_us;
+        snapshot.position_sample_time_us = sample_time;
+        snapshot.ground_speed_ned = ground_speed_ned;
+        snapshot.ground_speed_ned_time_us = time_us;
+    });
 }
 
 Telemetry::Position TelemetryImpl::get_home_position() const
 {
-    std::lock_guard<std::mutex> lock(_home_position_mutex);
-    return _home_position;
+    return _home_position.load();
 }
 
 void TelemetryImpl::set_home_position(Telemetry::Position home_position)
 {
-    std::lock_guard<std::mutex> lock(_home_position_mutex);
-    _home_position = home_position;
+    _home_position.store(home_position);
+
+    const uint64_t time_us = receive_time_us();
+    _snapshot.update([&home_position, time_us](Telemetry::Snapshot & snapshot) {
+        snapshot.home_position = home_position;
+        snapshot.home_position_time_us = time_us;
+    });
+}
+
+void TelemetryImpl::update_ground_track(Telemetry::GroundSpeedNED ground_speed_ned)
+{
+    const Telemetry::GroundTrack ground_track =
+        to_ground_track_from_ground_speed_ned(ground_speed_ned);
+    _ground_track.store(ground_track);
+
+    if (!_ground_track_subscriptions.empty()) {
+        notify(_ground_track_subscriptions, ground_track);
+    }
+}
+
+void TelemetryImpl::update_home_vector(Telemetry::Position position,
+                                       Telemetry::Position home_position)
+{
+    const Telemetry::HomeVector home_vector = to_home_vector(position, home_position);
+    _home_vector.store(home_vector);
+
+    if (!_home_vector_subscriptions.empty()) {
+        notify(_home_vector_subscriptions, home_vector);
+    }
+}
+
+void TelemetryImpl::want_derived() const
+{
+    if (_derived_wanted.exchange(true)) {
+        return;
+    }
+
+    // Until the next update, from what was received last.
+    _ground_track.store(to_ground_track_from_ground_speed_ned(get_ground_speed_ned()));
+    _home_vector.store(to_home_vector(get_position(), get_home_position()));
+}
+
+Telemetry::GroundTrack TelemetryImpl::get_ground_track() const
+{
+    want_derived();
+    return _ground_track.load();
+}
+
+Telemetry::HomeVector TelemetryImpl::get_home_vector() const
+{
+    want_derived();
+    return _home_vector.load();
 }
 
 bool TelemetryImpl::in_air() const
@@ -624,119 +1113,167 @@ bool TelemetryImpl::armed() const
 void TelemetryImpl::set_in_air(bool in_air_new)
 {
     _in_air = in_air_new;
+
+    const uint64_t time_us = receive_time_us();
+    _snapshot.update([in_air_new, time_us](Telemetry::Snapshot & snapshot) {
+        snapshot.in_air = in_air_new;
+        snapshot.in_air_time_us = time_us;
+    });
 }
 
 void TelemetryImpl::set_armed(bool armed_new)
 {
     _armed = armed_new;
+
+    const uint64_t time_us = receive_time_us();
+    _snapshot.update([armed_new, time_us](Telemetry::Snapshot & snapshot) {
+        snapshot.armed = armed_new;
+        snapshot.armed_time_us = time_us;
+    });
 }
 
 Telemetry::Quaternion TelemetryImpl::get_attitude_quaternion() const
 {
-    std::lock_guard<std::mutex> lock(_attitude_quaternion_mutex);
-    return _attitude_quaternion;
+    return _attitude_quaternion.load();
 }
 
 Telemetry::EulerAngle TelemetryImpl::get_attitude_euler_angle() const
 {
-    std::lock_guard<std::mutex> lock(_attitude_quaternion_mutex);
-    Telemetry::EulerAngle euler = to_euler_angle_from_quaternion(_attitude_quaternion);
+    Telemetry::EulerAngle euler = to_euler_angle_from_quaternion(_attitude_quaternion.load());
 
     return euler;
 }
 
-void TelemetryImpl::set_attitude_quaternion(Telemetry::Quaternion quaternion)
+void TelemetryImpl::set_attitude_quaternion(Telemetry::Quaternion quaternion,
+                                            uint64_t vehicle_time_us)
 {
-    std::lock_guard<std::mutex> lock(_attitude_quaternion_mutex);
-    _attitude_quaternion = quaternion;
+    _attitude_quaternion.store(quaternion);
+
+    const uint64_t time_us = receive_time_us();
+    const uint64_t sample_time = sample_time_us(vehicle_time_us);
+    const Telemetry::QuaternionSample quaternion_sample {
+        time_us, quaternion, vehicle_time_us, sample_time
+    };
+    _attitude_quaternion_history.add(quaternion_sample);
+
+    if (!_attitude_quaternion_sample_subscriptions.empty()) {
+        notify(_attitude_quaternion_sample_subscriptions, quaternion_sample);
+    }
+
+    const double quaternion_values[] = {
+        double(quaternion.w),
+        double(quaternion.x),
+        double(quaternion.y),
+        double(quaternion.z)
+    };
+    _attitude_quaternion_recording.append(time_us, quaternion_values);
+
+    _snapshot.update([&quaternion, time_us, sample_time](Telemetry::Snapshot & snapshot) {
+        snapshot.attitude_quaternion = quaternion;
+        snapshot.attitude_quaternion_time_us = time_us;
+        snapshot.attitude_quaternion_sample_time_us = sample_time;
+    });
 }
 
 Telemetry::Quaternion TelemetryImpl::get_camera_attitude_quaternion() const
 {
-    std::lock_guard<std::mutex> lock(_camera_attitude_euler_angle_mutex);
     Telemetry::Quaternion quaternion
-        = to_quaternion_from_euler_angle(_camera_attitude_euler_angle);
+        = to_quaternion_from_euler_angle(_camera_attitude_euler_angle.load());
 
     return quaternion;
 }
 
 Telemetry::EulerAngle TelemetryImpl::get_camera_attitude_euler_angle() const
 {
-    std::lock_guard<std::mutex> lock(_camera_attitude_euler_angle_mutex);
-
-    return _camera_attitude_euler_angle;
+    return _camera_attitude_euler_angle.load();
 }
 
 void TelemetryImpl::set_camera_attitude_euler_angle(Telemetry::EulerAngle euler_angle)
 {
-    std::lock_guard<std::mutex> lock(_camera_attitude_euler_angle_mutex);
-    _camera_attitude_euler_angle = euler_angle;
-}
+    _camera_attitude_euler_angle.store(euler_angle);
 
-Telemetry::GroundSpeedNED TelemetryImpl::get_ground_speed_ned() const
-{
-    std::lock_guard<std::mutex> lock(_ground_speed_ned_mutex);
-    return _ground_speed_ned;
+    const uint64_t time_us = receive_time_us();
+    _snapshot.update([&euler_angle, time_us](Telemetry::Snapshot & snapshot) {
+        snapshot.camera_attitude_euler_angle = euler_angle;
+        snapshot.camera_attitude_euler_angle_time_us = time_us;
+    });
 }
 
-void TelemetryImpl::set_ground_speed_ned(Telemetry::GroundSpeedNED ground_speed_ned)
+Telemetry::GroundSpeedNED TelemetryImpl::get_ground_speed_ned() const
 {
-    std::lock_guard<std::mutex> lock(_ground_speed_ned_mutex);
-    _ground_speed_ned = ground_speed_ned;
+    return _ground_speed_ned.load();
 }
 
 Telemetry::GPSInfo TelemetryImpl::get_gps_info() const
 {
-    std::lock_guard<std::mutex> lock(_gps_info_mutex);
-    return _gps_info;
+    return _gps_info.load();
 }
 
 void TelemetryImpl::set_gps_info(Telemetry::GPSInfo gps_info)
 {
-    std::lock_guard<std::mutex> lock(_gps_info_mutex);
-    _gps_info = gps_info;
+    _gps_info.store(gps_info);
+
+    const uint64_t time_us = receive_time_us();
+    _snapshot.update([&gps_info, time_us](Telemetry::Snapshot & snapshot) {
+        snapshot.gps_info = gps_info;
+        snapshot.gps_info_time_us = time_us;
+    });
 }
 
 Telemetry::Battery TelemetryImpl::get_battery() const
 {
-    std::lock_guard<std::mutex> lock(_battery_mutex);
-    return _battery;
+    return _battery.load();
 }
 
 void TelemetryImpl::set_battery(Telemetry::Battery battery)
 {
-    std::lock_guard<std::mutex> lock(_battery_mutex);
-    _battery = battery;
+    _battery.store(battery);
+
+    const uint64_t time_us = receive_time_us();
+
+    const double battery_values[] = {
+        double(battery.voltage_v),
+        double(battery.remaining_percent)
+    };
+    _battery_recording.append(time_us, battery_values);
+
+    _snapshot.update([&battery, time_us](Telemetry::Snapshot & snapshot) {
+        snapshot.battery = battery;
+        snapshot.battery_time_us = time_us;
+    });
 }
 
 Telemetry::FlightMode TelemetryImpl::get_flight_mode() const
 {
-    std::lock_guard<std::mutex> lock(_flight_mode_mutex);
-    return _flight_mode;
+    return _flight_mode.load();
 }
 
 void TelemetryImpl::set_flight_mode(Telemetry::FlightMode flight_mode)
 {
-    std::lock_guard<std::mutex> lock(_flight_mode_mutex);
-    _flight_mode = flight_mode;
+    _flight_mode.store(flight_mode);
+
+    const uint64_t time_us = receive_time_us();
+    _snapshot.update([&flight_mode, time_us](Telemetry::Snapshot & snapshot) {
+        snapshot.flight_mode = flight_mode;
+        snapshot.flight_mode_time_us = time_us;
+    });
 }
 
 Telemetry::Health TelemetryImpl::get_health() const
 {
-    std::lock_guard<std::mutex> lock(_health_mutex);
-    return _health;
+    return _health.load();
 }
 
 bool TelemetryImpl::get_health_all_ok() const
 {
-    std::lock_guard<std::mutex> lock(_health_mutex);
-    if (_health.gyrometer_calibration_ok &&
-        _health.accelerometer_calibration_ok &&
-        _health.magnetometer_calibration_ok &&
-        _health.level_calibration_ok &&
-        _health.local_position_ok &&
-        _health.global_position_ok &&
-        _health.home_position_ok) {
+    const Telemetry::Health health = _health.load();
+    if (health.gyrometer_calibration_ok &&
+        health.accelerometer_calibration_ok &&
+        health.magnetometer_calibration_ok &&
+        health.level_calibration_ok &&
+        health.local_position_ok &&
+        health.global_position_ok &&
+        health.home_position_ok) {
         return true;
     } else {
         return false;
@@ -745,143 +1282,693 @@ bool TelemetryImpl::get_health_all_ok() const
 
 Telemetry::RCStatus TelemetryImpl::get_rc_status() const
 {
-    std::lock_guard<std::mutex> lock(_rc_status_mutex);
-    return _rc_status;
+    return _rc_status.load();
 }
 
 void TelemetryImpl::set_health_local_position(bool ok)
 {
-    std::lock_guard<std::mutex> lock(_health_mutex);
-    _health.local_position_ok = ok;
+    _health.update([ok](Telemetry::Health & health) {
+        health.local_position_ok = ok;
+    });
+    publish_health();
 }
 
 void TelemetryImpl::set_health_global_position(bool ok)
 {
-    std::lock_guard<std::mutex> lock(_health_mutex);
-    _health.global_position_ok = ok;
+    _health.update([ok](Telemetry::Health & health) {
+        health.global_position_ok = ok;
+    });
+    publish_health();
 }
 
 void TelemetryImpl::set_health_home_position(bool ok)
 {
-    std::lock_guard<std::mutex> lock(_health_mutex);
-    _health.home_position_ok = ok;
+    _health.update([ok](Telemetry::Health & health) {
+        health.home_position_ok = ok;
+    });
+    publish_health();
 }
 
 void TelemetryImpl::set_health_gyrometer_calibration(bool ok)
 {
-    std::lock_guard<std::mutex> lock(_health_mutex);
-    _health.gyrometer_calibration_ok = ok;
+    _health.update([ok](Telemetry::Health & health) {
+        health.gyrometer_calibration_ok = ok;
+    });
+    publish_health();
 }
 
 void TelemetryImpl::set_health_accelerometer_calibration(bool ok)
 {
-    std::lock_guard<std::mutex> lock(_health_mutex);
-    _health.accelerometer_calibration_ok = ok;
+    _health.update([ok](Telemetry::Health & health) {
+        health.accelerometer_calibration_ok = ok;
+    });
+    publish_health();
 }
 
 void TelemetryImpl::set_health_magnetometer_calibration(bool ok)
 {
-    std::lock_guard<std::mutex> lock(_health_mutex);
-    _health.magnetometer_calibration_ok = ok;
+    _health.update([ok](Telemetry::Health & health) {
+        health.magnetometer_calibration_ok = ok;
+    });
+    publish_health();
 }
 
 void TelemetryImpl::set_health_level_calibration(bool ok)
 {
-    std::lock_guard<std::mutex> lock(_health_mutex);
-    _health.level_calibration_ok = ok;
+    _health.update([ok](Telemetry::Health & health) {
+        health.level_calibration_ok = ok;
+    });
+    publish_health();
 }
 
 void TelemetryImpl::set_rc_status(bool available, float signal_strength_percent)
 {
-    std::lock_guard<std::mutex> lock(_rc_status_mutex);
+    _rc_status.update([available, signal_strength_percent](Telemetry::RCStatus & rc_status) {
+        if (available) {
+            rc_status.available_once = true;
+            rc_status.signal_strength_percent = signal_strength_percent;
+        } else {
+            rc_status.signal_strength_percent = 0.0f;
+        }
 
-    if (available) {
-        _rc_status.available_once = true;
-        _rc_status.signal_strength_percent = signal_strength_percent;
-    } else {
-        _rc_status.signal_strength_percent = 0.0f;
+        rc_status.available = available;
+    });
+
+    const uint64_t time_us = receive_time_us();
+    _snapshot.update([this, time_us](Telemetry::Snapshot & snapshot) {
+        // Whoever publishes last has the latest value.
+        snapshot.rc_status = _rc_status.load();
+        snapshot.rc_status_time_us = time_us;
+    });
+}
+
+void TelemetryImpl::publish_health()
+{
+    const uint64_t time_us = receive_time_us();
+    _snapshot.update([this, time_us](Telemetry::Snapshot & snapshot) {
+        // Whoever publishes last has the latest value.
+        snapshot.health = _health.load();
+        snapshot.health_time_us = time_us;
+    });
+}
+
+Telemetry::Snapshot TelemetryImpl::get_snapshot() const
+{
+    return _snapshot.load();
+}
+
+void TelemetryImpl::set_history_capacity(size_t num_samples)
+{
+    _position_history.set_capacity(num_samples);
+    _attitude_quaternion_history.set_capacity(num_samples);
+    _ground_speed_ned_history.set_capacity(num_samples);
+}
+
+std::vector<Telemetry::PositionSample> TelemetryImpl::get_history_position(uint64_t since_us) const
+{
+    std::vector<Telemetry::PositionSample> samples;
+    _position_history.copy_since(since_us, samples);
+    return samples;
+}
+
+std::vector<Telemetry::QuaternionSample>
+TelemetryImpl::get_history_attitude_quaternion(uint64_t since_us) const
+{
+    std::vector<Telemetry::QuaternionSample> samples;
+    _attitude_quaternion_history.copy_since(since_us, samples);
+    return samples;
+}
+
+std::vector<Telemetry::GroundSpeedNEDSample>
+TelemetryImpl::get_history_ground_speed_ned(uint64_t since_us) const
+{
+    std::vector<Telemetry::GroundSpeedNEDSample> samples;
+    _ground_speed_ned_history.copy_since(since_us, samples);
+    return samples;
+}
+
+Telemetry::Result TelemetryImpl::enable_imu_stream(size_t capacity, double rate_hz)
+{
+    _imu_stream.enable(capacity);
+    if (capacity == 0) {
+        return Telemetry::Result::SUCCESS;
+    }
+
+    return telemetry_result_from_command_result(
+               _parent->set_msg_rate(MAVLINK_MSG_ID_HIGHRES_IMU, rate_hz, MAV_COMP_ID_AUTOPILOT1,
+                                     this));
+}
+
+size_t TelemetryImpl::drain_imu_stream(std::vector<Telemetry::Imu> &samples)
+{
+    return _imu_stream.drain(samples);
+}
+
+uint64_t TelemetryImpl::get_imu_stream_dropped() const
+{
+    return _imu_stream.dropped;
+}
+
+Telemetry::Result TelemetryImpl::enable_odometry_stream(size_t capacity, double rate_hz)
+{
+    _odometry_stream.enable(capacity);
+    if (capacity == 0) {
+        return Telemetry::Result::SUCCESS;
+    }
+
+    return telemetry_result_from_command_result(
+               _parent->set_msg_rate(MAVLINK_MSG_ID_ODOMETRY, rate_hz, MAV_COMP_ID_AUTOPILOT1,
+                                     this));
+}
+
+size_t TelemetryImpl::drain_odometry_stream(std::vector<Telemetry::Odometry> &samples)
+{
+    return _odometry_stream.drain(samples);
+}
+
+uint64_t TelemetryImpl::get_odometry_stream_dropped() const
+{
+    return _odometry_stream.dropped;
+}
+
+Telemetry::Result TelemetryImpl::enable_rc_channels_stream(size_t capacity, double rate_hz)
+{
+    _rc_channels_stream.enable(capacity);
+    if (capacity == 0) {
+        return Telemetry::Result::SUCCESS;
+    }
+
+    return telemetry_result_from_command_result(
+               _parent->set_msg_rate(MAVLINK_MSG_ID_RC_CHANNELS, rate_hz, MAV_COMP_ID_AUTOPILOT1,
+                                     this));
+}
+
+size_t TelemetryImpl::drain_rc_channels_stream(std::vector<Telemetry::RcChannels> &samples)
+{
+    return _rc_channels_stream.drain(samples);
+}
+
+uint64_t TelemetryImpl::get_rc_channels_stream_dropped() const
+{
+    return _rc_channels_stream.dropped;
+}
+
+Telemetry::Result TelemetryImpl::enable_attitude_stream(size_t capacity, double rate_hz)
+{
+    _attitude_stream.enable(capacity);
+    if (capacity == 0) {
+        return Telemetry::Result::SUCCESS;
+    }
+
+    return telemetry_result_from_command_result(
+               _parent->set_msg_rate(MAVLINK_MSG_ID_ATTITUDE, rate_hz, MAV_COMP_ID_AUTOPILOT1,
+                                     this));
+}
+
+size_t TelemetryImpl::drain_attitude_stream(std::vector<Telemetry::Attitude> &samples)
+{
+    return _attitude_stream.drain(samples);
+}
+
+uint64_t TelemetryImpl::get_attitude_stream_dropped() const
+{
+    return _attitude_stream.dropped;
+}
+
+bool TelemetryImpl::start_recording(const std::string &directory)
+{
+    const std::string prefix = directory + "/";
+    const ColumnFile::Type float_type = ColumnFile::Type::FLOAT;
+
+    bool success = _position_recording.open(prefix + "position.dccf", {
+        {"latitude_deg", ColumnFile::Type::DOUBLE},
+        {"longitude_deg", ColumnFile::Type::DOUBLE},
+        {"absolute_altitude_m", float_type},
+        {"relative_altitude_m", float_type}
+    });
+    success = _attitude_quaternion_recording.open(prefix + "attitude_quaternion.dccf", {
+        {"w", float_type},
+        {"x", float_type},
+        {"y", float_type},
+        {"z", float_type}
+    }) && success;
+    success = _ground_speed_ned_recording.open(prefix + "ground_speed_ned.dccf", {
+        {"velocity_north_m_s", float_type},
+        {"velocity_east_m_s", float_type},
+        {"velocity_down_m_s", float_type}
+    }) && success;
+    success = _battery_recording.open(prefix + "battery.dccf", {
+        {"voltage_v", float_type},
+        {"remaining_percent", float_type}
+    }) && success;
+
+    if (!success) {
+        stop_recording();
+    }
+    return success;
+}
+
+void TelemetryImpl::stop_recording()
+{
+    _position_recording.close();
+    _attitude_quaternion_recording.close();
+    _ground_speed_ned_recording.close();
+    _battery_recording.close();
+}
+
+template<typename T>
+void TelemetryImpl::Stream<T>::enable(size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(queues_mutex);
+
+    if (capacity == 0) {
+        queue = nullptr;
+        return;
+    }
+
+    queues.emplace_back(new SpscQueue<T>(capacity));
+    queue = queues.back().get();
+}
+
+template<typename T>
+size_t TelemetryImpl::Stream<T>::drain(std::vector<T> &samples)
+{
+    SpscQueue<T> *current = queue;
+    if (current == nullptr) {
+        return 0;
+    }
+    return current->pop_batch(samples);
+}
+
+template<typename T>
+void TelemetryImpl::Stream<T>::push(const T &sample)
+{
+    SpscQueue<T> *current = queue;
+    if (current == nullptr) {
+        return;
+    }
+    if (!current->push(sample)) {
+        ++dropped;
+    }
+}
+
+uint64_t TelemetryImpl::receive_time_us()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                        _parent->get_time().steady_time().time_since_epoch()).count());
+}
+
+uint64_t TelemetryImpl::sample_time_us(uint64_t vehicle_time_us) const
+{
+    uint64_t host_us = 0;
+    if (vehicle_time_us == 0 || !_parent->vehicle_time_to_host_us(vehicle_time_us, host_us)) {
+        return 0;
     }
+    return host_us;
+}
+
+Telemetry::TimesyncStatus TelemetryImpl::timesync_status() const
+{
+    const TimesyncEstimator::Status status = _parent->get_timesync_status();
+    return Telemetry::TimesyncStatus {
+        status.converged,
+        status.offset_s,
+        status.skew_ppm,
+        status.rtt_s,
+        status.num_samples,
+        status.num_rejected
+    };
+}
+
+// How much a value changed, in the unit of the deadband for its topic.
+static double difference(const Telemetry::Position &lhs, const Telemetry::Position &rhs)
+{
+    // Flat earth is good enough for distances this small.
+    const double earth_radius_m = 6371000.0;
+    const double north_m = (lhs.latitude_deg - rhs.latitude_deg) * (M_PI / 180.0) * earth_radius_m;
+    const double east_m = (lhs.longitude_deg - rhs.longitude_deg) * (M_PI / 180.0) * earth_radius_m
+                          * std::cos(lhs.latitude_deg * (M_PI / 180.0));
+    const double up_m = double(lhs.absolute_altitude_m - rhs.absolute_altitude_m);
+    const double distance_m = std::sqrt(north_m * north_m + east_m * east_m + up_m * up_m);
+    // Something with NAN always counts as a change.
+    return std::isnan(distance_m) ? double(INFINITY) : distance_m;
+}
 
-    _rc_status.available = available;
+static double difference(const Telemetry::Quaternion &lhs, const Telemetry::Quaternion &rhs)
+{
+    const double dot = std::fabs(double(lhs.w * rhs.w + lhs.x * rhs.x +
+                                        lhs.y * rhs.y + lhs.z * rhs.z));
+    const double angle_deg = 2.0 * std::acos(std::min(dot, 1.0)) * (180.0 / M_PI);
+    return std::isnan(angle_deg) ? double(INFINITY) : angle_deg;
+}
 
+static double angle_difference_deg(float lhs_deg, float rhs_deg)
+{
+    double diff = std::fmod(std::fabs(double(lhs_deg - rhs_deg)), 360.0);
+    if (diff > 180.0) {
+        diff = 360.0 - diff;
+    }
+    return std::isnan(diff) ? double(INFINITY) : diff;
 }
 
-void TelemetryImpl::position_async(Telemetry::position_callback_t &callback)
+static double difference(const Telemetry::EulerAngle &lhs, const Telemetry::EulerAngle &rhs)
 {
-    _position_subscription = callback;
+    return std::max(angle_difference_deg(lhs.roll_deg, rhs.roll_deg),
+                    std::max(angle_difference_deg(lhs.pitch_deg, rhs.pitch_deg),
+                             angle_difference_deg(lhs.yaw_deg, rhs.yaw_deg)));
 }
 
-void TelemetryImpl::home_position_async(Telemetry::position_callback_t &callback)
+static double difference(const Telemetry::GroundSpeedNED &lhs, const Telemetry::GroundSpeedNED &rhs)
 {
-    _home_position_subscription = callback;
+    const double north = double(lhs.velocity_north_m_s - rhs.velocity_north_m_s);
+    const double east = double(lhs.velocity_east_m_s - rhs.velocity_east_m_s);
+    const double down = double(lhs.velocity_down_m_s - rhs.velocity_down_m_s);
+    const double diff = std::sqrt(north * north + east * east + down * down);
+    return std::isnan(diff) ? double(INFINITY) : diff;
 }
 
-void TelemetryImpl::in_air_async(Telemetry::in_air_callback_t &callback)
+static double difference(const Telemetry::Battery &lhs, const Telemetry::Battery &rhs)
 {
-    _in_air_subscription = callback;
+    const double diff = std::fabs(double(lhs.voltage_v - rhs.voltage_v));
+    return std::isnan(diff) ? double(INFINITY) : diff;
 }
 
-void TelemetryImpl::armed_async(Telemetry::armed_callback_t &callback)
+static double difference(const Telemetry::RCStatus &lhs, const Telemetry::RCStatus &rhs)
 {
-    _armed_subscription = callback;
+    if (lhs.available != rhs.available || lhs.available_once != rhs.available_once) {
+        return double(INFINITY);
+    }
+    return std::fabs(double(lhs.signal_strength_percent - rhs.signal_strength_percent));
 }
 
-void TelemetryImpl::attitude_quaternion_async(Telemetry::attitude_quaternion_callback_t &callback)
+// Samples change as much as their values.
+static double difference(const Telemetry::PositionSample &lhs, const Telemetry::PositionSample &rhs)
 {
-    _attitude_quaternion_subscription = callback;
+    return difference(lhs.position, rhs.position);
 }
 
-void TelemetryImpl::attitude_euler_angle_async(Telemetry::attitude_euler_angle_callback_t
-                                               &callback)
+static double difference(const Telemetry::QuaternionSample &lhs,
+                         const Telemetry::QuaternionSample &rhs)
 {
-    _attitude_euler_angle_subscription = callback;
+    return difference(lhs.quaternion, rhs.quaternion);
 }
 
-void TelemetryImpl::camera_attitude_quaternion_async(Telemetry::attitude_quaternion_callback_t
-                                                     &callback)
+// Taken back to velocities, so that the course counts as much as the speed along it.
+static Telemetry::GroundSpeedNED to_ground_speed_ned(const Telemetry::GroundTrack &ground_track)
 {
-    _camera_attitude_quaternion_subscription = callback;
+    // There is no course without speed.
+    const float course_rad = std::isnan(ground_track.course_deg) ?
+                             0.0f : to_rad_from_deg(ground_track.course_deg);
+    return Telemetry::GroundSpeedNED {
+        ground_track.ground_speed_m_s * std::cos(course_rad),
+        ground_track.ground_speed_m_s * std::sin(course_rad),
+        -ground_track.climb_rate_m_s
+    };
 }
 
-void TelemetryImpl::camera_attitude_euler_angle_async(Telemetry::attitude_euler_angle_callback_t
-                                                      &callback)
+static double difference(const Telemetry::GroundTrack &lhs, const Telemetry::GroundTrack &rhs)
 {
-    _camera_attitude_euler_angle_subscription = callback;
+    return difference(to_ground_speed_ned(lhs), to_ground_speed_ned(rhs));
 }
 
-void TelemetryImpl::ground_speed_ned_async(Telemetry::ground_speed_ned_callback_t &callback)
+static double difference(const Telemetry::HomeVector &lhs, const Telemetry::HomeVector &rhs)
 {
-    _ground_speed_ned_subscription = callback;
+    const double diff = std::fabs(double(lhs.distance_m - rhs.distance_m));
+    return std::isnan(diff) ? double(INFINITY) : diff;
 }
 
-void TelemetryImpl::gps_info_async(Telemetry::gps_info_callback_t &callback)
+static double difference(const Telemetry::GroundSpeedNEDSample &lhs,
+                         const Telemetry::GroundSpeedNEDSample &rhs)
 {
-    _gps_info_subscription = callback;
+    return difference(lhs.ground_speed_ned, rhs.ground_speed_ned);
 }
 
-void TelemetryImpl::battery_async(Telemetry::battery_callback_t &callback)
+// Everything else can only be the same or different.
+template<typename T>
+static double difference(const T &lhs, const T &rhs)
 {
-    _battery_subscription = callback;
+    return (lhs == rhs) ? 0.0 : double(INFINITY);
 }
 
-void TelemetryImpl::flight_mode_async(Telemetry::flight_mode_callback_t &callback)
+template<typename T>
+static Telemetry::subscription_handle_t subscribe(CallbackList<T> &subscriptions,
+                                                  const std::function<void(T)> &callback,
+                                                  const Telemetry::SubscriptionOptions &options,
+                                                  Time &time)
 {
-    _flight_mode_subscription = callback;
+    // Passing nullptr used to be the way to stop getting updates.
+    if (!callback) {
+        subscriptions.clear();
+        return 0;
+    }
+
+    if (options.max_rate_hz <= 0.0 && options.deadband <= 0.0) {
+        return subscriptions.add(callback);
+    }
+
+    // Updates of one topic are delivered one after the other, so this does not
+    // need a lock.
+    struct LastDelivered {
+        bool valid;
+        dl_time_t time;
+        T value;
+    };
+    auto last = std::make_shared<LastDelivered>();
+    last->valid = false;
+
+    return subscriptions.add([callback, options, &time, last](T value) {
+        if (last->valid) {
+            if (options.max_rate_hz > 0.0 &&
+                time.elapsed_since_s(last->time) < 1.0 / options.max_rate_hz) {
+                return;
+            }
+            if (options.deadband > 0.0 &&
+                difference(last->value, value) <= options.deadband) {
+                return;
+            }
+        }
+        last->valid = true;
+        last->time = time.steady_time();
+        last->value = value;
+        callback(value);
+    });
+}
+
+void TelemetryImpl::unsubscribe(Telemetry::subscription_handle_t handle)
+{
+    // Handles are unique across all topics, so only one of these can match.
+    _position_subscriptions.remove(handle) ||
+    _home_position_subscriptions.remove(handle) ||
+    _in_air_subscriptions.remove(handle) ||
+    _armed_subscriptions.remove(handle) ||
+    _attitude_quaternion_subscriptions.remove(handle) ||
+    _attitude_euler_angle_subscriptions.remove(handle) ||
+    _camera_attitude_quaternion_subscriptions.remove(handle) ||
+    _camera_attitude_euler_angle_subscriptions.remove(handle) ||
+    _ground_speed_ned_subscriptions.remove(handle) ||
+    _ground_track_subscriptions.remove(handle) ||
+    _home_vector_subscriptions.remove(handle) ||
+    _gps_info_subscriptions.remove(handle) ||
+    _battery_subscriptions.remove(handle) ||
+    _flight_mode_subscriptions.remove(handle) ||
+    _health_subscriptions.remove(handle) ||
+    _health_all_ok_subscriptions.remove(handle) ||
+    _rc_status_subscriptions.remove(handle) ||
+    _status_text_subscriptions.remove(handle) ||
+    _position_sample_subscriptions.remove(handle) ||
+    _attitude_quaternion_sample_subscriptions.remove(handle) ||
+    _ground_speed_ned_sample_subscriptions.remove(handle);
+}
+
+Telemetry::subscription_handle_t
+TelemetryImpl::position_async(Telemetry::position_callback_t &callback,
+                              const Telemetry::SubscriptionOptions &options)
+{
+    return subscribe(_position_subscriptions, callback, options, _parent->get_time());
+}
+
+Telemetry::subscription_handle_t
+TelemetryImpl::home_position_async(Telemetry::position_callback_t &callback,
+                                   const Telemetry::SubscriptionOptions &options)
+{
+    return subscribe(_home_position_subscriptions, callback, options, _parent->get_time());
+}
+
+Telemetry::subscription_handle_t
+TelemetryImpl::in_air_async(Telemetry::in_air_callback_t &callback,
+                            const Telemetry::SubscriptionOptions &options)
+{
+    return subscribe(_in_air_subscriptions, callback, options, _parent->get_time());
+}
+
+Telemetry::subscription_handle_t
+TelemetryImpl::armed_async(Telemetry::armed_callback_t &callback,
+                           const Telemetry::SubscriptionOptions &options)
+{
+    return subscribe(_armed_subscriptions, callback, options, _parent->get_time());
+}
+
+Telemetry::subscription_handle_t
+TelemetryImpl::attitude_quaternion_async(Telemetry::attitude_quaternion_callback_t &callback,
+                                         const Telemetry::SubscriptionOptions &options)
+{
+    return subscribe(_attitude_quaternion_subscriptions, callback, options, _parent->get_time());
+}
+
+Telemetry::subscription_handle_t
+TelemetryImpl::attitude_euler_angle_async(Telemetry::attitude_euler_angle_callback_t &callback,
+                                          const Telemetry::SubscriptionOptions &options)
+{
+    return subscribe(_attitude_euler_angle_subscriptions, callback, options, _parent->get_time());
+}
+
+Telemetry::subscription_handle_t
+TelemetryImpl::camera_attitude_quaternion_async(Telemetry::attitude_quaternion_callback_t &callback,
+                                                const Telemetry::SubscriptionOptions &options)
+{
+    return subscribe(_camera_attitude_quaternion_subscriptions, callback, options,
+                     _parent->get_time());
+}
+
+Telemetry::subscription_handle_t
+TelemetryImpl::camera_attitude_euler_angle_async(
+    Telemetry::attitude_euler_angle_callback_t &callback,
+    const Telemetry::SubscriptionOptions &options)
+{
+    return subscribe(_camera_attitude_euler_angle_subscriptions, callback, options,
+                     _parent->get_time());
+}
+
+Telemetry::subscription_handle_t
+TelemetryImpl::ground_speed_ned_async(Telemetry::ground_speed_ned_callback_t &callback,
+                                      const Telemetry::SubscriptionOptions &options)
+{
+    return subscribe(_ground_speed_ned_subscriptions, callback, options, _parent->get_time());
+}
+
+Telemetry::subscription_handle_t
+TelemetryImpl::ground_track_async(Telemetry::ground_track_callback_t &callback,
+                                  const Telemetry::SubscriptionOptions &options)
+{
+    want_derived();
+    return subscribe(_ground_track_subscriptions, callback, options, _parent->get_time());
+}
+
+Telemetry::subscription_handle_t
+TelemetryImpl::home_vector_async(Telemetry::home_vector_callback_t &callback,
+                                 const Telemetry::SubscriptionOptions &options)
+{
+    want_derived();
+    return subscribe(_home_vector_subscriptions, callback, options, _parent->get_time());
+}
+
+Telemetry::subscription_handle_t
+TelemetryImpl::gps_info_async(Telemetry::gps_info_callback_t &callback,
+                              const Telemetry::SubscriptionOptions &options)
+{
+    return subscribe(_gps_info_subscriptions, callback, options, _parent->get_time());
+}
+
+Telemetry::subscription_handle_t
+TelemetryImpl::battery_async(Telemetry::battery_callback_t &callback,
+                             const Telemetry::SubscriptionOptions &options)
+{
+    return subscribe(_battery_subscriptions, callback, options, _parent->get_time());
+}
+
+Telemetry::subscription_handle_t
+TelemetryImpl::flight_mode_async(Telemetry::flight_mode_callback_t &callback,
+                                 const Telemetry::SubscriptionOptions &options)
+{
+    return subscribe(_flight_mode_subscriptions, callback, options, _parent->get_time());
+}
+
+Telemetry::subscription_handle_t
+TelemetryImpl::health_async(Telemetry::health_callback_t &callback,
+                            const Telemetry::SubscriptionOptions &options)
+{
+    return subscribe(_health_subscriptions, callback, options, _parent->get_time());
+}
+
+Telemetry::subscription_handle_t
+TelemetryImpl::health_all_ok_async(Telemetry::health_all_ok_callback_t &callback,
+                                   const Telemetry::SubscriptionOptions &options)
+{
+    return subscribe(_health_all_ok_subscriptions, callback, options, _parent->get_time());
+}
+
+Telemetry::subscription_handle_t
+TelemetryImpl::rc_status_async(Telemetry::rc_status_callback_t &callback,
+                               const Telemetry::SubscriptionOptions &options)
+{
+    return subscribe(_rc_status_subscriptions, callback, options, _parent->get_time());
+}
+
+Telemetry::subscription_handle_t
+TelemetryImpl::status_text_async(Telemetry::status_text_callback_t &callback)
+{
+    if (!callback) {
+        _status_text_subscriptions.clear();
+        return 0;
+    }
+    return _status_text_subscriptions.add(callback);
+}
+
+std::vector<Telemetry::StatusText> TelemetryImpl::status_texts(uint64_t since_seq) const
+{
+    std::vector<StatusTextLog::Entry> entries;
+    _parent->get_status_texts(since_seq, entries);
+
+    std::vector<Telemetry::StatusText> status_texts;
+    status_texts.reserve(entries.size());
+    for (const auto &entry : entries) {
+        status_texts.push_back(status_text_from_entry(entry));
+    }
+    return status_texts;
+}
+
+void TelemetryImpl::receive_status_text(const StatusTextLog::Entry &entry)
+{
+    if (!_status_text_subscriptions.empty()) {
+        notify(_status_text_subscriptions, status_text_from_entry(entry));
+    }
+}
+
+Telemetry::StatusText TelemetryImpl::status_text_from_entry(const StatusTextLog::Entry &entry)
+{
+    return Telemetry::StatusText {
+        entry.seq,
+        entry.time_us,
+        entry.component_id,
+        static_cast<Telemetry::StatusTextSeverity>(
+            std::min(entry.severity, uint8_t(MAV_SEVERITY_DEBUG))),
+        entry.text
+    };
 }
 
-void TelemetryImpl::health_async(Telemetry::health_callback_t &callback)
+Telemetry::subscription_handle_t
+TelemetryImpl::position_sample_async(Telemetry::position_sample_callback_t &callback,
+                                     const Telemetry::SubscriptionOptions &options)
 {
-    _health_subscription = callback;
+    return subscribe(_position_sample_subscriptions, callback, options, _parent->get_time());
 }
 
-void TelemetryImpl::health_all_ok_async(Telemetry::health_all_ok_callback_t &callback)
+Telemetry::subscription_handle_t
+TelemetryImpl::attitude_quaternion_sample_async(
+    Telemetry::attitude_quaternion_sample_callback_t &callback,
+    const Telemetry::SubscriptionOptions &options)
 {
-    _health_all_ok_subscription = callback;
+    return subscribe(_attitude_quaternion_sample_subscriptions, callback, options,
+                     _parent->get_time());
 }
 
-void TelemetryImpl::rc_status_async(Telemetry::rc_status_callback_t &callback)
+Telemetry::subscription_handle_t
+TelemetryImpl::ground_speed_ned_sample_async(
+    Telemetry::ground_speed_ned_sample_callback_t &callback,
+    const Telemetry::SubscriptionOptions &options)
 {
-    _rc_status_subscription = callback;
+    return subscribe(_ground_speed_ned_sample_subscriptions, callback, options,
+                     _parent->get_time());
 }
 
 } // namespace dronecore
@@ -1,12 +1,20 @@
 #pragma once
 
 #include <atomic>
+#include <map>
 #include <mutex>
 #include "telemetry.h"
 #include "plugin_impl_base.h"
 #include "system.h"
 #include "mavlink_system.h"
 #include "mavlink_include.h"
+#include "seqlock.h"
+#include "callback_list.h"
+#include "history_buffer.h"
+#include "spsc_queue.h"
+#include "column_file.h"
+#include "rate_adapter.h"
+#include "lock_stats.h"
 
 // Since not all vehicles support/require level calibration, this
 // is disabled for now.
@@ -27,6 +35,7 @@ public:
 
     void enable() override;
     void disable() override;
+    void add_resource_usage(DroneCore::ResourceUsage &usage) override;
 
     Telemetry::Result set_rate_position(double rate_hz);
     Telemetry::Result set_rate_home_position(double rate_hz);
@@ -48,6 +57,21 @@ public:
     void set_rate_battery_async(double rate_hz, Telemetry::result_callback_t callback);
     void set_rate_rc_status_async(double rate_hz, Telemetry::result_callback_t callback);
 
+    Telemetry::Result set_rates(const std::vector<Telemetry::TopicRate> &rates);
+    void set_rates_async(const std::vector<Telemetry::TopicRate> &rates,
+                         Telemetry::result_callback_t callback);
+
+    Telemetry::Result enable_adaptive_rates(const std::vector<Telemetry::AdaptiveRate> &rates);
+    Telemetry::Result disable_adaptive_rates();
+    double adaptive_rate_scale() const;
+
+    void add_rate_profile(const std::string &name,
+                          const std::vector<Telemetry::TopicRate> &rates);
+    Telemetry::Result set_rate_profile(const std::string &name);
+    std::string rate_profile() const;
+
+    Telemetry::TimesyncStatus timesync_status() const;
+
     Telemetry::Position get_position() const;
     Telemetry::Position get_home_position() const;
     bool in_air() const;
@@ -57,37 +81,119 @@ public:
     Telemetry::EulerAngle get_camera_attitude_euler_angle() const;
     Telemetry::Quaternion get_camera_attitude_quaternion() const;
     Telemetry::GroundSpeedNED get_ground_speed_ned() const;
+    Telemetry::GroundTrack get_ground_track() const;
+    Telemetry::HomeVector get_home_vector() const;
     Telemetry::GPSInfo get_gps_info() const;
     Telemetry::Battery get_battery() const;
     Telemetry::FlightMode get_flight_mode() const;
     Telemetry::Health get_health() const;
     bool get_health_all_ok() const;
     Telemetry::RCStatus get_rc_status() const;
-
-    void position_async(Telemetry::position_callback_t &callback);
-    void home_position_async(Telemetry::position_callback_t &callback);
-    void in_air_async(Telemetry::in_air_callback_t &callback);
-    void armed_async(Telemetry::armed_callback_t &callback);
-    void attitude_quaternion_async(Telemetry::attitude_quaternion_callback_t &callback);
-    void attitude_euler_angle_async(Telemetry::attitude_euler_angle_callback_t &callback);
-    void camera_attitude_quaternion_async(Telemetry::attitude_quaternion_callback_t &callback);
-    void camera_attitude_euler_angle_async(Telemetry::attitude_euler_angle_callback_t &callback);
-    void ground_speed_ned_async(Telemetry::ground_speed_ned_callback_t &callback);
-    void gps_info_async(Telemetry::gps_info_callback_t &callback);
-    void battery_async(Telemetry::battery_callback_t &callback);
-    void flight_mode_async(Telemetry::flight_mode_callback_t &callback);
-    void health_async(Telemetry::health_callback_t &callback);
-    void health_all_ok_async(Telemetry::health_all_ok_callback_t &callback);
-    void rc_status_async(Telemetry::rc_status_callback_t &callback);
+    Telemetry::Snapshot get_snapshot() const;
+
+    void set_history_capacity(size_t num_samples);
+    std::vector<Telemetry::PositionSample> get_history_position(uint64_t since_us) const;
+    std::vector<Telemetry::QuaternionSample>
+    get_history_attitude_quaternion(uint64_t since_us) const;
+    std::vector<Telemetry::GroundSpeedNEDSample>
+    get_history_ground_speed_ned(uint64_t since_us) const;
+
+    Telemetry::Result enable_imu_stream(size_t capacity, double rate_hz);
+    size_t drain_imu_stream(std::vector<Telemetry::Imu> &samples);
+    uint64_t get_imu_stream_dropped() const;
+    Telemetry::Result enable_odometry_stream(size_t capacity, double rate_hz);
+    size_t drain_odometry_stream(std::vector<Telemetry::Odometry> &samples);
+    uint64_t get_odometry_stream_dropped() const;
+    Telemetry::Result enable_rc_channels_stream(size_t capacity, double rate_hz);
+    size_t drain_rc_channels_stream(std::vector<Telemetry::RcChannels> &samples);
+    uint64_t get_rc_channels_stream_dropped() const;
+    Telemetry::Result enable_attitude_stream(size_t capacity, double rate_hz);
+    size_t drain_attitude_stream(std::vector<Telemetry::Attitude> &samples);
+    uint64_t get_attitude_stream_dropped() const;
+
+    bool start_recording(const std::string &directory);
+    void stop_recording();
+
+    void unsubscribe(Telemetry::subscription_handle_t handle);
+
+    Telemetry::subscription_handle_t position_async(
+        Telemetry::position_callback_t &callback,
+        const Telemetry::SubscriptionOptions &options);
+    Telemetry::subscription_handle_t home_position_async(
+        Telemetry::position_callback_t &callback,
+        const Telemetry::SubscriptionOptions &options);
+    Telemetry::subscription_handle_t in_air_async(
+        Telemetry::in_air_callback_t &callback,
+        const Telemetry::SubscriptionOptions &options);
+    Telemetry::subscription_handle_t armed_async(
+        Telemetry::armed_callback_t &callback,
+        const Telemetry::SubscriptionOptions &options);
+    Telemetry::subscription_handle_t attitude_quaternion_async(
+        Telemetry::attitude_quaternion_callback_t &callback,
+        const Telemetry::SubscriptionOptions &options);
+    Telemetry::subscription_handle_t attitude_euler_angle_async(
+        Telemetry::attitude_euler_angle_callback_t &callback,
+        const Telemetry::SubscriptionOptions &options);
+    Telemetry::subscription_handle_t camera_attitude_quaternion_async(
+        Telemetry::attitude_quaternion_callback_t &callback,
+        const Telemetry::SubscriptionOptions &options);
+    Telemetry::subscription_handle_t camera_attitude_euler_angle_async(
+        Telemetry::attitude_euler_angle_callback_t &callback,
+        const Telemetry::SubscriptionOptions &options);
+    Telemetry::subscription_handle_t ground_speed_ned_async(
+        Telemetry::ground_speed_ned_callback_t &callback,
+        const Telemetry::SubscriptionOptions &options);
+    Telemetry::subscription_handle_t ground_track_async(
+        Telemetry::ground_track_callback_t &callback,
+        const Telemetry::SubscriptionOptions &options);
+    Telemetry::subscription_handle_t home_vector_async(
+        Telemetry::home_vector_callback_t &callback,
+        const Telemetry::SubscriptionOptions &options);
+    Telemetry::subscription_handle_t gps_info_async(
+        Telemetry::gps_info_callback_t &callback,
+        const Telemetry::SubscriptionOptions &options);
+    Telemetry::subscription_handle_t battery_async(
+        Telemetry::battery_callback_t &callback,
+        const Telemetry::SubscriptionOptions &options);
+    Telemetry::subscription_handle_t flight_mode_async(
+        Telemetry::flight_mode_callback_t &callback,
+        const Telemetry::SubscriptionOptions &options);
+    Telemetry::subscription_handle_t health_async(
+        Telemetry::health_callback_t &callback,
+        const Telemetry::SubscriptionOptions &options);
+    Telemetry::subscription_handle_t health_all_ok_async(
+        Telemetry::health_all_ok_callback_t &callback,
+        const Telemetry::SubscriptionOptions &options);
+    Telemetry::subscription_handle_t rc_status_async(
+        Telemetry::rc_status_callback_t &callback,
+        const Telemetry::SubscriptionOptions &options);
+    Telemetry::subscription_handle_t status_text_async(
+        Telemetry::status_text_callback_t &callback);
+    std::vector<Telemetry::StatusText> status_texts(uint64_t since_seq) const;
+    Telemetry::subscription_handle_t position_sample_async(
+        Telemetry::position_sample_callback_t &callback,
+        const Telemetry::SubscriptionOptions &options);
+    Telemetry::subscription_handle_t attitude_quaternion_sample_async(
+        Telemetry::attitude_quaternion_sample_callback_t &callback,
+        const Telemetry::SubscriptionOptions &options);
+    Telemetry::subscription_handle_t ground_speed_ned_sample_async(
+        Telemetry::ground_speed_ned_sample_callback_t &callback,
+        const Telemetry::SubscriptionOptions &options);
 
 private:
-    void set_position(Telemetry::Position position);
+    // Both come from GLOBAL_POSITION_INT, so they get published together.
+    void set_position_velocity_ned(Telemetry::Position position,
+                                   Telemetry::GroundSpeedNED ground_speed_ned,
+                                   uint64_t vehicle_time_us);
     void set_home_position(Telemetry::Position home_position);
+    // Computed from the fields they are derived from, once wanted.
+    void update_ground_track(Telemetry::GroundSpeedNED ground_speed_ned);
+    void update_home_vector(Telemetry::Position position, Telemetry::Position home_position);
+    void want_derived() const;
     void set_in_air(bool in_air);
     void set_armed(bool armed);
-    void set_attitude_quaternion(Telemetry::Quaternion quaternion);
+    void set_attitude_quaternion(Telemetry::Quaternion quaternion, uint64_t vehicle_time_us);
     void set_camera_attitude_euler_angle(Telemetry::EulerAngle euler_angle);
-    void set_ground_speed_ned(Telemetry::GroundSpeedNED ground_speed_ned);
     void set_gps_info(Telemetry::GPSInfo gps_info);
     void set_battery(Telemetry::Battery battery);
     void set_flight_mode(Telemetry::FlightMode flight_mode);
@@ -99,17 +205,29 @@ private:
     void set_health_magnetometer_calibration(bool ok);
     void set_health_level_calibration(bool ok);
     void set_rc_status(bool available, float signal_strength_percent);
+    void publish_health();
+
+    // Calls the subscriptions of one topic off the receive thread. If they are
+    // slow, older values get dropped.
+    template<typename T>
+    void notify(const CallbackList<T> &subscriptions, const T &value);
 
     void process_global_position_int(const mavlink_message_t &message);
     void process_home_position(const mavlink_message_t &message);
     void process_attitude_quaternion(const mavlink_message_t &message);
     void process_mount_orientation(const mavlink_message_t &message);
     void process_gps_raw_int(const mavlink_message_t &message);
-    void process_extended_sys_state(const mavlink_message_t &message);
+    void process_extended_sys_state(const mavlink_extended_sys_state_t &extended_sys_state);
     void process_sys_status(const mavlink_message_t &message);
-    void process_heartbeat(const mavlink_message_t &message);
+    void process_heartbeat(const MAVLinkMessageView &message);
     void process_rc_channels(const mavlink_message_t &message);
+    void process_highres_imu(const mavlink_message_t &message);
+    void process_odometry(const mavlink_message_t &message);
+    void process_attitude(const mavlink_message_t &message);
+    void process_radio_status(const mavlink_message_t &message);
 
+    void receive_calibration_params(
+        bool success, const std::map<std::string, MAVLinkParameters::ParamValue> &values);
     void receive_param_cal_gyro(bool success, int value);
     void receive_param_cal_accel(bool success, int value);
     void receive_param_cal_mag(bool success, int value);
@@ -128,58 +246,100 @@ private:
 
     static Telemetry::FlightMode to_flight_mode_from_custom_mode(uint32_t custom_mode);
 
-    // Make all fields thread-safe using mutexs
-    // The mutexs are mutable so that the lock can get aqcuired in
-    // methods marked const.
-    mutable std::mutex _position_mutex;
-    Telemetry::Position _position;
+    static uint16_t message_id_of_topic(Telemetry::Topic topic);
+
+    static std::vector<Telemetry::TopicRate>
+    scaled_rates(const std::vector<Telemetry::AdaptiveRate> &rates, double scale);
+
+    // The fields are written by the receive thread and polled by the
+    // application, so reads must not block. See SeqLock.
+    SeqLock<Telemetry::Position> _position;
 
-    mutable std::mutex _home_position_mutex;
-    Telemetry::Position _home_position;
+    SeqLock<Telemetry::Position> _home_position;
 
     // If possible, just use atomic instead of a mutex.
     std::atomic_bool _in_air;
     std::atomic_bool _armed;
 
-    mutable std::mutex _attitude_quaternion_mutex;
-    Telemetry::Quaternion _attitude_quaternion;
-
-    mutable std::mutex _camera_attitude_euler_angle_mutex;
-    Telemetry::EulerAngle _camera_attitude_euler_angle;
-
-    mutable std::mutex _ground_speed_ned_mutex;
-    Telemetry::GroundSpeedNED _ground_speed_ned;
-
-    mutable std::mutex _gps_info_mutex;
-    Telemetry::GPSInfo _gps_info;
-
-    mutable std::mutex _battery_mutex;
-    Telemetry::Battery _battery;
-
-    mutable std::mutex _flight_mode_mutex;
-    Telemetry::FlightMode _flight_mode;
-
-    mutable std::mutex _health_mutex;
-    Telemetry::Health _health;
-
-    mutable std::mutex _rc_status_mutex;
-    Telemetry::RCStatus _rc_status;
-
-    Telemetry::position_callback_t _position_subscription;
-    Telemetry::position_callback_t _home_position_subscription;
-    Telemetry::in_air_callback_t _in_air_subscription;
-    Telemetry::armed_callback_t _armed_subscription;
-    Telemetry::attitude_quaternion_callback_t _attitude_quaternion_subscription;
-    Telemetry::attitude_euler_angle_callback_t _attitude_euler_angle_subscription;
-    Telemetry::attitude_quaternion_callback_t _camera_attitude_quaternion_subscription;
-    Telemetry::attitude_euler_angle_callback_t _camera_attitude_euler_angle_subscription;
-    Telemetry::ground_speed_ned_callback_t _ground_speed_ned_subscription;
-    Telemetry::gps_info_callback_t _gps_info_subscription;
-    Telemetry::battery_callback_t _battery_subscription;
-    Telemetry::flight_mode_callback_t _flight_mode_subscription;
-    Telemetry::health_callback_t _health_subscription;
-    Telemetry::health_all_ok_callback_t _health_all_ok_subscription;
-    Telemetry::rc_status_callback_t _rc_status_subscription;
+    SeqLock<Telemetry::Quaternion> _attitude_quaternion;
+
+    SeqLock<Telemetry::EulerAngle> _camera_attitude_euler_angle;
+
+    SeqLock<Telemetry::GroundSpeedNED> _ground_speed_ned;
+
+    // Nobody should pay for the derived fields without using them, so they are
+    // only kept up to date once they were asked for.
+    mutable std::atomic_bool _derived_wanted {false};
+    mutable SeqLock<Telemetry::GroundTrack> _ground_track;
+    mutable SeqLock<Telemetry::HomeVector> _home_vector;
+
+    SeqLock<Telemetry::GPSInfo> _gps_info;
+
+    SeqLock<Telemetry::Battery> _battery;
+
+    SeqLock<Telemetry::FlightMode> _flight_mode;
+
+    SeqLock<Telemetry::Health> _health;
+
+    SeqLock<Telemetry::RCStatus> _rc_status;
+
+    // Everything again in one place, so that it can be read at once.
+    SeqLock<Telemetry::Snapshot> _snapshot;
+    uint64_t receive_time_us();
+    // 0 until TIMESYNC has given an estimate.
+    uint64_t sample_time_us(uint64_t vehicle_time_us) const;
+
+    HistoryBuffer<Telemetry::PositionSample> _position_history {};
+    HistoryBuffer<Telemetry::QuaternionSample> _attitude_quaternion_history {};
+    HistoryBuffer<Telemetry::GroundSpeedNEDSample> _ground_speed_ned_history {};
+
+    // High-rate samples are pushed by the receive thread, which is the only
+    // producer, and drained by the application, which must be the only
+    // consumer. A queue which is replaced is kept until destruction because
+    // the receive thread could still be pushing into it.
+    template<typename T>
+    struct Stream {
+        std::atomic<SpscQueue<T> *> queue {nullptr};
+        std::atomic<uint64_t> dropped {0};
+        std::mutex queues_mutex {};
+        std::vector<std::unique_ptr<SpscQueue<T>>> queues {};
+
+        void enable(size_t capacity);
+        size_t drain(std::vector<T> &samples);
+        void push(const T &sample);
+    };
+
+    Stream<Telemetry::Imu> _imu_stream {};
+    Stream<Telemetry::Odometry> _odometry_stream {};
+    Stream<Telemetry::Attitude> _attitude_stream {};
+    Stream<Telemetry::RcChannels> _rc_channels_stream {};
+
+    ColumnFile _position_recording {};
+    ColumnFile _attitude_quaternion_recording {};
+    ColumnFile _ground_speed_ned_recording {};
+    ColumnFile _battery_recording {};
+
+    CallbackList<Telemetry::Position> _position_subscriptions {};
+    CallbackList<Telemetry::Position> _home_position_subscriptions {};
+    CallbackList<bool> _in_air_subscriptions {};
+    CallbackList<bool> _armed_subscriptions {};
+    CallbackList<Telemetry::Quaternion> _attitude_quaternion_subscriptions {};
+    CallbackList<Telemetry::EulerAngle> _attitude_euler_angle_subscriptions {};
+    CallbackList<Telemetry::Quaternion> _camera_attitude_quaternion_subscriptions {};
+    CallbackList<Telemetry::EulerAngle> _camera_attitude_euler_angle_subscriptions {};
+    CallbackList<Telemetry::GroundSpeedNED> _ground_speed_ned_subscriptions {};
+    CallbackList<Telemetry::GroundTrack> _ground_track_subscriptions {};
+    CallbackList<Telemetry::HomeVector> _home_vector_subscriptions {};
+    CallbackList<Telemetry::GPSInfo> _gps_info_subscriptions {};
+    CallbackList<Telemetry::Battery> _battery_subscriptions {};
+    CallbackList<Telemetry::FlightMode> _flight_mode_subscriptions {};
+    CallbackList<Telemetry::Health> _health_subscriptions {};
+    CallbackList<bool> _health_all_ok_subscriptions {};
+    CallbackList<Telemetry::RCStatus> _rc_status_subscriptions {};
+    CallbackList<Telemetry::StatusText> _status_text_subscriptions {};
+    CallbackList<Telemetry::PositionSample> _position_sample_subscriptions {};
+    CallbackList<Telemetry::QuaternionSample> _attitude_quaternion_sample_subscriptions {};
+    CallbackList<Telemetry::GroundSpeedNEDSample> _ground_speed_ned_sample_subscriptions {};
 
     // The ground speed and position are coupled to the same message, therefore, we just use
     // the faster between the two.
@@ -187,6 +347,20 @@ private:
     double _position_rate_hz;
 
     void *_timeout_cookie = nullptr;
+
+    mutable instrumented_mutex_t _adaptive_rates_mutex {"telemetry_adaptive_rates"};
+    std::vector<Telemetry::AdaptiveRate> _adaptive_rates {};
+    RateAdapter _rate_adapter {};
+    Time _time {};
+
+    void apply_rate_profile();
+
+    void receive_status_text(const StatusTextLog::Entry &entry);
+    static Telemetry::StatusText status_text_from_entry(const StatusTextLog::Entry &entry);
+
+    mutable instrumented_mutex_t _rate_profiles_mutex {"telemetry_rate_profiles"};
+    std::map<std::string, std::vector<Telemetry::TopicRate>> _rate_profiles {};
+    std::string _rate_profile {};
 };
 
 } // namespace dronecore